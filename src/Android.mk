@@ -9,9 +9,11 @@ LOCAL_SRC_FILES :=      am_map.c \
                         comptime.c \
                         console.c \
                         d_clisrv.c \
+                        d_desync.c \
                         d_main.c \
                         d_net.c \
                         d_netcmd.c \
+                        d_netrec.c \
                         d_netfil.c \
                         dehacked.c \
                         f_finale.c \
@@ -29,6 +31,10 @@ LOCAL_SRC_FILES :=      am_map.c \
                         m_fixed.c \
                         m_menu.c \
                         m_misc.c \
+                        m_bench.c \
+                        m_trace.c \
+                        m_cpu.c \
+                        m_perfstats.c \
                         m_queue.c \
                         m_random.c \
                         md5.c \
@@ -42,12 +48,16 @@ LOCAL_SRC_FILES :=      am_map.c \
                         p_map.c \
                         p_maputl.c \
                         p_mobj.c \
+                        p_predict.c \
                         p_polyobj.c \
                         p_saveg.c \
                         p_setup.c \
                         p_sight.c \
+                        p_warmup.c \
+                        p_snapshot.c \
                         p_spec.c \
                         p_telept.c \
+                        p_threads.c \
                         p_tick.c \
                         p_user.c \
                         r_bsp.c \
@@ -58,6 +68,8 @@ LOCAL_SRC_FILES :=      am_map.c \
                         r_segs.c \
                         r_sky.c \
                         r_splats.c \
+                        r_threads.c \
+                        r_fps.c \
                         r_things.c \
                         s_sound.c \
                         screen.c \
@@ -66,6 +78,7 @@ LOCAL_SRC_FILES :=      am_map.c \
                         string.c \
                         tables.c \
                         v_video.c \
+                        w_md5cache.c \
                         w_wad.c \
                         y_inter.c \
                         z_zone.c \
@@ -735,6 +735,7 @@ static boolean AM_clipMline(const mline_t *ml, fline_t *fl)
 static void AM_drawFline_soft(const fline_t *fl, INT32 color)
 {
 	INT32 x, y, dx, dy, sx, sy, ax, ay, d;
+	UINT8 *fb = screens[0];
 
 #ifdef _DEBUG
 	static INT32 num = 0;
@@ -750,7 +751,12 @@ static void AM_drawFline_soft(const fline_t *fl, INT32 color)
 	}
 #endif
 
-	#define PUTDOT(xx,yy,cc) V_DrawFill(xx,yy,1,1,cc|V_NOSCALESTART);
+	if (!fb)
+		return;
+
+	// The line's already been clipped to the window, so there's no need
+	// to go through V_DrawFill for every single dot
+	#define PUTDOT(xx,yy,cc) fb[(yy)*vid.width + (xx)] = (UINT8)(cc);
 
 	dx = fl->b.x - fl->a.x;
 	ax = 2 * (dx < 0 ? -dx : dx);
@@ -873,6 +879,11 @@ static inline void AM_drawWalls(void)
 		l.a.y = lines[i].v1->y >> FRACTOMAPBITS;
 		l.b.x = lines[i].v2->x >> FRACTOMAPBITS;
 		l.b.y = lines[i].v2->y >> FRACTOMAPBITS;
+
+		// Nothing more to work out if it's entirely outside the window
+		if ((l.a.x < m_x && l.b.x < m_x) || (l.a.x > m_x2 && l.b.x > m_x2)
+			|| (l.a.y < m_y && l.b.y < m_y) || (l.a.y > m_y2 && l.b.y > m_y2))
+			continue;
 #ifdef ESLOPE
 #define SLOPEPARAMS(slope, end1, end2, normalheight) \
 		if (slope) { \
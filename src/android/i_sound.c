@@ -13,6 +13,11 @@ void I_FreeSfx(sfxinfo_t *sfx)
         (void)sfx;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+        (void)sfx;
+}
+
 void I_StartupSound(void){}
 
 void I_ShutdownSound(void){}
@@ -145,6 +150,12 @@ void I_UnloadSong()
 
 }
 
+void I_PrefetchSong(char *data, size_t len)
+{
+        (void)data;
+        (void)len;
+}
+
 boolean I_PlaySong(boolean looping)
 {
         (void)handle;
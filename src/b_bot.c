@@ -17,12 +17,25 @@
 #include "p_local.h"
 #include "b_bot.h"
 #include "lua_hook.h"
+#include "d_netcmd.h"
+#include "d_clisrv.h"
 
-// If you want multiple bots, variables like this will
-// have to be stuffed in something accessible through player_t.
-static boolean lastForward = false;
-static boolean lastBlocked = false;
-static boolean blocked = false;
+// What each bot remembers from the tic before
+typedef struct
+{
+	boolean lastForward;
+	boolean lastBlocked;
+	boolean blocked;
+} botmemory_t;
+
+static botmemory_t botmemory[MAXPLAYERS];
+
+// Bots the server added to the netgame. Only the server knows which
+// players these are: it builds their ticcmds in SV_Maketic and sends
+// them with everyone else's, so everywhere else they're just players.
+static boolean netbot[MAXPLAYERS];
+static INT32 numnetbots = 0;
+static tic_t netbotjointic[MAXPLAYERS]; // when to ask to join the game again
 
 static inline void B_BuildTailsTiccmd(mobj_t *sonic, mobj_t *tails, ticcmd_t *cmd)
 {
@@ -30,6 +43,7 @@ static inline void B_BuildTailsTiccmd(mobj_t *sonic, mobj_t *tails, ticcmd_t *cm
 	angle_t angle;
 	INT16 rangle;
 	fixed_t dist;
+	botmemory_t *memory = &botmemory[tails->player - players];
 
 	// We can't follow Sonic if he's not around!
 	if (!sonic || sonic->health <= 0)
@@ -84,10 +98,10 @@ static inline void B_BuildTailsTiccmd(mobj_t *sonic, mobj_t *tails, ticcmd_t *cm
 
 	// Decide when to jump
 	if (!(tails->player->pflags & (PF_JUMPED|PF_JUMPDOWN))) { // We're not jumping yet...
-		if (forward && lastForward && blocked && lastBlocked) // We've been stopped by a wall or something
+		if (forward && memory->lastForward && memory->blocked && memory->lastBlocked) // We've been stopped by a wall or something
 			jump = true; // Try to jump up
 	} else if ((tails->player->pflags & (PF_JUMPDOWN|PF_JUMPED)) == (PF_JUMPDOWN|PF_JUMPED)) { // When we're already jumping...
-		if (lastForward && blocked) // We're still stuck on something?
+		if (memory->lastForward && memory->blocked) // We're still stuck on something?
 			jump = true;
 		if (sonic->floorz > tails->floorz) // He's still above us? Jump HIGHER, then!
 			jump = true;
@@ -102,9 +116,9 @@ static inline void B_BuildTailsTiccmd(mobj_t *sonic, mobj_t *tails, ticcmd_t *cm
 	B_KeysToTiccmd(tails, cmd, forward, backward, left, right, false, false, jump, spin);
 
 	// Update our status
-	lastForward = forward;
-	lastBlocked = blocked;
-	blocked = false;
+	memory->lastForward = forward;
+	memory->lastBlocked = memory->blocked;
+	memory->blocked = false;
 }
 
 void B_BuildTiccmd(player_t *player, ticcmd_t *cmd)
@@ -196,8 +210,7 @@ void B_KeysToTiccmd(mobj_t *mo, ticcmd_t *cmd, boolean forward, boolean backward
 
 void B_MoveBlocked(player_t *player)
 {
-	(void)player;
-	blocked = true;
+	botmemory[player - players].blocked = true;
 }
 
 boolean B_CheckRespawn(player_t *player)
@@ -281,3 +294,154 @@ void B_RespawnBot(INT32 playernum)
 	P_SetScale(tails, sonic->scale);
 	tails->destscale = sonic->destscale;
 }
+
+boolean B_IsNetBot(INT32 playernum)
+{
+	return netbot[playernum];
+}
+
+INT32 B_NumNetBots(void)
+{
+	return numnetbots;
+}
+
+void B_AddNetBot(INT32 playernum)
+{
+	if (netbot[playernum])
+		return;
+	netbot[playernum] = true;
+	numnetbots++;
+	memset(&botmemory[playernum], 0, sizeof (botmemory[playernum]));
+	netbotjointic[playernum] = 0;
+}
+
+void B_RemoveNetBot(INT32 playernum)
+{
+	if (!netbot[playernum])
+		return;
+	netbot[playernum] = false;
+	numnetbots--;
+}
+
+void B_ResetNetBots(void)
+{
+	memset(netbot, 0, sizeof (netbot));
+	numnetbots = 0;
+}
+
+//
+// B_JoinGame
+//
+// Bots spawn as spectators in gametypes that have them, so ask the
+// game to put them in, on the smaller team if there are teams.
+//
+static void B_JoinGame(INT32 playernum)
+{
+	changeteam_union NetPacket;
+	UINT16 usvalue;
+	INT32 i, red = 0, blue = 0;
+
+	if (!G_GametypeHasSpectators() || gametic < netbotjointic[playernum])
+		return;
+	netbotjointic[playernum] = gametic + TICRATE; // give the last one time to go through
+
+	NetPacket.value.l = NetPacket.value.b = 0;
+	NetPacket.packet.playernum = playernum;
+	NetPacket.packet.verification = true;
+	if (G_GametypeHasTeams())
+	{
+		for (i = 0; i < MAXPLAYERS; i++)
+			if (playeringame[i] && !players[i].spectator)
+			{
+				if (players[i].ctfteam == 1)
+					red++;
+				else if (players[i].ctfteam == 2)
+					blue++;
+			}
+		NetPacket.packet.newteam = (red > blue) ? 2 : 1;
+	}
+	else
+		NetPacket.packet.newteam = 3;
+
+	usvalue = SHORT(NetPacket.value.l|NetPacket.value.b);
+	SendNetXCmd(XD_TEAMCHANGE, &usvalue, sizeof(usvalue));
+}
+
+//
+// B_BuildNetBotTiccmds
+//
+// Builds the ticcmd of every bot the server added, all in one pass.
+// The players they can follow are gathered once for all of them, and
+// each bot follows the nearest player who isn't a bot, or the nearest
+// other bot if there's nobody else.
+//
+void B_BuildNetBotTiccmds(ticcmd_t *cmds)
+{
+	mobj_t *leaders[MAXPLAYERS];
+	INT32 numleaders = 0, numhumans, i, j;
+
+	if (!numnetbots)
+		return;
+
+	// People first, then bots
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i] && !netbot[i] && !players[i].spectator
+		&& players[i].mo && players[i].mo->health > 0)
+			leaders[numleaders++] = players[i].mo;
+	numhumans = numleaders;
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i] && netbot[i] && !players[i].spectator
+		&& players[i].mo && players[i].mo->health > 0)
+			leaders[numleaders++] = players[i].mo;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		player_t *player = &players[i];
+		ticcmd_t *cmd = &cmds[i];
+		mobj_t *mo = player->mo;
+		mobj_t *leader = NULL;
+		fixed_t dist, leaderdist = INT32_MAX;
+
+		if (!netbot[i] || !playeringame[i])
+			continue;
+
+		memset(cmd, 0, sizeof (*cmd));
+
+		if (player->spectator)
+			B_JoinGame(i);
+		else if (!mo)
+			;
+		else if (player->playerstate == PST_DEAD)
+		{
+			if (player->deadtimer > TICRATE)
+				cmd->buttons |= BT_JUMP;
+		}
+#ifdef HAVE_BLUA
+		else if (LUAh_BotTiccmd(player, cmd))
+			;
+#endif
+		else
+		{
+			for (j = 0; j < numleaders; j++)
+			{
+				if (j == numhumans && leader)
+					break;
+				if (leaders[j] == mo)
+					continue;
+				dist = P_AproxDistance(leaders[j]->x - mo->x, leaders[j]->y - mo->y);
+				if (dist < leaderdist)
+				{
+					leader = leaders[j];
+					leaderdist = dist;
+				}
+			}
+			if (leader)
+				B_BuildTailsTiccmd(leader, mo, cmd);
+		}
+
+		// Bot turning is relative, like G_BuildTiccmd2 expects
+		if (mo)
+			cmd->angleturn = (INT16)((mo->angle >> 16) + cmd->angleturn);
+		cmd->angleturn |= TICCMD_RECEIVED;
+	}
+}
@@ -15,3 +15,11 @@ void B_KeysToTiccmd(mobj_t *mo, ticcmd_t *cmd, boolean forward, boolean backward
 boolean B_CheckRespawn(player_t *player);
 void B_MoveBlocked(player_t *player);
 void B_RespawnBot(INT32 playernum);
+
+// Bots the server adds to netgames, see B_BuildNetBotTiccmds
+boolean B_IsNetBot(INT32 playernum);
+INT32 B_NumNetBots(void);
+void B_AddNetBot(INT32 playernum);
+void B_RemoveNetBot(INT32 playernum);
+void B_ResetNetBots(void);
+void B_BuildNetBotTiccmds(ticcmd_t *cmds);
@@ -0,0 +1,702 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  bench/srb2bench.c
+/// \brief Micro-benchmarks of the engine's hot functions
+///
+///        Each benchmark calls one function over synthetic data, in
+///        batches that double until a batch takes long enough to time
+///        with clock(), and reports the time a call took. Only what the
+///        functions look at is set up: nothing is loaded, and the game
+///        itself never starts. Give names, or parts of them, to run only
+///        those benchmarks.
+
+#include <time.h>
+
+#include "../doomdef.h"
+#include "../m_fixed.h"
+#include "../tables.h"
+#include "../p_local.h"
+#include "../r_main.h"
+#include "../r_bsp.h"
+#include "../r_draw.h"
+#include "../r_state.h"
+#include "../screen.h"
+#include "../v_video.h"
+#include "../z_zone.h"
+#include "../lzf.h"
+#include "../md5.h"
+#ifdef HAVE_BLUA
+#include "../blua/lua.h"
+#include "../blua/lauxlib.h"
+#endif
+
+// A batch has to take at least this long to count
+#define MINBATCHTIME (CLOCKS_PER_SEC/4)
+
+#define NUMPOINTS 4096 // a power of 2
+#define NUMLINES 64
+#define BENCHWIDTH 640
+#define BENCHHEIGHT 400
+#define TEXHEIGHT 128
+#define BUFFERSIZE 65536 // for lzf and md5
+#define NUMFOFS 8
+
+typedef struct
+{
+	const char *name;
+	void (*run)(UINT32 n); // calls the function n times
+} benchmark_t;
+
+// Everything computed goes here, so none of it can be optimized away
+static volatile UINT32 sink;
+
+static fixed_t points[NUMPOINTS][2];
+static vertex_t vertexes_[NUMLINES*2];
+static line_t lines_[NUMLINES];
+static fixed_t boxes[NUMPOINTS][4];
+
+static UINT8 *screen;
+static UINT8 texture[TEXHEIGHT];
+static UINT8 flat[64*64];
+static UINT8 bigflat[1024*1024], bigtiled[1024*1024];
+static lighttable_t colormap[256];
+static UINT8 *transmap;
+
+static UINT8 *plain, *packed, *unpacked;
+static size_t packedlen;
+
+static sector_t fofsectors[NUMFOFS+1]; // the FOFs' control sectors, then the one they're in
+static ffloor_t ffloors_[NUMFOFS];
+
+static UINT32 randomseed = 0x5EED1234;
+
+#ifdef HAVE_BLUA
+// A bare Lua state, without the game's libraries, for timing the VM
+static lua_State *benchL;
+
+// Each function goes round its loop n times. U is a userdata whose
+// __index is a C function, the way mobj_t and the rest are.
+static const char benchscript[] =
+	"function arith(n) local a, b = 0, 3 for i = 1, n do a = a + b - (i & 7) end return a end\n"
+	"function compare(n) local c = 0 for i = 1, n do if i < 1000 then c = c + 1 end if i == 5 then c = c - 1 end end return c end\n"
+	"local t = {x = 1, y = 2}\n"
+	"function fields(n) local s = 0 for i = 1, n do s = s + t.x + t.y end return s end\n"
+	"function userdata(n) local u, s = U, 0 for i = 1, n do s = s + u.x + u.y end return s end\n"
+	"local function f(a) return a + 1 end\n"
+	"function calls(n) local s = 0 for i = 1, n do s = f(s) end return s end\n";
+#endif
+
+static UINT32 Bench_Random(void)
+{
+	// xorshift32
+	randomseed ^= randomseed << 13;
+	randomseed ^= randomseed >> 17;
+	randomseed ^= randomseed << 5;
+	return randomseed;
+}
+
+// A coordinate anywhere in a big map
+static fixed_t Bench_RandomCoord(void)
+{
+	return (fixed_t)(Bench_Random() % (32768u<<FRACBITS)) - (16384<<FRACBITS);
+}
+
+//
+// Bench_Setup
+//
+// Makes up the data the benchmarks work on.
+//
+static void Bench_Setup(void)
+{
+	size_t i;
+
+	for (i = 0; i < NUMPOINTS; i++)
+	{
+		points[i][0] = Bench_RandomCoord();
+		points[i][1] = Bench_RandomCoord();
+
+		boxes[i][BOXLEFT] = points[i][0];
+		boxes[i][BOXRIGHT] = points[i][0] + (fixed_t)(Bench_Random() % (256<<FRACBITS));
+		boxes[i][BOXBOTTOM] = points[i][1];
+		boxes[i][BOXTOP] = points[i][1] + (fixed_t)(Bench_Random() % (256<<FRACBITS));
+	}
+
+	// Lines of every slope type, the way P_LoadLineDefs sets them up
+	for (i = 0; i < NUMLINES; i++)
+	{
+		line_t *ld = &lines_[i];
+
+		ld->v1 = &vertexes_[i*2];
+		ld->v2 = &vertexes_[i*2 + 1];
+		ld->v1->x = Bench_RandomCoord();
+		ld->v1->y = Bench_RandomCoord();
+		ld->v2->x = (i & 3) == 1 ? ld->v1->x : Bench_RandomCoord();
+		ld->v2->y = (i & 3) == 0 ? ld->v1->y : Bench_RandomCoord();
+		ld->dx = ld->v2->x - ld->v1->x;
+		ld->dy = ld->v2->y - ld->v1->y;
+
+		if (!ld->dx)
+			ld->slopetype = ST_VERTICAL;
+		else if (!ld->dy)
+			ld->slopetype = ST_HORIZONTAL;
+		else if (FixedDiv(ld->dy, ld->dx) > 0)
+			ld->slopetype = ST_POSITIVE;
+		else
+			ld->slopetype = ST_NEGATIVE;
+	}
+
+	// A screen for the drawers, as R_InitViewBuffer would set it up
+	vid.width = vid.rowbytes = BENCHWIDTH;
+	vid.height = BENCHHEIGHT;
+	vid.bpp = 1;
+	screen = malloc(BENCHWIDTH*BENCHHEIGHT);
+	transmap = malloc(256*256);
+	plain = malloc(BUFFERSIZE);
+	packed = malloc(BUFFERSIZE);
+	unpacked = malloc(BUFFERSIZE);
+	if (!screen || !transmap || !plain || !packed || !unpacked)
+		I_Error("Bench_Setup: out of memory");
+
+	memset(screen, 0, BENCHWIDTH*BENCHHEIGHT);
+	screens[0] = topleft = screen;
+	for (i = 0; i < BENCHHEIGHT; i++)
+		ylookup[i] = screen + i*BENCHWIDTH;
+	for (i = 0; i < BENCHWIDTH; i++)
+		columnofs[i] = (INT32)i;
+	centery = BENCHHEIGHT/2;
+	centeryfrac = centery<<FRACBITS;
+
+	for (i = 0; i < TEXHEIGHT; i++)
+		texture[i] = (UINT8)Bench_Random();
+	for (i = 0; i < sizeof flat; i++)
+		flat[i] = (UINT8)Bench_Random();
+	for (i = 0; i < sizeof bigflat; i++)
+		bigflat[i] = (UINT8)Bench_Random();
+	R_TileFlat(bigtiled, bigflat, 10);
+	for (i = 0; i < 256; i++)
+		colormap[i] = (lighttable_t)(255 - i);
+	for (i = 0; i < 256*256; i++)
+		transmap[i] = (UINT8)Bench_Random();
+
+	// Runs of repeats and noise, so it packs about as well as a savegame
+	for (i = 0; i < BUFFERSIZE;)
+	{
+		size_t run = 1 + Bench_Random() % 32;
+		UINT8 c = (UINT8)Bench_Random();
+		const boolean repeat = Bench_Random() & 1;
+
+		for (; run && i < BUFFERSIZE; run--, i++)
+			plain[i] = repeat ? c : (UINT8)Bench_Random();
+	}
+	packedlen = lzf_compress(plain, BUFFERSIZE, packed, BUFFERSIZE - 1);
+	if (!packedlen)
+		I_Error("Bench_Setup: the test data doesn't pack");
+
+	// A stack of FOFs in one sector, every other one double shadowed
+	sectors = fofsectors;
+	numsectors = NUMFOFS+1;
+	for (i = 0; i < NUMFOFS; i++)
+	{
+		sector_t *control = &fofsectors[i];
+		ffloor_t *rover = &ffloors_[i];
+
+		control->floorheight = (fixed_t)(i*128)<<FRACBITS;
+		control->ceilingheight = control->floorheight + (64<<FRACBITS);
+		control->lightlevel = (INT16)(i*16);
+		control->midmap = -1;
+
+		rover->topheight = &control->ceilingheight;
+		rover->bottomheight = &control->floorheight;
+		rover->toplightlevel = &control->lightlevel;
+#ifdef ESLOPE
+		rover->t_slope = &control->c_slope;
+		rover->b_slope = &control->f_slope;
+#endif
+		rover->secnum = i;
+		rover->flags = FF_EXISTS|FF_SOLID|FF_RENDERALL|FF_CUTLEVEL|((i & 1) ? FF_DOUBLESHADOW : 0);
+		rover->next = (i + 1 < NUMFOFS) ? &ffloors_[i+1] : NULL;
+	}
+	fofsectors[NUMFOFS].ceilingheight = (fixed_t)(NUMFOFS*128)<<FRACBITS;
+	fofsectors[NUMFOFS].ffloors = ffloors_;
+
+	// FixedMul4 and FixedMul4By are only any use if they match FixedMul to the bit
+	for (i = 0; i < NUMPOINTS; i++)
+	{
+		fixed_t a[4], b[4], r[4];
+		size_t j;
+
+		for (j = 0; j < 4; j++)
+		{
+			a[j] = (fixed_t)Bench_Random();
+			b[j] = (i & 1) ? (fixed_t)Bench_Random() : points[(i + j) & (NUMPOINTS-1)][j & 1];
+		}
+		if (i < 4)
+			a[i] = i & 1 ? INT32_MIN : INT32_MAX;
+		FixedMul4(r, a, b);
+		for (j = 0; j < 4; j++)
+		{
+			if (r[j] != FixedMul(a[j], b[j]))
+				I_Error("Bench_Setup: FixedMul4(%d, %d) is %d, not %d", a[j], b[j], r[j], FixedMul(a[j], b[j]));
+		}
+		FixedMul4By(r, a, b[i & 3]);
+		for (j = 0; j < 4; j++)
+		{
+			if (r[j] != FixedMul(a[j], b[i & 3]))
+				I_Error("Bench_Setup: FixedMul4By(%d, %d) is %d, not %d", a[j], b[i & 3], r[j], FixedMul(a[j], b[i & 3]));
+		}
+	}
+}
+
+#ifdef HAVE_BLUA
+static int Bench_LuaIndex(lua_State *L)
+{
+	lua_pushinteger(L, *luaL_checkstring(L, 2));
+	return 1;
+}
+
+static void Bench_SetupLua(void)
+{
+	benchL = luaL_newstate();
+	if (!benchL)
+		I_Error("Bench_SetupLua: no Lua state");
+
+	lua_newuserdata(benchL, 1);
+	lua_newtable(benchL);
+	lua_pushcfunction(benchL, Bench_LuaIndex);
+	lua_setfield(benchL, -2, "__index");
+	lua_setmetatable(benchL, -2);
+	lua_setglobal(benchL, "U");
+
+	if (luaL_loadbuffer(benchL, benchscript, sizeof (benchscript) - 1, "srb2bench")
+		|| lua_pcall(benchL, 0, 0, 0))
+		I_Error("Bench_SetupLua: %s", lua_tostring(benchL, -1));
+}
+#endif
+
+// ==========================================================================
+//                               BENCHMARKS
+// ==========================================================================
+
+static void Bench_FixedMul(UINT32 n)
+{
+	fixed_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += FixedMul(points[i & (NUMPOINTS-1)][0], points[(i + 1) & (NUMPOINTS-1)][1]);
+	sink = (UINT32)r;
+}
+
+static void Bench_FixedDiv(UINT32 n)
+{
+	fixed_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += FixedDiv(points[i & (NUMPOINTS-1)][0], points[(i + 1) & (NUMPOINTS-1)][1] | 1);
+	sink = (UINT32)r;
+}
+
+static void Bench_FixedMul4(UINT32 n)
+{
+	fixed_t r[4], total = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+	{
+		FixedMul4(r, points[i & (NUMPOINTS-1)], points[(i + 2) & (NUMPOINTS-1)]);
+		total += r[0] + r[1] + r[2] + r[3];
+	}
+	sink = (UINT32)total;
+}
+
+static void Bench_Rotate(UINT32 n)
+{
+	vector3_t v, axis;
+	UINT32 r = 0, i;
+
+	for (i = 0; i < n; i++)
+	{
+		const fixed_t *p = points[i & (NUMPOINTS-1)];
+
+		// Momentum around a slope's axis, the way P_QuantizeMomentumToSlope does it
+		v.x = p[0] >> 8;
+		v.y = p[1] >> 8;
+		v.z = (p[0] ^ p[1]) >> 10;
+		axis.x = p[1] & FRACMASK;
+		axis.y = -(p[0] & FRACMASK);
+		axis.z = 0;
+		FV3_Rotate(&v, &axis, i & FINEMASK);
+		r += (UINT32)(v.x + v.y + v.z);
+	}
+	sink = r;
+}
+
+static void Bench_PointToAngle(UINT32 n)
+{
+	angle_t r = 0;
+	UINT32 i;
+
+	viewx = viewy = 0;
+	for (i = 0; i < n; i++)
+		r += R_PointToAngle(points[i & (NUMPOINTS-1)][0], points[i & (NUMPOINTS-1)][1]);
+	sink = r;
+}
+
+static void Bench_PointToDist2(UINT32 n)
+{
+	fixed_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+	{
+		const fixed_t *a = points[i & (NUMPOINTS-1)], *b = points[(i + 1) & (NUMPOINTS-1)];
+		r += R_PointToDist2(a[0], a[1], b[0], b[1]);
+	}
+	sink = (UINT32)r;
+}
+
+static void Bench_AproxDistance(UINT32 n)
+{
+	fixed_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += P_AproxDistance(points[i & (NUMPOINTS-1)][0], points[i & (NUMPOINTS-1)][1]);
+	sink = (UINT32)r;
+}
+
+static void Bench_BoxOnLineSide(UINT32 n)
+{
+	INT32 r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += P_BoxOnLineSide(boxes[i & (NUMPOINTS-1)], &lines_[i & (NUMLINES-1)]);
+	sink = (UINT32)r;
+}
+
+// One full height column, like a wall seen up close
+static void Bench_SetupColumn(void)
+{
+	dc_yl = 0;
+	dc_yh = BENCHHEIGHT - 1;
+	dc_iscale = FRACUNIT/2;
+	dc_texturemid = 0;
+	dc_texheight = TEXHEIGHT;
+	dc_hires = 0;
+	dc_source = texture;
+	dc_colormap = colormap;
+	dc_transmap = transmap;
+}
+
+static void Bench_DrawColumn(UINT32 n)
+{
+	UINT32 i;
+
+	Bench_SetupColumn();
+	for (i = 0; i < n; i++)
+	{
+		dc_x = (INT32)(i % BENCHWIDTH);
+		R_DrawColumn_8();
+	}
+	sink = screen[0];
+}
+
+// Four of those side by side, each a little further away
+static void Bench_DrawWallColumns4(UINT32 n)
+{
+	wallcolumn_t cols[4];
+	UINT32 i;
+
+	for (i = 0; i < 4; i++)
+	{
+		cols[i].source = texture;
+		cols[i].colormap = colormap;
+		cols[i].iscale = FRACUNIT/2 + (fixed_t)i*64;
+		cols[i].texturemid = 0;
+		cols[i].yl = (INT32)i;
+		cols[i].yh = BENCHHEIGHT - 1 - (INT32)i;
+		cols[i].texheight = TEXHEIGHT;
+	}
+	for (i = 0; i < n; i++)
+		R_DrawWallColumns4_8((INT32)((i*4) % BENCHWIDTH), cols);
+	sink = screen[0];
+}
+
+static void Bench_DrawTranslucentColumn(UINT32 n)
+{
+	UINT32 i;
+
+	Bench_SetupColumn();
+	for (i = 0; i < n; i++)
+	{
+		dc_x = (INT32)(i % BENCHWIDTH);
+		R_DrawTranslucentColumn_8();
+	}
+	sink = screen[0];
+}
+
+// One full width span of a 64x64 flat, like R_MapPlane draws
+static void Bench_DrawSpan(UINT32 n)
+{
+	UINT32 i;
+
+	ds_x1 = 0;
+	ds_x2 = BENCHWIDTH - 1;
+	ds_source = flat;
+	ds_colormap = colormap;
+	ds_xstep = FRACUNIT/3;
+	ds_ystep = FRACUNIT/5;
+	nflatmask = 0xFC0;
+	nflatxshift = 26;
+	nflatyshift = 20;
+	nflatshiftup = 10;
+
+	for (i = 0; i < n; i++)
+	{
+		ds_y = (INT32)(i % BENCHHEIGHT);
+		ds_xfrac = (fixed_t)(i << 12);
+		ds_yfrac = (fixed_t)(i << 11);
+		R_DrawSpan_8();
+	}
+	sink = screen[0];
+}
+
+// A floor of a 1024x1024 flat seen at an angle, one row per call
+static void Bench_DrawBigSpan(UINT32 n, UINT8 *source, void (*drawer)(void))
+{
+	UINT32 i;
+
+	ds_x1 = 0;
+	ds_x2 = BENCHWIDTH - 1;
+	ds_source = source;
+	ds_colormap = colormap;
+	nflatmask = 0xFFC00;
+	nflatxshift = 22;
+	nflatyshift = 12;
+	nflatshiftup = 6;
+
+	for (i = 0; i < n; i++)
+	{
+		const fixed_t scale = FRACUNIT/2 + (fixed_t)(i % BENCHHEIGHT)*(FRACUNIT/256);
+
+		ds_y = (INT32)(i % BENCHHEIGHT);
+		ds_xstep = FixedMul(scale, 56756); // cos 30
+		ds_ystep = FixedMul(scale, 32768); // sin 30
+		ds_xfrac = -(fixed_t)(i % BENCHHEIGHT)*(FRACUNIT/2);
+		ds_yfrac = (fixed_t)(i % BENCHHEIGHT)*56756;
+		drawer();
+	}
+	sink = screen[0];
+}
+
+static void Bench_DrawBigSpanLinear(UINT32 n)
+{
+	Bench_DrawBigSpan(n, bigflat, R_DrawSpan_8);
+}
+
+static void Bench_DrawBigSpanTiled(UINT32 n)
+{
+	Bench_DrawBigSpan(n, bigtiled, R_DrawTiledSpan_8);
+}
+
+static void Bench_LZFCompress(UINT32 n)
+{
+	size_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += lzf_compress(plain, BUFFERSIZE, packed, BUFFERSIZE - 1);
+	sink = (UINT32)r;
+}
+
+static void Bench_LZFDecompress(UINT32 n)
+{
+	size_t r = 0;
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+		r += lzf_decompress(packed, packedlen, unpacked, BUFFERSIZE);
+	sink = (UINT32)r;
+}
+
+static void Bench_MD5(UINT32 n)
+{
+	UINT8 digest[16];
+	UINT32 i, r = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		md5_buffer((const char *)plain, BUFFERSIZE, digest);
+		r += digest[0];
+	}
+	sink = r;
+}
+
+static void Bench_ZMallocFree(UINT32 n)
+{
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+	{
+		// Sizes from a small thinker to a big lump, every other one tagged
+		void *p = Z_Malloc(16 + (i*37 & 4095), (i & 1) ? PU_LEVEL : PU_STATIC, NULL);
+		Z_Free(p);
+	}
+	sink = i;
+}
+
+// As R_Subsector does for a sector that's moved
+static void Bench_Prep3DFloors(UINT32 n)
+{
+	sector_t *sector = &fofsectors[NUMFOFS];
+	UINT32 i;
+
+	for (i = 0; i < n; i++)
+	{
+		sector->numlights = 0;
+		R_Prep3DFloors(sector);
+	}
+	sink = (UINT32)sector->numlights;
+}
+
+#ifdef HAVE_BLUA
+// Runs a function of benchscript, n times round its loop.
+static void Bench_RunLua(const char *func, UINT32 n)
+{
+	lua_getglobal(benchL, func);
+	lua_pushinteger(benchL, (lua_Integer)n);
+	if (lua_pcall(benchL, 1, 1, 0))
+		I_Error("Bench_RunLua: %s", lua_tostring(benchL, -1));
+	sink = (UINT32)lua_tointeger(benchL, -1);
+	lua_pop(benchL, 1);
+}
+
+static void Bench_LuaArith(UINT32 n)
+{
+	Bench_RunLua("arith", n);
+}
+
+static void Bench_LuaCompare(UINT32 n)
+{
+	Bench_RunLua("compare", n);
+}
+
+static void Bench_LuaFields(UINT32 n)
+{
+	Bench_RunLua("fields", n);
+}
+
+static void Bench_LuaUserdata(UINT32 n)
+{
+	Bench_RunLua("userdata", n);
+}
+
+static void Bench_LuaCalls(UINT32 n)
+{
+	Bench_RunLua("calls", n);
+}
+#endif
+
+static const benchmark_t benchmarks[] = {
+	{"FixedMul", Bench_FixedMul},
+	{"FixedDiv", Bench_FixedDiv},
+	{"FixedMul4", Bench_FixedMul4},
+	{"FV3_Rotate", Bench_Rotate},
+	{"R_PointToAngle", Bench_PointToAngle},
+	{"R_PointToDist2", Bench_PointToDist2},
+	{"P_AproxDistance", Bench_AproxDistance},
+	{"P_BoxOnLineSide", Bench_BoxOnLineSide},
+	{"R_DrawColumn_8 (400px)", Bench_DrawColumn},
+	{"R_DrawWallColumns4_8 (4x400px)", Bench_DrawWallColumns4},
+	{"R_DrawTranslucentColumn_8 (400px)", Bench_DrawTranslucentColumn},
+	{"R_DrawSpan_8 (640px)", Bench_DrawSpan},
+	{"R_DrawSpan_8 (640px, 1024 flat)", Bench_DrawBigSpanLinear},
+	{"R_DrawTiledSpan_8 (640px, 1024 flat)", Bench_DrawBigSpanTiled},
+	{"lzf_compress (64K)", Bench_LZFCompress},
+	{"lzf_decompress (64K)", Bench_LZFDecompress},
+	{"md5_buffer (64K)", Bench_MD5},
+	{"Z_Malloc+Z_Free", Bench_ZMallocFree},
+	{"R_Prep3DFloors (8 FOFs)", Bench_Prep3DFloors},
+#ifdef HAVE_BLUA
+	{"Lua arithmetic (per loop)", Bench_LuaArith},
+	{"Lua comparisons (per loop)", Bench_LuaCompare},
+	{"Lua table fields (per loop)", Bench_LuaFields},
+	{"Lua userdata fields (per loop)", Bench_LuaUserdata},
+	{"Lua function calls (per loop)", Bench_LuaCalls},
+#endif
+	{NULL, NULL}
+};
+
+//
+// Bench_Time
+//
+// Runs a benchmark in ever bigger batches, returning nanoseconds per call.
+//
+static double Bench_Time(const benchmark_t *b, UINT32 *calls)
+{
+	UINT32 n = 1;
+	clock_t start, elapsed;
+
+	for (;;)
+	{
+		start = clock();
+		b->run(n);
+		elapsed = clock() - start;
+
+		if (elapsed >= MINBATCHTIME || n >= 0x40000000)
+			break;
+		n *= 2;
+	}
+
+	*calls = n;
+	return (double)elapsed * 1000000000.0 / (double)CLOCKS_PER_SEC / (double)n;
+}
+
+static boolean Bench_Wanted(const char *name, int argc, char **argv)
+{
+	int i;
+
+	if (argc < 2)
+		return true;
+	for (i = 1; i < argc; i++)
+	{
+		if (strstr(name, argv[i]))
+			return true;
+	}
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	const benchmark_t *b;
+	UINT32 calls;
+	double ns;
+
+	Z_Init();
+	Bench_Setup();
+#ifdef HAVE_BLUA
+	Bench_SetupLua();
+#endif
+
+	printf("srb2bench %s\n", VERSIONSTRING);
+	printf("%-36s %12s %12s\n", "benchmark", "calls", "ns/call");
+
+	for (b = benchmarks; b->name; b++)
+	{
+		if (!Bench_Wanted(b->name, argc, argv))
+			continue;
+		ns = Bench_Time(b, &calls);
+		printf("%-36s %12u %12.2f\n", b->name, calls, ns);
+		fflush(stdout);
+	}
+
+	return 0;
+}
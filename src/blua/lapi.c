@@ -861,6 +861,20 @@ LUA_API int lua_load (lua_State *L, lua_Reader reader, void *data,
 }
 
 
+/* SRB2: load a precompiled chunk, for the game's own bytecode cache */
+LUA_API int lua_undump (lua_State *L, lua_Reader reader, void *data,
+                        const char *chunkname) {
+  ZIO z;
+  int status;
+  lua_lock(L);
+  if (!chunkname) chunkname = "?";
+  luaZ_init(L, &z, reader, data);
+  status = luaD_protectedundump(L, &z, chunkname);
+  lua_unlock(L);
+  return status;
+}
+
+
 #ifndef LUA_STRIPPING
 #define LUA_STRIPPING 0
 #endif
@@ -81,6 +81,12 @@ LUA_API int lua_gethookcount (lua_State *L) {
 }
 
 
+/* SRB2: instructions left until the next count hook */
+LUA_API int lua_gethookcountleft (lua_State *L) {
+  return L->hookcount;
+}
+
+
 LUA_API int lua_getstack (lua_State *L, int level, lua_Debug *ar) {
   int status;
   CallInfo *ci;
@@ -56,6 +56,7 @@ static boolean CV_Command(void);
 static consvar_t *CV_FindVar(const char *name);
 static const char *CV_StringValue(const char *var_name);
 static consvar_t *consvar_vars; // list of registered console variables
+UINT32 cv_netvarchanges = 0;
 
 static char com_token[1024];
 static char *COM_Parse(char *data);
@@ -261,11 +262,67 @@ typedef struct xcommand_s
 {
 	const char *name;
 	struct xcommand_s *next;
+	struct xcommand_s *hashnext; // next with the same name hash
 	com_func_t function;
 } xcommand_t;
 
 static xcommand_t *com_commands = NULL; // current commands
 
+// Commands and variables are looked up by name through these,
+// and net variables by netid, instead of going through the lists
+#define COM_HASHSIZE 1024
+static xcommand_t *com_hash[COM_HASHSIZE];
+static consvar_t *cv_hash[COM_HASHSIZE];
+static consvar_t *cv_netvars[0x10000];
+
+/** Hashes a command or variable name, ignoring case.
+  *
+  * \param name The name.
+  * \return Which bucket of com_hash or cv_hash it goes in.
+  */
+static size_t COM_HashName(const char *name)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	while (*name)
+	{
+		hash ^= (UINT8)tolower((UINT8)*name++);
+		hash *= 16777619u;
+	}
+	return hash & (COM_HASHSIZE-1);
+}
+
+/** Finds a command by name.
+  *
+  * \param name The command's name, in any case.
+  * \return The command, or NULL if there isn't one.
+  */
+static xcommand_t *COM_FindCommand(const char *name)
+{
+	xcommand_t *cmd;
+
+	for (cmd = com_hash[COM_HashName(name)]; cmd; cmd = cmd->hashnext)
+		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
+			return cmd;
+
+	return NULL;
+}
+
+/** Adds a new command to the list and the hash.
+  */
+static void COM_LinkCommand(const char *name, com_func_t func)
+{
+	xcommand_t *cmd = ZZ_Alloc(sizeof *cmd);
+	const size_t hash = COM_HashName(name);
+
+	cmd->name = name;
+	cmd->function = func;
+	cmd->next = com_commands;
+	com_commands = cmd;
+	cmd->hashnext = com_hash[hash];
+	com_hash[hash] = cmd;
+}
+
 #define MAX_ARGS 80
 static size_t com_argc;
 static char *com_argv[MAX_ARGS];
@@ -399,28 +456,21 @@ void COM_AddCommand(const char *name, com_func_t func)
 	}
 
 	// fail if the command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	if ((cmd = COM_FindCommand(name)) != NULL)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
 #ifdef HAVE_BLUA
-			// don't I_Error for Lua commands
-			// Lua commands can replace game commands, and they have priority.
-			// BUT, if for some reason we screwed up and made two console commands with the same name,
-			// it's good to have this here so we find out.
-			if (cmd->function != COM_Lua_f)
+		// don't I_Error for Lua commands
+		// Lua commands can replace game commands, and they have priority.
+		// BUT, if for some reason we screwed up and made two console commands with the same name,
+		// it's good to have this here so we find out.
+		if (cmd->function != COM_Lua_f)
 #endif
-				I_Error("Command %s already exists\n", name);
+			I_Error("Command %s already exists\n", name);
 
-			return;
-		}
+		return;
 	}
 
-	cmd = ZZ_Alloc(sizeof *cmd);
-	cmd->name = name;
-	cmd->function = func;
-	cmd->next = com_commands;
-	com_commands = cmd;
+	COM_LinkCommand(name, func);
 }
 
 #ifdef HAVE_BLUA
@@ -438,22 +488,15 @@ int COM_AddLuaCommand(const char *name)
 		return -1;
 
 	// command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	if ((cmd = COM_FindCommand(name)) != NULL)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			// replace the built in command.
-			cmd->function = COM_Lua_f;
-			return 1;
-		}
+		// replace the built in command.
+		cmd->function = COM_Lua_f;
+		return 1;
 	}
 
 	// Add a new command.
-	cmd = ZZ_Alloc(sizeof *cmd);
-	cmd->name = name;
-	cmd->function = COM_Lua_f;
-	cmd->next = com_commands;
-	com_commands = cmd;
+	COM_LinkCommand(name, COM_Lua_f);
 	return 0;
 }
 #endif
@@ -465,13 +508,7 @@ int COM_AddLuaCommand(const char *name)
   */
 static boolean COM_Exists(const char *com_name)
 {
-	xcommand_t *cmd;
-
-	for (cmd = com_commands; cmd; cmd = cmd->next)
-		if (!stricmp(com_name, cmd->name))
-			return true;
-
-	return false;
+	return (COM_FindCommand(com_name) != NULL);
 }
 
 /** Does command completion for the console.
@@ -518,13 +555,10 @@ static void COM_ExecuteString(char *ptext)
 		return; // no tokens
 
 	// check functions
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	if ((cmd = COM_FindCommand(com_argv[0])) != NULL)
 	{
-		if (!stricmp(com_argv[0], cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			cmd->function();
-			return;
-		}
+		cmd->function();
+		return;
 	}
 
 	// check aliases
@@ -939,7 +973,7 @@ static consvar_t *CV_FindVar(const char *name)
 {
 	consvar_t *cvar;
 
-	for (cvar = consvar_vars; cvar; cvar = cvar->next)
+	for (cvar = cv_hash[COM_HashName(name)]; cvar; cvar = cvar->hashnext)
 		if (!stricmp(name,cvar->name))
 			return cvar;
 
@@ -975,13 +1009,7 @@ static inline UINT16 CV_ComputeNetid(const char *s)
   */
 static consvar_t *CV_FindNetVar(UINT16 netid)
 {
-	consvar_t *cvar;
-
-	for (cvar = consvar_vars; cvar; cvar = cvar->next)
-		if (cvar->netid == netid)
-			return cvar;
-
-	return NULL;
+	return cv_netvars[netid];
 }
 
 static void Setvalue(consvar_t *var, const char *valstr, boolean stealth);
@@ -1019,8 +1047,14 @@ void CV_RegisterVar(consvar_t *variable)
 	// link the variable in
 	if (!(variable->flags & CV_HIDEN))
 	{
+		const size_t hash = COM_HashName(variable->name);
+
 		variable->next = consvar_vars;
 		consvar_vars = variable;
+		variable->hashnext = cv_hash[hash];
+		cv_hash[hash] = variable;
+		if (variable->flags & CV_NETVAR)
+			cv_netvars[variable->netid] = variable;
 	}
 	variable->string = variable->zstring = NULL;
 	variable->changed = 0; // new variable has not been modified by the user
@@ -1228,6 +1262,8 @@ finish:
 		DEBFILE(va("%s set to %s\n", var->name, var->string));
 	}
 	var->flags |= CV_MODIFIED;
+	if (var->flags & CV_NETVAR)
+		cv_netvarchanges++;
 	// raise 'on change' code
 #ifdef HAVE_BLUA
 	LUA_CVarChanged(var->name); // let consolelib know what cvar this is.
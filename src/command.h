@@ -122,6 +122,7 @@ typedef struct consvar_s //NULL, NULL, 0, NULL, NULL |, 0, NULL, NULL, 0, 0, NUL
 	                      // used only with CV_NETVAR
 	char changed;         // has variable been changed by the user? 0 = no, 1 = yes
 	struct consvar_s *next;
+	struct consvar_s *hashnext; // used internaly : next with the same name hash
 } consvar_t;
 
 extern CV_PossibleValue_t CV_OnOff[];
@@ -161,6 +162,7 @@ void CV_AddValue(consvar_t *var, INT32 increment);
 void CV_SaveVariables(FILE *f);
 
 // load/save gamesate (load and save option and for network join in game)
+extern UINT32 cv_netvarchanges; // counts up whenever a netvar is set
 void CV_SaveNetVars(UINT8 **p);
 void CV_LoadNetVars(UINT8 **p);
 
@@ -17,6 +17,17 @@
 #include <unistd.h> //for unlink
 #endif
 
+// Dedicated servers on Unix make join savegames in a forked copy of
+// themselves, so the game goes on while the world is being archived.
+#if defined (UNIXCOMMON) && !defined (NONET) && !defined (__CYGWIN__)
+#define FORKSAVEGAME
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
 #include "i_net.h"
 #include "i_system.h"
 #include "i_video.h"
@@ -34,6 +45,7 @@
 #include "z_zone.h"
 #include "p_local.h"
 #include "m_misc.h"
+#include "m_perfstats.h"
 #include "am_map.h"
 #include "m_random.h"
 #include "mserv.h"
@@ -42,9 +54,16 @@
 #include "m_argv.h"
 #include "p_setup.h"
 #include "lzf.h"
+#ifdef HAVE_ZLIB
+#include "zlib.h"
+#endif
 #include "lua_script.h"
 #include "lua_hook.h"
 #include "md5.h"
+#include "d_desync.h"
+#include "p_snapshot.h"
+#include "d_netrec.h"
+#include "b_bot.h"
 
 #ifdef CLIENT_LOADINGSCREEN
 // cl loading screen
@@ -101,6 +120,7 @@ boolean nodeingame[MAXNETNODES]; // set false as nodes leave game
 static tic_t nettics[MAXNETNODES]; // what tic the client have received
 static tic_t supposedtics[MAXNETNODES]; // nettics prevision for smaller packet
 static UINT8 nodewaiting[MAXNETNODES];
+static boolean nodedeltatics[MAXNETNODES]; // Node asked for PT_SERVERDELTATICS when it joined
 static tic_t firstticstosend; // min of the nettics
 static tic_t tictoclear = 0; // optimize d_clearticcmd
 static tic_t maketic;
@@ -110,9 +130,18 @@ static INT16 consistancy[BACKUPTICS];
 // Resynching shit!
 static UINT32 resynch_score[MAXNETNODES]; // "score" for kicking -- if this gets too high then cfail kick
 static UINT16 resynch_delay[MAXNETNODES]; // delay time before the player can be considered to have desynched
-static UINT32 resynch_status[MAXNETNODES]; // 0 bit means synched for that player, 1 means possibly desynched
+static UINT8 resynch_status[MAXNETNODES][PLAYERMASKSIZE]; // 0 bit means synched for that player, 1 means possibly desynched
 static UINT8 resynch_sent[MAXNETNODES][MAXPLAYERS]; // what synch packets have we attempted to send to the player
 static UINT8 resynch_inprogress[MAXNETNODES];
+// Both sides remember the last resynch_pak of each player the client
+// confirmed it has, so the next one can be sent as the changes from it.
+static resynch_pak *resynch_bases[MAXNETNODES]; // MAXPLAYERS confirmed, then MAXPLAYERS last sent
+static UINT8 resynch_baseid[MAXNETNODES][MAXPLAYERS]; // 0 if none confirmed
+static UINT8 resynch_nextid[MAXNETNODES];
+static resynch_pak resynch_localbase[MAXPLAYERS]; // client side
+static UINT8 resynch_localbaseid[MAXPLAYERS];
+static tic_t fingerprintask[MAXNETNODES]; // desyncdebug: tic+1 to ask the node for, 0 if none
+static boolean fingerprintasked[MAXNETNODES]; // Only ask each node once, it's for the log
 static UINT8 resynch_local_inprogress = false; // WE are desynched and getting packets to fix it.
 static UINT8 player_joining = false;
 UINT8 hu_resynching = 0;
@@ -124,11 +153,25 @@ boolean adminpasswordset = false;
 static ticcmd_t localcmds;
 static ticcmd_t localcmds2;
 static boolean cl_packetmissed;
+
+// Ticcmds sent to the server that haven't come back in a tic yet,
+// oldest first, for p_predict.c to run the local player ahead on.
+#define MAXPREDICTEDCMDS 32
+static ticcmd_t predictcmds[MAXPREDICTEDCMDS];
+static tic_t predicttimes[MAXPREDICTEDCMDS];
+static INT32 firstpredictcmd = 0, numpredictcmds = 0;
 // here it is for the secondary local player (splitscreen)
 static UINT8 mynode; // my address pointofview server
 
-static UINT8 localtextcmd[MAXTEXTCMD];
-static UINT8 localtextcmd2[MAXTEXTCMD]; // splitscreen
+// A player's net commands for a tic, each an XD_ id and its parameters
+typedef struct
+{
+	UINT16 size;
+	UINT8 data[MAXTEXTCMD];
+} textcmd_t;
+
+static textcmd_t localtextcmd;
+static textcmd_t localtextcmd2; // splitscreen
 static tic_t neededtic;
 SINT8 servernode = 0; // the number of the server node
 /// \brief do we accept new players?
@@ -137,25 +180,18 @@ boolean acceptnewnode = true;
 
 // engine
 
-// Must be a power of two
-#define TEXTCMD_HASH_SIZE 4
-
-typedef struct textcmdplayer_s
-{
-	INT32 playernum;
-	UINT8 cmd[MAXTEXTCMD];
-	struct textcmdplayer_s *next;
-} textcmdplayer_t;
-
-typedef struct textcmdtic_s
+// Net commands for a tic live in the slot for tic%BACKUPTICS, like
+// netcmds. No more than BACKUPTICS tics are ever kept, so a slot still
+// holding an older tic is free to take over.
+typedef struct
 {
 	tic_t tic;
-	textcmdplayer_t *playercmds[TEXTCMD_HASH_SIZE];
-	struct textcmdtic_s *next;
+	UINT8 playermask[PLAYERMASKSIZE]; // which players have a cmd for the tic, none if the slot is free
+	textcmd_t cmd[MAXPLAYERS];
 } textcmdtic_t;
 
 ticcmd_t netcmds[BACKUPTICS][MAXPLAYERS];
-static textcmdtic_t *textcmds[TEXTCMD_HASH_SIZE] = {NULL};
+static textcmdtic_t textcmds[BACKUPTICS];
 
 
 static consvar_t cv_showjoinaddress = {"showjoinaddress", "On", 0, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
@@ -189,6 +225,83 @@ static inline void *G_ScpyTiccmd(ticcmd_t* dest, void* src, const size_t n)
 	return ret+n;
 }
 
+// In PT_SERVERDELTATICS every ticcmd starts with a byte of these flags,
+// one for each field that is different from the same player's last tic.
+// Only those fields follow. The first tic in a packet goes against an
+// empty ticcmd, so a packet never needs an earlier one to be read.
+#define DELTA_FORWARDMOVE 0x01
+#define DELTA_SIDEMOVE    0x02
+#define DELTA_ANGLETURN   0x04
+#define DELTA_AIMING      0x08
+#define DELTA_BUTTONS     0x10
+
+static const ticcmd_t emptyticcmd;
+
+static UINT8 G_TiccmdDeltaFlags(const ticcmd_t *cmd, const ticcmd_t *base)
+{
+	UINT8 flags = 0;
+
+	if (cmd->forwardmove != base->forwardmove)
+		flags |= DELTA_FORWARDMOVE;
+	if (cmd->sidemove != base->sidemove)
+		flags |= DELTA_SIDEMOVE;
+	if (cmd->angleturn != base->angleturn)
+		flags |= DELTA_ANGLETURN;
+	if (cmd->aiming != base->aiming)
+		flags |= DELTA_AIMING;
+	if (cmd->buttons != base->buttons)
+		flags |= DELTA_BUTTONS;
+	return flags;
+}
+
+static size_t G_DeltaTiccmdSize(const ticcmd_t *cmd, const ticcmd_t *base)
+{
+	const UINT8 flags = G_TiccmdDeltaFlags(cmd, base);
+	size_t size = 1;
+
+	if (flags & DELTA_FORWARDMOVE)
+		size++;
+	if (flags & DELTA_SIDEMOVE)
+		size++;
+	if (flags & DELTA_ANGLETURN)
+		size += 2;
+	if (flags & DELTA_AIMING)
+		size += 2;
+	if (flags & DELTA_BUTTONS)
+		size += 2;
+	return size;
+}
+
+static UINT8 *G_DeltaTiccmd(UINT8 *dest, const ticcmd_t *cmd, const ticcmd_t *base)
+{
+	const UINT8 flags = G_TiccmdDeltaFlags(cmd, base);
+
+	WRITEUINT8(dest, flags);
+	if (flags & DELTA_FORWARDMOVE)
+		WRITESINT8(dest, cmd->forwardmove);
+	if (flags & DELTA_SIDEMOVE)
+		WRITESINT8(dest, cmd->sidemove);
+	if (flags & DELTA_ANGLETURN)
+		WRITEINT16(dest, cmd->angleturn);
+	if (flags & DELTA_AIMING)
+		WRITEINT16(dest, cmd->aiming);
+	if (flags & DELTA_BUTTONS)
+		WRITEUINT16(dest, cmd->buttons);
+	return dest;
+}
+
+static UINT8 *G_UndeltaTiccmd(ticcmd_t *cmd, UINT8 *src, const ticcmd_t *base)
+{
+	const UINT8 flags = READUINT8(src);
+
+	cmd->forwardmove = (flags & DELTA_FORWARDMOVE) ? READSINT8(src) : base->forwardmove;
+	cmd->sidemove = (flags & DELTA_SIDEMOVE) ? READSINT8(src) : base->sidemove;
+	cmd->angleturn = (flags & DELTA_ANGLETURN) ? READINT16(src) : base->angleturn;
+	cmd->aiming = (flags & DELTA_AIMING) ? READINT16(src) : base->aiming;
+	cmd->buttons = (flags & DELTA_BUTTONS) ? READUINT16(src) : base->buttons;
+	return src;
+}
+
 
 
 // Some software don't support largest packet
@@ -235,138 +348,120 @@ void RegisterNetXCmd(netxcmd_t id, void (*cmd_f)(UINT8 **p, INT32 playernum))
 
 void SendNetXCmd(netxcmd_t id, const void *param, size_t nparam)
 {
-	if (localtextcmd[0]+2+nparam > MAXTEXTCMD)
+	if (localtextcmd.size+1+nparam > MAXTEXTCMD)
 	{
 		// for future reference: if (cv_debug) != debug disabled.
-		CONS_Alert(CONS_ERROR, M_GetText("NetXCmd buffer full, cannot add netcmd %d! (size: %d, needed: %s)\n"), id, localtextcmd[0], sizeu1(nparam));
+		CONS_Alert(CONS_ERROR, M_GetText("NetXCmd buffer full, cannot add netcmd %d! (size: %d, needed: %s)\n"), id, localtextcmd.size, sizeu1(nparam));
 		return;
 	}
-	localtextcmd[0]++;
-	localtextcmd[localtextcmd[0]] = (UINT8)id;
+	localtextcmd.data[localtextcmd.size++] = (UINT8)id;
 	if (param && nparam)
 	{
-		M_Memcpy(&localtextcmd[localtextcmd[0]+1], param, nparam);
-		localtextcmd[0] = (UINT8)(localtextcmd[0] + (UINT8)nparam);
+		M_Memcpy(&localtextcmd.data[localtextcmd.size], param, nparam);
+		localtextcmd.size = (UINT16)(localtextcmd.size + nparam);
 	}
 }
 
 // splitscreen player
 void SendNetXCmd2(netxcmd_t id, const void *param, size_t nparam)
 {
-	if (localtextcmd2[0]+2+nparam > MAXTEXTCMD)
+	if (localtextcmd2.size+1+nparam > MAXTEXTCMD)
 	{
 		I_Error("No more place in the buffer for netcmd %d\n",id);
 		return;
 	}
-	localtextcmd2[0]++;
-	localtextcmd2[localtextcmd2[0]] = (UINT8)id;
+	localtextcmd2.data[localtextcmd2.size++] = (UINT8)id;
 	if (param && nparam)
 	{
-		M_Memcpy(&localtextcmd2[localtextcmd2[0]+1], param, nparam);
-		localtextcmd2[0] = (UINT8)(localtextcmd2[0] + (UINT8)nparam);
+		M_Memcpy(&localtextcmd2.data[localtextcmd2.size], param, nparam);
+		localtextcmd2.size = (UINT16)(localtextcmd2.size + nparam);
 	}
 }
 
-UINT8 GetFreeXCmdSize(void)
+size_t GetFreeXCmdSize(void)
 {
-	// -1 for the size and another -1 for the ID.
-	return (UINT8)(localtextcmd[0] - 2);
+	// -1 for the ID.
+	if (localtextcmd.size + 1 >= MAXTEXTCMD)
+		return 0;
+	return MAXTEXTCMD - localtextcmd.size - 1;
 }
 
-// Frees all textcmd memory for the specified tic
-static void D_FreeTextcmd(tic_t tic)
+// In packets a textcmd's size goes before it in one byte if it's under
+// 128, or in two with the top bit of the first set if not.
+UINT8 *D_WriteTextCmdSize(UINT8 *p, size_t size)
 {
-	textcmdtic_t **tctprev = &textcmds[tic & (TEXTCMD_HASH_SIZE - 1)];
-	textcmdtic_t *textcmdtic = *tctprev;
-
-	while (textcmdtic && textcmdtic->tic != tic)
+	if (size < 0x80)
+		WRITEUINT8(p, (UINT8)size);
+	else
 	{
-		tctprev = &textcmdtic->next;
-		textcmdtic = textcmdtic->next;
+		WRITEUINT8(p, (UINT8)(0x80 | (size >> 8)));
+		WRITEUINT8(p, (UINT8)(size & 0xFF));
 	}
+	return p;
+}
 
-	if (textcmdtic)
-	{
-		INT32 i;
+size_t D_ReadTextCmdSize(const UINT8 **p)
+{
+	size_t size = *(*p)++;
+
+	if (size & 0x80)
+		size = ((size & 0x7F) << 8) | *(*p)++;
+	return size;
+}
 
-		// Remove this tic from the list.
-		*tctprev = textcmdtic->next;
+#define TEXTCMDSIZELEN(size) ((size) < 0x80 ? 1 : 2)
 
-		// Free all players.
-		for (i = 0; i < TEXTCMD_HASH_SIZE; i++)
-		{
-			textcmdplayer_t *textcmdplayer = textcmdtic->playercmds[i];
+// True if no player is in the mask
+static boolean PlayerMaskEmpty(const UINT8 *mask)
+{
+	INT32 i;
 
-			while (textcmdplayer)
-			{
-				textcmdplayer_t *tcpnext = textcmdplayer->next;
-				Z_Free(textcmdplayer);
-				textcmdplayer = tcpnext;
-			}
-		}
+	for (i = 0; i < PLAYERMASKSIZE; i++)
+		if (mask[i])
+			return false;
+	return true;
+}
 
-		// Free this tic's own memory.
-		Z_Free(textcmdtic);
-	}
+// Forgets all textcmds for the specified tic
+static void D_FreeTextcmd(tic_t tic)
+{
+	textcmdtic_t *textcmdtic = &textcmds[tic%BACKUPTICS];
+
+	if (textcmdtic->tic == tic)
+		memset(textcmdtic->playermask, 0, PLAYERMASKSIZE);
 }
 
 // Gets the buffer for the specified ticcmd, or NULL if there isn't one
-static UINT8* D_GetExistingTextcmd(tic_t tic, INT32 playernum)
+static textcmd_t *D_GetExistingTextcmd(tic_t tic, INT32 playernum)
 {
-	textcmdtic_t *textcmdtic = textcmds[tic & (TEXTCMD_HASH_SIZE - 1)];
-	while (textcmdtic && textcmdtic->tic != tic) textcmdtic = textcmdtic->next;
-
-	// Do we have an entry for the tic? If so, look for player.
-	if (textcmdtic)
-	{
-		textcmdplayer_t *textcmdplayer = textcmdtic->playercmds[playernum & (TEXTCMD_HASH_SIZE - 1)];
-		while (textcmdplayer && textcmdplayer->playernum != playernum) textcmdplayer = textcmdplayer->next;
+	textcmdtic_t *textcmdtic = &textcmds[tic%BACKUPTICS];
 
-		if (textcmdplayer) return textcmdplayer->cmd;
-	}
+	if (textcmdtic->tic == tic && PLAYERINMASK(textcmdtic->playermask, playernum))
+		return &textcmdtic->cmd[playernum];
 
 	return NULL;
 }
 
 // Gets the buffer for the specified ticcmd, creating one if necessary
-static UINT8* D_GetTextcmd(tic_t tic, INT32 playernum)
+static textcmd_t *D_GetTextcmd(tic_t tic, INT32 playernum)
 {
-	textcmdtic_t *textcmdtic = textcmds[tic & (TEXTCMD_HASH_SIZE - 1)];
-	textcmdtic_t **tctprev = &textcmds[tic & (TEXTCMD_HASH_SIZE - 1)];
-	textcmdplayer_t *textcmdplayer, **tcpprev;
-
-	// Look for the tic.
-	while (textcmdtic && textcmdtic->tic != tic)
-	{
-		tctprev = &textcmdtic->next;
-		textcmdtic = textcmdtic->next;
-	}
+	textcmdtic_t *textcmdtic = &textcmds[tic%BACKUPTICS];
 
-	// If we don't have an entry for the tic, make it.
-	if (!textcmdtic)
+	// Take the slot over from whatever tic had it last.
+	if (textcmdtic->tic != tic)
 	{
-		textcmdtic = *tctprev = Z_Calloc(sizeof (textcmdtic_t), PU_STATIC, NULL);
 		textcmdtic->tic = tic;
+		memset(textcmdtic->playermask, 0, PLAYERMASKSIZE);
 	}
 
-	tcpprev = &textcmdtic->playercmds[playernum & (TEXTCMD_HASH_SIZE - 1)];
-	textcmdplayer = *tcpprev;
-
-	// Look for the player.
-	while (textcmdplayer && textcmdplayer->playernum != playernum)
-	{
-		tcpprev = &textcmdplayer->next;
-		textcmdplayer = textcmdplayer->next;
-	}
-
-	// If we don't have an entry for the player, make it.
-	if (!textcmdplayer)
+	// A new entry starts out empty, like it used to from Z_Calloc.
+	if (!PLAYERINMASK(textcmdtic->playermask, playernum))
 	{
-		textcmdplayer = *tcpprev = Z_Calloc(sizeof (textcmdplayer_t), PU_STATIC, NULL);
-		textcmdplayer->playernum = playernum;
+		textcmdtic->cmd[playernum].size = 0;
+		ADDPLAYERTOMASK(textcmdtic->playermask, playernum);
 	}
 
-	return textcmdplayer->cmd;
+	return &textcmdtic->cmd[playernum];
 }
 
 static void ExtraDataTicker(void)
@@ -376,14 +471,14 @@ static void ExtraDataTicker(void)
 	for (i = 0; i < MAXPLAYERS; i++)
 		if (playeringame[i] || i == 0)
 		{
-			UINT8 *bufferstart = D_GetExistingTextcmd(gametic, i);
+			textcmd_t *textcmd = D_GetExistingTextcmd(gametic, i);
 
-			if (bufferstart)
+			if (textcmd)
 			{
+				UINT8 *bufferstart = textcmd->data;
 				UINT8 *curpos = bufferstart;
-				UINT8 *bufferend = &curpos[curpos[0]+1];
+				UINT8 *bufferend = &bufferstart[textcmd->size];
 
-				curpos++;
 				while (curpos < bufferend)
 				{
 					if (*curpos < MAXNETXCMD && listnetxcmd[*curpos])
@@ -405,7 +500,7 @@ static void ExtraDataTicker(void)
 							SendNetXCmd(XD_KICK, &buf, 2);
 							DEBFILE(va("player %d kicked [gametic=%u] reason as follows:\n", i, gametic));
 						}
-						CONS_Alert(CONS_WARNING, M_GetText("Got unknown net command [%s]=%d (max %d)\n"), sizeu1(curpos - bufferstart), *curpos, bufferstart[0]);
+						CONS_Alert(CONS_WARNING, M_GetText("Got unknown net command [%s]=%d (max %d)\n"), sizeu1(curpos - bufferstart), *curpos, textcmd->size);
 						break;
 					}
 				}
@@ -437,11 +532,12 @@ void D_ResetTiccmds(void)
 
 	memset(&localcmds, 0, sizeof(ticcmd_t));
 	memset(&localcmds2, 0, sizeof(ticcmd_t));
+	numpredictcmds = 0;
 
 	// Reset the net command list
-	for (i = 0; i < TEXTCMD_HASH_SIZE; i++)
-		while (textcmds[i])
-			D_Clearticcmd(textcmds[i]->tic);
+	for (i = 0; i < BACKUPTICS; i++)
+		if (!PlayerMaskEmpty(textcmds[i].playermask))
+			D_Clearticcmd(textcmds[i].tic);
 }
 
 // -----------------------------------------------------------------
@@ -879,7 +975,7 @@ static inline void resynch_write_others(resynchend_pak *rst)
 {
 	UINT8 i;
 
-	rst->ingame = 0;
+	memset(rst->ingame, 0, sizeof (rst->ingame));
 
 	for (i = 0; i < MAXPLAYERS; ++i)
 	{
@@ -895,7 +991,7 @@ static inline void resynch_write_others(resynchend_pak *rst)
 		}
 
 		if (!players[i].spectator)
-			rst->ingame |= (1<<i);
+			ADDPLAYERTOMASK(rst->ingame, i);
 		rst->ctfteam[i] = (INT32)LONG(players[i].ctfteam);
 		rst->score[i] = (UINT32)LONG(players[i].score);
 		rst->numboxes[i] = SHORT(players[i].numboxes);
@@ -903,20 +999,16 @@ static inline void resynch_write_others(resynchend_pak *rst)
 		rst->realtime[i] = (tic_t)LONG(players[i].realtime);
 		rst->laps[i] = players[i].laps;
 	}
-
-	// endian safeness
-	rst->ingame = (UINT32)LONG(rst->ingame);
 }
 
 static inline void resynch_read_others(resynchend_pak *p)
 {
 	UINT8 i;
-	UINT32 loc_ingame = (UINT32)LONG(p->ingame);
 
 	for (i = 0; i < MAXPLAYERS; ++i)
 	{
 		// We don't care if they're in the game or not, just write all the data.
-		players[i].spectator = !(loc_ingame & (1<<i));
+		players[i].spectator = !PLAYERINMASK(p->ingame, i);
 		players[i].ctfteam = (INT32)LONG(p->ctfteam[i]); // no, 0 does not mean spectator, at least not in Match
 		players[i].score = (UINT32)LONG(p->score[i]);
 		players[i].numboxes = SHORT(p->numboxes[i]);
@@ -930,18 +1022,24 @@ static void SV_InitResynchVars(INT32 node)
 {
 	resynch_delay[node] = TICRATE; // initial one second delay
 	resynch_score[node] = 0; // clean slate
-	resynch_status[node] = 0x00;
+	memset(resynch_status[node], 0, PLAYERMASKSIZE);
 	resynch_inprogress[node] = false;
 	memset(resynch_sent[node], 0, MAXPLAYERS);
+	memset(resynch_baseid[node], 0, MAXPLAYERS);
+	if (resynch_bases[node])
+	{
+		Z_Free(resynch_bases[node]);
+		resynch_bases[node] = NULL;
+	}
 }
 
 static void SV_RequireResynch(INT32 node)
 {
-	INT32 i;
+	INT32 i, numplayers = D_NumPlayers();
 
 	resynch_delay[node] = 10; // Delay before you can fail sync again
 	resynch_score[node] += 200; // Add score for initial desynch
-	resynch_status[node] = 0xFFFFFFFF; // No players assumed synched
+	memset(resynch_status[node], 0, PLAYERMASKSIZE);
 	resynch_inprogress[node] = true; // so we know to send a PT_RESYNCHEND after sync
 
 	// Initial setup
@@ -949,13 +1047,75 @@ static void SV_RequireResynch(INT32 node)
 	for (i = 0; i < MAXPLAYERS; ++i)
 	{
 		if (!playeringame[i]) // Player not in game so just drop it from required synch
-			resynch_status[node] &= ~(1<<i);
-		else if (playernode[i] == node); // instantly update THEIR position
+			continue;
+
+		ADDPLAYERTOMASK(resynch_status[node], i); // No players assumed synched
+		if (playernode[i] == node); // instantly update THEIR position
 		else // Send at random times based on num players
-			resynch_sent[node][i] = M_RandomKey(D_NumPlayers()>>1)+1;
+			resynch_sent[node][i] = M_RandomKey(numplayers>>1)+1;
 	}
 }
 
+//
+// SV_SendResynchPlayer
+//
+// Sends player i to node, as the changes from what it last confirmed
+// if that's smaller.
+//
+static void SV_SendResynchPlayer(INT32 node, INT32 i)
+{
+	resynch_pak *sent, *base;
+	resynch_pak pak;
+	resynchdelta_pak *delta = &netbuffer->u.resynchdelta;
+	const UINT8 *now, *then;
+	UINT8 *p;
+	size_t w, b;
+
+	if (!resynch_bases[node])
+		resynch_bases[node] = Z_Calloc(2*MAXPLAYERS * sizeof (resynch_pak), PU_STATIC, NULL);
+	base = &resynch_bases[node][i];
+	sent = &resynch_bases[node][MAXPLAYERS + i];
+
+	memset(&pak, 0, sizeof (pak));
+	resynch_write_player(&pak, i);
+	if (!++resynch_nextid[node])
+		resynch_nextid[node] = 1;
+	pak.id = resynch_nextid[node];
+	*sent = pak;
+
+	if (resynch_baseid[node][i])
+	{
+		now = (const UINT8 *)&pak;
+		then = (const UINT8 *)base;
+		memset(delta->changed, 0, sizeof (delta->changed));
+		p = delta->words;
+		for (w = 0; w < RESYNCHWORDS; w++)
+		{
+			const size_t len = min(4, sizeof (resynch_pak) - w*4);
+
+			if (!memcmp(now + w*4, then + w*4, len))
+				continue;
+			delta->changed[w>>3] |= 1<<(w&7);
+			for (b = 0; b < len; b++)
+				*p++ = now[w*4 + b];
+		}
+
+		if ((size_t)(p - (UINT8 *)delta) < sizeof (resynch_pak))
+		{
+			netbuffer->packettype = PT_RESYNCHDELTA;
+			delta->playernum = (UINT8)i;
+			delta->id = pak.id;
+			delta->baseid = resynch_baseid[node][i];
+			HSendPacket(node, false, 0, p - (UINT8 *)delta);
+			return;
+		}
+	}
+
+	netbuffer->packettype = PT_RESYNCHING;
+	netbuffer->u.resynchpak = pak;
+	HSendPacket(node, false, 0, (sizeof(resynch_pak)));
+}
+
 static void SV_SendResynch(INT32 node)
 {
 	INT32 i, j;
@@ -969,7 +1129,7 @@ static void SV_SendResynch(INT32 node)
 	}
 
 	// resynched?
-	if (!resynch_status[node])
+	if (PlayerMaskEmpty(resynch_status[node]))
 	{
 		// you are now synched
 		resynch_inprogress[node] = false;
@@ -985,11 +1145,10 @@ static void SV_SendResynch(INT32 node)
 		return;
 	}
 
-	netbuffer->packettype = PT_RESYNCHING;
 	for (i = 0, j = 0; i < MAXPLAYERS; ++i)
 	{
 		// if already synched don't bother
-		if (!(resynch_status[node] & 1<<i))
+		if (!PLAYERINMASK(resynch_status[node], i))
 			continue;
 
 		// waiting for a reply or just waiting in general
@@ -999,8 +1158,7 @@ static void SV_SendResynch(INT32 node)
 			continue;
 		}
 
-		resynch_write_player(&netbuffer->u.resynchpak, i);
-		HSendPacket(node, false, 0, (sizeof(resynch_pak)));
+		SV_SendResynchPlayer(node, i);
 
 		resynch_sent[node][i] = TICRATE;
 		resynch_score[node] += 2; // penalty for send
@@ -1021,21 +1179,86 @@ static void SV_SendResynch(INT32 node)
 
 static void CL_AcknowledgeResynch(resynch_pak *rsp)
 {
-	resynch_read_player(rsp);
+	const UINT8 playernum = rsp->playernum;
+	UINT8 id = 0;
+
+	if (playernum < MAXPLAYERS)
+	{
+		resynch_read_player(rsp);
+		resynch_localbase[playernum] = *rsp;
+		resynch_localbaseid[playernum] = id = rsp->id;
+	}
 
 	netbuffer->packettype = PT_RESYNCHGET;
-	netbuffer->u.resynchgot = rsp->playernum;
-	HSendPacket(servernode, true, 0, sizeof(UINT8));
+	netbuffer->u.resynchgot.playernum = playernum;
+	netbuffer->u.resynchgot.id = id;
+	HSendPacket(servernode, true, 0, sizeof (resynchgot_pak));
 }
 
-static void SV_AcknowledgeResynchAck(INT32 node, UINT8 rsg)
+static void CL_AcknowledgeResynchDelta(resynchdelta_pak *delta, size_t length)
 {
-	if (rsg >= MAXPLAYERS)
+	const UINT8 playernum = delta->playernum;
+	resynch_pak pak;
+	UINT8 *now = (UINT8 *)&pak;
+	const UINT8 *p = delta->words;
+	size_t w, b;
+
+	if (playernum >= MAXPLAYERS || !delta->baseid
+		|| resynch_localbaseid[playernum] != delta->baseid)
+	{
+		// Don't have that one: ask for the whole thing
+		netbuffer->packettype = PT_RESYNCHGET;
+		netbuffer->u.resynchgot.playernum = playernum;
+		netbuffer->u.resynchgot.id = 0;
+		HSendPacket(servernode, true, 0, sizeof (resynchgot_pak));
+		return;
+	}
+
+	pak = resynch_localbase[playernum];
+	for (w = 0; w < RESYNCHWORDS; w++)
+	{
+		const size_t len = min(4, sizeof (resynch_pak) - w*4);
+
+		if (!(delta->changed[w>>3] & 1<<(w&7)))
+			continue;
+		if ((size_t)(p + len - (UINT8 *)delta) > length)
+			break; // cut short, take what came
+		for (b = 0; b < len; b++)
+			now[w*4 + b] = *p++;
+	}
+	pak.playernum = playernum;
+	pak.id = delta->id;
+
+	CL_AcknowledgeResynch(&pak);
+}
+
+static void SV_AcknowledgeResynchAck(INT32 node, resynchgot_pak *rsg, size_t length)
+{
+	const UINT8 playernum = rsg->playernum;
+
+	if (playernum >= MAXPLAYERS)
 		resynch_score[node] += 16384; // lol.
+	else if (length >= sizeof (resynchgot_pak) && !rsg->id)
+	{
+		// Client didn't have the base; send it all, soon
+		resynch_baseid[node][playernum] = 0;
+		resynch_sent[node][playernum] = 0;
+	}
 	else
 	{
-		resynch_status[node] &= ~(1<<rsg);
+		REMOVEPLAYERFROMMASK(resynch_status[node], playernum);
 		--resynch_score[node]; // unpenalize
+
+		// Only a reply to the very last one sent says what the client has now.
+		// Old clients don't say which one they got, so never get deltas.
+		if (length >= sizeof (resynchgot_pak) && resynch_bases[node]
+			&& rsg->id == resynch_bases[node][MAXPLAYERS + playernum].id)
+		{
+			resynch_bases[node][playernum] = resynch_bases[node][MAXPLAYERS + playernum];
+			resynch_baseid[node][playernum] = rsg->id;
+		}
+		else
+			resynch_baseid[node][playernum] = 0;
 	}
 
 	// Don't let resynch cause a timeout
@@ -1053,6 +1276,7 @@ static INT16 Consistancy(void);
 
 typedef enum
 {
+	CL_RESOLVING, // waiting for I_NetMakeNodewPortAsync
 	CL_SEARCHING,
 	CL_DOWNLOADFILES,
 	CL_ASKJOIN,
@@ -1067,6 +1291,7 @@ typedef enum
 static void GetPackets(void);
 
 static cl_mode_t cl_mode = CL_SEARCHING;
+static boolean resolvingserver = false; // set by Command_connect for CL_ConnectToServer
 
 // Player name send/load
 
@@ -1122,7 +1347,7 @@ static inline void CL_DrawConnectionStatus(void)
 	if (cl_mode != CL_DOWNLOADFILES)
 	{
 		INT32 i, animtime = ((ccstime / 4) & 15) + 16;
-		UINT8 palstart = (cl_mode == CL_SEARCHING) ? 128 : 160;
+		UINT8 palstart = (cl_mode == CL_SEARCHING || cl_mode == CL_RESOLVING) ? 128 : 160;
 		// 15 pal entries total.
 		const char *cltext;
 
@@ -1150,6 +1375,9 @@ static inline void CL_DrawConnectionStatus(void)
 			case CL_WAITJOINRESPONSE:
 				cltext = M_GetText("Requesting to join...");
 				break;
+			case CL_RESOLVING:
+				cltext = M_GetText("Looking up server...");
+				break;
 			default:
 				cltext = M_GetText("Connecting to server...");
 				break;
@@ -1224,21 +1452,49 @@ static boolean CL_SendJoin(void)
 	netbuffer->u.clientcfg.localplayers = localplayers;
 	netbuffer->u.clientcfg.version = VERSION;
 	netbuffer->u.clientcfg.subversion = SUBVERSION;
+	netbuffer->u.clientcfg.flags = CLIENTCFG_DELTATICS;
+	netbuffer->u.clientcfg.maxplayers = MAXPLAYERS;
 
 	return HSendPacket(servernode, true, 0, sizeof (clientconfig_pak));
 }
 
-static void SV_SendServerInfo(INT32 node, tic_t servertime)
+// Replies to PT_ASKINFO are built once and then copied until something in
+// them changes, so a server browser asking over and over costs next to nothing.
+typedef struct
+{
+	INT16 map;
+	INT16 gametype;
+	size_t numwadfiles;
+	INT32 numplayers;
+	INT32 maxplayers;
+	INT32 downloading;
+	INT32 maxsend;
+	boolean modifiedgame;
+	boolean cheats;
+	boolean dedicated;
+} serverinfokey_t;
+
+static serverinfokey_t serverinfokey;
+static UINT8 serverinfocache[sizeof (serverinfo_pak)];
+static size_t serverinfolength = 0; // 0 if there's nothing cached
+
+static plrinfo playerinfocache[MAXPLAYERS];
+static tic_t playerinfotic;
+static boolean playerinfocached = false;
+
+static void SV_ClearInfoCaches(void)
+{
+	serverinfolength = 0;
+	playerinfocached = false;
+}
+
+// Builds the parts of the serverinfo packet that don't change every tic.
+static size_t SV_BuildServerInfo(void)
 {
 	UINT8 *p;
 
-	netbuffer->packettype = PT_SERVERINFO;
 	netbuffer->u.serverinfo.version = VERSION;
 	netbuffer->u.serverinfo.subversion = SUBVERSION;
-	// return back the time value so client can compute their ping
-	netbuffer->u.serverinfo.time = (tic_t)LONG(servertime);
-	netbuffer->u.serverinfo.leveltime = (tic_t)LONG(leveltime);
-
 	netbuffer->u.serverinfo.numberofplayer = (UINT8)D_NumPlayers();
 	netbuffer->u.serverinfo.maxplayer = (UINT8)cv_maxplayers.value;
 	netbuffer->u.serverinfo.gametype = (UINT8)gametype;
@@ -1265,15 +1521,53 @@ static void SV_SendServerInfo(INT32 node, tic_t servertime)
 
 	netbuffer->u.serverinfo.actnum = mapheaderinfo[gamemap-1]->actnum;
 
+	strncpy(netbuffer->u.serverinfo.httpsource, cv_httpsource.string, MAX_MIRROR_LENGTH);
+	netbuffer->u.serverinfo.httpsource[MAX_MIRROR_LENGTH-1] = '\0';
+
 	p = PutFileNeeded();
 
-	HSendPacket(node, false, 0, p - ((UINT8 *)&netbuffer->u));
+	return p - ((UINT8 *)&netbuffer->u);
 }
 
-static void SV_SendPlayerInfo(INT32 node)
+static void SV_SendServerInfo(INT32 node, tic_t servertime)
+{
+	serverinfokey_t key;
+	const serverinfo_pak *cached = (serverinfo_pak *)serverinfocache;
+
+	memset(&key, 0, sizeof (key)); // so padding compares equal
+	key.map = gamemap;
+	key.gametype = gametype;
+	key.numwadfiles = numwadfiles;
+	key.numplayers = D_NumPlayers();
+	key.maxplayers = cv_maxplayers.value;
+	key.downloading = cv_downloading.value;
+	key.maxsend = cv_maxsend.value;
+	key.modifiedgame = modifiedgame;
+	key.cheats = CV_CheatsEnabled();
+	key.dedicated = dedicated;
+
+	if (serverinfolength && !memcmp(&key, &serverinfokey, sizeof (key))
+		&& !strncmp(cached->servername, cv_servername.string, MAXSERVERNAME)
+		&& !strncmp(cached->httpsource, cv_httpsource.string, MAX_MIRROR_LENGTH-1))
+		M_Memcpy(&netbuffer->u, serverinfocache, serverinfolength);
+	else
+	{
+		serverinfolength = SV_BuildServerInfo();
+		M_Memcpy(serverinfocache, &netbuffer->u, serverinfolength);
+		serverinfokey = key;
+	}
+
+	netbuffer->packettype = PT_SERVERINFO;
+	// return back the time value so client can compute their ping
+	netbuffer->u.serverinfo.time = (tic_t)LONG(servertime);
+	netbuffer->u.serverinfo.leveltime = (tic_t)LONG(leveltime);
+
+	HSendPacket(node, false, 0, serverinfolength);
+}
+
+static void SV_BuildPlayerInfo(void)
 {
 	UINT8 i;
-	netbuffer->packettype = PT_PLAYERINFO;
 
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -1342,10 +1636,122 @@ static void SV_SendPlayerInfo(INT32 node)
 		if (players[i].powers[pw_super])
 			netbuffer->u.playerinfo[i].data |= 0x80;
 	}
+}
+
+static void SV_SendPlayerInfo(INT32 node)
+{
+	// Scores and times only move once a tic
+	if (playerinfocached && playerinfotic == gametic)
+		M_Memcpy(netbuffer->u.playerinfo, playerinfocache, sizeof (playerinfocache));
+	else
+	{
+		SV_BuildPlayerInfo();
+		M_Memcpy(playerinfocache, netbuffer->u.playerinfo, sizeof (playerinfocache));
+		playerinfotic = gametic;
+		playerinfocached = true;
+	}
 
+	netbuffer->packettype = PT_PLAYERINFO;
 	HSendPacket(node, false, 0, sizeof(plrinfo) * MAXPLAYERS);
 }
 
+// How a block of the join savegame or the server config is packed
+enum
+{
+	SAVECHUNK_STORED,
+	SAVECHUNK_LZF,
+	SAVECHUNK_ZLIB
+};
+
+// Packs rawlen bytes of raw into out, which has room for as many, and
+// returns the codec. It's only stored as it is if nothing makes it smaller.
+static UINT8 D_PackBlock(const UINT8 *raw, size_t rawlen, UINT8 *out, size_t *outlen)
+{
+#ifdef HAVE_ZLIB
+	if (rawlen > 1)
+	{
+		uLongf zlen = (uLongf)(rawlen - 1);
+		if (compress2(out, &zlen, raw, (uLong)rawlen, Z_DEFAULT_COMPRESSION) == Z_OK)
+		{
+			*outlen = zlen;
+			return SAVECHUNK_ZLIB;
+		}
+	}
+#endif
+	if (rawlen > 1 && (*outlen = lzf_compress(raw, rawlen, out, rawlen - 1)))
+		return SAVECHUNK_LZF;
+	M_Memcpy(out, raw, rawlen);
+	*outlen = rawlen;
+	return SAVECHUNK_STORED;
+}
+
+// Undoes D_PackBlock, false if in isn't exactly outlen bytes once unpacked
+static boolean D_UnpackBlock(UINT8 codec, const UINT8 *in, size_t inlen, UINT8 *out, size_t outlen)
+{
+	switch (codec)
+	{
+		case SAVECHUNK_STORED:
+			if (inlen != outlen)
+				return false;
+			M_Memcpy(out, in, outlen);
+			return true;
+		case SAVECHUNK_LZF:
+			return (lzf_decompress(in, inlen, out, outlen) == outlen);
+#ifdef HAVE_ZLIB
+		case SAVECHUNK_ZLIB:
+		{
+			uLongf zlen = (uLongf)outlen;
+			return (uncompress(out, &zlen, in, (uLong)inlen) == Z_OK && zlen == outlen);
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+// The player names and netvars of a PT_SERVERCFG are packed once, then
+// sent to every node that joins until a netvar or a name changes, so a
+// crowd joining on a map change doesn't dump the netvars for each one.
+#define SERVERCFGSIZE (64*1024)
+
+static UINT8 *servercfgraw = NULL; // the names, then the netvars
+static size_t servercfgnameslen, servercfgrawlen;
+static UINT8 *servercfgpacked = NULL;
+static size_t servercfgpackedlen;
+static UINT8 servercfgcodec;
+static UINT32 servercfgnetvars; // cv_netvarchanges when it was packed
+
+static void SV_PackServerConfig(void)
+{
+	UINT8 names[MAXPLAYERS*(MAXPLAYERNAME+1)];
+	UINT8 *p = names;
+	size_t nameslen;
+
+	CV_SavePlayerNames(&p);
+	nameslen = (size_t)(p - names);
+
+	if (servercfgpacked && servercfgnetvars == cv_netvarchanges
+		&& servercfgnameslen == nameslen && !memcmp(servercfgraw, names, nameslen))
+		return;
+
+	if (!servercfgraw)
+	{
+		servercfgraw = malloc(SERVERCFGSIZE);
+		servercfgpacked = malloc(SERVERCFGSIZE);
+		if (!servercfgraw || !servercfgpacked)
+			I_Error("SV_PackServerConfig: No more free memory\n");
+	}
+
+	M_Memcpy(servercfgraw, names, nameslen);
+	p = servercfgraw + nameslen;
+	CV_SaveNetVars(&p);
+
+	servercfgnameslen = nameslen;
+	servercfgrawlen = (size_t)(p - servercfgraw);
+	servercfgcodec = D_PackBlock(servercfgraw, servercfgrawlen, servercfgpacked, &servercfgpackedlen);
+	servercfgnetvars = cv_netvarchanges;
+}
+
 /** Sends a PT_SERVERCFG packet
   *
   * \param node The destination
@@ -1355,7 +1761,6 @@ static void SV_SendPlayerInfo(INT32 node)
 static boolean SV_SendServerConfig(INT32 node)
 {
 	INT32 i;
-	UINT8 *p, *op;
 	boolean waspacketsent;
 
 	netbuffer->packettype = PT_SERVERCFG;
@@ -1389,12 +1794,14 @@ static boolean SV_SendServerConfig(INT32 node)
 	}
 
 	memcpy(netbuffer->u.servercfg.server_context, server_context, 8);
-	op = p = netbuffer->u.servercfg.varlengthinputs;
 
-	CV_SavePlayerNames(&p);
-	CV_SaveNetVars(&p);
+	SV_PackServerConfig();
+	netbuffer->u.servercfg.varlengthcodec = servercfgcodec;
+	netbuffer->u.servercfg.varlengthsize = (UINT32)LONG(servercfgrawlen);
+	netbuffer->u.servercfg.varlengthpacked = (UINT32)LONG(servercfgpackedlen);
+	M_Memcpy(netbuffer->u.servercfg.varlengthinputs, servercfgpacked, servercfgpackedlen);
 	{
-		const size_t len = sizeof (serverconfig_pak) + (size_t)(p - op);
+		const size_t len = sizeof (serverconfig_pak) + servercfgpackedlen;
 
 #ifdef DEBUGFILE
 		if (debugfile)
@@ -1427,72 +1834,313 @@ static boolean SV_SendServerConfig(INT32 node)
 #ifdef JOININGAME
 #define SAVEGAMESIZE (768*1024)
 
-static void SV_SendSaveGame(INT32 node)
+// The join savegame is made all in one go, but it's compressed and sent a
+// chunk at a time, so the compression is spread over a few tics and the
+// first chunks are on their way while the rest are still being compressed.
+// The file is the uncompressed length, then chunks of:
+// UINT8 codec, UINT32 uncompressed length, UINT32 compressed length, data
+#define SAVECHUNKSIZE (64*1024)
+#define SAVECHUNKSPERTIC 4
+#define SAVECHUNKHEADER (1 + 2*sizeof (UINT32))
+
+typedef struct
 {
-	size_t length, compressedlen;
-	UINT8 *savebuffer;
-	UINT8 *compressedsave;
-	UINT8 *buffertosend;
+	UINT8 *data; // The whole uncompressed savegame, NULL when not sending one
+	size_t length;
+	size_t position; // How much of it has been sent
+	UINT32 sent; // Size of the file so far
+	tic_t tic; // When the last chunks were made
+	INT32 chunksthistic;
+#ifdef FORKSAVEGAME
+	pid_t child; // still archiving it if not 0
+	int pipefd; // where the child writes the length, then the savegame
+	size_t received; // of the above
+	UINT8 lengthbuf[4];
+#endif
+} savestream_t;
 
-	// first save it in a malloced buffer
-	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
-	if (!savebuffer)
+static savestream_t savestreams[MAXNETNODES];
+
+#ifdef FORKSAVEGAME
+static consvar_t cv_forksavegame = {"forksavegame", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+#endif
+
+static void SV_StopSaveStream(INT32 node)
+{
+#ifdef FORKSAVEGAME
+	savestream_t *stream = &savestreams[node];
+
+	if (stream->child)
 	{
-		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
-		return;
+		close(stream->pipefd);
+		kill(stream->child, SIGKILL);
+		waitpid(stream->child, NULL, 0);
+		stream->child = 0;
 	}
+#endif
+	free(savestreams[node].data);
+	savestreams[node].data = NULL;
+}
 
-	// Leave room for the uncompressed length.
-	save_p = savebuffer + sizeof(UINT32);
+// Compresses the next chunk of a node's savegame and queues it to be sent
+static void SV_SendSaveChunk(INT32 node)
+{
+	savestream_t *stream = &savestreams[node];
+	const UINT8 *raw = stream->data + stream->position;
+	const size_t rawlen = min(SAVECHUNKSIZE, stream->length - stream->position);
+	const size_t headerlen = SAVECHUNKHEADER + (stream->position ? 0 : sizeof (UINT32));
+	size_t packedlen;
+	UINT8 codec;
+	UINT8 *chunk, *p;
+
+	// Only as much room as the chunk stored as it is,
+	// so compressing it has to make it smaller
+	chunk = malloc(headerlen + rawlen);
+	if (!chunk)
+		I_Error("SV_SendSaveChunk: No more free memory for savegame\n");
+	codec = D_PackBlock(raw, rawlen, chunk + headerlen, &packedlen);
+
+	p = chunk;
+	if (!stream->position)
+		WRITEUINT32(p, (UINT32)stream->length);
+	WRITEUINT8(p, codec);
+	WRITEUINT32(p, (UINT32)rawlen);
+	WRITEUINT32(p, (UINT32)packedlen);
+
+	stream->position += rawlen;
+	SV_SendRamPart(node, chunk, headerlen + packedlen, SF_RAM, 0, stream->sent, stream->position == stream->length);
+	stream->sent += (UINT32)(headerlen + packedlen);
+
+	if (stream->position == stream->length)
+		SV_StopSaveStream(node);
+}
 
-	P_SaveNetGame();
+// Starts sending a node the savegame in its stream
+static void SV_StartSaveStream(INT32 node)
+{
+	savestream_t *stream = &savestreams[node];
 
-	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
+	// Remember when we started sending the savegame so we can handle timeouts
+	sendingsavegame[node] = true;
+	freezetimeout[node] = I_GetTime() + jointimeout + stream->length / 1024; // 1 extra tic for each kilobyte
+
+	// The rest is sent by SV_SaveStreamTicker
+	stream->position = 0;
+	stream->sent = 0;
+	stream->tic = I_GetTime();
+	stream->chunksthistic = 1;
+	SV_SendSaveChunk(node);
+}
+
+#ifdef FORKSAVEGAME
+//
+// SV_ForkSaveGame
+//
+// Archives the game for node in a child process. The child has the world
+// exactly as it is now, so the savegame is the same as one made here,
+// and the server carries on while it's written.
+//
+static boolean SV_ForkSaveGame(INT32 node)
+{
+	savestream_t *stream = &savestreams[node];
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) == -1)
+		return false;
+
+	pid = fork();
+	if (pid == -1)
 	{
-		free(savebuffer);
-		save_p = NULL;
-		I_Error("Savegame buffer overrun");
+		close(fds[0]);
+		close(fds[1]);
+		return false;
 	}
 
-	// Allocate space for compressed save: one byte fewer than for the
-	// uncompressed data to ensure that the compression is worthwhile.
-	compressedsave = malloc(length - 1);
-	if (!compressedsave)
+	if (pid == 0)
 	{
-		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
-		return;
+		// The child: archive, hand it over, and leave without
+		// running any of the parent's exit code
+		UINT8 header[4], *p;
+		size_t length;
+		ssize_t n;
+
+		close(fds[0]);
+		save_p = stream->data;
+		P_SaveNetGame();
+		length = save_p - stream->data;
+		if (length > SAVEGAMESIZE)
+			_exit(1);
+
+		p = header;
+		WRITEUINT32(p, (UINT32)length);
+		if (write(fds[1], header, 4) != 4)
+			_exit(1);
+		for (p = stream->data; length; p += n, length -= n)
+		{
+			n = write(fds[1], p, length);
+			if (n <= 0)
+			{
+				if (n == -1 && errno == EINTR)
+				{
+					n = 0;
+					continue;
+				}
+				_exit(1);
+			}
+		}
+		_exit(0);
 	}
 
-	// Attempt to compress it.
-	if((compressedlen = lzf_compress(savebuffer + sizeof(UINT32), length - sizeof(UINT32), compressedsave + sizeof(UINT32), length - sizeof(UINT32) - 1)))
+	close(fds[1]);
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	stream->child = pid;
+	stream->pipefd = fds[0];
+	stream->received = 0;
+
+	// Don't let the archiving count against the join
+	sendingsavegame[node] = true;
+	freezetimeout[node] = I_GetTime() + jointimeout;
+	return true;
+}
+
+// Takes in whatever the child has written so far, and starts sending once it's all there
+static void SV_ReadForkedSaveGame(INT32 node)
+{
+	savestream_t *stream = &savestreams[node];
+	ssize_t n;
+	int status = 0;
+
+	for (;;)
 	{
-		// Compressing succeeded; send compressed data
+		if (stream->received < 4)
+			n = read(stream->pipefd, stream->lengthbuf + stream->received, 4 - stream->received);
+		else
+		{
+			if (stream->received == 4)
+			{
+				UINT8 *p = stream->lengthbuf;
+				stream->length = READUINT32(p);
+				if (stream->length > SAVEGAMESIZE)
+					break;
+			}
+			if (stream->received - 4 == stream->length)
+				n = read(stream->pipefd, stream->lengthbuf, 1); // just waiting for the end
+			else
+				n = read(stream->pipefd, stream->data + stream->received - 4, stream->length - (stream->received - 4));
+		}
 
-		free(savebuffer);
+		if (n > 0)
+		{
+			stream->received += n;
+			continue;
+		}
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			return; // more later
+		break; // the child is done, one way or another
+	}
 
-		// State that we're compressed.
-		buffertosend = compressedsave;
-		WRITEUINT32(compressedsave, length - sizeof(UINT32));
-		length = compressedlen + sizeof(UINT32);
+	close(stream->pipefd);
+	waitpid(stream->child, &status, 0);
+	stream->child = 0;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) || stream->received < 4
+		|| stream->received - 4 != stream->length)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't make a savegame for node %d\n"), node);
+		SV_StopSaveStream(node);
+		return;
 	}
-	else
+
+	CONS_Debug(DBG_NETPLAY, "Savegame for node %d: %s bytes, made in the background\n",
+		node, sizeu1(stream->length));
+	SV_StartSaveStream(node);
+}
+#endif
+
+// Makes the next few chunks of every savegame being sent
+static void SV_SaveStreamTicker(void)
+{
+	const tic_t now = I_GetTime();
+	INT32 node;
+
+	for (node = 1; node < MAXNETNODES; node++)
 	{
-		// Compression failed to make it smaller; send original
+		savestream_t *stream = &savestreams[node];
 
-		free(compressedsave);
+		if (!stream->data)
+			continue;
+		if (!nodeingame[node])
+		{
+			SV_StopSaveStream(node);
+			continue;
+		}
+
+#ifdef FORKSAVEGAME
+		if (stream->child)
+		{
+			SV_ReadForkedSaveGame(node);
+			continue;
+		}
+#endif
+
+		if (stream->tic != now)
+		{
+			stream->tic = now;
+			stream->chunksthistic = 0;
+		}
+		while (stream->data && stream->chunksthistic < SAVECHUNKSPERTIC)
+		{
+			stream->chunksthistic++;
+			SV_SendSaveChunk(node);
+		}
+	}
+}
 
-		// State that we're not compressed
-		buffertosend = savebuffer;
-		WRITEUINT32(savebuffer, 0);
+static void SV_SendSaveGame(INT32 node)
+{
+	savestream_t *stream = &savestreams[node];
+#ifdef HAVE_BLUA
+	size_t luabytes;
+	UINT32 luamicros;
+#endif
+
+	SV_StopSaveStream(node); // Start over if one was still being sent
+
+	// first save it in a malloced buffer
+	stream->data = (UINT8 *)malloc(SAVEGAMESIZE);
+	if (!stream->data)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
+		return;
 	}
 
-	SV_SendRam(node, buffertosend, length, SF_RAM, 0);
+#ifdef FORKSAVEGAME
+	if (dedicated && cv_forksavegame.value && SV_ForkSaveGame(node))
+		return;
+#endif
+
+	save_p = stream->data;
+
+	P_SaveNetGame();
+
+	stream->length = save_p - stream->data;
 	save_p = NULL;
+	if (stream->length > SAVEGAMESIZE)
+	{
+		SV_StopSaveStream(node);
+		I_Error("Savegame buffer overrun");
+	}
 
-	// Remember when we started sending the savegame so we can handle timeouts
-	sendingsavegame[node] = true;
-	freezetimeout[node] = I_GetTime() + jointimeout + length / 1024; // 1 extra tic for each kilobyte
+#ifdef HAVE_BLUA
+	LUA_GetArchiveStats(&luabytes, &luamicros);
+	CONS_Debug(DBG_NETPLAY, "Savegame for node %d: %s bytes, Lua %s bytes in %u us\n",
+		node, sizeu1(stream->length), sizeu2(luabytes), luamicros);
+	DEBFILE(va("savegame for node %d: %s bytes, Lua %s bytes in %u us\n",
+		node, sizeu1(stream->length), sizeu2(luabytes), luamicros));
+#endif
+
+	SV_StartSaveStream(node);
 }
 
 #ifdef DUMPCONSISTENCY
@@ -1541,10 +2189,51 @@ static void SV_SavedGame(void)
 #define TMPSAVENAME "$$$.sav"
 
 
+// Puts the chunks of a received savegame back together, see SV_SendSaveChunk
+static UINT8 *CL_JoinSaveChunks(UINT8 *file, size_t length)
+{
+	UINT8 *p = file, *end = file + length;
+	UINT8 *joined, *out;
+	size_t rawlen;
+
+	if (length < sizeof (UINT32))
+		return NULL;
+	rawlen = READUINT32(p);
+	if (rawlen > SAVEGAMESIZE)
+		return NULL;
+
+	joined = out = Z_Malloc(rawlen, PU_STATIC, NULL);
+	while (out < joined + rawlen)
+	{
+		UINT8 codec;
+		UINT32 chunklen, packedlen;
+
+		if ((size_t)(end - p) < SAVECHUNKHEADER)
+			break;
+		codec = READUINT8(p);
+		chunklen = READUINT32(p);
+		packedlen = READUINT32(p);
+		if (packedlen > (size_t)(end - p) || chunklen > (size_t)(joined + rawlen - out))
+			break;
+		if (!D_UnpackBlock(codec, p, packedlen, out, chunklen))
+			break;
+
+		p += packedlen;
+		out += chunklen;
+	}
+
+	if (out != joined + rawlen)
+	{
+		Z_Free(joined);
+		return NULL;
+	}
+	return joined;
+}
+
 static void CL_LoadReceivedSavegame(void)
 {
-	UINT8 *savebuffer = NULL;
-	size_t length, decompressedlen;
+	UINT8 *savebuffer = NULL, *joined;
+	size_t length;
 	XBOXSTATIC char tmpsave[256];
 
 	sprintf(tmpsave, "%s" PATHSEP TMPSAVENAME, srb2home);
@@ -1558,17 +2247,15 @@ static void CL_LoadReceivedSavegame(void)
 		return;
 	}
 
-	save_p = savebuffer;
-
-	// Decompress saved game if necessary.
-	decompressedlen = READUINT32(save_p);
-	if(decompressedlen > 0)
+	// Decompress the chunks
+	joined = CL_JoinSaveChunks(savebuffer, length);
+	Z_Free(savebuffer);
+	if (!joined)
 	{
-		UINT8 *decompressedbuffer = Z_Malloc(decompressedlen, PU_STATIC, NULL);
-		lzf_decompress(save_p, length - sizeof(UINT32), decompressedbuffer, decompressedlen);
-		Z_Free(savebuffer);
-		save_p = savebuffer = decompressedbuffer;
+		I_Error("Savegame sent is corrupt");
+		return;
 	}
+	save_p = savebuffer = joined;
 
 	paused = false;
 	demoplayback = false;
@@ -1606,6 +2293,9 @@ static void CL_LoadReceivedSavegame(void)
 	if (unlink(tmpsave) == -1)
 		CONS_Alert(CONS_ERROR, M_GetText("Can't delete %s\n"), tmpsave);
 	consistancy[gametic%BACKUPTICS] = Consistancy();
+	D_RecordFingerprint(gametic);
+	P_ClearSnapshots();
+	P_TakeSnapshot(gametic);
 	CON_ToggleOff();
 }
 #endif
@@ -1684,6 +2374,78 @@ static void SL_InsertServer(serverinfo_pak* info, SINT8 node)
 	M_SortServerList();
 }
 
+// The servers SL_AskServers has already asked, so they aren't asked twice.
+static msg_server_t askedservers[MAXSERVERLIST+1];
+
+//
+// SL_AskServers
+//
+// Sends PT_ASKINFO to every server on server_list, all in one go, except
+// for the ones also on skip.
+//
+static void SL_AskServers(const msg_server_t *server_list, const msg_server_t *skip)
+{
+	char version[8] = "";
+	INT32 i, j;
+
+	if (!server_list)
+		return;
+
+#if VERSION > 0 || SUBVERSION > 0
+	snprintf(version, sizeof (version), "%d.%d.%d", VERSION/100, VERSION%100, SUBVERSION);
+#else
+	strcpy(version, GetRevisionString());
+#endif
+	version[sizeof (version) - 1] = '\0';
+
+	for (i = 0; server_list[i].header.buffer[0]; i++)
+	{
+		INT32 node;
+
+		// Make sure MS version matches our own, to
+		// thwart nefarious servers who lie to the MS.
+		if (strcmp(version, server_list[i].version) != 0)
+			continue;
+
+		if (skip)
+		{
+			for (j = 0; skip[j].header.buffer[0]; j++)
+				if (!strcmp(skip[j].ip, server_list[i].ip) && !strcmp(skip[j].port, server_list[i].port))
+					break;
+			if (skip[j].header.buffer[0])
+				continue;
+		}
+
+		node = I_NetMakeNodewPort(server_list[i].ip, server_list[i].port);
+		if (node == -1)
+			break; // no more node free
+		SendAskInfo(node, true);
+		// Force close the connection so that servers can't eat
+		// up nodes forever if we never get a reply back from them
+		// (usually when they've not forwarded their ports).
+		//
+		// Don't worry, we'll get in contact with the working
+		// servers again when they send SERVERINFO to us later!
+		//
+		// (Note: as a side effect this probably means every
+		// server in the list will probably be using the same node (e.g. node 1),
+		// not that it matters which nodes they use when
+		// the connections are closed afterwards anyway)
+		// -- Monster Iestyn 12/11/18
+		Net_CloseConnection(node|FORCECLOSE);
+	}
+}
+
+// The master server's list came in: ask whoever wasn't on the saved one.
+static void CL_GotServerList(const msg_server_t *server_list, INT32 room)
+{
+	if (!server_list)
+		return; /// TODO: display error or warning?
+
+	SL_AskServers(server_list, askedservers);
+	MS_SaveServersList(room, server_list);
+}
+
 void CL_UpdateServerList(boolean internetsearch, INT32 room)
 {
 	SL_ClearServerList(0);
@@ -1705,56 +2467,70 @@ void CL_UpdateServerList(boolean internetsearch, INT32 room)
 	if (internetsearch)
 	{
 		const msg_server_t *server_list;
-		INT32 i = -1;
-		server_list = GetShortServersList(room);
+
+		// Ask the servers we knew of last time right away, while the
+		// master server is asked for who's there now
+		server_list = MS_LoadServersList(room);
+		SL_AskServers(server_list, NULL);
 		if (server_list)
-		{
-			char version[8] = "";
-#if VERSION > 0 || SUBVERSION > 0
-			snprintf(version, sizeof (version), "%d.%d.%d", VERSION/100, VERSION%100, SUBVERSION);
-#else
-			strcpy(version, GetRevisionString());
-#endif
-			version[sizeof (version) - 1] = '\0';
+			M_Memcpy(askedservers, server_list, sizeof (askedservers));
+		else
+			askedservers[0].header.buffer[0] = 0;
 
-			for (i = 0; server_list[i].header.buffer[0]; i++)
-			{
-				// Make sure MS version matches our own, to
-				// thwart nefarious servers who lie to the MS.
+		if (!MS_StartServersListFetch(room))
+			CL_GotServerList(GetShortServersList(room), room);
+	}
+}
 
-				if (strcmp(version, server_list[i].version) == 0)
-				{
-					INT32 node = I_NetMakeNodewPort(server_list[i].ip, server_list[i].port);
-					if (node == -1)
-						break; // no more node free
-					SendAskInfo(node, true);
-					// Force close the connection so that servers can't eat
-					// up nodes forever if we never get a reply back from them
-					// (usually when they've not forwarded their ports).
-					//
-					// Don't worry, we'll get in contact with the working
-					// servers again when they send SERVERINFO to us later!
-					//
-					// (Note: as a side effect this probably means every
-					// server in the list will probably be using the same node (e.g. node 1),
-					// not that it matters which nodes they use when
-					// the connections are closed afterwards anyway)
-					// -- Monster Iestyn 12/11/18
-					Net_CloseConnection(node|FORCECLOSE);
-				}
-			}
-		}
+//
+// CL_PollServerList
+//
+// Asks the servers on the list from the master server, if it just arrived.
+//
+void CL_PollServerList(void)
+{
+	const msg_server_t *server_list;
+	INT32 room;
 
-		//no server list?(-1) or no servers?(0)
-		if (!i)
-		{
-			; /// TODO: display error or warning?
-		}
-	}
+	server_list = MS_PollServersList(&room);
+	if (server_list)
+		CL_GotServerList(server_list, room);
 }
 
 #endif // ifndef NONET
 
+#ifndef NONET
+/** Asks the server for the files we don't have, unless it won't send them
+  *
+  * \return False if the connection was aborted
+  * \sa CL_ServerConnectionSearchTicker
+  *
+  */
+static boolean CL_RequestMissingFiles(void)
+{
+	// can we, though?
+	if (!CL_CheckDownloadable()) // nope!
+	{
+		D_QuitNetGame();
+		CL_Reset();
+		D_StartTitle();
+		M_StartMessage(M_GetText(
+			"You cannot connect to this server\n"
+			"because you cannot download the files\n"
+			"that you are missing from the server.\n\n"
+			"See the console or log file for\n"
+			"more details.\n\n"
+			"Press ESC\n"
+		), NULL, MM_NOTHING);
+		return false;
+	}
+	// no problem if can't send packet, we will retry later
+	if (CL_SendRequestFile())
+		cl_mode = CL_DOWNLOADFILES;
+	return true;
+}
+#endif
+
 /** Called by CL_ServerConnectionTicker
   *
   * \param viams ???
@@ -1798,6 +2574,12 @@ static boolean CL_ServerConnectionSearchTicker(boolean viams, tic_t *asksent)
 
 		if (client)
 		{
+			char *httpsource = serverlist[i].info.httpsource;
+			httpsource[MAX_MIRROR_LENGTH-1] = '\0';
+#ifndef HTTPDOWNLOAD
+			(void)httpsource;
+#endif
+
 			D_ParseFileneeded(serverlist[i].info.fileneedednum,
 				serverlist[i].info.fileneeded);
 			CONS_Printf(M_GetText("Checking files...\n"));
@@ -1835,25 +2617,16 @@ static boolean CL_ServerConnectionSearchTicker(boolean viams, tic_t *asksent)
 			else
 			{
 				// must download something
-				// can we, though?
-				if (!CL_CheckDownloadable()) // nope!
+#ifdef HTTPDOWNLOAD
+				// from the server's web address, if it has one
+				if (CL_StartHTTPDownloads(httpsource))
 				{
-					D_QuitNetGame();
-					CL_Reset();
-					D_StartTitle();
-					M_StartMessage(M_GetText(
-						"You cannot connect to this server\n"
-						"because you cannot download the files\n"
-						"that you are missing from the server.\n\n"
-						"See the console or log file for\n"
-						"more details.\n\n"
-						"Press ESC\n"
-					), NULL, MM_NOTHING);
-					return false;
-				}
-				// no problem if can't send packet, we will retry later
-				if (CL_SendRequestFile())
 					cl_mode = CL_DOWNLOADFILES;
+					return true;
+				}
+#endif
+				if (!CL_RequestMissingFiles())
+					return false;
 			}
 		}
 		else
@@ -1898,14 +2671,47 @@ static boolean CL_ServerConnectionTicker(boolean viams, const char *tmpsave, tic
 	(void)tmpsave;
 #endif
 
+	if (I_NetAsyncTicker)
+		I_NetAsyncTicker(); // can finish CL_RESOLVING
+
 	switch (cl_mode)
 	{
+		case CL_RESOLVING:
+			if (!I_NetMakeNodewPortAsync) // the socket went away
+				servernode = -1;
+			else if (servernode == -1)
+				break; // still looking
+
+			if (servernode < 0 || servernode >= MAXNETNODES)
+			{
+				D_QuitNetGame();
+				CL_Reset();
+				D_StartTitle();
+				M_StartMessage(M_GetText("Couldn't find the server's address\n\nPress ESC\n"), NULL, MM_NOTHING);
+				return false;
+			}
+			cl_mode = CL_SEARCHING;
+			break;
+
 		case CL_SEARCHING:
 			if (!CL_ServerConnectionSearchTicker(viams, asksent))
 				return false;
 			break;
 
 		case CL_DOWNLOADFILES:
+#ifdef HTTPDOWNLOAD
+			if (CL_HTTPDownloadTicker())
+				break;
+
+			// Whatever the web address didn't have, ask the server for
+			for (i = 1; i < fileneedednum; i++)
+				if (fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD)
+				{
+					if (!CL_RequestMissingFiles())
+						return false;
+					break;
+				}
+#endif
 			waitmore = false;
 			for (i = 0; i < fileneedednum; i++)
 				if (fileneeded[i].status == FS_DOWNLOADING
@@ -2014,6 +2820,7 @@ static void CL_ConnectToServer(boolean viams)
 {
 	INT32 pnumnodes, nodewaited = doomcom->numnodes, i;
 	tic_t oldtic;
+	const UINT32 joinstart = I_GetTimeMicros();
 #ifndef NONET
 	tic_t asksent;
 #endif
@@ -2023,7 +2830,8 @@ static void CL_ConnectToServer(boolean viams)
 	sprintf(tmpsave, "%s" PATHSEP TMPSAVENAME, srb2home);
 #endif
 
-	cl_mode = CL_SEARCHING;
+	cl_mode = resolvingserver ? CL_RESOLVING : CL_SEARCHING;
+	resolvingserver = false;
 
 #ifdef CLIENT_LOADINGSCREEN
 	lastfilenum = -1;
@@ -2037,7 +2845,9 @@ static void CL_ConnectToServer(boolean viams)
 
 	if (netgame)
 	{
-		if (servernode < 0 || servernode >= MAXNETNODES)
+		if (cl_mode == CL_RESOLVING)
+			CONS_Printf(M_GetText("Looking up the server...\n"));
+		else if (servernode < 0 || servernode >= MAXNETNODES)
 			CONS_Printf(M_GetText("Searching for a server...\n"));
 		else
 			CONS_Printf(M_GetText("Contacting the server...\n"));
@@ -2095,6 +2905,10 @@ static void CL_ConnectToServer(boolean viams)
 
 	DEBFILE(va("Synchronisation Finished\n"));
 
+	if (loadtest)
+		CONS_Printf(M_GetText("Loadtest client %d joined in %u ms\n"), serverinstance + 1,
+			(I_GetTimeMicros() - joinstart)/1000);
+
 	displayplayer = consoleplayer;
 }
 
@@ -2253,6 +3067,15 @@ static void Command_ReloadBan(void)  //recheck ban.txt
 	Ban_Load_File(true);
 }
 
+// Where I_NetMakeNodewPortAsync reports the server's node.
+static void CL_ServerResolved(SINT8 node)
+{
+	if (cl_mode == CL_RESOLVING)
+		servernode = (node == -1) ? MAXNETNODES : node; // -1 is still looking
+	else if (node != -1)
+		Net_CloseConnection(node|FORCECLOSE); // gave up on it
+}
+
 static void Command_connect(void)
 {
 	// Assume we connect directly.
@@ -2309,6 +3132,14 @@ static void Command_connect(void)
 
 			if (!stricmp(COM_Argv(1), "any"))
 				servernode = BROADCASTADDR;
+			else if (I_NetMakeNodewPortAsync && (COM_Argc() >= 3
+				? I_NetMakeNodewPortAsync(COM_Argv(1), COM_Argv(2), CL_ServerResolved)
+				: I_NetMakeNodeAsync(COM_Argv(1), CL_ServerResolved)))
+			{
+				// CL_ConnectToServer waits for it
+				servernode = -1;
+				resolvingserver = true;
+			}
 			else if (I_NetMakeNodewPort && COM_Argc() >= 3)
 				servernode = I_NetMakeNodewPort(COM_Argv(1), COM_Argv(2));
 			else if (I_NetMakeNodewPort)
@@ -2363,7 +3194,9 @@ static void CL_RemovePlayer(INT32 playernum, INT32 reason)
 	if (!playeringame[playernum])
 		return;
 
-	if (server && !demoplayback)
+	if (server && !demoplayback && B_IsNetBot(playernum))
+		B_RemoveNetBot(playernum); // never had a node of its own
+	else if (server && !demoplayback)
 	{
 		INT32 node = playernode[playernum];
 		playerpernode[node]--;
@@ -2805,7 +3638,7 @@ static void Got_KickCmd(UINT8 **p, INT32 playernum)
 
 	// If a verified admin banned someone, the server needs to know about it.
 	// If the playernum isn't zero (the server) then the server needs to record the ban.
-	if (server && playernum && (msg == KICK_MSG_BANNED || msg == KICK_MSG_CUSTOM_BAN))
+	if (server && playernum && (msg == KICK_MSG_BANNED || msg == KICK_MSG_CUSTOM_BAN) && !B_IsNetBot(pnum))
 	{
 		if (I_Ban && !I_Ban(playernode[(INT32)pnum]))
 			CONS_Alert(CONS_WARNING, M_GetText("Too many bans! Geez, that's a lot of people you're excluding...\n"));
@@ -2918,7 +3751,7 @@ static void Got_KickCmd(UINT8 **p, INT32 playernum)
 
 consvar_t cv_allownewplayer = {"allowjoin", "On", CV_NETVAR, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL	};
 consvar_t cv_joinnextround = {"joinnextround", "Off", CV_NETVAR, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL}; /// \todo not done
-static CV_PossibleValue_t maxplayers_cons_t[] = {{2, "MIN"}, {32, "MAX"}, {0, NULL}};
+static CV_PossibleValue_t maxplayers_cons_t[] = {{2, "MIN"}, {MAXPLAYERS, "MAX"}, {0, NULL}};
 consvar_t cv_maxplayers = {"maxplayers", "8", CV_SAVE, maxplayers_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 static CV_PossibleValue_t resynchattempts_cons_t[] = {{0, "MIN"}, {20, "MAX"}, {0, NULL}};
 consvar_t cv_resynchattempts = {"resynchattempts", "10", 0, resynchattempts_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL	};
@@ -2933,7 +3766,18 @@ consvar_t cv_noticedownload = {"noticedownload", "Off", CV_SAVE, CV_OnOff, NULL,
 static CV_PossibleValue_t downloadspeed_cons_t[] = {{0, "MIN"}, {32, "MAX"}, {0, NULL}};
 consvar_t cv_downloadspeed = {"downloadspeed", "16", CV_SAVE, downloadspeed_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+#ifdef NETTHREAD
+// Answer acks on a thread of its own while drawing and loading levels
+consvar_t cv_netthread = {"netthread", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+#endif
+
+// Web address clients can download the server's files from instead,
+// with the file name put on the end
+consvar_t cv_httpsource = {"http_source", "", CV_SAVE, NULL, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 static void Got_AddPlayer(UINT8 **p, INT32 playernum);
+static void Got_AddBot(UINT8 **p, INT32 playernum);
+static void Command_Addbot_f(void);
 
 // called one time at init
 void D_ClientServerInit(void)
@@ -2951,6 +3795,12 @@ void D_ClientServerInit(void)
 	COM_AddCommand("reloadbans", Command_ReloadBan);
 	COM_AddCommand("connect", Command_connect);
 	COM_AddCommand("nodes", Command_Nodes);
+	COM_AddCommand("netstats", Command_Netstats_f);
+	COM_AddCommand("addbot", Command_Addbot_f);
+#ifdef FORKSAVEGAME
+	CV_RegisterVar(&cv_forksavegame);
+#endif
+	CV_RegisterVar(&cv_netstatslog);
 #ifdef PACKETDROP
 	COM_AddCommand("drop", Command_Drop);
 	COM_AddCommand("droprate", Command_Droprate);
@@ -2962,12 +3812,14 @@ void D_ClientServerInit(void)
 
 	RegisterNetXCmd(XD_KICK, Got_KickCmd);
 	RegisterNetXCmd(XD_ADDPLAYER, Got_AddPlayer);
+	RegisterNetXCmd(XD_ADDBOT, Got_AddBot);
 #ifndef NONET
 	CV_RegisterVar(&cv_allownewplayer);
 	CV_RegisterVar(&cv_joinnextround);
 	CV_RegisterVar(&cv_showjoinaddress);
 	CV_RegisterVar(&cv_resynchattempts);
 	CV_RegisterVar(&cv_blamecfail);
+	CV_RegisterVar(&cv_desyncdebug);
 #ifdef DUMPCONSISTENCY
 	CV_RegisterVar(&cv_dumpconsistency);
 #endif
@@ -2992,8 +3844,14 @@ static void ResetNode(INT32 node)
 	nettics[node] = gametic;
 	supposedtics[node] = gametic;
 	nodewaiting[node] = 0;
+	nodedeltatics[node] = false;
+	fingerprintask[node] = 0;
+	fingerprintasked[node] = false;
 	playerpernode[node] = 0;
 	sendingsavegame[node] = false;
+#ifdef JOININGAME
+	SV_StopSaveStream(node);
+#endif
 }
 
 void SV_ResetServer(void)
@@ -3015,6 +3873,8 @@ void SV_ResetServer(void)
 		// Make sure resynch status doesn't get carried over!
 		SV_InitResynchVars(i);
 	}
+	memset(resynch_localbaseid, 0, sizeof (resynch_localbaseid));
+	B_ResetNetBots();
 
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -3046,6 +3906,8 @@ void SV_ResetServer(void)
 	// clear server_context
 	memset(server_context, '-', 8);
 
+	SV_ClearInfoCaches();
+
 	DEBFILE("\n-=-=-=-=-=-=-= Server Reset =-=-=-=-=-=-=-\n\n");
 }
 
@@ -3162,43 +4024,158 @@ static void Got_AddPlayer(UINT8 **p, INT32 playernum)
 	// the server is creating my player
 	if (node == mynode)
 	{
-		playernode[newplayernum] = 0; // for information only
-		if (!splitscreenplayer)
-		{
-			consoleplayer = newplayernum;
-			displayplayer = newplayernum;
-			secondarydisplayplayer = newplayernum;
-			DEBFILE("spawning me\n");
-		}
-		else
-		{
-			secondarydisplayplayer = newplayernum;
-			DEBFILE("spawning my brother\n");
-			if (botingame)
-				players[newplayernum].bot = 1;
-		}
-		D_SendPlayerConfig();
-		addedtogame = true;
+		playernode[newplayernum] = 0; // for information only
+		if (!splitscreenplayer)
+		{
+			consoleplayer = newplayernum;
+			displayplayer = newplayernum;
+			secondarydisplayplayer = newplayernum;
+			DEBFILE("spawning me\n");
+		}
+		else
+		{
+			secondarydisplayplayer = newplayernum;
+			DEBFILE("spawning my brother\n");
+			if (botingame)
+				players[newplayernum].bot = 1;
+		}
+		D_SendPlayerConfig();
+		addedtogame = true;
+	}
+
+	if (netgame)
+	{
+		if (server && cv_showjoinaddress.value)
+		{
+			const char *address;
+			if (I_GetNodeAddress && (address = I_GetNodeAddress(node)) != NULL)
+				HU_AddChatText(va("\x82*Player %d has joined the game (node %d) (%s)", newplayernum+1, node, address), false);	// merge join notification + IP to avoid clogging console/chat.
+		}
+		else
+			HU_AddChatText(va("\x82*Player %d has joined the game (node %d)", newplayernum+1, node), false);	// if you don't wanna see the join address.
+	}
+
+	if (server && multiplayer && motd[0] != '\0')
+		COM_BufAddText(va("sayto %d %s\n", newplayernum, motd));
+
+#ifdef HAVE_BLUA
+	LUAh_PlayerJoin(newplayernum);
+#endif
+}
+
+// Xcmd XD_ADDBOT
+static void Got_AddBot(UINT8 **p, INT32 playernum)
+{
+	INT32 newplayernum, skin, color;
+
+	newplayernum = READUINT8(*p);
+	skin = READUINT8(*p);
+	color = READUINT8(*p);
+
+	if (playernum != serverplayer)
+	{
+		// protect against hacked/buggy client
+		CONS_Alert(CONS_WARNING, M_GetText("Illegal add bot command received from %s\n"), player_names[playernum]);
+		if (server)
+		{
+			XBOXSTATIC UINT8 buf[2];
+
+			buf[0] = (UINT8)playernum;
+			buf[1] = KICK_MSG_CON_FAIL;
+			SendNetXCmd(XD_KICK, &buf, 2);
+		}
+		return;
+	}
+
+	if (newplayernum >= MAXPLAYERS || playeringame[newplayernum])
+		return;
+
+	CL_ClearPlayer(newplayernum);
+	playeringame[newplayernum] = true;
+	G_AddPlayer(newplayernum);
+	if (newplayernum+1 > doomcom->numslots)
+		doomcom->numslots = (INT16)(newplayernum+1);
+	if (server)
+		playernode[newplayernum] = servernode; // the server sends its ticcmds
+
+	sprintf(player_names[newplayernum], "Bot %d", newplayernum+1);
+	SetPlayerSkinByNum(newplayernum, skin < numskins ? skin : 0);
+	players[newplayernum].skincolor = (UINT8)(color < MAXSKINCOLORS ? color : skins[players[newplayernum].skin].prefcolor);
+
+	HU_AddChatText(va("\x82*%s has joined the game", player_names[newplayernum]), false);
+
+#ifdef HAVE_BLUA
+	LUAh_PlayerJoin(newplayernum);
+#endif
+}
+
+//
+// SV_RemoveBot
+//
+// Takes a bot the server added out of the game
+//
+static void SV_RemoveBot(INT32 playernum)
+{
+	XBOXSTATIC UINT8 buf[2];
+
+	buf[0] = (UINT8)playernum;
+	buf[1] = KICK_MSG_PLAYER_QUIT;
+	SendNetXCmd(XD_KICK, &buf, 2);
+}
+
+//
+// Command_Addbot_f
+//
+// addbot [count] [skin]: adds bots to the netgame, which the server
+// plays for. They take the highest free player numbers, and give their
+// place up to people who join.
+//
+static void Command_Addbot_f(void)
+{
+	INT32 count = 1, skin = -1, added = 0, i;
+	XBOXSTATIC UINT8 buf[3];
+
+	if (!netgame)
+	{
+		CONS_Printf(M_GetText("This only works in a netgame.\n"));
+		return;
+	}
+	if (!server)
+	{
+		CONS_Printf(M_GetText("Only the server can add bots.\n"));
+		return;
 	}
 
-	if (netgame)
+	if (COM_Argc() > 1)
+		count = atoi(COM_Argv(1));
+	if (COM_Argc() > 2)
 	{
-		if (server && cv_showjoinaddress.value)
+		skin = R_SkinAvailable(COM_Argv(2));
+		if (skin == -1)
 		{
-			const char *address;
-			if (I_GetNodeAddress && (address = I_GetNodeAddress(node)) != NULL)
-				HU_AddChatText(va("\x82*Player %d has joined the game (node %d) (%s)", newplayernum+1, node, address), false);	// merge join notification + IP to avoid clogging console/chat.
+			CONS_Printf(M_GetText("There is no skin named %s.\n"), COM_Argv(2));
+			return;
 		}
-		else
-			HU_AddChatText(va("\x82*Player %d has joined the game (node %d)", newplayernum+1, node), false);	// if you don't wanna see the join address.
 	}
 
-	if (server && multiplayer && motd[0] != '\0')
-		COM_BufAddText(va("sayto %d %s\n", newplayernum, motd));
+	// Player 0 is kept for the server, like in SV_AddWaitingPlayers
+	for (i = MAXPLAYERS-1; i > 0 && added < count; i--)
+	{
+		if (playeringame[i] || playernode[i] != UINT8_MAX || B_IsNetBot(i))
+			continue;
+		if (D_NumPlayers() + added >= cv_maxplayers.value)
+			break;
 
-#ifdef HAVE_BLUA
-	LUAh_PlayerJoin(newplayernum);
-#endif
+		B_AddNetBot(i);
+		buf[0] = (UINT8)i;
+		buf[1] = (UINT8)(skin == -1 ? i % numskins : skin);
+		buf[2] = skins[buf[1]].prefcolor;
+		SendNetXCmd(XD_ADDBOT, &buf, 3);
+		added++;
+	}
+
+	if (added < count)
+		CONS_Printf(M_GetText("Only room for %d more bots.\n"), added);
 }
 
 static boolean SV_AddWaitingPlayers(void)
@@ -3285,6 +4262,17 @@ static boolean SV_AddWaitingPlayers(void)
 			// before accepting the join
 			I_Assert(newplayernum < MAXPLAYERS);
 
+			// Bots give up their place to people
+			if (B_IsNetBot(newplayernum))
+				SV_RemoveBot(newplayernum);
+			else if (D_NumPlayers() >= cv_maxplayers.value)
+				for (n = MAXPLAYERS-1; n > 0; n--)
+					if (B_IsNetBot(n) && playeringame[n])
+					{
+						SV_RemoveBot(n);
+						break;
+					}
+
 			playernode[newplayernum] = (UINT8)node;
 
 			buf[0] = (UINT8)node;
@@ -3371,8 +4359,11 @@ void SV_StopServer(void)
 		Y_EndIntermission();
 	gamestate = wipegamestate = GS_NULL;
 
-	localtextcmd[0] = 0;
-	localtextcmd2[0] = 0;
+	localtextcmd.size = 0;
+	localtextcmd2.size = 0;
+
+	D_StopNetRecording();
+	D_StopNetReplay();
 
 	for (i = firstticstosend; i < firstticstosend + BACKUPTICS; i++)
 		D_Clearticcmd(i);
@@ -3416,9 +4407,9 @@ static size_t TotalTextCmdPerTic(tic_t tic)
 
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
-		UINT8 *textcmd = D_GetExistingTextcmd(tic, i);
+		textcmd_t *textcmd = D_GetExistingTextcmd(tic, i);
 		if ((!i || playeringame[i]) && textcmd)
-			total += 2 + textcmd[0]; // "+2" for size and playernum
+			total += 1 + TEXTCMDSIZELEN(textcmd->size) + textcmd->size; // "+1" for playernum
 	}
 
 	return total;
@@ -3436,9 +4427,11 @@ static void HandleConnect(SINT8 node)
 	else if (netbuffer->u.clientcfg.version != VERSION
 		|| netbuffer->u.clientcfg.subversion != SUBVERSION)
 		SV_SendRefuse(node, va(M_GetText("Different SRB2 versions cannot\nplay a netgame!\n(server version %d.%d.%d)"), VERSION/100, VERSION%100, SUBVERSION));
+	else if (netbuffer->u.clientcfg.maxplayers != MAXPLAYERS)
+		SV_SendRefuse(node, va(M_GetText("The server is built\nfor %d players, not %d"), MAXPLAYERS, netbuffer->u.clientcfg.maxplayers));
 	else if (!cv_allownewplayer.value && node)
 		SV_SendRefuse(node, M_GetText("The server is not accepting\njoins for the moment"));
-	else if (D_NumPlayers() >= cv_maxplayers.value)
+	else if (D_NumPlayers() - B_NumNetBots() >= cv_maxplayers.value) // bots make room
 		SV_SendRefuse(node, va(M_GetText("Maximum players reached: %d"), cv_maxplayers.value));
 	else if (netgame && netbuffer->u.clientcfg.localplayers > 1) // Hacked client?
 		SV_SendRefuse(node, M_GetText("Too many players from\nthis node."));
@@ -3452,6 +4445,7 @@ static void HandleConnect(SINT8 node)
 
 		// client authorised to join
 		nodewaiting[node] = (UINT8)(netbuffer->u.clientcfg.localplayers - playerpernode[node]);
+		nodedeltatics[node] = (netbuffer->u.clientcfg.flags & CLIENTCFG_DELTATICS) != 0;
 		if (!nodeingame[node])
 		{
 			gamestate_t backupstate = gamestate;
@@ -3641,7 +4635,8 @@ static void HandlePacketFromAwayNode(SINT8 node)
 		case PT_SERVERCFG: // Positive response of client join request
 		{
 			INT32 j;
-			UINT8 *scp;
+			UINT8 *scp, *cfg;
+			size_t cfglen, cfgpacked;
 
 			if (server && serverrunning && node != servernode)
 			{ // but wait I thought I'm the server?
@@ -3690,9 +4685,21 @@ static void HandlePacketFromAwayNode(SINT8 node)
 				players[j].skincolor = netbuffer->u.servercfg.playercolor[j];
 			}
 
-			scp = netbuffer->u.servercfg.varlengthinputs;
+			cfglen = (UINT32)LONG(netbuffer->u.servercfg.varlengthsize);
+			cfgpacked = (UINT32)LONG(netbuffer->u.servercfg.varlengthpacked);
+			if (cfglen > SERVERCFGSIZE || cfgpacked > (size_t)doomcom->datalength-BASEPACKETSIZE-sizeof (serverconfig_pak))
+				I_Error("Received bad server config packet when trying to join");
+			cfg = malloc(cfglen);
+			if (!cfg)
+				I_Error("No more free memory for server config");
+			if (!D_UnpackBlock(netbuffer->u.servercfg.varlengthcodec,
+				netbuffer->u.servercfg.varlengthinputs, cfgpacked, cfg, cfglen))
+				I_Error("Received bad server config packet when trying to join");
+
+			scp = cfg;
 			CV_LoadPlayerNames(&scp);
 			CV_LoadNetVars(&scp);
+			free(cfg);
 #ifdef JOININGAME
 			/// \note Wait. What if a Lua script uses some global custom variables synched with the NetVars hook?
 			///       Shouldn't them be downloaded even at intermission time?
@@ -3737,6 +4744,7 @@ static void HandlePacketFromAwayNode(SINT8 node)
 			break; // This is not an "unknown packet"
 
 		case PT_SERVERTICS:
+		case PT_SERVERDELTATICS:
 			// Do not remove my own server (we have just get a out of order packet)
 			if (node == servernode)
 				break;
@@ -3763,7 +4771,7 @@ static void HandlePacketFromPlayer(SINT8 node)
 {FILESTAMP
 	XBOXSTATIC INT32 netconsole;
 	XBOXSTATIC tic_t realend, realstart;
-	XBOXSTATIC UINT8 *pak, *txtpak, numtxtpak;
+	XBOXSTATIC UINT8 *pak, *txtpak;
 	XBOXSTATIC UINT8 finalmd5[16];/* Well, it's the cool thing to do? */
 FILESTAMP
 
@@ -3784,7 +4792,7 @@ FILESTAMP
 		case PT_RESYNCHGET:
 			if (client)
 				break;
-			SV_AcknowledgeResynchAck(netconsole, netbuffer->u.resynchgot);
+			SV_AcknowledgeResynchAck(node, &netbuffer->u.resynchgot, doomcom->datalength - BASEPACKETSIZE);
 			break;
 		case PT_CLIENTCMD:
 		case PT_CLIENT2CMD:
@@ -3868,6 +4876,13 @@ FILESTAMP
 			{
 				SV_RequireResynch(node);
 
+				// Sent from NetUpdate, this packet is still needed here
+				if (cv_desyncdebug.value && !fingerprintasked[node])
+				{
+					fingerprintask[node] = realstart + 1;
+					fingerprintasked[node] = true;
+				}
+
 				if (cv_resynchattempts.value && resynch_score[node] <= (unsigned)cv_resynchattempts.value*250)
 				{
 					if (cv_blamecfail.value)
@@ -3896,6 +4911,12 @@ FILESTAMP
 			else if (resynch_score[node])
 				--resynch_score[node];
 			break;
+		case PT_FINGERPRINT:
+			if (client || !fingerprintasked[node] || netconsole < 0)
+				break;
+			D_CompareFingerprint(netconsole, netbuffer->u.fingerprint,
+				min((size_t)(doomcom->datalength - BASEPACKETSIZE), MAXFINGERPRINTSIZE));
+			break;
 		case PT_TEXTCMD2: // splitscreen special
 			netconsole = nodetoplayer2[node];
 			/* FALLTHRU */
@@ -3907,13 +4928,16 @@ FILESTAMP
 				Net_UnAcknowledgePacket(node);
 			else
 			{
-				size_t j;
+				size_t j, size;
 				tic_t tic = maketic;
-				UINT8 *textcmd;
+				const UINT8 *data = netbuffer->u.textcmd;
+				textcmd_t *textcmd;
+
+				size = D_ReadTextCmdSize(&data);
 
 				// ignore if the textcmd has a reported size of zero
 				// this shouldn't be sent at all
-				if (!netbuffer->u.textcmd[0])
+				if (!size)
 				{
 					DEBFILE(va("GetPacket: Textcmd with size 0 detected! (node %u, player %d)\n",
 						node, netconsole));
@@ -3922,11 +4946,11 @@ FILESTAMP
 				}
 
 				// ignore if the textcmd size var is actually larger than it should be
-				// BASEPACKETSIZE + 1 (for size) + textcmd[0] should == datalength
-				if (netbuffer->u.textcmd[0] > (size_t)doomcom->datalength-BASEPACKETSIZE-1)
+				// BASEPACKETSIZE + the size's bytes + size should == datalength
+				if (size > MAXTEXTCMD || size > (size_t)doomcom->datalength-BASEPACKETSIZE-TEXTCMDSIZELEN(size))
 				{
-					DEBFILE(va("GetPacket: Bad Textcmd packet size! (expected %d, actual %s, node %u, player %d)\n",
-					netbuffer->u.textcmd[0], sizeu1((size_t)doomcom->datalength-BASEPACKETSIZE-1),
+					DEBFILE(va("GetPacket: Bad Textcmd packet size! (expected %s, actual %s, node %u, player %d)\n",
+					sizeu1(size), sizeu2((size_t)doomcom->datalength-BASEPACKETSIZE-TEXTCMDSIZELEN(size)),
 						node, netconsole));
 					Net_UnAcknowledgePacket(node);
 					break;
@@ -3935,12 +4959,12 @@ FILESTAMP
 				// check if tic that we are making isn't too large else we cannot send it :(
 				// doomcom->numslots+1 "+1" since doomcom->numslots can change within this time and sent time
 				j = software_MAXPACKETLENGTH
-					- (netbuffer->u.textcmd[0]+2+BASESERVERTICSSIZE
+					- (size+3+BASESERVERTICSSIZE
 					+ (doomcom->numslots+1)*sizeof(ticcmd_t));
 
 				// search a tic that have enougth space in the ticcmd
 				while ((textcmd = D_GetExistingTextcmd(tic, netconsole)),
-					(TotalTextCmdPerTic(tic) > j || netbuffer->u.textcmd[0] + (textcmd ? textcmd[0] : 0) > MAXTEXTCMD)
+					(TotalTextCmdPerTic(tic) > j || size + (textcmd ? textcmd->size : 0) > MAXTEXTCMD)
 					&& tic < firstticstosend + BACKUPTICS)
 					tic++;
 
@@ -3957,10 +4981,10 @@ FILESTAMP
 				if (!textcmd) textcmd = D_GetTextcmd(tic, netconsole);
 
 				DEBFILE(va("textcmd put in tic %u at position %d (player %d) ftts %u mk %u\n",
-					tic, textcmd[0]+1, netconsole, firstticstosend, maketic));
+					tic, textcmd->size, netconsole, firstticstosend, maketic));
 
-				M_Memcpy(&textcmd[textcmd[0]+1], netbuffer->u.textcmd+1, netbuffer->u.textcmd[0]);
-				textcmd[0] += (UINT8)netbuffer->u.textcmd[0];
+				M_Memcpy(&textcmd->data[textcmd->size], data, size);
+				textcmd->size = (UINT16)(textcmd->size + size);
 			}
 			break;
 		case PT_LOGIN:
@@ -4045,10 +5069,12 @@ FILESTAMP
 
 			break;
 		case PT_SERVERTICS:
+		case PT_SERVERDELTATICS:
 			// Only accept PT_SERVERTICS from the server.
 			if (node != servernode)
 			{
-				CONS_Alert(CONS_WARNING, M_GetText("%s received from non-host %d\n"), "PT_SERVERTICS", node);
+				CONS_Alert(CONS_WARNING, M_GetText("%s received from non-host %d\n"),
+					netbuffer->packettype == PT_SERVERDELTATICS ? "PT_SERVERDELTATICS" : "PT_SERVERTICS", node);
 
 				if (server)
 				{
@@ -4064,7 +5090,7 @@ FILESTAMP
 			realstart = ExpandTics(netbuffer->u.serverpak.starttic);
 			realend = realstart + netbuffer->u.serverpak.numtics;
 
-			if (!txtpak)
+			if (!txtpak && netbuffer->packettype == PT_SERVERTICS)
 				txtpak = (UINT8 *)&netbuffer->u.serverpak.cmds[netbuffer->u.serverpak.numslots
 					* netbuffer->u.serverpak.numtics];
 
@@ -4083,20 +5109,23 @@ FILESTAMP
 					D_Clearticcmd(i);
 
 					// copy the tics
-					pak = G_ScpyTiccmd(netcmds[i%BACKUPTICS], pak,
-						netbuffer->u.serverpak.numslots*sizeof (ticcmd_t));
-
-					// copy the textcmds
-					numtxtpak = *txtpak++;
-					for (j = 0; j < numtxtpak; j++)
+					if (netbuffer->packettype == PT_SERVERDELTATICS)
 					{
-						INT32 k = *txtpak++; // playernum
-						const size_t txtsize = txtpak[0]+1;
-
-						if (i >= gametic) // Don't copy old net commands
-							M_Memcpy(D_GetTextcmd(i, k), txtpak, txtsize);
-						txtpak += txtsize;
+						for (j = 0; j < netbuffer->u.serverpak.numslots; j++)
+							pak = G_UndeltaTiccmd(&netcmds[i%BACKUPTICS][j], pak,
+								i == realstart ? &emptyticcmd : &netcmds[(i-1)%BACKUPTICS][j]);
+						txtpak = pak; // this tic's textcmds come next
 					}
+					else
+						pak = G_ScpyTiccmd(netcmds[i%BACKUPTICS], pak,
+							netbuffer->u.serverpak.numslots*sizeof (ticcmd_t));
+
+					// copy the textcmds
+					txtpak = D_ReadTextCmds(txtpak, i, i >= gametic); // Don't copy old net commands
+					if (!txtpak)
+						I_Error("Received a bad textcmd from the server");
+					if (netbuffer->packettype == PT_SERVERDELTATICS)
+						pak = txtpak; // and then the next tic
 				}
 
 				neededtic = realend;
@@ -4112,6 +5141,7 @@ FILESTAMP
 			}
 			break;
 		case PT_RESYNCHING:
+		case PT_RESYNCHDELTA:
 			// Only accept PT_RESYNCHING from the server.
 			if (node != servernode)
 			{
@@ -4128,7 +5158,10 @@ FILESTAMP
 				break;
 			}
 			resynch_local_inprogress = true;
-			CL_AcknowledgeResynch(&netbuffer->u.resynchpak);
+			if (netbuffer->packettype == PT_RESYNCHDELTA)
+				CL_AcknowledgeResynchDelta(&netbuffer->u.resynchdelta, doomcom->datalength - BASEPACKETSIZE);
+			else
+				CL_AcknowledgeResynch(&netbuffer->u.resynchpak);
 			break;
 #ifdef NEWPING
 		case PT_PING:
@@ -4159,6 +5192,24 @@ FILESTAMP
 
 			break;
 #endif
+		case PT_ASKFINGERPRINT:
+			// Only accept PT_ASKFINGERPRINT from the server.
+			if (node != servernode || !client)
+				break;
+			{
+				tic_t tic = (tic_t)LONG(netbuffer->u.fingerprinttic);
+				size_t length = D_WriteFingerprint(tic, netbuffer->u.fingerprint);
+
+				if (!length) // Too late, still say which tic
+				{
+					UINT8 *p = netbuffer->u.fingerprint;
+					WRITEUINT32(p, tic);
+					length = p - netbuffer->u.fingerprint;
+				}
+				netbuffer->packettype = PT_FINGERPRINT;
+				HSendPacket(servernode, true, 0, length);
+			}
+			break;
 		case PT_SERVERCFG:
 			break;
 		case PT_FILEFRAGMENT:
@@ -4253,10 +5304,6 @@ static INT16 Consistancy(void)
 {
 	INT32 i;
 	UINT32 ret = 0;
-#ifdef MOBJCONSISTANCY
-	thinker_t *th;
-	mobj_t *mo;
-#endif
 
 	DEBFILE(va("TIC %u ", gametic));
 
@@ -4279,82 +5326,77 @@ static INT16 Consistancy(void)
 		ret += P_GetRandSeed();
 
 #ifdef MOBJCONSISTANCY
-	if (!thinkercap.next)
+	ret += mobjconsistancy ^ (mobjconsistancy >> 16); // only the low 16 bits are sent
+#endif
+
+	DEBFILE(va("Consistancy = %u\n", (ret & 0xFFFF)));
+
+	return (INT16)(ret & 0xFFFF);
+}
+
+static void CL_AddPredictedCmd(const ticcmd_t *cmd)
+{
+	INT32 slot;
+
+	if (numpredictcmds == MAXPREDICTEDCMDS)
 	{
-		DEBFILE(va("Consistancy = %u\n", ret));
-		return ret;
+		firstpredictcmd = (firstpredictcmd + 1) % MAXPREDICTEDCMDS;
+		numpredictcmds--;
 	}
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
-	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
 
-		mo = (mobj_t *)th;
+	slot = (firstpredictcmd + numpredictcmds) % MAXPREDICTEDCMDS;
+	predictcmds[slot] = *cmd;
+	predicttimes[slot] = I_GetTime();
+	numpredictcmds++;
+}
+
+static boolean CL_SameTiccmd(const ticcmd_t *a, const ticcmd_t *b)
+{
+	return a->forwardmove == b->forwardmove && a->sidemove == b->sidemove
+		&& a->angleturn == b->angleturn && a->aiming == b->aiming
+		&& a->buttons == b->buttons;
+}
+
+/** Drops the sent ticcmds up to the one the server ran this tic with.
+  * If two got to the server in the same tic it only kept the last,
+  * so anything before the match is dropped too.
+  *
+  * \param cmd The local player's ticcmd, as the server sent it back
+  *
+  */
+static void CL_ConfirmPredictedCmd(const ticcmd_t *cmd)
+{
+	INT32 i;
+
+	// The server didn't get one from us, and repeated the last
+	if (!(cmd->angleturn & TICCMD_RECEIVED))
+		return;
 
-		if (mo->flags & (MF_SPECIAL | MF_SOLID | MF_PUSHABLE | MF_BOSS | MF_MISSILE | MF_SPRING | MF_MONITOR | MF_FIRE | MF_ENEMY | MF_PAIN | MF_STICKY))
+	for (i = 0; i < numpredictcmds; i++)
+		if (CL_SameTiccmd(&predictcmds[(firstpredictcmd + i) % MAXPREDICTEDCMDS], cmd))
 		{
-			ret -= mo->type;
-			ret += mo->x;
-			ret -= mo->y;
-			ret += mo->z;
-			ret -= mo->momx;
-			ret += mo->momy;
-			ret -= mo->momz;
-			ret += mo->angle;
-			ret -= mo->flags;
-			ret += mo->flags2;
-			ret -= mo->eflags;
-			if (mo->target)
-			{
-				ret += mo->target->type;
-				ret -= mo->target->x;
-				ret += mo->target->y;
-				ret -= mo->target->z;
-				ret += mo->target->momx;
-				ret -= mo->target->momy;
-				ret += mo->target->momz;
-				ret -= mo->target->angle;
-				ret += mo->target->flags;
-				ret -= mo->target->flags2;
-				ret += mo->target->eflags;
-				ret -= mo->target->state - states;
-				ret += mo->target->tics;
-				ret -= mo->target->sprite;
-				ret += mo->target->frame;
-			}
-			else
-				ret ^= 0x3333;
-			if (mo->tracer && mo->tracer->type != MT_OVERLAY)
-			{
-				ret += mo->tracer->type;
-				ret -= mo->tracer->x;
-				ret += mo->tracer->y;
-				ret -= mo->tracer->z;
-				ret += mo->tracer->momx;
-				ret -= mo->tracer->momy;
-				ret += mo->tracer->momz;
-				ret -= mo->tracer->angle;
-				ret += mo->tracer->flags;
-				ret -= mo->tracer->flags2;
-				ret += mo->tracer->eflags;
-				ret -= mo->tracer->state - states;
-				ret += mo->tracer->tics;
-				ret -= mo->tracer->sprite;
-				ret += mo->tracer->frame;
-			}
-			else
-				ret ^= 0xAAAA;
-			ret -= mo->state - states;
-			ret += mo->tics;
-			ret -= mo->sprite;
-			ret += mo->frame;
+			firstpredictcmd = (firstpredictcmd + i + 1) % MAXPREDICTEDCMDS;
+			numpredictcmds -= i + 1;
+			return;
 		}
-	}
-#endif
+}
 
-	DEBFILE(va("Consistancy = %u\n", (ret & 0xFFFF)));
+INT32 CL_GetPredictedCmds(ticcmd_t *cmds, INT32 max)
+{
+	const tic_t now = I_GetTime();
+	INT32 i, n;
 
-	return (INT16)(ret & 0xFFFF);
+	// Anything this old went missing; don't keep running on it
+	while (numpredictcmds && now - predicttimes[firstpredictcmd] > TICRATE)
+	{
+		firstpredictcmd = (firstpredictcmd + 1) % MAXPREDICTEDCMDS;
+		numpredictcmds--;
+	}
+
+	n = min(numpredictcmds, max);
+	for (i = 0; i < n; i++)
+		cmds[i] = predictcmds[(firstpredictcmd + numpredictcmds - n + i) % MAXPREDICTEDCMDS];
+	return n;
 }
 
 // send the client packet to the server
@@ -4381,6 +5423,9 @@ static void CL_SendClientCmd(void)
 		G_MoveTiccmd(&netbuffer->u.clientpak.cmd, &localcmds, 1);
 		netbuffer->u.clientpak.consistancy = SHORT(consistancy[gametic%BACKUPTICS]);
 
+		if (client && gamestate == GS_LEVEL)
+			CL_AddPredictedCmd(&localcmds);
+
 		// Send a special packet with 2 cmd for splitscreen
 		if (splitscreen || botingame)
 		{
@@ -4397,37 +5442,220 @@ static void CL_SendClientCmd(void)
 	if (cl_mode == CL_CONNECTED || dedicated)
 	{
 		// Send extra data if needed
-		if (localtextcmd[0])
+		if (localtextcmd.size)
 		{
+			UINT8 *p = D_WriteTextCmdSize(netbuffer->u.textcmd, localtextcmd.size);
+
 			netbuffer->packettype = PT_TEXTCMD;
-			M_Memcpy(netbuffer->u.textcmd,localtextcmd, localtextcmd[0]+1);
+			M_Memcpy(p, localtextcmd.data, localtextcmd.size);
 			// All extra data have been sent
-			if (HSendPacket(servernode, true, 0, localtextcmd[0]+1)) // Send can fail...
-				localtextcmd[0] = 0;
+			if (HSendPacket(servernode, true, 0, (size_t)(p - netbuffer->u.textcmd) + localtextcmd.size)) // Send can fail...
+				localtextcmd.size = 0;
 		}
 
 		// Send extra data if needed for player 2 (splitscreen)
-		if (localtextcmd2[0])
+		if (localtextcmd2.size)
 		{
+			UINT8 *p = D_WriteTextCmdSize(netbuffer->u.textcmd, localtextcmd2.size);
+
 			netbuffer->packettype = PT_TEXTCMD2;
-			M_Memcpy(netbuffer->u.textcmd, localtextcmd2, localtextcmd2[0]+1);
+			M_Memcpy(p, localtextcmd2.data, localtextcmd2.size);
 			// All extra data have been sent
-			if (HSendPacket(servernode, true, 0, localtextcmd2[0]+1)) // Send can fail...
-				localtextcmd2[0] = 0;
+			if (HSendPacket(servernode, true, 0, (size_t)(p - netbuffer->u.textcmd) + localtextcmd2.size)) // Send can fail...
+				localtextcmd2.size = 0;
+		}
+	}
+}
+
+// Size of a tic's ticcmds in PT_SERVERDELTATICS
+static size_t SV_DeltaTicSize(tic_t tic, tic_t firsttic)
+{
+	size_t size = 0;
+	INT32 j;
+
+	for (j = 0; j < doomcom->numslots; j++)
+		size += G_DeltaTiccmdSize(&netcmds[tic%BACKUPTICS][j],
+			tic == firsttic ? &emptyticcmd : &netcmds[(tic-1)%BACKUPTICS][j]);
+	return size;
+}
+
+// Writes a tic's textcmds, after their count
+UINT8 *D_WriteTextCmds(UINT8 *bufpos, tic_t tic)
+{
+	UINT8 *ntextcmd = bufpos++;
+	INT32 j;
+
+	*ntextcmd = 0;
+	for (j = 0; j < MAXPLAYERS; j++)
+	{
+		textcmd_t *textcmd = D_GetExistingTextcmd(tic, j);
+		size_t size = textcmd ? textcmd->size : 0;
+
+		if ((!j || playeringame[j]) && size)
+		{
+			(*ntextcmd)++;
+			WRITEUINT8(bufpos, j);
+			bufpos = D_WriteTextCmdSize(bufpos, size);
+			M_Memcpy(bufpos, textcmd->data, size);
+			bufpos += size;
+		}
+	}
+	return bufpos;
+}
+
+// Reads a tic's textcmds back, in place of any it had, if keep is set.
+// Returns NULL if they're bad.
+UINT8 *D_ReadTextCmds(UINT8 *bufpos, tic_t tic, boolean keep)
+{
+	UINT8 numtxtpak = *bufpos++;
+	UINT8 j;
+
+	if (keep)
+		D_FreeTextcmd(tic);
+	for (j = 0; j < numtxtpak; j++)
+	{
+		INT32 k = *bufpos++; // playernum
+		const size_t txtsize = D_ReadTextCmdSize((const UINT8 **)&bufpos);
+
+		if (k >= MAXPLAYERS || txtsize > MAXTEXTCMD)
+			return NULL;
+		if (keep)
+		{
+			textcmd_t *textcmd = D_GetTextcmd(tic, k);
+			M_Memcpy(textcmd->data, bufpos, txtsize);
+			textcmd->size = (UINT16)txtsize;
 		}
+		bufpos += txtsize;
 	}
+	return bufpos;
 }
 
 // send the server packet
 // send tic from firstticstosend to maketic-1
-static void SV_SendTics(void)
+// SV_SendTics builds each distinct packet once and copies it to every
+// node that needs the same tics; spectators usually all do.
+typedef struct
 {
-	tic_t realfirsttic, lasttictosend, i;
-	UINT32 n;
+	boolean valid;
+	tic_t firsttic, lasttic;
+	size_t size;
+	UINT8 data[MAXPACKETLENGTH];
+} builttics_t;
+
+static builttics_t builttics[2]; // plain and delta tics
+
+// When each node was last sent tics, for spacing out its packets
+static tic_t nodeticssent[MAXNETNODES];
+
+//
+// SV_TicsInterval
+//
+// How many tics to bundle into each packet to a node. Close nodes get
+// every tic as it's made; for far ones, waiting a tic or two to send
+// fewer, bigger packets costs little next to the trip itself.
+//
+static tic_t SV_TicsInterval(INT32 node)
+{
+	const tic_t rtt = Net_GetNodeRTT(node);
+
+	if (rtt < 4) // under ~115ms
+		return 1;
+	if (rtt < 8)
+		return 2;
+	return 3;
+}
+
+//
+// SV_BuildTics
+//
+// Fills netbuffer with the tics from firsttic on, as many as fit,
+// and returns the packet size. lasttic is set to one past the last.
+//
+static size_t SV_BuildTics(tic_t firsttic, boolean delta, UINT32 node, tic_t *lasttic)
+{
+	tic_t lasttictosend = maketic, i;
 	INT32 j;
 	size_t packsize;
 	UINT8 *bufpos;
-	UINT8 *ntextcmd;
+
+	// compute the length of the packet and cut it if too large
+	packsize = BASESERVERTICSSIZE;
+	for (i = firsttic; i < lasttictosend; i++)
+	{
+		if (delta)
+			packsize += SV_DeltaTicSize(i, firsttic);
+		else
+			packsize += sizeof (ticcmd_t) * doomcom->numslots;
+		packsize += TotalTextCmdPerTic(i);
+
+		if (packsize > software_MAXPACKETLENGTH)
+		{
+			DEBFILE(va("packet too large (%s) at tic %d (should be from %d to %d)\n",
+				sizeu1(packsize), i, firsttic, lasttictosend));
+			lasttictosend = i;
+
+			// too bad: too much player have send extradata and there is too
+			//          much data in one tic.
+			// To avoid it put the data on the next tic. (see getpacket
+			// textcmd case) but when numplayer changes the computation can be different
+			if (lasttictosend == firsttic)
+			{
+				if (packsize > MAXPACKETLENGTH)
+					I_Error("Too many players: can't send %s data for %d players to node %d\n"
+					        "Well sorry nobody is perfect....\n",
+					        sizeu1(packsize), doomcom->numslots, node);
+				else
+				{
+					lasttictosend++; // send it anyway!
+					DEBFILE("sending it anyway\n");
+				}
+			}
+			break;
+		}
+	}
+
+	// Send the tics
+	netbuffer->packettype = delta ? PT_SERVERDELTATICS : PT_SERVERTICS;
+	netbuffer->u.serverpak.starttic = (UINT8)firsttic;
+	netbuffer->u.serverpak.numtics = (UINT8)(lasttictosend - firsttic);
+	netbuffer->u.serverpak.numslots = (UINT8)SHORT(doomcom->numslots);
+	bufpos = (UINT8 *)&netbuffer->u.serverpak.cmds;
+
+	if (delta)
+	{
+		for (i = firsttic; i < lasttictosend; i++)
+		{
+			for (j = 0; j < doomcom->numslots; j++)
+				bufpos = G_DeltaTiccmd(bufpos, &netcmds[i%BACKUPTICS][j],
+					i == firsttic ? &emptyticcmd : &netcmds[(i-1)%BACKUPTICS][j]);
+			bufpos = D_WriteTextCmds(bufpos, i);
+		}
+	}
+	else
+	{
+		for (i = firsttic; i < lasttictosend; i++)
+		{
+			bufpos = G_DcpyTiccmd(bufpos, netcmds[i%BACKUPTICS], doomcom->numslots * sizeof (ticcmd_t));
+		}
+
+		// add textcmds
+		for (i = firsttic; i < lasttictosend; i++)
+			bufpos = D_WriteTextCmds(bufpos, i);
+	}
+
+	*lasttic = lasttictosend;
+	return bufpos - (UINT8 *)&(netbuffer->u);
+}
+
+static void SV_SendTics(void)
+{
+	tic_t realfirsttic, lasttictosend, interval;
+	const tic_t now = I_GetTime();
+	UINT32 n;
+	size_t packsize;
+	builttics_t *built;
+
+	builttics[0].valid = builttics[1].valid = false;
 
 	// send to all client but not to me
 	// for each node create a packet with x tics and send it
@@ -4435,7 +5663,7 @@ static void SV_SendTics(void)
 	for (n = 1; n < MAXNETNODES; n++)
 		if (nodeingame[n])
 		{
-			lasttictosend = maketic;
+			interval = SV_TicsInterval(n);
 
 			// assert supposedtics[n]>=nettics[n]
 			realfirsttic = supposedtics[n];
@@ -4445,84 +5673,41 @@ static void SV_SendTics(void)
 				// to resent packet that are supposed lost (this is necessary since lost
 				// packet detection work when we have received packet with firsttic > neededtic
 				// (getpacket servertics case)
+				// Don't bother before the node could have told us it got them.
 				DEBFILE(va("Nothing to send node %u mak=%u sup=%u net=%u \n",
 					n, maketic, supposedtics[n], nettics[n]));
 				realfirsttic = nettics[n];
-				if (realfirsttic >= maketic || (I_GetTime() + n)&3)
+				if (realfirsttic >= maketic
+					|| now - nodeticssent[n] < max(4, Net_GetNodeRTT(n) + 2))
 					// all tic are ok
 					continue;
 				DEBFILE(va("Sent %d anyway\n", realfirsttic));
 			}
+			else if (maketic - realfirsttic < interval && now - nodeticssent[n] < interval)
+				continue; // wait for a fuller packet
 			if (realfirsttic < firstticstosend)
 				realfirsttic = firstticstosend;
 
-			// compute the length of the packet and cut it if too large
-			packsize = BASESERVERTICSSIZE;
-			for (i = realfirsttic; i < lasttictosend; i++)
-			{
-				packsize += sizeof (ticcmd_t) * doomcom->numslots;
-				packsize += TotalTextCmdPerTic(i);
-
-				if (packsize > software_MAXPACKETLENGTH)
-				{
-					DEBFILE(va("packet too large (%s) at tic %d (should be from %d to %d)\n",
-						sizeu1(packsize), i, realfirsttic, lasttictosend));
-					lasttictosend = i;
-
-					// too bad: too much player have send extradata and there is too
-					//          much data in one tic.
-					// To avoid it put the data on the next tic. (see getpacket
-					// textcmd case) but when numplayer changes the computation can be different
-					if (lasttictosend == realfirsttic)
-					{
-						if (packsize > MAXPACKETLENGTH)
-							I_Error("Too many players: can't send %s data for %d players to node %d\n"
-							        "Well sorry nobody is perfect....\n",
-							        sizeu1(packsize), doomcom->numslots, n);
-						else
-						{
-							lasttictosend++; // send it anyway!
-							DEBFILE("sending it anyway\n");
-						}
-					}
-					break;
-				}
-			}
-
-			// Send the tics
-			netbuffer->packettype = PT_SERVERTICS;
-			netbuffer->u.serverpak.starttic = (UINT8)realfirsttic;
-			netbuffer->u.serverpak.numtics = (UINT8)(lasttictosend - realfirsttic);
-			netbuffer->u.serverpak.numslots = (UINT8)SHORT(doomcom->numslots);
-			bufpos = (UINT8 *)&netbuffer->u.serverpak.cmds;
-
-			for (i = realfirsttic; i < lasttictosend; i++)
+			built = &builttics[nodedeltatics[n] ? 1 : 0];
+			if (built->valid && built->firsttic == realfirsttic)
 			{
-				bufpos = G_DcpyTiccmd(bufpos, netcmds[i%BACKUPTICS], doomcom->numslots * sizeof (ticcmd_t));
+				netbuffer->packettype = nodedeltatics[n] ? PT_SERVERDELTATICS : PT_SERVERTICS;
+				packsize = built->size;
+				M_Memcpy(&netbuffer->u, built->data, packsize);
+				lasttictosend = built->lasttic;
 			}
-
-			// add textcmds
-			for (i = realfirsttic; i < lasttictosend; i++)
+			else
 			{
-				ntextcmd = bufpos++;
-				*ntextcmd = 0;
-				for (j = 0; j < MAXPLAYERS; j++)
-				{
-					UINT8 *textcmd = D_GetExistingTextcmd(i, j);
-					INT32 size = textcmd ? textcmd[0] : 0;
-
-					if ((!j || playeringame[j]) && size)
-					{
-						(*ntextcmd)++;
-						WRITEUINT8(bufpos, j);
-						M_Memcpy(bufpos, textcmd, size + 1);
-						bufpos += size + 1;
-					}
-				}
+				packsize = SV_BuildTics(realfirsttic, nodedeltatics[n], n, &lasttictosend);
+				built->valid = true;
+				built->firsttic = realfirsttic;
+				built->lasttic = lasttictosend;
+				built->size = packsize;
+				M_Memcpy(built->data, &netbuffer->u, packsize);
 			}
-			packsize = bufpos - (UINT8 *)&(netbuffer->u);
 
 			HSendPacket(n, false, 0, packsize);
+			nodeticssent[n] = now;
 			// when tic are too large, only one tic is sent so don't go backward!
 			if (lasttictosend-doomcom->extratics > realfirsttic)
 				supposedtics[n] = lasttictosend-doomcom->extratics;
@@ -4608,10 +5793,32 @@ static void SV_Maketic(void)
 			}
 		}
 
+	B_BuildNetBotTiccmds(netcmds[maketic%BACKUPTICS]);
+
 	// all tic are now proceed make the next
 	maketic++;
 }
 
+//
+// D_RunTic
+//
+// Runs gametic, with the netcmds and textcmds it has.
+//
+void D_RunTic(void)
+{
+	DEBFILE(va("============ Running tic %d (local %d)\n", gametic, localgametic));
+
+	D_NetRecordTic();
+	if (client)
+		CL_ConfirmPredictedCmd(&netcmds[gametic%BACKUPTICS][consoleplayer]);
+	G_Ticker((gametic % NEWTICRATERATIO) == 0);
+	ExtraDataTicker();
+	gametic++;
+	consistancy[gametic%BACKUPTICS] = Consistancy();
+	D_RecordFingerprint(gametic);
+	P_TakeSnapshot(gametic);
+}
+
 void TryRunTics(tic_t realtics)
 {
 	// the machine has lagged but it is not so bad
@@ -4635,7 +5842,7 @@ void TryRunTics(tic_t realtics)
 
 	NetUpdate();
 
-	if (demoplayback)
+	if (demoplayback || netreplaying)
 	{
 		neededtic = gametic + (realtics * cv_playbackspeed.value);
 		// start a game after a demo
@@ -4668,12 +5875,9 @@ void TryRunTics(tic_t realtics)
 			// run the count * tics
 			while (neededtic > gametic)
 			{
-				DEBFILE(va("============ Running tic %d (local %d)\n", gametic, localgametic));
-
-				G_Ticker((gametic % NEWTICRATERATIO) == 0);
-				ExtraDataTicker();
-				gametic++;
-				consistancy[gametic%BACKUPTICS] = Consistancy();
+				if (netreplaying && !D_ReadNetReplayTic())
+					break;
+				D_RunTic();
 			}
 	}
 }
@@ -4738,6 +5942,68 @@ static inline void PingUpdate(void)
 }
 #endif
 
+/** Asks the nodes that failed a synch check for their fingerprint of the
+  * tic they failed on, so the server can log what went different
+  *
+  * \sa D_CompareFingerprint
+  *
+  */
+static void SV_SendFingerprintAsks(void)
+{
+	INT32 i;
+
+	for (i = 0; i < MAXNETNODES; i++)
+	{
+		if (!fingerprintask[i])
+			continue;
+		if (nodeingame[i])
+		{
+			netbuffer->packettype = PT_ASKFINGERPRINT;
+			netbuffer->u.fingerprinttic = LONG(fingerprintask[i] - 1);
+			HSendPacket(i, true, 0, sizeof (UINT32));
+		}
+		fingerprintask[i] = 0;
+	}
+}
+
+#define LOADTESTREPORT (10*TICRATE)
+
+//
+// CL_LoadtestTicker
+//
+// Every so often, a -loadtest client reports how well the server keeps
+// up: how many tics a second it sends, how far the client lags behind
+// them, the ping, and the traffic both ways.
+//
+static void CL_LoadtestTicker(tic_t nowtime)
+{
+	static tic_t lastreport = 0, lastneededtic = 0;
+	tic_t elapsed;
+
+	Net_GetNetStat();
+
+	if (cl_mode != CL_CONNECTED || servernode < 0 || servernode >= MAXNETNODES)
+		return;
+
+	if (!lastreport)
+	{
+		lastreport = nowtime;
+		lastneededtic = neededtic;
+		return;
+	}
+
+	elapsed = nowtime - lastreport;
+	if (elapsed < LOADTESTREPORT)
+		return;
+
+	CONS_Printf(M_GetText("Loadtest client %d: server %u tics/s, %u behind, ping %d ms, in %d B/s, out %d B/s, lost %.1f%%\n"),
+		serverinstance + 1, (neededtic - lastneededtic)*TICRATE/elapsed, neededtic - gametic,
+		G_TicsToMilliseconds(Net_GetNodeRTT(servernode)), getbps, sendbps, lostpercent);
+
+	lastreport = nowtime;
+	lastneededtic = neededtic;
+}
+
 void NetUpdate(void)
 {
 	static tic_t gametime = 0;
@@ -4745,12 +6011,20 @@ void NetUpdate(void)
 	tic_t nowtime;
 	INT32 i;
 	INT32 realtics;
+	boolean released;
+	UINT32 start = 0;
 
 	nowtime = I_GetTime();
 	realtics = nowtime - gametime;
 
 	if (realtics <= 0) // nothing new to update
 		return;
+
+	if (cv_perfstats.value)
+		start = I_GetTimeMicros();
+
+	// Called from the middle of drawing a frame? Take the network back
+	released = Net_ReclaimNetwork();
 	if (realtics > 5)
 	{
 		if (server)
@@ -4761,6 +6035,9 @@ void NetUpdate(void)
 
 	gametime = nowtime;
 
+	if (I_NetAsyncTicker)
+		I_NetAsyncTicker();
+
 #ifdef NEWPING
 	if (server)
 	{
@@ -4784,20 +6061,27 @@ void NetUpdate(void)
 FILESTAMP
 	GetPackets(); // get packet from client or from server
 FILESTAMP
+	if (server)
+		SV_SendFingerprintAsks();
 	// client send the command after a receive of the server
 	// the server send before because in single player is beter
 
 	MasterClient_Ticker(); // Acking the Master Server
+#ifndef NONET
+	CL_PollServerList();
+#endif
 
 	if (client)
 	{
 		if (!resynch_local_inprogress)
 			CL_SendClientCmd(); // Send tic cmd
 		hu_resynching = resynch_local_inprogress;
+		if (loadtest)
+			CL_LoadtestTicker(nowtime);
 	}
 	else
 	{
-		if (!demoplayback)
+		if (!demoplayback && !netreplaying)
 		{
 			INT32 counts;
 
@@ -4851,7 +6135,19 @@ FILESTAMP
 		M_Ticker();
 		CON_Ticker();
 	}
+#ifdef JOININGAME
+	if (server)
+		SV_SaveStreamTicker();
+#endif
 	SV_FileSendTicker();
+	if (I_NetFlush)
+		I_NetFlush(); // send this tic's packets all at once
+
+	if (released)
+		Net_ReleaseNetwork();
+
+	if (cv_perfstats.value)
+		ps_frametime[PSF_NETUPDATE] += I_GetTimeMicros() - start;
 }
 
 /** Returns the number of players playing.
@@ -26,7 +26,10 @@
 
 // Networking and tick handling related.
 #define BACKUPTICS 32
-#define MAXTEXTCMD 256
+// A player's net commands for one tic. They have to fit in a
+// PT_SERVERTICS with every slot full, even at INETPACKETLENGTH.
+#define MAXTEXTCMD 512
+#define MAXFINGERPRINTSIZE 1024 // Biggest PT_FINGERPRINT, see d_desync.c
 //
 // Packet structure
 //
@@ -55,6 +58,10 @@ typedef enum
 	                  // If this ID changes, update masterserver definition.
 	PT_RESYNCHEND,    // Player is now resynched and is being requested to remake the gametic
 	PT_RESYNCHGET,    // Player got resynch packet
+	PT_SERVERDELTATICS, // PT_SERVERTICS with each ticcmd sent as changes from the last tic.
+	PT_ASKFINGERPRINT, // Server wants the client's fingerprint of a tic (desyncdebug).
+	PT_FINGERPRINT,   // The client's answer to PT_ASKFINGERPRINT.
+	PT_RESYNCHDELTA,  // PT_RESYNCHING as changes from one the client already got.
 
 	// Add non-PT_CANFAIL packet types here to avoid breaking MS compatibility.
 
@@ -122,6 +129,7 @@ typedef struct
 	UINT8 numtics;
 	UINT8 numslots; // "Slots filled": Highest player number in use plus one.
 	ticcmd_t cmds[45]; // Normally [BACKUPTIC][MAXPLAYERS] but too large
+	                   // In PT_SERVERDELTATICS, each tic is its ticcmd deltas then its textcmds
 } ATTRPACK servertics_pak;
 
 // Sent to client when all consistency data
@@ -138,7 +146,7 @@ typedef struct
 	fixed_t flagy[2];
 	fixed_t flagz[2];
 
-	UINT32 ingame;  // Spectator bit for each player
+	UINT8 ingame[PLAYERMASKSIZE]; // Spectator bit for each player
 	INT32 ctfteam[MAXPLAYERS]; // Which team? (can't be 1 bit, since in regular Match there are no teams)
 
 	// Resynch game scores and the like all at once
@@ -264,8 +272,29 @@ typedef struct
 	fixed_t scale;
 	fixed_t destscale;
 	fixed_t scalespeed;
+
+	UINT8 id; // so a later PT_RESYNCHDELTA can name this one as its base; 0 if it can't
 } ATTRPACK resynch_pak;
 
+#define RESYNCHWORDS ((sizeof (resynch_pak) + 3)/4)
+
+// A resynch_pak sent as the 4 byte words that changed from one the
+// client already has. The client answers 0 if it doesn't have that one.
+typedef struct
+{
+	UINT8 playernum;
+	UINT8 id;
+	UINT8 baseid;
+	UINT8 changed[(RESYNCHWORDS + 7)/8]; // bit per word of resynch_pak
+	UINT8 words[RESYNCHWORDS*4]; // the changed words, in order
+} ATTRPACK resynchdelta_pak;
+
+typedef struct
+{
+	UINT8 playernum;
+	UINT8 id; // of the resynch_pak now applied, or 0 to ask for all of it
+} ATTRPACK resynchgot_pak;
+
 typedef struct
 {
 	UINT8 version; // Different versions don't work
@@ -289,6 +318,10 @@ typedef struct
 
 	char server_context[8]; // Unique context id, generated at server startup.
 
+	UINT8 varlengthcodec; // How varlengthinputs are packed
+	UINT32 varlengthsize; // Their size unpacked
+	UINT32 varlengthpacked; // and packed
+
 	UINT8 varlengthinputs[0]; // Playernames and netvars
 } ATTRPACK serverconfig_pak;
 
@@ -309,10 +342,15 @@ typedef struct
 	UINT8 subversion; // Contains build version
 	UINT8 localplayers;
 	UINT8 mode;
+	UINT8 flags; // CLIENTCFG_ flags
+	UINT8 maxplayers; // MAXPLAYERS the client was built with, it has to match
 } ATTRPACK clientconfig_pak;
 
+#define CLIENTCFG_DELTATICS 1 // Client can take PT_SERVERDELTATICS
+
 #define MAXSERVERNAME 32
 #define MAXFILENEEDED 915
+#define MAX_MIRROR_LENGTH 256
 // This packet is too large
 typedef struct
 {
@@ -334,6 +372,7 @@ typedef struct
 	unsigned char mapmd5[16];
 	UINT8 actnum;
 	UINT8 iszone;
+	char httpsource[MAX_MIRROR_LENGTH]; // Web address to download the files from, if any
 	UINT8 fileneeded[MAXFILENEEDED]; // is filled with writexxx (byteptr.h)
 } ATTRPACK serverinfo_pak;
 
@@ -397,8 +436,9 @@ typedef struct
 		serverconfig_pak servercfg;         //         773 bytes
 		resynchend_pak resynchend;          //
 		resynch_pak resynchpak;             //
-		UINT8 resynchgot;                   //
-		UINT8 textcmd[MAXTEXTCMD+1];        //       66049 bytes (wut??? 64k??? More like 257 bytes...)
+		resynchdelta_pak resynchdelta;      //
+		resynchgot_pak resynchgot;          //
+		UINT8 textcmd[MAXTEXTCMD+2];        //         514 bytes (size, see D_WriteTextCmdSize)
 		filetx_pak filetxpak;               //         139 bytes
 		clientconfig_pak clientcfg;         //         136 bytes
 		UINT8 md5sum[16];
@@ -411,6 +451,8 @@ typedef struct
 #ifdef NEWPING
 		UINT32 pingtable[MAXPLAYERS];       //         128 bytes
 #endif
+		UINT32 fingerprinttic;              //           4 bytes
+		UINT8 fingerprint[MAXFINGERPRINTSIZE]; //     1024 bytes
 	} u; // This is needed to pack diff packet types data together
 } ATTRPACK doomdata_t;
 
@@ -476,7 +518,10 @@ extern UINT32 realpingtable[MAXPLAYERS];
 extern UINT32 playerpingtable[MAXPLAYERS];
 #endif
 
-extern consvar_t cv_joinnextround, cv_allownewplayer, cv_maxplayers, cv_resynchattempts, cv_blamecfail, cv_maxsend, cv_noticedownload, cv_downloadspeed;
+extern consvar_t cv_joinnextround, cv_allownewplayer, cv_maxplayers, cv_resynchattempts, cv_blamecfail, cv_maxsend, cv_noticedownload, cv_downloadspeed, cv_httpsource;
+#ifdef NETTHREAD
+extern consvar_t cv_netthread;
+#endif
 
 // Used in d_net, the only dependence
 tic_t ExpandTics(INT32 low);
@@ -500,6 +545,7 @@ void CL_RemoveSplitscreenPlayer(void);
 void CL_Reset(void);
 void CL_ClearPlayer(INT32 playernum);
 void CL_UpdateServerList(boolean internetsearch, INT32 room);
+void CL_PollServerList(void);
 // Is there a game running
 boolean Playing(void);
 
@@ -510,6 +556,9 @@ void D_QuitNetGame(void);
 //? How many ticks to run?
 void TryRunTics(tic_t realtic);
 
+// The ticcmds our tics are waiting on the server for, oldest first
+INT32 CL_GetPredictedCmds(ticcmd_t *cmds, INT32 max);
+
 // extra data for lmps
 // these functions scare me. they contain magic.
 /*boolean AddLmpExtradata(UINT8 **demo_p, INT32 playernum);
@@ -528,7 +577,12 @@ INT32 D_NumPlayers(void);
 void D_ResetTiccmds(void);
 
 tic_t GetLag(INT32 node);
-UINT8 GetFreeXCmdSize(void);
+size_t GetFreeXCmdSize(void);
+UINT8 *D_WriteTextCmds(UINT8 *bufpos, tic_t tic);
+UINT8 *D_ReadTextCmds(UINT8 *bufpos, tic_t tic, boolean keep);
+void D_RunTic(void);
+UINT8 *D_WriteTextCmdSize(UINT8 *p, size_t size);
+size_t D_ReadTextCmdSize(const UINT8 **p);
 
 void D_MD5PasswordPass(const UINT8 *buffer, size_t len, const char *salt, void *dest);
 
@@ -0,0 +1,396 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_desync.c
+/// \brief Per-subsystem fingerprints of the game state, to find desyncs
+///
+///        Hashing everything is far too slow to leave on, which is why
+///        Consistancy() only looks at a little. This is for tracking a
+///        desync down: turn it on, wait for the synch failure, and the
+///        log says which part of the game went different.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "byteptr.h"
+#include "d_desync.h"
+#include "dehacked.h"
+#include "g_game.h"
+#include "m_random.h"
+#include "p_local.h"
+#include "p_polyobj.h"
+#include "p_saveg.h"
+#include "r_state.h"
+#include "z_zone.h"
+#ifdef HAVE_BLUA
+#include "lua_script.h"
+#endif
+
+consvar_t cv_desyncdebug = {"desyncdebug", "Off", CV_NETVAR, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// Kept for longer than BACKUPTICS, so the server's copy of a tic
+// is still around when the client's answer gets back.
+#define FINGERPRINTTICS (BACKUPTICS*2)
+
+typedef struct
+{
+	tic_t tic;
+	UINT32 rngseed;
+	UINT32 players[MAXPLAYERS];
+	UINT32 sectors;
+	UINT32 polyobjects;
+	UINT32 lua;
+	UINT32 mobjtypes[NUMMOBJTYPES]; // summed over every mobj of the type
+} fingerprint_t;
+
+static fingerprint_t *fingerprints = NULL;
+
+// Types that didn't fit in a packet are summed into this one
+#define OTHERMOBJTYPES NUMMOBJTYPES
+
+#ifdef HAVE_BLUA
+#define LUAARCHIVESIZE (768*1024)
+static UINT8 *luaarchive = NULL;
+#endif
+
+static inline UINT32 D_Mix(UINT32 h, UINT32 v)
+{
+	return (h ^ v) * 0x01000193;
+}
+
+static UINT32 D_HashMobj(const mobj_t *mo)
+{
+	UINT32 h = 0x811C9DC5;
+
+	h = D_Mix(h, (UINT32)mo->x);
+	h = D_Mix(h, (UINT32)mo->y);
+	h = D_Mix(h, (UINT32)mo->z);
+	h = D_Mix(h, (UINT32)mo->momx);
+	h = D_Mix(h, (UINT32)mo->momy);
+	h = D_Mix(h, (UINT32)mo->momz);
+	h = D_Mix(h, mo->angle);
+	h = D_Mix(h, mo->flags);
+	h = D_Mix(h, mo->flags2);
+	h = D_Mix(h, mo->eflags);
+	h = D_Mix(h, (UINT32)mo->health);
+	h = D_Mix(h, (UINT32)(mo->state - states));
+	h = D_Mix(h, (UINT32)mo->tics);
+	h = D_Mix(h, (UINT32)mo->fuse);
+	h = D_Mix(h, (UINT32)mo->scale);
+	h = D_Mix(h, mo->target ? mo->target->type : 0x3333);
+	h = D_Mix(h, mo->tracer ? mo->tracer->type : 0xAAAA);
+	return h;
+}
+
+static UINT32 D_HashPlayer(const player_t *player)
+{
+	UINT32 h = 0x811C9DC5;
+	INT32 i;
+
+	h = D_Mix(h, player->playerstate);
+	h = D_Mix(h, player->pflags);
+	h = D_Mix(h, player->panim);
+	h = D_Mix(h, (UINT32)player->health);
+	h = D_Mix(h, (UINT32)player->lives);
+	h = D_Mix(h, player->score);
+	h = D_Mix(h, (UINT32)player->speed);
+	h = D_Mix(h, (UINT32)player->rmomx);
+	h = D_Mix(h, (UINT32)player->rmomy);
+	h = D_Mix(h, player->skin);
+	h = D_Mix(h, (UINT32)player->spectator);
+	h = D_Mix(h, (UINT32)player->ctfteam);
+	for (i = 0; i < NUMPOWERS; i++)
+		h = D_Mix(h, (UINT32)player->powers[i]);
+	if (player->mo)
+		h = D_Mix(h, D_HashMobj(player->mo));
+	return h;
+}
+
+static UINT32 D_HashSectors(void)
+{
+	UINT32 h = 0x811C9DC5;
+	size_t i;
+
+	for (i = 0; i < numsectors; i++)
+	{
+		const sector_t *sec = &sectors[i];
+		h = D_Mix(h, (UINT32)sec->floorheight);
+		h = D_Mix(h, (UINT32)sec->ceilingheight);
+		h = D_Mix(h, (UINT32)sec->floorpic);
+		h = D_Mix(h, (UINT32)sec->ceilingpic);
+		h = D_Mix(h, (UINT32)sec->lightlevel);
+		h = D_Mix(h, (UINT32)sec->special);
+		h = D_Mix(h, (UINT32)sec->tag);
+		h = D_Mix(h, (UINT32)sec->floor_xoffs);
+		h = D_Mix(h, (UINT32)sec->floor_yoffs);
+		h = D_Mix(h, (UINT32)sec->ceiling_xoffs);
+		h = D_Mix(h, (UINT32)sec->ceiling_yoffs);
+	}
+	return h;
+}
+
+static UINT32 D_HashPolyObjects(void)
+{
+	UINT32 h = 0x811C9DC5;
+#ifdef POLYOBJECTS
+	INT32 i;
+
+	for (i = 0; i < numPolyObjects; i++)
+	{
+		const polyobj_t *po = &PolyObjects[i];
+		h = D_Mix(h, (UINT32)po->id);
+		h = D_Mix(h, (UINT32)po->centerPt.x);
+		h = D_Mix(h, (UINT32)po->centerPt.y);
+		h = D_Mix(h, po->angle);
+		h = D_Mix(h, (UINT32)po->flags);
+	}
+#endif
+	return h;
+}
+
+#ifdef HAVE_BLUA
+// Hashes what a savegame would hold of Lua's variables.
+static UINT32 D_HashLua(void)
+{
+	UINT8 *oldsave_p = save_p;
+	UINT32 h = 0x811C9DC5;
+	thinker_t *th;
+	UINT8 *p;
+	INT32 i = 1;
+
+	if (!luaarchive)
+		luaarchive = Z_Malloc(LUAARCHIVESIZE, PU_STATIC, NULL);
+
+	// LUA_Archive refers to mobjs by number
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+			((mobj_t *)th)->mobjnum = i++;
+
+	save_p = luaarchive;
+	LUA_Archive();
+	if (save_p - luaarchive > LUAARCHIVESIZE)
+		I_Error("D_HashLua: Lua archive buffer overrun");
+
+	for (p = luaarchive; p < save_p; p++)
+		h = D_Mix(h, *p);
+
+	save_p = oldsave_p;
+	return h;
+}
+#endif
+
+void D_RecordFingerprint(tic_t tic)
+{
+	fingerprint_t *fp;
+	thinker_t *th;
+	INT32 i;
+
+	if (!cv_desyncdebug.value || !netgame)
+		return;
+
+	if (!fingerprints)
+		fingerprints = Z_Malloc(FINGERPRINTTICS * sizeof (*fingerprints), PU_STATIC, NULL);
+
+	fp = &fingerprints[tic % FINGERPRINTTICS];
+	memset(fp, 0, sizeof (*fp));
+	fp->tic = tic;
+	fp->rngseed = P_GetRandSeed();
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i])
+			fp->players[i] = D_HashPlayer(&players[i]);
+
+	if (gamestate == GS_LEVEL)
+	{
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		{
+			const mobj_t *mo = (const mobj_t *)th;
+
+			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+				continue;
+			if (mo->type == MT_OVERLAY)
+				continue; // client-side only
+			fp->mobjtypes[mo->type] += D_HashMobj(mo);
+		}
+
+		fp->sectors = D_HashSectors();
+		fp->polyobjects = D_HashPolyObjects();
+	}
+
+#ifdef HAVE_BLUA
+	fp->lua = D_HashLua();
+#endif
+}
+
+static fingerprint_t *D_GetFingerprint(tic_t tic)
+{
+	fingerprint_t *fp;
+
+	if (!fingerprints)
+		return NULL;
+	fp = &fingerprints[tic % FINGERPRINTTICS];
+	return fp->tic == tic ? fp : NULL;
+}
+
+size_t D_WriteFingerprint(tic_t tic, UINT8 *p)
+{
+	const fingerprint_t *fp = D_GetFingerprint(tic);
+	UINT8 *start = p, *countp;
+	UINT32 other = 0;
+	UINT16 count = 0;
+	INT32 i;
+
+	if (!fp)
+		return 0;
+
+	WRITEUINT32(p, fp->tic);
+	WRITEUINT32(p, fp->rngseed);
+	for (i = 0; i < MAXPLAYERS; i++)
+		WRITEUINT32(p, fp->players[i]);
+	WRITEUINT32(p, fp->sectors);
+	WRITEUINT32(p, fp->polyobjects);
+	WRITEUINT32(p, fp->lua);
+
+	// Only the types there are any of, as many as fit
+	countp = p;
+	WRITEUINT16(p, 0);
+	for (i = 0; i < NUMMOBJTYPES; i++)
+	{
+		if (!fp->mobjtypes[i])
+			continue;
+		if (p - start + 2*6 > MAXFINGERPRINTSIZE) // room for this and OTHERMOBJTYPES
+		{
+			other += fp->mobjtypes[i];
+			continue;
+		}
+		WRITEUINT16(p, i);
+		WRITEUINT32(p, fp->mobjtypes[i]);
+		count++;
+	}
+	if (other)
+	{
+		WRITEUINT16(p, OTHERMOBJTYPES);
+		WRITEUINT32(p, other);
+		count++;
+	}
+	WRITEUINT16(countp, count);
+
+	return p - start;
+}
+
+static void D_LogDifference(const char *what, UINT32 ours, UINT32 theirs)
+{
+	CONS_Printf("  %s: ours %08x, theirs %08x\n", what, ours, theirs);
+}
+
+static const char *D_TypeName(INT32 type)
+{
+	const char *name;
+
+	if (type == OTHERMOBJTYPES)
+		return "other types (didn't fit)";
+	name = DEH_MobjTypeName(type);
+	return name ? name : va("mobj type %d", type);
+}
+
+void D_CompareFingerprint(INT32 playernum, const UINT8 *data, size_t length)
+{
+	UINT8 *p = (UINT8 *)data;
+	const UINT8 *end = data + length;
+	const fingerprint_t *fp;
+	UINT32 theirs[NUMMOBJTYPES+1];
+	UINT32 mine[NUMMOBJTYPES+1];
+	UINT32 seed, sectorhash, polyhash, luahash;
+	UINT32 playerhash[MAXPLAYERS];
+	UINT16 count;
+	tic_t tic;
+	INT32 i, differences = 0;
+
+	if (length < 4)
+		return;
+
+	tic = READUINT32(p);
+	if (length < 4*(6 + MAXPLAYERS) + 2)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Desync with %s at tic %u, but they don't have that tic any more\n"),
+			player_names[playernum], tic);
+		return;
+	}
+	seed = READUINT32(p);
+	for (i = 0; i < MAXPLAYERS; i++)
+		playerhash[i] = READUINT32(p);
+	sectorhash = READUINT32(p);
+	polyhash = READUINT32(p);
+	luahash = READUINT32(p);
+
+	fp = D_GetFingerprint(tic);
+	if (!fp)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Desync with %s at tic %u, but that tic isn't kept any more\n"),
+			player_names[playernum], tic);
+		return;
+	}
+
+	CONS_Alert(CONS_WARNING, M_GetText("Desync with %s at tic %u:\n"), player_names[playernum], tic);
+
+	if (seed != fp->rngseed)
+	{
+		D_LogDifference("random seed", fp->rngseed, seed);
+		differences++;
+	}
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playerhash[i] != fp->players[i])
+		{
+			D_LogDifference(va("player %d (%s)", i+1, playeringame[i] ? player_names[i] : "not in game"),
+				fp->players[i], playerhash[i]);
+			differences++;
+		}
+
+	// Lay both sides out by type, the same way D_WriteFingerprint folds them
+	memset(theirs, 0, sizeof (theirs));
+	count = READUINT16(p);
+	while (count-- && p + 6 <= end)
+	{
+		UINT16 type = READUINT16(p);
+		UINT32 hash = READUINT32(p);
+		if (type <= OTHERMOBJTYPES)
+			theirs[type] = hash;
+	}
+	memset(mine, 0, sizeof (mine));
+	for (i = 0; i < NUMMOBJTYPES; i++)
+		if (theirs[OTHERMOBJTYPES] && !theirs[i])
+			mine[OTHERMOBJTYPES] += fp->mobjtypes[i];
+		else
+			mine[i] = fp->mobjtypes[i];
+
+	for (i = 0; i <= OTHERMOBJTYPES; i++)
+		if (mine[i] != theirs[i])
+		{
+			D_LogDifference(D_TypeName(i), mine[i], theirs[i]);
+			differences++;
+		}
+
+	if (sectorhash != fp->sectors)
+	{
+		D_LogDifference("sectors", fp->sectors, sectorhash);
+		differences++;
+	}
+	if (polyhash != fp->polyobjects)
+	{
+		D_LogDifference("polyobjects", fp->polyobjects, polyhash);
+		differences++;
+	}
+	if (luahash != fp->lua)
+	{
+		D_LogDifference("Lua variables", fp->lua, luahash);
+		differences++;
+	}
+
+	if (!differences)
+		CONS_Printf("  nothing fingerprinted differs; it's something else\n");
+}
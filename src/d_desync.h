@@ -0,0 +1,44 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_desync.h
+/// \brief Per-subsystem fingerprints of the game state, to find desyncs
+///
+///        With desyncdebug on, every tic the game state is hashed in parts:
+///        the random seed, each player, the mobjs of each type, sectors,
+///        polyobjects and Lua's archived variables. When a client's
+///        Consistancy() stops matching, the server asks it for its
+///        fingerprint of that tic and logs every part that differs.
+
+#ifndef __D_DESYNC__
+#define __D_DESYNC__
+
+#include "command.h"
+#include "d_clisrv.h"
+
+extern consvar_t cv_desyncdebug;
+
+/**	\brief Hashes the game state as it is after running tic.
+*/
+void D_RecordFingerprint(tic_t tic);
+
+/**	\brief Writes the fingerprint of tic for sending, if it's still kept.
+	\param	tic	the tic to write
+	\param	p	where to write it, MAXFINGERPRINTSIZE bytes at most
+	\return	the size written, or 0 if there is none for tic
+*/
+size_t D_WriteFingerprint(tic_t tic, UINT8 *p);
+
+/**	\brief Logs every part of a fingerprint that differs from ours.
+	\param	playernum	the player who sent it
+	\param	p	the fingerprint, as D_WriteFingerprint wrote it
+	\param	length	its size
+*/
+void D_CompareFingerprint(INT32 playernum, const UINT8 *p, size_t length);
+
+#endif // __D_DESYNC__
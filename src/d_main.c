@@ -24,6 +24,12 @@
 #include <unistd.h> // for getcwd
 #endif
 
+#if defined (UNIXCOMMON) && !defined (NONET) && !defined (__CYGWIN__)
+#define FORKINSTANCES
+#include <sys/wait.h>
+#include <errno.h>
+#endif
+
 #ifdef PC_DOS
 #include <stdio.h> // for snprintf
 int	snprintf(char *str, size_t n, const char *fmt, ...);
@@ -52,12 +58,18 @@ int	snprintf(char *str, size_t n, const char *fmt, ...);
 #include "i_system.h"
 #include "i_video.h"
 #include "m_argv.h"
+#include "m_bench.h"
+#include "m_trace.h"
 #include "m_menu.h"
 #include "m_misc.h"
+#include "m_perfstats.h"
 #include "p_setup.h"
 #include "p_saveg.h"
+#include "p_predict.h"
+#include "p_warmup.h"
 #include "r_main.h"
 #include "r_local.h"
+#include "r_fps.h"
 #include "s_sound.h"
 #include "st_stuff.h"
 #include "v_video.h"
@@ -65,6 +77,7 @@ int	snprintf(char *str, size_t n, const char *fmt, ...);
 #include "z_zone.h"
 #include "d_main.h"
 #include "d_netfil.h"
+#include "d_netcmd.h" // cv_playername
 #include "m_cheat.h"
 #include "y_inter.h"
 #include "p_local.h" // chasecam
@@ -163,6 +176,11 @@ INT32 eventhead, eventtail;
 
 boolean dedicated = false;
 
+INT32 serverinstance = 0;
+static INT32 numinstances = 1;
+
+INT32 loadtest = 0;
+
 //
 // D_PostEvent
 // Called by the I/O functions when input is detected
@@ -219,7 +237,7 @@ void D_ProcessEvents(void)
 }
 
 //
-// D_Display
+// D_DrawDisplay
 // draw current display, possibly wiping it from the previous
 //
 
@@ -227,11 +245,15 @@ void D_ProcessEvents(void)
 // added comment : there is a wipe eatch change of the gamestate
 gamestate_t wipegamestate = GS_LEVEL;
 
-static void D_Display(void)
+static void D_DrawDisplay(void)
 {
 	boolean forcerefresh = false;
 	static boolean wipe = false;
 	INT32 wipedefindex = 0;
+	UINT32 sectionstart = 0; // for perfstats
+#ifdef HWRENDER
+	UINT32 drawstart;
+#endif
 
 	if (dedicated)
 		return;
@@ -239,6 +261,10 @@ static void D_Display(void)
 	if (nodrawers)
 		return; // for comparative timing/profiling
 
+#ifdef HWRENDER
+	drawstart = I_GetTimeMicros(); // for HWR_UpdateRenderScale
+#endif
+
 	// check for change of screen size (video mode)
 	if (setmodeneeded && !wipe)
 		SCR_SetMode(); // change video mode
@@ -350,9 +376,18 @@ static void D_Display(void)
 
 	if (gamestate == GS_LEVEL)
 	{
+		if (benchrendering)
+			M_BenchFrameStart();
+
 		// draw the view directly
 		if (cv_renderview.value && !automapactive)
 		{
+			if (cv_perfstats.value)
+				sectionstart = I_GetTimeMicros();
+			R_ResetPlaneStats();
+			P_PredictPlayer();
+			R_InterpolateState();
+
 			if (players[displayplayer].mo || players[displayplayer].playerstate == PST_DEAD)
 			{
 				topleft = screens[0] + viewwindowy*vid.width + viewwindowx;
@@ -388,6 +423,16 @@ static void D_Display(void)
 				}
 			}
 
+			// The first split screen view may still be being drawn
+			if (rendermode == render_soft)
+				R_WaitDrawQueue();
+
+			if (cv_perfstats.value)
+				ps_frametime[rendermode == render_soft ? PSF_SOFTRENDER : PSF_GLRENDER] +=
+					I_GetTimeMicros() - sectionstart;
+
+			BENCH_STAGE(BR_HUD);
+
 			// Image postprocessing effect
 			if (rendermode == render_soft)
 			{
@@ -396,6 +441,10 @@ static void D_Display(void)
 				if (postimgtype2)
 					V_DoPostProcessor(1, postimgtype2, postimgparam2);
 			}
+
+			// Before the HUD, so Lua never sees the in-between positions
+			R_RestoreInterpolationState();
+			P_UnpredictPlayer();
 		}
 
 		if (lastdraw)
@@ -410,6 +459,9 @@ static void D_Display(void)
 
 		ST_Drawer();
 		HU_Drawer();
+
+		if (cv_planestats.value && rendermode == render_soft && cv_renderview.value && !automapactive)
+			SCR_DisplayPlaneStats();
 	}
 
 	// change gamma if needed
@@ -489,10 +541,43 @@ static void D_Display(void)
 			V_DrawRightAlignedString(BASEVIDWIDTH, BASEVIDHEIGHT-ST_HEIGHT-10, V_YELLOWMAP, s);
 		}
 
+		if (cv_perfstats.value)
+			PS_DrawPerfStats();
+
+		BENCH_STAGE(BR_PRESENT);
+
+#ifdef HWRENDER
+		if (rendermode == render_opengl)
+			HWR_UpdateRenderStats();
+#endif
+
+		if (cv_perfstats.value)
+			sectionstart = I_GetTimeMicros();
 		I_FinishUpdate(); // page flip or blit buffer
+		if (cv_perfstats.value)
+		{
+			ps_frametime[PSF_PRESENT] += I_GetTimeMicros() - sectionstart;
+			PS_EndFrame();
+		}
+
+		if (benchrendering)
+			M_BenchFrameEnd();
+
+#ifdef HWRENDER
+		if (rendermode == render_opengl)
+			HWR_UpdateRenderScale(I_GetTimeMicros() - drawstart);
+#endif
 	}
 }
 
+// Drawing never sends packets, so the network thread can answer them meanwhile
+static void D_Display(void)
+{
+	Net_ReleaseNetwork();
+	D_DrawDisplay();
+	Net_ReclaimNetwork();
+}
+
 // =========================================================================
 // D_SRB2Loop
 // =========================================================================
@@ -502,6 +587,7 @@ tic_t rendergametic;
 void D_SRB2Loop(void)
 {
 	tic_t oldentertics = 0, entertic = 0, realtics = 0, rendertimeout = INFTICS;
+	UINT32 ticstartmicros = 0;
 
 	if (dedicated)
 		server = true;
@@ -511,8 +597,12 @@ void D_SRB2Loop(void)
 
 	// Pushing of + parameters is now done back in D_SRB2Main, not here.
 
+	TRACE_BEGIN("main", "D_SRB2Loop setup");
+
 	CONS_Printf("I_StartupKeyboard()...\n");
+	TRACE_BEGIN("main", "I_StartupKeyboard");
 	I_StartupKeyboard();
+	TRACE_END();
 
 #ifdef _WINDOWS
 	CONS_Printf("I_StartupMouse()...\n");
@@ -525,8 +615,10 @@ void D_SRB2Loop(void)
 	con_startup = false;
 
 	// make sure to do a d_display to init mode _before_ load a level
+	TRACE_BEGIN("video", "SCR_SetMode");
 	SCR_SetMode(); // change video mode
 	SCR_Recalc();
+	TRACE_END();
 
 	// Check and print which version is executed.
 	// Use this as the border between setup and the main game loop being entered.
@@ -544,6 +636,8 @@ void D_SRB2Loop(void)
 		V_DrawScaledPatch(0, 0, 0, (patch_t *)W_CacheLumpNum(W_GetNumForName("CONSBACK"), PU_CACHE));
 	I_FinishUpdate(); // page flip or blit buffer
 
+	TRACE_END();
+
 	for (;;)
 	{
 		if (lastwipetic)
@@ -556,8 +650,11 @@ void D_SRB2Loop(void)
 		entertic = I_GetTime();
 		realtics = entertic - oldentertics;
 		oldentertics = entertic;
+		if (realtics)
+			ticstartmicros = I_GetTimeMicros();
 
 		refreshdirmenu = 0; // not sure where to put this, here as good as any?
+		FIL_ReportWrites();
 
 #ifdef DEBUGFILE
 		if (!realtics)
@@ -567,7 +664,41 @@ void D_SRB2Loop(void)
 
 		if (!realtics && !singletics)
 		{
-			I_Sleep();
+#ifdef HAVE_BLUA
+			LUA_IdleGC(); // no tic is due, so now's a good time
+#endif
+
+			if (dedicated)
+			{
+				// Nothing to draw, so sleep on the socket until a packet
+				// comes in or the next tic is due, rather than polling.
+				UINT32 elapsed = I_GetTimeMicros() - ticstartmicros;
+				UINT32 timeout = elapsed < 1000000/TICRATE ? 1000000/TICRATE - elapsed : 0;
+
+				// Our clock and I_GetTime's don't quite agree; check back soon
+				if (timeout < 1000)
+					timeout = 1000;
+
+				if (Net_WaitForPacket(timeout))
+					TryRunTics(0); // answer it now, not next tic
+				continue;
+			}
+
+			// No tic to run, but the view can still move on a bit.
+			if (R_UsingFrameInterpolation())
+			{
+				if (R_WaitForNextFrame())
+				{
+					if (cv_lateinput.value)
+					{
+						I_OsPolling();
+						D_ProcessEvents();
+					}
+					D_Display();
+				}
+			}
+			else
+				I_Sleep();
 			continue;
 		}
 
@@ -649,6 +780,8 @@ void D_AdvanceDemo(void)
 void D_StartTitle(void)
 {
 	INT32 i;
+
+	P_SaveWarmupTrace();
 	if (netgame)
 	{
 		if (gametype == GT_COOP)
@@ -866,6 +999,67 @@ static inline void D_Titlebar(char *title1, char *title2)
 //
 // Center the title string, then add the date and time of compilation.
 //
+#ifdef FORKINSTANCES
+#define MAXINSTANCES 16
+
+//
+// D_ForkInstances
+//
+// -instances n on a dedicated server starts n-1 copies of it once the
+// addons are in, each hosting its own game on the next port up, with
+// settings from adedserv<instance>.cfg. The copies share every page
+// none of them writes to, which is most of the loaded wads, lumps and
+// tables, so extra games cost far less than extra servers.
+//
+// -loadtest n does the same for its clients, up to MAXPLAYERS of them.
+//
+static void D_ForkInstances(void)
+{
+	INT32 i;
+	pid_t pid;
+
+	if (loadtest)
+		numinstances = loadtest;
+	else if (!dedicated || !M_CheckParm("-instances") || !M_IsNextParm())
+		return;
+	else
+		numinstances = atoi(M_GetNextParm());
+
+	if (numinstances > MAXINSTANCES && !loadtest)
+		numinstances = MAXINSTANCES;
+	if (numinstances <= 1)
+	{
+		numinstances = 1;
+		return;
+	}
+
+	fflush(NULL); // or the copies print what's buffered again
+	for (i = 1; i < numinstances; i++)
+	{
+		pid = fork();
+		if (pid == -1)
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("Couldn't start instance %d: %s\n"), i, strerror(errno));
+			break;
+		}
+
+		if (pid == 0)
+		{
+			// Fork again and let the middle one go, so nobody
+			// has to wait on an instance that quits
+			if (fork() != 0)
+				_exit(0);
+			serverinstance = i;
+			break;
+		}
+
+		waitpid(pid, NULL, 0);
+	}
+
+	CONS_Printf(M_GetText("Instance %d of %d\n"), serverinstance, numinstances);
+}
+#endif
+
 static inline void D_MakeTitleString(char *s)
 {
 	char temp[82];
@@ -931,6 +1125,9 @@ void D_SRB2Main(void)
 	// get parameters from a response file (eg: srb2 @parms.txt)
 	M_FindResponseFile();
 
+	// -startupprofile times everything from here to the first level
+	M_StartTrace();
+
 	// MAINCFG is now taken care of where "OBJCTCFG" is handled
 	G_LoadGameSettings();
 
@@ -954,6 +1151,26 @@ void D_SRB2Main(void)
 #if !defined (_WINDOWS) //already check in win_main.c
 	dedicated = M_CheckParm("-dedicated") != 0;
 #endif
+	// benchmarking runs headless, like a dedicated server, but not as one
+	if (M_CheckParm("-benchdemo"))
+		dedicated = true;
+
+	// -loadtest n joins the -connect server with n headless clients
+	if (M_CheckParm("-loadtest"))
+	{
+		if (!M_IsNextParm())
+			I_Error("syntax: -loadtest <clients>");
+		loadtest = atoi(M_GetNextParm());
+		if (loadtest < 1)
+			loadtest = 1;
+		else if (loadtest > MAXPLAYERS)
+			loadtest = MAXPLAYERS;
+		if (dedicated)
+			I_Error("-loadtest can't be used with -dedicated");
+		if (!M_CheckParm("-connect"))
+			I_Error("-loadtest needs a server to -connect to");
+		nodrawers = true;
+	}
 
 	strcpy(title, "Sonic Robo Blast 2");
 	strcpy(srb2, "Sonic Robo Blast 2");
@@ -1061,7 +1278,7 @@ void D_SRB2Main(void)
 
 	// get map from parms
 
-	if (M_CheckParm("-server") || dedicated)
+	if (M_CheckParm("-server") || (dedicated && !M_CheckParm("-benchdemo")))
 		netgame = server = true;
 
 	if (M_CheckParm("-warp") && M_IsNextParm())
@@ -1085,7 +1302,9 @@ void D_SRB2Main(void)
 	}
 
 	CONS_Printf("Z_Init(): Init zone memory allocation daemon. \n");
+	TRACE_BEGIN("main", "Z_Init");
 	Z_Init();
+	TRACE_END();
 
 	// adapt tables to SRB2's needs, including extra slots for dehacked file support
 	P_PatchInfoTables();
@@ -1108,12 +1327,14 @@ void D_SRB2Main(void)
 
 	// load wad, including the main wad file
 	CONS_Printf("W_InitMultipleFiles(): Adding IWAD and main PWADs.\n");
+	TRACE_BEGIN("wad", "W_InitMultipleFiles");
 	if (!W_InitMultipleFiles(startupwadfiles))
 #ifdef _DEBUG
 		CONS_Error("A WAD file was not found or not valid.\nCheck the log to see which ones.\n");
 #else
 		I_Error("A WAD file was not found or not valid.\nCheck the log to see which ones.\n");
 #endif
+	TRACE_END();
 	D_CleanFile();
 
 	mainwads = 0;
@@ -1153,7 +1374,9 @@ void D_SRB2Main(void)
 	// we need to check for dedicated before initialization of some subsystems
 
 	CONS_Printf("I_StartupGraphics()...\n");
+	TRACE_BEGIN("video", "I_StartupGraphics");
 	I_StartupGraphics();
+	TRACE_END();
 
 	//--------------------------------------------------------- CONSOLE
 	// setup loading screen
@@ -1161,8 +1384,11 @@ void D_SRB2Main(void)
 
 	// we need the font of the console
 	CONS_Printf("HU_Init(): Setting up heads up display.\n");
+	TRACE_BEGIN("main", "HU_Init");
 	HU_Init();
+	TRACE_END();
 
+	TRACE_BEGIN("main", "Console and commands");
 	COM_Init();
 	// libogc has a CON_Init function, we must rename SRB2's CON_Init in WII/libogc
 #ifndef _WII
@@ -1177,11 +1403,16 @@ void D_SRB2Main(void)
 	S_RegisterSoundStuff();
 
 	I_RegisterSysCommands();
+	TRACE_END();
 
 	//--------------------------------------------------------- CONFIG.CFG
+	TRACE_BEGIN("main", "M_FirstLoadConfig");
 	M_FirstLoadConfig(); // WARNING : this do a "COM_BufExecute()"
+	TRACE_END();
 
+	TRACE_BEGIN("main", "G_LoadGameData");
 	G_LoadGameData();
+	TRACE_END();
 
 #if (defined (__unix__) && !defined (MSDOS)) || defined (UNIXCOMMON) || defined (HAVE_SDL)
 	VID_PrepareModeList(); // Regenerate Modelist according to cv_fullscreen
@@ -1204,13 +1435,17 @@ void D_SRB2Main(void)
 		COM_BufAddText("downloading 0\n");
 
 	CONS_Printf("M_Init(): Init miscellaneous info.\n");
+	TRACE_BEGIN("main", "M_Init");
 	M_Init();
+	TRACE_END();
 
 	CONS_Printf("R_Init(): Init SRB2 refresh daemon.\n");
+	TRACE_BEGIN("render", "R_Init");
 	R_Init();
+	TRACE_END();
 
 	// setting up sound
-	if (dedicated)
+	if (dedicated || loadtest)
 	{
 		sound_disabled = true;
 		midi_disabled = digital_disabled = true;
@@ -1230,12 +1465,22 @@ void D_SRB2Main(void)
 		if (M_CheckParm("-nodigmusic"))
 			digital_disabled = true; // WARNING: DOS version initmusic in I_StartupSound
 	}
+	TRACE_BEGIN("sound", "S_Init");
+	TRACE_BEGIN("sound", "I_StartupSound");
 	I_StartupSound();
+	TRACE_END();
+	TRACE_BEGIN("sound", "I_InitMusic");
 	I_InitMusic();
+	TRACE_END();
+	TRACE_BEGIN("sound", "S_InitSfxChannels");
 	S_InitSfxChannels(cv_soundvolume.value);
+	TRACE_END();
+	TRACE_END();
 
 	CONS_Printf("ST_Init(): Init status bar.\n");
+	TRACE_BEGIN("main", "ST_Init");
 	ST_Init();
+	TRACE_END();
 
 	if (M_CheckParm("-room"))
 	{
@@ -1248,10 +1493,16 @@ void D_SRB2Main(void)
 #endif
 	}
 
+#ifdef FORKINSTANCES
+	D_ForkInstances();
+#endif
+
 	// init all NETWORK
 	CONS_Printf("D_CheckNetGame(): Checking network game status.\n");
+	TRACE_BEGIN("net", "D_CheckNetGame");
 	if (D_CheckNetGame())
 		autostart = true;
+	TRACE_END();
 
 	// check for a driver that wants intermission stats
 	// start the apropriate game based on parms
@@ -1268,10 +1519,18 @@ void D_SRB2Main(void)
 
 	// user settings come before "+" parameters.
 	if (dedicated)
+	{
 		COM_ImmedExecute(va("exec \"%s"PATHSEP"adedserv.cfg\"\n", srb2home));
+		if (numinstances > 1)
+			COM_ImmedExecute(va("exec \"%s"PATHSEP"adedserv%d.cfg\" -noerror\n", srb2home, serverinstance));
+	}
 	else
 		COM_ImmedExecute(va("exec \"%s"PATHSEP"autoexec.cfg\" -noerror\n", srb2home));
 
+	// so the server can tell the clients apart
+	if (loadtest)
+		CV_StealthSet(&cv_playername, va("Loadtest%d", serverinstance + 1));
+
 	if (!autostart)
 		M_PushSpecialParameters(); // push all "+" parameters at the command buffer
 
@@ -1279,6 +1538,10 @@ void D_SRB2Main(void)
 	p = M_CheckParm("-playdemo");
 	if (!p)
 		p = M_CheckParm("-timedemo");
+	if (!p)
+		p = M_CheckParm("-benchdemo");
+	if (!p)
+		p = M_CheckParm("-benchrender");
 	if (p && M_IsNextParm())
 	{
 		char tmp[MAX_WADPATH];
@@ -1303,6 +1566,22 @@ void D_SRB2Main(void)
 			singledemo = true; // quit after one demo
 			G_DeferedPlayDemo(tmp);
 		}
+		else if (M_CheckParm("-benchdemo"))
+		{
+			// quits once it's done
+			COM_BufAddText(va("benchdemo \"%s\"", tmp));
+			if (M_CheckParm("-benchout") && M_IsNextParm())
+				COM_BufAddText(va(" \"%s\"", M_GetNextParm()));
+			COM_BufAddText("\n");
+		}
+		else if (M_CheckParm("-benchrender"))
+		{
+			// quits once it's done too, but draws everything
+			COM_BufAddText(va("benchrender \"%s\"", tmp));
+			if (M_CheckParm("-benchout") && M_IsNextParm())
+				COM_BufAddText(va(" \"%s\"", M_GetNextParm()));
+			COM_BufAddText("\n");
+		}
 		else
 			G_TimeDemo(tmp);
 
@@ -27,6 +27,12 @@ extern boolean usehome; //Alam: which path?
 extern const char *pandf; //Alam: how to path?
 extern char srb2path[256]; //Alam: SRB2's Home
 
+// Which of the dedicated servers started by -instances this is, 0 for the first
+extern INT32 serverinstance;
+
+// How many clients -loadtest runs, 0 normally. Each one is an instance.
+extern INT32 loadtest;
+
 // the infinite loop of D_SRB2Loop() called from win_main for windows version
 void D_SRB2Loop(void) FUNCNORETURN;
 
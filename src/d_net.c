@@ -28,6 +28,7 @@
 #include "z_zone.h"
 #include "i_tcp.h"
 #include "d_main.h" // srb2home
+#include "i_threads.h"
 
 //
 // NETWORKING
@@ -67,11 +68,15 @@ INT16 hardware_MAXPACKETLENGTH;
 
 boolean (*I_NetGet)(void) = NULL;
 void (*I_NetSend)(void) = NULL;
+void (*I_NetFlush)(void) = NULL;
 boolean (*I_NetCanSend)(void) = NULL;
 boolean (*I_NetCanGet)(void) = NULL;
+boolean (*I_NetWaitForPacket)(UINT32 timeout) = NULL;
 void (*I_NetCloseSocket)(void) = NULL;
 void (*I_NetFreeNodenum)(INT32 nodenum) = NULL;
 SINT8 (*I_NetMakeNodewPort)(const char *address, const char* port) = NULL;
+boolean (*I_NetMakeNodewPortAsync)(const char *address, const char *port, void (*done)(SINT8 node)) = NULL;
+void (*I_NetAsyncTicker)(void) = NULL;
 boolean (*I_NetOpenSocket)(void) = NULL;
 boolean (*I_Ban) (INT32 node) = NULL;
 void (*I_ClearBans)(void) = NULL;
@@ -95,6 +100,48 @@ INT32 getbps, sendbps;
 float lostpercent, duppercent, gamelostpercent;
 INT32 packetheaderlength;
 
+/// \warning Keep this up-to-date if you add/remove/rename packet types
+static const char *packettypename[NUMPACKETTYPE] =
+{
+	"NOTHING",
+	"SERVERCFG",
+	"CLIENTCMD",
+	"CLIENTMIS",
+	"CLIENT2CMD",
+	"CLIENT2MIS",
+	"NODEKEEPALIVE",
+	"NODEKEEPALIVEMIS",
+	"SERVERTICS",
+	"SERVERREFUSE",
+	"SERVERSHUTDOWN",
+	"CLIENTQUIT",
+
+	"ASKINFO",
+	"SERVERINFO",
+	"PLAYERINFO",
+	"REQUESTFILE",
+	"ASKINFOVIAMS",
+
+	"RESYNCHEND",
+	"RESYNCHGET",
+	"SERVERDELTATICS",
+	"ASKFINGERPRINT",
+	"FINGERPRINT",
+	"RESYNCHDELTA",
+
+	"FILEFRAGMENT",
+	"TEXTCMD",
+	"TEXTCMD2",
+	"CLIENTJOIN",
+	"NODETIMEOUT",
+	"RESYNCHING",
+
+	"LOGIN",
+#ifdef NEWPING
+	"PING"
+#endif
+};
+
 boolean Net_GetNetStat(void)
 {
 	const tic_t t = I_GetTime();
@@ -129,6 +176,198 @@ boolean Net_GetNetStat(void)
 	return 0;
 }
 
+// -----------------------------------------------------------------
+// Long running counters for sizing servers, by packet type and by node.
+// They're never cleared on their own; netstats reset does that, and a
+// node's are cleared when its connection closes.
+// -----------------------------------------------------------------
+
+#define NUMRTTBUCKETS 8
+static const UINT32 rttbucketms[NUMRTTBUCKETS-1] = {50, 100, 150, 200, 300, 500, 1000};
+
+typedef struct
+{
+	UINT32 packets;
+	UINT64 bytes;
+} netcounter_t;
+
+typedef struct
+{
+	netcounter_t sent, got;
+	UINT32 retransmits; // reliable packets Net_AckTicker had to send again
+	UINT32 dupacks; // packets that came in again after we had them
+	UINT32 rtt[NUMRTTBUCKETS]; // round trips of acked packets, by rttbucketms
+} nodestats_t;
+
+static netcounter_t sentbytype[NUMPACKETTYPE], gotbytype[NUMPACKETTYPE];
+static nodestats_t nodestats[MAXNETNODES];
+static tic_t netstatsstart;
+
+static CV_PossibleValue_t netstatslog_cons_t[] = {{0, "MIN"}, {3600, "MAX"}, {0, NULL}};
+consvar_t cv_netstatslog = {"netstatslog", "0", CV_SAVE, netstatslog_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static void Net_CountPacket(netcounter_t *bytype, nodestats_t *stats, boolean sent, size_t length)
+{
+	const UINT8 type = netbuffer->packettype;
+	netcounter_t *bynode;
+
+	if (type < NUMPACKETTYPE)
+	{
+		bytype[type].packets++;
+		bytype[type].bytes += length;
+	}
+
+	if (!stats)
+		return;
+	bynode = sent ? &stats->sent : &stats->got;
+	bynode->packets++;
+	bynode->bytes += length;
+}
+
+static void Net_CountRTT(INT32 node, tic_t rtt)
+{
+	const UINT32 ms = (UINT32)(rtt*1000/TICRATE);
+	INT32 i;
+
+	for (i = 0; i < NUMRTTBUCKETS-1; i++)
+		if (ms < rttbucketms[i])
+			break;
+	nodestats[node].rtt[i]++;
+}
+
+static void Net_ClearNodeStats(INT32 node)
+{
+	memset(&nodestats[node], 0, sizeof (nodestats[node]));
+}
+
+static const char *Net_NodeStatsName(INT32 node)
+{
+	const char *address = NULL;
+
+	if (node == 0)
+		return "self";
+	if (I_GetNodeAddress)
+		address = I_GetNodeAddress(node);
+	return address ? address : "?";
+}
+
+/** The netstats command: dumps the counters, or clears them with "reset".
+  */
+void Command_Netstats_f(void)
+{
+	const tic_t secs = (I_GetTime() - netstatsstart)/TICRATE;
+	INT32 i, j;
+
+	if (COM_Argc() > 1 && !stricmp(COM_Argv(1), "reset"))
+	{
+		memset(sentbytype, 0, sizeof (sentbytype));
+		memset(gotbytype, 0, sizeof (gotbytype));
+		memset(nodestats, 0, sizeof (nodestats));
+		netstatsstart = I_GetTime();
+		CONS_Printf(M_GetText("Net stats cleared.\n"));
+		return;
+	}
+
+	CONS_Printf(M_GetText("Over the last %u seconds:\n"), secs);
+	CONS_Printf("%-17s %9s %11s %9s %11s\n", "type", "sent", "bytes", "got", "bytes");
+	for (i = 0; i < NUMPACKETTYPE; i++)
+	{
+		if (!sentbytype[i].packets && !gotbytype[i].packets)
+			continue;
+		CONS_Printf("%-17s %9u %11s %9u %11s\n", packettypename[i] ? packettypename[i] : "?",
+			sentbytype[i].packets, sizeu1((size_t)sentbytype[i].bytes),
+			gotbytype[i].packets, sizeu2((size_t)gotbytype[i].bytes));
+	}
+
+	for (i = 0; i < MAXNETNODES; i++)
+	{
+		const nodestats_t *stats = &nodestats[i];
+
+		if (!stats->sent.packets && !stats->got.packets)
+			continue;
+
+		CONS_Printf(M_GetText("Node %d (%s): sent %u (%s bytes), got %u (%s bytes), %u resent, %u duplicate\n"),
+			i, Net_NodeStatsName(i),
+			stats->sent.packets, sizeu1((size_t)stats->sent.bytes),
+			stats->got.packets, sizeu2((size_t)stats->got.bytes),
+			stats->retransmits, stats->dupacks);
+
+		CONS_Printf("  rtt ms:");
+		for (j = 0; j < NUMRTTBUCKETS; j++)
+		{
+			if (j < NUMRTTBUCKETS-1)
+				CONS_Printf(" <%u:%u", rttbucketms[j], stats->rtt[j]);
+			else
+				CONS_Printf(" more:%u", stats->rtt[j]);
+		}
+		CONS_Printf("\n");
+	}
+}
+
+//
+// Net_LogNetStats
+//
+// With netstatslog set, a dedicated server appends the counters to
+// netstats.csv every that many seconds. They only ever go up, so one
+// line minus the one before is the traffic in between.
+//
+static void Net_LogNetStats(void)
+{
+	static FILE *logfile = NULL;
+	static tic_t lastlog = 0;
+	const tic_t now = I_GetTime();
+	INT32 i;
+
+	if (!dedicated || !cv_netstatslog.value)
+		return;
+	if (now - lastlog < (tic_t)cv_netstatslog.value*TICRATE)
+		return;
+	lastlog = now;
+
+	if (!logfile)
+	{
+		logfile = fopen(va(pandf, srb2home, "netstats.csv"), "a");
+		if (!logfile)
+		{
+			CONS_Alert(CONS_WARNING, M_GetText("Can't open netstats.csv, not logging net stats\n"));
+			CV_SetValue(&cv_netstatslog, 0);
+			return;
+		}
+		fseek(logfile, 0, SEEK_END);
+		if (ftell(logfile) == 0)
+			fprintf(logfile, "seconds,kind,name,sentpackets,sentbytes,gotpackets,gotbytes,"
+				"retransmits,dupacks,rtt50,rtt100,rtt150,rtt200,rtt300,rtt500,rtt1000,rttmore\n");
+	}
+
+	for (i = 0; i < NUMPACKETTYPE; i++)
+	{
+		if (!sentbytype[i].packets && !gotbytype[i].packets)
+			continue;
+		fprintf(logfile, "%u,type,%s,%u,%s,%u,%s,,,,,,,,,,\n", now/TICRATE,
+			packettypename[i] ? packettypename[i] : "?",
+			sentbytype[i].packets, sizeu1((size_t)sentbytype[i].bytes),
+			gotbytype[i].packets, sizeu2((size_t)gotbytype[i].bytes));
+	}
+
+	for (i = 1; i < MAXNETNODES; i++)
+	{
+		const nodestats_t *stats = &nodestats[i];
+		INT32 j;
+
+		if (!nodeingame[i])
+			continue;
+
+		fprintf(logfile, "%u,node,%s,%u,%s,%u,%s,%u,%u", now/TICRATE, Net_NodeStatsName(i),
+			stats->sent.packets, sizeu1((size_t)stats->sent.bytes),
+			stats->got.packets, sizeu2((size_t)stats->got.bytes),
+			stats->retransmits, stats->dupacks);
+		for (j = 0; j < NUMRTTBUCKETS; j++)
+			fprintf(logfile, ",%u", stats->rtt[j]);
+		fprintf(logfile, "\n");
+	}
+	fflush(logfile);
+}
+
 // -----------------------------------------------------------------
 // Some structs and functions for acknowledgement of packets
 // -----------------------------------------------------------------
@@ -191,6 +430,10 @@ typedef struct
 	fixed_t varping;
 	INT32 timeout; // computed with ping and varping
 #endif
+
+	// for the file sender's pacing, see Net_GetNodeRTT
+	fixed_t rtt; // round trip of packets that were not resent, in tics
+	UINT32 resends; // packets to this node that had to be sent again
 } node_t;
 
 static node_t nodes[MAXNETNODES];
@@ -201,6 +444,7 @@ static node_t nodes[MAXNETNODES];
 #else
 #define NODETIMEOUT 14 //What the above boiled down to...
 #endif
+#define RTTDEFAULT ((200*TICRATE*FRACUNIT)/1000)
 
 #ifndef NONET
 // return <0 if a < b (mod 256)
@@ -310,6 +554,46 @@ INT32 Net_GetFreeAcks(boolean urgent)
 	return n;
 }
 
+/** Counts the reliable packets sent to a node that it hasn't acknowledged yet
+  *
+  * \param node The node to count for
+  * \return The number of packets in flight
+  *
+  */
+INT32 Net_GetNodeUnacked(INT32 node)
+{
+	INT32 i, n = 0;
+
+	for (i = 0; i < MAXACKPACKETS; i++)
+		if (ackpak[i].acknum && ackpak[i].destinationnode == node)
+			n++;
+
+	return n;
+}
+
+/** Gets how long a reliable packet takes to reach a node and be acknowledged
+  *
+  * \param node The node
+  * \return The average round trip time, in tics
+  *
+  */
+tic_t Net_GetNodeRTT(INT32 node)
+{
+	return (tic_t)((nodes[node].rtt + FRACUNIT/2)>>FRACBITS);
+}
+
+/** Gets how many packets to a node had to be sent again since it connected,
+  * so a sender can tell when it is sending faster than the line allows
+  *
+  * \param node The node
+  * \return The number of resent packets
+  *
+  */
+UINT32 Net_GetNodeResends(INT32 node)
+{
+	return nodes[node].resends;
+}
+
 // Get a ack to send in the queue of this node
 static UINT8 GetAcktosend(INT32 node)
 {
@@ -333,6 +617,12 @@ static void RemoveAck(INT32 i)
 #else
 	DEBFILE(va("Remove ack %d\n",ackpak[i].acknum));
 #endif
+	// Only a packet sent once says how long the trip takes (Karn)
+	if (!ackpak[i].resentnum)
+	{
+		nodes[node].rtt = (nodes[node].rtt*7 + ((I_GetTime() - ackpak[i].senttime)<<FRACBITS))/8;
+		Net_CountRTT(node, I_GetTime() - ackpak[i].senttime);
+	}
 	ackpak[i].acknum = 0;
 	if (nodes[node].flags & NF_CLOSE)
 		Net_CloseConnection(node);
@@ -367,6 +657,7 @@ static boolean Processackpak(void)
 		{
 			DEBFILE(va("Discard(1) ack %d (duplicated)\n", ack));
 			duppacket++;
+			nodestats[node - nodes].dupacks++;
 			goodpacket = false; // Discard packet (duplicate)
 		}
 		else
@@ -377,6 +668,7 @@ static boolean Processackpak(void)
 				{
 					DEBFILE(va("Discard(2) ack %d (duplicated)\n", ack));
 					duppacket++;
+					nodestats[node - nodes].dupacks++;
 					goodpacket = false; // Discard packet (duplicate)
 					break;
 				}
@@ -546,6 +838,8 @@ void Net_AckTicker(void)
 			ackpak[i].resentnum++;
 			ackpak[i].nextacknum = node->nextacknum;
 			retransmit++; // For stat
+			node->resends++;
+			nodestats[nodei].retransmits++;
 			HSendPacket((INT32)(node - nodes), false, ackpak[i].acknum,
 				(size_t)(ackpak[i].length - BASEPACKETSIZE));
 		}
@@ -568,6 +862,8 @@ void Net_AckTicker(void)
 			}
 		}
 	}
+
+	Net_LogNetStats();
 #endif
 }
 
@@ -663,6 +959,9 @@ static void InitNode(node_t *node)
 	node->varping = VARPINGDEFAULT;
 	node->timeout = TIMEOUT(node->ping, node->varping);
 #endif
+	node->rtt = RTTDEFAULT;
+	node->resends = 0;
+	Net_ClearNodeStats((INT32)(node - nodes));
 	node->firstacktosend = 0;
 	node->nextacknum = 1;
 	node->remotefirstack = 0;
@@ -812,42 +1111,6 @@ static void fprintfstringnewline(char *s, size_t len)
 	fprintf(debugfile, "\n");
 }
 
-/// \warning Keep this up-to-date if you add/remove/rename packet types
-static const char *packettypename[NUMPACKETTYPE] =
-{
-	"NOTHING",
-	"SERVERCFG",
-	"CLIENTCMD",
-	"CLIENTMIS",
-	"CLIENT2CMD",
-	"CLIENT2MIS",
-	"NODEKEEPALIVE",
-	"NODEKEEPALIVEMIS",
-	"SERVERTICS",
-	"SERVERREFUSE",
-	"SERVERSHUTDOWN",
-	"CLIENTQUIT",
-
-	"ASKINFO",
-	"SERVERINFO",
-	"PLAYERINFO",
-	"REQUESTFILE",
-	"ASKINFOVIAMS",
-
-	"RESYNCHEND",
-	"RESYNCHGET",
-
-	"FILEFRAGMENT",
-	"TEXTCMD",
-	"TEXTCMD2",
-	"CLIENTJOIN",
-	"NODETIMEOUT",
-	"RESYNCHING",
-#ifdef NEWPING
-	"PING"
-#endif
-};
-
 static void DebugPrintpacket(const char *header)
 {
 	fprintf(debugfile, "%-12s (node %d,ack %d,ackret %d,size %d) type(%d) : %s\n",
@@ -895,10 +1158,16 @@ static void DebugPrintpacket(const char *header)
 			break;
 		case PT_TEXTCMD:
 		case PT_TEXTCMD2:
-			fprintf(debugfile, "    length %d\n    ", netbuffer->u.textcmd[0]);
-			fprintf(debugfile, "[%s]", netxcmdnames[netbuffer->u.textcmd[1] - 1]);
-			fprintfstringnewline((char *)netbuffer->u.textcmd + 2, netbuffer->u.textcmd[0] - 1);
+		{
+			const UINT8 *p = netbuffer->u.textcmd;
+			size_t size = D_ReadTextCmdSize(&p);
+			char *data = (char *)netbuffer->u.textcmd + (p - netbuffer->u.textcmd);
+
+			fprintf(debugfile, "    length %s\n    ", sizeu1(size));
+			fprintf(debugfile, "[%s]", netxcmdnames[data[0] - 1]);
+			fprintfstringnewline(data + 1, size - 1);
 			break;
+		}
 		case PT_SERVERCFG:
 			fprintf(debugfile, "    playerslots %d clientnode %d serverplayer %d "
 				"gametic %u gamestate %d gametype %d modifiedgame %d\n",
@@ -1089,6 +1358,8 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 
 	netbuffer->checksum = NetbufferChecksum();
 	sendbytes += packetheaderlength + doomcom->datalength; // For stat
+	Net_CountPacket(sentbytype, node < MAXNETNODES ? &nodestats[node] : NULL, true,
+		packetheaderlength + doomcom->datalength);
 
 #ifdef PACKETDROP
 	// Simulate internet :)
@@ -1119,6 +1390,141 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 	return true;
 }
 
+#ifdef NETTHREAD
+// The network thread. The main thread holds net_mutex all the time, except
+// around work that never touches the network, like drawing a frame or
+// loading a level, where it calls Net_ReleaseNetwork. The network thread
+// then reads the socket, answers acks and resends packets, so the other
+// side doesn't see the game's stall as lag. The packets it gets for the
+// game wait in netqueue until the main thread's next HGetPacket.
+
+#define NETQUEUESIZE 256
+
+typedef struct
+{
+	INT16 remotenode;
+	INT16 datalength;
+	char data[MAXPACKETLENGTH];
+} queuedpacket_t;
+
+static queuedpacket_t *netqueue = NULL;
+static INT32 netqueue_head = 0, netqueue_tail = 0;
+
+static I_mutex net_mutex;
+static boolean netthreadstarted = false;
+static boolean netthreadstop = false;
+static boolean netreleased = false; // The main thread has let go of the network
+static boolean innetthread = false; // HGetPacket is being called by the network thread
+static doomcom_t netthreadcom; // So the main thread's netbuffer is left alone
+
+// Runs with net_mutex locked
+static void Net_BackgroundIO(void)
+{
+	doomcom_t *maincom = doomcom;
+	doomdata_t *mainbuffer = netbuffer;
+
+	M_Memcpy(&netthreadcom, doomcom, offsetof(doomcom_t, data));
+	doomcom = &netthreadcom;
+	netbuffer = (doomdata_t *)(void *)&doomcom->data;
+	innetthread = true;
+
+	// Once the queue is full, the rest waits on the socket
+	while ((netqueue_head + 1) % NETQUEUESIZE != netqueue_tail && HGetPacket())
+	{
+		queuedpacket_t *q = &netqueue[netqueue_head];
+		q->remotenode = doomcom->remotenode;
+		q->datalength = doomcom->datalength;
+		M_Memcpy(q->data, netbuffer, doomcom->datalength);
+		netqueue_head = (netqueue_head + 1) % NETQUEUESIZE;
+	}
+
+	Net_AckTicker();
+	if (I_NetFlush)
+		I_NetFlush();
+
+	innetthread = false;
+	doomcom = maincom;
+	netbuffer = mainbuffer;
+}
+
+static void Net_IOThread(void *userdata)
+{
+	(void)userdata;
+
+	for (;;)
+	{
+		I_lock_mutex(&net_mutex);
+		if (netthreadstop || I_thread_is_stopped())
+		{
+			I_unlock_mutex(net_mutex);
+			break;
+		}
+		if (netgame && netreleased)
+			Net_BackgroundIO();
+		I_unlock_mutex(net_mutex);
+
+		I_thread_sleep(1);
+	}
+}
+
+// Lets the network thread finish, at exit
+static void Net_StopIOThread(void)
+{
+	netthreadstop = true;
+	if (!netreleased)
+	{
+		netreleased = true;
+		I_unlock_mutex(net_mutex);
+	}
+}
+#endif
+
+/** Lets the network thread handle packets while the game is busy with
+  * something that doesn't touch the network, until ::Net_ReclaimNetwork
+  * Does nothing unless ::cv_netthread is on.
+  *
+  */
+void Net_ReleaseNetwork(void)
+{
+#ifdef NETTHREAD
+	if (netreleased || !netgame || !cv_netthread.value)
+		return;
+
+	if (!netthreadstarted)
+	{
+		netqueue = malloc(NETQUEUESIZE * sizeof (*netqueue));
+		if (!netqueue)
+			return;
+		I_lock_mutex(&net_mutex); // and keep it; see above
+		I_spawn_thread("net-io", Net_IOThread, NULL);
+		I_AddExitFunc(Net_StopIOThread);
+		netthreadstarted = true;
+	}
+
+	netreleased = true;
+	I_unlock_mutex(net_mutex);
+#endif
+}
+
+/** Takes the network back from the network thread
+  *
+  * \return True if it had been let go with ::Net_ReleaseNetwork
+  *
+  */
+boolean Net_ReclaimNetwork(void)
+{
+#ifdef NETTHREAD
+	if (!netreleased || netthreadstop)
+		return false;
+
+	I_lock_mutex(&net_mutex);
+	netreleased = false;
+	return true;
+#else
+	return false;
+#endif
+}
+
 //
 // HGetPacket
 // Returns false if no packet is waiting
@@ -1128,6 +1534,19 @@ boolean HGetPacket(void)
 {
 	//boolean nodejustjoined;
 
+#ifdef NETTHREAD
+	// Packets the network thread got while we were busy come first
+	if (!innetthread && netqueue_tail != netqueue_head)
+	{
+		queuedpacket_t *q = &netqueue[netqueue_tail];
+		M_Memcpy(netbuffer, q->data, q->datalength);
+		doomcom->remotenode = q->remotenode;
+		doomcom->datalength = q->datalength;
+		netqueue_tail = (netqueue_tail + 1) % NETQUEUESIZE;
+		return true;
+	}
+#endif
+
 	// Get a packet from self
 	if (rebound_tail != rebound_head)
 	{
@@ -1151,6 +1570,10 @@ boolean HGetPacket(void)
 
 #ifndef NONET
 
+	// anything we're waiting a reply for has to go out first
+	if (I_NetFlush)
+		I_NetFlush();
+
 	while(true)
 	{
 		//nodejustjoined = I_NetGet();
@@ -1177,6 +1600,9 @@ boolean HGetPacket(void)
 			continue;
 		}
 
+		Net_CountPacket(gotbytype, &nodestats[doomcom->remotenode], false,
+			packetheaderlength + doomcom->datalength);
+
 #ifdef DEBUGFILE
 		if (debugfile)
 			DebugPrintpacket("GET");
@@ -1214,6 +1640,28 @@ boolean HGetPacket(void)
 	return true;
 }
 
+//
+// Net_WaitForPacket
+// Sleeps until a packet may be waiting or timeout microseconds pass,
+// then returns true if HGetPacket could have something
+//
+boolean Net_WaitForPacket(UINT32 timeout)
+{
+#ifdef NETTHREAD
+	if (netqueue_tail != netqueue_head)
+		return true;
+#endif
+	if (rebound_tail != rebound_head)
+		return true;
+
+	if (!netgame || !I_NetWaitForPacket)
+	{
+		I_Sleep();
+		return false;
+	}
+	return I_NetWaitForPacket(timeout);
+}
+
 static boolean Internal_Get(void)
 {
 	doomcom->remotenode = -1;
@@ -1230,24 +1678,33 @@ static void Internal_FreeNodenum(INT32 nodenum)
 	(void)nodenum;
 }
 
+// Splits "host:port" in two. The host comes back in a copy to free().
+static char *SplitHostPort(const char *hostname, const char **port)
+{
+	char *localhostname = strdup(hostname);
+	char  *t = localhostname;
+	if (!localhostname)
+		return NULL;
+	// retrieve portnum from address!
+	strtok(localhostname, ":");
+	*port = strtok(NULL, ":");
+
+	// remove the port in the hostname as we've it already
+	while ((*t != ':') && (*t != '\0'))
+		t++;
+	*t = '\0';
+	return localhostname;
+}
+
 SINT8 I_NetMakeNode(const char *hostname)
 {
 	SINT8 newnode = -1;
 	if (I_NetMakeNodewPort)
 	{
-		char *localhostname = strdup(hostname);
-		char  *t = localhostname;
 		const char *port;
+		char *localhostname = SplitHostPort(hostname, &port);
 		if (!localhostname)
 			return newnode;
-		// retrieve portnum from address!
-		strtok(localhostname, ":");
-		port = strtok(NULL, ":");
-
-		// remove the port in the hostname as we've it already
-		while ((*t != ':') && (*t != '\0'))
-			t++;
-		*t = '\0';
 
 		newnode = I_NetMakeNodewPort(localhostname, port);
 		free(localhostname);
@@ -1255,6 +1712,22 @@ SINT8 I_NetMakeNode(const char *hostname)
 	return newnode;
 }
 
+boolean I_NetMakeNodeAsync(const char *hostname, void (*done)(SINT8 node))
+{
+	boolean started = false;
+	if (I_NetMakeNodewPortAsync)
+	{
+		const char *port;
+		char *localhostname = SplitHostPort(hostname, &port);
+		if (!localhostname)
+			return false;
+
+		started = I_NetMakeNodewPortAsync(localhostname, port, done);
+		free(localhostname);
+	}
+	return started;
+}
+
 void D_SetDoomcom(void)
 {
 	if (doomcom) return;
@@ -1277,16 +1750,19 @@ boolean D_CheckNetGame(void)
 	InitAck();
 	rebound_tail = rebound_head = 0;
 
-	statstarttic = I_GetTime();
+	statstarttic = netstatsstart = I_GetTime();
 
 	I_NetGet = Internal_Get;
 	I_NetSend = Internal_Send;
+	I_NetFlush = NULL;
 	I_NetCanSend = NULL;
+	I_NetWaitForPacket = NULL;
 	I_NetCloseSocket = NULL;
 	I_NetFreeNodenum = Internal_FreeNodenum;
 	I_NetMakeNodewPort = NULL;
+	I_NetMakeNodewPortAsync = NULL;
 
-	hardware_MAXPACKETLENGTH = MAXPACKETLENGTH;
+	hardware_MAXPACKETLENGTH = LANPACKETLENGTH;
 	net_bandwidth = 30000;
 	// I_InitNetwork sets doomcom and netgame
 	// check and initialize the network driver
@@ -1326,7 +1802,7 @@ boolean D_CheckNetGame(void)
 			if (net_bandwidth < 1000)
 				net_bandwidth = 1000;
 			if (net_bandwidth > 100000)
-				hardware_MAXPACKETLENGTH = MAXPACKETLENGTH;
+				hardware_MAXPACKETLENGTH = LANPACKETLENGTH;
 			CONS_Printf(M_GetText("Network bandwidth set to %d\n"), net_bandwidth);
 		}
 		else
@@ -1436,13 +1912,20 @@ void D_CloseConnection(void)
 
 		I_NetGet = Internal_Get;
 		I_NetSend = Internal_Send;
+		I_NetFlush = NULL;
 		I_NetCanSend = NULL;
+		I_NetWaitForPacket = NULL;
 		I_NetCloseSocket = NULL;
 		I_NetFreeNodenum = Internal_FreeNodenum;
 		I_NetMakeNodewPort = NULL;
+		I_NetMakeNodewPortAsync = NULL;
 		netgame = false;
 		addedtogame = false;
 	}
 
+#ifdef NETTHREAD
+	netqueue_head = netqueue_tail = 0;
+#endif
+
 	D_ResetTiccmds();
 }
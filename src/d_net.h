@@ -35,18 +35,27 @@ boolean Net_GetNetStat(void);
 extern INT32 getbytes;
 extern INT64 sendbytes; // Realtime updated
 
+extern consvar_t cv_netstatslog;
+void Command_Netstats_f(void);
+
 extern SINT8 nodetoplayer[MAXNETNODES];
 extern SINT8 nodetoplayer2[MAXNETNODES]; // Say the numplayer for this node if any (splitscreen)
 extern UINT8 playerpernode[MAXNETNODES]; // Used specially for splitscreen
 extern boolean nodeingame[MAXNETNODES]; // Set false as nodes leave game
 
 INT32 Net_GetFreeAcks(boolean urgent);
+INT32 Net_GetNodeUnacked(INT32 node);
+tic_t Net_GetNodeRTT(INT32 node);
+UINT32 Net_GetNodeResends(INT32 node);
 void Net_AckTicker(void);
 
 // If reliable return true if packet sent, 0 else
 boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum,
 	size_t packetlength);
 boolean HGetPacket(void);
+boolean Net_WaitForPacket(UINT32 timeout);
+void Net_ReleaseNetwork(void);
+boolean Net_ReclaimNetwork(void);
 void D_SetDoomcom(void);
 #ifndef NONET
 void D_SaveBan(void);
@@ -25,12 +25,16 @@
 #include "r_things.h"
 #include "p_local.h"
 #include "p_setup.h"
+#include "p_predict.h"
+#include "p_threads.h"
+#include "p_warmup.h"
 #include "s_sound.h"
 #include "i_sound.h"
 #include "m_misc.h"
 #include "am_map.h"
 #include "byteptr.h"
 #include "d_netfil.h"
+#include "d_netrec.h"
 #include "p_spec.h"
 #include "m_cheat.h"
 #include "d_clisrv.h"
@@ -47,6 +51,11 @@
 #include "m_cond.h"
 #include "m_anigif.h"
 #include "md5.h"
+#include "m_perfstats.h"
+#include "m_cpu.h"
+#include "m_bench.h"
+#include "p_snapshot.h"
+#include "w_md5cache.h"
 
 #ifdef NETGAME_DEVMODE
 #define CV_RESTRICT CV_NETVAR
@@ -107,6 +116,7 @@ static void Fishcake_OnChange(void);
 static void Command_Playdemo_f(void);
 static void Command_Timedemo_f(void);
 static void Command_Stopdemo_f(void);
+static void Command_Demoseek_f(void);
 static void Command_StartMovie_f(void);
 static void Command_StopMovie_f(void);
 static void Command_Map_f(void);
@@ -392,9 +402,12 @@ const char *netxcmdnames[MAXNETXCMD - 1] =
 	"DELFILE",
 	"SETMOTD",
 	"SUICIDE",
+	"DEMOTED",
+	"ADDBOT",
 #ifdef HAVE_BLUA
 	"LUACMD",
-	"LUAVAR"
+	"LUAVAR",
+	"LUAHOOKOFF"
 #endif
 };
 
@@ -433,6 +446,7 @@ void D_RegisterServerCommands(void)
 	RegisterNetXCmd(XD_RUNSOC, Got_RunSOCcmd);
 #ifdef HAVE_BLUA
 	RegisterNetXCmd(XD_LUACMD, Got_Luacmd);
+	RegisterNetXCmd(XD_LUAHOOKOFF, Got_LuaHookOff);
 #endif
 
 	// Remote Administration
@@ -483,6 +497,11 @@ void D_RegisterServerCommands(void)
 	COM_AddCommand("showscores", Command_ShowScores_f);
 	COM_AddCommand("showtime", Command_ShowTime_f);
 	COM_AddCommand("cheats", Command_Cheats_f); // test
+	COM_AddCommand("tickprofile", Command_TickProfile_f);
+	CV_RegisterVar(&cv_perfstats);
+	COM_AddCommand("cpuinfo", Command_CPUInfo_f);
+	COM_AddCommand("benchdemo", Command_Benchdemo_f);
+	COM_AddCommand("benchrender", Command_Benchrender_f);
 #ifdef _DEBUG
 	COM_AddCommand("togglemodified", Command_Togglemodified_f);
 #ifdef HAVE_BLUA
@@ -521,6 +540,8 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_playbackspeed);
 	CV_RegisterVar(&cv_forceskin);
 	CV_RegisterVar(&cv_downloading);
+	CV_RegisterVar(&cv_blockmapcache);
+	CV_RegisterVar(&cv_warmuptraces);
 
 	CV_RegisterVar(&cv_specialrings);
 	CV_RegisterVar(&cv_powerstones);
@@ -563,6 +584,10 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_maxsend);
 	CV_RegisterVar(&cv_noticedownload);
 	CV_RegisterVar(&cv_downloadspeed);
+	CV_RegisterVar(&cv_httpsource);
+#ifdef NETTHREAD
+	CV_RegisterVar(&cv_netthread);
+#endif
 
 	COM_AddCommand("ping", Command_Ping_f);
 	CV_RegisterVar(&cv_nettimeout);
@@ -570,6 +595,14 @@ void D_RegisterServerCommands(void)
 
 	CV_RegisterVar(&cv_skipmapcheck);
 	CV_RegisterVar(&cv_sleep);
+	CV_RegisterVar(&cv_zonebudget);
+	CV_RegisterVar(&cv_lumppool);
+#ifdef HAVE_BLUA
+	CV_RegisterVar(&cv_luagcbudget);
+	CV_RegisterVar(&cv_luahookinstructions);
+	CV_RegisterVar(&cv_luahookoverrun);
+	CV_RegisterVar(&cv_luahooktime);
+#endif
 #ifdef NEWPING
 	CV_RegisterVar(&cv_maxping);
 #endif
@@ -614,6 +647,13 @@ void D_RegisterClientCommands(void)
 	COM_AddCommand("playdemo", Command_Playdemo_f);
 	COM_AddCommand("timedemo", Command_Timedemo_f);
 	COM_AddCommand("stopdemo", Command_Stopdemo_f);
+	COM_AddCommand("demoseek", Command_Demoseek_f);
+	COM_AddCommand("netrecord", Command_Netrecord_f);
+	COM_AddCommand("stopnetrecord", Command_Stopnetrecord_f);
+	COM_AddCommand("netreplay", Command_Netreplay_f);
+	CV_RegisterVar(&cv_netrecordkeyframes);
+	CV_RegisterVar(&cv_demokeyframes);
+	CV_RegisterVar(&cv_compresssaves);
 	COM_AddCommand("playintro", Command_Playintro_f);
 
 	COM_AddCommand("resetcamera", Command_ResetCamera_f);
@@ -661,6 +701,13 @@ void D_RegisterClientCommands(void)
 #endif
 	CV_RegisterVar(&cv_rollingdemos);
 	CV_RegisterVar(&cv_netstat);
+	CV_RegisterVar(&cv_netprediction);
+	CV_RegisterVar(&cv_snapshots);
+	COM_AddCommand("snapshotstats", Command_Snapshotstats_f);
+#ifdef THINKERTHREADS
+	CV_RegisterVar(&cv_thinkerthreads);
+	CV_RegisterVar(&cv_thinkerthreadscheck);
+#endif
 
 #ifdef NETGAME_DEVMODE
 	CV_RegisterVar(&cv_fishcake);
@@ -720,6 +767,7 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_addons_option);
 	CV_RegisterVar(&cv_addons_folder);
 	CV_RegisterVar(&cv_addons_md5);
+	CV_RegisterVar(&cv_md5cache);
 	CV_RegisterVar(&cv_addons_showall);
 	CV_RegisterVar(&cv_addons_search_type);
 	CV_RegisterVar(&cv_addons_search_case);
@@ -1524,6 +1572,44 @@ static void Command_Stopdemo_f(void)
 	CONS_Printf(M_GetText("Stopped demo.\n"));
 }
 
+// go forward or back in the demo or netgame recording being played
+static void Command_Demoseek_f(void)
+{
+	const char *arg;
+	const char *colon;
+	INT32 seconds, now;
+	tic_t tic;
+
+	if (COM_Argc() != 2)
+	{
+		now = (INT32)(netreplaying ? D_NetReplayTics() : G_DemoTics());
+		CONS_Printf(M_GetText("demoseek <m:ss|seconds|+seconds|-seconds>: go to a time in the demo being played\n"));
+		if (demoplayback || netreplaying)
+			CONS_Printf(M_GetText("Now at %d:%02d\n"), G_TicsToMinutes(now, true), G_TicsToSeconds(now));
+		return;
+	}
+
+	arg = COM_Argv(1);
+	colon = strchr(arg, ':');
+	if (colon)
+		seconds = atoi(arg)*60 + atoi(colon + 1);
+	else
+		seconds = atoi(arg);
+
+	if (arg[0] == '+' || arg[0] == '-')
+	{
+		now = (INT32)(netreplaying ? D_NetReplayTics() : G_DemoTics()) + seconds*TICRATE;
+		tic = (now > 0) ? (tic_t)now : 0;
+	}
+	else
+		tic = (seconds > 0) ? (tic_t)seconds*TICRATE : 0;
+
+	if (netreplaying)
+		D_SeekNetReplay(tic);
+	else
+		G_SeekDemo(tic);
+}
+
 static void Command_StartMovie_f(void)
 {
 	M_StartMovie();
@@ -4098,7 +4184,7 @@ static void Command_Archivetest_f(void)
 
 	// assign mobjnum
 	i = 1;
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 			((mobj_t *)th)->mobjnum = i++;
 
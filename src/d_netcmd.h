@@ -134,9 +134,11 @@ typedef enum
 	XD_SETMOTD,     // 19
 	XD_SUICIDE,     // 20
 	XD_DEMOTED,     // 21
+	XD_ADDBOT,      // 22
 #ifdef HAVE_BLUA
-	XD_LUACMD,      // 22
-	XD_LUAVAR,      // 23
+	XD_LUACMD,      // 23
+	XD_LUAVAR,      // 24
+	XD_LUAHOOKOFF,  // 25
 #endif
 	MAXNETXCMD
 } netxcmd_t;
@@ -154,9 +156,18 @@ extern const char *netxcmdnames[MAXNETXCMD - 1];
 //Packet composition for Command_TeamChange_f() ServerTeamChange, etc.
 //bitwise structs make packing bits a little easier, but byte alignment harder?
 //todo: decide whether to make the other netcommands conform, or just get rid of this experiment.
+//More players take bits from newteam, which only goes up to 3.
+#if MAXPLAYERS > 64
+#define TEAMCHANGEPLAYERBITS 7
+#elif MAXPLAYERS > 32
+#define TEAMCHANGEPLAYERBITS 6
+#else
+#define TEAMCHANGEPLAYERBITS 5
+#endif
+
 typedef struct {
-	UINT32 playernum    : 5;  // value 0 to 31
-	UINT32 newteam      : 5;  // value 0 to 31
+	UINT32 playernum    : TEAMCHANGEPLAYERBITS;    // value 0 to MAXPLAYERS-1
+	UINT32 newteam      : 10-TEAMCHANGEPLAYERBITS; // value 0 to 3 at least
 	UINT32 verification : 1;  // value 0 to 1
 	UINT32 autobalance  : 1;  // value 0 to 1
 	UINT32 scrambled    : 1;  // value 0 to 1
@@ -58,12 +58,19 @@
 #include "m_misc.h"
 #include "m_menu.h"
 #include "md5.h"
+#include "w_md5cache.h"
 #include "filesrch.h"
 
+#ifdef HTTPDOWNLOAD
+#include <curl/curl.h>
+#include "i_threads.h"
+#endif
+
 #include <errno.h>
 
 // Prototypes
-static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid);
+static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid,
+	UINT32 resume, const UINT8 *resumemd5);
 
 // Sender structure
 typedef struct filetx_s
@@ -74,6 +81,12 @@ typedef struct filetx_s
 		char *ram; // Pointer to the data in RAM
 	} id;
 	UINT32 size; // Size of the file
+	UINT32 offset; // Where this part goes in the file, see SV_SendRamPart
+	boolean last; // This part ends the file
+	UINT32 start; // Where sending starts, past what the node already has
+	boolean markstart; // The next fragment tells the node where sending starts
+	UINT32 position; // The current position in the file
+	FILE *file; // The open file, if it's a file
 	UINT8 fileid;
 	INT32 node; // Destination
 	struct filetx_s *next; // Next file in the list
@@ -83,11 +96,31 @@ typedef struct filetx_s
 typedef struct filetran_s
 {
 	filetx_t *txlist; // Linked list of all files for the node
-	UINT32 position; // The current position in the file
-	FILE *currentfile; // The file currently being sent/received
+	UINT8 nextslot; // Which of the files in flight gets the next fragment
+	// Congestion control, see SV_FileSendBudget
+	INT32 window; // How many packets may be waiting for an ack
+	INT32 threshold; // Window size where slow start stops
+	UINT32 resends; // Net_GetNodeResends when last checked
+	tic_t windowtime; // When the window last changed
 } filetran_t;
 static filetran_t transfer[MAXNETNODES];
 
+// How many files of a node's list are sent at once, taking turns
+#define MAXFILESINFLIGHT 4
+
+// Limits of the congestion window, in packets
+#define FILEWINDOWMIN 2
+#define FILEWINDOWSTART 4
+#define FILEWINDOWMAX 64
+
+// Set in the size of the first fragment the server sends of a file
+#define FILETX_START 0x8000
+
+// A download that stopped carries on from where it was only if the
+// last bytes of the part the client has match the server's
+#define RESUMECHECKSIZE (64*1024)
+#define MAXPENDINGFRAGMENTS 128
+
 // Read time of file: stat _stmtime
 // Write time of file: utime
 
@@ -166,6 +199,9 @@ void D_ParseFileneeded(INT32 fileneedednum_parm, UINT8 *fileneededstr)
 		fileneeded[i].file = NULL; // The file isn't open yet
 		READSTRINGN(p, fileneeded[i].filename, MAX_WADPATH); // The next bytes are the file name
 		READMEM(p, fileneeded[i].md5sum, 16); // The last 16 bytes are the file checksum
+		fileneeded[i].resumesize = 0;
+		fileneeded[i].pending = NULL;
+		fileneeded[i].numpending = 0;
 	}
 }
 
@@ -175,10 +211,128 @@ void CL_PrepareDownloadSaveGame(const char *tmpsave)
 	fileneeded[0].status = FS_REQUESTED;
 	fileneeded[0].totalsize = UINT32_MAX;
 	fileneeded[0].file = NULL;
+	fileneeded[0].resumesize = 0;
+	fileneeded[0].pending = NULL;
+	fileneeded[0].numpending = 0;
 	memset(fileneeded[0].md5sum, 0, 16);
 	strcpy(fileneeded[0].filename, tmpsave);
 }
 
+/** Gets the MD5 sum of a part of a file
+  *
+  * \param filename The file
+  * \param offset Where the part starts
+  * \param size The size of the part
+  * \param md5sum Where to put the sum
+  * \return False if the part couldn't be read
+  *
+  */
+static boolean GetFileBlockMD5(const char *filename, UINT32 offset, UINT32 size, UINT8 *md5sum)
+{
+#if defined (NOMD5) || defined (_arch_dreamcast)
+	(void)filename;
+	(void)offset;
+	(void)size;
+	(void)md5sum;
+	return false;
+#else
+	FILE *f;
+	char *buf;
+
+	f = fopen(filename, "rb");
+	if (!f)
+		return false;
+
+	buf = malloc(size);
+	if (!buf)
+		I_Error("GetFileBlockMD5: No more memory\n");
+
+	if (fseek(f, offset, SEEK_SET) || fread(buf, 1, size, f) != size)
+	{
+		free(buf);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	md5_buffer(buf, size, md5sum);
+	free(buf);
+	return true;
+#endif
+}
+
+// The file that remembers how much of a stopped download can be kept
+static const char *ResumeFileName(const char *filename)
+{
+	return va("%s.resume", filename);
+}
+
+static void MD5ToString(const UINT8 *md5sum, char *s)
+{
+	INT32 j;
+	for (j = 0; j < 16; j++)
+		sprintf(&s[j*2], "%02x", md5sum[j]);
+}
+
+/** Gets where a file goes in the download cache, in a folder named after its
+  * MD5 sum, so the same file from any server is only downloaded once
+  *
+  * \param path Where to put the path, MAX_WADPATH long
+  * \param filename The file name; any path is ignored
+  * \param md5sum The file's MD5 sum
+  * \param folder True to get the folder instead of the file
+  * \return False if the path is too long
+  *
+  */
+static boolean CacheFilePath(char *path, const char *filename, const UINT8 *md5sum, boolean folder)
+{
+	char md5tmp[33];
+	INT32 len;
+
+	MD5ToString(md5sum, md5tmp);
+	if (folder)
+		len = snprintf(path, MAX_WADPATH, "%s" PATHSEP "cache" PATHSEP "%s", downloaddir, md5tmp);
+	else
+		len = snprintf(path, MAX_WADPATH, "%s" PATHSEP "cache" PATHSEP "%s" PATHSEP "%s", downloaddir, md5tmp,
+			filename + strlen(filename) - nameonlylength(filename));
+	return len >= 0 && len < MAX_WADPATH;
+}
+
+/** Looks for a download of a file that stopped part of the way through
+  *
+  * \param file The file to download, with its full path
+  * \param blockmd5 Where to put the sum of the block before where the download stopped
+  * \return How much of the file is already there, or 0 to start over
+  *
+  */
+static UINT32 CL_GetResumeSize(fileneeded_t *file, UINT8 *blockmd5)
+{
+	FILE *f;
+	unsigned int size = 0;
+	char md5tmp[33], wanted[33];
+
+	file->resumesize = 0;
+
+	f = fopen(ResumeFileName(file->filename), "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%u %32s", &size, md5tmp) != 2)
+		size = 0;
+	fclose(f);
+
+	// It must be the same version of the file
+	MD5ToString(file->md5sum, wanted);
+	if (strcmp(md5tmp, wanted))
+		size = 0;
+
+	if (size < RESUMECHECKSIZE || size >= file->totalsize
+		|| !GetFileBlockMD5(file->filename, size - RESUMECHECKSIZE, RESUMECHECKSIZE, blockmd5))
+		return 0;
+
+	file->resumesize = size;
+	return size;
+}
+
 /** Checks the server to see if we CAN download all the files,
   * before starting to create them and requesting.
   *
@@ -245,6 +399,391 @@ boolean CL_CheckDownloadable(void)
 	return false;
 }
 
+#ifdef HTTPDOWNLOAD
+// Downloading from the server's web address (http_source), on a thread of
+// its own. The thread owns the curl handles and the files being written;
+// the main thread only looks at the progress and status, with http_mutex
+// locked, in CL_HTTPDownloadTicker.
+
+#define HTTP_MAXPARALLEL 4 // Files downloaded at once
+
+typedef enum
+{
+	HTTP_QUEUED,
+	HTTP_DOWNLOADING,
+	HTTP_DONE,
+	HTTP_FAILED
+} httpstatus_t;
+
+typedef struct
+{
+	INT32 fileid;
+	char url[MAX_MIRROR_LENGTH + MAX_WADPATH*3]; // room for an escaped file name
+	char path[MAX_WADPATH]; // Where it goes in the cache
+	char partpath[MAX_WADPATH+5]; // Where it's written until it's checked
+	UINT8 md5sum[16];
+	char error[CURL_ERROR_SIZE];
+
+	// Owned by the thread
+	FILE *file;
+	CURL *handle;
+
+	// Shared, with http_mutex locked
+	UINT32 currentsize;
+	httpstatus_t status;
+} httpfile_t;
+
+static httpfile_t *httpfiles = NULL;
+static INT32 numhttpfiles = 0;
+static boolean httpbusy = false; // The thread is running
+static boolean httpabort = false;
+static I_mutex http_mutex;
+static I_cond http_donecond;
+
+static size_t HTTP_Write(void *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	httpfile_t *h = userdata;
+	size_t n = fwrite(ptr, size, nmemb, h->file);
+
+	I_lock_mutex(&http_mutex);
+	h->currentsize += (UINT32)(n * size);
+	I_unlock_mutex(http_mutex);
+
+	return n * size; // Anything short of what we got stops the transfer
+}
+
+static void HTTP_SetStatus(httpfile_t *h, httpstatus_t status)
+{
+	I_lock_mutex(&http_mutex);
+	h->status = status;
+	I_unlock_mutex(http_mutex);
+}
+
+// Opens the file and adds its transfer to the multi handle
+static boolean HTTP_StartFile(CURLM *multi, httpfile_t *h)
+{
+	char folder[MAX_WADPATH];
+	char *p;
+
+	// Make the cache folders, one level at a time
+	I_mkdir(downloaddir, 0755);
+	CacheFilePath(folder, "", h->md5sum, true);
+	for (p = folder + strlen(downloaddir) + 1; *p; p++)
+		if (*p == PATHSEP[0])
+		{
+			*p = '\0';
+			I_mkdir(folder, 0755);
+			*p = PATHSEP[0];
+		}
+	I_mkdir(folder, 0755);
+
+	h->file = fopen(h->partpath, "wb");
+	if (!h->file)
+	{
+		strlcpy(h->error, strerror(errno), CURL_ERROR_SIZE);
+		HTTP_SetStatus(h, HTTP_FAILED);
+		return false;
+	}
+
+	h->handle = curl_easy_init();
+	if (!h->handle)
+	{
+		fclose(h->file);
+		h->file = NULL;
+		remove(h->partpath);
+		strlcpy(h->error, "can't start transfer", CURL_ERROR_SIZE);
+		HTTP_SetStatus(h, HTTP_FAILED);
+		return false;
+	}
+
+	curl_easy_setopt(h->handle, CURLOPT_URL, h->url);
+#if LIBCURL_VERSION_NUM >= 0x075500 // 7.85.0
+	curl_easy_setopt(h->handle, CURLOPT_PROTOCOLS_STR, "http,https");
+	curl_easy_setopt(h->handle, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+#else
+	curl_easy_setopt(h->handle, CURLOPT_PROTOCOLS, CURLPROTO_HTTP|CURLPROTO_HTTPS);
+	curl_easy_setopt(h->handle, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP|CURLPROTO_HTTPS);
+#endif
+	curl_easy_setopt(h->handle, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(h->handle, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(h->handle, CURLOPT_NOSIGNAL, 1L); // Signals go to whichever thread, don't use them
+	curl_easy_setopt(h->handle, CURLOPT_CONNECTTIMEOUT, 10L);
+	curl_easy_setopt(h->handle, CURLOPT_LOW_SPEED_LIMIT, 1L);
+	curl_easy_setopt(h->handle, CURLOPT_LOW_SPEED_TIME, 30L);
+	curl_easy_setopt(h->handle, CURLOPT_USERAGENT, "SRB2/" VERSIONSTRING);
+	curl_easy_setopt(h->handle, CURLOPT_ERRORBUFFER, h->error);
+	curl_easy_setopt(h->handle, CURLOPT_WRITEFUNCTION, HTTP_Write);
+	curl_easy_setopt(h->handle, CURLOPT_WRITEDATA, h);
+	curl_easy_setopt(h->handle, CURLOPT_PRIVATE, h);
+	curl_multi_add_handle(multi, h->handle);
+
+	HTTP_SetStatus(h, HTTP_DOWNLOADING);
+	return true;
+}
+
+// Closes the file, and keeps it if it's the right one
+static void HTTP_FinishFile(CURLM *multi, httpfile_t *h, CURLcode result)
+{
+	httpstatus_t status = HTTP_FAILED;
+	UINT8 md5sum[16];
+
+	curl_multi_remove_handle(multi, h->handle);
+	curl_easy_cleanup(h->handle);
+	h->handle = NULL;
+	fclose(h->file);
+	h->file = NULL;
+
+	if (result == CURLE_OK)
+	{
+#if defined (NOMD5) || defined (_arch_dreamcast)
+		memcpy(md5sum, h->md5sum, 16);
+		h->file = fopen(h->partpath, "rb");
+#else
+		memset(md5sum, 0, 16);
+		h->file = fopen(h->partpath, "rb");
+		if (h->file)
+			md5_stream(h->file, md5sum);
+#endif
+		if (h->file)
+			fclose(h->file);
+		h->file = NULL;
+
+		if (memcmp(md5sum, h->md5sum, 16))
+			strlcpy(h->error, "wrong version of the file", CURL_ERROR_SIZE);
+		else
+		{
+			remove(h->path);
+			if (!rename(h->partpath, h->path))
+				status = HTTP_DONE;
+			else
+				strlcpy(h->error, strerror(errno), CURL_ERROR_SIZE);
+		}
+	}
+
+	if (status != HTTP_DONE)
+		remove(h->partpath);
+	HTTP_SetStatus(h, status);
+}
+
+static void HTTP_DownloadThread(void *userdata)
+{
+	CURLM *multi = curl_multi_init();
+	CURLMsg *msg;
+	INT32 next = 0, active = 0, running, left, i;
+	boolean stop;
+	(void)userdata;
+
+	for (;;)
+	{
+		fd_set readfds, writefds, exceptfds;
+		struct timeval timeout;
+		int maxfd = -1;
+
+		I_lock_mutex(&http_mutex);
+		stop = httpabort;
+		I_unlock_mutex(http_mutex);
+		if (stop || I_thread_is_stopped())
+			break;
+
+		// Keep a few going at once
+		while (active < HTTP_MAXPARALLEL && next < numhttpfiles)
+			if (HTTP_StartFile(multi, &httpfiles[next++]))
+				active++;
+		if (!active)
+			break;
+
+		curl_multi_perform(multi, &running);
+		while ((msg = curl_multi_info_read(multi, &left)) != NULL)
+			if (msg->msg == CURLMSG_DONE)
+			{
+				httpfile_t *h;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&h);
+				HTTP_FinishFile(multi, h, msg->data.result);
+				active--;
+			}
+
+		// Wait for something to happen on the sockets
+		FD_ZERO(&readfds);
+		FD_ZERO(&writefds);
+		FD_ZERO(&exceptfds);
+		curl_multi_fdset(multi, &readfds, &writefds, &exceptfds, &maxfd);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100*1000;
+		if (maxfd >= 0)
+			select(maxfd + 1, &readfds, &writefds, &exceptfds, &timeout);
+		else
+			I_Sleep();
+	}
+
+	// Stopped part of the way through
+	for (i = 0; i < numhttpfiles; i++)
+	{
+		httpfile_t *h = &httpfiles[i];
+		if (h->handle)
+		{
+			curl_multi_remove_handle(multi, h->handle);
+			curl_easy_cleanup(h->handle);
+			h->handle = NULL;
+			fclose(h->file);
+			h->file = NULL;
+			remove(h->partpath);
+		}
+		if (h->status == HTTP_QUEUED || h->status == HTTP_DOWNLOADING)
+		{
+			strlcpy(h->error, "download stopped", CURL_ERROR_SIZE);
+			HTTP_SetStatus(h, HTTP_FAILED);
+		}
+	}
+	curl_multi_cleanup(multi);
+
+	I_lock_mutex(&http_mutex);
+	httpbusy = false;
+	I_wake_all_cond(&http_donecond);
+	I_unlock_mutex(http_mutex);
+}
+
+/** Starts downloading the files we don't have from the server's web address
+  *
+  * \param source The web address, from the server's PT_SERVERINFO
+  * \return True if any downloads were started
+  * \sa CL_HTTPDownloadTicker
+  *
+  */
+boolean CL_StartHTTPDownloads(const char *source)
+{
+	static boolean curlstarted = false;
+	INT32 i;
+	char *escaped;
+	CURL *curl;
+
+	if (!source[0] || httpbusy || M_CheckParm("-nodownload"))
+		return false;
+
+	if (!curlstarted)
+	{
+		if (curl_global_init(CURL_GLOBAL_ALL) != CURLE_OK)
+			return false;
+		I_AddExitFunc(curl_global_cleanup);
+		curlstarted = true;
+	}
+
+	curl = curl_easy_init(); // Only to escape the file names
+	if (!curl)
+		return false;
+
+	free(httpfiles);
+	httpfiles = calloc(fileneedednum, sizeof (*httpfiles));
+	if (!httpfiles)
+		I_Error("CL_StartHTTPDownloads: No more memory\n");
+	numhttpfiles = 0;
+
+	for (i = 0; i < fileneedednum; i++)
+	{
+		httpfile_t *h = &httpfiles[numhttpfiles];
+		fileneeded_t *file = &fileneeded[i];
+
+		if (file->status != FS_NOTFOUND && file->status != FS_MD5SUMBAD)
+			continue;
+
+		nameonly(file->filename);
+		if (!CacheFilePath(h->path, file->filename, file->md5sum, false))
+			continue;
+		escaped = curl_easy_escape(curl, file->filename, 0);
+		if (!escaped)
+			continue;
+		snprintf(h->url, sizeof h->url, "%s%s%s", source,
+			source[strlen(source)-1] == '/' ? "" : "/", escaped);
+		curl_free(escaped);
+		snprintf(h->partpath, sizeof h->partpath, "%s.part", h->path);
+
+		h->fileid = i;
+		memcpy(h->md5sum, file->md5sum, 16);
+		h->status = HTTP_QUEUED;
+		file->currentsize = 0;
+		file->status = FS_DOWNLOADING;
+		numhttpfiles++;
+	}
+	curl_easy_cleanup(curl);
+
+	if (!numhttpfiles)
+		return false;
+
+	CONS_Printf(M_GetText("Downloading %d files from %s\n"), numhttpfiles, source);
+	httpbusy = true;
+	I_spawn_thread("http-download", HTTP_DownloadThread, NULL);
+	return true;
+}
+
+/** Picks up what the download thread did: the progress of each file, and
+  * which files are done. Files that couldn't be downloaded go back to
+  * ::FS_NOTFOUND, so they can be asked from the server itself.
+  *
+  * \return True while files are still downloading
+  *
+  */
+boolean CL_HTTPDownloadTicker(void)
+{
+	boolean busy;
+	INT32 i;
+
+	if (!numhttpfiles)
+		return false;
+
+	I_lock_mutex(&http_mutex);
+	busy = httpbusy;
+	for (i = 0; i < numhttpfiles; i++)
+	{
+		httpfile_t *h = &httpfiles[i];
+		fileneeded_t *file = &fileneeded[h->fileid];
+
+		if (file->status != FS_DOWNLOADING)
+			continue;
+
+		file->currentsize = h->currentsize;
+		if (h->status == HTTP_DONE)
+		{
+			strcpy(file->filename, h->path);
+			file->status = FS_FOUND;
+			CONS_Printf(M_GetText("Downloading %s...(done)\n"), file->filename);
+		}
+		else if (h->status == HTTP_FAILED)
+		{
+			CONS_Alert(CONS_WARNING, M_GetText("Couldn't download %s: %s\n"), file->filename, h->error);
+			file->status = FS_NOTFOUND;
+		}
+#ifdef CLIENT_LOADINGSCREEN
+		else if (h->status == HTTP_DOWNLOADING)
+			lastfilenum = h->fileid;
+#endif
+	}
+	I_unlock_mutex(http_mutex);
+
+	if (!busy)
+	{
+		free(httpfiles);
+		httpfiles = NULL;
+		numhttpfiles = 0;
+	}
+	return busy;
+}
+
+/** Stops the download thread, and waits for it
+  */
+void CL_AbortHTTPDownloads(void)
+{
+	I_lock_mutex(&http_mutex);
+	httpabort = true;
+	while (httpbusy)
+		I_hold_cond(&http_donecond, http_mutex);
+	httpabort = false;
+	I_unlock_mutex(http_mutex);
+
+	free(httpfiles);
+	httpfiles = NULL;
+	numhttpfiles = 0;
+}
+#endif // HTTPDOWNLOAD
+
 /** Sends requests for files in the ::fileneeded table with a status of
   * ::FS_NOTFOUND.
   *
@@ -275,12 +814,22 @@ boolean CL_SendRequestFile(void)
 	for (i = 0; i < fileneedednum; i++)
 		if ((fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD))
 		{
-			totalfreespaceneeded += fileneeded[i].totalsize;
+			UINT8 blockmd5[16];
+			UINT32 resume;
+
 			nameonly(fileneeded[i].filename);
 			WRITEUINT8(p, i); // fileid
 			WRITESTRINGN(p, fileneeded[i].filename, MAX_WADPATH);
 			// put it in download dir
 			strcatbf(fileneeded[i].filename, downloaddir, "/");
+
+			// Ask to carry on from where the last try stopped
+			resume = CL_GetResumeSize(&fileneeded[i], blockmd5);
+			WRITEUINT32(p, resume);
+			if (resume)
+				WRITEMEM(p, blockmd5, 16);
+
+			totalfreespaceneeded += fileneeded[i].totalsize - resume;
 			fileneeded[i].status = FS_REQUESTED;
 		}
 	WRITEUINT8(p, 0xFF);
@@ -302,13 +851,18 @@ boolean Got_RequestFilePak(INT32 node)
 	char wad[MAX_WADPATH+1];
 	UINT8 *p = netbuffer->u.textcmd;
 	UINT8 id;
+	UINT32 resume;
+	UINT8 resumemd5[16];
 	while (p < netbuffer->u.textcmd + MAXTEXTCMD-1) // Don't allow hacked client to overflow
 	{
 		id = READUINT8(p);
 		if (id == 0xFF)
 			break;
 		READSTRINGN(p, wad, MAX_WADPATH);
-		if (!SV_SendFile(node, wad, id))
+		resume = READUINT32(p);
+		if (resume)
+			READMEM(p, resumemd5, 16);
+		if (!SV_SendFile(node, wad, id, resume, resumemd5))
 		{
 			SV_AbortSendFiles(node);
 			return false; // don't read the rest of the files
@@ -317,6 +871,27 @@ boolean Got_RequestFilePak(INT32 node)
 	return true; // no problems with any files
 }
 
+/** Hashes every needed file that's waiting in the download cache, several
+  * at once, so the searches that follow find their MD5s ready.
+  */
+static void CL_PrepareServerFiles(void)
+{
+	static char paths[MAX_WADFILES][MAX_WADPATH];
+	const char *files[MAX_WADFILES];
+	INT32 i;
+	size_t n = 0;
+
+	for (i = 1; i < fileneedednum; i++)
+		if (fileneeded[i].status == FS_NOTFOUND
+			&& CacheFilePath(paths[n], fileneeded[i].filename, fileneeded[i].md5sum, false))
+		{
+			files[n] = paths[n];
+			n++;
+		}
+
+	W_PrepareFileMD5s(files, n);
+}
+
 /** Checks if the files needed aren't already loaded or on the disk
   *
   * \return 0 if some files are missing
@@ -376,6 +951,8 @@ INT32 CL_CheckFiles(void)
 	// See W_LoadWadFile in w_wad.c
 	packetsize = packetsizetally;
 
+	CL_PrepareServerFiles();
+
 	for (i = 1; i < fileneedednum; i++)
 	{
 		CONS_Debug(DBG_NETPLAY, "searching for '%s' ", fileneeded[i].filename);
@@ -464,10 +1041,13 @@ static INT32 filestosend = 0;
   * \param node The node to send the file to
   * \param filename The file to send
   * \param fileid ???
+  * \param resume How much of the file the node already has, from a download that stopped
+  * \param resumemd5 The MD5 sum of the block before that, so it can be checked
   * \sa SV_SendRam
   *
   */
-static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid)
+static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid,
+	UINT32 resume, const UINT8 *resumemd5)
 {
 	filetx_t **q; // A pointer to the "next" field of the last file in the list
 	filetx_t *p; // The new file request
@@ -539,8 +1119,28 @@ static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid)
 		return false; // cancel the rest of the requests
 	}
 
+	// Carry on from where the node's last download stopped, but only if
+	// what it has is the same file. Otherwise it gets the whole file again,
+	// and the first fragment tells it so.
+	if (resume)
+	{
+		UINT8 md5sum[16];
+
+		if (resume >= RESUMECHECKSIZE && resume < wadfiles[i]->filesize
+			&& GetFileBlockMD5(p->id.filename, resume - RESUMECHECKSIZE, RESUMECHECKSIZE, md5sum)
+			&& !memcmp(md5sum, resumemd5, 16))
+		{
+			p->start = resume;
+			DEBFILE(va("Client %d request %s: resuming at %u\n", node, filename, resume));
+		}
+		else
+			DEBFILE(va("Client %d request %s: can't resume at %u\n", node, filename, resume));
+	}
+
 	DEBFILE(va("Sending file %s (id=%d) to %d\n", filename, fileid, node));
 	p->ram = SF_FILE; // It's a file, we need to close it and free its name once we're done sending it
+	p->last = true;
+	p->markstart = true;
 	p->fileid = fileid;
 	p->next = NULL; // End of list
 	filestosend++;
@@ -558,6 +1158,25 @@ static boolean SV_SendFile(INT32 node, const char *filename, UINT8 fileid)
   *
   */
 void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod, UINT8 fileid)
+{
+	SV_SendRamPart(node, data, size, freemethod, fileid, 0, true);
+}
+
+/** Adds a memory block that is one part of a file to the file list for a node,
+  * so a file can be sent while the rest of it is still being made
+  *
+  * \param node The node to send the memory block to
+  * \param data The memory block to send
+  * \param size The size of the block in bytes
+  * \param freemethod How to free the block after it has been sent
+  * \param fileid The file the block is part of
+  * \param offset Where the block goes in the file
+  * \param last True if the block is the end of the file
+  * \sa SV_SendRam
+  *
+  */
+void SV_SendRamPart(INT32 node, void *data, size_t size, freemethod_t freemethod, UINT8 fileid,
+	UINT32 offset, boolean last)
 {
 	filetx_t **q; // A pointer to the "next" field of the last file in the list
 	filetx_t *p; // The new file request
@@ -578,6 +1197,9 @@ void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod, UI
 	p->ram = freemethod; // Remember how to free the memory block for when we're done sending it
 	p->id.ram = data;
 	p->size = (UINT32)size;
+	p->offset = offset;
+	p->last = last;
+	p->markstart = !offset;
 	p->fileid = fileid;
 	p->next = NULL; // End of list
 
@@ -590,161 +1212,278 @@ void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod, UI
   * either because the file has been fully sent or because the node was disconnected
   *
   * \param node The destination
+  * \param f The file request
   *
   */
-static void SV_EndFileSend(INT32 node)
+static void SV_EndFileSend(INT32 node, filetx_t *f)
 {
-	filetx_t *p = transfer[node].txlist;
+	filetx_t **q = &transfer[node].txlist;
 
 	// Free the file request according to the freemethod parameter used with SV_SendFile/Ram
-	switch (p->ram)
+	switch (f->ram)
 	{
 		case SF_FILE: // It's a file, close it and free its filename
 			if (cv_noticedownload.value)
 				CONS_Printf("Ending file transfer for node %d\n", node);
-			if (transfer[node].currentfile)
-				fclose(transfer[node].currentfile);
-			free(p->id.filename);
+			if (f->file)
+				fclose(f->file);
+			free(f->id.filename);
 			break;
 		case SF_Z_RAM: // It's a memory block allocated with Z_Alloc or the likes, use Z_Free
-			Z_Free(p->id.ram);
+			Z_Free(f->id.ram);
 			break;
 		case SF_RAM: // It's a memory block allocated with malloc, use free
-			free(p->id.ram);
+			free(f->id.ram);
 		case SF_NOFREERAM: // Nothing to free
 			break;
 	}
 
 	// Remove the file request from the list
-	transfer[node].txlist = p->next;
-	free(p);
-
-	// Indicate that the transmission is over
-	transfer[node].currentfile = NULL;
+	while (*q != f)
+		q = &((*q)->next);
+	*q = f->next;
+	free(f);
 
 	filestosend--;
 }
 
-#define PACKETPERTIC net_bandwidth/(TICRATE*software_MAXPACKETLENGTH)
+/** Works out how many fragments a node can be sent this tic
+  *
+  * Each node has a window of packets that may be waiting for an ack. It
+  * doubles every round trip until a packet has to be sent again, and after
+  * that grows by one packet every round trip. A resent packet halves it.
+  * The window is spread over the round trip instead of all going at once.
+  * ::cv_downloadspeed, if set, is the most packets sent in a tic.
+  *
+  * \param node The destination
+  * \return The number of fragments to send
+  *
+  */
+static INT32 SV_FileSendBudget(INT32 node)
+{
+#ifndef NONET
+	filetran_t *t = &transfer[node];
+	const tic_t now = I_GetTime();
+	tic_t rtt = Net_GetNodeRTT(node);
+	UINT32 resends = Net_GetNodeResends(node);
+	INT32 n;
+
+	if (rtt < 1)
+		rtt = 1;
+
+	if (!t->window) // First file for this node
+	{
+		t->window = FILEWINDOWSTART;
+		t->threshold = FILEWINDOWMAX;
+		t->resends = resends;
+		t->windowtime = now;
+	}
+
+	if (resends != t->resends)
+	{
+		// Packets got lost, so the line is full; back off, once a round trip
+		t->resends = resends;
+		if (now - t->windowtime >= rtt)
+		{
+			t->threshold = max(t->window/2, FILEWINDOWMIN);
+			t->window = t->threshold;
+			t->windowtime = now;
+		}
+	}
+	else if (now - t->windowtime >= rtt)
+	{
+		// A whole round trip went by without losing anything
+		if (t->window < t->threshold)
+			t->window *= 2;
+		else
+			t->window++;
+		if (t->window > FILEWINDOWMAX)
+			t->window = FILEWINDOWMAX;
+		t->windowtime = now;
+	}
+
+	n = t->window - Net_GetNodeUnacked(node);
+	if (n > (INT32)((t->window + rtt - 1)/rtt))
+		n = (INT32)((t->window + rtt - 1)/rtt);
+	if (cv_downloadspeed.value && n > cv_downloadspeed.value)
+		n = cv_downloadspeed.value;
+	return n;
+#else
+	(void)node;
+	return 1;
+#endif
+}
+
+/** Sends a node the next fragment of one of its files
+  *
+  * \param node The destination
+  * \return False if the packet couldn't be sent
+  *
+  */
+static boolean SV_SendFileFragment(INT32 node)
+{
+	filetran_t *t = &transfer[node];
+	filetx_t *f = t->txlist;
+	filetx_pak *p = &netbuffer->u.filetxpak;
+	size_t size;
+	UINT16 sizeflags;
+	UINT8 n;
+
+	// The first few files in the list take turns
+	for (n = t->nextslot; n && f->next; n--)
+		f = f->next;
+	if (!f->next || t->nextslot + 1 >= MAXFILESINFLIGHT)
+		t->nextslot = 0;
+	else
+		t->nextslot++;
+
+	// Open the file if it isn't open yet
+	if (f->ram == SF_FILE && !f->file)
+	{
+		long filesize;
+
+		f->file = fopen(f->id.filename, "rb");
+
+		if (!f->file)
+			I_Error("File %s does not exist",
+				f->id.filename);
+
+		fseek(f->file, 0, SEEK_END);
+		filesize = ftell(f->file);
+
+		// Nobody wants to transfer a file bigger
+		// than 4GB!
+		if (filesize >= LONG_MAX)
+			I_Error("filesize of %s is too large", f->id.filename);
+		if (filesize == -1)
+			I_Error("Error getting filesize of %s", f->id.filename);
+
+		f->size = (UINT32)filesize;
+		if (f->start >= f->size)
+			f->start = 0;
+		f->position = f->start;
+		fseek(f->file, f->position, SEEK_SET);
+	}
+
+	// Build a packet containing a file fragment
+	size = software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE);
+	if (f->size-f->position < size)
+		size = f->size-f->position;
+	if (f->ram != SF_FILE)
+		M_Memcpy(p->data, &f->id.ram[f->position], size);
+	else if (fread(p->data, 1, size, f->file) != size)
+		I_Error("SV_FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(size), f->id.filename, f->position, strerror(ferror(f->file)));
+	p->position = LONG(f->offset + f->position);
+	// Put flag so receiver knows the total size
+	if (f->last && f->position + size == f->size)
+		p->position |= LONG(0x80000000);
+	p->fileid = f->fileid;
+	sizeflags = (UINT16)size;
+	// Tell the receiver where we start, in case it hoped to resume
+	if (f->markstart)
+		sizeflags |= FILETX_START;
+	p->size = SHORT(sizeflags);
+
+	// Send the packet
+	if (!HSendPacket(node, true, 0, FILETXHEADER + size)) // Reliable SEND
+	{ // Not sent for some odd reason, retry at next call
+		if (f->ram == SF_FILE)
+			fseek(f->file, f->position, SEEK_SET);
+		return false;
+	}
+
+	f->markstart = false;
+	f->position = (UINT32)(f->position + size);
+	if (f->position == f->size) // Finish?
+		SV_EndFileSend(node, f);
+	return true;
+}
 
 /** Handles file transmission
   *
-  * \todo Use an acknowledging method more adapted to file transmission
-  *       The current download speed suffers from lack of ack packets,
-  *       especially when the one downloading has high latency
+  * Nodes take turns sending one fragment at a time, so one fast node doesn't
+  * use up all the acks, until every node has sent what its window allows.
+  * The reliable packets' acks tell each node's window what got through.
   *
   */
 void SV_FileSendTicker(void)
 {
 	static INT32 currentnode = 0;
-	filetx_pak *p;
-	size_t size;
-	filetx_t *f;
-	INT32 packetsent, ram, i, j;
-	INT32 maxpacketsent;
+	INT32 budget[MAXNETNODES];
+	INT32 freeacks, packetsent, i, j;
 
 	if (!filestosend) // No file to send
 		return;
 
-	if (cv_downloadspeed.value) // New (and experimental) behavior
-	{
-		packetsent = cv_downloadspeed.value;
-		// Don't send more packets than we have free acks
+	// Don't send more packets than we have free acks
 #ifndef NONET
-		maxpacketsent = Net_GetFreeAcks(false) - 5; // Let 5 extra acks just in case
+	freeacks = Net_GetFreeAcks(false) - 5; // Let 5 extra acks just in case
 #else
-		maxpacketsent = 1;
+	freeacks = 1;
 #endif
-		if (packetsent > maxpacketsent && maxpacketsent > 0) // Send at least one packet
-			packetsent = maxpacketsent;
-	}
-	else // Old behavior
-	{
-		packetsent = PACKETPERTIC;
-		if (!packetsent)
-			packetsent = 1;
-	}
+	if (freeacks < 1) // Send at least one packet
+		freeacks = 1;
+
+	for (i = 0; i < MAXNETNODES; i++)
+		budget[i] = transfer[i].txlist ? SV_FileSendBudget(i) : 0;
 
 	netbuffer->packettype = PT_FILEFRAGMENT;
 
-	// (((sendbytes-nowsentbyte)*TICRATE)/(I_GetTime()-starttime)<(UINT32)net_bandwidth)
-	while (packetsent-- && filestosend != 0)
+	do
 	{
-		for (i = currentnode, j = 0; j < MAXNETNODES;
-			i = (i+1) % MAXNETNODES, j++)
+		packetsent = 0;
+		for (j = 0; j < MAXNETNODES && freeacks > 0; j++)
 		{
-			if (transfer[i].txlist)
-				goto found;
-		}
-		// no transfer to do
-		I_Error("filestosend=%d but no file to send found\n", filestosend);
-	found:
-		currentnode = (i+1) % MAXNETNODES;
-		f = transfer[i].txlist;
-		ram = f->ram;
-
-		// Open the file if it isn't open yet, or
-		if (!transfer[i].currentfile)
-		{
-			if (!ram) // Sending a file
-			{
-				long filesize;
+			i = (currentnode + j) % MAXNETNODES;
+			if (budget[i] <= 0 || !transfer[i].txlist)
+				continue;
 
-				transfer[i].currentfile =
-					fopen(f->id.filename, "rb");
+			if (SV_SendFileFragment(i))
+			{
+				budget[i]--;
+				freeacks--;
+				packetsent++;
+			}
+			else // Can't send this one so why should i send the next?
+				budget[i] = 0;
+		}
+	} while (packetsent && freeacks > 0);
 
-				if (!transfer[i].currentfile)
-					I_Error("File %s does not exist",
-						f->id.filename);
+	currentnode = (currentnode+1) % MAXNETNODES;
+}
 
-				fseek(transfer[i].currentfile, 0, SEEK_END);
-				filesize = ftell(transfer[i].currentfile);
+/** Keeps track of how much of a file came through with no gaps, which is
+  * what can be kept if the download stops
+  *
+  * \param file The file being downloaded
+  * \param pos Where the fragment goes
+  * \param size The size of the fragment
+  *
+  */
+static void CL_AddFileFragment(fileneeded_t *file, UINT32 pos, UINT32 size)
+{
+	UINT16 i;
 
-				// Nobody wants to transfer a file bigger
-				// than 4GB!
-				if (filesize >= LONG_MAX)
-					I_Error("filesize of %s is too large", f->id.filename);
-				if (filesize == -1)
-					I_Error("Error getting filesize of %s", f->id.filename);
+	if (pos == file->contiguous)
+	{
+		file->contiguous += size;
 
-				f->size = (UINT32)filesize;
-				fseek(transfer[i].currentfile, 0, SEEK_SET);
+		// Fragments that came early may join up now
+		for (i = 0; i < file->numpending;)
+			if (file->pending[i].position == file->contiguous)
+			{
+				file->contiguous += file->pending[i].size;
+				file->pending[i] = file->pending[--file->numpending];
+				i = 0;
 			}
-			else // Sending RAM
-				transfer[i].currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
-			transfer[i].position = 0;
-		}
-
-		// Build a packet containing a file fragment
-		p = &netbuffer->u.filetxpak;
-		size = software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE);
-		if (f->size-transfer[i].position < size)
-			size = f->size-transfer[i].position;
-		if (ram)
-			M_Memcpy(p->data, &f->id.ram[transfer[i].position], size);
-		else if (fread(p->data, 1, size, transfer[i].currentfile) != size)
-			I_Error("SV_FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(size), f->id.filename, transfer[i].position, strerror(ferror(transfer[i].currentfile)));
-		p->position = LONG(transfer[i].position);
-		// Put flag so receiver knows the total size
-		if (transfer[i].position + size == f->size)
-			p->position |= LONG(0x80000000);
-		p->fileid = f->fileid;
-		p->size = SHORT((UINT16)size);
-
-		// Send the packet
-		if (HSendPacket(i, true, 0, FILETXHEADER + size)) // Reliable SEND
-		{ // Success
-			transfer[i].position = (UINT32)(transfer[i].position + size);
-			if (transfer[i].position == f->size) // Finish?
-				SV_EndFileSend(i);
-		}
-		else
-		{ // Not sent for some odd reason, retry at next call
-			if (!ram)
-				fseek(transfer[i].currentfile,transfer[i].position, SEEK_SET);
-			// Exit the while (can't send this one so why should i send the next?)
-			break;
-		}
+			else
+				i++;
+	}
+	else if (pos > file->contiguous && file->pending && file->numpending < MAXPENDINGFRAGMENTS)
+	{
+		file->pending[file->numpending].position = pos;
+		file->pending[file->numpending].size = size;
+		file->numpending++;
 	}
 }
 
@@ -776,11 +1515,18 @@ void Got_Filetxpak(void)
 	{
 		if (file->file)
 			I_Error("Got_Filetxpak: already open file\n");
-		file->file = fopen(filename, "wb");
+		// Write over a download that stopped, keeping what's there
+		file->file = fopen(filename, file->resumesize ? "r+b" : "wb");
 		if (!file->file)
 			I_Error("Can't create file %s: %s", filename, strerror(errno));
-		CONS_Printf("\r%s...\n",filename);
-		file->currentsize = 0;
+		if (file->resumesize)
+			CONS_Printf("\r%s (resuming at %uK)...\n", filename, file->resumesize>>10);
+		else
+			CONS_Printf("\r%s...\n",filename);
+		file->currentsize = file->contiguous = file->resumesize;
+		file->started = false;
+		file->pending = malloc(MAXPENDINGFRAGMENTS * sizeof (*file->pending));
+		file->numpending = 0;
 		file->status = FS_DOWNLOADING;
 	}
 
@@ -788,6 +1534,22 @@ void Got_Filetxpak(void)
 	{
 		UINT32 pos = LONG(netbuffer->u.filetxpak.position);
 		UINT16 size = SHORT(netbuffer->u.filetxpak.size);
+
+		// The server only resumes where we asked if our part matched its file;
+		// if it starts before that, it didn't
+		if (size & FILETX_START)
+		{
+			size &= ~FILETX_START;
+			if ((pos & ~0x80000000) < file->resumesize)
+			{
+				file->currentsize -= file->resumesize - (pos & ~0x80000000);
+				file->resumesize = pos & ~0x80000000;
+				if (file->contiguous > file->resumesize)
+					file->contiguous = file->resumesize;
+			}
+			file->started = true;
+		}
+
 		// Use a special trick to know when the file is complete (not always used)
 		// WARNING: file fragments can arrive out of order so don't stop yet!
 		if (pos & 0x80000000)
@@ -800,15 +1562,28 @@ void Got_Filetxpak(void)
 		if (fwrite(netbuffer->u.filetxpak.data,size,1,file->file) != 1)
 			I_Error("Can't write to %s: %s\n",filename, strerror(ferror(file->file)));
 		file->currentsize += size;
+		CL_AddFileFragment(file, pos, size);
 
 		// Finished?
-		if (file->currentsize == file->totalsize)
+		if (file->currentsize == file->totalsize && file->started)
 		{
 			fclose(file->file);
 			file->file = NULL;
+			free(file->pending);
+			file->pending = NULL;
 			file->status = FS_FOUND;
-			CONS_Printf(M_GetText("Downloading %s...(done)\n"),
-				filename);
+			remove(ResumeFileName(filename));
+
+			// Make sure the bytes kept from last time were right
+			if (file->resumesize && checkfilemd5(filename, file->md5sum) == FS_MD5SUMBAD)
+			{
+				CONS_Alert(CONS_WARNING, M_GetText("Resumed download of %s is corrupt\n"), filename);
+				remove(filename);
+				file->status = FS_MD5SUMBAD;
+			}
+			else
+				CONS_Printf(M_GetText("Downloading %s...(done)\n"),
+					filename);
 		}
 	}
 	else
@@ -866,7 +1641,9 @@ boolean SV_SendingFile(INT32 node)
 void SV_AbortSendFiles(INT32 node)
 {
 	while (transfer[node].txlist)
-		SV_EndFileSend(node);
+		SV_EndFileSend(node, transfer[node].txlist);
+	transfer[node].nextslot = 0;
+	transfer[node].window = 0;
 }
 
 void CloseNetFile(void)
@@ -876,13 +1653,37 @@ void CloseNetFile(void)
 	for (i = 0; i < MAXNETNODES; i++)
 		SV_AbortSendFiles(i);
 
+#ifdef HTTPDOWNLOAD
+	CL_AbortHTTPDownloads();
+#endif
+
 	// Receiving a file?
 	for (i = 0; i < MAX_WADFILES; i++)
 		if (fileneeded[i].status == FS_DOWNLOADING && fileneeded[i].file)
 		{
-			fclose(fileneeded[i].file);
-			// File is not complete delete it
-			remove(fileneeded[i].filename);
+			static const UINT8 nomd5sum[16];
+			fileneeded_t *file = &fileneeded[i];
+			FILE *f = NULL;
+			char md5tmp[33];
+
+			fclose(file->file);
+			free(file->pending);
+			file->pending = NULL;
+
+			// Keep what came through with no gaps, for next time;
+			// a savegame has no MD5 sum to check it against
+			if (file->contiguous >= RESUMECHECKSIZE && memcmp(file->md5sum, nomd5sum, 16)
+				&& (f = fopen(ResumeFileName(file->filename), "w")) != NULL)
+			{
+				MD5ToString(file->md5sum, md5tmp);
+				fprintf(f, "%u %s\n", file->contiguous, md5tmp);
+				fclose(f);
+			}
+			else // File is not complete delete it
+			{
+				remove(file->filename);
+				remove(ResumeFileName(file->filename));
+			}
 		}
 
 	// Remove PT_FILEFRAGMENT from acknowledge list
@@ -932,17 +1733,13 @@ filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum)
 	(void)wantedmd5sum;
 	(void)filename;
 #else
-	FILE *fhandle;
 	UINT8 md5sum[16];
 
 	if (!wantedmd5sum)
 		return FS_FOUND;
 
-	fhandle = fopen(filename, "rb");
-	if (fhandle)
+	if (!W_FileMD5(filename, md5sum))
 	{
-		md5_stream(fhandle,md5sum);
-		fclose(fhandle);
 		if (!memcmp(wantedmd5sum, md5sum, 16))
 			return FS_FOUND;
 		return FS_MD5SUMBAD;
@@ -961,6 +1758,24 @@ filestatus_t findfile(char *filename, const UINT8 *wantedmd5sum, boolean complet
 	filestatus_t homecheck; // store result of last file search
 	boolean badmd5 = false; // store whether md5 was bad from either of the first two searches (if nothing was found in the third)
 
+	// first of all, check the download cache, if we know what we're looking for
+	if (wantedmd5sum)
+	{
+		char path[MAX_WADPATH];
+		FILE *f;
+
+		if (CacheFilePath(path, filename, wantedmd5sum, false) && (f = fopen(path, "rb")) != NULL)
+		{
+			fclose(f);
+			if (checkfilemd5(path, wantedmd5sum) == FS_FOUND)
+			{
+				if (completepath)
+					strcpy(filename, path);
+				return FS_FOUND;
+			}
+		}
+	}
+
 	// first, check SRB2's "home" directory
 	homecheck = filesearch(filename, srb2home, wantedmd5sum, completepath, 10);
 
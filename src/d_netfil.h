@@ -33,6 +33,13 @@ typedef enum
 	FS_MD5SUMBAD
 } filestatus_t;
 
+// A file fragment that came before the ones in front of it
+typedef struct
+{
+	UINT32 position;
+	UINT32 size;
+} filefragment_t;
+
 typedef struct
 {
 	UINT8 willsend; // Is the server willing to send it?
@@ -43,6 +50,12 @@ typedef struct
 	UINT32 currentsize;
 	UINT32 totalsize;
 	filestatus_t status; // The value returned by recsearch
+	// Resuming a download that stopped
+	UINT32 resumesize; // Bytes kept from the last try, if the server agrees
+	UINT32 contiguous; // Bytes received with no gaps before them
+	boolean started; // The server has said where it starts sending
+	filefragment_t *pending; // Fragments received past contiguous
+	UINT16 numpending;
 } fileneeded_t;
 
 extern INT32 fileneedednum;
@@ -57,10 +70,19 @@ UINT8 *PutFileNeeded(void);
 void D_ParseFileneeded(INT32 fileneedednum_parm, UINT8 *fileneededstr);
 void CL_PrepareDownloadSaveGame(const char *tmpsave);
 
+#if defined (HAVE_CURL) && defined (HAVE_THREADS) && !defined (NONET)
+#define HTTPDOWNLOAD
+boolean CL_StartHTTPDownloads(const char *source);
+boolean CL_HTTPDownloadTicker(void);
+void CL_AbortHTTPDownloads(void);
+#endif
+
 INT32 CL_CheckFiles(void);
 void CL_LoadServerFiles(void);
 void SV_SendRam(INT32 node, void *data, size_t size, freemethod_t freemethod,
 	UINT8 fileid);
+void SV_SendRamPart(INT32 node, void *data, size_t size, freemethod_t freemethod,
+	UINT8 fileid, UINT32 offset, boolean last);
 
 void SV_FileSendTicker(void);
 void Got_Filetxpak(void);
@@ -0,0 +1,709 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_netrec.c
+/// \brief Netgame recordings
+///
+///        The file is a header, then chunks of a type, a tic and the
+///        length of the rest:
+///        'T' tics from that one on, packed with lzf like demo blocks
+///        'K' a keyframe: what PT_SERVERCFG would tell a joining player
+///            that the archive doesn't, then the archive, packed
+///        'E' the end
+///        A tic is each player in the game with their ticcmd, then the
+///        textcmds as they go in PT_SERVERTICS. Playing back runs the
+///        game as a netgame with no one else in it, and feeds it the tics.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "am_map.h"
+#include "byteptr.h"
+#include "command.h"
+#include "console.h"
+#include "d_clisrv.h"
+#include "d_main.h"
+#include "d_netrec.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "lzf.h"
+#include "m_misc.h"
+#include "p_saveg.h"
+#include "r_things.h"
+#include "s_sound.h"
+#include "w_wad.h"
+#include "z_zone.h"
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
+#define NETRECTAG "SRB2NREC"
+#define NETRECVERSION 1
+#define NETRECBLOCKSIZE (64*1024) // tics are packed this many bytes at a time
+#define NETRECMAXTIC (1 + MAXPLAYERS*9 + 1 + MAXPLAYERS*(3 + MAXTEXTCMD))
+#define NETRECSAVESIZE (768*1024) // the same as a savegame for joining
+#define NETRECCHUNKHEAD (1 + 4 + 4)
+
+enum
+{
+	NETREC_TICS = 'T',
+	NETREC_KEYFRAME = 'K',
+	NETREC_END = 'E'
+};
+
+static CV_PossibleValue_t netrecordkeyframes_cons_t[] = {{1, "MIN"}, {600, "MAX"}, {0, NULL}};
+consvar_t cv_netrecordkeyframes = {"netrecordkeyframes", "30", CV_SAVE, netrecordkeyframes_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+boolean netreplaying = false;
+
+// While recording
+static FILE *recordfile = NULL;
+static UINT8 *recordraw = NULL; // the tics since the last block
+static size_t recordrawlen;
+static tic_t recordblocktic; // the first of them
+static UINT8 *recordsave = NULL; // a keyframe's archive, before packing
+static tic_t lastkeyframe;
+static boolean haskeyframe; // nothing is recorded before the first
+
+// While playing back
+static UINT8 *replaybuffer = NULL, *replayend;
+static UINT8 **replaykeyframes = NULL; // where each one's chunk starts
+static UINT32 numreplaykeyframes;
+static UINT8 *replaychunk; // the next one to read
+static UINT8 *replayraw = NULL, *replay_p, *replayrawend; // the block being read
+static tic_t replaytic, replaystart; // of the next tic, and the first keyframe
+
+// -----------------------------------------------------------------
+// The writer
+//
+// Chunks are queued for a thread to write out, so the disk never holds
+// up a tic. Without threads they're written straight away.
+// -----------------------------------------------------------------
+
+typedef struct netrecchunk_s
+{
+	struct netrecchunk_s *next;
+	size_t length; // of what follows this
+} netrecchunk_t;
+
+#ifdef HAVE_THREADS
+static netrecchunk_t *queuehead = NULL, *queuetail = NULL;
+static boolean writerrunning = false, writerstop = false;
+static I_mutex netrec_mutex;
+static I_cond netrec_cond;
+
+static void D_NetRecordWriter(void *userdata)
+{
+	netrecchunk_t *chunk;
+	size_t d;
+	(void)userdata;
+
+	I_lock_mutex(&netrec_mutex);
+	for (;;)
+	{
+		while (!queuehead && !writerstop)
+			I_hold_cond(&netrec_cond, netrec_mutex);
+		chunk = queuehead;
+		if (!chunk) // stopping, and everything's written
+			break;
+		queuehead = chunk->next;
+		if (!queuehead)
+			queuetail = NULL;
+		I_unlock_mutex(netrec_mutex);
+
+		d = fwrite(chunk + 1, chunk->length, 1, recordfile);
+		(void)d;
+		free(chunk);
+
+		I_lock_mutex(&netrec_mutex);
+	}
+	writerrunning = false;
+	I_wake_all_cond(&netrec_cond);
+	I_unlock_mutex(netrec_mutex);
+}
+#endif
+
+// A chunk with room for length bytes after it
+static netrecchunk_t *D_NewChunk(size_t length)
+{
+	netrecchunk_t *chunk = malloc(sizeof (*chunk) + length);
+
+	if (!chunk)
+		I_Error("D_NewChunk: out of memory");
+	chunk->next = NULL;
+	chunk->length = 0;
+	return chunk;
+}
+
+static void D_QueueChunk(netrecchunk_t *chunk, size_t length)
+{
+	size_t d;
+
+	chunk->length = length;
+#ifdef HAVE_THREADS
+	if (writerrunning)
+	{
+		I_lock_mutex(&netrec_mutex);
+		if (queuetail)
+			queuetail->next = chunk;
+		else
+			queuehead = chunk;
+		queuetail = chunk;
+		I_wake_all_cond(&netrec_cond);
+		I_unlock_mutex(netrec_mutex);
+		return;
+	}
+#endif
+	d = fwrite(chunk + 1, length, 1, recordfile);
+	(void)d;
+	free(chunk);
+}
+
+// -----------------------------------------------------------------
+// Recording
+// -----------------------------------------------------------------
+
+// Packs rawlen bytes of raw after p, with its length and packed length
+static UINT8 *D_PackChunkData(UINT8 *p, const UINT8 *raw, size_t rawlen)
+{
+	size_t packedlen = (rawlen > 1) ? lzf_compress(raw, rawlen, p + 8, rawlen - 1) : 0;
+
+	WRITEUINT32(p, rawlen);
+	WRITEUINT32(p, packedlen);
+	if (!packedlen)
+	{
+		M_Memcpy(p, raw, rawlen);
+		packedlen = rawlen;
+	}
+	return p + packedlen;
+}
+
+// Queues the tics since the last block
+static void D_FlushTics(void)
+{
+	netrecchunk_t *chunk;
+	UINT8 *start, *p;
+
+	if (!recordrawlen)
+		return;
+
+	chunk = D_NewChunk(NETRECCHUNKHEAD + 8 + recordrawlen);
+	start = p = (UINT8 *)(chunk + 1);
+	p += NETRECCHUNKHEAD;
+	p = D_PackChunkData(p, recordraw, recordrawlen);
+
+	WRITEUINT8(start, NETREC_TICS);
+	WRITEUINT32(start, recordblocktic);
+	WRITEUINT32(start, (UINT32)(p - start - 4));
+	D_QueueChunk(chunk, (size_t)(p - (UINT8 *)(chunk + 1)));
+	recordrawlen = 0;
+}
+
+static void D_WriteKeyframe(void)
+{
+	netrecchunk_t *chunk;
+	UINT8 *start, *p, *oldsave_p = save_p;
+	size_t rawlen;
+	INT32 i;
+
+	D_FlushTics(); // playing back from here starts at the next block
+
+	save_p = recordsave;
+	P_SaveNetGame();
+	rawlen = save_p - recordsave;
+	save_p = oldsave_p;
+	if (rawlen > NETRECSAVESIZE)
+		I_Error("D_WriteKeyframe: keyframe buffer overrun");
+
+	chunk = D_NewChunk(NETRECCHUNKHEAD + 1 + MAXPLAYERS*(1 + MAXPLAYERNAME + 2) + 1 + 8 + rawlen);
+	start = p = (UINT8 *)(chunk + 1);
+	p += NETRECCHUNKHEAD;
+
+	WRITEUINT8(p, gametype);
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i])
+		{
+			WRITEUINT8(p, i);
+			WRITESTRINGN(p, player_names[i], MAXPLAYERNAME);
+			WRITEUINT8(p, players[i].skin);
+			WRITEUINT8(p, players[i].skincolor);
+		}
+	WRITEUINT8(p, 0xFF);
+	p = D_PackChunkData(p, recordsave, rawlen);
+
+	WRITEUINT8(start, NETREC_KEYFRAME);
+	WRITEUINT32(start, gametic);
+	WRITEUINT32(start, (UINT32)(p - start - 4));
+	D_QueueChunk(chunk, (size_t)(p - (UINT8 *)(chunk + 1)));
+
+	lastkeyframe = gametic;
+	haskeyframe = true;
+}
+
+void D_NetRecordTic(void)
+{
+	UINT8 *p, *count_p;
+	INT32 i;
+
+	if (!recordfile || netreplaying)
+		return;
+
+	// Not while a new level is on its way in, since the archive wouldn't have it
+	if (gamestate == GS_LEVEL && gameaction == ga_nothing
+		&& (!haskeyframe || gametic - lastkeyframe >= (tic_t)cv_netrecordkeyframes.value*TICRATE))
+		D_WriteKeyframe();
+	if (!haskeyframe)
+		return; // there's nothing to start from yet
+
+	if (NETRECBLOCKSIZE - recordrawlen < NETRECMAXTIC)
+		D_FlushTics();
+	if (!recordrawlen)
+		recordblocktic = gametic;
+
+	p = recordraw + recordrawlen;
+	count_p = p++;
+	*count_p = 0;
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i])
+		{
+			const ticcmd_t *cmd = &netcmds[gametic%BACKUPTICS][i];
+
+			WRITEUINT8(p, i);
+			WRITESINT8(p, cmd->forwardmove);
+			WRITESINT8(p, cmd->sidemove);
+			WRITEINT16(p, cmd->angleturn);
+			WRITEINT16(p, cmd->aiming);
+			WRITEUINT16(p, cmd->buttons);
+			(*count_p)++;
+		}
+	p = D_WriteTextCmds(p, gametic);
+	recordrawlen = p - recordraw;
+}
+
+void D_StopNetRecording(void)
+{
+	netrecchunk_t *chunk;
+	UINT8 *p;
+
+	if (!recordfile)
+		return;
+
+	D_FlushTics();
+	chunk = D_NewChunk(NETRECCHUNKHEAD);
+	p = (UINT8 *)(chunk + 1);
+	WRITEUINT8(p, NETREC_END);
+	WRITEUINT32(p, gametic);
+	WRITEUINT32(p, 0);
+	D_QueueChunk(chunk, NETRECCHUNKHEAD);
+
+#ifdef HAVE_THREADS
+	if (writerrunning)
+	{
+		I_lock_mutex(&netrec_mutex);
+		writerstop = true;
+		I_wake_all_cond(&netrec_cond);
+		while (writerrunning)
+			I_hold_cond(&netrec_cond, netrec_mutex);
+		I_unlock_mutex(netrec_mutex);
+	}
+#endif
+
+	fclose(recordfile);
+	recordfile = NULL;
+	free(recordraw);
+	free(recordsave);
+	recordraw = recordsave = NULL;
+	CONS_Printf(M_GetText("Netgame recording finished.\n"));
+}
+
+void Command_Netrecord_f(void)
+{
+	char name[256];
+	netrecchunk_t *chunk;
+	UINT8 *p;
+	UINT16 i;
+
+	if (COM_Argc() != 2)
+	{
+		CONS_Printf(M_GetText("netrecord <name>: record the netgame from here on to <name>.nrec\n"));
+		return;
+	}
+	if (netreplaying || demoplayback)
+	{
+		CONS_Printf(M_GetText("You can't record while playing something back.\n"));
+		return;
+	}
+	if (recordfile)
+	{
+		CONS_Printf(M_GetText("Already recording. Use stopnetrecord first.\n"));
+		return;
+	}
+
+	strlcpy(name, COM_Argv(1), sizeof (name) - 5);
+	FIL_DefaultExtension(name, ".nrec");
+	recordfile = fopen(va(pandf, srb2home, name), "wb");
+	if (!recordfile)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Can't create %s\n"), name);
+		return;
+	}
+
+	recordraw = malloc(NETRECBLOCKSIZE);
+	recordsave = malloc(NETRECSAVESIZE);
+	if (!recordraw || !recordsave)
+		I_Error("Command_Netrecord_f: out of memory");
+	recordrawlen = 0;
+	haskeyframe = false;
+
+	// The files have to be the same to play it back
+	chunk = D_NewChunk(8 + 3 + 2 + 16*numwadfiles);
+	p = (UINT8 *)(chunk + 1);
+	WRITEMEM(p, NETRECTAG, 8);
+	WRITEUINT8(p, NETRECVERSION);
+	WRITEUINT8(p, VERSION);
+	WRITEUINT8(p, SUBVERSION);
+	WRITEUINT16(p, numwadfiles);
+	for (i = 0; i < numwadfiles; i++)
+		WRITEMEM(p, wadfiles[i]->md5sum, 16);
+	D_QueueChunk(chunk, (size_t)(p - (UINT8 *)(chunk + 1)));
+
+#ifdef HAVE_THREADS
+	writerstop = false;
+	writerrunning = true;
+	I_spawn_thread("net-recorder", D_NetRecordWriter, NULL);
+#endif
+
+	CONS_Printf(M_GetText("Recording the netgame to %s\n"), name);
+}
+
+void Command_Stopnetrecord_f(void)
+{
+	if (!recordfile)
+	{
+		CONS_Printf(M_GetText("The netgame isn't being recorded.\n"));
+		return;
+	}
+	D_StopNetRecording();
+}
+
+// -----------------------------------------------------------------
+// Playing back
+// -----------------------------------------------------------------
+
+static tic_t D_ChunkTic(const UINT8 *chunk)
+{
+	chunk++;
+	return READUINT32(chunk);
+}
+
+// Unpacks what D_PackChunkData packed, if it fits in dest
+static boolean D_UnpackChunkData(UINT8 *p, UINT8 *end, UINT8 *dest, size_t size, size_t *rawlen)
+{
+	UINT32 packedlen;
+
+	if (end - p < 8)
+		return false;
+	*rawlen = READUINT32(p);
+	packedlen = READUINT32(p);
+	if (*rawlen > size || (packedlen ? packedlen : *rawlen) > (size_t)(end - p))
+		return false;
+	if (packedlen)
+		return (lzf_decompress(p, packedlen, dest, *rawlen) == *rawlen);
+	M_Memcpy(dest, p, *rawlen);
+	return true;
+}
+
+// Unpacks the next block of tics, passing over any keyframes on the way
+static boolean D_NextReplayBlock(void)
+{
+	while (replaychunk < replayend && *replaychunk != NETREC_END)
+	{
+		UINT8 *chunk = replaychunk, *p = chunk + 5;
+		UINT8 *end = p + 4 + READUINT32(p);
+		size_t rawlen;
+
+		replaychunk = end;
+		if (*chunk != NETREC_TICS)
+			continue;
+		if (D_ChunkTic(chunk) != replaytic
+			|| !D_UnpackChunkData(p, end, replayraw, NETRECBLOCKSIZE, &rawlen))
+		{
+			CONS_Alert(CONS_WARNING, M_GetText("The recording is damaged past this point.\n"));
+			return false;
+		}
+		replay_p = replayraw;
+		replayrawend = replayraw + rawlen;
+		return true;
+	}
+	return false;
+}
+
+// Ends the playback at the end of the recording, or when it's gone wrong
+static void D_EndNetReplay(void)
+{
+	D_StopNetReplay();
+	netgame = multiplayer = false;
+	D_AdvanceDemo();
+}
+
+boolean D_ReadNetReplayTic(void)
+{
+	UINT8 *p, count, n;
+	INT32 i, ingame = 0;
+
+	if (!netreplaying)
+		return false;
+	if (replay_p >= replayrawend && !D_NextReplayBlock())
+	{
+		D_EndNetReplay();
+		return false;
+	}
+
+	p = replay_p;
+	count = READUINT8(p);
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i])
+			ingame++;
+	if (count != ingame || (size_t)(replayrawend - p) < count*9U)
+		goto outofstep;
+
+	for (n = 0; n < count; n++)
+	{
+		ticcmd_t *cmd;
+
+		i = READUINT8(p);
+		if (i >= MAXPLAYERS || !playeringame[i])
+			goto outofstep;
+		cmd = &netcmds[gametic%BACKUPTICS][i];
+		cmd->forwardmove = READSINT8(p);
+		cmd->sidemove = READSINT8(p);
+		cmd->angleturn = READINT16(p);
+		cmd->aiming = READINT16(p);
+		cmd->buttons = READUINT16(p);
+	}
+
+	p = D_ReadTextCmds(p, gametic, true);
+	if (!p || p > replayrawend)
+		goto outofstep;
+
+	replay_p = p;
+	replaytic++;
+	return true;
+
+outofstep:
+	CONS_Alert(CONS_ERROR, M_GetText("The recording has gone out of step at %d:%02d.\n"),
+		G_TicsToMinutes(D_NetReplayTics(), true), G_TicsToSeconds(D_NetReplayTics()));
+	D_EndNetReplay();
+	return false;
+}
+
+// Puts the game back as it was at a keyframe
+static boolean D_LoadReplayKeyframe(UINT32 k)
+{
+	UINT8 *chunk = replaykeyframes[k], *p = chunk + 5, *end, *raw;
+	size_t rawlen;
+	UINT8 i;
+	boolean ok;
+
+	end = p + 4 + READUINT32(p);
+
+	gametype = READUINT8(p);
+	memset(playeringame, 0, sizeof (playeringame));
+	while ((i = READUINT8(p)) != 0xFF)
+	{
+		if (i >= MAXPLAYERS || end - p < 3)
+			return false;
+		playeringame[i] = true;
+		READSTRINGN(p, player_names[i], MAXPLAYERNAME);
+		SetPlayerSkinByNum(i, READUINT8(p));
+		players[i].skincolor = READUINT8(p);
+	}
+
+	raw = Z_Malloc(NETRECSAVESIZE, PU_STATIC, NULL);
+	ok = D_UnpackChunkData(p, end, raw, NETRECSAVESIZE, &rawlen);
+	if (ok)
+	{
+		save_p = raw;
+		ok = P_LoadNetGame();
+		save_p = NULL;
+	}
+	Z_Free(raw);
+
+	replaychunk = end;
+	replay_p = replayrawend = replayraw;
+	replaytic = D_ChunkTic(chunk);
+	return ok;
+}
+
+void D_StopNetReplay(void)
+{
+	if (!netreplaying)
+		return;
+	netreplaying = false;
+
+	Z_Free(replaybuffer);
+	Z_Free(replaykeyframes);
+	free(replayraw);
+	replaybuffer = replayraw = NULL;
+	replaykeyframes = NULL;
+}
+
+tic_t D_NetReplayTics(void)
+{
+	return replaytic - replaystart;
+}
+
+void D_SeekNetReplay(tic_t tic)
+{
+	UINT32 k;
+
+	if (!netreplaying)
+		return;
+
+	tic += replaystart;
+	for (k = 1; k < numreplaykeyframes && D_ChunkTic(replaykeyframes[k]) <= tic; k++)
+		;
+	k--;
+
+	// Running on from here is quicker than loading, if the keyframe doesn't get any closer
+	if (tic < replaytic || D_ChunkTic(replaykeyframes[k]) > replaytic || gamestate != GS_LEVEL)
+	{
+		if (!D_LoadReplayKeyframe(k))
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("The recording's keyframe at %d:%02d is damaged.\n"),
+				G_TicsToMinutes(D_NetReplayTics(), true), G_TicsToSeconds(D_NetReplayTics()));
+			D_EndNetReplay();
+			return;
+		}
+	}
+
+	while (replaytic < tic && D_ReadNetReplayTic())
+		D_RunTic();
+
+	// Whatever went off on the way shouldn't all be heard at once
+	S_StopSounds();
+}
+
+// Checks the header and finds the keyframes
+static boolean D_IndexNetReplay(size_t length)
+{
+	UINT8 *p = replaybuffer, *chunk;
+	UINT16 numfiles, i;
+
+	replayend = replaybuffer + length;
+	if (length < 13 || memcmp(p, NETRECTAG, 8))
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("That isn't a netgame recording.\n"));
+		return false;
+	}
+	p += 8;
+	if (READUINT8(p) != NETRECVERSION || READUINT8(p) != VERSION || READUINT8(p) != SUBVERSION)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("That recording is from a different version of the game.\n"));
+		return false;
+	}
+	numfiles = READUINT16(p);
+	if (numfiles != numwadfiles || (size_t)(replayend - p) < 16U*numfiles)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("That recording needs different files loaded.\n"));
+		return false;
+	}
+	for (i = 0; i < numfiles; i++, p += 16)
+		if (memcmp(p, wadfiles[i]->md5sum, 16))
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("That recording needs different files loaded.\n"));
+			return false;
+		}
+
+	replaychunk = p;
+	replaykeyframes = Z_Malloc((length / NETRECCHUNKHEAD + 1) * sizeof (*replaykeyframes), PU_STATIC, NULL);
+	numreplaykeyframes = 0;
+	while ((size_t)(replayend - p) >= NETRECCHUNKHEAD && *p != NETREC_END)
+	{
+		UINT32 rest;
+
+		chunk = p;
+		p += 5;
+		rest = READUINT32(p);
+		if (rest > (size_t)(replayend - p) || (*chunk != NETREC_TICS && *chunk != NETREC_KEYFRAME))
+			break; // the rest is damaged, or was never written
+		if (*chunk == NETREC_KEYFRAME)
+			replaykeyframes[numreplaykeyframes++] = chunk;
+		p += rest;
+	}
+	replayend = p;
+
+	if (!numreplaykeyframes || replaykeyframes[0] != replaychunk)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("That recording has nothing to start from.\n"));
+		return false;
+	}
+	return true;
+}
+
+void Command_Netreplay_f(void)
+{
+	char name[256];
+	size_t length;
+
+	if (COM_Argc() != 2)
+	{
+		CONS_Printf(M_GetText("netreplay <name>: play back a netgame recording\n"));
+		return;
+	}
+	if (netgame)
+	{
+		CONS_Printf(M_GetText("You can't play a recording back during a netgame.\n"));
+		return;
+	}
+
+	strlcpy(name, COM_Argv(1), sizeof (name) - 5);
+	FIL_DefaultExtension(name, ".nrec");
+	length = FIL_ReadFile(va(pandf, srb2home, name), &replaybuffer);
+	if (!length)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't read file %s\n"), name);
+		return;
+	}
+
+	replayraw = malloc(NETRECBLOCKSIZE + NETRECMAXTIC); // a damaged tic can't read past it
+	if (!replayraw)
+		I_Error("Command_Netreplay_f: out of memory");
+	netreplaying = true;
+	if (!D_IndexNetReplay(length))
+	{
+		D_StopNetReplay();
+		return;
+	}
+
+	if (demoplayback)
+		G_StopDemo();
+	if (metalplayback)
+		G_StopMetalDemo();
+	paused = false;
+	automapactive = false;
+	splitscreen = false;
+
+	// The game runs as it did on the server, as a netgame
+	// that nobody else is in
+	netgame = multiplayer = true;
+	netreplaying = true;
+	if (!D_LoadReplayKeyframe(0))
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("The recording's first keyframe is damaged.\n"));
+		D_EndNetReplay();
+		return;
+	}
+	replaystart = replaytic;
+
+	for (consoleplayer = 0; consoleplayer < MAXPLAYERS-1; consoleplayer++)
+		if (playeringame[consoleplayer])
+			break;
+	displayplayer = consoleplayer;
+
+	CONS_Printf(M_GetText("Playing back %s\n"), name);
+}
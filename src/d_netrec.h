@@ -0,0 +1,57 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  d_netrec.h
+/// \brief Netgame recordings
+///
+///        A recording is every tic the game runs, as the server put it
+///        together: the ticcmd of each player in the game and their net
+///        commands. Nothing extra is simulated to make one. Every so often
+///        the game is archived as it is for a joining player, and the
+///        first of these keyframes is where playing it back starts from.
+
+#ifndef __D_NETREC__
+#define __D_NETREC__
+
+#include "command.h"
+
+extern consvar_t cv_netrecordkeyframes;
+
+/// \brief A netgame recording is being played back
+extern boolean netreplaying;
+
+/**	\brief Adds the tic about to be run to the recording, if there is one.
+*/
+void D_NetRecordTic(void);
+
+/**	\brief Finishes the recording and closes the file, if there is one.
+*/
+void D_StopNetRecording(void);
+
+/**	\brief Puts the next tic of the recording being played back in netcmds.
+	\return	false if the recording is over, or has gone out of step
+*/
+boolean D_ReadNetReplayTic(void);
+
+/**	\brief Stops playing a recording back, if one is.
+*/
+void D_StopNetReplay(void);
+
+/**	\brief How far into the recording being played back it is.
+*/
+tic_t D_NetReplayTics(void);
+
+/**	\brief Goes forward or back to a tic of the recording being played back.
+*/
+void D_SeekNetReplay(tic_t tic);
+
+void Command_Netrecord_f(void);
+void Command_Stopnetrecord_f(void);
+void Command_Netreplay_f(void);
+
+#endif // __D_NETREC__
@@ -49,6 +49,8 @@ typedef struct thinker_s
 	// killough 11/98: count of how many other objects reference
 	// this one using pointers. Used for garbage collection.
 	INT32 references;
+
+	INT32 luaref; // registry reference to its Lua userdata, 0 if none
 } thinker_t;
 
 #endif
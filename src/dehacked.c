@@ -21,6 +21,7 @@
 #include "w_wad.h"
 #include "m_menu.h"
 #include "m_misc.h"
+#include "m_trace.h"
 #include "f_finale.h"
 #include "dehacked.h"
 #include "st_stuff.h"
@@ -63,6 +64,7 @@ memset(used_spr,0,sizeof(UINT8) * ((NUMSPRITEFREESLOTS / 8) + 1));\
 
 // Crazy word-reading stuff
 /// \todo Put these in a seperate file or something.
+static INT32 DEH_FindAction(const char *word, boolean caseless);
 static mobjtype_t get_mobjtype(const char *word);
 static statenum_t get_state(const char *word);
 static spritenum_t get_sprite(const char *word);
@@ -1952,6 +1954,7 @@ static void readframe(MYFILE *f, INT32 num)
 			else if (fastcmp(word1, "ACTION"))
 			{
 				size_t z;
+				INT32 action;
 				boolean found = false;
 				XBOXSTATIC char actiontocompare[32];
 
@@ -1977,22 +1980,16 @@ static void readframe(MYFILE *f, INT32 num)
 					}
 				}
 
-				z = 0;
 #ifdef HAVE_BLUA
 				found = LUA_SetLuaAction(&states[num], actiontocompare);
 				if (!found)
 #endif
-				while (actionpointers[z].name)
+				if ((action = DEH_FindAction(actiontocompare, false)) != -1)
 				{
-					if (fastcmp(actiontocompare, actionpointers[z].name))
-					{
-						states[num].action = actionpointers[z].action;
-						states[num].action.acv = actionpointers[z].action.acv; // assign
-						states[num].action.acp1 = actionpointers[z].action.acp1;
-						found = true;
-						break;
-					}
-					z++;
+					states[num].action = actionpointers[action].action;
+					states[num].action.acv = actionpointers[action].action.acv; // assign
+					states[num].action.acp1 = actionpointers[action].action.acp1;
+					found = true;
 				}
 
 				if (!found)
@@ -3726,6 +3723,7 @@ void DEH_LoadDehackedLumpPwad(UINT16 wad, UINT16 lump)
 #ifdef DELFILE
 	unsocwad = wad;
 #endif
+	TRACE_BEGIN("soc", wadfiles[wad]->lumpinfo[lump].name2);
 	f.wad = wad;
 	f.size = W_LumpLengthPwad(wad, lump);
 	f.data = Z_Malloc(f.size + 1, PU_STATIC, NULL);
@@ -3735,6 +3733,7 @@ void DEH_LoadDehackedLumpPwad(UINT16 wad, UINT16 lump)
 	DEH_LoadDehackedFile(&f, wad);
 	DEH_WriteUndoline(va("# uload for wad: %u, lump: %u", wad, lump), NULL, UNDO_DONE);
 	Z_Free(f.data);
+	TRACE_END();
 }
 
 void DEH_LoadDehackedLump(lumpnum_t lumpnum)
@@ -6752,7 +6751,7 @@ static const char *const MOBJEFLAG_LIST[] = {
 	"JUSTSTEPPEDDOWN", // used for ramp sectors
 	"VERTICALFLIP", // Vertically flip sprite/allow upside-down physics
 	"GOOWATER", // Goo water
-	"\x01", // free: 1<<7 (name un-matchable)
+	"DORMANT", // Dozing: nothing to think about but its state
 	"SPRUNG", // Mobj was already sprung this tic
 	"APPLYPMOMZ", // Platform movement
 	NULL
@@ -7460,42 +7459,203 @@ struct {
 	{NULL,0}
 };
 
+// Name lookups
+// What get_mobjtype and friends look names up in, so that each lookup
+// isn't a walk over a list thousands of names long. A table only holds
+// values, and asks for the name that goes with one, so that a name is
+// always checked against what it is now. Each is filled in the first
+// time it's needed, and the free slot ones as more free slots are taken.
+
+#define DEHNAMEHASHSIZE 4096 // Must be a power of two
+
+typedef struct
+{
+	INT32 value;
+	INT32 next; // the next name with the same hash, counting from 1; 0 for none
+} dehname_t;
+
+typedef struct
+{
+	INT32 heads[DEHNAMEHASHSIZE]; // counting from 1; 0 for none
+	dehname_t *names;
+	INT32 numnames, maxnames;
+	const char *(*nameof)(INT32 value); // NULL if the value's not in use
+} dehnametable_t;
+
+// Case doesn't matter, so that one table can be searched either way.
+static UINT32 DEH_HashName(const char *name)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+	for (; *name; name++)
+		hash = (hash ^ (UINT8)toupper(*name)) * 16777619u;
+	return hash & (DEHNAMEHASHSIZE-1);
+}
+
+static void DEH_AddName(dehnametable_t *table, INT32 value)
+{
+	const char *name = table->nameof(value);
+	INT32 *link;
+
+	if (!name || !*name)
+		return;
+
+	if (table->numnames == table->maxnames)
+	{
+		table->maxnames = table->maxnames ? table->maxnames*2 : 256;
+		table->names = realloc(table->names, table->maxnames * sizeof (*table->names));
+		if (!table->names)
+			I_Error("DEH_AddName: out of memory");
+	}
+	table->names[table->numnames].value = value;
+	table->names[table->numnames].next = 0;
+
+	// Onto the end, so that the first of two with the same name is found first
+	for (link = &table->heads[DEH_HashName(name)]; *link; link = &table->names[*link - 1].next) ;
+	*link = ++table->numnames;
+}
+
+static void DEH_ClearNames(dehnametable_t *table)
+{
+	memset(table->heads, 0, sizeof (table->heads));
+	table->numnames = 0;
+}
+
+// Returns the value named word, or -1.
+static INT32 DEH_FindName(dehnametable_t *table, const char *word, boolean caseless)
+{
+	INT32 i;
+	const char *name;
+
+	for (i = table->heads[DEH_HashName(word)]; i; i = table->names[i - 1].next)
+	{
+		name = table->nameof(table->names[i - 1].value);
+		if (name && (caseless ? fasticmp(word, name) : fastcmp(word, name)))
+			return table->names[i - 1].value;
+	}
+	return -1;
+}
+
+static const char *NameOfMobjType(INT32 i) { return MOBJTYPE_LIST[i]+3; }
+static const char *NameOfState(INT32 i) { return STATE_LIST[i]+2; }
+static const char *NameOfFreeMobj(INT32 i) { return FREE_MOBJS[i]; }
+static const char *NameOfFreeState(INT32 i) { return FREE_STATES[i]; }
+static const char *NameOfSfx(INT32 i) { return S_sfx[i].name; }
+static const char *NameOfAction(INT32 i) { return actionpointers[i].name; }
+static const char *NameOfConst(INT32 i) { return INT_CONST[i].n; }
+
+static dehnametable_t mobjtypenames = {{0}, NULL, 0, 0, NameOfMobjType};
+static dehnametable_t statenames = {{0}, NULL, 0, 0, NameOfState};
+static dehnametable_t freemobjnames = {{0}, NULL, 0, 0, NameOfFreeMobj};
+static dehnametable_t freestatenames = {{0}, NULL, 0, 0, NameOfFreeState};
+static dehnametable_t sfxnames = {{0}, NULL, 0, 0, NameOfSfx};
+static dehnametable_t actionnames = {{0}, NULL, 0, 0, NameOfAction};
+static dehnametable_t constnames = {{0}, NULL, 0, 0, NameOfConst};
+
+// Catches a free slot table up with the free slots taken since.
+static void DEH_SyncFreeSlotNames(dehnametable_t *table, char **freeslots, INT32 numslots)
+{
+	// initfreeslots clears them all
+	if (table->numnames && !freeslots[table->numnames - 1])
+		DEH_ClearNames(table);
+	while (table->numnames < numslots && freeslots[table->numnames])
+		DEH_AddName(table, table->numnames);
+}
+
+// Returns the MT_ named word, without the MT_, or -1.
+static INT32 DEH_FindMobjType(const char *word)
+{
+	INT32 i;
+
+	DEH_SyncFreeSlotNames(&freemobjnames, FREE_MOBJS, NUMMOBJFREESLOTS);
+	if ((i = DEH_FindName(&freemobjnames, word, false)) != -1)
+		return MT_FIRSTFREESLOT+i;
+
+	if (!mobjtypenames.numnames)
+		for (i = 0; i < MT_FIRSTFREESLOT; i++)
+			DEH_AddName(&mobjtypenames, i);
+	return DEH_FindName(&mobjtypenames, word, false);
+}
+
+// Returns the S_ named word, without the S_, or -1.
+static INT32 DEH_FindState(const char *word)
+{
+	INT32 i;
+
+	DEH_SyncFreeSlotNames(&freestatenames, FREE_STATES, NUMSTATEFREESLOTS);
+	if ((i = DEH_FindName(&freestatenames, word, false)) != -1)
+		return S_FIRSTFREESLOT+i;
+
+	if (!statenames.numnames)
+		for (i = 0; i < S_FIRSTFREESLOT; i++)
+			DEH_AddName(&statenames, i);
+	return DEH_FindName(&statenames, word, false);
+}
+
+// Returns the sfx named word, without the sfx_, or -1.
+static INT32 DEH_FindSfx(const char *word, boolean caseless)
+{
+	INT32 i;
+
+	if (!sfxnames.numnames)
+		for (i = 0; i < NUMSFX; i++)
+			DEH_AddName(&sfxnames, i);
+	if ((i = DEH_FindName(&sfxnames, word, caseless)) != -1)
+		return i;
+
+	// Free slots get their names after the table is filled in
+	for (i = 0; i < NUMSFX; i++)
+		if (S_sfx[i].name && (caseless ? fasticmp(word, S_sfx[i].name) : fastcmp(word, S_sfx[i].name)))
+		{
+			DEH_AddName(&sfxnames, i);
+			return i;
+		}
+	return -1;
+}
+
+// Returns the index in actionpointers of the action named word, or -1.
+static INT32 DEH_FindAction(const char *word, boolean caseless)
+{
+	INT32 i;
+
+	if (!actionnames.numnames)
+		for (i = 0; actionpointers[i].name; i++)
+			DEH_AddName(&actionnames, i);
+	return DEH_FindName(&actionnames, word, caseless);
+}
+
+// Returns the index in INT_CONST of the constant named word, or -1.
+static INT32 DEH_FindConst(const char *word)
+{
+	INT32 i;
+
+	if (!constnames.numnames)
+		for (i = 0; INT_CONST[i].n; i++)
+			DEH_AddName(&constnames, i);
+	return DEH_FindName(&constnames, word, false);
+}
+
 static mobjtype_t get_mobjtype(const char *word)
 { // Returns the vlaue of MT_ enumerations
-	mobjtype_t i;
+	INT32 i;
 	if (*word >= '0' && *word <= '9')
 		return atoi(word);
 	if (fastncmp("MT_",word,3))
 		word += 3; // take off the MT_
-	for (i = 0; i < NUMMOBJFREESLOTS; i++) {
-		if (!FREE_MOBJS[i])
-			break;
-		if (fastcmp(word, FREE_MOBJS[i]))
-			return MT_FIRSTFREESLOT+i;
-	}
-	for (i = 0; i < MT_FIRSTFREESLOT; i++)
-		if (fastcmp(word, MOBJTYPE_LIST[i]+3))
-			return i;
+	if ((i = DEH_FindMobjType(word)) != -1)
+		return i;
 	deh_warning("Couldn't find mobjtype named 'MT_%s'",word);
 	return MT_BLUECRAWLA;
 }
 
 static statenum_t get_state(const char *word)
 { // Returns the value of S_ enumerations
-	statenum_t i;
+	INT32 i;
 	if (*word >= '0' && *word <= '9')
 		return atoi(word);
 	if (fastncmp("S_",word,2))
 		word += 2; // take off the S_
-	for (i = 0; i < NUMSTATEFREESLOTS; i++) {
-		if (!FREE_STATES[i])
-			break;
-		if (fastcmp(word, FREE_STATES[i]))
-			return S_FIRSTFREESLOT+i;
-	}
-	for (i = 0; i < S_FIRSTFREESLOT; i++)
-		if (fastcmp(word, STATE_LIST[i]+2))
-			return i;
+	if ((i = DEH_FindState(word)) != -1)
+		return i;
 	deh_warning("Couldn't find state named 'S_%s'",word);
 	return S_NULL;
 }
@@ -7516,16 +7676,15 @@ static spritenum_t get_sprite(const char *word)
 
 static sfxenum_t get_sfx(const char *word)
 { // Returns the value of SFX_ enumerations
-	sfxenum_t i;
+	INT32 i;
 	if (*word >= '0' && *word <= '9')
 		return atoi(word);
 	if (fastncmp("SFX_",word,4))
 		word += 4; // take off the SFX_
 	else if (fastncmp("DS",word,2))
 		word += 2; // take off the DS
-	for (i = 0; i < NUMSFX; i++)
-		if (S_sfx[i].name && fasticmp(word, S_sfx[i].name))
-			return i;
+	if ((i = DEH_FindSfx(word, true)) != -1)
+		return i;
 	deh_warning("Couldn't find sfx named 'SFX_%s'",word);
 	return sfx_None;
 }
@@ -7796,11 +7955,10 @@ static fixed_t find_const(const char **rword)
 		free(word);
 		return 0;
 	}
-	for (i = 0; INT_CONST[i].n; i++)
-		if (fastcmp(word,INT_CONST[i].n)) {
-			free(word);
-			return INT_CONST[i].v;
-		}
+	if ((i = DEH_FindConst(word)) != -1) {
+		free(word);
+		return INT_CONST[i].v;
+	}
 
 	// Not found error.
 	const_warning("constant",word);
@@ -7851,6 +8009,17 @@ void DEH_Check(void)
 #endif
 }
 
+// Name of a mobj type, for debugging output.
+// Returns NULL for freeslots that haven't been allocated.
+const char *DEH_MobjTypeName(mobjtype_t type)
+{
+	if (type < MT_FIRSTFREESLOT)
+		return MOBJTYPE_LIST[type];
+	if (type <= MT_LASTFREESLOT && FREE_MOBJS[type - MT_FIRSTFREESLOT])
+		return va("MT_%s", FREE_MOBJS[type - MT_FIRSTFREESLOT]);
+	return NULL;
+}
+
 #ifdef HAVE_BLUA
 #include "lua_script.h"
 #include "lua_libs.h"
@@ -8074,36 +8243,18 @@ static inline int lib_getenum(lua_State *L)
 	}
 	else if (fastncmp("S_",word,2)) {
 		p = word+2;
-		for (i = 0; i < NUMSTATEFREESLOTS; i++) {
-			if (!FREE_STATES[i])
-				break;
-			if (fastcmp(p, FREE_STATES[i])) {
-				lua_pushinteger(L, S_FIRSTFREESLOT+i);
-				return 1;
-			}
+		if ((i = DEH_FindState(p)) != -1) {
+			lua_pushinteger(L, i);
+			return 1;
 		}
-		for (i = 0; i < S_FIRSTFREESLOT; i++)
-			if (fastcmp(p, STATE_LIST[i]+2)) {
-				lua_pushinteger(L, i);
-				return 1;
-			}
 		return luaL_error(L, "state '%s' does not exist.\n", word);
 	}
 	else if (fastncmp("MT_",word,3)) {
 		p = word+3;
-		for (i = 0; i < NUMMOBJFREESLOTS; i++) {
-			if (!FREE_MOBJS[i])
-				break;
-			if (fastcmp(p, FREE_MOBJS[i])) {
-				lua_pushinteger(L, MT_FIRSTFREESLOT+i);
-				return 1;
-			}
+		if ((i = DEH_FindMobjType(p)) != -1) {
+			lua_pushinteger(L, i);
+			return 1;
 		}
-		for (i = 0; i < MT_FIRSTFREESLOT; i++)
-			if (fastcmp(p, MOBJTYPE_LIST[i]+3)) {
-				lua_pushinteger(L, i);
-				return 1;
-			}
 		return luaL_error(L, "mobjtype '%s' does not exist.\n", word);
 	}
 	else if (fastncmp("SPR_",word,4)) {
@@ -8118,29 +8269,26 @@ static inline int lib_getenum(lua_State *L)
 	}
 	else if (!mathlib && fastncmp("sfx_",word,4)) {
 		p = word+4;
-		for (i = 0; i < NUMSFX; i++)
-			if (S_sfx[i].name && fastcmp(p, S_sfx[i].name)) {
-				lua_pushinteger(L, i);
-				return 1;
-			}
+		if ((i = DEH_FindSfx(p, false)) != -1) {
+			lua_pushinteger(L, i);
+			return 1;
+		}
 		return 0;
 	}
 	else if (mathlib && fastncmp("SFX_",word,4)) { // SOCs are ALL CAPS!
 		p = word+4;
-		for (i = 0; i < NUMSFX; i++)
-			if (S_sfx[i].name && fasticmp(p, S_sfx[i].name)) {
-				lua_pushinteger(L, i);
-				return 1;
-			}
+		if ((i = DEH_FindSfx(p, true)) != -1) {
+			lua_pushinteger(L, i);
+			return 1;
+		}
 		return luaL_error(L, "sfx '%s' could not be found.\n", word);
 	}
 	else if (mathlib && fastncmp("DS",word,2)) {
 		p = word+2;
-		for (i = 0; i < NUMSFX; i++)
-			if (S_sfx[i].name && fasticmp(p, S_sfx[i].name)) {
-				lua_pushinteger(L, i);
-				return 1;
-			}
+		if ((i = DEH_FindSfx(p, true)) != -1) {
+			lua_pushinteger(L, i);
+			return 1;
+		}
 		if (mathlib) return luaL_error(L, "sfx '%s' could not be found.\n", word);
 		return 0;
 	}
@@ -8222,13 +8370,12 @@ static inline int lib_getenum(lua_State *L)
 
 		// Hardcoded actions as callable Lua functions!
 		// Retrieving them from this metatable allows them to be case-insensitive!
-		for (i = 0; actionpointers[i].name; i++)
-			if (fasticmp(word, actionpointers[i].name)) {
-				// push lib_action as a C closure with the actionf_t* as an upvalue.
-				lua_pushlightuserdata(L, &actionpointers[i].action);
-				lua_pushcclosure(L, lib_action, 1);
-				return 1;
-			}
+		if ((i = DEH_FindAction(word, true)) != -1) {
+			// push lib_action as a C closure with the actionf_t* as an upvalue.
+			lua_pushlightuserdata(L, &actionpointers[i].action);
+			lua_pushcclosure(L, lib_action, 1);
+			return 1;
+		}
 		return 0;
 	}
 	else if (!mathlib && fastcmp("super",word))
@@ -8238,20 +8385,18 @@ static inline int lib_getenum(lua_State *L)
 			lua_pushcfunction(L, lib_dummysuper);
 			return 1;
 		}
-		for (i = 0; actionpointers[i].name; i++)
-			if (fasticmp(superactions[superstack-1], actionpointers[i].name)) {
-				lua_pushlightuserdata(L, &actionpointers[i].action);
-				lua_pushcclosure(L, lib_action, 1);
-				return 1;
-			}
+		if ((i = DEH_FindAction(superactions[superstack-1], true)) != -1) {
+			lua_pushlightuserdata(L, &actionpointers[i].action);
+			lua_pushcclosure(L, lib_action, 1);
+			return 1;
+		}
 		return 0;
 	}
 
-	for (i = 0; INT_CONST[i].n; i++)
-		if (fastcmp(word,INT_CONST[i].n)) {
-			lua_pushinteger(L, INT_CONST[i].v);
-			return 1;
-		}
+	if ((i = DEH_FindConst(word)) != -1) {
+		lua_pushinteger(L, INT_CONST[i].v);
+		return 1;
+	}
 
 	if (mathlib) return luaL_error(L, "constant '%s' could not be parsed.\n", word);
 
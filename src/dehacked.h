@@ -14,6 +14,7 @@
 #define __DEHACKED_H__
 
 #include "m_fixed.h" // for get_number
+#include "info.h" // for mobjtype_t
 
 typedef enum
 {
@@ -38,6 +39,7 @@ void DEH_LoadDehackedLump(lumpnum_t lumpnum);
 void DEH_LoadDehackedLumpPwad(UINT16 wad, UINT16 lump);
 
 void DEH_Check(void);
+const char *DEH_MobjTypeName(mobjtype_t type);
 
 fixed_t get_number(const char *word);
 
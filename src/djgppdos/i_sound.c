@@ -126,6 +126,12 @@ void I_FreeSfx (sfxinfo_t *sfx)
 	sfx->lumpnum = LUMPERROR;
 }
 
+void I_PrefetchSfx (sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx (sfx);
+}
+
 FUNCINLINE static ATTRINLINE int Volset(int vol)
 {
 	return (vol*255/31);
@@ -507,6 +513,12 @@ void I_UnloadSong(void)
 	//destroy_midi(currsong);
 }
 
+void I_PrefetchSong(char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+}
+
 boolean I_PlaySong(boolean looping)
 {
 	handle = 0;
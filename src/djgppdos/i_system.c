@@ -326,6 +326,12 @@ tic_t I_GetTime (void)
 	return ticcount;
 }
 
+// only as precise as the timer interrupt
+UINT32 I_GetTimeMicros(void)
+{
+	return ticcount * (1000000/TICRATE);
+}
+
 
 void I_Sleep(void)
 {
@@ -333,6 +339,11 @@ void I_Sleep(void)
 		rest(cv_sleep.value);
 }
 
+void I_SleepMillis(UINT32 ms)
+{
+	rest(ms);
+}
+
 
 static UINT8 joystick_detected = false;
 static UINT8 joystick2_detected = false;
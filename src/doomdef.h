@@ -236,13 +236,31 @@ extern FILE *logstream;
 // =========================================================================
 
 // The maximum number of players, multiplayer/networking.
-// NOTE: it needs more than this to increase the number of players...
-
+// Build with MAXPLAYERS set to change it. Netgames only work between
+// builds with the same number. Node numbers are signed bytes and need
+// room for a few nodes more than players, so 120 is as far as it goes.
+// Every player costs each client 8 bytes a tic, or less with delta tics,
+// so the server sends out about players*players*8*TICRATE bytes a second.
+// Beyond 32 the join packets no longer fit in one datagram (see
+// MAXPACKETLENGTH).
+
+#ifndef MAXPLAYERS
 #define MAXPLAYERS 32
+#endif
+#if MAXPLAYERS < 2 || MAXPLAYERS > 120
+#error MAXPLAYERS must be from 2 to 120
+#endif
 #define MAXSKINS MAXPLAYERS
-#define PLAYERSMASK (MAXPLAYERS-1)
 #define MAXPLAYERNAME 21
 
+// A bit for each player, in bytes, for sets of players sent over the
+// net or saved. Bit i of a 32 player mask is where it'd be in a little
+// endian UINT32.
+#define PLAYERMASKSIZE ((MAXPLAYERS+7)/8)
+#define PLAYERINMASK(mask, i) ((mask)[(i)>>3] & (1<<((i)&7)))
+#define ADDPLAYERTOMASK(mask, i) ((mask)[(i)>>3] |= (UINT8)(1<<((i)&7)))
+#define REMOVEPLAYERFROMMASK(mask, i) ((mask)[(i)>>3] &= (UINT8)~(1<<((i)&7)))
+
 typedef enum
 {
 	SKINCOLOR_NONE = 0,
@@ -538,4 +556,30 @@ extern const char *compdate, *comptime, *comprevision, *compbranch;
 ///      	SRB2CB itself ported this from PrBoom+
 #define NEWCLIP
 
+/// Let the software renderer draw on several threads, see r_threads.c.
+/// The drawing state the drawers read becomes thread-local, which the
+/// assembly drawers can't cope with.
+#if defined (HAVE_THREADS) && !defined (USEASM) && !defined (NORENDERTHREADS)
+#define RENDERTHREADS
+#ifdef _MSC_VER
+#define RENDERLOCAL __declspec(thread)
+#else
+#define RENDERLOCAL __thread
+#endif
+#else
+#define RENDERLOCAL
+#endif
+
+/// Let a thread answer acks and hold on to packets while the game is busy
+/// drawing or loading a level, see Net_ReleaseNetwork.
+#if defined (HAVE_THREADS) && !defined (NONET) && !defined (NONETTHREAD)
+#define NETTHREAD
+#endif
+
+/// Let scrollers and lights that keep to themselves think on several
+/// threads, see p_threads.c.
+#if defined (HAVE_THREADS) && !defined (NOTHINKERTHREADS)
+#define THINKERTHREADS
+#endif
+
 #endif // __DOOMDEF__
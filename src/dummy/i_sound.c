@@ -13,6 +13,11 @@ void I_FreeSfx(sfxinfo_t *sfx)
 	(void)sfx;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	(void)sfx;
+}
+
 void I_StartupSound(void){}
 
 void I_ShutdownSound(void){}
@@ -36,18 +41,15 @@ INT32 I_StartSound(sfxenum_t id, UINT8 vol, UINT8 sep, UINT8 pitch, UINT8 priori
 
 void I_StopSound(INT32 handle)
 {
-	(void)handle;
 }
 
 boolean I_SoundIsPlaying(INT32 handle)
 {
-	(void)handle;
 	return false;
 }
 
 void I_UpdateSoundParams(INT32 handle, UINT8 vol, UINT8 sep, UINT8 pitch)
 {
-	(void)handle;
 	(void)vol;
 	(void)sep;
 	(void)pitch;
@@ -139,29 +141,30 @@ boolean I_LoadSong(char *data, size_t len)
 
 void I_UnloadSong(void)
 {
-	(void)handle;
+}
+
+void I_PrefetchSong(char *data, size_t len)
+{
+	(void)data;
+	(void)len;
 }
 
 boolean I_PlaySong(boolean looping)
 {
-	(void)handle;
 	(void)looping;
 	return false;
 }
 
 void I_StopSong(void)
 {
-	(void)handle;
 }
 
 void I_PauseSong(void)
 {
-	(void)handle;
 }
 
 void I_ResumeSong(void)
 {
-	(void)handle;
 }
 
 void I_SetMusicVolume(UINT8 volume)
@@ -188,16 +191,18 @@ void I_StopFadingSong(void)
 {
 }
 
-boolean I_FadeSongFromVolume(UINT8 target_volume, UINT8 source_volume, UINT32 ms, void (*callback)(void));
+boolean I_FadeSongFromVolume(UINT8 target_volume, UINT8 source_volume, UINT32 ms, void (*callback)(void))
 {
+	(void)callback;
 	(void)target_volume;
 	(void)source_volume;
 	(void)ms;
 	return false;
 }
 
-boolean I_FadeSong(UINT8 target_volume, UINT32 ms, void (*callback)(void));
+boolean I_FadeSong(UINT8 target_volume, UINT32 ms, void (*callback)(void))
 {
+	(void)callback;
 	(void)target_volume;
 	(void)ms;
 	return false;
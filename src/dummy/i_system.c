@@ -16,8 +16,18 @@ tic_t I_GetTime(void)
 	return 0;
 }
 
+UINT32 I_GetTimeMicros(void)
+{
+	return 0;
+}
+
 void I_Sleep(void){}
 
+void I_SleepMillis(UINT32 ms)
+{
+	(void)ms;
+}
+
 void I_GetEvent(void){}
 
 void I_OsPolling(void){}
@@ -39,7 +49,12 @@ void I_Quit(void)
 
 void I_Error(const char *error, ...)
 {
-	(void)error;
+	va_list argptr;
+
+	va_start(argptr, error);
+	vfprintf(stderr, error, argptr);
+	va_end(argptr);
+	fputc('\n', stderr);
 	exit(-1);
 }
 
@@ -169,7 +184,7 @@ INT32 I_ClipboardCopy(const char *data, size_t size)
 	return -1;
 }
 
-char *I_ClipboardPaste(void)
+const char *I_ClipboardPaste(void)
 {
 	return NULL;
 }
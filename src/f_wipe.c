@@ -99,7 +99,8 @@ static fademask_t *F_GetFadeMask(UINT8 masknum, UINT8 scrnnum) {
 	lumpnum_t lumpnum;
 	UINT8 *lump, *mask;
 	size_t lsize;
-	RGBA_t *pcolor;
+	UINT8 level[256];
+	INT32 i;
 
 	if (masknum > 99 || scrnnum > 99)
 		goto freemask;
@@ -142,12 +143,13 @@ static fademask_t *F_GetFadeMask(UINT8 masknum, UINT8 scrnnum) {
 
 	mask = fm.mask;
 
+	// Work out the fade level of each palette colour once, instead of
+	// once for every pixel of the mask
+	for (i = 0; i < 256; i++)
+		level[i] = (UINT8)(FixedDiv((pLocalPalette[i].s.red+1)<<FRACBITS, paldiv)>>FRACBITS);
+
 	while (lsize--)
-	{
-		// Determine pixel to use from fademask
-		pcolor = &pLocalPalette[*lump++];
-		*mask++ = FixedDiv((pcolor->s.red+1)<<FRACBITS, paldiv)>>FRACBITS;
-	}
+		*mask++ = level[*lump++];
 
 	fm.xscale = FixedDiv(vid.width<<FRACBITS, fm.width<<FRACBITS);
 	fm.yscale = FixedDiv(vid.height<<FRACBITS, fm.height<<FRACBITS);
@@ -211,22 +213,37 @@ static void F_DoWipe(fademask_t *fademask)
 		UINT32 draw_linestogo, draw_rowstogo;
 
 		// rectangle coordinates, etc.
-		UINT16* scrxpos = (UINT16*)malloc((fademask->width + 1)  * sizeof(UINT16));
-		UINT16* scrypos = (UINT16*)malloc((fademask->height + 1) * sizeof(UINT16));
+		// These only depend on the mask and screen sizes, so they're kept
+		// from one frame (and one wipe) to the next until either changes.
+		static UINT16 *scrxpos = NULL, *scrypos = NULL;
+		static UINT16 poswidth = 0, posheight = 0;
+		static INT32 posvidwidth = 0, posvidheight = 0;
 		UINT16 maskx, masky;
 		UINT32 relativepos;
 
 		// ---
 		// Screw it, we do the fixed point math ourselves up front.
-		scrxpos[0] = 0;
-		for (relativepos = 0, maskx = 1; maskx < fademask->width; ++maskx)
-			scrxpos[maskx] = (relativepos += fademask->xscale)>>FRACBITS;
-		scrxpos[fademask->width] = vid.width;
-
-		scrypos[0] = 0;
-		for (relativepos = 0, masky = 1; masky < fademask->height; ++masky)
-			scrypos[masky] = (relativepos += fademask->yscale)>>FRACBITS;
-		scrypos[fademask->height] = vid.height;
+		if (!scrxpos || poswidth != fademask->width || posheight != fademask->height
+			|| posvidwidth != vid.width || posvidheight != vid.height)
+		{
+			scrxpos = Z_Realloc(scrxpos, (fademask->width + 1)  * sizeof(UINT16), PU_STATIC, NULL);
+			scrypos = Z_Realloc(scrypos, (fademask->height + 1) * sizeof(UINT16), PU_STATIC, NULL);
+
+			scrxpos[0] = 0;
+			for (relativepos = 0, maskx = 1; maskx < fademask->width; ++maskx)
+				scrxpos[maskx] = (relativepos += fademask->xscale)>>FRACBITS;
+			scrxpos[fademask->width] = vid.width;
+
+			scrypos[0] = 0;
+			for (relativepos = 0, masky = 1; masky < fademask->height; ++masky)
+				scrypos[masky] = (relativepos += fademask->yscale)>>FRACBITS;
+			scrypos[fademask->height] = vid.height;
+
+			poswidth = fademask->width;
+			posheight = fademask->height;
+			posvidwidth = vid.width;
+			posvidheight = vid.height;
+		}
 		// ---
 
 		maskx = masky = 0;
@@ -261,7 +278,7 @@ static void F_DoWipe(fademask_t *fademask)
 			else
 			{
 				// pointer to transtable that this mask would use
-				transtbl = transtables + ((9 - *mask)<<FF_TRANSSHIFT);
+				transtbl = R_GetTranslucencyTable(10 - *mask);
 
 				// DRAWING LOOP
 				while (draw_linestogo--)
@@ -282,9 +299,6 @@ static void F_DoWipe(fademask_t *fademask)
 			if (++maskx >= fademask->width)
 				++masky, maskx = 0;
 		} while (++mask < maskend);
-
-		free(scrxpos);
-		free(scrypos);
 	}
 }
 #endif
@@ -27,11 +27,14 @@
 #include <sys/stat.h>
 #endif
 #include <string.h>
+#include <time.h>
 
 #include "filesrch.h"
 #include "d_netfil.h"
 #include "m_misc.h"
 #include "z_zone.h"
+#include "i_system.h"
+#include "i_threads.h"
 #include "m_menu.h" // Addons_option_Onchange
 
 #if (defined (_WIN32) && !defined (_WIN32_WCE)) && defined (_MSC_VER) && !defined (_XBOX)
@@ -340,6 +343,7 @@ size_t sizedirmenu, sizecoredirmenu; // ditto
 size_t dir_on[menudepth];
 UINT8 refreshdirmenu = 0;
 char *refreshdirname = NULL;
+boolean dirmenuempty = false;
 
 size_t packetsizetally = 0;
 size_t mainwadstally = 0;
@@ -374,6 +378,11 @@ boolean preparefilemenu(boolean samedepth)
 	return false;
 }
 
+boolean pollfilemenu(void)
+{
+	return false;
+}
+
 #elif defined (_WIN32_WCE)
 filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *wantedmd5sum,
 	boolean completepath, int maxsearchdepth)
@@ -443,84 +452,388 @@ boolean preparefilemenu(boolean samedepth)
 	return false;
 }
 
+boolean pollfilemenu(void)
+{
+	return false;
+}
+
 #else
 
-filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *wantedmd5sum, boolean completepath, int maxsearchdepth)
+// ==========================================================================
+// Directory listings. What a directory holds is kept until its modification
+// time changes, so the Addons menu opens again straight away, and filesearch
+// can look through the same folders for every file a server needs without
+// reading them all again. With threads, the menu's directories are read on a
+// thread of their own, and the menu fills in as they are.
+// ==========================================================================
+
+#define MAXDIRLISTINGS 64
+
+typedef struct
 {
-	filestatus_t retval = FS_NOTFOUND;
-	DIR **dirhandle;
-	struct dirent *dent;
+	char *name;
+	boolean isdir;
+} direntry_t;
+
+typedef struct dirlisting_s
+{
+	char *path;
+	time_t mtime; // of the directory, when it was read
+	time_t readtime; // when it was read
+	boolean complete; // read all the way through
+	boolean failed; // couldn't be opened
+	INT32 users; // being looked through, so it can't be thrown out or read again
+	direntry_t *entries;
+	size_t numentries, maxentries;
+	struct dirlisting_s *next; // most recently used first
+} dirlisting_t;
+
+static dirlisting_t *dirlistings = NULL;
+static size_t numdirlistings = 0;
+
+// The listing the menu was made from, and how much of it there was
+static dirlisting_t *menulisting = NULL;
+static size_t menulistingsize = 0;
+static boolean menulistingcomplete = false;
+static tic_t menulistingtic = 0;
+
+#ifdef HAVE_THREADS
+static dirlisting_t *scanlisting = NULL; // being read by the scan thread
+static dirlisting_t *nextscan = NULL; // for it to read next
+static boolean scanthread = false;
+static boolean scanstop = false;
+
+static I_mutex dirlisting_mutex;
+static I_cond dirlisting_workcond;
+static I_cond dirlisting_donecond;
+#endif
+
+static inline void lockdirlistings(void)
+{
+#ifdef HAVE_THREADS
+	I_lock_mutex(&dirlisting_mutex);
+#endif
+}
+
+static inline void unlockdirlistings(void)
+{
+#ifdef HAVE_THREADS
+	I_unlock_mutex(dirlisting_mutex);
+#endif
+}
+
+// Is listing being read, or about to be, by the scan thread?
+static inline boolean dirlistingscanning(const dirlisting_t *listing)
+{
+#ifdef HAVE_THREADS
+	return (listing == scanlisting || listing == nextscan);
+#else
+	(void)listing;
+	return false;
+#endif
+}
+
+// Waits for the scan thread to be done with listing. Call with the lock held.
+static inline void waitdirlisting(const dirlisting_t *listing)
+{
+#ifdef HAVE_THREADS
+	while (dirlistingscanning(listing))
+		I_hold_cond(&dirlisting_donecond, dirlisting_mutex);
+#else
+	(void)listing;
+#endif
+}
+
+static time_t dirmtime(const char *path)
+{
+	char dirpath[1024];
 	struct stat fsstat;
-	int found = 0;
-	char *searchname = strdup(filename);
-	int depthleft = maxsearchdepth;
-	char searchpath[1024];
-	size_t *searchpathindex;
+	size_t len;
+
+	// Windows can't stat a directory with a slash on the end
+	strlcpy(dirpath, path, sizeof dirpath);
+	len = strlen(dirpath);
+	if (len > 1 && (dirpath[len-1] == '/' || dirpath[len-1] == '\\') && dirpath[len-2] != ':')
+		dirpath[len-1] = '\0';
 
-	dirhandle = (DIR**) malloc(maxsearchdepth * sizeof (DIR*));
-	searchpathindex = (size_t *) malloc(maxsearchdepth * sizeof (size_t));
+	if (stat(dirpath, &fsstat) < 0)
+		return 0;
+	return fsstat.st_mtime;
+}
+
+static void cleardirlisting(dirlisting_t *listing)
+{
+	size_t i;
+
+	for (i = 0; i < listing->numentries; i++)
+		free(listing->entries[i].name);
+	listing->numentries = 0;
+	listing->complete = listing->failed = false;
+}
+
+static void freedirlisting(dirlisting_t *listing)
+{
+	cleardirlisting(listing);
+	free(listing->entries);
+	free(listing->path);
+	free(listing);
+}
+
+//
+// readdirlisting
+// Reads what's in a directory into its listing. The scan thread gives up
+// part way if another directory is wanted first, and returns false.
+//
+static boolean readdirlisting(dirlisting_t *listing, boolean abortable)
+{
+	char fullpath[1024];
+	DIR *dirhandle;
+	struct dirent *dent;
+	struct stat fsstat;
+	size_t len;
 
-	strcpy(searchpath,startpath);
-	searchpathindex[--depthleft] = strlen(searchpath) + 1;
+	lockdirlistings();
+	cleardirlisting(listing);
+	unlockdirlistings();
 
-	dirhandle[depthleft] = opendir(searchpath);
+	strlcpy(fullpath, listing->path, sizeof fullpath);
+	len = strlen(fullpath);
 
-	if (dirhandle[depthleft] == NULL)
+	if (!(dirhandle = opendir(fullpath)))
 	{
-		free(searchname);
-		free(dirhandle);
-		free(searchpathindex);
-		return FS_NOTFOUND;
+		lockdirlistings();
+		listing->failed = listing->complete = true;
+		unlockdirlistings();
+		return true;
 	}
 
-	if (searchpath[searchpathindex[depthleft]-2] != '/')
+	while ((dent = readdir(dirhandle)) != NULL)
 	{
-		searchpath[searchpathindex[depthleft]-1] = '/';
-		searchpath[searchpathindex[depthleft]] = 0;
+		if (dent->d_name[0]=='.' &&
+				(dent->d_name[1]=='\0' ||
+					(dent->d_name[1]=='.' &&
+						dent->d_name[2]=='\0')))
+			continue; // we don't want to scan uptree
+
+		strlcpy(&fullpath[len], dent->d_name, sizeof fullpath - len);
+		if (stat(fullpath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
+			continue; // was the file (re)moved? can't stat it
+
+		lockdirlistings();
+#ifdef HAVE_THREADS
+		if (abortable && (nextscan || scanstop))
+		{
+			unlockdirlistings();
+			closedir(dirhandle);
+			return false;
+		}
+#else
+		(void)abortable;
+#endif
+		if (listing->numentries == listing->maxentries)
+		{
+			listing->maxentries = listing->maxentries ? listing->maxentries*2 : 64;
+			listing->entries = realloc(listing->entries, listing->maxentries * sizeof (*listing->entries));
+			if (!listing->entries)
+				I_Error("readdirlisting(): could not reallocate entries.");
+		}
+		listing->entries[listing->numentries].name = strdup(dent->d_name);
+		listing->entries[listing->numentries].isdir = S_ISDIR(fsstat.st_mode);
+		if (listing->entries[listing->numentries].name)
+			listing->numentries++;
+		unlockdirlistings();
 	}
-	else
-		searchpathindex[depthleft]--;
 
-	while ((!found) && (depthleft < maxsearchdepth))
+	closedir(dirhandle);
+
+	lockdirlistings();
+	listing->complete = true;
+	unlockdirlistings();
+	return true;
+}
+
+#ifdef HAVE_THREADS
+static void scandirlistings(void *userdata)
+{
+	dirlisting_t *listing;
+
+	(void)userdata;
+
+	I_lock_mutex(&dirlisting_mutex);
+	for (;;)
 	{
-		searchpath[searchpathindex[depthleft]]=0;
-		dent = readdir(dirhandle[depthleft]);
+		while (!nextscan && !scanstop)
+			I_hold_cond(&dirlisting_workcond, dirlisting_mutex);
+		if (scanstop)
+			break;
+		listing = scanlisting = nextscan;
+		nextscan = NULL;
+
+		I_unlock_mutex(dirlisting_mutex);
+		readdirlisting(listing, true);
+		I_lock_mutex(&dirlisting_mutex);
+
+		scanlisting = NULL;
+		I_wake_all_cond(&dirlisting_donecond);
+	}
+	scanthread = false;
+	I_wake_all_cond(&dirlisting_donecond);
+	I_unlock_mutex(dirlisting_mutex);
+}
+
+static void stopdirlistings(void)
+{
+	I_lock_mutex(&dirlisting_mutex);
+	scanstop = true;
+	I_wake_all_cond(&dirlisting_workcond);
+	while (scanthread)
+		I_hold_cond(&dirlisting_donecond, dirlisting_mutex);
+	I_unlock_mutex(dirlisting_mutex);
+}
+#endif
+
+//
+// getdirlisting
+// Finds the listing of a directory, reading it again if it has changed.
+// With wait, or without threads, it's read before this returns; otherwise
+// it's read in the background, and can be incomplete for a while.
+//
+static dirlisting_t *getdirlisting(const char *path, boolean wait)
+{
+	dirlisting_t *listing, **link;
+	const time_t mtime = dirmtime(path);
+	boolean reread;
+
+	lockdirlistings();
+
+	for (link = &dirlistings; *link; link = &(*link)->next)
+		if (!strcmp((*link)->path, path))
+			break;
 
-		if (!dent)
+	if ((listing = *link) != NULL)
+		*link = listing->next;
+	else
+	{
+		if (numdirlistings >= MAXDIRLISTINGS) // throw out the oldest one nobody is using
 		{
-			closedir(dirhandle[depthleft++]);
-			continue;
+			dirlisting_t **oldest = NULL;
+			for (link = &dirlistings; *link; link = &(*link)->next)
+				if (!(*link)->users && !dirlistingscanning(*link))
+					oldest = link;
+			if (oldest)
+			{
+				dirlisting_t *old = *oldest;
+				*oldest = old->next;
+				freedirlisting(old);
+				numdirlistings--;
+			}
 		}
 
-		if (dent->d_name[0]=='.' &&
-				(dent->d_name[1]=='\0' ||
-					(dent->d_name[1]=='.' &&
-						dent->d_name[2]=='\0')))
+		listing = calloc(1, sizeof (*listing));
+		if (!listing || !(listing->path = strdup(path)))
+			I_Error("getdirlisting(): could not create listing.");
+		numdirlistings++;
+	}
+	listing->next = dirlistings;
+	dirlistings = listing;
+
+	// A file added or taken away changes the directory's time, but the time
+	// only counts seconds. So a listing read in the same second as a change
+	// may have missed something, and is read once more afterwards.
+	if (listing->users)
+		reread = false; // in the middle of being looked through
+	else if (!listing->readtime)
+		reread = true;
+	else if (listing->mtime != mtime)
+		reread = true;
+	else if (!listing->complete)
+		reread = !dirlistingscanning(listing); // was given up on
+	else
+		reread = (listing->mtime + 1 >= listing->readtime && time(NULL) > listing->readtime + 1);
+
+	if (reread)
+	{
+		listing->mtime = mtime;
+		listing->readtime = time(NULL);
+#ifdef HAVE_THREADS
+		if (!wait)
 		{
-			// we don't want to scan uptree
-			continue;
+			if (!scanthread)
+			{
+				static boolean exitfunc = false;
+				if (!exitfunc)
+				{
+					I_AddExitFunc(stopdirlistings);
+					exitfunc = true;
+				}
+				scanthread = true;
+				I_spawn_thread("dir-scan", scandirlistings, NULL);
+			}
+			nextscan = listing;
+			I_wake_one_cond(&dirlisting_workcond);
+			unlockdirlistings();
+			return listing;
 		}
+#endif
+		waitdirlisting(listing);
+		listing->users++;
+		unlockdirlistings();
+		readdirlisting(listing, false);
+		lockdirlistings();
+		listing->users--;
+	}
+	else if (wait)
+		waitdirlisting(listing);
+
+	unlockdirlistings();
+	return listing;
+}
+
+//
+// searchdirlisting
+// Looks for searchname in the directory at searchpath,
+// and the ones under it up to depthleft deep.
+//
+static filestatus_t searchdirlisting(char *filename, const char *searchname, char *searchpath,
+	const UINT8 *wantedmd5sum, boolean completepath, int depthleft)
+{
+	filestatus_t retval = FS_NOTFOUND;
+	dirlisting_t *listing = getdirlisting(searchpath, true);
+	const size_t len = strlen(searchpath);
+	size_t i;
+
+	if (listing->failed)
+		return FS_NOTFOUND;
 
-		// okay, now we actually want searchpath to incorporate d_name
-		strcpy(&searchpath[searchpathindex[depthleft]],dent->d_name);
+	listing->users++;
+	for (i = 0; i < listing->numentries && retval != FS_FOUND; i++)
+	{
+		const direntry_t *entry = &listing->entries[i];
+
+		if (len + strlen(entry->name) + 2 > 1024)
+			continue;
 
-		if (stat(searchpath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
-			; // was the file (re)moved? can't stat it
-		else if (S_ISDIR(fsstat.st_mode) && depthleft)
+		// okay, now we actually want searchpath to incorporate the name
+		strcpy(&searchpath[len], entry->name);
+
+		if (entry->isdir)
 		{
-			searchpathindex[--depthleft] = strlen(searchpath) + 1;
-			dirhandle[depthleft] = opendir(searchpath);
-			if (!dirhandle[depthleft])
+			if (!depthleft)
+				continue;
+			strcat(searchpath, "/");
+			switch (searchdirlisting(filename, searchname, searchpath, wantedmd5sum, completepath, depthleft-1))
 			{
-					// can't open it... maybe no read-permissions
-					// go back to previous dir
-					depthleft++;
+				case FS_FOUND:
+					retval = FS_FOUND;
+					break;
+				case FS_MD5SUMBAD:
+					retval = FS_MD5SUMBAD;
+					break;
+				default: // prevent some compiler warnings
+					break;
 			}
-
-			searchpath[searchpathindex[depthleft]-1]='/';
-			searchpath[searchpathindex[depthleft]]=0;
 		}
-		else if (!strcasecmp(searchname, dent->d_name))
+		else if (!strcasecmp(searchname, entry->name))
 		{
 			switch (checkfilemd5(searchpath, wantedmd5sum))
 			{
@@ -528,9 +841,8 @@ filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *want
 					if (completepath)
 						strcpy(filename,searchpath);
 					else
-						strcpy(filename,dent->d_name);
+						strcpy(filename,entry->name);
 					retval = FS_FOUND;
-					found = 1;
 					break;
 				case FS_MD5SUMBAD:
 					retval = FS_MD5SUMBAD;
@@ -540,13 +852,33 @@ filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *want
 			}
 		}
 	}
+	listing->users--;
 
-	for (; depthleft < maxsearchdepth; closedir(dirhandle[depthleft++]));
+	searchpath[len] = '\0';
+	return retval;
+}
 
-	free(searchname);
-	free(searchpathindex);
-	free(dirhandle);
+filestatus_t filesearch(char *filename, const char *startpath, const UINT8 *wantedmd5sum, boolean completepath, int maxsearchdepth)
+{
+	filestatus_t retval;
+	char *searchname = strdup(filename);
+	char searchpath[1024];
+	size_t len;
+
+	if (!searchname || maxsearchdepth < 1)
+	{
+		free(searchname);
+		return FS_NOTFOUND;
+	}
+
+	strlcpy(searchpath, startpath, sizeof searchpath - 1);
+	len = strlen(searchpath);
+	if (!len || searchpath[len-1] != '/')
+		strcat(searchpath, "/");
+
+	retval = searchdirlisting(filename, searchname, searchpath, wantedmd5sum, completepath, maxsearchdepth-1);
 
+	free(searchname);
 	return retval;
 }
 
@@ -611,8 +943,15 @@ void closefilemenu(boolean validsize)
 	if (refreshdirname)
 		Z_Free(refreshdirname);
 	refreshdirname = NULL;
+
+	if (menulisting)
+		menulisting->users--;
+	menulisting = NULL;
 }
 
+// Searching... isn't a file, and the search's own No results... mustn't be mistaken for it
+#define SEARCHABLE(entry) ((UINT8)((entry)[DIR_TYPE]) != EXT_NORESULTS)
+
 void searchfilemenu(char *tempname)
 {
 	size_t i, first;
@@ -669,7 +1008,7 @@ void searchfilemenu(char *tempname)
 	sizedirmenu = 0;
 	for (i = first; i < sizecoredirmenu; i++)
 	{
-		if (filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
+		if (SEARCHABLE(coredirmenu[i]) && filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
 			sizedirmenu++;
 	}
 
@@ -691,7 +1030,7 @@ void searchfilemenu(char *tempname)
 	sizedirmenu = 0;
 	for (i = first; i < sizecoredirmenu; i++)
 	{
-		if (filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
+		if (SEARCHABLE(coredirmenu[i]) && filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
 		{
 			if (tempname && !strcmp(coredirmenu[i]+DIR_STRING, tempname))
 			{
@@ -712,11 +1051,12 @@ void searchfilemenu(char *tempname)
 
 boolean preparefilemenu(boolean samedepth)
 {
-	DIR *dirhandle;
-	struct dirent *dent;
-	struct stat fsstat;
-	size_t pos = 0, folderpos = 0, numfolders = 0;
+	dirlisting_t *listing;
+	size_t i, pos = 0, folderpos = 0, numfolders = 0;
 	char *tempname = NULL;
+	boolean complete;
+
+	dirmenuempty = false;
 
 	if (samedepth)
 	{
@@ -726,58 +1066,64 @@ boolean preparefilemenu(boolean samedepth)
 	else
 		menusearch[0] = menusearch[1] = 0; // clear search
 
-	if (!(dirhandle = opendir(menupath))) // get directory
+	menupath[menupathindex[menudepthleft]] = 0;
+	listing = getdirlisting(menupath, false); // get directory
+
+	if (listing != menulisting)
 	{
+		if (menulisting)
+			menulisting->users--;
+		listing->users++;
+		menulisting = listing;
+	}
+
+	lockdirlistings();
+
+	if (listing->failed)
+	{
+		unlockdirlistings();
 		closefilemenu(true);
+		if (tempname)
+			Z_Free(tempname);
 		return false;
 	}
 
+	complete = listing->complete;
+	menulistingsize = listing->numentries;
+	menulistingcomplete = complete;
+	menulistingtic = I_GetTime();
+
 	for (; sizecoredirmenu > 0; sizecoredirmenu--) // clear out existing items
 	{
 		Z_Free(coredirmenu[sizecoredirmenu-1]);
 		coredirmenu[sizecoredirmenu-1] = NULL;
 	}
 
-	while (true)
+	for (i = 0; i < menulistingsize; i++)
 	{
-		menupath[menupathindex[menudepthleft]] = 0;
-		dent = readdir(dirhandle);
+		const direntry_t *entry = &listing->entries[i];
 
-		if (!dent)
-			break;
-		else if (dent->d_name[0]=='.' &&
-				(dent->d_name[1]=='\0' ||
-					(dent->d_name[1]=='.' &&
-						dent->d_name[2]=='\0')))
-			continue; // we don't want to scan uptree
-
-		strcpy(&menupath[menupathindex[menudepthleft]],dent->d_name);
-
-		if (stat(menupath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
-			; // was the file (re)moved? can't stat it
-		else // is a file or directory
+		if (!entry->isdir) // file
 		{
-			if (!S_ISDIR(fsstat.st_mode)) // file
+			if (!cv_addons_showall.value)
 			{
-				if (!cv_addons_showall.value)
-				{
-					size_t len = strlen(dent->d_name)+1;
-					UINT8 ext;
-					for (ext = 0; ext < NUM_EXT_TABLE; ext++)
-						if (!strcasecmp(exttable[ext]+1, dent->d_name+len-(exttable[ext][0]))) break; // extension comparison
-					if (ext == NUM_EXT_TABLE) continue; // not an addfile-able (or exec-able) file
-				}
+				size_t len = strlen(entry->name)+1;
+				UINT8 ext;
+				for (ext = 0; ext < NUM_EXT_TABLE; ext++)
+					if (!strcasecmp(exttable[ext]+1, entry->name+len-(exttable[ext][0]))) break; // extension comparison
+				if (ext == NUM_EXT_TABLE) continue; // not an addfile-able (or exec-able) file
 			}
-			else // directory
-				numfolders++;
-
-			sizecoredirmenu++;
 		}
+		else // directory
+			numfolders++;
+
+		sizecoredirmenu++;
 	}
 
-	if (!sizecoredirmenu)
+	if (!sizecoredirmenu && complete)
 	{
-		closedir(dirhandle);
+		unlockdirlistings();
+		dirmenuempty = true;
 		closefilemenu(false);
 		if (tempname)
 			Z_Free(tempname);
@@ -791,120 +1137,120 @@ boolean preparefilemenu(boolean samedepth)
 		folderpos++;
 	}
 
+	if (!complete) // and for Searching... at the bottom
+		sizecoredirmenu++;
+
 	if (dirmenu && dirmenu == coredirmenu)
 		dirmenu = NULL;
 
 	if (!(coredirmenu = Z_Realloc(coredirmenu, sizecoredirmenu*sizeof(char *), PU_STATIC, NULL)))
 	{
-		closedir(dirhandle); // just in case
+		unlockdirlistings(); // just in case
 		I_Error("preparefilemenu(): could not reallocate coredirmenu.");
 	}
 
-	rewinddir(dirhandle);
-
-	while ((pos+folderpos) < sizecoredirmenu)
+	for (i = 0; i < menulistingsize; i++)
 	{
-		menupath[menupathindex[menudepthleft]] = 0;
-		dent = readdir(dirhandle);
-
-		if (!dent)
-			break;
-		else if (dent->d_name[0]=='.' &&
-				(dent->d_name[1]=='\0' ||
-					(dent->d_name[1]=='.' &&
-						dent->d_name[2]=='\0')))
-			continue; // we don't want to scan uptree
+		const direntry_t *entry = &listing->entries[i];
+		char *temp;
+		size_t len = strlen(entry->name)+1;
+		UINT8 ext = EXT_FOLDER;
+		UINT8 folder;
 
-		strcpy(&menupath[menupathindex[menudepthleft]],dent->d_name);
-
-		if (stat(menupath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
-			; // was the file (re)moved? can't stat it
-		else // is a file or directory
+		if (!entry->isdir) // file
 		{
-			char *temp;
-			size_t len = strlen(dent->d_name)+1;
-			UINT8 ext = EXT_FOLDER;
-			UINT8 folder;
+			for (; ext < NUM_EXT_TABLE; ext++)
+				if (!strcasecmp(exttable[ext]+1, entry->name+len-(exttable[ext][0]))) break; // extension comparison
+			if (ext == NUM_EXT_TABLE && !cv_addons_showall.value) continue; // not an addfile-able (or exec-able) file
+			ext += EXT_START; // moving to be appropriate position
 
-			if (!S_ISDIR(fsstat.st_mode)) // file
+			if (ext >= EXT_LOADSTART)
 			{
-				if (!((numfolders+pos) < sizecoredirmenu)) continue; // crash prevention
-				for (; ext < NUM_EXT_TABLE; ext++)
-					if (!strcasecmp(exttable[ext]+1, dent->d_name+len-(exttable[ext][0]))) break; // extension comparison
-				if (ext == NUM_EXT_TABLE && !cv_addons_showall.value) continue; // not an addfile-able (or exec-able) file
-				ext += EXT_START; // moving to be appropriate position
-
-				if (ext >= EXT_LOADSTART)
+				size_t j;
+				for (j = 0; j < numwadfiles; j++)
 				{
-					size_t i;
-					for (i = 0; i < numwadfiles; i++)
+					if (!filenamebuf[j][0])
 					{
-						if (!filenamebuf[i][0])
-						{
-							strncpy(filenamebuf[i], wadfiles[i]->filename, MAX_WADPATH);
-							filenamebuf[i][MAX_WADPATH - 1] = '\0';
-							nameonly(filenamebuf[i]);
-						}
-
-						if (strcmp(dent->d_name, filenamebuf[i]))
-							continue;
-						if (cv_addons_md5.value && !checkfilemd5(menupath, wadfiles[i]->md5sum))
-							continue;
+						strncpy(filenamebuf[j], wadfiles[j]->filename, MAX_WADPATH);
+						filenamebuf[j][MAX_WADPATH - 1] = '\0';
+						nameonly(filenamebuf[j]);
+					}
 
-						ext |= EXT_LOADED;
+					if (strcmp(entry->name, filenamebuf[j]))
+						continue;
+					if (cv_addons_md5.value)
+					{
+						strcpy(&menupath[menupathindex[menudepthleft]],entry->name);
+						if (!checkfilemd5(menupath, wadfiles[j]->md5sum))
+							continue;
 					}
-				}
-				else if (ext == EXT_TXT)
-				{
-					if (!strcmp(dent->d_name, "log.txt") || !strcmp(dent->d_name, "errorlog.txt"))
-						ext |= EXT_LOADED;
-				}
 
-				if (!strcmp(dent->d_name, configfile))
 					ext |= EXT_LOADED;
-
-				folder = 0;
+				}
 			}
-			else // directory
-				len += (folder = 1);
-
-			if (len > 255)
-				len = 255;
-
-			if (!(temp = Z_Malloc((len+DIR_STRING+folder) * sizeof (char), PU_STATIC, NULL)))
-				I_Error("preparefilemenu(): could not create file entry.");
-			temp[DIR_TYPE] = ext;
-			temp[DIR_LEN] = (UINT8)(len);
-			strlcpy(temp+DIR_STRING, dent->d_name, len);
-			if (folder)
+			else if (ext == EXT_TXT)
 			{
-				strcpy(temp+len, PATHSEP);
-				coredirmenu[folderpos++] = temp;
+				if (!strcmp(entry->name, "log.txt") || !strcmp(entry->name, "errorlog.txt"))
+					ext |= EXT_LOADED;
 			}
-			else
-				coredirmenu[numfolders + pos++] = temp;
+
+			if (!strcmp(entry->name, configfile))
+				ext |= EXT_LOADED;
+
+			folder = 0;
+		}
+		else // directory
+			len += (folder = 1);
+
+		if (len > 255)
+			len = 255;
+
+		if (!(temp = Z_Malloc((len+DIR_STRING+folder) * sizeof (char), PU_STATIC, NULL)))
+			I_Error("preparefilemenu(): could not create file entry.");
+		temp[DIR_TYPE] = ext;
+		temp[DIR_LEN] = (UINT8)(len);
+		strlcpy(temp+DIR_STRING, entry->name, len);
+		if (folder)
+		{
+			strcpy(temp+len, PATHSEP);
+			coredirmenu[folderpos++] = temp;
 		}
+		else
+			coredirmenu[numfolders + pos++] = temp;
 	}
 
-	closedir(dirhandle);
+	unlockdirlistings();
 
 	if ((menudepthleft != menudepth-1) // now for UP... entry
 		&& !(coredirmenu[0] = Z_StrDup(va("%c\5UP...", EXT_UP))))
 			I_Error("preparefilemenu(): could not create \"UP...\".");
 
-	menupath[menupathindex[menudepthleft]] = 0;
-	sizecoredirmenu = (numfolders+pos); // just in case things shrink between opening and rewind
+	if (!complete // and Searching...
+		&& !(coredirmenu[numfolders + pos++] = Z_StrDup(va("%c\15Searching...", EXT_NORESULTS))))
+			I_Error("preparefilemenu(): could not create \"Searching...\".");
 
-	if (!sizecoredirmenu)
-	{
-		dir_on[menudepthleft] = 0;
-		closefilemenu(false);
-		return false;
-	}
+	menupath[menupathindex[menudepthleft]] = 0;
+	sizecoredirmenu = (numfolders+pos);
 
 	searchfilemenu(tempname);
 
 	return true;
 }
 
+boolean pollfilemenu(void)
+{
+	boolean changed, complete;
+
+	if (!menulisting || menulistingcomplete)
+		return false;
+
+	lockdirlistings();
+	complete = menulisting->complete;
+	changed = (complete || menulisting->numentries != menulistingsize);
+	unlockdirlistings();
+
+	// Don't make the whole menu again every frame while it's filling in
+	return (changed && (complete || I_GetTime() - menulistingtic >= TICRATE/4));
+}
+
 #endif
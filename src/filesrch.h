@@ -41,6 +41,7 @@ extern size_t sizedirmenu;
 extern size_t dir_on[menudepth];
 extern UINT8 refreshdirmenu;
 extern char *refreshdirname;
+extern boolean dirmenuempty; // the last preparefilemenu found nothing to show
 
 extern size_t packetsizetally;
 extern size_t mainwadstally;
@@ -95,4 +96,11 @@ void closefilemenu(boolean validsize);
 void searchfilemenu(char *tempname);
 boolean preparefilemenu(boolean samedepth);
 
+/**	\brief	Whether the folder the menu shows has been read further since
+		preparefilemenu, so it should be made again. Folders that haven't been
+		read before, or that have changed, are read in the background when
+		the interface has threads, and the menu fills in as they are.
+*/
+boolean pollfilemenu(void);
+
 #endif // __FILESRCH_H__
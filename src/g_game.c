@@ -16,6 +16,7 @@
 #include "d_main.h"
 #include "d_player.h"
 #include "d_clisrv.h"
+#include "d_net.h"
 #include "f_finale.h"
 #include "p_setup.h"
 #include "p_saveg.h"
@@ -46,6 +47,8 @@
 #include "b_bot.h"
 #include "m_cond.h" // condition sets
 #include "md5.h" // demo checksums
+#include "lzf.h" // demo keyframes
+#include "m_bench.h" // benchrender
 
 gameaction_t gameaction;
 gamestate_t gamestate = GS_NULL;
@@ -242,6 +245,7 @@ static UINT16 demoversion;
 boolean singledemo; // quit after playing a demo from cmdline
 boolean demo_start; // don't start playing demo right away
 static boolean demosynced = true; // console warning message
+static UINT32 demotics; // tics recorded or played so far
 
 boolean metalrecording; // recording as metal sonic
 mobj_t *metalplayback;
@@ -264,17 +268,48 @@ static struct {
 	mobj_t **hitlist;
 } ghostext;
 
+// A ghost's tic, decoded from its replay when it was added
+typedef struct
+{
+	fixed_t x, y, z;
+	fixed_t scale; // with EZT_SCALE
+	UINT8 angle; // top 8 bits
+	UINT8 frame;
+	UINT8 extra; // EZT_ flags
+	UINT8 color; // with EZT_COLOR
+	UINT8 sprite; // with EZT_SPRITE
+	UINT8 numhits; // with EZT_HIT, the next few of the ghost's hits
+} ghostframe_t;
+
+typedef struct
+{
+	UINT32 type;
+	UINT16 health;
+	fixed_t x, y, z;
+	angle_t angle;
+} ghosthit_t;
+
 // Your naming conventions are stupid and useless.
 // There is no conflict here.
 typedef struct demoghost {
 	UINT8 checksum[16];
-	UINT8 *buffer, *p, color;
-	UINT16 version;
-	mobj_t oldmo, *mo;
+	ghostframe_t *frames;
+	ghosthit_t *hits;
+	size_t numframes, tic, hit;
+	UINT8 color, basecolor;
+	mobj_t *mo;
 	struct demoghost *next;
 } demoghost;
 demoghost *ghosts = NULL;
 
+static void G_FreeGhost(demoghost *gh)
+{
+	Z_Free(gh->frames);
+	if (gh->hits)
+		Z_Free(gh->hits);
+	Z_Free(gh);
+}
+
 boolean precache = true; // if true, load all graphics at start
 
 INT16 prevmap, nextmap;
@@ -393,6 +428,8 @@ consvar_t cv_mousemove = {"mousemove", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL,
 consvar_t cv_mousemove2 = {"mousemove2", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_analog = {"analog", "Off", CV_CALL, CV_OnOff, Analog_OnChange, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_analog2 = {"analog2", "Off", CV_CALL, CV_OnOff, Analog2_OnChange, 0, NULL, NULL, 0, 0, NULL};
+// older versions can't read packed saves
+consvar_t cv_compresssaves = {"compresssaves", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 #if defined (DC)
 consvar_t cv_useranalog = {"useranalog", "On", CV_SAVE|CV_CALL, CV_OnOff, UserAnalog_OnChange, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_useranalog2 = {"useranalog2", "On", CV_SAVE|CV_CALL, CV_OnOff, UserAnalog2_OnChange, 0, NULL, NULL, 0, 0, NULL};
@@ -486,49 +523,11 @@ consvar_t cv_firenaxis2 = {"joyaxis2_firenormal", "Z-Axis", CV_SAVE, joyaxis_con
 #endif
 
 
-#if MAXPLAYERS > 32
-#error "please update player_name table using the new value for MAXPLAYERS"
-#endif
-
 #ifdef SEENAMES
 player_t *seenplayer; // player we're aiming at right now
 #endif
 
-char player_names[MAXPLAYERS][MAXPLAYERNAME+1] =
-{
-	"Player 1",
-	"Player 2",
-	"Player 3",
-	"Player 4",
-	"Player 5",
-	"Player 6",
-	"Player 7",
-	"Player 8",
-	"Player 9",
-	"Player 10",
-	"Player 11",
-	"Player 12",
-	"Player 13",
-	"Player 14",
-	"Player 15",
-	"Player 16",
-	"Player 17",
-	"Player 18",
-	"Player 19",
-	"Player 20",
-	"Player 21",
-	"Player 22",
-	"Player 23",
-	"Player 24",
-	"Player 25",
-	"Player 26",
-	"Player 27",
-	"Player 28",
-	"Player 29",
-	"Player 30",
-	"Player 31",
-	"Player 32"
-};
+char player_names[MAXPLAYERS][MAXPLAYERNAME+1]; // SV_ResetServer names them "Player 1" and so on
 
 INT16 rw_maximums[NUM_WEAPONS] =
 {
@@ -1010,6 +1009,45 @@ static fixed_t forwardmove[2] = {25<<FRACBITS>>16, 50<<FRACBITS>>16};
 static fixed_t sidemove[2] = {25<<FRACBITS>>16, 50<<FRACBITS>>16}; // faster!
 static fixed_t angleturn[3] = {640, 1280, 320}; // + slow turn
 
+//
+// G_LoadtestTiccmd
+//
+// A -loadtest client runs forward, picking a new way to turn and
+// whether to jump or spin every half second to few seconds. It has to
+// use rand(), since the game's own random numbers are shared by all.
+//
+static void G_LoadtestTiccmd(ticcmd_t *cmd, player_t *player)
+{
+	static tic_t nextchange = 0;
+	static boolean left, right, jump, spin;
+	const tic_t now = I_GetTime();
+
+	if (gamestate != GS_LEVEL || !player->mo)
+		return;
+
+	if (player->playerstate == PST_DEAD)
+	{
+		cmd->angleturn = (INT16)(localangle >> 16);
+		cmd->buttons |= BT_JUMP;
+		return;
+	}
+
+	if (now >= nextchange)
+	{
+		const INT32 r = rand();
+
+		left = (r & 3) == 1;
+		right = (r & 3) == 2;
+		jump = (r & 4) != 0;
+		spin = (r & 24) == 24;
+		nextchange = now + TICRATE/2 + (tic_t)(rand() % (2*TICRATE));
+	}
+
+	B_KeysToTiccmd(player->mo, cmd, true, false, left, right, false, false, jump, spin);
+	localangle += (cmd->angleturn<<16);
+	cmd->angleturn = (INT16)(localangle >> 16);
+}
+
 void G_BuildTiccmd(ticcmd_t *cmd, INT32 realtics)
 {
 	boolean forcestrafe = false;
@@ -1033,6 +1071,13 @@ void G_BuildTiccmd(ticcmd_t *cmd, INT32 realtics)
 	{
 		cmd->angleturn = (INT16)(localangle >> 16);
 		cmd->aiming = G_ClipAimingPitch(&localaiming);
+		mousex = mousey = mlooky = 0; // don't save it up for after
+		return;
+	}
+
+	if (loadtest)
+	{
+		G_LoadtestTiccmd(cmd, player);
 		return;
 	}
 
@@ -1319,6 +1364,41 @@ void G_BuildTiccmd(ticcmd_t *cmd, INT32 realtics)
 		displayplayer = consoleplayer;
 }
 
+//
+// G_MouseLookAhead
+//
+// How far the mouse motion G_BuildTiccmd hasn't used yet will turn and
+// tilt the view, for drawing the frames in between tics with lateinput.
+//
+void G_MouseLookAhead(angle_t *turn, INT32 *aim)
+{
+	player_t *player = &players[consoleplayer];
+	boolean mouseaiming;
+
+	*turn = 0;
+	*aim = 0;
+
+	if (paused || P_AutoPause() || loadtest || demoplayback || gamestate != GS_LEVEL)
+		return;
+
+	mouseaiming = (PLAYER1INPUTDOWN(gc_mouseaiming)) ^
+		(cv_chasecam.value ? cv_chasefreelook.value : cv_alwaysfreelook.value);
+
+	if (mouseaiming)
+	{
+		INT32 player_invert = cv_invertmouse.value ? -1 : 1;
+		INT32 screen_invert =
+			(player->mo && (player->mo->eflags & MFE_VERTICALFLIP)
+			 && (!camera.chase || player->pflags & PF_FLIPCAM))
+			 ? -1 : 1;
+
+		*aim = (mlooky<<19)*player_invert*screen_invert;
+	}
+
+	if (!(cv_analog.value || player->climbing || (player->pflags & PF_SLIDING)))
+		*turn = (angle_t)(INT16)(-(mousex*8))<<16;
+}
+
 // like the g_buildticcmd 1 but using mouse2, gamcontrolbis, ...
 void G_BuildTiccmd2(ticcmd_t *cmd, INT32 realtics)
 {
@@ -1690,6 +1770,7 @@ static void Analog2_OnChange(void)
 void G_DoLoadLevel(boolean resetplayer)
 {
 	INT32 i;
+	boolean setup;
 
 	// Make sure objectplace is OFF when you first start the level!
 	OP_ResetObjectplace();
@@ -1710,8 +1791,12 @@ void G_DoLoadLevel(boolean resetplayer)
 			players[i].playerstate = PST_REBORN;
 	}
 
-	// Setup the level.
-	if (!P_SetupLevel(false))
+	// Setup the level. It only queues net commands and never sends packets,
+	// so the network thread can keep the connection going meanwhile.
+	Net_ReleaseNetwork();
+	setup = P_SetupLevel(false);
+	Net_ReclaimNetwork();
+	if (!setup)
 	{
 		// fail so reset game stuff
 		Command_ExitGame_f();
@@ -2535,7 +2620,7 @@ void G_ChangePlayerReferences(mobj_t *oldmo, mobj_t *newmo)
 	I_Assert((oldmo != NULL) && (newmo != NULL));
 
 	// scan all thinkers
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -3196,7 +3281,7 @@ void G_LoadGameData(void)
 	if (M_CheckParm("-resetdata"))
 		return; // Don't load (essentially, reset).
 
-	length = FIL_ReadFile(va(pandf, srb2home, gamedatafilename), &savebuffer);
+	length = FIL_ReadPackedFile(va(pandf, srb2home, gamedatafilename), &savebuffer);
 	if (!length) // Aw, no game data. Their loss!
 		return;
 
@@ -3441,8 +3526,8 @@ void G_SaveGameData(void)
 
 	length = save_p - savebuffer;
 
-	FIL_WriteFile(va(pandf, srb2home, gamedatafilename), savebuffer, length);
-	free(savebuffer);
+	// This happens after emblems and levels, so don't hold the game up for it
+	FIL_WriteFileLater(va(pandf, srb2home, gamedatafilename), savebuffer, length, cv_compresssaves.value);
 	save_p = savebuffer = NULL;
 }
 
@@ -3521,7 +3606,7 @@ void G_LoadGame(UINT32 slot, INT16 mapoverride)
 
 	sprintf(savename, savegamename, slot);
 
-	length = FIL_ReadFile(savename, &savebuffer);
+	length = FIL_ReadPackedFile(savename, &savebuffer);
 	if (!length)
 	{
 		CONS_Printf(M_GetText("Couldn't read file %s\n"), savename);
@@ -3595,12 +3680,9 @@ void G_LoadGame(UINT32 slot, INT16 mapoverride)
 //
 void G_SaveGame(UINT32 savegameslot)
 {
-	boolean saved;
 	char savename[256] = "";
-	const char *backup;
 
 	sprintf(savename, savegamename, savegameslot);
-	backup = va("%s",savename);
 
 	// save during evaluation or credits? game's over, folks!
 	if (gamestate == GS_CREDITS || gamestate == GS_EVALUATION)
@@ -3625,17 +3707,14 @@ void G_SaveGame(UINT32 savegameslot)
 		P_SaveGame();
 
 		length = save_p - savebuffer;
-		saved = FIL_WriteFile(backup, savebuffer, length);
-		free(savebuffer);
+		FIL_WriteFileLater(savename, savebuffer, length, cv_compresssaves.value); // FIL_ReportWrites says if it fails
 		save_p = savebuffer = NULL;
 	}
 
 	gameaction = ga_nothing;
 
-	if (cv_debug && saved)
+	if (cv_debug)
 		CONS_Printf(M_GetText("Game saved.\n"));
-	else if (!saved)
-		CONS_Alert(CONS_ERROR, M_GetText("Error while writing to %s for save slot %u, base: %s\n"), backup, savegameslot, savegamename);
 }
 
 //
@@ -3823,7 +3902,7 @@ char *G_BuildMapTitle(INT32 mapnum)
 // DEMO RECORDING
 //
 
-#define DEMOVERSION 0x0009
+#define DEMOVERSION 0x000a
 #define DEMOHEADER  "\xF0" "SRB2Replay" "\x0F"
 
 #define DF_GHOST        0x01 // This demo contains ghost data too!
@@ -3842,6 +3921,19 @@ char *G_BuildMapTitle(INT32 mapnum)
 
 static ticcmd_t oldcmd;
 
+// From 0x000a on, the tics are kept in blocks packed with lzf: a varint
+// of the block's size unpacked, a varint of its size packed (0 if it
+// wasn't worth packing) and then the data. A block never stops in the
+// middle of a tic, and one with nothing in it ends the demo.
+#define DEMOBLOCKSIZE (16*1024) // packed once it gets this big
+#define DEMORAWSIZE (2*DEMOBLOCKSIZE) // with room for the tic that went over
+#define MAXVARINTSIZE 5
+
+static UINT8 *demoraw = NULL; // the block demo_p is in, unpacked
+static UINT8 *demoblockend; // where what's been unpacked into demoraw ends
+static UINT8 *demofile_p, *demofileend; // where the next block goes, or comes from
+static boolean demoblocks; // false for older demos, which just have the tics
+
 // For Metal Sonic and time attack ghosts
 #define GZT_XYZ    0x01
 #define GZT_MOMXY  0x02
@@ -3899,6 +3991,210 @@ ticcmd_t *G_MoveTiccmd(ticcmd_t* dest, const ticcmd_t* src, const size_t n)
 	return dest;
 }
 
+//
+// Varints, for the ticcmd fields and block sizes.
+// Signed ones are zigzagged, so small changes either way stay small.
+//
+
+static void G_WriteVarUInt(UINT8 **p, UINT32 n)
+{
+	UINT8 *b = *p;
+
+	while (n >= 0x80)
+	{
+		*b++ = (UINT8)(n | 0x80);
+		n >>= 7;
+	}
+	*b++ = (UINT8)n;
+	*p = b;
+}
+
+static UINT32 G_ReadVarUInt(UINT8 **p)
+{
+	UINT8 *b = *p, c, shift = 0;
+	UINT32 n = 0;
+
+	do
+	{
+		c = *b++;
+		if (shift < 32)
+			n |= (UINT32)(c & 0x7F) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	*p = b;
+	return n;
+}
+
+static void G_WriteVarInt(UINT8 **p, INT32 n)
+{
+	G_WriteVarUInt(p, ((UINT32)n << 1) ^ (UINT32)(n >> 31));
+}
+
+static INT32 G_ReadVarInt(UINT8 **p)
+{
+	UINT32 n = G_ReadVarUInt(p);
+	return (INT32)(n >> 1) ^ -(INT32)(n & 1);
+}
+
+//
+// G_UnpackDemoBlock
+//
+// Unpacks the block at *src into dest, if there is one.
+// Returns false if it's damaged, and true with *rawlen of 0 at the end.
+//
+static boolean G_UnpackDemoBlock(UINT8 **src, UINT8 *end, UINT8 *dest, size_t *rawlen)
+{
+	UINT8 *p = *src;
+	size_t packedlen, len;
+
+	*rawlen = 0;
+	if (end - p < 2)
+		return false;
+	*rawlen = G_ReadVarUInt(&p);
+	if (!*rawlen)
+	{
+		*src = p;
+		return true;
+	}
+	packedlen = G_ReadVarUInt(&p);
+	len = packedlen ? packedlen : *rawlen;
+	if (*rawlen > DEMORAWSIZE || p > end || len > (size_t)(end - p))
+		return false;
+
+	if (dest)
+	{
+		if (!packedlen)
+			M_Memcpy(dest, p, len);
+		else if (lzf_decompress(p, packedlen, dest, *rawlen) != *rawlen)
+			return false;
+	}
+	*src = p + len;
+	return true;
+}
+
+//
+// G_ReadDemoBlock
+//
+// Unpacks the next block, once demo_p has read all of this one.
+//
+static void G_ReadDemoBlock(void)
+{
+	size_t rawlen;
+
+	if (!demoblocks || demo_p < demoblockend)
+		return;
+
+	demo_p = demoraw;
+	if (!G_UnpackDemoBlock(&demofile_p, demofileend, demoraw, &rawlen) || !rawlen)
+	{
+		if (rawlen)
+			CONS_Alert(CONS_WARNING, M_GetText("Demo is damaged past this point.\n"));
+		// Either way, this is where it ends
+		demoraw[0] = DEMOMARKER;
+		rawlen = 1;
+		demofile_p = demofileend;
+	}
+	demoblockend = demoraw + rawlen;
+}
+
+//
+// G_WriteDemoBlock
+//
+// Packs what's been recorded since the last block, always between tics.
+// Returns false once there's no room left for more.
+//
+static boolean G_WriteDemoBlock(void)
+{
+	size_t rawlen = demo_p - demoraw, packedlen;
+	UINT8 *packed, *p;
+
+	if (!rawlen)
+		return true;
+
+	packed = demofile_p + 2*MAXVARINTSIZE;
+	packedlen = (rawlen > 1) ? lzf_compress(demoraw, rawlen, packed, rawlen - 1) : 0;
+	if (!packedlen)
+		M_Memcpy(packed, demoraw, rawlen);
+
+	p = demofile_p;
+	G_WriteVarUInt(&p, rawlen);
+	G_WriteVarUInt(&p, packedlen);
+	memmove(p, packed, packedlen ? packedlen : rawlen);
+	demofile_p = p + (packedlen ? packedlen : rawlen);
+	demo_p = demoraw;
+
+	// Keep enough for one more full block and the empty one at the end
+	return (size_t)(demofileend - demofile_p) >= DEMORAWSIZE + 3*MAXVARINTSIZE;
+}
+
+//
+// G_UnpackDemo
+//
+// Unpacks all the blocks at once, for ghosts, which all read from the
+// same buffer as the level goes on.
+//
+static UINT8 *G_UnpackDemo(UINT8 *p, UINT8 *end, INT32 tag)
+{
+	UINT8 *src = p, *buf, *out;
+	size_t rawlen, total = 0;
+
+	do
+	{
+		if (!G_UnpackDemoBlock(&src, end, NULL, &rawlen))
+			return NULL;
+		total += rawlen;
+	} while (rawlen);
+
+	buf = out = Z_Malloc(total + 1, tag, NULL);
+	src = p;
+	do
+	{
+		if (!G_UnpackDemoBlock(&src, end, out, &rawlen))
+		{
+			Z_Free(buf);
+			return NULL;
+		}
+		out += rawlen;
+	} while (rawlen);
+	*out = DEMOMARKER; // if the last tic somehow didn't have one
+
+	return buf;
+}
+
+//
+// G_SkipDemoTiccmd
+//
+// Steps over a ticcmd, for ghosts, which only want what comes after.
+//
+static UINT8 *G_SkipDemoTiccmd(UINT8 *p, UINT16 version)
+{
+	UINT8 ziptic = READUINT8(p);
+
+	if (ziptic & ZT_FWD)
+		p++;
+	if (ziptic & ZT_SIDE)
+		p++;
+	if (version < 0x000a)
+	{
+		if (ziptic & ZT_ANGLE)
+			p += 2;
+		if (ziptic & ZT_BUTTONS)
+			p += 2;
+		if (ziptic & ZT_AIMING)
+			p += 2;
+	}
+	else
+	{
+		if (ziptic & ZT_ANGLE)
+			G_ReadVarUInt(&p);
+		if (ziptic & ZT_BUTTONS)
+			G_ReadVarUInt(&p);
+		if (ziptic & ZT_AIMING)
+			G_ReadVarUInt(&p);
+	}
+	return p;
+}
+
 void G_ReadDemoTiccmd(ticcmd_t *cmd, INT32 playernum)
 {
 	UINT8 ziptic;
@@ -3906,26 +4202,50 @@ void G_ReadDemoTiccmd(ticcmd_t *cmd, INT32 playernum)
 
 	if (!demo_p || !demo_start)
 		return;
+	G_ReadDemoBlock();
+	if (demoblocks && *demo_p == DEMOMARKER)
+	{
+		// ran out of blocks
+		G_CheckDemoStatus();
+		return;
+	}
 	ziptic = READUINT8(demo_p);
 
 	if (ziptic & ZT_FWD)
 		oldcmd.forwardmove = READSINT8(demo_p);
 	if (ziptic & ZT_SIDE)
 		oldcmd.sidemove = READSINT8(demo_p);
-	if (ziptic & ZT_ANGLE)
-		oldcmd.angleturn = READINT16(demo_p);
-	if (ziptic & ZT_BUTTONS)
-		oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | (READUINT16(demo_p) & ~(BT_CAMLEFT|BT_CAMRIGHT));
-	if (ziptic & ZT_AIMING)
-		oldcmd.aiming = READINT16(demo_p);
+	if (demoblocks)
+	{
+		if (ziptic & ZT_ANGLE)
+			oldcmd.angleturn = (INT16)(oldcmd.angleturn + G_ReadVarInt(&demo_p));
+		if (ziptic & ZT_BUTTONS)
+			oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | ((UINT16)G_ReadVarUInt(&demo_p) & ~(BT_CAMLEFT|BT_CAMRIGHT));
+		if (ziptic & ZT_AIMING)
+			oldcmd.aiming = (INT16)(oldcmd.aiming + G_ReadVarInt(&demo_p));
+	}
+	else
+	{
+		if (ziptic & ZT_ANGLE)
+			oldcmd.angleturn = READINT16(demo_p);
+		if (ziptic & ZT_BUTTONS)
+			oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | (READUINT16(demo_p) & ~(BT_CAMLEFT|BT_CAMRIGHT));
+		if (ziptic & ZT_AIMING)
+			oldcmd.aiming = READINT16(demo_p);
+	}
 
 	G_CopyTiccmd(cmd, &oldcmd, 1);
+	demotics++;
 
-	if (!(demoflags & DF_GHOST) && *demo_p == DEMOMARKER)
+	if (!(demoflags & DF_GHOST))
 	{
-		// end of demo data stream
-		G_CheckDemoStatus();
-		return;
+		G_ReadDemoBlock();
+		if (*demo_p == DEMOMARKER)
+		{
+			// end of demo data stream
+			G_CheckDemoStatus();
+			return;
+		}
 	}
 }
 
@@ -3955,26 +4275,27 @@ void G_WriteDemoTiccmd(ticcmd_t *cmd, INT32 playernum)
 
 	if (cmd->angleturn != oldcmd.angleturn)
 	{
-		WRITEINT16(demo_p,cmd->angleturn);
+		G_WriteVarInt(&demo_p, cmd->angleturn - oldcmd.angleturn);
 		oldcmd.angleturn = cmd->angleturn;
 		ziptic |= ZT_ANGLE;
 	}
 
 	if (cmd->buttons != oldcmd.buttons)
 	{
-		WRITEUINT16(demo_p,cmd->buttons);
+		G_WriteVarUInt(&demo_p, cmd->buttons);
 		oldcmd.buttons = cmd->buttons;
 		ziptic |= ZT_BUTTONS;
 	}
 
 	if (cmd->aiming != oldcmd.aiming)
 	{
-		WRITEINT16(demo_p,cmd->aiming);
+		G_WriteVarInt(&demo_p, cmd->aiming - oldcmd.aiming);
 		oldcmd.aiming = cmd->aiming;
 		ziptic |= ZT_AIMING;
 	}
 
 	*ziptic_p = ziptic;
+	demotics++;
 
 	// attention here for the ticcmd size!
 	// latest demos with mouse aiming byte in ticcmd
@@ -4191,6 +4512,13 @@ void G_WriteGhostTic(mobj_t *ghost)
 
 	*ziptic_p = ziptic;
 
+	// The tic's done, so this is somewhere a block can end
+	if (demo_p - demoraw >= DEMOBLOCKSIZE && !G_WriteDemoBlock())
+	{
+		G_CheckDemoStatus(); // no more space
+		return;
+	}
+
 	// attention here for the ticcmd size!
 	// latest demos with mouse aiming byte in ticcmd
 	if (demo_p >= demoend - (13 + 9))
@@ -4278,7 +4606,7 @@ void G_ConsGhostTic(void)
 				demo_p += sizeof(angle_t); // angle, unnecessary for cons.
 
 				mobj = NULL;
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 				{
 					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 						continue;
@@ -4321,6 +4649,7 @@ void G_ConsGhostTic(void)
 		testmo->z = oldghost.z;
 	}
 
+	G_ReadDemoBlock();
 	if (*demo_p == DEMOMARKER)
 	{
 		// end of demo data stream
@@ -4329,70 +4658,130 @@ void G_ConsGhostTic(void)
 	}
 }
 
-void G_GhostTicker(void)
+//
+// G_ReadGhostFrames
+//
+// Decodes a ghost's whole stream at once, starting where it spawned, into
+// where it is and what it does on every tic. With frames NULL, only counts
+// how many tics and hits there are. Only the first 4 hits of a tic are
+// kept, since no more than that ever make poofs.
+//
+static size_t G_ReadGhostFrames(UINT8 *p, UINT16 version, const mobj_t *mo,
+	ghostframe_t *frames, ghosthit_t *hits, size_t *numhits)
 {
-	demoghost *g,*p;
-	for(g = ghosts, p = NULL; g; g = g->next)
+	fixed_t x = mo->x, y = mo->y, z = mo->z;
+	fixed_t momx = 0, momy = 0, momz = 0;
+	UINT8 angle = 0, frame = 0;
+	size_t n = 0;
+
+	*numhits = 0;
+	do
 	{
+		ghostframe_t f;
+		UINT8 ziptic;
+
 		// Skip normal demo data.
-		UINT8 ziptic = READUINT8(g->p);
-		if (ziptic & ZT_FWD)
-			g->p++;
-		if (ziptic & ZT_SIDE)
-			g->p++;
-		if (ziptic & ZT_ANGLE)
-			g->p += 2;
-		if (ziptic & ZT_BUTTONS)
-			g->p += 2;
-		if (ziptic & ZT_AIMING)
-			g->p += 2;
+		p = G_SkipDemoTiccmd(p, version);
 
 		// Grab ghost data.
-		ziptic = READUINT8(g->p);
+		memset(&f, 0, sizeof (f));
+		ziptic = READUINT8(p);
 		if (ziptic & GZT_XYZ)
 		{
-			g->oldmo.x = READFIXED(g->p);
-			g->oldmo.y = READFIXED(g->p);
-			g->oldmo.z = READFIXED(g->p);
+			x = READFIXED(p);
+			y = READFIXED(p);
+			z = READFIXED(p);
 		}
 		else
 		{
 			if (ziptic & GZT_MOMXY)
 			{
-				g->oldmo.momx = READINT16(g->p)<<8;
-				g->oldmo.momy = READINT16(g->p)<<8;
+				momx = READINT16(p)<<8;
+				momy = READINT16(p)<<8;
 			}
 			if (ziptic & GZT_MOMZ)
-				g->oldmo.momz = READINT16(g->p)<<8;
-			g->oldmo.x += g->oldmo.momx;
-			g->oldmo.y += g->oldmo.momy;
-			g->oldmo.z += g->oldmo.momz;
+				momz = READINT16(p)<<8;
+			x += momx;
+			y += momy;
+			z += momz;
 		}
 		if (ziptic & GZT_ANGLE)
-			g->oldmo.angle = READUINT8(g->p)<<24;
+			angle = READUINT8(p);
 		if (ziptic & GZT_SPRITE)
-			g->oldmo.frame = READUINT8(g->p);
+			frame = READUINT8(p);
+		f.x = x;
+		f.y = y;
+		f.z = z;
+		f.angle = angle;
+		f.frame = frame;
+
+		if (ziptic & GZT_EXTRA)
+		{ // But wait, there's more!
+			f.extra = READUINT8(p);
+			if (f.extra & EZT_COLOR)
+				f.color = READUINT8(p);
+			if (f.extra & EZT_SCALE)
+				f.scale = READFIXED(p);
+			if (f.extra & EZT_HIT)
+			{
+				UINT16 i, count = READUINT16(p);
+				ghosthit_t h;
+				for (i = 0; i < count; i++)
+				{
+					p += 4; // reserved
+					h.type = READUINT32(p);
+					h.health = READUINT16(p);
+					h.x = READFIXED(p);
+					h.y = READFIXED(p);
+					h.z = READFIXED(p);
+					h.angle = READANGLE(p);
+					if (i >= 4)
+						continue;
+					if (hits)
+						hits[*numhits] = h;
+					f.numhits++;
+					(*numhits)++;
+				}
+			}
+			if (f.extra & EZT_SPRITE)
+				f.sprite = READUINT8(p);
+		}
+
+		if (frames)
+			frames[n] = f;
+		n++;
+	} while (*p != DEMOMARKER); // Demo ends after ghost data.
+
+	return n;
+}
+
+void G_GhostTicker(void)
+{
+	demoghost *g,*p;
+	for(g = ghosts, p = NULL; g; g = g->next)
+	{
+		const ghostframe_t *f = &g->frames[g->tic++];
 
 		// Update ghost
 		P_UnsetThingPosition(g->mo);
-		g->mo->x = g->oldmo.x;
-		g->mo->y = g->oldmo.y;
-		g->mo->z = g->oldmo.z;
+		g->mo->x = f->x;
+		g->mo->y = f->y;
+		g->mo->z = f->z;
 		P_SetThingPosition(g->mo);
-		g->mo->angle = g->oldmo.angle;
-		g->mo->frame = g->oldmo.frame | tr_trans30<<FF_TRANSSHIFT;
+		g->mo->angle = f->angle<<24;
+		g->mo->frame = f->frame | tr_trans30<<FF_TRANSSHIFT;
 
-		if (ziptic & GZT_EXTRA)
+		if (f->extra)
 		{ // But wait, there's more!
-			ziptic = READUINT8(g->p);
+			UINT8 ziptic = f->extra;
 			if (ziptic & EZT_COLOR)
 			{
-				g->color = READUINT8(g->p);
+				g->color = f->color;
 				switch(g->color)
 				{
 				default:
 				case GHC_NORMAL: // Go back to skin color
-					g->mo->color = g->oldmo.color;
+					g->mo->color = g->basecolor;
 					break;
 				// Handled below
 				case GHC_SUPER:
@@ -4407,7 +4796,7 @@ void G_GhostTicker(void)
 				g->mo->eflags ^= MFE_VERTICALFLIP;
 			if (ziptic & EZT_SCALE)
 			{
-				g->mo->destscale = READFIXED(g->p);
+				g->mo->destscale = f->scale;
 				if (g->mo->destscale != g->mo->scale)
 					P_SetScale(g->mo, g->mo->destscale);
 			}
@@ -4459,35 +4848,28 @@ void G_GhostTicker(void)
 				mobj->fuse = 8;
 				P_SetTarget(&mobj->target, g->mo);
 			}
-			if (ziptic & EZT_HIT)
+			if ((ziptic & EZT_HIT) && f->numhits)
 			{ // Spawn hit poofs for killing things!
-				UINT16 i, count = READUINT16(g->p), health;
-				UINT32 type;
-				fixed_t x,y,z;
-				angle_t angle;
+				// Only the first 4 hits per frame were kept, to prevent ghosts from splode-spamming too bad.
+				const ghosthit_t *h = &g->hits[g->hit];
 				mobj_t *poof;
-				for (i = 0; i < count; i++)
+				UINT8 i;
+				g->hit += f->numhits;
+				for (i = 0; i < f->numhits; i++, h++)
 				{
-					g->p += 4; // reserved
-					type = READUINT32(g->p);
-					health = READUINT16(g->p);
-					x = READFIXED(g->p);
-					y = READFIXED(g->p);
-					z = READFIXED(g->p);
-					angle = READANGLE(g->p);
-					if (!(mobjinfo[type].flags & MF_SHOOTABLE)
-					|| !(mobjinfo[type].flags & (MF_ENEMY|MF_MONITOR))
-					|| health != 0 || i >= 4) // only spawn for the first 4 hits per frame, to prevent ghosts from splode-spamming too bad.
+					if (!(mobjinfo[h->type].flags & MF_SHOOTABLE)
+					|| !(mobjinfo[h->type].flags & (MF_ENEMY|MF_MONITOR))
+					|| h->health != 0)
 						continue;
-					poof = P_SpawnMobj(x, y, z, MT_GHOST);
-					poof->angle = angle;
+					poof = P_SpawnMobj(h->x, h->y, h->z, MT_GHOST);
+					poof->angle = h->angle;
 					poof->flags = MF_NOBLOCKMAP|MF_NOCLIP|MF_NOCLIPHEIGHT|MF_NOGRAVITY; // make an ATTEMPT to curb crazy SOCs fucking stuff up...
 					poof->health = 0;
 					P_SetMobjStateNF(poof, S_XPLD1);
 				}
 			}
 			if (ziptic & EZT_SPRITE)
-				g->mo->sprite = READUINT8(g->p);
+				g->mo->sprite = f->sprite;
 		}
 
 		// Tick ghost colors (Super and Mario Invincibility flashing)
@@ -4505,14 +4887,14 @@ void G_GhostTicker(void)
 		}
 
 		// Demo ends after ghost data.
-		if (*g->p == DEMOMARKER)
+		if (g->tic == g->numframes)
 		{
 			g->mo->momx = g->mo->momy = g->mo->momz = 0;
 			if (p)
 				p->next = g->next;
 			else
 				ghosts = g->next;
-			Z_Free(g);
+			G_FreeGhost(g);
 			continue;
 		}
 		p = g;
@@ -4726,6 +5108,329 @@ void G_WriteMetalTic(mobj_t *metal)
 	}
 }
 
+//
+// Demo keyframes
+//
+// Every so often while recording, the game is archived the same way it
+// is for a joining player, packed with lzf, and kept aside along with
+// where the tics had got to. They go at the end of the file, after the
+// demo marker, where nothing that reads the tics ever looks:
+//
+// "KEYF", count, keyframes, offset of "KEYF" from the start, "KEYF"
+//
+// Seeking loads the last keyframe at or before the wanted tic, and runs
+// the rest of the way without drawing anything.
+//
+
+static CV_PossibleValue_t demokeyframes_cons_t[] = {{0, "MIN"}, {600, "MAX"}, {0, NULL}};
+consvar_t cv_demokeyframes = {"demokeyframes", "0", CV_SAVE, demokeyframes_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+#define KEYFRAMETAG "KEYF"
+#define KEYFRAMESAVESIZE (768*1024) // the same as a savegame for joining
+#define KEYFRAMEHEADSIZE (4+4 + 1+1+2+2+2 + 6*4 + 4+4)
+
+// While recording
+static UINT8 *keyframesave = NULL; // the archive, before packing
+static UINT8 *keyframebuffer = NULL; // every keyframe so far, as in the file
+static size_t keyframesize = 0, keyframecapacity = 0;
+static UINT32 numkeyframes = 0;
+
+// While playing back: where each keyframe starts in demobuffer
+static UINT8 **keyframes = NULL;
+static UINT32 numdemokeyframes = 0;
+
+static void G_FreeDemoKeyframes(void)
+{
+	free(keyframesave);
+	free(keyframebuffer);
+	keyframesave = keyframebuffer = NULL;
+	keyframesize = keyframecapacity = 0;
+	numkeyframes = 0;
+
+	if (keyframes)
+		Z_Free(keyframes);
+	keyframes = NULL;
+	numdemokeyframes = 0;
+}
+
+//
+// G_WriteDemoKeyframe
+//
+// Called after every tic while recording.
+//
+void G_WriteDemoKeyframe(void)
+{
+	UINT8 *p, *oldsave_p = save_p;
+	size_t rawlen, packedlen;
+
+	if (!cv_demokeyframes.value || !demo_p || gamestate != GS_LEVEL)
+		return;
+	// The first tic always gets one, so there's somewhere to rewind to
+	if ((demotics - 1) % ((UINT32)cv_demokeyframes.value*TICRATE))
+		return;
+
+	// Seeking starts reading at the block after it
+	if (!G_WriteDemoBlock())
+	{
+		G_CheckDemoStatus(); // no more space
+		return;
+	}
+
+	if (!keyframesave)
+	{
+		keyframesave = malloc(KEYFRAMESAVESIZE);
+		if (!keyframesave)
+			I_Error("G_WriteDemoKeyframe: out of memory");
+	}
+
+	save_p = keyframesave;
+	P_SaveNetGame();
+	rawlen = save_p - keyframesave;
+	save_p = oldsave_p;
+	if (rawlen > KEYFRAMESAVESIZE)
+		I_Error("G_WriteDemoKeyframe: keyframe buffer overrun");
+
+	if (keyframesize + KEYFRAMEHEADSIZE + rawlen > keyframecapacity)
+	{
+		keyframecapacity = max(keyframecapacity*2, keyframesize + KEYFRAMEHEADSIZE + rawlen);
+		keyframebuffer = realloc(keyframebuffer, keyframecapacity);
+		if (!keyframebuffer)
+			I_Error("G_WriteDemoKeyframe: out of memory");
+	}
+
+	p = keyframebuffer + keyframesize;
+	WRITEUINT32(p, demotics);
+	WRITEUINT32(p, demofile_p - demobuffer);
+	WRITESINT8(p, oldcmd.forwardmove);
+	WRITESINT8(p, oldcmd.sidemove);
+	WRITEINT16(p, oldcmd.angleturn);
+	WRITEUINT16(p, oldcmd.buttons);
+	WRITEINT16(p, oldcmd.aiming);
+	WRITEFIXED(p, oldghost.x);
+	WRITEFIXED(p, oldghost.y);
+	WRITEFIXED(p, oldghost.z);
+	WRITEFIXED(p, oldghost.momx);
+	WRITEFIXED(p, oldghost.momy);
+	WRITEFIXED(p, oldghost.momz);
+	WRITEUINT32(p, rawlen);
+
+	// Not worth packing? Then it's kept as it is, with a length of 0
+	packedlen = lzf_compress(keyframesave, rawlen, p + 4, rawlen - 1);
+	WRITEUINT32(p, packedlen);
+	if (!packedlen)
+	{
+		M_Memcpy(p, keyframesave, rawlen);
+		packedlen = rawlen;
+	}
+
+	keyframesize = (p + packedlen) - keyframebuffer;
+	numkeyframes++;
+}
+
+//
+// G_FindDemoKeyframes
+//
+// Looks for keyframes at the end of a demo that's about to be played.
+//
+static void G_FindDemoKeyframes(size_t length)
+{
+	UINT8 *end = demobuffer + length, *p;
+	UINT32 i, count, start;
+
+	numdemokeyframes = 0;
+	if (length < 8 || memcmp(end - 4, KEYFRAMETAG, 4))
+		return;
+
+	p = end - 8;
+	start = READUINT32(p);
+	if (start < 8 || start > length - 16 || memcmp(demobuffer + start, KEYFRAMETAG, 4))
+		return;
+
+	p = demobuffer + start + 4;
+	count = READUINT32(p);
+	if (count > (length - start) / KEYFRAMEHEADSIZE)
+		return;
+
+	keyframes = Z_Malloc(max(count, 1) * sizeof (*keyframes), PU_STATIC, NULL);
+	for (i = 0; i < count; i++)
+	{
+		UINT8 *kp = p + KEYFRAMEHEADSIZE - 8;
+		UINT32 rawlen, packedlen;
+
+		if (p + KEYFRAMEHEADSIZE > end - 8)
+			break;
+		rawlen = READUINT32(kp);
+		packedlen = READUINT32(kp);
+		if (!packedlen)
+			packedlen = rawlen;
+		if (packedlen > (size_t)(end - 8 - kp) || rawlen > KEYFRAMESAVESIZE)
+			break;
+
+		keyframes[i] = p;
+		p = kp + packedlen;
+	}
+
+	if (i < count)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("This demo's keyframes are damaged; seeking won't work.\n"));
+		Z_Free(keyframes);
+		keyframes = NULL;
+		return;
+	}
+	numdemokeyframes = count;
+}
+
+//
+// G_AppendDemoKeyframes
+//
+// Puts the keyframes after the demo marker, when the demo is done.
+//
+static void G_AppendDemoKeyframes(void)
+{
+	size_t start = demo_p - demobuffer;
+	UINT8 *buf;
+
+	if (!numkeyframes)
+		return;
+
+	buf = realloc(demobuffer, start + 8 + keyframesize + 8);
+	if (!buf)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Not enough memory to save the demo's keyframes\n"));
+		return;
+	}
+	demobuffer = buf;
+	demo_p = demobuffer + start;
+
+	M_Memcpy(demo_p, KEYFRAMETAG, 4); demo_p += 4;
+	WRITEUINT32(demo_p, numkeyframes);
+	M_Memcpy(demo_p, keyframebuffer, keyframesize); demo_p += keyframesize;
+	WRITEUINT32(demo_p, start);
+	M_Memcpy(demo_p, KEYFRAMETAG, 4); demo_p += 4;
+}
+
+static tic_t G_KeyframeTic(UINT32 i)
+{
+	UINT8 *p = keyframes[i];
+	return READUINT32(p);
+}
+
+//
+// G_LoadDemoKeyframe
+//
+// Puts the game back as it was at a keyframe.
+//
+static boolean G_LoadDemoKeyframe(UINT32 i)
+{
+	UINT8 *p = keyframes[i], *raw;
+	UINT32 tic, offset, rawlen, packedlen;
+	boolean ok;
+
+	tic = READUINT32(p);
+	offset = READUINT32(p);
+	if (offset >= (UINT32)(keyframes[0] - demobuffer))
+		return false;
+
+	oldcmd.forwardmove = READSINT8(p);
+	oldcmd.sidemove = READSINT8(p);
+	oldcmd.angleturn = READINT16(p);
+	oldcmd.buttons = READUINT16(p);
+	oldcmd.aiming = READINT16(p);
+	oldghost.x = READFIXED(p);
+	oldghost.y = READFIXED(p);
+	oldghost.z = READFIXED(p);
+	oldghost.momx = READFIXED(p);
+	oldghost.momy = READFIXED(p);
+	oldghost.momz = READFIXED(p);
+	rawlen = READUINT32(p);
+	packedlen = READUINT32(p);
+
+	raw = Z_Malloc(rawlen, PU_STATIC, NULL);
+	if (packedlen)
+		ok = (lzf_decompress(p, packedlen, raw, rawlen) == rawlen);
+	else
+	{
+		M_Memcpy(raw, p, rawlen);
+		ok = true;
+	}
+
+	if (ok)
+	{
+		save_p = raw;
+		ok = P_LoadNetGame();
+		save_p = NULL;
+	}
+	Z_Free(raw);
+
+	if (demoblocks)
+	{
+		demofile_p = demobuffer + offset;
+		demo_p = demoblockend = demoraw;
+	}
+	else
+		demo_p = demobuffer + offset;
+	demotics = tic;
+	return ok;
+}
+
+tic_t G_DemoTics(void)
+{
+	return demotics;
+}
+
+//
+// G_SeekDemo
+//
+// Goes forward or back to a tic of the demo being played.
+//
+void G_SeekDemo(tic_t tic)
+{
+	UINT32 i;
+	tic_t last;
+
+	if (!demoplayback || titledemo || timingdemo || !demo_start)
+	{
+		CONS_Printf(M_GetText("You can only seek while watching a demo.\n"));
+		return;
+	}
+	if (!numdemokeyframes)
+	{
+		CONS_Printf(M_GetText("This demo has no keyframes to seek with.\n"));
+		return;
+	}
+
+	if (tic < G_KeyframeTic(0))
+		tic = G_KeyframeTic(0);
+	for (i = 1; i < numdemokeyframes && G_KeyframeTic(i) <= tic; i++)
+		;
+	i--;
+
+	// Running on from here is quicker than loading, if the keyframe doesn't get any closer
+	if (tic < demotics || G_KeyframeTic(i) > demotics || gamestate != GS_LEVEL)
+	{
+		if (!G_LoadDemoKeyframe(i))
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("This demo's keyframe at %d:%02d is damaged.\n"),
+				G_TicsToMinutes(G_KeyframeTic(i), true), G_TicsToSeconds(G_KeyframeTic(i)));
+			G_CheckDemoStatus();
+			return;
+		}
+	}
+
+	// Stops short if the demo ends, or the level does, or the game is
+	// paused and the tics stop going by
+	while (demotics < tic && demoplayback && gamestate == GS_LEVEL)
+	{
+		last = demotics;
+		G_Ticker(true);
+		if (demotics == last)
+			break;
+	}
+
+	// Whatever went off on the way shouldn't all be heard at once
+	S_StopSounds();
+}
+
 //
 // G_RecordDemo
 //
@@ -4740,9 +5445,16 @@ void G_RecordDemo(const char *name)
 		maxsize = atoi(M_GetNextParm()) * 1024;
 //	if (demobuffer)
 //		free(demobuffer);
+	maxsize = max(maxsize, DEMORAWSIZE*4);
 	demo_p = NULL;
 	demobuffer = malloc(maxsize);
-	demoend = demobuffer + maxsize;
+	demofileend = demobuffer + maxsize;
+	if (!demoraw)
+		demoraw = malloc(DEMORAWSIZE);
+	if (!demobuffer || !demoraw)
+		I_Error("G_RecordDemo: out of memory");
+	demoend = demoraw + DEMORAWSIZE;
+	demoblocks = true;
 
 	demorecording = true;
 }
@@ -4851,9 +5563,15 @@ void G_BeginRecording(void)
 	// Save netvar data (SONICCD, etc)
 	CV_SaveNetVars(&demo_p);
 
+	// The tics go in blocks from here on
+	demofile_p = demo_p;
+	demo_p = demoraw;
+
 	memset(&oldcmd,0,sizeof(oldcmd));
 	memset(&oldghost,0,sizeof(oldghost));
 	memset(&ghostext,0,sizeof(ghostext));
+	demotics = 0;
+	G_FreeDemoKeyframes();
 	ghostext.lastcolor = ghostext.color = GHC_NORMAL;
 	ghostext.lastscale = ghostext.scale = FRACUNIT;
 
@@ -4996,6 +5714,7 @@ UINT8 G_CmpDemoTime(char *oldname, char *newname)
 	{
 	case DEMOVERSION: // latest always supported
 	// compatibility available?
+	case 0x0009:
 	case 0x0008:
 		break;
 	// too old, cannot support.
@@ -5074,6 +5793,7 @@ void G_DoPlayDemo(char *defdemoname)
 	UINT8 version,subversion,charability,charability2,thrustfactor,accelstart,acceleration;
 	UINT32 randseed;
 	fixed_t actionspd,mindash,maxdash,normalspeed,runspeed,jumpfactor;
+	size_t demolength;
 	char msg[1024];
 
 	skin[16] = '\0';
@@ -5091,7 +5811,7 @@ void G_DoPlayDemo(char *defdemoname)
 	if (FIL_CheckExtension(defdemoname))
 	{
 		//FIL_DefaultExtension(defdemoname, ".lmp");
-		if (!FIL_ReadFile(defdemoname, &demobuffer))
+		if (!(demolength = FIL_ReadFile(defdemoname, &demobuffer)))
 		{
 			snprintf(msg, 1024, M_GetText("Failed to read file '%s'.\n"), defdemoname);
 			CONS_Alert(CONS_ERROR, "%s", msg);
@@ -5111,7 +5831,10 @@ void G_DoPlayDemo(char *defdemoname)
 		return;
 	}
 	else // it's an internal demo
+	{
 		demobuffer = demo_p = W_CacheLumpNum(l, PU_STATIC);
+		demolength = W_LumpLength(l);
+	}
 
 	// read demo header
 	gameaction = ga_nothing;
@@ -5136,6 +5859,7 @@ void G_DoPlayDemo(char *defdemoname)
 	{
 	case DEMOVERSION: // latest always supported
 	// compatibility available?
+	case 0x0009:
 	case 0x0008:
 		break;
 	// too old, cannot support.
@@ -5224,6 +5948,19 @@ void G_DoPlayDemo(char *defdemoname)
 	// net var data
 	CV_LoadNetVars(&demo_p);
 
+	demoblocks = (demoversion >= 0x000a);
+	if (demoblocks)
+	{
+		if (!demoraw)
+			demoraw = malloc(DEMORAWSIZE);
+		if (!demoraw)
+			I_Error("G_DoPlayDemo: out of memory");
+		demofile_p = demo_p;
+		demofileend = demobuffer + demolength;
+		demo_p = demoblockend = demoraw;
+		G_ReadDemoBlock();
+	}
+
 	// Sigh ... it's an empty demo.
 	if (*demo_p == DEMOMARKER)
 	{
@@ -5241,6 +5978,8 @@ void G_DoPlayDemo(char *defdemoname)
 
 	memset(&oldcmd,0,sizeof(oldcmd));
 	memset(&oldghost,0,sizeof(oldghost));
+	demotics = 0;
+	G_FindDemoKeyframes(demolength);
 
 	if (VERSION != version || SUBVERSION != subversion)
 		CONS_Alert(CONS_WARNING, M_GetText("Demo version does not match game version. Desyncs may occur.\n"));
@@ -5307,6 +6046,7 @@ void G_AddGhost(char *defdemoname)
 	UINT8 *buffer,*p;
 	mapthing_t *mthing;
 	UINT16 count, ghostversion;
+	size_t length;
 
 	name[16] = '\0';
 	skin[16] = '\0';
@@ -5324,7 +6064,7 @@ void G_AddGhost(char *defdemoname)
 	if (FIL_CheckExtension(defdemoname))
 	{
 		//FIL_DefaultExtension(defdemoname, ".lmp");
-		if (!FIL_ReadFileTag(defdemoname, &buffer, PU_LEVEL))
+		if (!(length = FIL_ReadFileTag(defdemoname, &buffer, PU_LEVEL)))
 		{
 			CONS_Alert(CONS_ERROR, M_GetText("Failed to read file '%s'.\n"), defdemoname);
 			Z_Free(pdemoname);
@@ -5340,7 +6080,10 @@ void G_AddGhost(char *defdemoname)
 		return;
 	}
 	else // it's an internal demo
+	{
 		buffer = p = W_CacheLumpNum(l, PU_LEVEL);
+		length = W_LumpLength(l);
+	}
 
 	// read demo header
 	if (memcmp(p, DEMOHEADER, 12))
@@ -5357,6 +6100,7 @@ void G_AddGhost(char *defdemoname)
 	{
 	case DEMOVERSION: // latest always supported
 	// compatibility available?
+	case 0x0009:
 	case 0x0008:
 		break;
 	// too old, cannot support.
@@ -5445,6 +6189,20 @@ void G_AddGhost(char *defdemoname)
 		p++;
 	}
 
+	if (ghostversion >= 0x000a)
+	{
+		UINT8 *unpacked = G_UnpackDemo(p, buffer + length, PU_LEVEL);
+
+		Z_Free(buffer);
+		if (!unpacked)
+		{
+			CONS_Alert(CONS_NOTICE, M_GetText("Failed to add ghost %s: Replay is damaged.\n"), pdemoname);
+			Z_Free(pdemoname);
+			return;
+		}
+		buffer = p = unpacked;
+	}
+
 	if (*p == DEMOMARKER)
 	{
 		CONS_Alert(CONS_NOTICE, M_GetText("Failed to add ghost %s: Replay is empty.\n"), pdemoname);
@@ -5455,13 +6213,10 @@ void G_AddGhost(char *defdemoname)
 
 	gh = Z_Calloc(sizeof(demoghost), PU_LEVEL, NULL);
 	gh->next = ghosts;
-	gh->buffer = buffer;
 	M_Memcpy(gh->checksum, md5, 16);
-	gh->p = p;
 
 	ghosts = gh;
 
-	gh->version = ghostversion;
 	mthing = playerstarts[0];
 	I_Assert(mthing);
 	{ // A bit more complex than P_SpawnPlayer because ghosts aren't solid and won't just push themselves out of the ceiling.
@@ -5493,9 +6248,21 @@ void G_AddGhost(char *defdemoname)
 	gh->mo->frame = (gh->mo->state->frame & FF_FRAMEMASK) | tr_trans20<<FF_TRANSSHIFT;
 	gh->mo->tics = -1;
 
-	gh->oldmo.x = gh->mo->x;
-	gh->oldmo.y = gh->mo->y;
-	gh->oldmo.z = gh->mo->z;
+	// The ghost only moves where its replay says, so it needn't think.
+	// It stays in the thinker list so it still gets interpolated.
+	gh->mo->flags |= MF_NOTHINK;
+
+	// Decode every tic now, so G_GhostTicker only has to look them up
+	{
+		size_t numhits;
+
+		gh->numframes = G_ReadGhostFrames(p, ghostversion, gh->mo, NULL, NULL, &numhits);
+		gh->frames = Z_Malloc(gh->numframes * sizeof (*gh->frames), PU_LEVEL, NULL);
+		if (numhits)
+			gh->hits = Z_Malloc(numhits * sizeof (*gh->hits), PU_LEVEL, NULL);
+		G_ReadGhostFrames(p, ghostversion, gh->mo, gh->frames, gh->hits, &numhits);
+	}
+	Z_Free(buffer);
 
 	// Set skin
 	gh->mo->skin = &skins[0];
@@ -5505,7 +6272,6 @@ void G_AddGhost(char *defdemoname)
 			gh->mo->skin = &skins[i];
 			break;
 		}
-	gh->oldmo.skin = gh->mo->skin;
 
 	// Set color
 	gh->mo->color = ((skin_t*)gh->mo->skin)->prefcolor;
@@ -5515,7 +6281,7 @@ void G_AddGhost(char *defdemoname)
 			gh->mo->color = (UINT8)i;
 			break;
 		}
-	gh->oldmo.color = gh->mo->color;
+	gh->basecolor = gh->mo->color;
 
 	CONS_Printf(M_GetText("Added ghost %s from %s\n"), name, pdemoname);
 	Z_Free(pdemoname);
@@ -5557,7 +6323,7 @@ void G_DoPlayMetal(void)
 		metalbuffer = metal_p = W_CacheLumpNum(l, PU_STATIC);
 
 	// find metal sonic
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -5582,6 +6348,7 @@ void G_DoPlayMetal(void)
 	{
 	case DEMOVERSION: // latest always supported
 	// compatibility available?
+	case 0x0009:
 	case 0x0008:
 		break;
 	// too old, cannot support.
@@ -5666,6 +6433,9 @@ void G_StopDemo(void)
 {
 	Z_Free(demobuffer);
 	demobuffer = NULL;
+	free(demoraw);
+	demoraw = NULL;
+	G_FreeDemoKeyframes();
 	demoplayback = false;
 	titledemo = false;
 	timingdemo = false;
@@ -5687,7 +6457,7 @@ boolean G_CheckDemoStatus(void)
 	while (ghosts)
 	{
 		demoghost *next = ghosts->next;
-		Z_Free(ghosts);
+		G_FreeGhost(ghosts);
 		ghosts = next;
 	}
 	ghosts = NULL;
@@ -5709,6 +6479,8 @@ boolean G_CheckDemoStatus(void)
 		CONS_Printf(M_GetText("timed %u gametics in %d realtics\n%f seconds, %f avg fps\n"), leveltime,demotime,f1/TICRATE,f2/f1);
 		if (restorecv_vidwait != cv_vidwait.value)
 			CV_SetValue(&cv_vidwait, restorecv_vidwait);
+		if (benchrendering)
+			M_FinishBenchRender();
 		D_AdvanceDemo();
 		return true;
 	}
@@ -5729,18 +6501,27 @@ boolean G_CheckDemoStatus(void)
 
 	if (demorecording)
 	{
-		UINT8 *p = demobuffer+16; // checksum position
+		UINT8 *p;
 #ifdef NOMD5
 		UINT8 i;
+#endif
 		WRITEUINT8(demo_p, DEMOMARKER); // add the demo end marker
+		G_WriteDemoBlock();
+		demo_p = demofile_p;
+		G_WriteVarUInt(&demo_p, 0); // and the empty block after the last
+		G_AppendDemoKeyframes();
+		p = demobuffer+16; // checksum position
+#ifdef NOMD5
 		for (i = 0; i < 16; i++, p++)
 			*p = P_RandomByte(); // This MD5 was chosen by fair dice roll and most likely < 50% correct.
 #else
-		WRITEUINT8(demo_p, DEMOMARKER); // add the demo end marker
 		md5_buffer((char *)p+16, demo_p - (p+16), p); // make a checksum of everything after the checksum in the file.
 #endif
 		saved = FIL_WriteFile(va(pandf, srb2home, demoname), demobuffer, demo_p - demobuffer); // finally output the file.
 		free(demobuffer);
+		free(demoraw);
+		demoraw = NULL;
+		G_FreeDemoKeyframes();
 		demorecording = false;
 
 		if (modeattacking != ATTACKING_RECORD)
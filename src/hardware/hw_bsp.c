@@ -29,6 +29,10 @@
 #include "../m_argv.h"
 #include "../i_video.h"
 #include "../w_wad.h"
+#include "../byteptr.h"
+#include "../m_misc.h"
+#include "../d_main.h"
+#include "../p_setup.h"
 
 // --------------------------------------------------------------------------
 // This is global data for planes rendering
@@ -951,6 +955,318 @@ static void AdjustSegs(void)
 }
 
 
+// --------------------------------------------------------------------------
+// On-disk cache of the plane polygons
+// --------------------------------------------------------------------------
+// Everything HWR_CreatePlanePolygons leaves behind is saved once per map,
+// keyed by the map's MD5: the subsector polygons, the node bounding boxes
+// and children it rewrites, and the float vertexes of every seg.
+
+#define PLANECACHEDIR "glcache"
+#define PLANECACHEID "SRB2GLPC"
+#define PLANECACHEVERSION 1
+
+// how a seg vertex was set by AdjustSegs
+enum
+{
+	PCV_NONE, // not touched (polyobject segs)
+	PCV_POLY, // a point of its subsector's polygon
+	PCV_OWN   // a vertex of its own
+};
+
+static const char *HWR_PlaneCacheName(void)
+{
+	char hex[33];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&hex[i*2], "%02x", mapmd5[i]);
+	return va("%s"PATHSEP PLANECACHEDIR PATHSEP"%s.plc", srb2home, hex);
+}
+
+static void WriteFloat(UINT8 **p, float f)
+{
+	UINT32 u;
+	memcpy(&u, &f, sizeof (u));
+	WRITEUINT32(*p, u);
+}
+
+static float ReadFloat(UINT8 **p)
+{
+	UINT32 u = READUINT32(*p);
+	float f;
+	memcpy(&f, &u, sizeof (f));
+	return f;
+}
+
+static size_t HWR_PlaneCacheHeaderSize(void)
+{
+	return 8 + 4 + 16 + 6*4 + 1;
+}
+
+static void HWR_WritePlaneCacheVertex(UINT8 **p, polyvertex_t *pv, poly_t *poly)
+{
+	if (!pv)
+		WRITEUINT8(*p, PCV_NONE);
+	else if (poly && pv >= poly->pts && pv < poly->pts + poly->numpts)
+	{
+		WRITEUINT8(*p, PCV_POLY);
+		WRITEINT32(*p, (INT32)(pv - poly->pts));
+	}
+	else
+	{
+		WRITEUINT8(*p, PCV_OWN);
+		WriteFloat(p, pv->x);
+		WriteFloat(p, pv->y);
+	}
+}
+
+static void HWR_SavePlaneCache(void)
+{
+	size_t i, length;
+	INT32 j;
+	UINT8 *buf, *p;
+	poly_t *poly;
+	seg_t *lseg;
+
+	// worst case: every seg has two vertexes of its own
+	length = HWR_PlaneCacheHeaderSize() + numnodes*(8*4 + 2*2) + numsegs*(2*9 + 4);
+	for (i = 0; i < addsubsector; i++)
+	{
+		length += 4;
+		if (extrasubsectors[i].planepoly)
+			length += extrasubsectors[i].planepoly->numpts * 3*4;
+	}
+
+	p = buf = malloc(length);
+	if (!buf)
+		return;
+
+	memcpy(p, PLANECACHEID, 8);
+	p += 8;
+	WRITEUINT32(p, PLANECACHEVERSION);
+	memcpy(p, mapmd5, 16);
+	p += 16;
+	WRITEUINT32(p, (UINT32)numvertexes);
+	WRITEUINT32(p, (UINT32)numsegs);
+	WRITEUINT32(p, (UINT32)numsubsectors);
+	WRITEUINT32(p, (UINT32)numnodes);
+	WRITEUINT32(p, (UINT32)addsubsector);
+	WRITEUINT32(p, (UINT32)sizeof (polyvertex_t));
+	WRITEUINT8(p, (UINT8)cv_grsolvetjoin.value);
+
+	for (i = 0; i < addsubsector; i++)
+	{
+		poly = extrasubsectors[i].planepoly;
+		if (!poly)
+		{
+			WRITEINT32(p, -1);
+			continue;
+		}
+		WRITEINT32(p, poly->numpts);
+		for (j = 0; j < poly->numpts; j++)
+		{
+			WriteFloat(&p, poly->pts[j].x);
+			WriteFloat(&p, poly->pts[j].y);
+			WriteFloat(&p, poly->pts[j].z);
+		}
+	}
+
+	for (i = 0; i < numnodes; i++)
+	{
+		for (j = 0; j < 2*4; j++)
+			WRITEFIXED(p, nodes[i].bbox[j/4][j%4]);
+		WRITEUINT16(p, nodes[i].children[0]);
+		WRITEUINT16(p, nodes[i].children[1]);
+	}
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		size_t count = subsectors[i].numlines;
+		poly = extrasubsectors[i].planepoly;
+		for (lseg = &segs[subsectors[i].firstline]; count--; lseg++)
+		{
+			HWR_WritePlaneCacheVertex(&p, lseg->pv1, poly);
+			HWR_WritePlaneCacheVertex(&p, lseg->pv2, poly);
+			WriteFloat(&p, lseg->flength);
+		}
+	}
+
+	I_mkdir(va("%s"PATHSEP PLANECACHEDIR, srb2home), 0755);
+	if (!FIL_WriteFile(HWR_PlaneCacheName(), buf, p - buf))
+		CONS_Debug(DBG_RENDER, "HWR_SavePlaneCache: couldn't write %s\n", HWR_PlaneCacheName());
+	free(buf);
+}
+
+// Checks the whole file before anything is changed, so a bad cache
+// just falls back to generating the polygons.
+static boolean HWR_CheckPlaneCache(UINT8 *p, UINT8 *end)
+{
+	size_t i, count;
+	INT32 numpts, v;
+	UINT8 kind;
+	INT32 *pointcounts;
+	boolean ok = false;
+
+	if ((size_t)(end - p) < HWR_PlaneCacheHeaderSize()
+	 || memcmp(p, PLANECACHEID, 8))
+		return false;
+	p += 8;
+	if (READUINT32(p) != PLANECACHEVERSION || memcmp(p, mapmd5, 16))
+		return false;
+	p += 16;
+	if (READUINT32(p) != numvertexes
+	 || READUINT32(p) != numsegs
+	 || READUINT32(p) != numsubsectors
+	 || READUINT32(p) != numnodes)
+		return false;
+	count = READUINT32(p);
+	if (count < numsubsectors || count > totsubsectors)
+		return false;
+	if (READUINT32(p) != sizeof (polyvertex_t)
+	 || READUINT8(p) != (UINT8)cv_grsolvetjoin.value)
+		return false;
+
+	pointcounts = calloc(numsubsectors, sizeof (*pointcounts));
+	if (!pointcounts)
+		return false;
+
+	for (i = 0; i < count; i++)
+	{
+		if (end - p < 4)
+			goto done;
+		numpts = READINT32(p);
+		if (i < numsubsectors)
+			pointcounts[i] = numpts;
+		if (numpts < 0)
+			continue;
+		if ((size_t)(end - p) < (size_t)numpts * 3*4)
+			goto done;
+		p += numpts * 3*4;
+	}
+
+	if ((size_t)(end - p) < numnodes*(8*4 + 2*2))
+		goto done;
+	p += numnodes*(8*4 + 2*2);
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		count = subsectors[i].numlines;
+		while (count--)
+		{
+			for (v = 0; v < 2; v++)
+			{
+				if (end - p < 1)
+					goto done;
+				kind = READUINT8(p);
+				if (kind == PCV_POLY)
+				{
+					if (end - p < 4)
+						goto done;
+					numpts = READINT32(p);
+					if (numpts < 0 || numpts >= pointcounts[i])
+						goto done;
+				}
+				else if (kind == PCV_OWN)
+				{
+					if (end - p < 2*4)
+						goto done;
+					p += 2*4;
+				}
+				else if (kind != PCV_NONE)
+					goto done;
+			}
+			if (end - p < 4)
+				goto done;
+			p += 4;
+		}
+	}
+
+	ok = (p == end);
+done:
+	free(pointcounts);
+	return ok;
+}
+
+static polyvertex_t *HWR_ReadPlaneCacheVertex(UINT8 **p, poly_t *poly)
+{
+	polyvertex_t *pv;
+
+	switch (READUINT8(*p))
+	{
+		case PCV_POLY:
+			return &poly->pts[READINT32(*p)];
+		case PCV_OWN:
+			pv = HWR_AllocVertex();
+			pv->x = ReadFloat(p);
+			pv->y = ReadFloat(p);
+			return pv;
+		default:
+			return NULL;
+	}
+}
+
+static boolean HWR_LoadPlaneCache(void)
+{
+	UINT8 *buf, *p;
+	size_t i, length;
+	INT32 j, numpts;
+	poly_t *poly;
+	seg_t *lseg;
+
+	length = FIL_ReadFileTag(HWR_PlaneCacheName(), &buf, PU_STATIC);
+	if (!length)
+		return false;
+
+	if (!HWR_CheckPlaneCache(buf, buf + length))
+	{
+		Z_Free(buf);
+		return false;
+	}
+
+	p = buf + 8 + 4 + 16 + 4*4;
+	addsubsector = READUINT32(p);
+	p += 4 + 1;
+
+	for (i = 0; i < addsubsector; i++)
+	{
+		numpts = READINT32(p);
+		if (numpts < 0)
+			continue;
+		poly = HWR_AllocPoly(numpts);
+		for (j = 0; j < numpts; j++)
+		{
+			poly->pts[j].x = ReadFloat(&p);
+			poly->pts[j].y = ReadFloat(&p);
+			poly->pts[j].z = ReadFloat(&p);
+		}
+		extrasubsectors[i].planepoly = poly;
+	}
+
+	for (i = 0; i < numnodes; i++)
+	{
+		for (j = 0; j < 2*4; j++)
+			nodes[i].bbox[j/4][j%4] = READFIXED(p);
+		nodes[i].children[0] = READUINT16(p);
+		nodes[i].children[1] = READUINT16(p);
+	}
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		size_t count = subsectors[i].numlines;
+		poly = extrasubsectors[i].planepoly;
+		for (lseg = &segs[subsectors[i].firstline]; count--; lseg++)
+		{
+			lseg->pv1 = HWR_ReadPlaneCacheVertex(&p, poly);
+			lseg->pv2 = HWR_ReadPlaneCacheVertex(&p, poly);
+			lseg->flength = ReadFloat(&p);
+		}
+	}
+
+	Z_Free(buf);
+	return true;
+}
+
 // call this routine after the BSP of a Doom wad file is loaded,
 // and it will generate all the convex polys for the hardware renderer
 void HWR_CreatePlanePolygons(INT32 bspnum)
@@ -992,6 +1308,12 @@ void HWR_CreatePlanePolygons(INT32 bspnum)
 	// number of the first new subsector that might be added
 	addsubsector = numsubsectors;
 
+	if (cv_grplanecache.value && HWR_LoadPlaneCache())
+	{
+		CONS_Debug(DBG_RENDER, "Loaded polygons from %s\n", HWR_PlaneCacheName());
+		return;
+	}
+
 	// construct the initial convex poly that encloses the full map
 	rootp = HWR_AllocPoly(4);
 	rootpv = rootp->pts;
@@ -1015,6 +1337,9 @@ void HWR_CreatePlanePolygons(INT32 bspnum)
 	//CONS_Debug(DBG_RENDER, "%d point divides a polygon line\n",i);
 	AdjustSegs();
 
+	if (cv_grplanecache.value)
+		HWR_SavePlaneCache();
+
 	//debug debug..
 	//if (nobackpoly)
 	//    CONS_Debug(DBG_RENDER, "no back polygon %u times\n",nobackpoly);
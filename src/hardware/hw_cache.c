@@ -22,6 +22,7 @@
 #ifdef HWRENDER
 #include "hw_glob.h"
 #include "hw_drv.h"
+#include "hw_main.h"
 
 #include "../doomstat.h"    //gamemode
 #include "../i_video.h"     //rendermode
@@ -30,6 +31,14 @@
 #include "../z_zone.h"
 #include "../v_video.h"
 #include "../r_draw.h"
+#include "../r_sky.h"
+#include "../p_setup.h"
+#include "../p_spec.h"
+#include "../m_argv.h"
+
+#ifdef HAVE_THREADS
+#include "../i_threads.h"
+#endif
 
 //Hurdler: 25/04/2000: used for new colormap code in hardware mode
 //static UINT8 *gr_colormap = NULL; // by default it must be NULL ! (because colormap tables are not initialized)
@@ -140,7 +149,7 @@ static void HWR_DrawPatchInCache(GLMipmap_t *mipmap,
 
 				texel = source[yfrac>>FRACBITS];
 
-				if (firetranslucent && (transtables[(texel<<8)+0x40000]!=texel))
+				if (firetranslucent && (R_GetTranslucencyTable(tr_trans50)[texel<<8]!=texel))
 					alpha = 0x80;
 				else
 					alpha = 0xff;
@@ -357,45 +366,45 @@ static const INT32 format2bpp[16] =
 	2, //14 GR_TEXFMT_AP_88
 };
 
-static UINT8 *MakeBlock(GLMipmap_t *grMipmap)
+// Fills a block with holes
+static void HWR_ClearBlock(UINT8 *block, INT32 size, INT32 bpp)
 {
-	UINT8 *block;
-	INT32 bpp, i;
+	INT32 i;
 	UINT16 bu16 = ((0x00 <<8) | HWR_CHROMAKEY_EQUIVALENTCOLORINDEX);
 
-	bpp =  format2bpp[grMipmap->grInfo.format];
-	block = Z_Malloc(blocksize*bpp, PU_HWRCACHE, &(grMipmap->grInfo.data));
-
 	switch (bpp)
 	{
-		case 1: memset(block, HWR_PATCHES_CHROMAKEY_COLORINDEX, blocksize); break;
+		case 1: memset(block, HWR_PATCHES_CHROMAKEY_COLORINDEX, size); break;
 		case 2:
 				// fill background with chromakey, alpha = 0
-				for (i = 0; i < blocksize; i++)
+				for (i = 0; i < size; i++)
 				//[segabor]
 					memcpy(block+i*sizeof(UINT16), &bu16, sizeof(UINT16));
 				break;
-		case 4: memset(block, 0x00, blocksize*sizeof(UINT32)); break;
+		case 4: memset(block, 0x00, size*sizeof(UINT32)); break;
 	}
+}
+
+static UINT8 *MakeBlock(GLMipmap_t *grMipmap)
+{
+	UINT8 *block;
+	INT32 bpp;
+
+	bpp =  format2bpp[grMipmap->grInfo.format];
+	block = Z_Malloc(blocksize*bpp, PU_HWRCACHE, &(grMipmap->grInfo.data));
+
+	HWR_ClearBlock(block, blocksize, bpp);
 
 	return block;
 }
 
 //
-// Create a composite texture from patches, adapt the texture size to a power of 2
-// height and width for the hardware texture cache.
+// Sizes a composite texture to a power of 2 height and width for the
+// hardware texture cache, and makes its empty block.
 //
-static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
+static void HWR_SetupTexture(INT32 texnum, GLTexture_t *grtex)
 {
-	UINT8 *block;
-	texture_t *texture;
-	texpatch_t *patch;
-	patch_t *realpatch;
-
-	INT32 i;
-	boolean skyspecial = false; //poor hack for Legacy large skies..
-
-	texture = textures[texnum];
+	texture_t *texture = textures[texnum];
 
 	// hack the Legacy skies..
 	if (texture->name[0] == 'S' &&
@@ -404,10 +413,7 @@ static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
 	    (texture->name[4] == 0 ||
 	     texture->name[5] == 0)
 	   )
-	{
-		skyspecial = true;
 		grtex->mipmap.flags = TF_WRAPXY; // don't use the chromakey for sky
-	}
 	else
 		grtex->mipmap.flags = TF_CHROMAKEYED | TF_WRAPXY;
 
@@ -415,23 +421,39 @@ static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
 	grtex->mipmap.width = (UINT16)blockwidth;
 	grtex->mipmap.height = (UINT16)blockheight;
 	grtex->mipmap.grInfo.format = textureformat;
+	grtex->mipmap.category = TC_WALL;
 
-	block = MakeBlock(&grtex->mipmap);
+	MakeBlock(&grtex->mipmap);
+}
+
+//
+// Draws the patches of a texture set up by HWR_SetupTexture into its block.
+// It only writes to the block and reads the patches, so HWR_PrecacheLevel
+// can run it on any thread.
+//
+static void HWR_CompositeTexture(INT32 texnum, GLTexture_t *grtex, patch_t **realpatches)
+{
+	texture_t *texture = textures[texnum];
+	texpatch_t *patch;
+	UINT8 *block = grtex->mipmap.grInfo.data;
+	const INT32 width = grtex->mipmap.width, height = grtex->mipmap.height;
+	const INT32 bpp = format2bpp[grtex->mipmap.grInfo.format];
+	INT32 i;
 
-	if (skyspecial) //Hurdler: not efficient, but better than holes in the sky (and it's done only at level loading)
+	if (!(grtex->mipmap.flags & TF_CHROMAKEYED)) //Hurdler: not efficient, but better than holes in the sky (and it's done only at level loading)
 	{
 		INT32 j;
 		RGBA_t col;
 
 		col = V_GetColor(HWR_CHROMAKEY_EQUIVALENTCOLORINDEX);
-		for (j = 0; j < blockheight; j++)
+		for (j = 0; j < height; j++)
 		{
-			for (i = 0; i < blockwidth; i++)
+			for (i = 0; i < width; i++)
 			{
-				block[4*(j*blockwidth+i)+0] = col.s.red;
-				block[4*(j*blockwidth+i)+1] = col.s.green;
-				block[4*(j*blockwidth+i)+2] = col.s.blue;
-				block[4*(j*blockwidth+i)+3] = 0xff;
+				block[4*(j*width+i)+0] = col.s.red;
+				block[4*(j*width+i)+1] = col.s.green;
+				block[4*(j*width+i)+2] = col.s.blue;
+				block[4*(j*width+i)+3] = 0xff;
 			}
 		}
 	}
@@ -439,20 +461,18 @@ static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
 	// Composite the columns together.
 	for (i = 0, patch = texture->patches; i < texture->patchcount; i++, patch++)
 	{
-		realpatch = W_CacheLumpNumPwad(patch->wad, patch->lump, PU_CACHE);
 		HWR_DrawPatchInCache(&grtex->mipmap,
-		                     blockwidth, blockheight,
-		                     blockwidth*format2bpp[grtex->mipmap.grInfo.format],
+		                     width, height,
+		                     width*bpp,
 		                     texture->width, texture->height,
 		                     patch->originx, patch->originy,
-		                     realpatch,
-		                     format2bpp[grtex->mipmap.grInfo.format]);
-		Z_Unlock(realpatch);
+		                     realpatches[i],
+		                     bpp);
 	}
 	//Hurdler: not efficient at all but I don't remember exactly how HWR_DrawPatchInCache works :(
-	if (format2bpp[grtex->mipmap.grInfo.format]==4)
+	if (bpp == 4)
 	{
-		for (i = 3; i < blocksize*4; i += 4) // blocksize*4 because blocksize doesn't include the bpp
+		for (i = 3; i < width*height*4; i += 4) // width*height*4 because the size doesn't include the bpp
 		{
 			if (block[i] == 0)
 			{
@@ -466,6 +486,44 @@ static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
 	grtex->scaleY = 1.0f/(texture->height*FRACUNIT);
 }
 
+// Caches every patch of a texture at once, with a tag that keeps
+// the earlier ones from being purged for the later ones
+static patch_t **HWR_CacheTexturePatches(INT32 texnum, INT32 tag)
+{
+	texture_t *texture = textures[texnum];
+	patch_t **realpatches = malloc(max(texture->patchcount, 1) * sizeof (*realpatches));
+	INT32 i;
+
+	if (!realpatches)
+		I_Error("HWR_CacheTexturePatches: out of memory");
+	for (i = 0; i < texture->patchcount; i++)
+		realpatches[i] = W_CacheLumpNumPwad(texture->patches[i].wad, texture->patches[i].lump, tag);
+	return realpatches;
+}
+
+static void HWR_UnlockTexturePatches(INT32 texnum, patch_t **realpatches)
+{
+	INT32 i;
+
+	for (i = 0; i < textures[texnum]->patchcount; i++)
+		Z_ChangeTag(realpatches[i], PU_CACHE);
+	free(realpatches);
+}
+
+//
+// Create a composite texture from patches, adapt the texture size to a power of 2
+// height and width for the hardware texture cache.
+//
+static void HWR_GenerateTexture(INT32 texnum, GLTexture_t *grtex)
+{
+	patch_t **realpatches;
+
+	HWR_SetupTexture(texnum, grtex);
+	realpatches = HWR_CacheTexturePatches(texnum, PU_STATIC);
+	HWR_CompositeTexture(texnum, grtex, realpatches);
+	HWR_UnlockTexturePatches(texnum, realpatches);
+}
+
 // patch may be NULL if grMipmap has been initialised already and makebitmap is false
 void HWR_MakePatch (const patch_t *patch, GLPatch_t *grPatch, GLMipmap_t *grMipmap, boolean makebitmap)
 {
@@ -491,6 +549,7 @@ void HWR_MakePatch (const patch_t *patch, GLPatch_t *grPatch, GLMipmap_t *grMipm
 		grMipmap->flags = 0;
 		// setup the texture info
 		grMipmap->grInfo.format = patchformat;
+		grMipmap->category = TC_SPRITE;
 	}
 	else
 	{
@@ -612,6 +671,193 @@ void HWR_PrepLevelCache(size_t pnumtextures)
 	gr_textures = calloc(pnumtextures, sizeof (*gr_textures));
 	if (gr_textures == NULL)
 		I_Error("3D can't alloc gr_textures");
+
+	if (cv_grprecache.value)
+		HWR_PrecacheLevel();
+}
+
+// --------------------------------------------------------------------------
+// Convert and download the level's wall textures and flats while it loads,
+// instead of the first time each one is seen
+// --------------------------------------------------------------------------
+// Textures are composited on as many threads as this,
+// while the main thread downloads the finished ones
+#define MAXTEXTURETHREADS 8
+
+typedef struct
+{
+	INT32 texnum;
+	patch_t **realpatches;
+	boolean done;
+} texturejob_t;
+
+static texturejob_t *texturejobs;
+static size_t numtexturejobs, nexttexturejob;
+
+#ifdef HAVE_THREADS
+static I_mutex texturejob_mutex;
+static I_cond texturejob_cond;
+#endif
+
+static void HWR_CompositeTextureJob(texturejob_t *job)
+{
+	HWR_CompositeTexture(job->texnum, &gr_textures[job->texnum], job->realpatches);
+}
+
+#ifdef HAVE_THREADS
+//
+// HWR_TextureWorker
+//
+// Composites textures off the list until it's empty. Everything the
+// jobs need was allocated up front, so it can run on any thread.
+//
+static void HWR_TextureWorker(void *userdata)
+{
+	(void)userdata;
+	I_lock_mutex(&texturejob_mutex);
+	while (nexttexturejob < numtexturejobs)
+	{
+		texturejob_t *job = &texturejobs[nexttexturejob++];
+
+		I_unlock_mutex(texturejob_mutex);
+		HWR_CompositeTextureJob(job);
+		I_lock_mutex(&texturejob_mutex);
+
+		job->done = true;
+		I_wake_all_cond(&texturejob_cond);
+	}
+	I_unlock_mutex(texturejob_mutex);
+}
+#endif
+
+// Waits for a job to be composited, doing it here if no worker has taken it.
+static void HWR_FinishTextureJob(texturejob_t *job)
+{
+#ifdef HAVE_THREADS
+	I_lock_mutex(&texturejob_mutex);
+	while (!job->done)
+	{
+		if (nexttexturejob < numtexturejobs)
+		{
+			texturejob_t *next = &texturejobs[nexttexturejob++];
+
+			I_unlock_mutex(texturejob_mutex);
+			HWR_CompositeTextureJob(next);
+			I_lock_mutex(&texturejob_mutex);
+
+			next->done = true;
+			I_wake_all_cond(&texturejob_cond);
+		}
+		else
+			I_hold_cond(&texturejob_cond, texturejob_mutex);
+	}
+	I_unlock_mutex(texturejob_mutex);
+#else
+	HWR_CompositeTextureJob(job);
+	job->done = true;
+#endif
+}
+
+static void HWR_QueueTexture(INT32 tex, UINT8 *queued)
+{
+	GLTexture_t *grtex;
+
+	if (tex <= 0 || (size_t)tex >= gr_numtextures || queued[tex])
+		return;
+	queued[tex] = 1;
+
+	grtex = &gr_textures[tex];
+	if (grtex->mipmap.grInfo.data || grtex->mipmap.downloaded)
+		return;
+
+	// The blocks and patches are allocated here, so the workers never
+	// touch the zone, and the patches are kept until they're done.
+	HWR_SetupTexture(tex, grtex);
+	texturejobs[numtexturejobs].texnum = tex;
+	texturejobs[numtexturejobs].realpatches = HWR_CacheTexturePatches(tex, PU_STATIC);
+	texturejobs[numtexturejobs].done = false;
+	numtexturejobs++;
+}
+
+//
+// HWR_PrecacheLevel
+//
+// The wall textures are composited on worker threads. Only the main
+// thread has the GL context, so it downloads each one as it's finished.
+//
+void HWR_PrecacheLevel(void)
+{
+	UINT8 *queued;
+	size_t i;
+#ifdef HAVE_THREADS
+	INT32 threads;
+#endif
+
+	queued = calloc(gr_numtextures, 1);
+	texturejobs = malloc(gr_numtextures * sizeof (*texturejobs));
+	if (!queued || !texturejobs)
+		I_Error("HWR_PrecacheLevel: out of memory");
+
+	numtexturejobs = nexttexturejob = 0;
+	for (i = 0; i < numsides; i++)
+	{
+		HWR_QueueTexture(sides[i].toptexture, queued);
+		HWR_QueueTexture(sides[i].midtexture, queued);
+		HWR_QueueTexture(sides[i].bottomtexture, queued);
+	}
+	HWR_QueueTexture(skytexture, queued);
+
+	// Every frame of an animation is downloaded now too, so the walls
+	// don't stall the first time each one comes around.
+	for (i = 0; i < gr_numtextures; i++)
+	{
+		INT32 basepic, numpics;
+
+		if (queued[i] && P_GetTextureAnimation((INT32)i, &basepic, &numpics))
+			while (numpics--)
+				HWR_QueueTexture(basepic + numpics, queued);
+	}
+	free(queued);
+
+#ifdef HAVE_THREADS
+	threads = min(min(I_num_cpus(), MAXTEXTURETHREADS), (INT32)numtexturejobs);
+	if (M_CheckParm("-notexturethreads"))
+		threads = 1;
+	while (--threads > 0)
+		I_spawn_thread("hwr-texture", HWR_TextureWorker, NULL);
+#endif
+
+	for (i = 0; i < numtexturejobs; i++)
+	{
+		GLTexture_t *grtex = &gr_textures[texturejobs[i].texnum];
+
+		HWR_FinishTextureJob(&texturejobs[i]);
+		HWR_UnlockTexturePatches(texturejobs[i].texnum, texturejobs[i].realpatches);
+
+		HWD.pfnSetTexture(&grtex->mipmap);
+		Z_ChangeTag(grtex->mipmap.grInfo.data, PU_HWRCACHE_UNLOCKED);
+	}
+
+#ifdef HAVE_THREADS
+	// Every job is done by now, but a worker may still be on its way out.
+	I_lock_mutex(&texturejob_mutex);
+	numtexturejobs = 0;
+	I_unlock_mutex(texturejob_mutex);
+#else
+	numtexturejobs = 0;
+#endif
+	free(texturejobs);
+	texturejobs = NULL;
+
+	for (i = 0; i < numlevelflats; i++)
+	{
+		INT32 k;
+
+		if (!levelflats[i].speed)
+			HWR_GetFlat(levelflats[i].lumpnum);
+		else for (k = 0; k < levelflats[i].numpics; k++)
+			HWR_GetFlat(levelflats[i].baselumpnum + k);
+	}
 }
 
 void HWR_SetPalette(RGBA_t *palette)
@@ -668,6 +914,7 @@ static void HWR_CacheFlat(GLMipmap_t *grMipmap, lumpnum_t flatlumpnum)
 	grMipmap->grInfo.aspectRatioLog2 = GR_ASPECT_LOG2_1x1;
 	grMipmap->grInfo.format = GR_TEXFMT_P_8;
 	grMipmap->flags = TF_WRAPXY|TF_CHROMAKEYED;
+	grMipmap->category = TC_FLAT;
 
 	size = W_LumpLength(flatlumpnum);
 
@@ -779,6 +1026,14 @@ void HWR_GetMappedPatch(GLPatch_t *gpatch, const UINT8 *colormap)
 		return;
 	}
 
+	// With indexed textures, the driver draws the one texture through the colormap
+	if (cv_grindexedtextures.value && HWD.pfnSetColormap)
+	{
+		HWR_GetPatch(gpatch);
+		if (HWD.pfnSetColormap(colormap))
+			return;
+	}
+
 	// search for the mimmap
 	// skip the first (no colormap translated)
 	for (grmip = &gpatch->mipmap; grmip->nextcolormap; )
@@ -815,6 +1070,201 @@ void HWR_UnlockCachedPatch(GLPatch_t *gpatch)
 	Z_ChangeTag(gpatch, PU_HWRPATCHINFO_UNLOCKED);
 }
 
+// =================================================
+//             PATCH ATLAS
+// =================================================
+// Small patches drawn straight to the screen, like font characters and HUD
+// graphics, share the pages of an atlas instead of having a texture each.
+// A screen of text then binds one texture instead of one per character,
+// and the driver can draw it as a single batch. The pages are kept in
+// system memory for good, so they can be sent again after the driver
+// forgets its textures.
+
+#define ATLASPAGESIZE 256 // power of two
+#define ATLASMAXPATCH 64 // bigger patches get their own texture
+#define ATLASPADDING 2 // holes between patches, so filtering doesn't bleed
+#define ATLASMAXPAGES 32 // the atlas starts over once they're all full
+
+typedef struct
+{
+	GLMipmap_t mipmap;
+	INT32 shelfx, shelfy, shelfheight; // patches are packed in rows
+	boolean dirty; // patches were added since the driver last had it
+} gratlaspage_t;
+
+typedef struct gratlasslot_s
+{
+	const UINT8 *colormap;
+	gratlaspage_t *page;
+	INT32 x, y;
+	struct gratlasslot_s *next;
+} gratlasslot_t;
+
+static gratlaspage_t *atlaspages[ATLASMAXPAGES];
+static INT32 numatlaspages = 0;
+
+static void HWR_InitAtlasPage(gratlaspage_t *page)
+{
+	const INT32 bpp = format2bpp[patchformat];
+
+	page->mipmap.width = page->mipmap.height = ATLASPAGESIZE;
+	page->mipmap.flags = 0;
+	page->mipmap.grInfo.format = patchformat;
+	page->mipmap.category = TC_HUD;
+	page->mipmap.grInfo.data = realloc(page->mipmap.grInfo.data, ATLASPAGESIZE*ATLASPAGESIZE*bpp);
+	if (!page->mipmap.grInfo.data)
+		I_Error("%s: Out of memory", "HWR_InitAtlasPage");
+	HWR_ClearBlock(page->mipmap.grInfo.data, ATLASPAGESIZE*ATLASPAGESIZE, bpp);
+
+	page->shelfx = page->shelfy = page->shelfheight = 0;
+	page->dirty = true;
+}
+
+// Callback function for HWR_ClearPatchAtlas.
+static void FreeAtlasSlots(INT32 patchnum, void *patch)
+{
+	GLPatch_t* const grpatch = patch;
+	(void)patchnum; //unused
+	while (grpatch->atlasslots)
+	{
+		gratlasslot_t *slot = grpatch->atlasslots;
+		grpatch->atlasslots = slot->next;
+		free(slot);
+	}
+}
+
+static void HWR_ClearPatchAtlas(void)
+{
+	INT32 i;
+
+	for (i = 0; i < numwadfiles; i++)
+		M_AATreeIterate(wadfiles[i]->hwrcache, FreeAtlasSlots);
+
+	for (i = 0; i < numatlaspages; i++)
+		HWR_InitAtlasPage(atlaspages[i]);
+}
+
+// Finds room for a w by h block at the end of the page's rows
+static boolean HWR_PlaceOnAtlasPage(gratlaspage_t *page, INT32 w, INT32 h, INT32 *x, INT32 *y)
+{
+	if (page->shelfx + w > ATLASPAGESIZE)
+	{
+		if (page->shelfy + page->shelfheight + h > ATLASPAGESIZE)
+			return false;
+		page->shelfy += page->shelfheight;
+		page->shelfx = page->shelfheight = 0;
+	}
+	if (page->shelfy + h > ATLASPAGESIZE)
+		return false;
+
+	*x = page->shelfx;
+	*y = page->shelfy;
+	page->shelfx += w;
+	if (h > page->shelfheight)
+		page->shelfheight = h;
+	return true;
+}
+
+static gratlasslot_t *HWR_AddToAtlas(GLPatch_t *gpatch, const UINT8 *colormap)
+{
+	const INT32 w = gpatch->width + ATLASPADDING, h = gpatch->height + ATLASPADDING;
+	gratlaspage_t *page = NULL;
+	gratlasslot_t *slot;
+	GLMipmap_t dest;
+	patch_t *patch;
+	INT32 i, x = 0, y = 0, bpp;
+
+	// Every page has the same format
+	if (numatlaspages && atlaspages[0]->mipmap.grInfo.format != (GrTextureFormat_t)patchformat)
+		HWR_ClearPatchAtlas();
+
+	for (i = 0; i < numatlaspages; i++)
+		if (HWR_PlaceOnAtlasPage(atlaspages[i], w, h, &x, &y))
+		{
+			page = atlaspages[i];
+			break;
+		}
+
+	if (!page)
+	{
+		if (numatlaspages == ATLASMAXPAGES)
+		{
+			HWR_ClearPatchAtlas();
+			page = atlaspages[0];
+		}
+		else
+		{
+			page = calloc(1, sizeof (*page));
+			if (!page)
+				I_Error("%s: Out of memory", "HWR_AddToAtlas");
+			HWR_InitAtlasPage(page);
+			atlaspages[numatlaspages++] = page;
+		}
+		HWR_PlaceOnAtlasPage(page, w, h, &x, &y);
+	}
+
+	slot = malloc(sizeof (*slot));
+	if (!slot)
+		I_Error("%s: Out of memory", "HWR_AddToAtlas");
+	slot->colormap = colormap;
+	slot->page = page;
+	slot->x = x;
+	slot->y = y;
+	slot->next = gpatch->atlasslots;
+	gpatch->atlasslots = slot;
+
+	// Draw it straight into the page
+	bpp = format2bpp[page->mipmap.grInfo.format];
+	dest = page->mipmap;
+	dest.grInfo.data = (UINT8 *)page->mipmap.grInfo.data + (y*ATLASPAGESIZE + x)*bpp;
+	dest.colormap = colormap;
+	patch = W_CacheLumpNumPwad(gpatch->wadnum, gpatch->lumpnum, PU_STATIC);
+	HWR_DrawPatchInCache(&dest, gpatch->width, gpatch->height, ATLASPAGESIZE*bpp,
+		gpatch->width, gpatch->height, 0, 0, patch, bpp);
+	Z_Free(patch);
+	page->dirty = true;
+
+	return slot;
+}
+
+// -------------------+
+// HWR_GetAtlasPatch  : Make a small patch ready for drawing as it is, from a
+//                    : page of the patch atlas. Gives where it is on the page.
+// Returns            : false if the patch needs a texture of its own, use
+//                    : HWR_GetMappedPatch then
+// -------------------+
+boolean HWR_GetAtlasPatch(GLPatch_t *gpatch, const UINT8 *colormap, float *s1, float *t1, float *s2, float *t2)
+{
+	gratlasslot_t *slot;
+
+	if (!HWD.pfnUpdateTexture || gpatch->width <= 0 || gpatch->height <= 0
+		|| gpatch->width > ATLASMAXPATCH || gpatch->height > ATLASMAXPATCH)
+		return false;
+
+	if (colormap == colormaps)
+		colormap = NULL;
+
+	for (slot = gpatch->atlasslots; slot; slot = slot->next)
+		if (slot->colormap == colormap)
+			break;
+	if (!slot)
+		slot = HWR_AddToAtlas(gpatch, colormap);
+
+	if (slot->page->dirty)
+	{
+		HWD.pfnUpdateTexture(&slot->page->mipmap);
+		slot->page->dirty = false;
+	}
+	else
+		HWD.pfnSetTexture(&slot->page->mipmap);
+
+	*s1 = (float)slot->x / ATLASPAGESIZE;
+	*t1 = (float)slot->y / ATLASPAGESIZE;
+	*s2 = (float)(slot->x + gpatch->width) / ATLASPAGESIZE;
+	*t2 = (float)(slot->y + gpatch->height) / ATLASPAGESIZE;
+	return true;
+}
+
 static const INT32 picmode2GR[] =
 {
 	GR_TEXFMT_P_8,                // PALETTE
@@ -972,6 +1422,7 @@ GLPatch_t *HWR_GetPic(lumpnum_t lumpnum)
 		Z_ChangeTag(block, PU_HWRCACHE_UNLOCKED);
 
 		grpatch->mipmap.flags = 0;
+		grpatch->mipmap.category = TC_HUD;
 		grpatch->max_s = (float)newwidth  / (float)blockwidth;
 		grpatch->max_t = (float)newheight / (float)blockheight;
 	}
@@ -82,101 +82,115 @@ static GLdouble projMatrix[16];
 float frustum[6][4];
 #endif
 
-typedef struct clipnode_s
-	{
-		struct clipnode_s *prev, *next;
-		angle_t start, end;
-	} clipnode_t;
-
-clipnode_t *freelist;
-clipnode_t *clipnodes;
-clipnode_t *cliphead;
-
-static clipnode_t * gld_clipnode_GetNew(void);
-static clipnode_t * gld_clipnode_NewRange(angle_t start, angle_t end);
-static boolean gld_clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle);
-static void gld_clipper_AddClipRange(angle_t start, angle_t end);
-static void gld_clipper_RemoveRange(clipnode_t * range);
-static void gld_clipnode_Free(clipnode_t *node);
-
-static clipnode_t * gld_clipnode_GetNew(void)
+// The circle of angles is split into CLIPBINS bins of CLIPBINSIZE angles
+// each. A bin that's clipped all over is set in clipfull. One that's only
+// partly clipped remembers how far the clipping reaches in from its start
+// and in from its end. A range clipped in the middle of a bin and touching
+// neither is forgotten, which can only let more through, never less.
+#define CLIPBINBITS 12
+#define CLIPBINS (1<<CLIPBINBITS)
+#define CLIPBINSHIFT (32-CLIPBINBITS)
+#define CLIPBINSIZE ((angle_t)1<<CLIPBINSHIFT)
+#define CLIPBINMASK (CLIPBINSIZE-1)
+
+static UINT32 clipfull[CLIPBINS/32];
+static angle_t clipfromstart[CLIPBINS]; // [0, clipfromstart) of the bin is clipped
+static angle_t clipfromend[CLIPBINS]; // [clipfromend, CLIPBINSIZE) of the bin is clipped
+
+static inline boolean gld_clipper_BinFull(size_t bin)
 {
-	if (freelist)
-	{
-		clipnode_t * p = freelist;
-		freelist = p->next;
-		return p;
-	}
-	else
-	{
-		return (clipnode_t*)malloc(sizeof(clipnode_t));
-	}
+	return (clipfull[bin>>5]>>(bin&31)) & 1;
 }
 
-static clipnode_t * gld_clipnode_NewRange(angle_t start, angle_t end)
+// Whether [start, end] of bin, counted from the bin's start, is clipped
+static inline boolean gld_clipper_BinClipped(size_t bin, angle_t start, angle_t end)
 {
-	clipnode_t * c = gld_clipnode_GetNew();
-	c->start = start;
-	c->end = end;
-	c->next = c->prev=NULL;
-	return c;
+	return gld_clipper_BinFull(bin) || end < clipfromstart[bin] || start >= clipfromend[bin];
 }
 
-boolean gld_clipper_SafeCheckRange(angle_t startAngle, angle_t endAngle)
+// Whether every bin from first to last is full, a word at a time
+static boolean gld_clipper_BinsFull(size_t first, size_t last)
 {
-	if(startAngle > endAngle)
-	{
-		return (gld_clipper_IsRangeVisible(startAngle, ANGLE_MAX) || gld_clipper_IsRangeVisible(0, endAngle));
-	}
+	size_t word = first>>5;
+	const size_t lastword = last>>5;
+	UINT32 mask = UINT32_MAX<<(first&31);
 
-	return gld_clipper_IsRangeVisible(startAngle, endAngle);
+	if (first > last)
+		return true;
+
+	for (; word < lastword; word++, mask = UINT32_MAX)
+		if ((clipfull[word] & mask) != mask)
+			return false;
+	mask &= UINT32_MAX>>(31-(last&31));
+	return (clipfull[word] & mask) == mask;
 }
 
-static boolean gld_clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle)
+static void gld_clipper_FillBins(size_t first, size_t last)
 {
-	clipnode_t *ci;
-	ci = cliphead;
+	size_t word = first>>5;
+	const size_t lastword = last>>5;
+	UINT32 mask = UINT32_MAX<<(first&31);
 
-	if (endAngle == 0 && ci && ci->start == 0)
-		return false;
+	if (first > last)
+		return;
 
-	while (ci != NULL && ci->start < endAngle)
-	{
-		if (startAngle >= ci->start && endAngle <= ci->end)
-		{
-			return false;
-		}
-		ci = ci->next;
-	}
+	for (; word < lastword; word++, mask = UINT32_MAX)
+		clipfull[word] |= mask;
+	clipfull[word] |= mask & (UINT32_MAX>>(31-(last&31)));
+}
 
-	return true;
+// Clips [start, end] of bin, counted from the bin's start
+static void gld_clipper_ClipBin(size_t bin, angle_t start, angle_t end)
+{
+	if (gld_clipper_BinFull(bin))
+		return;
+
+	if (start <= clipfromstart[bin])
+		clipfromstart[bin] = max(clipfromstart[bin], end+1);
+	else if (end+1 >= clipfromend[bin])
+		clipfromend[bin] = min(clipfromend[bin], start);
+	else
+		return;
+
+	if (clipfromstart[bin] >= clipfromend[bin])
+		clipfull[bin>>5] |= 1U<<(bin&31);
 }
 
-static void gld_clipnode_Free(clipnode_t *node)
+static boolean gld_clipper_IsRangeVisible(angle_t startAngle, angle_t endAngle)
 {
-	node->next = freelist;
-	freelist = node;
+	const size_t first = startAngle>>CLIPBINSHIFT, last = endAngle>>CLIPBINSHIFT;
+
+	if (first == last)
+		return !gld_clipper_BinClipped(first, startAngle & CLIPBINMASK, endAngle & CLIPBINMASK);
+
+	return !(gld_clipper_BinClipped(first, startAngle & CLIPBINMASK, CLIPBINMASK)
+		&& gld_clipper_BinClipped(last, 0, endAngle & CLIPBINMASK)
+		&& gld_clipper_BinsFull(first+1, last-1));
 }
 
-static void gld_clipper_RemoveRange(clipnode_t *range)
+static void gld_clipper_AddClipRange(angle_t start, angle_t end)
 {
-	if (range == cliphead)
+	const size_t first = start>>CLIPBINSHIFT, last = end>>CLIPBINSHIFT;
+
+	if (first == last)
 	{
-		cliphead = cliphead->next;
+		gld_clipper_ClipBin(first, start & CLIPBINMASK, end & CLIPBINMASK);
+		return;
 	}
-	else
+
+	gld_clipper_ClipBin(first, start & CLIPBINMASK, CLIPBINMASK);
+	gld_clipper_FillBins(first+1, last-1);
+	gld_clipper_ClipBin(last, 0, end & CLIPBINMASK);
+}
+
+boolean gld_clipper_SafeCheckRange(angle_t startAngle, angle_t endAngle)
+{
+	if(startAngle > endAngle)
 	{
-		if (range->prev)
-		{
-			range->prev->next = range->next;
-		}
-		if (range->next)
-		{
-			range->next->prev = range->prev;
-		}
+		return (gld_clipper_IsRangeVisible(startAngle, ANGLE_MAX) || gld_clipper_IsRangeVisible(0, endAngle));
 	}
 
-	gld_clipnode_Free(range);
+	return gld_clipper_IsRangeVisible(startAngle, endAngle);
 }
 
 void gld_clipper_SafeAddClipRange(angle_t startangle, angle_t endangle)
@@ -194,127 +208,14 @@ void gld_clipper_SafeAddClipRange(angle_t startangle, angle_t endangle)
 	}
 }
 
-static void gld_clipper_AddClipRange(angle_t start, angle_t end)
-{
-	clipnode_t *node, *temp, *prevNode, *node2, *delnode;
-
-	if (cliphead)
-	{
-		//check to see if range contains any old ranges
-		node = cliphead;
-		while (node != NULL && node->start < end)
-		{
-			if (node->start >= start && node->end <= end)
-			{
-				temp = node;
-				node = node->next;
-				gld_clipper_RemoveRange(temp);
-			}
-			else
-			{
-				if (node->start <= start && node->end >= end)
-				{
-					return;
-				}
-				else
-				{
-					node = node->next;
-				}
-			}
-		}
-
-		//check to see if range overlaps a range (or possibly 2)
-		node = cliphead;
-		while (node != NULL && node->start <= end)
-		{
-			if (node->end >= start)
-			{
-				// we found the first overlapping node
-				if (node->start > start)
-				{
-					// the new range overlaps with this node's start point
-					node->start = start;
-				}
-				if (node->end < end)
-				{
-					node->end = end;
-				}
-
-				node2 = node->next;
-				while (node2 && node2->start <= node->end)
-				{
-					if (node2->end > node->end)
-					{
-						node->end = node2->end;
-					}
-
-					delnode = node2;
-					node2 = node2->next;
-					gld_clipper_RemoveRange(delnode);
-				}
-				return;
-			}
-			node = node->next;
-		}
-
-		//just add range
-		node = cliphead;
-		prevNode = NULL;
-		temp = gld_clipnode_NewRange(start, end);
-		while (node != NULL && node->start < end)
-		{
-			prevNode = node;
-			node = node->next;
-		}
-		temp->next = node;
-		if (node == NULL)
-		{
-			temp->prev = prevNode;
-			if (prevNode)
-			{
-				prevNode->next = temp;
-			}
-			if (!cliphead)
-			{
-				cliphead = temp;
-			}
-		}
-		else
-		{
-			if (node == cliphead)
-			{
-				cliphead->prev = temp;
-				cliphead = temp;
-			}
-			else
-			{
-				temp->prev = prevNode;
-				prevNode->next = temp;
-				node->prev = temp;
-			}
-		}
-	}
-	else
-	{
-		temp = gld_clipnode_NewRange(start, end);
-		cliphead = temp;
-		return;
-	}
-}
-
 void gld_clipper_Clear(void)
 {
-	clipnode_t *node = cliphead;
-	clipnode_t *temp;
-
-	while (node != NULL)
-	{
-		temp = node;
-		node = node->next;
-		gld_clipnode_Free(temp);
-	}
+	size_t i;
 
-	cliphead = NULL;
+	memset(clipfull, 0, sizeof (clipfull));
+	memset(clipfromstart, 0, sizeof (clipfromstart));
+	for (i = 0; i < CLIPBINS; i++)
+		clipfromend[i] = CLIPBINSIZE;
 }
 
 #define RMUL (1.6f/1.333333f)
@@ -45,6 +45,8 @@ struct GLMipmap_s
 	UINT16          height;
 	UINT16          width;
 	UINT32          downloaded;     // the dll driver have it in there cache ?
+	UINT8           category;       // ETextureCategory, for the driver's stats
+	UINT32          lastused;       // frame the driver last bound it in
 
 	struct GLMipmap_s    *nextcolormap;
 	const UINT8          *colormap;
@@ -84,6 +86,7 @@ struct GLPatch_s
 	UINT16              wadnum;      // the software patch lump num for when the hardware patch
 	UINT16              lumpnum;     // was flushed, and we need to re-create it
 	GLMipmap_t          mipmap;
+	struct gratlasslot_s *atlasslots; // where it is on the patch atlas, for each colormap
 };
 typedef struct GLPatch_s GLPatch_t;
 
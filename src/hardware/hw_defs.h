@@ -176,6 +176,43 @@ enum ETextureFlags
 	TF_TRANSPARENT = 0x00000040,        // texture with some alpha == 0
 };
 
+// What a texture is used for, so the driver can tell how much memory each takes
+enum ETextureCategory
+{
+	TC_OTHER = 0,
+	TC_WALL,
+	TC_FLAT,
+	TC_SPRITE,          // sprites and other patches
+	TC_HUD,             // the patch atlas and pics
+	TC_MODEL,
+	NUMTEXTURECATEGORIES
+};
+
+// Parts of a frame the card's time is measured for, see MarkRenderSection
+enum ERenderSection
+{
+	RS_OTHER = 0,       // from the start of the frame to the first mark
+	RS_SKY,
+	RS_WALLS,
+	RS_PLANES,
+	RS_SPRITES,
+	RS_TRANSLUCENT,     // sorted translucent walls and planes
+	RS_HUD,
+	NUMRENDERSECTIONS
+};
+
+// What the last frame sent to the card
+typedef struct
+{
+	UINT32 drawcalls;
+	UINT32 texturebinds;
+	UINT32 statechanges;    // blend modes set
+	UINT32 vertices;
+	boolean gputimers;      // gputime is measured
+	UINT32 gputime[NUMRENDERSECTIONS]; // microseconds, a few frames behind
+	const char *renderer;   // GL_RENDERER, to tell dumps apart
+} FRenderStats;
+
 #ifdef TODO
 struct FTextureInfo
 {
@@ -213,6 +250,14 @@ enum hwdsetspecialstate
 	HWD_SET_PALETTECOLOR,
 	HWD_SET_TEXTUREFILTERMODE,
 	HWD_SET_TEXTUREANISOTROPICMODE,
+	HWD_SET_TEXTUREBUDGET,
+	HWD_SET_ASYNCUPLOADS,
+	HWD_SET_GPUTIMERS,
+	HWD_SET_SCENEBUFFER,
+	HWD_SET_RENDERSCALE,
+	HWD_SET_SHADERS,
+	HWD_SET_SWAPNOWAIT,
+	HWD_SET_INDEXEDTEXTURES,
 	HWD_NUMSTATE
 };
 
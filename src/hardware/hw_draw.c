@@ -71,6 +71,25 @@ static UINT8 softwaretranstogl[11]    = {  0, 25, 51, 76,102,127,153,178,204,229
 static UINT8 softwaretranstogl_hi[11] = {  0, 51,102,153,204,255,255,255,255,255,255};
 static UINT8 softwaretranstogl_lo[11] = {  0, 12, 24, 36, 48, 60, 71, 83, 95,111,127};
 
+// Makes a patch ready to be drawn on the screen: from the patch atlas when it
+// can be, so runs of text and HUD graphics share a texture. Gives the texture
+// coordinates of its corners.
+static void HWR_Get2DPatch(GLPatch_t *gpatch, const UINT8 *colormap, INT32 option,
+	float *s1, float *t1, float *s2, float *t2)
+{
+	// a wrapping patch needs the whole texture to itself
+	if (!(option & (V_WRAPX|V_WRAPY)) && HWR_GetAtlasPatch(gpatch, colormap, s1, t1, s2, t2))
+		return;
+
+	if (!colormap)
+		HWR_GetPatch(gpatch);
+	else
+		HWR_GetMappedPatch(gpatch, colormap);
+	*s1 = *t1 = 0.0f;
+	*s2 = gpatch->max_s;
+	*t2 = gpatch->max_t;
+}
+
 //
 // -----------------+
 // HWR_DrawPatch    : Draw a 'tile' graphic
@@ -81,6 +100,7 @@ void HWR_DrawPatch(GLPatch_t *gpatch, INT32 x, INT32 y, INT32 option)
 {
 	FOutVector v[4];
 	FBITFIELD flags;
+	float s1, t1, s2, t2;
 
 //  3--2
 //  | /|
@@ -92,7 +112,7 @@ void HWR_DrawPatch(GLPatch_t *gpatch, INT32 x, INT32 y, INT32 option)
 	float pdupy = FIXED_TO_FLOAT(vid.fdupy)*2.0f;
 
 	// make patch ready in hardware cache
-	HWR_GetPatch(gpatch);
+	HWR_Get2DPatch(gpatch, NULL, option, &s1, &t1, &s2, &t2);
 
 	switch (option & V_SCALEPATCHMASK)
 	{
@@ -119,10 +139,10 @@ void HWR_DrawPatch(GLPatch_t *gpatch, INT32 x, INT32 y, INT32 option)
 
 	v[0].z = v[1].z = v[2].z = v[3].z = 1.0f;
 
-	v[0].sow = v[3].sow = 0.0f;
-	v[2].sow = v[1].sow = gpatch->max_s;
-	v[0].tow = v[1].tow = 0.0f;
-	v[2].tow = v[3].tow = gpatch->max_t;
+	v[0].sow = v[3].sow = s1;
+	v[2].sow = v[1].sow = s2;
+	v[0].tow = v[1].tow = t1;
+	v[2].tow = v[3].tow = t2;
 
 	flags = BLENDMODE|PF_Clip|PF_NoZClip|PF_NoDepthTest;
 
@@ -142,6 +162,7 @@ void HWR_DrawFixedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscale,
 	float cx = FIXED_TO_FLOAT(x);
 	float cy = FIXED_TO_FLOAT(y);
 	UINT8 alphalevel = ((option & V_ALPHAMASK) >> V_ALPHASHIFT);
+	float s1, t1, s2, t2;
 
 //  3--2
 //  | /|
@@ -153,10 +174,7 @@ void HWR_DrawFixedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscale,
 		return;
 
 	// make patch ready in hardware cache
-	if (!colormap)
-		HWR_GetPatch(gpatch);
-	else
-		HWR_GetMappedPatch(gpatch, colormap);
+	HWR_Get2DPatch(gpatch, colormap, option, &s1, &t1, &s2, &t2);
 
 	dupx = (float)vid.dupx;
 	dupy = (float)vid.dupy;
@@ -276,17 +294,17 @@ void HWR_DrawFixedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscale,
 
 	if (option & V_FLIP)
 	{
-		v[0].sow = v[3].sow = gpatch->max_s;
-		v[2].sow = v[1].sow = 0.0f;
+		v[0].sow = v[3].sow = s2;
+		v[2].sow = v[1].sow = s1;
 	}
 	else
 	{
-		v[0].sow = v[3].sow = 0.0f;
-		v[2].sow = v[1].sow = gpatch->max_s;
+		v[0].sow = v[3].sow = s1;
+		v[2].sow = v[1].sow = s2;
 	}
 
-	v[0].tow = v[1].tow = 0.0f;
-	v[2].tow = v[3].tow = gpatch->max_t;
+	v[0].tow = v[1].tow = t1;
+	v[2].tow = v[3].tow = t2;
 
 	flags = BLENDMODE|PF_Clip|PF_NoZClip|PF_NoDepthTest;
 
@@ -318,6 +336,7 @@ void HWR_DrawCroppedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscal
 	float cx = FIXED_TO_FLOAT(x);
 	float cy = FIXED_TO_FLOAT(y);
 	UINT8 alphalevel = ((option & V_ALPHAMASK) >> V_ALPHASHIFT);
+	float s1, t1, s2, t2;
 
 //  3--2
 //  | /|
@@ -329,7 +348,7 @@ void HWR_DrawCroppedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscal
 		return;
 
 	// make patch ready in hardware cache
-	HWR_GetPatch(gpatch);
+	HWR_Get2DPatch(gpatch, NULL, option, &s1, &t1, &s2, &t2);
 
 	dupx = (float)vid.dupx;
 	dupy = (float)vid.dupy;
@@ -437,10 +456,10 @@ void HWR_DrawCroppedPatch(GLPatch_t *gpatch, fixed_t x, fixed_t y, fixed_t pscal
 
 	v[0].z = v[1].z = v[2].z = v[3].z = 1.0f;
 
-	v[0].sow = v[3].sow = ((sx)/(float)SHORT(gpatch->width) )*gpatch->max_s;
-	v[2].sow = v[1].sow = ((w )/(float)SHORT(gpatch->width) )*gpatch->max_s;
-	v[0].tow = v[1].tow = ((sy)/(float)SHORT(gpatch->height))*gpatch->max_t;
-	v[2].tow = v[3].tow = ((h )/(float)SHORT(gpatch->height))*gpatch->max_t;
+	v[0].sow = v[3].sow = s1 + ((sx)/(float)SHORT(gpatch->width) )*(s2 - s1);
+	v[2].sow = v[1].sow = s1 + ((w )/(float)SHORT(gpatch->width) )*(s2 - s1);
+	v[0].tow = v[1].tow = t1 + ((sy)/(float)SHORT(gpatch->height))*(t2 - t1);
+	v[2].tow = v[3].tow = t1 + ((h )/(float)SHORT(gpatch->height))*(t2 - t1);
 
 	flags = BLENDMODE|PF_Clip|PF_NoZClip|PF_NoDepthTest;
 
@@ -1071,15 +1090,30 @@ static inline boolean saveTGA(const char *file_name, void *buffer,
 // screen shot
 // --------------------------------------------------------------------------
 
-UINT8 *HWR_GetScreenshot(void)
+// Reads the screen as 24bit 888 RGB, without waiting for the card if the
+// driver can help it. Returns true if buf got a screen, which may be one
+// from a few calls ago; *buftag is the tag that one was read with.
+boolean HWR_ReadScreenAsync(UINT8 *buf, UINT32 tag, UINT32 *buftag)
 {
-	UINT8 *buf = malloc(vid.width * vid.height * 3 * sizeof (*buf));
+	INT32 ret = -1;
+
+	if (HWD.pfnReadScreenAsync)
+		ret = HWD.pfnReadScreenAsync(vid.width, vid.height, tag, buf, buftag);
+	if (ret >= 0)
+		return (ret > 0);
 
-	if (!buf)
-		return NULL;
-	// returns 24bit 888 RGB
 	HWD.pfnReadRect(0, 0, vid.width, vid.height, vid.width * 3, (void *)buf);
-	return buf;
+	*buftag = tag;
+	return true;
+}
+
+// Collects the screens HWR_ReadScreenAsync is still reading, one per call.
+// Returns false once there are none left.
+boolean HWR_CollectScreenAsync(UINT8 *buf, UINT32 *buftag)
+{
+	if (!HWD.pfnReadScreenAsync)
+		return false;
+	return (HWD.pfnReadScreenAsync(0, 0, 0, buf, buftag) > 0);
 }
 
 boolean HWR_Screenshot(const char *pathname)
@@ -1097,11 +1131,11 @@ boolean HWR_Screenshot(const char *pathname)
 	HWD.pfnReadRect(0, 0, vid.width, vid.height, vid.width * 3, (void *)buf);
 
 #ifdef USE_PNG
-	ret = M_SavePNG(pathname, buf, vid.width, vid.height, NULL);
+	ret = M_SavePNGLater(pathname, buf, vid.width, vid.height, NULL); // frees buf
 #else
 	ret = saveTGA(pathname, buf, vid.width, vid.height);
-#endif
 	free(buf);
+#endif
 	return ret;
 }
 
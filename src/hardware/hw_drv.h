@@ -50,7 +50,10 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo *pSurf, FOutVector *pOutVerts, FUI
 EXPORT void HWRAPI(SetBlend) (FBITFIELD PolyFlags);
 EXPORT void HWRAPI(ClearBuffer) (FBOOLEAN ColorMask, FBOOLEAN DepthMask, FRGBAFloat *ClearColor);
 EXPORT void HWRAPI(SetTexture) (FTextureInfo *TexInfo);
+EXPORT void HWRAPI(UpdateTexture) (FTextureInfo *TexInfo);
+EXPORT boolean HWRAPI(SetColormap) (const UINT8 *colormap);
 EXPORT void HWRAPI(ReadRect) (INT32 x, INT32 y, INT32 width, INT32 height, INT32 dst_stride, UINT16 *dst_data);
+EXPORT INT32 HWRAPI(ReadScreenAsync) (INT32 width, INT32 height, UINT32 tag, UINT8 *dst_data, UINT32 *dst_tag);
 EXPORT void HWRAPI(GClipRect) (INT32 minx, INT32 miny, INT32 maxx, INT32 maxy, float nearclip);
 EXPORT void HWRAPI(ClearMipMapCache) (void);
 
@@ -61,7 +64,11 @@ EXPORT void HWRAPI(SetSpecialState) (hwdspecialstate_t IdState, INT32 Value);
 EXPORT void HWRAPI(DrawMD2) (INT32 *gl_cmd_buffer, md2_frame_t *frame, FTransform *pos, float scale);
 EXPORT void HWRAPI(DrawMD2i) (INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration, INT32 tics, md2_frame_t *nextframe, FTransform *pos, float scale, UINT8 flipped, UINT8 *color);
 EXPORT void HWRAPI(SetTransform) (FTransform *ptransform);
+EXPORT boolean HWRAPI(SetBlendedTexture) (FTextureInfo *pTexInfo, FTextureInfo *pMaskInfo, RGBA_t color);
 EXPORT INT32 HWRAPI(GetTextureUsed) (void);
+EXPORT void HWRAPI(GetTextureStats) (UINT32 *resident, UINT32 *evictions);
+EXPORT void HWRAPI(MarkRenderSection) (INT32 section);
+EXPORT void HWRAPI(GetRenderStats) (FRenderStats *stats);
 EXPORT INT32 HWRAPI(GetRenderVersion) (void);
 
 #ifdef SHUFFLE
@@ -92,14 +99,21 @@ struct hwdriver_s
 	SetBlend            pfnSetBlend;
 	ClearBuffer         pfnClearBuffer;
 	SetTexture          pfnSetTexture;
+	UpdateTexture       pfnUpdateTexture;
+	SetColormap         pfnSetColormap;
 	ReadRect            pfnReadRect;
+	ReadScreenAsync     pfnReadScreenAsync;
 	GClipRect           pfnGClipRect;
 	ClearMipMapCache    pfnClearMipMapCache;
 	SetSpecialState     pfnSetSpecialState;//Hurdler: added for backward compatibility
 	DrawMD2             pfnDrawMD2;
 	DrawMD2i            pfnDrawMD2i;
 	SetTransform        pfnSetTransform;
+	SetBlendedTexture   pfnSetBlendedTexture;
 	GetTextureUsed      pfnGetTextureUsed;
+	GetTextureStats     pfnGetTextureStats;
+	MarkRenderSection   pfnMarkRenderSection;
+	GetRenderStats      pfnGetRenderStats;
 	GetRenderVersion    pfnGetRenderVersion;
 #ifdef _WINDOWS
 	GetModeList         pfnGetModeList;
@@ -61,6 +61,7 @@ typedef struct
 typedef struct
 {
 	poly_t *planepoly;  // the generated convex polygon
+	struct planecache_s *planecache[2]; // floor and ceiling as last drawn, see HWR_RenderPlane
 } extrasubsector_t;
 
 // needed for sprite rendering
@@ -78,6 +79,7 @@ typedef struct gr_vissprite_s
 	UINT8 translucency;       //alpha level 0-255
 	mobj_t *mobj;
 	boolean precip; // Tails 08-25-2002
+	precipdrop_t precipdrop; // the drop, if precip; mobj is NULL then
 	boolean vflip;
    //Hurdler: 25/04/2000: now support colormap in hardware mode
 	UINT8 *colormap;
@@ -105,6 +107,7 @@ GLTexture_t *HWR_GetTexture(INT32 tex);
 void HWR_GetPatch(GLPatch_t *gpatch);
 void HWR_GetMappedPatch(GLPatch_t *gpatch, const UINT8 *colormap);
 void HWR_UnlockCachedPatch(GLPatch_t *gpatch);
+boolean HWR_GetAtlasPatch(GLPatch_t *gpatch, const UINT8 *colormap, float *s1, float *t1, float *s2, float *t2);
 GLPatch_t *HWR_GetPic(lumpnum_t lumpnum);
 void HWR_SetPalette(RGBA_t *palette);
 GLPatch_t *HWR_GetCachedGLPatchPwad(UINT16 wad, UINT16 lump);
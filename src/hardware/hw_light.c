@@ -634,6 +634,43 @@ light_t *t_lspr[NUMSPRITES] =
 
 static void HWR_SetLight(void);
 
+// The light drawn on walls and planes, kept for HWR_DrawDynamicLights
+// so the lightmap is bound once, and not once per lit surface.
+typedef struct
+{
+	size_t firstvert;
+	FUINT numverts;
+	RGBA_t color;
+} lightpoly_t;
+
+static lightpoly_t *lightpolys = NULL;
+static size_t numlightpolys = 0, maxlightpolys = 0;
+static FOutVector *lightverts = NULL;
+static size_t numlightverts = 0, maxlightverts = 0;
+
+static void HWR_QueueLight(FOutVector *verts, FUINT numverts, RGBA_t color)
+{
+	lightpoly_t *poly;
+
+	if (numlightpolys == maxlightpolys)
+	{
+		maxlightpolys = maxlightpolys ? maxlightpolys*2 : 256;
+		Z_Realloc(lightpolys, maxlightpolys * sizeof (*lightpolys), PU_STATIC, &lightpolys);
+	}
+	while (numlightverts + numverts > maxlightverts)
+	{
+		maxlightverts = maxlightverts ? maxlightverts*2 : 1024;
+		Z_Realloc(lightverts, maxlightverts * sizeof (*lightverts), PU_STATIC, &lightverts);
+	}
+
+	poly = &lightpolys[numlightpolys++];
+	poly->firstvert = numlightverts;
+	poly->numverts = numverts;
+	poly->color = color;
+	M_Memcpy(&lightverts[numlightverts], verts, numverts * sizeof (*verts));
+	numlightverts += numverts;
+}
+
 // --------------------------------------------------------------------------
 // calcul la projection d'un point sur une droite (determin� par deux
 // points) et ensuite calcul la distance (au carr� de ce point au point
@@ -756,8 +793,6 @@ void HWR_WallLighting(FOutVector *wlVerts)
 			wlVerts[i].tow = (float)(0.5f + (wlVerts[i].y-LIGHT_POS(j).y)*s*1.2f);
 		}
 
-		HWR_SetLight();
-
 		Surf.FlatColor.rgba = LONG(dynlights->p_lspr[j]->dynamic_color);
 #ifdef DL_HIGH_QUALITY
 		Surf.FlatColor.s.alpha = (UINT8)((1-dist_p2d/DL_SQRRADIUS(j))*Surf.FlatColor.s.alpha);
@@ -768,7 +803,7 @@ void HWR_WallLighting(FOutVector *wlVerts)
 		if (dynlights->mo[j]->state->nextstate == S_NULL)
 			Surf.FlatColor.s.alpha = (UINT8)(((float)dynlights->mo[j]->tics/(float)dynlights->mo[j]->state->tics)*Surf.FlatColor.s.alpha);
 
-		HWD.pfnDrawPolygon (&Surf, wlVerts, 4, LIGHTMAPFLAGS);
+		HWR_QueueLight(wlVerts, 4, Surf.FlatColor);
 
 	} // end for (j = 0; j < dynlights->nb; j++)
 }
@@ -819,8 +854,6 @@ void HWR_PlaneLighting(FOutVector *clVerts, int nrClipVerts)
 			clVerts[i].tow = 0.5f + (clVerts[i].z-LIGHT_POS(j).z)*s*1.2f;
 		}
 
-		HWR_SetLight();
-
 		Surf.FlatColor.rgba = LONG(dynlights->p_lspr[j]->dynamic_color);
 #ifdef DL_HIGH_QUALITY
 		Surf.FlatColor.s.alpha = (unsigned char)((1 - dist_p2d/DL_SQRRADIUS(j))*Surf.FlatColor.s.alpha);
@@ -831,11 +864,36 @@ void HWR_PlaneLighting(FOutVector *clVerts, int nrClipVerts)
 		if ((dynlights->mo[j]->state->nextstate == S_NULL))
 			Surf.FlatColor.s.alpha = (unsigned char)(((float)dynlights->mo[j]->tics/(float)dynlights->mo[j]->state->tics)*Surf.FlatColor.s.alpha);
 
-		HWD.pfnDrawPolygon (&Surf, clVerts, nrClipVerts, LIGHTMAPFLAGS);
+		HWR_QueueLight(clVerts, (FUINT)nrClipVerts, Surf.FlatColor);
 
 	} // end for (j = 0; j < dynlights->nb; j++)
 }
 
+// --------------------------------------------------------------------------
+// Draw the light HWR_WallLighting and HWR_PlaneLighting have put aside
+// --------------------------------------------------------------------------
+void HWR_DrawDynamicLights(void)
+{
+	FSurfaceInfo Surf;
+	size_t i;
+
+	if (!numlightpolys)
+		return;
+
+	// The light is added on top, so it isn't fogged a second time
+	if (cv_grfog.value)
+		HWD.pfnSetSpecialState(HWD_SET_FOG_MODE, 0);
+
+	HWR_SetLight();
+	for (i = 0; i < numlightpolys; i++)
+	{
+		Surf.FlatColor = lightpolys[i].color;
+		HWD.pfnDrawPolygon(&Surf, &lightverts[lightpolys[i].firstvert], lightpolys[i].numverts, LIGHTMAPFLAGS);
+	}
+
+	numlightpolys = numlightverts = 0;
+}
+
 
 static lumpnum_t coronalumpnum = LUMPERROR;
 #ifndef NEWCORONAS
@@ -1274,7 +1332,7 @@ static void HWR_SearchLightsInMobjs(void)
 	//mobj_t *            mobj;
 
 	// search in the list of thinkers
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		// a mobj ?
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
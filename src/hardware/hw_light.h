@@ -33,6 +33,7 @@ void HWR_InitLight(void);
 void HWR_DL_AddLight(gr_vissprite_t *spr, GLPatch_t *patch);
 void HWR_PlaneLighting(FOutVector *clVerts, int nrClipVerts);
 void HWR_WallLighting(FOutVector *wlVerts);
+void HWR_DrawDynamicLights(void);
 void HWR_ResetLights(void);
 void HWR_SetLights(int viewnumber);
 
@@ -32,6 +32,7 @@
 #include "../r_local.h"
 #include "../r_bsp.h"
 #include "../d_clisrv.h"
+#include "../d_main.h"
 #include "../w_wad.h"
 #include "../z_zone.h"
 #include "../r_splats.h"
@@ -39,6 +40,7 @@
 #include "../st_stuff.h"
 #include "../i_system.h"
 #include "../m_cheat.h"
+#include "../m_bench.h"
 #ifdef ESLOPE
 #include "../p_slopes.h"
 #endif
@@ -66,7 +68,7 @@ struct hwdriver_s hwdriver;
 static void HWR_AddSprites(sector_t *sec);
 static void HWR_ProjectSprite(mobj_t *thing);
 #ifdef HWPRECIP
-static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing);
+static void HWR_AddPrecipitationSprites(void);
 #endif
 
 #ifdef SORTING
@@ -85,6 +87,13 @@ static UINT32 atohex(const char *s);
 
 static void CV_filtermode_ONChange(void);
 static void CV_anisotropic_ONChange(void);
+static void CV_grtexturememory_OnChange(void);
+static void CV_grasyncupload_OnChange(void);
+static void CV_grshowstats_OnChange(void);
+static void CV_grscenebuffer_OnChange(void);
+static void CV_grshaders_OnChange(void);
+static void CV_grswapnowait_OnChange(void);
+static void CV_grindexedtextures_OnChange(void);
 static void CV_FogDensity_ONChange(void);
 static void CV_grFov_OnChange(void);
 // ==========================================================================
@@ -124,6 +133,32 @@ consvar_t cv_granisotropicmode = {"gr_anisotropicmode", "1", CV_CALL, granisotro
 //static consvar_t cv_grzbuffer = {"gr_zbuffer", "On", 0, CV_OnOff};
 consvar_t cv_grcorrecttricks = {"gr_correcttricks", "Off", 0, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_grsolvetjoin = {"gr_solvetjoin", "On", 0, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grplanecache = {"gr_planecache", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+// in megabytes, 0 for no limit
+static CV_PossibleValue_t grtexturememory_cons_t[] = {{0, "MIN"}, {4095, "MAX"}, {0, NULL}};
+consvar_t cv_grtexturememory = {"gr_texturememory", "0", CV_SAVE|CV_CALL, grtexturememory_cons_t,
+                             CV_grtexturememory_OnChange, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grasyncupload = {"gr_asyncupload", "On", CV_SAVE|CV_CALL, CV_OnOff,
+                             CV_grasyncupload_OnChange, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grprecache = {"gr_precache", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grshowstats = {"gr_showstats", "Off", CV_CALL, CV_OnOff, CV_grshowstats_OnChange, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grscenebuffer = {"gr_scenebuffer", "On", CV_SAVE|CV_CALL, CV_OnOff,
+                             CV_grscenebuffer_OnChange, 0, NULL, NULL, 0, 0, NULL};
+// fog done in a shader, so it doesn't break up the batches
+consvar_t cv_grshaders = {"gr_shaders", "On", CV_SAVE|CV_CALL, CV_OnOff,
+                             CV_grshaders_OnChange, 0, NULL, NULL, 0, 0, NULL};
+// with vidwait, drop a frame rather than wait for the last one to be shown
+consvar_t cv_grswapnowait = {"gr_swapnowait", "Off", CV_SAVE|CV_CALL, CV_OnOff,
+                             CV_grswapnowait_OnChange, 0, NULL, NULL, 0, 0, NULL};
+// palettized textures kept as indices and coloured in a shader, point sampled
+consvar_t cv_grindexedtextures = {"gr_indexedtextures", "Off", CV_SAVE|CV_CALL, CV_OnOff,
+                             CV_grindexedtextures_OnChange, 0, NULL, NULL, 0, 0, NULL};
+// in percent of the screen's width and height
+static CV_PossibleValue_t grrenderscale_cons_t[] = {{25, "MIN"}, {100, "MAX"}, {0, NULL}};
+consvar_t cv_grrenderscale = {"gr_renderscale", "100", CV_SAVE, grrenderscale_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_grdynamicres = {"gr_dynamicres", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+static CV_PossibleValue_t grdynamicresfps_cons_t[] = {{1, "MIN"}, {500, "MAX"}, {0, NULL}};
+consvar_t cv_grdynamicresfps = {"gr_dynamicres_fps", "35", CV_SAVE, grdynamicresfps_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
 static void CV_FogDensity_ONChange(void)
 {
@@ -140,6 +175,36 @@ static void CV_anisotropic_ONChange(void)
 	HWD.pfnSetSpecialState(HWD_SET_TEXTUREANISOTROPICMODE, cv_granisotropicmode.value);
 }
 
+static void CV_grtexturememory_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_TEXTUREBUDGET, cv_grtexturememory.value);
+}
+
+static void CV_grasyncupload_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_ASYNCUPLOADS, cv_grasyncupload.value);
+}
+
+static void CV_grscenebuffer_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_SCENEBUFFER, cv_grscenebuffer.value);
+}
+
+static void CV_grshaders_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_SHADERS, cv_grshaders.value);
+}
+
+static void CV_grswapnowait_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_SWAPNOWAIT, cv_grswapnowait.value);
+}
+
+static void CV_grindexedtextures_OnChange(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_INDEXEDTEXTURES, cv_grindexedtextures.value);
+}
+
 /*
  * lookuptable for lightvalues
  * calculated as follow:
@@ -518,6 +583,30 @@ static UINT8 HWR_FogBlockAlpha(INT32 light, UINT32 color) // Let's see if this c
 
 #ifdef DOPLANES
 
+// A floor or ceiling's vertexes only change when it moves, scrolls or turns,
+// so each subsector keeps the last ones its own floor and ceiling had.
+typedef struct planecache_s
+{
+	fixed_t fixedheight;
+	float scrollx, scrolly, flatsize;
+	angle_t angle;
+	FOutVector *verts;
+} planecache_t;
+
+static planecache_t *HWR_GetPlaneCache(extrasubsector_t *xsub, boolean isceiling, INT32 numverts)
+{
+	planecache_t *cache = xsub->planecache[isceiling];
+
+	if (!cache)
+	{
+		// Not owned: extrasubsectors are thrown away with the level anyway
+		cache = Z_Calloc(sizeof (*cache) + numverts * sizeof (FOutVector), PU_LEVEL, NULL);
+		cache->verts = (FOutVector *)(cache + 1);
+		xsub->planecache[isceiling] = cache;
+	}
+	return cache;
+}
+
 // -----------------+
 // HWR_RenderPlane  : Render a floor or ceiling convex polygon
 // -----------------+
@@ -537,11 +626,13 @@ static void HWR_RenderPlane(sector_t *sector, extrasubsector_t *xsub, boolean is
 	angle_t angle = 0;
 	FSurfaceInfo    Surf;
 	fixed_t tempxsow, tempytow;
+	planecache_t *cache = NULL;
+	FOutVector *planeVerts;
 #ifdef ESLOPE
 	pslope_t *slope = NULL;
 #endif
 
-	static FOutVector *planeVerts = NULL;
+	static FOutVector *tempVerts = NULL;
 	static UINT16 numAllocedPlaneVerts = 0;
 
 	(void)sector; ///@TODO remove shitty unused variable
@@ -586,12 +677,26 @@ static void HWR_RenderPlane(sector_t *sector, extrasubsector_t *xsub, boolean is
 		return;
 	}
 
+	// Sloped planes aren't kept, they can be moved without anything here knowing
+	if (!FOFsector
+#ifdef ESLOPE
+		&& !slope
+#endif
+		)
+		cache = HWR_GetPlaneCache(xsub, isceiling, nrPlaneVerts);
+
 	// Allocate plane-vertex buffer if we need to
-	if (!planeVerts || nrPlaneVerts > numAllocedPlaneVerts)
+	if (cache)
+		planeVerts = cache->verts;
+	else
 	{
-		numAllocedPlaneVerts = (UINT16)nrPlaneVerts;
-		Z_Free(planeVerts);
-		Z_Malloc(numAllocedPlaneVerts * sizeof (FOutVector), PU_LEVEL, &planeVerts);
+		if (!tempVerts || nrPlaneVerts > numAllocedPlaneVerts)
+		{
+			numAllocedPlaneVerts = (UINT16)nrPlaneVerts;
+			Z_Free(tempVerts);
+			Z_Malloc(numAllocedPlaneVerts * sizeof (FOutVector), PU_LEVEL, &tempVerts);
+		}
+		planeVerts = tempVerts;
 	}
 
 	len = W_LumpLength(lumpnum);
@@ -683,38 +788,51 @@ static void HWR_RenderPlane(sector_t *sector, extrasubsector_t *xsub, boolean is
 		flatyref = (FIXED_TO_FLOAT(FixedMul(tempxsow, FINESINE(angle)) + FixedMul(tempytow, FINECOSINE(angle))));
 	}
 
-	for (i = 0; i < nrPlaneVerts; i++,v3d++,pv++)
+	if (!cache || cache->fixedheight != fixedheight || cache->flatsize != fflatsize
+		|| cache->scrollx != scrollx || cache->scrolly != scrolly || cache->angle != angle)
 	{
-		// Hurdler: add scrolling texture on floor/ceiling
-		v3d->sow = (float)((pv->x / fflatsize) - flatxref + scrollx);
-		v3d->tow = (float)(flatyref - (pv->y / fflatsize) + scrolly);
+		for (i = 0; i < nrPlaneVerts; i++,v3d++,pv++)
+		{
+			// Hurdler: add scrolling texture on floor/ceiling
+			v3d->sow = (float)((pv->x / fflatsize) - flatxref + scrollx);
+			v3d->tow = (float)(flatyref - (pv->y / fflatsize) + scrolly);
 
-		//v3d->sow = (float)(pv->x / fflatsize);
-		//v3d->tow = (float)(pv->y / fflatsize);
+			//v3d->sow = (float)(pv->x / fflatsize);
+			//v3d->tow = (float)(pv->y / fflatsize);
 
-		// Need to rotate before translate
-		if (angle) // Only needs to be done if there's an altered angle
-		{
-			tempxsow = FLOAT_TO_FIXED(v3d->sow);
-			tempytow = FLOAT_TO_FIXED(v3d->tow);
-			v3d->sow = (FIXED_TO_FLOAT(FixedMul(tempxsow, FINECOSINE(angle)) - FixedMul(tempytow, FINESINE(angle))));
-			v3d->tow = (FIXED_TO_FLOAT(-FixedMul(tempxsow, FINESINE(angle)) - FixedMul(tempytow, FINECOSINE(angle))));
-		}
+			// Need to rotate before translate
+			if (angle) // Only needs to be done if there's an altered angle
+			{
+				tempxsow = FLOAT_TO_FIXED(v3d->sow);
+				tempytow = FLOAT_TO_FIXED(v3d->tow);
+				v3d->sow = (FIXED_TO_FLOAT(FixedMul(tempxsow, FINECOSINE(angle)) - FixedMul(tempytow, FINESINE(angle))));
+				v3d->tow = (FIXED_TO_FLOAT(-FixedMul(tempxsow, FINESINE(angle)) - FixedMul(tempytow, FINECOSINE(angle))));
+			}
 
-		//v3d->sow = (float)(v3d->sow - flatxref + scrollx);
-		//v3d->tow = (float)(flatyref - v3d->tow + scrolly);
+			//v3d->sow = (float)(v3d->sow - flatxref + scrollx);
+			//v3d->tow = (float)(flatyref - v3d->tow + scrolly);
 
-		v3d->x = pv->x;
-		v3d->y = height;
-		v3d->z = pv->y;
+			v3d->x = pv->x;
+			v3d->y = height;
+			v3d->z = pv->y;
 
 #ifdef ESLOPE
-		if (slope)
+			if (slope)
+			{
+				fixedheight = P_GetZAt(slope, FLOAT_TO_FIXED(pv->x), FLOAT_TO_FIXED(pv->y));
+				v3d->y = FIXED_TO_FLOAT(fixedheight);
+			}
+#endif
+		}
+
+		if (cache)
 		{
-			fixedheight = P_GetZAt(slope, FLOAT_TO_FIXED(pv->x), FLOAT_TO_FIXED(pv->y));
-			v3d->y = FIXED_TO_FLOAT(fixedheight);
+			cache->fixedheight = fixedheight;
+			cache->flatsize = fflatsize;
+			cache->scrollx = scrollx;
+			cache->scrolly = scrolly;
+			cache->angle = angle;
 		}
-#endif
 	}
 
 	// only useful for flat coloured triangles
@@ -789,6 +907,100 @@ static void HWR_RenderPlane(sector_t *sector, extrasubsector_t *xsub, boolean is
 #endif
 }
 
+// --------------------------------------------------------------------------
+// Opaque planes are drawn after the BSP walk instead of as it goes, sorted
+// by flat, so the driver can batch every plane with the same flat together.
+// --------------------------------------------------------------------------
+typedef struct
+{
+	sector_t *sector; // gr_frontsector, for the scrolling and slopes
+	extrasubsector_t *xsub;
+	boolean isceiling;
+	fixed_t fixedheight;
+	INT32 lightlevel;
+	lumpnum_t lumpnum;
+	sector_t *FOFsector;
+	extracolormap_t *planecolormap;
+} opaqueplane_t;
+
+#define OPAQUEPLANECHUNK 1024
+
+static opaqueplane_t *opaqueplanes = NULL;
+static size_t numopaqueplanes = 0;
+
+static void HWR_AddOpaquePlane(extrasubsector_t *xsub, boolean isceiling, fixed_t fixedheight,
+                               INT32 lightlevel, lumpnum_t lumpnum, sector_t *FOFsector, extracolormap_t *planecolormap)
+{
+	static size_t allocedplanes = 0;
+	opaqueplane_t *plane;
+
+	// R_FakeFlat's copy of the sector won't last until the planes are drawn
+	if (!FOFsector && (gr_frontsector < sectors || gr_frontsector >= sectors + numsectors))
+	{
+		HWR_GetFlat(lumpnum);
+		HWR_RenderPlane(NULL, xsub, isceiling, fixedheight, PF_Occlude, lightlevel, lumpnum, NULL, 255, false, planecolormap);
+		return;
+	}
+
+	// Force realloc if buffer has been freed
+	if (!opaqueplanes)
+		allocedplanes = 0;
+
+	if (allocedplanes < numopaqueplanes + 1)
+	{
+		allocedplanes += OPAQUEPLANECHUNK;
+		Z_Realloc(opaqueplanes, allocedplanes * sizeof (*opaqueplanes), PU_LEVEL, &opaqueplanes);
+	}
+
+	plane = &opaqueplanes[numopaqueplanes++];
+	plane->sector = gr_frontsector;
+	plane->xsub = xsub;
+	plane->isceiling = isceiling;
+	plane->fixedheight = fixedheight;
+	plane->lightlevel = lightlevel;
+	plane->lumpnum = lumpnum;
+	plane->FOFsector = FOFsector;
+	plane->planecolormap = planecolormap;
+}
+
+static int HWR_CompareOpaquePlanes(const void *p1, const void *p2)
+{
+	const opaqueplane_t *a = p1, *b = p2;
+
+	if (a->lumpnum != b->lumpnum)
+		return a->lumpnum < b->lumpnum ? -1 : 1;
+	return 0;
+}
+
+static void HWR_DrawOpaquePlanes(void)
+{
+	sector_t *savedsector = gr_frontsector;
+	lumpnum_t lastlump = LUMPERROR;
+	size_t i;
+
+	if (!numopaqueplanes)
+		return;
+
+	qsort(opaqueplanes, numopaqueplanes, sizeof (*opaqueplanes), HWR_CompareOpaquePlanes);
+
+	for (i = 0; i < numopaqueplanes; i++)
+	{
+		opaqueplane_t *plane = &opaqueplanes[i];
+
+		if (plane->lumpnum != lastlump)
+		{
+			HWR_GetFlat(plane->lumpnum);
+			lastlump = plane->lumpnum;
+		}
+		gr_frontsector = plane->sector;
+		HWR_RenderPlane(NULL, plane->xsub, plane->isceiling, plane->fixedheight, PF_Occlude,
+			plane->lightlevel, plane->lumpnum, plane->FOFsector, 255, false, plane->planecolormap);
+	}
+
+	gr_frontsector = savedsector;
+	numopaqueplanes = 0;
+}
+
 #ifdef POLYSKY
 // this don't draw anything it only update the z-buffer so there isn't problem with
 // wall/things upper that sky (map12)
@@ -3003,6 +3215,46 @@ clipsolid:
 #endif
 }
 
+#ifdef NEWCLIP
+// The sides of the view, for HWR_CheckBBox to throw out what's beyond
+// them before it works out any angles. Off when the view is too wide.
+static boolean frustumcull = false;
+static float frustumleftx, frustumlefty, frustumrightx, frustumrighty;
+
+// BSP nodes HWR_CheckBBox has thrown out, for gr_showstats
+static UINT32 nodesfrustumculled = 0, nodesclipped = 0;
+static UINT32 lastfrustumculled = 0, lastclipped = 0;
+
+// a1 is half the angle the clipper was opened to
+static void HWR_SetupFrustumCull(angle_t a1)
+{
+	frustumcull = (a1 < ANGLE_90);
+	if (!frustumcull)
+		return;
+
+	frustumleftx = FIXED_TO_FLOAT(FINECOSINE((viewangle + a1)>>ANGLETOFINESHIFT));
+	frustumlefty = FIXED_TO_FLOAT(FINESINE((viewangle + a1)>>ANGLETOFINESHIFT));
+	frustumrightx = FIXED_TO_FLOAT(FINECOSINE((viewangle - a1)>>ANGLETOFINESHIFT));
+	frustumrighty = FIXED_TO_FLOAT(FINESINE((viewangle - a1)>>ANGLETOFINESHIFT));
+}
+
+// Whether the box is all the way past one side of the view.
+// Only the corner furthest inside each side needs checking.
+static boolean HWR_BBoxOutsideFrustum(const fixed_t *bspcoord)
+{
+	const float left = (float)bspcoord[BOXLEFT] - (float)dup_viewx;
+	const float right = (float)bspcoord[BOXRIGHT] - (float)dup_viewx;
+	const float bottom = (float)bspcoord[BOXBOTTOM] - (float)dup_viewy;
+	const float top = (float)bspcoord[BOXTOP] - (float)dup_viewy;
+
+	if (frustumleftx*(frustumleftx > 0 ? bottom : top) - frustumlefty*(frustumlefty > 0 ? right : left) > 0)
+		return true;
+	if (frustumrightx*(frustumrightx > 0 ? top : bottom) - frustumrighty*(frustumrighty > 0 ? left : right) < 0)
+		return true;
+	return false;
+}
+#endif
+
 // HWR_CheckBBox
 // Checks BSP node/subtree bounding box.
 // Returns true
@@ -3039,6 +3291,14 @@ static boolean HWR_CheckBBox(fixed_t *bspcoord)
 	if (boxpos == 5)
 		return true;
 
+#ifdef NEWCLIP
+	if (frustumcull && HWR_BBoxOutsideFrustum(bspcoord))
+	{
+		nodesfrustumculled++;
+		return false;
+	}
+#endif
+
 	px1 = bspcoord[checkcoord[boxpos][0]];
 	py1 = bspcoord[checkcoord[boxpos][1]];
 	px2 = bspcoord[checkcoord[boxpos][2]];
@@ -3047,7 +3307,10 @@ static boolean HWR_CheckBBox(fixed_t *bspcoord)
 #ifdef NEWCLIP
 	angle1 = R_PointToAngle(px1, py1);
 	angle2 = R_PointToAngle(px2, py2);
-	return gld_clipper_SafeCheckRange(angle2, angle1);
+	if (gld_clipper_SafeCheckRange(angle2, angle1))
+		return true;
+	nodesclipped++;
+	return false;
 #else
 	// check clip list for an open space
 	angle1 = R_PointToAngle2(dup_viewx>>1, dup_viewy>>1, px1>>1, py1>>1) - dup_viewangle;
@@ -3487,10 +3750,10 @@ static void HWR_Subsector(size_t num)
 	{
 		if (gr_frontsector->moved)
 		{
-			gr_frontsector->numlights = sub->sector->numlights = 0;
 			R_Prep3DFloors(gr_frontsector);
 			sub->sector->lightlist = gr_frontsector->lightlist;
 			sub->sector->numlights = gr_frontsector->numlights;
+			sub->sector->maxlights = gr_frontsector->maxlights;
 			sub->sector->moved = gr_frontsector->moved = false;
 		}
 
@@ -3516,12 +3779,11 @@ static void HWR_Subsector(size_t num)
 		{
 			if (sub->validcount != validcount)
 			{
-				HWR_GetFlat(levelflats[gr_frontsector->floorpic].lumpnum);
-				HWR_RenderPlane(gr_frontsector, &extrasubsectors[num], false,
+				HWR_AddOpaquePlane(&extrasubsectors[num], false,
 					// Hack to make things continue to work around slopes.
 					locFloorHeight == cullFloorHeight ? locFloorHeight : gr_frontsector->floorheight,
 					// We now return you to your regularly scheduled rendering.
-					PF_Occlude, floorlightlevel, levelflats[gr_frontsector->floorpic].lumpnum, NULL, 255, false, floorcolormap);
+					floorlightlevel, levelflats[gr_frontsector->floorpic].lumpnum, NULL, floorcolormap);
 			}
 		}
 		else
@@ -3538,12 +3800,11 @@ static void HWR_Subsector(size_t num)
 		{
 			if (sub->validcount != validcount)
 			{
-				HWR_GetFlat(levelflats[gr_frontsector->ceilingpic].lumpnum);
-				HWR_RenderPlane(NULL, &extrasubsectors[num], true,
+				HWR_AddOpaquePlane(&extrasubsectors[num], true,
 					// Hack to make things continue to work around slopes.
 					locCeilingHeight == cullCeilingHeight ? locCeilingHeight : gr_frontsector->ceilingheight,
 					// We now return you to your regularly scheduled rendering.
-					PF_Occlude, ceilinglightlevel, levelflats[gr_frontsector->ceilingpic].lumpnum,NULL, 255, false, ceilingcolormap);
+					ceilinglightlevel, levelflats[gr_frontsector->ceilingpic].lumpnum, NULL, ceilingcolormap);
 			}
 		}
 		else
@@ -3631,10 +3892,9 @@ static void HWR_Subsector(size_t num)
 				}
 				else
 				{
-					HWR_GetFlat(levelflats[*rover->bottompic].lumpnum);
 					light = R_GetPlaneLight(gr_frontsector, centerHeight, dup_viewz < cullHeight ? true : false);
-					HWR_RenderPlane(NULL, &extrasubsectors[num], false, *rover->bottomheight, PF_Occlude, *gr_frontsector->lightlist[light].lightlevel, levelflats[*rover->bottompic].lumpnum,
-					                rover->master->frontsector, 255, false, gr_frontsector->lightlist[light].extra_colormap);
+					HWR_AddOpaquePlane(&extrasubsectors[num], false, *rover->bottomheight, *gr_frontsector->lightlist[light].lightlevel, levelflats[*rover->bottompic].lumpnum,
+					                   rover->master->frontsector, gr_frontsector->lightlist[light].extra_colormap);
 				}
 			}
 
@@ -3695,10 +3955,9 @@ static void HWR_Subsector(size_t num)
 				}
 				else
 				{
-					HWR_GetFlat(levelflats[*rover->toppic].lumpnum);
 					light = R_GetPlaneLight(gr_frontsector, centerHeight, dup_viewz < cullHeight ? true : false);
-					HWR_RenderPlane(NULL, &extrasubsectors[num], true, *rover->topheight, PF_Occlude, *gr_frontsector->lightlist[light].lightlevel, levelflats[*rover->toppic].lumpnum,
-					                  rover->master->frontsector, 255, false, gr_frontsector->lightlist[light].extra_colormap);
+					HWR_AddOpaquePlane(&extrasubsectors[num], true, *rover->topheight, *gr_frontsector->lightlist[light].lightlevel, levelflats[*rover->toppic].lumpnum,
+					                   rover->master->frontsector, gr_frontsector->lightlist[light].extra_colormap);
 				}
 			}
 		}
@@ -4249,11 +4508,11 @@ static void HWR_DrawSpriteShadow(gr_vissprite_t *spr, GLPatch_t *gpatch, float t
 // This is expecting a pointer to an array containing 4 wallVerts for a sprite
 static void HWR_RotateSpritePolyToAim(gr_vissprite_t *spr, FOutVector *wallVerts)
 {
-	if (cv_grspritebillboarding.value && spr && spr->mobj && wallVerts)
+	if (cv_grspritebillboarding.value && spr && (spr->mobj || spr->precip) && wallVerts)
 	{
-		float basey = FIXED_TO_FLOAT(spr->mobj->z);
+		float basey = FIXED_TO_FLOAT(spr->precip ? spr->precipdrop.z : spr->mobj->z);
 		float lowy = wallVerts[0].y;
-		if (P_MobjFlip(spr->mobj) == -1)
+		if (!spr->precip && P_MobjFlip(spr->mobj) == -1)
 		{
 			basey = FIXED_TO_FLOAT(spr->mobj->z + spr->mobj->height);
 		}
@@ -4801,12 +5060,7 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 	FOutVector wallVerts[4];
 	GLPatch_t *gpatch; // sprite patch converted to hardware
 	FSurfaceInfo Surf;
-
-	if (!spr->mobj)
-		return;
-
-	if (!spr->mobj->subsector)
-		return;
+	const precipdrop_t *drop = &spr->precipdrop;
 
 	// cache sprite graphics
 	gpatch = W_CachePatchNum(spr->patchlumpnum, PU_CACHE);
@@ -4843,7 +5097,7 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 
 	// colormap test
 	{
-		sector_t *sector = spr->mobj->subsector->sector;
+		sector_t *sector = drop->subsector->sector;
 		UINT8 lightlevel = 255;
 		extracolormap_t *colormap = sector->extra_colormap;
 
@@ -4851,9 +5105,9 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 		{
 			INT32 light;
 
-			light = R_GetPlaneLight(sector, spr->mobj->z + spr->mobj->height, false); // Always use the light at the top instead of whatever I was doing before
+			light = R_GetPlaneLight(sector, drop->z, false);
 
-			if (!(spr->mobj->frame & FF_FULLBRIGHT))
+			if (!(drop->frame & FF_FULLBRIGHT))
 				lightlevel = *sector->lightlist[light].lightlevel;
 
 			if (sector->lightlist[light].extra_colormap)
@@ -4861,7 +5115,7 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 		}
 		else
 		{
-			if (!(spr->mobj->frame & FF_FULLBRIGHT))
+			if (!(drop->frame & FF_FULLBRIGHT))
 				lightlevel = sector->lightlevel;
 
 			if (sector->extra_colormap)
@@ -4874,13 +5128,8 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 			Surf.FlatColor.rgba = HWR_Lighting(lightlevel, NORMALFOG, FADEFOG, false, false);
 	}
 
-	if (spr->mobj->flags2 & MF2_SHADOW)
-	{
-		Surf.FlatColor.s.alpha = 0x40;
-		blend = PF_Translucent;
-	}
-	else if (spr->mobj->frame & FF_TRANSMASK)
-		blend = HWR_TranstableToAlpha((spr->mobj->frame & FF_TRANSMASK)>>FF_TRANSSHIFT, &Surf);
+	if (drop->frame & FF_TRANSMASK)
+		blend = HWR_TranstableToAlpha((drop->frame & FF_TRANSMASK)>>FF_TRANSSHIFT, &Surf);
 	else
 	{
 		// BP: i agree that is little better in environement but it don't
@@ -4900,67 +5149,72 @@ static inline void HWR_DrawPrecipitationSprite(gr_vissprite_t *spr)
 // --------------------------------------------------------------------------
 static gr_vissprite_t gr_vsprsortedhead;
 
-static void HWR_SortVisSprites(void)
+// Farthest first. Sprites at the same distance are ordered by dispoffset,
+// smallest first, and otherwise keep the order they were made in.
+static inline boolean HWR_VisSpriteBefore(const gr_vissprite_t *a, const gr_vissprite_t *b)
 {
-	UINT32 i;
-	gr_vissprite_t *ds, *dsprev, *dsnext, *dsfirst;
-	gr_vissprite_t *best = NULL;
-	gr_vissprite_t unsorted;
-	float bestdist = 0.0f;
-	INT32 bestdispoffset = 0;
-
-	if (!gr_visspritecount)
-		return;
+	return a->tz > b->tz || (fabsf(a->tz - b->tz) < 1.0E-36f && a->dispoffset < b->dispoffset);
+}
 
-	dsfirst = HWR_GetVisSprite(0);
+// Stable merge sort of count sprites linked through next.
+// The sorted list ends in NULL; prev is left alone.
+static gr_vissprite_t *HWR_MergeSortVisSprites(gr_vissprite_t *list, UINT32 count)
+{
+	gr_vissprite_t *left, *right, *head = NULL, **tail = &head;
+	UINT32 i, half;
 
-	for (i = 0, dsnext = dsfirst, ds = NULL; i < gr_visspritecount; i++)
+	if (count < 2)
 	{
-		dsprev = ds;
-		ds = dsnext;
-		if (i < gr_visspritecount - 1) dsnext = HWR_GetVisSprite(i + 1);
-
-		ds->next = dsnext;
-		ds->prev = dsprev;
+		list->next = NULL;
+		return list;
 	}
 
-	// Fix first and last. ds still points to the last one after the loop
-	dsfirst->prev = &unsorted;
-	unsorted.next = dsfirst;
-	if (ds)
-		ds->next = &unsorted;
-	unsorted.prev = ds;
+	half = count/2;
+	for (i = 0, right = list; i < half; i++)
+		right = right->next;
 
-	// pull the vissprites out by scale
-	gr_vsprsortedhead.next = gr_vsprsortedhead.prev = &gr_vsprsortedhead;
-	for (i = 0; i < gr_visspritecount; i++)
+	left = HWR_MergeSortVisSprites(list, half);
+	right = HWR_MergeSortVisSprites(right, count - half);
+
+	while (left && right)
 	{
-		best = NULL;
-		for (ds = unsorted.next; ds != &unsorted; ds = ds->next)
+		if (HWR_VisSpriteBefore(right, left))
 		{
-			if (!best || ds->tz > bestdist)
-			{
-				bestdist = ds->tz;
-				bestdispoffset = ds->dispoffset;
-				best = ds;
-			}
-			// order visprites of same scale by dispoffset, smallest first
-			else if (fabsf(ds->tz - bestdist) < 1.0E-36f && ds->dispoffset < bestdispoffset)
-			{
-				bestdispoffset = ds->dispoffset;
-				best = ds;
-			}
+			*tail = right;
+			right = right->next;
 		}
-		if (best)
+		else
 		{
-			best->next->prev = best->prev;
-			best->prev->next = best->next;
-			best->next = &gr_vsprsortedhead;
-			best->prev = gr_vsprsortedhead.prev;
+			*tail = left;
+			left = left->next;
 		}
-		gr_vsprsortedhead.prev->next = best;
-		gr_vsprsortedhead.prev = best;
+		tail = &(*tail)->next;
 	}
+	*tail = left ? left : right;
+
+	return head;
+}
+
+static void HWR_SortVisSprites(void)
+{
+	UINT32 i;
+	gr_vissprite_t *ds, *dsprev, *best;
+
+	if (!gr_visspritecount)
+		return;
+
+	for (i = 0, ds = HWR_GetVisSprite(0); i < gr_visspritecount - 1; i++)
+		ds = ds->next = HWR_GetVisSprite(i + 1);
+	ds->next = NULL;
+
+	// Insertion order breaks ties, so this gives the same order the old
+	// selection sort did, in O(n log n).
+	ds = gr_vsprsortedhead.next = HWR_MergeSortVisSprites(HWR_GetVisSprite(0), gr_visspritecount);
+
+	for (dsprev = &gr_vsprsortedhead; ds; dsprev = ds, ds = ds->next)
+		ds->prev = dsprev;
+	dsprev->next = &gr_vsprsortedhead;
+	gr_vsprsortedhead.prev = dsprev;
 
 	// Sryder:	Oh boy, while it's nice having ALL the sprites sorted properly, it fails when we bring MD2's into the
 	//			mix and they want to be translucent. So let's place all the translucent sprites and MD2's AFTER
@@ -4970,7 +5224,8 @@ static void HWR_SortVisSprites(void)
 	best = gr_vsprsortedhead.next;
 	for (i = 0; i < gr_visspritecount; i++)
 	{
-		if ((best->mobj->flags2 & MF2_SHADOW) || (best->mobj->frame & FF_TRANSMASK))
+		if (best->precip ? (best->precipdrop.frame & FF_TRANSMASK)
+			: (best->mobj->flags2 & MF2_SHADOW) || (best->mobj->frame & FF_TRANSMASK))
 		{
 			if (best == gr_vsprsortedhead.next)
 			{
@@ -5365,9 +5620,6 @@ static UINT8 sectorlight;
 static void HWR_AddSprites(sector_t *sec)
 {
 	mobj_t *thing;
-#ifdef HWPRECIP
-	precipmobj_t *precipthing;
-#endif
 	fixed_t approx_dist, limit_dist;
 
 	// BSP is traversed by subsector.
@@ -5408,31 +5660,6 @@ static void HWR_AddSprites(sector_t *sec)
 				HWR_ProjectSprite(thing);
 	}
 
-#ifdef HWPRECIP
-	// Someone seriously wants infinite draw distance for precipitation?
-	if ((limit_dist = (fixed_t)cv_drawdist_precip.value << FRACBITS))
-	{
-		for (precipthing = sec->preciplist; precipthing; precipthing = precipthing->snext)
-		{
-			if (precipthing->precipflags & PCF_INVISIBLE)
-				continue;
-
-			approx_dist = P_AproxDistance(viewx-precipthing->x, viewy-precipthing->y);
-
-			if (approx_dist > limit_dist)
-				continue;
-
-			HWR_ProjectPrecipitationSprite(precipthing);
-		}
-	}
-	else
-	{
-		// Draw everything in sector, no checks
-		for (precipthing = sec->preciplist; precipthing; precipthing = precipthing->snext)
-			if (!(precipthing->precipflags & PCF_INVISIBLE))
-				HWR_ProjectPrecipitationSprite(precipthing);
-	}
-#endif
 }
 
 // --------------------------------------------------------------------------
@@ -5453,6 +5680,7 @@ static void HWR_ProjectSprite(mobj_t *thing)
 	spritedef_t *sprdef;
 	spriteframe_t *sprframe;
 	size_t lumpoff;
+	const sprcache_t *info;
 	unsigned rot;
 	UINT8 flip;
 	angle_t ang;
@@ -5527,6 +5755,7 @@ static void HWR_ProjectSprite(mobj_t *thing)
 		lumpoff = sprframe->lumpid[0];     //Fab: see note above
 		flip = sprframe->flip; // Will only be 0x00 or 0xFF
 	}
+	info = R_GetSpriteCache(lumpoff);
 
 	if (thing->skin && ((skin_t *)thing->skin)->flags & SF_HIRES)
 		this_scale = this_scale * FIXED_TO_FLOAT(((skin_t *)thing->skin)->highresscale);
@@ -5535,13 +5764,13 @@ static void HWR_ProjectSprite(mobj_t *thing)
 	rightcos = FIXED_TO_FLOAT(FINECOSINE((viewangle + ANGLE_90)>>ANGLETOFINESHIFT));
 	if (flip)
 	{
-		x1 = (FIXED_TO_FLOAT(spritecachedinfo[lumpoff].width - spritecachedinfo[lumpoff].offset) * this_scale);
-		x2 = (FIXED_TO_FLOAT(spritecachedinfo[lumpoff].offset) * this_scale);
+		x1 = (FIXED_TO_FLOAT(info->width - info->offset) * this_scale);
+		x2 = (FIXED_TO_FLOAT(info->offset) * this_scale);
 	}
 	else
 	{
-		x1 = (FIXED_TO_FLOAT(spritecachedinfo[lumpoff].offset) * this_scale);
-		x2 = (FIXED_TO_FLOAT(spritecachedinfo[lumpoff].width - spritecachedinfo[lumpoff].offset) * this_scale);
+		x1 = (FIXED_TO_FLOAT(info->offset) * this_scale);
+		x2 = (FIXED_TO_FLOAT(info->width - info->offset) * this_scale);
 	}
 
 	z1 = tr_y + x1 * rightsin;
@@ -5551,13 +5780,13 @@ static void HWR_ProjectSprite(mobj_t *thing)
 
 	if (thing->eflags & MFE_VERTICALFLIP)
 	{
-		gz = FIXED_TO_FLOAT(thing->z+thing->height) - FIXED_TO_FLOAT(spritecachedinfo[lumpoff].topoffset) * this_scale;
-		gzt = gz + FIXED_TO_FLOAT(spritecachedinfo[lumpoff].height) * this_scale;
+		gz = FIXED_TO_FLOAT(thing->z+thing->height) - FIXED_TO_FLOAT(info->topoffset) * this_scale;
+		gzt = gz + FIXED_TO_FLOAT(info->height) * this_scale;
 	}
 	else
 	{
-		gzt = FIXED_TO_FLOAT(thing->z) + FIXED_TO_FLOAT(spritecachedinfo[lumpoff].topoffset) * this_scale;
-		gz = gzt - FIXED_TO_FLOAT(spritecachedinfo[lumpoff].height) * this_scale;
+		gzt = FIXED_TO_FLOAT(thing->z) + FIXED_TO_FLOAT(info->topoffset) * this_scale;
+		gz = gzt - FIXED_TO_FLOAT(info->height) * this_scale;
 	}
 
 	if (thing->subsector->sector->cullheight)
@@ -5636,7 +5865,7 @@ static void HWR_ProjectSprite(mobj_t *thing)
 
 #ifdef HWPRECIP
 // Precipitation projector for hardware mode
-static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing)
+static void HWR_ProjectPrecipitationSprite(const precipdrop_t *thing)
 {
 	gr_vissprite_t *vis;
 	float tr_x, tr_y;
@@ -5647,9 +5876,14 @@ static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing)
 	spritedef_t *sprdef;
 	spriteframe_t *sprframe;
 	size_t lumpoff;
+	const sprcache_t *info;
 	unsigned rot = 0;
 	UINT8 flip;
 
+	// only in sectors the BSP went through
+	if (thing->subsector->sector->validcount != validcount)
+		return;
+
 	// transform the origin point
 	tr_x = FIXED_TO_FLOAT(thing->x) - gr_viewx;
 	tr_y = FIXED_TO_FLOAT(thing->y) - gr_viewy;
@@ -5687,19 +5921,20 @@ static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing)
 
 	// use single rotation for all views
 	lumpoff = sprframe->lumpid[0];
+	info = R_GetSpriteCache(lumpoff);
 	flip = sprframe->flip; // Will only be 0x00 or 0xFF
 
 	rightsin = FIXED_TO_FLOAT(FINESINE((viewangle + ANGLE_90)>>ANGLETOFINESHIFT));
 	rightcos = FIXED_TO_FLOAT(FINECOSINE((viewangle + ANGLE_90)>>ANGLETOFINESHIFT));
 	if (flip)
 	{
-		x1 = FIXED_TO_FLOAT(spritecachedinfo[lumpoff].width - spritecachedinfo[lumpoff].offset);
-		x2 = FIXED_TO_FLOAT(spritecachedinfo[lumpoff].offset);
+		x1 = FIXED_TO_FLOAT(info->width - info->offset);
+		x2 = FIXED_TO_FLOAT(info->offset);
 	}
 	else
 	{
-		x1 = FIXED_TO_FLOAT(spritecachedinfo[lumpoff].offset);
-		x2 = FIXED_TO_FLOAT(spritecachedinfo[lumpoff].width - spritecachedinfo[lumpoff].offset);
+		x1 = FIXED_TO_FLOAT(info->offset);
+		x2 = FIXED_TO_FLOAT(info->width - info->offset);
 	}
 
 	z1 = tr_y + x1 * rightsin;
@@ -5707,16 +5942,6 @@ static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing)
 	x1 = tr_x + x1 * rightcos;
 	x2 = tr_x - x2 * rightcos;
 
-	// okay, we can't return now... this is a hack, but weather isn't networked, so it should be ok
-	if (!(thing->precipflags & PCF_THUNK))
-	{
-		if (thing->precipflags & PCF_RAIN)
-			P_RainThinker(thing);
-		else
-			P_SnowThinker(thing);
-		thing->precipflags |= PCF_THUNK;
-	}
-
 	//
 	// store information in a vissprite
 	//
@@ -5729,14 +5954,25 @@ static void HWR_ProjectPrecipitationSprite(precipmobj_t *thing)
 	vis->dispoffset = 0; // Monster Iestyn: 23/11/15: HARDWARE SUPPORT AT LAST
 	vis->patchlumpnum = sprframe->lumppat[rot];
 	vis->flip = flip;
-	vis->mobj = (mobj_t *)thing;
+	vis->mobj = NULL;
 
 	vis->colormap = colormaps;
 
 	// set top/bottom coords
-	vis->ty = FIXED_TO_FLOAT(thing->z + spritecachedinfo[lumpoff].topoffset);
+	vis->ty = FIXED_TO_FLOAT(thing->z + info->topoffset);
 
 	vis->precip = true;
+	vis->precipdrop = *thing;
+}
+
+// --------------------------------------------------------------------------
+// HWR_AddPrecipitationSprites
+// After BSP traversal, adds the weather in the sectors it went through.
+// --------------------------------------------------------------------------
+static void HWR_AddPrecipitationSprites(void)
+{
+	// Someone seriously wants infinite draw distance for precipitation?
+	P_IteratePrecipitation(viewx, viewy, (fixed_t)cv_drawdist_precip.value << FRACBITS, HWR_ProjectPrecipitationSprite);
 }
 #endif
 
@@ -5988,6 +6224,7 @@ if (0)
 		angle_t a1 = gld_FrustumAngle();
 		gld_clipper_Clear();
 		gld_clipper_SafeAddClipRange(viewangle + a1, viewangle - a1);
+		HWR_SetupFrustumCull(a1);
 #ifdef HAVE_SPHEREFRUSTRUM
 		gld_FrustrumSetup();
 #endif
@@ -6033,10 +6270,20 @@ if (0)
 	}
 #endif
 
+#ifdef HWPRECIP
+	HWR_AddPrecipitationSprites();
+#endif
+
+#ifdef DOPLANES
+	HWR_DrawOpaquePlanes();
+#endif
+
 	// Check for new console commands.
 	NetUpdate();
 
 #ifdef ALAM_LIGHTING
+	HWR_DrawDynamicLights();
+
 	//14/11/99: Hurdler: moved here because it doesn't work with
 	// subsector, see other comments;
 	HWR_ResetLights();
@@ -6071,6 +6318,10 @@ if (0)
 	}
 #endif
 
+#ifdef ALAM_LIGHTING
+	HWR_DrawDynamicLights(); // on the translucent walls and planes
+#endif
+
 	HWD.pfnSetTransform(NULL);
 
 	// put it off for menus etc
@@ -6085,6 +6336,25 @@ if (0)
 	HWD.pfnGClipRect(0, 0, vid.width, vid.height, NZCLIP_PLANE);
 }
 
+// The benchrender stage each section's CPU time goes to
+static const benchstage_t renderbenchstages[NUMRENDERSECTIONS] = {
+	BR_OTHER,
+	BR_SKY,
+	BR_BSP,          // RS_WALLS
+	BR_PLANES,
+	BR_MASKED,       // RS_SPRITES
+	BR_TRANSLUCENT,
+	BR_HUD
+};
+
+// What's drawn from now on counts towards this section's time in gr_showstats
+static inline void HWR_MarkRenderSection(INT32 section)
+{
+	if (HWD.pfnMarkRenderSection)
+		HWD.pfnMarkRenderSection(section);
+	BENCH_STAGE(renderbenchstages[section]);
+}
+
 // ==========================================================================
 //
 // ==========================================================================
@@ -6111,7 +6381,10 @@ void HWR_RenderPlayerView(INT32 viewnumber, player_t *player)
 		HWD.pfnClearBuffer(true, false, &ClearColor); // Clear the Color Buffer, stops HOMs. Also seems to fix the skybox issue on Intel GPUs.
 
 	if (skybox && drawsky) // If there's a skybox and we should be drawing the sky, draw the skybox
+	{
+		HWR_MarkRenderSection(RS_SKY);
 		HWR_RenderSkyboxView(viewnumber, player); // This is drawn before everything else so it is placed behind
+	}
 
 	{
 		// do we really need to save player (is it not the same)?
@@ -6189,7 +6462,10 @@ if (0)
 }
 
 	if (!skybox && drawsky) // Don't draw the regular sky if there's a skybox
+	{
+		HWR_MarkRenderSection(RS_SKY);
 		HWR_DrawSkyBackground();
+	}
 
 	//Hurdler: it doesn't work in splitscreen mode
 	drawsky = splitscreen;
@@ -6205,6 +6481,7 @@ if (0)
 		angle_t a1 = gld_FrustumAngle();
 		gld_clipper_Clear();
 		gld_clipper_SafeAddClipRange(viewangle + a1, viewangle - a1);
+		HWR_SetupFrustumCull(a1);
 #ifdef HAVE_SPHEREFRUSTRUM
 		gld_FrustrumSetup();
 #endif
@@ -6219,6 +6496,7 @@ if (0)
 
 	validcount++;
 
+	HWR_MarkRenderSection(RS_WALLS);
 	HWR_RenderBSPNode((INT32)numnodes-1);
 
 #ifndef NEWCLIP
@@ -6250,16 +6528,28 @@ if (0)
 	}
 #endif
 
+#ifdef HWPRECIP
+	HWR_AddPrecipitationSprites();
+#endif
+
+#ifdef DOPLANES
+	HWR_MarkRenderSection(RS_PLANES);
+	HWR_DrawOpaquePlanes();
+#endif
+
 	// Check for new console commands.
 	NetUpdate();
 
 #ifdef ALAM_LIGHTING
+	HWR_DrawDynamicLights();
+
 	//14/11/99: Hurdler: moved here because it doesn't work with
 	// subsector, see other comments;
 	HWR_ResetLights();
 #endif
 
 	// Draw MD2 and sprites
+	HWR_MarkRenderSection(RS_SPRITES);
 #ifdef SORTING
 	HWR_SortVisSprites();
 #endif
@@ -6272,6 +6562,7 @@ if (0)
 	HWR_DrawCoronas();
 #endif
 
+	HWR_MarkRenderSection(RS_TRANSLUCENT);
 #ifdef SORTING
 	if (numplanes || numpolyplanes || numwalls) //Hurdler: render 3D water and transparent walls after everything
 	{
@@ -6288,6 +6579,10 @@ if (0)
 	}
 #endif
 
+#ifdef ALAM_LIGHTING
+	HWR_DrawDynamicLights(); // on the translucent walls and planes
+#endif
+
 	HWD.pfnSetTransform(NULL);
 
 	// put it off for menus etc
@@ -6302,6 +6597,8 @@ if (0)
 	// added by Hurdler for correct splitscreen
 	// moved here by hurdler so it works with the new near clipping plane
 	HWD.pfnGClipRect(0, 0, vid.width, vid.height, NZCLIP_PLANE);
+
+	HWR_MarkRenderSection(RS_HUD); // whatever's drawn after the view
 }
 
 // ==========================================================================
@@ -6358,13 +6655,224 @@ static void CV_grFov_OnChange(void)
 		CV_Set(&cv_grfov, cv_grfov.defaultvalue);
 }
 
+// --------------------------------------------------------------------------
+// Render statistics: gr_showstats draws what the last frame sent to the card
+// and how long the card took over each part of it, "gr_stats record" logs
+// the same for every frame as CSV
+// --------------------------------------------------------------------------
+static const char *rendersectionnames[NUMRENDERSECTIONS] = {"other", "sky", "walls", "planes", "sprites", "translucent", "HUD"};
+static FILE *statslog = NULL;
+static UINT32 statslogframes = 0;
+
+static void HWR_SetGPUTimers(void)
+{
+	HWD.pfnSetSpecialState(HWD_SET_GPUTIMERS, cv_grshowstats.value || statslog);
+}
+
+static void CV_grshowstats_OnChange(void)
+{
+	HWR_SetGPUTimers();
+}
+
+static void HWR_DrawRenderStats(const FRenderStats *stats)
+{
+	INT32 i, y = 0;
+	UINT32 total = 0;
+
+	V_DrawRightAlignedString(BASEVIDWIDTH, y, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u draws", stats->drawcalls));
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u binds", stats->texturebinds));
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u states", stats->statechanges));
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u verts", stats->vertices));
+#ifdef NEWCLIP
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u nodes off view", lastfrustumculled));
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE, va("%u nodes hidden", lastclipped));
+#endif
+
+	if (!stats->gputimers)
+		return;
+
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 12, V_SNAPTOTOP|V_SNAPTORIGHT|V_YELLOWMAP, "GPU MS");
+	for (i = 0; i < NUMRENDERSECTIONS; i++)
+	{
+		V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE,
+			va("%s %u.%02u", rendersectionnames[i], stats->gputime[i]/1000, (stats->gputime[i]%1000)/10));
+		total += stats->gputime[i];
+	}
+	V_DrawRightAlignedString(BASEVIDWIDTH, y += 8, V_SNAPTOTOP|V_SNAPTORIGHT|V_ALLOWLOWERCASE|V_YELLOWMAP,
+		va("total %u.%02u", total/1000, (total%1000)/10));
+}
+
+static void HWR_LogRenderStats(const FRenderStats *stats)
+{
+	INT32 i;
+
+	fprintf(statslog, "%u,%u,%u,%u,%u", statslogframes++, stats->drawcalls, stats->texturebinds, stats->statechanges, stats->vertices);
+	for (i = 0; i < NUMRENDERSECTIONS; i++)
+	{
+		if (stats->gputimers)
+			fprintf(statslog, ",%u", stats->gputime[i]);
+		else
+			fputc(',', statslog);
+	}
+	fputc('\n', statslog);
+}
+
+// Draws the overlay and logs the frame, if either's wanted
+void HWR_UpdateRenderStats(void)
+{
+	FRenderStats stats;
+
+#ifdef NEWCLIP
+	lastfrustumculled = nodesfrustumculled;
+	lastclipped = nodesclipped;
+	nodesfrustumculled = nodesclipped = 0;
+#endif
+
+	if (!HWD.pfnGetRenderStats || !(cv_grshowstats.value || statslog))
+		return;
+
+	HWD.pfnGetRenderStats(&stats);
+	if (statslog)
+		HWR_LogRenderStats(&stats);
+	if (cv_grshowstats.value)
+		HWR_DrawRenderStats(&stats);
+}
+
+// --------------------------------------------------------------------------
+// Dynamic resolution: with gr_dynamicres the scene is drawn smaller when
+// frames take longer than gr_dynamicres_fps allows, and bigger again once
+// there's time to spare. gr_renderscale is the most it goes up to.
+// --------------------------------------------------------------------------
+#define MINDYNAMICSCALE 50 // percent
+#define DYNAMICSCALESTEP 5
+#define DYNAMICSCALEFRAMES 16 // frames between changes, so the average can catch up
+
+static INT32 dynamicscale = 100;
+static INT32 lastrenderscale = 100;
+static INT32 framessincescale = 0;
+static UINT32 avgframetime = 0;
+
+// frametime is how long the frame took to draw and show, in microseconds
+void HWR_UpdateRenderScale(UINT32 frametime)
+{
+	INT32 scale = cv_grrenderscale.value;
+
+	if (cv_grdynamicres.value)
+	{
+		const UINT32 budget = 1000000/cv_grdynamicresfps.value;
+
+		// Averaged over about eight frames, one slow frame is not enough
+		avgframetime = avgframetime - avgframetime/8 + frametime/8;
+		if (++framessincescale >= DYNAMICSCALEFRAMES)
+		{
+			if (avgframetime > budget && dynamicscale > MINDYNAMICSCALE)
+			{
+				dynamicscale -= DYNAMICSCALESTEP;
+				framessincescale = 0;
+			}
+			else if (avgframetime < budget - budget/5 && dynamicscale < 100)
+			{
+				dynamicscale += DYNAMICSCALESTEP;
+				framessincescale = 0;
+			}
+		}
+		scale = min(scale, dynamicscale);
+	}
+	else
+		dynamicscale = 100;
+
+	if (scale != lastrenderscale)
+	{
+		HWD.pfnSetSpecialState(HWD_SET_RENDERSCALE, scale);
+		lastrenderscale = scale;
+	}
+}
+
+static void HWR_StartStatsLog(const char *filename)
+{
+	const char *path = va(pandf, srb2home, filename);
+	FRenderStats stats;
+	INT32 i;
+
+	if (statslog)
+		fclose(statslog);
+	statslog = fopen(path, "w");
+	if (!statslog)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't open %s for writing\n"), path);
+		return;
+	}
+
+	HWD.pfnGetRenderStats(&stats);
+	fprintf(statslog, "# %s, %dx%d\n", stats.renderer ? stats.renderer : "unknown renderer", vid.width, vid.height);
+	fprintf(statslog, "frame,drawcalls,texturebinds,statechanges,vertices");
+	for (i = 0; i < NUMRENDERSECTIONS; i++)
+		fprintf(statslog, ",%s_us", rendersectionnames[i]);
+	fputc('\n', statslog);
+
+	statslogframes = 0;
+	HWR_SetGPUTimers();
+	CONS_Printf(M_GetText("Recording render statistics to %s\n"), path);
+}
+
+static void HWR_StopStatsLog(void)
+{
+	if (!statslog)
+		return;
+	fclose(statslog);
+	statslog = NULL;
+	HWR_SetGPUTimers();
+	CONS_Printf(M_GetText("Recorded render statistics for %u frames\n"), statslogframes);
+}
+
 static void Command_GrStats_f(void)
 {
+	if (COM_Argc() > 1)
+	{
+		if (!stricmp(COM_Argv(1), "record") && COM_Argc() > 2 && HWD.pfnGetRenderStats)
+			HWR_StartStatsLog(COM_Argv(2));
+		else if (!stricmp(COM_Argv(1), "stop"))
+			HWR_StopStatsLog();
+		else
+			CONS_Printf(M_GetText("gr_stats [record <file>|stop]: Show memory use, or log render statistics for every frame\n"));
+		return;
+	}
+
 	Z_CheckHeap(9875); // debug
 
 	CONS_Printf(M_GetText("Patch info headers: %7s kb\n"), sizeu1(Z_TagUsage(PU_HWRPATCHINFO)>>10));
 	CONS_Printf(M_GetText("3D Texture cache  : %7s kb\n"), sizeu1(Z_TagUsage(PU_HWRCACHE)>>10));
 	CONS_Printf(M_GetText("Plane polygon     : %7s kb\n"), sizeu1(Z_TagUsage(PU_HWRPLANE)>>10));
+
+	if (HWD.pfnGetTextureStats)
+	{
+		static const char *categorynames[NUMTEXTURECATEGORIES] = {"other", "walls", "flats", "sprites", "HUD", "models"};
+		UINT32 resident[NUMTEXTURECATEGORIES], evictions, total = 0;
+		INT32 i;
+
+		HWD.pfnGetTextureStats(resident, &evictions);
+		for (i = 0; i < NUMTEXTURECATEGORIES; i++)
+		{
+			CONS_Printf(M_GetText("Video memory, %-7s: %7u kb\n"), categorynames[i], resident[i]>>10);
+			total += resident[i];
+		}
+		if (cv_grtexturememory.value)
+			CONS_Printf(M_GetText("Video memory, total  : %7u kb of %d MB, %u evicted\n"), total>>10, cv_grtexturememory.value, evictions);
+		else
+			CONS_Printf(M_GetText("Video memory, total  : %7u kb\n"), total>>10);
+	}
+
+	if (HWD.pfnGetRenderStats)
+	{
+		FRenderStats stats;
+
+		HWD.pfnGetRenderStats(&stats);
+		CONS_Printf(M_GetText("Last frame        : %u draws, %u binds, %u state changes, %u vertices\n"),
+			stats.drawcalls, stats.texturebinds, stats.statechanges, stats.vertices);
+#ifdef NEWCLIP
+		CONS_Printf(M_GetText("BSP nodes culled  : %u off the view, %u hidden\n"), lastfrustumculled, lastclipped);
+#endif
+	}
 }
 
 
@@ -6383,8 +6891,20 @@ void HWR_AddCommands(void)
 	CV_RegisterVar(&cv_grfogdensity);
 	CV_RegisterVar(&cv_grfiltermode);
 	CV_RegisterVar(&cv_granisotropicmode);
+	CV_RegisterVar(&cv_grtexturememory);
+	CV_RegisterVar(&cv_grasyncupload);
+	CV_RegisterVar(&cv_grprecache);
+	CV_RegisterVar(&cv_grshowstats);
+	CV_RegisterVar(&cv_grscenebuffer);
+	CV_RegisterVar(&cv_grshaders);
+	CV_RegisterVar(&cv_grswapnowait);
+	CV_RegisterVar(&cv_grindexedtextures);
+	CV_RegisterVar(&cv_grrenderscale);
+	CV_RegisterVar(&cv_grdynamicres);
+	CV_RegisterVar(&cv_grdynamicresfps);
 	CV_RegisterVar(&cv_grcorrecttricks);
 	CV_RegisterVar(&cv_grsolvetjoin);
+	CV_RegisterVar(&cv_grplanecache);
 }
 
 static inline void HWR_AddEngineCommands(void)
@@ -6457,6 +6977,7 @@ void HWR_Shutdown(void)
 	HWR_FreePolyPool();
 	HWR_FreeTextureCache();
 	HWD.pfnFlushScreenTextures();
+	HWR_StopStatsLog();
 }
 
 void transform(float *cx, float *cy, float *cz)
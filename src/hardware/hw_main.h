@@ -48,11 +48,13 @@ void HWR_MakePatch (const patch_t *patch, GLPatch_t *grPatch, GLMipmap_t *grMipm
 void HWR_CreatePlanePolygons(INT32 bspnum);
 void HWR_CreateStaticLightmaps(INT32 bspnum);
 void HWR_PrepLevelCache(size_t pnumtextures);
+void HWR_PrecacheLevel(void);
 void HWR_DrawFill(INT32 x, INT32 y, INT32 w, INT32 h, INT32 color);
 void HWR_DrawConsoleFill(INT32 x, INT32 y, INT32 w, INT32 h, UINT32 color, INT32 options);	// Lat: separate flags from color since color needs to be an uint to work right.
 void HWR_DrawPic(INT32 x,INT32 y,lumpnum_t lumpnum);
 
-UINT8 *HWR_GetScreenshot(void);
+boolean HWR_ReadScreenAsync(UINT8 *buf, UINT32 tag, UINT32 *buftag);
+boolean HWR_CollectScreenAsync(UINT8 *buf, UINT32 *buftag);
 boolean HWR_Screenshot(const char *pathname);
 
 void HWR_AddCommands(void);
@@ -68,6 +70,8 @@ void HWR_DrawIntermissionBG(void);
 void HWR_DoWipe(UINT8 wipenum, UINT8 scrnnum);
 void HWR_MakeScreenFinalTexture(void);
 void HWR_DrawScreenFinalTexture(int width, int height);
+void HWR_UpdateRenderStats(void);
+void HWR_UpdateRenderScale(UINT32 frametime);
 
 // This stuff is put here so MD2's can use them
 UINT32 HWR_Lighting(INT32 light, UINT32 color, UINT32 fadecolor, boolean fogblockpoly, boolean plane);
@@ -96,6 +100,17 @@ extern consvar_t cv_grcorrecttricks;
 extern consvar_t cv_voodoocompatibility;
 extern consvar_t cv_grfovchange;
 extern consvar_t cv_grsolvetjoin;
+extern consvar_t cv_grplanecache;
+extern consvar_t cv_grtexturememory;
+extern consvar_t cv_grasyncupload;
+extern consvar_t cv_grindexedtextures;
+extern consvar_t cv_grprecache;
+extern consvar_t cv_grshowstats;
+extern consvar_t cv_grscenebuffer;
+extern consvar_t cv_grshaders, cv_grswapnowait;
+extern consvar_t cv_grrenderscale;
+extern consvar_t cv_grdynamicres;
+extern consvar_t cv_grdynamicresfps;
 extern consvar_t cv_grspritebillboarding;
 
 extern float gr_viewwidth, gr_viewheight, gr_baseviewwindowy;
@@ -710,6 +710,7 @@ static void md2_loadTexture(md2_t *model)
 
 		grpatch->mipmap.downloaded = 0;
 		grpatch->mipmap.flags = 0;
+		grpatch->mipmap.category = TC_MODEL;
 
 		grpatch->width = (INT16)w;
 		grpatch->height = (INT16)h;
@@ -761,6 +762,7 @@ static void md2_loadBlendTexture(md2_t *model)
 
 		grpatch->mipmap.downloaded = 0;
 		grpatch->mipmap.flags = 0;
+		grpatch->mipmap.category = TC_MODEL;
 
 		grpatch->width = (INT16)w;
 		grpatch->height = (INT16)h;
@@ -952,162 +954,128 @@ spritemd2found:
 	fclose(f);
 }
 
-static void HWR_CreateBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch, GLMipmap_t *grmip, skincolors_t color)
+// The colour a skin colour's blend mask is tinted with
+static RGBA_t HWR_SkinBlendColor(skincolors_t color)
 {
-	UINT16 w = gpatch->width, h = gpatch->height;
-	UINT32 size = w*h;
-	RGBA_t *image, *blendimage, *cur, blendcolor;
-
-	if (grmip->width == 0)
-	{
-
-		grmip->width = gpatch->width;
-		grmip->height = gpatch->height;
-
-		// no wrap around, no chroma key
-		grmip->flags = 0;
-		// setup the texture info
-		grmip->grInfo.format = GR_RGBA;
-	}
-
-	Z_Free(grmip->grInfo.data);
-	grmip->grInfo.data = NULL;
-
-	cur = Z_Malloc(size*4, PU_HWRCACHE, &grmip->grInfo.data);
-	memset(cur, 0x00, size*4);
-
-	image = gpatch->mipmap.grInfo.data;
-	blendimage = blendgpatch->mipmap.grInfo.data;
-
 	switch (color)
 	{
 		case SKINCOLOR_WHITE:
-			blendcolor = V_GetColor(3);
-			break;
+			return V_GetColor(3);
 		case SKINCOLOR_SILVER:
-			blendcolor = V_GetColor(10);
-			break;
+			return V_GetColor(10);
 		case SKINCOLOR_GREY:
-			blendcolor = V_GetColor(15);
-			break;
+			return V_GetColor(15);
 		case SKINCOLOR_BLACK:
-			blendcolor = V_GetColor(27);
-			break;
+			return V_GetColor(27);
 		case SKINCOLOR_CYAN:
-			blendcolor = V_GetColor(215);
-			break;
+			return V_GetColor(215);
 		case SKINCOLOR_TEAL:
-			blendcolor = V_GetColor(221);
-			break;
+			return V_GetColor(221);
 		case SKINCOLOR_STEELBLUE:
-			blendcolor = V_GetColor(203);
-			break;
+			return V_GetColor(203);
 		case SKINCOLOR_BLUE:
-			blendcolor = V_GetColor(232);
-			break;
+			return V_GetColor(232);
 		case SKINCOLOR_PEACH:
-			blendcolor = V_GetColor(71);
-			break;
+			return V_GetColor(71);
 		case SKINCOLOR_TAN:
-			blendcolor = V_GetColor(79);
-			break;
+			return V_GetColor(79);
 		case SKINCOLOR_PINK:
-			blendcolor = V_GetColor(147);
-			break;
+			return V_GetColor(147);
 		case SKINCOLOR_LAVENDER:
-			blendcolor = V_GetColor(251);
-			break;
+			return V_GetColor(251);
 		case SKINCOLOR_PURPLE:
-			blendcolor = V_GetColor(195);
-			break;
+			return V_GetColor(195);
 		case SKINCOLOR_ORANGE:
-			blendcolor = V_GetColor(87);
-			break;
+			return V_GetColor(87);
 		case SKINCOLOR_ROSEWOOD:
-			blendcolor = V_GetColor(94);
-			break;
+			return V_GetColor(94);
 		case SKINCOLOR_BEIGE:
-			blendcolor = V_GetColor(40);
-			break;
+			return V_GetColor(40);
 		case SKINCOLOR_BROWN:
-			blendcolor = V_GetColor(57);
-			break;
+			return V_GetColor(57);
 		case SKINCOLOR_RED:
-			blendcolor = V_GetColor(130);
-			break;
+			return V_GetColor(130);
 		case SKINCOLOR_DARKRED:
-			blendcolor = V_GetColor(139);
-			break;
+			return V_GetColor(139);
 		case SKINCOLOR_NEONGREEN:
-			blendcolor = V_GetColor(184);
-			break;
+			return V_GetColor(184);
 		case SKINCOLOR_GREEN:
-			blendcolor = V_GetColor(166);
-			break;
+			return V_GetColor(166);
 		case SKINCOLOR_ZIM:
-			blendcolor = V_GetColor(180);
-			break;
+			return V_GetColor(180);
 		case SKINCOLOR_OLIVE:
-			blendcolor = V_GetColor(108);
-			break;
+			return V_GetColor(108);
 		case SKINCOLOR_YELLOW:
-			blendcolor = V_GetColor(104);
-			break;
+			return V_GetColor(104);
 		case SKINCOLOR_GOLD:
-			blendcolor = V_GetColor(115);
-			break;
+			return V_GetColor(115);
 
 		case SKINCOLOR_SUPER1:
-			blendcolor = V_GetColor(97);
-			break;
+			return V_GetColor(97);
 		case SKINCOLOR_SUPER2:
-			blendcolor = V_GetColor(100);
-			break;
+			return V_GetColor(100);
 		case SKINCOLOR_SUPER3:
-			blendcolor = V_GetColor(103);
-			break;
+			return V_GetColor(103);
 		case SKINCOLOR_SUPER4:
-			blendcolor = V_GetColor(113);
-			break;
+			return V_GetColor(113);
 		case SKINCOLOR_SUPER5:
-			blendcolor = V_GetColor(116);
-			break;
+			return V_GetColor(116);
 
 		case SKINCOLOR_TSUPER1:
-			blendcolor = V_GetColor(81);
-			break;
+			return V_GetColor(81);
 		case SKINCOLOR_TSUPER2:
-			blendcolor = V_GetColor(82);
-			break;
+			return V_GetColor(82);
 		case SKINCOLOR_TSUPER3:
-			blendcolor = V_GetColor(84);
-			break;
+			return V_GetColor(84);
 		case SKINCOLOR_TSUPER4:
-			blendcolor = V_GetColor(85);
-			break;
+			return V_GetColor(85);
 		case SKINCOLOR_TSUPER5:
-			blendcolor = V_GetColor(87);
-			break;
+			return V_GetColor(87);
 
 		case SKINCOLOR_KSUPER1:
-			blendcolor = V_GetColor(122);
-			break;
+			return V_GetColor(122);
 		case SKINCOLOR_KSUPER2:
-			blendcolor = V_GetColor(123);
-			break;
+			return V_GetColor(123);
 		case SKINCOLOR_KSUPER3:
-			blendcolor = V_GetColor(124);
-			break;
+			return V_GetColor(124);
 		case SKINCOLOR_KSUPER4:
-			blendcolor = V_GetColor(125);
-			break;
+			return V_GetColor(125);
 		case SKINCOLOR_KSUPER5:
-			blendcolor = V_GetColor(126);
-			break;
+			return V_GetColor(126);
 		default:
-			blendcolor = V_GetColor(247);
-			break;
+			return V_GetColor(247);
 	}
+}
+
+static void HWR_CreateBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch, GLMipmap_t *grmip, skincolors_t color)
+{
+	UINT16 w = gpatch->width, h = gpatch->height;
+	UINT32 size = w*h;
+	RGBA_t *image, *blendimage, *cur, blendcolor;
+
+	if (grmip->width == 0)
+	{
+
+		grmip->width = gpatch->width;
+		grmip->height = gpatch->height;
+
+		// no wrap around, no chroma key
+		grmip->flags = 0;
+		// setup the texture info
+		grmip->grInfo.format = GR_RGBA;
+		grmip->category = TC_MODEL;
+	}
+
+	Z_Free(grmip->grInfo.data);
+	grmip->grInfo.data = NULL;
+
+	cur = Z_Malloc(size*4, PU_HWRCACHE, &grmip->grInfo.data);
+	memset(cur, 0x00, size*4);
+
+	image = gpatch->mipmap.grInfo.data;
+	blendimage = blendgpatch->mipmap.grInfo.data;
+
+	blendcolor = HWR_SkinBlendColor(color);
 
 	while (size--)
 	{
@@ -1147,7 +1115,111 @@ static void HWR_CreateBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch,
 	return;
 }
 
-static void HWR_GetBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch, const UINT8 *colormap, skincolors_t color)
+static void HWR_InitBlendMipmap(GLMipmap_t *grmip, GLPatch_t *gpatch)
+{
+	grmip->width = gpatch->width;
+	grmip->height = gpatch->height;
+	grmip->flags = 0;
+	grmip->grInfo.format = GR_RGBA;
+	grmip->category = TC_MODEL;
+}
+
+// Splits HWR_CreateBlendedTexture's blend into what depends on the skin
+// colour and what doesn't, so the card can do the rest for any colour:
+//     out = base * (1 - k) + color * k
+// where k, the mask, is how much of the colour shows.
+static void HWR_CreateBlendLayers(GLPatch_t *gpatch, GLPatch_t *blendgpatch, GLMipmap_t *basemip, GLMipmap_t *maskmip)
+{
+	UINT32 size = gpatch->width*gpatch->height;
+	RGBA_t *image, *blendimage, *base, *mask;
+
+	HWR_InitBlendMipmap(basemip, gpatch);
+	HWR_InitBlendMipmap(maskmip, gpatch);
+
+	base = Z_Malloc(size*4, PU_HWRCACHE, &basemip->grInfo.data);
+	mask = Z_Malloc(size*4, PU_HWRCACHE, &maskmip->grInfo.data);
+
+	image = gpatch->mipmap.grInfo.data;
+	blendimage = blendgpatch->mipmap.grInfo.data;
+
+	while (size--)
+	{
+		if (blendimage->s.alpha == 0)
+		{
+			base->rgba = image->rgba;
+			mask->rgba = 0;
+		}
+		else
+		{
+			INT32 tempalpha, tempmult, k;
+			tempalpha = -(abs(blendimage->s.red-127)-127)*2;
+			if (tempalpha > 255)
+				tempalpha = 255;
+			else if (tempalpha < 0)
+				tempalpha = 0;
+
+			tempmult = (blendimage->s.red-127)*2;
+			if (tempmult > 255)
+				tempmult = 255;
+			else if (tempmult < 0)
+				tempmult = 0;
+
+			k = (tempalpha * blendimage->s.alpha)/255;
+			if (k >= 255)
+				base->rgba = 0; // all colour
+			else
+			{
+				// tempmult + tempalpha never goes over 255, so neither do these
+#define BLENDBASE(c) (UINT8)min((((image->s.c*(255-blendimage->s.alpha))/255 + (tempmult*blendimage->s.alpha)/255)*255)/(255-k), 255)
+				base->s.red = BLENDBASE(red);
+				base->s.green = BLENDBASE(green);
+				base->s.blue = BLENDBASE(blue);
+#undef BLENDBASE
+			}
+			mask->s.red = mask->s.green = mask->s.blue = (UINT8)k;
+		}
+		base->s.alpha = image->s.alpha;
+		mask->s.alpha = 0xff;
+
+		base++; mask++; image++; blendimage++;
+	}
+}
+
+// Has the card blend the colour in as the model is drawn, so there's only
+// ever two textures per model instead of one for every skin colour.
+static boolean HWR_SetBlendedTexture(md2_t *md2, GLPatch_t *gpatch, GLPatch_t *blendgpatch, skincolors_t color)
+{
+	GLMipmap_t *basemip, *maskmip;
+	boolean ok;
+
+	if (!md2->blendbase)
+	{
+		md2->blendbase = calloc(1, sizeof (GLMipmap_t));
+		md2->blendmask = calloc(1, sizeof (GLMipmap_t));
+		if (!md2->blendbase || !md2->blendmask)
+			I_Error("%s: Out of memory", "HWR_SetBlendedTexture");
+	}
+	basemip = md2->blendbase;
+	maskmip = md2->blendmask;
+
+	if ((!basemip->downloaded && !basemip->grInfo.data) || (!maskmip->downloaded && !maskmip->grInfo.data))
+	{
+		if (!gpatch->mipmap.grInfo.data || !blendgpatch->mipmap.grInfo.data)
+			return false;
+		Z_Free(basemip->grInfo.data);
+		Z_Free(maskmip->grInfo.data);
+		HWR_CreateBlendLayers(gpatch, blendgpatch, basemip, maskmip);
+	}
+
+	ok = HWD.pfnSetBlendedTexture(basemip, maskmip, HWR_SkinBlendColor(color));
+	if (basemip->grInfo.data)
+		Z_ChangeTag(basemip->grInfo.data, PU_HWRCACHE_UNLOCKED);
+	if (maskmip->grInfo.data)
+		Z_ChangeTag(maskmip->grInfo.data, PU_HWRCACHE_UNLOCKED);
+	return ok;
+}
+
+static void HWR_GetBlendedTexture(md2_t *md2, GLPatch_t *gpatch, GLPatch_t *blendgpatch, const UINT8 *colormap, skincolors_t color)
 {
 	// mostly copied from HWR_GetMappedPatch, hence the similarities and comment
 	GLMipmap_t *grmip, *newmip;
@@ -1159,6 +1231,11 @@ static void HWR_GetBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch, con
 		return;
 	}
 
+	if (HWD.pfnSetBlendedTexture && HWR_SetBlendedTexture(md2, gpatch, blendgpatch, color))
+		return;
+
+	// The card can't, so make a blended copy of the texture for this colour
+
 	// search for the mimmap
 	// skip the first (no colormap translated)
 	for (grmip = &gpatch->mipmap; grmip->nextcolormap; )
@@ -1166,12 +1243,12 @@ static void HWR_GetBlendedTexture(GLPatch_t *gpatch, GLPatch_t *blendgpatch, con
 		grmip = grmip->nextcolormap;
 		if (grmip->colormap == colormap)
 		{
-			if (grmip->downloaded && grmip->grInfo.data)
-			{
-				HWD.pfnSetTexture(grmip); // found the colormap, set it to the correct texture
-				Z_ChangeTag(grmip->grInfo.data, PU_HWRCACHE_UNLOCKED);
-				return;
-			}
+			// The driver can have let go of it, then make it again in place
+			if (!grmip->downloaded && !grmip->grInfo.data)
+				HWR_CreateBlendedTexture(gpatch, blendgpatch, grmip, color);
+			HWD.pfnSetTexture(grmip); // found the colormap, set it to the correct texture
+			Z_ChangeTag(grmip->grInfo.data, PU_HWRCACHE_UNLOCKED);
+			return;
 		}
 	}
 
@@ -1339,7 +1416,7 @@ void HWR_DrawMD2(gr_vissprite_t *spr)
 				md2->blendgrpatch && ((GLPatch_t *)md2->blendgrpatch)->mipmap.grInfo.format
 				&& gpatch->width == ((GLPatch_t *)md2->blendgrpatch)->width && gpatch->height == ((GLPatch_t *)md2->blendgrpatch)->height)
 			{
-				HWR_GetBlendedTexture(gpatch, (GLPatch_t *)md2->blendgrpatch, spr->colormap, (skincolors_t)spr->mobj->color);
+				HWR_GetBlendedTexture(md2, gpatch, (GLPatch_t *)md2->blendgrpatch, spr->colormap, (skincolors_t)spr->mobj->color);
 			}
 			else
 			{
@@ -126,6 +126,8 @@ typedef struct
 	md2_model_t *model;
 	void        *grpatch;
 	void        *blendgrpatch;
+	void        *blendbase; // GLMipmap_t, for blending skin colours on the card
+	void        *blendmask;
 	boolean     notfound;
 	INT32       skin;
 	boolean     error;
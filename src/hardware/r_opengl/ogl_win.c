@@ -551,6 +551,7 @@ EXPORT void HWRAPI(FinishUpdate) (INT32 waitvbl)
 	UNREFERENCED_PARAMETER(waitvbl);
 #endif
 	// DBG_Printf ("FinishUpdate()\n");
+	FlushBatch();
 #ifdef DEBUG_TO_FILE
 	if ((++nb_frames)==2)  // on ne commence pas � la premi�re frame
 		my_clock = clock();
@@ -563,6 +564,7 @@ EXPORT void HWRAPI(FinishUpdate) (INT32 waitvbl)
 #endif
 
 	SwapBuffers(hDC);
+	FinishFrame();
 }
 
 
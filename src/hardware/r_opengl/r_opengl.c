@@ -77,6 +77,23 @@ static  FBITFIELD   CurrentPolyFlags;
 static  FTextureInfo*  gr_cachetail = NULL;
 static  FTextureInfo*  gr_cachehead = NULL;
 
+// Texture memory accounting
+static  UINT32      texturebytes[NUMTEXTURECATEGORIES];
+static  UINT32      totaltexturebytes = 0;
+static  UINT32      texturebudget = 0; // 0 for no limit
+static  UINT32      textureevictions = 0;
+static  UINT32      textureframe = 1;
+
+// What was sent to the card this frame, and the last one
+static  FRenderStats curstats, laststats;
+
+// Counts a draw call
+static void CountDraw(UINT32 vertices)
+{
+	curstats.drawcalls++;
+	curstats.vertices += vertices;
+}
+
 RGBA_t  myPaletteData[256];
 GLint   screen_width    = 0;               // used by Draw2DLine()
 GLint   screen_height   = 0;
@@ -116,6 +133,7 @@ static GLint       viewport[4];
 #define SCRTEX_STARTSCREENWIPE 65534
 #define SCRTEX_ENDSCREENWIPE 65533
 #define SCRTEX_FINALSCREENTEXTURE 65532
+#define SCRTEX_SCENETEXTURE 65531
 static GLuint screentexture = 0;
 static GLuint startScreenWipe = 0;
 static GLuint endScreenWipe = 0;
@@ -169,6 +187,54 @@ static I_Error_t I_Error_GL = NULL;
 
 #ifndef MINI_GL_COMPATIBILITY
 static boolean gl13 = false; // whether we can use opengl 1.3 functions
+static boolean skinblendsupport = false; // texture combiners on three units
+static boolean skinblending = false; // SetBlendedTexture is set up for the next model
+static boolean pixelbuffersupport = false; // textures can be uploaded from buffer objects
+static boolean asyncuploads = true; // HWD_SET_ASYNCUPLOADS
+
+// Texture uploads waiting for the end of the frame, see QueueUpload
+#define MAXPENDINGUPLOADS 16
+
+typedef struct
+{
+	GLuint texname;
+	GLsizei width, height;
+} pendingupload_t;
+
+static pendingupload_t pendinguploads[MAXPENDINGUPLOADS];
+static INT32 numpendinguploads = 0;
+static GLuint uploadbuffers[MAXPENDINGUPLOADS]; // pendinguploads[i] is in uploadbuffers[i]
+
+// Timestamps for the card's time in each section, see MarkRenderSection
+#define MAXSECTIONMARKS 64
+#define RENDERSTATFRAMES 4 // frames that can be in flight before their timestamps are read
+
+typedef struct
+{
+	GLuint queries[MAXSECTIONMARKS+1]; // one more for the end of the frame
+	INT32 sections[MAXSECTIONMARKS];
+	INT32 nummarks;
+} statframe_t;
+
+static boolean timersupport = false; // timestamp queries
+static boolean gputimers = false; // HWD_SET_GPUTIMERS
+static statframe_t statframes[RENDERSTATFRAMES];
+static INT32 curstatframe = 0;
+
+// The scene is drawn into a framebuffer object and scaled up to the window, see MakeSceneBuffer
+static boolean framebuffersupport = false;
+static boolean scenebuffer = true; // HWD_SET_SCENEBUFFER
+static GLuint scenefbo = 0, scenedepth = 0, scenetexture = 0;
+static boolean scenebound = false; // drawing goes into scenefbo
+static boolean finaltextureused = false; // the window is drawn through DrawScreenFinalTexture
+static boolean presentpending = false; // MakeScreenFinalTexture was called for this frame
+static GLint scenefilter = 0;
+static INT32 renderscale = 100, nextrenderscale = 100; // HWD_SET_RENDERSCALE, in percent
+
+// With swapnowait, a swap isn't made while the last one is still queued, see ReadyToSwap
+static boolean syncsupport = false;
+static boolean swapnowait = false; // HWD_SET_SWAPNOWAIT
+static struct __GLsync *swapfence = NULL; // put in after the last swap
 #endif
 
 
@@ -246,6 +312,15 @@ FUNCPRINTF void DBG_Printf(const char *lpFmt, ...)
 #define pglColor4fv glColor4fv
 #define pglTexCoord2f glTexCoord2f
 
+/* Vertex arrays */
+#define pglEnableClientState glEnableClientState
+#define pglDisableClientState glDisableClientState
+#define pglVertexPointer glVertexPointer
+#define pglTexCoordPointer glTexCoordPointer
+#define pglColorPointer glColorPointer
+#define pglNormalPointer glNormalPointer
+#define pglDrawElements glDrawElements
+
 /* Lighting */
 #define pglShadeModel glShadeModel
 #define pglLightfv glLightfv
@@ -258,6 +333,7 @@ FUNCPRINTF void DBG_Printf(const char *lpFmt, ...)
 
 /* Texture mapping */
 #define pglTexEnvi glTexEnvi
+#define pglTexEnvfv glTexEnvfv
 #define pglTexParameteri glTexParameteri
 #define pglTexImage2D glTexImage2D
 
@@ -358,6 +434,22 @@ static PFNglColor4fv pglColor4fv;
 typedef void (APIENTRY * PFNglTexCoord2f) (GLfloat s, GLfloat t);
 static PFNglTexCoord2f pglTexCoord2f;
 
+/* Vertex arrays */
+typedef void (APIENTRY * PFNglEnableClientState) (GLenum array);
+static PFNglEnableClientState pglEnableClientState;
+typedef void (APIENTRY * PFNglDisableClientState) (GLenum array);
+static PFNglDisableClientState pglDisableClientState;
+typedef void (APIENTRY * PFNglVertexPointer) (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+static PFNglVertexPointer pglVertexPointer;
+typedef void (APIENTRY * PFNglTexCoordPointer) (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+static PFNglTexCoordPointer pglTexCoordPointer;
+typedef void (APIENTRY * PFNglColorPointer) (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+static PFNglColorPointer pglColorPointer;
+typedef void (APIENTRY * PFNglNormalPointer) (GLenum type, GLsizei stride, const GLvoid *pointer);
+static PFNglNormalPointer pglNormalPointer;
+typedef void (APIENTRY * PFNglDrawElements) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
+static PFNglDrawElements pglDrawElements;
+
 /* Lighting */
 typedef void (APIENTRY * PFNglShadeModel) (GLenum mode);
 static PFNglShadeModel pglShadeModel;
@@ -377,6 +469,8 @@ static PFNglReadPixels pglReadPixels;
 /* Texture mapping */
 typedef void (APIENTRY * PFNglTexEnvi) (GLenum target, GLenum pname, GLint param);
 static PFNglTexEnvi pglTexEnvi;
+typedef void (APIENTRY * PFNglTexEnvfv) (GLenum target, GLenum pname, const GLfloat *params);
+static PFNglTexEnvfv pglTexEnvfv;
 typedef void (APIENTRY * PFNglTexParameteri) (GLenum target, GLenum pname, GLint param);
 static PFNglTexParameteri pglTexParameteri;
 typedef void (APIENTRY * PFNglTexImage2D) (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels);
@@ -410,6 +504,91 @@ typedef void (APIENTRY *PFNglActiveTexture) (GLenum);
 static PFNglActiveTexture pglActiveTexture;
 typedef void (APIENTRY *PFNglMultiTexCoord2f) (GLenum, GLfloat, GLfloat);
 static PFNglMultiTexCoord2f pglMultiTexCoord2f;
+typedef void (APIENTRY *PFNglMultiTexCoord4fv) (GLenum, const GLfloat *);
+static PFNglMultiTexCoord4fv pglMultiTexCoord4fv;
+typedef void (APIENTRY *PFNglClientActiveTexture) (GLenum);
+static PFNglClientActiveTexture pglClientActiveTexture;
+
+/* 1.5 functions for buffer objects */
+typedef void (APIENTRY *PFNglGenBuffers) (GLsizei, GLuint *);
+static PFNglGenBuffers pglGenBuffers;
+typedef void (APIENTRY *PFNglBindBuffer) (GLenum, GLuint);
+static PFNglBindBuffer pglBindBuffer;
+typedef void (APIENTRY *PFNglBufferData) (GLenum, ptrdiff_t, const GLvoid *, GLenum);
+static PFNglBufferData pglBufferData;
+typedef GLvoid *(APIENTRY *PFNglMapBuffer) (GLenum, GLenum);
+static PFNglMapBuffer pglMapBuffer;
+typedef GLboolean (APIENTRY *PFNglUnmapBuffer) (GLenum);
+static PFNglUnmapBuffer pglUnmapBuffer;
+
+/* 3.3 timer queries */
+typedef void (APIENTRY *PFNglGenQueries) (GLsizei, GLuint *);
+static PFNglGenQueries pglGenQueries;
+typedef void (APIENTRY *PFNglQueryCounter) (GLuint, GLenum);
+static PFNglQueryCounter pglQueryCounter;
+typedef void (APIENTRY *PFNglGetQueryObjectiv) (GLuint, GLenum, GLint *);
+static PFNglGetQueryObjectiv pglGetQueryObjectiv;
+typedef void (APIENTRY *PFNglGetQueryObjectui64v) (GLuint, GLenum, UINT64 *);
+static PFNglGetQueryObjectui64v pglGetQueryObjectui64v;
+
+/* 3.0 framebuffer objects */
+typedef void (APIENTRY *PFNglGenFramebuffers) (GLsizei, GLuint *);
+static PFNglGenFramebuffers pglGenFramebuffers;
+typedef void (APIENTRY *PFNglDeleteFramebuffers) (GLsizei, const GLuint *);
+static PFNglDeleteFramebuffers pglDeleteFramebuffers;
+typedef void (APIENTRY *PFNglBindFramebuffer) (GLenum, GLuint);
+static PFNglBindFramebuffer pglBindFramebuffer;
+typedef void (APIENTRY *PFNglFramebufferTexture2D) (GLenum, GLenum, GLenum, GLuint, GLint);
+static PFNglFramebufferTexture2D pglFramebufferTexture2D;
+typedef GLenum (APIENTRY *PFNglCheckFramebufferStatus) (GLenum);
+static PFNglCheckFramebufferStatus pglCheckFramebufferStatus;
+typedef void (APIENTRY *PFNglGenRenderbuffers) (GLsizei, GLuint *);
+static PFNglGenRenderbuffers pglGenRenderbuffers;
+typedef void (APIENTRY *PFNglDeleteRenderbuffers) (GLsizei, const GLuint *);
+static PFNglDeleteRenderbuffers pglDeleteRenderbuffers;
+typedef void (APIENTRY *PFNglBindRenderbuffer) (GLenum, GLuint);
+static PFNglBindRenderbuffer pglBindRenderbuffer;
+typedef void (APIENTRY *PFNglRenderbufferStorage) (GLenum, GLenum, GLsizei, GLsizei);
+static PFNglRenderbufferStorage pglRenderbufferStorage;
+typedef void (APIENTRY *PFNglFramebufferRenderbuffer) (GLenum, GLenum, GLenum, GLuint);
+static PFNglFramebufferRenderbuffer pglFramebufferRenderbuffer;
+
+/* 2.0 shaders */
+typedef GLuint (APIENTRY *PFNglCreateShader) (GLenum);
+static PFNglCreateShader pglCreateShader;
+typedef void (APIENTRY *PFNglShaderSource) (GLuint, GLsizei, const char **, const GLint *);
+static PFNglShaderSource pglShaderSource;
+typedef void (APIENTRY *PFNglCompileShader) (GLuint);
+static PFNglCompileShader pglCompileShader;
+typedef void (APIENTRY *PFNglGetShaderiv) (GLuint, GLenum, GLint *);
+static PFNglGetShaderiv pglGetShaderiv;
+typedef void (APIENTRY *PFNglDeleteShader) (GLuint);
+static PFNglDeleteShader pglDeleteShader;
+typedef GLuint (APIENTRY *PFNglCreateProgram) (void);
+static PFNglCreateProgram pglCreateProgram;
+typedef void (APIENTRY *PFNglAttachShader) (GLuint, GLuint);
+static PFNglAttachShader pglAttachShader;
+typedef void (APIENTRY *PFNglLinkProgram) (GLuint);
+static PFNglLinkProgram pglLinkProgram;
+typedef void (APIENTRY *PFNglGetProgramiv) (GLuint, GLenum, GLint *);
+static PFNglGetProgramiv pglGetProgramiv;
+typedef void (APIENTRY *PFNglUseProgram) (GLuint);
+static PFNglUseProgram pglUseProgram;
+typedef GLint (APIENTRY *PFNglGetUniformLocation) (GLuint, const char *);
+static PFNglGetUniformLocation pglGetUniformLocation;
+typedef void (APIENTRY *PFNglUniform1i) (GLint, GLint);
+static PFNglUniform1i pglUniform1i;
+typedef void (APIENTRY *PFNglUniform1f) (GLint, GLfloat);
+static PFNglUniform1f pglUniform1f;
+
+/* 3.2 sync objects */
+typedef struct __GLsync *glsync_t;
+typedef glsync_t (APIENTRY *PFNglFenceSync) (GLenum, GLbitfield);
+static PFNglFenceSync pglFenceSync;
+typedef GLenum (APIENTRY *PFNglClientWaitSync) (glsync_t, GLbitfield, UINT64);
+static PFNglClientWaitSync pglClientWaitSync;
+typedef void (APIENTRY *PFNglDeleteSync) (glsync_t);
+static PFNglDeleteSync pglDeleteSync;
 #endif
 
 #ifndef MINI_GL_COMPATIBILITY
@@ -432,6 +611,100 @@ static PFNglMultiTexCoord2f pglMultiTexCoord2f;
 #ifndef GL_TEXTURE1
 #define GL_TEXTURE1 0x84C1
 #endif
+#ifndef GL_TEXTURE2
+#define GL_TEXTURE2 0x84C2
+#endif
+#ifndef GL_MAX_TEXTURE_UNITS
+#define GL_MAX_TEXTURE_UNITS 0x84E2
+#endif
+
+/* 1.3 texture combiners */
+#ifndef GL_COMBINE
+#define GL_COMBINE 0x8570
+#define GL_COMBINE_RGB 0x8571
+#define GL_COMBINE_ALPHA 0x8572
+#define GL_INTERPOLATE 0x8575
+#define GL_CONSTANT 0x8576
+#define GL_PRIMARY_COLOR 0x8577
+#define GL_PREVIOUS 0x8578
+#define GL_SOURCE0_RGB 0x8580
+#define GL_SOURCE1_RGB 0x8581
+#define GL_SOURCE2_RGB 0x8582
+#define GL_SOURCE0_ALPHA 0x8588
+#define GL_SOURCE1_ALPHA 0x8589
+#define GL_OPERAND0_RGB 0x8590
+#define GL_OPERAND1_RGB 0x8591
+#define GL_OPERAND2_RGB 0x8592
+#define GL_OPERAND0_ALPHA 0x8598
+#define GL_OPERAND1_ALPHA 0x8599
+#endif
+
+/* 1.5 buffer objects */
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+/* 2.1 pixel buffer objects */
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+
+/* 3.3 timer queries */
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+/* 3.0 framebuffer objects */
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+
+/* 2.0 shaders */
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+/* 3.2 sync objects */
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
 
 #endif
 
@@ -496,6 +769,14 @@ boolean SetupGLfunc(void)
 	GETOPENGLFUNC(pglColor4fv , glColor4fv)
 	GETOPENGLFUNC(pglTexCoord2f , glTexCoord2f)
 
+	GETOPENGLFUNC(pglEnableClientState , glEnableClientState)
+	GETOPENGLFUNC(pglDisableClientState , glDisableClientState)
+	GETOPENGLFUNC(pglVertexPointer , glVertexPointer)
+	GETOPENGLFUNC(pglTexCoordPointer , glTexCoordPointer)
+	GETOPENGLFUNC(pglColorPointer , glColorPointer)
+	GETOPENGLFUNC(pglNormalPointer , glNormalPointer)
+	GETOPENGLFUNC(pglDrawElements , glDrawElements)
+
 	GETOPENGLFUNC(pglShadeModel , glShadeModel)
 	GETOPENGLFUNC(pglLightfv, glLightfv)
 	GETOPENGLFUNC(pglLightModelfv , glLightModelfv)
@@ -505,6 +786,7 @@ boolean SetupGLfunc(void)
 	GETOPENGLFUNC(pglReadPixels , glReadPixels)
 
 	GETOPENGLFUNC(pglTexEnvi , glTexEnvi)
+	GETOPENGLFUNC(pglTexEnvfv , glTexEnvfv)
 	GETOPENGLFUNC(pglTexParameteri , glTexParameteri)
 	GETOPENGLFUNC(pglTexImage2D , glTexImage2D)
 
@@ -525,6 +807,411 @@ boolean SetupGLfunc(void)
 	return true;
 }
 
+// ==========================================================================
+//                                                           POLYGON BATCHING
+// ==========================================================================
+// DrawPolygon doesn't draw straight away: it adds the polygon to a batch, as
+// triangles with their own colour, and the batch is drawn with one call
+// when the texture or the blend mode changes. Every other entry point that
+// touches the OpenGL state flushes the batch first. With buffer objects the
+// batch is streamed into a VBO, otherwise it's drawn from client memory.
+
+#if !defined (MINI_GL_COMPATIBILITY) && !defined (KOS_GL_COMPATIBILITY)
+#define POLYBATCHING
+#endif
+
+#ifdef POLYBATCHING
+#define MAXBATCHVERTS   8192
+#define MAXBATCHINDICES (MAXBATCHVERTS*3)
+
+typedef struct
+{
+	GLfloat x, y, z;
+	GLfloat s, t;
+	GLRGBAFloat c;
+	GLRGBAFloat fog; // colour, and the density in alpha, for fogprogram
+} batchvertex_t;
+
+static batchvertex_t batchverts[MAXBATCHVERTS];
+static GLushort batchindices[MAXBATCHINDICES];
+static GLsizei numbatchverts = 0, numbatchindices = 0;
+static GLRGBAFloat batchcolor = {1.0f, 1.0f, 1.0f, 1.0f}; // what glColor would have been
+static boolean batchwritesdepth = false; // anything batched was drawn with PF_Occlude
+static GLuint batchbuffers[2]; // vertexes and indices
+
+// Fog set with SetSpecialState, with no density while it's off.
+// fogprogram takes this from each vertex, so a surface's fog can
+// change without drawing everything batched before it first.
+static GLRGBAFloat batchfog = {0.0f, 0.0f, 0.0f, 0.0f};
+static GLfloat fogdensity = 0.0f;
+static boolean fogon = false;
+static GLuint fogprogram = 0; // 0 if the card can't run it
+static boolean shaders = true; // HWD_SET_SHADERS
+
+// With HWD_SET_INDEXEDTEXTURES, palettized textures and patches are sent
+// as they are, one byte a texel or two with the alpha, instead of being
+// made RGBA. paletteprogram looks each texel up in the colormap and then
+// the palette, so a translated sprite is the same texture with another
+// colormap instead of a copy of its own. Lookups can't be filtered, so
+// these textures are always point sampled.
+#define PALETTETEXTURE 65530
+#define COLORMAPTEXTURE 65529
+static boolean indexedtextures = false;
+static GLuint paletteprogram = 0;
+static GLint chromakeyuniform = -1;
+static boolean palettechanged = true; // since PALETTETEXTURE was last sent
+static boolean colormapchanged = true;
+static UINT8 curcolormap[256]; // what COLORMAPTEXTURE has
+static const UINT8 *nextcolormap = NULL; // from SetColormap, NULL for none
+static GLuint indexedtex = 0; // the bound texture, if it's indexed
+static GLfloat indexedchromakey = -1.0f; // its chroma key index, if it has one
+
+#define INDEXEDTEXTURES (indexedtextures && shaders && paletteprogram)
+
+static const char *fogvertexshader =
+	"#version 120\n"
+	"varying vec4 fog;\n"
+	"varying float fogdepth;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = ftransform();\n"
+	"	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"	fog = gl_MultiTexCoord1;\n"
+	"	fogdepth = abs((gl_ModelViewMatrix * gl_Vertex).z);\n"
+	"}\n";
+
+// The same as GL_EXP fog on top of GL_MODULATE
+static const char *fogfragmentshader =
+	"#version 120\n"
+	"uniform sampler2D tex;\n"
+	"varying vec4 fog;\n"
+	"varying float fogdepth;\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 c = texture2D(tex, gl_TexCoord[0].st) * gl_Color;\n"
+	"	float f = clamp(exp(-fog.a * fogdepth), 0.0, 1.0);\n"
+	"	gl_FragColor = vec4(mix(fog.rgb, c.rgb, f), c.a);\n"
+	"}\n";
+
+// The same as fogfragmentshader, with the colour from the palette
+static const char *palettefragmentshader =
+	"#version 120\n"
+	"uniform sampler2D tex;\n"
+	"uniform sampler2D palette;\n"
+	"uniform sampler2D colormap;\n"
+	"uniform float chromakey;\n"
+	"varying vec4 fog;\n"
+	"varying float fogdepth;\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 texel = texture2D(tex, gl_TexCoord[0].st);\n"
+	"	float index = texture2D(colormap, vec2(texel.r * (255.0/256.0) + (0.5/256.0), 0.5)).r;\n"
+	"	vec4 c = texture2D(palette, vec2(index * (255.0/256.0) + (0.5/256.0), 0.5));\n"
+	"	if (chromakey < 0.0)\n"
+	"		c.a *= texel.a;\n"
+	"	else if (abs(texel.r * 255.0 - chromakey) < 0.5)\n"
+	"		c.a = 0.0;\n"
+	"	c *= gl_Color;\n"
+	"	float f = clamp(exp(-fog.a * fogdepth), 0.0, 1.0);\n"
+	"	gl_FragColor = vec4(mix(fog.rgb, c.rgb, f), c.a);\n"
+	"}\n";
+
+static GLuint CompileShader(GLenum type, const char *source)
+{
+	GLuint shader = pglCreateShader(type);
+	GLint ok = 0;
+
+	pglShaderSource(shader, 1, &source, NULL);
+	pglCompileShader(shader);
+	pglGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok)
+	{
+		pglDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static void Clamp2D(GLenum pname);
+
+// Returns 0 if it doesn't compile or link
+static GLuint LinkProgram(const char *vertexsource, const char *fragmentsource)
+{
+	GLuint vs, fs, program = 0;
+	GLint ok = 0;
+
+	vs = CompileShader(GL_VERTEX_SHADER, vertexsource);
+	fs = CompileShader(GL_FRAGMENT_SHADER, fragmentsource);
+	if (vs && fs)
+	{
+		program = pglCreateProgram();
+		pglAttachShader(program, vs);
+		pglAttachShader(program, fs);
+		pglLinkProgram(program);
+		pglGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if (!ok)
+			program = 0;
+	}
+	// The program keeps them around for as long as it needs them
+	if (vs)
+		pglDeleteShader(vs);
+	if (fs)
+		pglDeleteShader(fs);
+	return program;
+}
+
+static void SetupFogProgram(void)
+{
+	fogprogram = paletteprogram = 0; // from an old context
+	if (!(pglCreateShader && pglShaderSource && pglCompileShader && pglGetShaderiv
+		&& pglDeleteShader && pglCreateProgram && pglAttachShader && pglLinkProgram
+		&& pglGetProgramiv && pglUseProgram && pglClientActiveTexture))
+	{
+		DBG_Printf("Fog shader: disabled\n");
+		DBG_Printf("Palette shader: disabled\n");
+		return;
+	}
+
+	fogprogram = LinkProgram(fogvertexshader, fogfragmentshader);
+	DBG_Printf("Fog shader: %s\n", fogprogram ? "enabled" : "failed to compile");
+
+	if (!(pglGetUniformLocation && pglUniform1i && pglUniform1f && pglActiveTexture && pglMultiTexCoord4fv))
+	{
+		DBG_Printf("Palette shader: disabled\n");
+		return;
+	}
+	paletteprogram = LinkProgram(fogvertexshader, palettefragmentshader);
+	if (paletteprogram)
+	{
+		pglUseProgram(paletteprogram);
+		pglUniform1i(pglGetUniformLocation(paletteprogram, "tex"), 0);
+		pglUniform1i(pglGetUniformLocation(paletteprogram, "palette"), 1);
+		pglUniform1i(pglGetUniformLocation(paletteprogram, "colormap"), 2);
+		chromakeyuniform = pglGetUniformLocation(paletteprogram, "chromakey");
+		pglUseProgram(0);
+	}
+	palettechanged = colormapchanged = true;
+	DBG_Printf("Palette shader: %s\n", paletteprogram ? "enabled" : "failed to compile");
+}
+
+// Whether the bound texture is an indexed one
+static boolean IndexedTextureBound(void)
+{
+	return (indexedtex && indexedtex == tex_downloaded);
+}
+
+// Makes the colormap from SetColormap the one the next polygons are drawn with
+static void UpdateColormap(void)
+{
+	static UINT8 identity[256];
+	const UINT8 *colormap = nextcolormap;
+	INT32 i;
+
+	if (!colormap)
+	{
+		if (!identity[255])
+			for (i = 0; i < 256; i++)
+				identity[i] = (UINT8)i;
+		colormap = identity;
+	}
+	if (!colormapchanged && !memcmp(colormap, curcolormap, sizeof (curcolormap)))
+		return;
+
+	FlushBatch(); // what's batched still needs the old one
+	memcpy(curcolormap, colormap, sizeof (curcolormap));
+	colormapchanged = true;
+}
+
+// Sends a 256 by 1 lookup texture to the active unit
+static void UploadLookupTexture(GLuint texname, GLint format, GLenum dataformat, const GLvoid *data)
+{
+	pglBindTexture(GL_TEXTURE_2D, texname);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	Clamp2D(GL_TEXTURE_WRAP_S);
+	Clamp2D(GL_TEXTURE_WRAP_T);
+	pglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	pglTexImage2D(GL_TEXTURE_2D, 0, format, 256, 1, 0, dataformat, GL_UNSIGNED_BYTE, data);
+	pglPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// Sets up paletteprogram for the bound indexed texture, with the palette
+// on unit 1 and the colormap on unit 2.
+static void StartIndexedDraw(void)
+{
+	pglUseProgram(paletteprogram);
+	pglUniform1f(chromakeyuniform, indexedchromakey);
+	pglMultiTexCoord4fv(GL_TEXTURE1, &batchfog.red); // unless there's an array of it
+
+	pglActiveTexture(GL_TEXTURE1);
+	if (palettechanged)
+	{
+		UploadLookupTexture(PALETTETEXTURE, GL_RGBA, GL_RGBA, myPaletteData);
+		palettechanged = false;
+	}
+	else
+		pglBindTexture(GL_TEXTURE_2D, PALETTETEXTURE);
+
+	pglActiveTexture(GL_TEXTURE2);
+	if (colormapchanged)
+	{
+		UploadLookupTexture(COLORMAPTEXTURE, GL_LUMINANCE8, GL_LUMINANCE, curcolormap);
+		colormapchanged = false;
+	}
+	else
+		pglBindTexture(GL_TEXTURE_2D, COLORMAPTEXTURE);
+	pglActiveTexture(GL_TEXTURE0);
+}
+
+static void EndIndexedDraw(void)
+{
+	// Leave the other units as the fixed function pipeline had them
+	pglActiveTexture(GL_TEXTURE2);
+	pglBindTexture(GL_TEXTURE_2D, 0);
+	pglActiveTexture(GL_TEXTURE1);
+	pglBindTexture(GL_TEXTURE_2D, 0);
+	pglActiveTexture(GL_TEXTURE0);
+	pglUseProgram(0);
+}
+
+static void SetupPolygonBatch(void)
+{
+	if (pglGenBuffers && pglBindBuffer && pglBufferData)
+	{
+		if (!batchbuffers[0])
+			pglGenBuffers(2, batchbuffers);
+		DBG_Printf("Vertex buffer objects: enabled\n");
+	}
+	else
+	{
+		pglBindBuffer = NULL;
+		DBG_Printf("Vertex buffer objects: disabled\n");
+	}
+}
+
+// Adds a convex polygon to the batch, as a fan of triangles.
+// Returns false if it's too big to fit in a batch at all.
+static boolean BatchPolygon(FOutVector *pOutVerts, FUINT iNumPts, const GLRGBAFloat *c)
+{
+	batchvertex_t *v;
+	GLushort *index;
+	FUINT i;
+
+	if (iNumPts > MAXBATCHVERTS)
+		return false;
+	if (iNumPts < 3)
+		return true;
+
+	if (numbatchverts + (GLsizei)iNumPts > MAXBATCHVERTS
+	 || numbatchindices + (GLsizei)(iNumPts-2)*3 > MAXBATCHINDICES)
+		FlushBatch();
+
+	v = &batchverts[numbatchverts];
+	for (i = 0; i < iNumPts; i++, v++)
+	{
+		v->x = pOutVerts[i].x;
+		v->y = pOutVerts[i].y;
+		v->z = pOutVerts[i].z;
+		v->s = pOutVerts[i].sow;
+		v->t = pOutVerts[i].tow;
+		v->c = *c;
+		v->fog = batchfog;
+	}
+
+	index = &batchindices[numbatchindices];
+	for (i = 2; i < iNumPts; i++)
+	{
+		*index++ = (GLushort)numbatchverts;
+		*index++ = (GLushort)(numbatchverts + i - 1);
+		*index++ = (GLushort)(numbatchverts + i);
+	}
+
+	numbatchverts += iNumPts;
+	numbatchindices += (iNumPts-2)*3;
+	if (CurrentPolyFlags & PF_Occlude)
+		batchwritesdepth = true;
+	return true;
+}
+#endif
+
+// -----------------+
+// FlushBatch       : Draw the polygons batched so far
+// -----------------+
+void FlushBatch(void)
+{
+#ifdef POLYBATCHING
+	const GLubyte *verts = (const GLubyte *)batchverts;
+	const GLvoid *indices = batchindices;
+	const boolean indexed = IndexedTextureBound();
+	const boolean useprogram = (indexed || (fogprogram && shaders));
+
+	if (!numbatchindices)
+	{
+		numbatchverts = 0;
+		return;
+	}
+
+	if (pglBindBuffer)
+	{
+		// New storage every flush, so the driver needn't wait for the last draw
+		pglBindBuffer(GL_ARRAY_BUFFER, batchbuffers[0]);
+		pglBufferData(GL_ARRAY_BUFFER, numbatchverts * sizeof (batchvertex_t), batchverts, GL_STREAM_DRAW);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchbuffers[1]);
+		pglBufferData(GL_ELEMENT_ARRAY_BUFFER, numbatchindices * sizeof (GLushort), batchindices, GL_STREAM_DRAW);
+		verts = NULL;
+		indices = NULL;
+	}
+
+	pglEnableClientState(GL_VERTEX_ARRAY);
+	pglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	pglEnableClientState(GL_COLOR_ARRAY);
+	pglVertexPointer(3, GL_FLOAT, sizeof (batchvertex_t), verts + offsetof(batchvertex_t, x));
+	pglTexCoordPointer(2, GL_FLOAT, sizeof (batchvertex_t), verts + offsetof(batchvertex_t, s));
+	pglColorPointer(4, GL_FLOAT, sizeof (batchvertex_t), verts + offsetof(batchvertex_t, c));
+	if (useprogram)
+	{
+		if (indexed)
+			StartIndexedDraw();
+		else
+			pglUseProgram(fogprogram);
+		pglClientActiveTexture(GL_TEXTURE1);
+		pglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		pglTexCoordPointer(4, GL_FLOAT, sizeof (batchvertex_t), verts + offsetof(batchvertex_t, fog));
+		pglClientActiveTexture(GL_TEXTURE0);
+	}
+
+	pglDrawElements(GL_TRIANGLES, numbatchindices, GL_UNSIGNED_SHORT, indices);
+	CountDraw(numbatchverts);
+
+	if (useprogram)
+	{
+		pglClientActiveTexture(GL_TEXTURE1);
+		pglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		pglClientActiveTexture(GL_TEXTURE0);
+		if (indexed)
+			EndIndexedDraw();
+		else
+			pglUseProgram(0);
+	}
+	pglDisableClientState(GL_COLOR_ARRAY);
+	pglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	pglDisableClientState(GL_VERTEX_ARRAY);
+
+	if (pglBindBuffer)
+	{
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	// The colour array leaves the current colour undefined
+	pglColor4fv(&batchcolor.red);
+
+	numbatchverts = numbatchindices = 0;
+	batchwritesdepth = false;
+#endif
+}
+
 // This has to be done after the context is created so the version number can be obtained
 boolean SetupGLFunc13(void)
 {
@@ -533,8 +1220,10 @@ boolean SetupGLFunc13(void)
 #else
 	const GLubyte *version = pglGetString(GL_VERSION);
 	int glmajor, glminor;
+	boolean gl15 = false, gl20 = false, gl21 = false, gl30 = false, gl32 = false, gl33 = false;
 
 	gl13 = false;
+	skinblendsupport = false;
 	// Parse the GL version
 	if (version != NULL)
 	{
@@ -545,6 +1234,12 @@ boolean SetupGLFunc13(void)
 				gl13 = true;
 			else if (glmajor > 1)
 				gl13 = true;
+			gl15 = (glmajor > 1 || (glmajor == 1 && glminor >= 5));
+			gl20 = (glmajor >= 2);
+			gl21 = (glmajor > 2 || (glmajor == 2 && glminor >= 1));
+			gl30 = (glmajor >= 3);
+			gl32 = (glmajor > 3 || (glmajor == 3 && glminor >= 2));
+			gl33 = (glmajor > 3 || (glmajor == 3 && glminor >= 3));
 		}
 	}
 
@@ -552,12 +1247,18 @@ boolean SetupGLFunc13(void)
 	{
 		pglActiveTexture = GetGLFunc("glActiveTexture");
 		pglMultiTexCoord2f = GetGLFunc("glMultiTexCoord2f");
+		pglMultiTexCoord4fv = GetGLFunc("glMultiTexCoord4fv");
+		pglClientActiveTexture = GetGLFunc("glClientActiveTexture");
+		skinblendsupport = true;
 	}
 	else if (isExtAvailable("GL_ARB_multitexture", gl_extensions))
 	{
 		// Get the functions
 		pglActiveTexture  = GetGLFunc("glActiveTextureARB");
 		pglMultiTexCoord2f  = GetGLFunc("glMultiTexCoord2fARB");
+		pglMultiTexCoord4fv = GetGLFunc("glMultiTexCoord4fvARB");
+		pglClientActiveTexture = GetGLFunc("glClientActiveTextureARB");
+		skinblendsupport = isExtAvailable("GL_ARB_texture_env_combine", gl_extensions);
 
 		gl13 = true; // This is now true, so the new fade mask stuff can be done, if OpenGL version is less than 1.3, it still uses the old fade stuff.
 		DBG_Printf("GL_ARB_multitexture support: enabled\n");
@@ -565,6 +1266,127 @@ boolean SetupGLFunc13(void)
 	}
 	else
 		DBG_Printf("GL_ARB_multitexture support: disabled\n");
+
+	// Skin colours are blended with a texture combiner on each of three units
+	if (skinblendsupport)
+	{
+		GLint units = 0;
+		pglGetIntegerv(GL_MAX_TEXTURE_UNITS, &units);
+		skinblendsupport = (units >= 3 && pglClientActiveTexture);
+	}
+	DBG_Printf("Skin colour blending on the card: %s\n", skinblendsupport ? "enabled" : "disabled");
+
+	pglGenBuffers = NULL;
+	pglBindBuffer = NULL;
+	pglBufferData = NULL;
+	pglMapBuffer = NULL;
+	pglUnmapBuffer = NULL;
+	if (gl15)
+	{
+		pglGenBuffers = GetGLFunc("glGenBuffers");
+		pglBindBuffer = GetGLFunc("glBindBuffer");
+		pglBufferData = GetGLFunc("glBufferData");
+		pglMapBuffer = GetGLFunc("glMapBuffer");
+		pglUnmapBuffer = GetGLFunc("glUnmapBuffer");
+	}
+	else if (isExtAvailable("GL_ARB_vertex_buffer_object", gl_extensions))
+	{
+		pglGenBuffers = GetGLFunc("glGenBuffersARB");
+		pglBindBuffer = GetGLFunc("glBindBufferARB");
+		pglBufferData = GetGLFunc("glBufferDataARB");
+		pglMapBuffer = GetGLFunc("glMapBufferARB");
+		pglUnmapBuffer = GetGLFunc("glUnmapBufferARB");
+	}
+
+	// Wall and flat textures can be uploaded from pixel buffer objects
+	pixelbuffersupport = (pglGenBuffers && pglBindBuffer && pglBufferData && pglMapBuffer && pglUnmapBuffer
+		&& (gl21 || isExtAvailable("GL_ARB_pixel_buffer_object", gl_extensions)
+		|| isExtAvailable("GL_EXT_pixel_buffer_object", gl_extensions)));
+	DBG_Printf("Texture uploads from pixel buffer objects: %s\n", pixelbuffersupport ? "enabled" : "disabled");
+
+	pglGenQueries = NULL;
+	pglQueryCounter = NULL;
+	pglGetQueryObjectiv = NULL;
+	pglGetQueryObjectui64v = NULL;
+	if (gl33 || isExtAvailable("GL_ARB_timer_query", gl_extensions))
+	{
+		pglGenQueries = GetGLFunc(gl15 ? "glGenQueries" : "glGenQueriesARB");
+		pglGetQueryObjectiv = GetGLFunc(gl15 ? "glGetQueryObjectiv" : "glGetQueryObjectivARB");
+		pglQueryCounter = GetGLFunc("glQueryCounter");
+		pglGetQueryObjectui64v = GetGLFunc("glGetQueryObjectui64v");
+	}
+	timersupport = (pglGenQueries && pglQueryCounter && pglGetQueryObjectiv && pglGetQueryObjectui64v);
+	memset(statframes, 0, sizeof (statframes)); // any query names are from an old context
+	DBG_Printf("GPU timer queries: %s\n", timersupport ? "enabled" : "disabled");
+
+	// The scene can be drawn into a framebuffer object, see MakeSceneBuffer
+	pglGenFramebuffers = NULL;
+	if (gl30 || isExtAvailable("GL_ARB_framebuffer_object", gl_extensions))
+	{
+		pglGenFramebuffers = GetGLFunc("glGenFramebuffers");
+		pglDeleteFramebuffers = GetGLFunc("glDeleteFramebuffers");
+		pglBindFramebuffer = GetGLFunc("glBindFramebuffer");
+		pglFramebufferTexture2D = GetGLFunc("glFramebufferTexture2D");
+		pglCheckFramebufferStatus = GetGLFunc("glCheckFramebufferStatus");
+		pglGenRenderbuffers = GetGLFunc("glGenRenderbuffers");
+		pglDeleteRenderbuffers = GetGLFunc("glDeleteRenderbuffers");
+		pglBindRenderbuffer = GetGLFunc("glBindRenderbuffer");
+		pglRenderbufferStorage = GetGLFunc("glRenderbufferStorage");
+		pglFramebufferRenderbuffer = GetGLFunc("glFramebufferRenderbuffer");
+	}
+	else if (isExtAvailable("GL_EXT_framebuffer_object", gl_extensions))
+	{
+		pglGenFramebuffers = GetGLFunc("glGenFramebuffersEXT");
+		pglDeleteFramebuffers = GetGLFunc("glDeleteFramebuffersEXT");
+		pglBindFramebuffer = GetGLFunc("glBindFramebufferEXT");
+		pglFramebufferTexture2D = GetGLFunc("glFramebufferTexture2DEXT");
+		pglCheckFramebufferStatus = GetGLFunc("glCheckFramebufferStatusEXT");
+		pglGenRenderbuffers = GetGLFunc("glGenRenderbuffersEXT");
+		pglDeleteRenderbuffers = GetGLFunc("glDeleteRenderbuffersEXT");
+		pglBindRenderbuffer = GetGLFunc("glBindRenderbufferEXT");
+		pglRenderbufferStorage = GetGLFunc("glRenderbufferStorageEXT");
+		pglFramebufferRenderbuffer = GetGLFunc("glFramebufferRenderbufferEXT");
+	}
+	framebuffersupport = (pglGenFramebuffers && pglDeleteFramebuffers && pglBindFramebuffer
+		&& pglFramebufferTexture2D && pglCheckFramebufferStatus && pglGenRenderbuffers
+		&& pglDeleteRenderbuffers && pglBindRenderbuffer && pglRenderbufferStorage
+		&& pglFramebufferRenderbuffer);
+	scenefbo = scenedepth = scenetexture = 0; // from an old context
+	scenebound = presentpending = false;
+	DBG_Printf("Framebuffer objects: %s\n", framebuffersupport ? "enabled" : "disabled");
+
+	pglFenceSync = NULL;
+	if (gl32 || isExtAvailable("GL_ARB_sync", gl_extensions))
+	{
+		pglFenceSync = GetGLFunc("glFenceSync");
+		pglClientWaitSync = GetGLFunc("glClientWaitSync");
+		pglDeleteSync = GetGLFunc("glDeleteSync");
+	}
+	syncsupport = (pglFenceSync && pglClientWaitSync && pglDeleteSync);
+	swapfence = NULL; // from an old context
+	DBG_Printf("Sync objects: %s\n", syncsupport ? "enabled" : "disabled");
+
+	pglCreateShader = NULL;
+	if (gl20)
+	{
+		pglCreateShader = GetGLFunc("glCreateShader");
+		pglShaderSource = GetGLFunc("glShaderSource");
+		pglCompileShader = GetGLFunc("glCompileShader");
+		pglGetShaderiv = GetGLFunc("glGetShaderiv");
+		pglDeleteShader = GetGLFunc("glDeleteShader");
+		pglCreateProgram = GetGLFunc("glCreateProgram");
+		pglAttachShader = GetGLFunc("glAttachShader");
+		pglLinkProgram = GetGLFunc("glLinkProgram");
+		pglGetProgramiv = GetGLFunc("glGetProgramiv");
+		pglUseProgram = GetGLFunc("glUseProgram");
+		pglGetUniformLocation = GetGLFunc("glGetUniformLocation");
+		pglUniform1i = GetGLFunc("glUniform1i");
+		pglUniform1f = GetGLFunc("glUniform1f");
+	}
+#ifdef POLYBATCHING
+	SetupPolygonBatch();
+	SetupFogProgram();
+#endif
 	return true;
 #endif
 }
@@ -577,8 +1399,10 @@ static void SetNoTexture(void)
 	// Set small white texture.
 	if (tex_downloaded != NOTEXTURE_NUM)
 	{
+		FlushBatch();
 		pglBindTexture(GL_TEXTURE_2D, NOTEXTURE_NUM);
 		tex_downloaded = NOTEXTURE_NUM;
+		curstats.texturebinds++;
 	}
 }
 
@@ -661,6 +1485,95 @@ static void GLProject(GLdouble objX, GLdouble objY, GLdouble objZ,
 }
 #endif
 
+#ifndef MINI_GL_COMPATIBILITY
+static GLint lastviewport[4]; // as asked for, before ScaleSceneRect
+
+// Scales a rectangle of the screen to the part of scenefbo that is drawn into
+static void ScaleSceneRect(GLint *x, GLint *y, GLsizei *w, GLsizei *h)
+{
+	GLint x2, y2;
+
+	if (!scenebound || renderscale == 100)
+		return;
+
+	x2 = (*x + *w)*renderscale/100;
+	y2 = (*y + *h)*renderscale/100;
+	*x = *x*renderscale/100;
+	*y = *y*renderscale/100;
+	*w = x2 - *x;
+	*h = y2 - *y;
+}
+
+static void DeleteSceneBuffer(void)
+{
+	if (!scenefbo)
+		return;
+
+	FlushBatch();
+	pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+	pglDeleteFramebuffers(1, &scenefbo);
+	pglDeleteRenderbuffers(1, &scenedepth);
+	pglDeleteTextures(1, &scenetexture);
+	scenefbo = scenedepth = scenetexture = 0;
+	scenebound = presentpending = false;
+}
+#endif
+
+static void SetViewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+#ifndef MINI_GL_COMPATIBILITY
+	lastviewport[0] = x;
+	lastviewport[1] = y;
+	lastviewport[2] = w;
+	lastviewport[3] = h;
+	ScaleSceneRect(&x, &y, &w, &h);
+#endif
+	pglViewport(x, y, w, h);
+}
+
+// Size of the picture of the screen in the buffer that is drawn into
+static void GetSceneSize(GLint *w, GLint *h)
+{
+	*w = screen_width;
+	*h = screen_height;
+#ifndef MINI_GL_COMPATIBILITY
+	if (scenebound && renderscale != 100)
+	{
+		*w = max(1, screen_width*renderscale/100);
+		*h = max(1, screen_height*renderscale/100);
+	}
+#endif
+}
+
+// Reads the screen as RGB, scaling it back up if the scene is drawn smaller
+static void ReadScreenPixels(INT32 x, INT32 y, INT32 width, INT32 height, GLubyte *dst)
+{
+#ifndef MINI_GL_COMPATIBILITY
+	if (scenebound && renderscale != 100)
+	{
+		GLint sx = x, sy = y;
+		GLsizei sw = width, sh = height;
+		GLubyte *image;
+		INT32 i, j;
+
+		ScaleSceneRect(&sx, &sy, &sw, &sh);
+		sw = max(sw, 1);
+		sh = max(sh, 1);
+		image = malloc(sw*sh*3);
+		if (image)
+		{
+			pglReadPixels(sx, sy, sw, sh, GL_RGB, GL_UNSIGNED_BYTE, image);
+			for (i = 0; i < height; i++)
+				for (j = 0; j < width; j++)
+					memcpy(dst + (i*width + j)*3, image + ((i*sh/height)*sw + j*sw/width)*3, 3);
+			free(image);
+			return;
+		}
+	}
+#endif
+	pglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, dst);
+}
+
 // -----------------+
 // SetModelView     :
 // -----------------+
@@ -668,14 +1581,21 @@ void SetModelView(GLint w, GLint h)
 {
 //	DBG_Printf("SetModelView(): %dx%d\n", (int)w, (int)h);
 
+	FlushBatch();
+
 	// The screen textures need to be flushed if the width or height change so that they be remade for the correct size
 	if (screen_width != w || screen_height != h)
+	{
 		FlushScreenTextures();
+#ifndef MINI_GL_COMPATIBILITY
+		DeleteSceneBuffer(); // made again at the new size by FinishFrame
+#endif
+	}
 
 	screen_width = w;
 	screen_height = h;
 
-	pglViewport(0, 0, w, h);
+	SetViewport(0, 0, w, h);
 #ifdef GL_ACCUM_BUFFER_BIT
 	pglClear(GL_ACCUM_BUFFER_BIT);
 #endif
@@ -713,6 +1633,8 @@ void SetStates(void)
 
 //	DBG_Printf("SetStates()\n");
 
+	FlushBatch();
+
 	// Hurdler: not necessary, is it?
 	pglShadeModel(GL_SMOOTH);      // iterate vertice colors
 	//pglShadeModel(GL_FLAT);
@@ -790,6 +1712,8 @@ void Flush(void)
 {
 	//DBG_Printf ("HWR_Flush()\n");
 
+	FlushBatch();
+
 	while (gr_cachehead)
 	{
 		// ceci n'est pas du tout necessaire vu que tu les a charger normalement et
@@ -812,6 +1736,15 @@ void Flush(void)
 	}
 	gr_cachetail = gr_cachehead = NULL; //Hurdler: well, gr_cachehead is already NULL
 	NextTexAvail = FIRST_TEX_AVAIL;
+#ifndef MINI_GL_COMPATIBILITY
+	numpendinguploads = 0; // their names are about to be given out again
+#endif
+	memset(texturebytes, 0, sizeof (texturebytes));
+	totaltexturebytes = 0;
+#ifdef POLYBATCHING
+	indexedtex = 0;
+	palettechanged = true; // SetPalette flushes the textures
+#endif
 #if 0
 	if (screentexture != FIRST_TEX_AVAIL)
 	{
@@ -892,13 +1825,14 @@ EXPORT void HWRAPI(ReadRect) (INT32 x, INT32 y, INT32 width, INT32 height,
 #else
 	INT32 i;
 	// DBG_Printf ("ReadRect()\n");
+	FlushBatch();
 	if (dst_stride == width*3)
 	{
 		GLubyte*top = (GLvoid*)dst_data, *bottom = top + dst_stride * (height - 1);
 		GLubyte *row = malloc(dst_stride);
 		if (!row) return;
 		pglPixelStorei(GL_PACK_ALIGNMENT, 1);
-		pglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, dst_data);
+		ReadScreenPixels(x, y, width, height, top);
 		pglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		for(i = 0; i < height/2; i++)
 		{
@@ -916,7 +1850,7 @@ EXPORT void HWRAPI(ReadRect) (INT32 x, INT32 y, INT32 width, INT32 height,
 		GLubyte *image = malloc(width*height*3*sizeof (*image));
 		if (!image) return;
 		pglPixelStorei(GL_PACK_ALIGNMENT, 1);
-		pglReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, image);
+		ReadScreenPixels(x, y, width, height, image);
 		pglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		for (i = height-1; i >= 0; i--)
 		{
@@ -934,6 +1868,91 @@ EXPORT void HWRAPI(ReadRect) (INT32 x, INT32 y, INT32 width, INT32 height,
 #endif
 }
 
+#ifndef MINI_GL_COMPATIBILITY
+// Screens being read into pixel buffer objects, oldest first. The card
+// has until the ring comes back around to finish each one.
+#define MAXREADBACKS 3
+static GLuint readbackbuffers[MAXREADBACKS];
+static UINT32 readbacktags[MAXREADBACKS];
+static INT32 readbackhead = 0, numreadbacks = 0;
+static INT32 readbackwidth = 0, readbackheight = 0;
+#endif
+
+// -----------------+
+// ReadScreenAsync  : Starts reading the screen into a pixel buffer object,
+//                  : and collects the one started MAXREADBACKS-1 calls ago
+//                  : A width of 0 starts nothing, to collect the rest
+// Returns          : 1 if dst_data got 24bit 888 RGB rows from the top,
+//                  : with the tag it was started with in dst_tag,
+//                  : 0 if nothing was ready, -1 if it can't be done at all
+// -----------------+
+EXPORT INT32 HWRAPI(ReadScreenAsync) (INT32 width, INT32 height, UINT32 tag, UINT8 *dst_data, UINT32 *dst_tag)
+{
+#if defined (MINI_GL_COMPATIBILITY) || defined (KOS_GL_COMPATIBILITY)
+	(void)width;
+	(void)height;
+	(void)tag;
+	(void)dst_data;
+	(void)dst_tag;
+	return -1;
+#else
+	const GLubyte *src;
+	INT32 i, got = 0;
+
+	// ReadScreenPixels has to scale the scene on the CPU
+	if (!pixelbuffersupport || (scenebound && renderscale != 100))
+	{
+		numreadbacks = 0;
+		return -1;
+	}
+
+	FlushBatch();
+	if (width && (width != readbackwidth || height != readbackheight))
+	{
+		numreadbacks = 0; // those were a different size
+		readbackwidth = width;
+		readbackheight = height;
+	}
+
+	if (numreadbacks && (numreadbacks == MAXREADBACKS || !width))
+	{
+		const INT32 stride = readbackwidth*3;
+
+		pglBindBuffer(GL_PIXEL_PACK_BUFFER, readbackbuffers[readbackhead]);
+		src = pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if (src)
+		{
+			// GL reads from the bottom up
+			for (i = 0; i < readbackheight; i++)
+				memcpy(dst_data + i*stride, src + (readbackheight-1-i)*stride, stride);
+			if (pglUnmapBuffer(GL_PIXEL_PACK_BUFFER))
+			{
+				*dst_tag = readbacktags[readbackhead];
+				got = 1;
+			}
+		}
+		readbackhead = (readbackhead + 1) % MAXREADBACKS;
+		numreadbacks--;
+	}
+
+	if (width)
+	{
+		i = (readbackhead + numreadbacks) % MAXREADBACKS;
+		if (!readbackbuffers[0])
+			pglGenBuffers(MAXREADBACKS, readbackbuffers);
+		pglBindBuffer(GL_PIXEL_PACK_BUFFER, readbackbuffers[i]);
+		pglBufferData(GL_PIXEL_PACK_BUFFER, width*height*3, NULL, GL_STREAM_READ);
+		pglPixelStorei(GL_PACK_ALIGNMENT, 1);
+		pglReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL); // into the buffer
+		readbacktags[i] = tag;
+		numreadbacks++;
+	}
+
+	pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0); // or every other read would go into it
+	return got;
+#endif
+}
+
 
 // -----------------+
 // GClipRect        : Defines the 2D hardware clipping window
@@ -941,8 +1960,9 @@ EXPORT void HWRAPI(ReadRect) (INT32 x, INT32 y, INT32 width, INT32 height,
 EXPORT void HWRAPI(GClipRect) (INT32 minx, INT32 miny, INT32 maxx, INT32 maxy, float nearclip)
 {
 	// DBG_Printf ("GClipRect(%d, %d, %d, %d)\n", minx, miny, maxx, maxy);
+	FlushBatch();
 
-	pglViewport(minx, screen_height-maxy, maxx-minx, maxy-miny);
+	SetViewport(minx, screen_height-maxy, maxx-minx, maxy-miny);
 	NEAR_CLIPPING_PLANE = nearclip;
 
 	//pglScissor(minx, screen_height-maxy, maxx-minx, maxy-miny);
@@ -969,6 +1989,8 @@ EXPORT void HWRAPI(ClearBuffer) (FBOOLEAN ColorMask,
 	// DBG_Printf ("ClearBuffer(%d)\n", alpha);
 	GLbitfield ClearMask = 0;
 
+	FlushBatch();
+
 	if (ColorMask)
 	{
 		if (ClearColor)
@@ -1012,6 +2034,7 @@ EXPORT void HWRAPI(Draw2DLine) (F2DCoord * v1,
 	// BP: we should reflect the new state in our variable
 	//SetBlend(PF_Modulated|PF_NoTexture);
 
+	FlushBatch();
 	pglDisable(GL_TEXTURE_2D);
 
 	c.red   = byte2float[Color.s.red];
@@ -1021,6 +2044,7 @@ EXPORT void HWRAPI(Draw2DLine) (F2DCoord * v1,
 
 #ifndef MINI_GL_COMPATIBILITY
 	pglColor4fv(&c.red);    // is in RGBA float format
+	CountDraw(2);
 	pglBegin(GL_LINES);
 		pglVertex3f(v1->x, -v1->y, 1.0f);
 		pglVertex3f(v2->x, -v2->y, 1.0f);
@@ -1039,6 +2063,7 @@ EXPORT void HWRAPI(Draw2DLine) (F2DCoord * v1,
 	px4 = v1->x + dx;  py4 = v1->y - dy;
 
 	pglColor4f(c.red, c.green, c.blue, c.alpha);
+	CountDraw(4);
 	pglBegin(GL_TRIANGLE_FAN);
 		pglVertex3f(px1, -py1, 1);
 		pglVertex3f(px2, -py2, 1);
@@ -1058,6 +2083,69 @@ static void Clamp2D(GLenum pname)
 #endif
 }
 
+#ifndef MINI_GL_COMPATIBILITY
+// The scene is drawn into scenefbo, at renderscale percent of the size of
+// the screen. DrawScreenFinalTexture scales it up to the window straight
+// from scenetexture, and the screen textures for wipes are copied out of it,
+// so nothing is copied out of the window every frame.
+static boolean MakeSceneBuffer(void)
+{
+	FlushBatch();
+
+	pglGenFramebuffers(1, &scenefbo);
+	pglGenRenderbuffers(1, &scenedepth);
+
+	scenetexture = SCRTEX_SCENETEXTURE;
+	scenefilter = GL_NEAREST;
+	pglBindTexture(GL_TEXTURE_2D, scenetexture);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, scenefilter);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, scenefilter);
+	Clamp2D(GL_TEXTURE_WRAP_S);
+	Clamp2D(GL_TEXTURE_WRAP_T);
+	pglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, screen_width, screen_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	tex_downloaded = scenetexture;
+
+	pglBindRenderbuffer(GL_RENDERBUFFER, scenedepth);
+	pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, screen_width, screen_height);
+	pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	pglBindFramebuffer(GL_FRAMEBUFFER, scenefbo);
+	pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scenetexture, 0);
+	pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scenedepth);
+	if (pglCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		DBG_Printf("MakeSceneBuffer: framebuffer is incomplete, drawing to the window instead\n");
+		DeleteSceneBuffer();
+		framebuffersupport = false; // don't try again every frame
+		return false;
+	}
+
+	scenebound = true;
+	pglClear(GL_COLOR_BUFFER_BIT);
+	return true;
+}
+
+// Called at the end of every frame
+static void UpdateSceneBuffer(void)
+{
+	// Only if the platform code draws the window through DrawScreenFinalTexture
+	const boolean wanted = (scenebuffer && framebuffersupport && finaltextureused);
+	const boolean wasbound = scenebound;
+
+	finaltextureused = false;
+	if (wanted && !scenefbo)
+		MakeSceneBuffer();
+	else if (!wanted && scenefbo)
+		DeleteSceneBuffer();
+
+	if (renderscale != nextrenderscale || scenebound != wasbound)
+	{
+		renderscale = nextrenderscale;
+		SetViewport(lastviewport[0], lastviewport[1], lastviewport[2], lastviewport[3]);
+	}
+}
+#endif
+
 
 // -----------------+
 // SetBlend         : Set render mode
@@ -1070,6 +2158,8 @@ EXPORT void HWRAPI(SetBlend) (FBITFIELD PolyFlags)
 	Xor = CurrentPolyFlags^PolyFlags;
 	if (Xor & (PF_Blending|PF_RemoveYWrap|PF_ForceWrapX|PF_ForceWrapY|PF_Occlude|PF_NoTexture|PF_Modulated|PF_NoDepthTest|PF_Decal|PF_Invisible|PF_NoAlphaTest))
 	{
+		FlushBatch();
+		curstats.statechanges++;
 		if (Xor&(PF_Blending)) // if blending mode must be changed
 		{
 			switch (PolyFlags & PF_Blending) {
@@ -1181,7 +2271,12 @@ EXPORT void HWRAPI(SetBlend) (FBITFIELD PolyFlags)
 			if (oglflags & GLF_NOTEXENV)
 			{
 				if (!(PolyFlags & PF_Modulated))
+				{
 					pglColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+#ifdef POLYBATCHING
+					batchcolor.red = batchcolor.green = batchcolor.blue = batchcolor.alpha = 1.0f;
+#endif
+				}
 			}
 			else
 #endif
@@ -1228,347 +2323,678 @@ EXPORT void HWRAPI(SetBlend) (FBITFIELD PolyFlags)
 
 
 // -----------------+
-// SetTexture       : The mipmap becomes the current texture source
+// TextureBytes     : Roughly how much memory a downloaded texture takes up
 // -----------------+
-EXPORT void HWRAPI(SetTexture) (FTextureInfo *pTexInfo)
+#ifdef POLYBATCHING
+// Whether the texture is (to be) sent as palette indices
+static boolean IsIndexedTexture(const FTextureInfo *pTexInfo)
 {
-	if (!pTexInfo)
+	return (INDEXEDTEXTURES && (pTexInfo->grInfo.format == GR_TEXFMT_P_8
+		|| pTexInfo->grInfo.format == GR_TEXFMT_AP_88));
+}
+#endif
+
+static UINT32 TextureBytes(const FTextureInfo *pTexInfo)
+{
+	UINT32 bytes = pTexInfo->width * pTexInfo->height;
+
+#ifdef POLYBATCHING
+	if (IsIndexedTexture(pTexInfo)) // no mipmaps either
+		return (pTexInfo->grInfo.format == GR_TEXFMT_AP_88) ? bytes*2 : bytes;
+#endif
+	if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+		bytes *= 2;
+	else if (pTexInfo->grInfo.format != GR_TEXFMT_ALPHA_8)
+		bytes *= 4;
+#ifndef KOS_GL_COMPATIBILITY
+	if (MipMap)
+		bytes += bytes/3;
+#endif
+	return bytes;
+}
+
+static void AccountTexture(const FTextureInfo *pTexInfo, boolean add)
+{
+	const UINT32 bytes = TextureBytes(pTexInfo);
+	const UINT8 category = pTexInfo->category < NUMTEXTURECATEGORIES ? pTexInfo->category : TC_OTHER;
+
+	if (add)
 	{
-		SetNoTexture();
-		return;
+		texturebytes[category] += bytes;
+		totaltexturebytes += bytes;
 	}
-	else if (pTexInfo->downloaded)
+	else
 	{
-		if (pTexInfo->downloaded != tex_downloaded)
+		texturebytes[category] -= bytes;
+		totaltexturebytes -= bytes;
+	}
+}
+
+// -----------------+
+// EvictTextures    : Delete the least recently bound textures until they're
+//                  : under the budget. The game makes them again when it needs
+//                  : them, as if they were flushed. What this frame uses stays,
+//                  : even if that's over the budget.
+// -----------------+
+static void EvictTextures(void)
+{
+	while (totaltexturebytes > texturebudget)
+	{
+		FTextureInfo *tmp, *prev = NULL, *lru = NULL, *lruprev = NULL;
+
+		for (tmp = gr_cachehead; tmp; prev = tmp, tmp = tmp->nextmipmap)
 		{
-			pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
-			tex_downloaded = pTexInfo->downloaded;
+			if (tmp->lastused != textureframe && (!lru || tmp->lastused < lru->lastused))
+			{
+				lru = tmp;
+				lruprev = prev;
+			}
 		}
+		if (!lru)
+			break;
+
+		if (lruprev)
+			lruprev->nextmipmap = lru->nextmipmap;
+		else
+			gr_cachehead = lru->nextmipmap;
+		if (gr_cachetail == lru)
+			gr_cachetail = lruprev;
+		lru->nextmipmap = NULL;
+
+		if (tex_downloaded == lru->downloaded)
+			tex_downloaded = 0;
+		pglDeleteTextures(1, (GLuint *)&lru->downloaded);
+		AccountTexture(lru, false);
+		lru->downloaded = 0;
+		textureevictions++;
+	}
+}
+
+// ==========================================================================
+// Wall and flat textures seen for the first time are converted straight
+// away, but copied into a pixel buffer object instead of being sent to the
+// card. Until the end of the frame they're one texel of their average
+// colour; then the real upload is started from the buffer, and the driver
+// can copy it in while the next frame is being set up. Textures with holes,
+// or with mipmaps built by GLU from client memory, still go up at once.
+// ==========================================================================
+
+#ifndef MINI_GL_COMPATIBILITY
+// Puts the converted texture in a buffer to be uploaded at the end of the
+// frame, with a placeholder in the bound texture until then.
+// Returns false if it has to be uploaded now.
+static boolean QueueUpload(const FTextureInfo *pTexInfo, const RGBA_t *ptex, GLsizei w, GLsizei h)
+{
+	const UINT32 n = (UINT32)(w*h);
+	UINT32 i, red = 0, green = 0, blue = 0;
+	RGBA_t *dest, average;
+	GLboolean unmapped;
+
+	if (!pixelbuffersupport || !asyncuploads || numpendinguploads == MAXPENDINGUPLOADS)
+		return false;
+	if (pTexInfo->category != TC_WALL && pTexInfo->category != TC_FLAT)
+		return false;
+	if (pTexInfo->flags & TF_TRANSPARENT) // the placeholder would fill in the holes
+		return false;
+
+	if (!uploadbuffers[0])
+		pglGenBuffers(MAXPENDINGUPLOADS, uploadbuffers);
+
+	pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadbuffers[numpendinguploads]);
+	pglBufferData(GL_PIXEL_UNPACK_BUFFER, n * sizeof (RGBA_t), NULL, GL_STREAM_DRAW);
+	dest = pglMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if (!dest)
+	{
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+	for (i = 0; i < n; i++)
+	{
+		dest[i] = ptex[i];
+		red += ptex[i].s.red;
+		green += ptex[i].s.green;
+		blue += ptex[i].s.blue;
+	}
+	unmapped = pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // or every other upload would read from it
+	if (!unmapped) // the buffer's contents were lost
+		return false;
+
+	average.s.red = (UINT8)(red / n);
+	average.s.green = (UINT8)(green / n);
+	average.s.blue = (UINT8)(blue / n);
+	average.s.alpha = 0xff;
+	pglTexImage2D(GL_TEXTURE_2D, 0, textureformatGL, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &average);
+
+	pendinguploads[numpendinguploads].texname = pTexInfo->downloaded;
+	pendinguploads[numpendinguploads].width = w;
+	pendinguploads[numpendinguploads].height = h;
+	numpendinguploads++;
+	return true;
+}
+
+// Starts the uploads queued during the frame.
+static void FinishUploads(void)
+{
+	INT32 i;
+
+	if (!numpendinguploads)
+		return;
+
+	FlushBatch();
+	for (i = 0; i < numpendinguploads; i++)
+	{
+		pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadbuffers[i]);
+		pglBindTexture(GL_TEXTURE_2D, pendinguploads[i].texname);
+		pglTexImage2D(GL_TEXTURE_2D, 0, textureformatGL, pendinguploads[i].width, pendinguploads[i].height,
+			0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // from the start of the buffer
 	}
+	pglBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	tex_downloaded = pendinguploads[numpendinguploads-1].texname;
+	numpendinguploads = 0;
+}
+#endif
+
+// ==========================================================================
+// Render statistics. Each MarkRenderSection puts a timestamp query in the
+// card's command stream, the end of the frame puts one more, and the time
+// between two is added to the section started by the first. A frame's
+// timestamps are only read when its slot comes round again, RENDERSTATFRAMES
+// frames later, by when the card has long finished with it.
+// ==========================================================================
+
+#ifndef MINI_GL_COMPATIBILITY
+// Adds up the times of a frame whose timestamps were all taken.
+// Leaves the last times alone if the card hasn't got to them yet.
+static void ReadRenderTimes(statframe_t *frame)
+{
+	UINT64 stamps[MAXSECTIONMARKS+1];
+	GLint available = 0;
+	INT32 i;
+
+	pglGetQueryObjectiv(frame->queries[frame->nummarks], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	for (i = 0; i <= frame->nummarks; i++)
+		pglGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &stamps[i]);
+
+	memset(laststats.gputime, 0, sizeof (laststats.gputime));
+	for (i = 0; i < frame->nummarks; i++)
+		laststats.gputime[frame->sections[i]] += (UINT32)((stamps[i+1] - stamps[i]) / 1000); // nanoseconds
+}
+
+static void FinishRenderStats(void)
+{
+	statframe_t *frame = &statframes[curstatframe];
+
+	if (frame->nummarks)
+		pglQueryCounter(frame->queries[frame->nummarks], GL_TIMESTAMP);
+
+	curstatframe = (curstatframe + 1) % RENDERSTATFRAMES;
+	frame = &statframes[curstatframe];
+	if (frame->nummarks)
+		ReadRenderTimes(frame);
+	frame->nummarks = 0;
+
+	if (gputimers && timersupport)
+		MarkRenderSection(RS_OTHER);
+}
+#endif
+
+// -----------------+
+// ReadyToSwap      : Whether the buffers can be swapped without waiting
+//                  : for the last swap, with swapnowait. If not, the frame
+//                  : isn't shown and the next one is drawn over it.
+// -----------------+
+boolean ReadyToSwap(void)
+{
+#ifndef MINI_GL_COMPATIBILITY
+	if (!swapfence)
+		return true;
+	if (swapnowait && pglClientWaitSync(swapfence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+		return false;
+	pglDeleteSync(swapfence);
+	swapfence = NULL;
+#endif
+	return true;
+}
+
+// -----------------+
+// SwapMade         : Called right after swapping the buffers
+// -----------------+
+void SwapMade(void)
+{
+#ifndef MINI_GL_COMPATIBILITY
+	// The card gets past this when the swap is done with, which is at
+	// the vertical blank if it waited for one
+	if (swapnowait && syncsupport && !swapfence)
+		swapfence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+}
+
+// -----------------+
+// FinishFrame      : Called once the buffers have been swapped
+// -----------------+
+void FinishFrame(void)
+{
+	memcpy(&laststats, &curstats, offsetof(FRenderStats, gputimers)); // just the counts
+	memset(&curstats, 0, sizeof (curstats));
+#ifndef MINI_GL_COMPATIBILITY
+	FinishRenderStats();
+	FinishUploads();
+	UpdateSceneBuffer();
+#endif
+	textureframe++; // textures bound from now on count as used in a new frame
+}
+
+static void SetTextureWrap(const FTextureInfo *pTexInfo)
+{
+	if (pTexInfo->flags & TF_WRAPX)
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	else
+		Clamp2D(GL_TEXTURE_WRAP_S);
+
+	if (pTexInfo->flags & TF_WRAPY)
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	else
+		Clamp2D(GL_TEXTURE_WRAP_T);
+
+	if (maximumAnisotropy)
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropic_filter);
+}
+
+#ifdef POLYBATCHING
+// Sends a palettized texture as it is, for paletteprogram to draw
+static void UploadIndexedTexture(FTextureInfo *pTexInfo)
+{
+	const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+	const boolean alpha = (pTexInfo->grInfo.format == GR_TEXFMT_AP_88);
+	const INT32 n = pTexInfo->width * pTexInfo->height;
+	INT32 i;
+
+	if (pTexInfo->flags & TF_CHROMAKEYED)
 	{
-		// Download a mipmap
+		for (i = 0; i < n; i++)
+			if (pImgData[alpha ? 2*i : i] == HWR_PATCHES_CHROMAKEY_COLORINDEX)
+			{
+				pTexInfo->flags |= TF_TRANSPARENT; // there is a hole in it
+				break;
+			}
+	}
+
+	tex_downloaded = pTexInfo->downloaded;
+	pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	pglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (alpha)
+		pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8_ALPHA8, pTexInfo->width, pTexInfo->height,
+			0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, pImgData);
+	else
+		pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, pTexInfo->width, pTexInfo->height,
+			0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pImgData);
+	pglPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	SetTextureWrap(pTexInfo);
+}
+#endif
+
+// -----------------+
+// UploadTexture    : Convert a mipmap and send it to the texture name it has
+//                  : async: it may be sent at the end of the frame instead
+// -----------------+
+static void UploadTexture(FTextureInfo *pTexInfo, boolean async)
+{
 #ifdef KOS_GL_COMPATIBILITY
-		static GLushort tex[2048*2048];
+	static GLushort tex[2048*2048];
 #else
-		static RGBA_t   tex[2048*2048];
+	static RGBA_t   tex[2048*2048];
 #endif
-		const GLvoid   *ptex = tex;
-		INT32             w, h;
+	const GLvoid   *ptex = tex;
+	INT32             w, h;
 
-		//DBG_Printf ("DownloadMipmap %d %x\n",NextTexAvail,pTexInfo->grInfo.data);
+	//DBG_Printf ("DownloadMipmap %d %x\n",NextTexAvail,pTexInfo->grInfo.data);
 
-		w = pTexInfo->width;
-		h = pTexInfo->height;
+	w = pTexInfo->width;
+	h = pTexInfo->height;
+
+#ifdef POLYBATCHING
+	if (IsIndexedTexture(pTexInfo))
+	{
+		UploadIndexedTexture(pTexInfo);
+		return;
+	}
+#endif
 
 #ifdef USE_PALETTED_TEXTURE
-		if (glColorTableEXT &&
-			(pTexInfo->grInfo.format == GR_TEXFMT_P_8) &&
-			!(pTexInfo->flags & TF_CHROMAKEYED))
-		{
-			// do nothing here.
-			// Not a problem with MiniGL since we don't use paletted texture
-		}
-		else
+	if (glColorTableEXT &&
+		(pTexInfo->grInfo.format == GR_TEXFMT_P_8) &&
+		!(pTexInfo->flags & TF_CHROMAKEYED))
+	{
+		// do nothing here.
+		// Not a problem with MiniGL since we don't use paletted texture
+	}
+	else
 #endif
 #ifdef KOS_GL_COMPATIBILITY
-		if ((pTexInfo->grInfo.format == GR_TEXFMT_P_8) ||
-			(pTexInfo->grInfo.format == GR_TEXFMT_AP_88))
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	if ((pTexInfo->grInfo.format == GR_TEXFMT_P_8) ||
+		(pTexInfo->grInfo.format == GR_TEXFMT_AP_88))
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
+				if ((*pImgData == HWR_PATCHES_CHROMAKEY_COLORINDEX) &&
+				    (pTexInfo->flags & TF_CHROMAKEYED))
 				{
-					if ((*pImgData == HWR_PATCHES_CHROMAKEY_COLORINDEX) &&
-					    (pTexInfo->flags & TF_CHROMAKEYED))
-					{
+					tex[w*j+i] = 0;
+				}
+				else
+				{
+					if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88 && !(pTexInfo->flags & TF_CHROMAKEYED))
 						tex[w*j+i] = 0;
-					}
 					else
-					{
-						if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88 && !(pTexInfo->flags & TF_CHROMAKEYED))
-							tex[w*j+i] = 0;
-						else
-							tex[w*j+i] = (myPaletteData[*pImgData].s.alpha>>4)<<12;
-
-						tex[w*j+i] |= (myPaletteData[*pImgData].s.red  >>4)<<8;
-						tex[w*j+i] |= (myPaletteData[*pImgData].s.green>>4)<<4;
-						tex[w*j+i] |= (myPaletteData[*pImgData].s.blue >>4);
-					}
+						tex[w*j+i] = (myPaletteData[*pImgData].s.alpha>>4)<<12;
 
-					pImgData++;
+					tex[w*j+i] |= (myPaletteData[*pImgData].s.red  >>4)<<8;
+					tex[w*j+i] |= (myPaletteData[*pImgData].s.green>>4)<<4;
+					tex[w*j+i] |= (myPaletteData[*pImgData].s.blue >>4);
+				}
 
-					if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88)
-					{
-						if (!(pTexInfo->flags & TF_CHROMAKEYED))
-							tex[w*j+i] |= ((*pImgData)>>4)<<12;
-						pImgData++;
-					}
+				pImgData++;
 
+				if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88)
+				{
+					if (!(pTexInfo->flags & TF_CHROMAKEYED))
+						tex[w*j+i] |= ((*pImgData)>>4)<<12;
+					pImgData++;
 				}
+
 			}
 		}
-		else if (pTexInfo->grInfo.format == GR_RGBA)
-		{
-			// corona test : passed as ARGB 8888, which is not in glide formats
-			// Hurdler: not used for coronas anymore, just for dynamic lighting
-			const RGBA_t *pImgData = (const RGBA_t *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	}
+	else if (pTexInfo->grInfo.format == GR_RGBA)
+	{
+		// corona test : passed as ARGB 8888, which is not in glide formats
+		// Hurdler: not used for coronas anymore, just for dynamic lighting
+		const RGBA_t *pImgData = (const RGBA_t *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
-				{
-					tex[w*j+i]  = (pImgData->s.alpha>>4)<<12;
-					tex[w*j+i] |= (pImgData->s.red  >>4)<<8;
-					tex[w*j+i] |= (pImgData->s.green>>4)<<4;
-					tex[w*j+i] |= (pImgData->s.blue >>4);
-					pImgData++;
-				}
+				tex[w*j+i]  = (pImgData->s.alpha>>4)<<12;
+				tex[w*j+i] |= (pImgData->s.red  >>4)<<8;
+				tex[w*j+i] |= (pImgData->s.green>>4)<<4;
+				tex[w*j+i] |= (pImgData->s.blue >>4);
+				pImgData++;
 			}
 		}
-		else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	}
+	else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
-				{
-					const GLubyte sID = (*pImgData)>>4;
-					tex[w*j+i] = sID<<8 | sID<<4 | sID;
-					pImgData++;
-					tex[w*j+i] |= ((*pImgData)>>4)<<12;
-					pImgData++;
-				}
+				const GLubyte sID = (*pImgData)>>4;
+				tex[w*j+i] = sID<<8 | sID<<4 | sID;
+				pImgData++;
+				tex[w*j+i] |= ((*pImgData)>>4)<<12;
+				pImgData++;
 			}
 		}
-		else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8) // Used for fade masks
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	}
+	else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8) // Used for fade masks
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
-				{
-					tex[w*j+i]  = (pImgData>>4)<<12;
-					tex[w*j+i] |= (255>>4)<<8;
-					tex[w*j+i] |= (255>>4)<<4;
-					tex[w*j+i] |= (255>>4);
-					pImgData++;
-				}
+				tex[w*j+i]  = (pImgData>>4)<<12;
+				tex[w*j+i] |= (255>>4)<<8;
+				tex[w*j+i] |= (255>>4)<<4;
+				tex[w*j+i] |= (255>>4);
+				pImgData++;
 			}
 		}
-		else
-			DBG_Printf ("SetTexture(bad format) %ld\n", pTexInfo->grInfo.format);
+	}
+	else
+		DBG_Printf ("SetTexture(bad format) %ld\n", pTexInfo->grInfo.format);
 #else
-		if ((pTexInfo->grInfo.format == GR_TEXFMT_P_8) ||
-			(pTexInfo->grInfo.format == GR_TEXFMT_AP_88))
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	if ((pTexInfo->grInfo.format == GR_TEXFMT_P_8) ||
+		(pTexInfo->grInfo.format == GR_TEXFMT_AP_88))
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
+				if ((*pImgData == HWR_PATCHES_CHROMAKEY_COLORINDEX) &&
+				    (pTexInfo->flags & TF_CHROMAKEYED))
 				{
-					if ((*pImgData == HWR_PATCHES_CHROMAKEY_COLORINDEX) &&
-					    (pTexInfo->flags & TF_CHROMAKEYED))
-					{
-						tex[w*j+i].s.red   = 0;
-						tex[w*j+i].s.green = 0;
-						tex[w*j+i].s.blue  = 0;
-						tex[w*j+i].s.alpha = 0;
-						pTexInfo->flags |= TF_TRANSPARENT; // there is a hole in it
-					}
-					else
-					{
-						tex[w*j+i].s.red   = myPaletteData[*pImgData].s.red;
-						tex[w*j+i].s.green = myPaletteData[*pImgData].s.green;
-						tex[w*j+i].s.blue  = myPaletteData[*pImgData].s.blue;
-						tex[w*j+i].s.alpha = myPaletteData[*pImgData].s.alpha;
-					}
-
-					pImgData++;
+					tex[w*j+i].s.red   = 0;
+					tex[w*j+i].s.green = 0;
+					tex[w*j+i].s.blue  = 0;
+					tex[w*j+i].s.alpha = 0;
+					pTexInfo->flags |= TF_TRANSPARENT; // there is a hole in it
+				}
+				else
+				{
+					tex[w*j+i].s.red   = myPaletteData[*pImgData].s.red;
+					tex[w*j+i].s.green = myPaletteData[*pImgData].s.green;
+					tex[w*j+i].s.blue  = myPaletteData[*pImgData].s.blue;
+					tex[w*j+i].s.alpha = myPaletteData[*pImgData].s.alpha;
+				}
 
-					if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88)
-					{
-						if (!(pTexInfo->flags & TF_CHROMAKEYED))
-							tex[w*j+i].s.alpha = *pImgData;
-						pImgData++;
-					}
+				pImgData++;
 
+				if (pTexInfo->grInfo.format == GR_TEXFMT_AP_88)
+				{
+					if (!(pTexInfo->flags & TF_CHROMAKEYED))
+						tex[w*j+i].s.alpha = *pImgData;
+					pImgData++;
 				}
+
 			}
 		}
-		else if (pTexInfo->grInfo.format == GR_RGBA)
-		{
-			// corona test : passed as ARGB 8888, which is not in glide formats
-			// Hurdler: not used for coronas anymore, just for dynamic lighting
-			ptex = pTexInfo->grInfo.data;
-		}
-		else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	}
+	else if (pTexInfo->grInfo.format == GR_RGBA)
+	{
+		// corona test : passed as ARGB 8888, which is not in glide formats
+		// Hurdler: not used for coronas anymore, just for dynamic lighting
+		ptex = pTexInfo->grInfo.data;
+	}
+	else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
-				{
-					tex[w*j+i].s.red   = *pImgData;
-					tex[w*j+i].s.green = *pImgData;
-					tex[w*j+i].s.blue  = *pImgData;
-					pImgData++;
-					tex[w*j+i].s.alpha = *pImgData;
-					pImgData++;
-				}
+				tex[w*j+i].s.red   = *pImgData;
+				tex[w*j+i].s.green = *pImgData;
+				tex[w*j+i].s.blue  = *pImgData;
+				pImgData++;
+				tex[w*j+i].s.alpha = *pImgData;
+				pImgData++;
 			}
 		}
-		else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8) // Used for fade masks
-		{
-			const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
-			INT32 i, j;
+	}
+	else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8) // Used for fade masks
+	{
+		const GLubyte *pImgData = (const GLubyte *)pTexInfo->grInfo.data;
+		INT32 i, j;
 
-			for (j = 0; j < h; j++)
+		for (j = 0; j < h; j++)
+		{
+			for (i = 0; i < w; i++)
 			{
-				for (i = 0; i < w; i++)
-				{
-					tex[w*j+i].s.red   = 255; // 255 because the fade mask is modulated with the screen texture, so alpha affects it while the colours don't
-					tex[w*j+i].s.green = 255;
-					tex[w*j+i].s.blue  = 255;
-					tex[w*j+i].s.alpha = *pImgData;
-					pImgData++;
-				}
+				tex[w*j+i].s.red   = 255; // 255 because the fade mask is modulated with the screen texture, so alpha affects it while the colours don't
+				tex[w*j+i].s.green = 255;
+				tex[w*j+i].s.blue  = 255;
+				tex[w*j+i].s.alpha = *pImgData;
+				pImgData++;
 			}
 		}
-		else
-			DBG_Printf ("SetTexture(bad format) %ld\n", pTexInfo->grInfo.format);
+	}
+	else
+		DBG_Printf ("SetTexture(bad format) %ld\n", pTexInfo->grInfo.format);
 #endif
 
-		pTexInfo->downloaded = NextTexAvail++;
-		tex_downloaded = pTexInfo->downloaded;
-		pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
+	tex_downloaded = pTexInfo->downloaded;
+	pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
 
-		// disable texture filtering on any texture that has holes so there's no dumb borders or blending issues
-		if (pTexInfo->flags & TF_TRANSPARENT)
-		{
+	// disable texture filtering on any texture that has holes so there's no dumb borders or blending issues
+	if (pTexInfo->flags & TF_TRANSPARENT)
+	{
 #ifdef KOS_GL_COMPATIBILITY
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NONE);
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NONE);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NONE);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NONE);
 #else
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 #endif
-		}
-		else
-		{
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-		}
+	}
+	else
+	{
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+	}
 
 #ifdef KOS_GL_COMPATIBILITY
-		pglTexImage2D(GL_TEXTURE_2D, 0, GL_ARGB4444, w, h, 0, GL_ARGB4444, GL_UNSIGNED_BYTE, ptex);
+	pglTexImage2D(GL_TEXTURE_2D, 0, GL_ARGB4444, w, h, 0, GL_ARGB4444, GL_UNSIGNED_BYTE, ptex);
 #else
 #ifdef MINI_GL_COMPATIBILITY
-		//if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
-			//pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
-		//else
-			if (MipMap)
-				pgluBuild2DMipmaps(GL_TEXTURE_2D, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
-			else
-				pglTexImage2D(GL_TEXTURE_2D, 0, 4, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+	//if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+		//pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+	//else
+		if (MipMap)
+			pgluBuild2DMipmaps(GL_TEXTURE_2D, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+		else
+			pglTexImage2D(GL_TEXTURE_2D, 0, 4, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
 #else
 #ifdef USE_PALETTED_TEXTURE
-			//Hurdler: not really supported and not tested recently
-		if (glColorTableEXT &&
-			(pTexInfo->grInfo.format == GR_TEXFMT_P_8) &&
-			!(pTexInfo->flags & TF_CHROMAKEYED))
-		{
-			glColorTableEXT(GL_TEXTURE_2D, GL_RGB8, 256, GL_RGB, GL_UNSIGNED_BYTE, palette_tex);
-			pglTexImage2D(GL_TEXTURE_2D, 0, GL_COLOR_INDEX8_EXT, w, h, 0, GL_COLOR_INDEX, GL_UNSIGNED_BYTE, pTexInfo->grInfo.data);
-		}
-		else
+		//Hurdler: not really supported and not tested recently
+	if (glColorTableEXT &&
+		(pTexInfo->grInfo.format == GR_TEXFMT_P_8) &&
+		!(pTexInfo->flags & TF_CHROMAKEYED))
+	{
+		glColorTableEXT(GL_TEXTURE_2D, GL_RGB8, 256, GL_RGB, GL_UNSIGNED_BYTE, palette_tex);
+		pglTexImage2D(GL_TEXTURE_2D, 0, GL_COLOR_INDEX8_EXT, w, h, 0, GL_COLOR_INDEX, GL_UNSIGNED_BYTE, pTexInfo->grInfo.data);
+	}
+	else
 #endif
-		if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+	if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_INTENSITY_88)
+	{
+		//pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+		if (MipMap)
 		{
-			//pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
-			if (MipMap)
-			{
-				pgluBuild2DMipmaps(GL_TEXTURE_2D, GL_LUMINANCE_ALPHA, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+			pgluBuild2DMipmaps(GL_TEXTURE_2D, GL_LUMINANCE_ALPHA, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
 #ifdef GL_TEXTURE_MIN_LOD
-				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0);
+			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0);
 #endif
 #ifdef GL_TEXTURE_MAX_LOD
-				if (pTexInfo->flags & TF_TRANSPARENT)
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
-				else
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 4);
-#endif
-				//pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR_MIPMAP_LINEAR);
-			}
+			if (pTexInfo->flags & TF_TRANSPARENT)
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
 			else
-				pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 4);
+#endif
+			//pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR_MIPMAP_LINEAR);
 		}
-		else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8)
+		else
+			pglTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+	}
+	else if (pTexInfo->grInfo.format == GR_TEXFMT_ALPHA_8)
+	{
+		//pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+		if (MipMap)
 		{
-			//pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
-			if (MipMap)
-			{
-				pgluBuild2DMipmaps(GL_TEXTURE_2D, GL_ALPHA, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+			pgluBuild2DMipmaps(GL_TEXTURE_2D, GL_ALPHA, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
 #ifdef GL_TEXTURE_MIN_LOD
-				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0);
+			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0);
 #endif
 #ifdef GL_TEXTURE_MAX_LOD
-				if (pTexInfo->flags & TF_TRANSPARENT)
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
-				else
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 4);
-#endif
-				//pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR_MIPMAP_LINEAR);
-			}
+			if (pTexInfo->flags & TF_TRANSPARENT)
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
 			else
-				pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 4);
+#endif
+			//pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR_MIPMAP_LINEAR);
 		}
 		else
+			pglTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+	}
+	else
+	{
+		if (MipMap)
 		{
-			if (MipMap)
-			{
-				pgluBuild2DMipmaps(GL_TEXTURE_2D, textureformatGL, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
-				// Control the mipmap level of detail
+			pgluBuild2DMipmaps(GL_TEXTURE_2D, textureformatGL, w, h, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+			// Control the mipmap level of detail
 #ifdef GL_TEXTURE_MIN_LOD
-				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0); // the lower the number, the higer the detail
+			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0); // the lower the number, the higer the detail
 #endif
 #ifdef GL_TEXTURE_MAX_LOD
-				if (pTexInfo->flags & TF_TRANSPARENT)
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
-				else
-					pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 5);
-#endif
-			}
+			if (pTexInfo->flags & TF_TRANSPARENT)
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 0); // No mippmaps on transparent stuff
 			else
-				pglTexImage2D(GL_TEXTURE_2D, 0, textureformatGL, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+				pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 5);
+#endif
+		}
+		else if (!async || !QueueUpload(pTexInfo, ptex, w, h))
+			pglTexImage2D(GL_TEXTURE_2D, 0, textureformatGL, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptex);
+	}
+#endif
+#endif
+
+	SetTextureWrap(pTexInfo);
+}
+
+// -----------------+
+// SetTexture       : The mipmap becomes the current texture source
+// -----------------+
+EXPORT void HWRAPI(SetTexture) (FTextureInfo *pTexInfo)
+{
+	if (!pTexInfo)
+	{
+		SetNoTexture();
+		return;
+	}
+	else if (pTexInfo->downloaded)
+	{
+		if (pTexInfo->downloaded != tex_downloaded)
+		{
+			FlushBatch();
+			pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
+			tex_downloaded = pTexInfo->downloaded;
+			curstats.texturebinds++;
 		}
-#endif
-#endif
-
-		if (pTexInfo->flags & TF_WRAPX)
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		else
-			Clamp2D(GL_TEXTURE_WRAP_S);
-
-		if (pTexInfo->flags & TF_WRAPY)
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		else
-			Clamp2D(GL_TEXTURE_WRAP_T);
-
-		if (maximumAnisotropy)
-			pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropic_filter);
+		pTexInfo->lastused = textureframe;
+	}
+	else
+	{
+		FlushBatch();
+		pTexInfo->downloaded = NextTexAvail++;
+		pTexInfo->lastused = textureframe;
+		curstats.texturebinds++;
+		UploadTexture(pTexInfo, true);
+		AccountTexture(pTexInfo, true);
 
 		pTexInfo->nextmipmap = NULL;
 		if (gr_cachetail)
@@ -1578,7 +3004,22 @@ EXPORT void HWRAPI(SetTexture) (FTextureInfo *pTexInfo)
 		}
 		else // initialisation de la liste
 			gr_cachetail = gr_cachehead =  pTexInfo;
+
+		if (texturebudget)
+		{
+			EvictTextures();
+			if (tex_downloaded != pTexInfo->downloaded) // the bind was lost
+			{
+				pglBindTexture(GL_TEXTURE_2D, pTexInfo->downloaded);
+				tex_downloaded = pTexInfo->downloaded;
+			}
+		}
 	}
+#ifdef POLYBATCHING
+	indexedtex = IsIndexedTexture(pTexInfo) ? pTexInfo->downloaded : 0;
+	indexedchromakey = (pTexInfo->flags & TF_CHROMAKEYED) ? (GLfloat)HWR_PATCHES_CHROMAKEY_COLORINDEX : -1.0f;
+	nextcolormap = NULL;
+#endif
 #ifdef MINI_GL_COMPATIBILITY
 	switch (pTexInfo->flags)
 	{
@@ -1594,6 +3035,43 @@ EXPORT void HWRAPI(SetTexture) (FTextureInfo *pTexInfo)
 #endif
 }
 
+// -----------------+
+// UpdateTexture    : The mipmap's data has changed: send it again, to the
+//                  : texture it already has, and make it the current one
+// -----------------+
+EXPORT void HWRAPI(UpdateTexture) (FTextureInfo *pTexInfo)
+{
+	if (!pTexInfo->downloaded)
+	{
+		SetTexture(pTexInfo);
+		return;
+	}
+
+	FlushBatch(); // anything drawn with the old data goes first
+	pTexInfo->lastused = textureframe;
+	UploadTexture(pTexInfo, false);
+}
+
+
+// -----------------+
+// SetColormap      : Draw the texture set last through a colormap, until the
+//                  : next SetTexture. NULL for none.
+// Returns          : false if the texture isn't indexed, then the colormap
+//                  : has to be in the texture itself
+// -----------------+
+EXPORT boolean HWRAPI(SetColormap) (const UINT8 *colormap)
+{
+#ifdef POLYBATCHING
+	if (!IndexedTextureBound())
+		return false;
+	nextcolormap = colormap;
+	return true;
+#else
+	(void)colormap;
+	return false;
+#endif
+}
+
 
 // -----------------+
 // DrawPolygon      : Render a polygon, set the texture, set render mode
@@ -1619,6 +3097,10 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo  *pSurf,
 #endif
 
 	SetBlend(PolyFlags);    //TODO: inline (#pragma..)
+#ifdef POLYBATCHING
+	if (IndexedTextureBound())
+		UpdateColormap();
+#endif
 
 	// If Modulated, mix the surface colour to the texture
 	if ((CurrentPolyFlags & PF_Modulated) && pSurf)
@@ -1642,6 +3124,9 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo  *pSurf,
 		pglColor4f(c.red, c.green, c.blue, c.alpha);
 #else
 		pglColor4fv(&c.red);    // is in RGBA float format
+#endif
+#ifdef POLYBATCHING
+		batchcolor = c;
 #endif
 	}
 
@@ -1660,6 +3145,14 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo  *pSurf,
 		cy = (pOutVerts[0].y + pOutVerts[2].y) / 2.0f; // ... code so its only done once.
 		cz = pOutVerts[0].z;
 
+		// The depth buffer must have everything drawn so far. The coronas
+		// before this one don't write to it, so they can wait and all go
+		// in one batch.
+#ifdef POLYBATCHING
+		if (batchwritesdepth)
+#endif
+		FlushBatch();
+
 		// I dont know if this is slow or not
 		GLProject(cx, cy, cz, &px, &py, &pz);
 		//DBG_Printf("Projection: (%f, %f, %f)\n", px, py, pz);
@@ -1693,20 +3186,47 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo  *pSurf,
 
 		c.alpha *= scalef; // change the alpha value (it seems better than changing the size of the corona)
 		pglColor4fv(&c.red);
+#ifdef POLYBATCHING
+		batchcolor = c;
+#endif
 	}
 #endif
 	if (PolyFlags & PF_MD2)
 		return;
 
-	pglBegin(GL_TRIANGLE_FAN);
-	for (i = 0; i < iNumPts; i++)
+#ifdef POLYBATCHING
+	if (!(CurrentPolyFlags & PF_Modulated)) // the colour comes from the texture alone
+		c.red = c.green = c.blue = c.alpha = 1.0f;
+	else if (!pSurf)
+		c = batchcolor;
+
+	if (!BatchPolygon(pOutVerts, iNumPts, &c))
+#endif
 	{
-		pglTexCoord2f(pOutVerts[i].sow, pOutVerts[i].tow);
-		//Hurdler: test code: -pOutVerts[i].z => pOutVerts[i].z
-		pglVertex3f(pOutVerts[i].x, pOutVerts[i].y, pOutVerts[i].z);
-		//pglVertex3f(pOutVerts[i].x, pOutVerts[i].y, -pOutVerts[i].z);
+		FlushBatch();
+#ifdef POLYBATCHING
+		if (IndexedTextureBound())
+			StartIndexedDraw();
+#endif
+		CountDraw(iNumPts);
+		pglBegin(GL_TRIANGLE_FAN);
+		for (i = 0; i < iNumPts; i++)
+		{
+			pglTexCoord2f(pOutVerts[i].sow, pOutVerts[i].tow);
+			//Hurdler: test code: -pOutVerts[i].z => pOutVerts[i].z
+			pglVertex3f(pOutVerts[i].x, pOutVerts[i].y, pOutVerts[i].z);
+			//pglVertex3f(pOutVerts[i].x, pOutVerts[i].y, -pOutVerts[i].z);
+		}
+		pglEnd();
+#ifdef POLYBATCHING
+		if (IndexedTextureBound())
+			EndIndexedDraw();
+#endif
 	}
-	pglEnd();
+
+	// These put the texture parameters back right away
+	if (PolyFlags & (PF_RemoveYWrap|PF_ForceWrapX|PF_ForceWrapY))
+		FlushBatch();
 
 	if (PolyFlags & PF_RemoveYWrap)
 		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -1724,6 +3244,13 @@ EXPORT void HWRAPI(DrawPolygon) (FSurfaceInfo  *pSurf,
 // ==========================================================================
 EXPORT void HWRAPI(SetSpecialState) (hwdspecialstate_t IdState, INT32 Value)
 {
+#ifdef POLYBATCHING
+	// Batched polygons each keep their own fog for fogprogram
+	if (!(fogprogram && shaders && (IdState == HWD_SET_FOG_COLOR
+		|| IdState == HWD_SET_FOG_DENSITY || IdState == HWD_SET_FOG_MODE)))
+#endif
+	FlushBatch();
+
 	switch (IdState)
 	{
 
@@ -1755,10 +3282,19 @@ EXPORT void HWRAPI(SetSpecialState) (hwdspecialstate_t IdState, INT32 Value)
 			fogcolor[2] = byte2float[((Value)&0xff)];
 			fogcolor[3] = 0x0;
 			pglFogfv(GL_FOG_COLOR, fogcolor);
+#ifdef POLYBATCHING
+			batchfog.red = fogcolor[0];
+			batchfog.green = fogcolor[1];
+			batchfog.blue = fogcolor[2];
+#endif
 			break;
 		}
 		case HWD_SET_FOG_DENSITY:
 			pglFogf(GL_FOG_DENSITY, Value*1200/(500*1000000.0f));
+#ifdef POLYBATCHING
+			fogdensity = Value*1200/(500*1000000.0f);
+			batchfog.alpha = fogon ? fogdensity : 0.0f;
+#endif
 			break;
 
 		case HWD_SET_FOG_MODE:
@@ -1785,6 +3321,10 @@ EXPORT void HWRAPI(SetSpecialState) (hwdspecialstate_t IdState, INT32 Value)
 			}
 			else
 				pglDisable(GL_FOG);
+#ifdef POLYBATCHING
+			fogon = (Value != 0);
+			batchfog.alpha = fogon ? fogdensity : 0.0f;
+#endif
 			break;
 
 		case HWD_SET_POLYGON_SMOOTH:
@@ -1874,15 +3414,353 @@ EXPORT void HWRAPI(SetSpecialState) (hwdspecialstate_t IdState, INT32 Value)
 				Flush(); //??? if we want to change filter mode by texture, remove this
 			break;
 
+#ifndef MINI_GL_COMPATIBILITY
+		case HWD_SET_ASYNCUPLOADS:
+			asyncuploads = (Value != 0);
+			break;
+
+		case HWD_SET_GPUTIMERS:
+			gputimers = (Value != 0);
+			break;
+
+		case HWD_SET_SCENEBUFFER: // from the next frame on
+			scenebuffer = (Value != 0);
+			break;
+
+		case HWD_SET_RENDERSCALE: // in percent, from the next frame on
+			nextrenderscale = min(max(Value, 1), 100);
+			break;
+
+		case HWD_SET_SWAPNOWAIT:
+			swapnowait = (Value != 0);
+			break;
+
+#ifdef POLYBATCHING
+		case HWD_SET_SHADERS:
+		case HWD_SET_INDEXEDTEXTURES:
+		{
+			const boolean wasindexed = INDEXEDTEXTURES;
+
+			if (IdState == HWD_SET_SHADERS)
+				shaders = (Value != 0);
+			else
+				indexedtextures = (Value != 0);
+			if (INDEXEDTEXTURES != wasindexed) // every texture has to be sent again
+				Flush();
+			break;
+		}
+#endif
+#endif
+
+		case HWD_SET_TEXTUREBUDGET: // in megabytes
+			texturebudget = (UINT32)Value<<20;
+			if (texturebudget)
+				EvictTextures();
+			break;
+
 		default:
 			break;
 	}
 }
 
+// -----------------+
+// SetBlendedTexture: Set up a model texture to have a skin colour blended in
+//                  : as it's drawn. Unit 0 has the texture with the part of the
+//                  : blend that doesn't depend on the colour already mixed in,
+//                  : unit 1 mixes in the colour by the mask, and unit 2 lights
+//                  : the result. Lasts until the next model is drawn.
+// Returns          : false if the card can't, then the blend is left to the caller
+// -----------------+
+EXPORT boolean HWRAPI(SetBlendedTexture) (FTextureInfo *pTexInfo, FTextureInfo *pMaskInfo, RGBA_t color)
+{
+#ifndef MINI_GL_COMPATIBILITY
+	GLfloat envcolor[4];
+	GLuint masktex;
+
+	if (!skinblendsupport || (oglflags & GLF_NOTEXENV))
+		return false;
+
+	FlushBatch();
+	SetTexture(pMaskInfo); // download it the usual way
+	masktex = tex_downloaded;
+	SetTexture(pTexInfo);
+
+	envcolor[0] = color.s.red/255.0f;
+	envcolor[1] = color.s.green/255.0f;
+	envcolor[2] = color.s.blue/255.0f;
+	envcolor[3] = 1.0f;
+
+	// colour * mask + previous * (1 - mask)
+	pglActiveTexture(GL_TEXTURE1);
+	pglEnable(GL_TEXTURE_2D);
+	pglBindTexture(GL_TEXTURE_2D, masktex);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_INTERPOLATE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_CONSTANT);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_PREVIOUS);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE2_RGB, GL_TEXTURE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND2_RGB, GL_SRC_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_REPLACE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_PREVIOUS);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+	pglTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, envcolor);
+
+	// previous * lighting. The unit needs a texture to be enabled at all,
+	// but doesn't read it.
+	pglActiveTexture(GL_TEXTURE2);
+	pglEnable(GL_TEXTURE_2D);
+	pglBindTexture(GL_TEXTURE_2D, masktex);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_PRIMARY_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_MODULATE);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_ALPHA, GL_PREVIOUS);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_ALPHA, GL_SRC_ALPHA);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_ALPHA, GL_PRIMARY_COLOR);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_ALPHA, GL_SRC_ALPHA);
+
+	pglActiveTexture(GL_TEXTURE0);
+	skinblending = true;
+	return true;
+#else
+	(void)pTexInfo;
+	(void)pMaskInfo;
+	(void)color;
+	return false;
+#endif
+}
+
+#ifndef MINI_GL_COMPATIBILITY
+static void EndSkinBlend(void)
+{
+	pglActiveTexture(GL_TEXTURE2);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	pglDisable(GL_TEXTURE_2D);
+	pglActiveTexture(GL_TEXTURE1);
+	pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	pglDisable(GL_TEXTURE_2D);
+	pglActiveTexture(GL_TEXTURE0);
+	// DrawMD2Ex replaced the colour on unit 0, put back what SetBlend thinks it is
+	pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, (CurrentPolyFlags & PF_Modulated) ? GL_MODULATE : GL_REPLACE);
+	skinblending = false;
+}
+#endif
+
+#ifdef POLYBATCHING
+// ==========================================================================
+//                                                                MD2 MESHES
+// ==========================================================================
+// The first time a model is drawn, its gl commands are turned into a single
+// indexed triangle list, so the model is drawn with one call instead of one
+// glVertex per command. The texture coordinates and indices never change
+// and go in buffer objects when there are any; only the positions and
+// normals of the (interpolated) frame are sent every draw.
+
+typedef struct md2mesh_s
+{
+	INT32 *gl_cmd_buffer; // the model this mesh was made from
+	GLsizei numverts, numindices;
+	INT32 *pindex; // frame vertex of each mesh vertex
+	GLfloat *texcoords;
+	GLuint *indices;
+	GLfloat *positions, *normals; // filled in every draw
+	GLuint buffers[2]; // texture coordinates and indices
+	struct md2mesh_s *next;
+} md2mesh_t;
+
+static md2mesh_t *md2meshes = NULL;
+
+static md2mesh_t *GetMD2Mesh(INT32 *gl_cmd_buffer)
+{
+	md2mesh_t *mesh;
+	INT32 *cmd, val, count, i;
+	GLsizei numverts = 0, numindices = 0;
+	GLuint *index;
+
+	for (mesh = md2meshes; mesh; mesh = mesh->next)
+		if (mesh->gl_cmd_buffer == gl_cmd_buffer)
+			return mesh;
+
+	for (cmd = gl_cmd_buffer; (val = *cmd++) != 0; cmd += 3*count)
+	{
+		count = abs(val);
+		numverts += count;
+		if (count > 2)
+			numindices += (count-2)*3;
+	}
+
+	mesh = calloc(1, sizeof (*mesh));
+	if (!mesh)
+		return NULL;
+	mesh->gl_cmd_buffer = gl_cmd_buffer;
+	mesh->numverts = numverts;
+	mesh->numindices = numindices;
+	mesh->pindex = malloc(numverts * sizeof (*mesh->pindex));
+	mesh->texcoords = malloc(numverts * 2 * sizeof (GLfloat));
+	mesh->indices = malloc((numindices ? numindices : 1) * sizeof (GLuint));
+	mesh->positions = malloc(numverts * 3 * sizeof (GLfloat));
+	mesh->normals = malloc(numverts * 3 * sizeof (GLfloat));
+	if (!mesh->pindex || !mesh->texcoords || !mesh->indices || !mesh->positions || !mesh->normals)
+	{
+		free(mesh->pindex);
+		free(mesh->texcoords);
+		free(mesh->indices);
+		free(mesh->positions);
+		free(mesh->normals);
+		free(mesh);
+		return NULL;
+	}
+
+	numverts = 0;
+	index = mesh->indices;
+	for (cmd = gl_cmd_buffer; (val = *cmd++) != 0;)
+	{
+		const GLuint base = (GLuint)numverts;
+		count = abs(val);
+
+		for (i = 0; i < count; i++, numverts++)
+		{
+			mesh->texcoords[numverts*2  ] = *(float *)cmd++;
+			mesh->texcoords[numverts*2+1] = *(float *)cmd++;
+			mesh->pindex[numverts] = *cmd++;
+		}
+
+		for (i = 2; i < count; i++)
+		{
+			if (val < 0) // fan
+			{
+				*index++ = base;
+				*index++ = base + i - 1;
+			}
+			else if (i & 1) // strip, every other triangle turns the other way
+			{
+				*index++ = base + i - 1;
+				*index++ = base + i - 2;
+			}
+			else
+			{
+				*index++ = base + i - 2;
+				*index++ = base + i - 1;
+			}
+			*index++ = base + i;
+		}
+	}
+
+	if (pglBindBuffer)
+	{
+		pglGenBuffers(2, mesh->buffers);
+		pglBindBuffer(GL_ARRAY_BUFFER, mesh->buffers[0]);
+		pglBufferData(GL_ARRAY_BUFFER, mesh->numverts * 2 * sizeof (GLfloat), mesh->texcoords, GL_STATIC_DRAW);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->buffers[1]);
+		pglBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->numindices * sizeof (GLuint), mesh->indices, GL_STATIC_DRAW);
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	mesh->next = md2meshes;
+	md2meshes = mesh;
+	return mesh;
+}
+
+// The skin colour mask uses the same coordinates as the texture
+static void MD2TexCoordPointer(const GLvoid *texcoords)
+{
+	pglTexCoordPointer(2, GL_FLOAT, 0, texcoords);
+	if (skinblending)
+	{
+		pglClientActiveTexture(GL_TEXTURE1);
+		pglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		pglTexCoordPointer(2, GL_FLOAT, 0, texcoords);
+		pglClientActiveTexture(GL_TEXTURE0);
+	}
+}
+
+static void DrawMD2Mesh(md2mesh_t *mesh, md2_frame_t *frame, md2_frame_t *nextframe, float pol,
+	float scalex, float scaley, float scalez)
+{
+	GLfloat *pos = mesh->positions, *norm = mesh->normals;
+	GLsizei i;
+
+	scalex /= 2.0f;
+	scaley /= 2.0f;
+	scalez /= 2.0f;
+
+	if (!nextframe || fpclassify(pol) == FP_ZERO)
+	{
+		for (i = 0; i < mesh->numverts; i++)
+		{
+			const md2_triangleVertex_t *v = &frame->vertices[mesh->pindex[i]];
+			*pos++ = v->vertex[0]*scalex;
+			*pos++ = v->vertex[1]*scaley;
+			*pos++ = v->vertex[2]*scalez;
+			*norm++ = v->normal[0];
+			*norm++ = v->normal[1];
+			*norm++ = v->normal[2];
+		}
+	}
+	else
+	{
+		for (i = 0; i < mesh->numverts; i++)
+		{
+			const md2_triangleVertex_t *v1 = &frame->vertices[mesh->pindex[i]];
+			const md2_triangleVertex_t *v2 = &nextframe->vertices[mesh->pindex[i]];
+			*pos++ = (v1->vertex[0] + pol * (v2->vertex[0] - v1->vertex[0]))*scalex;
+			*pos++ = (v1->vertex[1] + pol * (v2->vertex[1] - v1->vertex[1]))*scaley;
+			*pos++ = (v1->vertex[2] + pol * (v2->vertex[2] - v1->vertex[2]))*scalez;
+			*norm++ = v1->normal[0] + pol * (v2->normal[0] - v1->normal[0]);
+			*norm++ = v1->normal[1] + pol * (v2->normal[1] - v1->normal[1]);
+			*norm++ = v1->normal[2] + pol * (v2->normal[2] - v1->normal[2]);
+		}
+	}
+
+	pglEnableClientState(GL_VERTEX_ARRAY);
+	pglEnableClientState(GL_NORMAL_ARRAY);
+	pglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	pglVertexPointer(3, GL_FLOAT, 0, mesh->positions);
+	pglNormalPointer(GL_FLOAT, 0, mesh->normals);
+
+	if (pglBindBuffer)
+	{
+		pglBindBuffer(GL_ARRAY_BUFFER, mesh->buffers[0]);
+		MD2TexCoordPointer(NULL);
+		pglBindBuffer(GL_ARRAY_BUFFER, 0);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->buffers[1]);
+		pglDrawElements(GL_TRIANGLES, mesh->numindices, GL_UNSIGNED_INT, NULL);
+		CountDraw(mesh->numverts);
+		pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	else
+	{
+		MD2TexCoordPointer(mesh->texcoords);
+		pglDrawElements(GL_TRIANGLES, mesh->numindices, GL_UNSIGNED_INT, mesh->indices);
+		CountDraw(mesh->numverts);
+	}
+
+	if (skinblending)
+	{
+		pglClientActiveTexture(GL_TEXTURE1);
+		pglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		pglClientActiveTexture(GL_TEXTURE0);
+	}
+	pglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	pglDisableClientState(GL_NORMAL_ARRAY);
+	pglDisableClientState(GL_VERTEX_ARRAY);
+}
+#endif
+
 static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration, INT32 tics, md2_frame_t *nextframe, FTransform *pos, float scale, UINT8 flipped, UINT8 *color)
 {
 	INT32     val, count, pindex;
 	GLfloat s, t;
+#ifdef POLYBATCHING
+	md2mesh_t *mesh;
+	boolean indexed;
+#endif
 	GLfloat ambient[4];
 	GLfloat diffuse[4];
 
@@ -1964,6 +3842,31 @@ static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration,
 	pglRotatef(pos->angley, 0.0f, -1.0f, 0.0f);
 	pglRotatef(pos->anglex, -1.0f, 0.0f, 0.0f);
 
+#ifndef MINI_GL_COMPATIBILITY
+	if (skinblending) // unit 2 does the lighting
+		pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+#endif
+
+#ifdef POLYBATCHING
+	// A model with no skin of its own can have a sprite's indexed texture.
+	// paletteprogram knows nothing of the lighting, so it's flat shaded.
+	indexed = IndexedTextureBound();
+	if (indexed)
+	{
+		UpdateColormap();
+		StartIndexedDraw();
+		if (color)
+			pglColor4fv(diffuse);
+	}
+
+	mesh = GetMD2Mesh(gl_cmd_buffer);
+	if (mesh)
+	{
+		DrawMD2Mesh(mesh, frame, nextframe, pol, scalex, scaley, scalez);
+		val = 0;
+	}
+	else
+#endif
 	val = *gl_cmd_buffer++;
 
 	while (val != 0)
@@ -1978,6 +3881,7 @@ static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration,
 			pglBegin(GL_TRIANGLE_STRIP);
 			count = val;
 		}
+		CountDraw(count);
 
 		while (count--)
 		{
@@ -1986,6 +3890,10 @@ static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration,
 			pindex = *gl_cmd_buffer++;
 
 			pglTexCoord2f(s, t);
+#ifndef MINI_GL_COMPATIBILITY
+			if (skinblending)
+				pglMultiTexCoord2f(GL_TEXTURE1, s, t);
+#endif
 
 			if (!nextframe || fpclassify(pol) == FP_ZERO)
 			{
@@ -2026,11 +3934,22 @@ static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration,
 
 		val = *gl_cmd_buffer++;
 	}
+#ifdef POLYBATCHING
+	if (indexed)
+	{
+		EndIndexedDraw();
+		pglColor4fv(&batchcolor.red);
+	}
+#endif
 	pglPopMatrix(); // should be the same as glLoadIdentity
 	if (color)
 		pglDisable(GL_LIGHTING);
 	pglShadeModel(GL_FLAT);
 	pglDisable(GL_CULL_FACE);
+#ifndef MINI_GL_COMPATIBILITY
+	if (skinblending)
+		EndSkinBlend();
+#endif
 }
 
 // -----------------+
@@ -2038,11 +3957,13 @@ static  void DrawMD2Ex(INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration,
 // -----------------+
 EXPORT void HWRAPI(DrawMD2i) (INT32 *gl_cmd_buffer, md2_frame_t *frame, INT32 duration, INT32 tics, md2_frame_t *nextframe, FTransform *pos, float scale, UINT8 flipped, UINT8 *color)
 {
+	FlushBatch();
 	DrawMD2Ex(gl_cmd_buffer, frame, duration, tics,  nextframe, pos, scale, flipped, color);
 }
 
 EXPORT void HWRAPI(DrawMD2) (INT32 *gl_cmd_buffer, md2_frame_t *frame, FTransform *pos, float scale)
 {
+	FlushBatch();
 	DrawMD2Ex(gl_cmd_buffer, frame, 0, 0,  NULL, pos, scale, false, NULL);
 }
 
@@ -2053,6 +3974,8 @@ EXPORT void HWRAPI(DrawMD2) (INT32 *gl_cmd_buffer, md2_frame_t *frame, FTransfor
 EXPORT void HWRAPI(SetTransform) (FTransform *stransform)
 {
 	static INT32 special_splitscreen;
+
+	FlushBatch();
 	pglLoadIdentity();
 	if (stransform)
 	{
@@ -2117,6 +4040,53 @@ EXPORT INT32  HWRAPI(GetTextureUsed) (void)
 	return res;
 }
 
+// -----------------+
+// GetTextureStats  : How much texture memory each ETextureCategory takes up,
+//                  : and how many textures went over the budget so far
+// -----------------+
+EXPORT void HWRAPI(GetTextureStats) (UINT32 *resident, UINT32 *evictions)
+{
+	memcpy(resident, texturebytes, sizeof (texturebytes));
+	*evictions = textureevictions;
+}
+
+// -----------------+
+// MarkRenderSection: What's drawn from now on goes in this section's time
+// -----------------+
+EXPORT void HWRAPI(MarkRenderSection) (INT32 section)
+{
+#ifdef MINI_GL_COMPATIBILITY
+	(void)section;
+#else
+	statframe_t *frame = &statframes[curstatframe];
+
+	if (!gputimers || !timersupport || frame->nummarks == MAXSECTIONMARKS)
+		return;
+	if (frame->nummarks && frame->sections[frame->nummarks-1] == section)
+		return;
+
+	FlushBatch(); // so what's batched is drawn in the section it was sent in
+	if (!frame->queries[0])
+		pglGenQueries(MAXSECTIONMARKS+1, frame->queries);
+	pglQueryCounter(frame->queries[frame->nummarks], GL_TIMESTAMP);
+	frame->sections[frame->nummarks++] = section;
+#endif
+}
+
+// -----------------+
+// GetRenderStats   : What the last frame sent to the card
+// -----------------+
+EXPORT void HWRAPI(GetRenderStats) (FRenderStats *stats)
+{
+	memcpy(stats, &laststats, sizeof (*stats));
+#ifndef MINI_GL_COMPATIBILITY
+	stats->gputimers = (gputimers && timersupport);
+#else
+	stats->gputimers = false;
+#endif
+	stats->renderer = (const char *)pglGetString(GL_RENDERER);
+}
+
 EXPORT INT32  HWRAPI(GetRenderVersion) (void)
 {
 	return VERSION;
@@ -2129,6 +4099,9 @@ EXPORT void HWRAPI(PostImgRedraw) (float points[SCREENVERTS][SCREENVERTS][2])
 	float float_x, float_y, float_nextx, float_nexty;
 	float xfix, yfix;
 	INT32 texsize = 2048;
+	GLint scenew, sceneh;
+
+	FlushBatch();
 
 	// Use a power of two texture, dammit
 	if(screen_width <= 1024)
@@ -2137,11 +4110,13 @@ EXPORT void HWRAPI(PostImgRedraw) (float points[SCREENVERTS][SCREENVERTS][2])
 		texsize = 512;
 
 	// X/Y stretch fix for all resolutions(!)
-	xfix = (float)(texsize)/((float)((screen_width)/(float)(SCREENVERTS-1)));
-	yfix = (float)(texsize)/((float)((screen_height)/(float)(SCREENVERTS-1)));
+	GetSceneSize(&scenew, &sceneh);
+	xfix = (float)(texsize)/((float)((scenew)/(float)(SCREENVERTS-1)));
+	yfix = (float)(texsize)/((float)((sceneh)/(float)(SCREENVERTS-1)));
 
 	pglDisable(GL_DEPTH_TEST);
 	pglDisable(GL_BLEND);
+	CountDraw(4);
 	pglBegin(GL_QUADS);
 
 		// Draw a black square behind the screen texture,
@@ -2188,6 +4163,7 @@ EXPORT void HWRAPI(PostImgRedraw) (float points[SCREENVERTS][SCREENVERTS][2])
 //			a new size
 EXPORT void HWRAPI(FlushScreenTextures) (void)
 {
+	FlushBatch();
 	pglDeleteTextures(1, &screentexture);
 	pglDeleteTextures(1, &startScreenWipe);
 	pglDeleteTextures(1, &endScreenWipe);
@@ -2204,6 +4180,8 @@ EXPORT void HWRAPI(StartScreenWipe) (void)
 	INT32 texsize = 2048;
 	boolean firstTime = (startScreenWipe == 0);
 
+	FlushBatch();
+
 	// Use a power of two texture, dammit
 	if(screen_width <= 512)
 		texsize = 512;
@@ -2244,6 +4222,8 @@ EXPORT void HWRAPI(EndScreenWipe)(void)
 	INT32 texsize = 2048;
 	boolean firstTime = (endScreenWipe == 0);
 
+	FlushBatch();
+
 	// Use a power of two texture, dammit
 	if(screen_width <= 512)
 		texsize = 512;
@@ -2285,18 +4265,23 @@ EXPORT void HWRAPI(DrawIntermissionBG)(void)
 {
 	float xfix, yfix;
 	INT32 texsize = 2048;
+	GLint scenew, sceneh;
+
+	FlushBatch();
 
 	if(screen_width <= 1024)
 		texsize = 1024;
 	if(screen_width <= 512)
 		texsize = 512;
 
-	xfix = 1/((float)(texsize)/((float)((screen_width))));
-	yfix = 1/((float)(texsize)/((float)((screen_height))));
+	GetSceneSize(&scenew, &sceneh);
+	xfix = 1/((float)(texsize)/((float)((scenew))));
+	yfix = 1/((float)(texsize)/((float)((sceneh))));
 
 	pglClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
 	pglBindTexture(GL_TEXTURE_2D, screentexture);
+	CountDraw(4);
 	pglBegin(GL_QUADS);
 
 		pglColor4f(1.0f, 1.0f, 1.0f, 1.0f);
@@ -2326,19 +4311,23 @@ EXPORT void HWRAPI(DoScreenWipe)(float alpha)
 {
 	INT32 texsize = 2048;
 	float xfix, yfix;
+	GLint scenew, sceneh;
 
 #ifndef MINI_GL_COMPATIBILITY
 	INT32 fademaskdownloaded = tex_downloaded; // the fade mask that has been set
 #endif
 
+	FlushBatch();
+
 	// Use a power of two texture, dammit
 	if(screen_width <= 1024)
 		texsize = 1024;
 	if(screen_width <= 512)
 		texsize = 512;
 
-	xfix = 1/((float)(texsize)/((float)((screen_width))));
-	yfix = 1/((float)(texsize)/((float)((screen_height))));
+	GetSceneSize(&scenew, &sceneh);
+	xfix = 1/((float)(texsize)/((float)((scenew))));
+	yfix = 1/((float)(texsize)/((float)((sceneh))));
 
 	pglClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
@@ -2346,6 +4335,7 @@ EXPORT void HWRAPI(DoScreenWipe)(float alpha)
 
 	// Draw the original screen
 	pglBindTexture(GL_TEXTURE_2D, startScreenWipe);
+	CountDraw(4);
 	pglBegin(GL_QUADS);
 		pglColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 
@@ -2383,6 +4373,7 @@ EXPORT void HWRAPI(DoScreenWipe)(float alpha)
 		pglBindTexture(GL_TEXTURE_2D, fademaskdownloaded);
 
 		pglTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+		CountDraw(4);
 		pglBegin(GL_QUADS);
 			pglColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 
@@ -2416,6 +4407,7 @@ EXPORT void HWRAPI(DoScreenWipe)(float alpha)
 #endif
 	// Draw the end screen that fades in
 	pglBindTexture(GL_TEXTURE_2D, endScreenWipe);
+	CountDraw(4);
 	pglBegin(GL_QUADS);
 		pglColor4f(1.0f, 1.0f, 1.0f, alpha);
 
@@ -2448,6 +4440,8 @@ EXPORT void HWRAPI(MakeScreenTexture) (void)
 	INT32 texsize = 2048;
 	boolean firstTime = (screentexture == 0);
 
+	FlushBatch();
+
 	// Use a power of two texture, dammit
 	if(screen_width <= 512)
 		texsize = 512;
@@ -2487,6 +4481,17 @@ EXPORT void HWRAPI(MakeScreenFinalTexture) (void)
 	INT32 texsize = 2048;
 	boolean firstTime = (finalScreenTexture == 0);
 
+	FlushBatch();
+
+#ifndef MINI_GL_COMPATIBILITY
+	finaltextureused = true;
+	if (scenebound)
+	{
+		presentpending = true; // DrawScreenFinalTexture draws from scenetexture
+		return;
+	}
+#endif
+
 	// Use a power of two texture, dammit
 	if(screen_width <= 512)
 		texsize = 512;
@@ -2529,6 +4534,10 @@ EXPORT void HWRAPI(DrawScreenFinalTexture)(int width, int height)
 	float xoff = 1, yoff = 1; // xoffset and yoffset for the polygon to have black bars around the screen
 	FRGBAFloat clearColour;
 	INT32 texsize = 2048;
+	GLuint texture = finalScreenTexture;
+	boolean fromscene = false;
+
+	FlushBatch();
 
 	if(screen_width <= 1024)
 		texsize = 1024;
@@ -2538,6 +4547,26 @@ EXPORT void HWRAPI(DrawScreenFinalTexture)(int width, int height)
 	xfix = 1/((float)(texsize)/((float)((screen_width))));
 	yfix = 1/((float)(texsize)/((float)((screen_height))));
 
+#ifndef MINI_GL_COMPATIBILITY
+	if (scenebound)
+	{
+		GLint scenew, sceneh;
+
+		// Asked to draw the frame again after the swap,
+		// but scenefbo still has it
+		if (!presentpending)
+			return;
+
+		// scenetexture is the size of the screen
+		GetSceneSize(&scenew, &sceneh);
+		xfix = (float)scenew/screen_width;
+		yfix = (float)sceneh/screen_height;
+		texture = scenetexture;
+		fromscene = true;
+		pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+#endif
+
 	origaspect = (float)screen_width / screen_height;
 	newaspect = (float)width / height;
 	if (origaspect < newaspect)
@@ -2555,8 +4584,18 @@ EXPORT void HWRAPI(DrawScreenFinalTexture)(int width, int height)
 
 	clearColour.red = clearColour.green = clearColour.blue = 0;
 	clearColour.alpha = 1;
-	ClearBuffer(true, false, &clearColour);
-	pglBindTexture(GL_TEXTURE_2D, finalScreenTexture);
+	ClearBuffer(true, fromscene, &clearColour); // nothing else clears the window's depth buffer then
+	pglBindTexture(GL_TEXTURE_2D, texture);
+#ifndef MINI_GL_COMPATIBILITY
+	if (fromscene && scenefilter != (renderscale == 100 ? GL_NEAREST : GL_LINEAR))
+	{
+		// Smooth it out when scaling the scene up
+		scenefilter = (renderscale == 100 ? GL_NEAREST : GL_LINEAR);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, scenefilter);
+		pglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, scenefilter);
+	}
+#endif
+	CountDraw(4);
 	pglBegin(GL_QUADS);
 
 		pglColor4f(1.0f, 1.0f, 1.0f, 1.0f);
@@ -2578,7 +4617,17 @@ EXPORT void HWRAPI(DrawScreenFinalTexture)(int width, int height)
 
 	pglEnd();
 
-	tex_downloaded = finalScreenTexture;
+	tex_downloaded = texture;
+
+#ifndef MINI_GL_COMPATIBILITY
+	if (fromscene)
+	{
+		FlushBatch();
+		pglBindFramebuffer(GL_FRAMEBUFFER, scenefbo);
+		SetViewport(lastviewport[0], lastviewport[1], lastviewport[2], lastviewport[3]);
+		presentpending = false;
+	}
+#endif
 }
 
 #endif //HWRENDER
@@ -86,6 +86,10 @@ void *GetGLFunc(const char *proc);
 boolean SetupGLfunc(void);
 boolean SetupGLFunc13(void);
 void Flush(void);
+void FlushBatch(void);
+boolean ReadyToSwap(void);
+void SwapMade(void);
+void FinishFrame(void);
 INT32 isExtAvailable(const char *extension, const GLubyte *start);
 int SetupPixelFormat(INT32 WantColorBits, INT32 WantStencilBits, INT32 WantDepthBits);
 void SetModelView(GLint w, GLint h);
@@ -337,6 +337,24 @@ static char chat_log[CHAT_BUFSIZE][255]; // hold the last 48 or so messages in t
 static char chat_mini[8][255]; // display up to 8 messages that will fade away / get overwritten
 static tic_t chat_timers[8];
 
+// The messages above, word wrapped for the width they were last drawn at.
+// They're only wrapped again when the box or the screen changes size.
+typedef struct
+{
+	char *text;
+	INT32 width, vidwidth;
+} chatwrap_t;
+
+static chatwrap_t chat_logwrap[CHAT_BUFSIZE];
+static chatwrap_t chat_miniwrap[8];
+
+static void CHAT_FreeWrap(chatwrap_t *wrap)
+{
+	if (wrap->text)
+		Z_Free(wrap->text);
+	wrap->text = NULL;
+}
+
 static boolean chat_scrollmedown = false; // force instant scroll down on the chat log. Happens when you open it / send a message.
 
 // remove text from minichat table
@@ -347,10 +365,13 @@ static void HU_removeChatText_Mini(void)
 {
     // MPC: Don't create new arrays, just iterate through an existing one
 	size_t i;
+	CHAT_FreeWrap(&chat_miniwrap[0]);
     for(i=0;i<chat_nummsg_min-1;i++) {
         strcpy(chat_mini[i], chat_mini[i+1]);
         chat_timers[i] = chat_timers[i+1];
+        chat_miniwrap[i] = chat_miniwrap[i+1];
     }
+	chat_miniwrap[i].text = NULL; // moved down, not freed
 	chat_nummsg_min--; // lost 1 msg.
 
 	// use addy and make shit slide smoothly af.
@@ -363,9 +384,12 @@ static void HU_removeChatText_Log(void)
 {
 	// MPC: Don't create new arrays, just iterate through an existing one
 	size_t i;
+	CHAT_FreeWrap(&chat_logwrap[0]);
     for(i=0;i<chat_nummsg_log-1;i++) {
         strcpy(chat_log[i], chat_log[i+1]);
+        chat_logwrap[i] = chat_logwrap[i+1];
     }
+	chat_logwrap[i].text = NULL; // moved down, not freed
     chat_nummsg_log--; // lost 1 msg.
 }
 #endif
@@ -381,12 +405,14 @@ void HU_AddChatText(const char *text, boolean playsound)
 		HU_removeChatText_Log();
 
 	strcpy(chat_log[chat_nummsg_log], text);
+	CHAT_FreeWrap(&chat_logwrap[chat_nummsg_log]);
 	chat_nummsg_log++;
 
 	if (chat_nummsg_min >= 8)
 		HU_removeChatText_Mini();
 
 	strcpy(chat_mini[chat_nummsg_min], text);
+	CHAT_FreeWrap(&chat_miniwrap[chat_nummsg_min]);
 	chat_timers[chat_nummsg_min] = TICRATE*cv_chattime.value;
 	chat_nummsg_min++;
 
@@ -1301,6 +1327,19 @@ static char *CHAT_WordWrap(INT32 x, INT32 w, INT32 option, const char *string)
 	return newstring;
 }
 
+// CHAT_WordWrap, but kept in wrap for the next frame.
+static const char *CHAT_CachedWordWrap(chatwrap_t *wrap, INT32 x, INT32 w, INT32 option, const char *string)
+{
+	if (!wrap->text || wrap->width != w || wrap->vidwidth != vid.width)
+	{
+		CHAT_FreeWrap(wrap);
+		wrap->text = CHAT_WordWrap(x, w, option, string);
+		wrap->width = w;
+		wrap->vidwidth = vid.width;
+	}
+	return wrap->text;
+}
+
 
 // 30/7/18: chaty is now the distance at which the lowest point of the chat will be drawn if that makes any sense.
 
@@ -1331,7 +1370,7 @@ static void HU_drawMiniChat(void)
 
 	for (; i>0; i--)
 	{
-		const char *msg = CHAT_WordWrap(x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_mini[i-1]);
+		const char *msg = CHAT_CachedWordWrap(&chat_miniwrap[i-1], x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_mini[i-1]);
 		size_t j = 0;
 		INT32 linescount = 0;
 
@@ -1396,7 +1435,7 @@ static void HU_drawMiniChat(void)
 		INT32 timer = ((cv_chattime.value*TICRATE)-chat_timers[i]) - cv_chattime.value*TICRATE+9; // see below...
 		INT32 transflag = (timer >= 0 && timer <= 9) ? (timer*V_10TRANS) : 0; // you can make bad jokes out of this one.
 		size_t j = 0;
-		const char *msg = CHAT_WordWrap(x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_mini[i]); // get the current message, and word wrap it.
+		const char *msg = CHAT_CachedWordWrap(&chat_miniwrap[i], x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_mini[i]); // get the current message, and word wrap it.
 		UINT8 *colormap = NULL;
 
 		while(msg[j]) // iterate through msg
@@ -1495,7 +1534,7 @@ static void HU_drawChatLog(INT32 offset)
 	{
 		INT32 clrflag = 0;
 		INT32 j = 0;
-		const char *msg = CHAT_WordWrap(x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_log[i]); // get the current message, and word wrap it.
+		const char *msg = CHAT_CachedWordWrap(&chat_logwrap[i], x+2, boxw-(charwidth*2), V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_ALLOWLOWERCASE, chat_log[i]); // get the current message, and word wrap it.
 		UINT8 *colormap = NULL;
 		while(msg[j]) // iterate through msg
 		{
@@ -2366,6 +2405,9 @@ static void HU_Draw32TeamTabRankings(playersort_t *tab, INT32 whiteplayer)
 		else //er?  not on red or blue, so ignore them
 			continue;
 
+		if (y > 173)
+			continue; // the team's column is full
+
 		strlcpy(name, tab[i].name, 8);
 		V_DrawString(x + 10, y,
 		             ((tab[i].num == whiteplayer) ? V_YELLOWMAP : 0)
@@ -2814,6 +2856,18 @@ static inline void HU_DrawSpectatorTicker(void)
 		}
 }
 
+// Best first: the lowest time in a race without laps, else the highest
+// count. On a tie the higher player number goes first.
+static int HU_CompareRanks(const void *a, const void *b)
+{
+	const playersort_t *x = a, *y = b;
+	const boolean lowestfirst = (gametype == GT_RACE && !circuitmap);
+
+	if (x->count != y->count)
+		return ((x->count < y->count) == lowestfirst) ? -1 : 1;
+	return y->num - x->num;
+}
+
 //
 // HU_DrawRankings
 //
@@ -2821,8 +2875,7 @@ static void HU_DrawRankings(void)
 {
 	patch_t *p;
 	playersort_t tab[MAXPLAYERS];
-	INT32 i, j, scorelines;
-	boolean completed[MAXPLAYERS];
+	INT32 i, scorelines;
 	UINT32 whiteplayer;
 
 	// draw the current gametype in the lower right
@@ -2899,7 +2952,6 @@ static void HU_DrawRankings(void)
 	whiteplayer = demoplayback ? displayplayer : consoleplayer;
 
 	scorelines = 0;
-	memset(completed, 0, sizeof (completed));
 	memset(tab, 0, sizeof (playersort_t)*MAXPLAYERS);
 
 	for (i = 0; i < MAXPLAYERS; i++)
@@ -2911,71 +2963,32 @@ static void HU_DrawRankings(void)
 			tab[i].count = INT32_MAX;
 	}
 
-	for (j = 0; j < MAXPLAYERS; j++)
+	for (i = 0; i < MAXPLAYERS; i++)
 	{
-		if (!playeringame[j] || players[j].spectator)
+		if (!playeringame[i] || players[i].spectator)
 			continue;
 
-		for (i = 0; i < MAXPLAYERS; i++)
+		tab[scorelines].num = i;
+		tab[scorelines].color = players[i].skincolor;
+		tab[scorelines].name = player_names[i];
+
+		if (gametype == GT_RACE)
+			tab[scorelines].count = circuitmap ? (unsigned)players[i].laps+1 : players[i].realtime;
+		else
 		{
-			if (playeringame[i] && !players[i].spectator)
-			{
-				if (gametype == GT_RACE)
-				{
-					if (circuitmap)
-					{
-						if ((unsigned)players[i].laps+1 >= tab[scorelines].count && completed[i] == false)
-						{
-							tab[scorelines].count = players[i].laps+1;
-							tab[scorelines].num = i;
-							tab[scorelines].color = players[i].skincolor;
-							tab[scorelines].name = player_names[i];
-						}
-					}
-					else
-					{
-						if (players[i].realtime <= tab[scorelines].count && completed[i] == false)
-						{
-							tab[scorelines].count = players[i].realtime;
-							tab[scorelines].num = i;
-							tab[scorelines].color = players[i].skincolor;
-							tab[scorelines].name = player_names[i];
-						}
-					}
-				}
-				else if (gametype == GT_COMPETITION)
-				{
-					// todo put something more fitting for the gametype here, such as current
-					// number of categories led
-					if (players[i].score >= tab[scorelines].count && completed[i] == false)
-					{
-						tab[scorelines].count = players[i].score;
-						tab[scorelines].num = i;
-						tab[scorelines].color = players[i].skincolor;
-						tab[scorelines].name = player_names[i];
-						tab[scorelines].emeralds = players[i].powers[pw_emeralds];
-					}
-				}
-				else
-				{
-					if (players[i].score >= tab[scorelines].count && completed[i] == false)
-					{
-						tab[scorelines].count = players[i].score;
-						tab[scorelines].num = i;
-						tab[scorelines].color = players[i].skincolor;
-						tab[scorelines].name = player_names[i];
-						tab[scorelines].emeralds = players[i].powers[pw_emeralds];
-					}
-				}
-			}
+			// todo put something more fitting for competition here, such as current
+			// number of categories led
+			tab[scorelines].count = players[i].score;
+			tab[scorelines].emeralds = players[i].powers[pw_emeralds];
 		}
-		completed[tab[scorelines].num] = true;
 		scorelines++;
 	}
 
-	//if (scorelines > 20)
-	//	scorelines = 20; //dont draw past bottom of screen, show the best only
-	// shush, we'll do it anyway.
+	qsort(tab, scorelines, sizeof (playersort_t), HU_CompareRanks);
+
+	// The compact board has room for 32; past that, only the best are shown.
+	if (scorelines > 32)
+		scorelines = 32;
 
 	if (G_GametypeHasTeams())
 		HU_DrawTeamTabRankings(tab, whiteplayer); //separate function for Spazzo's silly request
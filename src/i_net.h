@@ -24,9 +24,19 @@
 /// \brief program net id
 #define DOOMCOM_ID (INT32)0x12345678l
 
-/// \def MAXPACKETLENGTH
+/// \def LANPACKETLENGTH
 /// For use in a LAN
-#define MAXPACKETLENGTH 1450
+#define LANPACKETLENGTH 1450
+/// \def MAXPACKETLENGTH
+///  The biggest packet there's room for. With more than 32 players, the
+///  server config, resynch and player info packets outgrow a LAN packet,
+///  so there's room for them and IP fragments them. Tics and files are
+///  still cut at hardware_MAXPACKETLENGTH.
+#if MAXPLAYERS > 32
+#define MAXPACKETLENGTH (LANPACKETLENGTH + (MAXPLAYERS-32)*40)
+#else
+#define MAXPACKETLENGTH LANPACKETLENGTH
+#endif
 /// \def INETPACKETLENGTH
 ///  For use on the internet
 #define INETPACKETLENGTH 1024
@@ -91,10 +101,20 @@ extern boolean (*I_NetGet)(void);
 */
 extern boolean (*I_NetCanGet)(void);
 
+/**	\brief sleep until there is data waiting or timeout microseconds pass, may be NULL
+
+	\return	true if there is data waiting
+*/
+extern boolean (*I_NetWaitForPacket)(UINT32 timeout);
+
 /**	\brief send packet within doomcom struct
 */
 extern void (*I_NetSend)(void);
 
+/**	\brief send every packet the driver is still holding, may be NULL
+*/
+extern void (*I_NetFlush)(void);
+
 /**	\brief ask to driver if all is ok to send data now
 */
 extern boolean (*I_NetCanSend)(void);
@@ -131,6 +151,34 @@ extern SINT8 I_NetMakeNode(const char *address);
 */
 extern SINT8 (*I_NetMakeNodewPort)(const char *address, const char *port);
 
+/**	\brief	Like I_NetMakeNodewPort, but looks the address up on another
+	thread instead of waiting for it. Only the latest lookup counts:
+	starting another one, or closing the socket, forgets the last.
+
+	\param	address	address to connect to
+
+	\param	port	port to connect to
+
+	\param	done	called from I_NetAsyncTicker with the node, or -1 if
+	the address couldn't be found
+
+	\return	false if the lookup couldn't be started
+
+
+*/
+extern boolean (*I_NetMakeNodewPortAsync)(const char *address, const char *port, void (*done)(SINT8 node));
+
+/**	\brief	Like I_NetMakeNode, for I_NetMakeNodewPortAsync
+*/
+extern boolean I_NetMakeNodeAsync(const char *address, void (*done)(SINT8 node));
+
+/**	\brief	Finishes whatever the driver did in the background since last
+	time, on the main thread: calls done for a finished lookup, and prints
+	what UPnP found. NULL if the driver never does anything in the
+	background.
+*/
+extern void (*I_NetAsyncTicker)(void);
+
 /**	\brief open connection
 */
 extern boolean (*I_NetOpenSocket)(void);
@@ -40,6 +40,10 @@ extern UINT8 sound_started;
 /**	\brief info of samplerate
 */
 extern consvar_t cv_samplerate;
+
+/**	\brief How many megabytes of decoded sounds an interface that caches them may keep
+*/
+extern consvar_t cv_sfxcachesize;
 //extern consvar_t cv_rndsoundpitch;
 
 /**	\brief	The I_GetSfx function
@@ -58,6 +62,17 @@ void *I_GetSfx(sfxinfo_t *sfx);
 */
 void I_FreeSfx(sfxinfo_t *sfx);
 
+/**	\brief	Gets a sound ready ahead of the first time it's played
+
+	An interface that can decode sounds in the background starts on it
+	and returns; the rest just do what I_GetSfx does now.
+
+	\param	sfx	sfx to get ready
+
+	\return	void
+*/
+void I_PrefetchSfx(sfxinfo_t *sfx);
+
 /**	\brief Init at program start...
 */
 void I_StartupSound(void);
@@ -182,6 +197,17 @@ boolean I_LoadSong(char *data, size_t len);
 */
 void I_UnloadSong(void);
 
+/**	\brief	Opens song data ahead of time, if the interface can do it in
+		the background, so that a later ::I_LoadSong of the same data only
+		has to pick it up. Only the last song prefetched is kept.
+
+	\param	data	song data, which must stay around until it's loaded
+	\param	len	len of data
+
+	\return	void
+*/
+void I_PrefetchSong(char *data, size_t len);
+
 /**	\brief	Called by anything that wishes to start music
 
 	\param	handle	Song handle
@@ -46,12 +46,24 @@ UINT32 I_GetFreeMem(UINT32 *total);
 */
 tic_t I_GetTime(void);
 
+/**	\brief	Returns a monotonic time in microseconds, for profiling.
+	The counter wraps around, so only the difference between two calls
+	means anything.
+*/
+UINT32 I_GetTimeMicros(void);
+
 /**	\brief	The I_Sleep function
 
 	\return	void
 */
 void I_Sleep(void);
 
+/**	\brief	Sleeps for about ms milliseconds, whatever cv_sleep is.
+	How about depends on the system's timer; don't count on better
+	than a millisecond or two.
+*/
+void I_SleepMillis(UINT32 ms);
+
 /**	\brief Get events
 
 	Called by D_SRB2Loop,
@@ -12,6 +12,13 @@
 ///        This is not really OS-dependent because all OSes have the same socket API.
 ///        Just use ifdef for OS-dependent parts.
 
+#if defined (__linux__) && !defined (NOMMSG)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for sendmmsg and recvmmsg
+#endif
+#define HAVE_MMSG
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -186,6 +193,10 @@ static UINT8 UPNP_support = TRUE;
 #include "d_netfil.h"
 #include "i_tcp.h"
 #include "m_argv.h"
+#include "d_main.h" // serverinstance, loadtest
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
 
 #include "doomstat.h"
 
@@ -348,16 +359,51 @@ static struct UPNPUrls urls;
 static struct IGDdatas data;
 static char lanaddr[64];
 
+#ifdef HAVE_THREADS
+// upnpDiscover waits two seconds for an answer, and every port mapping is
+// a request to the router, so they all run on threads of their own. Until
+// discovery is done, urls and data belong to its thread; after that they're
+// only read, until I_ShutdownUPnP waits for everyone and frees them.
+static I_mutex upnp_mutex;
+static I_cond upnp_cond;
+static INT32 upnpbusy = 0; // threads still running
+static boolean upnpdiscovered = false;
+static char upnpport[8]; // to map once discovery is done, "" if none
+static char upnpmessage[1024]; // for SOCK_AsyncTicker to print
+#endif
+
 static void I_ShutdownUPnP(void)
 {
+#ifdef HAVE_THREADS
+	I_lock_mutex(&upnp_mutex);
+	while (upnpbusy)
+		I_hold_cond(&upnp_cond, upnp_mutex);
+	I_unlock_mutex(upnp_mutex);
+#endif
 	FreeUPNPUrls(&urls);
 }
 
-static inline void I_InitUPnP(void)
+// Adds to a message for the console, since threads can't print.
+static void I_UPnPMessage(char *msg, size_t size, const char *fmt, ...)
+{
+	size_t len = strlen(msg);
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg + len, size - len, fmt, ap);
+	va_end(ap);
+}
+
+//
+// I_DiscoverUPnP
+//
+// Looks for the gateway, writing what it found in msg.
+//
+static void I_DiscoverUPnP(char *msg, size_t size)
 {
 	struct UPNPDev * devlist = NULL;
 	int upnp_error = -2;
-	CONS_Printf(M_GetText("Looking for UPnP Internet Gateway Device\n"));
+	msg[0] = '\0';
 	devlist = upnpDiscover(2000, NULL, NULL, 0, false, &upnp_error);
 	if (devlist)
 	{
@@ -373,11 +419,11 @@ static inline void I_InitUPnP(void)
 		if (!dev)
 			dev = devlist; /* defaulting to first device */
 
-		CONS_Printf(M_GetText("Found UPnP device:\n desc: %s\n st: %s\n"),
+		I_UPnPMessage(msg, size, M_GetText("Found UPnP device:\n desc: %s\n st: %s\n"),
 		           dev->descURL, dev->st);
 
 		UPNP_GetValidIGD(devlist, &urls, &data, lanaddr, sizeof(lanaddr));
-		CONS_Printf(M_GetText("Local LAN IP address: %s\n"), lanaddr);
+		I_UPnPMessage(msg, size, M_GetText("Local LAN IP address: %s\n"), lanaddr);
 		descXML = miniwget(dev->descURL, &descXMLsize);
 		if (descXML)
 		{
@@ -387,13 +433,12 @@ static inline void I_InitUPnP(void)
 			memset(&urls, 0, sizeof(struct UPNPUrls));
 			memset(&data, 0, sizeof(struct IGDdatas));
 			GetUPNPUrls(&urls, &data, dev->descURL);
-			I_AddExitFunc(I_ShutdownUPnP);
 		}
 		freeUPNPDevlist(devlist);
 	}
 	else if (upnp_error == UPNPDISCOVER_SOCKET_ERROR)
 	{
-		CONS_Printf(M_GetText("No UPnP devices discovered\n"));
+		I_UPnPMessage(msg, size, M_GetText("No UPnP devices discovered\n"));
 	}
 }
 
@@ -414,6 +459,87 @@ static inline void I_UPnP_rem(const char *port, const char * servicetype)
 	UPNP_DeletePortMapping(urls.controlURL, data.first.servicetype,
 	                       port, servicetype, NULL);
 }
+
+#ifdef HAVE_THREADS
+//
+// I_UPnPThread
+//
+// With a port, maps it. Without one, discovers the gateway first, then maps
+// whatever port was asked for in the meantime.
+//
+static void I_UPnPThread(void *userdata)
+{
+	char *port = userdata;
+
+	if (!port)
+	{
+		char msg[sizeof upnpmessage];
+
+		I_DiscoverUPnP(msg, sizeof msg);
+
+		I_lock_mutex(&upnp_mutex);
+		strlcat(upnpmessage, msg, sizeof upnpmessage);
+		upnpdiscovered = true;
+		if (upnpport[0])
+			port = strdup(upnpport);
+		upnpport[0] = '\0';
+		I_unlock_mutex(upnp_mutex);
+	}
+
+	if (port)
+	{
+		I_UPnP_rem(port, "UDP");
+		I_UPnP_add(NULL, port, "UDP");
+		free(port);
+	}
+
+	I_lock_mutex(&upnp_mutex);
+	if (--upnpbusy == 0)
+		I_wake_all_cond(&upnp_cond);
+	I_unlock_mutex(upnp_mutex);
+}
+#endif
+
+static inline void I_InitUPnP(void)
+{
+	CONS_Printf(M_GetText("Looking for UPnP Internet Gateway Device\n"));
+	I_AddExitFunc(I_ShutdownUPnP);
+#ifdef HAVE_THREADS
+	upnpbusy++;
+	I_spawn_thread("upnp", I_UPnPThread, NULL);
+#else
+	{
+		char msg[1024];
+		I_DiscoverUPnP(msg, sizeof msg);
+		CONS_Printf("%s", msg);
+	}
+#endif
+}
+
+//
+// I_UPnP_map
+//
+// Forwards a UDP port to us, replacing whatever was there.
+//
+static void I_UPnP_map(const char *port)
+{
+#ifdef HAVE_THREADS
+	char *p = NULL;
+
+	I_lock_mutex(&upnp_mutex);
+	if (!upnpdiscovered)
+		strlcpy(upnpport, port, sizeof upnpport);
+	else if ((p = strdup(port)) != NULL)
+		upnpbusy++;
+	I_unlock_mutex(upnp_mutex);
+
+	if (p)
+		I_spawn_thread("upnp-map", I_UPnPThread, p);
+#else
+	I_UPnP_rem(port, "UDP");
+	I_UPnP_add(NULL, port, "UDP");
+#endif
+}
 #endif
 
 static const char *SOCK_AddrToStr(mysockaddr_t *sk)
@@ -505,7 +631,7 @@ static boolean SOCK_cmpaddr(mysockaddr_t *a, mysockaddr_t *b, UINT8 mask)
 			&& (b->ip4.sin_port == 0 || (a->ip4.sin_port == b->ip4.sin_port));
 #ifdef HAVE_IPV6
 	else if (b->any.sa_family == AF_INET6)
-		return memcmp(&a->ip6.sin6_addr, &b->ip6.sin6_addr, sizeof(b->ip6.sin6_addr))
+		return !memcmp(&a->ip6.sin6_addr, &b->ip6.sin6_addr, sizeof(b->ip6.sin6_addr))
 			&& (b->ip6.sin6_port == 0 || (a->ip6.sin6_port == b->ip6.sin6_port));
 #endif
 	else
@@ -599,63 +725,229 @@ void Command_Numnodes(void)
 #endif
 
 #ifndef NONET
+// Datagrams are read from the sockets in batches, then handed out one
+// at a time by SOCK_Get.
+#define MAXRECVQUEUE 32
+
+typedef struct
+{
+	SOCKET_TYPE socket;
+	mysockaddr_t addr;
+	socklen_t addrlen;
+	ssize_t length;
+	char data[MAXPACKETLENGTH];
+} recvpacket_t;
+
+static recvpacket_t recvqueue[MAXRECVQUEUE];
+static size_t recvqueuehead = 0, recvqueuelength = 0;
+
+// Refills the empty receive queue from every socket.
+static void SOCK_ReceiveBatch(void)
+{
+	size_t n;
+#ifdef HAVE_MMSG
+	static struct mmsghdr msgs[MAXRECVQUEUE];
+	static struct iovec iovs[MAXRECVQUEUE];
+	size_t i, room;
+	int got;
+#else
+	ssize_t c;
+#endif
+
+	recvqueuehead = recvqueuelength = 0;
+
+	for (n = 0; n < mysocketses && recvqueuelength < MAXRECVQUEUE; n++)
+	{
+#ifdef HAVE_MMSG
+		room = MAXRECVQUEUE - recvqueuelength;
+		for (i = 0; i < room; i++)
+		{
+			recvpacket_t *packet = &recvqueue[recvqueuelength + i];
+			iovs[i].iov_base = packet->data;
+			iovs[i].iov_len = MAXPACKETLENGTH;
+			memset(&msgs[i], 0, sizeof (msgs[i]));
+			msgs[i].msg_hdr.msg_name = &packet->addr;
+			msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof(packet->addr);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		got = recvmmsg(mysockets[n], msgs, (unsigned int)room, MSG_DONTWAIT, NULL);
+		for (i = 0; got > 0 && i < (size_t)got; i++)
+		{
+			recvpacket_t *packet = &recvqueue[recvqueuelength++];
+			packet->socket = mysockets[n];
+			packet->addrlen = msgs[i].msg_hdr.msg_namelen;
+			packet->length = (ssize_t)msgs[i].msg_len;
+		}
+#else
+		recvpacket_t *packet = &recvqueue[0];
+		packet->addrlen = (socklen_t)sizeof(packet->addr);
+		c = recvfrom(mysockets[n], packet->data, MAXPACKETLENGTH, 0,
+			(void *)&packet->addr, &packet->addrlen);
+		if (c != ERRSOCKET)
+		{
+			packet->socket = mysockets[n];
+			packet->length = c;
+			recvqueuelength = 1;
+			return;
+		}
+#endif
+	}
+}
+
+// Packets from addresses without a node, which are mostly server queries,
+// are let through at QUERYRATE a second, after a burst of QUERYBURST.
+// Each address has its own bucket of tokens; the stalest is reused when
+// the table fills, which is no loss since a stale bucket is full anyway.
+#define QUERYBUCKETS 64
+#define QUERYBURST 8
+#define QUERYRATE 4
+
+typedef struct
+{
+	mysockaddr_t addr; // port cleared, so any port matches
+	tic_t time; // when tokens was last topped up
+	INT32 tokens;
+} querybucket_t;
+
+static querybucket_t querybuckets[QUERYBUCKETS];
+static size_t numquerybuckets = 0;
+
+static boolean SOCK_AllowQuery(mysockaddr_t *addr)
+{
+	const tic_t now = I_GetTime();
+	querybucket_t *bucket = NULL;
+	size_t i;
+
+	if (addr->any.sa_family != AF_INET
+#ifdef HAVE_IPV6
+		&& addr->any.sa_family != AF_INET6
+#endif
+		)
+		return true;
+
+	for (i = 0; i < numquerybuckets; i++)
+		if (SOCK_cmpaddr(addr, &querybuckets[i].addr, 0))
+		{
+			bucket = &querybuckets[i];
+			break;
+		}
+
+	if (!bucket)
+	{
+		if (numquerybuckets < QUERYBUCKETS)
+			bucket = &querybuckets[numquerybuckets++];
+		else
+		{
+			bucket = &querybuckets[0];
+			for (i = 1; i < QUERYBUCKETS; i++)
+				if (querybuckets[i].time < bucket->time)
+					bucket = &querybuckets[i];
+		}
+
+		M_Memcpy(&bucket->addr, addr, sizeof (bucket->addr));
+		if (addr->any.sa_family == AF_INET)
+			bucket->addr.ip4.sin_port = 0;
+#ifdef HAVE_IPV6
+		else
+			bucket->addr.ip6.sin6_port = 0;
+#endif
+		bucket->time = now;
+		bucket->tokens = QUERYBURST;
+	}
+	else if (now - bucket->time >= TICRATE/QUERYRATE)
+	{
+		const tic_t earned = (now - bucket->time) / (TICRATE/QUERYRATE);
+
+		if (earned >= QUERYBURST || bucket->tokens + (INT32)earned >= QUERYBURST)
+		{
+			bucket->tokens = QUERYBURST;
+			bucket->time = now;
+		}
+		else
+		{
+			bucket->tokens += (INT32)earned;
+			bucket->time += earned * (TICRATE/QUERYRATE);
+		}
+	}
+
+	if (bucket->tokens <= 0)
+		return false;
+	bucket->tokens--;
+	return true;
+}
+
 // Returns true if a packet was received from a new node, false in all other cases
 static boolean SOCK_Get(void)
 {
-	size_t i, n;
+	size_t i;
 	int j;
-	ssize_t c;
-	mysockaddr_t fromaddress;
-	socklen_t fromlen;
+	boolean refilled = false;
+	recvpacket_t *packet;
 
-	for (n = 0; n < mysocketses; n++)
+	for (;;)
 	{
-		fromlen = (socklen_t)sizeof(fromaddress);
-		c = recvfrom(mysockets[n], (char *)&doomcom->data, MAXPACKETLENGTH, 0,
-			(void *)&fromaddress, &fromlen);
-		if (c != ERRSOCKET)
+		if (recvqueuehead == recvqueuelength)
 		{
-			// find remote node number
-			for (j = 1; j <= MAXNETNODES; j++) //include LAN
-			{
-				if (SOCK_cmpaddr(&fromaddress, &clientaddress[j], 0))
-				{
-					doomcom->remotenode = (INT16)j; // good packet from a game player
-					doomcom->datalength = (INT16)c;
-					nodesocket[j] = mysockets[n];
-					return false;
-				}
-			}
-			// not found
+			// only read the sockets once, so a flood can't keep us here
+			if (refilled)
+				break;
+			SOCK_ReceiveBatch();
+			refilled = true;
+			if (!recvqueuelength)
+				break;
+		}
 
-			// find a free slot
-			j = getfreenode();
-			if (j > 0)
+		packet = &recvqueue[recvqueuehead++];
+		M_Memcpy(&doomcom->data, packet->data, packet->length);
+
+		// find remote node number
+		for (j = 1; j <= MAXNETNODES; j++) //include LAN
+		{
+			if (SOCK_cmpaddr(&packet->addr, &clientaddress[j], 0))
 			{
-				M_Memcpy(&clientaddress[j], &fromaddress, fromlen);
-				nodesocket[j] = mysockets[n];
-				DEBFILE(va("New node detected: node:%d address:%s\n", j,
-						SOCK_GetNodeAddress(j)));
 				doomcom->remotenode = (INT16)j; // good packet from a game player
-				doomcom->datalength = (INT16)c;
+				doomcom->datalength = (INT16)packet->length;
+				nodesocket[j] = packet->socket;
+				return false;
+			}
+		}
+		// not found
 
-				// check if it's a banned dude so we can send a refusal later
-				for (i = 0; i < numbans; i++)
+		if (!SOCK_AllowQuery(&packet->addr))
+		{
+			DEBFILE(va("Too many packets from %s, dropped\n", SOCK_AddrToStr(&packet->addr)));
+			continue;
+		}
+
+		// find a free slot
+		j = getfreenode();
+		if (j > 0)
+		{
+			M_Memcpy(&clientaddress[j], &packet->addr, packet->addrlen);
+			nodesocket[j] = packet->socket;
+			DEBFILE(va("New node detected: node:%d address:%s\n", j,
+					SOCK_GetNodeAddress(j)));
+			doomcom->remotenode = (INT16)j; // good packet from a game player
+			doomcom->datalength = (INT16)packet->length;
+
+			// check if it's a banned dude so we can send a refusal later
+			for (i = 0; i < numbans; i++)
+			{
+				if (SOCK_cmpaddr(&packet->addr, &banned[i], bannedmask[i]))
 				{
-					if (SOCK_cmpaddr(&fromaddress, &banned[i], bannedmask[i]))
-					{
-						SOCK_bannednode[j] = true;
-						DEBFILE("This dude has been banned\n");
-						break;
-					}
+					SOCK_bannednode[j] = true;
+					DEBFILE("This dude has been banned\n");
+					break;
 				}
-				if (i == numbans)
-					SOCK_bannednode[j] = false;
-				return true;
 			}
-			else
-				DEBFILE("New node detected: No more free slots\n");
+			if (i == numbans)
+				SOCK_bannednode[j] = false;
+			return true;
 		}
+		else
+			DEBFILE("New node detected: No more free slots\n");
 	}
 
 	doomcom->remotenode = -1; // no packet
@@ -713,33 +1005,136 @@ static boolean SOCK_CanGet(void)
 		return true;
 	return false;
 }
+
+static boolean SOCK_WaitForPacket(UINT32 timeout)
+{
+	struct timeval timeval_for_select;
+	fd_set tset;
+	SOCKET_TYPE maxfd = 0;
+	size_t i;
+
+	// still some left over from the last batch
+	if (recvqueuehead < recvqueuelength)
+		return true;
+
+	if (!FD_CPY(&masterset, &tset, mysockets, mysocketses))
+	{
+		I_Sleep();
+		return false;
+	}
+	for (i = 0; i < mysocketses; i++)
+		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET && mysockets[i] > maxfd)
+			maxfd = mysockets[i];
+
+	timeval_for_select.tv_sec = timeout / 1000000;
+	timeval_for_select.tv_usec = timeout % 1000000;
+	return select((int)maxfd + 1, &tset, NULL, NULL, &timeval_for_select) >= 1;
+}
 #endif
 #endif
 
 #ifndef NONET
-static inline ssize_t SOCK_SendToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr)
+// Packets are queued by SOCK_Send and only go out when the queue is
+// flushed, so one tic's worth of packets can be sent with a single
+// sendmmsg call where it exists.
+#define MAXSENDQUEUE 64
+
+typedef struct
 {
-	socklen_t d4 = (socklen_t)sizeof(struct sockaddr_in);
-#ifdef HAVE_IPV6
-	socklen_t d6 = (socklen_t)sizeof(struct sockaddr_in6);
+	SOCKET_TYPE socket;
+	mysockaddr_t addr;
+	socklen_t addrlen;
+	INT32 node; // node to report errors for, or -1 to ignore them
+	size_t length;
+	char data[MAXPACKETLENGTH];
+} sendpacket_t;
+
+static sendpacket_t sendqueue[MAXSENDQUEUE];
+static size_t sendqueuelength = 0;
+
+static void SOCK_SendError(const sendpacket_t *packet)
+{
+	int e = errno; // save error code so it can't be modified later
+	if (packet->node < 0)
+		return;
+	if (e != ECONNREFUSED && e != EWOULDBLOCK)
+		I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", packet->node,
+			SOCK_GetNodeAddress(packet->node), e, strerror(e));
+}
+
+static void SOCK_FlushSends(void)
+{
+	size_t i = 0;
+#ifdef HAVE_MMSG
+	static struct mmsghdr msgs[MAXSENDQUEUE];
+	static struct iovec iovs[MAXSENDQUEUE];
+	size_t j;
+	int sent;
+
+	// sendmmsg takes a single socket, so send each run of packets
+	// for the same socket in one call
+	while (i < sendqueuelength)
+	{
+		for (j = i; j < sendqueuelength && sendqueue[j].socket == sendqueue[i].socket; j++)
+		{
+			iovs[j-i].iov_base = sendqueue[j].data;
+			iovs[j-i].iov_len = sendqueue[j].length;
+			memset(&msgs[j-i], 0, sizeof (msgs[j-i]));
+			msgs[j-i].msg_hdr.msg_name = &sendqueue[j].addr.any;
+			msgs[j-i].msg_hdr.msg_namelen = sendqueue[j].addrlen;
+			msgs[j-i].msg_hdr.msg_iov = &iovs[j-i];
+			msgs[j-i].msg_hdr.msg_iovlen = 1;
+		}
+
+		sent = sendmmsg(sendqueue[i].socket, msgs, (unsigned int)(j - i), 0);
+		if (sent <= 0)
+		{
+			// the error is for the first packet, skip it and carry on
+			SOCK_SendError(&sendqueue[i]);
+			i++;
+		}
+		else
+			i += sent;
+	}
+#else
+	for (; i < sendqueuelength; i++)
+	{
+		if (sendto(sendqueue[i].socket, sendqueue[i].data, sendqueue[i].length, 0,
+			&sendqueue[i].addr.any, sendqueue[i].addrlen) == ERRSOCKET)
+			SOCK_SendError(&sendqueue[i]);
+	}
 #endif
-	socklen_t d, da = (socklen_t)sizeof(mysockaddr_t);
+	sendqueuelength = 0;
+}
+
+static void SOCK_QueueToAddr(SOCKET_TYPE socket, mysockaddr_t *sockaddr, INT32 node)
+{
+	sendpacket_t *packet;
+
+	if (sendqueuelength == MAXSENDQUEUE)
+		SOCK_FlushSends();
+
+	packet = &sendqueue[sendqueuelength++];
+	packet->socket = socket;
+	packet->node = node;
 
 	switch (sockaddr->any.sa_family)
 	{
-		case AF_INET:  d = d4; break;
+		case AF_INET:  packet->addrlen = (socklen_t)sizeof(struct sockaddr_in); break;
 #ifdef HAVE_IPV6
-		case AF_INET6: d = d6; break;
+		case AF_INET6: packet->addrlen = (socklen_t)sizeof(struct sockaddr_in6); break;
 #endif
-		default:       d = da; break;
+		default:       packet->addrlen = (socklen_t)sizeof(mysockaddr_t); break;
 	}
+	// copy the address too, the node may be freed before the flush
+	M_Memcpy(&packet->addr, sockaddr, packet->addrlen);
 
-	return sendto(socket, (char *)&doomcom->data, doomcom->datalength, 0, &sockaddr->any, d);
+	packet->length = doomcom->datalength;
+	M_Memcpy(packet->data, &doomcom->data, packet->length);
 }
 
 static void SOCK_Send(void)
 {
-	ssize_t c = ERRSOCKET;
 	size_t i, j;
 
 	if (!nodeconnected[doomcom->remotenode])
@@ -752,31 +1147,22 @@ static void SOCK_Send(void)
 			for (j = 0; j < broadcastaddresses; j++)
 			{
 				if (myfamily[i] == broadcastaddress[j].any.sa_family)
-					SOCK_SendToAddr(mysockets[i], &broadcastaddress[j]);
+					SOCK_QueueToAddr(mysockets[i], &broadcastaddress[j], -1);
 			}
 		}
-		return;
 	}
 	else if (nodesocket[doomcom->remotenode] == (SOCKET_TYPE)ERRSOCKET)
 	{
 		for (i = 0; i < mysocketses; i++)
 		{
 			if (myfamily[i] == clientaddress[doomcom->remotenode].any.sa_family)
-				SOCK_SendToAddr(mysockets[i], &clientaddress[doomcom->remotenode]);
+				SOCK_QueueToAddr(mysockets[i], &clientaddress[doomcom->remotenode], -1);
 		}
-		return;
 	}
 	else
 	{
-		c = SOCK_SendToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode]);
-	}
-
-	if (c == ERRSOCKET)
-	{
-		int e = errno; // save error code so it can't be modified later
-		if (e != ECONNREFUSED && e != EWOULDBLOCK)
-			I_Error("SOCK_Send, error sending to node %d (%s) #%u: %s", doomcom->remotenode,
-				SOCK_GetNodeAddress(doomcom->remotenode), e, strerror(e));
+		SOCK_QueueToAddr(nodesocket[doomcom->remotenode], &clientaddress[doomcom->remotenode],
+			doomcom->remotenode);
 	}
 }
 #endif
@@ -943,6 +1329,8 @@ static boolean UDP_Socket(void)
 			I_Error("syntax: -clientport <portnum>");
 		sock_port = M_GetNextParm();
 	}
+	else if (loadtest)
+		sock_port = "0"; // the clients can't all have the same one
 	else
 		sock_port = port_name;
 
@@ -985,10 +1373,7 @@ static boolean UDP_Socket(void)
 					s++;
 #ifdef HAVE_MINIUPNPC
 					if (UPNP_support)
-					{
-						I_UPnP_rem(sock_port, "UDP");
-						I_UPnP_add(NULL, sock_port, "UDP");
-					}
+						I_UPnP_map(sock_port);
 #endif
 				}
 				runp = runp->ai_next;
@@ -1261,9 +1646,20 @@ boolean I_InitTcpDriver(void)
 }
 
 #ifndef NONET
+#ifdef HAVE_THREADS
+static void SOCK_AbandonLookup(void);
+#endif
+
 static void SOCK_CloseSocket(void)
 {
 	size_t i;
+
+	SOCK_FlushSends(); // send any goodbyes still queued
+	recvqueuehead = recvqueuelength = 0;
+#ifdef HAVE_THREADS
+	SOCK_AbandonLookup();
+#endif
+
 	for (i=0; i < MAXNETNODES+1; i++)
 	{
 		if (mysockets[i] != (SOCKET_TYPE)ERRSOCKET
@@ -1311,16 +1707,9 @@ void I_ShutdownTcpDriver(void)
 }
 
 #ifndef NONET
-static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
+static int SOCK_LookUp(const char *address, const char *port, struct my_addrinfo **ai)
 {
-	SINT8 newnode = -1;
-	struct my_addrinfo *ai = NULL, *runp, hints;
-	int gaie;
-
-	 if (!port || !port[0])
-		port = port_name;
-
-	DEBFILE(va("Creating new node: %s@%s\n", address, port));
+	struct my_addrinfo hints;
 
 	memset (&hints, 0x00, sizeof (hints));
 	hints.ai_flags = 0;
@@ -1328,20 +1717,19 @@ static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
 	hints.ai_socktype = SOCK_DGRAM;
 	hints.ai_protocol = IPPROTO_UDP;
 
-	gaie = I_getaddrinfo(address, port, &hints, &ai);
-	if (gaie == 0)
-	{
-		newnode = getfreenode();
-	}
+	return I_getaddrinfo(address, port, &hints, ai);
+}
+
+// Makes a node of the first address that can be sent to.
+static SINT8 SOCK_NodeFromAddrinfo(struct my_addrinfo *ai)
+{
+	SINT8 newnode = getfreenode();
+	struct my_addrinfo *runp;
+
 	if (newnode == -1)
-	{
-		I_freeaddrinfo(ai);
 		return -1;
-	}
-	else
-		runp = ai;
 
-	while (runp != NULL)
+	for (runp = ai; runp != NULL; runp = runp->ai_next)
 	{
 		// find ip of the server
 		if (sendto(mysockets[0], NULL, 0, 0, runp->ai_addr, runp->ai_addrlen) == 0)
@@ -1349,11 +1737,145 @@ static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
 			memcpy(&clientaddress[newnode], runp->ai_addr, runp->ai_addrlen);
 			break;
 		}
-		runp = runp->ai_next;
 	}
+	return newnode;
+}
+
+static SINT8 SOCK_NetMakeNodewPort(const char *address, const char *port)
+{
+	SINT8 newnode = -1;
+	struct my_addrinfo *ai = NULL;
+
+	 if (!port || !port[0])
+		port = port_name;
+
+	DEBFILE(va("Creating new node: %s@%s\n", address, port));
+
+	if (SOCK_LookUp(address, port, &ai) == 0)
+		newnode = SOCK_NodeFromAddrinfo(ai);
 	I_freeaddrinfo(ai);
 	return newnode;
 }
+
+#ifdef HAVE_THREADS
+// A lookup for SOCK_NetMakeNodewPortAsync. If it's abandoned before it
+// finishes, its thread frees it; otherwise the main thread does.
+typedef struct
+{
+	char address[256], port[16];
+	void (*done)(SINT8 node);
+	struct my_addrinfo *ai;
+	int gaie;
+	boolean finished, abandoned;
+} lookup_t;
+
+static I_mutex lookup_mutex;
+static lookup_t *pendinglookup = NULL;
+
+static void SOCK_FreeLookup(lookup_t *l)
+{
+	if (l->gaie == 0)
+		I_freeaddrinfo(l->ai);
+	free(l);
+}
+
+static void SOCK_LookupThread(void *userdata)
+{
+	lookup_t *l = userdata;
+	struct my_addrinfo *ai = NULL;
+	int gaie = SOCK_LookUp(l->address, l->port, &ai);
+	boolean abandoned;
+
+	I_lock_mutex(&lookup_mutex);
+	l->ai = ai;
+	l->gaie = gaie;
+	l->finished = true;
+	abandoned = l->abandoned;
+	I_unlock_mutex(lookup_mutex);
+
+	if (abandoned)
+		SOCK_FreeLookup(l);
+}
+
+// Forgets the pending lookup, if there is one.
+static void SOCK_AbandonLookup(void)
+{
+	lookup_t *l = pendinglookup;
+	boolean finished;
+
+	if (!l)
+		return;
+	pendinglookup = NULL;
+
+	I_lock_mutex(&lookup_mutex);
+	finished = l->finished;
+	l->abandoned = true;
+	I_unlock_mutex(lookup_mutex);
+
+	if (finished)
+		SOCK_FreeLookup(l);
+}
+
+static boolean SOCK_NetMakeNodewPortAsync(const char *address, const char *port, void (*done)(SINT8 node))
+{
+	lookup_t *l;
+
+	if (!port || !port[0])
+		port = port_name;
+
+	SOCK_AbandonLookup();
+	l = calloc(1, sizeof (*l));
+	if (!l)
+		return false;
+	strlcpy(l->address, address, sizeof l->address);
+	strlcpy(l->port, port, sizeof l->port);
+	l->done = done;
+	pendinglookup = l;
+
+	DEBFILE(va("Looking up new node: %s@%s\n", address, port));
+	I_spawn_thread("lookup", SOCK_LookupThread, l);
+	return true;
+}
+
+static void SOCK_AsyncTicker(void)
+{
+	lookup_t *l = pendinglookup;
+
+	if (l)
+	{
+		boolean finished;
+
+		I_lock_mutex(&lookup_mutex);
+		finished = l->finished;
+		I_unlock_mutex(lookup_mutex);
+
+		if (finished)
+		{
+			SINT8 node = -1;
+
+			pendinglookup = NULL;
+			DEBFILE(va("Looked up %s@%s\n", l->address, l->port));
+			if (l->gaie == 0)
+				node = SOCK_NodeFromAddrinfo(l->ai);
+			l->done(node);
+			SOCK_FreeLookup(l);
+		}
+	}
+
+#ifdef HAVE_MINIUPNPC
+	if (upnpmessage[0])
+	{
+		char msg[sizeof upnpmessage];
+
+		I_lock_mutex(&upnp_mutex);
+		strlcpy(msg, upnpmessage, sizeof msg);
+		upnpmessage[0] = '\0';
+		I_unlock_mutex(upnp_mutex);
+		CONS_Printf("%s", msg);
+	}
+#endif
+}
+#endif // HAVE_THREADS
 #endif
 
 static boolean SOCK_OpenSocket(void)
@@ -1368,15 +1890,20 @@ static boolean SOCK_OpenSocket(void)
 		nodeconnected[i] = false;
 	nodeconnected[BROADCASTADDR] = true;
 	I_NetSend = SOCK_Send;
+	I_NetFlush = SOCK_FlushSends;
 	I_NetGet = SOCK_Get;
 	I_NetCloseSocket = SOCK_CloseSocket;
 	I_NetFreeNodenum = SOCK_FreeNodenum;
 	I_NetMakeNodewPort = SOCK_NetMakeNodewPort;
+#ifdef HAVE_THREADS
+	I_NetMakeNodewPortAsync = SOCK_NetMakeNodewPortAsync;
+#endif
 
 #ifdef SELECTTEST
 	// seem like not work with libsocket : (
 	I_NetCanSend = SOCK_CanSend;
 	I_NetCanGet = SOCK_CanGet;
+	I_NetWaitForPacket = SOCK_WaitForPacket;
 #endif
 
 	// build the socket but close it first
@@ -1491,6 +2018,13 @@ boolean I_InitTcpNetwork(void)
 	}
 	current_port = (UINT16)atoi(port_name);
 
+	// Each -instances copy takes the next port up
+	if (serverinstance && current_port && !loadtest)
+	{
+		current_port = (UINT16)(current_port + serverinstance);
+		snprintf(port_name, sizeof (port_name), "%u", current_port);
+	}
+
 	// parse network game options,
 	if (M_CheckParm("-server") || dedicated)
 	{
@@ -1548,11 +2082,14 @@ boolean I_InitTcpNetwork(void)
 			COM_BufAddText("connect any\n");
 
 			net_bandwidth = 800000;
-			hardware_MAXPACKETLENGTH = MAXPACKETLENGTH;
+			hardware_MAXPACKETLENGTH = LANPACKETLENGTH;
 		}
 	}
 
 	I_NetOpenSocket = SOCK_OpenSocket;
+#if !defined (NONET) && defined (HAVE_THREADS)
+	I_NetAsyncTicker = SOCK_AsyncTicker;
+#endif
 	I_Ban = SOCK_Ban;
 	I_ClearBans = SOCK_ClearBans;
 	I_GetNodeAddress = SOCK_GetNodeAddress;
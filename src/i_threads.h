@@ -0,0 +1,68 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  i_threads.h
+/// \brief Multithreading abstraction
+///
+///        Only available when the interface defines HAVE_THREADS. Code
+///        that uses threads must keep working without them, usually by
+///        doing the same work on the main thread.
+///
+///        Mutexes and condition variables are plain pointers that start
+///        out NULL and are created the first time they are locked or
+///        waited on, so they can be declared as static variables without
+///        any setup code.
+
+#ifndef __I_THREADS__
+#define __I_THREADS__
+
+#ifdef HAVE_THREADS
+
+typedef void (*I_thread_fn)(void *userdata);
+
+typedef void *I_mutex;
+typedef void *I_cond;
+
+/**	\brief Sets up the thread system. Call once, before any other function here.
+*/
+void I_start_threads(void);
+
+/**	\brief Asks every thread to stop, and waits for them to finish.
+*/
+void I_stop_threads(void);
+
+/**	\brief Starts a new thread running fn(userdata).
+	\param	name	thread name, for debuggers
+*/
+void I_spawn_thread(const char *name, I_thread_fn fn, void *userdata);
+
+/**	\brief Long running threads should poll this and return once it's true.
+*/
+boolean I_thread_is_stopped(void);
+
+/**	\brief Number of logical processors, at least 1.
+*/
+INT32 I_num_cpus(void);
+
+/**	\brief Lets other threads run for at least ms milliseconds.
+*/
+void I_thread_sleep(UINT32 ms);
+
+void I_lock_mutex(I_mutex *anchor);
+void I_unlock_mutex(I_mutex mutex);
+
+/**	\brief Waits on a condition. mutex must be locked, and is locked again on return.
+*/
+void I_hold_cond(I_cond *anchor, I_mutex mutex);
+
+void I_wake_one_cond(I_cond *anchor);
+void I_wake_all_cond(I_cond *anchor);
+
+#endif // HAVE_THREADS
+
+#endif // __I_THREADS__
@@ -2408,9 +2408,6 @@ int LUA_BaseLib(lua_State *L)
 	lua_setfield(L,-2,"__add"); // ... store it as mathematical addition
 	lua_pop(L, 2); // pop metatable and dummy string
 
-	lua_newtable(L);
-	lua_setfield(L, LUA_REGISTRYINDEX, LREG_EXTVARS);
-
 	// Set global functions
 	lua_pushvalue(L, LUA_GLOBALSINDEX);
 	luaL_register(L, NULL, lib);
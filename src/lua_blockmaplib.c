@@ -32,10 +32,39 @@ typedef UINT8 (*blockmap_func)(lua_State *, INT32, INT32, mobj_t *);
 
 static boolean blockfuncerror = false; // errors should only print once per search blockmap call
 
+#define SEARCH_NEXT 3 // not a return value, just carry on in the block
+
+// Calls the search function on one object
+static UINT8 lib_searchBlockmap_Object(lua_State *L, mobj_t *thing, mobj_t *mobj)
+{
+	lua_pushvalue(L, 1); // push function
+	LUA_PushUserdata(L, thing, META_MOBJ);
+	LUA_PushUserdata(L, mobj, META_MOBJ);
+	if (lua_pcall(gL, 2, 1, 0)) {
+		if (!blockfuncerror || cv_debug & DBG_LUA)
+			CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
+		lua_pop(gL, 1);
+		blockfuncerror = true;
+		return 0; // *shrugs*
+	}
+	if (!lua_isnil(gL, -1))
+	{ // if nil, continue
+		if (lua_toboolean(gL, -1))
+			return 2; // stop whole search
+		else
+			return 1; // stop block search
+	}
+	lua_pop(gL, 1);
+	return SEARCH_NEXT;
+}
+
 // Helper function for "objects" search
 static UINT8 lib_searchBlockmap_Objects(lua_State *L, INT32 x, INT32 y, mobj_t *thing)
 {
 	mobj_t *mobj, *bnext = NULL;
+	const blockstatic_t *cell;
+	size_t i, count;
+	UINT8 result;
 
 	if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 		return 0;
@@ -46,24 +75,8 @@ static UINT8 lib_searchBlockmap_Objects(lua_State *L, INT32 x, INT32 y, mobj_t *
 		P_SetTarget(&bnext, mobj->bnext); // We want to note our reference to bnext here incase it is MF_NOTHINK and gets removed!
 		if (mobj == thing)
 			continue; // our thing just found itself, so move on
-		lua_pushvalue(L, 1); // push function
-		LUA_PushUserdata(L, thing, META_MOBJ);
-		LUA_PushUserdata(L, mobj, META_MOBJ);
-		if (lua_pcall(gL, 2, 1, 0)) {
-			if (!blockfuncerror || cv_debug & DBG_LUA)
-				CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
-			lua_pop(gL, 1);
-			blockfuncerror = true;
-			return 0; // *shrugs*
-		}
-		if (!lua_isnil(gL, -1))
-		{ // if nil, continue
-			if (lua_toboolean(gL, -1))
-				return 2; // stop whole search
-			else
-				return 1; // stop block search
-		}
-		lua_pop(gL, 1);
+		if ((result = lib_searchBlockmap_Object(L, thing, mobj)) != SEARCH_NEXT)
+			return result;
 		if (P_MobjWasRemoved(thing) // func just popped our thing, cannot continue.
 		|| (bnext && P_MobjWasRemoved(bnext))) // func just broke blockmap chain, cannot continue.
 		{
@@ -71,9 +84,25 @@ static UINT8 lib_searchBlockmap_Objects(lua_State *L, INT32 x, INT32 y, mobj_t *
 			return (P_MobjWasRemoved(thing)) ? 2 : 1;
 		}
 	}
+
+	// Then the ones that aren't moving
+	cell = &blockstatics[y*bmapwidth + x];
+	count = cell->count;
+	for (i = 0; i < count; i++)
+	{
+		mobj = cell->mobjs[i];
+		if (!mobj || mobj == thing)
+			continue;
+		if ((result = lib_searchBlockmap_Object(L, thing, mobj)) != SEARCH_NEXT)
+			return result;
+		if (P_MobjWasRemoved(thing))
+			return 2;
+	}
 	return 0;
 }
 
+#undef SEARCH_NEXT
+
 // Helper function for "lines" search
 static UINT8 lib_searchBlockmap_Lines(lua_State *L, INT32 x, INT32 y, mobj_t *thing)
 {
@@ -257,9 +286,201 @@ static int lib_searchBlockmap(lua_State *L)
 	return 1;
 }
 
+// Filters for findObjects and findObjectsInRadius, read from a table:
+//   type    - a mobj type, or a list of them
+//   flags   - MF_ flags they must all have
+//   noflags - MF_ flags they must have none of
+//   z1, z2  - heights they have to overlap, either can be left out
+//   sight   - a mobj they must be in sight of
+//   exclude - a mobj to leave out, such as the one searching
+//   max     - stop after this many
+typedef struct
+{
+	UINT8 types[(NUMMOBJTYPES+7)/8];
+	boolean anytype;
+	UINT32 flags, noflags;
+	boolean zcheck;
+	fixed_t z1, z2;
+	mobj_t *sight, *exclude;
+	size_t max;
+} blockquery_t;
+
+// Reads the number in field, or returns def if it isn't there.
+static lua_Integer lib_queryNumber(lua_State *L, int idx, const char *field, lua_Integer def)
+{
+	lua_Integer value = def;
+
+	lua_getfield(L, idx, field);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+			luaL_error(L, "filter field " LUA_QS " should be a number", field);
+		value = lua_tointeger(L, -1);
+	}
+	lua_pop(L, 1);
+	return value;
+}
+
+// Reads the mobj in field, or NULL if it isn't there.
+static mobj_t *lib_queryMobj(lua_State *L, int idx, const char *field)
+{
+	mobj_t *mo = NULL;
+
+	lua_getfield(L, idx, field);
+	if (!lua_isnil(L, -1))
+	{
+		mo = *((mobj_t **)luaL_checkudata(L, lua_gettop(L), META_MOBJ));
+		if (!mo)
+			LUA_ErrInvalid(L, "mobj_t");
+	}
+	lua_pop(L, 1);
+	return mo;
+}
+
+static void lib_queryType(lua_State *L, blockquery_t *q, lua_Integer type)
+{
+	if (type < 0 || type >= NUMMOBJTYPES)
+		luaL_error(L, "filter type %d out of range (0 - %d)", (int)type, NUMMOBJTYPES-1);
+	q->types[type/8] |= 1<<(type%8);
+	q->anytype = false;
+}
+
+static void lib_readQuery(lua_State *L, int idx, blockquery_t *q)
+{
+	memset(q, 0, sizeof (*q));
+	q->anytype = true;
+
+	if (lua_isnoneornil(L, idx))
+		return;
+	luaL_checktype(L, idx, LUA_TTABLE);
+
+	lua_getfield(L, idx, "type");
+	if (lua_isnumber(L, -1))
+		lib_queryType(L, q, lua_tointeger(L, -1));
+	else if (lua_istable(L, -1))
+	{
+		size_t i, n = lua_objlen(L, -1);
+		for (i = 1; i <= n; i++)
+		{
+			lua_rawgeti(L, -1, (int)i);
+			if (!lua_isnumber(L, -1))
+				luaL_error(L, "filter type list should only have mobj types");
+			lib_queryType(L, q, lua_tointeger(L, -1));
+			lua_pop(L, 1);
+		}
+	}
+	else if (!lua_isnil(L, -1))
+		luaL_error(L, "filter type should be a mobj type or a list of them");
+	lua_pop(L, 1);
+
+	q->flags = (UINT32)lib_queryNumber(L, idx, "flags", 0);
+	q->noflags = (UINT32)lib_queryNumber(L, idx, "noflags", 0);
+
+	q->z1 = (fixed_t)lib_queryNumber(L, idx, "z1", INT32_MIN);
+	q->z2 = (fixed_t)lib_queryNumber(L, idx, "z2", INT32_MAX);
+	q->zcheck = (q->z1 != INT32_MIN || q->z2 != INT32_MAX);
+
+	q->sight = lib_queryMobj(L, idx, "sight");
+	q->exclude = lib_queryMobj(L, idx, "exclude");
+	q->max = (size_t)max(0, lib_queryNumber(L, idx, "max", 0));
+}
+
+static boolean lib_queryMatches(const blockquery_t *q, mobj_t *mo)
+{
+	if (mo == q->exclude)
+		return false;
+	if (!q->anytype && !(q->types[mo->type/8] & (1<<(mo->type%8))))
+		return false;
+	if ((mo->flags & q->flags) != q->flags || (mo->flags & q->noflags))
+		return false;
+	if (q->zcheck && (mo->z > q->z2 || mo->z + mo->height < q->z1))
+		return false;
+	// Last, it's by far the slowest
+	if (q->sight && !P_CheckSight(q->sight, mo))
+		return false;
+	return true;
+}
+
+// Pushes a list of every thing touching the box that passes the filter
+// at filteridx. With radius >= 0, they have to touch the circle of that
+// radius around the box's center as well.
+static int lib_findObjectsIn(lua_State *L, fixed_t x1, fixed_t x2, fixed_t y1, fixed_t y2, fixed_t radius, int filteridx)
+{
+	blockquery_t q;
+	blockwalk_t walk;
+	mobj_t *mo;
+	INT32 xl, xh, yl, yh, bx, by;
+	fixed_t cx = x1/2 + x2/2, cy = y1/2 + y2/2;
+	int n = 0;
+
+	lib_readQuery(L, filteridx, &q);
+	lua_settop(L, 0);
+	lua_createtable(L, 0, 0);
+
+	// Things are only linked where their centers are
+	xl = (unsigned)(x1 - MAXRADIUS - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (unsigned)(x2 + MAXRADIUS - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (unsigned)(y1 - MAXRADIUS - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (unsigned)(y2 + MAXRADIUS - bmaporgy)>>MAPBLOCKSHIFT;
+
+	BMBOUNDFIX(xl, xh, yl, yh);
+	if (xh >= bmapwidth)
+		xh = bmapwidth - 1;
+	if (yh >= bmapheight)
+		yh = bmapheight - 1;
+
+	for (bx = xl; bx <= xh; bx++)
+		for (by = yl; by <= yh; by++)
+			for (mo = P_FirstBlockThing(&walk, bx, by); mo; mo = P_NextBlockThing(&walk))
+			{
+				if (mo->x + mo->radius <= x1 || mo->x - mo->radius >= x2
+				|| mo->y + mo->radius <= y1 || mo->y - mo->radius >= y2)
+					continue;
+				if (radius >= 0 && FixedHypot(mo->x - cx, mo->y - cy) > radius + mo->radius)
+					continue;
+				if (!lib_queryMatches(&q, mo))
+					continue;
+
+				LUA_PushUserdata(L, mo, META_MOBJ);
+				lua_rawseti(L, 1, ++n);
+				if (q.max && (size_t)n >= q.max)
+					return 1;
+			}
+
+	return 1;
+}
+
+// findObjects(x1, x2, y1, y2, [filter])
+// returns a list of the things touching the box, in blockmap order
+static int lib_findObjects(lua_State *L)
+{
+	fixed_t x1 = luaL_checkfixed(L, 1);
+	fixed_t x2 = luaL_checkfixed(L, 2);
+	fixed_t y1 = luaL_checkfixed(L, 3);
+	fixed_t y2 = luaL_checkfixed(L, 4);
+
+	if (x1 > x2 || y1 > y2)
+		return luaL_error(L, "box is inside out (x1 > x2 or y1 > y2)");
+	return lib_findObjectsIn(L, x1, x2, y1, y2, -1, 5);
+}
+
+// findObjectsInRadius(x, y, radius, [filter])
+// returns a list of the things touching the circle, in blockmap order
+static int lib_findObjectsInRadius(lua_State *L)
+{
+	fixed_t x = luaL_checkfixed(L, 1);
+	fixed_t y = luaL_checkfixed(L, 2);
+	fixed_t radius = luaL_checkfixed(L, 3);
+
+	luaL_argcheck(L, radius >= 0, 3, "radius can't be negative");
+	return lib_findObjectsIn(L, x - radius, x + radius, y - radius, y + radius, radius, 4);
+}
+
 int LUA_BlockmapLib(lua_State *L)
 {
 	lua_register(L, "searchBlockmap", lib_searchBlockmap);
+	lua_register(L, "findObjects", lib_findObjects);
+	lua_register(L, "findObjectsInRadius", lib_findObjectsInRadius);
 	return 0;
 }
 
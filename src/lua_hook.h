@@ -14,6 +14,7 @@
 
 #include "r_defs.h"
 #include "d_player.h"
+#include "command.h"
 
 enum hook {
 	hook_NetVars=0,
@@ -44,30 +45,50 @@ enum hook {
 	hook_HurtMsg,
 	hook_PlayerSpawn,
 	hook_PlayerQuit,
+	hook_MobjThinkerBatch,
 
 	hook_MAX // last hook
 };
 extern const char *const hookNames[];
 
+// For each mobj type, bit (1<<hook) is set if any hook of that kind could
+// run for it, generic MT_NULL hooks included. The macros below test it
+// before calling into lua_hooklib.c, so unhooked mobjs cost nothing.
+extern UINT32 mobjhookmask[NUMMOBJTYPES];
+#define LUAh_MobjHasHook(mo, which) (mobjhookmask[(mo)->type] & (1<<(which)))
+
+// The hook watchdog
+extern consvar_t cv_luahookinstructions, cv_luahookoverrun, cv_luahooktime;
+void Got_LuaHookOff(UINT8 **cp, INT32 playernum); // XD_LUAHOOKOFF
+void LUAh_ArchiveWatchdog(void); // Which hooks it has turned off, for joiners
+void LUAh_UnArchiveWatchdog(void);
+
+boolean LUAh_AnyHooks(void); // Whether any script has added a hook at all
 void LUAh_MapChange(INT16 mapnumber); // Hook for map change (before load)
 void LUAh_MapLoad(void); // Hook for map load
 void LUAh_PlayerJoin(int playernum); // Hook for Got_AddPlayer
 void LUAh_ThinkFrame(void); // Hook for frame (after mobj and player thinkers)
+void LUAh_MobjThinkerBatch(void); // Hook for every mobj of a type at once (before the thinkers)
 boolean LUAh_MobjHook(mobj_t *mo, enum hook which);
 boolean LUAh_PlayerHook(player_t *plr, enum hook which);
-#define LUAh_MobjSpawn(mo) LUAh_MobjHook(mo, hook_MobjSpawn) // Hook for P_SpawnMobj by mobj type
+#define LUAh_MobjSpawn(mo) (LUAh_MobjHasHook(mo, hook_MobjSpawn) && LUAh_MobjHook(mo, hook_MobjSpawn)) // Hook for P_SpawnMobj by mobj type
 UINT8 LUAh_MobjCollideHook(mobj_t *thing1, mobj_t *thing2, enum hook which);
-#define LUAh_MobjCollide(thing1, thing2) LUAh_MobjCollideHook(thing1, thing2, hook_MobjCollide) // Hook for PIT_CheckThing by (thing) mobj type
-#define LUAh_MobjMoveCollide(thing1, thing2) LUAh_MobjCollideHook(thing1, thing2, hook_MobjMoveCollide) // Hook for PIT_CheckThing by (tmthing) mobj type
-boolean LUAh_TouchSpecial(mobj_t *special, mobj_t *toucher); // Hook for P_TouchSpecialThing by mobj type
-#define LUAh_MobjFuse(mo) LUAh_MobjHook(mo, hook_MobjFuse) // Hook for mobj->fuse == 0 by mobj type
-boolean LUAh_MobjThinker(mobj_t *mo); // Hook for P_MobjThinker or P_SceneryThinker by mobj type
-#define LUAh_BossThinker(mo) LUAh_MobjHook(mo, hook_BossThinker) // Hook for P_GenericBossThinker by mobj type
-UINT8 LUAh_ShouldDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage); // Hook for P_DamageMobj by mobj type (Should mobj take damage?)
-boolean LUAh_MobjDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage); // Hook for P_DamageMobj by mobj type (Mobj actually takes damage!)
-boolean LUAh_MobjDeath(mobj_t *target, mobj_t *inflictor, mobj_t *source); // Hook for P_KillMobj by mobj type
-#define LUAh_BossDeath(mo) LUAh_MobjHook(mo, hook_BossDeath) // Hook for A_BossDeath by mobj type
-#define LUAh_MobjRemoved(mo) LUAh_MobjHook(mo, hook_MobjRemoved) // Hook for P_RemoveMobj by mobj type
+#define LUAh_MobjCollide(thing1, thing2) (LUAh_MobjHasHook(thing1, hook_MobjCollide) ? LUAh_MobjCollideHook(thing1, thing2, hook_MobjCollide) : 0) // Hook for PIT_CheckThing by (thing) mobj type
+#define LUAh_MobjMoveCollide(thing1, thing2) (LUAh_MobjHasHook(thing1, hook_MobjMoveCollide) ? LUAh_MobjCollideHook(thing1, thing2, hook_MobjMoveCollide) : 0) // Hook for PIT_CheckThing by (tmthing) mobj type
+boolean LUAh_TouchSpecialHook(mobj_t *special, mobj_t *toucher);
+#define LUAh_TouchSpecial(special, toucher) (LUAh_MobjHasHook(special, hook_TouchSpecial) && LUAh_TouchSpecialHook(special, toucher)) // Hook for P_TouchSpecialThing by mobj type
+#define LUAh_MobjFuse(mo) (LUAh_MobjHasHook(mo, hook_MobjFuse) && LUAh_MobjHook(mo, hook_MobjFuse)) // Hook for mobj->fuse == 0 by mobj type
+boolean LUAh_MobjThinkerHook(mobj_t *mo);
+#define LUAh_MobjThinker(mo) (LUAh_MobjHasHook(mo, hook_MobjThinker) && LUAh_MobjThinkerHook(mo)) // Hook for P_MobjThinker or P_SceneryThinker by mobj type
+#define LUAh_BossThinker(mo) (LUAh_MobjHasHook(mo, hook_BossThinker) && LUAh_MobjHook(mo, hook_BossThinker)) // Hook for P_GenericBossThinker by mobj type
+UINT8 LUAh_ShouldDamageHook(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage);
+#define LUAh_ShouldDamage(target, inflictor, source, damage) (LUAh_MobjHasHook(target, hook_ShouldDamage) ? LUAh_ShouldDamageHook(target, inflictor, source, damage) : 0) // Hook for P_DamageMobj by mobj type (Should mobj take damage?)
+boolean LUAh_MobjDamageHook(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage);
+#define LUAh_MobjDamage(target, inflictor, source, damage) (LUAh_MobjHasHook(target, hook_MobjDamage) && LUAh_MobjDamageHook(target, inflictor, source, damage)) // Hook for P_DamageMobj by mobj type (Mobj actually takes damage!)
+boolean LUAh_MobjDeathHook(mobj_t *target, mobj_t *inflictor, mobj_t *source);
+#define LUAh_MobjDeath(target, inflictor, source) (LUAh_MobjHasHook(target, hook_MobjDeath) && LUAh_MobjDeathHook(target, inflictor, source)) // Hook for P_KillMobj by mobj type
+#define LUAh_BossDeath(mo) (LUAh_MobjHasHook(mo, hook_BossDeath) && LUAh_MobjHook(mo, hook_BossDeath)) // Hook for A_BossDeath by mobj type
+#define LUAh_MobjRemoved(mo) (LUAh_MobjHasHook(mo, hook_MobjRemoved) && LUAh_MobjHook(mo, hook_MobjRemoved)) // Hook for P_RemoveMobj by mobj type
 #define LUAh_JumpSpecial(player) LUAh_PlayerHook(player, hook_JumpSpecial) // Hook for P_DoJumpStuff (Any-jumping)
 #define LUAh_AbilitySpecial(player) LUAh_PlayerHook(player, hook_AbilitySpecial) // Hook for P_DoJumpStuff (Double-jumping)
 #define LUAh_SpinSpecial(player) LUAh_PlayerHook(player, hook_SpinSpecial) // Hook for P_DoSpinDash (Spin button effect)
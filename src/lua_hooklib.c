@@ -18,11 +18,18 @@
 #include "r_things.h"
 #include "b_bot.h"
 #include "z_zone.h"
+#include "i_system.h"
+#include "byteptr.h"
+#include "d_clisrv.h"
+#include "d_netcmd.h"
+#include "p_saveg.h"
 
 #include "lua_script.h"
 #include "lua_libs.h"
 #include "lua_hook.h"
 #include "lua_hud.h" // hud_running errors
+#include "m_perfstats.h"
+#include "m_bench.h"
 
 static UINT8 hooksAvailable[(hook_MAX/8)+1];
 
@@ -55,6 +62,7 @@ const char *const hookNames[hook_MAX+1] = {
 	"HurtMsg",
 	"PlayerSpawn",
 	"PlayerQuit",
+	"MobjThinkerBatch",
 	NULL
 };
 
@@ -64,16 +72,30 @@ struct hook_s
 	struct hook_s *next;
 	enum hook type;
 	UINT16 id;
+	int ref; // the function, as a reference in the registry
 	union {
 		mobjtype_t mt;
 		char *skinname;
 		char *funcname;
 	} s;
 	boolean error;
+
+	// For the watchdog
+	boolean disabled; // turned off for running over budget
+	boolean timewarned; // reported going over lua_hooktime
+	tic_t budgettic; // the tic the counts below are for
+	UINT32 ticinstructions;
+	UINT32 ticmicros;
 };
 typedef struct hook_s* hook_p;
 
-#define FMT_HOOKID "hook_%d"
+// Pushes the hook's function. A reference is an integer key, so this is a
+// plain array read, where a "hook_%d" name had to be formatted and hashed.
+#define PushHook(L, hookp) lua_rawgeti(L, LUA_REGISTRYINDEX, (hookp)->ref)
+
+// Every hook, by id
+static hook_p *hooksbyid = NULL;
+static UINT32 numhooks = 0;
 
 // For each mobj type, a linked list to its thinker and collision hooks.
 // That way, we don't have to iterate through all the hooks.
@@ -85,19 +107,305 @@ static hook_p mobjcollidehooks[NUMMOBJTYPES];
 // For each mobj type, a linked list for other mobj hooks
 static hook_p mobjhooks[NUMMOBJTYPES];
 
+// MobjThinkerBatch hooks, by mobj type, and the types that have any, in
+// the order they got their first
+static hook_p mobjbatchhooks[NUMMOBJTYPES];
+static mobjtype_t batchtypes[NUMMOBJTYPES];
+static size_t numbatchtypes = 0;
+
+UINT32 mobjhookmask[NUMMOBJTYPES];
+
 // A linked list for player hooks
 static hook_p playerhooks;
 
-// A linked list for linedef executor hooks
-static hook_p linedefexecutorhooks;
+// Linedef executor hooks, by the function name they answer to. Each name
+// has a linked list of its hooks, so a linedef only ever looks at its own.
+typedef struct lexechooks_s
+{
+	struct lexechooks_s *hashnext;
+	const char *name;
+	hook_p hooks;
+} lexechooks_t;
+
+#define LEXEC_HASHSIZE 256
+static lexechooks_t *lexechooks[LEXEC_HASHSIZE];
+
+// Bumped whenever a new name gets a hook, so lines that found nothing
+// for theirs look again
+static UINT32 lexecstamp = 1;
+
+static size_t LexecHashName(const char *name)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	while (*name)
+	{
+		hash ^= (UINT8)*name++;
+		hash *= 16777619u;
+	}
+	return hash & (LEXEC_HASHSIZE-1);
+}
+
+// Finds the hooks for a name, adding the name if create is set.
+static lexechooks_t *FindLexecHooks(const char *name, boolean create)
+{
+	const size_t hash = LexecHashName(name);
+	lexechooks_t *lh;
+
+	for (lh = lexechooks[hash]; lh; lh = lh->hashnext)
+		if (!strcmp(lh->name, name))
+			return lh;
+
+	if (!create)
+		return NULL;
+
+	lh = ZZ_Alloc(sizeof (*lh));
+	lh->name = name;
+	lh->hooks = NULL;
+	lh->hashnext = lexechooks[hash];
+	lexechooks[hash] = lh;
+	lexecstamp++;
+	return lh;
+}
 
 // For other hooks, a unique linked list
 hook_p roothook;
 
+// Marks a hook of this kind as present for type, or for all types if MT_NULL.
+static void SetMobjHookMask(enum hook which, mobjtype_t type)
+{
+	size_t i;
+
+	if (type != MT_NULL)
+	{
+		mobjhookmask[type] |= 1<<which;
+		return;
+	}
+
+	for (i = 0; i < NUMMOBJTYPES; i++)
+		mobjhookmask[i] |= 1<<which;
+}
+
+//
+// Watchdog
+//
+// While it's on, a count hook ticks every WATCHDOG_STEP instructions,
+// and every hook's instructions are added up for the tic. A hook going
+// over lua_hookinstructions is stopped with an error right there. The
+// count is restarted from the same point every time a hook starts or
+// ends, so that happens at the same instruction on every node, and
+// with lua_hookoverrun set to Disable, the hook is turned off after.
+//
+// Wall time can't be the same everywhere, so only the server looks at
+// lua_hooktime, and turns a hook off for everyone with XD_LUAHOOKOFF.
+//
+// NetVars, BotTiccmd and BotAI hooks only run on some nodes, so they
+// are counted for tickprofile but left alone.
+//
+
+static CV_PossibleValue_t luahookoverrun_cons_t[] = {{0, "Abort"}, {1, "Disable"}, {0, NULL}};
+consvar_t cv_luahookinstructions = {"lua_hookinstructions", "50000000", CV_NETVAR, CV_Unsigned, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_luahookoverrun = {"lua_hookoverrun", "Abort", CV_NETVAR, luahookoverrun_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_luahooktime = {"lua_hooktime", "0", CV_SAVE, CV_Unsigned, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+#define WATCHDOG_STEP 1000
+
+#define TIMING (cv_luahooktime.value || ps_tickprofiling || cv_perfstats.value)
+#define WATCHING (cv_luahookinstructions.value || TIMING)
+#define POLICED(hookp) ((hookp)->type != hook_NetVars && (hookp)->type != hook_BotTiccmd && (hookp)->type != hook_BotAI)
+
+static hook_p watchhook = NULL; // the hook running now
+static UINT32 watchcount = 0; // instructions seen by the count hook
+static UINT32 watchstart; // the count when watchhook started, or got back control
+
+// Instructions run so far, while the count hook is set.
+static inline UINT32 Watchdog_Count(void)
+{
+	return watchcount + (WATCHDOG_STEP - lua_gethookcountleft(gL));
+}
+
+static void Watchdog_Hook(lua_State *L, lua_Debug *ar)
+{
+	(void)ar;
+	watchcount += WATCHDOG_STEP;
+
+	if (!watchhook || !cv_luahookinstructions.value || !POLICED(watchhook))
+		return;
+	if (watchhook->ticinstructions + (Watchdog_Count() - watchstart) <= (UINT32)cv_luahookinstructions.value)
+		return;
+
+	if (cv_luahookoverrun.value)
+		watchhook->disabled = true;
+	luaL_error(L, "%s hook ran over lua_hookinstructions%s", hookNames[watchhook->type],
+		watchhook->disabled ? ", turning it off" : "");
+}
+
+// Starts counting for hookp, and returns the hook it interrupts, if any.
+static hook_p Watchdog_Start(hook_p hookp)
+{
+	hook_p outer = watchhook;
+
+	if (outer)
+		outer->ticinstructions += Watchdog_Count() - watchstart;
+
+	if (hookp->budgettic != gametic)
+	{
+		hookp->budgettic = gametic;
+		hookp->ticinstructions = hookp->ticmicros = 0;
+	}
+
+	lua_sethook(gL, Watchdog_Hook, LUA_MASKCOUNT, WATCHDOG_STEP);
+	watchhook = hookp;
+	watchstart = Watchdog_Count();
+	return outer;
+}
+
+static void Watchdog_Finish(hook_p hookp, hook_p outer, UINT32 micros)
+{
+	UINT32 used = Watchdog_Count() - watchstart;
+
+	hookp->ticinstructions += used;
+	hookp->ticmicros += micros;
+	if (ps_tickprofiling)
+	{
+		PS_AddHookTime(hookp->type, micros);
+		PS_AddHookInstructions(hookp->type, used);
+	}
+	if (cv_perfstats.value && !outer)
+		ps_frametime[PSF_LUAHOOK] += micros;
+
+	watchhook = outer;
+	if (outer)
+	{
+		lua_sethook(gL, Watchdog_Hook, LUA_MASKCOUNT, WATCHDOG_STEP);
+		watchstart = Watchdog_Count();
+	}
+	else
+		lua_sethook(gL, NULL, 0, 0);
+
+	if (cv_luahooktime.value && hookp->ticmicros > (UINT32)cv_luahooktime.value
+		&& !hookp->timewarned && POLICED(hookp) && server)
+	{
+		hookp->timewarned = true;
+		CONS_Alert(CONS_WARNING, M_GetText("%s hook took %u us this tic, over lua_hooktime\n"), hookNames[hookp->type], hookp->ticmicros);
+		if (cv_luahookoverrun.value)
+		{
+			UINT8 buf[2], *p = buf;
+			WRITEUINT16(p, hookp->id);
+			SendNetXCmd(XD_LUAHOOKOFF, buf, p - buf);
+		}
+	}
+}
+
+// Calls the hook function below its nargs arguments on the stack,
+// catching errors like lua_pcall, and watches and times it.
+static int call_hook(hook_p hookp, int nargs, int nresults)
+{
+	UINT32 start = 0;
+	hook_p outer;
+	int err;
+
+	if (hookp->disabled)
+	{
+		// Leave the stack looking like it returned nothing
+		lua_pop(gL, nargs + 1);
+		for (; nresults > 0; nresults--)
+			lua_pushnil(gL);
+		return 0;
+	}
+
+	BENCH_ENTER(BENCH_HOOKS);
+	if (!WATCHING)
+		err = lua_pcall(gL, nargs, nresults, 0);
+	else
+	{
+		outer = Watchdog_Start(hookp);
+		if (TIMING)
+			start = I_GetTimeMicros();
+		err = lua_pcall(gL, nargs, nresults, 0);
+		Watchdog_Finish(hookp, outer, start ? I_GetTimeMicros() - start : 0);
+	}
+	BENCH_EXIT(BENCH_HOOKS);
+	return err;
+}
+
+// Same as above, but leaves errors to LUA_Call.
+static void call_hook_unprotected(hook_p hookp, int nargs)
+{
+	UINT32 start = 0;
+	hook_p outer;
+
+	if (hookp->disabled)
+	{
+		lua_pop(gL, nargs + 1);
+		return;
+	}
+
+	BENCH_ENTER(BENCH_HOOKS);
+	if (!WATCHING)
+	{
+		LUA_Call(gL, nargs);
+	}
+	else
+	{
+		outer = Watchdog_Start(hookp);
+		if (TIMING)
+			start = I_GetTimeMicros();
+		LUA_Call(gL, nargs);
+		Watchdog_Finish(hookp, outer, start ? I_GetTimeMicros() - start : 0);
+	}
+	BENCH_EXIT(BENCH_HOOKS);
+}
+
+void Got_LuaHookOff(UINT8 **cp, INT32 playernum)
+{
+	UINT16 id = READUINT16(*cp);
+	hook_p hookp;
+
+	if (playernum != serverplayer) // only the server times hooks
+		return;
+	if (id >= numhooks)
+		return;
+
+	hookp = hooksbyid[id];
+	if (hookp->disabled)
+		return;
+	hookp->disabled = true;
+	CONS_Alert(CONS_WARNING, M_GetText("The server turned off a %s hook for taking too long.\n"), hookNames[hookp->type]);
+}
+
+void LUAh_ArchiveWatchdog(void)
+{
+	UINT32 i;
+	UINT16 count = 0;
+
+	for (i = 0; i < numhooks; i++)
+		if (hooksbyid[i]->disabled)
+			count++;
+
+	WRITEUINT16(save_p, count);
+	for (i = 0; i < numhooks; i++)
+		if (hooksbyid[i]->disabled)
+			WRITEUINT16(save_p, (UINT16)i);
+}
+
+void LUAh_UnArchiveWatchdog(void)
+{
+	UINT16 count = READUINT16(save_p);
+	UINT16 id;
+
+	while (count--)
+	{
+		id = READUINT16(save_p);
+		if (id < numhooks)
+			hooksbyid[id]->disabled = true;
+	}
+}
+
 // Takes hook, function, and additional arguments (mobj type to act on, etc.)
 static int lib_addHook(lua_State *L)
 {
-	static struct hook_s hook = {NULL, 0, 0, {0}, false};
+	static struct hook_s hook = {NULL, 0, 0, 0, {0}, false};
 	static UINT32 nextid;
 	hook_p hookp, *lastp;
 
@@ -125,10 +433,12 @@ static int lib_addHook(lua_State *L)
 	case hook_BossDeath:
 	case hook_MobjRemoved:
 	case hook_HurtMsg:
+	case hook_MobjThinkerBatch:
 		hook.s.mt = MT_NULL;
 		if (lua_isnumber(L, 2))
 			hook.s.mt = lua_tonumber(L, 2);
 		luaL_argcheck(L, hook.s.mt < NUMMOBJTYPES, 2, "invalid mobjtype_t");
+		luaL_argcheck(L, hook.type != hook_MobjThinkerBatch || hook.s.mt != MT_NULL, 2, "MobjThinkerBatch needs a mobjtype_t");
 		break;
 	case hook_BotAI:
 		hook.s.skinname = NULL;
@@ -159,6 +469,9 @@ static int lib_addHook(lua_State *L)
 	}
 	lua_settop(L, 1); // lua stack contains only the function now.
 
+	// set the hook function in the registry.
+	hook.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
 	hooksAvailable[hook.type/8] |= 1<<(hook.type%8);
 
 	// set hook.id to the highest id + 1
@@ -169,10 +482,12 @@ static int lib_addHook(lua_State *L)
 	{
 	case hook_MobjThinker:
 		lastp = &mobjthinkerhooks[hook.s.mt];
+		SetMobjHookMask(hook.type, hook.s.mt);
 		break;
 	case hook_MobjCollide:
 	case hook_MobjMoveCollide:
 		lastp = &mobjcollidehooks[hook.s.mt];
+		SetMobjHookMask(hook.type, hook.s.mt);
 		break;
 	case hook_MobjSpawn:
 	case hook_TouchSpecial:
@@ -184,6 +499,12 @@ static int lib_addHook(lua_State *L)
 	case hook_BossDeath:
 	case hook_MobjRemoved:
 		lastp = &mobjhooks[hook.s.mt];
+		SetMobjHookMask(hook.type, hook.s.mt);
+		break;
+	case hook_MobjThinkerBatch:
+		if (!mobjbatchhooks[hook.s.mt])
+			batchtypes[numbatchtypes++] = hook.s.mt;
+		lastp = &mobjbatchhooks[hook.s.mt];
 		break;
 	case hook_JumpSpecial:
 	case hook_AbilitySpecial:
@@ -193,7 +514,7 @@ static int lib_addHook(lua_State *L)
 		lastp = &playerhooks;
 		break;
 	case hook_LinedefExecute:
-		lastp = &linedefexecutorhooks;
+		lastp = &FindLexecHooks(hook.s.funcname, true)->hooks;
 		break;
 	default:
 		lastp = &roothook;
@@ -210,21 +531,37 @@ static int lib_addHook(lua_State *L)
 	// tack it onto the end of the linked list.
 	*lastp = hookp;
 
-	// set the hook function in the registry.
-	lua_pushfstring(L, FMT_HOOKID, hook.id);
-	lua_pushvalue(L, 1);
-	lua_settable(L, LUA_REGISTRYINDEX);
+	// and remember it by id, for the watchdog
+	if (!(numhooks % 64))
+		hooksbyid = Z_Realloc(hooksbyid, (numhooks + 64) * sizeof (*hooksbyid), PU_STATIC, NULL);
+	hooksbyid[numhooks++] = hookp;
 	return 0;
 }
 
 int LUA_HookLib(lua_State *L)
 {
 	memset(hooksAvailable,0,sizeof(UINT8[(hook_MAX/8)+1]));
+	memset(mobjhookmask,0,sizeof(mobjhookmask));
 	roothook = NULL;
+	memset(mobjbatchhooks, 0, sizeof (mobjbatchhooks));
+	numbatchtypes = 0;
+	memset(lexechooks, 0, sizeof (lexechooks));
+	lexecstamp++;
 	lua_register(L, "addHook", lib_addHook);
 	return 0;
 }
 
+boolean LUAh_AnyHooks(void)
+{
+	size_t i;
+	if (!gL)
+		return false;
+	for (i = 0; i < sizeof (hooksAvailable); i++)
+		if (hooksAvailable[i])
+			return true;
+	return false;
+}
+
 boolean LUAh_MobjHook(mobj_t *mo, enum hook which)
 {
 	hook_p hookp;
@@ -242,10 +579,9 @@ boolean LUAh_MobjHook(mobj_t *mo, enum hook which)
 		{
 			if (lua_gettop(gL) == 0)
 				LUA_PushUserdata(gL, mo, META_MOBJ);
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			if (lua_pcall(gL, 1, 1, 0)) {
+			if (call_hook(hookp, 1, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -262,10 +598,9 @@ boolean LUAh_MobjHook(mobj_t *mo, enum hook which)
 		{
 			if (lua_gettop(gL) == 0)
 				LUA_PushUserdata(gL, mo, META_MOBJ);
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			if (lua_pcall(gL, 1, 1, 0)) {
+			if (call_hook(hookp, 1, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -295,10 +630,9 @@ boolean LUAh_PlayerHook(player_t *plr, enum hook which)
 		{
 			if (lua_gettop(gL) == 0)
 				LUA_PushUserdata(gL, plr, META_PLAYER);
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			if (lua_pcall(gL, 1, 1, 0)) {
+			if (call_hook(hookp, 1, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -327,10 +661,9 @@ void LUAh_MapChange(INT16 mapnumber)
 	for (hookp = roothook; hookp; hookp = hookp->next)
 		if (hookp->type == hook_MapChange)
 		{
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			LUA_Call(gL, 1);
+			call_hook_unprotected(hookp, 1);
 		}
 
 	lua_settop(gL, 0);
@@ -349,10 +682,9 @@ void LUAh_MapLoad(void)
 	for (hookp = roothook; hookp; hookp = hookp->next)
 		if (hookp->type == hook_MapLoad)
 		{
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			LUA_Call(gL, 1);
+			call_hook_unprotected(hookp, 1);
 		}
 
 	lua_settop(gL, 0);
@@ -371,10 +703,9 @@ void LUAh_PlayerJoin(int playernum)
 	for (hookp = roothook; hookp; hookp = hookp->next)
 		if (hookp->type == hook_PlayerJoin)
 		{
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2);
-			LUA_Call(gL, 1);
+			call_hook_unprotected(hookp, 1);
 		}
 
 	lua_settop(gL, 0);
@@ -390,15 +721,61 @@ void LUAh_ThinkFrame(void)
 	for (hookp = roothook; hookp; hookp = hookp->next)
 		if (hookp->type == hook_ThinkFrame)
 		{
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
-			if (lua_pcall(gL, 0, 0, 0)) {
+			PushHook(gL, hookp);
+			if (call_hook(hookp, 0, 0)) {
+				if (!hookp->error || cv_debug & DBG_LUA)
+					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
+				lua_pop(gL, 1);
+				hookp->error = true;
+			}
+		}
+}
+
+// Hook for every mobj of a type at once, before the thinkers run. Each
+// hook gets an array of the type's mobjs in the order they were spawned,
+// shared with the type's other hooks. Their thinkers still run after, so
+// it can't replace them the way a MobjThinker hook returning true can.
+void LUAh_MobjThinkerBatch(void)
+{
+	hook_p hookp;
+	mobj_t *mo;
+	size_t i;
+	int n;
+	if (!gL || !(hooksAvailable[hook_MobjThinkerBatch/8] & (1<<(hook_MobjThinkerBatch%8))))
+		return;
+
+	lua_settop(gL, 0);
+
+	for (i = 0; i < numbatchtypes; i++)
+	{
+		const mobjtype_t type = batchtypes[i];
+
+		lua_newtable(gL);
+		n = 0;
+		for (mo = P_FindMobjFromType(type, NULL); mo; mo = P_FindMobjFromType(type, mo))
+		{
+			LUA_PushUserdata(gL, mo, META_MOBJ);
+			lua_rawseti(gL, -2, ++n);
+		}
+		if (!n) // nothing to call them for
+		{
+			lua_settop(gL, 0);
+			continue;
+		}
+
+		for (hookp = mobjbatchhooks[type]; hookp; hookp = hookp->next)
+		{
+			PushHook(gL, hookp);
+			lua_pushvalue(gL, -2);
+			if (call_hook(hookp, 1, 0)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
 				hookp->error = true;
 			}
 		}
+		lua_settop(gL, 0);
+	}
 }
 
 // Hook for mobj collisions
@@ -422,11 +799,10 @@ UINT8 LUAh_MobjCollideHook(mobj_t *thing1, mobj_t *thing2, enum hook which)
 				LUA_PushUserdata(gL, thing1, META_MOBJ);
 				LUA_PushUserdata(gL, thing2, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 1, 0)) {
+			if (call_hook(hookp, 2, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -451,11 +827,10 @@ UINT8 LUAh_MobjCollideHook(mobj_t *thing1, mobj_t *thing2, enum hook which)
 				LUA_PushUserdata(gL, thing1, META_MOBJ);
 				LUA_PushUserdata(gL, thing2, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 1, 0)) {
+			if (call_hook(hookp, 2, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -477,7 +852,7 @@ UINT8 LUAh_MobjCollideHook(mobj_t *thing1, mobj_t *thing2, enum hook which)
 }
 
 // Hook for mobj thinkers
-boolean LUAh_MobjThinker(mobj_t *mo)
+boolean LUAh_MobjThinkerHook(mobj_t *mo)
 {
 	hook_p hookp;
 	boolean hooked = false;
@@ -493,10 +868,9 @@ boolean LUAh_MobjThinker(mobj_t *mo)
 	{
 		if (lua_gettop(gL) == 0)
 			LUA_PushUserdata(gL, mo, META_MOBJ);
-		lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-		lua_gettable(gL, LUA_REGISTRYINDEX);
+		PushHook(gL, hookp);
 		lua_pushvalue(gL, -2);
-		if (lua_pcall(gL, 1, 1, 0)) {
+		if (call_hook(hookp, 1, 1)) {
 			if (!hookp->error || cv_debug & DBG_LUA)
 				CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 			lua_pop(gL, 1);
@@ -512,10 +886,9 @@ boolean LUAh_MobjThinker(mobj_t *mo)
 	{
 		if (lua_gettop(gL) == 0)
 			LUA_PushUserdata(gL, mo, META_MOBJ);
-		lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-		lua_gettable(gL, LUA_REGISTRYINDEX);
+		PushHook(gL, hookp);
 		lua_pushvalue(gL, -2);
-		if (lua_pcall(gL, 1, 1, 0)) {
+		if (call_hook(hookp, 1, 1)) {
 			if (!hookp->error || cv_debug & DBG_LUA)
 				CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 			lua_pop(gL, 1);
@@ -532,7 +905,7 @@ boolean LUAh_MobjThinker(mobj_t *mo)
 }
 
 // Hook for P_TouchSpecialThing by mobj type
-boolean LUAh_TouchSpecial(mobj_t *special, mobj_t *toucher)
+boolean LUAh_TouchSpecialHook(mobj_t *special, mobj_t *toucher)
 {
 	hook_p hookp;
 	boolean hooked = false;
@@ -552,11 +925,10 @@ boolean LUAh_TouchSpecial(mobj_t *special, mobj_t *toucher)
 				LUA_PushUserdata(gL, special, META_MOBJ);
 				LUA_PushUserdata(gL, toucher, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 1, 0)) {
+			if (call_hook(hookp, 2, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -576,11 +948,10 @@ boolean LUAh_TouchSpecial(mobj_t *special, mobj_t *toucher)
 				LUA_PushUserdata(gL, special, META_MOBJ);
 				LUA_PushUserdata(gL, toucher, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 1, 0)) {
+			if (call_hook(hookp, 2, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -597,7 +968,7 @@ boolean LUAh_TouchSpecial(mobj_t *special, mobj_t *toucher)
 }
 
 // Hook for P_DamageMobj by mobj type (Should mobj take damage?)
-UINT8 LUAh_ShouldDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage)
+UINT8 LUAh_ShouldDamageHook(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage)
 {
 	hook_p hookp;
 	UINT8 shouldDamage = 0; // 0 = default, 1 = force yes, 2 = force no.
@@ -619,13 +990,12 @@ UINT8 LUAh_ShouldDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 				LUA_PushUserdata(gL, source, META_MOBJ);
 				lua_pushinteger(gL, damage);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
-			if (lua_pcall(gL, 4, 1, 0)) {
+			if (call_hook(hookp, 4, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -652,13 +1022,12 @@ UINT8 LUAh_ShouldDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 				LUA_PushUserdata(gL, source, META_MOBJ);
 				lua_pushinteger(gL, damage);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
-			if (lua_pcall(gL, 4, 1, 0)) {
+			if (call_hook(hookp, 4, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -680,7 +1049,7 @@ UINT8 LUAh_ShouldDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 }
 
 // Hook for P_DamageMobj by mobj type (Mobj actually takes damage!)
-boolean LUAh_MobjDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage)
+boolean LUAh_MobjDamageHook(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 damage)
 {
 	hook_p hookp;
 	boolean hooked = false;
@@ -702,13 +1071,12 @@ boolean LUAh_MobjDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 				LUA_PushUserdata(gL, source, META_MOBJ);
 				lua_pushinteger(gL, damage);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
-			if (lua_pcall(gL, 4, 1, 0)) {
+			if (call_hook(hookp, 4, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -730,13 +1098,12 @@ boolean LUAh_MobjDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 				LUA_PushUserdata(gL, source, META_MOBJ);
 				lua_pushinteger(gL, damage);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
-			if (lua_pcall(gL, 4, 1, 0)) {
+			if (call_hook(hookp, 4, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -753,7 +1120,7 @@ boolean LUAh_MobjDamage(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32
 }
 
 // Hook for P_KillMobj by mobj type
-boolean LUAh_MobjDeath(mobj_t *target, mobj_t *inflictor, mobj_t *source)
+boolean LUAh_MobjDeathHook(mobj_t *target, mobj_t *inflictor, mobj_t *source)
 {
 	hook_p hookp;
 	boolean hooked = false;
@@ -774,12 +1141,11 @@ boolean LUAh_MobjDeath(mobj_t *target, mobj_t *inflictor, mobj_t *source)
 				LUA_PushUserdata(gL, inflictor, META_MOBJ);
 				LUA_PushUserdata(gL, source, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
-			if (lua_pcall(gL, 3, 1, 0)) {
+			if (call_hook(hookp, 3, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -800,12 +1166,11 @@ boolean LUAh_MobjDeath(mobj_t *target, mobj_t *inflictor, mobj_t *source)
 				LUA_PushUserdata(gL, inflictor, META_MOBJ);
 				LUA_PushUserdata(gL, source, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
-			if (lua_pcall(gL, 3, 1, 0)) {
+			if (call_hook(hookp, 3, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -839,11 +1204,10 @@ boolean LUAh_BotTiccmd(player_t *bot, ticcmd_t *cmd)
 				LUA_PushUserdata(gL, bot, META_PLAYER);
 				LUA_PushUserdata(gL, cmd, META_TICCMD);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 1, 0)) {
+			if (call_hook(hookp, 2, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -878,11 +1242,10 @@ boolean LUAh_BotAI(mobj_t *sonic, mobj_t *tails, ticcmd_t *cmd)
 				LUA_PushUserdata(gL, sonic, META_MOBJ);
 				LUA_PushUserdata(gL, tails, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			if (lua_pcall(gL, 2, 8, 0)) {
+			if (call_hook(hookp, 2, 8)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -927,26 +1290,35 @@ boolean LUAh_LinedefExecute(line_t *line, mobj_t *mo, sector_t *sector)
 	boolean hooked = false;
 	if (!gL || !(hooksAvailable[hook_LinedefExecute/8] & (1<<(hook_LinedefExecute%8))))
 		return 0;
+	if (!line->text)
+		return 0;
+
+	// The line remembers which hooks its name has
+	if (line->luaexecstamp != lexecstamp)
+	{
+		line->luaexechooks = FindLexecHooks(line->text, false);
+		line->luaexecstamp = lexecstamp;
+	}
+	if (!line->luaexechooks)
+		return 0;
 
 	lua_settop(gL, 0);
 
-	for (hookp = linedefexecutorhooks; hookp; hookp = hookp->next)
-		if (!strcmp(hookp->s.funcname, line->text))
+	for (hookp = ((lexechooks_t *)line->luaexechooks)->hooks; hookp; hookp = hookp->next)
+	{
+		if (lua_gettop(gL) == 0)
 		{
-			if (lua_gettop(gL) == 0)
-			{
-				LUA_PushUserdata(gL, line, META_LINE);
-				LUA_PushUserdata(gL, mo, META_MOBJ);
-				LUA_PushUserdata(gL, sector, META_SECTOR);
-			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
-			lua_pushvalue(gL, -4);
-			lua_pushvalue(gL, -4);
-			lua_pushvalue(gL, -4);
-			LUA_Call(gL, 3);
-			hooked = true;
+			LUA_PushUserdata(gL, line, META_LINE);
+			LUA_PushUserdata(gL, mo, META_MOBJ);
+			LUA_PushUserdata(gL, sector, META_SECTOR);
 		}
+		PushHook(gL, hookp);
+		lua_pushvalue(gL, -4);
+		lua_pushvalue(gL, -4);
+		lua_pushvalue(gL, -4);
+		call_hook_unprotected(hookp, 3);
+		hooked = true;
+	}
 
 	lua_settop(gL, 0);
 	return hooked;
@@ -983,13 +1355,12 @@ boolean LUAh_PlayerMsg(int source, int target, int flags, char *msg)
 				}
 				lua_pushstring(gL, msg); // msg
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
 			lua_pushvalue(gL, -5);
-			if (lua_pcall(gL, 4, 1, 0)) {
+			if (call_hook(hookp, 4, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -1026,12 +1397,11 @@ boolean LUAh_HurtMsg(player_t *player, mobj_t *inflictor, mobj_t *source)
 				LUA_PushUserdata(gL, inflictor, META_MOBJ);
 				LUA_PushUserdata(gL, source, META_MOBJ);
 			}
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
 			lua_pushvalue(gL, -4);
-			if (lua_pcall(gL, 3, 1, 0)) {
+			if (call_hook(hookp, 3, 1)) {
 				if (!hookp->error || cv_debug & DBG_LUA)
 					CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL, -1));
 				lua_pop(gL, 1);
@@ -1066,10 +1436,9 @@ void LUAh_NetArchiveHook(lua_CFunction archFunc)
 	for (hookp = roothook; hookp; hookp = hookp->next)
 		if (hookp->type == hook_NetVars)
 		{
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -2); // archFunc
-			LUA_Call(gL, 1);
+			call_hook_unprotected(hookp, 1);
 		}
 
 	lua_pop(gL, 1); // pop archFunc
@@ -1092,11 +1461,10 @@ void LUAh_PlayerQuit(player_t *plr, int reason)
 		        LUA_PushUserdata(gL, plr, META_PLAYER); // Player that quit
 		        lua_pushinteger(gL, reason); // Reason for quitting
 		    }
-			lua_pushfstring(gL, FMT_HOOKID, hookp->id);
-			lua_gettable(gL, LUA_REGISTRYINDEX);
+			PushHook(gL, hookp);
 			lua_pushvalue(gL, -3);
 			lua_pushvalue(gL, -3);
-			LUA_Call(gL, 2);
+			call_hook_unprotected(hookp, 2);
 		}
 
 	lua_settop(gL, 0);
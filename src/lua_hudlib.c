@@ -331,140 +331,398 @@ static int libd_patchExists(lua_State *L)
 	return 1;
 }
 
+// HUD scripts tend to call v.cachePatch for the same names every frame,
+// so what each name found is remembered until a file is added or the
+// renderer changes, either of which can change the answer.
+#define PATCHCACHESIZE 256 // Must be a power of two
+
+typedef struct patchcache_s
+{
+	char name[9]; // as W_CheckNumForName sees it: eight characters, uppercase
+	patch_t *patch;
+	struct patchcache_s *next;
+} patchcache_t;
+
+static patchcache_t *patchcache[PATCHCACHESIZE];
+static UINT16 patchcachewads = 0;
+static INT32 patchcacherender = -1;
+
+static void LUA_FlushPatchCache(void)
+{
+	patchcache_t *entry, *next;
+	size_t i;
+
+	for (i = 0; i < PATCHCACHESIZE; i++)
+	{
+		for (entry = patchcache[i]; entry; entry = next)
+		{
+			next = entry->next;
+			free(entry);
+		}
+		patchcache[i] = NULL;
+	}
+	patchcachewads = numwadfiles;
+	patchcacherender = rendermode;
+}
+
+static patch_t *LUA_CachePatchName(const char *str)
+{
+	patchcache_t *entry;
+	char name[9];
+	UINT32 hash = 0;
+	size_t i;
+
+	if (patchcachewads != numwadfiles || patchcacherender != rendermode)
+		LUA_FlushPatchCache();
+
+	memset(name, 0, sizeof name);
+	strncpy(name, str, 8);
+	strupr(name);
+	for (i = 0; name[i]; i++)
+		hash = hash*31 + (UINT8)name[i];
+	hash &= PATCHCACHESIZE-1;
+
+	for (entry = patchcache[hash]; entry; entry = entry->next)
+		if (!memcmp(entry->name, name, 8))
+			return entry->patch;
+
+	entry = malloc(sizeof *entry);
+	if (!entry)
+		return W_CachePatchName(name, PU_STATIC);
+	M_Memcpy(entry->name, name, sizeof name);
+	entry->patch = W_CachePatchName(name, PU_STATIC);
+	entry->next = patchcache[hash];
+	patchcache[hash] = entry;
+	return entry->patch;
+}
+
+// HUD hooks are run once a tic, and what they draw is kept in a list to
+// draw again for the frames in between. A list is made again the next
+// tic, or for everything as soon as the screen, renderer or files change.
+// A hook added with hud.add(func, hook, true) is run every frame instead.
+enum hudcmdtype {
+	hudcmd_patch = 0,
+	hudcmd_num,
+	hudcmd_paddednum,
+	hudcmd_fill,
+	hudcmd_string
+};
+
+typedef struct
+{
+	UINT8 type; // enum hudcmdtype
+	UINT8 align; // enum align, for strings
+	INT32 x, y, flags;
+	INT32 a, b, c; // scale; num and digits; width, height and color
+	patch_t *patch;
+	const UINT8 *colormap;
+	size_t text; // where a string is in the list's text
+} hudcmd_t;
+
+typedef struct
+{
+	hudcmd_t *cmds;
+	size_t numcmds, maxcmds;
+	char *text;
+	size_t textlen, maxtext;
+	UINT32 epoch; // 0 if it's never been made
+	tic_t tic;
+	player_t *stplayr;
+} hudlist_t;
+
+typedef struct
+{
+	boolean everyframe;
+	hudlist_t view[2]; // one for each screen in splitscreen
+} hudhookcache_t;
+
+static hudhookcache_t *hudcache[2]; // for each hook in HUD[2+], in order
+static size_t numhudcache[2];
+static hudlist_t *hudrecording = NULL;
+
+static UINT32 hudepoch = 1;
+static INT32 hudepochwidth, hudepochheight, hudepochrender = -1;
+static UINT16 hudepochwads;
+static boolean hudepochsplit;
+
+static void LUA_FreeHudCache(void)
+{
+	size_t field, i, v;
+
+	for (field = 0; field < 2; field++)
+	{
+		for (i = 0; i < numhudcache[field]; i++)
+			for (v = 0; v < 2; v++)
+			{
+				Z_Free(hudcache[field][i].view[v].cmds);
+				Z_Free(hudcache[field][i].view[v].text);
+			}
+		Z_Free(hudcache[field]);
+		hudcache[field] = NULL;
+		numhudcache[field] = 0;
+	}
+	hudrecording = NULL;
+	hudepoch++;
+}
+
+// Throws out every list if anything a hook can see other than the tic has changed
+static void LUA_CheckHudEpoch(void)
+{
+	if (hudepochwidth == vid.width && hudepochheight == vid.height && hudepochrender == rendermode
+		&& hudepochwads == numwadfiles && hudepochsplit == (boolean)splitscreen)
+		return;
+	hudepochwidth = vid.width;
+	hudepochheight = vid.height;
+	hudepochrender = rendermode;
+	hudepochwads = numwadfiles;
+	hudepochsplit = (boolean)splitscreen;
+	hudepoch++;
+}
+
+static void LUA_RunHudCommand(const hudcmd_t *cmd, const char *str)
+{
+	switch (cmd->type)
+	{
+	case hudcmd_patch:
+		V_DrawFixedPatch(cmd->x, cmd->y, cmd->a, cmd->flags, cmd->patch, cmd->colormap);
+		break;
+	case hudcmd_num:
+		V_DrawTallNum(cmd->x, cmd->y, cmd->flags, cmd->a);
+		break;
+	case hudcmd_paddednum:
+		V_DrawPaddedTallNum(cmd->x, cmd->y, cmd->flags, cmd->a, cmd->b);
+		break;
+	case hudcmd_fill:
+		V_DrawFill(cmd->x, cmd->y, cmd->a, cmd->b, cmd->c);
+		break;
+	case hudcmd_string:
+		switch (cmd->align)
+		{
+		// hu_font
+		case align_left:
+			V_DrawString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		case align_center:
+			V_DrawCenteredString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		case align_right:
+			V_DrawRightAlignedString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		case align_fixed:
+			V_DrawStringAtFixed(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		// hu_font, 0.5x scale
+		case align_small:
+			V_DrawSmallString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		case align_smallright:
+			V_DrawRightAlignedSmallString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		// tny_font
+		case align_thin:
+			V_DrawThinString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		case align_thinright:
+			V_DrawRightAlignedThinString(cmd->x, cmd->y, cmd->flags, str);
+			break;
+		}
+		break;
+	}
+}
+
+// Draws, and adds to the list being made if there is one
+static void LUA_HudCommand(hudcmd_t *cmd, const char *str)
+{
+	hudlist_t *list = hudrecording;
+
+	LUA_RunHudCommand(cmd, str);
+	if (!list)
+		return;
+
+	if (str)
+	{
+		const size_t len = strlen(str) + 1;
+
+		if (list->textlen + len > list->maxtext)
+		{
+			list->maxtext = max(list->maxtext*2, list->textlen + len + 256);
+			list->text = Z_Realloc(list->text, list->maxtext, PU_STATIC, NULL);
+		}
+		M_Memcpy(list->text + list->textlen, str, len);
+		cmd->text = list->textlen;
+		list->textlen += len;
+	}
+
+	if (list->numcmds >= list->maxcmds)
+	{
+		list->maxcmds = max(list->maxcmds*2, 64);
+		list->cmds = Z_Realloc(list->cmds, list->maxcmds * sizeof (*list->cmds), PU_STATIC, NULL);
+	}
+	list->cmds[list->numcmds++] = *cmd;
+}
+
+static void LUA_StartHudList(hudlist_t *list, player_t *stplayr)
+{
+	list->numcmds = list->textlen = 0;
+	list->epoch = hudepoch;
+	list->tic = gametic;
+	list->stplayr = stplayr;
+	hudrecording = list;
+}
+
+static boolean LUA_HudListReady(const hudlist_t *list, player_t *stplayr)
+{
+	return (list->epoch == hudepoch && list->tic == gametic && list->stplayr == stplayr);
+}
+
+static void LUA_DrawHudList(const hudlist_t *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->numcmds; i++)
+		LUA_RunHudCommand(&list->cmds[i],
+			list->cmds[i].type == hudcmd_string ? list->text + list->cmds[i].text : NULL);
+}
+
+// Runs one hook, the function on top of the stack with its arguments
+// under it, or draws its list if it was made this tic already
+static void LUA_CallHudHook(enum hudhook field, size_t hook, UINT8 view, player_t *stplayr, int argc)
+{
+	hudlist_t *list;
+
+	if (hook >= numhudcache[field] || hudcache[field][hook].everyframe)
+	{
+		LUA_Call(gL, argc);
+		return;
+	}
+
+	list = &hudcache[field][hook].view[view];
+	if (LUA_HudListReady(list, stplayr))
+	{
+		lua_pop(gL, argc + 1);
+		LUA_DrawHudList(list);
+		return;
+	}
+
+	LUA_StartHudList(list, stplayr);
+	LUA_Call(gL, argc);
+	hudrecording = NULL;
+}
+
 static int libd_cachePatch(lua_State *L)
 {
 	HUDONLY
-	LUA_PushUserdata(L, W_CachePatchName(luaL_checkstring(L, 1), PU_STATIC), META_PATCH);
+	LUA_PushUserdata(L, LUA_CachePatchName(luaL_checkstring(L, 1)), META_PATCH);
 	return 1;
 }
 
 static int libd_draw(lua_State *L)
 {
-	INT32 x, y, flags;
-	patch_t *patch;
-	const UINT8 *colormap = NULL;
+	hudcmd_t cmd;
 
 	HUDONLY
-	x = luaL_checkinteger(L, 1);
-	y = luaL_checkinteger(L, 2);
-	patch = *((patch_t **)luaL_checkudata(L, 3, META_PATCH));
-	flags = luaL_optinteger(L, 4, 0);
+	cmd.type = hudcmd_patch;
+	cmd.x = luaL_checkinteger(L, 1)<<FRACBITS;
+	cmd.y = luaL_checkinteger(L, 2)<<FRACBITS;
+	cmd.a = FRACUNIT;
+	cmd.patch = *((patch_t **)luaL_checkudata(L, 3, META_PATCH));
+	cmd.flags = luaL_optinteger(L, 4, 0);
+	cmd.colormap = NULL;
 	if (!lua_isnoneornil(L, 5))
-		colormap = *((UINT8 **)luaL_checkudata(L, 5, META_COLORMAP));
+		cmd.colormap = *((UINT8 **)luaL_checkudata(L, 5, META_COLORMAP));
 
-	flags &= ~V_PARAMMASK; // Don't let crashes happen.
+	cmd.flags &= ~V_PARAMMASK; // Don't let crashes happen.
 
-	V_DrawFixedPatch(x<<FRACBITS, y<<FRACBITS, FRACUNIT, flags, patch, colormap);
+	LUA_HudCommand(&cmd, NULL);
 	return 0;
 }
 
 static int libd_drawScaled(lua_State *L)
 {
-	fixed_t x, y, scale;
-	INT32 flags;
-	patch_t *patch;
-	const UINT8 *colormap = NULL;
+	hudcmd_t cmd;
 
 	HUDONLY
-	x = luaL_checkinteger(L, 1);
-	y = luaL_checkinteger(L, 2);
-	scale = luaL_checkinteger(L, 3);
-	if (scale < 0)
+	cmd.type = hudcmd_patch;
+	cmd.x = luaL_checkinteger(L, 1);
+	cmd.y = luaL_checkinteger(L, 2);
+	cmd.a = luaL_checkinteger(L, 3);
+	if (cmd.a < 0)
 		return luaL_error(L, "negative scale");
-	patch = *((patch_t **)luaL_checkudata(L, 4, META_PATCH));
-	flags = luaL_optinteger(L, 5, 0);
+	cmd.patch = *((patch_t **)luaL_checkudata(L, 4, META_PATCH));
+	cmd.flags = luaL_optinteger(L, 5, 0);
+	cmd.colormap = NULL;
 	if (!lua_isnoneornil(L, 6))
-		colormap = *((UINT8 **)luaL_checkudata(L, 6, META_COLORMAP));
+		cmd.colormap = *((UINT8 **)luaL_checkudata(L, 6, META_COLORMAP));
 
-	flags &= ~V_PARAMMASK; // Don't let crashes happen.
+	cmd.flags &= ~V_PARAMMASK; // Don't let crashes happen.
 
-	V_DrawFixedPatch(x, y, scale, flags, patch, colormap);
+	LUA_HudCommand(&cmd, NULL);
 	return 0;
 }
 
 static int libd_drawNum(lua_State *L)
 {
-	INT32 x, y, flags, num;
+	hudcmd_t cmd;
 	HUDONLY
-	x = luaL_checkinteger(L, 1);
-	y = luaL_checkinteger(L, 2);
-	num = luaL_checkinteger(L, 3);
-	flags = luaL_optinteger(L, 4, 0);
-	flags &= ~V_PARAMMASK; // Don't let crashes happen.
-
-	V_DrawTallNum(x, y, flags, num);
+	cmd.type = hudcmd_num;
+	cmd.x = luaL_checkinteger(L, 1);
+	cmd.y = luaL_checkinteger(L, 2);
+	cmd.a = luaL_checkinteger(L, 3);
+	cmd.flags = luaL_optinteger(L, 4, 0);
+	cmd.flags &= ~V_PARAMMASK; // Don't let crashes happen.
+
+	LUA_HudCommand(&cmd, NULL);
 	return 0;
 }
 
 static int libd_drawPaddedNum(lua_State *L)
 {
-	INT32 x, y, flags, num, digits;
+	hudcmd_t cmd;
 	HUDONLY
-	x = luaL_checkinteger(L, 1);
-	y = luaL_checkinteger(L, 2);
-	num = labs(luaL_checkinteger(L, 3));
-	digits = luaL_optinteger(L, 4, 2);
-	flags = luaL_optinteger(L, 5, 0);
-	flags &= ~V_PARAMMASK; // Don't let crashes happen.
-
-	V_DrawPaddedTallNum(x, y, flags, num, digits);
+	cmd.type = hudcmd_paddednum;
+	cmd.x = luaL_checkinteger(L, 1);
+	cmd.y = luaL_checkinteger(L, 2);
+	cmd.a = labs(luaL_checkinteger(L, 3));
+	cmd.b = luaL_optinteger(L, 4, 2);
+	cmd.flags = luaL_optinteger(L, 5, 0);
+	cmd.flags &= ~V_PARAMMASK; // Don't let crashes happen.
+
+	LUA_HudCommand(&cmd, NULL);
 	return 0;
 }
 
 static int libd_drawFill(lua_State *L)
 {
-	INT32 x = luaL_optinteger(L, 1, 0);
-	INT32 y = luaL_optinteger(L, 2, 0);
-	INT32 w = luaL_optinteger(L, 3, BASEVIDWIDTH);
-	INT32 h = luaL_optinteger(L, 4, BASEVIDHEIGHT);
-	INT32 c = luaL_optinteger(L, 5, 31);
+	hudcmd_t cmd;
+
+	cmd.type = hudcmd_fill;
+	cmd.x = luaL_optinteger(L, 1, 0);
+	cmd.y = luaL_optinteger(L, 2, 0);
+	cmd.a = luaL_optinteger(L, 3, BASEVIDWIDTH);
+	cmd.b = luaL_optinteger(L, 4, BASEVIDHEIGHT);
+	cmd.c = luaL_optinteger(L, 5, 31);
 
 	HUDONLY
-	V_DrawFill(x, y, w, h, c);
+	LUA_HudCommand(&cmd, NULL);
 	return 0;
 }
 
 static int libd_drawString(lua_State *L)
 {
-	fixed_t x = luaL_checkinteger(L, 1);
-	fixed_t y = luaL_checkinteger(L, 2);
-	const char *str = luaL_checkstring(L, 3);
-	INT32 flags = luaL_optinteger(L, 4, V_ALLOWLOWERCASE);
-	enum align align = luaL_checkoption(L, 5, "left", align_opt);
+	hudcmd_t cmd;
+	const char *str;
+
+	cmd.type = hudcmd_string;
+	cmd.x = luaL_checkinteger(L, 1);
+	cmd.y = luaL_checkinteger(L, 2);
+	str = luaL_checkstring(L, 3);
+	cmd.flags = luaL_optinteger(L, 4, V_ALLOWLOWERCASE);
+	cmd.align = (UINT8)luaL_checkoption(L, 5, "left", align_opt);
 
-	flags &= ~V_PARAMMASK; // Don't let crashes happen.
+	cmd.flags &= ~V_PARAMMASK; // Don't let crashes happen.
 
 	HUDONLY
-	switch(align)
-	{
-	// hu_font
-	case align_left:
-		V_DrawString(x, y, flags, str);
-		break;
-	case align_center:
-		V_DrawCenteredString(x, y, flags, str);
-		break;
-	case align_right:
-		V_DrawRightAlignedString(x, y, flags, str);
-		break;
-	case align_fixed:
-		V_DrawStringAtFixed(x, y, flags, str);
-		break;
-	// hu_font, 0.5x scale
-	case align_small:
-		V_DrawSmallString(x, y, flags, str);
-		break;
-	case align_smallright:
-		V_DrawRightAlignedSmallString(x, y, flags, str);
-		break;
-	// tny_font
-	case align_thin:
-		V_DrawThinString(x, y, flags, str);
-		break;
-	case align_thinright:
-		V_DrawRightAlignedThinString(x, y, flags, str);
-		break;
-	}
+	LUA_HudCommand(&cmd, str);
 	return 0;
 }
 
@@ -623,12 +881,20 @@ static int lib_hudenabled(lua_State *L)
 
 
 // add a HUD element for rendering
+// hud.add(func, hook, everyframe): with everyframe, func is run for every frame
+// drawn, rather than once a tic with what it drew drawn again in between
 static int lib_hudadd(lua_State *L)
 {
 	enum hudhook field;
+	boolean everyframe;
+	hudhookcache_t *cache;
 
 	luaL_checktype(L, 1, LUA_TFUNCTION);
 	field = luaL_checkoption(L, 2, "game", hudhook_opt);
+	everyframe = lua_toboolean(L, 3);
+
+	if (dedicated) // nothing is ever drawn, so don't keep it around
+		return 0;
 
 	lua_getfield(L, LUA_REGISTRYINDEX, "HUD");
 	I_Assert(lua_istable(L, -1));
@@ -639,6 +905,12 @@ static int lib_hudadd(lua_State *L)
 	lua_pushvalue(L, 1);
 	lua_rawseti(L, -2, (int)(lua_objlen(L, -2) + 1));
 
+	// Its place in the cache is its place in HUD[2+]
+	hudcache[field] = Z_Realloc(hudcache[field], (numhudcache[field] + 1) * sizeof (*cache), PU_STATIC, NULL);
+	cache = &hudcache[field][numhudcache[field]++];
+	memset(cache, 0, sizeof (*cache));
+	cache->everyframe = everyframe;
+
 	hudAvailable |= 1<<field;
 	return 0;
 }
@@ -658,6 +930,7 @@ static luaL_Reg lib_hud[] = {
 int LUA_HudLib(lua_State *L)
 {
 	memset(hud_enabled, 0xff, (hud_MAX/8)+1);
+	LUA_FreeHudCache(); // the hooks were the last Lua state's
 
 	lua_newtable(L); // HUD registry table
 		lua_newtable(L);
@@ -724,6 +997,8 @@ boolean LUA_HudEnabled(enum hud option)
 // Hook for HUD rendering
 void LUAh_GameHUD(player_t *stplayr)
 {
+	UINT8 view = 0;
+
 	if (!gL || !(hudAvailable & (1<<hudhook_game)))
 		return;
 
@@ -741,16 +1016,21 @@ void LUAh_GameHUD(player_t *stplayr)
 	LUA_PushUserdata(gL, stplayr, META_PLAYER);
 
 	if (splitscreen && stplayr == &players[secondarydisplayplayer])
+	{
 		LUA_PushUserdata(gL, &camera2, META_CAMERA);
+		view = 1;
+	}
 	else
 		LUA_PushUserdata(gL, &camera, META_CAMERA);
 
+	LUA_CheckHudEpoch();
 	lua_pushnil(gL);
 	while (lua_next(gL, -5) != 0) {
+		size_t hook = (size_t)lua_tointeger(gL, -2) - 1;
 		lua_pushvalue(gL, -5); // graphics library (HUD[1])
 		lua_pushvalue(gL, -5); // stplayr
 		lua_pushvalue(gL, -5); // camera
-		LUA_Call(gL, 3);
+		LUA_CallHudHook(hudhook_game, hook, view, stplayr, 3);
 	}
 	lua_pop(gL, -1);
 	hud_running = false;
@@ -772,10 +1052,12 @@ void LUAh_ScoresHUD(void)
 	lua_rawgeti(gL, -2, 1); // HUD[1] = lib_draw
 	I_Assert(lua_istable(gL, -1));
 	lua_remove(gL, -3); // pop HUD
+	LUA_CheckHudEpoch();
 	lua_pushnil(gL);
 	while (lua_next(gL, -3) != 0) {
+		size_t hook = (size_t)lua_tointeger(gL, -2) - 1;
 		lua_pushvalue(gL, -3); // graphics library (HUD[1])
-		LUA_Call(gL, 1);
+		LUA_CallHudHook(hudhook_scores, hook, 0, NULL, 1);
 	}
 	lua_pop(gL, -1);
 	hud_running = false;
@@ -24,6 +24,7 @@
 #include "lua_hud.h" // hud_running errors
 
 boolean LUA_CallAction(const char *action, mobj_t *actor);
+boolean LUA_HasAction(const char *action);
 state_t *astate;
 
 enum sfxinfo_read {
@@ -271,6 +272,21 @@ boolean LUA_SetLuaAction(void *stv, const char *action)
 	return true; // action successfully set.
 }
 
+// Whether a script has replaced the action, given in all-caps.
+boolean LUA_HasAction(const char *action)
+{
+	boolean found;
+
+	if (!gL) // Lua isn't loaded,
+		return false; // so nothing's replaced.
+
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_ACTIONS);
+	lua_getfield(gL, -1, action);
+	found = !lua_isnil(gL, -1);
+	lua_pop(gL, 2); // pop the field and LREG_ACTIONS
+	return found;
+}
+
 boolean LUA_CallAction(const char *csaction, mobj_t *actor)
 {
 	I_Assert(csaction != NULL);
@@ -610,11 +626,7 @@ static int mobjinfo_get(lua_State *L)
 	else if (fastcmp(field,"raisestate"))
 		lua_pushinteger(L, info->raisestate);
 	else {
-		lua_getfield(L, LUA_REGISTRYINDEX, LREG_EXTVARS);
-		I_Assert(lua_istable(L, -1));
-		lua_pushlightuserdata(L, info);
-		lua_rawget(L, -2);
-		if (!lua_istable(L, -1)) { // no extra values table
+		if (!LUA_PushExtVars(L, 1, false)) { // no extra values table
 			CONS_Debug(DBG_LUA, M_GetText("'%s' has no field named '%s'; returning nil.\n"), "mobjinfo_t", field);
 			return 0;
 		}
@@ -686,22 +698,14 @@ static int mobjinfo_set(lua_State *L)
 	else if (fastcmp(field,"raisestate"))
 		info->raisestate = luaL_checkinteger(L, 3);
 	else {
-		lua_getfield(L, LUA_REGISTRYINDEX, LREG_EXTVARS);
-		I_Assert(lua_istable(L, -1));
-		lua_pushlightuserdata(L, info);
-		lua_rawget(L, -2);
-		if (lua_isnil(L, -1)) {
-			// This index doesn't have a table for extra values yet, let's make one.
-			lua_pop(L, 1);
+		if (!LUA_PushExtVars(L, 1, false)) {
+			// This userdata doesn't have a table for extra values yet, let's make one.
 			CONS_Debug(DBG_LUA, M_GetText("'%s' has no field named '%s'; adding it as Lua data.\n"), "mobjinfo_t", field);
-			lua_newtable(L);
-			lua_pushlightuserdata(L, info);
-			lua_pushvalue(L, -2); // ext value table
-			lua_rawset(L, -4); // LREG_EXTVARS table
+			LUA_PushExtVars(L, 1, true);
 		}
 		lua_pushvalue(L, 3); // value to store
 		lua_setfield(L, -2, field);
-		lua_pop(L, 2);
+		lua_pop(L, 1);
 	}
 	//else
 		//return luaL_error(L, LUA_QL("mobjinfo_t") " has no field named " LUA_QS, field);
@@ -15,7 +15,6 @@
 extern lua_State *gL;
 
 #define LREG_VALID "VALID_USERDATA"
-#define LREG_EXTVARS "LUA_VARS"
 #define LREG_STATEACTION "STATE_ACTION"
 #define LREG_ACTIONS "MOBJ_ACTION"
 
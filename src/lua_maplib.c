@@ -71,6 +71,8 @@ static const char *const sector_opt[] = {
 #endif
 	NULL};
 
+static int sector_fields_ref = LUA_NOREF;
+
 enum subsector_e {
 	subsector_valid = 0,
 	subsector_sector,
@@ -85,6 +87,8 @@ static const char *const subsector_opt[] = {
 	"firstline",
 	NULL};
 
+static int subsector_fields_ref = LUA_NOREF;
+
 enum line_e {
 	line_valid = 0,
 	line_v1,
@@ -127,6 +131,8 @@ static const char *const line_opt[] = {
 	"callcount",
 	NULL};
 
+static int line_fields_ref = LUA_NOREF;
+
 enum side_e {
 	side_valid = 0,
 	side_textureoffset,
@@ -153,6 +159,8 @@ static const char *const side_opt[] = {
 	"text",
 	NULL};
 
+static int side_fields_ref = LUA_NOREF;
+
 enum vertex_e {
 	vertex_valid = 0,
 	vertex_x,
@@ -167,6 +175,8 @@ static const char *const vertex_opt[] = {
 	"z",
 	NULL};
 
+static int vertex_fields_ref = LUA_NOREF;
+
 enum ffloor_e {
 	ffloor_valid = 0,
 	ffloor_topheight,
@@ -207,6 +217,8 @@ static const char *const ffloor_opt[] = {
 	"alpha",
 	NULL};
 
+static int ffloor_fields_ref = LUA_NOREF;
+
 #ifdef ESLOPE
 enum slope_e {
 	slope_valid = 0,
@@ -234,6 +246,8 @@ static const char *const slope_opt[] = {
 	"flags",
 	NULL};
 
+static int slope_fields_ref = LUA_NOREF;
+
 // shared by both vector2_t and vector3_t
 enum vector_e {
 	vector_x = 0,
@@ -246,6 +260,8 @@ static const char *const vector_opt[] = {
 	"y",
 	"z",
 	NULL};
+
+static int vector_fields_ref = LUA_NOREF;
 #endif
 
 static const char *const array_opt[] ={"iterate",NULL};
@@ -389,7 +405,7 @@ static int sectorlines_num(lua_State *L)
 static int sector_get(lua_State *L)
 {
 	sector_t *sector = *((sector_t **)luaL_checkudata(L, 1, META_SECTOR));
-	enum sector_e field = luaL_checkoption(L, 2, sector_opt[0], sector_opt);
+	enum sector_e field = Lua_checkoption(L, 2, sector_valid, sector_fields_ref);
 	INT16 i;
 
 	if (!sector)
@@ -477,7 +493,7 @@ static int sector_get(lua_State *L)
 static int sector_set(lua_State *L)
 {
 	sector_t *sector = *((sector_t **)luaL_checkudata(L, 1, META_SECTOR));
-	enum sector_e field = luaL_checkoption(L, 2, sector_opt[0], sector_opt);
+	enum sector_e field = Lua_checkoption(L, 2, sector_valid, sector_fields_ref);
 
 	if (!sector)
 		return luaL_error(L, "accessed sector_t doesn't exist anymore.");
@@ -485,6 +501,9 @@ static int sector_set(lua_State *L)
 	if (hud_running)
 		return luaL_error(L, "Do not alter sector_t in HUD rendering code!");
 
+	P_ClearSightCache();
+	P_ClearTouchCache();
+
 	switch(field)
 	{
 	case sector_valid: // valid
@@ -555,7 +574,7 @@ static int sector_num(lua_State *L)
 static int subsector_get(lua_State *L)
 {
 	subsector_t *subsector = *((subsector_t **)luaL_checkudata(L, 1, META_SUBSECTOR));
-	enum subsector_e field = luaL_checkoption(L, 2, subsector_opt[0], subsector_opt);
+	enum subsector_e field = Lua_checkoption(L, 2, subsector_valid, subsector_fields_ref);
 
 	if (!subsector)
 	{
@@ -594,7 +613,7 @@ static int subsector_num(lua_State *L)
 static int line_get(lua_State *L)
 {
 	line_t *line = *((line_t **)luaL_checkudata(L, 1, META_LINE));
-	enum line_e field = luaL_checkoption(L, 2, line_opt[0], line_opt);
+	enum line_e field = Lua_checkoption(L, 2, line_valid, line_fields_ref);
 
 	if (!line)
 	{
@@ -719,7 +738,7 @@ static int sidenum_get(lua_State *L)
 static int side_get(lua_State *L)
 {
 	side_t *side = *((side_t **)luaL_checkudata(L, 1, META_SIDE));
-	enum side_e field = luaL_checkoption(L, 2, side_opt[0], side_opt);
+	enum side_e field = Lua_checkoption(L, 2, side_valid, side_fields_ref);
 
 	if (!side)
 	{
@@ -769,7 +788,7 @@ static int side_get(lua_State *L)
 static int side_set(lua_State *L)
 {
 	side_t *side = *((side_t **)luaL_checkudata(L, 1, META_SIDE));
-	enum side_e field = luaL_checkoption(L, 2, side_opt[0], side_opt);
+	enum side_e field = Lua_checkoption(L, 2, side_valid, side_fields_ref);
 
 	if (!side)
 	{
@@ -820,7 +839,7 @@ static int side_num(lua_State *L)
 static int vertex_get(lua_State *L)
 {
 	vertex_t *vertex = *((vertex_t **)luaL_checkudata(L, 1, META_VERTEX));
-	enum vertex_e field = luaL_checkoption(L, 2, vertex_opt[0], vertex_opt);
+	enum vertex_e field = Lua_checkoption(L, 2, vertex_valid, vertex_fields_ref);
 
 	if (!vertex)
 	{
@@ -1089,7 +1108,7 @@ static int lib_numvertexes(lua_State *L)
 static int ffloor_get(lua_State *L)
 {
 	ffloor_t *ffloor = *((ffloor_t **)luaL_checkudata(L, 1, META_FFLOOR));
-	enum ffloor_e field = luaL_checkoption(L, 2, ffloor_opt[0], ffloor_opt);
+	enum ffloor_e field = Lua_checkoption(L, 2, ffloor_valid, ffloor_fields_ref);
 	INT16 i;
 
 	if (!ffloor)
@@ -1167,7 +1186,7 @@ static int ffloor_get(lua_State *L)
 static int ffloor_set(lua_State *L)
 {
 	ffloor_t *ffloor = *((ffloor_t **)luaL_checkudata(L, 1, META_FFLOOR));
-	enum ffloor_e field = luaL_checkoption(L, 2, ffloor_opt[0], ffloor_opt);
+	enum ffloor_e field = Lua_checkoption(L, 2, ffloor_valid, ffloor_fields_ref);
 
 	if (!ffloor)
 		return luaL_error(L, "accessed ffloor_t doesn't exist anymore.");
@@ -1175,6 +1194,9 @@ static int ffloor_set(lua_State *L)
 	if (hud_running)
 		return luaL_error(L, "Do not alter ffloor_t in HUD rendering code!");
 
+	P_ClearSightCache();
+	P_ClearTouchCache();
+
 	switch(field)
 	{
 	case ffloor_valid: // valid
@@ -1232,7 +1254,10 @@ static int ffloor_set(lua_State *L)
 		ffloortype_e oldflags = ffloor->flags; // store FOF's old flags
 		ffloor->flags = luaL_checkinteger(L, 3);
 		if (ffloor->flags != oldflags)
+		{
 			ffloor->target->moved = true; // reset target sector's lightlist
+			P_RecalcFOFFlags(ffloor->target);
+		}
 		break;
 	}
 	case ffloor_alpha:
@@ -1246,7 +1271,7 @@ static int ffloor_set(lua_State *L)
 static int slope_get(lua_State *L)
 {
 	pslope_t *slope = *((pslope_t **)luaL_checkudata(L, 1, META_SLOPE));
-	enum slope_e field = luaL_checkoption(L, 2, slope_opt[0], slope_opt);
+	enum slope_e field = Lua_checkoption(L, 2, slope_valid, slope_fields_ref);
 
 	if (!slope)
 	{
@@ -1296,7 +1321,7 @@ static int slope_get(lua_State *L)
 static int slope_set(lua_State *L)
 {
 	pslope_t *slope = *((pslope_t **)luaL_checkudata(L, 1, META_SLOPE));
-	enum slope_e field = luaL_checkoption(L, 2, slope_opt[0], slope_opt);
+	enum slope_e field = Lua_checkoption(L, 2, slope_valid, slope_fields_ref);
 
 	if (!slope)
 		return luaL_error(L, "accessed pslope_t doesn't exist anymore.");
@@ -1382,7 +1407,7 @@ static int slope_set(lua_State *L)
 static int vector2_get(lua_State *L)
 {
 	vector2_t *vec = *((vector2_t **)luaL_checkudata(L, 1, META_VECTOR2));
-	enum vector_e field = luaL_checkoption(L, 2, vector_opt[0], vector_opt);
+	enum vector_e field = Lua_checkoption(L, 2, vector_x, vector_fields_ref);
 
 	if (!vec)
 		return luaL_error(L, "accessed vector2_t doesn't exist anymore.");
@@ -1400,7 +1425,7 @@ static int vector2_get(lua_State *L)
 static int vector3_get(lua_State *L)
 {
 	vector3_t *vec = *((vector3_t **)luaL_checkudata(L, 1, META_VECTOR3));
-	enum vector_e field = luaL_checkoption(L, 2, vector_opt[0], vector_opt);
+	enum vector_e field = Lua_checkoption(L, 2, vector_x, vector_fields_ref);
 
 	if (!vec)
 		return luaL_error(L, "accessed vector3_t doesn't exist anymore.");
@@ -1534,6 +1559,15 @@ static int mapheaderinfo_get(lua_State *L)
 
 int LUA_MapLib(lua_State *L)
 {
+	sector_fields_ref = Lua_CreateFieldTable(L, sector_opt);
+	subsector_fields_ref = Lua_CreateFieldTable(L, subsector_opt);
+	line_fields_ref = Lua_CreateFieldTable(L, line_opt);
+	side_fields_ref = Lua_CreateFieldTable(L, side_opt);
+	vertex_fields_ref = Lua_CreateFieldTable(L, vertex_opt);
+	ffloor_fields_ref = Lua_CreateFieldTable(L, ffloor_opt);
+	slope_fields_ref = Lua_CreateFieldTable(L, slope_opt);
+	vector_fields_ref = Lua_CreateFieldTable(L, vector_opt);
+
 	luaL_newmetatable(L, META_SECTORLINES);
 		lua_pushcfunction(L, sectorlines_get);
 		lua_setfield(L, -2, "__index");
@@ -150,12 +150,14 @@ static const char *const mobj_opt[] = {
 #endif
 	NULL};
 
+static int mobj_fields_ref = LUA_NOREF;
+
 #define UNIMPLEMENTED luaL_error(L, LUA_QL("mobj_t") " field " LUA_QS " is not implemented for Lua and cannot be accessed.", mobj_opt[field])
 
 static int mobj_get(lua_State *L)
 {
 	mobj_t *mo = *((mobj_t **)luaL_checkudata(L, 1, META_MOBJ));
-	enum mobj_e field = Lua_optoption(L, 2, NULL, mobj_opt);
+	enum mobj_e field = Lua_optoption(L, 2, -1, mobj_fields_ref);
 	lua_settop(L, 2);
 
 	if (!mo) {
@@ -357,11 +359,7 @@ static int mobj_get(lua_State *L)
 		break;
 #endif
 	default: // extra custom variables in Lua memory
-		lua_getfield(L, LUA_REGISTRYINDEX, LREG_EXTVARS);
-		I_Assert(lua_istable(L, -1));
-		lua_pushlightuserdata(L, mo);
-		lua_rawget(L, -2);
-		if (!lua_istable(L, -1)) { // no extra values table
+		if (!LUA_PushExtVars(L, 1, false)) { // no extra values table
 			CONS_Debug(DBG_LUA, M_GetText("'%s' has no extvars table or field named '%s'; returning nil.\n"), "mobj_t", lua_tostring(L, 2));
 			return 0;
 		}
@@ -379,7 +377,7 @@ static int mobj_get(lua_State *L)
 static int mobj_set(lua_State *L)
 {
 	mobj_t *mo = *((mobj_t **)luaL_checkudata(L, 1, META_MOBJ));
-	enum mobj_e field = Lua_optoption(L, 2, mobj_opt[0], mobj_opt);
+	enum mobj_e field = Lua_optoption(L, 2, mobj_valid, mobj_fields_ref);
 	lua_settop(L, 3);
 
 	if (!mo)
@@ -388,6 +386,8 @@ static int mobj_set(lua_State *L)
 	if (hud_running)
 		return luaL_error(L, "Do not alter mobj_t in HUD rendering code!");
 
+	mo->eflags &= ~MFE_DORMANT; // think about whatever the script did
+
 	switch(field)
 	{
 	case mobj_valid:
@@ -441,6 +441,7 @@ static int mobj_set(lua_State *L)
 		mo->radius = luaL_checkfixed(L, 3);
 		if (mo->radius < 0)
 			mo->radius = 0;
+		P_UpdateStaticThing(mo);
 		P_CheckPosition(mo, mo->x, mo->y);
 		mo->floorz = tmfloorz;
 		mo->ceilingz = tmceilingz;
@@ -544,8 +545,10 @@ static int mobj_set(lua_State *L)
 		mobjtype_t newtype = luaL_checkinteger(L, 3);
 		if (newtype >= NUMMOBJTYPES)
 			return luaL_error(L, "mobj.type %d out of range (0 - %d).", newtype, NUMMOBJTYPES-1);
+		P_UnlinkMobjType(mo);
 		mo->type = newtype;
 		mo->info = &mobjinfo[newtype];
+		P_LinkMobjType(mo);
 		P_SetScale(mo, mo->scale);
 		break;
 	}
@@ -652,23 +655,15 @@ static int mobj_set(lua_State *L)
 		return NOSET;
 #endif
 	default:
-		lua_getfield(L, LUA_REGISTRYINDEX, LREG_EXTVARS);
-		I_Assert(lua_istable(L, -1));
-		lua_pushlightuserdata(L, mo);
-		lua_rawget(L, -2);
-		if (lua_isnil(L, -1)) {
-			// This index doesn't have a table for extra values yet, let's make one.
-			lua_pop(L, 1);
+		if (!LUA_PushExtVars(L, 1, false)) {
+			// This userdata doesn't have a table for extra values yet, let's make one.
 			CONS_Debug(DBG_LUA, M_GetText("'%s' has no field named '%s'; adding it as Lua data.\n"), "mobj_t", lua_tostring(L, 2));
-			lua_newtable(L);
-			lua_pushlightuserdata(L, mo);
-			lua_pushvalue(L, -2); // ext value table
-			lua_rawset(L, -4); // LREG_EXTVARS table
+			LUA_PushExtVars(L, 1, true);
 		}
 		lua_pushvalue(L, 2); // key
 		lua_pushvalue(L, 3); // value to store
 		lua_settable(L, -3);
-		lua_pop(L, 2);
+		lua_pop(L, 1);
 		break;
 	}
 	return 0;
@@ -805,6 +800,8 @@ static int lib_nummapthings(lua_State *L)
 
 int LUA_MobjLib(lua_State *L)
 {
+	mobj_fields_ref = Lua_CreateFieldTable(L, mobj_opt);
+
 	luaL_newmetatable(L, META_MOBJ);
 		lua_pushcfunction(L, mobj_get);
 		lua_setfield(L, -2, "__index");
@@ -22,12 +22,18 @@
 #include "byteptr.h"
 #include "p_saveg.h"
 #include "p_local.h"
+#include "m_trace.h"
 #ifdef ESLOPE
 #include "p_slopes.h" // for P_SlopeById
 #endif
 #ifdef LUA_ALLOW_BYTECODE
 #include "d_netfil.h" // for LUA_DumpFile
 #endif
+#include "d_main.h" // srb2home, for the bytecode cache
+#include "i_system.h"
+#include "m_argv.h"
+#include "md5.h"
+#include "m_perfstats.h"
 
 #include "lua_script.h"
 #include "lua_libs.h"
@@ -37,6 +43,18 @@
 
 lua_State *gL = NULL;
 
+static void LUA_GCBudget_OnChange(void);
+
+static CV_PossibleValue_t luagcbudget_cons_t[] = {{0, "MIN"}, {1000000/TICRATE, "MAX"}, {0, NULL}};
+consvar_t cv_luagcbudget = {"lua_gcbudget", "1000", CV_SAVE|CV_CALL, luagcbudget_cons_t, LUA_GCBudget_OnChange, 0, NULL, NULL, 0, 0, NULL};
+
+// The garbage collector, when it runs on a time budget
+static boolean gcincycle = false; // a cycle has been started and not finished
+static INT32 gcnextkb = 0; // don't start another until the heap is this big
+static boolean gcstepped = false; // a slice has been run since the last LUA_Step
+
+static void LUA_ResetGC(void);
+
 // List of internal libraries to load from SRB2
 static lua_CFunction liblist[] = {
 	LUA_EnumLib, // global metatable for enums
@@ -152,21 +170,163 @@ static void LUA_ClearState(void)
 
 	// lua state is ready!
 	gL = L;
+	LUA_ResetGC();
 }
 
-#ifdef _DEBUG
-void LUA_ClearExtVars(void)
+
+// Load a script from a MYFILE
+// must match lua_Writer
+static int dumpWriter(lua_State *L, const void *p, size_t sz, void *ud)
 {
-	if (!gL)
+	FILE *handle = (FILE*)ud;
+	I_Assert(handle != NULL);
+	(void)L;
+	if (!sz) return 0; // nothing to write? can't fail that! :D
+	return (fwrite(p, 1, sz, handle) != sz); // if fwrite != sz, we've failed.
+}
+
+//
+// Bytecode cache
+//
+// Compiled scripts are kept in srb2home/luacache, one file per script,
+// named after the MD5 of its source. Each file starts with a header
+// holding the build it was compiled by and the chunk name, so a file
+// left behind by another version or by an identical script in another
+// addon just gets recompiled and replaced.
+//
+
+#define LUACACHEDIR "luacache"
+#define LUACACHEMAGIC "SRB2LUAC"
+
+static const char *LUA_CacheBuild(void)
+{
+	static char build[256];
+	if (!*build)
+		snprintf(build, sizeof build, "%s %s %s %s", VERSIONSTRING, comprevision, compdate, comptime);
+	return build;
+}
+
+static const char *LUA_CachePath(const UINT8 *md5sum)
+{
+	char hex[33];
+	size_t i;
+	for (i = 0; i < 16; i++)
+		sprintf(&hex[i*2], "%02x", md5sum[i]);
+	return va("%s"PATHSEP LUACACHEDIR PATHSEP"%s.luac", srb2home, hex);
+}
+
+typedef struct
+{
+	const char *data;
+	size_t size;
+} cachereader_t;
+
+// must match lua_Reader
+static const char *cacheReader(lua_State *L, void *ud, size_t *sz)
+{
+	cachereader_t *r = ud;
+	(void)L;
+	*sz = r->size;
+	r->size = 0;
+	return *sz ? r->data : NULL;
+}
+
+// Pushes the cached chunk for a script and returns true, if there is one.
+static boolean LUA_LoadCachedChunk(const char *name, const UINT8 *md5sum)
+{
+	FILE *handle = fopen(LUA_CachePath(md5sum), "rb");
+	const char *build = LUA_CacheBuild();
+	const size_t headlen = sizeof LUACACHEMAGIC + strlen(build) + 1 + strlen(name) + 1 + 16;
+	cachereader_t reader;
+	char *buf, *p;
+	long size;
+	boolean loaded = false;
+
+	if (!handle)
+		return false;
+
+	fseek(handle, 0, SEEK_END);
+	size = ftell(handle);
+	fseek(handle, 0, SEEK_SET);
+
+	if (size <= (long)headlen || !(buf = malloc(size)))
+	{
+		fclose(handle);
+		return false;
+	}
+
+	if (fread(buf, 1, size, handle) == (size_t)size)
+	{
+		p = buf;
+		if (!memcmp(p, LUACACHEMAGIC, sizeof LUACACHEMAGIC))
+		{
+			p += sizeof LUACACHEMAGIC;
+			if (!strcmp(p, build))
+			{
+				p += strlen(build) + 1;
+				if (!strcmp(p, name))
+				{
+					p += strlen(name) + 1;
+					if (!memcmp(p, md5sum, 16))
+					{
+						p += 16;
+						reader.data = p;
+						reader.size = size - (p - buf);
+						if (!lua_undump(gL, cacheReader, &reader, va("@%s", name)))
+							loaded = true;
+						else
+							lua_pop(gL, 1); // bad chunk, it'll be rewritten
+					}
+				}
+			}
+		}
+	}
+
+	fclose(handle);
+	free(buf);
+	return loaded;
+}
+
+// Writes the function on top of the stack to the cache.
+static void LUA_SaveCachedChunk(const char *name, const UINT8 *md5sum)
+{
+	const char *build = LUA_CacheBuild();
+	char path[MAX_WADPATH+64], temp[MAX_WADPATH+68];
+	FILE *handle;
+	boolean failed;
+
+	I_mkdir(va("%s"PATHSEP LUACACHEDIR, srb2home), 0755);
+
+	strlcpy(path, LUA_CachePath(md5sum), sizeof path);
+	snprintf(temp, sizeof temp, "%s.tmp", path);
+
+	// write it under another name first, so a half written file
+	// is never picked up
+	if (!(handle = fopen(temp, "wb")))
 		return;
-	lua_newtable(gL);
-	lua_setfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
+
+	failed = (fwrite(LUACACHEMAGIC, 1, sizeof LUACACHEMAGIC, handle) != sizeof LUACACHEMAGIC
+		|| fwrite(build, 1, strlen(build) + 1, handle) != strlen(build) + 1
+		|| fwrite(name, 1, strlen(name) + 1, handle) != strlen(name) + 1
+		|| fwrite(md5sum, 1, 16, handle) != 16
+		|| lua_dump(gL, dumpWriter, handle));
+	if (fclose(handle))
+		failed = true;
+
+	if (!failed)
+	{
+		remove(path);
+		if (!rename(temp, path))
+			return;
+	}
+	remove(temp);
 }
-#endif
 
-// Load a script from a MYFILE
 static inline void LUA_LoadFile(MYFILE *f, char *name)
 {
+	UINT8 md5sum[16];
+	boolean usecache;
+
 	if (!name)
 		name = wadfiles[f->wad]->filename;
 	CONS_Printf("Loading Lua script from %s\n", name);
@@ -175,11 +335,28 @@ static inline void LUA_LoadFile(MYFILE *f, char *name)
 	lua_pushinteger(gL, f->wad);
 	lua_setfield(gL, LUA_REGISTRYINDEX, "WAD");
 
-	if (luaL_loadbuffer(gL, f->data, f->size, va("@%s",name)) || lua_pcall(gL, 0, 0, 0)) {
+	usecache = !M_CheckParm("-noluacache");
+	if (usecache)
+		md5_buffer(f->data, f->size, md5sum);
+
+	if (!usecache || !LUA_LoadCachedChunk(name, md5sum))
+	{
+		if (luaL_loadbuffer(gL, f->data, f->size, va("@%s",name)))
+		{
+			CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL,-1));
+			lua_pop(gL,1);
+			LUA_FullGC();
+			return;
+		}
+		if (usecache)
+			LUA_SaveCachedChunk(name, md5sum);
+	}
+
+	if (lua_pcall(gL, 0, 0, 0)) {
 		CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL,-1));
 		lua_pop(gL,1);
 	}
-	lua_gc(gL, LUA_GCCOLLECT, 0);
+	LUA_FullGC();
 }
 
 // Load a script from a lump
@@ -210,23 +387,15 @@ void LUA_LoadLump(UINT16 wad, UINT16 lump)
 		name[len] = '\0';
 	}
 
+	TRACE_BEGIN("lua", name);
 	LUA_LoadFile(&f, name); // actually load file!
+	TRACE_END();
 
 	free(name);
 	Z_Free(f.data);
 }
 
 #ifdef LUA_ALLOW_BYTECODE
-// must match lua_Writer
-static int dumpWriter(lua_State *L, const void *p, size_t sz, void *ud)
-{
-	FILE *handle = (FILE*)ud;
-	I_Assert(handle != NULL);
-	(void)L;
-	if (!sz) return 0; // nothing to write? can't fail that! :D
-	return (fwrite(p, 1, sz, handle) != sz); // if fwrite != sz, we've failed.
-}
-
 // Compile a script by name and dump it back to disk.
 void LUA_DumpFile(const char *filename)
 {
@@ -281,7 +450,7 @@ void LUA_DumpFile(const char *filename)
 		CONS_Printf("Successfully compiled %s into bytecode.\n", filename);
 	fclose(handle);
 	lua_pop(gL, 1); // function is still on stack after lua_dump
-	lua_gc(gL, LUA_GCCOLLECT, 0);
+	LUA_FullGC();
 	return;
 }
 #endif
@@ -334,15 +503,72 @@ fixed_t LUA_EvalMath(const char *word)
 // Takes a pointer, any pointer, and a metatable name
 // Creates a userdata for that pointer with the given metatable
 // Pushes it to the stack and stores it in the registry.
+// Registry references to the players' userdata, 0 if none
+static INT32 playerrefs[MAXPLAYERS];
+
+// For the kinds of userdata Lua asks for the most, where data keeps the
+// registry reference to its userdata, so getting it again is a single
+// lookup by integer. Everything else goes in the LREG_VALID table.
+static INT32 *LUA_UserdataRef(void *data, const char *meta)
+{
+	switch (meta[0])
+	{
+		case 'M':
+			if (!strcmp(meta, META_MOBJ))
+				return &((thinker_t *)data)->luaref;
+			break;
+		case 'P':
+			if (!strcmp(meta, META_PLAYER)
+			&& (player_t *)data >= players && (player_t *)data < players + MAXPLAYERS)
+				return &playerrefs[(player_t *)data - players];
+			break;
+		case 'S':
+			if (!strcmp(meta, META_SECTOR))
+				return &((sector_t *)data)->luaref;
+			if (!strcmp(meta, META_SIDE))
+				return &((side_t *)data)->luaref;
+			break;
+		case 'L':
+			if (!strcmp(meta, META_LINE))
+				return &((line_t *)data)->luaref;
+			break;
+		default:
+			break;
+	}
+	return NULL;
+}
+
 void LUA_PushUserdata(lua_State *L, void *data, const char *meta)
 {
 	void **userdata;
+	INT32 *ref;
 
 	if (!data) { // push a NULL
 		lua_pushnil(L);
 		return;
 	}
 
+	ref = LUA_UserdataRef(data, meta);
+	if (ref)
+	{
+		if (*ref)
+		{
+			lua_rawgeti(L, LUA_REGISTRYINDEX, *ref);
+			return;
+		}
+
+		userdata = lua_newuserdata(L, sizeof(void *));
+		*userdata = data;
+		luaL_getmetatable(L, meta);
+		lua_setmetatable(L, -2);
+		lua_pushvalue(L, LUA_GLOBALSINDEX); // no custom fields yet
+		lua_setfenv(L, -2);
+
+		lua_pushvalue(L, -1);
+		*ref = luaL_ref(L, LUA_REGISTRYINDEX); // pops the copy
+		return;
+	}
+
 	lua_getfield(L, LUA_REGISTRYINDEX, LREG_VALID);
 	I_Assert(lua_istable(L, -1));
 	lua_pushlightuserdata(L, data);
@@ -355,6 +581,8 @@ void LUA_PushUserdata(lua_State *L, void *data, const char *meta)
 		*userdata = data;
 		luaL_getmetatable(L, meta);
 		lua_setmetatable(L, -2);
+		lua_pushvalue(L, LUA_GLOBALSINDEX); // no custom fields yet
+		lua_setfenv(L, -2);
 
 		// Set it in the registry so we can find it again
 		lua_pushlightuserdata(L, data); // k (store the userdata via the data's pointer)
@@ -366,6 +594,111 @@ void LUA_PushUserdata(lua_State *L, void *data, const char *meta)
 	lua_remove(L, -2); // remove LREG_VALID
 }
 
+// Custom fields, like mo.myvar, are kept in a table that is the
+// userdata's environment. Userdata start out with the globals there,
+// which means they have none.
+// Pushes the custom field table of the userdata at idx and returns true,
+// or pushes nothing and returns false if it has none and create is false.
+boolean LUA_PushExtVars(lua_State *L, int idx, boolean create)
+{
+	lua_getfenv(L, idx);
+	if (!lua_rawequal(L, -1, LUA_GLOBALSINDEX))
+		return true;
+	lua_pop(L, 1);
+
+	if (!create)
+		return false;
+
+	if (idx < 0)
+		idx = lua_gettop(L) + idx + 1;
+	lua_newtable(L);
+	lua_pushvalue(L, -1);
+	lua_setfenv(L, idx);
+	return true;
+}
+
+// Pushes the userdata data already has and returns true, or returns false
+static boolean LUA_PushExistingUserdata(void *data, const char *meta)
+{
+	INT32 *ref = LUA_UserdataRef(data, meta);
+
+	if (ref)
+	{
+		if (!*ref)
+			return false;
+		lua_rawgeti(gL, LUA_REGISTRYINDEX, *ref);
+		return true;
+	}
+
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_VALID);
+	lua_pushlightuserdata(gL, data);
+	lua_rawget(gL, -2);
+	lua_remove(gL, -2); // remove LREG_VALID
+	if (lua_isnil(gL, -1))
+	{
+		lua_pop(gL, 1);
+		return false;
+	}
+	return true;
+}
+
+#ifdef _DEBUG
+// Forgets the custom fields LUA_Archive saves
+void LUA_ClearExtVars(void)
+{
+	thinker_t *th;
+	INT32 i;
+
+	if (!gL)
+		return;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (LUA_PushExistingUserdata(&players[i], META_PLAYER))
+		{
+			lua_pushvalue(gL, LUA_GLOBALSINDEX);
+			lua_setfenv(gL, -2);
+			lua_pop(gL, 1);
+		}
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th->function.acp1 == (actionf_p1)P_MobjThinker
+		&& LUA_PushExistingUserdata(th, META_MOBJ))
+		{
+			lua_pushvalue(gL, LUA_GLOBALSINDEX);
+			lua_setfenv(gL, -2);
+			lua_pop(gL, 1);
+		}
+}
+#endif
+
+// Same as below, for userdata kept by reference.
+static void LUA_InvalidateRef(void *data, INT32 *ref)
+{
+	void **userdata;
+
+	if (!*ref)
+		return;
+
+	// invalidate the userdata, and nullify any additional data
+	lua_rawgeti(gL, LUA_REGISTRYINDEX, *ref);
+	userdata = lua_touserdata(gL, -1);
+	I_Assert(userdata != NULL && *userdata == data);
+	*userdata = NULL;
+	lua_pushvalue(gL, LUA_GLOBALSINDEX);
+	lua_setfenv(gL, -2);
+	lua_pop(gL, 1);
+
+	luaL_unref(gL, LUA_REGISTRYINDEX, *ref);
+	*ref = 0;
+}
+
+void LUA_InvalidateThinker(thinker_t *thinker)
+{
+	if (!gL)
+		return;
+	LUA_InvalidateRef(thinker, &thinker->luaref);
+}
+
 // When userdata is freed, use this function to remove it from Lua.
 void LUA_InvalidateUserdata(void *data)
 {
@@ -383,17 +716,11 @@ void LUA_InvalidateUserdata(void *data)
 				return;
 			}
 
-			// nullify any additional data
-			lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
-			I_Assert(lua_istable(gL, -1));
-				lua_pushlightuserdata(gL, data);
-				lua_pushnil(gL);
-				lua_rawset(gL, -3);
-			lua_pop(gL, 1);
-
-			// invalidate the userdata
+			// invalidate the userdata, and nullify any additional data
 			userdata = lua_touserdata(gL, -1);
 			*userdata = NULL;
+			lua_pushvalue(gL, LUA_GLOBALSINDEX);
+			lua_setfenv(gL, -2);
 		lua_pop(gL, 1);
 
 		// remove it from the registry
@@ -411,22 +738,23 @@ void LUA_InvalidateLevel(void)
 	if (!gL)
 		return;
 
-	for (th = thinkercap.next; th && th != &thinkercap; th = th->next)
-		LUA_InvalidateUserdata(th);
+	for (i = 0; i < NUM_THINKERLISTS; i++)
+		for (th = thlist[i].next; th && th != &thlist[i]; th = th->next)
+			LUA_InvalidateThinker(th);
 
 	LUA_InvalidateMapthings();
 
 	for (i = 0; i < numsubsectors; i++)
 		LUA_InvalidateUserdata(&subsectors[i]);
 	for (i = 0; i < numsectors; i++)
-		LUA_InvalidateUserdata(&sectors[i]);
+		LUA_InvalidateRef(&sectors[i], &sectors[i].luaref);
 	for (i = 0; i < numlines; i++)
 	{
-		LUA_InvalidateUserdata(&lines[i]);
+		LUA_InvalidateRef(&lines[i], &lines[i].luaref);
 		LUA_InvalidateUserdata(lines[i].sidenum);
 	}
 	for (i = 0; i < numsides; i++)
-		LUA_InvalidateUserdata(&sides[i]);
+		LUA_InvalidateRef(&sides[i], &sides[i].luaref);
 	for (i = 0; i < numvertexes; i++)
 		LUA_InvalidateUserdata(&vertexes[i]);
 }
@@ -445,17 +773,35 @@ void LUA_InvalidatePlayer(player_t *player)
 {
 	if (!gL)
 		return;
-	LUA_InvalidateUserdata(player);
+	LUA_InvalidateRef(player, &playerrefs[player - players]);
 	LUA_InvalidateUserdata(player->powers);
 	LUA_InvalidateUserdata(&player->cmd);
 }
 
+//
+// Net archiving
+//
+// Every value starts with its type. Integers, lengths and the indices
+// of what userdata point to follow as varints, and numbers that are a
+// whole number of FRACUNITs are written in FRACUNITs, so the common
+// cases take a byte or two. Each string is written out once; after
+// that it's written as its number. Tables are numbered the same way,
+// so one shared between several places is only written once.
+//
+// While archiving, the tables table keeps table number i at i, and the
+// number given to each table and string under the table or string
+// itself. While unarchiving, string number i is kept at -i.
+//
+
 enum
 {
 	ARCH_NULL=0,
-	ARCH_BOOLEAN,
-	ARCH_SIGNED,
+	ARCH_TRUE,
+	ARCH_FALSE,
+	ARCH_INT,
+	ARCH_FRAC,
 	ARCH_STRING,
+	ARCH_STRINGREF,
 	ARCH_TABLE,
 
 	ARCH_MOBJINFO,
@@ -497,6 +843,49 @@ static const struct {
 	{NULL,          ARCH_NULL}
 };
 
+static UINT32 numarchstrings; // strings numbered so far, either way
+
+// The last LUA_Archive's size and how long it took
+static size_t lastarchivesize;
+static UINT32 lastarchivemicros;
+
+static void WriteVarUInt(UINT32 n)
+{
+	while (n >= 0x80)
+	{
+		WRITEUINT8(save_p, (UINT8)(n | 0x80));
+		n >>= 7;
+	}
+	WRITEUINT8(save_p, (UINT8)n);
+}
+
+static UINT32 ReadVarUInt(void)
+{
+	UINT32 n = 0;
+	UINT8 b, shift = 0;
+
+	do
+	{
+		b = READUINT8(save_p);
+		if (shift < 32)
+			n |= (UINT32)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return n;
+}
+
+// Zigzagged, so small negative numbers stay small too
+static void WriteVarInt(INT32 n)
+{
+	WriteVarUInt(((UINT32)n << 1) ^ (n < 0 ? UINT32_MAX : 0));
+}
+
+static INT32 ReadVarInt(void)
+{
+	UINT32 n = ReadVarUInt();
+	return (INT32)(n >> 1) ^ -(INT32)(n & 1);
+}
+
 static UINT8 GetUserdataArchType(int index)
 {
 	UINT8 i;
@@ -517,6 +906,31 @@ static UINT8 GetUserdataArchType(int index)
 	return ARCH_NULL;
 }
 
+// Writes the userdata at myindex as its index in base
+#define ARCHIVEINDEX(type, arch, base) \
+{\
+	type *p = *((type **)lua_touserdata(gL, myindex));\
+	if (!p)\
+		WRITEUINT8(save_p, ARCH_NULL);\
+	else {\
+		WRITEUINT8(save_p, arch);\
+		WriteVarUInt((UINT32)(p - (base)));\
+	}\
+	break;\
+}
+
+// Looks up the number the table or string at myindex was given, if any
+static UINT32 ArchivedNumber(int TABLESINDEX, int myindex)
+{
+	UINT32 n;
+
+	lua_pushvalue(gL, myindex);
+	lua_rawget(gL, TABLESINDEX);
+	n = (UINT32)lua_tointeger(gL, -1); // 0 if it's nil
+	lua_pop(gL, 1);
+	return n;
+}
+
 static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 {
 	if (myindex < 0)
@@ -534,81 +948,76 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 		WRITEUINT8(save_p, ARCH_NULL);
 		return 2;
 	case LUA_TBOOLEAN:
-		WRITEUINT8(save_p, ARCH_BOOLEAN);
-		WRITEUINT8(save_p, lua_toboolean(gL, myindex));
+		WRITEUINT8(save_p, lua_toboolean(gL, myindex) ? ARCH_TRUE : ARCH_FALSE);
 		break;
 	case LUA_TNUMBER:
 	{
-		lua_Integer number = lua_tointeger(gL, myindex);
-        WRITEUINT8(save_p, ARCH_SIGNED);
-        WRITEFIXED(save_p, number);
+		INT32 number = (INT32)lua_tointeger(gL, myindex);
+		if (number && !(number & (FRACUNIT-1)))
+		{
+			WRITEUINT8(save_p, ARCH_FRAC);
+			WriteVarInt(number / FRACUNIT);
+		}
+		else
+		{
+			WRITEUINT8(save_p, ARCH_INT);
+			WriteVarInt(number);
+		}
 		break;
 	}
 	case LUA_TSTRING:
 	{
-		UINT16 len = (UINT16)lua_objlen(gL, myindex); // get length of string, including embedded zeros
-		const char *s = lua_tostring(gL, myindex);
-		UINT16 i = 0;
+		UINT32 sid = ArchivedNumber(TABLESINDEX, myindex);
+		const char *s;
+		size_t len;
+
+		if (sid)
+		{
+			WRITEUINT8(save_p, ARCH_STRINGREF);
+			WriteVarUInt(sid);
+			break;
+		}
+
+		// Lua strings can have embedded zeros ('\0'), so WRITESTRING
+		// won't do; the length goes first instead.
+		s = lua_tolstring(gL, myindex, &len);
 		WRITEUINT8(save_p, ARCH_STRING);
-		// if you're wondering why we're writing a string to save_p this way,
-		// it turns out that Lua can have embedded zeros ('\0') in the strings,
-		// so we can't use WRITESTRING as that cuts off when it finds a '\0'.
-		// Saving the size of the string also allows us to get the size of the string on the other end,
-		// fixing the awful crashes previously encountered for reading strings longer than 1024
-		// (yes I know that's kind of a stupid thing to care about, but it'd be evil to trim or ignore them?)
-		// -- Monster Iestyn 05/08/18
-		WRITEUINT16(save_p, len); // save size of string
-		while (i < len)
-			WRITECHAR(save_p, s[i++]); // write chars individually, including the embedded zeros
+		WriteVarUInt((UINT32)len);
+		M_Memcpy(save_p, s, len);
+		save_p += len;
+
+		lua_pushvalue(gL, myindex);
+		lua_pushinteger(gL, ++numarchstrings);
+		lua_rawset(gL, TABLESINDEX);
 		break;
 	}
 	case LUA_TTABLE:
 	{
-		boolean found = false;
-		INT32 i;
-		UINT16 t = (UINT16)lua_objlen(gL, TABLESINDEX);
-
-		for (i = 1; i <= t && !found; i++)
-		{
-			lua_rawgeti(gL, TABLESINDEX, i);
-			if (lua_rawequal(gL, myindex, -1))
-			{
-				t = i;
-				found = true;
-			}
-			lua_pop(gL, 1);
-		}
-		if (!found)
-			t++;
+		UINT32 t = ArchivedNumber(TABLESINDEX, myindex);
 
 		WRITEUINT8(save_p, ARCH_TABLE);
-		WRITEUINT16(save_p, t);
-
-		if (!found)
+		if (t)
 		{
-			lua_pushvalue(gL, myindex);
-			lua_rawseti(gL, TABLESINDEX, t);
-			return 1;
+			WriteVarUInt(t);
+			break;
 		}
-		break;
+
+		t = (UINT32)lua_objlen(gL, TABLESINDEX) + 1;
+		WriteVarUInt(t);
+		lua_pushvalue(gL, myindex);
+		lua_rawseti(gL, TABLESINDEX, t);
+		lua_pushvalue(gL, myindex);
+		lua_pushinteger(gL, t);
+		lua_rawset(gL, TABLESINDEX);
+		return 1;
 	}
 	case LUA_TUSERDATA:
 		switch (GetUserdataArchType(myindex))
 		{
 		case ARCH_MOBJINFO:
-		{
-			mobjinfo_t *info = *((mobjinfo_t **)lua_touserdata(gL, myindex));
-			WRITEUINT8(save_p, ARCH_MOBJINFO);
-			WRITEUINT16(save_p, info - mobjinfo);
-			break;
-		}
+			ARCHIVEINDEX(mobjinfo_t, ARCH_MOBJINFO, mobjinfo)
 		case ARCH_STATE:
-		{
-			state_t *state = *((state_t **)lua_touserdata(gL, myindex));
-			WRITEUINT8(save_p, ARCH_STATE);
-			WRITEUINT16(save_p, state - states);
-			break;
-		}
+			ARCHIVEINDEX(state_t, ARCH_STATE, states)
 		case ARCH_MOBJ:
 		{
 			mobj_t *mobj = *((mobj_t **)lua_touserdata(gL, myindex));
@@ -616,87 +1025,24 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 				WRITEUINT8(save_p, ARCH_NULL);
 			else {
 				WRITEUINT8(save_p, ARCH_MOBJ);
-				WRITEUINT32(save_p, mobj->mobjnum);
+				WriteVarUInt(mobj->mobjnum);
 			}
 			break;
 		}
 		case ARCH_PLAYER:
-		{
-			player_t *player = *((player_t **)lua_touserdata(gL, myindex));
-			if (!player)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_PLAYER);
-				WRITEUINT8(save_p, player - players);
-			}
-			break;
-		}
+			ARCHIVEINDEX(player_t, ARCH_PLAYER, players)
 		case ARCH_MAPTHING:
-		{
-			mapthing_t *mapthing = *((mapthing_t **)lua_touserdata(gL, myindex));
-			if (!mapthing)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_MAPTHING);
-				WRITEUINT16(save_p, mapthing - mapthings);
-			}
-			break;
-		}
+			ARCHIVEINDEX(mapthing_t, ARCH_MAPTHING, mapthings)
 		case ARCH_VERTEX:
-		{
-			vertex_t *vertex = *((vertex_t **)lua_touserdata(gL, myindex));
-			if (!vertex)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_VERTEX);
-				WRITEUINT16(save_p, vertex - vertexes);
-			}
-			break;
-		}
+			ARCHIVEINDEX(vertex_t, ARCH_VERTEX, vertexes)
 		case ARCH_LINE:
-		{
-			line_t *line = *((line_t **)lua_touserdata(gL, myindex));
-			if (!line)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_LINE);
-				WRITEUINT16(save_p, line - lines);
-			}
-			break;
-		}
+			ARCHIVEINDEX(line_t, ARCH_LINE, lines)
 		case ARCH_SIDE:
-		{
-			side_t *side = *((side_t **)lua_touserdata(gL, myindex));
-			if (!side)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_SIDE);
-				WRITEUINT16(save_p, side - sides);
-			}
-			break;
-		}
+			ARCHIVEINDEX(side_t, ARCH_SIDE, sides)
 		case ARCH_SUBSECTOR:
-		{
-			subsector_t *subsector = *((subsector_t **)lua_touserdata(gL, myindex));
-			if (!subsector)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_SUBSECTOR);
-				WRITEUINT16(save_p, subsector - subsectors);
-			}
-			break;
-		}
+			ARCHIVEINDEX(subsector_t, ARCH_SUBSECTOR, subsectors)
 		case ARCH_SECTOR:
-		{
-			sector_t *sector = *((sector_t **)lua_touserdata(gL, myindex));
-			if (!sector)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_SECTOR);
-				WRITEUINT16(save_p, sector - sectors);
-			}
-			break;
-		}
+			ARCHIVEINDEX(sector_t, ARCH_SECTOR, sectors)
 #ifdef ESLOPE
 		case ARCH_SLOPE:
 		{
@@ -705,22 +1051,13 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 				WRITEUINT8(save_p, ARCH_NULL);
 			else {
 				WRITEUINT8(save_p, ARCH_SLOPE);
-				WRITEUINT16(save_p, slope->id);
+				WriteVarUInt(slope->id);
 			}
 			break;
 		}
 #endif
 		case ARCH_MAPHEADER:
-		{
-			mapheader_t *header = *((mapheader_t **)lua_touserdata(gL, myindex));
-			if (!header)
-				WRITEUINT8(save_p, ARCH_NULL);
-			else {
-				WRITEUINT8(save_p, ARCH_MAPHEADER);
-				WRITEUINT16(save_p, header - *mapheaderinfo);
-			}
-			break;
-		}
+			ARCHIVEINDEX(mapheader_t, ARCH_MAPHEADER, *mapheaderinfo)
 		default:
 			WRITEUINT8(save_p, ARCH_NULL);
 			return 2;
@@ -730,32 +1067,36 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 	return 0;
 }
 
+#undef ARCHIVEINDEX
+
 static void ArchiveExtVars(void *pointer, const char *ptype)
 {
 	int TABLESINDEX;
-	UINT16 i;
+	UINT32 i;
 
 	if (!gL) {
 		if (fastcmp(ptype,"player")) // players must always be included, even if no vars
-			WRITEUINT16(save_p, 0);
+			WriteVarUInt(0);
 		return;
 	}
 
 	TABLESINDEX = lua_gettop(gL);
 
-	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
-	I_Assert(lua_istable(gL, -1));
-	lua_pushlightuserdata(gL, pointer);
-	lua_rawget(gL, -2);
-	lua_remove(gL, -2); // pop LREG_EXTVARS
+	if (!LUA_PushExistingUserdata(pointer, fastcmp(ptype,"player") ? META_PLAYER : META_MOBJ))
+	{ // never seen by Lua
+		if (fastcmp(ptype,"player")) // players must always be included, even if no vars
+			WriteVarUInt(0);
+		return;
+	}
 
-	if (!lua_istable(gL, -1))
+	if (!LUA_PushExtVars(gL, -1, false))
 	{ // no extra values table
 		lua_pop(gL, 1);
 		if (fastcmp(ptype,"player")) // players must always be included, even if no vars
-			WRITEUINT16(save_p, 0);
+			WriteVarUInt(0);
 		return;
 	}
+	lua_remove(gL, -2); // pop the userdata
 
 	lua_pushnil(gL);
 	for (i = 0; lua_next(gL, -2); i++)
@@ -765,19 +1106,19 @@ static void ArchiveExtVars(void *pointer, const char *ptype)
 	if (i == 0)
 	{
 		if (fastcmp(ptype,"player")) // always include players even if they have no extra variables
-			WRITEUINT16(save_p, 0);
+			WriteVarUInt(0);
 		lua_pop(gL, 1);
 		return;
 	}
 
 	if (fastcmp(ptype,"mobj")) // mobjs must write their mobjnum as a header
-		WRITEUINT32(save_p, ((mobj_t *)pointer)->mobjnum);
-	WRITEUINT16(save_p, i);
+		WriteVarUInt(((mobj_t *)pointer)->mobjnum);
+	WriteVarUInt(i);
 	lua_pushnil(gL);
 	while (lua_next(gL, -2))
 	{
 		I_Assert(lua_type(gL, -2) == LUA_TSTRING);
-		WRITESTRING(save_p, lua_tostring(gL, -2));
+		ArchiveValue(TABLESINDEX, -2); // the same few names over and over
 		if (ArchiveValue(TABLESINDEX, -1) == 2)
 			CONS_Alert(CONS_ERROR, "Type of value for %s entry '%s' (%s) could not be archived!\n", ptype, lua_tostring(gL, -2), luaL_typename(gL, -1));
 		lua_pop(gL, 1);
@@ -798,7 +1139,7 @@ static int NetArchive(lua_State *L)
 static void ArchiveTables(void)
 {
 	int TABLESINDEX;
-	UINT16 i, n;
+	UINT32 i, n;
 	UINT8 e;
 
 	if (!gL)
@@ -806,7 +1147,7 @@ static void ArchiveTables(void)
 
 	TABLESINDEX = lua_gettop(gL);
 
-	n = (UINT16)lua_objlen(gL, TABLESINDEX);
+	n = (UINT32)lua_objlen(gL, TABLESINDEX);
 	for (i = 1; i <= n; i++)
 	{
 		lua_rawgeti(gL, TABLESINDEX, i);
@@ -815,7 +1156,9 @@ static void ArchiveTables(void)
 		{
 			// Write key
 			e = ArchiveValue(TABLESINDEX, -2); // key should be either a number or a string, ArchiveValue can handle this.
-			if (e == 2) // invalid key type (function, thread, lightuserdata, or anything we don't recognise)
+			if (e == 1)
+				n++; // a table used as a key is fine, as long as it's archived too
+			else if (e == 2) // invalid key type (function, thread, lightuserdata, or anything we don't recognise)
 			{
 				lua_pushvalue(gL, -2);
 				CONS_Alert(CONS_ERROR, "Index '%s' (%s) of table %d could not be archived!\n", lua_tostring(gL, -1), luaL_typename(gL, -1), i);
@@ -847,32 +1190,31 @@ static UINT8 UnArchiveValue(int TABLESINDEX)
 	case ARCH_NULL:
 		lua_pushnil(gL);
 		break;
-	case ARCH_BOOLEAN:
-		lua_pushboolean(gL, READUINT8(save_p));
+	case ARCH_TRUE:
+	case ARCH_FALSE:
+		lua_pushboolean(gL, type == ARCH_TRUE);
+		break;
+	case ARCH_INT:
+		lua_pushinteger(gL, ReadVarInt());
 		break;
-	case ARCH_SIGNED:
-		lua_pushinteger(gL, READFIXED(save_p));
+	case ARCH_FRAC:
+		lua_pushinteger(gL, ReadVarInt() * FRACUNIT);
 		break;
 	case ARCH_STRING:
 	{
-		UINT16 len = READUINT16(save_p); // length of string, including embedded zeros
-		char *value;
-		UINT16 i = 0;
-		// See my comments in the ArchiveValue function;
-		// it's much the same for reading strings as writing them!
-		// (i.e. we can't use READSTRING either)
-		// -- Monster Iestyn 05/08/18
-		value = malloc(len); // make temp buffer of size len
-		// now read the actual string
-		while (i < len)
-			value[i++] = READCHAR(save_p); // read chars individually, including the embedded zeros
-		lua_pushlstring(gL, value, len); // push the string (note: this function supports embedded zeros)
-		free(value); // free the buffer
+		size_t len = ReadVarUInt();
+		lua_pushlstring(gL, (const char *)save_p, len); // embedded zeros and all
+		save_p += len;
+		lua_pushvalue(gL, -1);
+		lua_rawseti(gL, TABLESINDEX, -(INT32)(++numarchstrings));
 		break;
 	}
+	case ARCH_STRINGREF:
+		lua_rawgeti(gL, TABLESINDEX, -(INT32)ReadVarUInt());
+		break;
 	case ARCH_TABLE:
 	{
-		UINT16 tid = READUINT16(save_p);
+		UINT32 tid = ReadVarUInt();
 		lua_rawgeti(gL, TABLESINDEX, tid);
 		if (lua_isnil(gL, -1))
 		{
@@ -885,42 +1227,42 @@ static UINT8 UnArchiveValue(int TABLESINDEX)
 		break;
 	}
 	case ARCH_MOBJINFO:
-		LUA_PushUserdata(gL, &mobjinfo[READUINT16(save_p)], META_MOBJINFO);
+		LUA_PushUserdata(gL, &mobjinfo[ReadVarUInt()], META_MOBJINFO);
 		break;
 	case ARCH_STATE:
-		LUA_PushUserdata(gL, &states[READUINT16(save_p)], META_STATE);
+		LUA_PushUserdata(gL, &states[ReadVarUInt()], META_STATE);
 		break;
 	case ARCH_MOBJ:
-		LUA_PushUserdata(gL, P_FindNewPosition(READUINT32(save_p)), META_MOBJ);
+		LUA_PushUserdata(gL, P_FindNewPosition(ReadVarUInt()), META_MOBJ);
 		break;
 	case ARCH_PLAYER:
-		LUA_PushUserdata(gL, &players[READUINT8(save_p)], META_PLAYER);
+		LUA_PushUserdata(gL, &players[ReadVarUInt()], META_PLAYER);
 		break;
 	case ARCH_MAPTHING:
-		LUA_PushUserdata(gL, &mapthings[READUINT16(save_p)], META_MAPTHING);
+		LUA_PushUserdata(gL, &mapthings[ReadVarUInt()], META_MAPTHING);
 		break;
 	case ARCH_VERTEX:
-		LUA_PushUserdata(gL, &vertexes[READUINT16(save_p)], META_VERTEX);
+		LUA_PushUserdata(gL, &vertexes[ReadVarUInt()], META_VERTEX);
 		break;
 	case ARCH_LINE:
-		LUA_PushUserdata(gL, &lines[READUINT16(save_p)], META_LINE);
+		LUA_PushUserdata(gL, &lines[ReadVarUInt()], META_LINE);
 		break;
 	case ARCH_SIDE:
-		LUA_PushUserdata(gL, &sides[READUINT16(save_p)], META_SIDE);
+		LUA_PushUserdata(gL, &sides[ReadVarUInt()], META_SIDE);
 		break;
 	case ARCH_SUBSECTOR:
-		LUA_PushUserdata(gL, &subsectors[READUINT16(save_p)], META_SUBSECTOR);
+		LUA_PushUserdata(gL, &subsectors[ReadVarUInt()], META_SUBSECTOR);
 		break;
 	case ARCH_SECTOR:
-		LUA_PushUserdata(gL, &sectors[READUINT16(save_p)], META_SECTOR);
+		LUA_PushUserdata(gL, &sectors[ReadVarUInt()], META_SECTOR);
 		break;
 #ifdef ESLOPE
 	case ARCH_SLOPE:
-		LUA_PushUserdata(gL, P_SlopeById(READUINT16(save_p)), META_SLOPE);
+		LUA_PushUserdata(gL, P_SlopeById((UINT16)ReadVarUInt()), META_SLOPE);
 		break;
 #endif
 	case ARCH_MAPHEADER:
-		LUA_PushUserdata(gL, mapheaderinfo[READUINT16(save_p)], META_MAPHEADER);
+		LUA_PushUserdata(gL, mapheaderinfo[ReadVarUInt()], META_MAPHEADER);
 		break;
 	case ARCH_TEND:
 		return 1;
@@ -928,12 +1270,11 @@ static UINT8 UnArchiveValue(int TABLESINDEX)
 	return 0;
 }
 
-static void UnArchiveExtVars(void *pointer)
+static void UnArchiveExtVars(void *pointer, const char *meta)
 {
 	int TABLESINDEX;
-	UINT16 field_count = READUINT16(save_p);
-	UINT16 i;
-	char field[1024];
+	UINT32 field_count = ReadVarUInt();
+	UINT32 i;
 
 	if (field_count == 0)
 		return;
@@ -944,17 +1285,15 @@ static void UnArchiveExtVars(void *pointer)
 
 	for (i = 0; i < field_count; i++)
 	{
-		READSTRING(save_p, field);
+		UnArchiveValue(TABLESINDEX); // name
 		UnArchiveValue(TABLESINDEX);
-		lua_setfield(gL, -2, field);
+		lua_rawset(gL, -3);
 	}
 
-	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
-	I_Assert(lua_istable(gL, -1));
-	lua_pushlightuserdata(gL, pointer);
-	lua_pushvalue(gL, -3); // pointer's ext vars subtable
-	lua_rawset(gL, -3);
-	lua_pop(gL, 2); // pop LREG_EXTVARS and pointer's subtable
+	LUA_PushUserdata(gL, pointer, meta);
+	lua_insert(gL, -2);
+	lua_setfenv(gL, -2); // pops pointer's ext vars subtable
+	lua_pop(gL, 1); // pop the userdata
 }
 
 static int NetUnArchive(lua_State *L)
@@ -969,21 +1308,24 @@ static int NetUnArchive(lua_State *L)
 static void UnArchiveTables(void)
 {
 	int TABLESINDEX;
-	UINT16 i, n;
+	UINT32 i, n;
 
 	if (!gL)
 		return;
 
 	TABLESINDEX = lua_gettop(gL);
 
-	n = (UINT16)lua_objlen(gL, TABLESINDEX);
+	n = (UINT32)lua_objlen(gL, TABLESINDEX);
 	for (i = 1; i <= n; i++)
 	{
 		lua_rawgeti(gL, TABLESINDEX, i);
 		while (true)
 		{
-			if (UnArchiveValue(TABLESINDEX) == 1) // read key
+			UINT8 e = UnArchiveValue(TABLESINDEX); // read key
+			if (e == 1)
 				break;
+			if (e == 2)
+				n++;
 			if (UnArchiveValue(TABLESINDEX) == 2) // read value
 				n++;
 			if (lua_isnil(gL, -2)) // if key is nil (if a function etc was accidentally saved)
@@ -998,18 +1340,133 @@ static void UnArchiveTables(void)
 	}
 }
 
+//
+// Garbage collection
+//
+// With lua_gcbudget at 0, Lua's own collector runs whenever scripts
+// allocate enough, which can be in the middle of any hook. Otherwise
+// it's stopped, and only ever run in slices of at most that many
+// microseconds: one at the end of every tic, and more while waiting
+// for the next one. Like Lua's own, a cycle starts once the heap has
+// doubled since the last one finished.
+//
+
+// A script that makes garbage faster than the budget can clear it would
+// grow the heap without end. Past this many times the size that should
+// have started the cycle, the rest of it is done at once.
+#define GCRUNAWAY 4
+
+static void LUA_ResetGC(void)
+{
+	gcincycle = false;
+	gcnextkb = 0;
+	if (!gL)
+		return;
+	if (cv_luagcbudget.value)
+	{
+		gcnextkb = lua_gc(gL, LUA_GCCOUNT, 0) * 2;
+		lua_gc(gL, LUA_GCSTOP, 0);
+	}
+	else
+		lua_gc(gL, LUA_GCRESTART, 0);
+}
+
+static void LUA_GCBudget_OnChange(void)
+{
+	LUA_ResetGC();
+}
+
+// Runs the collector for about budget microseconds at most,
+// and returns how long it took.
+static UINT32 LUA_GCSlice(UINT32 budget)
+{
+	UINT32 start = I_GetTimeMicros();
+	INT32 kb = lua_gc(gL, LUA_GCCOUNT, 0);
+
+	gcstepped = true;
+
+	if (!gcincycle && kb < gcnextkb)
+		return 0;
+
+	if (gcnextkb && kb >= gcnextkb * GCRUNAWAY)
+	{
+		CONS_Debug(DBG_LUA, "Lua heap at %d KB, collecting everything\n", kb);
+		LUA_FullGC();
+		return I_GetTimeMicros() - start;
+	}
+
+	gcincycle = true;
+	do
+	{
+		if (lua_gc(gL, LUA_GCSTEP, 0)) // finished the cycle
+		{
+			gcincycle = false;
+			gcnextkb = lua_gc(gL, LUA_GCCOUNT, 0) * 2;
+			break;
+		}
+	} while (I_GetTimeMicros() - start < budget);
+
+	// Stepping sets the collector going again
+	lua_gc(gL, LUA_GCSTOP, 0);
+	return I_GetTimeMicros() - start;
+}
+
+void LUA_FullGC(void)
+{
+	if (!gL)
+		return;
+	lua_gc(gL, LUA_GCCOLLECT, 0);
+	LUA_ResetGC();
+}
+
+void LUA_TicGC(void)
+{
+	UINT32 micros;
+
+	if (!gL || !cv_luagcbudget.value)
+		return;
+
+	micros = LUA_GCSlice(cv_luagcbudget.value);
+	if (ps_tickprofiling)
+		PS_AddGCTime(micros);
+	if (cv_perfstats.value)
+		ps_frametime[PSF_LUAGC] += micros;
+}
+
+void LUA_IdleGC(void)
+{
+	UINT32 micros;
+
+	// Only finish what's been started; a new cycle can wait for a tic
+	if (!gL || !cv_luagcbudget.value || !gcincycle)
+		return;
+	micros = LUA_GCSlice(cv_luagcbudget.value);
+	if (cv_perfstats.value)
+		ps_frametime[PSF_LUAGC] += micros;
+}
+
 void LUA_Step(void)
 {
 	if (!gL)
 		return;
 	lua_settop(gL, 0);
-	lua_gc(gL, LUA_GCSTEP, 1);
+
+	if (!cv_luagcbudget.value)
+		lua_gc(gL, LUA_GCSTEP, 1);
+	else if (!gcstepped) // no tic ran since last time, such as in menus
+		LUA_GCSlice(cv_luagcbudget.value);
+	gcstepped = false;
 }
 
 void LUA_Archive(void)
 {
 	INT32 i;
 	thinker_t *th;
+	UINT8 *start = save_p;
+	UINT32 starttime = I_GetTimeMicros();
+
+	LUAh_ArchiveWatchdog();
+	numarchstrings = 0;
 
 	if (gL)
 		lua_newtable(gL); // tables to be archived.
@@ -1022,20 +1479,29 @@ void LUA_Archive(void)
 		ArchiveExtVars(&players[i], "player");
 	}
 
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 		{
 			// archive function will determine when to skip mobjs,
 			// and write mobjnum in otherwise.
 			ArchiveExtVars(th, "mobj");
 		}
-	WRITEUINT32(save_p, UINT32_MAX); // end of mobjs marker, replaces mobjnum.
+	WriteVarUInt(UINT32_MAX); // end of mobjs marker, replaces mobjnum.
 
 	LUAh_NetArchiveHook(NetArchive); // call the NetArchive hook in archive mode
 	ArchiveTables();
 
 	if (gL)
 		lua_pop(gL, 1); // pop tables
+
+	lastarchivesize = save_p - start;
+	lastarchivemicros = I_GetTimeMicros() - starttime;
+}
+
+void LUA_GetArchiveStats(size_t *bytes, UINT32 *micros)
+{
+	*bytes = lastarchivesize;
+	*micros = lastarchivemicros;
 }
 
 void LUA_UnArchive(void)
@@ -1044,6 +1510,9 @@ void LUA_UnArchive(void)
 	INT32 i;
 	thinker_t *th;
 
+	LUAh_UnArchiveWatchdog();
+	numarchstrings = 0;
+
 	if (gL)
 		lua_newtable(gL); // tables to be read
 
@@ -1051,15 +1520,15 @@ void LUA_UnArchive(void)
 	{
 		if (!playeringame[i])
 			continue;
-		UnArchiveExtVars(&players[i]);
+		UnArchiveExtVars(&players[i], META_PLAYER);
 	}
 
 	do {
-		mobjnum = READUINT32(save_p); // read a mobjnum
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		mobjnum = ReadVarUInt(); // read a mobjnum
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			if (th->function.acp1 == (actionf_p1)P_MobjThinker
 			&& ((mobj_t *)th)->mobjnum == mobjnum) // find matching mobj
-				UnArchiveExtVars(th); // apply variables
+				UnArchiveExtVars(th, META_MOBJ); // apply variables
 	} while(mobjnum != UINT32_MAX); // repeat until end of mobjs marker.
 
 	LUAh_NetArchiveHook(NetUnArchive); // call the NetArchive hook in unarchive mode
@@ -1070,15 +1539,51 @@ void LUA_UnArchive(void)
 }
 
 // For mobj_t, player_t, etc. to take custom variables.
-int Lua_optoption(lua_State *L, int narg,
-	const char *def, const char *const lst[])
+// Makes a table mapping each string in lst to its index, and returns
+// a registry reference to it for Lua_optoption and Lua_checkoption.
+// Lua strings are interned, so looking a field up in it is a single
+// hash lookup instead of a string compare for every entry of lst.
+int Lua_CreateFieldTable(lua_State *L, const char *const lst[])
 {
-	const char *name = (def) ? luaL_optstring(L, narg, def) :  luaL_checkstring(L, narg);
 	int i;
-	for (i=0; lst[i]; i++)
-		if (fastcmp(lst[i], name))
-			return i;
-	return -1;
+
+	lua_newtable(L);
+	for (i = 0; lst[i]; i++)
+	{
+		lua_pushstring(L, lst[i]);
+		lua_pushinteger(L, i);
+		lua_rawset(L, -3);
+	}
+	return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+// Returns the index of the string at narg in the field table, or -1 if
+// it isn't in there. If the argument is missing def is returned,
+// unless def is -1, in which case a string is required.
+int Lua_optoption(lua_State *L, int narg, int def, int list_ref)
+{
+	int i = -1;
+
+	if (def != -1 && lua_isnoneornil(L, narg))
+		return def;
+
+	luaL_checkstring(L, narg);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, list_ref);
+	lua_pushvalue(L, narg);
+	lua_rawget(L, -2);
+	if (lua_isnumber(L, -1))
+		i = (int)lua_tointeger(L, -1);
+	lua_pop(L, 2);
+	return i;
+}
+
+// Same as above, but unknown strings are an error, like luaL_checkoption.
+int Lua_checkoption(lua_State *L, int narg, int def, int list_ref)
+{
+	int i = Lua_optoption(L, narg, def, list_ref);
+	if (i == -1)
+		return luaL_argerror(L, narg, lua_pushfstring(L, "invalid option " LUA_QS, lua_tostring(L, narg)));
+	return i;
 }
 
 #endif // HAVE_BLUA
@@ -15,6 +15,7 @@
 #include "m_fixed.h"
 #include "doomtype.h"
 #include "d_player.h"
+#include "command.h"
 
 #include "blua/lua.h"
 #include "blua/lualib.h"
@@ -44,17 +45,42 @@ void LUA_DumpFile(const char *filename);
 #endif
 fixed_t LUA_EvalMath(const char *word);
 void LUA_PushUserdata(lua_State *L, void *data, const char *meta);
+boolean LUA_PushExtVars(lua_State *L, int idx, boolean create);
 void LUA_InvalidateUserdata(void *data);
+void LUA_InvalidateThinker(thinker_t *thinker);
 void LUA_InvalidateLevel(void);
 void LUA_InvalidateMapthings(void);
 void LUA_InvalidatePlayer(player_t *player);
+
+extern consvar_t cv_luagcbudget;
+
+/**	\brief Collects all of Lua's garbage at once, for load times.
+*/
+void LUA_FullGC(void);
+
+/**	\brief Runs the garbage collector for at most lua_gcbudget microseconds.
+	Called at the end of every tic.
+*/
+void LUA_TicGC(void);
+
+/**	\brief Carries on with a collection already started, while waiting for a tic.
+*/
+void LUA_IdleGC(void);
+
+/**	\brief Called once a frame, clears the stack and collects garbage
+	if no tic has.
+*/
 void LUA_Step(void);
 void LUA_Archive(void);
 void LUA_UnArchive(void);
+/**	\brief Tells how many bytes the last LUA_Archive wrote, and how long it took in microseconds.
+*/
+void LUA_GetArchiveStats(size_t *bytes, UINT32 *micros);
 void Got_Luacmd(UINT8 **cp, INT32 playernum); // lua_consolelib.c
 void LUA_CVarChanged(const char *name); // lua_consolelib.c
-int Lua_optoption(lua_State *L, int narg,
-	const char *def, const char *const lst[]);
+int Lua_CreateFieldTable(lua_State *L, const char *const lst[]);
+int Lua_optoption(lua_State *L, int narg, int def, int list_ref);
+int Lua_checkoption(lua_State *L, int narg, int def, int list_ref);
 void LUAh_NetArchiveHook(lua_CFunction archFunc);
 
 // Console wrapper
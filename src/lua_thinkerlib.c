@@ -28,9 +28,22 @@ static const actionf_p1 iter_funcs[] = {
 	(actionf_p1)P_MobjThinker
 };
 
+// Range of thinker lists each option walks through
+static const thinklistnum_t iter_firstlist[] = {
+	0,
+	THINK_MOBJ
+};
+
+static const thinklistnum_t iter_lastlist[] = {
+	NUM_THINKERLISTS - 1,
+	THINK_MOBJ
+};
+
 struct iterationState {
 	actionf_p1 filter;
 	int next;
+	thinklistnum_t list, lastlist;
+	mobjtype_t type; // for thinkers.iterate("mobj", type)
 };
 
 static int iterationState_gc(lua_State *L)
@@ -58,7 +71,7 @@ static int lib_iterateThinkers(lua_State *L)
 	lua_settop(L, 2);
 
 	if (lua_isnil(L, 2))
-		th = &thinkercap;
+		th = &thlist[it->list];
 	else if (lua_isuserdata(L, 2))
 	{
 		if (lua_islightuserdata(L, 2))
@@ -88,31 +101,93 @@ static int lib_iterateThinkers(lua_State *L)
 	if (!next)
 		return luaL_error(L, "next thinker invalidated during iteration");
 
-	for (; next != &thinkercap; next = next->next)
-		if (!it->filter || next->function.acp1 == it->filter)
-		{
-			push_thinker(next);
-			if (next->next != &thinkercap)
+	for (;;)
+	{
+		for (; next != &thlist[it->list]; next = next->next)
+			if (!it->filter || next->function.acp1 == it->filter)
 			{
-				push_thinker(next->next);
-				it->next = luaL_ref(L, LUA_REGISTRYINDEX);
+				push_thinker(next);
+				if (next->next != &thlist[it->list])
+				{
+					push_thinker(next->next);
+					it->next = luaL_ref(L, LUA_REGISTRYINDEX);
+				}
+				return 1;
 			}
-			return 1;
+
+		// End of this list, carry on with the next one
+		if (it->list >= it->lastlist)
+			return 0;
+		it->list++;
+		next = thlist[it->list].next;
+	}
+}
+
+// Goes through the mobjs of one type, using their type's list
+static int lib_iterateMobjType(lua_State *L)
+{
+	mobj_t *mo, *next = NULL;
+	struct iterationState *it = luaL_checkudata(L, 1, META_ITERATIONSTATE);
+	lua_settop(L, 2);
+
+	if (lua_isnil(L, 2))
+		next = P_FindMobjFromType(it->type, NULL);
+	else
+	{
+		mo = *((mobj_t **)luaL_checkudata(L, 2, META_MOBJ));
+		if (mo)
+			next = P_FindMobjFromType(it->type, mo);
+		else // removed during the loop, so carry on from what came after it
+		{
+			if (it->next == LUA_REFNIL)
+				return 0;
+			lua_rawgeti(L, LUA_REGISTRYINDEX, it->next);
+			next = *(mobj_t **)lua_touserdata(L, -1);
+			if (!next)
+				return luaL_error(L, "next thinker invalidated during iteration");
 		}
-	return 0;
+	}
+
+	luaL_unref(L, LUA_REGISTRYINDEX, it->next);
+	it->next = LUA_REFNIL;
+
+	if (!next)
+		return 0;
+
+	LUA_PushUserdata(L, next, META_MOBJ);
+	mo = P_FindMobjFromType(it->type, next);
+	if (mo)
+	{
+		LUA_PushUserdata(L, mo, META_MOBJ);
+		it->next = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	return 1;
 }
 
 static int lib_startIterate(lua_State *L)
 {
 	struct iterationState *it;
+	int opt;
+	lua_Integer type = NUMMOBJTYPES;
+
+	opt = luaL_checkoption(L, 1, "mobj", iter_opt);
+	if (!lua_isnoneornil(L, 2))
+	{
+		luaL_argcheck(L, iter_funcs[opt] == (actionf_p1)P_MobjThinker, 2, "only mobjs can be iterated by type");
+		type = luaL_checkinteger(L, 2);
+		luaL_argcheck(L, type >= 0 && type < NUMMOBJTYPES, 2, "mobj type out of range");
+	}
 
-	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_pushvalue(L, lua_upvalueindex(type < NUMMOBJTYPES ? 2 : 1));
 	it = lua_newuserdata(L, sizeof(struct iterationState));
 	luaL_getmetatable(L, META_ITERATIONSTATE);
 	lua_setmetatable(L, -2);
 
-	it->filter = iter_funcs[luaL_checkoption(L, 1, "mobj", iter_opt)];
+	it->filter = iter_funcs[opt];
 	it->next = LUA_REFNIL;
+	it->list = iter_firstlist[opt];
+	it->lastlist = iter_lastlist[opt];
+	it->type = (mobjtype_t)type;
 	return 2;
 }
 
@@ -127,7 +202,8 @@ int LUA_ThinkerLib(lua_State *L)
 
 	lua_createtable(L, 0, 1);
 		lua_pushcfunction(L, lib_iterateThinkers);
-		lua_pushcclosure(L, lib_startIterate, 1);
+		lua_pushcfunction(L, lib_iterateMobjType);
+		lua_pushcclosure(L, lib_startIterate, 2);
 		lua_setfield(L, -2, "iterate");
 	lua_setglobal(L, "thinkers");
 	return 0;
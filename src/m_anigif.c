@@ -18,6 +18,8 @@
 #include "z_zone.h"
 #include "v_video.h"
 #include "i_video.h"
+#include "i_system.h"
+#include "i_threads.h"
 
 // GIFs are always little-endian
 #include "byteptr.h"
@@ -32,7 +34,7 @@ static boolean gif_downscale = false; // like changing cvars mid output
 static FILE *gif_out = NULL;
 static INT32 gif_frames = 0;
 static UINT8 gif_writeover = 0;
-
+static INT32 gif_width, gif_height; // of the screen when recording started
 
 
 // OPTIMIZE gif output
@@ -48,13 +50,13 @@ static UINT8 gif_writeover = 0;
 static UINT8 GIF_optimizecmprow(const UINT8 *dst, const UINT8 *src, INT32 row,
 	INT32 *last, INT32 *left, INT32 *right)
 {
-	const UINT8 *dp = dst + (vid.width * row);
-	const UINT8 *sp = src + (vid.width * row);
+	const UINT8 *dp = dst + (gif_width * row);
+	const UINT8 *sp = src + (gif_width * row);
 	const UINT8 *dtmp, *stmp;
 	UINT8 doleft = 1, doright = 1;
 	INT32 i = 0;
 
-	if (!memcmp(sp, dp, vid.width))
+	if (!memcmp(sp, dp, gif_width))
 		return 0; // unchanged.
 
 	*last = row;
@@ -81,14 +83,14 @@ static UINT8 GIF_optimizecmprow(const UINT8 *dst, const UINT8 *src, INT32 row,
 	}
 
 	// right side
-	i = vid.width - 1;
-	if (*right == vid.width - 1) // edge reached
+	i = gif_width - 1;
+	if (*right == gif_width - 1) // edge reached
 		doright = 0;
 	else if (*right >= 0) // right set, non-end-of-width
 	{
 		dtmp = dp + *right + 1;
 		stmp = sp + *right + 1;
-		if (!memcmp(stmp, dtmp, vid.width - (*right + 1)))
+		if (!memcmp(stmp, dtmp, gif_width - (*right + 1)))
 			doright = 0; // right side not changed
 	}
 	while (doright)
@@ -118,7 +120,7 @@ static UINT8 GIF_optimizecmprow(const UINT8 *dst, const UINT8 *src, INT32 row,
 static void GIF_optimizeregion(const UINT8 *dst, const UINT8 *src,
 	INT32 *x, INT32 *y, INT32 *w, INT32 *h)
 {
-	INT32 st = 0, sb = vid.height - 1; // work from both directions
+	INT32 st = 0, sb = gif_height - 1; // work from both directions
 	INT32 firstchg_t = -1, firstchg_b = -1; // store first changed row.
 	INT32 lastchg_t = -1, lastchg_b = -1; // Store last row... just in case
 	INT32 lmpix = -1, rmpix = -1; // store left and rightmost change
@@ -129,7 +131,7 @@ static void GIF_optimizeregion(const UINT8 *dst, const UINT8 *src,
 		if (!stopt)
 		{
 			if (GIF_optimizecmprow(dst, src, st++, &lastchg_t, &lmpix, &rmpix)
-			 && lmpix == 0 && rmpix == vid.width - 1)
+			 && lmpix == 0 && rmpix == gif_width - 1)
 				stopt = 1;
 			if (firstchg_t < 0 && lastchg_t >= 0)
 				firstchg_t = lastchg_t;
@@ -137,7 +139,7 @@ static void GIF_optimizeregion(const UINT8 *dst, const UINT8 *src,
 		if (!stopb)
 		{
 			if (GIF_optimizecmprow(dst, src, sb--, &lastchg_b, &lmpix, &rmpix)
-			 && lmpix == 0 && rmpix == vid.width - 1)
+			 && lmpix == 0 && rmpix == gif_width - 1)
 				stopb = 1;
 			if (firstchg_b < 0 && lastchg_b >= 0)
 				firstchg_b = lastchg_b;
@@ -240,7 +242,9 @@ static void GIF_prepareLZW(void)
 	giflzw_nextCodeToAssign = GIFLZW_DICTSTART;
 
 	if (!giflzw_hashTable)
-		giflzw_hashTable = Z_Malloc(16384*sizeof(UINT32), PU_STATIC, NULL);
+		giflzw_hashTable = malloc(16384*sizeof(UINT32));
+	if (!giflzw_hashTable)
+		I_Error("GIF_prepareLZW: out of memory");
 	memset(giflzw_hashTable, 0, 16384*sizeof(UINT32));
 }
 
@@ -346,8 +350,8 @@ static void GIF_lzw(void)
 		}
 		if ((scrbuf_pos += scrbuf_downscaleamt) >= scrbuf_lineend)
 		{
-			scrbuf_lineend += (vid.width * scrbuf_downscaleamt);
-			scrbuf_linebegin += (vid.width * scrbuf_downscaleamt);
+			scrbuf_lineend += (gif_width * scrbuf_downscaleamt);
+			scrbuf_linebegin += (gif_width * scrbuf_downscaleamt);
 			scrbuf_pos = scrbuf_linebegin;
 		}
 		// Just a bit of overflow prevention
@@ -452,18 +456,28 @@ const UINT8 gifframe_gchead[4] = {0x21,0xF9,0x04,0x04}; // GCE, bytes, packed by
 static UINT8 *gifframe_data = NULL;
 static size_t gifframe_size = 8192;
 
+// The encoder's copies of the screen. A frame is held back until the
+// next one is captured, since its delay is the time between the two.
+static UINT8 *gif_lastscreen = NULL; // last frame written, to compare against
+static UINT8 *gif_heldscreen = NULL; // captured, but not written yet
+static tic_t gif_heldtic, gif_starttic;
+static boolean gif_haveheld = false;
+
 //
 // GIF_framewrite
-// writes a frame into the file.
+// writes the held frame into the file,
+// with a delay that lasts until nexttic.
 //
-static void GIF_framewrite(void)
+static void GIF_framewrite(tic_t nexttic)
 {
 	UINT8 *p;
-	UINT8 *movie_screen = screens[2];
+	UINT8 *movie_screen = gif_heldscreen;
 	INT32 blitx, blity, blitw, blith;
 
 	if (!gifframe_data)
-		gifframe_data = Z_Malloc(gifframe_size, PU_STATIC, NULL);
+		gifframe_data = malloc(gifframe_size);
+	if (!gifframe_data)
+		I_Error("GIF_framewrite: out of memory");
 	p = gifframe_data;
 
 	if (!gif_out)
@@ -471,29 +485,19 @@ static void GIF_framewrite(void)
 
 	// Compare image data (for optimizing GIF)
 	if (gif_optimize && gif_frames > 0)
-	{
-		// before blit movie_screen points to last frame, cur_screen points to this frame
-		UINT8 *cur_screen = screens[0];
-		GIF_optimizeregion(cur_screen, movie_screen, &blitx, &blity, &blitw, &blith);
-
-		// blit to temp screen
-		I_ReadScreen(movie_screen);
-	}
+		GIF_optimizeregion(gif_heldscreen, gif_lastscreen, &blitx, &blity, &blitw, &blith);
 	else
 	{
 		blitx = blity = 0;
-		blitw = vid.width;
-		blith = vid.height;
-
-		if (gif_frames == 0)
-			I_ReadScreen(movie_screen);
-		movie_screen = screens[0];
+		blitw = gif_width;
+		blith = gif_height;
 	}
 
 	// screen regions are handled in GIF_lzw
 	{
-		int d1 = (int)((100.0f/NEWTICRATE)*(gif_frames+1));
-		int d2 = (int)((100.0f/NEWTICRATE)*(gif_frames));
+		// measured from the start, so the rounding doesn't add up
+		int d1 = (int)((100.0f/NEWTICRATE)*(nexttic - gif_starttic));
+		int d2 = (int)((100.0f/NEWTICRATE)*(gif_heldtic - gif_starttic));
 		UINT16 delay = d1-d2;
 		INT32 startline;
 
@@ -519,19 +523,21 @@ static void GIF_framewrite(void)
 		WRITEUINT16(p, (UINT16)(blith / scrbuf_downscaleamt));
 		WRITEUINT8(p, 0); // no local table of colors
 
-		scrbuf_pos = movie_screen + blitx + (blity * vid.width);
-		scrbuf_writeend = scrbuf_pos + (blitw - 1) + ((blith - 1) * vid.width);
+		scrbuf_pos = movie_screen + blitx + (blity * gif_width);
+		scrbuf_writeend = scrbuf_pos + (blitw - 1) + ((blith - 1) * gif_width);
 
 		if (!gifbwr_buf)
-			gifbwr_buf = Z_Malloc(256, PU_STATIC, NULL);
+			gifbwr_buf = malloc(256);
+		if (!gifbwr_buf)
+			I_Error("GIF_framewrite: out of memory");
 		gifbwr_cur = gifbwr_buf;
 
 		GIF_prepareLZW();
 		giflzw_workingCode = UINT16_MAX;
 		WRITEUINT8(p, gifbwr_bits_min - 1);
 
-		startline = (scrbuf_pos - movie_screen) / vid.width;
-		scrbuf_linebegin = movie_screen + (startline * vid.width) + blitx;
+		startline = (scrbuf_pos - movie_screen) / gif_width;
+		scrbuf_linebegin = movie_screen + (startline * gif_width) + blitx;
 		scrbuf_lineend = scrbuf_linebegin + blitw;
 
 		//prewrite a table clear
@@ -545,7 +551,9 @@ static void GIF_framewrite(void)
 			if ((size_t)(p - gifframe_data) + gifbwr_bufsize + 1 >= gifframe_size)
 			{
 				INT32 temppos = p - gifframe_data;
-				gifframe_data = Z_Realloc(gifframe_data, (gifframe_size *= 2), PU_STATIC, NULL);
+				gifframe_data = realloc(gifframe_data, (gifframe_size *= 2));
+				if (!gifframe_data)
+					I_Error("GIF_framewrite: out of memory");
 				p = gifframe_data + temppos; // realloc moves gifframe_data, so p is now invalid
 			}
 
@@ -563,6 +571,162 @@ static void GIF_framewrite(void)
 	++gif_frames;
 }
 
+//
+// GIF_encodeframe
+// writes the held frame now that the next one is here,
+// then holds on to this one instead.
+//
+static void GIF_encodeframe(const UINT8 *screen, tic_t tic)
+{
+	UINT8 *swap;
+
+	if (gif_haveheld)
+		GIF_framewrite(tic);
+
+	swap = gif_lastscreen;
+	gif_lastscreen = gif_heldscreen;
+	gif_heldscreen = swap;
+
+	M_Memcpy(gif_heldscreen, screen, gif_width * gif_height);
+	gif_heldtic = tic;
+	gif_haveheld = true;
+}
+
+//
+// GIF_flushheld
+// writes the last frame, which nothing came after.
+//
+static void GIF_flushheld(void)
+{
+	if (gif_haveheld)
+		GIF_framewrite(gif_heldtic + 1);
+	gif_haveheld = false;
+}
+
+
+
+// Frame QUEUE
+// ---
+// Captured frames wait here to be encoded. With threads, the encoding
+// is done on a thread of its own, and the game only has to copy the
+// screen. Without them, each frame is encoded as soon as it's captured.
+#ifdef HAVE_THREADS
+#define GIFQUEUESIZE 8
+#else
+#define GIFQUEUESIZE 1
+#endif
+
+typedef struct
+{
+	UINT8 *screen;
+	tic_t tic;
+} gifcapture_t;
+
+static gifcapture_t gif_queue[GIFQUEUESIZE];
+
+#ifdef HAVE_THREADS
+static INT32 gif_queuehead = 0, gif_queuecount = 0;
+static boolean gif_closing = false;
+static boolean gif_encoderrunning = false;
+
+static I_mutex gif_mutex;
+static I_cond gif_workcond;
+static I_cond gif_donecond;
+
+static void GIF_EncoderThread(void *userdata)
+{
+	gifcapture_t *capture;
+
+	(void)userdata;
+
+	I_lock_mutex(&gif_mutex);
+	for (;;)
+	{
+		while (!gif_queuecount && !gif_closing)
+			I_hold_cond(&gif_workcond, gif_mutex);
+		if (!gif_queuecount) // closing, and nothing left to do
+			break;
+		capture = &gif_queue[gif_queuehead];
+
+		I_unlock_mutex(gif_mutex);
+		GIF_encodeframe(capture->screen, capture->tic);
+		I_lock_mutex(&gif_mutex);
+
+		gif_queuehead = (gif_queuehead + 1) % GIFQUEUESIZE;
+		gif_queuecount--;
+		I_wake_all_cond(&gif_donecond);
+	}
+
+	GIF_flushheld();
+	gif_encoderrunning = false;
+	I_wake_all_cond(&gif_donecond);
+	I_unlock_mutex(gif_mutex);
+}
+#endif
+
+//
+// GIF_freebuffers
+// frees everything used while recording.
+//
+static void GIF_freebuffers(void)
+{
+	INT32 i;
+
+	for (i = 0; i < GIFQUEUESIZE; i++)
+	{
+		free(gif_queue[i].screen);
+		gif_queue[i].screen = NULL;
+	}
+	free(gif_lastscreen);
+	free(gif_heldscreen);
+	gif_lastscreen = gif_heldscreen = NULL;
+
+	free(gifbwr_buf);
+	gifbwr_buf = gifbwr_cur = NULL;
+
+	free(gifframe_data);
+	gifframe_data = NULL;
+
+	free(giflzw_hashTable);
+	giflzw_hashTable = NULL;
+}
+
+//
+// GIF_finish
+// writes whatever is left, and closes the file.
+//
+static void GIF_finish(void)
+{
+#ifdef HAVE_THREADS
+	I_lock_mutex(&gif_mutex);
+	gif_closing = true;
+	I_wake_all_cond(&gif_workcond);
+	while (gif_encoderrunning)
+		I_hold_cond(&gif_donecond, gif_mutex);
+	gif_closing = false;
+	I_unlock_mutex(gif_mutex);
+#else
+	GIF_flushheld();
+#endif
+
+	// final terminator.
+	fwrite(";", 1, 1, gif_out);
+	fclose(gif_out);
+	gif_out = NULL;
+
+	GIF_freebuffers();
+}
+
+//
+// GIF_shutdown
+// finishes a GIF that's still being recorded on quit.
+//
+static void GIF_shutdown(void)
+{
+	if (gif_out)
+		GIF_finish();
+}
+
 
 
 // ========================
@@ -575,6 +739,10 @@ static void GIF_framewrite(void)
 //
 INT32 GIF_open(const char *filename)
 {
+	static boolean exitfunc = false;
+	size_t screensize = vid.width * vid.height;
+	INT32 i;
+
 #ifdef HWRENDER
 	if (rendermode != render_soft)
 	{
@@ -589,19 +757,81 @@ INT32 GIF_open(const char *filename)
 
 	gif_optimize = (!!cv_gif_optimize.value);
 	gif_downscale = (!!cv_gif_downscale.value);
+	gif_width = vid.width;
+	gif_height = vid.height;
+
+	for (i = 0; i < GIFQUEUESIZE; i++)
+		gif_queue[i].screen = malloc(screensize);
+	gif_lastscreen = malloc(screensize);
+	gif_heldscreen = malloc(screensize);
+	for (i = 0; i < GIFQUEUESIZE; i++)
+		if (!gif_queue[i].screen)
+			break;
+	if (i < GIFQUEUESIZE || !gif_lastscreen || !gif_heldscreen)
+	{
+		GIF_freebuffers();
+		fclose(gif_out);
+		gif_out = NULL;
+		CONS_Alert(CONS_ERROR, M_GetText("Not enough memory to record a GIF\n"));
+		return 0;
+	}
+
 	GIF_headwrite();
 	gif_frames = 0;
+	gif_haveheld = false;
+	gif_starttic = I_GetTime();
+
+	if (!exitfunc)
+	{
+		I_AddExitFunc(GIF_shutdown);
+		exitfunc = true;
+	}
+
+#ifdef HAVE_THREADS
+	gif_queuehead = gif_queuecount = 0;
+	gif_encoderrunning = true;
+	I_spawn_thread("gif-encode", GIF_EncoderThread, NULL);
+#endif
 	return 1;
 }
 
 //
 // GIF_frame
-// writes a frame into the output gif
+// captures a frame for the output gif
 //
 void GIF_frame(void)
 {
-	// there's not much actually needed here, is there.
-	GIF_framewrite();
+	gifcapture_t *capture;
+
+	if (!gif_out)
+		return;
+
+	// Not what the header says any more
+	if (vid.width != gif_width || vid.height != gif_height)
+		return;
+
+#ifdef HAVE_THREADS
+	// Wait for a free slot, if the encoder has fallen that far behind
+	I_lock_mutex(&gif_mutex);
+	while (gif_queuecount == GIFQUEUESIZE)
+		I_hold_cond(&gif_donecond, gif_mutex);
+	capture = &gif_queue[(gif_queuehead + gif_queuecount) % GIFQUEUESIZE];
+	I_unlock_mutex(gif_mutex);
+
+	// The encoder doesn't touch it until it's counted
+	I_ReadScreen(capture->screen);
+	capture->tic = I_GetTime();
+
+	I_lock_mutex(&gif_mutex);
+	gif_queuecount++;
+	I_wake_one_cond(&gif_workcond);
+	I_unlock_mutex(gif_mutex);
+#else
+	capture = &gif_queue[0];
+	I_ReadScreen(capture->screen);
+	capture->tic = I_GetTime();
+	GIF_encodeframe(capture->screen, capture->tic);
+#endif
 }
 
 //
@@ -613,22 +843,7 @@ INT32 GIF_close(void)
 	if (!gif_out)
 		return 0;
 
-	// final terminator.
-	fwrite(";", 1, 1, gif_out);
-	fclose(gif_out);
-	gif_out = NULL;
-
-	if (gifbwr_buf)
-		Z_Free(gifbwr_buf);
-	gifbwr_buf = gifbwr_cur = NULL;
-
-	if (gifframe_data)
-		Z_Free(gifframe_data);
-	gifframe_data = NULL;
-
-	if (giflzw_hashTable)
-		Z_Free(giflzw_hashTable);
-	giflzw_hashTable = NULL;
+	GIF_finish();
 
 	CONS_Printf(M_GetText("Animated gif closed; wrote %d frames\n"), gif_frames);
 	return 1;
@@ -0,0 +1,415 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_bench.c
+/// \brief Running a demo as fast as it goes, for the "benchdemo" command,
+///        and timing how it's drawn, for "benchrender"
+
+#include "doomdef.h"
+#include "d_main.h"
+#include "doomstat.h"
+#include "command.h"
+#include "console.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_bench.h"
+#include "screen.h"
+
+// If the game sits outside a level this long, it's waiting for a key
+#define MAXIDLETICS (60*TICRATE)
+
+typedef struct
+{
+	UINT32 depth; // so a section that runs itself isn't counted twice
+	UINT32 start;
+	UINT32 calls;
+	UINT64 total;
+} benchtimer_t;
+
+boolean benchmarking = false;
+
+static benchtimer_t timers[NUMBENCHSECTIONS];
+
+static const char *const sectionnames[NUMBENCHSECTIONS] = {
+	"thinkers",
+	"playerthink",
+	"collision",
+	"sight",
+	"hooks",
+	"specials"
+};
+
+void M_BenchEnter(benchsection_t section)
+{
+	benchtimer_t *t = &timers[section];
+
+	if (t->depth++ == 0)
+	{
+		t->start = I_GetTimeMicros();
+		t->calls++;
+	}
+}
+
+void M_BenchExit(benchsection_t section)
+{
+	benchtimer_t *t = &timers[section];
+
+	if (t->depth && --t->depth == 0)
+		t->total += I_GetTimeMicros() - t->start;
+}
+
+static void M_WriteJSONString(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fputc('\\', f);
+		if ((UINT8)*s >= ' ')
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+//
+// M_WriteBenchReport
+//
+// Writes the results as JSON, to a file or to standard output.
+//
+static void M_WriteBenchReport(FILE *f, const char *demo, UINT32 tics, UINT64 micros, UINT32 worst)
+{
+	const double seconds = (double)micros / 1000000.0;
+	size_t i;
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"demo\": ");
+	M_WriteJSONString(f, demo);
+	fprintf(f, ",\n\t\"version\": ");
+	M_WriteJSONString(f, VERSIONSTRING);
+	fprintf(f, ",\n");
+	fprintf(f, "\t\"tics\": %u,\n", tics);
+	fprintf(f, "\t\"seconds\": %.3f,\n", seconds);
+	fprintf(f, "\t\"tics_per_second\": %.1f,\n", seconds > 0.0 ? tics / seconds : 0.0);
+	fprintf(f, "\t\"avg_tic_us\": %.1f,\n", tics ? (double)micros / tics : 0.0);
+	fprintf(f, "\t\"worst_tic_us\": %u,\n", worst);
+	fprintf(f, "\t\"sections\": {\n");
+	for (i = 0; i < NUMBENCHSECTIONS; i++)
+	{
+		fprintf(f, "\t\t\"%s\": {\"calls\": %u, \"total_us\": %.0f, \"percent\": %.1f}%s\n",
+			sectionnames[i], timers[i].calls, (double)timers[i].total,
+			micros ? 100.0 * (double)timers[i].total / (double)micros : 0.0,
+			i + 1 < NUMBENCHSECTIONS ? "," : "");
+	}
+	fprintf(f, "\t}\n");
+	fprintf(f, "}\n");
+}
+
+//
+// M_BenchDemo
+//
+// Plays the demo through to the end, with nothing drawn.
+//
+static boolean M_BenchDemo(char *name, const char *outname)
+{
+	UINT32 tics = 0, idle = 0, worst = 0, start, ticstart, elapsed;
+	UINT64 micros;
+	FILE *f = stdout;
+
+	singledemo = false;
+	G_DoPlayDemo(name);
+	if (!demoplayback)
+		return false;
+
+	memset(timers, 0, sizeof timers);
+	benchmarking = true;
+	start = I_GetTimeMicros();
+
+	while (demoplayback && idle < MAXIDLETICS)
+	{
+		const boolean inlevel = (gamestate == GS_LEVEL);
+
+		ticstart = I_GetTimeMicros();
+		G_Ticker(true);
+		elapsed = I_GetTimeMicros() - ticstart;
+
+		if (inlevel)
+		{
+			tics++;
+			idle = 0;
+			if (elapsed > worst)
+				worst = elapsed;
+		}
+		else
+			idle++;
+	}
+
+	micros = I_GetTimeMicros() - start;
+	benchmarking = false;
+
+	if (demoplayback)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("The demo stopped advancing; benchmarking was cut short.\n"));
+		G_CheckDemoStatus();
+	}
+
+	if (outname)
+	{
+		f = fopen(outname, "w");
+		if (!f)
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("Couldn't open %s for writing\n"), outname);
+			return false;
+		}
+	}
+	M_WriteBenchReport(f, name, tics, micros, worst);
+	if (f != stdout)
+	{
+		fclose(f);
+		CONS_Printf(M_GetText("Wrote the benchmark of %u tics to %s\n"), tics, outname);
+	}
+	else
+		fflush(f);
+
+	return true;
+}
+
+void Command_Benchdemo_f(void)
+{
+	char name[256], outname[256];
+	const boolean fromcmdline = M_CheckParm("-benchdemo") != 0;
+	boolean ok;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf(M_GetText("benchdemo <demoname> [report.json]: run a demo as fast as possible and time it\n"));
+		return;
+	}
+
+	if (netgame)
+	{
+		CONS_Printf(M_GetText("You can't play a demo while in a netgame.\n"));
+		return;
+	}
+
+	if (demoplayback)
+		G_StopDemo();
+
+	// Internal if no extension, external if one exists
+	strlcpy(name, COM_Argv(1), sizeof name);
+	if (FIL_CheckExtension(name))
+		strlcpy(name, va("%s"PATHSEP"%s", srb2home, COM_Argv(1)), sizeof name);
+
+	// From the command line, the report goes where it was asked to
+	if (COM_Argc() > 2 && fromcmdline)
+		strlcpy(outname, COM_Argv(2), sizeof outname);
+	else if (COM_Argc() > 2)
+		strlcpy(outname, va("%s"PATHSEP"%s", srb2home, COM_Argv(2)), sizeof outname);
+
+	ok = M_BenchDemo(name, COM_Argc() > 2 ? outname : NULL);
+
+	if (fromcmdline)
+	{
+		if (!ok)
+			I_Error("Couldn't benchmark demo %s\n", name);
+		I_Quit();
+	}
+}
+
+// ==========================================================================
+//                            RENDER BENCHMARK
+// ==========================================================================
+
+typedef struct
+{
+	UINT32 total;
+	UINT32 stages[NUMBENCHSTAGES];
+} benchframe_t;
+
+boolean benchrendering = false;
+
+static benchframe_t *benchframes = NULL;
+static size_t numbenchframes = 0, maxbenchframes = 0;
+
+static benchframe_t curframe;
+static boolean inframe = false;
+static benchstage_t curstage;
+static UINT32 framestart, stagestart;
+
+static char benchrenderout[256];
+
+static const char *const stagenames[NUMBENCHSTAGES] = {
+	"other",
+	"sky",
+	"bsp",
+	"segs",
+	"planes",
+	"masked",
+	"translucent",
+	"drawqueue",
+	"hud",
+	"present"
+};
+
+void M_BenchFrameStart(void)
+{
+	// One left unfinished, by a wipe, is dropped
+	memset(&curframe, 0, sizeof curframe);
+	inframe = true;
+	curstage = BR_OTHER;
+	framestart = stagestart = I_GetTimeMicros();
+}
+
+benchstage_t M_BenchStage(benchstage_t stage)
+{
+	const benchstage_t last = curstage;
+	UINT32 now;
+
+	if (!inframe)
+		return stage;
+
+	now = I_GetTimeMicros();
+	curframe.stages[last] += now - stagestart;
+	stagestart = now;
+	curstage = stage;
+	return last;
+}
+
+void M_BenchFrameEnd(void)
+{
+	if (!inframe)
+		return;
+
+	M_BenchStage(curstage);
+	curframe.total = stagestart - framestart;
+	inframe = false;
+
+	if (numbenchframes == maxbenchframes)
+	{
+		maxbenchframes = maxbenchframes ? maxbenchframes*2 : 1024;
+		benchframes = realloc(benchframes, maxbenchframes * sizeof (*benchframes));
+		if (!benchframes)
+			I_Error("M_BenchFrameEnd: out of memory");
+	}
+	benchframes[numbenchframes++] = curframe;
+}
+
+static int M_CompareMicros(const void *a, const void *b)
+{
+	const UINT32 x = *(const UINT32 *)a, y = *(const UINT32 *)b;
+	return (x > y) - (x < y);
+}
+
+//
+// M_WriteBenchRenderReport
+//
+// Writes a row for every stage, and one for the whole frame, as CSV.
+//
+static void M_WriteBenchRenderReport(FILE *f)
+{
+	const char *renderer = (rendermode == render_soft) ? "software" : "opengl";
+	const size_t n = numbenchframes;
+	UINT32 *sorted = malloc((n ? n : 1) * sizeof (*sorted));
+	UINT64 frametotal = 0, sum;
+	size_t i, j;
+
+	if (!sorted)
+		I_Error("M_WriteBenchRenderReport: out of memory");
+
+	for (j = 0; j < n; j++)
+		frametotal += benchframes[j].total;
+
+	fprintf(f, "renderer,width,height,stage,frames,avg_us,p50_us,p95_us,p99_us,max_us,percent\n");
+	for (i = 0; i <= NUMBENCHSTAGES; i++)
+	{
+		sum = 0;
+		for (j = 0; j < n; j++)
+		{
+			sorted[j] = (i < NUMBENCHSTAGES) ? benchframes[j].stages[i] : benchframes[j].total;
+			sum += sorted[j];
+		}
+		qsort(sorted, n, sizeof (*sorted), M_CompareMicros);
+
+		if (n)
+			fprintf(f, "%s,%d,%d,%s,%s,%.1f,%u,%u,%u,%u,%.1f\n", renderer, vid.width, vid.height,
+				i < NUMBENCHSTAGES ? stagenames[i] : "frame", sizeu1(n), (double)sum / n,
+				sorted[(n-1)*50/100], sorted[(n-1)*95/100], sorted[(n-1)*99/100], sorted[n-1],
+				frametotal ? 100.0 * (double)sum / (double)frametotal : 0.0);
+		else
+			fprintf(f, "%s,%d,%d,%s,0,0,0,0,0,0,0\n", renderer, vid.width, vid.height,
+				i < NUMBENCHSTAGES ? stagenames[i] : "frame");
+	}
+
+	free(sorted);
+}
+
+void M_FinishBenchRender(void)
+{
+	const boolean fromcmdline = M_CheckParm("-benchrender") != 0;
+	FILE *f;
+
+	benchrendering = false;
+	inframe = false;
+
+	f = fopen(benchrenderout, "w");
+	if (!f)
+	{
+		if (fromcmdline)
+			I_Error("Couldn't open %s for writing\n", benchrenderout);
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't open %s for writing\n"), benchrenderout);
+		return;
+	}
+	M_WriteBenchRenderReport(f);
+	fclose(f);
+	CONS_Printf(M_GetText("Wrote the timings of %s frames to %s\n"), sizeu1(numbenchframes), benchrenderout);
+
+	if (fromcmdline)
+		I_Quit();
+}
+
+void Command_Benchrender_f(void)
+{
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf(M_GetText("benchrender <demoname> [report.csv]: time how every frame of a demo is drawn\n"));
+		return;
+	}
+
+	if (netgame)
+	{
+		CONS_Printf(M_GetText("You can't play a demo while in a netgame.\n"));
+		return;
+	}
+
+	if (dedicated || rendermode == render_none)
+	{
+		CONS_Printf(M_GetText("There's nothing to render with.\n"));
+		return;
+	}
+
+	if (demoplayback)
+		G_StopDemo();
+	if (metalplayback)
+		G_StopMetalDemo();
+
+	// From the command line, the report goes where it was asked to
+	if (COM_Argc() > 2 && M_CheckParm("-benchrender"))
+		strlcpy(benchrenderout, COM_Argv(2), sizeof benchrenderout);
+	else
+		strlcpy(benchrenderout, va("%s"PATHSEP"%s", srb2home, COM_Argc() > 2 ? COM_Argv(2) : "benchrender.csv"), sizeof benchrenderout);
+
+	numbenchframes = 0;
+	inframe = false;
+	benchrendering = true;
+
+	// dont add .lmp so internal game demos can be played
+	CONS_Printf(M_GetText("Benchmarking the rendering of demo '%s'.\n"), COM_Argv(1));
+	G_TimeDemo(COM_Argv(1));
+}
@@ -0,0 +1,93 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_bench.h
+/// \brief Running a demo as fast as it goes, for the "benchdemo" command
+///
+///        Nothing is drawn: the demo's tics go straight through G_Ticker,
+///        and the time spent in a few parts of the game is added up as it
+///        goes. Times are inclusive, so collision run by a thinker counts
+///        for both. With -benchdemo on the command line, the game starts
+///        headless like a dedicated server, benchmarks the demo, writes
+///        the report and quits.
+///
+///        "benchrender" is the other way around: the demo is timed like
+///        timedemo, one frame per tic, but only the drawing is timed,
+///        split into the stages of a frame. The tics in between run
+///        untimed, so every frame sees the same view of the same level
+///        however fast it's drawn, and two runs with different settings
+///        can be compared frame for frame.
+
+#ifndef __M_BENCH__
+#define __M_BENCH__
+
+#include "doomtype.h"
+
+typedef enum
+{
+	BENCH_THINKERS,    // P_RunThinkers
+	BENCH_PLAYERTHINK, // P_PlayerThink
+	BENCH_COLLISION,   // P_CheckPosition and P_TryMove
+	BENCH_SIGHT,       // P_CheckSight
+	BENCH_HOOKS,       // Lua hooks
+	BENCH_SPECIALS,    // sector specials and linedef executors
+	NUMBENCHSECTIONS
+} benchsection_t;
+
+// Check this before calling M_BenchEnter or M_BenchExit.
+extern boolean benchmarking;
+
+void M_BenchEnter(benchsection_t section);
+void M_BenchExit(benchsection_t section);
+
+#define BENCH_ENTER(section) do { if (benchmarking) M_BenchEnter(section); } while (0)
+#define BENCH_EXIT(section) do { if (benchmarking) M_BenchExit(section); } while (0)
+
+void Command_Benchdemo_f(void);
+
+typedef enum
+{
+	BR_OTHER,       // frame setup, before the first stage
+	BR_SKY,         // the skybox view
+	BR_BSP,         // walking the BSP; the walls too in OpenGL
+	BR_SEGS,        // software walls, which are set up while walking the BSP
+	BR_PLANES,
+	BR_MASKED,      // sprites, masked midtextures and FOFs
+	BR_TRANSLUCENT, // OpenGL's sorted translucent walls and planes
+	BR_DRAWQUEUE,   // waiting for the software drawer threads
+	BR_HUD,         // postprocessing, status bar, HUD, console and menu
+	BR_PRESENT,     // I_FinishUpdate, which waits for the card in OpenGL
+	NUMBENCHSTAGES
+} benchstage_t;
+
+// Check this before calling any of the frame functions below.
+extern boolean benchrendering;
+
+/**	\brief Starts timing a frame, drawn in a level, in stage BR_OTHER.
+*/
+void M_BenchFrameStart(void);
+
+/**	\brief Ends the current stage of the frame and starts another.
+	\param	stage	what's drawn from now on
+	\return	the stage that just ended, so a nested one can go back to it
+*/
+benchstage_t M_BenchStage(benchstage_t stage);
+
+/**	\brief Ends the frame once it's been presented.
+*/
+void M_BenchFrameEnd(void);
+
+/**	\brief Writes the report of a benchrender run, called when its demo ends.
+*/
+void M_FinishBenchRender(void);
+
+#define BENCH_STAGE(stage) do { if (benchrendering) M_BenchStage(stage); } while (0)
+
+void Command_Benchrender_f(void);
+
+#endif // __M_BENCH__
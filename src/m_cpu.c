@@ -0,0 +1,166 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_cpu.c
+/// \brief What the CPU can do, and which kernels were picked for it
+
+#include "doomdef.h"
+#include "command.h"
+#include "console.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_cpu.h"
+#include "m_fixed.h"
+#include "screen.h" // the R_ CPUID flags
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+#define CPUX86
+#include <cpuid.h>
+#elif defined (_MSC_VER) && (defined (_M_IX86) || defined (_M_X64))
+#define CPUX86
+#include <intrin.h>
+#endif
+#if defined (__linux__) && defined (__arm__) && !defined (__ARM_NEON) && !defined (__ARM_NEON__)
+#define CPUAUXV
+#include <sys/auxv.h>
+#define CPUHWCAP_NEON (1<<12)
+#endif
+
+#define MAXKERNELFAMILIES 16
+
+cpufeatures_t cpufeatures;
+
+static struct
+{
+	const char *family;
+	const char *path;
+} kernels[MAXKERNELFAMILIES];
+static size_t numkernels = 0;
+
+#ifdef CPUX86
+static void M_CPUID(UINT32 leaf, UINT32 *regs)
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, (int)leaf, 0);
+	regs[0] = r[0]; regs[1] = r[1]; regs[2] = r[2]; regs[3] = r[3];
+#else
+	if (!__get_cpuid_count(leaf, 0, &regs[0], &regs[1], &regs[2], &regs[3]))
+		regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+// AVX registers are only usable if the OS saves them
+static boolean M_OSSavesYMM(void)
+{
+	UINT32 lo;
+#ifdef _MSC_VER
+	lo = (UINT32)_xgetbv(0);
+#else
+	UINT32 hi;
+	__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	(void)hi;
+#endif
+	return (lo & 6) == 6;
+}
+
+static void M_DetectX86(void)
+{
+	UINT32 regs[4], maxleaf;
+
+	M_CPUID(0, regs);
+	maxleaf = regs[0];
+	if (maxleaf < 1)
+		return;
+
+	M_CPUID(1, regs);
+	cpufeatures.sse2 = cpufeatures.sse2 || (regs[3] & (1<<26));
+	cpufeatures.sse41 = !!(regs[2] & (1<<19));
+	if (maxleaf >= 7 && (regs[2] & (1<<27)) && (regs[2] & (1<<28)) && M_OSSavesYMM())
+	{
+		M_CPUID(7, regs);
+		cpufeatures.avx2 = !!(regs[1] & (1<<5));
+	}
+}
+#endif
+
+void M_DetectCPUFeatures(void)
+{
+	memset(&cpufeatures, 0, sizeof cpufeatures);
+
+	cpufeatures.mmx = R_MMX;
+	cpufeatures.mmxext = R_MMXExt;
+	cpufeatures.amd3dnow = R_3DNow;
+	cpufeatures.sse2 = R_SSE2;
+#if defined (__x86_64__) || defined (_M_X64)
+	cpufeatures.sse2 = true; // always there
+#endif
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+	cpufeatures.neon = true; // built for it
+#elif defined (CPUAUXV)
+	cpufeatures.neon = !!(getauxval(AT_HWCAP) & CPUHWCAP_NEON);
+#endif
+
+	if (M_CheckParm("-NOCPUID"))
+		return;
+#ifdef CPUX86
+	M_DetectX86();
+#endif
+}
+
+void M_SetKernelPath(const char *family, const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < numkernels; i++)
+		if (!strcmp(kernels[i].family, family))
+			break;
+	if (i == numkernels)
+	{
+		if (numkernels == MAXKERNELFAMILIES)
+			return;
+		numkernels++;
+	}
+	kernels[i].family = family;
+	kernels[i].path = path;
+}
+
+void Command_CPUInfo_f(void)
+{
+	size_t i;
+
+	CONS_Printf(M_GetText("CPU features:%s%s%s%s%s%s%s\n"),
+		cpufeatures.mmx ? " MMX" : "",
+		cpufeatures.mmxext ? " MMXExt" : "",
+		cpufeatures.amd3dnow ? " 3DNow" : "",
+		cpufeatures.sse2 ? " SSE2" : "",
+		cpufeatures.sse41 ? " SSE4.1" : "",
+		cpufeatures.avx2 ? " AVX2" : "",
+		cpufeatures.neon ? " NEON" : "");
+#ifdef HAVE_THREADS
+	CONS_Printf(M_GetText("%d CPUs\n"), I_num_cpus());
+#endif
+
+	for (i = 0; i < numkernels; i++)
+		CONS_Printf("%-16s %s\n", kernels[i].family, kernels[i].path);
+
+	// Picked when the game was built, since they're inlined
+#if defined (FIXEDSSE41)
+	CONS_Printf("%-16s %s\n", "FixedMul4", "SSE4.1 (built in)");
+#elif defined (FIXEDSSE2)
+	CONS_Printf("%-16s %s\n", "FixedMul4", "SSE2 (built in)");
+#elif defined (FIXEDNEON)
+	CONS_Printf("%-16s %s\n", "FixedMul4", "NEON (built in)");
+#else
+	CONS_Printf("%-16s %s\n", "FixedMul4", "C");
+#endif
+}
@@ -0,0 +1,43 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_cpu.h
+/// \brief What the CPU can do, and which kernels were picked for it
+///
+///        The features are found once at startup, before anything picks
+///        a kernel. Each family of kernels that has more than one
+///        (M_Memcpy, the span drawers, the sound mixer) picks from them
+///        and says which it's using, for the cpuinfo command.
+
+#ifndef __M_CPU__
+#define __M_CPU__
+
+#include "doomtype.h"
+
+typedef struct
+{
+	boolean mmx, mmxext, amd3dnow; // only the old x86 memcpy uses these
+	boolean sse2, sse41, avx2;
+	boolean neon;
+} cpufeatures_t;
+
+extern cpufeatures_t cpufeatures;
+
+/**	\brief Finds what the CPU can do. Call once the R_ CPUID flags are set.
+*/
+void M_DetectCPUFeatures(void);
+
+/**	\brief Says which kernels a family is using.
+	\param	family	what they do, like "span drawers"
+	\param	path	which ones, like "SSE2" or "C"
+*/
+void M_SetKernelPath(const char *family, const char *path);
+
+void Command_CPUInfo_f(void);
+
+#endif // __M_CPU__
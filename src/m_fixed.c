@@ -21,25 +21,6 @@
 #include "doomdef.h"
 #include "m_fixed.h"
 
-#ifdef __USE_C_FIXEDMUL__
-
-/**	\brief	The FixedMul function
-
-	\param	a	fixed_t number
-	\param	b	fixed_t number
-
-	\return	a*b>>FRACBITS
-
-*/
-fixed_t FixedMul(fixed_t a, fixed_t b)
-{
-	// Need to cast to unsigned before shifting to avoid undefined behaviour
-	// for negative integers
-	return (fixed_t)(((UINT64)((INT64)a * b)) >> FRACBITS);
-}
-
-#endif //__USE_C_FIXEDMUL__
-
 #ifdef __USE_C_FIXEDDIV__
 /**	\brief	The FixedDiv2 function
 
@@ -777,22 +758,16 @@ void FM_CreateObjectMatrix(matrix_t *matrix, fixed_t x, fixed_t y, fixed_t z, fi
 //
 void FM_MultMatrixVec3(const matrix_t *matrix, const vector3_t *vec, vector3_t *out)
 {
-#define M(row,col)  matrix->m[col * 4 + row]
-	out->x = FixedMul(vec->x,M(0, 0))
-	       + FixedMul(vec->y,M(0, 1))
-	       + FixedMul(vec->z,M(0, 2))
-	       + M(0, 3);
-
-	out->y = FixedMul(vec->x,M(1, 0))
-	       + FixedMul(vec->y,M(1, 1))
-	       + FixedMul(vec->z,M(1, 2))
-	       + M(1, 3);
-
-	out->z = FixedMul(vec->x,M(2, 0))
-	       + FixedMul(vec->y,M(2, 1))
-	       + FixedMul(vec->z,M(2, 2))
-	       + M(2, 3);
-#undef M
+	// Each of the first three columns times a coordinate, plus the fourth
+	fixed_t cx[4], cy[4], cz[4];
+
+	FixedMul4By(cx, &matrix->m[0], vec->x);
+	FixedMul4By(cy, &matrix->m[4], vec->y);
+	FixedMul4By(cz, &matrix->m[8], vec->z);
+
+	out->x = cx[0] + cy[0] + cz[0] + matrix->m[12];
+	out->y = cx[1] + cy[1] + cz[1] + matrix->m[13];
+	out->z = cx[2] + cy[2] + cz[2] + matrix->m[14];
 }
 
 //
@@ -803,21 +778,27 @@ void FM_MultMatrixVec3(const matrix_t *matrix, const vector3_t *vec, vector3_t *
 void FM_MultMatrix(matrix_t *dest, const matrix_t *multme)
 {
 	matrix_t result;
-	UINT8 i, j;
+	fixed_t col[4];
+	UINT8 i, j, k;
 #define M(row,col)  multme->m[col * 4 + row]
-#define D(row,col)  dest->m[col * 4 + row]
 #define R(row,col)  result.m[col * 4 + row]
 
-	for (i = 0; i < 4; i++)
+	// Column j of the result is dest's columns, each times M(k, j)
+	for (j = 0; j < 4; j++)
 	{
-		for (j = 0; j < 4; j++)
-			R(i, j) = FixedMul(D(i, 0),M(0, j)) + FixedMul(D(i, 1),M(1, j)) + FixedMul(D(i, 2),M(2, j)) + FixedMul(D(i, 3),M(3, j));
+		for (i = 0; i < 4; i++)
+			R(i, j) = 0;
+		for (k = 0; k < 4; k++)
+		{
+			FixedMul4By(col, &dest->m[k * 4], M(k, j));
+			for (i = 0; i < 4; i++)
+				R(i, j) += col[i];
+		}
 	}
 
 	M_Memcpy(dest, &result, sizeof(matrix_t));
 
 #undef R
-#undef D
 #undef M
 }
 
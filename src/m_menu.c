@@ -4070,6 +4070,16 @@ static boolean M_AddonsRefresh(void)
 {
 	if ((refreshdirmenu & REFRESHDIR_NORMAL) && !preparefilemenu(true))
 	{
+		// A folder still being read when it was opened can turn out to be empty
+		if (dirmenuempty && menudepthleft != menudepth-1)
+		{
+			S_StartSound(NULL, sfx_skid);
+			M_StartMessage(va("%c%s\x80\nThis folder is empty.\n\n(Press a key)\n", ('\x80' + (highlightflags>>V_CHARCOLORSHIFT)), M_AddonsHeaderPath()),NULL,MM_NOTHING);
+			menupath[menupathindex[++menudepthleft]] = 0;
+
+			if (preparefilemenu(true))
+				return true;
+		}
 		UNEXIST;
 		return true;
 	}
@@ -4112,6 +4122,9 @@ static void M_DrawAddons(void)
 	const UINT8 *flashcol = NULL;
 	UINT8 hilicol;
 
+	if (pollfilemenu()) // the folder's still being read
+		refreshdirmenu |= REFRESHDIR_NORMAL;
+
 	// hack - need to refresh at end of frame to handle addfile...
 	if (refreshdirmenu & M_AddonsRefresh())
 	{
@@ -5161,7 +5174,7 @@ static void M_ReadSavegameInfo(UINT32 slot)
 
 	sprintf(savename, savegamename, slot);
 
-	length = FIL_ReadFile(savename, &savebuffer);
+	length = FIL_ReadPackedFile(savename, &savebuffer);
 	if (length == 0)
 	{
 		savegameinfo[slot].lives = -42;
@@ -5281,6 +5294,8 @@ static void M_ReadSaveStrings(void)
 	UINT32 i;
 	char name[256];
 
+	FIL_FinishWrites(); // a slot may have only just been saved
+
 	for (i = 0; i < MAXSAVEGAMES; i++)
 	{
 		snprintf(name, sizeof name, savegamename, i);
@@ -5310,6 +5325,7 @@ static void M_SaveGameDeleteResponse(INT32 ch)
 	// delete savegame
 	snprintf(name, sizeof name, savegamename, saveSlotSelected);
 	name[sizeof name - 1] = '\0';
+	FIL_FinishWrites();
 	remove(name);
 
 	// Refresh savegame menu info
@@ -38,7 +38,10 @@
 #include "d_main.h"
 #include "m_argv.h"
 #include "i_system.h"
+#include "i_threads.h"
+#include "m_cpu.h"
 #include "command.h" // cv_execversion
+#include "lzf.h" // packed files
 
 #include "m_anigif.h"
 
@@ -154,7 +157,7 @@ consvar_t cv_zlib_strategy = {"png_strategy", "Normal", CV_SAVE, zlib_strategy_t
 consvar_t cv_zlib_window_bits = {"png_window_size", "32k", CV_SAVE, zlib_window_bits_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
 consvar_t cv_zlib_memorya = {"apng_memory_level", "(Max Memory) 9", CV_SAVE, zlib_mem_level_t, NULL, 0, NULL, NULL, 0, 0, NULL};
-consvar_t cv_zlib_levela = {"apng_compress_level", "4", CV_SAVE, zlib_level_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_zlib_levela = {"apng_compress_level", "(Fastest) 1", CV_SAVE, zlib_level_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_zlib_strategya = {"apng_strategy", "RLE", CV_SAVE, zlib_strategy_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_zlib_window_bitsa = {"apng_window_size", "32k", CV_SAVE, zlib_window_bits_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_apng_delay = {"apng_speed", "1/2x", CV_SAVE, apng_delay_t, NULL, 0, NULL, NULL, 0, 0, NULL};
@@ -292,6 +295,251 @@ size_t FIL_ReadFileTag(char const *name, UINT8 **buffer, INT32 tag)
 	return length;
 }
 
+// ==========================================================================
+//                    PACKED FILES AND BACKGROUND WRITES
+// ==========================================================================
+
+// A packed file starts with this, then its unpacked length, then the lzf
+#define PACKEDMAGIC "SRB2LZF"
+#define PACKEDHEADERSIZE (sizeof PACKEDMAGIC + 4)
+
+// Files handed to FIL_WriteFileLater wait here. With threads, they're
+// written on a thread of their own, in the order they were handed over.
+#define MAXPENDINGWRITES 8
+
+typedef struct
+{
+	char name[256];
+	UINT8 *data; // malloc'd, freed once written
+	size_t length;
+	boolean pack;
+} pendingwrite_t;
+
+static pendingwrite_t pendingwrites[MAXPENDINGWRITES];
+static INT32 writehead = 0, writecount = 0;
+static char failedwrite[256] = ""; // for FIL_ReportWrites
+
+#ifdef HAVE_THREADS
+static boolean writerrunning = false;
+
+static I_mutex write_mutex;
+static I_cond write_workcond;
+static I_cond write_donecond;
+#endif
+
+//
+// FIL_WriteFileSafely
+// Writes the file under another name and renames it over the old one,
+// so a crash or a full disk never leaves half a file behind.
+//
+static boolean FIL_WriteFileSafely(const char *name, const void *source, size_t length)
+{
+	char temp[256+4];
+
+	snprintf(temp, sizeof temp, "%s.tmp", name);
+	if (FIL_WriteFile(temp, source, length))
+	{
+#ifdef _WIN32
+		remove(name); // rename won't replace it
+#endif
+		if (!rename(temp, name))
+			return true;
+	}
+	remove(temp);
+	return false;
+}
+
+//
+// FIL_DoWrite
+// Packs the file if it should be and it gets smaller, then writes it.
+//
+static boolean FIL_DoWrite(const pendingwrite_t *w)
+{
+	UINT8 *packed = NULL;
+	size_t packedlen = 0;
+	boolean ok;
+
+	if (w->pack && w->length > PACKEDHEADERSIZE && (packed = malloc(w->length)) != NULL)
+	{
+		packedlen = lzf_compress(w->data, w->length, packed + PACKEDHEADERSIZE, w->length - PACKEDHEADERSIZE - 1);
+		if (packedlen)
+		{
+			M_Memcpy(packed, PACKEDMAGIC, sizeof PACKEDMAGIC);
+			packed[sizeof PACKEDMAGIC] = (UINT8)w->length;
+			packed[sizeof PACKEDMAGIC + 1] = (UINT8)(w->length>>8);
+			packed[sizeof PACKEDMAGIC + 2] = (UINT8)(w->length>>16);
+			packed[sizeof PACKEDMAGIC + 3] = (UINT8)(w->length>>24);
+			packedlen += PACKEDHEADERSIZE;
+		}
+	}
+
+	if (packedlen)
+		ok = FIL_WriteFileSafely(w->name, packed, packedlen);
+	else
+		ok = FIL_WriteFileSafely(w->name, w->data, w->length);
+	free(packed);
+	return ok;
+}
+
+#ifdef HAVE_THREADS
+static void FIL_WriterThread(void *userdata)
+{
+	pendingwrite_t *w;
+	boolean ok;
+
+	(void)userdata;
+
+	I_lock_mutex(&write_mutex);
+	for (;;)
+	{
+		while (!writecount)
+			I_hold_cond(&write_workcond, write_mutex);
+		w = &pendingwrites[writehead];
+
+		I_unlock_mutex(write_mutex);
+		ok = FIL_DoWrite(w);
+		free(w->data);
+		I_lock_mutex(&write_mutex);
+
+		if (!ok)
+			strlcpy(failedwrite, w->name, sizeof failedwrite);
+		writehead = (writehead + 1) % MAXPENDINGWRITES;
+		writecount--;
+		I_wake_all_cond(&write_donecond);
+	}
+}
+#endif
+
+/** Writes out a file later, without holding the game up for it.
+  * The file is written under another name and renamed over the old one.
+  *
+  * \param name   Name of the file to write.
+  * \param source Memory location to write from, from malloc. It's freed
+  *               once the file is written, so don't touch it after this.
+  * \param length How many bytes to write.
+  * \param pack   Pack the file with lzf, if that makes it smaller.
+  *               FIL_ReadPackedFile reads it either way.
+  * \sa FIL_FinishWrites, FIL_ReportWrites
+  */
+void FIL_WriteFileLater(char const *name, void *source, size_t length, boolean pack)
+{
+	pendingwrite_t *w;
+
+#ifdef HAVE_THREADS
+	if (!writerrunning)
+	{
+		writerrunning = true;
+		I_AddExitFunc(FIL_FinishWrites);
+		I_spawn_thread("file-write", FIL_WriterThread, NULL);
+	}
+
+	I_lock_mutex(&write_mutex);
+	while (writecount == MAXPENDINGWRITES)
+		I_hold_cond(&write_donecond, write_mutex);
+	w = &pendingwrites[(writehead + writecount) % MAXPENDINGWRITES];
+	strlcpy(w->name, name, sizeof w->name);
+	w->data = source;
+	w->length = length;
+	w->pack = pack;
+	writecount++;
+	I_wake_one_cond(&write_workcond);
+	I_unlock_mutex(write_mutex);
+#else
+	w = &pendingwrites[0];
+	strlcpy(w->name, name, sizeof w->name);
+	w->data = source;
+	w->length = length;
+	w->pack = pack;
+	if (!FIL_DoWrite(w))
+		strlcpy(failedwrite, name, sizeof failedwrite);
+	free(source);
+#endif
+}
+
+/** Waits for every file handed to FIL_WriteFileLater to be written.
+  */
+void FIL_FinishWrites(void)
+{
+#ifdef HAVE_THREADS
+	if (!writerrunning)
+		return;
+
+	I_lock_mutex(&write_mutex);
+	while (writecount)
+		I_hold_cond(&write_donecond, write_mutex);
+	I_unlock_mutex(write_mutex);
+#endif
+}
+
+/** Says if a file handed to FIL_WriteFileLater couldn't be written.
+  */
+void FIL_ReportWrites(void)
+{
+	char name[sizeof failedwrite];
+
+#ifdef HAVE_THREADS
+	if (!writerrunning)
+		return;
+
+	I_lock_mutex(&write_mutex);
+	strlcpy(name, failedwrite, sizeof name);
+	failedwrite[0] = '\0';
+	I_unlock_mutex(write_mutex);
+#else
+	strlcpy(name, failedwrite, sizeof name);
+	failedwrite[0] = '\0';
+#endif
+
+	if (name[0])
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't write %s\n"), name);
+}
+
+/** Reads in a file that may have been packed by FIL_WriteFileLater,
+  * unpacked and with a zero byte at the end, like FIL_ReadFile.
+  * Waits for any writes still going first.
+  *
+  * \param name   Filename to read.
+  * \param buffer Set to a newly allocated PU_STATIC buffer.
+  * 
+eturn Unpacked length, or 0 on error.
+  */
+size_t FIL_ReadPackedFile(char const *name, UINT8 **buffer)
+{
+	UINT8 *buf, *raw;
+	size_t length, rawlen;
+
+	FIL_FinishWrites();
+
+	length = FIL_ReadFile(name, &buf);
+	if (length < PACKEDHEADERSIZE || memcmp(buf, PACKEDMAGIC, sizeof PACKEDMAGIC))
+	{
+		if (length)
+			*buffer = buf;
+		return length;
+	}
+
+	rawlen = buf[sizeof PACKEDMAGIC] | (buf[sizeof PACKEDMAGIC + 1]<<8)
+		| (buf[sizeof PACKEDMAGIC + 2]<<16) | ((size_t)buf[sizeof PACKEDMAGIC + 3]<<24);
+	if (!rawlen || rawlen/128 > length) // lzf can't pack that well, so it's damaged
+	{
+		Z_Free(buf);
+		return 0;
+	}
+
+	raw = Z_Malloc(rawlen + 1, PU_STATIC, NULL);
+	if (lzf_decompress(buf + PACKEDHEADERSIZE, length - PACKEDHEADERSIZE, raw, rawlen) != rawlen)
+	{
+		Z_Free(raw);
+		Z_Free(buf);
+		return 0;
+	}
+	Z_Free(buf);
+
+	raw[rawlen] = 0;
+	*buffer = raw;
+	return rawlen;
+}
+
 /** Check if the filename exists
   *
   * \param name   Filename to check.
@@ -530,6 +778,11 @@ void M_SaveConfig(const char *filename)
 	if (!gameconfig_loaded)
 		return;
 
+	// only the first of several -instances keeps the config,
+	// and load testing doesn't touch it at all
+	if (!filename && (serverinstance || loadtest))
+		return;
+
 	// can change the file name
 	if (filename)
 	{
@@ -907,13 +1160,49 @@ static inline boolean M_PNGLib(void)
 #endif
 }
 
-static void M_PNGFrame(png_structp png_ptr, png_infop png_info_ptr, png_bytep png_buf)
+// Captured frames wait here to be written. A frame is written once the
+// next one has been captured, since its delay lasts until then. With
+// threads, the writing is done on a thread of its own. If that falls a
+// whole queue behind, frames are dropped instead of holding the game up,
+// and the frame before a dropped one just stays up longer.
+#ifdef HAVE_THREADS
+#define APNGQUEUESIZE 8
+#else
+#define APNGQUEUESIZE 2
+#endif
+
+typedef struct
+{
+	UINT8 *screen; // 8-bit in software, 24-bit RGB in OpenGL
+	tic_t tic;
+} apngcapture_t;
+
+static apngcapture_t apng_queue[APNGQUEUESIZE];
+static INT32 apng_queuehead = 0, apng_queuecount = 0;
+static INT32 apng_width, apng_height; // of the screen when recording started
+static png_uint_16 apng_delay; // per tic
+static UINT32 apng_captured = 0, apng_dropped = 0;
+
+#ifdef HAVE_THREADS
+static boolean apng_closing = false;
+static boolean apng_writerrunning = false;
+
+static I_mutex apng_mutex;
+static I_cond apng_workcond;
+static I_cond apng_donecond;
+#endif
+
+static void M_PNGFrame(png_structp png_ptr, png_infop png_info_ptr, png_bytep png_buf, tic_t tics)
 {
 	png_uint_32 pitch = png_get_rowbytes(png_ptr, png_info_ptr);
-	PNG_CONST png_uint_32 height = vid.height;
+	PNG_CONST png_uint_32 height = apng_height;
 	png_bytepp row_pointers = png_malloc(png_ptr, height* sizeof (png_bytep));
 	png_uint_32 y;
-	png_uint_16 framedelay = (png_uint_16)cv_apng_delay.value;
+	png_uint_16 framedelay;
+
+	if (tics > UINT16_MAX / apng_delay)
+		tics = UINT16_MAX / apng_delay;
+	framedelay = (png_uint_16)(apng_delay * tics);
 
 	apng_frames++;
 
@@ -927,7 +1216,7 @@ static void M_PNGFrame(png_structp png_ptr, png_infop png_info_ptr, png_bytep pn
 	if (aPNG_write_frame_head)
 #endif
 		aPNG_write_frame_head(apng_ptr, apng_info_ptr, row_pointers,
-			vid.width, /* width */
+			apng_width, /* width */
 			height,    /* height */
 			0,         /* x offset */
 			0,         /* y offset */
@@ -956,8 +1245,190 @@ static void M_PNGfix_acTL(png_structp png_ptr, png_infop png_info_ptr,
 #endif
 }
 
+//
+// M_WriteAPNGFrame
+// Writes the frame at the head of the queue, which lasts until next.
+//
+static void M_WriteAPNGFrame(tic_t next)
+{
+	apngcapture_t *capture = &apng_queue[apng_queuehead];
+
+	M_PNGFrame(apng_ptr, apng_info_ptr, (png_bytep)capture->screen, next - capture->tic);
+}
+
+#ifdef HAVE_THREADS
+static void M_APNGWriterThread(void *userdata)
+{
+	tic_t next;
+
+	(void)userdata;
+
+	I_lock_mutex(&apng_mutex);
+	for (;;)
+	{
+		while (apng_queuecount < 2 && !apng_closing)
+			I_hold_cond(&apng_workcond, apng_mutex);
+		if (!apng_queuecount) // closing, and nothing left to do
+			break;
+
+		if (apng_queuecount > 1)
+			next = apng_queue[(apng_queuehead + 1) % APNGQUEUESIZE].tic;
+		else
+			next = apng_queue[apng_queuehead].tic + 1; // the last one
+
+		I_unlock_mutex(apng_mutex);
+		M_WriteAPNGFrame(next);
+		I_lock_mutex(&apng_mutex);
+
+		apng_queuehead = (apng_queuehead + 1) % APNGQUEUESIZE;
+		apng_queuecount--;
+		I_wake_all_cond(&apng_donecond);
+	}
+
+	apng_writerrunning = false;
+	I_wake_all_cond(&apng_donecond);
+	I_unlock_mutex(apng_mutex);
+}
+#endif
+
+//
+// M_NextAPNGSlot
+// The slot the next captured frame goes in,
+// or NULL if the queue is full and wait is false.
+//
+static apngcapture_t *M_NextAPNGSlot(boolean wait)
+{
+	apngcapture_t *capture;
+
+#ifdef HAVE_THREADS
+	I_lock_mutex(&apng_mutex);
+	while (apng_queuecount == APNGQUEUESIZE)
+	{
+		if (!wait)
+		{
+			I_unlock_mutex(apng_mutex);
+			return NULL;
+		}
+		I_hold_cond(&apng_donecond, apng_mutex);
+	}
+	capture = &apng_queue[(apng_queuehead + apng_queuecount) % APNGQUEUESIZE];
+	I_unlock_mutex(apng_mutex);
+#else
+	(void)wait;
+	capture = &apng_queue[(apng_queuehead + apng_queuecount) % APNGQUEUESIZE];
+#endif
+	return capture;
+}
+
+//
+// M_QueueAPNGFrame
+// Hands the frame just put in the next slot over to be written.
+//
+static void M_QueueAPNGFrame(void)
+{
+	apng_captured++;
+#ifdef HAVE_THREADS
+	I_lock_mutex(&apng_mutex);
+	apng_queuecount++;
+	I_wake_one_cond(&apng_workcond);
+	I_unlock_mutex(apng_mutex);
+#else
+	if (++apng_queuecount == APNGQUEUESIZE)
+	{
+		M_WriteAPNGFrame(apng_queue[(apng_queuehead + 1) % APNGQUEUESIZE].tic);
+		apng_queuehead = (apng_queuehead + 1) % APNGQUEUESIZE;
+		apng_queuecount--;
+	}
+#endif
+}
+
+//
+// M_CaptureAPNGFrame
+// Copies the screen into the queue, if there's room.
+//
+static void M_CaptureAPNGFrame(void)
+{
+	apngcapture_t *capture;
+	tic_t tic = I_GetTime();
+
+	// Not what the header says any more
+	if (vid.width != apng_width || vid.height != apng_height)
+		return;
+
+	capture = M_NextAPNGSlot(false);
+	if (!capture)
+	{
+		apng_dropped++;
+		return;
+	}
+
+#ifdef HWRENDER
+	if (rendermode != render_soft)
+	{
+		UINT32 tag;
+		if (!HWR_ReadScreenAsync(capture->screen, (UINT32)tic, &tag))
+			return; // the card's still reading it
+		capture->tic = (tic_t)tag;
+	}
+	else
+#endif
+	{
+		I_ReadScreen(capture->screen);
+		capture->tic = tic;
+	}
+	M_QueueAPNGFrame();
+}
+
+//
+// M_FinishAPNGFrames
+// Writes every frame still waiting.
+//
+static void M_FinishAPNGFrames(void)
+{
+	INT32 i;
+
+#ifdef HWRENDER
+	// The card may still be reading the last few screens
+	if (rendermode != render_soft)
+	{
+		for (;;)
+		{
+			apngcapture_t *capture = M_NextAPNGSlot(true);
+			UINT32 tag;
+
+			if (!HWR_CollectScreenAsync(capture->screen, &tag))
+				break;
+			capture->tic = (tic_t)tag;
+			M_QueueAPNGFrame();
+		}
+	}
+#endif
+
+#ifdef HAVE_THREADS
+	I_lock_mutex(&apng_mutex);
+	apng_closing = true;
+	I_wake_all_cond(&apng_workcond);
+	while (apng_writerrunning)
+		I_hold_cond(&apng_donecond, apng_mutex);
+	apng_closing = false;
+	I_unlock_mutex(apng_mutex);
+#else
+	if (apng_queuecount)
+		M_WriteAPNGFrame(apng_queue[apng_queuehead].tic + 1);
+#endif
+	apng_queuehead = apng_queuecount = 0;
+
+	for (i = 0; i < APNGQUEUESIZE; i++)
+	{
+		free(apng_queue[i].screen);
+		apng_queue[i].screen = NULL;
+	}
+}
+
 static boolean M_SetupaPNG(png_const_charp filename, png_bytep pal)
 {
+	INT32 i;
+
 	apng_FILE = fopen(filename,"wb+"); // + mode for reading
 	if (!apng_FILE)
 	{
@@ -1018,7 +1489,34 @@ static boolean M_SetupaPNG(png_const_charp filename, png_bytep pal)
 
 	apng_write_info(apng_ptr, apng_info_ptr, apng_ainfo_ptr);
 
-	apng_frames = 0;
+	apng_width = vid.width;
+	apng_height = vid.height;
+	apng_delay = (png_uint_16)cv_apng_delay.value;
+	for (i = 0; i < APNGQUEUESIZE; i++)
+	{
+		apng_queue[i].screen = malloc(apng_width * apng_height * (pal ? 1 : 3));
+		if (!apng_queue[i].screen)
+		{
+			CONS_Debug(DBG_RENDER, "M_StartMovie: Not enough memory for the frame queue\n");
+			while (i--)
+			{
+				free(apng_queue[i].screen);
+				apng_queue[i].screen = NULL;
+			}
+			png_destroy_write_struct(&apng_ptr, &apng_info_ptr);
+			fclose(apng_FILE);
+			apng_FILE = NULL;
+			remove(filename);
+			return false;
+		}
+	}
+
+	apng_frames = apng_captured = apng_dropped = 0;
+	apng_queuehead = apng_queuecount = 0;
+#ifdef HAVE_THREADS
+	apng_writerrunning = true;
+	I_spawn_thread("apng-write", M_APNGWriterThread, NULL);
+#endif
 
 	return true;
 }
@@ -1168,30 +1666,15 @@ void M_SaveFrame(void)
 		case MM_APNG:
 #ifdef USE_APNG
 			{
-				UINT8 *linear = NULL;
 				if (!apng_FILE) // should not happen!!
 				{
 					moviemode = MM_OFF;
 					return;
 				}
 
-				if (rendermode == render_soft)
-				{
-					// munge planar buffer to linear
-					linear = screens[2];
-					I_ReadScreen(linear);
-				}
-#ifdef HWRENDER
-				else
-					linear = HWR_GetScreenshot();
-#endif
-				M_PNGFrame(apng_ptr, apng_info_ptr, (png_bytep)linear);
-#ifdef HWRENDER
-				if (rendermode != render_soft && linear)
-					free(linear);
-#endif
+				M_CaptureAPNGFrame();
 
-				if (apng_frames == PNG_UINT_31_MAX)
+				if (apng_captured == PNG_UINT_31_MAX)
 				{
 					CONS_Alert(CONS_NOTICE, M_GetText("Max movie size reached\n"));
 					M_StopMovie();
@@ -1221,6 +1704,8 @@ void M_StopMovie(void)
 			if (!apng_FILE)
 				return;
 
+			M_FinishAPNGFrames();
+
 			if (apng_frames)
 			{
 				M_PNGfix_acTL(apng_ptr, apng_info_ptr, apng_ainfo_ptr);
@@ -1231,7 +1716,10 @@ void M_StopMovie(void)
 
 			fclose(apng_FILE);
 			apng_FILE = NULL;
-			CONS_Printf("aPNG closed; wrote %u frames\n", (UINT32)apng_frames);
+			if (apng_dropped)
+				CONS_Printf("aPNG closed; wrote %u frames, dropped %u\n", (UINT32)apng_frames, apng_dropped);
+			else
+				CONS_Printf("aPNG closed; wrote %u frames\n", (UINT32)apng_frames);
 			apng_frames = 0;
 			break;
 #else
@@ -1251,94 +1739,220 @@ void M_StopMovie(void)
 //                            SCREEN SHOTS
 // ==========================================================================
 #ifdef USE_PNG
-/** Writes a PNG file to disk.
-  *
-  * \param filename Filename to write to.
-  * \param data     The image data.
-  * \param width    Width of the picture.
-  * \param height   Height of the picture.
-  * \param palette  Palette of image data.
-  *  \note if palette is NULL, BGR888 format
-  */
-boolean M_SavePNG(const char *filename, void *data, int width, int height, const UINT8 *palette)
+// A PNG made by M_StartPNG, for M_FinishPNG to write
+typedef struct
 {
 	png_structp png_ptr;
 	png_infop png_info_ptr;
-	PNG_CONST png_byte *PLTE = (const png_byte *)palette;
-#ifdef PNG_SETJMP_SUPPORTED
-#ifdef USE_FAR_KEYWORD
-	jmp_buf jmpbuf;
-#endif
-#endif
 	png_FILE_p png_FILE;
+	png_uint_32 height;
+	UINT8 *data; // from malloc, when it's written later
+} pngwrite_t;
 
-	png_FILE = fopen(filename,"wb");
-	if (!png_FILE)
+//
+// M_StartPNG
+// Opens the file and sets up everything but the image. This reads the
+// game for the text chunks, so it's done straight away.
+//
+static boolean M_StartPNG(pngwrite_t *w, const char *filename, int width, int height, const UINT8 *palette)
+{
+	PNG_CONST png_byte *PLTE = (const png_byte *)palette;
+
+	w->png_FILE = fopen(filename,"wb");
+	if (!w->png_FILE)
 	{
 		CONS_Debug(DBG_RENDER, "M_SavePNG: Error on opening %s for write\n", filename);
 		return false;
 	}
 
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, PNG_error, PNG_warn);
-	if (!png_ptr)
+	w->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, PNG_error, PNG_warn);
+	if (!w->png_ptr)
 	{
 		CONS_Debug(DBG_RENDER, "M_SavePNG: Error on initialize libpng\n");
-		fclose(png_FILE);
+		fclose(w->png_FILE);
 		remove(filename);
 		return false;
 	}
 
-	png_info_ptr = png_create_info_struct(png_ptr);
-	if (!png_info_ptr)
+	w->png_info_ptr = png_create_info_struct(w->png_ptr);
+	if (!w->png_info_ptr)
 	{
 		CONS_Debug(DBG_RENDER, "M_SavePNG: Error on allocate for libpng\n");
-		png_destroy_write_struct(&png_ptr,  NULL);
-		fclose(png_FILE);
+		png_destroy_write_struct(&w->png_ptr,  NULL);
+		fclose(w->png_FILE);
 		remove(filename);
 		return false;
 	}
 
+	png_init_io(w->png_ptr, w->png_FILE);
+
+#ifdef PNG_SET_USER_LIMITS_SUPPORTED
+	png_set_user_limits(w->png_ptr, MAXVIDWIDTH, MAXVIDHEIGHT);
+#endif
+
+	//png_set_filter(w->png_ptr, 0, PNG_ALL_FILTERS);
+
+	png_set_compression_level(w->png_ptr, cv_zlib_level.value);
+	png_set_compression_mem_level(w->png_ptr, cv_zlib_memory.value);
+	png_set_compression_strategy(w->png_ptr, cv_zlib_strategy.value);
+	png_set_compression_window_bits(w->png_ptr, cv_zlib_window_bits.value);
+
+	M_PNGhdr(w->png_ptr, w->png_info_ptr, width, height, PLTE);
+
+	M_PNGText(w->png_ptr, w->png_info_ptr, false);
+
+	w->height = height;
+	return true;
+}
+
+//
+// M_FinishPNG
+// Compresses and writes the image. This is the slow part.
+//
+static boolean M_FinishPNG(pngwrite_t *w, void *data)
+{
+#ifdef PNG_SETJMP_SUPPORTED
+#ifdef USE_FAR_KEYWORD
+	jmp_buf jmpbuf;
+#endif
+#endif
+
 #ifdef USE_FAR_KEYWORD
 	if (setjmp(jmpbuf))
 #else
-	if (setjmp(png_jmpbuf(png_ptr)))
+	if (setjmp(png_jmpbuf(w->png_ptr)))
 #endif
 	{
-		//CONS_Debug(DBG_RENDER, "libpng write error on %s\n", filename);
-		png_destroy_write_struct(&png_ptr, &png_info_ptr);
-		fclose(png_FILE);
-		remove(filename);
+		//CONS_Debug(DBG_RENDER, "libpng write error\n");
+		png_destroy_write_struct(&w->png_ptr, &w->png_info_ptr);
+		fclose(w->png_FILE);
 		return false;
 	}
 #ifdef USE_FAR_KEYWORD
-	png_memcpy(png_jmpbuf(png_ptr),jmpbuf, sizeof (jmp_buf));
+	png_memcpy(png_jmpbuf(w->png_ptr),jmpbuf, sizeof (jmp_buf));
 #endif
-	png_init_io(png_ptr, png_FILE);
 
-#ifdef PNG_SET_USER_LIMITS_SUPPORTED
-	png_set_user_limits(png_ptr, MAXVIDWIDTH, MAXVIDHEIGHT);
-#endif
+	png_write_info(w->png_ptr, w->png_info_ptr);
 
-	//png_set_filter(png_ptr, 0, PNG_ALL_FILTERS);
+	M_PNGImage(w->png_ptr, w->png_info_ptr, w->height, data);
 
-	png_set_compression_level(png_ptr, cv_zlib_level.value);
-	png_set_compression_mem_level(png_ptr, cv_zlib_memory.value);
-	png_set_compression_strategy(png_ptr, cv_zlib_strategy.value);
-	png_set_compression_window_bits(png_ptr, cv_zlib_window_bits.value);
+	png_write_end(w->png_ptr, w->png_info_ptr);
+	png_destroy_write_struct(&w->png_ptr, &w->png_info_ptr);
 
-	M_PNGhdr(png_ptr, png_info_ptr, width, height, PLTE);
+	fclose(w->png_FILE);
+	return true;
+}
+
+/** Writes a PNG file to disk.
+  *
+  * \param filename Filename to write to.
+  * \param data     The image data.
+  * \param width    Width of the picture.
+  * \param height   Height of the picture.
+  * \param palette  Palette of image data.
+  *  \note if palette is NULL, BGR888 format
+  */
+boolean M_SavePNG(const char *filename, void *data, int width, int height, const UINT8 *palette)
+{
+	pngwrite_t w;
+
+	if (!M_StartPNG(&w, filename, width, height, palette))
+		return false;
+	if (M_FinishPNG(&w, data))
+		return true;
+	remove(filename);
+	return false;
+}
 
-	M_PNGText(png_ptr, png_info_ptr, false);
+// PNGs handed to M_SavePNGLater wait here. With threads, they're
+// compressed on a thread of their own, and the game only holds up
+// for one if the queue's full.
+#ifdef HAVE_THREADS
+#define MAXPENDINGPNGS 4
 
-	png_write_info(png_ptr, png_info_ptr);
+static pngwrite_t pendingpngs[MAXPENDINGPNGS];
+static INT32 pnghead = 0, pngcount = 0;
+static boolean pngwriterrunning = false;
 
-	M_PNGImage(png_ptr, png_info_ptr, height, data);
+static I_mutex png_mutex;
+static I_cond png_workcond;
+static I_cond png_donecond;
 
-	png_write_end(png_ptr, png_info_ptr);
-	png_destroy_write_struct(&png_ptr, &png_info_ptr);
+static void M_PNGWriterThread(void *userdata)
+{
+	pngwrite_t *w;
 
-	fclose(png_FILE);
+	(void)userdata;
+
+	I_lock_mutex(&png_mutex);
+	for (;;)
+	{
+		while (!pngcount)
+			I_hold_cond(&png_workcond, png_mutex);
+		w = &pendingpngs[pnghead];
+
+		I_unlock_mutex(png_mutex);
+		M_FinishPNG(w, w->data); // libpng's errors end the game anyway
+		free(w->data);
+		I_lock_mutex(&png_mutex);
+
+		pnghead = (pnghead + 1) % MAXPENDINGPNGS;
+		pngcount--;
+		I_wake_all_cond(&png_donecond);
+	}
+}
+
+static void M_FinishPNGWrites(void)
+{
+	I_lock_mutex(&png_mutex);
+	while (pngcount)
+		I_hold_cond(&png_donecond, png_mutex);
+	I_unlock_mutex(png_mutex);
+}
+#endif
+
+/** Writes a PNG file to disk, later if there are threads.
+  *
+  * \param filename Filename to write to. The file is made straight away.
+  * \param data     The image data, from malloc. It's freed once written,
+  *                 so don't touch it after this.
+  * \param width    Width of the picture.
+  * \param height   Height of the picture.
+  * \param palette  Palette of image data, or NULL for BGR888.
+  * \return False if the file couldn't be made.
+  */
+boolean M_SavePNGLater(const char *filename, void *data, int width, int height, const UINT8 *palette)
+{
+#ifdef HAVE_THREADS
+	pngwrite_t w;
+
+	if (!M_StartPNG(&w, filename, width, height, palette))
+	{
+		free(data);
+		return false;
+	}
+	w.data = data;
+
+	if (!pngwriterrunning)
+	{
+		pngwriterrunning = true;
+		I_AddExitFunc(M_FinishPNGWrites);
+		I_spawn_thread("png-write", M_PNGWriterThread, NULL);
+	}
+
+	I_lock_mutex(&png_mutex);
+	while (pngcount == MAXPENDINGPNGS)
+		I_hold_cond(&png_donecond, png_mutex);
+	pendingpngs[(pnghead + pngcount) % MAXPENDINGPNGS] = w;
+	pngcount++;
+	I_wake_one_cond(&png_workcond);
+	I_unlock_mutex(png_mutex);
 	return true;
+#else
+	boolean ret = M_SavePNG(filename, data, width, height, palette);
+	free(data);
+	return ret;
+#endif
 }
 #else
 /** PCX file structure.
@@ -1473,7 +2087,13 @@ void M_DoScreenShot(void)
 	if (rendermode == render_soft)
 	{
 		// munge planar buffer to linear
+#ifdef USE_PNG
+		linear = malloc(vid.width * vid.height); // M_SavePNGLater frees it
+		if (!linear)
+			goto failure;
+#else
 		linear = screens[2];
+#endif
 		I_ReadScreen(linear);
 	}
 
@@ -1489,13 +2109,17 @@ void M_DoScreenShot(void)
 	{
 		M_CreateScreenShotPalette();
 #ifdef USE_PNG
-		ret = M_SavePNG(va(pandf,pathname,freename), linear, vid.width, vid.height, screenshot_palette);
+		ret = M_SavePNGLater(va(pandf,pathname,freename), linear, vid.width, vid.height, screenshot_palette);
+		linear = NULL;
 #else
 		ret = WritePCXfile(va(pandf,pathname,freename), linear, vid.width, vid.height, screenshot_palette);
 #endif
 	}
 
 failure:
+#ifdef USE_PNG
+	free(linear); // unless it was handed over
+#endif
 	if (ret)
 	{
 		if (moviemode != MM_SCREENSHOT)
@@ -2356,18 +2980,33 @@ void *(*M_Memcpy)(void* dest, const void* src, size_t n) = cpu_cpy;
   */
 void M_SetupMemcpy(void)
 {
+	const char *path = "C";
+
 #if defined (__GNUC__) && defined (__i386__)
-	if (R_SSE2)
+	if (cpufeatures.sse2)
+	{
 		M_Memcpy = sse_cpy;
-	else if (R_MMXExt)
+		path = "SSE2";
+	}
+	else if (cpufeatures.mmxext)
+	{
 		M_Memcpy = mmx2_cpy;
-	else if (R_3DNow)
+		path = "MMXExt";
+	}
+	else if (cpufeatures.amd3dnow)
+	{
 		M_Memcpy = mmx1_cpy;
+		path = "3DNow";
+	}
 	else
 #endif
-	if (R_MMX)
+	if (cpufeatures.mmx)
+	{
 		M_Memcpy = mmx_cpy;
+		path = "MMX";
+	}
 #if 0
 	M_Memcpy = cpu_cpy;
 #endif
+	M_SetKernelPath("memcpy", path);
 }
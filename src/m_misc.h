@@ -53,6 +53,10 @@ INT32 M_MapNumber(char first, char second);
 boolean FIL_WriteFile(char const *name, const void *source, size_t length);
 size_t FIL_ReadFileTag(char const *name, UINT8 **buffer, INT32 tag);
 #define FIL_ReadFile(n, b) FIL_ReadFileTag(n, b, PU_STATIC)
+void FIL_WriteFileLater(char const *name, void *source, size_t length, boolean pack);
+void FIL_FinishWrites(void);
+void FIL_ReportWrites(void);
+size_t FIL_ReadPackedFile(char const *name, UINT8 **buffer);
 
 boolean FIL_FileExists(const char *name);
 boolean FIL_WriteFileOK(char const *name);
@@ -65,6 +69,7 @@ boolean FIL_CheckExtension(const char *in);
 
 #ifdef HAVE_PNG
 boolean M_SavePNG(const char *filename, void *data, int width, int height, const UINT8 *palette);
+boolean M_SavePNGLater(const char *filename, void *data, int width, int height, const UINT8 *palette);
 #endif
 
 extern boolean takescreenshot;
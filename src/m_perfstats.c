@@ -0,0 +1,681 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_perfstats.c
+/// \brief Tick profiler for the "tickprofile" console command, and the
+///        "perfstats" overlay
+
+#include "doomdef.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "command.h"
+#include "console.h"
+#include "d_clisrv.h"
+#include "d_net.h"
+#include "g_game.h"
+#include "p_local.h"
+#include "p_spec.h"
+#include "p_polyobj.h"
+#include "dehacked.h"
+#include "v_video.h"
+#include "z_zone.h"
+#include "m_perfstats.h"
+
+#ifdef HAVE_BLUA
+#include "lua_hook.h"
+#endif
+
+#define PS_RINGSIZE (60*TICRATE) // keep a minute of per-tic totals
+#define PS_FUNCHASHSIZE 512 // thinker and action functions, must be a power of two
+#define PS_DEFAULTTOP 20
+
+typedef struct
+{
+	actionf_p1 func; // key, for the thinker and action tables
+	UINT32 calls;
+	UINT32 tictime; // microseconds spent this tic
+	UINT32 peak; // worst single tic
+	UINT64 total;
+	UINT64 instructions; // for Lua hooks
+} psentry_t;
+
+typedef struct
+{
+	UINT32 time; // the whole of P_Ticker
+	UINT32 cat[NUMPSCATEGORIES];
+} pstic_t;
+
+boolean ps_tickprofiling = false;
+
+static psentry_t thinkerentries[PS_FUNCHASHSIZE];
+static psentry_t actionentries[PS_FUNCHASHSIZE];
+static psentry_t mobjentries[NUMMOBJTYPES];
+#ifdef HAVE_BLUA
+static psentry_t hookentries[hook_MAX];
+#endif
+static psentry_t gcentry;
+static psentry_t overflowentry; // if a hash table ever fills up
+
+static pstic_t ticring[PS_RINGSIZE];
+static size_t ringpos, ringcount;
+
+static pstic_t curtic;
+static UINT32 ticstart;
+static UINT32 profiledtics;
+
+static const char *const categorynames[NUMPSCATEGORIES] = {
+	"thinker",
+	"mobjtype",
+	"action",
+	"hook",
+	"gc"
+};
+
+// Names for the thinker functions the game knows about.
+#define THINKERNAME(fn) {(actionf_p1)fn, #fn}
+static const struct
+{
+	actionf_p1 func;
+	const char *name;
+} thinkernames[] = {
+	THINKERNAME(P_MobjThinker),
+	THINKERNAME(P_RemoveThinkerDelayed),
+	THINKERNAME(T_MoveCeiling),
+	THINKERNAME(T_CrushCeiling),
+	THINKERNAME(T_MoveFloor),
+	THINKERNAME(T_LightningFlash),
+	THINKERNAME(T_StrobeFlash),
+	THINKERNAME(T_Glow),
+	THINKERNAME(T_FireFlicker),
+	THINKERNAME(T_LightFade),
+	THINKERNAME(T_MoveElevator),
+	THINKERNAME(T_ContinuousFalling),
+	THINKERNAME(T_ThwompSector),
+	THINKERNAME(T_NoEnemiesSector),
+	THINKERNAME(T_EachTimeThinker),
+	THINKERNAME(T_CameraScanner),
+	THINKERNAME(T_RaiseSector),
+	THINKERNAME(T_BounceCheese),
+	THINKERNAME(T_StartCrumble),
+	THINKERNAME(T_MarioBlock),
+	THINKERNAME(T_SpikeSector),
+	THINKERNAME(T_FloatSector),
+	THINKERNAME(T_BridgeThinker),
+	THINKERNAME(T_MarioBlockChecker),
+	THINKERNAME(T_Scroll),
+	THINKERNAME(T_Friction),
+	THINKERNAME(T_Pusher),
+	THINKERNAME(T_LaserFlash),
+	THINKERNAME(T_Disappear),
+#ifdef POLYOBJECTS
+	THINKERNAME(T_PolyObjRotate),
+	THINKERNAME(T_PolyObjMove),
+	THINKERNAME(T_PolyObjWaypoint),
+	THINKERNAME(T_PolyDoorSlide),
+	THINKERNAME(T_PolyDoorSwing),
+	THINKERNAME(T_PolyObjFlag),
+	THINKERNAME(T_PolyObjDisplace),
+#endif
+	{NULL, NULL}
+};
+#undef THINKERNAME
+
+// Per-tic histogram buckets, in microseconds
+static const UINT32 histbuckets[] = {100, 250, 500, 1000, 2000, 4000, 8000, 16000, 1000000/TICRATE};
+#define NUMHISTBUCKETS (sizeof histbuckets / sizeof *histbuckets + 1)
+
+static psentry_t *PS_FuncEntry(psentry_t *table, actionf_p1 func)
+{
+	size_t i = ((size_t)func >> 2) & (PS_FUNCHASHSIZE-1);
+	size_t probes;
+
+	for (probes = 0; probes < PS_FUNCHASHSIZE; probes++)
+	{
+		if (table[i].func == func)
+			return &table[i];
+		if (!table[i].func)
+		{
+			table[i].func = func;
+			return &table[i];
+		}
+		i = (i + 1) & (PS_FUNCHASHSIZE-1);
+	}
+	return &overflowentry;
+}
+
+static inline void PS_Account(psentry_t *e, pscategory_t cat, UINT32 micros)
+{
+	e->calls++;
+	e->tictime += micros;
+	e->total += micros;
+	curtic.cat[cat] += micros;
+}
+
+void PS_RunThinker(thinker_t *thinker)
+{
+	actionf_p1 func = thinker->function.acp1;
+	psentry_t *mobjentry = NULL;
+	UINT32 start, elapsed;
+
+	// read the type now, the thinker may be freed by the time it returns
+	if (func == (actionf_p1)P_MobjThinker)
+		mobjentry = &mobjentries[((mobj_t *)thinker)->type];
+
+	start = I_GetTimeMicros();
+	func(thinker);
+	elapsed = I_GetTimeMicros() - start;
+
+	PS_Account(PS_FuncEntry(thinkerentries, func), PS_THINKER, elapsed);
+	if (mobjentry)
+		PS_Account(mobjentry, PS_MOBJTYPE, elapsed);
+}
+
+void PS_RunAction(actionf_p1 action, void *actor)
+{
+	UINT32 start = I_GetTimeMicros();
+	action(actor);
+	PS_Account(PS_FuncEntry(actionentries, action), PS_ACTION, I_GetTimeMicros() - start);
+}
+
+void PS_AddHookTime(INT32 hook, UINT32 micros)
+{
+#ifdef HAVE_BLUA
+	if (hook >= 0 && hook < hook_MAX)
+		PS_Account(&hookentries[hook], PS_HOOK, micros);
+#else
+	(void)hook;
+	(void)micros;
+#endif
+}
+
+void PS_AddHookInstructions(INT32 hook, UINT32 count)
+{
+#ifdef HAVE_BLUA
+	if (hook >= 0 && hook < hook_MAX)
+		hookentries[hook].instructions += count;
+#else
+	(void)hook;
+	(void)count;
+#endif
+}
+
+void PS_AddGCTime(UINT32 micros)
+{
+	PS_Account(&gcentry, PS_GC, micros);
+}
+
+void PS_StartTic(void)
+{
+	ticstart = I_GetTimeMicros();
+}
+
+static void PS_FinishEntries(psentry_t *table, size_t count)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+	{
+		if (table[i].tictime > table[i].peak)
+			table[i].peak = table[i].tictime;
+		table[i].tictime = 0;
+	}
+}
+
+void PS_EndTic(void)
+{
+	UINT32 micros = I_GetTimeMicros() - ticstart;
+
+	if (cv_perfstats.value)
+		ps_frametime[PSF_TIC] += micros;
+	if (!ps_tickprofiling)
+		return;
+
+	curtic.time = micros;
+
+	ticring[ringpos] = curtic;
+	ringpos = (ringpos + 1) % PS_RINGSIZE;
+	if (ringcount < PS_RINGSIZE)
+		ringcount++;
+	profiledtics++;
+
+	PS_FinishEntries(thinkerentries, PS_FUNCHASHSIZE);
+	PS_FinishEntries(actionentries, PS_FUNCHASHSIZE);
+	PS_FinishEntries(mobjentries, NUMMOBJTYPES);
+#ifdef HAVE_BLUA
+	PS_FinishEntries(hookentries, hook_MAX);
+#endif
+	PS_FinishEntries(&gcentry, 1);
+
+	memset(&curtic, 0, sizeof curtic);
+}
+
+static void PS_Reset(void)
+{
+	memset(thinkerentries, 0, sizeof thinkerentries);
+	memset(actionentries, 0, sizeof actionentries);
+	memset(mobjentries, 0, sizeof mobjentries);
+#ifdef HAVE_BLUA
+	memset(hookentries, 0, sizeof hookentries);
+#endif
+	memset(&gcentry, 0, sizeof gcentry);
+	memset(&overflowentry, 0, sizeof overflowentry);
+	memset(&curtic, 0, sizeof curtic);
+	ringpos = ringcount = 0;
+	profiledtics = 0;
+}
+
+//
+// Reporting
+//
+
+typedef struct
+{
+	const psentry_t *e;
+	pscategory_t cat;
+	INT32 num; // index, for the mobj type and hook tables
+} psrow_t;
+
+static const char *PS_RowName(const psrow_t *row)
+{
+	static char buf[32];
+	size_t i;
+
+	switch (row->cat)
+	{
+		case PS_THINKER:
+			for (i = 0; thinkernames[i].func; i++)
+				if (thinkernames[i].func == row->e->func)
+					return thinkernames[i].name;
+			break;
+		case PS_MOBJTYPE:
+			{
+				const char *name = DEH_MobjTypeName((mobjtype_t)row->num);
+				if (name)
+					return name;
+			}
+			break;
+		case PS_ACTION:
+#ifdef HAVE_BLUA
+			{
+				actionf_t act;
+				const char *name;
+				act.acp1 = row->e->func;
+				name = LUA_GetActionName(&act);
+				return name ? name : "(Lua action)";
+			}
+#else
+			break;
+#endif
+		case PS_HOOK:
+#ifdef HAVE_BLUA
+			return hookNames[row->num];
+#else
+			break;
+#endif
+		case PS_GC:
+			return "Lua GC";
+		default:
+			break;
+	}
+
+	if (row->e->func)
+		snprintf(buf, sizeof buf, "%p", (void *)row->e->func);
+	else
+		snprintf(buf, sizeof buf, "%d", row->num);
+	return buf;
+}
+
+static int PS_CompareRows(const void *p1, const void *p2)
+{
+	const psrow_t *r1 = p1, *r2 = p2;
+	if (r1->e->total != r2->e->total)
+		return r1->e->total < r2->e->total ? 1 : -1;
+	return 0;
+}
+
+static size_t PS_AddRows(psrow_t *rows, size_t n, const psentry_t *table, size_t count, pscategory_t cat)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+		if (table[i].calls)
+		{
+			rows[n].e = &table[i];
+			rows[n].cat = cat;
+			rows[n].num = (INT32)i;
+			n++;
+		}
+	return n;
+}
+
+// Collects every entry that has been called, heaviest first.
+// The caller frees the result.
+static psrow_t *PS_SortedRows(size_t *numrows)
+{
+	psrow_t *rows = malloc((PS_FUNCHASHSIZE*2 + NUMMOBJTYPES
+#ifdef HAVE_BLUA
+		+ hook_MAX
+#endif
+		+ 1) * sizeof *rows);
+	size_t n = 0;
+
+	if (!rows)
+		I_Error("PS_SortedRows: out of memory");
+
+	n = PS_AddRows(rows, n, thinkerentries, PS_FUNCHASHSIZE, PS_THINKER);
+	n = PS_AddRows(rows, n, mobjentries, NUMMOBJTYPES, PS_MOBJTYPE);
+	n = PS_AddRows(rows, n, actionentries, PS_FUNCHASHSIZE, PS_ACTION);
+#ifdef HAVE_BLUA
+	n = PS_AddRows(rows, n, hookentries, hook_MAX, PS_HOOK);
+#endif
+	n = PS_AddRows(rows, n, &gcentry, 1, PS_GC);
+
+	qsort(rows, n, sizeof *rows, PS_CompareRows);
+	*numrows = n;
+	return rows;
+}
+
+static void PS_PrintTop(size_t top)
+{
+	size_t numrows, i;
+	psrow_t *rows = PS_SortedRows(&numrows);
+
+	if (!numrows)
+	{
+		CONS_Printf(M_GetText("Nothing has been profiled yet.\n"));
+		free(rows);
+		return;
+	}
+
+	CONS_Printf(M_GetText("Top %s of %s entries over %u tics (inclusive times):\n"), sizeu1(min(top, numrows)), sizeu2(numrows), profiledtics);
+	CONS_Printf("%-8s %-24s %9s %10s %9s %9s %10s\n", "category", "name", "calls", "total ms", "us/call", "peak us", "instr/call");
+	for (i = 0; i < top && i < numrows; i++)
+	{
+		const psentry_t *e = rows[i].e;
+		CONS_Printf("%-8s %-24.24s %9u %10.2f %9.2f %9u",
+			categorynames[rows[i].cat], PS_RowName(&rows[i]), e->calls,
+			(double)e->total / 1000.0, (double)e->total / e->calls, e->peak);
+		if (rows[i].cat == PS_HOOK)
+			CONS_Printf(" %10.0f\n", (double)e->instructions / e->calls);
+		else
+			CONS_Printf(" %10s\n", "-");
+	}
+
+	free(rows);
+}
+
+static void PS_DumpCSV(const char *filename, size_t top)
+{
+	size_t numrows, i;
+	psrow_t *rows;
+	const char *path = va(pandf, srb2home, filename);
+	FILE *f = fopen(path, "w");
+
+	if (!f)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't open %s for writing\n"), path);
+		return;
+	}
+
+	rows = PS_SortedRows(&numrows);
+
+	fprintf(f, "category,name,calls,total_us,avg_us,peak_tic_us,avg_instructions\n");
+	for (i = 0; i < top && i < numrows; i++)
+	{
+		const psentry_t *e = rows[i].e;
+		fprintf(f, "%s,%s,%u,%.0f,%.2f,%u,%.0f\n",
+			categorynames[rows[i].cat], PS_RowName(&rows[i]), e->calls,
+			(double)e->total, (double)e->total / e->calls, e->peak,
+			(double)e->instructions / e->calls);
+	}
+
+	fclose(f);
+	free(rows);
+
+	CONS_Printf(M_GetText("Wrote %s rows over %u tics to %s\n"), sizeu1(min(top, numrows)), profiledtics, path);
+}
+
+static void PS_PrintHistogram(void)
+{
+	UINT32 counts[NUMHISTBUCKETS][NUMPSCATEGORIES+1];
+	size_t i, b, c;
+
+	if (!ringcount)
+	{
+		CONS_Printf(M_GetText("Nothing has been profiled yet.\n"));
+		return;
+	}
+
+	memset(counts, 0, sizeof counts);
+
+	for (i = 0; i < ringcount; i++)
+	{
+		const pstic_t *t = &ticring[i];
+		for (c = 0; c <= NUMPSCATEGORIES; c++)
+		{
+			UINT32 time = (c == NUMPSCATEGORIES) ? t->time : t->cat[c];
+			for (b = 0; b < NUMHISTBUCKETS-1; b++)
+				if (time < histbuckets[b])
+					break;
+			counts[b][c]++;
+		}
+	}
+
+	CONS_Printf(M_GetText("Time per tic over the last %s tics:\n"), sizeu1(ringcount));
+	CONS_Printf("%-10s %8s %8s %8s %8s %8s %8s\n", "", "thinker", "mobjtype", "action", "hook", "gc", "ticker");
+	for (b = 0; b < NUMHISTBUCKETS; b++)
+	{
+		if (b < NUMHISTBUCKETS-1)
+			CONS_Printf("< %5u us", histbuckets[b]);
+		else
+			CONS_Printf(">= 1 tic  ");
+		for (c = 0; c <= NUMPSCATEGORIES; c++)
+			CONS_Printf(" %8u", counts[b][c]);
+		CONS_Printf("\n");
+	}
+}
+
+void Command_TickProfile_f(void)
+{
+	const char *arg;
+	size_t top = PS_DEFAULTTOP;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf(M_GetText("tickprofile <start|stop|reset|hist|top [n]|dump <file> [n]>: Profile thinkers, actions, Lua hooks and Lua GC\n"));
+		CONS_Printf(M_GetText("Profiling is %s, %u tics recorded.\n"), ps_tickprofiling ? M_GetText("on") : M_GetText("off"), profiledtics);
+		return;
+	}
+
+	arg = COM_Argv(1);
+
+	if (!stricmp(arg, "start"))
+	{
+		if (!ps_tickprofiling)
+			memset(&curtic, 0, sizeof curtic);
+		ps_tickprofiling = true;
+		CONS_Printf(M_GetText("Tick profiling started.\n"));
+	}
+	else if (!stricmp(arg, "stop"))
+	{
+		ps_tickprofiling = false;
+		CONS_Printf(M_GetText("Tick profiling stopped after %u tics.\n"), profiledtics);
+	}
+	else if (!stricmp(arg, "reset"))
+		PS_Reset();
+	else if (!stricmp(arg, "hist"))
+		PS_PrintHistogram();
+	else if (!stricmp(arg, "top"))
+	{
+		if (COM_Argc() > 2)
+			top = atoi(COM_Argv(2));
+		PS_PrintTop(top);
+	}
+	else if (!stricmp(arg, "dump"))
+	{
+		if (COM_Argc() < 3)
+		{
+			CONS_Printf(M_GetText("tickprofile dump <file> [n]: Write the n heaviest entries to a CSV file\n"));
+			return;
+		}
+		if (COM_Argc() > 3)
+			top = atoi(COM_Argv(3));
+		else
+			top = (size_t)-1;
+		PS_DumpCSV(COM_Argv(2), top);
+	}
+	else
+		CONS_Printf(M_GetText("Unknown tickprofile command \"%s\".\n"), arg);
+}
+
+// -----------------------------------------------------------------
+// The perfstats overlay
+// -----------------------------------------------------------------
+
+#define PSF_FRAMES 64 // frames in the graph
+#define PSF_GRAPHX 4
+#define PSF_GRAPHY 4
+#define PSF_GRAPHHEIGHT 40
+#define PSF_GRAPHMICROS (2*1000000/TICRATE) // the top of the graph is two tics
+
+static void PS_PerfStats_OnChange(void);
+
+consvar_t cv_perfstats = {"perfstats", "Off", CV_CALL, CV_OnOff, PS_PerfStats_OnChange, 0, NULL, NULL, 0, 0, NULL};
+
+UINT32 ps_frametime[NUMPSFSECTIONS];
+
+static UINT32 framering[PSF_FRAMES][NUMPSFSECTIONS];
+static size_t framepos, framecount;
+
+static size_t heapused;
+static tic_t heaptic;
+static boolean heapsampled;
+
+static const struct
+{
+	const char *name;
+	UINT8 color;
+} psfsections[NUMPSFSECTIONS] = {
+	{"tic",         164}, // green
+	{"render",      228}, // blue
+	{"render (GL)", 210}, // cyan
+	{"present",     103}, // yellow
+	{"netupdate",    84}, // orange
+	{" lua hooks",  196}, // purple
+	{" lua gc",     146}  // pink
+};
+
+// Start the graph over, so it never shows a gap as if it were a frame
+static void PS_PerfStats_OnChange(void)
+{
+	memset(ps_frametime, 0, sizeof ps_frametime);
+	framepos = framecount = 0;
+	heapsampled = false;
+}
+
+void PS_EndFrame(void)
+{
+	M_Memcpy(framering[framepos], ps_frametime, sizeof ps_frametime);
+	framepos = (framepos + 1) % PSF_FRAMES;
+	if (framecount < PSF_FRAMES)
+		framecount++;
+	memset(ps_frametime, 0, sizeof ps_frametime);
+}
+
+static void PS_DrawMicros(INT32 x, INT32 y, INT32 flags, UINT32 micros)
+{
+	V_DrawThinString(x, y, flags, va("%3u.%ums", (micros + 50) / 1000, (micros + 50) / 100 % 10));
+}
+
+// Round trip and loss to the server, or to the worst connected node
+static void PS_DrawNetStats(INT32 y, INT32 flags)
+{
+	tic_t rtt = 0;
+	INT32 node;
+
+	if (server)
+	{
+		for (node = 1; node < MAXNETNODES; node++)
+			if (nodeingame[node] && Net_GetNodeRTT(node) > rtt)
+				rtt = Net_GetNodeRTT(node);
+	}
+	else
+		rtt = Net_GetNodeRTT(servernode);
+
+	Net_GetNetStat();
+	V_DrawThinString(PSF_GRAPHX, y, flags, va("%s %ums, loss %.2f%%, tics missed %.2f%%",
+		server ? "worst rtt" : "rtt", G_TicsToMilliseconds(rtt), lostpercent, gamelostpercent));
+}
+
+void PS_DrawPerfStats(void)
+{
+	const INT32 flags = V_MONOSPACE|V_ALLOWLOWERCASE|V_SNAPTOLEFT|V_SNAPTOTOP;
+	UINT32 sum[NUMPSFSECTIONS], peak[NUMPSFSECTIONS];
+	size_t f, i;
+	INT32 y;
+
+	if (!framecount)
+		return;
+
+	memset(sum, 0, sizeof sum);
+	memset(peak, 0, sizeof peak);
+
+	V_DrawFill(PSF_GRAPHX - 1, PSF_GRAPHY - 1, PSF_FRAMES*2 + 2, PSF_GRAPHHEIGHT + 2, 31|V_SNAPTOLEFT|V_SNAPTOTOP);
+	for (f = 0; f < framecount; f++)
+	{
+		const UINT32 *t = framering[(framepos + PSF_FRAMES - framecount + f) % PSF_FRAMES];
+		INT32 bottom = PSF_GRAPHY + PSF_GRAPHHEIGHT;
+
+		for (i = 0; i < NUMPSFSECTIONS; i++)
+		{
+			INT32 h;
+
+			sum[i] += t[i];
+			if (t[i] > peak[i])
+				peak[i] = t[i];
+
+			// Lua's time is already in the bars it ran in
+			if (i >= PSF_LUAHOOK)
+				continue;
+			h = (INT32)(min(t[i], PSF_GRAPHMICROS) * PSF_GRAPHHEIGHT / PSF_GRAPHMICROS);
+			h = min(h, bottom - PSF_GRAPHY);
+			if (h <= 0)
+				continue;
+			bottom -= h;
+			V_DrawFill(PSF_GRAPHX + (INT32)f*2, bottom, 2, h, psfsections[i].color|V_SNAPTOLEFT|V_SNAPTOTOP);
+		}
+	}
+
+	// A line at one tic: bars above it held up a frame
+	V_DrawFill(PSF_GRAPHX, PSF_GRAPHY + PSF_GRAPHHEIGHT/2, PSF_FRAMES*2, 1, 0|V_SNAPTOLEFT|V_SNAPTOTOP);
+
+	y = PSF_GRAPHY + PSF_GRAPHHEIGHT + 3;
+	for (i = 0; i < NUMPSFSECTIONS; i++)
+	{
+		// Only the renderer in use
+		if (!peak[i] && (i == PSF_SOFTRENDER || i == PSF_GLRENDER))
+			continue;
+		V_DrawFill(PSF_GRAPHX, y + 1, 5, 5, psfsections[i].color|V_SNAPTOLEFT|V_SNAPTOTOP);
+		V_DrawThinString(PSF_GRAPHX + 8, y, flags, psfsections[i].name);
+		PS_DrawMicros(PSF_GRAPHX + 64, y, flags, sum[i] / (UINT32)framecount);
+		V_DrawThinString(PSF_GRAPHX + 104, y, flags|V_GRAYMAP, "peak");
+		PS_DrawMicros(PSF_GRAPHX + 124, y, flags, peak[i]);
+		y += 8;
+	}
+
+	// Walking the zone's lists every frame would cost more than the rest
+	if (!heapsampled || I_GetTime() - heaptic >= TICRATE)
+	{
+		heapused = Z_TagsUsage(0, INT32_MAX);
+		heaptic = I_GetTime();
+		heapsampled = true;
+	}
+	V_DrawThinString(PSF_GRAPHX, y, flags, va("zone heap %s KB", sizeu1(heapused >> 10)));
+	y += 8;
+
+	if (netgame)
+		PS_DrawNetStats(y, flags);
+}
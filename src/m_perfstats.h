@@ -0,0 +1,95 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_perfstats.h
+/// \brief Tick profiler for the "tickprofile" console command, and the
+///        "perfstats" overlay
+///
+///        While profiling, every thinker, action and Lua hook call is
+///        timed and added up by thinker function, mobj type, action
+///        and hook type, along with Lua's garbage collection at the end
+///        of the tic. Times are inclusive: an action run from a mobj's
+///        thinker counts for both the action and the mobj.
+///
+///        The overlay is cheaper: it only adds up a few sections of
+///        each frame, and graphs the last few seconds of them.
+
+#ifndef __M_PERFSTATS__
+#define __M_PERFSTATS__
+
+#include "doomtype.h"
+#include "d_think.h"
+#include "command.h"
+
+typedef enum
+{
+	PS_THINKER,  // by thinker function, from P_RunThinkers
+	PS_MOBJTYPE, // by mobj type, for P_MobjThinker
+	PS_ACTION,   // by action function, from P_SetMobjState
+	PS_HOOK,     // by Lua hook type
+	PS_GC,       // Lua garbage collection, from LUA_TicGC
+	NUMPSCATEGORIES
+} pscategory_t;
+
+// Check this before calling any of the functions below.
+extern boolean ps_tickprofiling;
+
+void PS_StartTic(void);
+void PS_EndTic(void);
+
+/**	\brief Runs a thinker's function and times it.
+*/
+void PS_RunThinker(thinker_t *thinker);
+
+/**	\brief Runs an action on actor and times it.
+*/
+void PS_RunAction(actionf_p1 action, void *actor);
+
+/**	\brief Adds the time spent in one call of a Lua hook.
+*/
+void PS_AddHookTime(INT32 hook, UINT32 micros);
+
+/**	\brief Adds the instructions run in one call of a Lua hook.
+*/
+void PS_AddHookInstructions(INT32 hook, UINT32 count);
+
+/**	\brief Adds the time spent collecting Lua's garbage.
+*/
+void PS_AddGCTime(UINT32 micros);
+
+void Command_TickProfile_f(void);
+
+typedef enum
+{
+	PSF_TIC,        // P_Ticker, for every tic run since the last frame
+	PSF_SOFTRENDER, // drawing the views, in software
+	PSF_GLRENDER,   // or in OpenGL
+	PSF_PRESENT,    // I_FinishUpdate
+	PSF_NETUPDATE,
+	// Lua runs inside the sections above, so these are part of them
+	// (bar the GC done while waiting for a tic)
+	PSF_LUAHOOK,    // outermost hook calls only
+	PSF_LUAGC,
+	NUMPSFSECTIONS
+} psfsection_t;
+
+extern consvar_t cv_perfstats;
+
+// Microseconds spent in each section so far this frame, while
+// cv_perfstats is on
+extern UINT32 ps_frametime[NUMPSFSECTIONS];
+
+/**	\brief Ends the frame's sections, for the graph.
+*/
+void PS_EndFrame(void);
+
+/**	\brief Draws the perfstats overlay.
+*/
+void PS_DrawPerfStats(void);
+
+#endif // __M_PERFSTATS__
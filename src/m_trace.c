@@ -0,0 +1,193 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_trace.c
+/// \brief A timeline of where startup time goes, for -startupprofile
+///
+///        Tracing starts before the zone memory does, so everything here is
+///        allocated with malloc.
+
+#include "doomdef.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_trace.h"
+
+// Deeper than this, and phases are timed as part of the one that holds them
+#define MAXTRACEDEPTH 32
+
+typedef struct
+{
+	char *name;
+	const char *category;
+	UINT64 start, duration; // microseconds since tracing started
+} traceevent_t;
+
+boolean tracing = false;
+
+static traceevent_t *traceevents = NULL;
+static size_t numtraceevents = 0, maxtraceevents = 0;
+
+static size_t openevents[MAXTRACEDEPTH];
+static INT32 tracedepth = 0, skippeddepth = 0;
+
+static char *tracefile = NULL;
+static UINT32 lastmicros;
+static UINT64 tracetime;
+
+// I_GetTimeMicros wraps every hour and a bit, which a slow start could see.
+static UINT64 M_TraceNow(void)
+{
+	UINT32 now = I_GetTimeMicros();
+
+	tracetime += (UINT32)(now - lastmicros);
+	lastmicros = now;
+	return tracetime;
+}
+
+static void M_TraceAtExit(void)
+{
+	if (tracing)
+		M_FinishTrace();
+}
+
+void M_StartTrace(void)
+{
+	const char *name = "startup.json";
+
+	if (!M_CheckParm("-startupprofile"))
+		return;
+	if (M_IsNextParm())
+		name = M_GetNextParm();
+
+	tracefile = strdup(name);
+	if (!tracefile)
+		return;
+
+	lastmicros = I_GetTimeMicros();
+	tracetime = 0;
+	tracing = true;
+
+	// so quitting before the first level still leaves a trace
+	I_AddExitFunc(M_TraceAtExit);
+}
+
+void M_TraceBegin(const char *category, const char *name)
+{
+	traceevent_t *ev;
+
+	if (tracedepth == MAXTRACEDEPTH)
+	{
+		skippeddepth++;
+		return;
+	}
+
+	if (numtraceevents == maxtraceevents)
+	{
+		traceevent_t *grown;
+
+		maxtraceevents = maxtraceevents ? maxtraceevents*2 : 512;
+		grown = realloc(traceevents, maxtraceevents * sizeof (*traceevents));
+		if (!grown) // not worth quitting over
+		{
+			maxtraceevents = numtraceevents;
+			skippeddepth++;
+			return;
+		}
+		traceevents = grown;
+	}
+
+	ev = &traceevents[numtraceevents];
+	ev->name = strdup(name ? name : "?");
+	ev->category = category;
+	ev->start = M_TraceNow();
+	ev->duration = 0;
+	openevents[tracedepth++] = numtraceevents++;
+}
+
+void M_TraceEnd(void)
+{
+	traceevent_t *ev;
+
+	if (skippeddepth)
+	{
+		skippeddepth--;
+		return;
+	}
+	if (!tracedepth)
+		return;
+
+	ev = &traceevents[openevents[--tracedepth]];
+	ev->duration = M_TraceNow() - ev->start;
+}
+
+// Writes s as the inside of a JSON string.
+static void M_TraceString(FILE *f, const char *s)
+{
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((UINT8)*s < 0x20)
+			fprintf(f, "\\u%04x", (UINT8)*s);
+		else
+			fputc(*s, f);
+	}
+}
+
+void M_FinishTrace(void)
+{
+	const char *path;
+	FILE *f;
+	size_t i;
+
+	if (!tracing)
+		return;
+	tracing = false;
+
+	skippeddepth = 0;
+	while (tracedepth)
+	{
+		traceevent_t *ev = &traceevents[openevents[--tracedepth]];
+		ev->duration = M_TraceNow() - ev->start;
+	}
+
+	// srb2home isn't known yet when tracing starts
+	if (strchr(tracefile, '/') || strchr(tracefile, '\\') || !*srb2home)
+		path = tracefile;
+	else
+		path = va(pandf, srb2home, tracefile);
+
+	f = fopen(path, "w");
+	if (!f)
+		CONS_Alert(CONS_ERROR, M_GetText("Couldn't write startup profile %s\n"), path);
+	else
+	{
+		fputs("{\"traceEvents\":[\n", f);
+		for (i = 0; i < numtraceevents; i++)
+		{
+			fputs("{\"name\":\"", f);
+			M_TraceString(f, traceevents[i].name ? traceevents[i].name : "?");
+			fprintf(f, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%s,\"dur\":%s,\"pid\":1,\"tid\":1}%s\n",
+				traceevents[i].category, sizeu1((size_t)traceevents[i].start), sizeu2((size_t)traceevents[i].duration),
+				i + 1 < numtraceevents ? "," : "");
+		}
+		fputs("],\"displayTimeUnit\":\"ms\"}\n", f);
+		fclose(f);
+		CONS_Printf(M_GetText("Startup profile written to %s\n"), path);
+	}
+
+	for (i = 0; i < numtraceevents; i++)
+		free(traceevents[i].name);
+	free(traceevents);
+	traceevents = NULL;
+	numtraceevents = maxtraceevents = 0;
+	free(tracefile);
+	tracefile = NULL;
+}
@@ -0,0 +1,46 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  m_trace.h
+/// \brief A timeline of where startup time goes, for -startupprofile
+///
+///        Every phase of startup, up to the end of the first level load, is
+///        timed as it runs and written out in the Chrome trace format, which
+///        chrome://tracing and Perfetto can open. Phases nest, so loading a
+///        file shows up with its MD5, directory and scripts underneath it.
+
+#ifndef __M_TRACE__
+#define __M_TRACE__
+
+#include "doomtype.h"
+
+// Check this before calling M_TraceBegin or M_TraceEnd.
+extern boolean tracing;
+
+/**	\brief Starts tracing, if -startupprofile is on the command line.
+*/
+void M_StartTrace(void);
+
+/**	\brief Opens a phase, which lasts until the matching M_TraceEnd.
+	\param	category	what kind of work it is, such as "wad" or "lua"
+	\param	name	what's being worked on; copied
+*/
+void M_TraceBegin(const char *category, const char *name);
+
+/**	\brief Closes the phase opened last.
+*/
+void M_TraceEnd(void);
+
+/**	\brief Writes the trace out and stops tracing. Phases still open end now.
+*/
+void M_FinishTrace(void);
+
+#define TRACE_BEGIN(category, name) do { if (tracing) M_TraceBegin(category, name); } while (0)
+#define TRACE_END() do { if (tracing) M_TraceEnd(); } while (0)
+
+#endif // __M_TRACE__
@@ -90,6 +90,9 @@
 #include "m_menu.h"
 #include "m_argv.h" // Alam is going to kill me <3
 #include "m_misc.h" //  GetRevisionString()
+#include "d_main.h" // srb2home
+#include "i_threads.h"
+#include "z_zone.h"
 
 #ifdef _WIN32_WCE
 #include "sdl12/SRB2CE/cehelp.h"
@@ -432,25 +435,27 @@ static INT32 MS_Connect(const char *ip_addr, const char *str_port, INT32 async)
 }
 
 #define NUM_LIST_SERVER MAXSERVERLIST
-const msg_server_t *GetShortServersList(INT32 room)
+
+//
+// MS_ReadShortServersList
+//
+// Fetches the servers in room into server_list. Touches nothing but the
+// socket, so the fetch thread can use it too.
+//
+static INT32 MS_ReadShortServersList(const char *ip, const char *port, INT32 room, msg_server_t *server_list)
 {
-	static msg_server_t server_list[NUM_LIST_SERVER+1]; // +1 for easy test
 	msg_t msg;
 	INT32 i;
 
 	// we must be connected to the master server before writing to it
-	if (MS_Connect(GetMasterServerIP(), GetMasterServerPort(), 0))
-	{
-		CONS_Alert(CONS_ERROR, M_GetText("Cannot connect to the Master Server\n"));
-		M_StartMessage(M_GetText("There was a problem connecting to\nthe Master Server\n"), NULL, MM_NOTHING);
-		return NULL;
-	}
+	if (MS_Connect(ip, port, 0))
+		return MS_CONNECT_ERROR;
 
 	msg.type = GET_SHORT_SERVER_MSG;
 	msg.length = 0;
 	msg.room = room;
 	if (MS_Write(&msg) < 0)
-		return NULL;
+		return MS_WRITE_ERROR;
 
 	for (i = 0; i < NUM_LIST_SERVER && MS_Read(&msg) >= 0; i++)
 	{
@@ -458,7 +463,7 @@ const msg_server_t *GetShortServersList(INT32 room)
 		{
 			server_list[i].header.buffer[0] = 0;
 			CloseConnection();
-			return server_list;
+			return MS_NO_ERROR;
 		}
 		M_Memcpy(&server_list[i], msg.buffer, sizeof (msg_server_t));
 		server_list[i].header.buffer[0] = 1;
@@ -467,10 +472,170 @@ const msg_server_t *GetShortServersList(INT32 room)
 	if (i == NUM_LIST_SERVER)
 	{
 		server_list[i].header.buffer[0] = 0;
-		return server_list;
+		return MS_NO_ERROR;
 	}
 	else
+		return MS_READ_ERROR;
+}
+
+static void MS_ServersListError(void)
+{
+	CONS_Alert(CONS_ERROR, M_GetText("Cannot connect to the Master Server\n"));
+	M_StartMessage(M_GetText("There was a problem connecting to\nthe Master Server\n"), NULL, MM_NOTHING);
+}
+
+const msg_server_t *GetShortServersList(INT32 room)
+{
+	static msg_server_t server_list[NUM_LIST_SERVER+1]; // +1 for easy test
+	INT32 err = MS_ReadShortServersList(GetMasterServerIP(), GetMasterServerPort(), room, server_list);
+
+	if (err == MS_CONNECT_ERROR)
+		MS_ServersListError();
+	return err ? NULL : server_list;
+}
+
+#if defined (HAVE_THREADS) && !defined (NONET)
+// The fetch thread works on copies of everything it needs, and only
+// hands back the list and whether it got one.
+static struct
+{
+	char ip[64];
+	char port[8];
+	INT32 room;
+	INT32 nextroom; // asked for while busy with room
+	INT32 err;
+	boolean busy, done;
+	msg_server_t list[NUM_LIST_SERVER+1];
+} fetch;
+static I_mutex fetch_mutex;
+
+static void MS_FetchThread(void *userdata)
+{
+	INT32 err;
+	(void)userdata;
+
+	err = MS_ReadShortServersList(fetch.ip, fetch.port, fetch.room, fetch.list);
+
+	I_lock_mutex(&fetch_mutex);
+	fetch.err = err;
+	fetch.done = true;
+	I_unlock_mutex(fetch_mutex);
+}
+#endif
+
+boolean MS_StartServersListFetch(INT32 room)
+{
+#if defined (HAVE_THREADS) && !defined (NONET)
+	// Registering a server uses the same socket
+	if (server && netgame)
+		return false;
+
+	if (fetch.busy)
+	{
+		fetch.nextroom = room; // fetched once this one's in
+		return true;
+	}
+
+	strlcpy(fetch.ip, GetMasterServerIP(), sizeof (fetch.ip));
+	strlcpy(fetch.port, GetMasterServerPort(), sizeof (fetch.port));
+	fetch.room = fetch.nextroom = room;
+	fetch.busy = true;
+	fetch.done = false;
+	I_spawn_thread("ms-fetch", MS_FetchThread, NULL);
+	return true;
+#else
+	(void)room;
+	return false;
+#endif
+}
+
+const msg_server_t *MS_PollServersList(INT32 *room)
+{
+#if defined (HAVE_THREADS) && !defined (NONET)
+	boolean done;
+
+	if (!fetch.busy)
+		return NULL;
+
+	I_lock_mutex(&fetch_mutex);
+	done = fetch.done;
+	I_unlock_mutex(fetch_mutex);
+	if (!done)
+		return NULL;
+
+	fetch.busy = false;
+	if (fetch.nextroom != fetch.room) // a different room was asked for since
+	{
+		MS_StartServersListFetch(fetch.nextroom);
+		return NULL;
+	}
+
+	if (fetch.err == MS_CONNECT_ERROR)
+		MS_ServersListError();
+	*room = fetch.room;
+	return fetch.err ? NULL : fetch.list;
+#else
+	(void)room;
+	return NULL;
+#endif
+}
+
+//
+// The last list fetched is saved, so the browser has something to show
+// and ping while a new one is on its way.
+//
+#define SERVERLISTCACHE "mslist.dat"
+#define SERVERLISTMAGIC "SRB2MSL1"
+
+void MS_SaveServersList(INT32 room, const msg_server_t *list)
+{
+	UINT8 *buf, *p;
+	INT32 count;
+
+	for (count = 0; list[count].header.buffer[0]; count++)
+		;
+
+	buf = p = Z_Malloc(8 + 8 + count * sizeof (msg_server_t), PU_STATIC, NULL);
+
+	WRITEMEM(p, SERVERLISTMAGIC, 8);
+	WRITEINT32(p, room);
+	WRITEINT32(p, count);
+	WRITEMEM(p, list, count * sizeof (msg_server_t));
+
+	FIL_WriteFile(va(pandf, srb2home, SERVERLISTCACHE), buf, p - buf);
+	Z_Free(buf);
+}
+
+const msg_server_t *MS_LoadServersList(INT32 room)
+{
+	static msg_server_t server_list[NUM_LIST_SERVER+1];
+	UINT8 *buf, *p;
+	size_t length;
+	INT32 count;
+	boolean ok = false;
+
+	length = FIL_ReadFile(va(pandf, srb2home, SERVERLISTCACHE), &buf);
+	if (!length)
 		return NULL;
+
+	p = buf;
+	if (length >= 16 && !memcmp(p, SERVERLISTMAGIC, 8))
+	{
+		p += 8;
+		ok = (READINT32(p) == room);
+		count = READINT32(p);
+		if (count < 0 || count > NUM_LIST_SERVER
+			|| length != 16 + count * sizeof (msg_server_t))
+			ok = false;
+		if (ok)
+		{
+			M_Memcpy(server_list, p, count * sizeof (msg_server_t));
+			server_list[count].header.buffer[0] = 0;
+		}
+	}
+
+	Z_Free(buf);
+	return ok ? server_list : NULL;
 }
 
 INT32 GetRoomsList(boolean hosting)
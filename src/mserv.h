@@ -84,6 +84,20 @@ void UnregisterServer(void);
 void MasterClient_Ticker(void);
 
 const msg_server_t *GetShortServersList(INT32 room);
+
+/**	\brief Starts fetching the server list of room on another thread.
+	\return false if that can't be done here, so GetShortServersList must
+*/
+boolean MS_StartServersListFetch(INT32 room);
+
+/**	\brief Checks on the fetch MS_StartServersListFetch started.
+	\param	room	set to the room the list is for
+	\return the list, once, when it arrives; NULL otherwise
+*/
+const msg_server_t *MS_PollServersList(INT32 *room);
+
+void MS_SaveServersList(INT32 room, const msg_server_t *list);
+const msg_server_t *MS_LoadServersList(INT32 room);
 INT32 GetRoomsList(boolean hosting);
 #ifdef UPDATE_ALERT
 const char *GetMODVersion(void);
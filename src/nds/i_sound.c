@@ -13,6 +13,11 @@ void I_FreeSfx(sfxinfo_t *sfx)
 	(void)sfx;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	(void)sfx;
+}
+
 void I_StartupSound(void){}
 
 void I_ShutdownSound(void){}
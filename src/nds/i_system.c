@@ -24,8 +24,18 @@ tic_t I_GetTime(void)
 	return ticcount;
 }
 
+UINT32 I_GetTimeMicros(void)
+{
+	return ticcount * (1000000/TICRATE);
+}
+
 void I_Sleep(void){}
 
+void I_SleepMillis(UINT32 ms)
+{
+	(void)ms;
+}
+
 void I_GetEvent(void)
 {
 	// Mappings of DS keys to SRB2 keys
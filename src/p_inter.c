@@ -17,6 +17,7 @@
 #include "g_game.h"
 #include "m_random.h"
 #include "p_local.h"
+#include "p_predict.h"
 #include "s_sound.h"
 #include "r_main.h"
 #include "st_stuff.h"
@@ -92,18 +93,12 @@ void P_RampConstant(const BasicFF_t *FFInfo, INT32 Start, INT32 End)
   */
 void P_ClearStarPost(INT32 postnum)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 
 	// scan the thinkers
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_STARPOST, NULL); mo2; mo2 = P_FindMobjFromType(MT_STARPOST, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-
-		if (mo2->type == MT_STARPOST && mo2->health <= postnum)
+		if (mo2->health <= postnum)
 			P_SetMobjState(mo2, mo2->info->seestate);
 	}
 	return;
@@ -116,19 +111,12 @@ void P_ClearStarPost(INT32 postnum)
 //
 void P_ResetStarposts(void)
 {
-	// Search through all the thinkers.
-	thinker_t *th;
+	// Search through all the starposts.
 	mobj_t *post;
 
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (post = P_FindMobjFromType(MT_STARPOST, NULL); post; post = P_FindMobjFromType(MT_STARPOST, post))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		post = (mobj_t *)th;
-
-		if (post->type == MT_STARPOST)
-			P_SetMobjState(post, post->info->spawnstate);
+		P_SetMobjState(post, post->info->spawnstate);
 	}
 }
 
@@ -238,7 +226,7 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 	player_t *player;
 	INT32 i;
 
-	if (objectplacing)
+	if (objectplacing || p_predicting)
 		return;
 
 	I_Assert(special != NULL);
@@ -698,7 +686,7 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 				count = 1;
 
 				// scan the remaining thinkers
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 				{
 					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 						continue;
@@ -748,7 +736,7 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 
 				// Now we RE-scan all the thinkers to find close objects to pull
 				// in from the paraloop. Isn't this just so efficient?
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 				{
 					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 						continue;
@@ -1103,7 +1091,6 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 		case MT_AXE:
 			{
 				line_t junk;
-				thinker_t  *th;
 				mobj_t *mo2;
 
 				if (player->bot)
@@ -1113,18 +1100,9 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 				EV_DoElevator(&junk, bridgeFall, false);
 
 				// scan the remaining thinkers to find koopa
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
-				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-					if (mo2->type == MT_KOOPA)
-					{
-						mo2->momz = 5*FRACUNIT;
-						break;
-					}
-				}
+				mo2 = P_FindMobjFromType(MT_KOOPA, NULL);
+				if (mo2)
+					mo2->momz = 5*FRACUNIT;
 			}
 			break;
 		case MT_FIREFLOWER:
@@ -1176,7 +1154,7 @@ void P_TouchSpecialThing(mobj_t *special, mobj_t *toucher, boolean heightcheck)
 				thinker_t *th;
 				mobj_t *mo2;
 
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 				{
 					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 					continue;
@@ -1668,7 +1646,7 @@ static void P_HitDeathMessages(player_t *player, mobj_t *inflictor, mobj_t *sour
   */
 void P_CheckTimeLimit(void)
 {
-	INT32 i, k;
+	INT32 i;
 
 	if (!cv_timelimit.value)
 		return;
@@ -1709,10 +1687,7 @@ void P_CheckTimeLimit(void)
 	//Optional tie-breaker for Match/CTF
 	else if (cv_overtime.value)
 	{
-		INT32 playerarray[MAXPLAYERS];
-		INT32 tempplayer = 0;
 		INT32 spectators = 0;
-		INT32 playercount = 0;
 
 		//Figure out if we have enough participating players to care.
 		for (i = 0; i < MAXPLAYERS; i++)
@@ -1730,32 +1705,25 @@ void P_CheckTimeLimit(void)
 			// Normal Match
 			if (!G_GametypeHasTeams())
 			{
-				//Store the nodes of participating players in an array.
+				INT32 first = -1, second = -1;
+
+				//Find the two best participating players.
 				for (i = 0; i < MAXPLAYERS; i++)
 				{
-					if (playeringame[i] && !players[i].spectator)
-					{
-						playerarray[playercount] = i;
-						playercount++;
-					}
-				}
+					if (!playeringame[i] || players[i].spectator)
+						continue;
 
-				//Sort 'em.
-				for (i = 1; i < playercount; i++)
-				{
-					for (k = i; k < playercount; k++)
+					if (first == -1 || players[i].score > players[first].score)
 					{
-						if (players[playerarray[i-1]].score < players[playerarray[k]].score)
-						{
-							tempplayer = playerarray[i-1];
-							playerarray[i-1] = playerarray[k];
-							playerarray[k] = tempplayer;
-						}
+						second = first;
+						first = i;
 					}
+					else if (second == -1 || players[i].score > players[second].score)
+						second = i;
 				}
 
 				//End the round if the top players aren't tied.
-				if (players[playerarray[0]].score == players[playerarray[1]].score)
+				if (second != -1 && players[first].score == players[second].score)
 					return;
 			}
 			else
@@ -1939,6 +1907,9 @@ void P_KillMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source)
 	mobjtype_t item;
 	mobj_t *mo;
 
+	if (p_predicting)
+		return;
+
 	if (inflictor && (inflictor->type == MT_SHELL || inflictor->type == MT_FIREBALL))
 		P_SetTarget(&target->tracer, inflictor);
 
@@ -2290,18 +2261,13 @@ void P_KillMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source)
 
 	if (target->type == MT_EGGMOBILE3)
 	{
-		thinker_t *th;
 		UINT32 i = 0; // to check how many clones we've removed
 
 		// scan the thinkers to make sure all the old pinch dummies are gone on death
 		// this can happen if the boss was hurt earlier than expected
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo = P_FindMobjFromType((mobjtype_t)target->info->mass, NULL); mo; mo = P_FindMobjFromType((mobjtype_t)target->info->mass, mo))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-				continue;
-
-			mo = (mobj_t *)th;
-			if (mo->type == (mobjtype_t)target->info->mass && mo->tracer == target)
+			if (mo->tracer == target)
 			{
 				P_RemoveMobj(mo);
 				i++;
@@ -2820,7 +2786,7 @@ boolean P_DamageMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 da
 	static const boolean force = false;
 #endif
 
-	if (objectplacing)
+	if (objectplacing || p_predicting)
 		return false;
 
 	if (target->health <= 0)
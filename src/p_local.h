@@ -63,11 +63,22 @@
 // P_TICK
 //
 
-// both the head and tail of the thinker list
-extern thinker_t thinkercap;
+// Thinkers are kept in one list per class, so code that only cares
+// about one kind (usually mobjs) doesn't have to walk all of them.
+// The lists are run in this order every tic.
+typedef enum
+{
+	THINK_POLYOBJ,
+	THINK_MAIN,
+	THINK_MOBJ,
+	NUM_THINKERLISTS
+} thinklistnum_t; /**< Thinker lists. */
+
+// both the head and tail of each thinker list
+extern thinker_t thlist[NUM_THINKERLISTS];
 
 void P_InitThinkers(void);
-void P_AddThinker(thinker_t *thinker);
+void P_AddThinker(const thinklistnum_t n, thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
 
 //
@@ -225,6 +236,10 @@ fixed_t P_MobjCeilingZ(mobj_t *mobj, sector_t *sector, sector_t *boundsec, fixed
 #define P_GetSpecialBottomZ(mobj, src, bound) P_MobjFloorZ(mobj, src, bound, mobj->x, mobj->y, NULL, src != bound, true)
 #define P_GetSpecialTopZ(mobj, src, bound) P_MobjCeilingZ(mobj, src, bound, mobj->x, mobj->y, NULL, src == bound, true)
 
+// FOF flags that can make a FOF hold up or block mobj. A sector whose
+// fofflags have none of them has no FOFs that matter to mobj's movement.
+#define P_FOFMOVEFLAGS(mobj) ((mobj)->player ? (FF_BLOCKPLAYER|FF_SWIMMABLE|FF_QUICKSAND) : (FF_BLOCKOTHERS|FF_QUICKSAND))
+
 fixed_t P_CameraFloorZ(camera_t *mobj, sector_t *sector, sector_t *boundsec, fixed_t x, fixed_t y, line_t *line, boolean lowest, boolean perfect);
 fixed_t P_CameraCeilingZ(camera_t *mobj, sector_t *sector, sector_t *boundsec, fixed_t x, fixed_t y, line_t *line, boolean lowest, boolean perfect);
 #define P_CameraGetFloorZ(mobj, sector, x, y, line) P_CameraFloorZ(mobj, sector, NULL, x, y, line, false, false)
@@ -308,26 +323,41 @@ extern line_t *ceilingline;
 extern line_t *blockingline;
 extern msecnode_t *sector_list;
 
-extern mprecipsecnode_t *precipsector_list;
 
 void P_UnsetThingPosition(mobj_t *thing);
 void P_SetThingPosition(mobj_t *thing);
 void P_SetUnderlayPosition(mobj_t *thing);
+void P_AddToThingBox(sector_t *sec, mobj_t *thing);
+
+void P_InitBlockStatics(void);
+boolean P_IsStaticThing(mobj_t *thing);
+void P_LinkStaticThing(mobj_t *thing, size_t cellnum);
+void P_UnlinkStaticThing(mobj_t *thing);
+void P_UpdateStaticThing(mobj_t *thing);
+void P_PackBlockStatics(void);
+
+#ifdef MOBJCONSISTANCY
+// The mobjs' part of Consistancy(), kept up to date as they're linked
+// in and out, so it never has to walk the thinker list.
+extern UINT32 mobjconsistancy;
+#endif
 
 boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y);
 boolean P_CheckCameraPosition(fixed_t x, fixed_t y, camera_t *thiscam);
+void P_ClearCameraCheck(void);
 boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean allowdropoff);
 boolean P_Move(mobj_t *actor, fixed_t speed);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y, fixed_t z);
 void P_SlideMove(mobj_t *mo);
 void P_BounceMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void P_BuildSightGroups(void);
+void P_ClearSightCache(void);
 void P_CheckHoopPosition(mobj_t *hoopthing, fixed_t x, fixed_t y, fixed_t z, fixed_t radius);
 
 boolean P_CheckSector(sector_t *sector, boolean crunch);
 
 void P_DelSeclist(msecnode_t *node);
-void P_DelPrecipSeclist(mprecipsecnode_t *node);
 
 void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y);
 void P_Initsecnode(void);
@@ -351,6 +381,19 @@ extern fixed_t bmaporgx;
 extern fixed_t bmaporgy; // origin of block map
 extern mobj_t **blocklinks; // for thing chains
 
+// Rings, monitors and scenery at rest, kept out of blocklinks so the
+// chains there only have things that move. Each cell's are parallel
+// arrays, with each thing's bounding box as it was linked.
+typedef struct
+{
+	mobj_t **mobjs; // NULL where one has left since the last pack
+	fixed_t *left, *right, *bottom, *top;
+	size_t count, size;
+	boolean holes;
+} blockstatic_t;
+
+extern blockstatic_t *blockstatics;
+
 //
 // P_INTER
 //
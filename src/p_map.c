@@ -19,6 +19,7 @@
 #include "m_random.h"
 #include "p_local.h"
 #include "p_setup.h" // NiGHTS stuff
+#include "p_predict.h"
 #include "r_state.h"
 #include "r_main.h"
 #include "r_sky.h"
@@ -34,6 +35,7 @@
 #include "z_zone.h"
 
 #include "lua_hook.h"
+#include "m_bench.h"
 
 fixed_t tmbbox[4];
 mobj_t *tmthing;
@@ -41,9 +43,6 @@ static INT32 tmflags;
 fixed_t tmx;
 fixed_t tmy;
 
-static precipmobj_t *tmprecipthing;
-static fixed_t preciptmbbox[4];
-
 // If "floatok" true, move would be ok
 // if within "tmfloorz - tmceilingz".
 boolean floatok;
@@ -65,7 +64,6 @@ line_t *ceilingline;
 line_t *blockingline;
 
 msecnode_t *sector_list = NULL;
-mprecipsecnode_t *precipsector_list = NULL;
 camera_t *mapcampointer;
 
 //
@@ -378,6 +376,99 @@ static void P_DoTailsCarry(player_t *sonic, player_t *tails)
 	}
 }
 
+// Things can stand on top of solid things, or be blocked by them.
+static void P_CheckSolidThing(mobj_t *thing)
+{
+	fixed_t topz, tmtopz;
+
+	if (tmthing->eflags & MFE_VERTICALFLIP)
+	{
+		// pass under
+		tmtopz = tmthing->z;
+
+		if (tmtopz > thing->z + thing->height)
+		{
+			if (thing->z + thing->height > tmfloorz)
+			{
+				tmfloorz = thing->z + thing->height;
+#ifdef ESLOPE
+				tmfloorslope = NULL;
+#endif
+			}
+			return;
+		}
+
+		topz = thing->z - thing->scale; // FixedMul(FRACUNIT, thing->scale), but thing->scale == FRACUNIT in base scale anyways
+
+		if (thing->flags & MF_SPRING)
+			;
+		// block only when jumping not high enough,
+		// (dont climb max. 24units while already in air)
+		// since return false doesn't handle momentum properly,
+		// we lie to P_TryMove() so it's always too high
+		else if (tmthing->player && tmthing->z + tmthing->height > topz
+			&& tmthing->z + tmthing->height < tmthing->ceilingz)
+		{
+			tmfloorz = tmceilingz = topz; // block while in air
+#ifdef ESLOPE
+			tmceilingslope = NULL;
+#endif
+			tmfloorthing = thing; // needed for side collision
+		}
+		else if (topz < tmceilingz && tmthing->z <= thing->z+thing->height)
+		{
+			tmceilingz = topz;
+#ifdef ESLOPE
+			tmceilingslope = NULL;
+#endif
+			tmfloorthing = thing; // thing we may stand on
+		}
+	}
+	else
+	{
+		// pass under
+		tmtopz = tmthing->z + tmthing->height;
+
+		if (tmtopz < thing->z)
+		{
+			if (thing->z < tmceilingz)
+			{
+				tmceilingz = thing->z;
+#ifdef ESLOPE
+				tmceilingslope = NULL;
+#endif
+			}
+			return;
+		}
+
+		topz = thing->z + thing->height + thing->scale; // FixedMul(FRACUNIT, thing->scale), but thing->scale == FRACUNIT in base scale anyways
+
+		if (thing->flags & MF_SPRING)
+			;
+		// block only when jumping not high enough,
+		// (dont climb max. 24units while already in air)
+		// since return false doesn't handle momentum properly,
+		// we lie to P_TryMove() so it's always too high
+		else if (tmthing->player && tmthing->z < topz
+			&& tmthing->z > tmthing->floorz)
+		{
+			tmfloorz = tmceilingz = topz; // block while in air
+#ifdef ESLOPE
+			tmfloorslope = NULL;
+#endif
+			tmfloorthing = thing; // needed for side collision
+		}
+		else if (topz > tmfloorz && tmthing->z+tmthing->height >= thing->z)
+		{
+			tmfloorz = topz;
+#ifdef ESLOPE
+			tmfloorslope = NULL;
+#endif
+			tmfloorthing = thing; // thing we may stand on
+		}
+	}
+}
+
 //
 // PIT_CheckThing
 //
@@ -469,6 +560,19 @@ static boolean PIT_CheckThing(mobj_t *thing)
 	if (abs(thing->x - tmx) >= blockdist || abs(thing->y - tmy) >= blockdist)
 		return true; // didn't hit it
 
+	// Whatever happens next, it has to think about it
+	thing->eflags &= ~MFE_DORMANT;
+
+	// Running ahead of the server, only bump into things;
+	// springs, monitors and the rest are for the real tic.
+	if (p_predicting)
+	{
+		if ((thing->flags & (MF_SOLID|MF_NOCLIP|MF_SPRING|MF_MONITOR)) == MF_SOLID
+			&& (tmthing->flags & (MF_SOLID|MF_NOCLIP)) == MF_SOLID)
+			P_CheckSolidThing(thing);
+		return true;
+	}
+
 #ifdef HAVE_BLUA
 	{
 		UINT8 shouldCollide = LUAh_MobjCollide(thing, tmthing); // checks hook for thing's type
@@ -967,96 +1071,7 @@ static boolean PIT_CheckThing(mobj_t *thing)
 	// Treat noclip things as non-solid!
 	else if ((thing->flags & (MF_SOLID|MF_NOCLIP)) == MF_SOLID
 		&& (tmthing->flags & (MF_SOLID|MF_NOCLIP)) == MF_SOLID)
-	{
-		fixed_t topz, tmtopz;
-
-		if (tmthing->eflags & MFE_VERTICALFLIP)
-		{
-			// pass under
-			tmtopz = tmthing->z;
-
-			if (tmtopz > thing->z + thing->height)
-			{
-				if (thing->z + thing->height > tmfloorz)
-				{
-					tmfloorz = thing->z + thing->height;
-#ifdef ESLOPE
-					tmfloorslope = NULL;
-#endif
-				}
-				return true;
-			}
-
-			topz = thing->z - thing->scale; // FixedMul(FRACUNIT, thing->scale), but thing->scale == FRACUNIT in base scale anyways
-
-			if (thing->flags & MF_SPRING)
-				;
-			// block only when jumping not high enough,
-			// (dont climb max. 24units while already in air)
-			// since return false doesn't handle momentum properly,
-			// we lie to P_TryMove() so it's always too high
-			else if (tmthing->player && tmthing->z + tmthing->height > topz
-				&& tmthing->z + tmthing->height < tmthing->ceilingz)
-			{
-				tmfloorz = tmceilingz = topz; // block while in air
-#ifdef ESLOPE
-				tmceilingslope = NULL;
-#endif
-				tmfloorthing = thing; // needed for side collision
-			}
-			else if (topz < tmceilingz && tmthing->z <= thing->z+thing->height)
-			{
-				tmceilingz = topz;
-#ifdef ESLOPE
-				tmceilingslope = NULL;
-#endif
-				tmfloorthing = thing; // thing we may stand on
-			}
-		}
-		else
-		{
-			// pass under
-			tmtopz = tmthing->z + tmthing->height;
-
-			if (tmtopz < thing->z)
-			{
-				if (thing->z < tmceilingz)
-				{
-					tmceilingz = thing->z;
-#ifdef ESLOPE
-					tmceilingslope = NULL;
-#endif
-				}
-				return true;
-			}
-
-			topz = thing->z + thing->height + thing->scale; // FixedMul(FRACUNIT, thing->scale), but thing->scale == FRACUNIT in base scale anyways
-
-			if (thing->flags & MF_SPRING)
-				;
-			// block only when jumping not high enough,
-			// (dont climb max. 24units while already in air)
-			// since return false doesn't handle momentum properly,
-			// we lie to P_TryMove() so it's always too high
-			else if (tmthing->player && tmthing->z < topz
-				&& tmthing->z > tmthing->floorz)
-			{
-				tmfloorz = tmceilingz = topz; // block while in air
-#ifdef ESLOPE
-				tmfloorslope = NULL;
-#endif
-				tmfloorthing = thing; // needed for side collision
-			}
-			else if (topz > tmfloorz && tmthing->z+tmthing->height >= thing->z)
-			{
-				tmfloorz = topz;
-#ifdef ESLOPE
-				tmfloorslope = NULL;
-#endif
-				tmfloorthing = thing; // thing we may stand on
-			}
-		}
-	}
+		P_CheckSolidThing(thing);
 
 	// not solid not blocked
 	return true;
@@ -1066,16 +1081,18 @@ static boolean PIT_CheckThing(mobj_t *thing)
 // Adjusts tmfloorz and tmceilingz as lines are contacted - FOR CAMERA ONLY
 static boolean PIT_CheckCameraLine(line_t *ld)
 {
-	if (ld->polyobj && !(ld->polyobj->flags & POF_SOLID))
-		return true;
+	const linecoll_t *lc = &linecoll[ld - lines];
 
-	if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT] || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-		|| tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM] || tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+	if (tmbbox[BOXRIGHT] <= lc->bbox[BOXLEFT] || tmbbox[BOXLEFT] >= lc->bbox[BOXRIGHT]
+		|| tmbbox[BOXTOP] <= lc->bbox[BOXBOTTOM] || tmbbox[BOXBOTTOM] >= lc->bbox[BOXTOP])
 	{
 		return true;
 	}
 
-	if (P_BoxOnLineSide(tmbbox, ld) != -1)
+	if (P_BoxOnLineCollSide(tmbbox, lc) != -1)
+		return true;
+
+	if (ld->polyobj && !(ld->polyobj->flags & POF_SOLID))
 		return true;
 
 	// A line has been hit
@@ -1128,14 +1145,17 @@ static boolean PIT_CheckCameraLine(line_t *ld)
 //
 static boolean PIT_CheckLine(line_t *ld)
 {
-	if (ld->polyobj && !(ld->polyobj->flags & POF_SOLID))
+	// Most lines are ruled out here, without reading the line_t
+	const linecoll_t *lc = &linecoll[ld - lines];
+
+	if (tmbbox[BOXRIGHT] <= lc->bbox[BOXLEFT] || tmbbox[BOXLEFT] >= lc->bbox[BOXRIGHT]
+	|| tmbbox[BOXTOP] <= lc->bbox[BOXBOTTOM] || tmbbox[BOXBOTTOM] >= lc->bbox[BOXTOP])
 		return true;
 
-	if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT] || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-	|| tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM] || tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+	if (P_BoxOnLineCollSide(tmbbox, lc) != -1)
 		return true;
 
-	if (P_BoxOnLineSide(tmbbox, ld) != -1)
+	if (ld->polyobj && !(ld->polyobj->flags & POF_SOLID))
 		return true;
 
 	// A line has been hit
@@ -1232,7 +1252,7 @@ static boolean PIT_CheckLine(line_t *ld)
 // tmceilingz
 //     the nearest ceiling or thing's bottom over tmthing
 //
-boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
+static boolean P_DoCheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 {
 	INT32 xl, xh, yl, yh, bx, by;
 	subsector_t *newsubsec;
@@ -1270,7 +1290,7 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 #endif
 
 	// Check list of fake floors and see if tmfloorz/tmceilingz need to be altered.
-	if (newsubsec->sector->ffloors)
+	if (newsubsec->sector->fofflags & (P_FOFMOVEFLAGS(thing)|FF_GOOWATER|(thing->type == MT_SKIM ? FF_SWIMMABLE : 0)))
 	{
 		ffloor_t *rover;
 		fixed_t delta1, delta2;
@@ -1479,7 +1499,7 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 		for (bx = xl; bx <= xh; bx++)
 			for (by = yl; by <= yh; by++)
 			{
-				if (!P_BlockThingsIterator(bx, by, PIT_CheckThing))
+				if (!P_BlockThingsIteratorBox(bx, by, tmbbox, PIT_CheckThing))
 					blockval = false;
 				if (P_MobjWasRemoved(tmthing))
 					return false;
@@ -1497,6 +1517,16 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 	return blockval;
 }
 
+boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
+{
+	boolean r;
+
+	BENCH_ENTER(BENCH_COLLISION);
+	r = P_DoCheckPosition(thing, x, y);
+	BENCH_EXIT(BENCH_COLLISION);
+	return r;
+}
+
 static const fixed_t hoopblockdist = 16*FRACUNIT + 8*FRACUNIT;
 static const fixed_t hoophalfheight = (56*FRACUNIT)/2;
 
@@ -1524,14 +1554,38 @@ void P_CheckHoopPosition(mobj_t *hoopthing, fixed_t x, fixed_t y, fixed_t z, fix
 	return;
 }
 
+// The last camera position checked, and what came of it
+static struct
+{
+	boolean valid;
+	camera_t *cam;
+	fixed_t x, y, z, height, radius;
+	boolean fits;
+	fixed_t floorz, ceilingz, dropoffz, drpoffceilz;
+	line_t *ceilingline, *blockingline;
+} lastcamcheck;
+
+//
+// P_ClearCameraCheck
+//
+// Forgets the last camera position checked. The camera thinker calls this
+// first, since sectors and polyobjects may have moved since the last time.
+//
+void P_ClearCameraCheck(void)
+{
+	lastcamcheck.valid = false;
+}
+
+static boolean P_DoCheckCameraPosition(fixed_t x, fixed_t y, camera_t *thiscam);
+
 //
 // P_CheckCameraPosition
 //
+// A camera usually ends its move by checking again where its last try
+// ended up, so that's remembered rather than worked out twice.
+//
 boolean P_CheckCameraPosition(fixed_t x, fixed_t y, camera_t *thiscam)
 {
-	INT32 xl, xh, yl, yh, bx, by;
-	subsector_t *newsubsec;
-
 	tmx = x;
 	tmy = y;
 
@@ -1540,11 +1594,46 @@ boolean P_CheckCameraPosition(fixed_t x, fixed_t y, camera_t *thiscam)
 	tmbbox[BOXRIGHT] = x + thiscam->radius;
 	tmbbox[BOXLEFT] = x - thiscam->radius;
 
+	mapcampointer = thiscam;
+
+	if (lastcamcheck.valid && lastcamcheck.cam == thiscam
+		&& lastcamcheck.x == x && lastcamcheck.y == y && lastcamcheck.z == thiscam->z
+		&& lastcamcheck.height == thiscam->height && lastcamcheck.radius == thiscam->radius)
+	{
+		tmfloorz = lastcamcheck.floorz;
+		tmceilingz = lastcamcheck.ceilingz;
+		tmdropoffz = lastcamcheck.dropoffz;
+		tmdrpoffceilz = lastcamcheck.drpoffceilz;
+		ceilingline = lastcamcheck.ceilingline;
+		blockingline = lastcamcheck.blockingline;
+		return lastcamcheck.fits;
+	}
+
+	lastcamcheck.fits = P_DoCheckCameraPosition(x, y, thiscam);
+	lastcamcheck.valid = true;
+	lastcamcheck.cam = thiscam;
+	lastcamcheck.x = x;
+	lastcamcheck.y = y;
+	lastcamcheck.z = thiscam->z;
+	lastcamcheck.height = thiscam->height;
+	lastcamcheck.radius = thiscam->radius;
+	lastcamcheck.floorz = tmfloorz;
+	lastcamcheck.ceilingz = tmceilingz;
+	lastcamcheck.dropoffz = tmdropoffz;
+	lastcamcheck.drpoffceilz = tmdrpoffceilz;
+	lastcamcheck.ceilingline = ceilingline;
+	lastcamcheck.blockingline = blockingline;
+	return lastcamcheck.fits;
+}
+
+static boolean P_DoCheckCameraPosition(fixed_t x, fixed_t y, camera_t *thiscam)
+{
+	INT32 xl, xh, yl, yh, bx, by;
+	subsector_t *newsubsec;
+
 	newsubsec = R_PointInSubsector(x, y);
 	ceilingline = blockingline = NULL;
 
-	mapcampointer = thiscam;
-
 	if (GETSECSPECIAL(newsubsec->sector->special, 4) == 12)
 	{ // Camera noclip on entire sector.
 		tmfloorz = tmdropoffz = thiscam->z;
@@ -1886,7 +1975,7 @@ boolean PIT_PushableMoved(mobj_t *thing)
 // P_TryMove
 // Attempt to move to a new position.
 //
-boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean allowdropoff)
+static boolean P_DoTryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean allowdropoff)
 {
 	fixed_t tryx = thing->x;
 	fixed_t tryy = thing->y;
@@ -2097,6 +2186,16 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean allowdropoff)
 	return true;
 }
 
+boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean allowdropoff)
+{
+	boolean r;
+
+	BENCH_ENTER(BENCH_COLLISION);
+	r = P_DoTryMove(thing, x, y, allowdropoff);
+	BENCH_EXIT(BENCH_COLLISION);
+	return r;
+}
+
 boolean P_SceneryTryMove(mobj_t *thing, fixed_t x, fixed_t y)
 {
 	fixed_t tryx, tryy;
@@ -3228,6 +3327,8 @@ static boolean PIT_ChangeSector(mobj_t *thing, boolean realcrush)
 {
 	mobj_t *killer = NULL;
 
+	thing->eflags &= ~MFE_DORMANT; // the floor or ceiling moved under it
+
 	if (P_ThingHeightClip(thing))
 	{
 		//thing fits, check next thing
@@ -3292,7 +3393,7 @@ static boolean PIT_ChangeSector(mobj_t *thing, boolean realcrush)
 						thinker_t *think;
 						elevator_t *crumbler;
 
-						for (think = thinkercap.next; think != &thinkercap; think = think->next)
+						for (think = thlist[THINK_MAIN].next; think != &thlist[THINK_MAIN]; think = think->next)
 						{
 							if (think->function.acp1 != (actionf_p1)T_StartCrumble)
 								continue;
@@ -3347,6 +3448,8 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 	msecnode_t *n;
 	size_t i;
 
+	P_ClearTouchCache();
+
 	nofit = false;
 	crushchange = crunch;
 
@@ -3383,14 +3486,13 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 				{
 					for (x = po->blockbox[BOXLEFT]; x <= po->blockbox[BOXRIGHT]; ++x)
 					{
+						blockwalk_t walk;
 						mobj_t *mo;
 
 						if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 							continue;
 
-						mo = blocklinks[y * bmapwidth + x];
-
-						for (; mo; mo = mo->bnext)
+						for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
 						{
 							// Monster Iestyn: do we need to check if a mobj has already been checked? ...probably not I suspect
 
@@ -3493,14 +3595,13 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 				{
 					for (x = po->blockbox[BOXLEFT]; x <= po->blockbox[BOXRIGHT]; ++x)
 					{
+						blockwalk_t walk;
 						mobj_t *mo;
 
 						if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 							continue;
 
-						mo = blocklinks[y * bmapwidth + x];
-
-						for (; mo; mo = mo->bnext)
+						for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
 						{
 							// Monster Iestyn: do we need to check if a mobj has already been checked? ...probably not I suspect
 
@@ -3578,12 +3679,10 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 */
 
 static msecnode_t *headsecnode = NULL;
-static mprecipsecnode_t *headprecipsecnode = NULL;
 
 void P_Initsecnode(void)
 {
 	headsecnode = NULL;
-	headprecipsecnode = NULL;
 }
 
 // P_GetSecnode() retrieves a node from the freelist. The calling routine
@@ -3603,20 +3702,6 @@ static msecnode_t *P_GetSecnode(void)
 	return node;
 }
 
-static mprecipsecnode_t *P_GetPrecipSecnode(void)
-{
-	mprecipsecnode_t *node;
-
-	if (headprecipsecnode)
-	{
-		node = headprecipsecnode;
-		headprecipsecnode = headprecipsecnode->m_thinglist_next;
-	}
-	else
-		node = Z_Calloc(sizeof (*node), PU_LEVEL, NULL);
-	return node;
-}
-
 // P_PutSecnode() returns a node to the freelist.
 
 static inline void P_PutSecnode(msecnode_t *node)
@@ -3625,13 +3710,6 @@ static inline void P_PutSecnode(msecnode_t *node)
 	headsecnode = node;
 }
 
-// Tails 08-25-2002
-static inline void P_PutPrecipSecnode(mprecipsecnode_t *node)
-{
-	node->m_thinglist_next = headprecipsecnode;
-	headprecipsecnode = node;
-}
-
 // P_AddSecnode() searches the current list to see if this sector is
 // already there. If not, it adds a sector node at the head of the list of
 // sectors this object appears in. This is called when creating a list of
@@ -3677,47 +3755,6 @@ static msecnode_t *P_AddSecnode(sector_t *s, mobj_t *thing, msecnode_t *nextnode
 	return node;
 }
 
-// More crazy crap Tails 08-25-2002
-static mprecipsecnode_t *P_AddPrecipSecnode(sector_t *s, precipmobj_t *thing, mprecipsecnode_t *nextnode)
-{
-	mprecipsecnode_t *node;
-
-	node = nextnode;
-	while (node)
-	{
-		if (node->m_sector == s) // Already have a node for this sector?
-		{
-			node->m_thing = thing; // Yes. Setting m_thing says 'keep it'.
-			return nextnode;
-		}
-		node = node->m_sectorlist_next;
-	}
-
-	// Couldn't find an existing node for this sector. Add one at the head
-	// of the list.
-
-	node = P_GetPrecipSecnode();
-
-	// mark new nodes unvisited.
-	node->visited = 0;
-
-	node->m_sector = s; // sector
-	node->m_thing = thing; // mobj
-	node->m_sectorlist_prev = NULL; // prev node on Thing thread
-	node->m_sectorlist_next = nextnode; // next node on Thing thread
-	if (nextnode)
-		nextnode->m_sectorlist_prev = node; // set back link on Thing
-
-	// Add new node at head of sector thread starting at s->touching_thinglist
-
-	node->m_thinglist_prev = NULL; // prev node on sector thread
-	node->m_thinglist_next = s->touching_preciplist; // next node on sector thread
-	if (s->touching_preciplist)
-		node->m_thinglist_next->m_thinglist_prev = node;
-	s->touching_preciplist = node;
-	return node;
-}
-
 // P_DelSecnode() deletes a sector node from the list of
 // sectors this object appears in. Returns a pointer to the next node
 // on the linked list, or NULL.
@@ -3760,45 +3797,6 @@ static msecnode_t *P_DelSecnode(msecnode_t *node)
 	return tn;
 }
 
-// Tails 08-25-2002
-static mprecipsecnode_t *P_DelPrecipSecnode(mprecipsecnode_t *node)
-{
-	mprecipsecnode_t *tp; // prev node on thing thread
-	mprecipsecnode_t *tn; // next node on thing thread
-	mprecipsecnode_t *sp; // prev node on sector thread
-	mprecipsecnode_t *sn; // next node on sector thread
-
-	if (!node)
-		return NULL;
-
-	// Unlink from the Thing thread. The Thing thread begins at
-	// sector_list and not from mobj_t->touching_sectorlist.
-
-	tp = node->m_sectorlist_prev;
-	tn = node->m_sectorlist_next;
-	if (tp)
-		tp->m_sectorlist_next = tn;
-	if (tn)
-		tn->m_sectorlist_prev = tp;
-
-	// Unlink from the sector thread. This thread begins at
-	// sector_t->touching_thinglist.
-
-	sp = node->m_thinglist_prev;
-	sn = node->m_thinglist_next;
-	if (sp)
-		sp->m_thinglist_next = sn;
-	else
-		node->m_sector->touching_preciplist = sn;
-	if (sn)
-		sn->m_thinglist_prev = sp;
-
-	// Return this node to the freelist
-
-	P_PutPrecipSecnode(node);
-	return tn;
-}
-
 // Delete an entire sector list
 void P_DelSeclist(msecnode_t *node)
 {
@@ -3806,13 +3804,6 @@ void P_DelSeclist(msecnode_t *node)
 		node = P_DelSecnode(node);
 }
 
-// Tails 08-25-2002
-void P_DelPrecipSeclist(mprecipsecnode_t *node)
-{
-	while (node)
-		node = P_DelPrecipSecnode(node);
-}
-
 // PIT_GetSectors
 // Locates all the sectors the object is in by looking at the lines that
 // cross through it. You have already decided that the object is allowed
@@ -3821,13 +3812,15 @@ void P_DelPrecipSeclist(mprecipsecnode_t *node)
 
 static inline boolean PIT_GetSectors(line_t *ld)
 {
-	if (tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT] ||
-		tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT] ||
-		tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM] ||
-		tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+	const linecoll_t *lc = &linecoll[ld - lines];
+
+	if (tmbbox[BOXRIGHT] <= lc->bbox[BOXLEFT] ||
+		tmbbox[BOXLEFT] >= lc->bbox[BOXRIGHT] ||
+		tmbbox[BOXTOP] <= lc->bbox[BOXBOTTOM] ||
+		tmbbox[BOXBOTTOM] >= lc->bbox[BOXTOP])
 	return true;
 
-	if (P_BoxOnLineSide(tmbbox, ld) != -1)
+	if (P_BoxOnLineCollSide(tmbbox, lc) != -1)
 		return true;
 
 	if (ld->polyobj) // line belongs to a polyobject, don't add it
@@ -3853,41 +3846,6 @@ static inline boolean PIT_GetSectors(line_t *ld)
 	return true;
 }
 
-// Tails 08-25-2002
-static inline boolean PIT_GetPrecipSectors(line_t *ld)
-{
-	if (preciptmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT] ||
-		preciptmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT] ||
-		preciptmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM] ||
-		preciptmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
-	return true;
-
-	if (P_BoxOnLineSide(preciptmbbox, ld) != -1)
-		return true;
-
-	if (ld->polyobj) // line belongs to a polyobject, don't add it
-		return true;
-
-	// This line crosses through the object.
-
-	// Collect the sector(s) from the line and add to the
-	// sector_list you're examining. If the Thing ends up being
-	// allowed to move to this position, then the sector_list
-	// will be attached to the Thing's mobj_t at touching_sectorlist.
-
-	precipsector_list = P_AddPrecipSecnode(ld->frontsector, tmprecipthing, precipsector_list);
-
-	// Don't assume all lines are 2-sided, since some Things
-	// like MT_TFOG are allowed regardless of whether their radius takes
-	// them beyond an impassable linedef.
-
-	// Use sidedefs instead of 2s flag to determine two-sidedness.
-	if (ld->backsector)
-		precipsector_list = P_AddPrecipSecnode(ld->backsector, tmprecipthing, precipsector_list);
-
-	return true;
-}
-
 // P_CreateSecNodeList alters/creates the sector_list that shows what sectors
 // the object resides in.
 
@@ -3974,79 +3932,16 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 	}
 }
 
-// More crazy crap Tails 08-25-2002
-void P_CreatePrecipSecNodeList(precipmobj_t *thing,fixed_t x,fixed_t y)
-{
-	INT32 xl, xh, yl, yh, bx, by;
-	mprecipsecnode_t *node = precipsector_list;
-	precipmobj_t *saved_tmthing = tmprecipthing; /* cph - see comment at func end */
-
-	// First, clear out the existing m_thing fields. As each node is
-	// added or verified as needed, m_thing will be set properly. When
-	// finished, delete all nodes where m_thing is still NULL. These
-	// represent the sectors the Thing has vacated.
-
-	while (node)
-	{
-		node->m_thing = NULL;
-		node = node->m_sectorlist_next;
-	}
-
-	tmprecipthing = thing;
-
-	preciptmbbox[BOXTOP] = y + 2*FRACUNIT;
-	preciptmbbox[BOXBOTTOM] = y - 2*FRACUNIT;
-	preciptmbbox[BOXRIGHT] = x + 2*FRACUNIT;
-	preciptmbbox[BOXLEFT] = x - 2*FRACUNIT;
-
-	validcount++; // used to make sure we only process a line once
-
-	xl = (unsigned)(preciptmbbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
-	xh = (unsigned)(preciptmbbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
-	yl = (unsigned)(preciptmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
-	yh = (unsigned)(preciptmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
-
-	BMBOUNDFIX(xl, xh, yl, yh);
-
-	for (bx = xl; bx <= xh; bx++)
-		for (by = yl; by <= yh; by++)
-			P_BlockLinesIterator(bx, by, PIT_GetPrecipSectors);
-
-	// Add the sector of the (x, y) point to sector_list.
-	precipsector_list = P_AddPrecipSecnode(thing->subsector->sector, thing, precipsector_list);
-
-	// Now delete any nodes that won't be used. These are the ones where
-	// m_thing is still NULL.
-	node = precipsector_list;
-	while (node)
-	{
-		if (!node->m_thing)
-		{
-			if (node == precipsector_list)
-				precipsector_list = node->m_sectorlist_next;
-			node = P_DelPrecipSecnode(node);
-		}
-		else
-			node = node->m_sectorlist_next;
-	}
-
-	/* cph -
-	* This is the strife we get into for using global variables. tmthing
-	*  is being used by several different functions calling
-	*  P_BlockThingIterator, including functions that can be called *from*
-	*  P_BlockThingIterator. Using a global tmthing is not reentrant.
-	* OTOH for Boom/MBF demos we have to preserve the buggy behavior.
-	*  Fun. We restore its previous value unless we're in a Boom/MBF demo.
-	*/
-	tmprecipthing = saved_tmthing;
-}
-
 /* cphipps 2004/08/30 -
  * Must clear tmthing at tic end, as it might contain a pointer to a removed thinker, or the level might have ended/been ended and we clear the objects it was pointing too. Hopefully we don't need to carry this between tics for sync. */
 void P_MapStart(void)
 {
 	if (tmthing)
 		I_Error("P_MapStart: tmthing set!");
+
+	// Anything could have moved since last time
+	P_ClearSightCache();
+	P_ClearTouchCache();
 }
 
 void P_MapEnd(void)
@@ -178,6 +178,108 @@ INT32 P_PointOnLineSide(fixed_t x, fixed_t y, line_t *line)
 	return 1; // back side
 }
 
+linecoll_t *linecoll;
+
+//
+// P_SetLineColl
+// Copies a line's bounding box and direction into linecoll.
+//
+void P_SetLineColl(line_t *ld)
+{
+	linecoll_t *lc = &linecoll[ld - lines];
+
+	lc->bbox[BOXTOP] = ld->bbox[BOXTOP];
+	lc->bbox[BOXBOTTOM] = ld->bbox[BOXBOTTOM];
+	lc->bbox[BOXLEFT] = ld->bbox[BOXLEFT];
+	lc->bbox[BOXRIGHT] = ld->bbox[BOXRIGHT];
+	lc->x = ld->v1->x;
+	lc->y = ld->v1->y;
+	lc->dx = ld->dx;
+	lc->dy = ld->dy;
+	lc->slopetype = ld->slopetype;
+}
+
+//
+// P_PointOnLineCollSide
+// P_PointOnLineSide, for a linecoll_t.
+//
+static inline INT32 P_PointOnLineCollSide(fixed_t x, fixed_t y, const linecoll_t *lc)
+{
+	fixed_t left, right;
+
+	if (!lc->dx)
+	{
+		if (x <= lc->x)
+			return (lc->dy > 0);
+
+		return (lc->dy < 0);
+	}
+	if (!lc->dy)
+	{
+		if (y <= lc->y)
+			return (lc->dx < 0);
+
+		return (lc->dx > 0);
+	}
+
+	left = FixedMul(lc->dy>>FRACBITS, x - lc->x);
+	right = FixedMul(y - lc->y, lc->dx>>FRACBITS);
+
+	if (right < left)
+		return 0; // front side
+	return 1; // back side
+}
+
+//
+// P_BoxOnLineCollSide
+// P_BoxOnLineSide, for a linecoll_t.
+//
+INT32 P_BoxOnLineCollSide(const fixed_t *tmbox, const linecoll_t *lc)
+{
+	INT32 p1, p2;
+
+	switch (lc->slopetype)
+	{
+		case ST_HORIZONTAL:
+			p1 = tmbox[BOXTOP] > lc->y;
+			p2 = tmbox[BOXBOTTOM] > lc->y;
+			if (lc->dx < 0)
+			{
+				p1 ^= 1;
+				p2 ^= 1;
+			}
+			break;
+
+		case ST_VERTICAL:
+			p1 = tmbox[BOXRIGHT] < lc->x;
+			p2 = tmbox[BOXLEFT] < lc->x;
+			if (lc->dy < 0)
+			{
+				p1 ^= 1;
+				p2 ^= 1;
+			}
+			break;
+
+		case ST_POSITIVE:
+			p1 = P_PointOnLineCollSide(tmbox[BOXLEFT], tmbox[BOXTOP], lc);
+			p2 = P_PointOnLineCollSide(tmbox[BOXRIGHT], tmbox[BOXBOTTOM], lc);
+			break;
+
+		case ST_NEGATIVE:
+			p1 = P_PointOnLineCollSide(tmbox[BOXRIGHT], tmbox[BOXTOP], lc);
+			p2 = P_PointOnLineCollSide(tmbox[BOXLEFT], tmbox[BOXBOTTOM], lc);
+			break;
+
+		default:
+			I_Error("P_BoxOnLineCollSide: unknown slopetype %d\n", lc->slopetype);
+			return -1;
+	}
+
+	if (p1 == p2)
+		return p1;
+	return -1;
+}
+
 //
 // P_BoxOnLineSide
 // Considers the line to be infinite
@@ -648,7 +750,7 @@ void P_LineOpening(line_t *linedef, mobj_t *mobj)
 		else
 #endif
 		// Check for fake floors in the sector.
-		if (front->ffloors || back->ffloors)
+		if ((front->fofflags | back->fofflags) & P_FOFMOVEFLAGS(mobj))
 		{
 			ffloor_t *rover;
 			fixed_t delta1, delta2;
@@ -751,6 +853,52 @@ void P_LineOpening(line_t *linedef, mobj_t *mobj)
 // THING POSITION SETTING
 //
 
+#ifdef MOBJCONSISTANCY
+UINT32 mobjconsistancy = 0;
+
+// Only things that can tell players apart take part.
+#define CONSISTANCYFLAGS (MF_SPECIAL|MF_SOLID|MF_PUSHABLE|MF_BOSS|MF_MISSILE|MF_SPRING|MF_MONITOR|MF_FIRE|MF_ENEMY|MF_PAIN|MF_STICKY)
+
+static inline UINT32 P_MixConsistancy(UINT32 h, UINT32 v)
+{
+	return (h ^ v) * 0x01000193;
+}
+
+// Each thing is mixed on its own and the results are XORed together,
+// so it can be taken out again, and the order things are in doesn't matter.
+static void P_LinkConsistancy(mobj_t *thing)
+{
+	UINT32 h = 0x811C9DC5;
+
+	mobjconsistancy ^= thing->consistancy; // linked in twice?
+	if (!(thing->flags & CONSISTANCYFLAGS))
+	{
+		thing->consistancy = 0;
+		return;
+	}
+
+	h = P_MixConsistancy(h, thing->type);
+	h = P_MixConsistancy(h, (UINT32)thing->x);
+	h = P_MixConsistancy(h, (UINT32)thing->y);
+	h = P_MixConsistancy(h, (UINT32)thing->z);
+	h = P_MixConsistancy(h, thing->angle);
+	h = P_MixConsistancy(h, thing->flags);
+	h = P_MixConsistancy(h, thing->flags2);
+	h = P_MixConsistancy(h, (UINT32)(thing->state - states));
+	h = P_MixConsistancy(h, thing->target ? thing->target->type : 0x3333);
+	h = P_MixConsistancy(h, thing->tracer && thing->tracer->type != MT_OVERLAY ? thing->tracer->type : 0xAAAA);
+
+	thing->consistancy = h;
+	mobjconsistancy ^= h;
+}
+
+static inline void P_UnlinkConsistancy(mobj_t *thing)
+{
+	mobjconsistancy ^= thing->consistancy;
+	thing->consistancy = 0;
+}
+#endif
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -763,6 +911,13 @@ void P_UnsetThingPosition(mobj_t *thing)
 	I_Assert(thing != NULL);
 	I_Assert(!P_MobjWasRemoved(thing));
 
+#ifdef MOBJCONSISTANCY
+	P_UnlinkConsistancy(thing);
+#endif
+
+	if (thing->staticslot)
+		P_UnlinkStaticThing(thing);
+
 	if (!(thing->flags & MF_NOSECTOR))
 	{
 		/* invisible things don't need to be in sector list
@@ -813,17 +968,6 @@ void P_UnsetThingPosition(mobj_t *thing)
 	}
 }
 
-void P_UnsetPrecipThingPosition(precipmobj_t *thing)
-{
-	precipmobj_t **sprev = thing->sprev;
-	precipmobj_t  *snext = thing->snext;
-	if ((*sprev = snext) != NULL)  // unlink from sector list
-		snext->sprev = sprev;
-
-	precipsector_list = thing->touching_sectorlist;
-	thing->touching_sectorlist = NULL; //to be restored by P_SetPrecipThingPosition
-}
-
 //
 // P_SetThingPosition
 // Links a thing into both a block and a subsector
@@ -844,6 +988,10 @@ void P_SetThingPosition(mobj_t *thing)
 
 	ss = thing->subsector = R_PointInSubsector(thing->x, thing->y);
 
+#ifdef MOBJCONSISTANCY
+	P_LinkConsistancy(thing);
+#endif
+
 	if (!(thing->flags & MF_NOSECTOR))
 	{
 		// invisible things don't go into the sector links
@@ -857,6 +1005,7 @@ void P_SetThingPosition(mobj_t *thing)
 			snext->sprev = &thing->snext;
 		thing->sprev = link;
 		*link = thing;
+		P_AddToThingBox(ss->sector, thing);
 
 		// phares 3/16/98
 		//
@@ -883,6 +1032,12 @@ void P_SetThingPosition(mobj_t *thing)
 		const INT32 blockx = (unsigned)(thing->x - bmaporgx)>>MAPBLOCKSHIFT;
 		const INT32 blocky = (unsigned)(thing->y - bmaporgy)>>MAPBLOCKSHIFT;
 		if (blockx >= 0 && blockx < bmapwidth
+			&& blocky >= 0 && blocky < bmapheight && P_IsStaticThing(thing))
+		{
+			thing->bnext = NULL, thing->bprev = NULL;
+			P_LinkStaticThing(thing, blocky*bmapwidth + blockx);
+		}
+		else if (blockx >= 0 && blockx < bmapwidth
 			&& blocky >= 0 && blocky < bmapheight)
 		{
 			// killough 8/11/98: simpler scheme using
@@ -917,6 +1072,19 @@ void P_SetThingPosition(mobj_t *thing)
 	}
 }
 
+//
+// P_AddToThingBox
+// Grows a sector's thingbox for a thing just linked into its thinglist.
+// Nothing shrinks it when things leave; R_AddSprites does that when it
+// goes through the list.
+//
+void P_AddToThingBox(sector_t *sec, mobj_t *thing)
+{
+	if (sec->thinglist == thing && !thing->snext)
+		M_ClearBox(sec->thingbox);
+	M_AddToBox(sec->thingbox, thing->x, thing->y);
+}
+
 //
 // P_SetUnderlayPosition
 // Links a thing into a subsector at the other end of the stack,
@@ -931,6 +1099,9 @@ void P_SetUnderlayPosition(mobj_t *thing)
 
 	ss = thing->subsector = R_PointInSubsector(thing->x, thing->y);
 	link = &ss->sector->thinglist;
+#ifdef MOBJCONSISTANCY
+	P_LinkConsistancy(thing);
+#endif
 	for (lend = *link; lend && lend->snext; lend = lend->snext)
 		;
 	thing->snext = NULL;
@@ -944,26 +1115,224 @@ void P_SetUnderlayPosition(mobj_t *thing)
 		thing->sprev = &lend->snext;
 		lend->snext = thing;
 	}
+	P_AddToThingBox(ss->sector, thing);
 
 	P_CreateSecNodeList(thing,thing->x,thing->y);
 	thing->touching_sectorlist = sector_list; // Attach to Thing's mobj_t
 	sector_list = NULL; // clear for next time
 }
 
-void P_SetPrecipitationThingPosition(precipmobj_t *thing)
+//
+// STATIC THINGS
+//
+// Rings, monitors and scenery that aren't moving are kept in
+// blockstatics instead of blocklinks. Each cell's are in parallel
+// arrays in the order they were linked, with their bounding boxes,
+// so looking for the ones something overlaps is a sweep over four
+// arrays rather than a walk down a chain.
+//
+// Leaving one only clears its slot, and the holes are packed out at
+// the start of the next tic, so a walk over a cell never skips or
+// repeats a thing whatever the things it finds do to the cell.
+//
+
+blockstatic_t *blockstatics;
+
+static size_t *staticdirty; // cells with holes
+static size_t numstaticdirty;
+
+#define STATICMINSIZE 8
+
+//
+// P_InitBlockStatics
+//
+// Called once the blockmap is loaded, before any things are spawned.
+//
+void P_InitBlockStatics(void)
 {
-	subsector_t *ss = thing->subsector = R_PointInSubsector(thing->x, thing->y);
-
-	precipmobj_t **link = &ss->sector->preciplist;
-	precipmobj_t *snext = *link;
-	if ((thing->snext = snext) != NULL)
-		snext->sprev = &thing->snext;
-	thing->sprev = link;
-	*link = thing;
-
-	P_CreatePrecipSecNodeList(thing, thing->x, thing->y);
-	thing->touching_sectorlist = precipsector_list; // Attach to Thing's precipmobj_t
-	precipsector_list = NULL; // clear for next time
+	const size_t numcells = bmapwidth*bmapheight;
+
+	blockstatics = Z_Calloc(numcells * sizeof (*blockstatics), PU_LEVEL, NULL);
+	staticdirty = Z_Malloc(numcells * sizeof (*staticdirty), PU_LEVEL, NULL);
+	numstaticdirty = 0;
+}
+
+//
+// P_IsStaticThing
+//
+// Only decides where a thing is kept. One that starts to move again
+// goes back into blocklinks the next time it's linked, as anything
+// moving is.
+//
+boolean P_IsStaticThing(mobj_t *thing)
+{
+	if (!blockstatics || thing->player || thing->momx || thing->momy)
+		return false;
+	if (thing->flags & (MF_ENEMY|MF_BOSS|MF_MISSILE|MF_PUSHABLE))
+		return false;
+	return (thing->flags & (MF_SCENERY|MF_MONITOR))
+		|| (thing->flags & (MF_SPECIAL|MF_NOGRAVITY)) == (MF_SPECIAL|MF_NOGRAVITY);
+}
+
+static void P_SetStaticBox(blockstatic_t *cell, size_t i, mobj_t *thing)
+{
+	cell->left[i] = thing->x - thing->radius;
+	cell->right[i] = thing->x + thing->radius;
+	cell->bottom[i] = thing->y - thing->radius;
+	cell->top[i] = thing->y + thing->radius;
+}
+
+//
+// P_LinkStaticThing
+//
+// Puts a thing at the end of a cell.
+//
+void P_LinkStaticThing(mobj_t *thing, size_t cellnum)
+{
+	blockstatic_t *cell = &blockstatics[cellnum];
+
+	if (cell->count == cell->size)
+	{
+		const size_t size = cell->size ? cell->size*2 : STATICMINSIZE;
+		UINT8 *block = Z_Malloc(size * (sizeof (mobj_t *) + 4*sizeof (fixed_t)), PU_LEVEL, NULL);
+		mobj_t **mobjs = (mobj_t **)block;
+		fixed_t *boxes = (fixed_t *)(block + size*sizeof (mobj_t *));
+
+		if (cell->size)
+		{
+			M_Memcpy(mobjs, cell->mobjs, cell->count * sizeof (mobj_t *));
+			M_Memcpy(boxes, cell->left, cell->count * sizeof (fixed_t));
+			M_Memcpy(boxes + size, cell->right, cell->count * sizeof (fixed_t));
+			M_Memcpy(boxes + 2*size, cell->bottom, cell->count * sizeof (fixed_t));
+			M_Memcpy(boxes + 3*size, cell->top, cell->count * sizeof (fixed_t));
+			Z_Free(cell->mobjs);
+		}
+
+		cell->mobjs = mobjs;
+		cell->left = boxes;
+		cell->right = boxes + size;
+		cell->bottom = boxes + 2*size;
+		cell->top = boxes + 3*size;
+		cell->size = size;
+	}
+
+	cell->mobjs[cell->count] = thing;
+	P_SetStaticBox(cell, cell->count, thing);
+	thing->staticcell = cellnum;
+	thing->staticslot = ++cell->count;
+}
+
+//
+// P_UnlinkStaticThing
+//
+// Leaves a hole for the next P_PackBlockStatics.
+//
+void P_UnlinkStaticThing(mobj_t *thing)
+{
+	blockstatic_t *cell = &blockstatics[thing->staticcell];
+	const size_t i = thing->staticslot - 1;
+
+	I_Assert(cell->mobjs[i] == thing);
+
+	cell->mobjs[i] = NULL;
+	// Nothing overlaps it any more
+	cell->left[i] = cell->bottom[i] = INT32_MAX;
+	cell->right[i] = cell->top[i] = INT32_MIN;
+	thing->staticslot = 0;
+
+	if (!cell->holes)
+	{
+		cell->holes = true;
+		staticdirty[numstaticdirty++] = thing->staticcell;
+	}
+}
+
+//
+// P_UpdateStaticThing
+//
+// For when a thing's radius changes where it is.
+//
+void P_UpdateStaticThing(mobj_t *thing)
+{
+	if (thing->staticslot)
+		P_SetStaticBox(&blockstatics[thing->staticcell], thing->staticslot - 1, thing);
+}
+
+//
+// P_PackBlockStatics
+//
+// Closes up the holes left in each cell, keeping the order.
+//
+void P_PackBlockStatics(void)
+{
+	size_t i, j, n;
+
+	while (numstaticdirty)
+	{
+		blockstatic_t *cell = &blockstatics[staticdirty[--numstaticdirty]];
+
+		for (i = n = 0; i < cell->count; i++)
+		{
+			mobj_t *thing = cell->mobjs[i];
+
+			if (!thing)
+				continue;
+			if (n != i)
+			{
+				cell->mobjs[n] = thing;
+				cell->left[n] = cell->left[i];
+				cell->right[n] = cell->right[i];
+				cell->bottom[n] = cell->bottom[i];
+				cell->top[n] = cell->top[i];
+			}
+			thing->staticslot = ++n;
+		}
+		for (j = n; j < cell->count; j++)
+			cell->mobjs[j] = NULL;
+		cell->count = n;
+		cell->holes = false;
+	}
+}
+
+//
+// P_FirstBlockThing
+//
+// Starts a walk over everything in a cell: what's in blocklinks,
+// then the static things. The cell has to be on the map.
+//
+mobj_t *P_FirstBlockThing(blockwalk_t *walk, INT32 x, INT32 y)
+{
+	walk->cell = y*bmapwidth + x;
+	walk->slot = 0;
+	walk->count = blockstatics[walk->cell].count;
+	walk->mobj = blocklinks[walk->cell];
+	if (walk->mobj)
+		return walk->mobj;
+	return P_NextBlockThing(walk);
+}
+
+//
+// P_NextBlockThing
+//
+// The next thing on the walk, or NULL at the end. Static things
+// linked into the cell on the way aren't visited.
+//
+mobj_t *P_NextBlockThing(blockwalk_t *walk)
+{
+	const blockstatic_t *cell = &blockstatics[walk->cell];
+
+	if (walk->mobj && !walk->slot)
+	{
+		walk->mobj = walk->mobj->bnext;
+		if (walk->mobj)
+			return walk->mobj;
+	}
+
+	while (walk->slot < walk->count)
+		if ((walk->mobj = cell->mobjs[walk->slot++]) != NULL)
+			return walk->mobj;
+
+	return walk->mobj = NULL;
 }
 
 //
@@ -1042,12 +1411,21 @@ boolean P_BlockLinesIterator(INT32 x, INT32 y, boolean (*func)(line_t *))
 }
 
 
+#define STATICSWEEP 64
+
 //
-// P_BlockThingsIterator
+// P_BlockThingsIteratorBox
 //
-boolean P_BlockThingsIterator(INT32 x, INT32 y, boolean (*func)(mobj_t *))
+// Like P_BlockThingsIterator, but static things that don't overlap
+// box are passed over for func. Only right for funcs that would
+// ignore them anyway, as PIT_CheckThing does.
+//
+boolean P_BlockThingsIteratorBox(INT32 x, INT32 y, const fixed_t *box, boolean (*func)(mobj_t *))
 {
 	mobj_t *mobj, *bnext = NULL;
+	const blockstatic_t *cell;
+	size_t hits[STATICSWEEP];
+	size_t base, count, end, i, n;
 
 	if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 		return true;
@@ -1065,9 +1443,55 @@ boolean P_BlockThingsIterator(INT32 x, INT32 y, boolean (*func)(mobj_t *))
 			return true;
 		}
 	}
+
+	// Then the static things, a few at a time. func can add to the
+	// cell and move its arrays, so they're looked up again each time.
+	cell = &blockstatics[y*bmapwidth + x];
+	count = cell->count;
+	for (base = 0; base < count; base = end)
+	{
+		end = base + STATICSWEEP < count ? base + STATICSWEEP : count;
+		n = 0;
+
+		if (box)
+		{
+			const fixed_t *left = cell->left, *right = cell->right;
+			const fixed_t *bottom = cell->bottom, *top = cell->top;
+
+			for (i = base; i < end; i++)
+			{
+				hits[n] = i;
+				n += (left[i] < box[BOXRIGHT]) & (right[i] > box[BOXLEFT])
+					& (bottom[i] < box[BOXTOP]) & (top[i] > box[BOXBOTTOM]);
+			}
+		}
+		else
+			for (i = base; i < end; i++)
+				hits[n++] = i;
+
+		for (i = 0; i < n; i++)
+		{
+			mobj = cell->mobjs[hits[i]];
+			if (!mobj) // left since the sweep
+				continue;
+			if (!func(mobj))
+				return false;
+			if (P_MobjWasRemoved(tmthing))
+				return true;
+		}
+	}
+
 	return true;
 }
 
+//
+// P_BlockThingsIterator
+//
+boolean P_BlockThingsIterator(INT32 x, INT32 y, boolean (*func)(mobj_t *))
+{
+	return P_BlockThingsIteratorBox(x, y, NULL, func);
+}
+
 //
 // INTERCEPT ROUTINES
 //
@@ -1215,33 +1639,83 @@ static boolean PIT_AddThingIntercepts(mobj_t *thing)
 // Returns true if the traverser function returns true
 // for all lines.
 //
-static boolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac)
+// Below this many, an insertion sort is quicker than merging.
+#define INTERCEPTMERGESIZE 16
+
+//
+// P_SortIntercepts
+//
+// Sorts the intercepts nearest first. Ones at the same distance keep the
+// order they were found in, which is the order P_TraverseIntercepts used to
+// pick them out in, one at a time.
+//
+static void P_SortIntercepts(intercept_t *list, size_t count)
 {
-	size_t count;
-	fixed_t dist;
-	intercept_t *scan, *in = NULL;
+	static intercept_t *scratch = NULL;
+	static size_t maxscratch = 0;
+	intercept_t *src, *dst, *swap, in;
+	size_t i, j, width, mid, end, a, b;
+
+	if (count <= INTERCEPTMERGESIZE)
+	{
+		for (i = 1; i < count; i++)
+		{
+			in = list[i];
+			for (j = i; j > 0 && list[j-1].frac > in.frac; j--)
+				list[j] = list[j-1];
+			list[j] = in;
+		}
+		return;
+	}
 
-	count = intercept_p - intercepts;
+	if (maxscratch < count)
+	{
+		maxscratch = count;
+		scratch = Z_Realloc(scratch, sizeof (*scratch) * maxscratch, PU_STATIC, NULL);
+	}
 
-	while (count--)
+	// Bottom-up merge sort, flipping between list and scratch
+	src = list;
+	dst = scratch;
+	for (width = 1; width < count; width *= 2)
 	{
-		dist = INT32_MAX;
-		for (scan = intercepts; scan < intercept_p; scan++)
+		for (i = 0; i < count; i += 2*width)
 		{
-			if (scan->frac < dist)
+			mid = min(i + width, count);
+			end = min(i + 2*width, count);
+			for (a = i, b = mid, j = i; j < end; j++)
 			{
-				dist = scan->frac;
-				in = scan;
+				if (a < mid && (b >= end || src[a].frac <= src[b].frac))
+					dst[j] = src[a++];
+				else
+					dst[j] = src[b++];
 			}
 		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != list)
+		M_Memcpy(list, src, sizeof (*list) * count);
+}
+
+static boolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac)
+{
+	intercept_t *scan, *in;
+	size_t count = 0;
 
-		if (dist > maxfrac)
-			return true; // Checked everything in range.
+	// Anything past maxfrac would never be reached, so don't sort it
+	for (scan = in = intercepts; scan < intercept_p; scan++)
+		if (scan->frac <= maxfrac)
+			in[count++] = *scan;
 
+	P_SortIntercepts(intercepts, count);
+
+	for (in = intercepts; in < intercepts + count; in++)
+	{
 		if (!func(in))
 			return false; // Don't bother going farther.
-
-		in->frac = INT32_MAX;
 	}
 
 	return true; // Everything was traversed.
@@ -38,6 +38,22 @@ typedef struct
 
 typedef boolean (*traverser_t)(intercept_t *in);
 
+// What the collision checks look at first, copied out of each line so a
+// blockmap cell's lines can be ruled out without reading whole line_ts.
+// lines[i] is linecoll[i]; anything that moves a line has to redo it.
+typedef struct
+{
+	fixed_t bbox[4];
+	fixed_t x, y; // v1
+	fixed_t dx, dy;
+	slopetype_t slopetype;
+} linecoll_t;
+
+extern linecoll_t *linecoll;
+
+void P_SetLineColl(line_t *ld);
+INT32 P_BoxOnLineCollSide(const fixed_t *tmbox, const linecoll_t *lc);
+
 boolean P_PathTraverse(fixed_t px1, fixed_t py1, fixed_t px2, fixed_t py2,
 	INT32 pflags, traverser_t ptrav);
 
@@ -49,9 +65,6 @@ void P_MakeDivline(line_t *li, divline_t *dl);
 void P_CameraLineOpening(line_t *plinedef);
 fixed_t P_InterceptVector(divline_t *v2, divline_t *v1);
 INT32 P_BoxOnLineSide(fixed_t *tmbox, line_t *ld);
-void P_UnsetPrecipThingPosition(precipmobj_t *thing);
-void P_SetPrecipitationThingPosition(precipmobj_t *thing);
-void P_CreatePrecipSecNodeList(precipmobj_t *thing, fixed_t x,fixed_t y);
 boolean P_SceneryTryMove(mobj_t *thing, fixed_t x, fixed_t y);
 
 extern fixed_t opentop, openbottom, openrange, lowfloor, highceiling;
@@ -63,6 +76,19 @@ void P_LineOpening(line_t *plinedef, mobj_t *mobj);
 
 boolean P_BlockLinesIterator(INT32 x, INT32 y, boolean(*func)(line_t *));
 boolean P_BlockThingsIterator(INT32 x, INT32 y, boolean(*func)(mobj_t *));
+boolean P_BlockThingsIteratorBox(INT32 x, INT32 y, const fixed_t *box, boolean(*func)(mobj_t *));
+
+// For going through every thing in a cell by hand, blocklinks and
+// blockstatics both:
+//	for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
+typedef struct
+{
+	mobj_t *mobj;
+	size_t cell, slot, count;
+} blockwalk_t;
+
+mobj_t *P_FirstBlockThing(blockwalk_t *walk, INT32 x, INT32 y);
+mobj_t *P_NextBlockThing(blockwalk_t *walk);
 
 #define PT_ADDLINES     1
 #define PT_ADDTHINGS    2
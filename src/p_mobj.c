@@ -31,10 +31,15 @@
 #include "i_video.h"
 #include "lua_hook.h"
 #include "b_bot.h"
+#include "m_perfstats.h"
 #ifdef ESLOPE
 #include "p_slopes.h"
 #endif
 
+#ifdef HAVE_BLUA
+boolean LUA_HasAction(const char *action);
+#endif
+
 // protos.
 static CV_PossibleValue_t viewheight_cons_t[] = {{16, "MIN"}, {56, "MAX"}, {0, NULL}};
 consvar_t cv_viewheight = {"viewheight", VIEWHEIGHTS, 0, viewheight_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
@@ -44,6 +49,9 @@ consvar_t cv_splats = {"splats", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0
 
 actioncache_t actioncachehead;
 
+// Object pool for P_SpawnMobj, purged with PU_LEVEL.
+zpool_t mobjpool = Z_POOLINIT("Objects", mobj_t, 256, PU_LEVEL);
+
 static mobj_t *overlaycap = NULL;
 
 void P_InitCachedActions(void)
@@ -316,7 +324,10 @@ boolean P_SetPlayerMobjState(mobj_t *mobj, statenum_t state)
 #ifdef HAVE_BLUA
 			astate = st;
 #endif
-			st->action.acp1(mobj);
+			if (ps_tickprofiling)
+				PS_RunAction(st->action.acp1, mobj);
+			else
+				st->action.acp1(mobj);
 
 			// woah. a player was removed by an action.
 			// this sounds like a VERY BAD THING, but there's nothing we can do now...
@@ -356,6 +367,8 @@ boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
 		I_Error("P_SetMobjState used for player mobj. Use P_SetPlayerMobjState instead!\n(State called: %d)", state);
 #endif
 
+	mobj->eflags &= ~MFE_DORMANT;
+
 	if (recursion++) // if recursion detected,
 		memset(seenstate = tempstate, 0, sizeof tempstate); // clear state table
 
@@ -384,7 +397,10 @@ boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
 #ifdef HAVE_BLUA
 			astate = st;
 #endif
-			st->action.acp1(mobj);
+			if (ps_tickprofiling)
+				PS_RunAction(st->action.acp1, mobj);
+			else
+				st->action.acp1(mobj);
 			if (P_MobjWasRemoved(mobj))
 				return false;
 		}
@@ -416,28 +432,11 @@ boolean P_SetMobjStateNF(mobj_t *mobj, statenum_t state)
 {
 	state_t *st;
 
-	if (state == S_NULL)
-	{ // Remove mobj
-		P_RemoveMobj(mobj);
-		return false;
-	}
-	st = &states[state];
-	mobj->state = st;
-	mobj->tics = st->tics;
-	mobj->sprite = st->sprite;
-	mobj->frame = st->frame;
-	mobj->anim_duration = (UINT16)st->var2; // only used if FF_ANIMATE is set
-
-	return true;
-}
-
-static boolean P_SetPrecipMobjState(precipmobj_t *mobj, statenum_t state)
-{
-	state_t *st;
+	mobj->eflags &= ~MFE_DORMANT;
 
 	if (state == S_NULL)
 	{ // Remove mobj
-		P_RemovePrecipMobj(mobj);
+		P_RemoveMobj(mobj);
 		return false;
 	}
 	st = &states[state];
@@ -494,7 +493,6 @@ boolean P_WeaponOrPanel(mobjtype_t type)
 //
 void P_EmeraldManager(void)
 {
-	thinker_t *think;
 	mobj_t *mo;
 	INT32 i,j;
 	INT32 numtospawn;
@@ -513,28 +511,21 @@ void P_EmeraldManager(void)
 		spawnpoints[i] = NULL;
 	}
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (mo = P_FindMobjFromType(MT_EMERALDSPAWN, NULL); mo; mo = P_FindMobjFromType(MT_EMERALDSPAWN, mo))
 	{
-		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue; // not a mobj thinker
-
-		mo = (mobj_t *)think;
-
-		if (mo->type == MT_EMERALDSPAWN)
-		{
-			if (mo->threshold || mo->target) // Either has the emerald spawned or is spawning
-			{
-				numwithemerald++;
-				emeraldsspawned |= mobjinfo[mo->reactiontime].speed;
-			}
-			else if (numspawnpoints < MAXHUNTEMERALDS)
-				spawnpoints[numspawnpoints++] = mo; // empty spawn points
-		}
-		else if (mo->type == MT_FLINGEMERALD)
+		if (mo->threshold || mo->target) // Either has the emerald spawned or is spawning
 		{
 			numwithemerald++;
-			emeraldsspawned |= mo->threshold;
+			emeraldsspawned |= mobjinfo[mo->reactiontime].speed;
 		}
+		else if (numspawnpoints < MAXHUNTEMERALDS)
+			spawnpoints[numspawnpoints++] = mo; // empty spawn points
+	}
+
+	for (mo = P_FindMobjFromType(MT_FLINGEMERALD, NULL); mo; mo = P_FindMobjFromType(MT_FLINGEMERALD, mo))
+	{
+		numwithemerald++;
+		emeraldsspawned |= mo->threshold;
 	}
 
 	if (numspawnpoints == 0)
@@ -1975,6 +1966,9 @@ static void P_AdjustMobjFloorZ_FFloors(mobj_t *mo, sector_t *sector, UINT8 motyp
 
 	thingtop = mo->z + mo->height;
 
+	if (!(sector->fofflags & P_FOFMOVEFLAGS(mo)))
+		return;
+
 	for (rover = sector->ffloors; rover; rover = rover->next)
 	{
 		if (!(rover->flags & FF_EXISTS))
@@ -3475,7 +3469,7 @@ void P_DestroyRobots(void)
 	mobj_t *mo;
 	thinker_t *think;
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (think = thlist[THINK_MOBJ].next; think != &thlist[THINK_MOBJ]; think = think->next)
 	{
 		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue; // not a mobj thinker
@@ -3499,6 +3493,9 @@ boolean P_CameraThinker(player_t *player, camera_t *thiscam, boolean resetcalled
 {
 	boolean itsatwodlevel = false;
 	postimg_t postimg = postimg_none;
+
+	P_ClearCameraCheck();
+
 	if (twodlevel
 		|| (thiscam == &camera && players[displayplayer].mo && (players[displayplayer].mo->flags2 & MF2_TWOD))
 		|| (thiscam == &camera2 && players[secondarydisplayplayer].mo && (players[secondarydisplayplayer].mo->flags2 & MF2_TWOD)))
@@ -3781,25 +3778,29 @@ animonly:
 	}
 }
 
-static void CalculatePrecipFloor(precipmobj_t *mobj)
+// Where a drop at x, y in the sector lands. Without slopes that's the same
+// for every drop, so the first one each tic keeps it in the sector for the rest.
+static fixed_t CalculatePrecipFloor(sector_t *sector, fixed_t x, fixed_t y)
 {
-	// recalculate floorz each time
-	const sector_t *mobjsecsubsec;
-	if (mobj && mobj->subsector && mobj->subsector->sector)
-		mobjsecsubsec = mobj->subsector->sector;
-	else
-		return;
-	mobj->floorz =
+	fixed_t floorz;
+#ifdef ESLOPE
+	boolean sloped = (sector->f_slope != NULL);
+#endif
+
+	if (sector->precipfloortic == leveltime + 1)
+		return sector->precipfloor;
+
+	floorz =
 #ifdef ESLOPE
-				mobjsecsubsec->f_slope ? P_GetZAt(mobjsecsubsec->f_slope, mobj->x, mobj->y) :
+				sector->f_slope ? P_GetZAt(sector->f_slope, x, y) :
 #endif
-				mobjsecsubsec->floorheight;
-	if (mobjsecsubsec->ffloors)
+				sector->floorheight;
+	if (sector->ffloors)
 	{
 		ffloor_t *rover;
 		fixed_t topheight;
 
-		for (rover = mobjsecsubsec->ffloors; rover; rover = rover->next)
+		for (rover = sector->ffloors; rover; rover = rover->next)
 		{
 			// If it exists, it'll get rained on.
 			if (!(rover->flags & FF_EXISTS))
@@ -3810,88 +3811,38 @@ static void CalculatePrecipFloor(precipmobj_t *mobj)
 
 #ifdef ESLOPE
 			if (*rover->t_slope)
-				topheight = P_GetZAt(*rover->t_slope, mobj->x, mobj->y);
+			{
+				topheight = P_GetZAt(*rover->t_slope, x, y);
+				sloped = true;
+			}
 			else
 #endif
 			topheight = *rover->topheight;
 
-			if (topheight > mobj->floorz)
-				mobj->floorz = topheight;
+			if (topheight > floorz)
+				floorz = topheight;
 		}
 	}
+
+#ifdef ESLOPE
+	if (!sloped)
+#endif
+	{
+		sector->precipfloor = floorz;
+		sector->precipfloortic = leveltime + 1;
+	}
+	return floorz;
 }
 
 void P_RecalcPrecipInSector(sector_t *sector)
 {
-	mprecipsecnode_t *psecnode;
-
 	if (!sector)
 		return;
 
+	// Drops find their floor as they're drawn, so all there is to
+	// update is the floor they share.
+	sector->precipfloortic = 0;
 	sector->moved = true; // Recalc lighting and things too, maybe
-
-	for (psecnode = sector->touching_preciplist; psecnode; psecnode = psecnode->m_thinglist_next)
-		CalculatePrecipFloor(psecnode->m_thing);
-}
-
-//
-// P_NullPrecipThinker
-//
-// For "Blank" precipitation
-//
-void P_NullPrecipThinker(precipmobj_t *mobj)
-{
-	//(void)mobj;
-	mobj->precipflags &= ~PCF_THUNK;
-}
-
-void P_SnowThinker(precipmobj_t *mobj)
-{
-	P_CycleStateAnimation((mobj_t *)mobj);
-
-	// adjust height
-	if ((mobj->z += mobj->momz) <= mobj->floorz)
-		mobj->z = mobj->ceilingz;
-}
-
-void P_RainThinker(precipmobj_t *mobj)
-{
-	P_CycleStateAnimation((mobj_t *)mobj);
-
-	if (mobj->state != &states[S_RAIN1])
-	{
-		// cycle through states,
-		// calling action functions at transitions
-		if (mobj->tics <= 0)
-			return;
-
-		if (--mobj->tics)
-			return;
-
-		if (!P_SetPrecipMobjState(mobj, mobj->state->nextstate))
-			return;
-
-		if (mobj->state != &states[S_RAINRETURN])
-			return;
-
-		mobj->z = mobj->ceilingz;
-		P_SetPrecipMobjState(mobj, S_RAIN1);
-
-		return;
-	}
-
-	// adjust height
-	if ((mobj->z += mobj->momz) <= mobj->floorz)
-	{
-		// no splashes on sky or bottomless pits
-		if (mobj->precipflags & PCF_PIT)
-			mobj->z = mobj->ceilingz;
-		else
-		{
-			mobj->z = mobj->floorz;
-			P_SetPrecipMobjState(mobj, S_SPLASH1);
-		}
-	}
 }
 
 static void P_RingThinker(mobj_t *mobj)
@@ -3932,9 +3883,9 @@ boolean P_BossTargetPlayer(mobj_t *actor, boolean closest)
 	// first time init, this allow minimum lastlook changes
 	if (actor->lastlook < 0)
 		actor->lastlook = P_RandomByte();
-	actor->lastlook &= PLAYERSMASK;
+	actor->lastlook %= MAXPLAYERS;
 
-	for( ; ; actor->lastlook = (actor->lastlook+1) & PLAYERSMASK)
+	for( ; ; actor->lastlook = (actor->lastlook+1) % MAXPLAYERS)
 	{
 		// save the first look so we stop next time.
 		if (stop < 0)
@@ -4255,7 +4206,7 @@ static void P_Boss3Thinker(mobj_t *mobj)
 
 			// scan the thinkers to make sure all the old pinch dummies are gone before making new ones
 			// this can happen if the boss was hurt earlier than expected
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			{
 				if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 					continue;
@@ -4332,7 +4283,6 @@ static void P_Boss3Thinker(mobj_t *mobj)
 	}
 	else if (mobj->threshold >= 0) // Traveling mode
 	{
-		thinker_t *th;
 		mobj_t *mo2;
 		fixed_t dist, dist2;
 		fixed_t speed;
@@ -4346,13 +4296,9 @@ static void P_Boss3Thinker(mobj_t *mobj)
 		// scan the thinkers
 		// to find a point that matches
 		// the number
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-				continue;
-
-			mo2 = (mobj_t *)th;
-			if (mo2->type == MT_BOSS3WAYPOINT && mo2->spawnpoint && mo2->spawnpoint->angle == mobj->threshold)
+			if (mo2->spawnpoint && mo2->spawnpoint->angle == mobj->threshold)
 			{
 				P_SetTarget(&mobj->target, mo2);
 				break;
@@ -4518,6 +4464,7 @@ static void P_Boss4DestroyCage(void)
 						rover->flags &= ~FF_EXISTS;
 						sector->moved = true;
 						rsec->moved = true;
+						P_RecalcFOFFlags(rover->target);
 					}
 				}
 		}
@@ -4944,7 +4891,6 @@ static void P_Boss7Thinker(mobj_t *mobj)
 		fixed_t vertical, horizontal;
 		fixed_t airtime = 5*TICRATE;
 		INT32 waypointNum = 0;
-		thinker_t *th;
 		INT32 i;
 		boolean foundgoop = false;
 		INT32 closestNum;
@@ -4967,13 +4913,9 @@ static void P_Boss7Thinker(mobj_t *mobj)
 				closestdist = 16384*FRACUNIT; // Just in case...
 
 				// Find waypoint he is closest to
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-					if (mo2->type == MT_BOSS3WAYPOINT && mo2->spawnpoint)
+					if (mo2->spawnpoint)
 					{
 						dist = P_AproxDistance(players[i].mo->x - mo2->x, players[i].mo->y - mo2->y);
 
@@ -5022,13 +4964,9 @@ static void P_Boss7Thinker(mobj_t *mobj)
 
 		// scan the thinkers to find
 		// the waypoint to use
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_BOSS3WAYPOINT, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-				continue;
-
-			mo2 = (mobj_t *)th;
-			if (mo2->type == MT_BOSS3WAYPOINT && mo2->spawnpoint && (mo2->spawnpoint->options & 7) == waypointNum)
+			if (mo2->spawnpoint && (mo2->spawnpoint->options & 7) == waypointNum)
 			{
 				hitspot = mo2;
 				break;
@@ -5132,7 +5070,6 @@ static void P_Boss9Thinker(mobj_t *mobj)
 
 	if (!mobj->tracer)
 	{
-		thinker_t *th;
 		mobj_t *mo2;
 		mobj_t *last=NULL;
 
@@ -5145,21 +5082,14 @@ static void P_Boss9Thinker(mobj_t *mobj)
 
 		// Run through the thinkers ONCE and find all of the MT_BOSS9GATHERPOINT in the map.
 		// Build a hoop linked list of 'em!
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_BOSS9GATHERPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_BOSS9GATHERPOINT, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-				continue;
-
-			mo2 = (mobj_t *)th;
-			if (mo2->type == MT_BOSS9GATHERPOINT)
-			{
-				if (last)
-					last->hnext = mo2;
-				else
-					mobj->hnext = mo2;
-				mo2->hprev = last;
-				last = mo2;
-			}
+			if (last)
+				last->hnext = mo2;
+			else
+				mobj->hnext = mo2;
+			mo2->hprev = last;
+			last = mo2;
 		}
 	}
 
@@ -5573,35 +5503,26 @@ static void P_Boss9Thinker(mobj_t *mobj)
 // Finds the CLOSEST axis to the source mobj
 mobj_t *P_GetClosestAxis(mobj_t *source)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *closestaxis = NULL;
 	fixed_t dist1, dist2 = 0;
 
 	// scan the thinkers to find the closest axis point
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_AXIS, NULL); mo2; mo2 = P_FindMobjFromType(MT_AXIS, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-
-		if (mo2->type == MT_AXIS)
+		if (closestaxis == NULL)
+		{
+			closestaxis = mo2;
+			dist2 = R_PointToDist2(source->x, source->y, mo2->x, mo2->y)-mo2->radius;
+		}
+		else
 		{
-			if (closestaxis == NULL)
+			dist1 = R_PointToDist2(source->x, source->y, mo2->x, mo2->y)-mo2->radius;
+
+			if (dist1 < dist2)
 			{
 				closestaxis = mo2;
-				dist2 = R_PointToDist2(source->x, source->y, mo2->x, mo2->y)-mo2->radius;
-			}
-			else
-			{
-				dist1 = R_PointToDist2(source->x, source->y, mo2->x, mo2->y)-mo2->radius;
-
-				if (dist1 < dist2)
-				{
-					closestaxis = mo2;
-					dist2 = dist1;
-				}
+				dist2 = dist1;
 			}
 		}
 	}
@@ -5824,6 +5745,7 @@ void P_SetScale(mobj_t *mobj, fixed_t newscale)
 
 	mobj->radius = FixedMul(mobj->info->radius, newscale);
 	mobj->height = FixedMul(mobj->info->height, newscale);
+	P_UpdateStaticThing(mobj);
 
 	player = mobj->player;
 
@@ -6174,6 +6096,68 @@ static void P_KoopaThinker(mobj_t *koopa)
 //
 // P_MobjThinker
 //
+boolean p_ringsdoze;
+
+//
+// P_CheckRingsDoze
+//
+// Rings can only doze while nothing could pull them in.
+//
+void P_CheckRingsDoze(void)
+{
+	INT32 i;
+
+	p_ringsdoze = true;
+
+#ifdef HAVE_BLUA
+	if (LUA_HasAction("A_ATTRACTCHASE"))
+	{
+		p_ringsdoze = false;
+		return;
+	}
+#endif
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i] && (players[i].powers[pw_shield] & SH_NOSTACK) == SH_ATTRACT)
+		{
+			p_ringsdoze = false;
+			return;
+		}
+}
+
+//
+// P_MobjCanDoze
+//
+// Whether the next P_MobjThinker would do nothing but P_CycleMobjState
+// and the flag clearing at its start. Only right for the mobjs that
+// P_MobjThinker marks MFE_DORMANT: rings, and scenery with no special
+// handling of its own. Anything else that can be seen from the outside,
+// such as momentum being given or a target being set, is checked again
+// here every tic, so only what can't be seen needs to wake a mobj.
+//
+static boolean P_MobjCanDoze(mobj_t *mobj)
+{
+	if (mobj->fuse || mobj->momx || mobj->momy || mobj->momz)
+		return false;
+	if (mobj->target || mobj->tracer || mobj->scale != mobj->destscale)
+		return false;
+	if (!mobj->subsector || GETSECSPECIAL(mobj->subsector->sector->special, 2) == 8)
+		return false;
+#ifdef HAVE_BLUA
+	if (LUAh_MobjHasHook(mobj, hook_MobjThinker))
+		return false;
+#endif
+
+	if (mobj->flags & MF_SCENERY) // see P_SceneryThinker
+		return !(mobj->flags & MF_BOXICON) && mobj->eflags & MFE_ONGROUND
+			&& !(mobj->eflags & MFE_JUSTHITFLOOR) && !mobj->pmomz && !P_IsObjectInGoop(mobj)
+			&& ((mobj->eflags & MFE_VERTICALFLIP) ? mobj->z + mobj->height == mobj->ceilingz : mobj->z == mobj->floorz);
+
+	// see A_AttractChase, which has to run after any state change
+	return p_ringsdoze && mobj->tics == -1 && mobj->health > 0 && !(mobj->flags & (MF_PUSHABLE|MF_BOSS|MF_NOCLIP))
+		&& !(mobj->flags2 & (MF2_NIGHTSPULL|MF2_DONTDRAW));
+}
+
 void P_MobjThinker(mobj_t *mobj)
 {
 	I_Assert(mobj != NULL);
@@ -6182,6 +6166,19 @@ void P_MobjThinker(mobj_t *mobj)
 	if (mobj->flags & MF_NOTHINK)
 		return;
 
+	if (mobj->eflags & MFE_DORMANT)
+	{
+		if (P_MobjCanDoze(mobj))
+		{
+			mobj->flags2 &= ~MF2_PUSHED;
+			mobj->eflags &= ~MFE_SPRUNG;
+			tmfloorthing = tmhitthing = NULL;
+			P_CycleMobjState(mobj); // a new state wakes it
+			return;
+		}
+		mobj->eflags &= ~MFE_DORMANT;
+	}
+
 	// Remove dead target/tracer.
 	if (mobj->target && P_MobjWasRemoved(mobj->target))
 		P_SetTarget(&mobj->target, NULL);
@@ -6248,6 +6245,8 @@ void P_MobjThinker(mobj_t *mobj)
 	// Special thinker for scenery objects
 	if (mobj->flags & MF_SCENERY)
 	{
+		boolean candoze = false;
+
 #ifdef HAVE_BLUA
 		if (LUAh_MobjThinker(mobj))
 			return;
@@ -6490,10 +6489,14 @@ void P_MobjThinker(mobj_t *mobj)
 						return;
 					}
 				}
+				else
+					candoze = true;
 				break;
 		}
 
 		P_SceneryThinker(mobj);
+		if (candoze && !P_MobjWasRemoved(mobj) && P_MobjCanDoze(mobj))
+			mobj->eflags |= MFE_DORMANT;
 		return;
 	}
 
@@ -6507,7 +6510,7 @@ void P_MobjThinker(mobj_t *mobj)
 	else if (!mobj->player->spectator)
 	{
 		// You cannot short-circuit the player thinker like you can other thinkers.
-		LUAh_MobjThinker(mobj);
+		(void)LUAh_MobjThinker(mobj);
 		if (P_MobjWasRemoved(mobj))
 			return;
 	}
@@ -7069,6 +7072,8 @@ void P_MobjThinker(mobj_t *mobj)
 				P_NightsItemChase(mobj);
 			else
 				A_AttractChase(mobj);
+			if (!P_MobjWasRemoved(mobj) && P_MobjCanDoze(mobj))
+				mobj->eflags |= MFE_DORMANT;
 			return;
 		// Flung items
 		case MT_FLINGRING:
@@ -7637,12 +7642,13 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
 {
 	const mobjinfo_t *info = &mobjinfo[type];
 	state_t *st;
-	mobj_t *mobj = Z_Calloc(sizeof (*mobj), PU_LEVEL, NULL);
+	mobj_t *mobj = Z_PoolCalloc(&mobjpool);
 
 	// this is officially a mobj, declared as soon as possible.
 	mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
 	mobj->type = type;
 	mobj->info = info;
+	P_LinkMobjType(mobj);
 
 	mobj->x = x;
 	mobj->y = y;
@@ -7844,7 +7850,7 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
 	}
 
 	if (!(mobj->flags & MF_NOTHINK))
-		P_AddThinker(&mobj->thinker);
+		P_AddThinker(THINK_MOBJ, &mobj->thinker);
 
 	// Call action functions when the state is set
 	if (st->action.acp1 && (mobj->flags & MF_RUNSPAWNFUNC))
@@ -7864,7 +7870,10 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
 #ifdef HAVE_BLUA
 			astate = st;
 #endif
-			st->action.acp1(mobj);
+			if (ps_tickprofiling)
+				PS_RunAction(st->action.acp1, mobj);
+			else
+				st->action.acp1(mobj);
 			// DANGER! This can cause P_SpawnMobj to return NULL!
 			// Avoid using MF_RUNSPAWNFUNC on mobjs whose spawn state expects target or tracer to already be set!
 			if (P_MobjWasRemoved(mobj))
@@ -7878,70 +7887,83 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
 	return mobj;
 }
 
-static precipmobj_t *P_SpawnPrecipMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
-{
-	state_t *st;
-	precipmobj_t *mobj = Z_Calloc(sizeof (*mobj), PU_LEVEL, NULL);
-	fixed_t starting_floorz;
-
-	mobj->x = x;
-	mobj->y = y;
-	mobj->flags = mobjinfo[type].flags;
-
-	// do not set the state with P_SetMobjState,
-	// because action routines can not be called yet
-	st = &states[mobjinfo[type].spawnstate];
-
-	mobj->state = st;
-	mobj->tics = st->tics;
-	mobj->sprite = st->sprite;
-	mobj->frame = st->frame; // FF_FRAMEMASK for frame, and other bits..
-	mobj->anim_duration = (UINT16)st->var2; // only used if FF_ANIMATE is set
-
-	// set subsector and/or block links
-	P_SetPrecipitationThingPosition(mobj);
-
-	mobj->floorz = starting_floorz =
-#ifdef ESLOPE
-				mobj->subsector->sector->f_slope ? P_GetZAt(mobj->subsector->sector->f_slope, x, y) :
-#endif
-				mobj->subsector->sector->floorheight;
-	mobj->ceilingz =
-#ifdef ESLOPE
-				mobj->subsector->sector->c_slope ? P_GetZAt(mobj->subsector->sector->c_slope, x, y) :
-#endif
-				mobj->subsector->sector->ceilingheight;
-
-	mobj->z = z;
-	mobj->momz = mobjinfo[type].speed;
-
-	mobj->thinker.function.acp1 = (actionf_p1)P_NullPrecipThinker;
-	P_AddThinker(&mobj->thinker);
+//
+// MOBJ TYPE LISTS
+//
+// Every mobj is also on a list of the others of its type, in the order
+// they were spawned, so bosses and linedef executors looking for their
+// waypoints by tag or sequence don't have to walk every thinker.
+//
+static mobj_t *typelists[NUMMOBJTYPES];
+static mobj_t **typetails[NUMMOBJTYPES];
 
-	CalculatePrecipFloor(mobj);
+//
+// P_ClearMobjTypeLists
+//
+// For when every mobj is about to go at once.
+//
+void P_ClearMobjTypeLists(void)
+{
+	size_t i;
 
-	if (mobj->floorz != starting_floorz)
-		mobj->precipflags |= PCF_FOF;
-	else if (GETSECSPECIAL(mobj->subsector->sector->special, 1) == 7
-	 || GETSECSPECIAL(mobj->subsector->sector->special, 1) == 6
-	 || mobj->subsector->sector->floorpic == skyflatnum)
-		mobj->precipflags |= PCF_PIT;
+	for (i = 0; i < NUMMOBJTYPES; i++)
+	{
+		typelists[i] = NULL;
+		typetails[i] = &typelists[i];
+	}
+}
 
-	return mobj;
+//
+// P_LinkMobjType
+//
+// Puts a mobj at the end of its type's list.
+//
+void P_LinkMobjType(mobj_t *mobj)
+{
+	mobj->typenext = NULL;
+	mobj->typeprev = typetails[mobj->type];
+	*typetails[mobj->type] = mobj;
+	typetails[mobj->type] = &mobj->typenext;
 }
 
-static inline precipmobj_t *P_SpawnRainMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
+//
+// P_UnlinkMobjType
+//
+// Takes a mobj off its type's list, before it goes or changes type.
+//
+void P_UnlinkMobjType(mobj_t *mobj)
 {
-	precipmobj_t *mo = P_SpawnPrecipMobj(x,y,z,type);
-	mo->precipflags |= PCF_RAIN;
-	//mo->thinker.function.acp1 = (actionf_p1)P_RainThinker;
-	return mo;
+	if (!mobj->typeprev)
+		return;
+	if ((*mobj->typeprev = mobj->typenext) != NULL)
+		mobj->typenext->typeprev = mobj->typeprev;
+	else
+		typetails[mobj->type] = mobj->typeprev;
+	mobj->typeprev = NULL;
 }
 
-static inline precipmobj_t *P_SpawnSnowMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
+/** Searches for the next mobj of a type.
+  *
+  * \param type  Type of mobj to look for.
+  * \param start NULL to start anew, or the result of a previous call to
+  *              keep searching.
+  * \return The next mobj of that type, in the order they were spawned,
+  *         or NULL if there are no more.
+  */
+mobj_t *P_FindMobjFromType(mobjtype_t type, mobj_t *start)
 {
-	precipmobj_t *mo = P_SpawnPrecipMobj(x,y,z,type);
-	//mo->thinker.function.acp1 = (actionf_p1)P_SnowThinker;
+	mobj_t *mo;
+
+	// Action vars can ask for anything
+	if ((UINT32)type >= NUMMOBJTYPES)
+		return NULL;
+
+	mo = start ? start->typenext : typelists[type];
+
+	// One can be removed while it's being looked at, and it still
+	// points on to the rest
+	while (mo && P_MobjWasRemoved(mo))
+		mo = mo->typenext;
 	return mo;
 }
 
@@ -7963,7 +7985,7 @@ void P_RemoveMobj(mobj_t *mobj)
 		return; // something already removing this mobj.
 
 	mobj->thinker.function.acp1 = (actionf_p1)P_RemoveThinkerDelayed; // shh. no recursing.
-	LUAh_MobjRemoved(mobj);
+	(void)LUAh_MobjRemoved(mobj);
 	mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker; // needed for P_UnsetThingPosition, etc. to work.
 #else
 	I_Assert(!P_MobjWasRemoved(mobj));
@@ -7999,6 +8021,7 @@ void P_RemoveMobj(mobj_t *mobj)
 		P_DelSeclist(sector_list);
 		sector_list = NULL;
 	}
+	P_UnlinkMobjType(mobj);
 	mobj->flags |= MF_NOSECTOR|MF_NOBLOCKMAP;
 	mobj->subsector = NULL;
 	mobj->state = NULL;
@@ -8027,7 +8050,7 @@ void P_RemoveMobj(mobj_t *mobj)
 		else
 		{ // Add thinker just to delay removing it until refrences are gone.
 			mobj->flags &= ~MF_NOTHINK;
-			P_AddThinker((thinker_t *)mobj);
+			P_AddThinker(THINK_MOBJ, (thinker_t *)mobj);
 #ifdef SCRAMBLE_REMOVED
 			// Invalidate mobj_t data to cause crashes if accessed!
 			memset((UINT8 *)mobj + sizeof(thinker_t), 0xff, sizeof(mobj_t) - sizeof(thinker_t));
@@ -8054,21 +8077,6 @@ boolean P_MobjWasRemoved(mobj_t *mobj)
 	return true;
 }
 
-void P_RemovePrecipMobj(precipmobj_t *mobj)
-{
-	// unlink from sector and block lists
-	P_UnsetPrecipThingPosition(mobj);
-
-	if (precipsector_list)
-	{
-		P_DelPrecipSeclist(precipsector_list);
-		precipsector_list = NULL;
-	}
-
-	// free block
-	P_RemoveThinker((thinker_t *)mobj);
-}
-
 // Clearing out stuff for savegames
 void P_RemoveSavegameMobj(mobj_t *mobj)
 {
@@ -8096,26 +8104,51 @@ static CV_PossibleValue_t flagtime_cons_t[] = {{0, "MIN"}, {300, "MAX"}, {0, NUL
 consvar_t cv_flagtime = {"flagtime", "30", CV_NETVAR|CV_CHEAT, flagtime_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_suddendeath = {"suddendeath", "Off", CV_NETVAR|CV_CHEAT, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+// The subsector each of the precipdensity spots in each blockmap cell
+// falls in, or NULL where nothing falls. Freed with the level.
+static subsector_t **precipspots = NULL;
+static INT32 precipspotspercell;
+
+// Mixes a cell and spot into something random looking, the same every time
+static UINT32 P_PrecipHash(UINT32 cell, UINT32 spot, UINT32 salt)
+{
+	UINT32 h = cell * 0x9E3779B1 ^ spot * 0x85EBCA6B ^ salt * 0xC2B2AE35;
+	h ^= h >> 16;
+	h *= 0x7FEB352D;
+	h ^= h >> 15;
+	h *= 0x846CA68B;
+	h ^= h >> 16;
+	return h;
+}
+
+static void P_PrecipSpot(INT32 cell, INT32 spot, fixed_t *x, fixed_t *y)
+{
+	UINT32 h = P_PrecipHash(cell, spot, 0);
+
+	// Same eighth-of-a-unit grid M_RandomKey used to pick from
+	*x = bmaporgx + (cell % bmapwidth) * MAPBLOCKSIZE + (((h & 0xFFFF) % (MAPBLOCKUNITS<<3)) << (FRACBITS-3));
+	*y = bmaporgy + (cell / bmapwidth) * MAPBLOCKSIZE + (((h >> 16) % (MAPBLOCKUNITS<<3)) << (FRACBITS-3));
+}
+
 void P_SpawnPrecipitation(void)
 {
-	INT32 i, j, mrand;
-	fixed_t basex, basey, x, y, height;
+	INT32 i, j;
+	fixed_t x, y;
 	subsector_t *precipsector = NULL;
-	precipmobj_t *rainmo = NULL;
 
 	if (dedicated || !cv_precipdensity.value || curWeather == PRECIP_NONE)
 		return;
 
+	P_ClearPrecipitation();
+	precipspotspercell = cv_precipdensity.value;
+	Z_Calloc(bmapwidth*bmapheight*precipspotspercell*sizeof (*precipspots), PU_LEVEL, &precipspots);
+
 	// Use the blockmap to narrow down our placing patterns
 	for (i = 0; i < bmapwidth*bmapheight; ++i)
 	{
-		basex = bmaporgx + (i % bmapwidth) * MAPBLOCKSIZE;
-		basey = bmaporgy + (i / bmapwidth) * MAPBLOCKSIZE;
-
-		for (j = 0; j < cv_precipdensity.value; ++j)
+		for (j = 0; j < precipspotspercell; ++j)
 		{
-			x = basex + ((M_RandomKey(MAPBLOCKUNITS<<3)<<FRACBITS)>>3);
-			y = basey + ((M_RandomKey(MAPBLOCKUNITS<<3)<<FRACBITS)>>3);
+			P_PrecipSpot(i, j, &x, &y);
 
 			precipsector = R_IsPointInSubsector(x, y);
 
@@ -8128,33 +8161,12 @@ void P_SpawnPrecipitation(void)
 			if (!(precipsector->sector->floorheight <= precipsector->sector->ceilingheight - (32<<FRACBITS)))
 				continue;
 
-			// Don't set height yet...
-			height = precipsector->sector->ceilingheight;
-
-			if (curWeather == PRECIP_SNOW)
-			{
-				// Not in a sector with visible sky -- exception for NiGHTS.
-				if (!(maptol & TOL_NIGHTS) && precipsector->sector->ceilingpic != skyflatnum)
-					continue;
-
-				rainmo = P_SpawnSnowMobj(x, y, height, MT_SNOWFLAKE);
-				mrand = M_RandomByte();
-				if (mrand < 64)
-					P_SetPrecipMobjState(rainmo, S_SNOW3);
-				else if (mrand < 144)
-					P_SetPrecipMobjState(rainmo, S_SNOW2);
-			}
-			else // everything else.
-			{
-				// Not in a sector with visible sky.
-				if (precipsector->sector->ceilingpic != skyflatnum)
-					continue;
-
-				rainmo = P_SpawnRainMobj(x, y, height, MT_RAIN);
-			}
+			// Not in a sector with visible sky -- exception for NiGHTS snow.
+			if (precipsector->sector->ceilingpic != skyflatnum
+				&& !(curWeather == PRECIP_SNOW && maptol & TOL_NIGHTS))
+				continue;
 
-			// Randomly assign a height, now that floorz is set.
-			rainmo->z = M_RandomRange(rainmo->floorz>>FRACBITS, rainmo->ceilingz>>FRACBITS)<<FRACBITS;
+			precipspots[i*precipspotspercell + j] = precipsector;
 		}
 	}
 
@@ -8170,6 +8182,161 @@ void P_SpawnPrecipitation(void)
 	}
 }
 
+void P_ClearPrecipitation(void)
+{
+	if (precipspots)
+		Z_Free(precipspots);
+}
+
+// Frame of st, elapsed tics after entering it
+static UINT32 P_PrecipFrame(const state_t *st, UINT32 elapsed)
+{
+	UINT32 frame = st->frame;
+
+	if (frame & FF_ANIMATE && st->var2 > 0)
+		frame += (elapsed / st->var2) % (st->var1 + 1);
+	return frame;
+}
+
+// A splash runs from S_SPLASH1 up to S_RAINRETURN. Finds the state
+// elapsed tics into it, or with a NULL st, how long the whole thing is.
+#define MAXSPLASHSTATES 16
+static UINT32 P_PrecipSplash(UINT32 elapsed, const state_t **st)
+{
+	const state_t *splash = &states[S_SPLASH1];
+	UINT32 tics = 0;
+	INT32 i;
+
+	for (i = 0; i < MAXSPLASHSTATES && splash != &states[S_RAINRETURN] && splash != &states[S_NULL]; i++)
+	{
+		if (st && elapsed < tics + (UINT32)max(splash->tics, 1))
+		{
+			*st = splash;
+			return elapsed - tics;
+		}
+		tics += max(splash->tics, 1);
+		splash = &states[splash->nextstate];
+	}
+	return tics;
+}
+
+// Makes up the drop at a spot, as it is this tic. Returns false if
+// there's nothing to draw.
+static boolean P_MakePrecipDrop(subsector_t *ss, INT32 cell, INT32 spot, precipdrop_t *drop)
+{
+	sector_t *sec = ss->sector;
+	const boolean snow = curWeather == PRECIP_SNOW;
+	const mobjinfo_t *info = &mobjinfo[snow ? MT_SNOWFLAKE : MT_RAIN];
+	const state_t *st = &states[info->spawnstate];
+	fixed_t floorz, ceilingz, fall;
+	UINT32 falltics, splashtics = 0, t;
+
+	P_PrecipSpot(cell, spot, &drop->x, &drop->y);
+	drop->subsector = ss;
+
+	floorz = CalculatePrecipFloor(sec, drop->x, drop->y);
+	ceilingz =
+#ifdef ESLOPE
+		sec->c_slope ? P_GetZAt(sec->c_slope, drop->x, drop->y) :
+#endif
+		sec->ceilingheight;
+	if (ceilingz <= floorz)
+		return false;
+
+	fall = abs(info->speed);
+	if (!fall)
+		fall = FRACUNIT;
+	falltics = (UINT32)((ceilingz - floorz) / fall) + 1;
+
+	if (snow)
+	{
+		// Some of the flakes are bigger than others
+		t = P_PrecipHash(cell, spot, 1) & 0xFF;
+		if (t < 64)
+			st += 2; // S_SNOW3
+		else if (t < 144)
+			st += 1; // S_SNOW2
+	}
+	else
+	{
+		// no splashes on sky or bottomless pits, unless there's an FOF in the way
+		if (!(GETSECSPECIAL(sec->special, 1) == 7 || GETSECSPECIAL(sec->special, 1) == 6 || sec->floorpic == skyflatnum)
+			|| floorz != (
+#ifdef ESLOPE
+				sec->f_slope ? P_GetZAt(sec->f_slope, drop->x, drop->y) :
+#endif
+				sec->floorheight))
+			splashtics = P_PrecipSplash(0, NULL);
+	}
+
+	// Each drop is somewhere else along its fall
+	t = (leveltime + P_PrecipHash(cell, spot, 2)) % (falltics + splashtics);
+
+	if (t < falltics)
+		drop->z = ceilingz - (fixed_t)t * fall;
+	else
+	{
+		t = P_PrecipSplash(t - falltics, &st);
+		drop->z = floorz;
+	}
+
+	drop->sprite = st->sprite;
+	drop->frame = P_PrecipFrame(st, t);
+	return true;
+}
+
+//
+// P_IteratePrecipitation
+//
+// Makes up every drop within (about) dist of x, y, or every drop
+// anywhere for a dist of 0, and passes each one to func.
+//
+void P_IteratePrecipitation(fixed_t x, fixed_t y, fixed_t dist, void (*func)(const precipdrop_t *))
+{
+	INT32 xl, xh, yl, yh, bx, by, cell, spot;
+	subsector_t *ss;
+	precipdrop_t drop;
+
+	if (!precipspots || curWeather == PRECIP_BLANK || curWeather == PRECIP_STORM_NORAIN)
+		return;
+
+	if (dist)
+	{
+		xl = (unsigned)(x - dist - bmaporgx)>>MAPBLOCKSHIFT;
+		xh = (unsigned)(x + dist - bmaporgx)>>MAPBLOCKSHIFT;
+		yl = (unsigned)(y - dist - bmaporgy)>>MAPBLOCKSHIFT;
+		yh = (unsigned)(y + dist - bmaporgy)>>MAPBLOCKSHIFT;
+
+		BMBOUNDFIX(xl, xh, yl, yh);
+
+		if (xh >= bmapwidth)
+			xh = bmapwidth - 1;
+		if (yh >= bmapheight)
+			yh = bmapheight - 1;
+	}
+	else
+	{
+		xl = yl = 0;
+		xh = bmapwidth - 1;
+		yh = bmapheight - 1;
+	}
+
+	for (by = yl; by <= yh; by++)
+		for (bx = xl; bx <= xh; bx++)
+		{
+			cell = by*bmapwidth + bx;
+			for (spot = 0; spot < precipspotspercell; spot++)
+			{
+				ss = precipspots[cell*precipspotspercell + spot];
+				if (!ss || !P_MakePrecipDrop(ss, cell, spot, &drop))
+					continue;
+				if (dist && P_AproxDistance(drop.x - x, drop.y - y) > dist)
+					continue;
+				func(&drop);
+			}
+		}
+}
+
 //
 // P_PrecipitationEffects
 //
@@ -9298,7 +9465,7 @@ ML_NOCLIMB : Direction not controllable
 		mobj->health = (mthing->angle / 360) + 1;
 
 		// See if other starposts exist in this level that have the same value.
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		{
 			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 				continue;
@@ -21,6 +21,9 @@
 // We need the thinker_t stuff.
 #include "d_think.h"
 
+// Objects are allocated from zone pools.
+#include "z_zone.h"
+
 // We need the WAD data structure for Map things, from the THINGS lump.
 #include "doomdata.h"
 
@@ -232,7 +235,8 @@ typedef enum
 	MFE_VERTICALFLIP      = 1<<5,
 	// Goo water
 	MFE_GOOWATER          = 1<<6,
-	// free: to and including 1<<7
+	// Dozing: nothing to think about but its state, see P_MobjThinker
+	MFE_DORMANT           = 1<<7,
 	// Mobj was already sprung this tic
 	MFE_SPRUNG            = 1<<8,
 	// Platform movement
@@ -240,45 +244,31 @@ typedef enum
 	// free: to and including 1<<15
 } mobjeflag_t;
 
-//
-// PRECIPITATION flags ?! ?! ?!
-//
-typedef enum {
-	// Don't draw.
-	PCF_INVISIBLE = 1,
-	// Above pit.
-	PCF_PIT = 2,
-	// Above FOF.
-	PCF_FOF = 4,
-	// Above MOVING FOF (this means we need to keep floorz up to date...)
-	PCF_MOVINGFOF = 8,
-	// Is rain.
-	PCF_RAIN = 16,
-	// Ran the thinker this tic.
-	PCF_THUNK = 32,
-} precipflag_t;
 // Map Object definition.
+//
+// Fields are in order of how often they're used. The first two cache
+// lines have what the thinkers and the collision checks look at for
+// every object on every tic, so a pass over hundreds of rings stays in
+// those. The rest come after, the rarely used last.
 typedef struct mobj_s
 {
 	// List: thinker links.
 	thinker_t thinker;
 
-	// Info for drawing: position.
+	// Info for drawing: position. (Also lines up with degenmobj_t.)
 	fixed_t x, y, z;
 
-	// More list: links in sector (if needed)
-	struct mobj_s *snext;
-	struct mobj_s **sprev; // killough 8/11/98: change to ptr-to-ptr
-
-	// More drawing info: to determine current sprite.
-	angle_t angle;  // orientation
-	spritenum_t sprite; // used to find patch_t and flip value
-	UINT32 frame; // frame number, plus bits see p_pspr.h
-	UINT16 anim_duration; // for FF_ANIMATE states
+	// Momentums, used to update position.
+	fixed_t momx, momy, momz;
 
-	struct msecnode_s *touching_sectorlist; // a linked list of sectors where this object appears
+	UINT32 flags; // flags from mobjinfo tables
+	INT32 tics; // state tic counter
 
+	state_t *state;
+	const mobjinfo_t *info; // &mobjinfo[mobj->type]
 	struct subsector_s *subsector; // Subsector the mobj resides in.
+	mobjtype_t type;
+	UINT32 flags2; // MF2_ flags
 
 	// The closest interval over all contacted sectors (or things).
 	fixed_t floorz; // Nearest floor below.
@@ -288,67 +278,90 @@ typedef struct mobj_s
 	fixed_t radius;
 	fixed_t height;
 
-	// Momentums, used to update position.
-	fixed_t momx, momy, momz;
-	fixed_t pmomz; // If you're on a moving floor, its "momz" would be here
-
-	INT32 tics; // state tic counter
-	state_t *state;
-	UINT32 flags; // flags from mobjinfo tables
-	UINT32 flags2; // MF2_ flags
+	fixed_t scale;
 	UINT16 eflags; // extra flags
+	UINT16 anim_duration; // for FF_ANIMATE states
+	angle_t angle;  // orientation
 
-	void *skin; // overrides 'sprite' when non-NULL (for player bodies to 'remember' the skin)
-	// Player and mobj sprites in multiplayer modes are modified
-	//  using an internal color lookup table for re-indexing.
-	UINT8 color; // This replaces MF_TRANSLATION. Use 0 for default (no translation).
+	// End of the first two cache lines.
+
+	// More list: links in sector (if needed)
+	struct mobj_s *snext;
+	struct mobj_s **sprev; // killough 8/11/98: change to ptr-to-ptr
 
 	// Interaction info, by BLOCKMAP.
 	// Links in blocks (if needed).
 	struct mobj_s *bnext;
 	struct mobj_s **bprev; // killough 8/11/98: change to ptr-to-ptr
 
-	// Additional pointers for NiGHTS hoops
-	struct mobj_s *hnext;
-	struct mobj_s *hprev;
+	struct msecnode_s *touching_sectorlist; // a linked list of sectors where this object appears
 
-	mobjtype_t type;
-	const mobjinfo_t *info; // &mobjinfo[mobj->type]
+	// More drawing info: to determine current sprite.
+	spritenum_t sprite; // used to find patch_t and flip value
+	UINT32 frame; // frame number, plus bits see p_pspr.h
 
+	fixed_t pmomz; // If you're on a moving floor, its "momz" would be here
 	INT32 health; // for player this is rings + 1
+	INT32 fuse; // Does something in P_MobjThinker on reaching 0.
+
+	fixed_t watertop; // top of the water FOF the mobj is in
+	fixed_t waterbottom; // bottom of the water FOF the mobj is in
+
+	struct mobj_s *target; // Thing being chased/attacked (or NULL), and originator for missiles.
+	struct mobj_s *tracer; // Thing being chased/attacked for tracers.
+
+	// Additional info record for player avatars only.
+	// Only valid if type == MT_PLAYER
+	struct player_s *player;
+
+#ifdef ESLOPE
+	struct pslope_s *standingslope; // The slope that the object is standing on (shouldn't need synced in savegames, right?)
+#endif
+
+	fixed_t friction;
+	fixed_t movefactor;
+
+	fixed_t destscale;
+	fixed_t scalespeed;
+
+	// Where it was at the start of the tic, for drawing in between (r_fps.c).
+	// Not part of the game state, so not saved or synced.
+	fixed_t old_x, old_y, old_z;
+	angle_t old_angle;
+	UINT32 old_stamp;
 
 	// Movement direction, movement generation (zig-zagging).
 	angle_t movedir; // dirtype_t 0-7; also used by Deton for up/down angle
 	INT32 movecount; // when 0, select a new dir
 
-	struct mobj_s *target; // Thing being chased/attacked (or NULL), and originator for missiles.
-
 	INT32 reactiontime; // If not 0, don't attack yet.
 
 	INT32 threshold; // If >0, the target will be chased no matter what.
 
-	// Additional info record for player avatars only.
-	// Only valid if type == MT_PLAYER
-	struct player_s *player;
-
 	INT32 lastlook; // Player number last looked for.
 
-	mapthing_t *spawnpoint; // Used for CTF flags, objectplace, and a handful other applications.
+	// Rarely used from here on.
 
-	struct mobj_s *tracer; // Thing being chased/attacked for tracers.
+	void *skin; // overrides 'sprite' when non-NULL (for player bodies to 'remember' the skin)
+	// Player and mobj sprites in multiplayer modes are modified
+	//  using an internal color lookup table for re-indexing.
+	UINT8 color; // This replaces MF_TRANSLATION. Use 0 for default (no translation).
 
-	fixed_t friction;
-	fixed_t movefactor;
+	// Or where it is in blockstatics instead
+	size_t staticcell;
+	size_t staticslot; // 0 if it isn't, or 1 + its index in the cell
 
-	INT32 fuse; // Does something in P_MobjThinker on reaching 0.
-	fixed_t watertop; // top of the water FOF the mobj is in
-	fixed_t waterbottom; // bottom of the water FOF the mobj is in
+	// Additional pointers for NiGHTS hoops
+	struct mobj_s *hnext;
+	struct mobj_s *hprev;
 
-	UINT32 mobjnum; // A unique number for this mobj. Used for restoring pointers on save games.
+	mapthing_t *spawnpoint; // Used for CTF flags, objectplace, and a handful other applications.
 
-	fixed_t scale;
-	fixed_t destscale;
-	fixed_t scalespeed;
+	// Links in its type's list (see P_FindMobjFromType)
+	struct mobj_s *typenext;
+	struct mobj_s **typeprev;
+
+	UINT32 mobjnum; // A unique number for this mobj. Used for restoring pointers on save games.
 
 	// Extra values are for internal use for whatever you want
 	INT32 extravalue1;
@@ -359,8 +372,10 @@ typedef struct mobj_s
 	INT32 cusval;
 	INT32 cvmem;
 
-#ifdef ESLOPE
-	struct pslope_s *standingslope; // The slope that the object is standing on (shouldn't need synced in savegames, right?)
+#ifdef MOBJCONSISTANCY
+	// What it added to mobjconsistancy when last linked in. Not saved:
+	// loading a game links everything in again.
+	UINT32 consistancy;
 #endif
 
 	// WARNING: New fields must be added separately to savegame and Lua.
@@ -369,48 +384,17 @@ typedef struct mobj_s
 //
 // For precipitation
 //
-// Sometimes this is casted to a mobj_t,
-// so please keep the start of the
-// structure the same.
+// Weather has no objects of its own. Each blockmap cell has a few spots a
+// drop can fall at, and where the drop is along its fall follows from
+// leveltime, so drops are only made up, into one of these, to be drawn.
 //
-typedef struct precipmobj_s
+typedef struct
 {
-	// List: thinker links.
-	thinker_t thinker;
-
-	// Info for drawing: position.
 	fixed_t x, y, z;
-
-	// More list: links in sector (if needed)
-	struct precipmobj_s *snext;
-	struct precipmobj_s **sprev; // killough 8/11/98: change to ptr-to-ptr
-
-	// More drawing info: to determine current sprite.
-	angle_t angle;  // orientation
-	spritenum_t sprite; // used to find patch_t and flip value
+	spritenum_t sprite;
 	UINT32 frame; // frame number, plus bits see p_pspr.h
-	UINT16 anim_duration; // for FF_ANIMATE states
-
-	struct mprecipsecnode_s *touching_sectorlist; // a linked list of sectors where this object appears
-
-	struct subsector_s *subsector; // Subsector the mobj resides in.
-
-	// The closest interval over all contacted sectors (or things).
-	fixed_t floorz; // Nearest floor below.
-	fixed_t ceilingz; // Nearest ceiling above.
-
-	// For movement checking.
-	fixed_t radius; // Fixed at 2*FRACUNIT
-	fixed_t height; // Fixed at 4*FRACUNIT
-
-	// Momentums, used to update position.
-	fixed_t momx, momy, momz;
-	fixed_t precipflags; // fixed_t so it uses the same spot as "pmomz" even as we use precipflags_t for it
-
-	INT32 tics; // state tic counter
-	state_t *state;
-	INT32 flags; // flags from mobjinfo tables
-} precipmobj_t;
+	struct subsector_s *subsector; // Subsector the drop falls in.
+} precipdrop_t;
 
 typedef struct actioncache_s
 {
@@ -422,6 +406,8 @@ typedef struct actioncache_s
 
 extern actioncache_t actioncachehead;
 
+extern zpool_t mobjpool;
+
 void P_InitCachedActions(void);
 void P_RunCachedActions(void);
 void P_AddCachedAction(mobj_t *mobj, INT32 statenum);
@@ -436,17 +422,21 @@ void P_MovePlayerToStarpost(INT32 playernum);
 void P_AfterPlayerSpawn(INT32 playernum);
 
 void P_SpawnMapThing(mapthing_t *mthing);
+void P_ClearMobjTypeLists(void);
+void P_LinkMobjType(mobj_t *mobj);
+void P_UnlinkMobjType(mobj_t *mobj);
+mobj_t *P_FindMobjFromType(mobjtype_t type, mobj_t *start);
 void P_SpawnHoopsAndRings(mapthing_t *mthing);
 void P_SpawnHoopOfSomething(fixed_t x, fixed_t y, fixed_t z, fixed_t radius, INT32 number, mobjtype_t type, angle_t rotangle);
 void P_SpawnPrecipitation(void);
+extern boolean p_ringsdoze;
+void P_CheckRingsDoze(void);
+void P_ClearPrecipitation(void);
+void P_IteratePrecipitation(fixed_t x, fixed_t y, fixed_t dist, void (*func)(const precipdrop_t *));
 void P_SpawnParaloop(fixed_t x, fixed_t y, fixed_t z, fixed_t radius, INT32 number, mobjtype_t type, statenum_t nstate, angle_t rotangle, boolean spawncenter);
 boolean P_BossTargetPlayer(mobj_t *actor, boolean closest);
 boolean P_SupermanLook4Players(mobj_t *actor);
 void P_DestroyRobots(void);
-void P_SnowThinker(precipmobj_t *mobj);
-void P_RainThinker(precipmobj_t *mobj);
-void P_NullPrecipThinker(precipmobj_t *mobj);
-void P_RemovePrecipMobj(precipmobj_t *mobj);
 void P_SetScale(mobj_t *mobj, fixed_t newscale);
 void P_XYMovement(mobj_t *mo);
 void P_EmeraldManager(void);
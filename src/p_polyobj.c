@@ -143,13 +143,10 @@ FUNCINLINE static ATTRINLINE void Polyobj_vecSub2(vertex_t *dst, vertex_t *v1, v
 }
 
 // Add the polyobject's thinker to the thinker list
-// Unlike P_AddThinker, this adds it to the front of the list instead of the back, so that carrying physics can work right. -Red
+// Polyobject thinkers have their own list, which is run before the mobjs, so that carrying physics can work right. -Red
 FUNCINLINE static ATTRINLINE void PolyObj_AddThinker(thinker_t *th)
 {
-	thinkercap.next->prev = th;
-	th->next = thinkercap.next;
-	th->prev = &thinkercap;
-	thinkercap.next = th;
+	P_AddThinker(THINK_POLYOBJ, th);
 }
 
 //
@@ -735,6 +732,9 @@ static void Polyobj_moveToSpawnSpot(mapthing_t *anchor)
 		Polyobj_vecSub2(&(po->origVerts[i]), po->vertices[i], &sspot);
 	}
 
+	for (i = 0; i < po->numLines; ++i)
+		P_SetLineColl(po->lines[i]);
+
 	// attach to subsector
 	Polyobj_attachToSubsec(po);
 }
@@ -763,12 +763,24 @@ static void Polyobj_attachToSubsec(polyobj_t *po)
 		center_y += FixedDiv(po->vertices[i]->y, numVertices);
 	}
 
-	po->centerPt.x = center_x;
-	po->centerPt.y = center_y;
+	// Spinning in place leaves the center where it was, and so
+	// in the same subsector; skip looking it up again
+	if (po->attached && po->subsector
+		&& center_x == po->centerPt.x && center_y == po->centerPt.y)
+		ss = po->subsector;
+	else
+	{
+		po->centerPt.x = center_x;
+		po->centerPt.y = center_y;
+		ss = R_PointInSubsector(po->centerPt.x, po->centerPt.y);
+	}
 
-	ss = R_PointInSubsector(po->centerPt.x, po->centerPt.y);
+	// still goes to the front, as if it had been taken out and put back
+	if (po->attached)
+		M_DLListRemove(&po->link);
 
 	M_DLListInsert(&po->link, (mdllistitem_t **)(void *)(&ss->polyList));
+	po->subsector = ss;
 
 #ifdef R_LINKEDPORTALS
 	// set spawnSpot's groupid for correct portal sound behavior
@@ -778,20 +790,6 @@ static void Polyobj_attachToSubsec(polyobj_t *po)
 	po->attached = true;
 }
 
-//
-// Polyobj_removeFromSubsec
-//
-// Removes a polyobject from the subsector to which it is attached.
-//
-static void Polyobj_removeFromSubsec(polyobj_t *po)
-{
-	if (po->attached)
-	{
-		M_DLListRemove(&po->link);
-		po->attached = false;
-	}
-}
-
 // Blockmap Functions
 
 //
@@ -837,16 +835,26 @@ static void Polyobj_putLink(polymaplink_t *l)
 // bounding box intersects. This ensures the accurate level of clipping
 // which is present with linedefs but absent from most mobj interactions.
 //
+// If it's already linked, only the cells its bounding box entered or left
+// get a link added or taken away. The ones it still covers keep theirs,
+// moved to the front of the cell as if it had been unlinked and
+// linked again, so things find polyobjects in the same order either way.
+//
 static void Polyobj_linkToBlockmap(polyobj_t *po)
 {
 	fixed_t *blockbox = po->blockbox;
+	fixed_t oldbox[4];
+	polymaplink_t *l, **lp;
 	size_t i;
 	fixed_t x, y;
 
-	// never link a bad polyobject or a polyobject already linked
-	if (po->isBad || po->linked)
+	// never link a bad polyobject
+	if (po->isBad)
 		return;
 
+	if (po->linked)
+		M_Memcpy(oldbox, blockbox, sizeof(oldbox));
+
 	// 2/26/06: start line box with values of first vertex, not INT32_MIN/INT32_MAX
 	blockbox[BOXLEFT]   = blockbox[BOXRIGHT] = po->vertices[0]->x;
 	blockbox[BOXBOTTOM] = blockbox[BOXTOP]   = po->vertices[0]->y;
@@ -861,66 +869,56 @@ static void Polyobj_linkToBlockmap(polyobj_t *po)
 	blockbox[BOXTOP]    = (unsigned)(blockbox[BOXTOP]    - bmaporgy) >> MAPBLOCKSHIFT;
 	blockbox[BOXBOTTOM] = (unsigned)(blockbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
 
-	// link polyobject to every block its bounding box intersects
-	for (y = blockbox[BOXBOTTOM]; y <= blockbox[BOXTOP]; ++y)
+	if (!po->linked) // nothing to keep
 	{
-		for (x = blockbox[BOXLEFT]; x <= blockbox[BOXRIGHT]; ++x)
-		{
-			if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
-			{
-				polymaplink_t  *l = Polyobj_getLink();
-
-				l->po = po;
-
-				M_DLListInsert(&l->link,
-							(mdllistitem_t **)(&polyblocklinks[y*bmapwidth + x]));
-			}
-		}
+		oldbox[BOXLEFT] = oldbox[BOXBOTTOM] = 1;
+		oldbox[BOXRIGHT] = oldbox[BOXTOP] = 0;
 	}
 
-	po->linked = true;
-}
+	// keep or drop the links it already has
+	for (lp = &po->blocklinks; (l = *lp);)
+	{
+		x = (fixed_t)(l->cell % bmapwidth);
+		y = (fixed_t)(l->cell / bmapwidth);
 
-//
-// Polyobj_removeFromBlockmap
-//
-// Unlinks a polyobject from all blockmap cells it intersects and returns
-// its polymaplink objects to the free list.
-//
-static void Polyobj_removeFromBlockmap(polyobj_t *po)
-{
-	polymaplink_t *rover;
-	fixed_t *blockbox = po->blockbox;
-	INT32 x, y;
+		M_DLListRemove(&l->link);
 
-	// don't bother trying to unlink one that's not linked
-	if (!po->linked)
-		return;
+		if (x < blockbox[BOXLEFT] || x > blockbox[BOXRIGHT]
+			|| y < blockbox[BOXBOTTOM] || y > blockbox[BOXTOP])
+		{
+			*lp = l->ponext;
+			Polyobj_putLink(l);
+			continue;
+		}
+
+		M_DLListInsert(&l->link, (mdllistitem_t **)(&polyblocklinks[l->cell]));
+		lp = &l->ponext;
+	}
 
-	// search all cells the polyobject touches
+	// link polyobject to every block its bounding box newly intersects
 	for (y = blockbox[BOXBOTTOM]; y <= blockbox[BOXTOP]; ++y)
 	{
 		for (x = blockbox[BOXLEFT]; x <= blockbox[BOXRIGHT]; ++x)
 		{
-			if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
-			{
-				rover = polyblocklinks[y * bmapwidth + x];
+			if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
+				continue;
 
-				while (rover && rover->po != po)
-					rover = (polymaplink_t *)(rover->link.next);
+			if (x >= oldbox[BOXLEFT] && x <= oldbox[BOXRIGHT]
+				&& y >= oldbox[BOXBOTTOM] && y <= oldbox[BOXTOP])
+				continue; // already has one
 
-				// polyobject not in this cell? go on to next.
-				if (!rover)
-					continue;
+			l = Polyobj_getLink();
+			l->po = po;
+			l->cell = y*bmapwidth + x;
+			l->ponext = po->blocklinks;
+			po->blocklinks = l;
 
-				// remove this link from the blockmap and put it on the freelist
-				M_DLListRemove(&rover->link);
-				Polyobj_putLink(rover);
-			}
+			M_DLListInsert(&l->link,
+						(mdllistitem_t **)(&polyblocklinks[l->cell]));
 		}
 	}
 
-	po->linked = false;
+	po->linked = true;
 }
 
 // Movement functions
@@ -1034,14 +1032,13 @@ static void Polyobj_carryThings(polyobj_t *po, fixed_t dx, fixed_t dy)
 	{
 		for (x = po->blockbox[BOXLEFT]; x <= po->blockbox[BOXRIGHT]; ++x)
 		{
+			blockwalk_t walk;
 			mobj_t *mo;
 
 			if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 				continue;
 
-			mo = blocklinks[y * bmapwidth + x];
-
-			for (; mo; mo = mo->bnext)
+			for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
 			{
 				if (mo->lastlook == pomovecount)
 					continue;
@@ -1099,9 +1096,10 @@ static INT32 Polyobj_clipThings(polyobj_t *po, line_t *line)
 		{
 			if (!(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight))
 			{
-				mobj_t *mo = blocklinks[y * bmapwidth + x];
+				blockwalk_t walk;
+				mobj_t *mo;
 
-				for (; mo; mo = mo->bnext)
+				for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
 				{
 
 					// Don't scroll objects that aren't affected by gravity
@@ -1149,6 +1147,8 @@ static boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y)
 	vertex_t vec;
 	INT32 hitflags = 0;
 
+	P_ClearSightCache();
+
 	vec.x = x;
 	vec.y = y;
 
@@ -1162,7 +1162,10 @@ static boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y)
 
 	// translate each line
 	for (i = 0; i < po->numLines; ++i)
+	{
 		Polyobj_bboxAdd(po->lines[i]->bbox, &vec);
+		P_SetLineColl(po->lines[i]);
+	}
 
 	// check for blocking things (yes, it needs to be done separately)
 	for (i = 0; i < po->numLines; ++i)
@@ -1176,7 +1179,10 @@ static boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y)
 
 		// reset lines that have been moved
 		for (i = 0; i < po->numLines; ++i)
+		{
 			Polyobj_bboxSub(po->lines[i]->bbox, &vec);
+			P_SetLineColl(po->lines[i]);
+		}
 	}
 	else
 	{
@@ -1185,10 +1191,8 @@ static boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y)
 		po->spawnSpot.y += vec.y;
 
 		Polyobj_carryThings(po, x, y);
-		Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-		Polyobj_removeFromSubsec(po);   // unlink it from its subsector
-		Polyobj_linkToBlockmap(po);     // relink to blockmap
-		Polyobj_attachToSubsec(po);     // relink to subsector
+		Polyobj_linkToBlockmap(po); // relink to blockmap
+		Polyobj_attachToSubsec(po); // relink to subsector
 	}
 
 	return !(hitflags & 2);
@@ -1256,6 +1260,8 @@ static void Polyobj_rotateLine(line_t *ld)
 		ld->bbox[BOXBOTTOM] = v2->y;
 		ld->bbox[BOXTOP]    = v1->y;
 	}
+
+	P_SetLineColl(ld);
 }
 
 //
@@ -1278,14 +1284,13 @@ static void Polyobj_rotateThings(polyobj_t *po, vertex_t origin, angle_t delta,
 	{
 		for (x = po->blockbox[BOXLEFT]; x <= po->blockbox[BOXRIGHT]; ++x)
 		{
+			blockwalk_t walk;
 			mobj_t *mo;
 
 			if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 				continue;
 
-			mo = blocklinks[y * bmapwidth + x];
-
-			for (; mo; mo = mo->bnext)
+			for (mo = P_FirstBlockThing(&walk, x, y); mo; mo = P_NextBlockThing(&walk))
 			{
 				if (mo->lastlook == pomovecount)
 					continue;
@@ -1362,6 +1367,8 @@ static boolean Polyobj_rotate(polyobj_t *po, angle_t delta, UINT8 turnthings)
 	if (po->isBad)
 		return false;
 
+	P_ClearSightCache();
+
 	angle = (po->angle + delta) >> ANGLETOFINESHIFT;
 
 	// point about which to rotate is the spawn spot
@@ -1408,10 +1415,8 @@ static boolean Polyobj_rotate(polyobj_t *po, angle_t delta, UINT8 turnthings)
 		// update polyobject's angle
 		po->angle += delta;
 
-		Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-		Polyobj_removeFromSubsec(po);   // remove from subsector
-		Polyobj_linkToBlockmap(po);     // relink to blockmap
-		Polyobj_attachToSubsec(po);     // relink to subsector
+		Polyobj_linkToBlockmap(po); // relink to blockmap
+		Polyobj_attachToSubsec(po); // relink to subsector
 	}
 
 	return !(hitflags & 2);
@@ -1500,7 +1505,7 @@ void Polyobj_InitLevel(void)
 
 	// run down the thinker list, count the number of spawn points, and save
 	// the mobj_t pointers on a queue for use below.
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 		{
@@ -1780,7 +1785,6 @@ void T_PolyObjWaypoint(polywaypoint_t *th)
 	mobj_t *mo2;
 	mobj_t *target = NULL;
 	mobj_t *waypoint = NULL;
-	thinker_t *wp;
 	fixed_t adjustx, adjusty, adjustz;
 	fixed_t momx, momy, momz, dist;
 	INT32 start;
@@ -1804,16 +1808,8 @@ void T_PolyObjWaypoint(polywaypoint_t *th)
 
 	// Find out target first.
 	// We redo this each tic to make savegame compatibility easier.
-	for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+	for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 	{
-		if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-			continue;
-
-		mo2 = (mobj_t *)wp;
-
-		if (mo2->type != MT_TUBEWAYPOINT)
-			continue;
-
 		if (mo2->threshold == th->sequence && mo2->health == th->pointnum)
 		{
 			target = mo2;
@@ -1887,16 +1883,8 @@ void T_PolyObjWaypoint(polywaypoint_t *th)
 			CONS_Debug(DBG_POLYOBJ, "Looking for next waypoint...\n");
 
 			// Find next waypoint
-			for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+			for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 			{
-				if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-					continue;
-
-				mo2 = (mobj_t *)wp;
-
-				if (mo2->type != MT_TUBEWAYPOINT)
-					continue;
-
 				if (mo2->threshold == th->sequence)
 				{
 					if (th->direction == -1)
@@ -1926,16 +1914,8 @@ void T_PolyObjWaypoint(polywaypoint_t *th)
 					th->stophere = true;
 				}
 
-				for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-						continue;
-
-					mo2 = (mobj_t *)wp;
-
-					if (mo2->type != MT_TUBEWAYPOINT)
-						continue;
-
 					if (mo2->threshold == th->sequence)
 					{
 						if (th->direction == -1)
@@ -1963,16 +1943,8 @@ void T_PolyObjWaypoint(polywaypoint_t *th)
 				if (!th->continuous)
 					th->comeback = false;
 
-				for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-						continue;
-
-					mo2 = (mobj_t *)wp;
-
-					if (mo2->type != MT_TUBEWAYPOINT)
-						continue;
-
 					if (mo2->threshold == th->sequence)
 					{
 						if (th->direction == -1)
@@ -2441,7 +2413,6 @@ INT32 EV_DoPolyObjWaypoint(polywaypointdata_t *pwdata)
 	mobj_t *first = NULL;
 	mobj_t *last = NULL;
 	mobj_t *target = NULL;
-	thinker_t *wp;
 
 	if (!(po = Polyobj_GetForNum(pwdata->polyObjNum)))
 	{
@@ -2477,16 +2448,8 @@ INT32 EV_DoPolyObjWaypoint(polywaypointdata_t *pwdata)
 	th->stophere = false;
 
 	// Find the first waypoint we need to use
-	for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+	for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 	{
-		if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-			continue;
-
-		mo2 = (mobj_t *)wp;
-
-		if (mo2->type != MT_TUBEWAYPOINT)
-			continue;
-
 		if (mo2->threshold == th->sequence)
 		{
 			if (th->direction == -1) // highest waypoint #
@@ -2548,7 +2511,7 @@ INT32 EV_DoPolyObjWaypoint(polywaypointdata_t *pwdata)
 
 	// Find the actual target movement waypoint
 	target = first;
-	/*for (wp = thinkercap.next; wp != &thinkercap; wp = wp->next)
+	/*for (wp = thlist[THINK_MOBJ].next; wp != &thlist[THINK_MOBJ]; wp = wp->next)
 	{
 		if (wp->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
 			continue;
@@ -2801,10 +2764,8 @@ void T_PolyObjFlag(polymove_t *th)
 	for (i = 0; i < po->numLines; i++)
 		Polyobj_rotateLine(po->lines[i]);
 
-	Polyobj_removeFromBlockmap(po); // unlink it from the blockmap
-	Polyobj_removeFromSubsec(po);   // unlink it from its subsector
-	Polyobj_linkToBlockmap(po);     // relink to blockmap
-	Polyobj_attachToSubsec(po);     // relink to subsector
+	Polyobj_linkToBlockmap(po); // relink to blockmap
+	Polyobj_attachToSubsec(po); // relink to subsector
 }
 
 INT32 EV_DoPolyObjFlag(line_t *pfdata)
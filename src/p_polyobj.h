@@ -90,6 +90,8 @@ typedef struct polyobj_s
 
 	fixed_t blockbox[4]; // bounding box for clipping
 	UINT8 linked;         // is linked to blockmap
+	struct polymaplink_s *blocklinks; // its own links, one per blockmap cell
+	struct subsector_s *subsector;    // subsector it's attached to
 	size_t validcount;   // for clipping: prevents multiple checks
 	INT32 damage;        // damage to inflict on stuck things
 	fixed_t thrust;      // amount of thrust to put on blocking objects
@@ -102,6 +104,11 @@ typedef struct polyobj_s
 
 	struct visplane_s *visplane; // polyobject's visplane, for ease of putting into the list later
 
+	// where the view and the polyobject were when its segs were last sorted
+	boolean segsorted;
+	fixed_t segsortviewx, segsortviewy, segsortx, segsorty;
+	angle_t segsortviewangle, segsortangle;
+
 	// these are saved for netgames, so do not let Lua touch these!
 	INT32 spawnflags; // Flags the polyobject originally spawned with
 } polyobj_t;
@@ -114,6 +121,8 @@ typedef struct polymaplink_s
 {
 	mdllistitem_t link; // for blockmap links
 	polyobj_t *po;      // pointer to polyobject
+	struct polymaplink_s *ponext; // next in the polyobject's own links
+	size_t cell;        // blockmap cell it's in
 } polymaplink_t;
 
 //
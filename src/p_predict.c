@@ -0,0 +1,232 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_predict.c
+/// \brief Client-side prediction of the local player
+///
+///        Only the local player's player_t and mobj_t are run ahead, so
+///        those, the camera, the random seed and leveltime are all that
+///        get saved. Everything the player could do to the rest of the
+///        level is switched off while predicting: other things only block
+///        it, and damage, sector specials, linedef executors and sounds
+///        wait for the real tic. Things the player spawns on the way are
+///        removed again afterwards.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_clisrv.h"
+#include "g_game.h"
+#include "m_random.h"
+#include "p_local.h"
+#include "p_predict.h"
+#ifdef HAVE_BLUA
+#include "lua_hook.h"
+#endif
+
+consvar_t cv_netprediction = {"netprediction", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+boolean p_predicting = false;
+
+// How far ahead of the server to run at most
+#define MAXPREDICTTICS TICRATE
+
+static boolean predicted = false; // between P_PredictPlayer and P_UnpredictPlayer
+static player_t savedplayer;
+static mobj_t savedmobj;
+static camera_t savedcamera;
+static UINT32 savedseed;
+static tic_t savedleveltime;
+#ifdef MOBJCONSISTANCY
+static UINT32 savedconsistancy;
+#endif
+static thinker_t *lastthinkers[NUM_THINKERLISTS];
+
+// Player states the prediction would only get wrong: the server is
+// moving or holding the player, or the rest of the level will react.
+#define UNPREDICTABLEFLAGS (PF_CARRIED|PF_ROPEHANG|PF_ITEMHANG|PF_MACESPIN|PF_NIGHTSMODE|PF_NIGHTSFALL)
+
+static boolean P_CanPredict(player_t *player)
+{
+	if (!cv_netprediction.value || !netgame || !client || demoplayback)
+		return false;
+	if (gamestate != GS_LEVEL || paused || P_AutoPause() || splitscreen)
+		return false;
+	if (displayplayer != consoleplayer || !playeringame[consoleplayer])
+		return false;
+	if (!player->mo || P_MobjWasRemoved(player->mo) || player->playerstate != PST_LIVE)
+		return false;
+	if (player->exiting || player->pflags & UNPREDICTABLEFLAGS)
+		return false;
+#ifdef HAVE_BLUA
+	// A script could touch anything, and nothing here would undo it
+	if (LUAh_AnyHooks())
+		return false;
+#endif
+	return true;
+}
+
+void P_PredictPlayer(void)
+{
+	player_t *player = &players[consoleplayer];
+	ticcmd_t cmds[MAXPREDICTTICS];
+	mobj_t *mo;
+	INT32 i, n;
+
+	I_Assert(!predicted);
+
+	if (!P_CanPredict(player))
+		return;
+
+	n = CL_GetPredictedCmds(cmds, MAXPREDICTTICS);
+	if (!n)
+		return;
+
+	mo = player->mo;
+	savedplayer = *player;
+	savedmobj = *mo;
+	savedcamera = camera;
+	savedseed = P_GetRandSeed();
+	savedleveltime = leveltime;
+#ifdef MOBJCONSISTANCY
+	savedconsistancy = mobjconsistancy;
+#endif
+	for (i = 0; i < NUM_THINKERLISTS; i++)
+		lastthinkers[i] = thlist[i].prev;
+
+	// Keep the sectors' nodes for where the server left the player,
+	// so they can be put back as they were. The player gets new ones
+	// as soon as it moves.
+	mo->touching_sectorlist = NULL;
+
+	predicted = true;
+	p_predicting = true;
+	P_MapStart();
+
+	for (i = 0; i < n; i++)
+	{
+		// Drawn in between the last two tics, like everything else
+		if (i == n - 1)
+		{
+			mo->old_x = mo->x;
+			mo->old_y = mo->y;
+			mo->old_z = mo->z;
+			mo->old_angle = mo->angle;
+		}
+
+		player->cmd = cmds[i];
+		player->cmd.buttons &= ~BT_TOSSFLAG; // the flags belong to the server
+
+		P_PlayerThink(player);
+		if (player->mo != mo || P_MobjWasRemoved(mo))
+			break;
+		P_MobjThinker(mo);
+		if (P_MobjWasRemoved(mo))
+			break;
+		P_PlayerAfterThink(player);
+		leveltime++;
+
+		if (player->mo != mo || player->playerstate != PST_LIVE)
+			break;
+	}
+
+	P_MapEnd();
+	p_predicting = false;
+}
+
+static void P_RestoreTarget(mobj_t **mop, mobj_t *saved)
+{
+	// The reference counts have to match what's about to be put back
+	if (*mop != saved)
+		P_SetTarget(mop, saved);
+}
+
+void P_UnpredictPlayer(void)
+{
+	player_t *player = &players[consoleplayer];
+	mobj_t *mo, *typenext, **typeprev;
+	thinker_t *th, thinker;
+	boolean linked;
+	INT32 i;
+
+	if (!predicted)
+		return;
+	predicted = false;
+	mo = savedplayer.mo;
+	P_ClearTouchCache();
+
+	// Things spawned while running ahead go again. The thinkers stay
+	// in their lists until the next tic frees them, like any other.
+	for (i = 0; i < NUM_THINKERLISTS; i++)
+	{
+		for (th = lastthinkers[i]->next; th != &thlist[i]; th = th->next)
+		{
+			if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+				continue;
+			if (i == THINK_MOBJ)
+				P_RemoveMobj((mobj_t *)th);
+			else
+				P_RemoveThinker(th);
+		}
+	}
+
+	P_RestoreTarget(&player->awayviewmobj, savedplayer.awayviewmobj);
+	P_RestoreTarget(&player->axis1, savedplayer.axis1);
+	P_RestoreTarget(&player->axis2, savedplayer.axis2);
+	P_RestoreTarget(&player->capsule, savedplayer.capsule);
+	*player = savedplayer;
+
+	P_RestoreTarget(&mo->target, savedmobj.target);
+	P_RestoreTarget(&mo->tracer, savedmobj.tracer);
+
+	P_UnsetThingPosition(mo);
+	P_DelSeclist(sector_list);
+	sector_list = NULL;
+
+	// Its place in the thinker and type lists is wherever it is now
+	thinker = mo->thinker;
+	typenext = mo->typenext;
+	typeprev = mo->typeprev;
+	*mo = savedmobj;
+	mo->thinker = thinker;
+	mo->typenext = typenext;
+	mo->typeprev = typeprev;
+
+	// Go back into the sector and blockmap lists exactly where the
+	// player was, so nothing that walks them runs in another order.
+	linked = (mo->flags & MF_NOSECTOR || *mo->sprev == mo->snext)
+		&& (mo->flags & MF_NOBLOCKMAP || !mo->bprev || *mo->bprev == mo->bnext);
+	if (linked)
+	{
+		if (!(mo->flags & MF_NOSECTOR))
+		{
+			if (mo->snext)
+				mo->snext->sprev = &mo->snext;
+			*mo->sprev = mo;
+		}
+		if (!(mo->flags & MF_NOBLOCKMAP) && mo->bprev)
+		{
+			if (mo->bnext)
+				mo->bnext->bprev = &mo->bnext;
+			*mo->bprev = mo;
+		}
+	}
+	else
+	{
+		// Shouldn't happen, but at least be somewhere sane
+		sector_list = mo->touching_sectorlist;
+		mo->touching_sectorlist = NULL;
+		P_SetThingPosition(mo);
+	}
+
+	camera = savedcamera;
+	P_SetRandSeed(savedseed);
+	leveltime = savedleveltime;
+#ifdef MOBJCONSISTANCY
+	mobjconsistancy = savedconsistancy;
+#endif
+}
@@ -0,0 +1,39 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_predict.h
+/// \brief Client-side prediction of the local player
+///
+///        A client only runs a tic once the server has sent it, so its own
+///        ticcmds show up a round trip late. Before a frame is drawn, the
+///        local player is saved and run ahead on the ticcmds still waiting
+///        on the server, then put back once the view is drawn. Every real
+///        tic starts from the server's state again, so a wrong guess only
+///        lasts until the tics catch up.
+
+#ifndef __P_PREDICT__
+#define __P_PREDICT__
+
+#include "command.h"
+
+extern consvar_t cv_netprediction;
+
+// True while the local player is being run ahead. Anything the
+// prediction can't put back (damage, specials, sounds) checks this.
+extern boolean p_predicting;
+
+/**	\brief Runs the local player ahead of the server for this frame.
+	Always pair with P_UnpredictPlayer.
+*/
+void P_PredictPlayer(void);
+
+/**	\brief Puts the local player back where the server left it.
+*/
+void P_UnpredictPlayer(void);
+
+#endif // __P_PREDICT__
@@ -45,6 +45,13 @@ UINT8 *save_p;
 #define ARCHIVEBLOCK_POBJS    0x7F928546
 #define ARCHIVEBLOCK_THINKERS 0x7F37037C
 #define ARCHIVEBLOCK_SPECIALS 0x7F228378
+#define ARCHIVEBLOCK_PACKEDPLAYERS 0x7F4480C8
+
+// P_SaveNetSnapshot copies players and mobjs whole, so the archive is only
+// any good to the same build. It starts with what the structs looked like.
+#define PACKEDVERSION 1
+
+static boolean packedsave = false; // P_SaveNetSnapshot is writing
 
 // Note: This cannot be bigger
 // than an UINT16
@@ -105,6 +112,93 @@ static inline void P_UnArchivePlayer(void)
 		savedata.botskin = 0;
 }
 
+static inline UINT32 SaveMobjnum(const mobj_t *mobj)
+{
+	if (mobj) return mobj->mobjnum;
+	return 0;
+}
+
+static void P_WritePackedLayout(void)
+{
+	WRITEUINT32(save_p, PACKEDVERSION);
+	WRITEUINT32(save_p, sizeof (player_t));
+	WRITEUINT32(save_p, sizeof (mobj_t));
+	WRITEUINT32(save_p, NUMSTATES);
+	WRITEUINT32(save_p, NUMMOBJTYPES);
+}
+
+static boolean P_ReadPackedLayout(void)
+{
+	boolean ok = true;
+
+	ok &= (READUINT32(save_p) == PACKEDVERSION);
+	ok &= (READUINT32(save_p) == sizeof (player_t));
+	ok &= (READUINT32(save_p) == sizeof (mobj_t));
+	ok &= (READUINT32(save_p) == NUMSTATES);
+	ok &= (READUINT32(save_p) == NUMMOBJTYPES);
+	return ok;
+}
+
+//
+// P_NetArchivePackedPlayers
+//
+// Each player as it is, with the mobjs it points to as their mobjnums
+//
+static void P_NetArchivePackedPlayers(void)
+{
+	player_t packed;
+	INT32 i;
+
+	WRITEUINT32(save_p, ARCHIVEBLOCK_PACKEDPLAYERS);
+	P_WritePackedLayout();
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		if (!playeringame[i])
+			continue;
+
+		packed = players[i];
+		packed.mo = NULL;
+		packed.capsule = (mobj_t *)(size_t)SaveMobjnum(players[i].capsule);
+		packed.axis1 = (mobj_t *)(size_t)SaveMobjnum(players[i].axis1);
+		packed.axis2 = (mobj_t *)(size_t)SaveMobjnum(players[i].axis2);
+		packed.awayviewmobj = (mobj_t *)(size_t)SaveMobjnum(players[i].awayviewmobj);
+		WRITEMEM(save_p, &packed, sizeof (packed));
+	}
+}
+
+//
+// P_NetUnArchivePackedPlayers
+//
+static void P_NetUnArchivePackedPlayers(void)
+{
+	player_t packed;
+	INT32 i;
+
+	if (!P_ReadPackedLayout())
+		I_Error("Bad $$$.sav at archive block Players (from another build)");
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		if (!playeringame[i])
+			continue;
+
+		READMEM(save_p, &packed, sizeof (packed));
+
+		// What isn't sent in the field format either stays as it is
+		packed.mo = players[i].mo;
+		packed.cmd = players[i].cmd;
+		packed.skincolor = players[i].skincolor;
+		packed.skin = players[i].skin;
+		packed.bot = players[i].bot;
+#ifdef HWRENDER
+		packed.fovadd = players[i].fovadd;
+#endif
+		packed.viewheight = cv_viewheight.value<<FRACBITS;
+		players[i] = packed;
+	}
+}
+
 //
 // P_NetArchivePlayers
 //
@@ -114,6 +208,12 @@ static void P_NetArchivePlayers(void)
 	UINT16 flags;
 //	size_t q;
 
+	if (packedsave)
+	{
+		P_NetArchivePackedPlayers();
+		return;
+	}
+
 	WRITEUINT32(save_p, ARCHIVEBLOCK_PLAYERS);
 
 	for (i = 0; i < MAXPLAYERS; i++)
@@ -284,8 +384,14 @@ static void P_NetUnArchivePlayers(void)
 {
 	INT32 i, j;
 	UINT16 flags;
+	UINT32 magic = READUINT32(save_p);
 
-	if (READUINT32(save_p) != ARCHIVEBLOCK_PLAYERS)
+	if (magic == ARCHIVEBLOCK_PACKEDPLAYERS)
+	{
+		P_NetUnArchivePackedPlayers();
+		return;
+	}
+	if (magic != ARCHIVEBLOCK_PLAYERS)
 		I_Error("Bad $$$.sav at archive block Players");
 
 	for (i = 0; i < MAXPLAYERS; i++)
@@ -833,7 +939,10 @@ static void P_NetUnArchiveWorld(void)
 				fflr_diff = READUINT8(get);
 
 				if (fflr_diff & 1)
+				{
 					rover->flags = READUINT32(get);
+					P_RecalcFOFFlags(rover->target);
+				}
 				if (fflr_diff & 2)
 					rover->alpha = READINT16(get);
 
@@ -990,15 +1099,10 @@ typedef enum
 	tc_polyflag,
 	tc_polydisplace,
 #endif
+	tc_mobjpacked, // a whole mobj_t, from P_SaveNetSnapshot
 	tc_end
 } specials_e;
 
-static inline UINT32 SaveMobjnum(const mobj_t *mobj)
-{
-	if (mobj) return mobj->mobjnum;
-	return 0;
-}
-
 static UINT32 SaveSector(const sector_t *sector)
 {
 	if (sector) return (UINT32)(sector - sectors);
@@ -1017,6 +1121,52 @@ static inline UINT32 SavePlayer(const player_t *player)
 	return 0xFFFFFFFF;
 }
 
+//
+// SavePackedMobjThinker
+//
+// Saves a mobj_t as it is, with what it points to as numbers. Everything
+// that links it into the level is left out, and made again when it's loaded.
+//
+static void SavePackedMobjThinker(const mobj_t *mobj)
+{
+	mobj_t packed = *mobj;
+	UINT8 flag = 0;
+
+	if (mobj == redflag)
+		flag |= 1;
+	if (mobj == blueflag)
+		flag |= 2;
+
+	memset(&packed.thinker, 0, sizeof (packed.thinker));
+	packed.info = NULL;
+	packed.subsector = NULL;
+	packed.snext = packed.bnext = NULL;
+	packed.sprev = packed.bprev = NULL;
+	packed.touching_sectorlist = NULL;
+	packed.typenext = NULL;
+	packed.typeprev = NULL;
+	packed.staticcell = packed.staticslot = 0;
+#ifdef MOBJCONSISTANCY
+	packed.consistancy = 0;
+#endif
+
+	packed.state = (state_t *)(size_t)(mobj->state - states);
+	packed.target = (mobj_t *)(size_t)SaveMobjnum(mobj->target);
+	packed.tracer = (mobj_t *)(size_t)SaveMobjnum(mobj->tracer);
+	packed.hnext = (mobj_t *)(size_t)SaveMobjnum(mobj->hnext);
+	packed.hprev = (mobj_t *)(size_t)SaveMobjnum(mobj->hprev);
+	packed.player = (player_t *)(size_t)(mobj->player ? (mobj->player - players) + 1 : 0);
+	packed.skin = (void *)(size_t)(mobj->skin ? ((skin_t *)mobj->skin - skins) + 1 : 0);
+#ifdef ESLOPE
+	packed.standingslope = (pslope_t *)(size_t)(mobj->standingslope ? mobj->standingslope->id + 1 : 0);
+#endif
+	packed.spawnpoint = (mapthing_t *)(size_t)(mobj->spawnpoint ? (mobj->spawnpoint - mapthings) + 1 : 0);
+
+	WRITEUINT8(save_p, tc_mobjpacked);
+	WRITEUINT8(save_p, flag);
+	WRITEMEM(save_p, &packed, sizeof (packed));
+}
+
 //
 // SaveMobjThinker
 //
@@ -1040,6 +1190,12 @@ static void SaveMobjThinker(const thinker_t *th, const UINT8 type)
 	if (mobj->type == MT_HOOPCENTER && mobj->threshold == 4242)
 		return;
 
+	if (packedsave && mobj->type != MT_HOOPCENTER)
+	{
+		SavePackedMobjThinker(mobj);
+		return;
+	}
+
 	if (mobj->spawnpoint && mobj->info->doomednum != -1)
 	{
 		// spawnpoint is not modified but we must save it since it is an identifier
@@ -1510,18 +1666,17 @@ static void SaveLightlevelThinker(const thinker_t *th, const UINT8 type)
 }
 
 //
-// SaveExecutorThinker
+// SaveExecutorDelay
 //
-// Saves a executor_t thinker
+// Saves a executor_t, the same way as when it was a thinker
 //
-static void SaveExecutorThinker(const thinker_t *th, const UINT8 type)
+static void SaveExecutorDelay(executor_t *e)
 {
-	const executor_t *ht = (const void *)th;
-	WRITEUINT8(save_p, type);
-	WRITEUINT32(save_p, SaveLine(ht->line));
-	WRITEUINT32(save_p, SaveMobjnum(ht->caller));
-	WRITEUINT32(save_p, SaveSector(ht->sector));
-	WRITEINT32(save_p, ht->timer);
+	WRITEUINT8(save_p, tc_executor);
+	WRITEUINT32(save_p, SaveLine(e->line));
+	WRITEUINT32(save_p, SaveMobjnum(e->caller));
+	WRITEUINT32(save_p, SaveSector(e->sector));
+	WRITEINT32(save_p, P_ExecutorDelayTimer(e));
 }
 
 //
@@ -1674,212 +1829,249 @@ static void P_NetArchiveThinkers(void)
 {
 	const thinker_t *th;
 	UINT32 numsaved = 0;
+	UINT8 i;
 
 	WRITEUINT32(save_p, ARCHIVEBLOCK_THINKERS);
 
-	// save off the current thinkers
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	// save off the current thinkers, one list at a time
+	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
-		if (!(th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed
-		 || th->function.acp1 == (actionf_p1)P_NullPrecipThinker))
-			numsaved++;
-
-		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
-		{
-			SaveMobjThinker(th, tc_mobj);
-			continue;
-		}
-#ifdef PARANOIA
-		else if (th->function.acp1 == (actionf_p1)P_NullPrecipThinker);
-#endif
-		else if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
-		{
-			SaveCeilingThinker(th, tc_ceiling);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_CrushCeiling)
-		{
-			SaveCeilingThinker(th, tc_crushceiling);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_MoveFloor)
-		{
-			SaveFloormoveThinker(th, tc_floor);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_LightningFlash)
-		{
-			SaveLightflashThinker(th, tc_flash);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
+		for (th = thlist[i].next; th != &thlist[i]; th = th->next)
 		{
-			SaveStrobeThinker(th, tc_strobe);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_Glow)
-		{
-			SaveGlowThinker(th, tc_glow);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_FireFlicker)
-		{
-			SaveFireflickerThinker(th, tc_fireflicker);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_MoveElevator)
-		{
-			SaveElevatorThinker(th, tc_elevator);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_ContinuousFalling)
-		{
-			SaveSpecialLevelThinker(th, tc_continuousfalling);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_ThwompSector)
-		{
-			SaveSpecialLevelThinker(th, tc_thwomp);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_NoEnemiesSector)
-		{
-			SaveSpecialLevelThinker(th, tc_noenemies);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_EachTimeThinker)
-		{
-			SaveSpecialLevelThinker(th, tc_eachtime);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_RaiseSector)
-		{
-			SaveSpecialLevelThinker(th, tc_raisesector);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_CameraScanner)
-		{
-			SaveElevatorThinker(th, tc_camerascanner);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_Scroll)
-		{
-			SaveScrollThinker(th, tc_scroll);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_Friction)
-		{
-			SaveFrictionThinker(th, tc_friction);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_Pusher)
-		{
-			SavePusherThinker(th, tc_pusher);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_BounceCheese)
-		{
-			SaveSpecialLevelThinker(th, tc_bouncecheese);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_StartCrumble)
-		{
-			SaveElevatorThinker(th, tc_startcrumble);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_MarioBlock)
-		{
-			SaveSpecialLevelThinker(th, tc_marioblock);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_MarioBlockChecker)
-		{
-			SaveSpecialLevelThinker(th, tc_marioblockchecker);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_SpikeSector)
-		{
-			SaveSpecialLevelThinker(th, tc_spikesector);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_FloatSector)
-		{
-			SaveSpecialLevelThinker(th, tc_floatsector);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_BridgeThinker)
-		{
-			SaveSpecialLevelThinker(th, tc_bridgethinker);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_LaserFlash)
-		{
-			SaveLaserThinker(th, tc_laserflash);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_LightFade)
-		{
-			SaveLightlevelThinker(th, tc_lightfade);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_ExecutorDelay)
-		{
-			SaveExecutorThinker(th, tc_executor);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_Disappear)
-		{
-			SaveDisappearThinker(th, tc_disappear);
-			continue;
-		}
+			if (th->function.acp1 != (actionf_p1)P_RemoveThinkerDelayed)
+				numsaved++;
+
+			if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+			{
+				SaveMobjThinker(th, tc_mobj);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
+			{
+				SaveCeilingThinker(th, tc_ceiling);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_CrushCeiling)
+			{
+				SaveCeilingThinker(th, tc_crushceiling);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_MoveFloor)
+			{
+				SaveFloormoveThinker(th, tc_floor);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_LightningFlash)
+			{
+				SaveLightflashThinker(th, tc_flash);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
+			{
+				SaveStrobeThinker(th, tc_strobe);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_Glow)
+			{
+				SaveGlowThinker(th, tc_glow);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_FireFlicker)
+			{
+				SaveFireflickerThinker(th, tc_fireflicker);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_MoveElevator)
+			{
+				SaveElevatorThinker(th, tc_elevator);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_ContinuousFalling)
+			{
+				SaveSpecialLevelThinker(th, tc_continuousfalling);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_ThwompSector)
+			{
+				SaveSpecialLevelThinker(th, tc_thwomp);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_NoEnemiesSector)
+			{
+				SaveSpecialLevelThinker(th, tc_noenemies);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_EachTimeThinker)
+			{
+				SaveSpecialLevelThinker(th, tc_eachtime);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_RaiseSector)
+			{
+				SaveSpecialLevelThinker(th, tc_raisesector);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_CameraScanner)
+			{
+				SaveElevatorThinker(th, tc_camerascanner);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_Scroll)
+			{
+				SaveScrollThinker(th, tc_scroll);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_Friction)
+			{
+				SaveFrictionThinker(th, tc_friction);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_Pusher)
+			{
+				SavePusherThinker(th, tc_pusher);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_BounceCheese)
+			{
+				SaveSpecialLevelThinker(th, tc_bouncecheese);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_StartCrumble)
+			{
+				SaveElevatorThinker(th, tc_startcrumble);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_MarioBlock)
+			{
+				SaveSpecialLevelThinker(th, tc_marioblock);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_MarioBlockChecker)
+			{
+				SaveSpecialLevelThinker(th, tc_marioblockchecker);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_SpikeSector)
+			{
+				SaveSpecialLevelThinker(th, tc_spikesector);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_FloatSector)
+			{
+				SaveSpecialLevelThinker(th, tc_floatsector);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_BridgeThinker)
+			{
+				SaveSpecialLevelThinker(th, tc_bridgethinker);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_LaserFlash)
+			{
+				SaveLaserThinker(th, tc_laserflash);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_LightFade)
+			{
+				SaveLightlevelThinker(th, tc_lightfade);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_Disappear)
+			{
+				SaveDisappearThinker(th, tc_disappear);
+				continue;
+			}
 #ifdef POLYOBJECTS
-		else if (th->function.acp1 == (actionf_p1)T_PolyObjRotate)
-		{
-			SavePolyrotatetThinker(th, tc_polyrotate);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyObjMove)
-		{
-			SavePolymoveThinker(th, tc_polymove);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyObjWaypoint)
-		{
-			SavePolywaypointThinker(th, tc_polywaypoint);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyDoorSlide)
-		{
-			SavePolyslidedoorThinker(th, tc_polyslidedoor);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyDoorSwing)
-		{
-			SavePolyswingdoorThinker(th, tc_polyswingdoor);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyObjFlag)
-		{
-			SavePolymoveThinker(th, tc_polyflag);
-			continue;
-		}
-		else if (th->function.acp1 == (actionf_p1)T_PolyObjDisplace)
-		{
-			SavePolydisplaceThinker(th, tc_polydisplace);
-			continue;
-		}
+			else if (th->function.acp1 == (actionf_p1)T_PolyObjRotate)
+			{
+				SavePolyrotatetThinker(th, tc_polyrotate);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyObjMove)
+			{
+				SavePolymoveThinker(th, tc_polymove);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyObjWaypoint)
+			{
+				SavePolywaypointThinker(th, tc_polywaypoint);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyDoorSlide)
+			{
+				SavePolyslidedoorThinker(th, tc_polyslidedoor);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyDoorSwing)
+			{
+				SavePolyswingdoorThinker(th, tc_polyswingdoor);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyObjFlag)
+			{
+				SavePolymoveThinker(th, tc_polyflag);
+				continue;
+			}
+			else if (th->function.acp1 == (actionf_p1)T_PolyObjDisplace)
+			{
+				SavePolydisplaceThinker(th, tc_polydisplace);
+				continue;
+			}
 #endif
 #ifdef PARANOIA
-		else if (th->function.acv != P_RemoveThinkerDelayed) // wait garbage collection
-			I_Error("unknown thinker type %p", th->function.acp1);
+			else if (th->function.acv != P_RemoveThinkerDelayed) // wait garbage collection
+				I_Error("unknown thinker type %p", th->function.acp1);
 #endif
+		}
 	}
 
+	// and the delayed executors that used to be thinkers
+	P_IterateExecutorDelays(SaveExecutorDelay);
+
 	CONS_Debug(DBG_NETPLAY, "%u thinkers saved\n", numsaved);
 
 	WRITEUINT8(save_p, tc_end);
 }
 
+// The mobjs loaded, by mobjnum, so that relinking pointers doesn't go
+// through the whole list for each one. Made when it's first wanted, and
+// thrown out when another mobj is loaded or the load is done.
+static mobj_t **mobjsbynum = NULL;
+static UINT32 nummobjsbynum;
+
+static void P_FreeMobjsByNum(void)
+{
+	Z_Free(mobjsbynum);
+	mobjsbynum = NULL;
+	nummobjsbynum = 0;
+}
+
+static void P_MakeMobjsByNum(void)
+{
+	thinker_t *th;
+	mobj_t *mobj;
+	UINT32 count = 0;
+
+	// Numbers go from 1 to how many were saved; any others are searched for
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+			count++;
+
+	nummobjsbynum = count + 1;
+	mobjsbynum = Z_Calloc(nummobjsbynum * sizeof (*mobjsbynum), PU_STATIC, NULL);
+
+	// The first with each number, the same as searching the list would find
+	for (th = thlist[THINK_MOBJ].prev; th != &thlist[THINK_MOBJ]; th = th->prev)
+	{
+		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+			continue;
+
+		mobj = (mobj_t *)th;
+		if (mobj->mobjnum < nummobjsbynum)
+			mobjsbynum[mobj->mobjnum] = mobj;
+	}
+}
+
 // Now save the pointers, tracer and target, but at load time we must
 // relink to this; the savegame contains the old position in the pointer
 // field copyed in the info field temporarily, but finally we just search
@@ -1889,7 +2081,15 @@ mobj_t *P_FindNewPosition(UINT32 oldposition)
 	thinker_t *th;
 	mobj_t *mobj;
 
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	if (!mobjsbynum)
+		P_MakeMobjsByNum();
+
+	if (oldposition < nummobjsbynum)
+	{
+		if (mobjsbynum[oldposition])
+			return mobjsbynum[oldposition];
+	}
+	else for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -1962,13 +2162,13 @@ static void LoadMobjThinker(actionf_p1 thinker)
 			return;
 		}
 
-		mobj = Z_Calloc(sizeof (*mobj), PU_LEVEL, NULL);
+		mobj = Z_PoolCalloc(&mobjpool);
 
 		mobj->spawnpoint = &mapthings[spawnpointnum];
 		mapthings[spawnpointnum].mobj = mobj;
 	}
 	else
-		mobj = Z_Calloc(sizeof (*mobj), PU_LEVEL, NULL);
+		mobj = Z_PoolCalloc(&mobjpool);
 
 	// declare this as a valid mobj as soon as possible.
 	mobj->thinker.function.acp1 = thinker;
@@ -2147,6 +2347,7 @@ static void LoadMobjThinker(actionf_p1 thinker)
 
 	// set sprev, snext, bprev, bnext, subsector
 	P_SetThingPosition(mobj);
+	P_LinkMobjType(mobj);
 
 	mobj->mobjnum = READUINT32(save_p);
 
@@ -2158,11 +2359,107 @@ static void LoadMobjThinker(actionf_p1 thinker)
 			mobj->player->viewz = mobj->player->mo->z + mobj->player->viewheight;
 	}
 
-	P_AddThinker(&mobj->thinker);
+	P_AddThinker(THINK_MOBJ, &mobj->thinker);
+	P_FreeMobjsByNum();
 
 	mobj->info = (mobjinfo_t *)next; // temporarily, set when leave this function
 }
 
+//
+// LoadPackedMobjThinker
+//
+// Loads a mobj_t saved by SavePackedMobjThinker
+//
+static void LoadPackedMobjThinker(void)
+{
+	mobj_t *mobj = Z_PoolCalloc(&mobjpool);
+	UINT8 flag = READUINT8(save_p);
+	size_t n;
+
+	READMEM(save_p, mobj, sizeof (*mobj));
+
+	// None of these were saved, but they're made again below regardless
+	memset(&mobj->thinker, 0, sizeof (mobj->thinker));
+	mobj->subsector = NULL;
+	mobj->snext = mobj->bnext = NULL;
+	mobj->sprev = mobj->bprev = NULL;
+	mobj->touching_sectorlist = NULL;
+	mobj->typenext = NULL;
+	mobj->typeprev = NULL;
+	mobj->staticcell = mobj->staticslot = 0;
+
+	// declare this as a valid mobj as soon as possible.
+	mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
+
+	n = (size_t)mobj->state;
+	if (n >= NUMSTATES || (size_t)mobj->type >= NUMMOBJTYPES)
+		I_Error("Savegame corrupted");
+	mobj->state = &states[n];
+	mobj->info = &mobjinfo[mobj->type];
+
+	n = (size_t)mobj->player;
+	if (n)
+	{
+		if (n > MAXPLAYERS)
+			I_Error("Savegame corrupted");
+		mobj->player = &players[n - 1];
+		mobj->player->mo = mobj;
+		// added for angle prediction
+		if (consoleplayer == (INT32)n - 1)
+			localangle = mobj->angle;
+		if (secondarydisplayplayer == (INT32)n - 1)
+			localangle2 = mobj->angle;
+	}
+
+	n = (size_t)mobj->skin;
+	if (n)
+	{
+		if (n > (size_t)numskins)
+			I_Error("Savegame corrupted");
+		mobj->skin = &skins[n - 1];
+	}
+
+#ifdef ESLOPE
+	n = (size_t)mobj->standingslope;
+	mobj->standingslope = n ? P_SlopeById((UINT16)(n - 1)) : NULL;
+#endif
+
+	n = (size_t)mobj->spawnpoint;
+	if (n)
+	{
+		if (n > nummapthings)
+			I_Error("Savegame corrupted");
+		mobj->spawnpoint = &mapthings[n - 1];
+		mapthings[n - 1].mobj = mobj;
+	}
+
+	if (flag & 1)
+	{
+		redflag = mobj;
+		rflagpoint = mobj->spawnpoint;
+	}
+	if (flag & 2)
+	{
+		blueflag = mobj;
+		bflagpoint = mobj->spawnpoint;
+	}
+
+	// set sprev, snext, bprev, bnext, subsector
+	P_SetThingPosition(mobj);
+	P_LinkMobjType(mobj);
+
+	if (mobj->player)
+	{
+		if (mobj->eflags & MFE_VERTICALFLIP)
+			mobj->player->viewz = mobj->z + mobj->height - mobj->player->viewheight;
+		else
+			mobj->player->viewz = mobj->player->mo->z + mobj->player->viewheight;
+	}
+
+	P_AddThinker(THINK_MOBJ, &mobj->thinker);
+	P_FreeMobjsByNum();
+}
+
 //
 // LoadSpecialLevelThinker
 //
@@ -2195,7 +2492,7 @@ static void LoadSpecialLevelThinker(actionf_p1 thinker, UINT8 floorOrCeiling)
 			ht->sector->floordata = ht;
 	}
 
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2224,7 +2521,7 @@ static void LoadCeilingThinker(actionf_p1 thinker)
 	ht->sourceline = READFIXED(save_p);
 	if (ht->sector)
 		ht->sector->ceilingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2248,7 +2545,7 @@ static void LoadFloormoveThinker(actionf_p1 thinker)
 	ht->delaytimer = READFIXED(save_p);
 	if (ht->sector)
 		ht->sector->floordata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2265,7 +2562,7 @@ static void LoadLightflashThinker(actionf_p1 thinker)
 	ht->minlight = READINT32(save_p);
 	if (ht->sector)
 		ht->sector->lightingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2285,7 +2582,7 @@ static void LoadStrobeThinker(actionf_p1 thinker)
 	ht->brighttime = READINT32(save_p);
 	if (ht->sector)
 		ht->sector->lightingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2304,7 +2601,7 @@ static void LoadGlowThinker(actionf_p1 thinker)
 	ht->speed = READINT32(save_p);
 	if (ht->sector)
 		ht->sector->lightingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 //
 // LoadFireflickerThinker
@@ -2322,7 +2619,7 @@ static void LoadFireflickerThinker(actionf_p1 thinker)
 	ht->minlight = READINT32(save_p);
 	if (ht->sector)
 		ht->sector->lightingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 //
 // LoadElevatorThinker
@@ -2359,7 +2656,7 @@ static void LoadElevatorThinker(actionf_p1 thinker, UINT8 floorOrCeiling)
 			ht->sector->floordata = ht;
 	}
 
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2381,7 +2678,7 @@ static void LoadScrollThinker(actionf_p1 thinker)
 	ht->accel = READINT32(save_p);
 	ht->exclusive = READINT32(save_p);
 	ht->type = READUINT8(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2398,7 +2695,7 @@ static inline void LoadFrictionThinker(actionf_p1 thinker)
 	ht->affectee = READINT32(save_p);
 	ht->referrer = READINT32(save_p);
 	ht->roverfriction = READUINT8(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2424,7 +2721,7 @@ static void LoadPusherThinker(actionf_p1 thinker)
 	ht->exclusive = READINT32(save_p);
 	ht->slider = READINT32(save_p);
 	ht->source = P_GetPushThing(ht->affectee);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2444,7 +2741,7 @@ static inline void LoadLaserThinker(actionf_p1 thinker)
 		if (rover->secnum == (size_t)(ht->sec - sectors)
 		&& rover->master == ht->sourceline)
 			ht->ffloor = rover;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
@@ -2461,23 +2758,31 @@ static inline void LoadLightlevelThinker(actionf_p1 thinker)
 	ht->speed = READINT32(save_p);
 	if (ht->sector)
 		ht->sector->lightingdata = ht;
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 //
-// LoadExecutorThinker
+// LoadExecutorDelay
 //
 // Loads a executor_t from a save game
 //
-static inline void LoadExecutorThinker(actionf_p1 thinker)
+static inline void LoadExecutorDelay(void)
 {
-	executor_t *ht = Z_Malloc(sizeof (*ht), PU_LEVSPEC, NULL);
-	ht->thinker.function.acp1 = thinker;
-	ht->line = LoadLine(READUINT32(save_p));
-	ht->caller = LoadMobj(READUINT32(save_p));
-	ht->sector = LoadSector(READUINT32(save_p));
-	ht->timer = READINT32(save_p);
-	P_AddThinker(&ht->thinker);
+	line_t *line = LoadLine(READUINT32(save_p));
+	mobj_t *caller = LoadMobj(READUINT32(save_p));
+	sector_t *sector = LoadSector(READUINT32(save_p));
+	INT32 timer = READINT32(save_p);
+
+	// caller is only a number until RestoreExecutorCaller
+	P_QueueExecutorDelay(line, NULL, sector, timer)->caller = caller;
+}
+
+static void RestoreExecutorCaller(executor_t *e)
+{
+	UINT32 mobjnum;
+
+	if ((mobjnum = (UINT32)(size_t)e->caller))
+		e->caller = P_FindNewPosition(mobjnum);
 }
 
 //
@@ -2496,7 +2801,7 @@ static inline void LoadDisappearThinker(actionf_p1 thinker)
 	ht->affectee = READINT32(save_p);
 	ht->sourceline = READINT32(save_p);
 	ht->exists = READINT32(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_MAIN, &ht->thinker);
 }
 
 #ifdef POLYOBJECTS
@@ -2513,7 +2818,7 @@ static inline void LoadPolyrotatetThinker(actionf_p1 thinker)
 	ht->polyObjNum = READINT32(save_p);
 	ht->speed = READINT32(save_p);
 	ht->distance = READINT32(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 
 //
@@ -2531,7 +2836,7 @@ static void LoadPolymoveThinker(actionf_p1 thinker)
 	ht->momy = READFIXED(save_p);
 	ht->distance = READINT32(save_p);
 	ht->angle = READANGLE(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 
 //
@@ -2555,7 +2860,7 @@ static inline void LoadPolywaypointThinker(actionf_p1 thinker)
 	ht->diffx = READFIXED(save_p);
 	ht->diffy = READFIXED(save_p);
 	ht->diffz = READFIXED(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 
 //
@@ -2580,7 +2885,7 @@ static inline void LoadPolyslidedoorThinker(actionf_p1 thinker)
 	ht->momx = READFIXED(save_p);
 	ht->momy = READFIXED(save_p);
 	ht->closing = READUINT8(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 
 //
@@ -2600,7 +2905,7 @@ static inline void LoadPolyswingdoorThinker(actionf_p1 thinker)
 	ht->initDistance = READINT32(save_p);
 	ht->distance = READINT32(save_p);
 	ht->closing = READUINT8(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 
 //
@@ -2617,7 +2922,7 @@ static inline void LoadPolydisplaceThinker(actionf_p1 thinker)
 	ht->dx = READFIXED(save_p);
 	ht->dy = READFIXED(save_p);
 	ht->oldHeights = READFIXED(save_p);
-	P_AddThinker(&ht->thinker);
+	P_AddThinker(THINK_POLYOBJ, &ht->thinker);
 }
 #endif
 
@@ -2650,15 +2955,18 @@ static void P_NetUnArchiveThinkers(void)
 		I_Error("Bad $$$.sav at archive block Thinkers");
 
 	// remove all the current thinkers
-	currentthinker = thinkercap.next;
-	for (currentthinker = thinkercap.next; currentthinker != &thinkercap; currentthinker = next)
+	P_FreeExecutorDelays();
+	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
-		next = currentthinker->next;
+		for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = next)
+		{
+			next = currentthinker->next;
 
-		if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
-			P_RemoveSavegameMobj((mobj_t *)currentthinker); // item isn't saved, don't remove it
-		else
-			Z_Free(currentthinker);
+			if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+				P_RemoveSavegameMobj((mobj_t *)currentthinker); // item isn't saved, don't remove it
+			else
+				Z_Free(currentthinker);
+		}
 	}
 
 	// we don't want the removed mobjs to come back
@@ -2686,6 +2994,10 @@ static void P_NetUnArchiveThinkers(void)
 				LoadMobjThinker((actionf_p1)P_MobjThinker);
 				break;
 
+			case tc_mobjpacked:
+				LoadPackedMobjThinker();
+				break;
+
 			case tc_ceiling:
 				LoadCeilingThinker((actionf_p1)T_MoveCeiling);
 				break;
@@ -2781,7 +3093,7 @@ static void P_NetUnArchiveThinkers(void)
 				break;
 
 			case tc_executor:
-				LoadExecutorThinker((actionf_p1)T_ExecutorDelay);
+				LoadExecutorDelay();
 				restoreNum = true;
 				break;
 
@@ -2837,20 +3149,7 @@ static void P_NetUnArchiveThinkers(void)
 	CONS_Debug(DBG_NETPLAY, "%u thinkers loaded\n", numloaded);
 
 	if (restoreNum)
-	{
-		executor_t *delay = NULL;
-		UINT32 mobjnum;
-		for (currentthinker = thinkercap.next; currentthinker != &thinkercap;
-			currentthinker = currentthinker->next)
-		{
-			if (currentthinker->function.acp1 == (actionf_p1)T_ExecutorDelay)
-			{
-				delay = (void *)currentthinker;
-				if ((mobjnum = (UINT32)(size_t)delay->caller))
-					delay->caller = P_FindNewPosition(mobjnum);
-			}
-		}
-	}
+		P_IterateExecutorDelays(RestoreExecutorCaller);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2956,7 +3255,7 @@ static inline void P_FinishMobjs(void)
 	mobj_t *mobj;
 
 	// put info field there real value
-	for (currentthinker = thinkercap.next; currentthinker != &thinkercap;
+	for (currentthinker = thlist[THINK_MOBJ].next; currentthinker != &thlist[THINK_MOBJ];
 		currentthinker = currentthinker->next)
 	{
 		if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
@@ -2974,7 +3273,7 @@ static void P_RelinkPointers(void)
 	UINT32 temp;
 
 	// use info field (value = oldposition) to relink mobjs
-	for (currentthinker = thinkercap.next; currentthinker != &thinkercap;
+	for (currentthinker = thlist[THINK_MOBJ].next; currentthinker != &thlist[THINK_MOBJ];
 		currentthinker = currentthinker->next)
 	{
 		if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
@@ -3190,7 +3489,7 @@ static inline void P_UnArchiveSPGame(INT16 mapoverride)
 
 static void P_NetArchiveMisc(void)
 {
-	UINT32 pig = 0;
+	UINT8 pig[PLAYERMASKSIZE];
 	INT32 i;
 
 	WRITEUINT32(save_p, ARCHIVEBLOCK_MISC);
@@ -3198,9 +3497,11 @@ static void P_NetArchiveMisc(void)
 	WRITEINT16(save_p, gamemap);
 	WRITEINT16(save_p, gamestate);
 
+	memset(pig, 0, sizeof (pig));
 	for (i = 0; i < MAXPLAYERS; i++)
-		pig |= (playeringame[i] != 0)<<i;
-	WRITEUINT32(save_p, pig);
+		if (playeringame[i])
+			ADDPLAYERTOMASK(pig, i);
+	WRITEMEM(save_p, pig, sizeof (pig));
 
 	WRITEUINT32(save_p, P_GetRandSeed());
 
@@ -3249,7 +3550,7 @@ static void P_NetArchiveMisc(void)
 
 static inline boolean P_NetUnArchiveMisc(void)
 {
-	UINT32 pig;
+	UINT8 pig[PLAYERMASKSIZE];
 	INT32 i;
 
 	if (READUINT32(save_p) != ARCHIVEBLOCK_MISC)
@@ -3268,10 +3569,10 @@ static inline boolean P_NetUnArchiveMisc(void)
 
 	G_SetGamestate(READINT16(save_p));
 
-	pig = READUINT32(save_p);
+	READMEM(save_p, pig, sizeof (pig));
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
-		playeringame[i] = (pig & (1<<i)) != 0;
+		playeringame[i] = PLAYERINMASK(pig, i) != 0;
 		// playerstate is set in unarchiveplayers
 	}
 
@@ -3342,7 +3643,7 @@ void P_SaveNetGame(void)
 	P_NetArchiveMisc();
 
 	// Assign the mobjnumber for pointer tracking
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 		{
@@ -3370,6 +3671,13 @@ void P_SaveNetGame(void)
 	WRITEUINT8(save_p, 0x1d); // consistency marker
 }
 
+void P_SaveNetSnapshot(void)
+{
+	packedsave = true;
+	P_SaveNetGame();
+	packedsave = false;
+}
+
 boolean P_LoadGame(INT16 mapoverride)
 {
 	if (gamestate == GS_INTERMISSION)
@@ -3406,10 +3714,12 @@ boolean P_LoadNetGame(void)
 		P_NetUnArchiveSpecials();
 		P_RelinkPointers();
 		P_FinishMobjs();
+		P_ClearTouchCache();
 	}
 #ifdef HAVE_BLUA
 	LUA_UnArchive();
 #endif
+	P_FreeMobjsByNum();
 
 	// This is stupid and hacky, but maybe it'll work!
 	P_SetRandSeed(P_GetInitSeed());
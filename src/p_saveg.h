@@ -23,6 +23,7 @@
 
 void P_SaveGame(void);
 void P_SaveNetGame(void);
+void P_SaveNetSnapshot(void); // the same, but quicker, and only for this build
 boolean P_LoadGame(INT16 mapoverride);
 boolean P_LoadNetGame(void);
 
@@ -20,11 +20,13 @@
 #include "p_setup.h"
 #include "p_spec.h"
 #include "p_saveg.h"
+#include "p_warmup.h"
 
 #include "i_sound.h" // for I_PlayCD()..
 #include "i_video.h" // for I_FinishUpdate()..
 #include "r_sky.h"
 #include "i_system.h"
+#include "i_threads.h"
 
 #include "r_data.h"
 #include "r_things.h"
@@ -46,9 +48,11 @@
 
 #include "dehacked.h" // for map headers
 #include "r_main.h"
+#include "r_fps.h"
 #include "m_cond.h" // for emblems
 
 #include "m_argv.h"
+#include "m_trace.h"
 
 #include "p_polyobj.h"
 
@@ -370,7 +374,7 @@ static inline void P_LoadRawVertexes(UINT8 *data, size_t i)
 		I_Error("Level has no vertices"); // instead of crashing
 
 	// Allocate zone memory for buffer.
-	vertexes = Z_Calloc(numvertexes * sizeof (*vertexes), PU_LEVEL, NULL);
+	vertexes = Z_LevelCalloc(numvertexes * sizeof (*vertexes));
 
 	ml = (mapvertex_t *)data;
 	li = vertexes;
@@ -436,7 +440,7 @@ static void P_LoadRawSegs(UINT8 *data, size_t i)
 	numsegs = i / sizeof (mapseg_t);
 	if (numsegs <= 0)
 		I_Error("Level has no segs"); // instead of crashing
-	segs = Z_Calloc(numsegs * sizeof (*segs), PU_LEVEL, NULL);
+	segs = Z_LevelCalloc(numsegs * sizeof (*segs));
 
 	ml = (mapseg_t *)data;
 	li = segs;
@@ -495,7 +499,7 @@ static inline void P_LoadRawSubsectors(void *data, size_t i)
 	numsubsectors = i / sizeof (mapsubsector_t);
 	if (numsubsectors <= 0)
 		I_Error("Level has no subsectors (did you forget to run it through a nodesbuilder?)");
-	ss = subsectors = Z_Calloc(numsubsectors * sizeof (*subsectors), PU_LEVEL, NULL);
+	ss = subsectors = Z_LevelCalloc(numsubsectors * sizeof (*subsectors));
 
 	ms = (mapsubsector_t *)data;
 
@@ -530,6 +534,31 @@ static void P_LoadSubsectors(lumpnum_t lumpnum)
 size_t numlevelflats;
 levelflat_t *levelflats;
 
+// Hash index over the levelflats by name: 1 + the newest levelflat of
+// each chain, 0 if empty. The chains go on through levelflat_t.hashnext.
+#define LEVELFLATHASHSIZE 256
+static INT32 levelflathash[LEVELFLATHASHSIZE];
+
+// Returns the id of the levelflat named flatname, or numlevelflats if there isn't one.
+static size_t P_FindLevelFlat(const char *flatname, const levelflat_t *flats)
+{
+	INT32 i;
+
+	for (i = levelflathash[W_HashLumpName(flatname, 8) & (LEVELFLATHASHSIZE-1)]; i; i = flats[i-1].hashnext)
+		if (strnicmp(flats[i-1].name,flatname,8)==0)
+			return (size_t)(i-1);
+
+	return numlevelflats;
+}
+
+static void P_HashLevelFlat(levelflat_t *flats, size_t i)
+{
+	const UINT32 bucket = W_HashLumpName(flats[i].name, 8) & (LEVELFLATHASHSIZE-1);
+
+	flats[i].hashnext = levelflathash[bucket];
+	levelflathash[bucket] = (INT32)i + 1;
+}
+
 //SoM: Other files want this info.
 size_t P_PrecacheLevelFlats(void)
 {
@@ -543,6 +572,20 @@ size_t P_PrecacheLevelFlats(void)
 		if (devparm)
 			flatmemory += W_LumpLength(lump);
 		R_GetFlat(lump);
+
+		// Tile the big ones now rather than the first time they're seen
+		if (cv_tiledflats.value)
+		{
+			const size_t size = W_LumpLength(lump);
+			INT32 bits;
+
+			for (bits = 7; bits <= 11; bits++)
+				if (size == (size_t)1 << (2*bits))
+				{
+					R_GetTiledFlat(lump, bits);
+					break;
+				}
+		}
 	}
 	return flatmemory;
 }
@@ -550,23 +593,22 @@ size_t P_PrecacheLevelFlats(void)
 // help function for P_LoadSectors, find a flat in the active wad files,
 // allocate an id for it, and set the levelflat (to speedup search)
 //
-INT32 P_AddLevelFlat(const char *flatname, levelflat_t *levelflat)
+INT32 P_AddLevelFlat(const char *flatname, levelflat_t *foundflats)
 {
-	size_t i;
-
 	//
-	//  first scan through the already found flats
+	//  first look through the already found flats
 	//
-	for (i = 0; i < numlevelflats; i++, levelflat++)
-		if (strnicmp(levelflat->name,flatname,8)==0)
-			break;
+	size_t i = P_FindLevelFlat(flatname, foundflats);
 
 	// that flat was already found in the level, return the id
 	if (i == numlevelflats)
 	{
+		levelflat_t *levelflat = foundflats + i;
+
 		// store the name
 		strlcpy(levelflat->name, flatname, sizeof (levelflat->name));
 		strupr(levelflat->name);
+		P_HashLevelFlat(foundflats, i);
 
 		// store the flat lump number
 		levelflat->lumpnum = R_GetFlatNumForName(flatname);
@@ -591,19 +633,16 @@ INT32 P_AddLevelFlat(const char *flatname, levelflat_t *levelflat)
 //
 INT32 P_AddLevelFlatRuntime(const char *flatname)
 {
-	size_t i;
-	levelflat_t *levelflat = levelflats;
-
 	//
-	//  first scan through the already found flats
+	//  first look through the already found flats
 	//
-	for (i = 0; i < numlevelflats; i++, levelflat++)
-		if (strnicmp(levelflat->name,flatname,8)==0)
-			break;
+	size_t i = P_FindLevelFlat(flatname, levelflats);
 
 	// that flat was already found in the level, return the id
 	if (i == numlevelflats)
 	{
+		levelflat_t *levelflat;
+
 		// allocate new flat memory
 		levelflats = Z_Realloc(levelflats, (numlevelflats + 1) * sizeof(*levelflats), PU_LEVEL, NULL);
 		levelflat = levelflats+i;
@@ -611,6 +650,7 @@ INT32 P_AddLevelFlatRuntime(const char *flatname)
 		// store the name
 		strlcpy(levelflat->name, flatname, sizeof (levelflat->name));
 		strupr(levelflat->name);
+		P_HashLevelFlat(levelflats, i);
 
 		// store the flat lump number
 		levelflat->lumpnum = R_GetFlatNumForName(flatname);
@@ -631,15 +671,10 @@ INT32 P_AddLevelFlatRuntime(const char *flatname)
 //
 INT32 P_CheckLevelFlat(const char *flatname)
 {
-	size_t i;
-	levelflat_t *levelflat = levelflats;
-
 	//
-	//  scan through the already found flats
+	//  look through the already found flats
 	//
-	for (i = 0; i < numlevelflats; i++, levelflat++)
-		if (strnicmp(levelflat->name,flatname,8)==0)
-			break;
+	size_t i = P_FindLevelFlat(flatname, levelflats);
 
 	if (i == numlevelflats)
 		return 0; // ??? flat was not found, this should not happen!
@@ -662,7 +697,7 @@ static void P_LoadRawSectors(UINT8 *data, size_t i)
 		I_Error("Level has no sectors");
 
 	// Allocate as much memory as we need into the global sectors table.
-	sectors = Z_Calloc(numsectors*sizeof (*sectors), PU_LEVEL, NULL);
+	sectors = Z_LevelCalloc(numsectors*sizeof (*sectors));
 
 	// Allocate a big chunk of memory as big as our MAXLEVELFLATS limit.
 	//Fab : FIXME: allocate for whatever number of flats - 512 different flats per level should be plenty
@@ -671,6 +706,7 @@ static void P_LoadRawSectors(UINT8 *data, size_t i)
 		I_Error("Ran out of memory while loading sectors\n");
 
 	numlevelflats = 0;
+	memset(levelflathash, 0, sizeof (levelflathash));
 
 	// For each counted sector, copy the sector raw data from our cache pointer ms, to the global table pointer ss.
 	ms = (mapsector_t *)data;
@@ -694,8 +730,6 @@ static void P_LoadRawSectors(UINT8 *data, size_t i)
 
 		ss->thinglist = NULL;
 		ss->touching_thinglist = NULL;
-		ss->preciplist = NULL;
-		ss->touching_preciplist = NULL;
 
 		ss->floordata = NULL;
 		ss->ceilingdata = NULL;
@@ -710,13 +744,15 @@ static void P_LoadRawSectors(UINT8 *data, size_t i)
 		ss->ceilinglightsec = -1;
 		ss->crumblestate = 0;
 		ss->ffloors = NULL;
+		ss->fofflags = 0;
 		ss->lightlist = NULL;
-		ss->numlights = 0;
+		ss->numlights = ss->maxlights = 0;
 		ss->attached = NULL;
 		ss->attachedsolid = NULL;
 		ss->numattached = 0;
 		ss->maxattached = 1;
 		ss->moved = true;
+		ss->precipfloortic = 0;
 
 		ss->extra_colormap = NULL;
 
@@ -774,7 +810,7 @@ static void P_LoadRawNodes(UINT8 *data, size_t i)
 	numnodes = i / sizeof (mapnode_t);
 	if (numnodes <= 0)
 		I_Error("Level has no nodes");
-	nodes = Z_Calloc(numnodes * sizeof (*nodes), PU_LEVEL, NULL);
+	nodes = Z_LevelCalloc(numnodes * sizeof (*nodes));
 
 	mn = (mapnode_t *)data;
 	no = nodes;
@@ -816,7 +852,7 @@ void P_ReloadRings(void)
 	mapthing_t *mt = mapthings;
 
 	// scan the thinkers to find rings/wings/hoops to unset
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -938,7 +974,7 @@ static void P_PrepareRawThings(UINT8 *data, size_t i)
 	mapthing_t *mt;
 
 	nummapthings = i / (5 * sizeof (INT16));
-	mapthings = Z_Calloc(nummapthings * sizeof (*mapthings), PU_LEVEL, NULL);
+	mapthings = Z_LevelCalloc(nummapthings * sizeof (*mapthings));
 
 	// Spawn axis points first so they are
 	// at the front of the list for fast searching.
@@ -1168,7 +1204,8 @@ static void P_LoadRawLineDefs(UINT8 *data, size_t i)
 	numlines = i / sizeof (maplinedef_t);
 	if (numlines <= 0)
 		I_Error("Level has no linedefs");
-	lines = Z_Calloc(numlines * sizeof (*lines), PU_LEVEL, NULL);
+	lines = Z_LevelCalloc(numlines * sizeof (*lines));
+	linecoll = Z_LevelCalloc(numlines * sizeof (*linecoll));
 
 	mld = (maplinedef_t *)data;
 	ld = lines;
@@ -1217,6 +1254,8 @@ static void P_LoadRawLineDefs(UINT8 *data, size_t i)
 			ld->bbox[BOXTOP] = v1->y;
 		}
 
+		P_SetLineColl(ld);
+
 		ld->sidenum[0] = SHORT(mld->sidenum[0]);
 		ld->sidenum[1] = SHORT(mld->sidenum[1]);
 
@@ -1353,8 +1392,7 @@ static void P_LoadLineDefs2(void)
 			numnewsides++;
 		}
 
-		// We're loading crap into this block anyhow, so no point in zeroing it out.
-		newsides = Z_Malloc(numnewsides * sizeof(*newsides), PU_LEVEL, NULL);
+		newsides = Z_LevelCalloc(numnewsides * sizeof(*newsides));
 
 		// Copy the sides to their new block of memory.
 		for (i = 0, z = 0; i < numsides; i++)
@@ -1365,7 +1403,7 @@ static void P_LoadLineDefs2(void)
 
 		CONS_Debug(DBG_SETUP, "Old sides is %s, new sides is %s\n", sizeu1(numsides), sizeu1(numnewsides));
 
-		Z_Free(sides);
+		Z_LevelFree(sides);
 		sides = newsides;
 		numsides = numnewsides;
 	}
@@ -1378,7 +1416,7 @@ static inline void P_LoadRawSideDefs(size_t i)
 	numsides = i / sizeof (mapsidedef_t);
 	if (numsides <= 0)
 		I_Error("Level has no sidedefs");
-	sides = Z_Calloc(numsides * sizeof (*sides), PU_LEVEL, NULL);
+	sides = Z_LevelCalloc(numsides * sizeof (*sides));
 }
 
 static inline void P_LoadSideDefs(lumpnum_t lumpnum)
@@ -1697,6 +1735,18 @@ static boolean LineInBlock(fixed_t cx1, fixed_t cy1, fixed_t cx2, fixed_t cy2, f
 	return P_BoxOnLineSide(bbox, &testline) == -1;
 }
 
+// The blockmap P_BuildBlockMap made, waiting for P_FinishBlockMap
+static INT32 *builtblockmap = NULL;
+static size_t builtblockmapsize = 0;
+static boolean blockmapready = false;
+
+#ifdef HAVE_THREADS
+static I_mutex blockmap_mutex;
+static I_cond blockmap_cond;
+#endif
+
+//
+// P_BuildBlockMap
 //
 // killough 10/98:
 //
@@ -1708,12 +1758,21 @@ static boolean LineInBlock(fixed_t cx1, fixed_t cy1, fixed_t cx2, fixed_t cy2, f
 //
 // Please note: This section of code is not interchangable with TeamTNT's
 // code which attempts to fix the same problem.
-static void P_CreateBlockMap(void)
+//
+// Only reads the vertexes and the linedefs' vertexes, and doesn't touch
+// the zone, so it can run on a thread while the rest of the map loads.
+// The result is left in builtblockmap, or NULL if memory ran out.
+//
+static void P_BuildBlockMap(void *userdata)
 {
 	register size_t i;
 	fixed_t minx = INT32_MAX, miny = INT32_MAX, maxx = INT32_MIN, maxy = INT32_MIN;
-	// First find limits of map
+	INT32 *result = NULL;
+	size_t count = 0;
+
+	(void)userdata;
 
+	// First find limits of map
 	for (i = 0; i < numvertexes; i++)
 	{
 		if (vertexes[i].x>>FRACBITS < minx)
@@ -1760,7 +1819,8 @@ static void P_CreateBlockMap(void)
 		bmap_t *bmap = calloc(tot, sizeof (*bmap)); // array of blocklists
 		boolean straight;
 
-		if (bmap == NULL) I_Error("%s: Out of memory making blockmap", "P_CreateBlockMap");
+		if (bmap == NULL)
+			goto done;
 
 		for (i = 0; i < numlines; i++)
 		{
@@ -1832,13 +1892,16 @@ static void P_CreateBlockMap(void)
 				{
 					// Graue 02-29-2004: make code more readable, don't realloc a null pointer
 					// (because it crashes for me, and because the comp.lang.c FAQ says so)
+					INT32 *list;
+
 					if (bmap[b].nalloc == 0)
 						bmap[b].nalloc = 8;
 					else
 						bmap[b].nalloc *= 2;
-					bmap[b].list = Z_Realloc(bmap[b].list, bmap[b].nalloc * sizeof (*bmap->list), PU_CACHE, &bmap[b].list);
-					if (!bmap[b].list)
-						I_Error("Out of Memory in P_CreateBlockMap");
+					list = realloc(bmap[b].list, bmap[b].nalloc * sizeof (*bmap->list));
+					if (!list)
+						goto freelists;
+					bmap[b].list = list;
 				}
 
 				// Add linedef to end of list
@@ -1852,51 +1915,216 @@ static void P_CreateBlockMap(void)
 		// at tot and tot+1.
 		//
 		// 4 words, unused if this routine is called, are reserved at the start.
-		{
-			size_t count = tot + 6; // we need at least 1 word per block, plus reserved's
+		count = tot + 6; // we need at least 1 word per block, plus reserved's
 
-			for (i = 0; i < tot; i++)
-				if (bmap[i].n)
-					count += bmap[i].n + 2; // 1 header word + 1 trailer word + blocklist
+		for (i = 0; i < tot; i++)
+			if (bmap[i].n)
+				count += bmap[i].n + 2; // 1 header word + 1 trailer word + blocklist
 
-			// Allocate blockmap lump with computed count
-			blockmaplump = Z_Calloc(sizeof (*blockmaplump) * count, PU_LEVEL, NULL);
-		}
+		// Allocate blockmap lump with computed count
+		result = calloc(count, sizeof (*result));
 
 		// Now compress the blockmap.
+		if (result)
 		{
-			size_t ndx = tot += 4; // Advance index to start of linedef lists
+			size_t ndx = tot + 4; // Advance index to start of linedef lists
 			bmap_t *bp = bmap; // Start of uncompressed blockmap
 
-			blockmaplump[ndx++] = 0; // Store an empty blockmap list at start
-			blockmaplump[ndx++] = -1; // (Used for compression)
+			result[ndx++] = 0; // Store an empty blockmap list at start
+			result[ndx++] = -1; // (Used for compression)
 
-			for (i = 4; i < tot; i++, bp++)
+			for (i = 4; i < tot + 4; i++, bp++)
 				if (bp->n) // Non-empty blocklist
 				{
-					blockmaplump[blockmaplump[i] = (INT32)(ndx++)] = 0; // Store index & header
+					result[result[i] = (INT32)(ndx++)] = 0; // Store index & header
 					do
-						blockmaplump[ndx++] = bp->list[--bp->n]; // Copy linedef list
+						result[ndx++] = bp->list[--bp->n]; // Copy linedef list
 					while (bp->n);
-					blockmaplump[ndx++] = -1; // Store trailer
-					Z_Free(bp->list); // Free linedef list
+					result[ndx++] = -1; // Store trailer
 				}
 				else // Empty blocklist: point to reserved empty blocklist
-					blockmaplump[i] = (INT32)tot;
-
-			free(bmap); // Free uncompressed blockmap
+					result[i] = (INT32)(tot + 4);
 		}
+
+freelists:
+		for (i = 0; i < tot; i++)
+			free(bmap[i].list); // Free linedef lists
+		free(bmap); // Free uncompressed blockmap
 	}
+
+done:
+#ifdef HAVE_THREADS
+	I_lock_mutex(&blockmap_mutex);
+#endif
+	builtblockmap = result;
+	builtblockmapsize = count;
+	blockmapready = true;
+#ifdef HAVE_THREADS
+	I_wake_one_cond(&blockmap_cond);
+	I_unlock_mutex(blockmap_mutex);
+#endif
+}
+
+// --------------------------------------------------------------------------
+// Blockmaps P_BuildBlockMap makes are saved once per map, keyed by the
+// map's MD5, so loading the map again only has to read them back.
+
+#define BLOCKMAPCACHEDIR "levelcache"
+#define BLOCKMAPCACHEID "SRB2BMC\0"
+#define BLOCKMAPCACHEVERSION 1
+#define BLOCKMAPCACHEHEADERSIZE (8 + 4 + 16 + 2*4 + 4*4 + 4)
+
+consvar_t cv_blockmapcache = {"blockmapcache", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static boolean blockmapcached = false; // P_StartBlockMap read it back
+
+static const char *P_BlockMapCacheName(void)
+{
+	char hex[33];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&hex[i*2], "%02x", mapmd5[i]);
+	return va("%s"PATHSEP BLOCKMAPCACHEDIR PATHSEP"%s.bmc", srb2home, hex);
+}
+
+static void P_SaveBlockMapCache(void)
+{
+	const size_t length = BLOCKMAPCACHEHEADERSIZE + builtblockmapsize*4;
+	UINT8 *buf, *p;
+	size_t i;
+
+	p = buf = malloc(length);
+	if (!buf)
+		return;
+
+	memcpy(p, BLOCKMAPCACHEID, 8);
+	p += 8;
+	WRITEUINT32(p, BLOCKMAPCACHEVERSION);
+	memcpy(p, mapmd5, 16);
+	p += 16;
+	WRITEUINT32(p, (UINT32)numvertexes);
+	WRITEUINT32(p, (UINT32)numlines);
+	WRITEFIXED(p, bmaporgx);
+	WRITEFIXED(p, bmaporgy);
+	WRITEINT32(p, bmapwidth);
+	WRITEINT32(p, bmapheight);
+	WRITEUINT32(p, (UINT32)builtblockmapsize);
+	for (i = 0; i < builtblockmapsize; i++)
+		WRITEINT32(p, builtblockmap[i]);
+
+	I_mkdir(va("%s"PATHSEP BLOCKMAPCACHEDIR, srb2home), 0755);
+	if (!FIL_WriteFile(P_BlockMapCacheName(), buf, p - buf))
+		CONS_Debug(DBG_SETUP, "P_SaveBlockMapCache: couldn't write %s\n", P_BlockMapCacheName());
+	free(buf);
+}
+
+// Reads the blockmap straight into the level's memory, if the cache
+// has one for this map that makes sense.
+static boolean P_LoadBlockMapCache(void)
+{
+	UINT8 *buf, *p;
+	size_t i, length, count;
+	INT32 width, height;
+
+	length = FIL_ReadFileTag(P_BlockMapCacheName(), &buf, PU_STATIC);
+	if (!length)
+		return false;
+
+	p = buf;
+	if (length < BLOCKMAPCACHEHEADERSIZE || memcmp(p, BLOCKMAPCACHEID, 8))
+		goto bad;
+	p += 8;
+	if (READUINT32(p) != BLOCKMAPCACHEVERSION || memcmp(p, mapmd5, 16))
+		goto bad;
+	p += 16;
+	if (READUINT32(p) != numvertexes || READUINT32(p) != numlines)
+		goto bad;
+	p += 2*4; // origin, read once the rest checks out
+	width = READINT32(p);
+	height = READINT32(p);
+	count = READUINT32(p);
+	if (width <= 0 || height <= 0 || count < (size_t)width*height + 6
+	 || length != BLOCKMAPCACHEHEADERSIZE + count*4)
+		goto bad;
+
+	blockmaplump = Z_LevelCalloc(sizeof (*blockmaplump) * count);
+	for (i = 0; i < count; i++)
+		blockmaplump[i] = READINT32(p);
+
+	p = buf + 8 + 4 + 16 + 2*4;
+	bmaporgx = READFIXED(p);
+	bmaporgy = READFIXED(p);
+	bmapwidth = width;
+	bmapheight = height;
+
+	Z_Free(buf);
+	return true;
+bad:
+	CONS_Debug(DBG_SETUP, "P_LoadBlockMapCache: ignoring %s\n", P_BlockMapCacheName());
+	Z_Free(buf);
+	return false;
+}
+
+//
+// P_StartBlockMap
+//
+// Starts building a blockmap for a map without one, in the background if
+// there are threads, unless the cache has it already. Call once the
+// vertexes and linedefs are loaded.
+//
+static void P_StartBlockMap(void)
+{
+	blockmapready = false;
+	blockmapcached = (cv_blockmapcache.value && P_LoadBlockMapCache());
+	if (blockmapcached)
+		return;
+#ifdef HAVE_THREADS
+	I_spawn_thread("blockmap", P_BuildBlockMap, NULL);
+#else
+	P_BuildBlockMap(NULL);
+#endif
+}
+
+//
+// P_FinishBlockMap
+//
+// Waits for P_StartBlockMap's blockmap, and moves it into the level's memory.
+// Saves it in the cache, if it wasn't read from there.
+//
+static void P_FinishBlockMap(void)
+{
+	if (!blockmapcached)
+	{
+#ifdef HAVE_THREADS
+		I_lock_mutex(&blockmap_mutex);
+		while (!blockmapready)
+			I_hold_cond(&blockmap_cond, blockmap_mutex);
+		I_unlock_mutex(blockmap_mutex);
+#endif
+
+		if (!builtblockmap)
+			I_Error("%s: Out of memory making blockmap", "P_FinishBlockMap");
+
+		if (cv_blockmapcache.value)
+			P_SaveBlockMapCache();
+
+		blockmaplump = Z_LevelCalloc(sizeof (*blockmaplump) * builtblockmapsize);
+		M_Memcpy(blockmaplump, builtblockmap, sizeof (*blockmaplump) * builtblockmapsize);
+		free(builtblockmap);
+		builtblockmap = NULL;
+	}
+
 	{
 		size_t count = sizeof (*blocklinks) * bmapwidth * bmapheight;
 		// clear out mobj chains (copied from from P_LoadBlockMap)
-		blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+		blocklinks = Z_LevelCalloc(count);
 		blockmap = blockmaplump + 4;
 
 #ifdef POLYOBJECTS
 		// haleyjd 2/22/06: setup polyobject blockmap
 		count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-		polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+		polyblocklinks = Z_LevelCalloc(count);
 #endif
 	}
 }
@@ -1906,7 +2134,7 @@ static void P_CreateBlockMap(void)
 static void P_ReadBlockMapLump(INT16 *wadblockmaplump, size_t count)
 {
 	size_t i;
-	blockmaplump = Z_Calloc(sizeof (*blockmaplump) * count, PU_LEVEL, NULL);
+	blockmaplump = Z_LevelCalloc(sizeof (*blockmaplump) * count);
 
 	// killough 3/1/98: Expand wad blockmap into larger internal one,
 	// by treating all offsets except -1 as unsigned and zero-extending
@@ -1967,13 +2195,13 @@ static boolean P_LoadBlockMap(lumpnum_t lumpnum)
 
 	// clear out mobj chains
 	count = sizeof (*blocklinks)* bmapwidth*bmapheight;
-	blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	blocklinks = Z_LevelCalloc(count);
 	blockmap = blockmaplump+4;
 
 #ifdef POLYOBJECTS
 	// haleyjd 2/22/06: setup polyobject blockmap
 	count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-	polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	polyblocklinks = Z_LevelCalloc(count);
 #endif
 	return true;
 /* Original
@@ -2033,13 +2261,13 @@ static boolean P_LoadRawBlockMap(UINT8 *data, size_t count, const char *lumpname
 
 	// clear out mobj chains
 	count = sizeof (*blocklinks)* bmapwidth*bmapheight;
-	blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	blocklinks = Z_LevelCalloc(count);
 	blockmap = blockmaplump+4;
 
 #ifdef POLYOBJECTS
 	// haleyjd 2/22/06: setup polyobject blockmap
 	count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-	polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+	polyblocklinks = Z_LevelCalloc(count);
 #endif
 	return true;
 #endif
@@ -2102,7 +2330,7 @@ static void P_GroupLines(void)
 		}
 		else
 		{
-			sector->lines = Z_Calloc(sector->linecount * sizeof(line_t*), PU_LEVEL, NULL);
+			sector->lines = Z_LevelCalloc(sector->linecount * sizeof(line_t*));
 
 			// zero the count, since we'll later use this to track how many we've recorded
 			sector->linecount = 0;
@@ -2189,7 +2417,7 @@ static void P_LoadRawReject(UINT8 *data, size_t count, const char *lumpname)
 	}
 	else
 	{
-		rejectmatrix = Z_Malloc(count, PU_LEVEL, NULL); // allocate memory for the reject matrix
+		rejectmatrix = Z_LevelCalloc(count); // allocate memory for the reject matrix
 		M_Memcpy(rejectmatrix, data, count); // copy the data into it
 	}
 }
@@ -2360,7 +2588,7 @@ void P_LoadThingsOnly(void)
 	mobj_t *mo;
 	thinker_t *think;
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (think = thlist[THINK_MOBJ].next; think != &thlist[THINK_MOBJ]; think = think->next)
 	{
 		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue; // not a mobj thinker
@@ -2668,6 +2896,299 @@ static boolean P_CanSave(void)
 			&& (gamemap != lastmapsaved));
 }
 
+// The next map, being got ready during the intermission a step per tic
+static lumpnum_t prefetchmaplump = LUMPERROR;
+static INT32 prefetchstep = 0;
+static INT32 *prefetchtextures = NULL; // wall textures whose composites are still to be made
+static size_t numprefetchtextures = 0, prefetchtexturepos = 0;
+
+// How long making composites may take every tic of the intermission
+#define PREFETCHCOMPOSITEMICROS 2000
+
+//
+// P_PrefetchMapTextures
+//
+// Finds the wall textures of the next map, and has their patches inflated.
+//
+static void P_PrefetchMapTextures(void)
+{
+	const size_t n = W_LumpLength(prefetchmaplump + ML_SIDEDEFS) / sizeof (mapsidedef_t);
+	mapsidedef_t *msd = W_CacheLumpNum(prefetchmaplump + ML_SIDEDEFS, PU_CACHE);
+	UINT8 *present = calloc(numtextures ? numtextures : 1, sizeof (*present));
+	char name[9];
+	size_t i, j;
+	INT32 tex;
+
+	if (!present || !(prefetchtextures = malloc((numtextures ? numtextures : 1) * sizeof (*prefetchtextures))))
+	{
+		free(present);
+		return; // it's only a hint anyway
+	}
+
+	name[8] = '\0';
+	for (i = 0; i < n; i++, msd++)
+	{
+		const char *names[3];
+		names[0] = msd->toptexture;
+		names[1] = msd->midtexture;
+		names[2] = msd->bottomtexture;
+		for (j = 0; j < 3; j++)
+		{
+			M_Memcpy(name, names[j], 8);
+			tex = R_CheckTextureNumForName(name);
+			if (tex > 0)
+				present[tex] = 1;
+		}
+	}
+
+	for (tex = 0; tex < numtextures; tex++)
+	{
+		if (!present[tex])
+			continue;
+		prefetchtextures[numprefetchtextures++] = tex;
+		R_PrefetchTexture(tex);
+	}
+	free(present);
+}
+
+//
+// P_PrefetchMapFlats
+//
+// Has the flats of the next map inflated.
+//
+static void P_PrefetchMapFlats(void)
+{
+	const size_t n = W_LumpLength(prefetchmaplump + ML_SECTORS) / sizeof (mapsector_t);
+	mapsector_t *ms = W_CacheLumpNum(prefetchmaplump + ML_SECTORS, PU_CACHE);
+	char names[256][8]; // the flats seen so far, since looking one up is slow
+	size_t numnames = 0, i, j, k;
+	char name[9];
+
+	name[8] = '\0';
+	for (i = 0; i < n; i++, ms++)
+	{
+		for (j = 0; j < 2; j++)
+		{
+			M_Memcpy(name, j ? ms->ceilingpic : ms->floorpic, 8);
+			for (k = 0; k < numnames; k++)
+				if (!strnicmp(names[k], name, 8))
+					break;
+			if (k < numnames)
+				continue;
+			if (numnames < sizeof names / sizeof *names)
+				M_Memcpy(names[numnames++], name, 8);
+			W_PrefetchLump(R_GetFlatNumForName(name));
+		}
+	}
+}
+
+//
+// P_PrefetchMapThings
+//
+// Has the sprites and sounds of everything placed on the next map got ready.
+//
+static void P_PrefetchMapThings(void)
+{
+	const size_t n = W_LumpLength(prefetchmaplump + ML_THINGS) / (5 * sizeof (INT16));
+	UINT8 *data = W_CacheLumpNum(prefetchmaplump + ML_THINGS, PU_CACHE);
+	INT16 *bynum = malloc(4096 * sizeof (*bynum)); // doomednum to mobjtype
+	UINT8 seen[(NUMMOBJTYPES + 7)/8];
+	size_t i;
+
+	if (!bynum)
+		return;
+
+	for (i = 0; i < 4096; i++)
+		bynum[i] = -1;
+	for (i = NUMMOBJTYPES; i-- > 0;) // the first type with a doomednum is the one spawned
+		if (mobjinfo[i].doomednum >= 0 && mobjinfo[i].doomednum < 4096)
+			bynum[mobjinfo[i].doomednum] = (INT16)i;
+
+	memset(seen, 0, sizeof seen);
+	for (i = 0; i < n; i++)
+	{
+		INT16 type;
+
+		data += 3 * sizeof (INT16); // skip x y position, angle
+		type = bynum[READUINT16(data) & 4095];
+		data += sizeof (INT16); // skip options
+
+		if (type < 0 || (seen[type/8] & (1<<(type%8))))
+			continue;
+		seen[type/8] |= 1<<(type%8);
+
+		R_PrefetchSprite(states[mobjinfo[type].spawnstate].sprite);
+		S_PrefetchMobjSounds((mobjtype_t)type);
+	}
+	free(bynum);
+}
+
+/** Starts getting a map ready ahead of time, so that loading it later
+  * finds its lumps, graphics and sounds cached. Everything but the lumps
+  * is done over the following calls to P_MapPrefetchTicker.
+  *
+  * \param map The map, counting from 0 like nextmap.
+  * \sa P_StopMapPrefetch
+  */
+void P_StartMapPrefetch(INT16 map)
+{
+	lumpnum_t lumpnum;
+	INT32 i;
+
+	P_StopMapPrefetch();
+
+	if (map < 0 || map >= NUMMAPS || !mapheaderinfo[map])
+		return;
+
+	lumpnum = W_CheckNumForName(G_BuildMapName(map+1));
+	if (lumpnum == LUMPERROR)
+		return;
+
+	if (W_IsLumpWad(lumpnum))
+	{
+		W_PrefetchLump(lumpnum);
+		return;
+	}
+
+	// Before the map's lumps are prefetched, since making the MD5 reads
+	// and frees some of them
+	if (rendermode != render_none && cv_warmuptraces.value)
+	{
+		UINT8 md5[16];
+		P_MakeMapMD5(lumpnum, md5);
+		P_LoadWarmupTrace(md5);
+	}
+
+	for (i = ML_THINGS; i <= ML_BLOCKMAP; i++)
+		W_PrefetchLump(lumpnum + i);
+
+	if (rendermode == render_none)
+		return;
+
+	prefetchmaplump = lumpnum;
+	prefetchstep = 0;
+}
+
+/** Does the next step of getting the map P_StartMapPrefetch was given
+  * ready. Call every tic until the map loads.
+  */
+void P_MapPrefetchTicker(void)
+{
+	UINT32 start;
+
+	if (prefetchmaplump == LUMPERROR)
+		return;
+
+	switch (prefetchstep++)
+	{
+		case 0:
+			P_PrefetchMapTextures();
+			return;
+		case 1:
+			P_PrefetchMapFlats();
+			return;
+		case 2:
+			P_PrefetchMapThings();
+			return;
+		default:
+			break;
+	}
+
+	// Only the software renderer draws from the composites
+	if (rendermode == render_soft)
+	{
+		start = I_GetTimeMicros();
+		while (prefetchtexturepos < numprefetchtextures
+			&& I_GetTimeMicros() - start < PREFETCHCOMPOSITEMICROS)
+			R_CheckTextureCache(prefetchtextures[prefetchtexturepos++]);
+
+		if (prefetchtexturepos < numprefetchtextures)
+			return;
+	}
+
+	// Then what the map's warm-up trace says its first minute loads
+	if (P_WarmUpStep(PREFETCHCOMPOSITEMICROS))
+		P_StopMapPrefetch();
+}
+
+/** Forgets about the map P_StartMapPrefetch was getting ready.
+  */
+void P_StopMapPrefetch(void)
+{
+	free(prefetchtextures);
+	prefetchtextures = NULL;
+	numprefetchtextures = prefetchtexturepos = 0;
+	prefetchmaplump = LUMPERROR;
+}
+
+// The phases of P_SetupLevel, for the trace and the -debug log
+#define MAXLOADPHASEDEPTH 4
+static const char *loadphasenames[MAXLOADPHASEDEPTH];
+static UINT32 loadphasestarts[MAXLOADPHASEDEPTH];
+static INT32 loadphasedepth = 0;
+
+//
+// P_BeginLoadPhase
+//
+// Starts timing a step of loading the level, until P_EndLoadPhase.
+//
+static void P_BeginLoadPhase(const char *name)
+{
+	TRACE_BEGIN("level", name);
+	if (loadphasedepth < MAXLOADPHASEDEPTH)
+	{
+		loadphasenames[loadphasedepth] = name;
+		loadphasestarts[loadphasedepth] = I_GetTimeMicros();
+	}
+	loadphasedepth++;
+}
+
+//
+// P_EndLoadPhase
+//
+// Ends the step P_BeginLoadPhase started last, and logs how long it took.
+//
+static void P_EndLoadPhase(void)
+{
+	TRACE_END();
+	if (--loadphasedepth < MAXLOADPHASEDEPTH)
+	{
+		UINT32 elapsed = I_GetTimeMicros() - loadphasestarts[loadphasedepth];
+		CONS_Debug(DBG_SETUP, "%*s%s: %u.%03u ms\n", (int)loadphasedepth*2, "",
+			loadphasenames[loadphasedepth], elapsed/1000, elapsed%1000);
+	}
+}
+
+//
+// P_StartLevelArena
+//
+// Sizes the level arena from the lengths of the map lumps, indexed by ML_,
+// for everything the geometry loaders put in it. FOFs and sidedefs that
+// have to be split aren't known yet, so there's a little to spare for
+// them; whatever else doesn't fit comes from the zone.
+//
+static void P_StartLevelArena(const size_t *lumpsize)
+{
+	size_t lines = lumpsize[ML_LINEDEFS] / sizeof (maplinedef_t);
+	size_t size = 0;
+
+	size += lumpsize[ML_THINGS] / (5 * sizeof (INT16)) * sizeof (mapthing_t);
+	size += lines * (sizeof (line_t) + sizeof (*linecoll) + 2*sizeof (line_t *));
+	size += lumpsize[ML_SIDEDEFS] / sizeof (mapsidedef_t) * sizeof (side_t);
+	size += lumpsize[ML_VERTEXES] / sizeof (mapvertex_t) * sizeof (vertex_t);
+	size += lumpsize[ML_SEGS] / sizeof (mapseg_t) * sizeof (seg_t);
+	size += lumpsize[ML_SSECTORS] / sizeof (mapsubsector_t) * sizeof (subsector_t);
+	size += lumpsize[ML_NODES] / sizeof (mapnode_t) * sizeof (node_t);
+	size += lumpsize[ML_SECTORS] / sizeof (mapsector_t) * (sizeof (sector_t) + 8);
+	size += lumpsize[ML_REJECT];
+
+	// The blockmap's offsets are widened to INT32, and each block has
+	// a mobj and a polyobject chain
+	size += lumpsize[ML_BLOCKMAP] * 2 + lumpsize[ML_BLOCKMAP] / 2 * 2*sizeof (void *);
+
+	Z_StartLevelArena(size + size/8);
+}
+
 /** Loads a level from a lump or external wad.
   *
   * \param skipprecip If true, don't spawn precipitation.
@@ -2686,6 +3207,10 @@ boolean P_SetupLevel(boolean skipprecip)
 	boolean chase;
 
 	levelloading = true;
+	P_BeginLoadPhase("P_SetupLevel");
+
+	P_StopMapPrefetch();
+	P_SaveWarmupTrace(); // the last level's
 
 	// This is needed. Don't touch.
 	maptol = mapheaderinfo[gamemap-1]->typeoflevel;
@@ -2701,6 +3226,9 @@ boolean P_SetupLevel(boolean skipprecip)
 	// Initialize sector node list.
 	P_Initsecnode();
 
+	// Nothing drawn in between tics until the new level has had one.
+	R_ResetInterpolation();
+
 	if (netgame || multiplayer)
 		cv_debug = botskin = 0;
 
@@ -2749,6 +3277,7 @@ boolean P_SetupLevel(boolean skipprecip)
 
 	// Special stage fade to white
 	// This is handled BEFORE sounds are stopped.
+	P_BeginLoadPhase("Wipe and music");
 	if (rendermode != render_none && G_IsSpecialStage(gamemap))
 	{
 		tic_t starttime = I_GetTime();
@@ -2810,21 +3339,21 @@ boolean P_SetupLevel(boolean skipprecip)
 		V_DrawSmallString(1, 195, V_ALLOWLOWERCASE, tx);
 		I_UpdateNoVsync();
 	}
+	P_EndLoadPhase();
 
 #ifdef HAVE_BLUA
 	LUA_InvalidateLevel();
 #endif
 
+	P_BeginLoadPhase("Freeing the old level");
 	for (ss = sectors; sectors+numsectors != ss; ss++)
 	{
 		Z_Free(ss->attached);
 		Z_Free(ss->attachedsolid);
 	}
 
-	// Clear pointers that would be left dangling by the purge
-	R_FlushTranslationColormapCache();
-
 	Z_FreeTags(PU_LEVEL, PU_PURGELEVEL - 1);
+	blockstatics = NULL; // until the new blockmap is loaded
 
 #if defined (WALLSPLATS) || defined (FLOORSPLATS)
 	// clear the splats from previous level
@@ -2833,6 +3362,7 @@ boolean P_SetupLevel(boolean skipprecip)
 
 	P_InitThinkers();
 	P_InitCachedActions();
+	P_EndLoadPhase();
 
 	/// \note for not spawning precipitation, etc. when loading netgame snapshots
 	if (skipprecip)
@@ -2850,6 +3380,14 @@ boolean P_SetupLevel(boolean skipprecip)
 	if (lastloadedmaplumpnum == INT16_MAX)
 		I_Error("Map %s not found.\n", maplumpname);
 
+	// Have every map lump inflated at once while the palette
+	// and sky are set up, instead of one by one as they're parsed.
+	if (!W_IsLumpWad(lastloadedmaplumpnum))
+	{
+		for (i = ML_THINGS; i <= ML_BLOCKMAP; i++)
+			W_PrefetchLump(lastloadedmaplumpnum + i);
+	}
+
 	R_ReInitColormaps(mapheaderinfo[gamemap-1]->palette);
 	CON_SetupBackColormap();
 
@@ -2858,6 +3396,8 @@ boolean P_SetupLevel(boolean skipprecip)
 
 	P_MakeMapMD5(lastloadedmaplumpnum, &mapmd5);
 
+	P_BeginLoadPhase("Geometry");
+
 	// HACK ALERT: Cache the WAD, get the map data into the tables, free memory.
 	// As it is implemented right now, we're assuming an uncompressed WAD.
 	// (As in, a normal PWAD, not ZWAD or anything. The lump itself can be compressed.)
@@ -2869,12 +3409,17 @@ boolean P_SetupLevel(boolean skipprecip)
 		//filelump_t *fileinfo = wadData + ((wadinfo_t *)wadData)->infotableofs;
 		filelump_t *fileinfo = (filelump_t *)(wadData + ((wadinfo_t *)wadData)->infotableofs);
 		UINT32 numlumps = ((wadinfo_t *)wadData)->numlumps;
+		size_t lumpsize[ML_BLOCKMAP + 1];
 
 		if (numlumps < ML_REJECT) // at least 9 lumps should be in the wad for a map to be loaded
 		{
 			I_Error("Bad WAD file for map %s!\n", maplumpname);
 		}
 
+		for (i = 0; i <= ML_BLOCKMAP; i++)
+			lumpsize[i] = ((UINT32)i < numlumps) ? (fileinfo + i)->size : 0;
+		P_StartLevelArena(lumpsize);
+
 		if (numlumps > ML_BLOCKMAP) // enough room for a BLOCKMAP lump at least
 		{
 			loadedbm = P_LoadRawBlockMap(
@@ -2886,6 +3431,8 @@ boolean P_SetupLevel(boolean skipprecip)
 		P_LoadRawSectors(wadData + (fileinfo + ML_SECTORS)->filepos, (fileinfo + ML_SECTORS)->size);
 		P_LoadRawSideDefs((fileinfo + ML_SIDEDEFS)->size);
 		P_LoadRawLineDefs(wadData + (fileinfo + ML_LINEDEFS)->filepos, (fileinfo + ML_LINEDEFS)->size);
+		if (!loadedbm)
+			P_StartBlockMap(); // Graue 02-29-2004
 		P_LoadRawSideDefs2(wadData + (fileinfo + ML_SIDEDEFS)->filepos);
 		P_LoadRawSubsectors(wadData + (fileinfo + ML_SSECTORS)->filepos, (fileinfo + ML_SSECTORS)->size);
 		P_LoadRawNodes(wadData + (fileinfo + ML_NODES)->filepos, (fileinfo + ML_NODES)->size);
@@ -2900,7 +3447,8 @@ boolean P_SetupLevel(boolean skipprecip)
 
 		// Important: take care of the ordering of the next functions.
 		if (!loadedbm)
-			P_CreateBlockMap(); // Graue 02-29-2004
+			P_FinishBlockMap();
+		P_InitBlockStatics();
 		P_LoadLineDefs2();
 		P_GroupLines();
 		numdmstarts = numredctfstarts = numbluectfstarts = 0;
@@ -2917,12 +3465,20 @@ boolean P_SetupLevel(boolean skipprecip)
 	}
 	else
 	{
+		size_t lumpsize[ML_BLOCKMAP + 1];
+
+		for (i = 0; i <= ML_BLOCKMAP; i++)
+			lumpsize[i] = W_CheckNameForNum(lastloadedmaplumpnum + i) ? W_LumpLength(lastloadedmaplumpnum + i) : 0;
+		P_StartLevelArena(lumpsize);
+
 		// Important: take care of the ordering of the next functions.
 		loadedbm = P_LoadBlockMap(lastloadedmaplumpnum + ML_BLOCKMAP);
 		P_LoadVertexes(lastloadedmaplumpnum + ML_VERTEXES);
 		P_LoadSectors(lastloadedmaplumpnum + ML_SECTORS);
 		P_LoadSideDefs(lastloadedmaplumpnum + ML_SIDEDEFS);
 		P_LoadLineDefs(lastloadedmaplumpnum + ML_LINEDEFS);
+		if (!loadedbm)
+			P_StartBlockMap(); // Graue 02-29-2004
 		P_LoadSideDefs2(lastloadedmaplumpnum + ML_SIDEDEFS);
 		P_LoadSubsectors(lastloadedmaplumpnum + ML_SSECTORS);
 		P_LoadNodes(lastloadedmaplumpnum + ML_NODES);
@@ -2931,7 +3487,8 @@ boolean P_SetupLevel(boolean skipprecip)
 
 		// Important: take care of the ordering of the next functions.
 		if (!loadedbm)
-			P_CreateBlockMap(); // Graue 02-29-2004
+			P_FinishBlockMap();
+		P_InitBlockStatics();
 
 		P_LoadLineDefs2();
 		P_GroupLines();
@@ -2945,12 +3502,29 @@ boolean P_SetupLevel(boolean skipprecip)
 		P_MapStart();
 		P_PrepareThings(lastloadedmaplumpnum + ML_THINGS);
 	}
+	P_EndLoadPhase();
 
 #ifdef ESLOPE
 	P_ResetDynamicSlopes();
 #endif
 
+	P_BeginLoadPhase("Sight groups");
+	P_BuildSightGroups();
+	P_ClearSightCache();
+	P_EndLoadPhase();
+
+	P_BeginLoadPhase("P_LoadThings");
 	P_LoadThings();
+	P_EndLoadPhase();
+
+	// Start inflating the level's graphics while the rest gets set up.
+	if (rendermode != render_none)
+	{
+		P_BeginLoadPhase("R_PrefetchLevelGraphics");
+		R_PrefetchLevelGraphics();
+		P_LoadWarmupTrace(mapmd5);
+		P_EndLoadPhase();
+	}
 
 	P_SpawnSecretItems(loademblems);
 
@@ -2959,10 +3533,12 @@ boolean P_SetupLevel(boolean skipprecip)
 			break;
 
 	// set up world state
+	P_BeginLoadPhase("P_SpawnSpecials");
 	P_SpawnSpecials(fromnetsave);
 
 	if (loadprecip) //  ugly hack for P_NetUnArchiveMisc (and P_LoadNetGame)
 		P_SpawnPrecipitation();
+	P_EndLoadPhase();
 
 	globalweather = mapheaderinfo[gamemap-1]->weather;
 
@@ -2974,8 +3550,10 @@ boolean P_SetupLevel(boolean skipprecip)
 		HWR_ResetLights();
 #endif
 		// Correct missing sidedefs & deep water trick
+		P_BeginLoadPhase("HWR_CreatePlanePolygons");
 		HWR_CorrectSWTricks();
 		HWR_CreatePlanePolygons((INT32)numnodes - 1);
+		P_EndLoadPhase();
 	}
 #endif
 
@@ -2988,6 +3566,8 @@ boolean P_SetupLevel(boolean skipprecip)
 		goto netgameskip;
 	// ==========
 
+	P_BeginLoadPhase("Spawning players");
+
 	for (i = 0; i < MAXPLAYERS; i++)
 		if (playeringame[i])
 		{
@@ -3059,6 +3639,7 @@ boolean P_SetupLevel(boolean skipprecip)
 	}
 	else if (gametype == GT_RACE && server && cv_usemapnumlaps.value)
 		CV_StealthSetValue(&cv_numlaps, mapheaderinfo[gamemap - 1]->numlaps);
+	P_EndLoadPhase();
 
 	// ===========
 	// landing point for netgames.
@@ -3125,7 +3706,9 @@ boolean P_SetupLevel(boolean skipprecip)
 #ifdef HWRENDER // not win32 only 19990829 by Kin
 	if (rendermode != render_soft && rendermode != render_none)
 	{
+		P_BeginLoadPhase("HWR_PrepLevelCache");
 		HWR_PrepLevelCache(numtextures);
+		P_EndLoadPhase();
 	}
 #endif
 
@@ -3136,7 +3719,23 @@ boolean P_SetupLevel(boolean skipprecip)
 		V_DrawFill(0, 0, BASEVIDWIDTH, BASEVIDHEIGHT, (ranspecialwipe) ? 0 : 31);
 
 	if (precache || dedicated)
+	{
+		P_BeginLoadPhase("R_PrecacheLevel");
 		R_PrecacheLevel();
+		P_EndLoadPhase();
+	}
+
+	P_BeginLoadPhase("S_PrefetchLevelSounds");
+	S_PrefetchLevelSounds();
+	P_EndLoadPhase();
+
+	// What the intermission didn't get to
+	if (rendermode != render_none)
+	{
+		P_BeginLoadPhase("P_WarmUpStep");
+		P_WarmUpStep(0);
+		P_EndLoadPhase();
+	}
 
 	nextmapoverride = 0;
 	skipstats = false;
@@ -3172,12 +3771,29 @@ boolean P_SetupLevel(boolean skipprecip)
 			if (playeringame[i])
 				G_CopyTiccmd(&players[i].cmd, &netcmds[buf][i], 1);
 		}
+		P_BeginLoadPhase("P_PreTicker");
 		P_PreTicker(2);
 #ifdef HAVE_BLUA
 		LUAh_MapLoad();
 #endif
+		P_EndLoadPhase();
 	}
 
+	P_EndLoadPhase();
+
+	{
+		size_t used, size, spilled;
+		Z_LevelArenaUsage(&used, &size, &spilled);
+		CONS_Debug(DBG_SETUP, "Level arena: %s of %s KB used, %s KB didn't fit\n",
+			sizeu1(used>>10), sizeu2(size>>10), sizeu3(spilled>>10));
+	}
+
+	P_StartWarmupTrace(mapmd5);
+
+	// Startup is over once the first level is in.
+	if (tracing)
+		M_FinishTrace();
+
 	return true;
 }
 
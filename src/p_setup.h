@@ -21,6 +21,8 @@
 // map md5, sent to players via PT_SERVERINFO
 extern unsigned char mapmd5[16];
 
+extern consvar_t cv_blockmapcache;
+
 // Player spawn spots for deathmatch.
 #define MAX_DM_STARTS 64
 extern mapthing_t *deathmatchstarts[MAX_DM_STARTS];
@@ -42,6 +44,8 @@ typedef struct
 	INT32 animseq; // start pos. in the anim sequence
 	INT32 numpics;
 	INT32 speed;
+
+	INT32 hashnext; // 1 + the next levelflat in the same name chain, 0 at the end
 } levelflat_t;
 
 extern size_t numlevelflats;
@@ -58,6 +62,9 @@ void P_SetupLevelSky(INT32 skynum, boolean global);
 void P_ScanThings(INT16 mapnum, INT16 wadnum, INT16 lumpnum);
 #endif
 void P_LoadThingsOnly(void);
+void P_StartMapPrefetch(INT16 map);
+void P_MapPrefetchTicker(void);
+void P_StopMapPrefetch(void);
 boolean P_SetupLevel(boolean skipprecip);
 boolean P_AddWadFile(const char *wadfilename);
 #ifdef DELFILE
@@ -10,9 +10,16 @@
 //-----------------------------------------------------------------------------
 /// \file  p_sight.c
 /// \brief Line of sight/visibility checks, uses REJECT lookup table
+///
+///        Most maps have no REJECT, so at load the sectors are also split
+///        into groups that share no two-sided line: nothing can see from
+///        one group into another. Traces that do run are kept for the
+///        rest of the tic, or until the level changes shape, since the
+///        same two things tend to get checked more than once.
 
 #include "doomdef.h"
 #include "doomstat.h"
+#include "m_bench.h"
 #include "p_local.h"
 #include "r_main.h"
 #include "r_state.h"
@@ -32,6 +39,22 @@ typedef struct {
 
 static INT32 sightcounts[2];
 
+// Which group each sector is in, or NULL if every sector is in one
+static INT32 *sightgroups;
+
+#define SIGHTMEMOSIZE 256 // must be a power of two
+
+typedef struct
+{
+	mobj_t *t1, *t2;
+	fixed_t pos[8]; // x, y, z and height of both
+	UINT32 stamp;
+	boolean result;
+} sightmemo_t;
+
+static sightmemo_t sightmemo[SIGHTMEMOSIZE];
+static UINT32 sightstamp = 1;
+
 //
 // P_DivlineSide
 //
@@ -299,50 +322,98 @@ static boolean P_CrossBSPNode(INT32 bspnum, register los_t *los)
 }
 
 //
-// P_CheckSight
+// P_BuildSightGroups
 //
-// Returns true if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// Joins the sectors on either side of every two-sided seg, and every
+// seg's sector with its subsector's. Sectors that end up apart can't
+// see each other however their floors and ceilings move.
 //
-boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+void P_BuildSightGroups(void)
 {
-	const sector_t *s1, *s2;
-	size_t pnum;
-	los_t los;
+	INT32 *parent;
+	INT32 a, b, groups;
+	size_t i, j;
+
+	sightgroups = NULL;
+	if (!numsectors)
+		return;
+
+	parent = Z_Malloc(numsectors * sizeof (*parent), PU_STATIC, NULL);
+	for (i = 0; i < numsectors; i++)
+		parent[i] = (INT32)i;
+
+#define FINDGROUP(x) while (parent[x] != x) x = parent[x] = parent[parent[x]]
+#define JOINSECTORS(s1, s2) \
+	{ \
+		a = (INT32)((s1) - sectors); \
+		b = (INT32)((s2) - sectors); \
+		FINDGROUP(a); \
+		FINDGROUP(b); \
+		if (a != b) \
+			parent[a > b ? a : b] = a > b ? b : a; \
+	}
 
-	// First check for trivial rejection.
-	if (!t1 || !t2)
-		return false;
+	for (i = 0; i < numsubsectors; i++)
+	{
+		const seg_t *seg = &segs[subsectors[i].firstline];
 
-	I_Assert(!P_MobjWasRemoved(t1));
-	I_Assert(!P_MobjWasRemoved(t2));
+		for (j = 0; j < subsectors[i].numlines; j++, seg++)
+		{
+			if (seg->frontsector && subsectors[i].sector)
+				JOINSECTORS(subsectors[i].sector, seg->frontsector)
+			if (seg->frontsector && seg->backsector)
+				JOINSECTORS(seg->frontsector, seg->backsector)
+		}
+	}
 
-	if (!t1->subsector || !t2->subsector
-	|| !t1->subsector->sector || !t2->subsector->sector)
-		return false;
+#undef JOINSECTORS
+#undef FINDGROUP
 
-	s1 = t1->subsector->sector;
-	s2 = t2->subsector->sector;
-	pnum = (s1-sectors)*numsectors + (s2-sectors);
+	groups = 0;
+	for (i = 0; i < numsectors; i++)
+	{
+		a = (INT32)i;
+		while (parent[a] != a)
+			a = parent[a];
+		parent[i] = a;
+		if (a == (INT32)i)
+			groups++;
+	}
 
-	if (rejectmatrix != NULL)
+	CONS_Debug(DBG_SETUP, "P_BuildSightGroups: %d sight groups\n", groups);
+
+	if (groups > 1)
 	{
-		// Check in REJECT table.
-		if (rejectmatrix[pnum>>3] & (1 << (pnum&7))) // can't possibly be connected
-			return false;
+		sightgroups = Z_Malloc(numsectors * sizeof (*sightgroups), PU_LEVEL, &sightgroups);
+		M_Memcpy(sightgroups, parent, numsectors * sizeof (*sightgroups));
 	}
+	Z_Free(parent);
+}
 
-	// killough 11/98: shortcut for melee situations
-	// same subsector? obviously visible
-#ifndef POLYOBJECTS
-	if (t1->subsector == t2->subsector)
-		return true;
-#else
-	// haleyjd 02/23/06: can't do this if there are polyobjects in the subsec
-	if (!t1->subsector->polyList &&
-		t1->subsector == t2->subsector)
-		return true;
-#endif
+//
+// P_ClearSightCache
+//
+// Forgets every remembered trace.
+//
+void P_ClearSightCache(void)
+{
+	if (!++sightstamp)
+	{
+		memset(sightmemo, 0, sizeof (sightmemo));
+		sightstamp = 1;
+	}
+}
+
+//
+// P_TraceSight
+//
+// The actual line of sight check between two things in different
+// subsectors.
+//
+static boolean P_TraceSight(mobj_t *t1, mobj_t *t2)
+{
+	const sector_t *s1 = t1->subsector->sector, *s2 = t2->subsector->sector;
+	los_t los;
 
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
@@ -421,3 +492,81 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 	// the head node is the last node output
 	return P_CrossBSPNode((INT32)numnodes - 1, &los);
 }
+
+//
+// P_CheckSight
+//
+// Returns true if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+static boolean P_DoCheckSight(mobj_t *t1, mobj_t *t2)
+{
+	const sector_t *s1, *s2;
+	size_t pnum;
+	sightmemo_t *memo;
+	fixed_t pos[8];
+
+	// First check for trivial rejection.
+	if (!t1 || !t2)
+		return false;
+
+	I_Assert(!P_MobjWasRemoved(t1));
+	I_Assert(!P_MobjWasRemoved(t2));
+
+	if (!t1->subsector || !t2->subsector
+	|| !t1->subsector->sector || !t2->subsector->sector)
+		return false;
+
+	s1 = t1->subsector->sector;
+	s2 = t2->subsector->sector;
+	pnum = (s1-sectors)*numsectors + (s2-sectors);
+
+	if (rejectmatrix != NULL)
+	{
+		// Check in REJECT table.
+		if (rejectmatrix[pnum>>3] & (1 << (pnum&7))) // can't possibly be connected
+			return false;
+	}
+
+	if (sightgroups && sightgroups[s1-sectors] != sightgroups[s2-sectors])
+		return false;
+
+	// killough 11/98: shortcut for melee situations
+	// same subsector? obviously visible
+#ifndef POLYOBJECTS
+	if (t1->subsector == t2->subsector)
+		return true;
+#else
+	// haleyjd 02/23/06: can't do this if there are polyobjects in the subsec
+	if (!t1->subsector->polyList &&
+		t1->subsector == t2->subsector)
+		return true;
+#endif
+
+	pos[0] = t1->x; pos[1] = t1->y; pos[2] = t1->z; pos[3] = t1->height;
+	pos[4] = t2->x; pos[5] = t2->y; pos[6] = t2->z; pos[7] = t2->height;
+
+	// The slot only decides what gets pushed out, so hashing
+	// the pointers doesn't make anyone see anything different.
+	memo = &sightmemo[(((size_t)t1 >> 4) ^ ((size_t)t2 >> 2) ^ ((size_t)t2 >> 9)) & (SIGHTMEMOSIZE - 1)];
+	if (memo->stamp == sightstamp && memo->t1 == t1 && memo->t2 == t2
+	&& !memcmp(memo->pos, pos, sizeof (pos)))
+		return memo->result;
+
+	memo->t1 = t1;
+	memo->t2 = t2;
+	M_Memcpy(memo->pos, pos, sizeof (pos));
+	memo->result = P_TraceSight(t1, t2);
+	memo->stamp = sightstamp;
+	return memo->result;
+}
+
+boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+{
+	boolean r;
+
+	BENCH_ENTER(BENCH_SIGHT);
+	r = P_DoCheckSight(t1, t2);
+	BENCH_EXIT(BENCH_SIGHT);
+	return r;
+}
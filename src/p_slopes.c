@@ -25,7 +25,7 @@
 
 #ifdef ESLOPE
 
-static pslope_t *slopelist = NULL;
+pslope_t *slopelist = NULL;
 static UINT16 slopecount = 0;
 
 // Calculate line normal
@@ -740,19 +740,6 @@ void P_ResetDynamicSlopes(void) {
 // Various utilities related to slopes
 //
 
-//
-// P_GetZAt
-//
-// Returns the height of the sloped plane at (x, y) as a fixed_t
-//
-fixed_t P_GetZAt(pslope_t *slope, fixed_t x, fixed_t y)
-{
-   fixed_t dist = FixedMul(x - slope->o.x, slope->d.x) +
-                  FixedMul(y - slope->o.y, slope->d.y);
-
-   return slope->o.z + FixedMul(dist, slope->zdelta);
-}
-
 
 //
 // P_QuantizeMomentumToSlope
@@ -14,6 +14,8 @@
 #define P_SLOPES_H__
 
 #ifdef ESLOPE
+extern pslope_t *slopelist; // every slope in the level
+
 void P_CalculateSlopeNormal(pslope_t *slope);
 void P_ResetDynamicSlopes(void);
 void P_RunDynamicSlopes(void);
@@ -32,7 +34,16 @@ void P_CopySectorSlope(line_t *line);
 pslope_t *P_SlopeById(UINT16 id);
 
 // Returns the height of the sloped plane at (x, y) as a fixed_t
-fixed_t P_GetZAt(pslope_t *slope, fixed_t x, fixed_t y);
+// Inline, since it's called for every sloped plane a thing or seg touches.
+// Keep the FixedMuls in this order: folding zdelta into d would round
+// differently, and heights have to match old demos and other clients.
+FUNCINLINE static ATTRINLINE fixed_t P_GetZAt(pslope_t *slope, fixed_t x, fixed_t y)
+{
+	fixed_t dist = FixedMul(x - slope->o.x, slope->d.x) +
+	               FixedMul(y - slope->o.y, slope->d.y);
+
+	return slope->o.z + FixedMul(dist, slope->zdelta);
+}
 
 // Lots of physics-based bullshit
 void P_QuantizeMomentumToSlope(vector3_t *momentum, pslope_t *slope);
@@ -0,0 +1,423 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_snapshot.c
+/// \brief A ring of savegame snapshots of the last few tics
+///
+///        A difference is a list of runs: either bytes to copy from the
+///        newer archive, or bytes that are new. Most of an archive is the
+///        same as a tic later, except where things were spawned or removed
+///        and everything after moved over. So the encoder first tries the
+///        same place in the newer archive, and otherwise looks the next few
+///        bytes up in an index of where every MINMATCH-th stretch of the
+///        newer archive is.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "byteptr.h"
+#include "i_system.h"
+#include "p_saveg.h"
+#include "p_snapshot.h"
+#include "z_zone.h"
+
+#define SNAPSHOTSIZE (4*1024*1024) // whole mobjs take more room than a savegame for joining
+#define MAXSNAPSHOTS (10*TICRATE)
+
+static void Snapshots_OnChange(void);
+
+static CV_PossibleValue_t snapshots_cons_t[] = {{0, "MIN"}, {MAXSNAPSHOTS, "MAX"}, {0, NULL}};
+consvar_t cv_snapshots = {"snapshots", "0", CV_CALL, snapshots_cons_t, Snapshots_OnChange, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct
+{
+	tic_t tic;
+	UINT8 *delta; // how to get this tic's archive from the next one's
+	size_t length, capacity;
+	size_t fullsize; // of this tic's archive
+	UINT32 archivemicros, deltamicros; // how long this tic took to take
+} snapshot_t;
+
+// Oldest first, newest at (first + numsnapshots - 1) % MAXSNAPSHOTS
+static snapshot_t snapshots[MAXSNAPSHOTS];
+static INT32 firstsnapshot, numsnapshots;
+
+// The newest archive in full, and the one being taken
+static UINT8 *newest = NULL, *incoming = NULL;
+static size_t newestsize;
+static tic_t newesttic;
+static boolean havenewest = false;
+static UINT32 newestmicros;
+
+static UINT8 *encoded = NULL; // a difference being written
+static UINT8 *rebuilt[2] = {NULL, NULL}; // for P_ReadSnapshot
+
+#define MINMATCH 8
+#define INDEXBITS 16
+static UINT32 *matchindex = NULL; // position + 1 of each stretch by its hash
+
+#define ENCODEDSIZE (SNAPSHOTSIZE + SNAPSHOTSIZE/2 + 64)
+
+static void Snapshots_OnChange(void)
+{
+	P_ClearSnapshots();
+}
+
+void P_ClearSnapshots(void)
+{
+	INT32 i;
+
+	for (i = 0; i < MAXSNAPSHOTS; i++)
+	{
+		Z_Free(snapshots[i].delta);
+		snapshots[i].delta = NULL;
+		snapshots[i].capacity = 0;
+	}
+	firstsnapshot = numsnapshots = 0;
+	havenewest = false;
+
+	Z_Free(newest);
+	Z_Free(incoming);
+	Z_Free(encoded);
+	Z_Free(rebuilt[0]);
+	Z_Free(rebuilt[1]);
+	Z_Free(matchindex);
+	newest = incoming = encoded = rebuilt[0] = rebuilt[1] = NULL;
+	matchindex = NULL;
+}
+
+//
+// Varints, for the run headers
+//
+
+static UINT8 *P_WriteVarUInt(UINT8 *p, UINT32 n)
+{
+	while (n >= 0x80)
+	{
+		*p++ = (UINT8)(n | 0x80);
+		n >>= 7;
+	}
+	*p++ = (UINT8)n;
+	return p;
+}
+
+static const UINT8 *P_ReadVarUInt(const UINT8 *p, UINT32 *n)
+{
+	UINT8 b, shift = 0;
+
+	*n = 0;
+	do
+	{
+		b = *p++;
+		if (shift < 32)
+			*n |= (UINT32)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return p;
+}
+
+static inline UINT32 P_HashStretch(const UINT8 *p)
+{
+	UINT32 a, b;
+
+	M_Memcpy(&a, p, 4);
+	M_Memcpy(&b, p + 4, 4);
+	return ((a * 2654435761u) ^ (b * 2246822519u)) >> (32 - INDEXBITS);
+}
+
+//
+// P_EncodeDifference
+//
+// Writes how to make target out of ref. Runs are a varint of the length
+// times two, plus one for a copy; copies then give where they're from,
+// relative to where the last one ended, and new bytes are written out.
+//
+static size_t P_EncodeDifference(const UINT8 *target, size_t targetsize, const UINT8 *ref, size_t refsize, UINT8 *out)
+{
+	UINT8 *p = out;
+	size_t t = 0, r = 0, literal = 0, i;
+
+	memset(matchindex, 0, (sizeof *matchindex) << INDEXBITS);
+	for (i = 0; i + MINMATCH <= refsize; i += MINMATCH)
+		matchindex[P_HashStretch(ref + i)] = (UINT32)i + 1;
+
+	p = P_WriteVarUInt(p, (UINT32)targetsize);
+
+	while (t < targetsize)
+	{
+		size_t from = SIZE_MAX, len;
+
+		if (t + MINMATCH <= targetsize)
+		{
+			if (r + MINMATCH <= refsize && !memcmp(target + t, ref + r, MINMATCH))
+				from = r;
+			else
+			{
+				const UINT32 pos = matchindex[P_HashStretch(target + t)];
+				if (pos && pos - 1 + MINMATCH <= refsize && !memcmp(target + t, ref + pos - 1, MINMATCH))
+					from = pos - 1;
+			}
+		}
+
+		if (from == SIZE_MAX)
+		{
+			// Keep the place in ref in step, for bytes that just changed
+			t++;
+			r++;
+			continue;
+		}
+
+		if (t > literal)
+		{
+			p = P_WriteVarUInt(p, (UINT32)(t - literal) << 1);
+			M_Memcpy(p, target + literal, t - literal);
+			p += t - literal;
+		}
+
+		for (len = MINMATCH; t + len < targetsize && from + len < refsize; len++)
+			if (target[t + len] != ref[from + len])
+				break;
+
+		p = P_WriteVarUInt(p, ((UINT32)len << 1) | 1);
+		{
+			const INT32 offset = (INT32)from - (INT32)r;
+			p = P_WriteVarUInt(p, ((UINT32)offset << 1) ^ (offset < 0 ? UINT32_MAX : 0));
+		}
+
+		t += len;
+		r = from + len;
+		literal = t;
+	}
+
+	if (t > literal)
+	{
+		p = P_WriteVarUInt(p, (UINT32)(t - literal) << 1);
+		M_Memcpy(p, target + literal, t - literal);
+		p += t - literal;
+	}
+
+	return p - out;
+}
+
+// Undoes P_EncodeDifference, and returns the size of what it made.
+static size_t P_DecodeDifference(const UINT8 *delta, const UINT8 *ref, UINT8 *out)
+{
+	const UINT8 *p = delta;
+	UINT32 targetsize, run, offset;
+	size_t t = 0, r = 0;
+
+	p = P_ReadVarUInt(p, &targetsize);
+	while (t < targetsize)
+	{
+		p = P_ReadVarUInt(p, &run);
+		if (run & 1)
+		{
+			p = P_ReadVarUInt(p, &offset);
+			r += (INT32)(offset >> 1) ^ -(INT32)(offset & 1);
+			M_Memcpy(out + t, ref + r, run >> 1);
+			r += run >> 1;
+		}
+		else
+		{
+			M_Memcpy(out + t, p, run >> 1);
+			p += run >> 1;
+			r += run >> 1;
+		}
+		t += run >> 1;
+	}
+
+	return targetsize;
+}
+
+void P_TakeSnapshot(tic_t tic)
+{
+	UINT8 *oldsave_p = save_p;
+	UINT32 start, micros;
+	size_t size;
+
+	if (!cv_snapshots.value || gamestate != GS_LEVEL)
+		return;
+
+	if (!newest)
+	{
+		newest = Z_Malloc(SNAPSHOTSIZE, PU_STATIC, NULL);
+		incoming = Z_Malloc(SNAPSHOTSIZE, PU_STATIC, NULL);
+		encoded = Z_Malloc(ENCODEDSIZE, PU_STATIC, NULL);
+		matchindex = Z_Malloc((sizeof *matchindex) << INDEXBITS, PU_STATIC, NULL);
+	}
+
+	start = I_GetTimeMicros();
+	save_p = incoming;
+	P_SaveNetSnapshot();
+	size = save_p - incoming;
+	save_p = oldsave_p;
+	if (size > SNAPSHOTSIZE)
+		I_Error("P_TakeSnapshot: snapshot buffer overrun");
+	micros = I_GetTimeMicros() - start;
+
+	if (havenewest)
+	{
+		snapshot_t *s;
+		size_t length;
+		UINT8 *buf = NULL;
+		size_t capacity = 0;
+
+		// The oldest goes, if there's no room for another, and its
+		// memory goes to the new one
+		if (numsnapshots >= cv_snapshots.value)
+		{
+			s = &snapshots[firstsnapshot];
+			buf = s->delta;
+			capacity = s->capacity;
+			s->delta = NULL;
+			s->capacity = 0;
+			firstsnapshot = (firstsnapshot + 1) % MAXSNAPSHOTS;
+			numsnapshots--;
+		}
+		s = &snapshots[(firstsnapshot + numsnapshots) % MAXSNAPSHOTS];
+		numsnapshots++;
+		if (buf)
+		{
+			Z_Free(s->delta);
+			s->delta = buf;
+			s->capacity = capacity;
+		}
+
+		start = I_GetTimeMicros();
+		length = P_EncodeDifference(newest, newestsize, incoming, size, encoded);
+		if (length > ENCODEDSIZE)
+			I_Error("P_TakeSnapshot: difference buffer overrun");
+		if (length > s->capacity)
+		{
+			s->delta = Z_Realloc(s->delta, length, PU_STATIC, NULL);
+			s->capacity = length;
+		}
+		M_Memcpy(s->delta, encoded, length);
+
+		s->tic = newesttic;
+		s->length = length;
+		s->fullsize = newestsize;
+		s->archivemicros = newestmicros;
+		s->deltamicros = I_GetTimeMicros() - start;
+	}
+
+	// The one just taken is the newest now
+	{
+		UINT8 *swap = newest;
+		newest = incoming;
+		incoming = swap;
+	}
+	newestsize = size;
+	newesttic = tic;
+	newestmicros = micros;
+	havenewest = true;
+}
+
+const UINT8 *P_ReadSnapshot(tic_t tic, size_t *length)
+{
+	const UINT8 *ref;
+	INT32 i, n;
+
+	if (!havenewest)
+		return NULL;
+	if (tic == newesttic)
+	{
+		*length = newestsize;
+		return newest;
+	}
+
+	// Is it there at all?
+	for (i = numsnapshots - 1; i >= 0; i--)
+		if (snapshots[(firstsnapshot + i) % MAXSNAPSHOTS].tic == tic)
+			break;
+	if (i < 0)
+		return NULL;
+
+	if (!rebuilt[0])
+	{
+		rebuilt[0] = Z_Malloc(SNAPSHOTSIZE, PU_STATIC, NULL);
+		rebuilt[1] = Z_Malloc(SNAPSHOTSIZE, PU_STATIC, NULL);
+	}
+
+	// Undo the differences one at a time, from the newest back
+	ref = newest;
+	for (n = numsnapshots - 1; n >= i; n--)
+	{
+		const snapshot_t *s = &snapshots[(firstsnapshot + n) % MAXSNAPSHOTS];
+		UINT8 *out = rebuilt[n & 1];
+
+		*length = P_DecodeDifference(s->delta, ref, out);
+		ref = out;
+	}
+	return ref;
+}
+
+void Command_Snapshotstats_f(void)
+{
+	size_t total = 0, fulltotal = 0, biggest = 0;
+	UINT32 archivetime = 0, deltatime = 0, slowest = 0;
+	INT32 i;
+
+	if (!cv_snapshots.value)
+	{
+		CONS_Printf(M_GetText("Set snapshots to the number of tics to keep first.\n"));
+		return;
+	}
+	if (!numsnapshots)
+	{
+		CONS_Printf(M_GetText("No snapshots yet.\n"));
+		return;
+	}
+
+	for (i = 0; i < numsnapshots; i++)
+	{
+		const snapshot_t *s = &snapshots[(firstsnapshot + i) % MAXSNAPSHOTS];
+		const UINT32 micros = s->archivemicros + s->deltamicros;
+
+		total += s->length;
+		fulltotal += s->fullsize;
+		biggest = max(biggest, s->length);
+		archivetime += s->archivemicros;
+		deltatime += s->deltamicros;
+		slowest = max(slowest, micros);
+	}
+
+	CONS_Printf(M_GetText("%d snapshots, tics %u to %u\n"), numsnapshots + 1,
+		snapshots[firstsnapshot].tic, newesttic);
+	CONS_Printf(M_GetText("Newest in full: %s KB\n"), sizeu1(newestsize>>10));
+	CONS_Printf(M_GetText("Differences: %s KB in all, %s bytes each on average, %s at most\n"),
+		sizeu1(total>>10), sizeu2(total/numsnapshots), sizeu3(biggest));
+	CONS_Printf(M_GetText("Archives: %s KB each on average\n"), sizeu1((fulltotal/numsnapshots)>>10));
+	CONS_Printf(M_GetText("Time per tic: %u us archiving, %u us finding differences, %u us at most\n"),
+		archivetime/numsnapshots, deltatime/numsnapshots, slowest);
+
+	// The same tic archived both ways, into the buffer that's free between tics
+	if (gamestate == GS_LEVEL)
+	{
+		UINT8 *oldsave_p = save_p;
+		UINT32 start, fieldmicros, packedmicros;
+		size_t fieldsize, packedsize;
+
+		start = I_GetTimeMicros();
+		save_p = incoming;
+		P_SaveNetGame();
+		fieldsize = save_p - incoming;
+		fieldmicros = I_GetTimeMicros() - start;
+
+		start = I_GetTimeMicros();
+		save_p = incoming;
+		P_SaveNetSnapshot();
+		packedsize = save_p - incoming;
+		packedmicros = I_GetTimeMicros() - start;
+		save_p = oldsave_p;
+
+		if (max(fieldsize, packedsize) > SNAPSHOTSIZE)
+			I_Error("Command_Snapshotstats_f: snapshot buffer overrun");
+		CONS_Printf(M_GetText("Now: %u us and %s KB field by field, %u us and %s KB packed\n"),
+			fieldmicros, sizeu1(fieldsize>>10), packedmicros, sizeu2(packedsize>>10));
+	}
+}
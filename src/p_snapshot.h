@@ -0,0 +1,45 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_snapshot.h
+/// \brief A ring of savegame snapshots of the last few tics
+///
+///        With snapshots set, the game is archived with P_SaveNetSnapshot
+///        after every tic, which copies players and mobjs whole rather than
+///        a field at a time as they're sent to a joining player. Only the
+///        newest archive is kept whole. Each older one is kept as the
+///        difference from the one after it, which is usually a few
+///        kilobytes, so going back n tics means undoing n differences.
+
+#ifndef __P_SNAPSHOT__
+#define __P_SNAPSHOT__
+
+#include "command.h"
+
+extern consvar_t cv_snapshots;
+
+/**	\brief Archives the game as it is after running tic, if snapshots is on.
+*/
+void P_TakeSnapshot(tic_t tic);
+
+/**	\brief Forgets every snapshot, for when the game starts over.
+*/
+void P_ClearSnapshots(void);
+
+/**	\brief Rebuilds the archive of an earlier tic.
+	\param	tic	the tic to rebuild
+	\param	length	set to the archive's size
+	\return	the archive, good until the next call, or NULL if tic isn't kept
+*/
+const UINT8 *P_ReadSnapshot(tic_t tic, size_t *length);
+
+/**	\brief The snapshotstats command: how big and slow the snapshots are.
+*/
+void Command_Snapshotstats_f(void);
+
+#endif // __P_SNAPSHOT__
@@ -30,9 +30,12 @@
 #include "r_sky.h"
 #include "p_polyobj.h"
 #include "p_slopes.h"
+#include "p_predict.h"
+#include "p_threads.h"
 #include "hu_stuff.h"
 #include "m_misc.h"
 #include "m_cond.h" //unlock triggers
+#include "m_bench.h"
 #include "lua_hook.h" // LUAh_LinedefExecute
 
 #ifdef HW3SOUND
@@ -114,6 +117,7 @@ static void P_AddSpikeThinker(sector_t *sec, INT32 referrer);
 static anim_t *lastanim;
 static anim_t *anims = NULL; /// \todo free leak
 static size_t maxanims;
+static tic_t animtic = 0; // leveltime P_UpdateSpecials last animated for
 
 //
 // P_InitPicAnims
@@ -345,6 +349,10 @@ void P_InitPicAnims(void)
 	lastanim->istexture = -1;
 	R_ClearTextureNumCache(false);
 
+	// texturetranslation may have just been reset, so animate everything
+	// again on the next tic, whatever leveltime it is
+	animtic = (tic_t)-2;
+
 	// Clear animdefs now that we're done with it.
 	// We'll only be using anims from now on.
 	if (animdefs != harddefs)
@@ -352,6 +360,29 @@ void P_InitPicAnims(void)
 	animdefs = NULL;
 }
 
+/** Finds the texture animation a texture is a frame of.
+  *
+  * \param tex Texture number.
+  * \param basepic Set to the animation's first frame.
+  * \param numpics Set to the number of frames.
+  * eturn True if tex is animated, false if not.
+  * \sa P_InitPicAnims
+  */
+boolean P_GetTextureAnimation(INT32 tex, INT32 *basepic, INT32 *numpics)
+{
+	anim_t *anim;
+
+	for (anim = anims; anim < lastanim; anim++)
+	{
+		if (!anim->istexture || tex < anim->basepic || tex > anim->picnum)
+			continue;
+		*basepic = anim->basepic;
+		*numpics = anim->numpics;
+		return true;
+	}
+	return false;
+}
+
 void P_ParseANIMDEFSLump(INT32 wadNum, UINT16 lumpnum)
 {
 	char *animdefsLump;
@@ -1447,6 +1478,25 @@ static boolean PolyDisplace(line_t *line)
 
 #endif // ifdef POLYOBJECTS
 
+/** Works out a sector's fofflags again from its FOFs.
+  * Has to be called whenever a FOF is added to the sector or one of its
+  * FOFs' flags change, so movement code can skip its FOFs safely.
+  *
+  * \param sec Sector whose FOFs changed.
+  * \sa P_FOFMOVEFLAGS
+  */
+void P_RecalcFOFFlags(sector_t *sec)
+{
+	ffloor_t *rover;
+
+	P_ClearTouchCache();
+
+	sec->fofflags = 0;
+	for (rover = sec->ffloors; rover; rover = rover->next)
+		if (rover->flags & FF_EXISTS)
+			sec->fofflags |= rover->flags;
+}
+
 /** Changes a sector's tag.
   * Used by the linedef executor tag changer and by crumblers.
   *
@@ -1562,33 +1612,123 @@ INT32 P_FindMinSurroundingLight(sector_t *sector, INT32 max)
 	return min;
 }
 
-void T_ExecutorDelay(executor_t *e)
+//
+// Delayed linedef executors
+//
+// Each delay used to be a thinker counting down every tic. Now they wait
+// in a wheel of slots, one per tic, and only the slot that's due is
+// looked at. One that is further off than the wheel is long stays in its
+// slot until its lap comes around.
+//
+// executortic counts the times P_RunExecutorDelays has run, which is once
+// per P_RunThinkers, right after the THINK_MAIN list. A delay of n runs
+// on the nth of those from when it's made, counting the current one if
+// THINK_MAIN hasn't finished yet: the tic the old thinker would have
+// counted down to zero on. Delays due on the same tic run in the order
+// they were made, like the thinkers did.
+//
+#define EXECUTORWHEELSIZE 256 // power of two
+
+static executor_t *executorwheel[EXECUTORWHEELSIZE];
+static executor_t **executorwheeltail[EXECUTORWHEELSIZE];
+static tic_t executortic;
+
+void P_InitExecutorDelays(void)
+{
+	INT32 i;
+
+	for (i = 0; i < EXECUTORWHEELSIZE; i++)
+	{
+		executorwheel[i] = NULL;
+		executorwheeltail[i] = &executorwheel[i];
+	}
+	executortic = 0;
+}
+
+// For when the level isn't being purged along with them
+void P_FreeExecutorDelays(void)
+{
+	executor_t *e, *next;
+	INT32 i;
+
+	for (i = 0; i < EXECUTORWHEELSIZE; i++)
+		for (e = executorwheel[i]; e; e = next)
+		{
+			next = e->next;
+			P_SetTarget(&e->caller, NULL);
+			Z_Free(e);
+		}
+	P_InitExecutorDelays();
+}
+
+executor_t *P_QueueExecutorDelay(line_t *line, mobj_t *mobj, sector_t *sector, INT32 timer)
 {
-	if (--e->timer <= 0)
+	executor_t *e = Z_Calloc(sizeof (*e), PU_LEVSPEC, NULL);
+	size_t slot;
+
+	e->line = line;
+	e->sector = sector;
+	e->due = executortic + max(timer, 1) - 1;
+	P_SetTarget(&e->caller, mobj); // Use P_SetTarget to make sure the mobj doesn't get freed while we're delaying.
+
+	slot = e->due & (EXECUTORWHEELSIZE-1);
+	*executorwheeltail[slot] = e;
+	executorwheeltail[slot] = &e->next;
+	return e;
+}
+
+// What the old thinker's timer would be now
+INT32 P_ExecutorDelayTimer(const executor_t *e)
+{
+	return (INT32)(e->due - executortic) + 1;
+}
+
+// Calls func on every waiting delay, soonest slot first
+void P_IterateExecutorDelays(void (*func)(executor_t *))
+{
+	executor_t *e;
+	tic_t i;
+
+	for (i = 0; i < EXECUTORWHEELSIZE; i++)
+		for (e = executorwheel[(executortic + i) & (EXECUTORWHEELSIZE-1)]; e; e = e->next)
+			func(e);
+}
+
+void P_RunExecutorDelays(void)
+{
+	const size_t slot = executortic & (EXECUTORWHEELSIZE-1);
+	executor_t **prev = &executorwheel[slot];
+	executor_t *e;
+
+	// Delays run now can queue more for this same slot; they go on
+	// the end, so they get their turn before this is done.
+	while ((e = *prev) != NULL)
 	{
+		if (e->due != executortic)
+		{
+			prev = &e->next;
+			continue;
+		}
+
+		if ((*prev = e->next) == NULL)
+			executorwheeltail[slot] = prev;
+
 		if (e->caller && P_MobjWasRemoved(e->caller)) // If the mobj died while we were delaying
 			P_SetTarget(&e->caller, NULL); // Call with no mobj!
 		P_ProcessLineSpecial(e->line, e->caller, e->sector);
 		P_SetTarget(&e->caller, NULL); // Let the mobj know it can be removed now.
-		P_RemoveThinker(&e->thinker);
+		Z_Free(e);
 	}
+
+	executortic++;
 }
 
 static void P_AddExecutorDelay(line_t *line, mobj_t *mobj, sector_t *sector)
 {
-	executor_t *e;
-
 	if (!line->backsector)
 		I_Error("P_AddExecutorDelay: Line has no backsector!\n");
 
-	e = Z_Calloc(sizeof (*e), PU_LEVSPEC, NULL);
-
-	e->thinker.function.acp1 = (actionf_p1)T_ExecutorDelay;
-	e->line = line;
-	e->sector = sector;
-	e->timer = (line->backsector->ceilingheight>>FRACBITS)+(line->backsector->floorheight>>FRACBITS);
-	P_SetTarget(&e->caller, mobj); // Use P_SetTarget to make sure the mobj doesn't get freed while we're delaying.
-	P_AddThinker(&e->thinker);
+	P_QueueExecutorDelay(line, mobj, sector, (line->backsector->ceilingheight>>FRACBITS)+(line->backsector->floorheight>>FRACBITS));
 }
 
 /** Used by P_LinedefExecute to check a trigger linedef's conditions
@@ -1947,10 +2087,13 @@ boolean P_RunTriggerLinedef(line_t *triggerline, mobj_t *actor, sector_t *caller
   * \sa P_ProcessLineSpecial, P_RunTriggerLinedef
   * \author Graue <graue@oceanbase.org>
   */
-void P_LinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller)
+static void P_DoLinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller)
 {
 	size_t masterline;
 
+	if (p_predicting)
+		return;
+
 	CONS_Debug(DBG_GAMELOGIC, "P_LinedefExecute: Executing trigger linedefs of tag %d\n", tag);
 
 	I_Assert(!actor || !P_MobjWasRemoved(actor)); // If actor is there, it must be valid.
@@ -1980,6 +2123,13 @@ void P_LinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller)
 	}
 }
 
+void P_LinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller)
+{
+	BENCH_ENTER(BENCH_SPECIALS);
+	P_DoLinedefExecute(tag, actor, caller);
+	BENCH_EXIT(BENCH_SPECIALS);
+}
+
 //
 // P_SwitchWeather
 //
@@ -2035,81 +2185,10 @@ void P_SwitchWeather(INT32 weathernum)
 			break;
 	}
 
+	// Drops are made up from curWeather as they're drawn, so a swap
+	// only has to change that and the spots can stay.
 	if (purge)
-	{
-		thinker_t *think;
-		precipmobj_t *precipmobj;
-
-		for (think = thinkercap.next; think != &thinkercap; think = think->next)
-		{
-			if (think->function.acp1 != (actionf_p1)P_NullPrecipThinker)
-				continue; // not a precipmobj thinker
-
-			precipmobj = (precipmobj_t *)think;
-
-			P_RemovePrecipMobj(precipmobj);
-		}
-	}
-	else if (swap && !((swap == PRECIP_BLANK && curWeather == PRECIP_STORM_NORAIN) || (swap == PRECIP_STORM_NORAIN && curWeather == PRECIP_BLANK))) // Rather than respawn all that crap, reuse it!
-	{
-		thinker_t *think;
-		precipmobj_t *precipmobj;
-		state_t *st;
-
-		for (think = thinkercap.next; think != &thinkercap; think = think->next)
-		{
-			if (think->function.acp1 != (actionf_p1)P_NullPrecipThinker)
-				continue; // not a precipmobj thinker
-			precipmobj = (precipmobj_t *)think;
-
-			if (swap == PRECIP_RAIN) // Snow To Rain
-			{
-				precipmobj->flags = mobjinfo[MT_RAIN].flags;
-				st = &states[mobjinfo[MT_RAIN].spawnstate];
-				precipmobj->state = st;
-				precipmobj->tics = st->tics;
-				precipmobj->sprite = st->sprite;
-				precipmobj->frame = st->frame;
-				precipmobj->momz = mobjinfo[MT_RAIN].speed;
-
-				precipmobj->precipflags &= ~PCF_INVISIBLE;
-
-				precipmobj->precipflags |= PCF_RAIN;
-				//think->function.acp1 = (actionf_p1)P_RainThinker;
-			}
-			else if (swap == PRECIP_SNOW) // Rain To Snow
-			{
-				INT32 z;
-
-				precipmobj->flags = mobjinfo[MT_SNOWFLAKE].flags;
-				z = M_RandomByte();
-
-				if (z < 64)
-					z = 2;
-				else if (z < 144)
-					z = 1;
-				else
-					z = 0;
-
-				st = &states[mobjinfo[MT_SNOWFLAKE].spawnstate+z];
-				precipmobj->state = st;
-				precipmobj->tics = st->tics;
-				precipmobj->sprite = st->sprite;
-				precipmobj->frame = st->frame;
-				precipmobj->momz = mobjinfo[MT_SNOWFLAKE].speed;
-
-				precipmobj->precipflags &= ~(PCF_INVISIBLE|PCF_RAIN);
-
-				//think->function.acp1 = (actionf_p1)P_SnowThinker;
-			}
-			else if (swap == PRECIP_BLANK || swap == PRECIP_STORM_NORAIN) // Remove precip, but keep it around for reuse.
-			{
-				//think->function.acp1 = (actionf_p1)P_NullPrecipThinker;
-
-				precipmobj->precipflags |= PCF_INVISIBLE;
-			}
-		}
-	}
+		P_ClearPrecipitation();
 
 	switch (weathernum)
 	{
@@ -2224,6 +2303,13 @@ static void P_ProcessLineSpecial(line_t *line, mobj_t *mo, sector_t *callsec)
 
 	I_Assert(!mo || !P_MobjWasRemoved(mo)); // If mo is there, mo must be valid!
 
+	// Executors can look at lights and scrollers that are still waiting
+	P_FlushLocalThinkers();
+
+	// Most of these move something or make or break a FOF
+	P_ClearSightCache();
+	P_ClearTouchCache();
+
 	if (mo && mo->player && botingame)
 		bot = players[secondarydisplayplayer].mo;
 
@@ -2913,7 +2999,7 @@ static void P_ProcessLineSpecial(line_t *line, mobj_t *mo, sector_t *callsec)
 				scroll_t *scroller;
 				thinker_t *th;
 
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (th = thlist[THINK_MAIN].next; th != &thlist[THINK_MAIN]; th = th->next)
 				{
 					if (th->function.acp1 != (actionf_p1)T_Scroll)
 						continue;
@@ -2990,10 +3076,10 @@ static void P_ProcessLineSpecial(line_t *line, mobj_t *mo, sector_t *callsec)
 
 		case 439: // Set texture
 			{
-				size_t linenum;
+				INT32 linenum;
 				side_t *set = &sides[line->sidenum[0]], *this;
 				boolean always = !(line->flags & ML_NOCLIMB); // If noclimb: Only change mid texture if mid texture already exists on tagged lines, etc.
-				for (linenum = 0; linenum < numlines; linenum++)
+				for (linenum = -1; (linenum = P_FindLineFromLineTag(line, linenum)) >= 0;)
 				{
 					if (lines[linenum].special == 439)
 						continue; // Don't override other set texture lines!
@@ -3153,7 +3239,10 @@ static void P_ProcessLineSpecial(line_t *line, mobj_t *mo, sector_t *callsec)
 
 					// if flags changed, reset sector's light list
 					if (rover->flags != oldflags)
+					{
 						sec->moved = true;
+						P_RecalcFOFFlags(sec);
+					}
 				}
 			}
 			break;
@@ -3221,7 +3310,6 @@ void P_SetupSignExit(player_t *player)
 {
 	mobj_t *thing;
 	msecnode_t *node = player->mo->subsector->sector->touching_thinglist; // things touching this sector
-	thinker_t *think;
 	INT32 numfound = 0;
 
 	for (; node; node = node->m_thinglist_next)
@@ -3246,15 +3334,8 @@ void P_SetupSignExit(player_t *player)
 
 	// didn't find any signposts in the exit sector.
 	// spin all signposts in the level then.
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (thing = P_FindMobjFromType(MT_SIGN, NULL); thing; thing = P_FindMobjFromType(MT_SIGN, thing))
 	{
-		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue; // not a mobj thinker
-
-		thing = (mobj_t *)think;
-		if (thing->type != MT_SIGN)
-			continue;
-
 		if (thing->state != &states[thing->info->spawnstate])
 			continue;
 
@@ -3274,20 +3355,11 @@ void P_SetupSignExit(player_t *player)
 //
 boolean P_IsFlagAtBase(mobjtype_t flag)
 {
-	thinker_t *think;
 	mobj_t *mo;
 	INT32 specialnum = 0;
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (mo = P_FindMobjFromType(flag, NULL); mo; mo = P_FindMobjFromType(flag, mo))
 	{
-		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue; // not a mobj thinker
-
-		mo = (mobj_t *)think;
-
-		if (mo->type != flag)
-			continue;
-
 		if (mo->type == MT_REDFLAG)
 			specialnum = 3;
 		else if (mo->type == MT_BLUEFLAG)
@@ -3317,140 +3389,205 @@ boolean P_IsFlagAtBase(mobjtype_t flag)
 }
 
 //
-// P_PlayerTouchingSectorSpecial
+// P_PlayerInTouchedFOF
 //
-// Replaces the old player->specialsector.
-// This allows a player to touch more than
-// one sector at a time, if necessary.
-//
-// Returns a pointer to the first sector of
-// the particular type that it finds.
-// Returns NULL if it doesn't find it.
+// Is the player where rover's special would get them? On top of (or under)
+// a solid FOF, depending on its flip flags, or inside anything else.
 //
-sector_t *P_PlayerTouchingSectorSpecial(player_t *player, INT32 section, INT32 number)
+static boolean P_PlayerInTouchedFOF(mobj_t *mo, ffloor_t *rover)
 {
-	msecnode_t *node;
-	ffloor_t *rover;
+	fixed_t topheight, bottomheight;
 
-	if (!player->mo)
-		return NULL;
+	if (!(rover->flags & FF_EXISTS))
+		return false;
 
-	// Check default case first
-	if (GETSECSPECIAL(player->mo->subsector->sector->special, section) == number)
-		return player->mo->subsector->sector;
+	topheight = P_GetSpecialTopZ(mo, sectors + rover->secnum, mo->subsector->sector);
+	bottomheight = P_GetSpecialBottomZ(mo, sectors + rover->secnum, mo->subsector->sector);
 
-	// Hmm.. maybe there's a FOF that has it...
-	for (rover = player->mo->subsector->sector->ffloors; rover; rover = rover->next)
+	// Check the 3D floor's type...
+	if (rover->flags & FF_BLOCKPLAYER)
 	{
-		fixed_t topheight, bottomheight;
-
-		if (GETSECSPECIAL(rover->master->frontsector->special, section) != number)
-			continue;
-
-		if (!(rover->flags & FF_EXISTS))
-			continue;
-
-		topheight = P_GetSpecialTopZ(player->mo, sectors + rover->secnum, player->mo->subsector->sector);
-		bottomheight = P_GetSpecialBottomZ(player->mo, sectors + rover->secnum, player->mo->subsector->sector);
-
-		// Check the 3D floor's type...
-		if (rover->flags & FF_BLOCKPLAYER)
+		// Thing must be on top of the floor to be affected...
+		if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR)
+			&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING))
 		{
-			// Thing must be on top of the floor to be affected...
-			if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR)
-				&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING))
-			{
-				if ((player->mo->eflags & MFE_VERTICALFLIP) || player->mo->z != topheight)
-					continue;
-			}
-			else if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING)
-				&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR))
-			{
-				if (!(player->mo->eflags & MFE_VERTICALFLIP)
-					|| player->mo->z + player->mo->height != bottomheight)
-					continue;
-			}
-			else if (rover->master->frontsector->flags & SF_FLIPSPECIAL_BOTH)
-			{
-				if (!((player->mo->eflags & MFE_VERTICALFLIP && player->mo->z + player->mo->height == bottomheight)
-					|| (!(player->mo->eflags & MFE_VERTICALFLIP) && player->mo->z == topheight)))
-					continue;
-			}
+			if ((mo->eflags & MFE_VERTICALFLIP) || mo->z != topheight)
+				return false;
 		}
-		else
+		else if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING)
+			&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR))
 		{
-			// Water and DEATH FOG!!! heh
-			if (player->mo->z > topheight || (player->mo->z + player->mo->height) < bottomheight)
-				continue;
+			if (!(mo->eflags & MFE_VERTICALFLIP)
+				|| mo->z + mo->height != bottomheight)
+				return false;
+		}
+		else if (rover->master->frontsector->flags & SF_FLIPSPECIAL_BOTH)
+		{
+			if (!((mo->eflags & MFE_VERTICALFLIP && mo->z + mo->height == bottomheight)
+				|| (!(mo->eflags & MFE_VERTICALFLIP) && mo->z == topheight)))
+				return false;
 		}
+	}
+	else
+	{
+		// Water and DEATH FOG!!! heh
+		if (mo->z > topheight || (mo->z + mo->height) < bottomheight)
+			return false;
+	}
 
-		// This FOF has the special we're looking for!
-		return rover->master->frontsector;
+	return true;
+}
+
+// Every sector a player could be getting a special from, in the order
+// P_PlayerTouchingSectorSpecial looks at them. It only depends on where the
+// player is and what the sectors and FOFs around them are like, so it is
+// kept until either changes; several calls a tic then share one walk.
+#define MAXTOUCHED 32
+
+typedef struct
+{
+	mobj_t *mo;
+	fixed_t x, y, z, height, radius;
+	UINT32 flip;
+	subsector_t *subsector;
+	msecnode_t *touching;
+	UINT32 stamp;
+	size_t numsectors; // MAXTOUCHED+1 if there were too many to keep
+	sector_t *sectors[MAXTOUCHED];
+} touched_t;
+
+static touched_t touched[MAXPLAYERS];
+static UINT32 touchstamp = 1;
+
+//
+// P_ClearTouchCache
+//
+// Forgets which sectors the players touch, for when something has changed
+// what a sector is like or how high it is.
+//
+void P_ClearTouchCache(void)
+{
+	if (++touchstamp == 0) // wrapped around, so old stamps could look new
+	{
+		memset(touched, 0, sizeof (touched));
+		touchstamp = 1;
 	}
+}
 
-	for (node = player->mo->touching_sectorlist; node; node = node->m_sectorlist_next)
+//
+// P_TouchedSector
+//
+// Hands sec to the walk in P_WalkTouchedSectors. Without t, says whether
+// sec is the one being looked for; with it, adds sec to the list instead.
+//
+static boolean P_TouchedSector(touched_t *t, sector_t *sec, INT32 section, INT32 number)
+{
+	if (!t)
+		return (GETSECSPECIAL(sec->special, section) == number);
+
+	if (t->numsectors < MAXTOUCHED)
+		t->sectors[t->numsectors] = sec;
+	if (t->numsectors <= MAXTOUCHED)
+		t->numsectors++;
+	return false;
+}
+
+//
+// P_WalkTouchedSectors
+//
+// Goes through all the sectors the player touches, and returns the first
+// with the special, or fills in t with all of them.
+//
+static sector_t *P_WalkTouchedSectors(mobj_t *mo, touched_t *t, INT32 section, INT32 number)
+{
+	sector_t *sec = mo->subsector->sector;
+	msecnode_t *node;
+	ffloor_t *rover;
+
+	// Check default case first
+	if (P_TouchedSector(t, sec, section, number))
+		return sec;
+
+	// Hmm.. maybe there's a FOF that has it...
+	for (rover = sec->ffloors; rover; rover = rover->next)
 	{
-		if (GETSECSPECIAL(node->m_sector->special, section) == number)
-		{
-			// This sector has the special we're looking for, but
-			// are we allowed to touch it?
-			if (node->m_sector == player->mo->subsector->sector
-				|| (node->m_sector->flags & SF_TRIGGERSPECIAL_TOUCH))
-				return node->m_sector;
-		}
+		if (t || GETSECSPECIAL(rover->master->frontsector->special, section) == number)
+			if (P_PlayerInTouchedFOF(mo, rover)
+				&& P_TouchedSector(t, rover->master->frontsector, section, number))
+				return rover->master->frontsector;
+	}
+
+	for (node = mo->touching_sectorlist; node; node = node->m_sectorlist_next)
+	{
+		// Are we allowed to touch this sector's special?
+		if ((node->m_sector == sec || (node->m_sector->flags & SF_TRIGGERSPECIAL_TOUCH))
+			&& P_TouchedSector(t, node->m_sector, section, number))
+			return node->m_sector;
 
 		// Hmm.. maybe there's a FOF that has it...
 		for (rover = node->m_sector->ffloors; rover; rover = rover->next)
 		{
-			fixed_t topheight, bottomheight;
-
-			if (GETSECSPECIAL(rover->master->frontsector->special, section) != number)
+			if (node->m_sector != sec && !(rover->master->frontsector->flags & SF_TRIGGERSPECIAL_TOUCH))
 				continue;
-
-			if (!(rover->flags & FF_EXISTS))
+			if (!t && GETSECSPECIAL(rover->master->frontsector->special, section) != number)
 				continue;
+			if (P_PlayerInTouchedFOF(mo, rover)
+				&& P_TouchedSector(t, rover->master->frontsector, section, number))
+				return rover->master->frontsector;
+		}
+	}
 
-			topheight = P_GetSpecialTopZ(player->mo, sectors + rover->secnum, player->mo->subsector->sector);
-			bottomheight = P_GetSpecialBottomZ(player->mo, sectors + rover->secnum, player->mo->subsector->sector);
+	return NULL;
+}
 
-			// Check the 3D floor's type...
-			if (rover->flags & FF_BLOCKPLAYER)
-			{
-				// Thing must be on top of the floor to be affected...
-				if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR)
-					&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING))
-				{
-					if ((player->mo->eflags & MFE_VERTICALFLIP) || player->mo->z != topheight)
-						continue;
-				}
-				else if ((rover->master->frontsector->flags & SF_FLIPSPECIAL_CEILING)
-					&& !(rover->master->frontsector->flags & SF_FLIPSPECIAL_FLOOR))
-				{
-					if (!(player->mo->eflags & MFE_VERTICALFLIP)
-						|| player->mo->z + player->mo->height != bottomheight)
-						continue;
-				}
-				else if (rover->master->frontsector->flags & SF_FLIPSPECIAL_BOTH)
-				{
-					if (!((player->mo->eflags & MFE_VERTICALFLIP && player->mo->z + player->mo->height == bottomheight)
-						|| (!(player->mo->eflags & MFE_VERTICALFLIP) && player->mo->z == topheight)))
-						continue;
-				}
-			}
-			else
-			{
-				// Water and DEATH FOG!!! heh
-				if (player->mo->z > topheight || (player->mo->z + player->mo->height) < bottomheight)
-					continue;
-			}
+//
+// P_PlayerTouchingSectorSpecial
+//
+// Replaces the old player->specialsector.
+// This allows a player to touch more than
+// one sector at a time, if necessary.
+//
+// Returns a pointer to the first sector of
+// the particular type that it finds.
+// Returns NULL if it doesn't find it.
+//
+sector_t *P_PlayerTouchingSectorSpecial(player_t *player, INT32 section, INT32 number)
+{
+	mobj_t *mo = player->mo;
+	touched_t *t;
+	size_t i;
 
-			// This FOF has the special we're looking for, but are we allowed to touch it?
-			if (node->m_sector == player->mo->subsector->sector
-				|| (rover->master->frontsector->flags & SF_TRIGGERSPECIAL_TOUCH))
-				return rover->master->frontsector;
-		}
+	if (!mo)
+		return NULL;
+
+	t = &touched[player - players];
+	if (t->stamp != touchstamp || t->mo != mo
+		|| t->x != mo->x || t->y != mo->y || t->z != mo->z
+		|| t->height != mo->height || t->radius != mo->radius
+		|| t->flip != (mo->eflags & MFE_VERTICALFLIP)
+		|| t->subsector != mo->subsector || t->touching != mo->touching_sectorlist)
+	{
+		t->stamp = touchstamp;
+		t->mo = mo;
+		t->x = mo->x;
+		t->y = mo->y;
+		t->z = mo->z;
+		t->height = mo->height;
+		t->radius = mo->radius;
+		t->flip = (mo->eflags & MFE_VERTICALFLIP);
+		t->subsector = mo->subsector;
+		t->touching = mo->touching_sectorlist;
+		t->numsectors = 0;
+		P_WalkTouchedSectors(mo, t, 0, 0);
 	}
 
+	if (t->numsectors > MAXTOUCHED)
+		return P_WalkTouchedSectors(mo, NULL, section, number);
+
+	for (i = 0; i < t->numsectors; i++)
+		if (GETSECSPECIAL(t->sectors[i]->special, section) == number)
+			return t->sectors[i];
+
 	return NULL;
 }
 
@@ -3730,7 +3867,7 @@ void P_ProcessSpecialSector(player_t *player, sector_t *sector, sector_t *rovers
 
 			// Find the center of the Eggtrap and release all the pretty animals!
 			// The chimps are my friends.. heeheeheheehehee..... - LouisJM
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			{
 				if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 					continue;
@@ -3994,7 +4131,6 @@ DoneSection2:
 				INT32 sequence;
 				fixed_t speed;
 				INT32 lineindex;
-				thinker_t *th;
 				mobj_t *waypoint = NULL;
 				mobj_t *mo2;
 				angle_t an;
@@ -4017,15 +4153,9 @@ DoneSection2:
 
 				// scan the thinkers
 				// to find the first waypoint
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-
-					if (mo2->type == MT_TUBEWAYPOINT && mo2->threshold == sequence
-						&& mo2->health == 0)
+					if (mo2->threshold == sequence && mo2->health == 0)
 					{
 						waypoint = mo2;
 						break;
@@ -4067,7 +4197,6 @@ DoneSection2:
 				INT32 sequence;
 				fixed_t speed;
 				INT32 lineindex;
-				thinker_t *th;
 				mobj_t *waypoint = NULL;
 				mobj_t *mo2;
 				angle_t an;
@@ -4090,14 +4219,9 @@ DoneSection2:
 
 				// scan the thinkers
 				// to find the last waypoint
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-
-					if (mo2->type == MT_TUBEWAYPOINT && mo2->threshold == sequence)
+					if (mo2->threshold == sequence)
 					{
 						if (!waypoint)
 							waypoint = mo2;
@@ -4184,7 +4308,6 @@ DoneSection2:
 				INT32 sequence;
 				fixed_t speed;
 				INT32 lineindex;
-				thinker_t *th;
 				mobj_t *waypointmid = NULL;
 				mobj_t *waypointhigh = NULL;
 				mobj_t *waypointlow = NULL;
@@ -4234,16 +4357,8 @@ DoneSection2:
 
 				// scan the thinkers
 				// to find the first waypoint
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-
-					if (mo2->type != MT_TUBEWAYPOINT)
-						continue;
-
 					if (mo2->threshold != sequence)
 						continue;
 
@@ -4272,16 +4387,8 @@ DoneSection2:
 				}
 
 				// Find waypoint before this one (waypointlow)
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-
-					if (mo2->type != MT_TUBEWAYPOINT)
-						continue;
-
 					if (mo2->threshold != sequence)
 						continue;
 
@@ -4299,16 +4406,8 @@ DoneSection2:
 				}
 
 				// Find waypoint after this one (waypointhigh)
-				for (th = thinkercap.next; th != &thinkercap; th = th->next)
+				for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 				{
-					if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-						continue;
-
-					mo2 = (mobj_t *)th;
-
-					if (mo2->type != MT_TUBEWAYPOINT)
-						continue;
-
 					if (mo2->threshold != sequence)
 						continue;
 
@@ -4763,13 +4862,13 @@ static void P_RunSpecialSectorCheck(player_t *player, sector_t *sector)
   * \param player Player to check.
   * \sa P_PlayerOnSpecial3DFloor, P_ProcessSpecialSector
   */
-void P_PlayerInSpecialSector(player_t *player)
+static void P_DoPlayerInSpecialSector(player_t *player)
 {
 	sector_t *originalsector;
 	sector_t *loopsector;
 	msecnode_t *node;
 
-	if (!player->mo)
+	if (!player->mo || p_predicting)
 		return;
 
 	originalsector = player->mo->subsector->sector;
@@ -4800,6 +4899,13 @@ void P_PlayerInSpecialSector(player_t *player)
 	}
 }
 
+void P_PlayerInSpecialSector(player_t *player)
+{
+	BENCH_ENTER(BENCH_SPECIALS);
+	P_DoPlayerInSpecialSector(player);
+	BENCH_EXIT(BENCH_SPECIALS);
+}
+
 #undef TELEPORTED
 
 /** Animate planes, scroll walls, etc. and keeps track of level timelimit and exits if time is up.
@@ -4814,6 +4920,7 @@ void P_UpdateSpecials(void)
 	size_t j;
 
 	levelflat_t *foundflats; // for flat animation
+	boolean allanims; // not just the ones on a new frame
 
 	// LEVEL TIMER
 	P_CheckTimeLimit();
@@ -4824,16 +4931,24 @@ void P_UpdateSpecials(void)
 #ifdef ESLOPE
 	// Dynamic slopeness
 	P_RunDynamicSlopes();
+	P_ClearTouchCache();
 #endif
 
+	// An animation only moves on to its next frame when leveltime is a
+	// multiple of its speed. After anything but the tic before, like a
+	// new level or a loaded game, everything is worked out again.
+	allanims = (leveltime != animtic + 1);
+	animtic = leveltime;
+
 	// ANIMATE TEXTURES
 	for (anim = anims; anim < lastanim; anim++)
 	{
+		if (!anim->istexture || (!allanims && leveltime % anim->speed))
+			continue;
 		for (i = 0; i < anim->numpics; i++)
 		{
 			pic = anim->basepic + ((leveltime/anim->speed + i) % anim->numpics);
-			if (anim->istexture)
-				texturetranslation[anim->basepic+i] = pic;
+			texturetranslation[anim->basepic+i] = pic;
 		}
 	}
 
@@ -4844,7 +4959,7 @@ void P_UpdateSpecials(void)
 	foundflats = levelflats;
 	for (j = 0; j < numlevelflats; j++, foundflats++)
 	{
-		if (foundflats->speed) // it is an animated flat
+		if (foundflats->speed && (allanims || !(leveltime % foundflats->speed))) // it is an animated flat
 		{
 			// update the levelflat lump number
 			foundflats->lumpnum = foundflats->baselumpnum +
@@ -4952,7 +5067,7 @@ static ffloor_t *P_AddFakeFloor(sector_t *sec, sector_t *sec2, line_t *master, f
 	}
 
 	// Add the floor
-	ffloor = Z_Calloc(sizeof (*ffloor), PU_LEVEL, NULL);
+	ffloor = Z_LevelCalloc(sizeof (*ffloor));
 	ffloor->secnum = sec2 - sectors;
 	ffloor->target = sec;
 	ffloor->bottomheight = &sec2->floorheight;
@@ -4998,7 +5113,7 @@ static ffloor_t *P_AddFakeFloor(sector_t *sec, sector_t *sec2, line_t *master, f
 
 	// Just initialise both of these to placate the compiler.
 	i = 0;
-	th = thinkercap.next;
+	th = thlist[THINK_MAIN].next;
 
 	for(;;)
 	{
@@ -5008,7 +5123,7 @@ static ffloor_t *P_AddFakeFloor(sector_t *sec, sector_t *sec2, line_t *master, f
 				th = secthinkers[sec2num].thinkers[i];
 			else break;
 		}
-		else if (th == &thinkercap)
+		else if (th == &thlist[THINK_MAIN])
 			break;
 
 		// Should this FOF have spikeness?
@@ -5075,6 +5190,7 @@ static ffloor_t *P_AddFakeFloor(sector_t *sec, sector_t *sec2, line_t *master, f
 	}
 
 	P_AddFFloorToList(sec, ffloor);
+	P_RecalcFOFFlags(sec);
 
 	return ffloor;
 }
@@ -5097,7 +5213,7 @@ static void P_AddSpikeThinker(sector_t *sec, INT32 referrer)
 
 	// create and initialize new thinker
 	spikes = Z_Calloc(sizeof (*spikes), PU_LEVSPEC, NULL);
-	P_AddThinker(&spikes->thinker);
+	P_AddThinker(THINK_MAIN, &spikes->thinker);
 
 	spikes->thinker.function.acp1 = (actionf_p1)T_SpikeSector;
 
@@ -5119,7 +5235,7 @@ static void P_AddFloatThinker(sector_t *sec, INT32 tag, line_t *sourceline)
 
 	// create and initialize new thinker
 	floater = Z_Calloc(sizeof (*floater), PU_LEVSPEC, NULL);
-	P_AddThinker(&floater->thinker);
+	P_AddThinker(THINK_MAIN, &floater->thinker);
 
 	floater->thinker.function.acp1 = (actionf_p1)T_FloatSector;
 
@@ -5143,7 +5259,7 @@ static inline void P_AddBridgeThinker(line_t *sourceline, sector_t *sec)
 
 	// create an initialize new thinker
 	bridge = Z_Calloc(sizeof (*bridge), PU_LEVSPEC, NULL);
-	P_AddThinker(&bridge->thinker);
+	P_AddThinker(THINK_MAIN, &bridge->thinker);
 
 	bridge->thinker.function.acp1 = (actionf_p1)T_BridgeThinker;
 
@@ -5177,7 +5293,7 @@ static void P_AddBlockThinker(sector_t *sec, line_t *sourceline)
 
 	// create and initialize new elevator thinker
 	block = Z_Calloc(sizeof (*block), PU_LEVSPEC, NULL);
-	P_AddThinker(&block->thinker);
+	P_AddThinker(THINK_MAIN, &block->thinker);
 
 	block->thinker.function.acp1 = (actionf_p1)T_MarioBlockChecker;
 	block->sourceline = sourceline;
@@ -5206,7 +5322,7 @@ static void P_AddRaiseThinker(sector_t *sec, line_t *sourceline)
 	levelspecthink_t *raise;
 
 	raise = Z_Calloc(sizeof (*raise), PU_LEVSPEC, NULL);
-	P_AddThinker(&raise->thinker);
+	P_AddThinker(THINK_MAIN, &raise->thinker);
 
 	raise->thinker.function.acp1 = (actionf_p1)T_RaiseSector;
 
@@ -5245,7 +5361,7 @@ static void P_AddOldAirbob(sector_t *sec, line_t *sourceline, boolean noadjust)
 	levelspecthink_t *airbob;
 
 	airbob = Z_Calloc(sizeof (*airbob), PU_LEVSPEC, NULL);
-	P_AddThinker(&airbob->thinker);
+	P_AddThinker(THINK_MAIN, &airbob->thinker);
 
 	airbob->thinker.function.acp1 = (actionf_p1)T_RaiseSector;
 
@@ -5306,7 +5422,7 @@ static inline void P_AddThwompThinker(sector_t *sec, sector_t *actionsector, lin
 
 	// create and initialize new elevator thinker
 	thwomp = Z_Calloc(sizeof (*thwomp), PU_LEVSPEC, NULL);
-	P_AddThinker(&thwomp->thinker);
+	P_AddThinker(THINK_MAIN, &thwomp->thinker);
 
 	thwomp->thinker.function.acp1 = (actionf_p1)T_ThwompSector;
 
@@ -5342,7 +5458,7 @@ static inline void P_AddNoEnemiesThinker(sector_t *sec, line_t *sourceline)
 
 	// create and initialize new thinker
 	nobaddies = Z_Calloc(sizeof (*nobaddies), PU_LEVSPEC, NULL);
-	P_AddThinker(&nobaddies->thinker);
+	P_AddThinker(THINK_MAIN, &nobaddies->thinker);
 
 	nobaddies->thinker.function.acp1 = (actionf_p1)T_NoEnemiesSector;
 
@@ -5364,7 +5480,7 @@ static inline void P_AddEachTimeThinker(sector_t *sec, line_t *sourceline)
 
 	// create and initialize new thinker
 	eachtime = Z_Calloc(sizeof (*eachtime), PU_LEVSPEC, NULL);
-	P_AddThinker(&eachtime->thinker);
+	P_AddThinker(THINK_MAIN, &eachtime->thinker);
 
 	eachtime->thinker.function.acp1 = (actionf_p1)T_EachTimeThinker;
 
@@ -5386,7 +5502,7 @@ static inline void P_AddCameraScanner(sector_t *sourcesec, sector_t *actionsecto
 
 	// create and initialize new elevator thinker
 	elevator = Z_Calloc(sizeof (*elevator), PU_LEVSPEC, NULL);
-	P_AddThinker(&elevator->thinker);
+	P_AddThinker(THINK_MAIN, &elevator->thinker);
 
 	elevator->thinker.function.acp1 = (actionf_p1)T_CameraScanner;
 	elevator->type = elevateBounce;
@@ -5480,7 +5596,7 @@ static inline void EV_AddLaserThinker(sector_t *sec, sector_t *sec2, line_t *lin
 
 	flash = Z_Calloc(sizeof (*flash), PU_LEVSPEC, NULL);
 
-	P_AddThinker(&flash->thinker);
+	P_AddThinker(THINK_MAIN, &flash->thinker);
 
 	flash->thinker.function.acp1 = (actionf_p1)T_LaserFlash;
 	flash->ffloor = ffloor;
@@ -5609,7 +5725,7 @@ void P_SpawnSpecials(INT32 fromnetsave)
 	secthinkers = Z_Calloc(numsectors * sizeof(thinkerlist_t), PU_STATIC, NULL);
 
 	// Firstly, find out how many there are in each sector
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MAIN].next; th != &thlist[THINK_MAIN]; th = th->next)
 	{
 		if (th->function.acp1 == (actionf_p1)T_SpikeSector)
 			secthinkers[((levelspecthink_t *)th)->sector - sectors].count++;
@@ -5629,7 +5745,7 @@ void P_SpawnSpecials(INT32 fromnetsave)
 		}
 
 	// Finally, populate the lists.
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MAIN].next; th != &thlist[THINK_MAIN]; th = th->next)
 	{
 		size_t secnum = (size_t)-1;
 
@@ -6884,7 +7000,7 @@ static void Add_Scroller(INT32 type, fixed_t dx, fixed_t dy, INT32 control, INT3
 	if ((s->control = control) != -1)
 		s->last_height = sectors[control].floorheight + sectors[control].ceilingheight;
 	s->affectee = affectee;
-	P_AddThinker(&s->thinker);
+	P_AddThinker(THINK_MAIN, &s->thinker);
 }
 
 /** Adds a wall scroller.
@@ -7043,7 +7159,7 @@ static void Add_MasterDisappearer(tic_t appeartime, tic_t disappeartime, tic_t o
 	d->exists = true;
 	d->timer = 1;
 
-	P_AddThinker(&d->thinker);
+	P_AddThinker(THINK_MAIN, &d->thinker);
 }
 
 /** Makes a FOF appear/disappear
@@ -7090,6 +7206,7 @@ void T_Disappear(disappear_t *d)
 				}
 			}
 			sectors[s].moved = true;
+			P_RecalcFOFFlags(&sectors[s]);
 		}
 
 		if (d->exists)
@@ -7137,7 +7254,7 @@ static void Add_Friction(INT32 friction, INT32 movefactor, INT32 affectee, INT32
 	else
 		f->roverfriction = false;
 
-	P_AddThinker(&f->thinker);
+	P_AddThinker(THINK_MAIN, &f->thinker);
 }
 
 /** Applies friction to all things in a sector.
@@ -7314,7 +7431,7 @@ static void Add_Pusher(pushertype_e type, fixed_t x_mag, fixed_t y_mag, mobj_t *
 		p->z = p->source->z;
 	}
 	p->affectee = affectee;
-	P_AddThinker(&p->thinker);
+	P_AddThinker(THINK_MAIN, &p->thinker);
 }
 
 
@@ -27,6 +27,7 @@ extern mobj_t *skyboxmo[2];
 
 // at game start
 void P_InitPicAnims(void);
+boolean P_GetTextureAnimation(INT32 tex, INT32 *basepic, INT32 *numpics);
 
 // at map load (sectors)
 void P_SetupLevelFlatAnims(void);
@@ -37,6 +38,7 @@ void P_SpawnSpecials(INT32 fromnetsave);
 // every tic
 void P_UpdateSpecials(void);
 sector_t *P_PlayerTouchingSectorSpecial(player_t *player, INT32 section, INT32 number);
+void P_ClearTouchCache(void);
 void P_PlayerInSpecialSector(player_t *player);
 void P_ProcessSpecialSector(player_t *player, sector_t *sector, sector_t *roversector);
 
@@ -63,6 +65,7 @@ void P_SwitchWeather(INT32 weathernum);
 boolean P_RunTriggerLinedef(line_t *triggerline, mobj_t *actor, sector_t *caller);
 void P_LinedefExecute(INT16 tag, mobj_t *actor, sector_t *caller);
 void P_ChangeSectorTag(UINT32 sector, INT16 newtag);
+void P_RecalcFOFFlags(sector_t *sec);
 
 //
 // P_LIGHTS
@@ -342,16 +345,23 @@ void T_EachTimeThinker(levelspecthink_t *eachtime);
 void T_CameraScanner(elevator_t *elevator);
 void T_RaiseSector(levelspecthink_t *sraise);
 
-typedef struct
+// A linedef executor waiting out its delay. These don't think; they
+// wait in a timer wheel and P_RunExecutorDelays runs each on its tic.
+typedef struct executor_s
 {
-	thinker_t thinker; // Thinker for linedef executor delay
+	struct executor_s *next; // Next one in the same wheel slot
 	line_t *line;      // Pointer to line that is waiting.
 	mobj_t *caller;    // Pointer to calling mobj
 	sector_t *sector;  // Pointer to triggering sector
-	INT32 timer;       // Delay timer
+	tic_t due;         // executortic to run on
 } executor_t;
 
-void T_ExecutorDelay(executor_t *e);
+void P_InitExecutorDelays(void);
+void P_FreeExecutorDelays(void);
+executor_t *P_QueueExecutorDelay(line_t *line, mobj_t *mobj, sector_t *sector, INT32 timer);
+void P_RunExecutorDelays(void);
+INT32 P_ExecutorDelayTimer(const executor_t *e);
+void P_IterateExecutorDelays(void (*func)(executor_t *));
 
 /** Generalized scroller.
   */
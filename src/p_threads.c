@@ -0,0 +1,334 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_threads.c
+/// \brief Running thinkers that keep to themselves on several threads
+///
+///        A thinker put aside has already been passed by the thinker loop,
+///        so it can't be freed before it runs, and is run with the function
+///        it had then, even if something removes it in the meantime. The
+///        serial thinkers in between never look at what the put aside ones
+///        change. Linedef executors can, so P_ProcessLineSpecial runs
+///        everything put aside first, and nothing is put aside at all while
+///        Lua has hooks, since those can look at anything at any time.
+///
+///        With thinkerthreadscheck on, every threaded run is done a second
+///        time one by one from the same starting point, and any thinker
+///        that came out differently is reported.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "i_threads.h"
+#include "m_perfstats.h"
+#include "p_local.h"
+#include "p_threads.h"
+#include "r_state.h"
+#ifdef HAVE_BLUA
+#include "lua_hook.h"
+#endif
+
+#ifdef THINKERTHREADS
+
+static CV_PossibleValue_t thinkerthreads_cons_t[] = {{0, "MIN"}, {MAXTHINKERTHREADS, "MAX"}, {0, NULL}};
+consvar_t cv_thinkerthreads = {"thinkerthreads", "0", CV_SAVE, thinkerthreads_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_thinkerthreadscheck = {"thinkerthreadscheck", "Off", 0, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// Fewer than this, and waking the threads costs more than it saves
+#define MINTHREADEDJOBS 32
+
+typedef struct
+{
+	thinker_t *th;
+	actionf_p1 func; // as it was when put aside
+	size_t thinkersize;
+	void *target; // the sector or sidedef it changes
+	size_t targetsize;
+	size_t group; // jobs with the same group share a target
+} localjob_t;
+
+static localjob_t *jobs = NULL;
+static size_t numjobs = 0, maxjobs = 0;
+
+// For thinkerthreadscheck: the jobs' thinkers and targets before and after
+static UINT8 *savedbefore = NULL, *savedafter = NULL;
+static size_t savedsize = 0;
+
+// Thinker threads. The main thread does the jobs of group 0 itself.
+static INT32 numthinkerthreads = 0; // spawned so far, not counting the main thread
+static INT32 activethreads = 0; // how many share the current jobs, counting the main thread
+static INT32 threadsbusy = 0;
+static UINT32 jobgeneration = 0; // bumped every time the jobs are handed out
+static boolean thinkerstop = false;
+static UINT32 spawngeneration[MAXTHINKERTHREADS];
+
+static I_mutex thinker_mutex;
+static I_cond thinker_workcond;
+static I_cond thinker_donecond;
+
+//
+// P_LocalThinkerTarget
+//
+// Finds what th changes, if it's a thinker that can run on a thread.
+//
+static boolean P_LocalThinkerTarget(thinker_t *th, localjob_t *job)
+{
+	actionf_p1 func = th->function.acp1;
+
+	if (func == (actionf_p1)T_Scroll)
+	{
+		scroll_t *s = (scroll_t *)th;
+
+		if (s->control != -1) // follows a sector the movers are changing
+			return false;
+
+		job->thinkersize = sizeof (scroll_t);
+		switch (s->type)
+		{
+			case sc_side:
+				job->target = &sides[s->affectee];
+				job->targetsize = sizeof (side_t);
+				job->group = numsectors + (size_t)s->affectee;
+				return true;
+			case sc_floor:
+			case sc_ceiling:
+				job->target = &sectors[s->affectee];
+				job->targetsize = sizeof (sector_t);
+				job->group = (size_t)s->affectee;
+				return true;
+			default: // moves things
+				return false;
+		}
+	}
+	else if (func == (actionf_p1)T_Glow)
+	{
+		job->thinkersize = sizeof (glow_t);
+		job->target = ((glow_t *)th)->sector;
+	}
+	else if (func == (actionf_p1)T_StrobeFlash)
+	{
+		job->thinkersize = sizeof (strobe_t);
+		job->target = ((strobe_t *)th)->sector;
+	}
+	else if (func == (actionf_p1)T_LightFade)
+	{
+		lightlevel_t *ll = (lightlevel_t *)th;
+
+		// Finishing removes the thinker, which Lua has to hear about
+		if (ll->sector->lightlevel < ll->destlevel
+			? ll->sector->lightlevel + ll->speed >= ll->destlevel
+			: ll->sector->lightlevel - ll->speed <= ll->destlevel)
+			return false;
+
+		job->thinkersize = sizeof (lightlevel_t);
+		job->target = ll->sector;
+	}
+	else
+		return false;
+
+	// Everything that gets here lights a sector
+	job->targetsize = sizeof (sector_t);
+	job->group = (size_t)((sector_t *)job->target - sectors);
+	return true;
+}
+
+boolean P_DeferLocalThinker(thinker_t *th)
+{
+	localjob_t job;
+
+	if (cv_thinkerthreads.value < 2 || thinkerstop || ps_tickprofiling)
+		return false;
+#ifdef HAVE_BLUA
+	if (LUAh_AnyHooks())
+		return false;
+#endif
+
+	if (!P_LocalThinkerTarget(th, &job))
+		return false;
+
+	job.th = th;
+	job.func = th->function.acp1;
+
+	if (numjobs == maxjobs)
+	{
+		maxjobs = maxjobs ? maxjobs*2 : 256;
+		jobs = realloc(jobs, maxjobs * sizeof (*jobs));
+		if (!jobs)
+			I_Error("P_DeferLocalThinker: out of memory");
+	}
+	jobs[numjobs++] = job;
+	return true;
+}
+
+// Runs the jobs of every group that falls to thread id of n.
+static void P_RunLocalJobs(INT32 id, INT32 n)
+{
+	size_t i;
+
+	for (i = 0; i < numjobs; i++)
+	{
+		if ((INT32)(jobs[i].group % n) == id)
+			jobs[i].func(jobs[i].th);
+	}
+}
+
+static void P_ThinkerThread(void *userdata)
+{
+	const INT32 id = (INT32)(size_t)userdata;
+	UINT32 seen = spawngeneration[id];
+	INT32 n;
+
+	I_lock_mutex(&thinker_mutex);
+	for (;;)
+	{
+		while (seen == jobgeneration && !thinkerstop)
+			I_hold_cond(&thinker_workcond, thinker_mutex);
+		if (thinkerstop)
+			break;
+		seen = jobgeneration;
+
+		n = activethreads;
+		if (id >= n)
+			continue;
+
+		I_unlock_mutex(thinker_mutex);
+		P_RunLocalJobs(id, n);
+		I_lock_mutex(&thinker_mutex);
+
+		if (--threadsbusy == 0)
+			I_wake_all_cond(&thinker_donecond);
+	}
+	I_unlock_mutex(thinker_mutex);
+}
+
+static void P_StopThinkerThreads(void)
+{
+	I_lock_mutex(&thinker_mutex);
+	thinkerstop = true;
+	I_wake_all_cond(&thinker_workcond);
+	I_unlock_mutex(thinker_mutex);
+}
+
+//
+// P_SaveLocalJobs
+//
+// Copies every job's thinker and target into buf, or back out of it.
+//
+static void P_SaveLocalJobs(UINT8 *buf, boolean restore)
+{
+	size_t i;
+
+	for (i = 0; i < numjobs; i++)
+	{
+		const localjob_t *job = &jobs[i];
+
+		if (restore)
+		{
+			M_Memcpy(job->th, buf, job->thinkersize);
+			M_Memcpy(job->target, buf + job->thinkersize, job->targetsize);
+		}
+		else
+		{
+			M_Memcpy(buf, job->th, job->thinkersize);
+			M_Memcpy(buf + job->thinkersize, job->target, job->targetsize);
+		}
+		buf += job->thinkersize + job->targetsize;
+	}
+}
+
+//
+// P_CheckLocalJobs
+//
+// Runs the jobs again one by one, from where they started, and compares.
+//
+static void P_CheckLocalJobs(void)
+{
+	UINT8 *buf;
+	size_t i, bad = 0;
+
+	P_SaveLocalJobs(savedafter, false);
+	P_SaveLocalJobs(savedbefore, true);
+	P_RunLocalJobs(0, 1);
+
+	for (i = 0, buf = savedafter; i < numjobs; i++)
+	{
+		const localjob_t *job = &jobs[i];
+
+		if (memcmp(job->th, buf, job->thinkersize)
+			|| memcmp(job->target, buf + job->thinkersize, job->targetsize))
+			bad++;
+		buf += job->thinkersize + job->targetsize;
+	}
+
+	if (bad)
+		CONS_Alert(CONS_WARNING, M_GetText("%s of %s threaded thinkers ran differently on tic %u\n"),
+			sizeu1(bad), sizeu2(numjobs), leveltime);
+}
+
+void P_FlushLocalThinkers(void)
+{
+	INT32 wanted = cv_thinkerthreads.value;
+	boolean check = cv_thinkerthreadscheck.value;
+
+	if (!numjobs)
+		return;
+
+	if (wanted < 2 || numjobs < MINTHREADEDJOBS)
+	{
+		P_RunLocalJobs(0, 1);
+		numjobs = 0;
+		return;
+	}
+
+	if (check)
+	{
+		size_t i, size = 0;
+
+		for (i = 0; i < numjobs; i++)
+			size += jobs[i].thinkersize + jobs[i].targetsize;
+		if (size > savedsize)
+		{
+			savedbefore = realloc(savedbefore, size);
+			savedafter = realloc(savedafter, size);
+			if (!savedbefore || !savedafter)
+				I_Error("P_FlushLocalThinkers: out of memory");
+			savedsize = size;
+		}
+		P_SaveLocalJobs(savedbefore, false);
+	}
+
+	if (numthinkerthreads == 0)
+		I_AddExitFunc(P_StopThinkerThreads);
+	while (numthinkerthreads < wanted - 1)
+	{
+		spawngeneration[numthinkerthreads + 1] = jobgeneration;
+		I_spawn_thread("thinker", P_ThinkerThread, (void *)(size_t)(numthinkerthreads + 1));
+		numthinkerthreads++;
+	}
+
+	I_lock_mutex(&thinker_mutex);
+	activethreads = wanted;
+	threadsbusy = wanted - 1;
+	jobgeneration++;
+	I_wake_all_cond(&thinker_workcond);
+	I_unlock_mutex(thinker_mutex);
+
+	P_RunLocalJobs(0, wanted);
+
+	I_lock_mutex(&thinker_mutex);
+	while (threadsbusy)
+		I_hold_cond(&thinker_donecond, thinker_mutex);
+	I_unlock_mutex(thinker_mutex);
+
+	if (check)
+		P_CheckLocalJobs();
+
+	numjobs = 0;
+}
+
+#endif // THINKERTHREADS
@@ -0,0 +1,51 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_threads.h
+/// \brief Running thinkers that keep to themselves on several threads
+///
+///        Some THINK_MAIN thinkers only ever touch their own struct and
+///        one sector or sidedef that nothing else changes during the tic:
+///        texture scrollers with no control sector, and the lights that
+///        don't use P_RandomByte. Instead of being run where they are in
+///        the list, they are put aside, and run all together on the
+///        thinker threads once the rest of THINK_MAIN is done. Those that
+///        share a target run on the same thread, in list order, so the
+///        results are exactly those of running them one by one.
+
+#ifndef __P_THREADS__
+#define __P_THREADS__
+
+#include "command.h"
+#include "d_think.h"
+
+#ifdef THINKERTHREADS
+
+#define MAXTHINKERTHREADS 16
+
+extern consvar_t cv_thinkerthreads, cv_thinkerthreadscheck;
+
+/**	\brief Puts a thinker aside to run on a thread, if it's one that can.
+	\param	th	a THINK_MAIN thinker, about to be run
+	\return	true if it was put aside, false if it should be run now
+*/
+boolean P_DeferLocalThinker(thinker_t *th);
+
+/**	\brief Runs every thinker put aside, and waits for them.
+	Anything that might look at what they change has to call this first.
+*/
+void P_FlushLocalThinkers(void);
+
+#else
+
+#define P_DeferLocalThinker(th) false
+#define P_FlushLocalThinkers()
+
+#endif // THINKERTHREADS
+
+#endif // __P_THREADS__
@@ -21,6 +21,11 @@
 #include "m_random.h"
 #include "lua_script.h"
 #include "lua_hook.h"
+#include "m_perfstats.h"
+#include "m_bench.h"
+#include "r_fps.h"
+#include "p_threads.h"
+#include "p_warmup.h"
 
 // Object place
 #include "m_cheat.h"
@@ -35,8 +40,8 @@ tic_t leveltime;
 // but the first element must be thinker_t.
 //
 
-// Both the head and tail of the thinker list.
-thinker_t thinkercap;
+// Both the head and tail of each thinker list.
+thinker_t thlist[NUM_THINKERLISTS];
 
 void Command_Numthinkers_f(void)
 {
@@ -44,6 +49,7 @@ void Command_Numthinkers_f(void)
 	INT32 count = 0;
 	actionf_p1 action;
 	thinker_t *think;
+	thinklistnum_t i;
 
 	if (gamestate != GS_LEVEL)
 	{
@@ -56,12 +62,9 @@ void Command_Numthinkers_f(void)
 		CONS_Printf(M_GetText("numthinkers <#>: Count number of thinkers\n"));
 		CONS_Printf(
 			"\t1: P_MobjThinker\n"
-			/*"\t2: P_RainThinker\n"
-			"\t3: P_SnowThinker\n"*/
-			"\t2: P_NullPrecipThinker\n"
-			"\t3: T_Friction\n"
-			"\t4: T_Pusher\n"
-			"\t5: P_RemoveThinkerDelayed\n");
+			"\t2: T_Friction\n"
+			"\t3: T_Pusher\n"
+			"\t4: P_RemoveThinkerDelayed\n");
 		return;
 	}
 
@@ -73,27 +76,15 @@ void Command_Numthinkers_f(void)
 			action = (actionf_p1)P_MobjThinker;
 			CONS_Printf(M_GetText("Number of %s: "), "P_MobjThinker");
 			break;
-		/*case 2:
-			action = (actionf_p1)P_RainThinker;
-			CONS_Printf(M_GetText("Number of %s: "), "P_RainThinker");
-			break;
-		case 3:
-			action = (actionf_p1)P_SnowThinker;
-			CONS_Printf(M_GetText("Number of %s: "), "P_SnowThinker");
-			break;*/
 		case 2:
-			action = (actionf_p1)P_NullPrecipThinker;
-			CONS_Printf(M_GetText("Number of %s: "), "P_NullPrecipThinker");
-			break;
-		case 3:
 			action = (actionf_p1)T_Friction;
 			CONS_Printf(M_GetText("Number of %s: "), "T_Friction");
 			break;
-		case 4:
+		case 3:
 			action = (actionf_p1)T_Pusher;
 			CONS_Printf(M_GetText("Number of %s: "), "T_Pusher");
 			break;
-		case 5:
+		case 4:
 			action = (actionf_p1)P_RemoveThinkerDelayed;
 			CONS_Printf(M_GetText("Number of %s: "), "P_RemoveThinkerDelayed");
 			break;
@@ -102,12 +93,15 @@ void Command_Numthinkers_f(void)
 			return;
 	}
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
-		if (think->function.acp1 != action)
-			continue;
+		for (think = thlist[i].next; think != &thlist[i]; think = think->next)
+		{
+			if (think->function.acp1 != action)
+				continue;
 
-		count++;
+			count++;
+		}
 	}
 
 	CONS_Printf("%d\n", count);
@@ -139,7 +133,7 @@ void Command_CountMobjs_f(void)
 
 			count = 0;
 
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			{
 				if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 					continue;
@@ -159,7 +153,7 @@ void Command_CountMobjs_f(void)
 	{
 		count = 0;
 
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		{
 			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 				continue;
@@ -178,21 +172,29 @@ void Command_CountMobjs_f(void)
 //
 void P_InitThinkers(void)
 {
-	thinkercap.prev = thinkercap.next = &thinkercap;
+	UINT8 i;
+	for (i = 0; i < NUM_THINKERLISTS; i++)
+		thlist[i].prev = thlist[i].next = &thlist[i];
+	P_InitExecutorDelays();
+	P_ClearMobjTypeLists();
+#ifdef MOBJCONSISTANCY
+	mobjconsistancy = 0; // the old mobjs are freed without being unlinked
+#endif
 }
 
 //
 // P_AddThinker
-// Adds a new thinker at the end of the list.
+// Adds a new thinker at the end of list n.
 //
-void P_AddThinker(thinker_t *thinker)
+void P_AddThinker(const thinklistnum_t n, thinker_t *thinker)
 {
-	thinkercap.prev->next = thinker;
-	thinker->next = &thinkercap;
-	thinker->prev = thinkercap.prev;
-	thinkercap.prev = thinker;
+	thlist[n].prev->next = thinker;
+	thinker->next = &thlist[n];
+	thinker->prev = thlist[n].prev;
+	thlist[n].prev = thinker;
 
 	thinker->references = 0;    // killough 11/98: init reference counter to 0
+	thinker->luaref = 0;
 }
 
 //
@@ -227,6 +229,9 @@ void P_RemoveThinkerDelayed(void *pthinker)
 			 * thinker->prev->next = thinker->next */
 			(next->prev = currentthinker = thinker->prev)->next = next;
 		}
+#ifdef HAVE_BLUA
+		LUA_InvalidateThinker(thinker); // in case it was pushed again after removal
+#endif
 		Z_Free(thinker);
 	}
 }
@@ -246,7 +251,7 @@ void P_RemoveThinkerDelayed(void *pthinker)
 void P_RemoveThinker(thinker_t *thinker)
 {
 #ifdef HAVE_BLUA
-	LUA_InvalidateUserdata(thinker);
+	LUA_InvalidateThinker(thinker);
 #endif
 	thinker->function.acp1 = P_RemoveThinkerDelayed;
 }
@@ -272,6 +277,26 @@ if ((*mop = targ) != NULL) // Set new target and if non-NULL, increase its count
 	return targ;
 }
 
+//
+// P_KeepsTouchCache
+//
+// Sector thinkers that never move a floor or change a FOF, so the players
+// still touch the same sectors after they run. Linedef executors they set
+// off clear the cache themselves.
+//
+static inline boolean P_KeepsTouchCache(actionf_p1 func)
+{
+	return (func == (actionf_p1)T_EachTimeThinker
+		|| func == (actionf_p1)T_Scroll
+		|| func == (actionf_p1)T_Friction
+		|| func == (actionf_p1)T_Pusher
+		|| func == (actionf_p1)T_Glow
+		|| func == (actionf_p1)T_FireFlicker
+		|| func == (actionf_p1)T_StrobeFlash
+		|| func == (actionf_p1)T_LightFade
+		|| func == (actionf_p1)T_LightningFlash);
+}
+
 //
 // P_RunThinkers
 //
@@ -294,12 +319,41 @@ if ((*mop = targ) != NULL) // Set new target and if non-NULL, increase its count
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
+// Each list is run to completion before the next one starts, in
+// thinklistnum_t order, so polyobjects still move before the mobjs
+// they carry.
+//
 static inline void P_RunThinkers(void)
 {
-	for (currentthinker = thinkercap.next; currentthinker != &thinkercap; currentthinker = currentthinker->next)
+	size_t i;
+
+	P_CheckRingsDoze();
+	P_PackBlockStatics();
+
+	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
-		if (currentthinker->function.acp1)
-			currentthinker->function.acp1(currentthinker);
+		// Whatever the last list moved could be in the way now
+		P_ClearSightCache();
+
+		for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+		{
+			if (!currentthinker->function.acp1)
+				continue;
+			if (i != THINK_MOBJ && !P_KeepsTouchCache(currentthinker->function.acp1))
+				P_ClearTouchCache();
+			if (ps_tickprofiling)
+				PS_RunThinker(currentthinker);
+			else if (i != THINK_MAIN || !P_DeferLocalThinker(currentthinker))
+				currentthinker->function.acp1(currentthinker);
+		}
+
+		// Delayed executors run where their thinkers would have
+		// counted down last, after the rest of THINK_MAIN
+		if (i == THINK_MAIN)
+		{
+			P_FlushLocalThinkers();
+			P_RunExecutorDelays();
+		}
 	}
 }
 
@@ -592,6 +646,11 @@ void P_Ticker(boolean run)
 
 	postimgtype = postimgtype2 = postimg_none;
 
+	R_RecordInterpolationState();
+
+	if (ps_tickprofiling || cv_perfstats.value)
+		PS_StartTic();
+
 	P_MapStart();
 
 	if (run)
@@ -601,9 +660,11 @@ void P_Ticker(boolean run)
 		if (demoplayback)
 			G_ReadDemoTiccmd(&players[consoleplayer].cmd, 0);
 
+		BENCH_ENTER(BENCH_PLAYERTHINK);
 		for (i = 0; i < MAXPLAYERS; i++)
 			if (playeringame[i] && players[i].mo && !P_MobjWasRemoved(players[i].mo))
 				P_PlayerThink(&players[i]);
+		BENCH_EXIT(BENCH_PLAYERTHINK);
 	}
 
 	// Keep track of how long they've been playing!
@@ -618,7 +679,12 @@ void P_Ticker(boolean run)
 
 	if (run)
 	{
+#ifdef HAVE_BLUA
+		LUAh_MobjThinkerBatch();
+#endif
+		BENCH_ENTER(BENCH_THINKERS);
 		P_RunThinkers();
+		BENCH_EXIT(BENCH_THINKERS);
 
 		// Run any "after all the other thinkers" stuff
 		for (i = 0; i < MAXPLAYERS; i++)
@@ -634,7 +700,9 @@ void P_Ticker(boolean run)
 	P_RunShields();
 	P_RunOverlays();
 
+	BENCH_ENTER(BENCH_SPECIALS);
 	P_UpdateSpecials();
+	BENCH_EXIT(BENCH_SPECIALS);
 	P_RespawnSpecials();
 
 	// Lightning, rain sounds, etc.
@@ -700,6 +768,18 @@ void P_Ticker(boolean run)
 
 	P_MapEnd();
 
+	if (run && demorecording)
+		G_WriteDemoKeyframe();
+
+	P_WarmupTraceTicker();
+
+#ifdef HAVE_BLUA
+	LUA_TicGC();
+#endif
+
+	if (ps_tickprofiling || cv_perfstats.value)
+		PS_EndTic();
+
 //	Z_CheckMemCleanup();
 }
 
@@ -731,6 +811,9 @@ void P_PreTicker(INT32 frames)
 				memcpy(&players[i].cmd, &temptic, sizeof(ticcmd_t));
 			}
 
+#ifdef HAVE_BLUA
+		LUAh_MobjThinkerBatch();
+#endif
 		P_RunThinkers();
 
 		// Run any "after all the other thinkers" stuff
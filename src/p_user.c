@@ -343,7 +343,6 @@ void P_ResetScore(player_t *player)
 //
 UINT8 P_FindLowestMare(void)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 	UINT8 mare = UINT8_MAX;
 
@@ -352,14 +351,9 @@ UINT8 P_FindLowestMare(void)
 
 	// scan the thinkers
 	// to find the egg capsule with the lowest mare
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_EGGCAPSULE, NULL); mo2; mo2 = P_FindMobjFromType(MT_EGGCAPSULE, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-
-		if (mo2->type == MT_EGGCAPSULE && mo2->health > 0)
+		if (mo2->health > 0)
 		{
 			const UINT8 threshold = (UINT8)mo2->threshold;
 			if (mare == 255)
@@ -383,7 +377,6 @@ UINT8 P_FindLowestMare(void)
 //
 boolean P_TransferToNextMare(player_t *player)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *closestaxis = NULL;
 	INT32 lowestaxisnum = -1;
@@ -399,33 +392,25 @@ boolean P_TransferToNextMare(player_t *player)
 
 	// scan the thinkers
 	// to find the closest axis point
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_AXIS, NULL); mo2; mo2 = P_FindMobjFromType(MT_AXIS, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-
-		if (mo2->type == MT_AXIS)
+		if (mo2->threshold == mare)
 		{
-			if (mo2->threshold == mare)
+			if (closestaxis == NULL)
 			{
-				if (closestaxis == NULL)
+				closestaxis = mo2;
+				lowestaxisnum = mo2->health;
+				dist2 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
+			}
+			else if (mo2->health < lowestaxisnum)
+			{
+				dist1 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
+
+				if (dist1 < dist2)
 				{
 					closestaxis = mo2;
 					lowestaxisnum = mo2->health;
-					dist2 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
-				}
-				else if (mo2->health < lowestaxisnum)
-				{
-					dist1 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
-
-					if (dist1 < dist2)
-					{
-						closestaxis = mo2;
-						lowestaxisnum = mo2->health;
-						dist2 = dist1;
-					}
+					dist2 = dist1;
 				}
 			}
 		}
@@ -450,7 +435,7 @@ static mobj_t *P_FindAxis(INT32 mare, INT32 axisnum)
 
 	// scan the thinkers
 	// to find the closest axis point
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -483,7 +468,7 @@ static mobj_t *P_FindAxisTransfer(INT32 mare, INT32 axisnum, mobjtype_t type)
 
 	// scan the thinkers
 	// to find the closest axis point
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -510,7 +495,6 @@ static mobj_t *P_FindAxisTransfer(INT32 mare, INT32 axisnum, mobjtype_t type)
 // Finds the CLOSEST axis with the number specified.
 void P_TransferToAxis(player_t *player, INT32 axisnum)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *closestaxis;
 	INT32 mare = player->mare;
@@ -522,31 +506,23 @@ void P_TransferToAxis(player_t *player, INT32 axisnum)
 
 	// scan the thinkers
 	// to find the closest axis point
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_AXIS, NULL); mo2; mo2 = P_FindMobjFromType(MT_AXIS, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-
-		if (mo2->type == MT_AXIS)
+		if (mo2->health == axisnum && mo2->threshold == mare)
 		{
-			if (mo2->health == axisnum && mo2->threshold == mare)
+			if (closestaxis == NULL)
 			{
-				if (closestaxis == NULL)
+				closestaxis = mo2;
+				dist2 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
+			}
+			else
+			{
+				dist1 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
+
+				if (dist1 < dist2)
 				{
 					closestaxis = mo2;
-					dist2 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
-				}
-				else
-				{
-					dist1 = R_PointToDist2(player->mo->x, player->mo->y, mo2->x, mo2->y)-mo2->radius;
-
-					if (dist1 < dist2)
-					{
-						closestaxis = mo2;
-						dist2 = dist1;
-					}
+					dist2 = dist1;
 				}
 			}
 		}
@@ -571,7 +547,6 @@ void P_TransferToAxis(player_t *player, INT32 axisnum)
 //
 static void P_DeNightserizePlayer(player_t *player)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 
 	player->pflags &= ~PF_NIGHTSMODE;
@@ -620,15 +595,8 @@ static void P_DeNightserizePlayer(player_t *player)
 	}
 
 	// Check to see if the player should be killed.
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_NIGHTSDRONE, NULL); mo2; mo2 = P_FindMobjFromType(MT_NIGHTSDRONE, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-		if (!(mo2->type == MT_NIGHTSDRONE))
-			continue;
-
 		if (mo2->flags & MF_AMBUSH)
 			P_DamageMobj(player->mo, NULL, NULL, 10000);
 
@@ -1341,7 +1309,6 @@ boolean P_IsLocalPlayer(player_t *player)
 void P_SpawnShieldOrb(player_t *player)
 {
 	mobjtype_t orbtype;
-	thinker_t *th;
 	mobj_t *shieldobj, *ov;
 
 #ifdef PARANOIA
@@ -1373,14 +1340,9 @@ void P_SpawnShieldOrb(player_t *player)
 	}
 
 	// blaze through the thinkers to see if an orb already exists!
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (shieldobj = P_FindMobjFromType(orbtype, NULL); shieldobj; shieldobj = P_FindMobjFromType(orbtype, shieldobj))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		shieldobj = (mobj_t *)th;
-
-		if (shieldobj->type == orbtype && shieldobj->target == player->mo)
+		if (shieldobj->target == player->mo)
 			P_RemoveMobj(shieldobj); //kill the old one(s)
 	}
 
@@ -2654,7 +2616,7 @@ static void P_DoClimbing(player_t *player)
 			angle_t sideangle;
 			fixed_t dx, dy;
 
-			for (think = thinkercap.next; think != &thinkercap; think = think->next)
+			for (think = thlist[THINK_MAIN].next; think != &thlist[THINK_MAIN]; think = think->next)
 			{
 				if (think->function.acp1 != (actionf_p1)T_Scroll)
 					continue;
@@ -3867,7 +3829,7 @@ void P_Telekinesis(player_t *player, fixed_t thrust, fixed_t range)
 	if (player->powers[pw_super]) // increase range when super
 		range *= 2;
 
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 	{
 		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue;
@@ -4987,7 +4949,7 @@ static void P_NightsTransferPoints(player_t *player, fixed_t xspeed, fixed_t rad
 		fixed_t truexspeed = xspeed*(!(player->pflags & PF_TRANSFERTOCLOSEST) && player->mo->target->flags & MF_AMBUSH ? -1 : 1);
 
 		// Find next waypoint
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		{
 			if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
 				continue;
@@ -5023,7 +4985,7 @@ static void P_NightsTransferPoints(player_t *player, fixed_t xspeed, fixed_t rad
 		// Look for a wrapper point.
 		if (!transfer1)
 		{
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			{
 				if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
 					continue;
@@ -5051,7 +5013,7 @@ static void P_NightsTransferPoints(player_t *player, fixed_t xspeed, fixed_t rad
 		}
 		if (!transfer2)
 		{
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 			{
 				if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
 					continue;
@@ -5526,7 +5488,6 @@ static void P_NiGHTSMovement(player_t *player)
 	boolean still = false, moved = false, backwardaxis = false, firstdrill;
 	INT16 newangle = 0;
 	fixed_t xspeed, yspeed;
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *closestaxis = NULL;
 	fixed_t newx, newy, radius;
@@ -5608,31 +5569,23 @@ static void P_NiGHTSMovement(player_t *player)
 
 		// scan the thinkers
 		// to find the closest axis point
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_AXIS, NULL); mo2; mo2 = P_FindMobjFromType(MT_AXIS, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-				continue;
-
-			mo2 = (mobj_t *)th;
-
-			if (mo2->type == MT_AXIS)
+			if (mo2->threshold == player->mare)
 			{
-				if (mo2->threshold == player->mare)
+				if (closestaxis == NULL)
+				{
+					closestaxis = mo2;
+					dist2 = R_PointToDist2(newx, newy, mo2->x, mo2->y)-mo2->radius;
+				}
+				else
 				{
-					if (closestaxis == NULL)
+					dist1 = R_PointToDist2(newx, newy, mo2->x, mo2->y)-mo2->radius;
+
+					if (dist1 < dist2)
 					{
 						closestaxis = mo2;
-						dist2 = R_PointToDist2(newx, newy, mo2->x, mo2->y)-mo2->radius;
-					}
-					else
-					{
-						dist1 = R_PointToDist2(newx, newy, mo2->x, mo2->y)-mo2->radius;
-
-						if (dist1 < dist2)
-						{
-							closestaxis = mo2;
-							dist2 = dist1;
-						}
+						dist2 = dist1;
 					}
 				}
 			}
@@ -6401,18 +6354,11 @@ static void P_MovePlayer(player_t *player)
 	{
 		if (!player->capsule && !player->bonustime)
 		{
-			thinker_t *th;
 			mobj_t *mo2;
 
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (mo2 = P_FindMobjFromType(MT_EGGCAPSULE, NULL); mo2; mo2 = P_FindMobjFromType(MT_EGGCAPSULE, mo2))
 			{
-				if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-					continue;
-
-				mo2 = (mobj_t *)th;
-
-				if (mo2->type == MT_EGGCAPSULE
-					&& mo2->threshold == player->mare)
+				if (mo2->threshold == player->mare)
 					P_SetTarget(&player->capsule, mo2);
 			}
 		}
@@ -7105,7 +7051,6 @@ static void P_DoZoomTube(player_t *player)
 {
 	INT32 sequence;
 	fixed_t speed;
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *waypoint = NULL;
 	fixed_t dist;
@@ -7155,16 +7100,8 @@ static void P_DoZoomTube(player_t *player)
 		CONS_Debug(DBG_GAMELOGIC, "Looking for next waypoint...\n");
 
 		// Find next waypoint
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-				continue;
-
-			mo2 = (mobj_t *)th;
-
-			if (mo2->type != MT_TUBEWAYPOINT)
-				continue;
-
 			if (mo2->threshold == sequence)
 			{
 				if ((reverse && mo2->health == player->mo->tracer->health - 1)
@@ -7224,7 +7161,6 @@ static void P_DoRopeHang(player_t *player)
 {
 	INT32 sequence;
 	fixed_t speed;
-	thinker_t *th;
 	mobj_t *mo2;
 	mobj_t *waypoint = NULL;
 	fixed_t dist;
@@ -7287,16 +7223,8 @@ static void P_DoRopeHang(player_t *player)
 		CONS_Debug(DBG_GAMELOGIC, "Looking for next waypoint...\n");
 
 		// Find next waypoint
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 		{
-			if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-				continue;
-
-			mo2 = (mobj_t *)th;
-
-			if (mo2->type != MT_TUBEWAYPOINT)
-				continue;
-
 			if (mo2->threshold == sequence)
 			{
 				if (mo2->health == player->mo->tracer->health + 1)
@@ -7312,16 +7240,8 @@ static void P_DoRopeHang(player_t *player)
 			CONS_Debug(DBG_GAMELOGIC, "Next waypoint not found, wrapping to start...\n");
 
 			// Wrap around back to first waypoint
-			for (th = thinkercap.next; th != &thinkercap; th = th->next)
+			for (mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, NULL); mo2; mo2 = P_FindMobjFromType(MT_TUBEWAYPOINT, mo2))
 			{
-				if (th->function.acp1 != (actionf_p1)P_MobjThinker) // Not a mobj thinker
-					continue;
-
-				mo2 = (mobj_t *)th;
-
-				if (mo2->type != MT_TUBEWAYPOINT)
-					continue;
-
 				if (mo2->threshold == sequence)
 				{
 					if (mo2->health == 0)
@@ -7381,7 +7301,7 @@ static void P_NukeAllPlayers(player_t *player)
 	mobj_t *mo;
 	thinker_t *think;
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (think = thlist[THINK_MOBJ].next; think != &thlist[THINK_MOBJ]; think = think->next)
 	{
 		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue; // not a mobj thinker
@@ -7429,7 +7349,7 @@ void P_NukeEnemies(mobj_t *inflictor, mobj_t *source, fixed_t radius)
 		}
 	}
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
+	for (think = thlist[THINK_MOBJ].next; think != &thlist[THINK_MOBJ]; think = think->next)
 	{
 		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
 			continue; // not a mobj thinker
@@ -7465,77 +7385,117 @@ void P_NukeEnemies(mobj_t *inflictor, mobj_t *source, fixed_t radius)
 }
 
 //
-// P_LookForEnemies
-// Looks for something you can hit - Used for homing attack
-// Includes monitors and springs!
+// P_ThinkerComesAfter
 //
-boolean P_LookForEnemies(player_t *player)
+// Whether a comes after b in the thinker list.
+//
+static boolean P_ThinkerComesAfter(thinker_t *a, thinker_t *b)
 {
-	mobj_t *mo;
-	thinker_t *think;
-	mobj_t *closestmo = NULL;
+	thinker_t *th;
+
+	for (th = b->next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th == a)
+			return true;
+	return false;
+}
+
+static player_t *homingplayer;
+static mobj_t *closestenemy;
+static fixed_t closestenemydist;
+
+static boolean PIT_LookForEnemies(mobj_t *mo)
+{
+	mobj_t *pmo = homingplayer->mo;
+	fixed_t dist;
 	angle_t an;
 
-	for (think = thinkercap.next; think != &thinkercap; think = think->next)
-	{
-		if (think->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue; // not a mobj thinker
+	if (!(mo->flags & (MF_ENEMY|MF_BOSS|MF_MONITOR|MF_SPRING)))
+		return true; // not a valid enemy
 
-		mo = (mobj_t *)think;
-		if (!(mo->flags & (MF_ENEMY|MF_BOSS|MF_MONITOR|MF_SPRING)))
-			continue; // not a valid enemy
+	if (!mo->thinker.next || mo->thinker.function.acp1 != (actionf_p1)P_MobjThinker)
+		return true; // MF_NOTHINK, so never in the thinker list
 
-		if (mo->health <= 0) // dead
-			continue;
+	if (mo->health <= 0) // dead
+		return true;
 
-		if (mo == player->mo)
-			continue;
+	if (mo == pmo)
+		return true;
 
-		if (mo->flags2 & MF2_FRET)
-			continue;
+	if (mo->flags2 & MF2_FRET)
+		return true;
 
-		if ((mo->flags & (MF_ENEMY|MF_BOSS)) && !(mo->flags & MF_SHOOTABLE)) // don't aim at something you can't shoot at anyway (see Egg Guard or Minus)
-			continue;
+	if ((mo->flags & (MF_ENEMY|MF_BOSS)) && !(mo->flags & MF_SHOOTABLE)) // don't aim at something you can't shoot at anyway (see Egg Guard or Minus)
+		return true;
 
-		if (mo->type == MT_DETON) // Don't be STUPID, Sonic!
-			continue;
+	if (mo->type == MT_DETON) // Don't be STUPID, Sonic!
+		return true;
 
-		if (((mo->z > player->mo->z+FixedMul(MAXSTEPMOVE, player->mo->scale)) && !(player->mo->eflags & MFE_VERTICALFLIP))
-		|| ((mo->z+mo->height < player->mo->z+player->mo->height-FixedMul(MAXSTEPMOVE, player->mo->scale)) && (player->mo->eflags & MFE_VERTICALFLIP))) // Reverse gravity check - Flame.
-			continue; // Don't home upwards!
+	if (((mo->z > pmo->z+FixedMul(MAXSTEPMOVE, pmo->scale)) && !(pmo->eflags & MFE_VERTICALFLIP))
+	|| ((mo->z+mo->height < pmo->z+pmo->height-FixedMul(MAXSTEPMOVE, pmo->scale)) && (pmo->eflags & MFE_VERTICALFLIP))) // Reverse gravity check - Flame.
+		return true; // Don't home upwards!
 
-		if (P_AproxDistance(P_AproxDistance(player->mo->x-mo->x, player->mo->y-mo->y),
-			player->mo->z-mo->z) > FixedMul(RING_DIST, player->mo->scale))
-			continue; // out of range
+	dist = P_AproxDistance(P_AproxDistance(pmo->x-mo->x, pmo->y-mo->y), pmo->z-mo->z);
+	if (dist > FixedMul(RING_DIST, pmo->scale))
+		return true; // out of range
 
-		if ((twodlevel || player->mo->flags2 & MF2_TWOD)
-		&& abs(player->mo->y-mo->y) > player->mo->radius)
-			continue; // not in your 2d plane
+	if ((twodlevel || pmo->flags2 & MF2_TWOD)
+	&& abs(pmo->y-mo->y) > pmo->radius)
+		return true; // not in your 2d plane
 
-		if (mo->type == MT_PLAYER) // Don't chase after other players!
-			continue;
+	if (mo->type == MT_PLAYER) // Don't chase after other players!
+		return true;
 
-		if (closestmo && P_AproxDistance(P_AproxDistance(player->mo->x-mo->x, player->mo->y-mo->y),
-			player->mo->z-mo->z) > P_AproxDistance(P_AproxDistance(player->mo->x-closestmo->x,
-			player->mo->y-closestmo->y), player->mo->z-closestmo->z))
-			continue;
+	// The whole thinker list used to be searched, with the last of the
+	// closest taking it, so a tie goes to the one further down the list
+	if (closestenemy && (dist > closestenemydist
+		|| (dist == closestenemydist && !P_ThinkerComesAfter(&mo->thinker, &closestenemy->thinker))))
+		return true;
 
-		an = R_PointToAngle2(player->mo->x, player->mo->y, mo->x, mo->y) - player->mo->angle;
+	an = R_PointToAngle2(pmo->x, pmo->y, mo->x, mo->y) - pmo->angle;
 
-		if (an > ANGLE_90 && an < ANGLE_270)
-			continue; // behind back
+	if (an > ANGLE_90 && an < ANGLE_270)
+		return true; // behind back
 
-		if (!P_CheckSight(player->mo, mo))
-			continue; // out of sight
+	if (!P_CheckSight(pmo, mo))
+		return true; // out of sight
 
-		closestmo = mo;
-	}
+	closestenemy = mo;
+	closestenemydist = dist;
+	return true;
+}
+
+//
+// P_LookForEnemies
+// Looks for something you can hit - Used for homing attack
+// Includes monitors and springs!
+//
+boolean P_LookForEnemies(player_t *player)
+{
+	mobj_t *oldtmthing = tmthing;
+	const fixed_t range = FixedMul(RING_DIST, player->mo->scale);
+	INT32 bx, by, xl, xh, yl, yh;
+
+	// Anything in range has its middle in these blocks
+	xl = (unsigned)(player->mo->x - range - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (unsigned)(player->mo->x + range - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (unsigned)(player->mo->y - range - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (unsigned)(player->mo->y + range - bmaporgy)>>MAPBLOCKSHIFT;
 
-	if (closestmo)
+	BMBOUNDFIX(xl, xh, yl, yh);
+
+	homingplayer = player;
+	closestenemy = NULL;
+	tmthing = player->mo;
+	for (by = yl; by <= yh; by++)
+		for (bx = xl; bx <= xh; bx++)
+			P_BlockThingsIterator(bx, by, PIT_LookForEnemies);
+	tmthing = oldtmthing;
+
+	if (closestenemy)
 	{
 		// Found a target monster
-		P_SetTarget(&player->mo->target, P_SetTarget(&player->mo->tracer, closestmo));
-		player->mo->angle = R_PointToAngle2(player->mo->x, player->mo->y, closestmo->x, closestmo->y);
+		P_SetTarget(&player->mo->target, P_SetTarget(&player->mo->tracer, closestenemy));
+		player->mo->angle = R_PointToAngle2(player->mo->x, player->mo->y, closestenemy->x, closestenemy->y);
 		return true;
 	}
 
@@ -7590,28 +7550,20 @@ void P_HomingAttack(mobj_t *source, mobj_t *enemy) // Home in on your target
 // Search for emeralds
 void P_FindEmerald(void)
 {
-	thinker_t *th;
 	mobj_t *mo2;
 
 	hunt1 = hunt2 = hunt3 = NULL;
 
 	// scan the remaining thinkers
 	// to find all emeralds
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_EMERHUNT, NULL); mo2; mo2 = P_FindMobjFromType(MT_EMERHUNT, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
-			continue;
-
-		mo2 = (mobj_t *)th;
-		if (mo2->type == MT_EMERHUNT)
-		{
-			if (!hunt1)
-				hunt1 = mo2;
-			else if (!hunt2)
-				hunt2 = mo2;
-			else if (!hunt3)
-				hunt3 = mo2;
-		}
+		if (!hunt1)
+			hunt1 = mo2;
+		else if (!hunt2)
+			hunt2 = mo2;
+		else if (!hunt3)
+			hunt3 = mo2;
 	}
 	return;
 }
@@ -8766,17 +8718,21 @@ void P_PlayerThink(player_t *player)
 		INT32 i;
 
 		// Check if all the players in the race have finished. If so, end the level.
-		for (i = 0; i < MAXPLAYERS; i++)
+		// Only worth looking on the tic it matters, or every player looks at every player.
+		if (player->exiting == 3*TICRATE)
 		{
-			if (playeringame[i])
+			for (i = 0; i < MAXPLAYERS; i++)
 			{
-				if (!players[i].exiting && players[i].lives > 0)
-					break;
+				if (playeringame[i])
+				{
+					if (!players[i].exiting && players[i].lives > 0)
+						break;
+				}
 			}
-		}
 
-		if (i == MAXPLAYERS && player->exiting == 3*TICRATE) // finished
-			player->exiting = (14*TICRATE)/5 + 1;
+			if (i == MAXPLAYERS) // finished
+				player->exiting = (14*TICRATE)/5 + 1;
+		}
 
 		// If 10 seconds are left on the timer,
 		// begin the drown music for countdown!
@@ -8966,7 +8922,7 @@ void P_PlayerThink(player_t *player)
 		fixed_t y = player->mo->y;
 		fixed_t z = player->mo->z;
 
-		for (th = thinkercap.next; th != &thinkercap; th = th->next)
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		{
 			if (th->function.acp1 != (actionf_p1)P_MobjThinker)
 				continue;
@@ -0,0 +1,274 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_warmup.c
+/// \brief Warm-up traces: what a map loads in its first minute
+///
+///        A trace file is a header, the MD5s of the files loaded when it
+///        was written, then each lump as the number of its file in that
+///        list, its number in the file, and how it was wanted. Lumps from
+///        files that aren't loaded now are left out when it's read.
+///
+///        Lumps are only ever added: the ones warmed up are cached before
+///        the level starts, so they'd never be missed again to be traced.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "byteptr.h"
+#include "command.h"
+#include "console.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_misc.h"
+#include "p_tick.h"
+#include "p_warmup.h"
+#include "s_sound.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#define WARMUPDIR "levelcache" // with the blockmap cache
+#define WARMUPID "SRB2WUT\0"
+#define WARMUPVERSION 1
+#define WARMUPHEADERSIZE (8 + 4 + 16 + 2)
+#define WARMUPMAXLUMPS 4096
+#define WARMUPHASHSIZE 8192 // must be a power of two, and more than WARMUPMAXLUMPS
+#define WARMUPTRACETICS (60*TICRATE)
+
+consvar_t cv_warmuptraces = {"warmuptraces", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct
+{
+	lumpnum_t lumpnum;
+	UINT8 how; // lumpmiss_t
+} warmuplump_t;
+
+static warmuplump_t tracelumps[WARMUPMAXLUMPS];
+static size_t numtracelumps; // including the ones added this time
+static size_t numreadlumps; // the ones the file had
+static size_t warmedup; // of those, the ones cached so far
+static UINT16 tracehash[WARMUPHASHSIZE]; // 1 + the index of each lump in tracelumps
+
+static UINT8 tracemd5[16];
+static boolean traceloaded = false; // tracemd5 is a map's
+static boolean tracechanged = false;
+static boolean recording = false;
+
+static const char *P_WarmupTraceName(const UINT8 *md5)
+{
+	char hex[33];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&hex[i*2], "%02x", md5[i]);
+	return va("%s"PATHSEP WARMUPDIR PATHSEP"%s.wut", srb2home, hex);
+}
+
+// The hash slot for a lump, empty if it isn't in the trace
+static UINT16 *P_TraceSlot(lumpnum_t lumpnum)
+{
+	size_t i = ((UINT32)lumpnum * 2654435761u) & (WARMUPHASHSIZE-1);
+
+	while (tracehash[i] && tracelumps[tracehash[i] - 1].lumpnum != lumpnum)
+		i = (i + 1) & (WARMUPHASHSIZE-1);
+	return &tracehash[i];
+}
+
+static boolean P_AddTraceLump(lumpnum_t lumpnum, UINT8 how)
+{
+	UINT16 *slot = P_TraceSlot(lumpnum);
+	warmuplump_t *l;
+
+	if (*slot)
+	{
+		// A patch that's cached as a lump first still wants converting
+		l = &tracelumps[*slot - 1];
+		if (how != LUMPMISS_PATCH || l->how == LUMPMISS_PATCH)
+			return false;
+		l->how = how;
+		return true;
+	}
+
+	if (numtracelumps >= WARMUPMAXLUMPS)
+		return false;
+	l = &tracelumps[numtracelumps++];
+	l->lumpnum = lumpnum;
+	l->how = how;
+	*slot = (UINT16)numtracelumps;
+	return true;
+}
+
+static void P_TraceLumpMiss(lumpnum_t lumpnum, lumpmiss_t how)
+{
+	if (P_AddTraceLump(lumpnum, (UINT8)how))
+		tracechanged = true;
+}
+
+void P_SaveWarmupTrace(void)
+{
+	UINT8 *buf, *p;
+	size_t i;
+	UINT16 wad;
+
+	if (recording)
+	{
+		W_LumpMissHook = NULL;
+		recording = false;
+	}
+	if (!traceloaded || !tracechanged)
+		return;
+	tracechanged = false;
+
+	p = buf = malloc(WARMUPHEADERSIZE + 16*numwadfiles + 4 + 5*numtracelumps);
+	if (!buf)
+		return;
+
+	memcpy(p, WARMUPID, 8);
+	p += 8;
+	WRITEUINT32(p, WARMUPVERSION);
+	memcpy(p, tracemd5, 16);
+	p += 16;
+	WRITEUINT16(p, numwadfiles);
+	for (wad = 0; wad < numwadfiles; wad++)
+		WRITEMEM(p, wadfiles[wad]->md5sum, 16);
+	WRITEUINT32(p, (UINT32)numtracelumps);
+	for (i = 0; i < numtracelumps; i++)
+	{
+		WRITEUINT16(p, WADFILENUM(tracelumps[i].lumpnum));
+		WRITEUINT16(p, LUMPNUM(tracelumps[i].lumpnum));
+		WRITEUINT8(p, tracelumps[i].how);
+	}
+
+	I_mkdir(va("%s"PATHSEP WARMUPDIR, srb2home), 0755);
+	if (!FIL_WriteFile(P_WarmupTraceName(tracemd5), buf, p - buf))
+		CONS_Debug(DBG_SETUP, "P_SaveWarmupTrace: couldn't write %s\n", P_WarmupTraceName(tracemd5));
+	free(buf);
+}
+
+// Reads the trace for tracemd5 into tracelumps, leaving out whatever
+// doesn't make sense with the files loaded now
+static void P_ReadWarmupTrace(void)
+{
+	UINT8 *buf, *p, *end;
+	UINT16 numfiles, f, wad, lump, *wadmap;
+	UINT32 count;
+	size_t length;
+	UINT8 how;
+
+	length = FIL_ReadFileTag(P_WarmupTraceName(tracemd5), &buf, PU_STATIC);
+	if (!length)
+		return;
+
+	p = buf;
+	end = buf + length;
+	if (length < WARMUPHEADERSIZE || memcmp(p, WARMUPID, 8))
+		goto bad;
+	p += 8;
+	if (READUINT32(p) != WARMUPVERSION || memcmp(p, tracemd5, 16))
+		goto bad;
+	p += 16;
+	numfiles = READUINT16(p);
+	if ((size_t)(end - p) < 16U*numfiles + 4)
+		goto bad;
+
+	// Each file's number now, or numwadfiles if it isn't loaded
+	wadmap = Z_Malloc((numfiles + 1) * sizeof (*wadmap), PU_STATIC, NULL);
+	for (f = 0; f < numfiles; f++, p += 16)
+	{
+		for (wad = 0; wad < numwadfiles; wad++)
+			if (!memcmp(p, wadfiles[wad]->md5sum, 16))
+				break;
+		wadmap[f] = wad;
+	}
+
+	count = READUINT32(p);
+	if ((size_t)(end - p) < 5U*count)
+	{
+		Z_Free(wadmap);
+		goto bad;
+	}
+	for (; count; count--)
+	{
+		f = READUINT16(p);
+		lump = READUINT16(p);
+		how = READUINT8(p);
+		if (f >= numfiles || wadmap[f] >= numwadfiles || lump >= wadfiles[wadmap[f]]->numlumps
+			|| how > LUMPMISS_SOUND)
+			continue;
+		P_AddTraceLump((wadmap[f]<<16) + lump, how);
+	}
+	Z_Free(wadmap);
+	Z_Free(buf);
+	return;
+bad:
+	CONS_Debug(DBG_SETUP, "P_ReadWarmupTrace: ignoring %s\n", P_WarmupTraceName(tracemd5));
+	Z_Free(buf);
+}
+
+void P_LoadWarmupTrace(const UINT8 *md5)
+{
+	size_t i;
+
+	if (dedicated || !cv_warmuptraces.value)
+		return;
+
+	if (!traceloaded || memcmp(md5, tracemd5, 16))
+	{
+		P_SaveWarmupTrace(); // the last map's, if nothing has yet
+
+		numtracelumps = numreadlumps = warmedup = 0;
+		memset(tracehash, 0, sizeof tracehash);
+		memcpy(tracemd5, md5, 16);
+		traceloaded = true;
+		tracechanged = false;
+
+		P_ReadWarmupTrace();
+	}
+	numreadlumps = numtracelumps; // and what was added since, coming back to the map
+
+	// Sounds have their own workers, and are only decoded
+	for (i = warmedup; i < numreadlumps; i++)
+		if (tracelumps[i].how == LUMPMISS_SOUND)
+			S_PrefetchSoundLump(tracelumps[i].lumpnum);
+		else
+			W_PrefetchLump(tracelumps[i].lumpnum);
+}
+
+boolean P_WarmUpStep(UINT32 budget)
+{
+	UINT32 start = I_GetTimeMicros();
+
+	while (warmedup < numreadlumps && (!budget || I_GetTimeMicros() - start < budget))
+	{
+		const warmuplump_t *l = &tracelumps[warmedup++];
+
+		if (l->how == LUMPMISS_PATCH)
+			W_CachePatchNum(l->lumpnum, PU_CACHE); // just the lump, in software
+		else if (l->how == LUMPMISS_LUMP)
+			W_CacheLumpNum(l->lumpnum, PU_CACHE);
+	}
+	return (warmedup >= numreadlumps);
+}
+
+void P_StartWarmupTrace(const UINT8 *md5)
+{
+	if (!traceloaded || memcmp(md5, tracemd5, 16) || !cv_warmuptraces.value)
+		return;
+	W_LumpMissHook = P_TraceLumpMiss;
+	recording = true;
+}
+
+void P_WarmupTraceTicker(void)
+{
+	if (recording && leveltime >= WARMUPTRACETICS)
+	{
+		// Written at the intermission or the next load, not in the middle of play
+		W_LumpMissHook = NULL;
+		recording = false;
+	}
+}
@@ -0,0 +1,53 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  p_warmup.h
+/// \brief Warm-up traces: what a map loads in its first minute
+///
+///        For the first minute of a level, every lump that has to be read
+///        because it isn't cached (wall patches, flats, sprites, OpenGL
+///        patches, sounds) is added in order to the map's trace, kept in
+///        levelcache and found by the map's MD5. Next time the map is got
+///        ready, in the intermission before it and then in P_SetupLevel,
+///        the trace's lumps are inflated in the background and cached
+///        before it starts, rather than the first time they're drawn or
+///        heard.
+
+#ifndef __P_WARMUP__
+#define __P_WARMUP__
+
+#include "command.h"
+
+extern consvar_t cv_warmuptraces;
+
+/**	\brief Reads the trace for a map and has its lumps inflated in the
+	background. Does nothing more if it's the trace read already.
+	\param	md5	the map's MD5, as P_MakeMapMD5 makes it
+*/
+void P_LoadWarmupTrace(const UINT8 *md5);
+
+/**	\brief Caches the next lumps of the trace.
+	\param	budget	microseconds to stop after, or 0 to cache the rest
+	\return	true once every lump the trace had is cached
+*/
+boolean P_WarmUpStep(UINT32 budget);
+
+/**	\brief Starts adding to the trace of the level that's just loaded.
+	\param	md5	the level's MD5; nothing is traced unless its trace was read
+*/
+void P_StartWarmupTrace(const UINT8 *md5);
+
+/**	\brief Stops adding to the trace once the level is a minute in.
+*/
+void P_WarmupTraceTicker(void);
+
+/**	\brief Stops adding to the trace, and writes it if it grew.
+*/
+void P_SaveWarmupTrace(void);
+
+#endif // __P_WARMUP__
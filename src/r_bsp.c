@@ -713,16 +713,16 @@ void R_SortPolyObjects(subsector_t *sub)
 // Callback for qsort to sort the segs of a polyobject. Returns such that the
 // closer one is sorted first. I sure hope this doesn't break anything. -Red
 //
+// TODO might be a better way to get distance?
+#define pdist(x, y) (FixedMul(R_PointToDist(x, y), FINECOSINE((R_PointToAngle(x, y)-viewangle)>>ANGLETOFINESHIFT))+0xFFFFFFF)
+#define vxdist(v) pdist(v->x, v->y)
+
 static int R_PolysegCompare(const void *p1, const void *p2)
 {
 	const seg_t *seg1 = *(const seg_t * const *)p1;
 	const seg_t *seg2 = *(const seg_t * const *)p2;
 	fixed_t dist1v1, dist1v2, dist2v1, dist2v2;
 
-	// TODO might be a better way to get distance?
-#define pdist(x, y) (FixedMul(R_PointToDist(x, y), FINECOSINE((R_PointToAngle(x, y)-viewangle)>>ANGLETOFINESHIFT))+0xFFFFFFF)
-#define vxdist(v) pdist(v->x, v->y)
-
 	dist1v1 = vxdist(seg1->v1);
 	dist1v2 = vxdist(seg1->v2);
 	dist2v1 = vxdist(seg2->v1);
@@ -771,9 +771,70 @@ static int R_PolysegCompare(const void *p1, const void *p2)
 
 		return pdist(x1, y1)-pdist(x2, y2);
 	}
+}
+
+static fixed_t *polysegdist = NULL; // each seg's nearest end, while sorting
+static size_t numpolysegdist = 0;
+
+//
+// R_SortPolySegs
+//
+// Sorts a polyobject's segs with R_PolysegCompare. The segs are sorted in
+// place, so they're left in last time's order, which is usually right or
+// nearly right: an insertion sort only has to move the few that changed.
+// Nothing can have changed if neither the view nor the polyobject moved.
+//
+static void R_SortPolySegs(polyobj_t *po)
+{
+	seg_t **segs = po->segs;
+	seg_t *seg;
+	fixed_t dist;
+	size_t i, j;
+
+	if (po->segsorted
+		&& po->segsortviewx == viewx && po->segsortviewy == viewy && po->segsortviewangle == viewangle
+		&& po->segsortx == po->centerPt.x && po->segsorty == po->centerPt.y && po->segsortangle == po->angle)
+		return;
+
+	if (numpolysegdist < po->segCount)
+	{
+		free(polysegdist);
+		polysegdist = malloc((numpolysegdist = po->segCount*2) * sizeof(*polysegdist));
+		if (!polysegdist)
+			I_Error("R_SortPolySegs: out of memory");
+	}
+
+	// R_PolysegCompare first compares the nearest ends, so work those out once
+	for (i = 0; i < po->segCount; i++)
+		polysegdist[i] = min(vxdist(segs[i]->v1), vxdist(segs[i]->v2));
+
+	for (i = 1; i < po->segCount; i++)
+	{
+		seg = segs[i];
+		dist = polysegdist[i];
+		for (j = i; j > 0; j--)
+		{
+			if (polysegdist[j-1] < dist)
+				break;
+			if (polysegdist[j-1] == dist && R_PolysegCompare(&segs[j-1], &seg) <= 0)
+				break;
+			segs[j] = segs[j-1];
+			polysegdist[j] = polysegdist[j-1];
+		}
+		segs[j] = seg;
+		polysegdist[j] = dist;
+	}
+
+	po->segsorted = true;
+	po->segsortviewx = viewx;
+	po->segsortviewy = viewy;
+	po->segsortviewangle = viewangle;
+	po->segsortx = po->centerPt.x;
+	po->segsorty = po->centerPt.y;
+	po->segsortangle = po->angle;
+}
 #undef vxdist
 #undef pdist
-}
 
 //
 // R_AddPolyObjects
@@ -801,7 +862,7 @@ static void R_AddPolyObjects(subsector_t *sub)
 	// render polyobjects
 	for (i = 0; i < numpolys; ++i)
 	{
-		qsort(po_ptrs[i]->segs, po_ptrs[i]->segCount, sizeof(seg_t *), R_PolysegCompare);
+		R_SortPolySegs(po_ptrs[i]);
 		for (j = 0; j < po_ptrs[i]->segCount; ++j)
 			R_AddLine(po_ptrs[i]->segs[j]);
 	}
@@ -863,10 +924,10 @@ static void R_Subsector(size_t num)
 	{
 		if (frontsector->moved)
 		{
-			frontsector->numlights = sub->sector->numlights = 0;
 			R_Prep3DFloors(frontsector);
 			sub->sector->lightlist = frontsector->lightlist;
 			sub->sector->numlights = frontsector->numlights;
+			sub->sector->maxlights = frontsector->maxlights;
 			sub->sector->moved = frontsector->moved = false;
 		}
 
@@ -1222,17 +1283,28 @@ void R_Prep3DFloors(sector_t *sector)
 			count++;
 			if (rover->flags & FF_DOUBLESHADOW)
 				count++;
+
+			// The sort below looks at these once a light
+#ifdef ESLOPE
+			rover->lighttop = *rover->t_slope ? P_GetZAt(*rover->t_slope, sector->soundorg.x, sector->soundorg.y) : *rover->topheight;
+			rover->lightbottom = *rover->b_slope ? P_GetZAt(*rover->b_slope, sector->soundorg.x, sector->soundorg.y) : *rover->bottomheight;
+#else
+			rover->lighttop = *rover->topheight;
+			rover->lightbottom = *rover->bottomheight;
+#endif
 		}
 	}
 
-	if (count != sector->numlights)
+	// The list stays allocated, and only grows
+	if (count > sector->maxlights)
 	{
 		Z_Free(sector->lightlist);
 		sector->lightlist = Z_Calloc(sizeof (*sector->lightlist) * count, PU_LEVEL, NULL);
-		sector->numlights = count;
+		sector->maxlights = count;
 	}
 	else
 		memset(sector->lightlist, 0, sizeof (lightlist_t) * count);
+	sector->numlights = count;
 
 #ifdef ESLOPE
 	heighttest = sector->c_slope ? P_GetZAt(sector->c_slope, sector->soundorg.x, sector->soundorg.y) : sector->ceilingheight;
@@ -1259,43 +1331,25 @@ void R_Prep3DFloors(sector_t *sector)
 				&& !(rover->flags & FF_CUTLEVEL) && !(rover->flags & FF_CUTSPRITES)))
 			continue;
 
-#ifdef ESLOPE
-			heighttest = *rover->t_slope ? P_GetZAt(*rover->t_slope, sector->soundorg.x, sector->soundorg.y) : *rover->topheight;
-
-			if (heighttest > bestheight && heighttest < maxheight)
+			if (rover->lighttop > bestheight && rover->lighttop < maxheight)
 			{
 				best = rover;
-				bestheight = heighttest;
+				bestheight = rover->lighttop;
+#ifdef ESLOPE
 				bestslope = *rover->t_slope;
+#endif
 				continue;
 			}
-			if (rover->flags & FF_DOUBLESHADOW) {
-				heighttest = *rover->b_slope ? P_GetZAt(*rover->b_slope, sector->soundorg.x, sector->soundorg.y) : *rover->bottomheight;
-
-				if (heighttest > bestheight
-					&& heighttest < maxheight)
-				{
-					best = rover;
-					bestheight = heighttest;
-					bestslope = *rover->b_slope;
-					continue;
-				}
-			}
-#else
-			if (*rover->topheight > bestheight && *rover->topheight < maxheight)
-			{
-				best = rover;
-				bestheight = *rover->topheight;
-				continue;
-			}
-			if (rover->flags & FF_DOUBLESHADOW && *rover->bottomheight > bestheight
-				&& *rover->bottomheight < maxheight)
+			if (rover->flags & FF_DOUBLESHADOW && rover->lightbottom > bestheight
+				&& rover->lightbottom < maxheight)
 			{
 				best = rover;
-				bestheight = *rover->bottomheight;
+				bestheight = rover->lightbottom;
+#ifdef ESLOPE
+				bestslope = *rover->b_slope;
+#endif
 				continue;
 			}
-#endif
 		}
 		if (!best)
 		{
@@ -1334,12 +1388,7 @@ void R_Prep3DFloors(sector_t *sector)
 
 		if (best->flags & FF_DOUBLESHADOW)
 		{
-#ifdef ESLOPE
-			heighttest = *best->b_slope ? P_GetZAt(*best->b_slope, sector->soundorg.x, sector->soundorg.y) : *best->bottomheight;
-			if (bestheight == heighttest) ///TODO: do this in a more efficient way -Red
-#else
-			if (bestheight == *best->bottomheight)
-#endif
+			if (bestheight == best->lightbottom)
 			{
 				sector->lightlist[i].lightlevel = sector->lightlist[best->lastlight].lightlevel;
 				sector->lightlist[i].extra_colormap =
@@ -24,6 +24,7 @@
 #include "p_setup.h" // levelflats
 #include "v_video.h" // pLocalPalette
 #include "dehacked.h"
+#include "m_trace.h"
 
 #if defined (_WIN32) || defined (_WIN32_WCE)
 #include <malloc.h> // alloca(sizeof)
@@ -101,6 +102,19 @@ texture_t **textures = NULL;
 static UINT32 **texturecolumnofs; // column offset lookup table for each texture
 static UINT8 **texturecache; // graphics data for each generated full-size texture
 
+// Composites are evicted, least recently drawn first, once they go over
+// texturecachesize megabytes. Zero means no limit.
+static CV_PossibleValue_t texturecachesize_cons_t[] = {{0, "MIN"}, {1024, "MAX"}, {0, NULL}};
+consvar_t cv_texturecachesize = {"texturecachesize", "64", CV_SAVE, texturecachesize_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct
+{
+	size_t lastused; // framecount when last drawn
+	size_t size; // bytes in texturecache
+} texturecacheinfo_t;
+
+static texturecacheinfo_t *texturecacheinfo;
+
 // texture width is a power of 2, so it can easily repeat along sidedefs using a simple mask
 INT32 *texturewidthmask;
 
@@ -120,12 +134,16 @@ static size_t flatmemory, spritememory, texturememory;
 INT16 color8to16[256]; // remap color index to highcolor rgb value
 INT16 *hicolormaps; // test a 32k colormap remaps high -> high
 
-// Painfully simple texture id cacheing to make maps load faster. :3
-static struct {
-	char name[9];
-	INT32 id;
-} *tidcache = NULL;
-static INT32 tidcachelen = 0;
+// Hash index over textures[].name, built by R_LoadTextures. Chains run
+// from the newest texture to the oldest, so later ones win.
+static INT32 *texturehash = NULL; // first texture of each chain, -1 if empty
+static INT32 *texturehashnext = NULL; // next texture in the same chain
+static UINT32 texturehashmask = 0;
+
+// Which textures have been looked up since R_ClearTextureNumCache, for the fun fact
+static UINT32 *texturelookedup = NULL;
+static UINT32 texturelookupgen = 1;
+static INT32 texturesused = 0;
 
 //
 // MAPTEXTURE_T CACHING
@@ -173,6 +191,55 @@ static inline void R_DrawColumnInCache(column_t *patch, UINT8 *cache, INT32 orig
 	}
 }
 
+static int texturelastusedcmp(const void *a, const void *b)
+{
+	const size_t la = texturecacheinfo[*(const INT32 *)a].lastused;
+	const size_t lb = texturecacheinfo[*(const INT32 *)b].lastused;
+	return (la > lb) - (la < lb);
+}
+
+//
+// R_TrimTextureCache
+//
+// Makes room for needed more bytes of composites by freeing the ones that
+// were drawn longest ago. Textures drawn this frame are never freed, the
+// renderer may still be holding their columns.
+//
+static void R_TrimTextureCache(size_t needed)
+{
+	const size_t budget = (size_t)cv_texturecachesize.value<<20;
+	size_t cached = 0;
+	INT32 *order, i, n = 0;
+
+	if (!budget)
+		return;
+
+	// The zone can also purge them when memory runs low, so count again.
+	for (i = 0; i < numtextures; i++)
+		if (texturecache[i])
+			cached += texturecacheinfo[i].size;
+
+	if (cached + needed <= budget)
+		return;
+
+	order = malloc(numtextures * sizeof (*order));
+	if (!order)
+		return;
+
+	for (i = 0; i < numtextures; i++)
+		if (texturecache[i] && texturecacheinfo[i].lastused != framecount)
+			order[n++] = i;
+	qsort(order, n, sizeof (*order), texturelastusedcmp);
+
+	for (i = 0; i < n && cached + needed > budget; i++)
+	{
+		cached -= texturecacheinfo[order[i]].size;
+		Z_Free(texturecache[order[i]]);
+	}
+
+	free(order);
+}
+
 //
 // R_GenerateTexture
 //
@@ -240,6 +307,7 @@ static UINT8 *R_GenerateTexture(size_t texnum)
 		{
 			texture->holes = true;
 			blocksize = W_LumpLengthPwad(patch->wad, patch->lump);
+			R_TrimTextureCache(blocksize);
 			block = Z_Calloc(blocksize, PU_STATIC, // will change tag at end of this function
 				&texturecache[texnum]);
 			M_Memcpy(block, realpatch, blocksize);
@@ -261,6 +329,7 @@ static UINT8 *R_GenerateTexture(size_t texnum)
 	texture->holes = false;
 	blocksize = (texture->width * 4) + (texture->width * texture->height);
 	texturememory += blocksize;
+	R_TrimTextureCache(blocksize);
 	block = Z_Malloc(blocksize+1, PU_STATIC, &texturecache[texnum]);
 
 	memset(block, 0xF7, blocksize+1); // Transparency hack
@@ -298,6 +367,9 @@ static UINT8 *R_GenerateTexture(size_t texnum)
 	}
 
 done:
+	texturecacheinfo[texnum].size = blocksize;
+	texturecacheinfo[texnum].lastused = framecount;
+
 	// Now that the texture has been built in column cache, it is purgable from zone memory.
 	Z_ChangeTag(block, PU_CACHE);
 	return blocktex;
@@ -322,11 +394,14 @@ INT32 R_GetTextureNum(INT32 texnum)
 //
 // Use this if you need to make sure the texture is cached before R_GetColumn calls
 // e.g.: midtextures and FOF walls
+// Returns the cached texture, which R_GetColumn's columns point into
 //
-void R_CheckTextureCache(INT32 tex)
+UINT8 *R_CheckTextureCache(INT32 tex)
 {
+	texturecacheinfo[tex].lastused = framecount;
 	if (!texturecache[tex])
-		R_GenerateTexture(tex);
+		return R_GenerateTexture(tex);
+	return texturecache[tex];
 }
 
 //
@@ -338,6 +413,7 @@ UINT8 *R_GetColumn(fixed_t tex, INT32 col)
 
 	col &= texturewidthmask[tex];
 	data = texturecache[tex];
+	texturecacheinfo[tex].lastused = framecount;
 
 	if (!data)
 		data = R_GenerateTexture(tex);
@@ -352,6 +428,59 @@ UINT8 *R_GetFlat(lumpnum_t flatlumpnum)
 	return W_CacheLumpNum(flatlumpnum, PU_CACHE);
 }
 
+// Tiled copies of the flats, by lump. They're PU_LEVEL, so loading a
+// level empties every slot at once and the probe chains stay whole.
+#define TILEDFLATS 512
+typedef struct
+{
+	lumpnum_t lumpnum;
+	UINT8 *data; // NULL for an empty slot
+} tiledflat_t;
+static tiledflat_t tiledflats[TILEDFLATS];
+
+//
+// R_GetTiledFlat
+//
+// Returns flatlumpnum, a 2^bits square, laid out as R_DrawTiledSpan_8
+// reads it: in strips of 8 rows, column by column within a strip, so
+// every 64 bytes hold an 8x8 block. Returns NULL if the cache is full.
+//
+UINT8 *R_GetTiledFlat(lumpnum_t flatlumpnum, INT32 bits)
+{
+	const INT32 width = 1<<bits;
+	size_t slot = ((size_t)flatlumpnum * 2654435761u) % TILEDFLATS, n;
+	tiledflat_t *tf;
+	UINT8 *src, *dst;
+
+	for (n = 0; n < TILEDFLATS; n++, slot = (slot + 1) % TILEDFLATS)
+	{
+		tf = &tiledflats[slot];
+		if (!tf->data)
+			break;
+		if (tf->lumpnum == flatlumpnum)
+			return tf->data;
+	}
+	if (n == TILEDFLATS)
+		return NULL;
+
+	src = W_CacheLumpNum(flatlumpnum, PU_STATIC);
+	dst = Z_Malloc((size_t)width*width, PU_LEVEL, &tf->data);
+	tf->lumpnum = flatlumpnum;
+	R_TileFlat(dst, src, bits);
+	Z_ChangeTag(src, PU_CACHE);
+	return dst;
+}
+
+void R_TileFlat(UINT8 *dst, const UINT8 *src, INT32 bits)
+{
+	const INT32 width = 1<<bits;
+	INT32 u, v;
+
+	for (v = 0; v < width; v++)
+		for (u = 0; u < width; u++)
+			dst[((v>>3)<<(bits+3)) | (u<<3) | (v&7)] = src[(v<<bits) + u];
+}
+
 //
 // Empty the texture cache (used for load wad at runtime)
 //
@@ -368,6 +497,37 @@ void R_FlushTextureCache(void)
 int R_CountTexturesInTEXTURESLump(UINT16 wadNum, UINT16 lumpNum);
 void R_ParseTEXTURESLump(UINT16 wadNum, UINT16 lumpNum, INT32 *index);
 
+//
+// R_BuildTextureHash
+//
+// Indexes textures[] by name, for R_CheckTextureNumForName.
+//
+static void R_BuildTextureHash(void)
+{
+	UINT32 numbuckets = 16;
+	INT32 i;
+
+	while (numbuckets < (UINT32)numtextures)
+		numbuckets <<= 1;
+
+	// one block: the buckets, then the chains, then the lookup marks
+	texturehash = Z_Malloc((numbuckets + numtextures*2) * sizeof (*texturehash), PU_STATIC, NULL);
+	texturehashnext = texturehash + numbuckets;
+	texturelookedup = (UINT32 *)(texturehashnext + numtextures);
+	texturehashmask = numbuckets - 1;
+	memset(texturehash, 0xff, numbuckets * sizeof (*texturehash));
+	memset(texturelookedup, 0, numtextures * sizeof (*texturelookedup));
+	texturelookupgen = 1;
+
+	// Insert forwards so each chain starts with the newest texture.
+	for (i = 0; i < numtextures; i++)
+	{
+		const UINT32 bucket = W_HashLumpName(textures[i]->name, 8) & texturehashmask;
+		texturehashnext[i] = texturehash[bucket];
+		texturehash[bucket] = i;
+	}
+}
+
 //
 // R_LoadTextures
 // Initializes the texture list with the textures from the world map.
@@ -379,13 +539,16 @@ void R_LoadTextures(void)
 	INT32 i, k, w;
 	UINT16 j;
 	UINT16 texstart, texend, texturesLumpPos;
-	patch_t *patchlump;
+	patch_t patchlump;
 	texpatch_t *patch;
 	texture_t *texture;
 
 	// Free previous memory before numtextures change.
 	if (numtextures)
 	{
+		Z_Free(texturehash);
+		texturehash = texturehashnext = NULL;
+		texturelookedup = NULL;
 		for (i = 0; i < numtextures; i++)
 		{
 			Z_Free(textures[i]);
@@ -393,6 +556,7 @@ void R_LoadTextures(void)
 		}
 		Z_Free(texturetranslation);
 		Z_Free(textures);
+		Z_Free(texturecacheinfo);
 	}
 
 	// Load patches and textures.
@@ -462,6 +626,8 @@ void R_LoadTextures(void)
 	texturewidthmask = (void *)((UINT8 *)textures + ((numtextures * sizeof(void *)) * 3));
 	// Allocate texture height mask table.
 	textureheight    = (void *)((UINT8 *)textures + ((numtextures * sizeof(void *)) * 4));
+	// Bookkeeping for R_TrimTextureCache.
+	texturecacheinfo = Z_Calloc(numtextures * sizeof(*texturecacheinfo), PU_STATIC, NULL);
 	// Create translation table for global animation.
 	texturetranslation = Z_Malloc((numtextures + 1) * sizeof(*texturetranslation), PU_STATIC, NULL);
 
@@ -504,15 +670,16 @@ void R_LoadTextures(void)
 				if (W_IsLumpFolder((UINT16)w, texstart + j)) // Check if lump is a folder
 					continue; // If it is then SKIP IT
 			}
-			patchlump = W_CacheLumpNumPwad((UINT16)w, texstart + j, PU_CACHE);
+			// Only the size is needed here, the rest is read when the texture is made.
+			W_ReadLumpHeaderPwad((UINT16)w, texstart + j, &patchlump, sizeof (patchlump), 0);
 
-			//CONS_Printf("\n\"%s\" is a single patch, dimensions %d x %d",W_CheckNameForNumPwad((UINT16)w,texstart+j),patchlump->width, patchlump->height);
+			//CONS_Printf("\n\"%s\" is a single patch, dimensions %d x %d",W_CheckNameForNumPwad((UINT16)w,texstart+j),patchlump.width, patchlump.height);
 			texture = textures[i] = Z_Calloc(sizeof(texture_t) + sizeof(texpatch_t), PU_STATIC, NULL);
 
 			// Set texture properties.
 			M_Memcpy(texture->name, W_CheckNameForNumPwad((UINT16)w, texstart + j), sizeof(texture->name));
-			texture->width = SHORT(patchlump->width);
-			texture->height = SHORT(patchlump->height);
+			texture->width = SHORT(patchlump.width);
+			texture->height = SHORT(patchlump.height);
 			texture->patchcount = 1;
 			texture->holes = false;
 
@@ -523,8 +690,6 @@ void R_LoadTextures(void)
 			patch->wad = (UINT16)w;
 			patch->lump = texstart + j;
 
-			Z_Unlock(patchlump);
-
 			k = 1;
 			while (k << 1 <= texture->width)
 				k <<= 1;
@@ -533,6 +698,8 @@ void R_LoadTextures(void)
 			i++;
 		}
 	}
+
+	R_BuildTextureHash();
 }
 
 static texpatch_t *R_ParsePatch(boolean actuallyLoadPatch)
@@ -1165,6 +1332,103 @@ static double deltas[256][3], map[256][3];
 static UINT8 NearestColor(UINT8 r, UINT8 g, UINT8 b);
 static int RoundUp(double number);
 
+// Software colormaps made for earlier levels, kept for the next one to use
+#define MAXCACHEDCOLORMAPS 64
+
+typedef struct
+{
+	double cmask[3], othermask, cdest[3];
+	UINT32 fadestart, fadedist;
+	UINT8 *colormap;
+	UINT32 lastused;
+} cachedcolormap_t;
+
+static cachedcolormap_t cachedcolormaps[MAXCACHEDCOLORMAPS];
+static size_t numcachedcolormaps = 0;
+static UINT32 colormapcachetime = 0;
+
+static boolean R_ColormapInUse(const UINT8 *colormap)
+{
+	size_t i;
+
+	for (i = 0; i < num_extra_colormaps; i++)
+		if (extra_colormaps[i].colormap == colormap)
+			return true;
+	return false;
+}
+
+//
+// R_FlushColormapCache
+//
+// For a new palette. Colormaps the level still uses go with it.
+//
+static void R_FlushColormapCache(void)
+{
+	size_t i;
+
+	for (i = 0; i < numcachedcolormaps; i++)
+	{
+		if (R_ColormapInUse(cachedcolormaps[i].colormap))
+			Z_ChangeTag(cachedcolormaps[i].colormap, PU_LEVEL);
+		else
+			Z_Free(cachedcolormaps[i].colormap);
+	}
+	numcachedcolormaps = 0;
+}
+
+static boolean R_SameColormap(const cachedcolormap_t *a, const cachedcolormap_t *b)
+{
+	return a->cmask[0] == b->cmask[0] && a->cmask[1] == b->cmask[1] && a->cmask[2] == b->cmask[2]
+		&& a->othermask == b->othermask
+		&& a->cdest[0] == b->cdest[0] && a->cdest[1] == b->cdest[1] && a->cdest[2] == b->cdest[2]
+		&& a->fadestart == b->fadestart && a->fadedist == b->fadedist;
+}
+
+//
+// R_CachedColormap
+//
+// Finds the colormap for key, or allocates one for it that the caller fills.
+// Sets made to true for a new one.
+//
+static UINT8 *R_CachedColormap(cachedcolormap_t *key, boolean *made)
+{
+	cachedcolormap_t *slot = NULL;
+	size_t i;
+
+	colormapcachetime++;
+	for (i = 0; i < numcachedcolormaps; i++)
+	{
+		if (R_SameColormap(&cachedcolormaps[i], key))
+		{
+			cachedcolormaps[i].lastused = colormapcachetime;
+			*made = false;
+			return cachedcolormaps[i].colormap;
+		}
+	}
+
+	*made = true;
+	if (numcachedcolormaps < MAXCACHEDCOLORMAPS)
+		slot = &cachedcolormaps[numcachedcolormaps++];
+	else
+	{
+		// Make room by dropping the one unused the longest
+		for (i = 0; i < numcachedcolormaps; i++)
+		{
+			if ((!slot || cachedcolormaps[i].lastused < slot->lastused)
+				&& !R_ColormapInUse(cachedcolormaps[i].colormap))
+				slot = &cachedcolormaps[i];
+		}
+		if (!slot) // all of them are up already
+			return Z_MallocAlign((256 * 34) + 10, PU_LEVEL, NULL, 8);
+		Z_Free(slot->colormap);
+	}
+
+	*slot = *key;
+	slot->colormap = Z_MallocAlign((256 * 34) + 10, PU_STATIC, NULL, 8);
+	slot->lastused = colormapcachetime;
+	return slot->colormap;
+}
+
 INT32 R_CreateColormap(char *p1, char *p2, char *p3)
 {
 	double cmaskr, cmaskg, cmaskb, cdestr, cdestg, cdestb;
@@ -1271,6 +1535,25 @@ INT32 R_CreateColormap(char *p1, char *p2, char *p3)
 		double r, g, b, cbrightness;
 		int p;
 		char *colormap_p;
+		cachedcolormap_t key;
+		boolean made;
+
+		// Nothing made for another palette fits this one
+		R_UpdateColorCube();
+
+		key.cmask[0] = cmaskr;
+		key.cmask[1] = cmaskg;
+		key.cmask[2] = cmaskb;
+		key.othermask = othermask;
+		key.cdest[0] = cdestr;
+		key.cdest[1] = cdestg;
+		key.cdest[2] = cdestb;
+		key.fadestart = fadestart;
+		key.fadedist = fadedist;
+
+		extra_colormaps[mapnum].colormap = R_CachedColormap(&key, &made);
+		if (!made)
+			return (INT32)mapnum;
 
 		// Initialise the map and delta arrays
 		// map[i] stores an RGB color (as double) for index i,
@@ -1300,9 +1583,7 @@ INT32 R_CreateColormap(char *p1, char *p2, char *p3)
 			deltas[i][2] = (map[i][2] - cdestb) / (double)fadedist;
 		}
 
-		// Now allocate memory for the actual colormap array itself!
-		colormap_p = Z_MallocAlign((256 * 34) + 10, PU_LEVEL, NULL, 8);
-		extra_colormaps[mapnum].colormap = (UINT8 *)colormap_p;
+		colormap_p = (char *)extra_colormaps[mapnum].colormap;
 
 		// Calculate the palette index for each palette index, for each light level
 		// (as well as the two unused colormap lines we inherited from Doom)
@@ -1340,15 +1621,110 @@ INT32 R_CreateColormap(char *p1, char *p2, char *p3)
 	return (INT32)mapnum;
 }
 
+//
+// The color cube
+//
+// RGB space is split into 32x32x32 cubes, 8 shades a side. Each one lists
+// the only palette entries that can be nearest to a color inside it: the
+// ones no farther from its nearest corner than some entry is from its
+// farthest. They stay in palette order, so the search picks the same entry
+// the full one would.
+//
+#define CUBEBITS 3
+#define CUBESIDE (256 >> CUBEBITS)
+#define NUMCUBES (CUBESIDE * CUBESIDE * CUBESIDE)
+
+static UINT8 cubepalette[256][3];
+static boolean cubebuilt = false;
+static UINT32 cubefirst[NUMCUBES + 1]; // each cube's list starts here in cubecolors
+static UINT8 *cubecolors = NULL;
+static size_t maxcubecolors = 0;
+
+void R_UpdateColorCube(void)
+{
+	// squared distance along each axis from an entry to a slice of cubes
+	static INT32 nearaxis[3][CUBESIDE][256], faraxis[3][CUBESIDE][256];
+	INT32 mindist[256];
+	INT32 c, i, ch;
+	UINT32 n = 0;
+
+	if (cubebuilt)
+	{
+		for (i = 0; i < 256; i++)
+			if (cubepalette[i][0] != pLocalPalette[i].s.red
+				|| cubepalette[i][1] != pLocalPalette[i].s.green
+				|| cubepalette[i][2] != pLocalPalette[i].s.blue)
+				break;
+		if (i == 256)
+			return;
+	}
+
+	R_FlushColormapCache();
+
+	for (i = 0; i < 256; i++)
+	{
+		cubepalette[i][0] = pLocalPalette[i].s.red;
+		cubepalette[i][1] = pLocalPalette[i].s.green;
+		cubepalette[i][2] = pLocalPalette[i].s.blue;
+	}
+
+	for (ch = 0; ch < 3; ch++)
+		for (c = 0; c < CUBESIDE; c++)
+			for (i = 0; i < 256; i++)
+			{
+				const INT32 v = cubepalette[i][ch], l = c << CUBEBITS, h = l + (1 << CUBEBITS) - 1;
+				const INT32 dn = v < l ? l - v : (v > h ? v - h : 0);
+				const INT32 df = v - l > h - v ? v - l : h - v;
+
+				nearaxis[ch][c][i] = dn*dn;
+				faraxis[ch][c][i] = df*df;
+			}
+
+	for (c = 0; c < NUMCUBES; c++)
+	{
+		const INT32 *nr = nearaxis[0][c / (CUBESIDE * CUBESIDE)], *fr = faraxis[0][c / (CUBESIDE * CUBESIDE)];
+		const INT32 *ng = nearaxis[1][(c / CUBESIDE) % CUBESIDE], *fg = faraxis[1][(c / CUBESIDE) % CUBESIDE];
+		const INT32 *nb = nearaxis[2][c % CUBESIDE], *fb = faraxis[2][c % CUBESIDE];
+		INT32 bound = INT32_MAX;
+
+		for (i = 0; i < 256; i++)
+		{
+			const INT32 farthest = fr[i] + fg[i] + fb[i];
+
+			mindist[i] = nr[i] + ng[i] + nb[i];
+			if (farthest < bound)
+				bound = farthest;
+		}
+
+		cubefirst[c] = n;
+		for (i = 0; i < 256; i++)
+		{
+			if (mindist[i] > bound)
+				continue;
+			if (n == maxcubecolors)
+			{
+				maxcubecolors = maxcubecolors ? maxcubecolors*2 : NUMCUBES*4;
+				cubecolors = Z_Realloc(cubecolors, maxcubecolors, PU_STATIC, NULL);
+			}
+			cubecolors[n++] = (UINT8)i;
+		}
+	}
+	cubefirst[NUMCUBES] = n;
+	cubebuilt = true;
+}
+
 // Thanks to quake2 source!
 // utils3/qdata/images.c
 static UINT8 NearestColor(UINT8 r, UINT8 g, UINT8 b)
 {
 	int dr, dg, db;
 	int distortion, bestdistortion = 256 * 256 * 4, bestcolor = 0, i;
+	const UINT32 cube = ((r >> CUBEBITS) * CUBESIDE + (g >> CUBEBITS)) * CUBESIDE + (b >> CUBEBITS);
+	UINT32 j;
 
-	for (i = 0; i < 256; i++)
+	for (j = cubefirst[cube]; j < cubefirst[cube + 1]; j++)
 	{
+		i = cubecolors[j];
 		dr = r - pLocalPalette[i].s.red;
 		dg = g - pLocalPalette[i].s.green;
 		db = b - pLocalPalette[i].s.blue;
@@ -1366,6 +1742,11 @@ static UINT8 NearestColor(UINT8 r, UINT8 g, UINT8 b)
 	return (UINT8)bestcolor;
 }
 
+UINT8 R_NearestPaletteColor(UINT8 r, UINT8 g, UINT8 b)
+{
+	return NearestColor(r, g, b);
+}
+
 // Rounds off floating numbers and checks for 0 - 255 bounds
 static int RoundUp(double number)
 {
@@ -1444,27 +1825,37 @@ void R_InitData(void)
 	}
 
 	CONS_Printf("R_LoadTextures()...\n");
+	TRACE_BEGIN("render", "Textures");
 	R_LoadTextures();
+	TRACE_END();
 
 	CONS_Printf("P_InitPicAnims()...\n");
+	TRACE_BEGIN("render", "Animated textures");
 	P_InitPicAnims();
+	TRACE_END();
 
 	CONS_Printf("R_InitSprites()...\n");
+	TRACE_BEGIN("render", "Sprites");
 	R_InitSpriteLumps();
 	R_InitSprites();
+	TRACE_END();
 
 	CONS_Printf("R_InitColormaps()...\n");
+	TRACE_BEGIN("render", "Colormaps");
 	R_InitColormaps();
+	TRACE_END();
 }
 
 void R_ClearTextureNumCache(boolean btell)
 {
-	if (tidcache)
-		Z_Free(tidcache);
-	tidcache = NULL;
 	if (btell)
-		CONS_Debug(DBG_SETUP, "Fun Fact: There are %d textures used in this map.\n", tidcachelen);
-	tidcachelen = 0;
+		CONS_Debug(DBG_SETUP, "Fun Fact: There are %d textures used in this map.\n", texturesused);
+	texturesused = 0;
+	if (++texturelookupgen == 0 && texturelookedup) // wrapped around
+	{
+		memset(texturelookedup, 0, numtextures * sizeof (*texturelookedup));
+		texturelookupgen = 1;
+	}
 }
 
 //
@@ -1480,23 +1871,20 @@ INT32 R_CheckTextureNumForName(const char *name)
 	if (name[0] == '-')
 		return 0;
 
-	for (i = 0; i < tidcachelen; i++)
-		if (!strncasecmp(tidcache[i].name, name, 8))
-			return tidcache[i].id;
+	if (!texturehash)
+		return -1;
 
-	// Need to parse the list backwards, so textures loaded more recently are used in lieu of ones loaded earlier
-	//for (i = 0; i < numtextures; i++) <- old
-	for (i = (numtextures - 1); i >= 0; i--) // <- new
+	for (i = texturehash[W_HashLumpName(name, 8) & texturehashmask]; i != -1; i = texturehashnext[i])
 		if (!strncasecmp(textures[i]->name, name, 8))
 		{
-			tidcachelen++;
-			Z_Realloc(tidcache, tidcachelen * sizeof(*tidcache), PU_STATIC, &tidcache);
-			strncpy(tidcache[tidcachelen-1].name, name, 8);
-			tidcache[tidcachelen-1].name[8] = '\0';
+			if (texturelookedup[i] != texturelookupgen)
+			{
+				texturelookedup[i] = texturelookupgen;
+				texturesused++;
 #ifndef ZDEBUG
-			CONS_Debug(DBG_SETUP, "texture #%s: %s\n", sizeu1(tidcachelen), tidcache[tidcachelen-1].name);
+				CONS_Debug(DBG_SETUP, "texture #%d: %.8s\n", texturesused, textures[i]->name);
 #endif
-			tidcache[tidcachelen-1].id = i;
+			}
 			return i;
 		}
 
@@ -1525,6 +1913,94 @@ INT32 R_TextureNumForName(const char *name)
 	return i;
 }
 
+//
+// R_PrefetchTexture
+//
+// Has the patches of a wall texture inflated in the background, unless
+// its composite is already made.
+//
+void R_PrefetchTexture(INT32 tex)
+{
+	INT32 i;
+
+	if (tex < 0 || tex >= numtextures || texturecache[tex])
+		return;
+	for (i = 0; i < textures[tex]->patchcount; i++)
+		W_PrefetchLump((textures[tex]->patches[i].wad<<16) + textures[tex]->patches[i].lump);
+}
+
+//
+// R_PrefetchSprite
+//
+// Has every frame of a sprite inflated in the background.
+//
+void R_PrefetchSprite(spritenum_t sprite)
+{
+	size_t j, k;
+
+	if (sprite >= numsprites)
+		return;
+	for (j = 0; j < sprites[sprite].numframes; j++)
+		for (k = 0; k < 8; k++)
+			W_PrefetchLump(sprites[sprite].spriteframes[j].lumppat[k]);
+}
+
+//
+// R_PrefetchLevelGraphics
+//
+// Has the lumps of every wall texture patch, flat and thing sprite in the
+// level inflated in the background, so whatever caches them next (the
+// renderer, or R_PrecacheLevel) finds them ready. Call once the map's
+// geometry and things are loaded.
+//
+void R_PrefetchLevelGraphics(void)
+{
+	UINT8 *texturepresent, *spritepresent;
+	size_t i;
+	thinker_t *th;
+
+	W_FlushPrefetchedLumps();
+
+	texturepresent = calloc(numtextures, sizeof (*texturepresent));
+	spritepresent = calloc(numsprites, sizeof (*spritepresent));
+	if (!texturepresent || !spritepresent)
+	{
+		free(texturepresent);
+		free(spritepresent);
+		return; // it's only a hint anyway
+	}
+
+	for (i = 0; i < numsides; i++)
+	{
+		if (sides[i].toptexture >= 0 && sides[i].toptexture < numtextures)
+			texturepresent[sides[i].toptexture] = 1;
+		if (sides[i].midtexture >= 0 && sides[i].midtexture < numtextures)
+			texturepresent[sides[i].midtexture] = 1;
+		if (sides[i].bottomtexture >= 0 && sides[i].bottomtexture < numtextures)
+			texturepresent[sides[i].bottomtexture] = 1;
+	}
+	if (skytexture >= 0 && skytexture < numtextures)
+		texturepresent[skytexture] = 1;
+
+	for (i = 0; i < (unsigned)numtextures; i++)
+		if (texturepresent[i])
+			R_PrefetchTexture((INT32)i);
+
+	for (i = 0; i < numlevelflats; i++)
+		W_PrefetchLump(levelflats[i].lumpnum);
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+			spritepresent[((mobj_t *)th)->sprite] = 1;
+
+	for (i = 0; i < numsprites; i++)
+		if (spritepresent[i])
+			R_PrefetchSprite((spritenum_t)i);
+
+	free(texturepresent);
+	free(spritepresent);
+}
+
 //
 // R_PrecacheLevel
 //
@@ -1592,7 +2068,7 @@ void R_PrecacheLevel(void)
 	spritepresent = calloc(numsprites, sizeof (*spritepresent));
 	if (spritepresent == NULL) I_Error("%s: Out of memory looking up sprites", "R_PrecacheLevel");
 
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
 		if (th->function.acp1 == (actionf_p1)P_MobjThinker)
 			spritepresent[((mobj_t *)th)->sprite] = 1;
 
@@ -65,16 +65,23 @@ extern CV_PossibleValue_t Color_cons_t[];
 void R_LoadTextures(void);
 void R_FlushTextureCache(void);
 
+extern consvar_t cv_texturecachesize;
+
 INT32 R_GetTextureNum(INT32 texnum);
-void R_CheckTextureCache(INT32 tex);
+UINT8 *R_CheckTextureCache(INT32 tex);
 
 // Retrieve column data for span blitting.
 UINT8 *R_GetColumn(fixed_t tex, INT32 col);
 
 UINT8 *R_GetFlat(lumpnum_t flatnum);
+UINT8 *R_GetTiledFlat(lumpnum_t flatlumpnum, INT32 bits);
+void R_TileFlat(UINT8 *dst, const UINT8 *src, INT32 bits); // the layout R_GetTiledFlat uses
 
 // I/O, setting up the stuff.
 void R_InitData(void);
+void R_PrefetchTexture(INT32 tex);
+void R_PrefetchSprite(spritenum_t sprite);
+void R_PrefetchLevelGraphics(void);
 void R_PrecacheLevel(void);
 
 // Retrieval.
@@ -93,6 +100,9 @@ void R_ReInitColormaps(UINT16 num);
 void R_ClearColormaps(void);
 INT32 R_ColormapNumForName(char *name);
 INT32 R_CreateColormap(char *p1, char *p2, char *p3);
+// Finding the palette entry nearest to a color: update the cube first
+void R_UpdateColorCube(void);
+UINT8 R_NearestPaletteColor(UINT8 r, UINT8 g, UINT8 b);
 const char *R_ColormapNameForNum(INT32 num);
 
 extern INT32 numtextures;
@@ -171,6 +171,7 @@ typedef struct ffloor_s
 	struct ffloor_s *prev;
 
 	INT32 lastlight;
+	fixed_t lighttop, lightbottom; // heights at the middle of target, for R_Prep3DFloors
 	INT32 alpha;
 	tic_t norender; // for culling
 
@@ -303,6 +304,7 @@ typedef struct sector_s
 
 	// list of mobjs in sector
 	mobj_t *thinglist;
+	fixed_t thingbox[4]; // around their origins, maybe loosely, for culling sprites
 
 	// thinker_ts for reversable actions
 	void *floordata; // floor move thinker
@@ -339,14 +341,21 @@ typedef struct sector_s
 
 	// Improved fake floor hack
 	ffloor_t *ffloors;
+	ffloortype_e fofflags; // flags of every existing FOF here, ORed together (see P_RecalcFOFFlags)
 	size_t *attached;
 	boolean *attachedsolid;
 	size_t numattached;
 	size_t maxattached;
 	lightlist_t *lightlist;
 	INT32 numlights;
+	INT32 maxlights; // lightlist has room for this many
 	boolean moved;
 
+	// Where weather lands, the same anywhere in the sector, good during
+	// tic precipfloortic-1 (see CalculatePrecipFloor). 0 if it isn't known.
+	fixed_t precipfloor;
+	tic_t precipfloortic;
+
 	// per-sector colormaps!
 	extracolormap_t *extra_colormap;
 
@@ -372,10 +381,6 @@ typedef struct sector_s
 	// Current speed of ceiling/floor. For Knuckles to hold onto stuff.
 	fixed_t floorspeed, ceilspeed;
 
-	// list of precipitation mobjs in sector
-	precipmobj_t *preciplist;
-	struct mprecipsecnode_s *touching_preciplist;
-
 #ifdef ESLOPE
 	// Eternity engine slope
 	pslope_t *f_slope; // floor slope
@@ -393,6 +398,8 @@ typedef struct sector_s
 	// flag angles sector spawned with (via linedef type 7)
 	angle_t spawn_flrpic_angle;
 	angle_t spawn_ceilpic_angle;
+
+	INT32 luaref; // registry reference to its Lua userdata, 0 if none (see LUA_PushUserdata)
 } sector_t;
 
 //
@@ -443,6 +450,10 @@ typedef struct line_s
 
 	char *text; // a concatination of all front and back texture names, for linedef specials that require a string.
 	INT16 callcount; // no. of calls left before triggering, for the "X calls" linedef specials, defaults to 0
+
+	INT32 luaref; // registry reference to its Lua userdata, 0 if none
+	void *luaexechooks; // the LinedefExecute hooks for text, looked up by Lua
+	UINT32 luaexecstamp; // when luaexechooks was looked up, 0 for never
 } line_t;
 
 //
@@ -468,6 +479,8 @@ typedef struct
 	INT16 repeatcnt; // # of times to repeat midtexture
 
 	char *text; // a concatination of all top, bottom, and mid texture names, for linedef specials that require a string.
+
+	INT32 luaref; // registry reference to its Lua userdata, 0 if none
 } side_t;
 
 //
@@ -515,17 +528,6 @@ typedef struct msecnode_s
 	boolean visited; // used in search algorithms
 } msecnode_t;
 
-typedef struct mprecipsecnode_s
-{
-	sector_t *m_sector; // a sector containing this object
-	struct precipmobj_s *m_thing;  // this object
-	struct mprecipsecnode_s *m_sectorlist_prev;  // prev msecnode_t for this thing
-	struct mprecipsecnode_s *m_sectorlist_next;  // next msecnode_t for this thing
-	struct mprecipsecnode_s *m_thinglist_prev;  // prev msecnode_t for this sector
-	struct mprecipsecnode_s *m_thinglist_next;  // next msecnode_t for this sector
-	boolean visited; // used in search algorithms
-} mprecipsecnode_t;
-
 // for now, only used in hardware mode
 // maybe later for software as well?
 // that's why it's moved here
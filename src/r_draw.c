@@ -21,7 +21,9 @@
 #include "st_stuff.h" // need ST_HEIGHT
 #include "i_video.h"
 #include "v_video.h"
+#include "m_argv.h"
 #include "m_misc.h"
+#include "m_cpu.h"
 #include "w_wad.h"
 #include "z_zone.h"
 #include "console.h" // Until buffering gets finished
@@ -30,6 +32,21 @@
 #include "hardware/hw_main.h"
 #endif
 
+// Vector span kernels, see R_SetupSpanKernels
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPANSSE2
+#define SPANSSE2_TARGET
+#include <emmintrin.h>
+#elif defined (__GNUC__) && defined (__i386__) && !defined (__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SPANSSE2
+#define SPANSSE2_TARGET __attribute__((target("sse2")))
+#include <emmintrin.h>
+#endif
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define SPANNEON
+#include <arm_neon.h>
+#endif
+
 // ==========================================================================
 //                     COMMON DATA FOR 8bpp AND 16bpp
 // ==========================================================================
@@ -40,7 +57,7 @@ INT32 viewwidth, scaledviewwidth, viewheight, viewwindowx, viewwindowy;
 
 /**	\brief pointer to the start of each line of the screen,
 */
-UINT8 *ylookup[MAXVIDHEIGHT*4];
+RENDERLOCAL UINT8 *ylookup[MAXVIDHEIGHT*4];
 
 /**	\brief pointer to the start of each line of the screen, for view1 (splitscreen)
 */
@@ -55,30 +72,30 @@ UINT8 *ylookup2[MAXVIDHEIGHT*4];
 */
 INT32 columnofs[MAXVIDWIDTH*4];
 
-UINT8 *topleft;
+RENDERLOCAL UINT8 *topleft;
 
 // =========================================================================
 //                      COLUMN DRAWING CODE STUFF
 // =========================================================================
 
-lighttable_t *dc_colormap;
-INT32 dc_x = 0, dc_yl = 0, dc_yh = 0;
+RENDERLOCAL lighttable_t *dc_colormap;
+RENDERLOCAL INT32 dc_x = 0, dc_yl = 0, dc_yh = 0;
 
-fixed_t dc_iscale, dc_texturemid;
-UINT8 dc_hires; // under MSVC boolean is a byte, while on other systems, it a bit,
+RENDERLOCAL fixed_t dc_iscale, dc_texturemid;
+RENDERLOCAL UINT8 dc_hires; // under MSVC boolean is a byte, while on other systems, it a bit,
                // soo lets make it a byte on all system for the ASM code
-UINT8 *dc_source;
+RENDERLOCAL UINT8 *dc_source;
 
 // -----------------------
 // translucency stuff here
 // -----------------------
 #define NUMTRANSTABLES 9 // how many translucency tables are used
 
-UINT8 *transtables; // translucency tables
+static UINT8 *transtables[NUMTRANSTABLES]; // loaded when first used
 
 /**	\brief R_DrawTransColumn uses this
 */
-UINT8 *dc_transmap; // one of the translucency tables
+RENDERLOCAL UINT8 *dc_transmap; // one of the translucency tables
 
 // ----------------------
 // translation stuff here
@@ -87,32 +104,34 @@ UINT8 *dc_transmap; // one of the translucency tables
 
 /**	\brief R_DrawTranslatedColumn uses this
 */
-UINT8 *dc_translation;
+RENDERLOCAL UINT8 *dc_translation;
 
-struct r_lightlist_s *dc_lightlist = NULL;
-INT32 dc_numlights = 0, dc_maxlights, dc_texheight;
+RENDERLOCAL struct r_lightlist_s *dc_lightlist = NULL;
+RENDERLOCAL INT32 dc_numlights = 0, dc_texheight;
+INT32 dc_maxlights;
 
 // =========================================================================
 //                      SPAN DRAWING CODE STUFF
 // =========================================================================
 
-INT32 ds_y, ds_x1, ds_x2;
-lighttable_t *ds_colormap;
-fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
+RENDERLOCAL INT32 ds_y, ds_x1, ds_x2;
+RENDERLOCAL lighttable_t *ds_colormap;
+RENDERLOCAL fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
 
-UINT8 *ds_source; // start of a 64*64 tile image
-UINT8 *ds_transmap; // one of the translucency tables
+RENDERLOCAL UINT8 *ds_source; // start of a 64*64 tile image
+RENDERLOCAL UINT8 *ds_transmap; // one of the translucency tables
 
 #ifdef ESLOPE
-pslope_t *ds_slope; // Current slope being used
-floatv3_t ds_su, ds_sv, ds_sz; // Vectors for... stuff?
-float focallengthf, zeroheight;
+RENDERLOCAL pslope_t *ds_slope; // Current slope being used
+RENDERLOCAL floatv3_t ds_su, ds_sv, ds_sz; // Vectors for... stuff?
+float focallengthf;
+RENDERLOCAL float zeroheight;
 #endif
 
 /**	\brief Variable flat sizes
 */
 
-UINT32 nflatxshift, nflatyshift, nflatshiftup, nflatmask;
+RENDERLOCAL UINT32 nflatxshift, nflatyshift, nflatshiftup, nflatmask;
 
 // ==========================================================================
 //                        OLD DOOM FUZZY EFFECT
@@ -130,7 +149,11 @@ UINT32 nflatxshift, nflatyshift, nflatshiftup, nflatmask;
 #define DEFAULT_STARTTRANSCOLOR 160
 #define NUM_PALETTE_ENTRIES 256
 
-static UINT8** translationtablecache[MAXSKINS + 4] = {NULL};
+// Every color's translation for each skin and each of the special cases,
+// made as soon as the skin is added. A row's tables never move, so the
+// pointers handed out stay good, and OpenGL's mipmaps for them too.
+#define NUMTRANSLATIONROWS (MAXSKINS + 4)
+static UINT8 *translationrows[NUMTRANSLATIONROWS] = {NULL}; // MAXTRANSLATIONS tables each
 
 
 // See also the enum skincolors_t
@@ -203,26 +226,70 @@ CV_PossibleValue_t Color_cons_t[MAXSKINCOLORS+1];
 */
 void R_InitTranslationTables(void)
 {
+	// The translucency tables are only loaded once something draws with
+	// them, which OpenGL and dedicated servers mostly never do.
+	memset(transtables, 0, sizeof (transtables));
+
+	R_BuildSkinTranslations(TC_DEFAULT);
+	R_BuildSkinTranslations(TC_BOSS);
+	R_BuildSkinTranslations(TC_METALSONIC);
+	R_BuildSkinTranslations(TC_ALLWHITE);
+}
+
+/**	\brief	Makes a translucency table from the palette, for a missing TRANS lump.
+
+	\param	table	where the table goes
+	\param	alphalevel	how translucent, tr_trans10 to tr_trans90
+*/
+static void R_GenerateTranslucencyTable(UINT8 *table, INT32 alphalevel)
+{
+	INT32 fg, bg;
+
+	R_UpdateColorCube();
+	for (fg = 0; fg < 256; fg++)
+		for (bg = 0; bg < 256; bg++)
+		{
+			const RGBA_t f = pLocalPalette[fg], b = pLocalPalette[bg];
+
+			*table++ = R_NearestPaletteColor(
+				(UINT8)((f.s.red*(10 - alphalevel) + b.s.red*alphalevel)/10),
+				(UINT8)((f.s.green*(10 - alphalevel) + b.s.green*alphalevel)/10),
+				(UINT8)((f.s.blue*(10 - alphalevel) + b.s.blue*alphalevel)/10));
+		}
+}
+
+UINT8 *R_GetTranslucencyTable(INT32 alphalevel)
+{
+	UINT8 **table;
+
+	if (alphalevel < tr_trans10)
+		alphalevel = tr_trans10;
+	else if (alphalevel > NUMTRANSTABLES)
+		alphalevel = NUMTRANSTABLES;
+
+	table = &transtables[alphalevel - 1];
+	if (!*table)
+	{
 #ifdef _NDS
-	// Ugly temporary NDS hack.
-	transtables = (UINT8*)0x2000000;
+		// Ugly temporary NDS hack.
+		*table = (UINT8 *)0x2000000 + ((alphalevel - 1) << FF_TRANSSHIFT);
 #else
-	// Load here the transparency lookup tables 'TINTTAB'
-	// NOTE: the TINTTAB resource MUST BE aligned on 64k for the asm
-	// optimised code (in other words, transtables pointer low word is 0)
-	transtables = Z_MallocAlign(NUMTRANSTABLES*0x10000, PU_STATIC,
-		NULL, 16);
-
-	W_ReadLump(W_GetNumForName("TRANS10"), transtables);
-	W_ReadLump(W_GetNumForName("TRANS20"), transtables+0x10000);
-	W_ReadLump(W_GetNumForName("TRANS30"), transtables+0x20000);
-	W_ReadLump(W_GetNumForName("TRANS40"), transtables+0x30000);
-	W_ReadLump(W_GetNumForName("TRANS50"), transtables+0x40000);
-	W_ReadLump(W_GetNumForName("TRANS60"), transtables+0x50000);
-	W_ReadLump(W_GetNumForName("TRANS70"), transtables+0x60000);
-	W_ReadLump(W_GetNumForName("TRANS80"), transtables+0x70000);
-	W_ReadLump(W_GetNumForName("TRANS90"), transtables+0x80000);
+		const lumpnum_t lump = W_CheckNumForName(va("TRANS%d0", alphalevel));
+
+		// NOTE: the TINTTAB resource MUST BE aligned on 64k for the asm
+		// optimised code (in other words, the table pointer's low word is 0)
+		*table = Z_MallocAlign(0x10000, PU_STATIC, NULL, 16);
+
+		if (lump != LUMPERROR && W_LumpLength(lump) >= 0x10000)
+			W_ReadLumpHeader(lump, *table, 0x10000, 0);
+		else
+		{
+			CONS_Alert(CONS_WARNING, "TRANS%d0 is missing, making it from the palette\n", alphalevel);
+			R_GenerateTranslucencyTable(*table, alphalevel);
+		}
 #endif
+	}
+	return *table;
 }
 
 
@@ -498,6 +565,28 @@ static void R_GenerateTranslationColormap(UINT8 *dest_colormap, INT32 skinnum, U
 }
 
 
+static INT32 R_TranslationRow(INT32 skinnum)
+{
+	// Adjust if we want the default colormap
+	if (skinnum == TC_DEFAULT) return DEFAULT_TT_CACHE_INDEX;
+	else if (skinnum == TC_BOSS) return BOSS_TT_CACHE_INDEX;
+	else if (skinnum == TC_METALSONIC) return METALSONIC_TT_CACHE_INDEX;
+	else if (skinnum == TC_ALLWHITE) return ALLWHITE_TT_CACHE_INDEX;
+	return skinnum;
+}
+
+void R_BuildSkinTranslations(INT32 skinnum)
+{
+	const INT32 row = R_TranslationRow(skinnum);
+	INT32 color;
+
+	if (!translationrows[row])
+		translationrows[row] = Z_MallocAlign(MAXTRANSLATIONS * NUM_PALETTE_ENTRIES, PU_STATIC, NULL, 8);
+
+	for (color = 0; color < MAXTRANSLATIONS; color++)
+		R_GenerateTranslationColormap(translationrows[row] + color*NUM_PALETTE_ENTRIES, skinnum, (UINT8)color);
+}
+
 /**	\brief	Retrieves a translation colormap from the cache.
 
 	\param	skinnum	number of skin, TC_DEFAULT or TC_BOSS
@@ -509,46 +598,25 @@ static void R_GenerateTranslationColormap(UINT8 *dest_colormap, INT32 skinnum, U
 UINT8* R_GetTranslationColormap(INT32 skinnum, skincolors_t color, UINT8 flags)
 {
 	UINT8* ret;
-	INT32 skintableindex;
-
-	// Adjust if we want the default colormap
-	if (skinnum == TC_DEFAULT) skintableindex = DEFAULT_TT_CACHE_INDEX;
-	else if (skinnum == TC_BOSS) skintableindex = BOSS_TT_CACHE_INDEX;
-	else if (skinnum == TC_METALSONIC) skintableindex = METALSONIC_TT_CACHE_INDEX;
-	else if (skinnum == TC_ALLWHITE) skintableindex = ALLWHITE_TT_CACHE_INDEX;
-	else skintableindex = skinnum;
 
 	if (flags & GTC_CACHE)
 	{
+		const INT32 row = R_TranslationRow(skinnum);
 
-		// Allocate table for skin if necessary
-		if (!translationtablecache[skintableindex])
-			translationtablecache[skintableindex] = Z_Calloc(MAXTRANSLATIONS * sizeof(UINT8**), PU_STATIC, NULL);
-
-		// Get colormap
-		ret = translationtablecache[skintableindex][color];
-	}
-	else ret = NULL;
-
-	// Generate the colormap if necessary
-	if (!ret)
-	{
-		ret = Z_MallocAlign(NUM_PALETTE_ENTRIES, (flags & GTC_CACHE) ? PU_LEVEL : PU_STATIC, NULL, 8);
-		R_GenerateTranslationColormap(ret, skinnum, color);
-
-		// Cache the colormap if desired
-		if (flags & GTC_CACHE)
-			translationtablecache[skintableindex][color] = ret;
+		if (!translationrows[row])
+			R_BuildSkinTranslations(skinnum);
+		return translationrows[row] + color*NUM_PALETTE_ENTRIES;
 	}
 
+	// A copy of its own, for the caller to keep
+	ret = Z_MallocAlign(NUM_PALETTE_ENTRIES, PU_STATIC, NULL, 8);
+	R_GenerateTranslationColormap(ret, skinnum, color);
 	return ret;
 }
 
-/**	\brief	Flushes cache of translation colormaps.
+/**	\brief	Makes every translation colormap again.
 
-	Flushes cache of translation colormaps, but doesn't actually free the
-	colormaps themselves. These are freed when PU_LEVEL blocks are purged,
-	at or before which point, this function should be called.
+	They're made again in place, so nothing pointing at them goes stale.
 
 	\return	void
 */
@@ -556,9 +624,13 @@ void R_FlushTranslationColormapCache(void)
 {
 	INT32 i;
 
-	for (i = 0; i < (INT32)(sizeof(translationtablecache) / sizeof(translationtablecache[0])); i++)
-		if (translationtablecache[i])
-			memset(translationtablecache[i], 0, MAXTRANSLATIONS * sizeof(UINT8**));
+	for (i = 0; i < MAXSKINS; i++)
+		if (translationrows[i])
+			R_BuildSkinTranslations(i);
+	R_BuildSkinTranslations(TC_DEFAULT);
+	R_BuildSkinTranslations(TC_BOSS);
+	R_BuildSkinTranslations(TC_METALSONIC);
+	R_BuildSkinTranslations(TC_ALLWHITE);
 }
 
 UINT8 R_GetColorByName(const char *name)
@@ -19,62 +19,73 @@
 // -------------------------------
 // COMMON STUFF FOR 8bpp AND 16bpp
 // -------------------------------
-extern UINT8 *ylookup[MAXVIDHEIGHT*4];
+extern RENDERLOCAL UINT8 *ylookup[MAXVIDHEIGHT*4];
 extern UINT8 *ylookup1[MAXVIDHEIGHT*4];
 extern UINT8 *ylookup2[MAXVIDHEIGHT*4];
 extern INT32 columnofs[MAXVIDWIDTH*4];
-extern UINT8 *topleft;
+extern RENDERLOCAL UINT8 *topleft;
 
 // -------------------------
 // COLUMN DRAWING CODE STUFF
 // -------------------------
 
-extern lighttable_t *dc_colormap;
-extern INT32 dc_x, dc_yl, dc_yh;
-extern fixed_t dc_iscale, dc_texturemid;
-extern UINT8 dc_hires;
+extern RENDERLOCAL lighttable_t *dc_colormap;
+extern RENDERLOCAL INT32 dc_x, dc_yl, dc_yh;
+extern RENDERLOCAL fixed_t dc_iscale, dc_texturemid;
+extern RENDERLOCAL UINT8 dc_hires;
 
-extern UINT8 *dc_source; // first pixel in a column
+extern RENDERLOCAL UINT8 *dc_source; // first pixel in a column
 
 // translucency stuff here
-extern UINT8 *transtables; // translucency tables, should be (*transtables)[5][256][256]
-extern UINT8 *dc_transmap;
+extern RENDERLOCAL UINT8 *dc_transmap;
 
 // translation stuff here
 
-extern UINT8 *dc_translation;
+extern RENDERLOCAL UINT8 *dc_translation;
 
-extern struct r_lightlist_s *dc_lightlist;
-extern INT32 dc_numlights, dc_maxlights;
+extern RENDERLOCAL struct r_lightlist_s *dc_lightlist;
+extern RENDERLOCAL INT32 dc_numlights;
+extern INT32 dc_maxlights;
 
 //Fix TUTIFRUTI
-extern INT32 dc_texheight;
+extern RENDERLOCAL INT32 dc_texheight;
+
+// One column for R_DrawWallColumns4_8, with what the dc_ globals would hold
+typedef struct
+{
+	UINT8 *source;
+	lighttable_t *colormap;
+	fixed_t iscale, texturemid;
+	INT32 yl, yh;
+	INT32 texheight;
+} wallcolumn_t;
 
 // -----------------------
 // SPAN DRAWING CODE STUFF
 // -----------------------
 
-extern INT32 ds_y, ds_x1, ds_x2;
-extern lighttable_t *ds_colormap;
-extern fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
-extern UINT8 *ds_source; // start of a 64*64 tile image
-extern UINT8 *ds_transmap;
+extern RENDERLOCAL INT32 ds_y, ds_x1, ds_x2;
+extern RENDERLOCAL lighttable_t *ds_colormap;
+extern RENDERLOCAL fixed_t ds_xfrac, ds_yfrac, ds_xstep, ds_ystep;
+extern RENDERLOCAL UINT8 *ds_source; // start of a 64*64 tile image
+extern RENDERLOCAL UINT8 *ds_transmap;
 
 #ifdef ESLOPE
 typedef struct {
 	float x, y, z;
 } floatv3_t;
 
-extern pslope_t *ds_slope; // Current slope being used
-extern floatv3_t ds_su, ds_sv, ds_sz; // Vectors for... stuff?
-extern float focallengthf, zeroheight;
+extern RENDERLOCAL pslope_t *ds_slope; // Current slope being used
+extern RENDERLOCAL floatv3_t ds_su, ds_sv, ds_sz; // Vectors for... stuff?
+extern float focallengthf;
+extern RENDERLOCAL float zeroheight;
 #endif
 
 // Variable flat sizes
-extern UINT32 nflatxshift;
-extern UINT32 nflatyshift;
-extern UINT32 nflatshiftup;
-extern UINT32 nflatmask;
+extern RENDERLOCAL UINT32 nflatxshift;
+extern RENDERLOCAL UINT32 nflatyshift;
+extern RENDERLOCAL UINT32 nflatshiftup;
+extern RENDERLOCAL UINT32 nflatmask;
 
 /// \brief Top border
 #define BRDR_T 0
@@ -108,8 +119,22 @@ extern lumpnum_t viewborderlump[8];
 
 // Initialize color translation tables, for player rendering etc.
 void R_InitTranslationTables(void);
+
+/**	\brief	Gets a translucency table, loading it the first time. Main thread only.
+
+	\param	alphalevel	how translucent, tr_trans10 to tr_trans90
+
+	\return	the 256x256 table, indexed by (source << 8) + background
+*/
+UINT8 *R_GetTranslucencyTable(INT32 alphalevel);
 UINT8* R_GetTranslationColormap(INT32 skinnum, skincolors_t color, UINT8 flags);
 void R_FlushTranslationColormapCache(void);
+
+/**	\brief	Makes every color's translation for a skin, ahead of its first use.
+
+	\param	skinnum	the skin, or TC_DEFAULT, TC_BOSS, TC_METALSONIC or TC_ALLWHITE
+*/
+void R_BuildSkinTranslations(INT32 skinnum);
 UINT8 R_GetColorByName(const char *name);
 
 // Custom player skin translation
@@ -131,6 +156,7 @@ void R_DrawViewBorder(void);
 
 void R_DrawColumn_8(void);
 #define R_DrawWallColumn_8	R_DrawColumn_8
+void R_DrawWallColumns4_8(INT32 x, const wallcolumn_t *cols);
 void R_DrawShadeColumn_8(void);
 void R_DrawTranslucentColumn_8(void);
 
@@ -151,6 +177,8 @@ void ASMCALL R_DrawSpan_8_MMX(void);
 void R_DrawTranslatedColumn_8(void);
 void R_DrawTranslatedTranslucentColumn_8(void);
 void R_DrawSpan_8(void);
+void R_DrawTiledSpan_8(void);
+void R_SetupSpanKernels(void);
 #ifdef ESLOPE
 void R_CalcTiltedLighting(fixed_t start, fixed_t end);
 void R_DrawTiltedSpan_8(void);
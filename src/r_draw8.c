@@ -105,6 +105,95 @@ void R_DrawColumn_8(void)
 	}
 }
 
+// Draws rows y1 to y2 of a column of R_DrawWallColumns4_8, from frac on.
+static void R_DrawWallRows_8(const wallcolumn_t *col, INT32 x, INT32 y1, INT32 y2, fixed_t *frac)
+{
+	UINT8 *dest = &topleft[y1*vid.width + x];
+	const INT32 heightmask = col->texheight - 1;
+	fixed_t f = *frac;
+
+	for (; y1 <= y2; y1++)
+	{
+		*dest = col->colormap[col->source[(f>>FRACBITS) & heightmask]];
+		dest += vid.width;
+		f += col->iscale;
+	}
+	*frac = f;
+}
+
+/**	rief The R_DrawWallColumns4_8 function
+	Draws the wall columns x to x+3 together, the way Build does: the
+	rows all four share are written four pixels at a time, the ends that
+	stick out above or below one column at a time. The output matches
+	four calls to R_DrawColumn_8. Every texheight must be a power of 2.
+*/
+void R_DrawWallColumns4_8(INT32 x, const wallcolumn_t *cols)
+{
+	fixed_t frac[4];
+	INT32 top = cols[0].yl, bottom = cols[0].yh;
+	INT32 i;
+
+#ifdef RANGECHECK
+	if (x < 0 || x + 3 >= vid.width)
+		return;
+#endif
+
+	for (i = 0; i < 4; i++)
+	{
+#ifdef RANGECHECK
+		if (cols[i].yl < 0 || cols[i].yh >= vid.height)
+			return;
+#endif
+		frac[i] = cols[i].texturemid + FixedMul((cols[i].yl << FRACBITS) - centeryfrac, cols[i].iscale);
+		if (cols[i].yl > top)
+			top = cols[i].yl;
+		if (cols[i].yh < bottom)
+			bottom = cols[i].yh;
+	}
+	if (bottom < top) // nothing shared
+		bottom = top - 1;
+
+	for (i = 0; i < 4; i++)
+		R_DrawWallRows_8(&cols[i], x + i, cols[i].yl, min(cols[i].yh, top - 1), &frac[i]);
+
+	if (bottom >= top)
+	{
+		const UINT8 *s0 = cols[0].source, *s1 = cols[1].source, *s2 = cols[2].source, *s3 = cols[3].source;
+		const lighttable_t *c0 = cols[0].colormap, *c1 = cols[1].colormap, *c2 = cols[2].colormap, *c3 = cols[3].colormap;
+		const INT32 m0 = cols[0].texheight - 1, m1 = cols[1].texheight - 1, m2 = cols[2].texheight - 1, m3 = cols[3].texheight - 1;
+		const fixed_t i0 = cols[0].iscale, i1 = cols[1].iscale, i2 = cols[2].iscale, i3 = cols[3].iscale;
+		fixed_t f0 = frac[0], f1 = frac[1], f2 = frac[2], f3 = frac[3];
+		UINT8 *dest = &topleft[top*vid.width + x];
+		INT32 count = bottom - top + 1;
+		UINT32 quad;
+
+		do
+		{
+#ifdef SRB2_BIG_ENDIAN
+			quad = (UINT32)c0[s0[(f0>>FRACBITS) & m0]]<<24 | (UINT32)c1[s1[(f1>>FRACBITS) & m1]]<<16
+				| (UINT32)c2[s2[(f2>>FRACBITS) & m2]]<<8 | c3[s3[(f3>>FRACBITS) & m3]];
+#else
+			quad = c0[s0[(f0>>FRACBITS) & m0]] | (UINT32)c1[s1[(f1>>FRACBITS) & m1]]<<8
+				| (UINT32)c2[s2[(f2>>FRACBITS) & m2]]<<16 | (UINT32)c3[s3[(f3>>FRACBITS) & m3]]<<24;
+#endif
+			memcpy(dest, &quad, sizeof (quad)); // one store, aligned or not
+			dest += vid.width;
+			f0 += i0;
+			f1 += i1;
+			f2 += i2;
+			f3 += i3;
+		} while (--count);
+
+		frac[0] = f0;
+		frac[1] = f1;
+		frac[2] = f2;
+		frac[3] = f3;
+	}
+
+	for (i = 0; i < 4; i++)
+		R_DrawWallRows_8(&cols[i], x + i, max(cols[i].yl, bottom + 1), cols[i].yh, &frac[i]);
+}
+
 #define TRANSPARENTPIXEL 247
 
 void R_Draw2sMultiPatchColumn_8(void)
@@ -538,402 +627,629 @@ void R_DrawTranslatedColumn_8(void)
 // SPANS
 // ==========================================================================
 
-/**	\brief The R_DrawSpan_8 function
-	Draws the actual span.
+/**	\brief A run of span pixels for the span kernels
+	count is a multiple of 8. The kernel draws it and leaves dest and the
+	positions just past the run, so the caller can draw what is left.
 */
-void R_DrawSpan_8 (void)
+typedef struct
 {
-	UINT32 xposition;
-	UINT32 yposition;
-	UINT32 xstep, ystep;
-
-	UINT8 *source;
-	UINT8 *colormap;
 	UINT8 *dest;
-	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
-
+	const UINT8 *source;
+	const UINT8 *colormap;
+	const UINT8 *transmap;
+	UINT32 xposition, yposition;
+	UINT32 xstep, ystep;
+	UINT32 xshift, yshift, mask;
 	size_t count;
+} spanrun_t;
 
-	// SoM: we only need 6 bits for the integer part (0 thru 63) so the rest
-	// can be used for the fraction part. This allows calculation of the memory address in the
-	// texture with two shifts, an OR and one AND. (see below)
-	// for texture sizes > 64 the amount of precision we can allow will decrease, but only by one
-	// bit per power of two (obviously)
-	// Ok, because I was able to eliminate the variable spot below, this function is now FASTER
-	// than the original span renderer. Whodathunkit?
-	xposition = ds_xfrac << nflatshiftup; yposition = ds_yfrac << nflatshiftup;
-	xstep = ds_xstep << nflatshiftup; ystep = ds_ystep << nflatshiftup;
-
-	source = ds_source;
-	colormap = ds_colormap;
-	dest = ylookup[ds_y] + columnofs[ds_x1];
-	count = ds_x2 - ds_x1 + 1;
-
-	if (dest+8 > deststop)
-		return;
+static void R_SpanRun_8_C(spanrun_t *run)
+{
+	UINT32 xposition = run->xposition, yposition = run->yposition;
+	const UINT32 xstep = run->xstep, ystep = run->ystep;
+	const UINT32 xshift = run->xshift, yshift = run->yshift, mask = run->mask;
+	const UINT8 *source = run->source;
+	const UINT8 *colormap = run->colormap;
+	UINT8 *dest = run->dest;
+	size_t count = run->count;
 
 	while (count >= 8)
 	{
 		// SoM: Why didn't I see this earlier? the spot variable is a waste now because we don't
 		// have the uber complicated math to calculate it now, so that was a memory write we didn't
 		// need!
-		dest[0] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[0] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[1] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[1] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[2] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[2] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[3] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[3] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[4] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[4] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[5] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[5] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[6] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[6] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
-		dest[7] = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[7] = colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]];
 		xposition += xstep;
 		yposition += ystep;
 
 		dest += 8;
 		count -= 8;
 	}
-	while (count-- && dest <= deststop)
+
+	run->dest = dest;
+	run->xposition = xposition;
+	run->yposition = yposition;
+}
+
+static void R_TranslucentSpanRun_8_C(spanrun_t *run)
+{
+	UINT32 xposition = run->xposition, yposition = run->yposition;
+	const UINT32 xstep = run->xstep, ystep = run->ystep;
+	const UINT32 xshift = run->xshift, yshift = run->yshift, mask = run->mask;
+	const UINT8 *source = run->source;
+	const UINT8 *colormap = run->colormap;
+	const UINT8 *transmap = run->transmap;
+	UINT8 *dest = run->dest;
+	size_t count = run->count;
+
+	while (count >= 8)
 	{
-		*dest++ = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		dest[0] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[0]);
 		xposition += xstep;
 		yposition += ystep;
-	}
-}
 
-#ifdef ESLOPE
-// R_CalcTiltedLighting
-// Exactly what it says on the tin. I wish I wasn't too lazy to explain things properly.
-static INT32 tiltlighting[MAXVIDWIDTH];
-void R_CalcTiltedLighting(fixed_t start, fixed_t end)
-{
-	// ZDoom uses a different lighting setup to us, and I couldn't figure out how to adapt their version
-	// of this function. Here's my own.
-	INT32 left = ds_x1, right = ds_x2;
-	fixed_t step = (end-start)/(ds_x2-ds_x1+1);
-	INT32 i;
+		dest[1] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[1]);
+		xposition += xstep;
+		yposition += ystep;
 
-	// I wanna do some optimizing by checking for out-of-range segments on either side to fill in all at once,
-	// but I'm too bad at coding to not crash the game trying to do that. I guess this is fast enough for now...
+		dest[2] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[2]);
+		xposition += xstep;
+		yposition += ystep;
 
-	for (i = left; i <= right; i++) {
-		tiltlighting[i] = (start += step) >> FRACBITS;
-		if (tiltlighting[i] < 0)
-			tiltlighting[i] = 0;
-		else if (tiltlighting[i] >= MAXLIGHTSCALE)
-			tiltlighting[i] = MAXLIGHTSCALE-1;
+		dest[3] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[3]);
+		xposition += xstep;
+		yposition += ystep;
+
+		dest[4] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[4]);
+		xposition += xstep;
+		yposition += ystep;
+
+		dest[5] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[5]);
+		xposition += xstep;
+		yposition += ystep;
+
+		dest[6] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[6]);
+		xposition += xstep;
+		yposition += ystep;
+
+		dest[7] = *(transmap + (colormap[source[((yposition >> yshift) & mask) | (xposition >> xshift)]] << 8) + dest[7]);
+		xposition += xstep;
+		yposition += ystep;
+
+		dest += 8;
+		count -= 8;
 	}
-}
 
+	run->dest = dest;
+	run->xposition = xposition;
+	run->yposition = yposition;
+}
 
-/**	\brief The R_DrawTiltedSpan_8 function
-	Draw slopes! Holy sheit!
-*/
-void R_DrawTiltedSpan_8(void)
+#ifdef SPANSSE2
+// The texel offsets for eight pixels are worked out in two vectors of four,
+// then the texture and colormap lookups are done one at a time.
+#define SSE2SPANSETUP \
+	UINT32 ofs[8]; \
+	const UINT32 xstep = run->xstep, ystep = run->ystep; \
+	const __m128i xshift = _mm_cvtsi32_si128((int)run->xshift); \
+	const __m128i yshift = _mm_cvtsi32_si128((int)run->yshift); \
+	const __m128i mask = _mm_set1_epi32((int)run->mask); \
+	const __m128i xstep8 = _mm_set1_epi32((int)(xstep*8)); \
+	const __m128i ystep8 = _mm_set1_epi32((int)(ystep*8)); \
+	__m128i xlo = _mm_set_epi32((int)(run->xposition + xstep*3), (int)(run->xposition + xstep*2), (int)(run->xposition + xstep), (int)run->xposition); \
+	__m128i ylo = _mm_set_epi32((int)(run->yposition + ystep*3), (int)(run->yposition + ystep*2), (int)(run->yposition + ystep), (int)run->yposition); \
+	__m128i xhi = _mm_add_epi32(xlo, _mm_set1_epi32((int)(xstep*4))); \
+	__m128i yhi = _mm_add_epi32(ylo, _mm_set1_epi32((int)(ystep*4))); \
+	const UINT8 *source = run->source; \
+	const UINT8 *colormap = run->colormap; \
+	UINT8 *dest = run->dest; \
+	size_t count = run->count
+
+#define SSE2SPANOFFSETS \
+	_mm_storeu_si128((__m128i *)&ofs[0], _mm_or_si128(_mm_and_si128(_mm_srl_epi32(ylo, yshift), mask), _mm_srl_epi32(xlo, xshift))); \
+	_mm_storeu_si128((__m128i *)&ofs[4], _mm_or_si128(_mm_and_si128(_mm_srl_epi32(yhi, yshift), mask), _mm_srl_epi32(xhi, xshift))); \
+	xlo = _mm_add_epi32(xlo, xstep8); \
+	ylo = _mm_add_epi32(ylo, ystep8); \
+	xhi = _mm_add_epi32(xhi, xstep8); \
+	yhi = _mm_add_epi32(yhi, ystep8)
+
+#define SSE2SPANFINISH \
+	run->xposition += xstep*(UINT32)run->count; \
+	run->yposition += ystep*(UINT32)run->count; \
+	run->dest = dest
+
+static SPANSSE2_TARGET void R_SpanRun_8_SSE2(spanrun_t *run)
 {
-	// x1, x2 = ds_x1, ds_x2
-	int width = ds_x2 - ds_x1;
-	double iz, uz, vz;
-	UINT32 u, v;
-	int i;
+	SSE2SPANSETUP;
 
-	UINT8 *source;
-	UINT8 *colormap;
-	UINT8 *dest;
+	for (; count >= 8; count -= 8, dest += 8)
+	{
+		SSE2SPANOFFSETS;
+		dest[0] = colormap[source[ofs[0]]];
+		dest[1] = colormap[source[ofs[1]]];
+		dest[2] = colormap[source[ofs[2]]];
+		dest[3] = colormap[source[ofs[3]]];
+		dest[4] = colormap[source[ofs[4]]];
+		dest[5] = colormap[source[ofs[5]]];
+		dest[6] = colormap[source[ofs[6]]];
+		dest[7] = colormap[source[ofs[7]]];
+	}
 
-	double startz, startu, startv;
-	double izstep, uzstep, vzstep;
-	double endz, endu, endv;
-	UINT32 stepu, stepv;
+	SSE2SPANFINISH;
+}
 
-	iz = ds_sz.z + ds_sz.y*(centery-ds_y) + ds_sz.x*(ds_x1-centerx);
+static SPANSSE2_TARGET void R_TranslucentSpanRun_8_SSE2(spanrun_t *run)
+{
+	const UINT8 *transmap = run->transmap;
+	SSE2SPANSETUP;
 
-	// Lighting is simple. It's just linear interpolation from start to end
+	for (; count >= 8; count -= 8, dest += 8)
 	{
-		float planelightfloat = BASEVIDWIDTH*BASEVIDWIDTH/vid.width / (zeroheight - FIXED_TO_FLOAT(viewz)) / 21.0f;
-		float lightstart, lightend;
+		SSE2SPANOFFSETS;
+		dest[0] = transmap[(colormap[source[ofs[0]]] << 8) + dest[0]];
+		dest[1] = transmap[(colormap[source[ofs[1]]] << 8) + dest[1]];
+		dest[2] = transmap[(colormap[source[ofs[2]]] << 8) + dest[2]];
+		dest[3] = transmap[(colormap[source[ofs[3]]] << 8) + dest[3]];
+		dest[4] = transmap[(colormap[source[ofs[4]]] << 8) + dest[4]];
+		dest[5] = transmap[(colormap[source[ofs[5]]] << 8) + dest[5]];
+		dest[6] = transmap[(colormap[source[ofs[6]]] << 8) + dest[6]];
+		dest[7] = transmap[(colormap[source[ofs[7]]] << 8) + dest[7]];
+	}
 
-		lightend = (iz + ds_sz.x*width) * planelightfloat;
-		lightstart = iz * planelightfloat;
+	SSE2SPANFINISH;
+}
 
-		R_CalcTiltedLighting(FLOAT_TO_FIXED(lightstart), FLOAT_TO_FIXED(lightend));
-		//CONS_Printf("tilted lighting %f to %f (foc %f)\n", lightstart, lightend, focallengthf);
+#undef SSE2SPANSETUP
+#undef SSE2SPANOFFSETS
+#undef SSE2SPANFINISH
+#endif // SPANSSE2
+
+#ifdef SPANNEON
+// Same as the SSE2 kernels. NEON shifts right by shifting left by a negative count.
+#define NEONSPANSETUP \
+	UINT32 ofs[8]; \
+	const UINT32 xstep = run->xstep, ystep = run->ystep; \
+	const int32x4_t xshift = vdupq_n_s32(-(INT32)run->xshift); \
+	const int32x4_t yshift = vdupq_n_s32(-(INT32)run->yshift); \
+	const uint32x4_t mask = vdupq_n_u32(run->mask); \
+	const uint32x4_t xstep8 = vdupq_n_u32(xstep*8); \
+	const uint32x4_t ystep8 = vdupq_n_u32(ystep*8); \
+	uint32x4_t xlo, ylo, xhi, yhi; \
+	const UINT8 *source = run->source; \
+	const UINT8 *colormap = run->colormap; \
+	UINT8 *dest = run->dest; \
+	size_t count = run->count; \
+	ofs[0] = run->xposition; ofs[1] = ofs[0] + xstep; ofs[2] = ofs[1] + xstep; ofs[3] = ofs[2] + xstep; \
+	ofs[4] = run->yposition; ofs[5] = ofs[4] + ystep; ofs[6] = ofs[5] + ystep; ofs[7] = ofs[6] + ystep; \
+	xlo = vld1q_u32(&ofs[0]); \
+	ylo = vld1q_u32(&ofs[4]); \
+	xhi = vaddq_u32(xlo, vdupq_n_u32(xstep*4)); \
+	yhi = vaddq_u32(ylo, vdupq_n_u32(ystep*4))
+
+#define NEONSPANOFFSETS \
+	vst1q_u32(&ofs[0], vorrq_u32(vandq_u32(vshlq_u32(ylo, yshift), mask), vshlq_u32(xlo, xshift))); \
+	vst1q_u32(&ofs[4], vorrq_u32(vandq_u32(vshlq_u32(yhi, yshift), mask), vshlq_u32(xhi, xshift))); \
+	xlo = vaddq_u32(xlo, xstep8); \
+	ylo = vaddq_u32(ylo, ystep8); \
+	xhi = vaddq_u32(xhi, xstep8); \
+	yhi = vaddq_u32(yhi, ystep8)
+
+#define NEONSPANFINISH \
+	run->xposition += xstep*(UINT32)run->count; \
+	run->yposition += ystep*(UINT32)run->count; \
+	run->dest = dest
+
+static void R_SpanRun_8_NEON(spanrun_t *run)
+{
+	NEONSPANSETUP;
+
+	for (; count >= 8; count -= 8, dest += 8)
+	{
+		NEONSPANOFFSETS;
+		dest[0] = colormap[source[ofs[0]]];
+		dest[1] = colormap[source[ofs[1]]];
+		dest[2] = colormap[source[ofs[2]]];
+		dest[3] = colormap[source[ofs[3]]];
+		dest[4] = colormap[source[ofs[4]]];
+		dest[5] = colormap[source[ofs[5]]];
+		dest[6] = colormap[source[ofs[6]]];
+		dest[7] = colormap[source[ofs[7]]];
 	}
 
-	uz = ds_su.z + ds_su.y*(centery-ds_y) + ds_su.x*(ds_x1-centerx);
-	vz = ds_sv.z + ds_sv.y*(centery-ds_y) + ds_sv.x*(ds_x1-centerx);
+	NEONSPANFINISH;
+}
 
-	dest = ylookup[ds_y] + columnofs[ds_x1];
-	source = ds_source;
-	//colormap = ds_colormap;
+static void R_TranslucentSpanRun_8_NEON(spanrun_t *run)
+{
+	const UINT8 *transmap = run->transmap;
+	NEONSPANSETUP;
 
-#if 0	// The "perfect" reference version of this routine. Pretty slow.
-		// Use it only to see how things are supposed to look.
-	i = 0;
-	do
+	for (; count >= 8; count -= 8, dest += 8)
 	{
-		double z = 1.f/iz;
-		u = (INT64)(uz*z) + viewx;
-		v = (INT64)(vz*z) + viewy;
+		NEONSPANOFFSETS;
+		dest[0] = transmap[(colormap[source[ofs[0]]] << 8) + dest[0]];
+		dest[1] = transmap[(colormap[source[ofs[1]]] << 8) + dest[1]];
+		dest[2] = transmap[(colormap[source[ofs[2]]] << 8) + dest[2]];
+		dest[3] = transmap[(colormap[source[ofs[3]]] << 8) + dest[3]];
+		dest[4] = transmap[(colormap[source[ofs[4]]] << 8) + dest[4]];
+		dest[5] = transmap[(colormap[source[ofs[5]]] << 8) + dest[5]];
+		dest[6] = transmap[(colormap[source[ofs[6]]] << 8) + dest[6]];
+		dest[7] = transmap[(colormap[source[ofs[7]]] << 8) + dest[7]];
+	}
 
-		colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
+	NEONSPANFINISH;
+}
 
-		*dest = colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]];
-		dest++;
-		iz += ds_sz.x;
-		uz += ds_su.x;
-		vz += ds_sv.x;
-	} while (--width >= 0);
-#else
-#define SPANSIZE 16
-#define INVSPAN	0.0625f
+#undef NEONSPANSETUP
+#undef NEONSPANOFFSETS
+#undef NEONSPANFINISH
+#endif // SPANNEON
 
-	startz = 1.f/iz;
-	startu = uz*startz;
-	startv = vz*startz;
+static void (*R_SpanRun_8)(spanrun_t *run) = R_SpanRun_8_C;
+static void (*R_TranslucentSpanRun_8)(spanrun_t *run) = R_TranslucentSpanRun_8_C;
 
-	izstep = ds_sz.x * SPANSIZE;
-	uzstep = ds_su.x * SPANSIZE;
-	vzstep = ds_sv.x * SPANSIZE;
-	//x1 = 0;
-	width++;
+// Draws a few made up spans with both kernels and compares the pixels.
+static boolean R_SpanKernelMatches_8(void (*kernel)(spanrun_t *), void (*reference)(spanrun_t *), const UINT8 *transmap)
+{
+	static UINT8 texture[256*256], colormap[256];
+	UINT8 want[264], got[264];
+	spanrun_t a, b;
+	UINT32 seed = 0x2A5F0C1Du;
+	INT32 i, j, bits;
 
-	while (width >= SPANSIZE)
+	for (i = 0; i < (INT32)sizeof texture; i++)
 	{
-		iz += izstep;
-		uz += uzstep;
-		vz += vzstep;
-
-		endz = 1.f/iz;
-		endu = uz*endz;
-		endv = vz*endz;
-		stepu = (INT64)((endu - startu) * INVSPAN);
-		stepv = (INT64)((endv - startv) * INVSPAN);
-		u = (INT64)(startu) + viewx;
-		v = (INT64)(startv) + viewy;
+		seed = seed*1103515245u + 12345u;
+		texture[i] = (UINT8)(seed >> 16);
+	}
+	for (i = 0; i < 256; i++)
+		colormap[i] = (UINT8)(255 - i);
 
-		for (i = SPANSIZE-1; i >= 0; i--)
+	for (i = 0; i < 64; i++)
+	{
+		bits = 6 + (i % 3); // 64 to 256 wide flats, shifted like R_DrawSinglePlane does
+		for (j = 0; j < (INT32)sizeof want; j++)
 		{
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			*dest = colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]];
-			dest++;
-			u += stepu;
-			v += stepv;
+			seed = seed*1103515245u + 12345u;
+			want[j] = got[j] = (UINT8)(seed >> 16);
 		}
-		startu = endu;
-		startv = endv;
-		width -= SPANSIZE;
+
+		a.dest = want;
+		a.source = texture;
+		a.colormap = colormap;
+		a.transmap = transmap;
+		seed = seed*1103515245u + 12345u;
+		a.xposition = seed;
+		seed = seed*1103515245u + 12345u;
+		a.yposition = seed;
+		seed = seed*1103515245u + 12345u;
+		a.xstep = seed >> (i & 7);
+		seed = seed*1103515245u + 12345u;
+		a.ystep = seed >> (i & 7);
+		a.xshift = 32 - bits;
+		a.yshift = 32 - 2*bits;
+		a.mask = ((1 << bits) - 1) << bits;
+		a.count = 8*(1 + (i % 33));
+
+		b = a;
+		b.dest = got;
+		reference(&a);
+		kernel(&b);
+
+		if (memcmp(want, got, sizeof want) || a.dest - want != b.dest - got
+			|| a.xposition != b.xposition || a.yposition != b.yposition)
+			return false;
 	}
-	if (width > 0)
+	return true;
+}
+
+/**	\brief Picks the span kernels for this CPU
+	Like M_SetupMemcpy. A kernel is only used if it draws the same pixels
+	as the C one.
+*/
+void R_SetupSpanKernels(void)
+{
+	void (*span)(spanrun_t *) = R_SpanRun_8_C;
+	void (*transspan)(spanrun_t *) = R_TranslucentSpanRun_8_C;
+	const char *name = NULL;
+	UINT8 *transmap;
+	INT32 i;
+
+#ifdef SPANSSE2
+#if !defined (__x86_64__) && !defined (_M_X64)
+	if (cpufeatures.sse2) // always there on x86_64
+#endif
 	{
-		if (width == 1)
-		{
-			u = (INT64)(startu);
-			v = (INT64)(startv);
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			*dest = colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]];
-		}
-		else
-		{
-			double left = width;
-			iz += ds_sz.x * left;
-			uz += ds_su.x * left;
-			vz += ds_sv.x * left;
-
-			endz = 1.f/iz;
-			endu = uz*endz;
-			endv = vz*endz;
-			left = 1.f/left;
-			stepu = (INT64)((endu - startu) * left);
-			stepv = (INT64)((endv - startv) * left);
-			u = (INT64)(startu) + viewx;
-			v = (INT64)(startv) + viewy;
-
-			for (; width != 0; width--)
-			{
-				colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-				*dest = colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]];
-				dest++;
-				u += stepu;
-				v += stepv;
-			}
-		}
+		span = R_SpanRun_8_SSE2;
+		transspan = R_TranslucentSpanRun_8_SSE2;
+		name = "SSE2";
 	}
 #endif
+#ifdef SPANNEON
+	span = R_SpanRun_8_NEON;
+	transspan = R_TranslucentSpanRun_8_NEON;
+	name = "NEON";
+#endif
+
+	R_SpanRun_8 = R_SpanRun_8_C;
+	R_TranslucentSpanRun_8 = R_TranslucentSpanRun_8_C;
+	M_SetKernelPath("span drawers", "C");
+	if (!name || M_CheckParm("-nospansimd"))
+		return;
+
+	transmap = malloc(256*256);
+	if (!transmap)
+		return;
+	for (i = 0; i < 256*256; i++)
+		transmap[i] = (UINT8)((i >> 8) ^ (i * 7));
+
+	if (R_SpanKernelMatches_8(span, R_SpanRun_8_C, transmap)
+		&& R_SpanKernelMatches_8(transspan, R_TranslucentSpanRun_8_C, transmap))
+	{
+		R_SpanRun_8 = span;
+		R_TranslucentSpanRun_8 = transspan;
+		M_SetKernelPath("span drawers", name);
+		CONS_Printf("Using %s span drawers\n", name);
+	}
+	else
+		CONS_Alert(CONS_WARNING, "%s span drawers don't match the C drawers, not using them\n", name);
+
+	free(transmap);
 }
 
-/**	\brief The R_DrawTiltedTranslucentSpan_8 function
-	Like DrawTiltedSpan, but translucent
+/**	\brief The R_DrawSpan_8 function
+	Draws the actual span.
 */
-void R_DrawTiltedTranslucentSpan_8(void)
+void R_DrawSpan_8 (void)
 {
-	// x1, x2 = ds_x1, ds_x2
-	int width = ds_x2 - ds_x1;
-	double iz, uz, vz;
-	UINT32 u, v;
-	int i;
+	UINT32 xposition;
+	UINT32 yposition;
+	UINT32 xstep, ystep;
 
 	UINT8 *source;
 	UINT8 *colormap;
 	UINT8 *dest;
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
 
-	double startz, startu, startv;
-	double izstep, uzstep, vzstep;
-	double endz, endu, endv;
-	UINT32 stepu, stepv;
+	size_t count;
 
-	iz = ds_sz.z + ds_sz.y*(centery-ds_y) + ds_sz.x*(ds_x1-centerx);
+	// SoM: we only need 6 bits for the integer part (0 thru 63) so the rest
+	// can be used for the fraction part. This allows calculation of the memory address in the
+	// texture with two shifts, an OR and one AND. (see below)
+	// for texture sizes > 64 the amount of precision we can allow will decrease, but only by one
+	// bit per power of two (obviously)
+	// Ok, because I was able to eliminate the variable spot below, this function is now FASTER
+	// than the original span renderer. Whodathunkit?
+	xposition = ds_xfrac << nflatshiftup; yposition = ds_yfrac << nflatshiftup;
+	xstep = ds_xstep << nflatshiftup; ystep = ds_ystep << nflatshiftup;
 
-	// Lighting is simple. It's just linear interpolation from start to end
-	{
-		float planelightfloat = BASEVIDWIDTH*BASEVIDWIDTH/vid.width / (zeroheight - FIXED_TO_FLOAT(viewz)) / 21.0f;
-		float lightstart, lightend;
+	source = ds_source;
+	colormap = ds_colormap;
+	dest = ylookup[ds_y] + columnofs[ds_x1];
+	count = ds_x2 - ds_x1 + 1;
 
-		lightend = (iz + ds_sz.x*width) * planelightfloat;
-		lightstart = iz * planelightfloat;
+	if (dest+8 > deststop)
+		return;
 
-		R_CalcTiltedLighting(FLOAT_TO_FIXED(lightstart), FLOAT_TO_FIXED(lightend));
-		//CONS_Printf("tilted lighting %f to %f (foc %f)\n", lightstart, lightend, focallengthf);
+	if (count >= 8)
+	{
+		spanrun_t run;
+
+		run.dest = dest;
+		run.source = source;
+		run.colormap = colormap;
+		run.transmap = NULL;
+		run.xposition = xposition;
+		run.yposition = yposition;
+		run.xstep = xstep;
+		run.ystep = ystep;
+		run.xshift = nflatxshift;
+		run.yshift = nflatyshift;
+		run.mask = nflatmask;
+		run.count = count & ~(size_t)7;
+		R_SpanRun_8(&run);
+
+		dest = run.dest;
+		xposition = run.xposition;
+		yposition = run.yposition;
+		count &= 7;
 	}
+	while (count-- && dest <= deststop)
+	{
+		*dest++ = colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]];
+		xposition += xstep;
+		yposition += ystep;
+	}
+}
 
-	uz = ds_su.z + ds_su.y*(centery-ds_y) + ds_su.x*(ds_x1-centerx);
-	vz = ds_sv.z + ds_sv.y*(centery-ds_y) + ds_sv.x*(ds_x1-centerx);
+/**	\brief The R_DrawTiledSpan_8 function
+	R_DrawSpan_8 for a flat from R_GetTiledFlat. A span that walks across
+	the flat at an angle stays in one 64 byte block for several pixels,
+	where a row by row flat would need a new cache line for every one.
+*/
+void R_DrawTiledSpan_8(void)
+{
+	UINT32 xposition, yposition;
+	UINT32 xstep, ystep;
+	const INT32 bits = 32 - (INT32)nflatxshift;
+	const UINT32 rowmask = ((1u << (bits-3)) - 1) << (bits+3);
+	const UINT32 columnmask = ((1u << bits) - 1) << 3;
+	const UINT32 columnshift = nflatxshift - 3;
+
+	UINT8 *source;
+	UINT8 *colormap;
+	UINT8 *dest;
+	const UINT8 *deststop = screens[0] + vid.rowbytes * vid.height;
+
+	size_t count;
+
+	xposition = ds_xfrac << nflatshiftup; yposition = ds_yfrac << nflatshiftup;
+	xstep = ds_xstep << nflatshiftup; ystep = ds_ystep << nflatshiftup;
 
-	dest = ylookup[ds_y] + columnofs[ds_x1];
 	source = ds_source;
-	//colormap = ds_colormap;
+	colormap = ds_colormap;
+	dest = ylookup[ds_y] + columnofs[ds_x1];
+	count = ds_x2 - ds_x1 + 1;
 
-#if 0	// The "perfect" reference version of this routine. Pretty slow.
-		// Use it only to see how things are supposed to look.
-	i = 0;
-	do
-	{
-		double z = 1.f/iz;
-		u = (INT64)(uz*z) + viewx;
-		v = (INT64)(vz*z) + viewy;
+	if (dest+8 > deststop)
+		return;
 
-		colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-		*dest = *(ds_transmap + (colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]] << 8) + *dest);
+	// The strip of 8 rows, the column in the strip, then the row in the strip
+#define TILEDPIXEL(i) \
+	dest[i] = colormap[source[((yposition >> nflatyshift) & rowmask) \
+		| ((xposition >> columnshift) & columnmask) | ((yposition >> nflatxshift) & 7)]]; \
+	xposition += xstep; \
+	yposition += ystep
+	while (count >= 8)
+	{
+		TILEDPIXEL(0);
+		TILEDPIXEL(1);
+		TILEDPIXEL(2);
+		TILEDPIXEL(3);
+		TILEDPIXEL(4);
+		TILEDPIXEL(5);
+		TILEDPIXEL(6);
+		TILEDPIXEL(7);
+		dest += 8;
+		count -= 8;
+	}
+	while (count-- && dest <= deststop)
+	{
+		TILEDPIXEL(0);
 		dest++;
-		iz += ds_sz.x;
-		uz += ds_su.x;
-		vz += ds_sv.x;
-	} while (--width >= 0);
-#else
-#define SPANSIZE 16
-#define INVSPAN	0.0625f
+	}
+#undef TILEDPIXEL
+}
+
+#ifdef ESLOPE
+// R_CalcTiltedLighting
+// Exactly what it says on the tin. I wish I wasn't too lazy to explain things properly.
+static INT32 tiltlighting[MAXVIDWIDTH];
+void R_CalcTiltedLighting(fixed_t start, fixed_t end)
+{
+	// ZDoom uses a different lighting setup to us, and I couldn't figure out how to adapt their version
+	// of this function. Here's my own.
+	INT32 left = ds_x1, right = ds_x2;
+	fixed_t step = (end-start)/(ds_x2-ds_x1+1);
+	INT32 i;
+
+	// I wanna do some optimizing by checking for out-of-range segments on either side to fill in all at once,
+	// but I'm too bad at coding to not crash the game trying to do that. I guess this is fast enough for now...
+
+	for (i = left; i <= right; i++) {
+		tiltlighting[i] = (start += step) >> FRACBITS;
+		if (tiltlighting[i] < 0)
+			tiltlighting[i] = 0;
+		else if (tiltlighting[i] >= MAXLIGHTSCALE)
+			tiltlighting[i] = MAXLIGHTSCALE-1;
+	}
+}
+
+
+// R_CalcTiltedSpots
+// Works out the flat offset of every pixel in the span. The perspective
+// divide is only done every cv_slopesubdivision pixels, and u and v are
+// stepped linearly in between, like Quake's span subdivision.
+static UINT32 tiltspots[MAXVIDWIDTH];
+static void R_CalcTiltedSpots(double iz, double uz, double vz)
+{
+	const INT32 spansize = cv_slopesubdivision.value;
+	INT32 x = ds_x1, width = ds_x2 - ds_x1 + 1, len, end;
+	double startz, startu, startv;
+	double endz, endu, endv;
+	double left;
+	UINT32 u, v, stepu, stepv;
+
+	if (spansize <= 1)
+	{
+		// The "perfect" reference version. Pretty slow.
+		// Use it only to see how things are supposed to look.
+		for (; width > 0; width--)
+		{
+			double z = 1.f/iz;
+			u = (INT64)(uz*z) + viewx;
+			v = (INT64)(vz*z) + viewy;
+			tiltspots[x++] = ((v >> nflatyshift) & nflatmask) | (u >> nflatxshift);
+			iz += ds_sz.x;
+			uz += ds_su.x;
+			vz += ds_sv.x;
+		}
+		return;
+	}
 
 	startz = 1.f/iz;
 	startu = uz*startz;
 	startv = vz*startz;
 
-	izstep = ds_sz.x * SPANSIZE;
-	uzstep = ds_su.x * SPANSIZE;
-	vzstep = ds_sv.x * SPANSIZE;
-	//x1 = 0;
-	width++;
-
-	while (width >= SPANSIZE)
+	for (; width > 0; width -= len)
 	{
-		iz += izstep;
-		uz += uzstep;
-		vz += vzstep;
+		len = width < spansize ? width : spansize;
+		u = (INT64)(startu) + viewx;
+		v = (INT64)(startv) + viewy;
+
+		if (len == 1)
+		{
+			tiltspots[x] = ((v >> nflatyshift) & nflatmask) | (u >> nflatxshift);
+			break;
+		}
+
+		left = len;
+		iz += ds_sz.x * left;
+		uz += ds_su.x * left;
+		vz += ds_sv.x * left;
 
 		endz = 1.f/iz;
 		endu = uz*endz;
 		endv = vz*endz;
-		stepu = (INT64)((endu - startu) * INVSPAN);
-		stepv = (INT64)((endv - startv) * INVSPAN);
-		u = (INT64)(startu) + viewx;
-		v = (INT64)(startv) + viewy;
+		left = 1.f/left;
+		stepu = (INT64)((endu - startu) * left);
+		stepv = (INT64)((endv - startv) * left);
 
-		for (i = SPANSIZE-1; i >= 0; i--)
+		for (end = x + len; x < end; x++)
 		{
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			*dest = *(ds_transmap + (colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]] << 8) + *dest);
-			dest++;
+			tiltspots[x] = ((v >> nflatyshift) & nflatmask) | (u >> nflatxshift);
 			u += stepu;
 			v += stepv;
 		}
 		startu = endu;
 		startv = endv;
-		width -= SPANSIZE;
 	}
-	if (width > 0)
-	{
-		if (width == 1)
-		{
-			u = (INT64)(startu);
-			v = (INT64)(startv);
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			*dest = *(ds_transmap + (colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]] << 8) + *dest);
-		}
-		else
-		{
-			double left = width;
-			iz += ds_sz.x * left;
-			uz += ds_su.x * left;
-			vz += ds_sv.x * left;
-
-			endz = 1.f/iz;
-			endu = uz*endz;
-			endv = vz*endz;
-			left = 1.f/left;
-			stepu = (INT64)((endu - startu) * left);
-			stepv = (INT64)((endv - startv) * left);
-			u = (INT64)(startu) + viewx;
-			v = (INT64)(startv) + viewy;
-
-			for (; width != 0; width--)
-			{
-				colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-				*dest = *(ds_transmap + (colormap[source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)]] << 8) + *dest);
-				dest++;
-				u += stepu;
-				v += stepv;
-			}
-		}
-	}
-#endif
 }
 
-void R_DrawTiltedSplat_8(void)
+// Sets up tiltlighting and tiltspots for the span.
+static void R_SetupTiltedSpan(void)
 {
 	// x1, x2 = ds_x1, ds_x2
 	int width = ds_x2 - ds_x1;
 	double iz, uz, vz;
-	UINT32 u, v;
-	int i;
-
-	UINT8 *source;
-	UINT8 *colormap;
-	UINT8 *dest;
-
-	UINT8 val;
-
-	double startz, startu, startv;
-	double izstep, uzstep, vzstep;
-	double endz, endu, endv;
-	UINT32 stepu, stepv;
 
 	iz = ds_sz.z + ds_sz.y*(centery-ds_y) + ds_sz.x*(ds_x1-centerx);
 
@@ -952,111 +1268,66 @@ void R_DrawTiltedSplat_8(void)
 	uz = ds_su.z + ds_su.y*(centery-ds_y) + ds_su.x*(ds_x1-centerx);
 	vz = ds_sv.z + ds_sv.y*(centery-ds_y) + ds_sv.x*(ds_x1-centerx);
 
-	dest = ylookup[ds_y] + columnofs[ds_x1];
-	source = ds_source;
-	//colormap = ds_colormap;
+	R_CalcTiltedSpots(iz, uz, vz);
+}
 
-#if 0	// The "perfect" reference version of this routine. Pretty slow.
-		// Use it only to see how things are supposed to look.
-	i = 0;
-	do
-	{
-		double z = 1.f/iz;
-		u = (INT64)(uz*z) + viewx;
-		v = (INT64)(vz*z) + viewy;
+/**	\brief The R_DrawTiltedSpan_8 function
+	Draw slopes! Holy sheit!
+*/
+void R_DrawTiltedSpan_8(void)
+{
+	INT32 x;
+	UINT8 *source = ds_source;
+	UINT8 *colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
 
-		colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
+	R_SetupTiltedSpan();
 
-		val = source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)];
-		if (val != TRANSPARENTPIXEL)
-			*dest = colormap[val];
-		dest++;
-		iz += ds_sz.x;
-		uz += ds_su.x;
-		vz += ds_sv.x;
-	} while (--width >= 0);
-#else
-#define SPANSIZE 16
-#define INVSPAN	0.0625f
+	for (x = ds_x1; x <= ds_x2; x++, dest++)
+	{
+		colormap = planezlight[tiltlighting[x]] + (ds_colormap - colormaps);
+		*dest = colormap[source[tiltspots[x]]];
+	}
+}
 
-	startz = 1.f/iz;
-	startu = uz*startz;
-	startv = vz*startz;
+/**	\brief The R_DrawTiltedTranslucentSpan_8 function
+	Like DrawTiltedSpan, but translucent
+*/
+void R_DrawTiltedTranslucentSpan_8(void)
+{
+	INT32 x;
+	UINT8 *source = ds_source;
+	UINT8 *colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
 
-	izstep = ds_sz.x * SPANSIZE;
-	uzstep = ds_su.x * SPANSIZE;
-	vzstep = ds_sv.x * SPANSIZE;
-	//x1 = 0;
-	width++;
+	R_SetupTiltedSpan();
 
-	while (width >= SPANSIZE)
+	for (x = ds_x1; x <= ds_x2; x++, dest++)
 	{
-		iz += izstep;
-		uz += uzstep;
-		vz += vzstep;
+		colormap = planezlight[tiltlighting[x]] + (ds_colormap - colormaps);
+		*dest = *(ds_transmap + (colormap[source[tiltspots[x]]] << 8) + *dest);
+	}
+}
 
-		endz = 1.f/iz;
-		endu = uz*endz;
-		endv = vz*endz;
-		stepu = (INT64)((endu - startu) * INVSPAN);
-		stepv = (INT64)((endv - startv) * INVSPAN);
-		u = (INT64)(startu) + viewx;
-		v = (INT64)(startv) + viewy;
+void R_DrawTiltedSplat_8(void)
+{
+	INT32 x;
+	UINT8 *source = ds_source;
+	UINT8 *colormap;
+	UINT8 *dest = ylookup[ds_y] + columnofs[ds_x1];
+	UINT8 val;
 
-		for (i = SPANSIZE-1; i >= 0; i--)
-		{
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			val = source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)];
-			if (val != TRANSPARENTPIXEL)
-				*dest = colormap[val];
-			dest++;
-			u += stepu;
-			v += stepv;
-		}
-		startu = endu;
-		startv = endv;
-		width -= SPANSIZE;
-	}
-	if (width > 0)
+	R_SetupTiltedSpan();
+
+	for (x = ds_x1; x <= ds_x2; x++, dest++)
 	{
-		if (width == 1)
-		{
-			u = (INT64)(startu);
-			v = (INT64)(startv);
-			colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-			val = source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)];
-			if (val != TRANSPARENTPIXEL)
-				*dest = colormap[val];
-		}
-		else
+		val = source[tiltspots[x]];
+		if (val != TRANSPARENTPIXEL)
 		{
-			double left = width;
-			iz += ds_sz.x * left;
-			uz += ds_su.x * left;
-			vz += ds_sv.x * left;
-
-			endz = 1.f/iz;
-			endu = uz*endz;
-			endv = vz*endz;
-			left = 1.f/left;
-			stepu = (INT64)((endu - startu) * left);
-			stepv = (INT64)((endv - startv) * left);
-			u = (INT64)(startu) + viewx;
-			v = (INT64)(startv) + viewy;
-
-			for (; width != 0; width--)
-			{
-				colormap = planezlight[tiltlighting[ds_x1++]] + (ds_colormap - colormaps);
-				val = source[((v >> nflatyshift) & nflatmask) | (u >> nflatxshift)];
-				if (val != TRANSPARENTPIXEL)
-					*dest = colormap[val];
-				dest++;
-				u += stepu;
-				v += stepv;
-			}
+			colormap = planezlight[tiltlighting[x]] + (ds_colormap - colormaps);
+			*dest = colormap[val];
 		}
 	}
-#endif
 }
 #endif // ESLOPE
 
@@ -1308,45 +1579,28 @@ void R_DrawTranslucentSpan_8 (void)
 	dest = ylookup[ds_y] + columnofs[ds_x1];
 	count = ds_x2 - ds_x1 + 1;
 
-	while (count >= 8)
+	if (count >= 8)
 	{
-		// SoM: Why didn't I see this earlier? the spot variable is a waste now because we don't
-		// have the uber complicated math to calculate it now, so that was a memory write we didn't
-		// need!
-		dest[0] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[0]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[1] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[1]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[2] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[2]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[3] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[3]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[4] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[4]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[5] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[5]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[6] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[6]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest[7] = *(ds_transmap + (colormap[source[((yposition >> nflatyshift) & nflatmask) | (xposition >> nflatxshift)]] << 8) + dest[7]);
-		xposition += xstep;
-		yposition += ystep;
-
-		dest += 8;
-		count -= 8;
+		spanrun_t run;
+
+		run.dest = dest;
+		run.source = source;
+		run.colormap = colormap;
+		run.transmap = ds_transmap;
+		run.xposition = xposition;
+		run.yposition = yposition;
+		run.xstep = xstep;
+		run.ystep = ystep;
+		run.xshift = nflatxshift;
+		run.yshift = nflatyshift;
+		run.mask = nflatmask;
+		run.count = count & ~(size_t)7;
+		R_TranslucentSpanRun_8(&run);
+
+		dest = run.dest;
+		xposition = run.xposition;
+		yposition = run.yposition;
+		count &= 7;
 	}
 	while (count--)
 	{
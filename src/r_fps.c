@@ -0,0 +1,496 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_fps.c
+/// \brief Drawing frames in between tics
+///
+///        Mobjs are moved in place, so both renderers and everything they
+///        look at (sprites, the view, shadows) agree without knowing about
+///        any of this. A mobj is only moved if its position was recorded
+///        at the start of this tic, so things spawned during the tic or
+///        loaded from a savegame are simply drawn where they are.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "p_polyobj.h"
+#include "p_slopes.h"
+#include "r_fps.h"
+#include "r_main.h"
+#include "r_state.h"
+
+consvar_t cv_frameinterpolation = {"frameinterpolation", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+static CV_PossibleValue_t fpscap_cons_t[] = {{0, "MIN"}, {500, "MAX"}, {0, NULL}};
+consvar_t cv_fpscap = {"fpscap", "0", CV_SAVE, fpscap_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+consvar_t cv_lateinput = {"lateinput", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// How far into the tic the frame being drawn is, FRACUNIT if it isn't in between
+fixed_t rendertimefrac = FRACUNIT;
+
+// Anything that moved further than this in one tic was teleported,
+// and is drawn where it is.
+#define MAXINTERPMOVE (1024*FRACUNIT)
+
+static UINT32 recordmicros; // when the last tic started
+static UINT32 framemicros; // when the last frame started
+static UINT32 recordstamp; // mobj_t old_stamp for this tic
+static boolean recorded = false; // since the last reset
+static boolean interpolated = false; // between R_InterpolateState and R_RestoreInterpolationState
+
+typedef struct
+{
+	fixed_t x, y, z;
+	angle_t angle, aiming;
+} camstate_t;
+
+static camera_t *const cameras[2] = {&camera, &camera2};
+static camstate_t oldcams[2], curcams[2], lerpcams[2];
+
+typedef struct
+{
+	fixed_t viewz;
+	angle_t aiming;
+} viewstate_t;
+
+static viewstate_t oldviews[MAXPLAYERS], curviews[MAXPLAYERS];
+
+typedef struct
+{
+	mobj_t *mo;
+	fixed_t x, y, z;
+	angle_t angle;
+} mobjstate_t;
+
+static mobjstate_t *movedmobjs;
+static size_t nummovedmobjs, maxmovedmobjs;
+
+typedef struct
+{
+	fixed_t oldfloor, oldceiling;
+	fixed_t floor, ceiling;
+} planestate_t;
+
+static planestate_t *planestates;
+static size_t numplanestates, maxplanestates;
+
+typedef struct
+{
+	fixed_t oldx, oldy;
+	fixed_t x, y;
+} polyvertstate_t;
+
+typedef struct
+{
+	angle_t old, cur;
+} polysegstate_t;
+
+static polyvertstate_t *polyverts;
+static size_t numpolyverts, maxpolyverts;
+static polysegstate_t *polysegs;
+static size_t numpolysegs, maxpolysegs;
+
+#ifdef ESLOPE
+typedef struct
+{
+	vector3_t o, normal;
+	fixed_t zdelta, lowz, highz;
+	angle_t zangle;
+} slopestate_t;
+
+typedef struct
+{
+	slopestate_t old, cur;
+} slopeinterp_t;
+
+static slopeinterp_t *slopes;
+static size_t numslopes, maxslopes;
+#endif
+
+// Makes room for n entries of size bytes.
+static void *R_GrowInterpArray(void *p, size_t *max, size_t n, size_t size)
+{
+	if (n <= *max)
+		return p;
+
+	*max = n + n/2 + 16;
+	p = realloc(p, *max * size);
+	if (!p)
+		I_Error("R_GrowInterpArray: out of memory");
+	return p;
+}
+
+#ifdef ESLOPE
+static void R_SaveSlope(slopestate_t *ss, const pslope_t *slope)
+{
+	ss->o = slope->o;
+	ss->normal = slope->normal;
+	ss->zdelta = slope->zdelta;
+	ss->lowz = slope->lowz;
+	ss->highz = slope->highz;
+	ss->zangle = slope->zangle;
+}
+#endif
+
+static inline fixed_t R_LerpFixed(fixed_t from, fixed_t to, fixed_t frac)
+{
+	return from + (fixed_t)((((INT64)to - from) * frac) >> FRACBITS);
+}
+
+static inline angle_t R_LerpAngle(angle_t from, angle_t to, fixed_t frac)
+{
+	return from + (angle_t)(((INT64)(INT32)(to - from) * frac) >> FRACBITS);
+}
+
+static inline boolean R_Teleported(fixed_t from, fixed_t to)
+{
+	const INT64 move = (INT64)to - from;
+	return move > MAXINTERPMOVE || move < -MAXINTERPMOVE;
+}
+
+boolean R_UsingFrameInterpolation(void)
+{
+	return cv_frameinterpolation.value && gamestate == GS_LEVEL
+		&& !dedicated && !singletics;
+}
+
+void R_ResetInterpolation(void)
+{
+	I_Assert(!interpolated);
+	recorded = false;
+	recordstamp++;
+}
+
+void R_RecordInterpolationState(void)
+{
+	thinker_t *th;
+	mobj_t *mo;
+	size_t i, j, n;
+#ifdef ESLOPE
+	pslope_t *slope;
+#endif
+
+	I_Assert(!interpolated);
+
+	if (!cv_frameinterpolation.value)
+	{
+		recorded = false;
+		return;
+	}
+
+	recordmicros = I_GetTimeMicros();
+	recordstamp++;
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+			continue;
+		mo = (mobj_t *)th;
+		mo->old_x = mo->x;
+		mo->old_y = mo->y;
+		mo->old_z = mo->z;
+		mo->old_angle = mo->angle;
+		mo->old_stamp = recordstamp;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		oldcams[i].x = cameras[i]->x;
+		oldcams[i].y = cameras[i]->y;
+		oldcams[i].z = cameras[i]->z;
+		oldcams[i].angle = cameras[i]->angle;
+		oldcams[i].aiming = cameras[i]->aiming;
+	}
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		oldviews[i].viewz = players[i].viewz;
+		oldviews[i].aiming = players[i].aiming;
+	}
+
+	planestates = R_GrowInterpArray(planestates, &maxplanestates, numsectors, sizeof (*planestates));
+	numplanestates = numsectors;
+	for (i = 0; i < numsectors; i++)
+	{
+		planestates[i].oldfloor = sectors[i].floorheight;
+		planestates[i].oldceiling = sectors[i].ceilingheight;
+	}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects; i++)
+		n += PolyObjects[i].numVertices;
+	polyverts = R_GrowInterpArray(polyverts, &maxpolyverts, n, sizeof (*polyverts));
+	numpolyverts = n;
+	for (i = 0, n = 0; i < (size_t)numPolyObjects; i++)
+		for (j = 0; j < PolyObjects[i].numVertices; j++, n++)
+		{
+			polyverts[n].oldx = PolyObjects[i].vertices[j]->x;
+			polyverts[n].oldy = PolyObjects[i].vertices[j]->y;
+		}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects; i++)
+		n += PolyObjects[i].segCount;
+	polysegs = R_GrowInterpArray(polysegs, &maxpolysegs, n, sizeof (*polysegs));
+	numpolysegs = n;
+	for (i = 0, n = 0; i < (size_t)numPolyObjects; i++)
+		for (j = 0; j < PolyObjects[i].segCount; j++, n++)
+			polysegs[n].old = PolyObjects[i].segs[j]->angle;
+
+#ifdef ESLOPE
+	for (slope = slopelist, n = 0; slope; slope = slope->next)
+		n++;
+	slopes = R_GrowInterpArray(slopes, &maxslopes, n, sizeof (*slopes));
+	numslopes = n;
+	for (slope = slopelist, n = 0; slope; slope = slope->next, n++)
+		R_SaveSlope(&slopes[n].old, slope);
+#endif
+
+	recorded = true;
+}
+
+void R_InterpolateState(void)
+{
+	thinker_t *th;
+	mobj_t *mo;
+	mobjstate_t *ms;
+	size_t i, j, n;
+	fixed_t frac;
+	INT64 elapsed;
+#ifdef ESLOPE
+	pslope_t *slope;
+#endif
+
+	framemicros = I_GetTimeMicros();
+
+	if (interpolated || !recorded || !R_UsingFrameInterpolation())
+		return;
+
+	elapsed = (UINT32)(framemicros - recordmicros);
+	elapsed = (elapsed * TICRATE << FRACBITS) / 1000000;
+	frac = elapsed > FRACUNIT ? FRACUNIT : (fixed_t)elapsed;
+	if (frac == FRACUNIT)
+		return; // already where the game left it
+	rendertimefrac = frac;
+
+	nummovedmobjs = 0;
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+			continue;
+		mo = (mobj_t *)th;
+		if (mo->old_stamp != recordstamp)
+			continue;
+		if (mo->x == mo->old_x && mo->y == mo->old_y && mo->z == mo->old_z && mo->angle == mo->old_angle)
+			continue;
+		if (R_Teleported(mo->old_x, mo->x) || R_Teleported(mo->old_y, mo->y) || R_Teleported(mo->old_z, mo->z))
+			continue;
+
+		movedmobjs = R_GrowInterpArray(movedmobjs, &maxmovedmobjs, nummovedmobjs + 1, sizeof (*movedmobjs));
+		ms = &movedmobjs[nummovedmobjs++];
+		ms->mo = mo;
+		ms->x = mo->x;
+		ms->y = mo->y;
+		ms->z = mo->z;
+		ms->angle = mo->angle;
+
+		mo->x = R_LerpFixed(mo->old_x, mo->x, frac);
+		mo->y = R_LerpFixed(mo->old_y, mo->y, frac);
+		mo->z = R_LerpFixed(mo->old_z, mo->z, frac);
+		mo->angle = R_LerpAngle(mo->old_angle, mo->angle, frac);
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		camera_t *cam = cameras[i];
+		const camstate_t *old = &oldcams[i];
+
+		curcams[i].x = cam->x;
+		curcams[i].y = cam->y;
+		curcams[i].z = cam->z;
+		curcams[i].angle = cam->angle;
+		curcams[i].aiming = cam->aiming;
+
+		if (!(R_Teleported(old->x, cam->x) || R_Teleported(old->y, cam->y) || R_Teleported(old->z, cam->z)))
+		{
+			cam->x = R_LerpFixed(old->x, cam->x, frac);
+			cam->y = R_LerpFixed(old->y, cam->y, frac);
+			cam->z = R_LerpFixed(old->z, cam->z, frac);
+			cam->angle = R_LerpAngle(old->angle, cam->angle, frac);
+			cam->aiming = R_LerpAngle(old->aiming, cam->aiming, frac);
+		}
+
+		lerpcams[i].x = cam->x;
+		lerpcams[i].y = cam->y;
+		lerpcams[i].z = cam->z;
+		lerpcams[i].angle = cam->angle;
+		lerpcams[i].aiming = cam->aiming;
+	}
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		curviews[i].viewz = players[i].viewz;
+		curviews[i].aiming = players[i].aiming;
+		if (!playeringame[i] || R_Teleported(oldviews[i].viewz, players[i].viewz))
+			continue;
+		players[i].viewz = R_LerpFixed(oldviews[i].viewz, players[i].viewz, frac);
+		players[i].aiming = R_LerpAngle(oldviews[i].aiming, players[i].aiming, frac);
+	}
+
+	if (numplanestates == numsectors)
+		for (i = 0; i < numsectors; i++)
+		{
+			planestate_t *ps = &planestates[i];
+
+			ps->floor = sectors[i].floorheight;
+			ps->ceiling = sectors[i].ceilingheight;
+			sectors[i].floorheight = R_LerpFixed(ps->oldfloor, ps->floor, frac);
+			sectors[i].ceilingheight = R_LerpFixed(ps->oldceiling, ps->ceiling, frac);
+		}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects && n < numpolyverts; i++)
+		for (j = 0; j < PolyObjects[i].numVertices && n < numpolyverts; j++, n++)
+		{
+			vertex_t *v = PolyObjects[i].vertices[j];
+
+			polyverts[n].x = v->x;
+			polyverts[n].y = v->y;
+			v->x = R_LerpFixed(polyverts[n].oldx, v->x, frac);
+			v->y = R_LerpFixed(polyverts[n].oldy, v->y, frac);
+		}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects && n < numpolysegs; i++)
+		for (j = 0; j < PolyObjects[i].segCount && n < numpolysegs; j++, n++)
+		{
+			seg_t *seg = PolyObjects[i].segs[j];
+
+			polysegs[n].cur = seg->angle;
+			seg->angle = R_LerpAngle(polysegs[n].old, seg->angle, frac);
+		}
+
+#ifdef ESLOPE
+	for (slope = slopelist, n = 0; slope && n < numslopes; slope = slope->next, n++)
+	{
+		const slopestate_t *old = &slopes[n].old;
+
+		R_SaveSlope(&slopes[n].cur, slope);
+		slope->o.z = R_LerpFixed(old->o.z, slope->o.z, frac);
+		slope->normal.x = R_LerpFixed(old->normal.x, slope->normal.x, frac);
+		slope->normal.y = R_LerpFixed(old->normal.y, slope->normal.y, frac);
+		slope->normal.z = R_LerpFixed(old->normal.z, slope->normal.z, frac);
+		slope->zdelta = R_LerpFixed(old->zdelta, slope->zdelta, frac);
+		slope->lowz = R_LerpFixed(old->lowz, slope->lowz, frac);
+		slope->highz = R_LerpFixed(old->highz, slope->highz, frac);
+		slope->zangle = R_LerpAngle(old->zangle, slope->zangle, frac);
+	}
+#endif
+
+	interpolated = true;
+}
+
+void R_RestoreInterpolationState(void)
+{
+	size_t i, j, n;
+#ifdef ESLOPE
+	pslope_t *slope;
+#endif
+
+	if (!interpolated)
+		return;
+	rendertimefrac = FRACUNIT;
+
+	for (i = 0; i < nummovedmobjs; i++)
+	{
+		mobjstate_t *ms = &movedmobjs[i];
+
+		ms->mo->x = ms->x;
+		ms->mo->y = ms->y;
+		ms->mo->z = ms->z;
+		ms->mo->angle = ms->angle;
+	}
+	nummovedmobjs = 0;
+
+	for (i = 0; i < 2; i++)
+	{
+		camera_t *cam = cameras[i];
+
+		// The renderer resets the camera when chasecam gets turned on.
+		// Keep that instead of the old position.
+		if (cam->x != lerpcams[i].x || cam->y != lerpcams[i].y || cam->z != lerpcams[i].z)
+			continue;
+
+		cam->x = curcams[i].x;
+		cam->y = curcams[i].y;
+		cam->z = curcams[i].z;
+		cam->angle = curcams[i].angle;
+		cam->aiming = curcams[i].aiming;
+	}
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		players[i].viewz = curviews[i].viewz;
+		players[i].aiming = curviews[i].aiming;
+	}
+
+	if (numplanestates == numsectors)
+		for (i = 0; i < numsectors; i++)
+		{
+			sectors[i].floorheight = planestates[i].floor;
+			sectors[i].ceilingheight = planestates[i].ceiling;
+		}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects && n < numpolyverts; i++)
+		for (j = 0; j < PolyObjects[i].numVertices && n < numpolyverts; j++, n++)
+		{
+			PolyObjects[i].vertices[j]->x = polyverts[n].x;
+			PolyObjects[i].vertices[j]->y = polyverts[n].y;
+		}
+
+	for (i = 0, n = 0; i < (size_t)numPolyObjects && n < numpolysegs; i++)
+		for (j = 0; j < PolyObjects[i].segCount && n < numpolysegs; j++, n++)
+			PolyObjects[i].segs[j]->angle = polysegs[n].cur;
+
+#ifdef ESLOPE
+	for (slope = slopelist, n = 0; slope && n < numslopes; slope = slope->next, n++)
+	{
+		const slopestate_t *cur = &slopes[n].cur;
+
+		slope->o = cur->o;
+		slope->normal = cur->normal;
+		slope->zdelta = cur->zdelta;
+		slope->lowz = cur->lowz;
+		slope->highz = cur->highz;
+		slope->zangle = cur->zangle;
+	}
+#endif
+
+	interpolated = false;
+}
+
+// Sleeping is only good to a millisecond or so; spin for the rest
+#define SPINMICROS 2000
+
+boolean R_WaitForNextFrame(void)
+{
+	UINT32 start = I_GetTimeMicros();
+	INT32 framewait, ticwait, wait;
+
+	if (!cv_fpscap.value)
+		return true;
+
+	framewait = (INT32)(1000000 / max(cv_fpscap.value, TICRATE) - (start - framemicros));
+	ticwait = recorded ? (INT32)(1000000 / TICRATE - (start - recordmicros)) : framewait;
+	wait = min(framewait, ticwait);
+
+	if (wait > SPINMICROS)
+		I_SleepMillis((wait - SPINMICROS) / 1000);
+	while ((INT32)(I_GetTimeMicros() - start) < wait)
+		;
+
+	// The tic comes first, if it's due before the frame
+	return framewait <= ticwait;
+}
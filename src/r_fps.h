@@ -0,0 +1,61 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_fps.h
+/// \brief Drawing frames in between tics
+///
+///        At the start of every tic the positions of mobjs, cameras,
+///        sector planes, polyobjects and slopes are recorded. When a frame
+///        is drawn part of the way into the next tic, they are moved in
+///        between the recorded and the current positions for the time it
+///        takes to draw the view, then put back. The game itself never
+///        sees the in-between positions.
+
+#ifndef __R_FPS__
+#define __R_FPS__
+
+#include "command.h"
+#include "m_fixed.h"
+
+extern consvar_t cv_frameinterpolation, cv_fpscap;
+
+// With lateinput, the frames in between tics read the mouse too, and the
+// first person view turns with what they read before the next tic does.
+extern consvar_t cv_lateinput;
+
+// How far into the tic the frame being drawn is, FRACUNIT if it isn't in between
+extern fixed_t rendertimefrac;
+
+/**	\brief Whether frames should be drawn in between tics right now.
+*/
+boolean R_UsingFrameInterpolation(void);
+
+/**	\brief Forgets everything recorded, for a new level.
+*/
+void R_ResetInterpolation(void);
+
+/**	\brief Records where everything is, at the start of a tic.
+*/
+void R_RecordInterpolationState(void);
+
+/**	\brief Moves everything in between the last tic and this one.
+	Always pair with R_RestoreInterpolationState.
+*/
+void R_InterpolateState(void);
+
+/**	\brief Puts everything back where the game left it.
+*/
+void R_RestoreInterpolationState(void);
+
+/**	\brief Holds back the next in-between frame to fpscap frames a second,
+	sleeping most of the way and spinning the rest.
+	\return	false if the next tic is due first, and the frame should wait
+*/
+boolean R_WaitForNextFrame(void);
+
+#endif // __R_FPS__
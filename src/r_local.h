@@ -33,6 +33,7 @@
 #include "r_data.h"
 #include "r_things.h"
 #include "r_draw.h"
+#include "r_threads.h"
 
 extern drawseg_t *firstseg;
 
@@ -19,6 +19,7 @@
 #include "r_local.h"
 #include "r_splats.h" // faB(21jan): testing
 #include "r_sky.h"
+#include "r_fps.h"
 #include "st_stuff.h"
 #include "p_local.h"
 #include "keys.h"
@@ -30,6 +31,8 @@
 #include "p_spec.h" // skyboxmo
 #include "z_zone.h"
 #include "m_random.h" // quake camera shake
+#include "m_bench.h"
+#include "m_trace.h"
 
 #ifdef HWRENDER
 #include "hardware/hw_main.h"
@@ -51,9 +54,10 @@ INT64 mytotal = 0;
 // increment every time a check is made
 size_t validcount = 1;
 
-INT32 centerx, centery;
+RENDERLOCAL INT32 centerx, centery;
 
-fixed_t centerxfrac, centeryfrac;
+fixed_t centerxfrac;
+RENDERLOCAL fixed_t centeryfrac;
 fixed_t projection;
 fixed_t projectiony; // aspect ratio
 
@@ -62,7 +66,7 @@ size_t framecount;
 
 size_t loopcount;
 
-fixed_t viewx, viewy, viewz;
+RENDERLOCAL fixed_t viewx, viewy, viewz;
 angle_t viewangle, aimingangle;
 fixed_t viewcos, viewsin;
 boolean viewsky, skyVisible;
@@ -161,6 +165,20 @@ consvar_t cv_precipdensity = {"precipdensity", "Moderate", CV_SAVE, precipdensit
 // Okay, whoever said homremoval causes a performance hit should be shot.
 consvar_t cv_homremoval = {"homremoval", "No", CV_SAVE, homremoval_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+#ifdef ESLOPE
+static CV_PossibleValue_t slopesubdivision_cons_t[] = {{1, "Exact"}, {4, "4"}, {8, "8"}, {16, "16"}, {32, "32"}, {0, NULL}};
+consvar_t cv_slopesubdivision = {"slopesubdivision", "16", CV_SAVE, slopesubdivision_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+#endif
+
+// Draw solid walls four columns at a time (R_DrawWallColumns4_8)
+consvar_t cv_quadcolumns = {"quadcolumns", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// Draw big flats from copies laid out in 8x8 blocks (R_GetTiledFlat).
+// Only pays off where the flats don't fit in the CPU's cache.
+consvar_t cv_tiledflats = {"tiledflats", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+consvar_t cv_planestats = {"r_planestats", "Off", 0, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 consvar_t cv_maxportals = {"maxportals", "2", CV_SAVE, maxportals_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 
 void SplitScreen_OnChange(void)
@@ -574,6 +592,10 @@ void R_SetViewSize(void)
 //
 void R_ExecuteSetViewSize(void)
 {
+	// what the slope and light tables were last worked out for
+	static INT32 slopeviewheight = 0, slopecenterx = 0;
+	static INT32 lightvidwidth = 0, lightviewwidth = 0;
+	static lighttable_t *lightcolormaps = NULL;
 	fixed_t dy;
 	INT32 i;
 	INT32 j;
@@ -622,8 +644,11 @@ void R_ExecuteSetViewSize(void)
 	R_SetSkyScale();
 
 	// planes
-	if (rendermode == render_soft)
+	if (rendermode == render_soft && (viewheight != slopeviewheight || centerx != slopecenterx))
 	{
+		slopeviewheight = viewheight;
+		slopecenterx = centerx;
+
 		// this is only used for planes rendering in software mode
 		j = viewheight*16;
 		for (i = 0; i < j; i++)
@@ -634,23 +659,30 @@ void R_ExecuteSetViewSize(void)
 		}
 	}
 
-	memset(scalelight, 0xFF, sizeof(scalelight));
-
 	// Calculate the light levels to use for each level/scale combination.
-	for (i = 0; i< LIGHTLEVELS; i++)
+	// They only depend on how wide the view is next to the screen, and
+	// that almost never changes, even for splitscreen.
+	if (vid.width != lightvidwidth || viewwidth != lightviewwidth || colormaps != lightcolormaps)
 	{
-		startmapl = ((LIGHTLEVELS - 1 - i)*2)*NUMCOLORMAPS/LIGHTLEVELS;
-		for (j = 0; j < MAXLIGHTSCALE; j++)
+		lightvidwidth = vid.width;
+		lightviewwidth = viewwidth;
+		lightcolormaps = colormaps;
+
+		for (i = 0; i< LIGHTLEVELS; i++)
 		{
-			level = startmapl - j*vid.width/(viewwidth)/DISTMAP;
+			startmapl = ((LIGHTLEVELS - 1 - i)*2)*NUMCOLORMAPS/LIGHTLEVELS;
+			for (j = 0; j < MAXLIGHTSCALE; j++)
+			{
+				level = startmapl - j*vid.width/(viewwidth)/DISTMAP;
 
-			if (level < 0)
-				level = 0;
+				if (level < 0)
+					level = 0;
 
-			if (level >= NUMCOLORMAPS)
-				level = NUMCOLORMAPS - 1;
+				if (level >= NUMCOLORMAPS)
+					level = NUMCOLORMAPS - 1;
 
-			scalelight[i][j] = colormaps + level*256;
+				scalelight[i][j] = colormaps + level*256;
+			}
 		}
 	}
 
@@ -682,10 +714,14 @@ void R_Init(void)
 
 	// this is now done by SCR_Recalc() at the first mode set
 	//I_OutputMsg("\nR_InitLightTables");
+	TRACE_BEGIN("render", "Light tables");
 	R_InitLightTables();
+	TRACE_END();
 
 	//I_OutputMsg("\nR_InitTranslationTables\n");
+	TRACE_BEGIN("render", "Translation tables");
 	R_InitTranslationTables();
+	TRACE_END();
 
 	R_InitDrawNodes();
 
@@ -766,6 +802,19 @@ static void R_SetupFreelook(void)
 
 #undef AIMINGTODY
 
+// Turns the first person view by the mouse motion the game hasn't used yet
+static void R_LookAhead(void)
+{
+	angle_t turn;
+	INT32 aim;
+
+	G_MouseLookAhead(&turn, &aim);
+	viewangle += turn;
+	aim += localaiming;
+	G_ClipAimingPitch(&aim);
+	aimingangle = (angle_t)aim;
+}
+
 void R_SetupFrame(player_t *player, boolean skybox)
 {
 	camera_t *thiscam;
@@ -831,6 +880,8 @@ void R_SetupFrame(player_t *player, boolean skybox)
 			{
 				viewangle = localangle; // WARNING: camera uses this
 				aimingangle = localaiming;
+				if (cv_lateinput.value)
+					R_LookAhead();
 			}
 			else if (player == &players[secondarydisplayplayer])
 			{
@@ -914,6 +965,8 @@ void R_SkyboxFrame(player_t *player)
 			{
 				viewangle = localangle; // WARNING: camera uses this
 				aimingangle = localaiming;
+				if (cv_lateinput.value)
+					R_LookAhead();
 			}
 			else if (player == &players[secondarydisplayplayer])
 			{
@@ -1161,12 +1214,114 @@ static void R_PortalFrame(line_t *start, line_t *dest, portal_pair *portal)
 #endif
 }
 
+//
+// FRAME ARENA
+//
+// Scratch space that only lasts until the next view is rendered. Taking
+// from it is just moving a pointer, and nothing is ever freed on its own;
+// R_ResetFrameArena takes it all back at once.
+//
+
+typedef struct framechunk_s
+{
+	struct framechunk_s *next;
+	size_t size, used;
+} framechunk_t;
+
+#define FRAMECHUNKSIZE (64<<10)
+#define FRAMEALIGN 16
+#define FRAMECHUNKHEADER ((sizeof (framechunk_t) + FRAMEALIGN-1) & ~(size_t)(FRAMEALIGN-1))
+
+static framechunk_t *framechunks = NULL, *framechunk = NULL;
+framearenastats_t framearenastats;
+
+static framechunk_t *R_NewFrameChunk(size_t size)
+{
+	framechunk_t *chunk = malloc(FRAMECHUNKHEADER + size);
+
+	if (!chunk)
+		I_Error("No more free memory for the frame arena");
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	framearenastats.allocated += size;
+	framearenastats.chunks++;
+	return chunk;
+}
+
+//
+// R_FrameAlloc
+//
+// Takes size bytes from the frame arena. They're good until the next
+// R_ResetFrameArena.
+//
+void *R_FrameAlloc(size_t size)
+{
+	framechunk_t *chunk;
+	void *p;
+
+	size = (size + FRAMEALIGN-1) & ~(size_t)(FRAMEALIGN-1);
+
+	if (!framechunk)
+		framechunks = framechunk = R_NewFrameChunk(max(size, FRAMECHUNKSIZE));
+
+	while (framechunk->used + size > framechunk->size)
+	{
+		if (framechunk->next && framechunk->next->size >= size)
+			framechunk = framechunk->next;
+		else
+		{
+			chunk = R_NewFrameChunk(max(size, FRAMECHUNKSIZE));
+			chunk->next = framechunk->next;
+			framechunk->next = chunk;
+			framechunk = chunk;
+		}
+	}
+
+	p = (UINT8 *)framechunk + FRAMECHUNKHEADER + framechunk->used;
+	framechunk->used += size;
+	framearenastats.used += size;
+	if (framearenastats.used > framearenastats.peak)
+		framearenastats.peak = framearenastats.used;
+	return p;
+}
+
+//
+// R_ResetFrameArena
+//
+// Takes back everything R_FrameAlloc handed out. If that took more than
+// one chunk, they're swapped for a single one big enough for all of it.
+//
+void R_ResetFrameArena(void)
+{
+	framechunk_t *chunk, *next;
+
+	if (framechunks && framechunks->next)
+	{
+		size_t total = framearenastats.allocated;
+
+		for (chunk = framechunks; chunk; chunk = next)
+		{
+			next = chunk->next;
+			free(chunk);
+		}
+		framearenastats.allocated = 0;
+		framearenastats.chunks = 0;
+		framechunks = R_NewFrameChunk(total);
+	}
+
+	for (chunk = framechunks; chunk; chunk = chunk->next)
+		chunk->used = 0;
+	framechunk = framechunks;
+	framearenastats.used = 0;
+}
+
 void R_AddPortal(INT32 line1, INT32 line2, INT32 x1, INT32 x2)
 {
-	portal_pair *portal = Z_Malloc(sizeof(portal_pair), PU_LEVEL, NULL);
-	INT16 *ceilingclipsave = Z_Malloc(sizeof(INT16)*(x2-x1), PU_LEVEL, NULL);
-	INT16 *floorclipsave = Z_Malloc(sizeof(INT16)*(x2-x1), PU_LEVEL, NULL);
-	fixed_t *frontscalesave = Z_Malloc(sizeof(fixed_t)*(x2-x1), PU_LEVEL, NULL);
+	portal_pair *portal = R_FrameAlloc(sizeof(portal_pair));
+	INT16 *ceilingclipsave = R_FrameAlloc(sizeof(INT16)*(x2-x1));
+	INT16 *floorclipsave = R_FrameAlloc(sizeof(INT16)*(x2-x1));
+	fixed_t *frontscalesave = R_FrameAlloc(sizeof(fixed_t)*(x2-x1));
 
 	portal->line1 = line1;
 	portal->line2 = line2;
@@ -1208,6 +1363,125 @@ void R_AddPortal(INT32 line1, INT32 line2, INT32 x1, INT32 x2)
 //                     FAB NOTE FOR WIN32 PORT !! I'm not finished already,
 // but I suspect network may have problems with the video buffer being locked
 // for all duration of rendering, and being released only once at the end..
+//
+// SKYBOX VIEW CACHE
+//
+// Drawing the skybox view again gives the same picture as long as it's
+// seen from the same place, and nothing in the world has moved: no tic
+// has run and the frame isn't drawn any further in between tics. That's
+// every frame while the game is paused or waiting on the network, and
+// every frame past the first in a tic with uncapped frames and no
+// interpolation. Each screen of a splitscreen game keeps its own copy.
+//
+
+consvar_t cv_skyboxcache = {"r_skyboxcache", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct
+{
+	fixed_t x, y, z;
+	angle_t angle, aiming;
+	sector_t *sector;
+	mobj_t *skybox;
+	INT32 windowx, windowy, width, height;
+	INT16 map;
+	tic_t time;
+	fixed_t frac;
+	INT32 drawdist, translucency;
+} skyboxkey_t;
+
+typedef struct
+{
+	boolean valid;
+	skyboxkey_t key;
+	UINT8 *pixels;
+	size_t size;
+} skyboxcache_t;
+
+static skyboxcache_t skyboxcaches[2];
+
+static void R_SkyboxKey(skyboxkey_t *key)
+{
+	memset(key, 0, sizeof (*key)); // compared with memcmp
+	key->x = viewx;
+	key->y = viewy;
+	key->z = viewz;
+	key->angle = viewangle;
+	key->aiming = aimingangle;
+	key->sector = viewsector;
+	key->skybox = skyboxmo[0];
+	key->windowx = viewwindowx;
+	key->windowy = viewwindowy;
+	key->width = viewwidth;
+	key->height = viewheight;
+	key->map = gamemap;
+	key->time = leveltime;
+	key->frac = rendertimefrac;
+	key->drawdist = cv_drawdist.value;
+	key->translucency = cv_translucency.value;
+}
+
+// Copies the view window between the screen and the cache.
+static void R_CopySkyboxView(skyboxcache_t *cache, boolean save)
+{
+	UINT8 *dest = screens[0] + viewwindowy*vid.width + viewwindowx;
+	UINT8 *src = cache->pixels;
+	INT32 y;
+
+	for (y = 0; y < viewheight; y++, dest += vid.width, src += viewwidth)
+	{
+		if (save)
+			M_Memcpy(src, dest, viewwidth);
+		else
+			M_Memcpy(dest, src, viewwidth);
+	}
+}
+
+//
+// R_DrawCachedSkybox
+//
+// Puts the skybox view the cache has for this screen back, if it's still
+// good, now that R_SkyboxFrame has set the view up.
+//
+static boolean R_DrawCachedSkybox(INT32 screen, skyboxkey_t *key)
+{
+	skyboxcache_t *cache = &skyboxcaches[screen];
+
+	R_SkyboxKey(key);
+	if (!cv_skyboxcache.value || !cache->valid || memcmp(&cache->key, key, sizeof (*key)))
+		return false;
+
+	R_CopySkyboxView(cache, false);
+	return true;
+}
+
+//
+// R_CacheSkybox
+//
+// Keeps the skybox view just drawn for next frame.
+//
+static void R_CacheSkybox(INT32 screen, const skyboxkey_t *key)
+{
+	skyboxcache_t *cache = &skyboxcaches[screen];
+	const size_t size = (size_t)viewwidth*viewheight;
+
+	cache->valid = false;
+	if (!cv_skyboxcache.value || vid.bpp != 1)
+		return;
+
+	if (cache->size < size)
+	{
+		UINT8 *pixels = realloc(cache->pixels, size);
+		if (!pixels)
+			return;
+		cache->pixels = pixels;
+		cache->size = size;
+	}
+
+	R_CopySkyboxView(cache, true);
+	cache->key = *key;
+	cache->valid = true;
+}
+
 // I mean, there is a win16lock() or something that lasts all the rendering,
 // so maybe we should release screen lock before each netupdate below..?
 
@@ -1215,6 +1489,8 @@ void R_RenderPlayerView(player_t *player)
 {
 	portal_pair *portal;
 	const boolean skybox = (skyboxmo[0] && cv_skybox.value);
+	const INT32 screen = (splitscreen && player == &players[secondarydisplayplayer]) ? 1 : 0;
+	skyboxkey_t skyboxkey;
 
 	if (cv_homremoval.value && player == &players[displayplayer]) // if this is display player 1
 	{
@@ -1225,33 +1501,52 @@ void R_RenderPlayerView(player_t *player)
 	}
 
 	// load previous saved value of skyVisible for the player
-	if (splitscreen && player == &players[secondarydisplayplayer])
+	if (screen == 1)
 		skyVisible = skyVisible2;
 	else
 		skyVisible = skyVisible1;
 
 	portalrender = 0;
 	portal_base = portal_cap = NULL;
+	R_ResetFrameArena();
+
+	R_StartDrawQueue();
 
 	if (skybox && skyVisible)
 	{
+		BENCH_STAGE(BR_SKY);
 		R_SkyboxFrame(player);
 
-		R_ClearClipSegs();
-		R_ClearDrawSegs();
-		R_ClearPlanes();
-		R_ClearSprites();
+		if (!R_DrawCachedSkybox(screen, &skyboxkey))
+		{
+			R_ClearClipSegs();
+			R_ClearDrawSegs();
+			R_ClearPlanes();
+			R_ClearSprites();
 #ifdef FLOORSPLATS
-		R_ClearVisibleFloorSplats();
+			R_ClearVisibleFloorSplats();
 #endif
 
-		R_RenderBSPNode((INT32)numnodes - 1);
-		R_ClipSprites();
-		R_DrawPlanes();
+			R_RenderBSPNode((INT32)numnodes - 1);
+			R_AddPrecipitationSprites();
+			R_ClipSprites();
+			R_DrawPlanes();
 #ifdef FLOORSPLATS
-		R_DrawVisibleFloorSplats();
+			R_DrawVisibleFloorSplats();
 #endif
-		R_DrawMasked();
+			R_DrawMasked();
+
+			// The main view's frame setup changes things the drawers use.
+			R_FinishDrawQueue();
+			R_StartDrawQueue();
+
+			// Portals seen from the skybox are drawn with the main view
+			if (portal_base)
+				skyboxcaches[screen].valid = false;
+			else
+				R_CacheSkybox(screen, &skyboxkey);
+		}
+		BENCH_STAGE(BR_OTHER);
 	}
 
 	R_SetupFrame(player, skybox);
@@ -1278,7 +1573,9 @@ void R_RenderPlayerView(player_t *player)
 	mytotal = 0;
 	ProfZeroTimer();
 #endif
+	BENCH_STAGE(BR_BSP);
 	R_RenderBSPNode((INT32)numnodes - 1);
+	R_AddPrecipitationSprites();
 	R_ClipSprites();
 #ifdef TIMING
 	RDMSR(0x10, &mycount);
@@ -1304,28 +1601,34 @@ void R_RenderPlayerView(player_t *player)
 		validcount++;
 
 		R_RenderBSPNode((INT32)numnodes - 1);
+		R_AddPrecipitationSprites();
 		R_ClipSprites();
 		//R_DrawPlanes();
 		//R_DrawMasked();
 
-		// okay done. free it.
+		// okay done. the frame arena takes it back next view.
 		portalcullsector = NULL; // Just in case...
 		portal_base = portal->next;
-		Z_Free(portal->ceilingclip);
-		Z_Free(portal->floorclip);
-		Z_Free(portal->frontscale);
-		Z_Free(portal);
 	}
 	// END PORTAL RENDERING
 
+	BENCH_STAGE(BR_PLANES);
 	R_DrawPlanes();
 #ifdef FLOORSPLATS
 	R_DrawVisibleFloorSplats();
 #endif
 	// draw mid texture and sprite
 	// And now 3D floors/sides!
+	BENCH_STAGE(BR_MASKED);
 	R_DrawMasked();
 
+	BENCH_STAGE(BR_DRAWQUEUE);
+	if (splitscreen && screen == 0)
+		R_SendDrawQueue(); // drawn while the second view is gone through
+	else
+		R_FinishDrawQueue();
+	BENCH_STAGE(BR_OTHER);
+
 	// Check for new console commands.
 	NetUpdate();
 
@@ -1360,6 +1663,17 @@ void R_RegisterEngineStuff(void)
 	CV_RegisterVar(&cv_drawdist);
 	CV_RegisterVar(&cv_drawdist_nights);
 	CV_RegisterVar(&cv_drawdist_precip);
+	CV_RegisterVar(&cv_planestats);
+	CV_RegisterVar(&cv_quadcolumns);
+	CV_RegisterVar(&cv_tiledflats);
+	CV_RegisterVar(&cv_skyboxcache);
+	CV_RegisterVar(&cv_frameinterpolation);
+	CV_RegisterVar(&cv_fpscap);
+	CV_RegisterVar(&cv_lateinput);
+	CV_RegisterVar(&cv_texturecachesize);
+#ifdef ESLOPE
+	CV_RegisterVar(&cv_slopesubdivision);
+#endif
 
 	CV_RegisterVar(&cv_chasecam);
 	CV_RegisterVar(&cv_chasecam2);
@@ -1385,6 +1699,9 @@ void R_RegisterEngineStuff(void)
 	CV_RegisterVar(&cv_translucenthud);
 
 	CV_RegisterVar(&cv_maxportals);
+#ifdef RENDERTHREADS
+	CV_RegisterVar(&cv_renderthreads);
+#endif
 
 	// Default viewheight is changeable,
 	// initialized to standard viewheight
@@ -22,9 +22,10 @@
 //
 extern fixed_t viewcos, viewsin;
 extern INT32 viewheight;
-extern INT32 centerx, centery;
+extern RENDERLOCAL INT32 centerx, centery;
 
-extern fixed_t centerxfrac, centeryfrac;
+extern fixed_t centerxfrac;
+extern RENDERLOCAL fixed_t centeryfrac;
 extern fixed_t projection, projectiony;
 
 extern size_t validcount, linecount, loopcount, framecount;
@@ -80,6 +81,11 @@ extern consvar_t cv_shadow, cv_shadowoffs;
 extern consvar_t cv_translucency;
 extern consvar_t cv_precipdensity, cv_drawdist, cv_drawdist_nights, cv_drawdist_precip;
 extern consvar_t cv_skybox;
+extern consvar_t cv_planestats;
+extern consvar_t cv_quadcolumns, cv_tiledflats;
+#ifdef ESLOPE
+extern consvar_t cv_slopesubdivision;
+#endif
 extern consvar_t cv_tailspickup;
 
 // Called by startup code.
@@ -95,6 +101,21 @@ void R_ExecuteSetViewSize(void);
 void R_SkyboxFrame(player_t *player);
 
 void R_SetupFrame(player_t *player, boolean skybox);
+
+// Scratch memory for the view being rendered, for the r_planestats overlay.
+typedef struct
+{
+	size_t used; // by this view so far
+	size_t peak; // most any view has used
+	size_t allocated; // in chunks, kept between views
+	UINT32 chunks;
+} framearenastats_t;
+
+extern framearenastats_t framearenastats;
+
+void *R_FrameAlloc(size_t size);
+void R_ResetFrameArena(void);
+
 // Called by G_Drawer.
 void R_RenderPlayerView(player_t *player);
 
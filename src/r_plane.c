@@ -46,11 +46,25 @@
 #define SHITPLANESPARENCY
 
 //SoM: 3/23/2000: Use Boom visplane hashing.
-#define MAXVISPLANES 512
-
 static visplane_t *visplanes[MAXVISPLANES];
-static visplane_t *freetail;
-static visplane_t **freehead = &freetail;
+
+// Visplanes come out of chunks that are kept around and handed out again
+// from the start every time the planes are cleared.
+#define VISPLANECHUNK 32
+
+typedef struct visplanechunk_s
+{
+	struct visplanechunk_s *next;
+	INT32 width; // screen width the columns were made for
+	UINT16 *columns; // every plane's top and bottom
+	visplane_t planes[VISPLANECHUNK];
+} visplanechunk_t;
+
+static visplanechunk_t *visplanechunks, *curvisplanechunk;
+static size_t chunkplanesused;
+static size_t numvisplanechunks;
+
+planestats_t planestats;
 
 visplane_t *floorplane;
 visplane_t *ceilingplane;
@@ -60,8 +74,10 @@ visffloor_t ffloor[MAXFFLOORS];
 INT32 numffloors;
 
 //SoM: 3/23/2000: Boom visplane hashing routine.
+// Heights are almost always whole map units, so the fractional bits are
+// shifted out first or they would put every height in the same bucket.
 #define visplane_hash(picnum,lightlevel,height) \
-  ((unsigned)((picnum)*3+(lightlevel)+(height)*7) & (MAXVISPLANES-1))
+  ((unsigned)((picnum)*3+(lightlevel)+((height)>>FRACBITS)*7) & (MAXVISPLANES-1))
 
 //SoM: 3/23/2000: Use boom opening limit removal
 size_t maxopenings;
@@ -84,7 +100,7 @@ static INT32 spanstart[MAXVIDHEIGHT];
 //
 // texture mapping
 //
-lighttable_t **planezlight;
+RENDERLOCAL lighttable_t **planezlight;
 static fixed_t planeheight;
 
 //added : 10-02-98: yslopetab is what yslope used to be,
@@ -341,7 +357,7 @@ void R_MapPlane(INT32 y, INT32 x1, INT32 x2)
 	ProfZeroTimer();
 #endif
 
-	spanfunc();
+	R_DrawSpanFunc(spanfunc);
 
 #ifdef TIMING
 	RDMSR(0x10, &mycount);
@@ -375,12 +391,9 @@ void R_ClearPlanes(void)
 
 	numffloors = 0;
 
-	for (i = 0; i < MAXVISPLANES; i++)
-	for (*freehead = visplanes[i], visplanes[i] = NULL;
-		freehead && *freehead ;)
-	{
-		freehead = &(*freehead)->next;
-	}
+	memset(visplanes, 0, sizeof (visplanes));
+	curvisplanechunk = NULL;
+	chunkplanesused = 0;
 
 	lastopening = openings;
 
@@ -397,18 +410,54 @@ void R_ClearPlanes(void)
 
 static visplane_t *new_visplane(unsigned hash)
 {
-	visplane_t *check = freetail;
-	if (!check)
-	{
-		check = calloc(2, sizeof (*check));
-		if (check == NULL) I_Error("%s: Out of memory", "new_visplane"); // FIXME: ugly
-	}
-	else
+	visplane_t *check;
+
+	if (!curvisplanechunk || chunkplanesused == VISPLANECHUNK)
 	{
-		freetail = freetail->next;
-		if (!freetail)
-			freehead = &freetail;
+		visplanechunk_t *chunk = curvisplanechunk ? curvisplanechunk->next : visplanechunks;
+
+		if (!chunk)
+		{
+			chunk = malloc(sizeof (*chunk));
+			if (chunk == NULL)
+				I_Error("%s: Out of memory", "new_visplane");
+			chunk->next = NULL;
+			chunk->width = 0;
+			chunk->columns = NULL;
+			if (curvisplanechunk)
+				curvisplanechunk->next = chunk;
+			else
+				visplanechunks = chunk;
+			numvisplanechunks++;
+			planestats.allocated = numvisplanechunks*VISPLANECHUNK;
+		}
+
+		curvisplanechunk = chunk;
+		chunkplanesused = 0;
+
+		// Give the planes columns for the screen as it is now, rather
+		// than for the biggest screen there could be
+		if (chunk->width != vid.width)
+		{
+			const size_t span = vid.width + 2;
+			size_t i;
+
+			free(chunk->columns);
+			chunk->columns = malloc(VISPLANECHUNK * 2 * span * sizeof (*chunk->columns));
+			if (chunk->columns == NULL)
+				I_Error("%s: Out of memory", "new_visplane");
+			for (i = 0; i < VISPLANECHUNK; i++)
+			{
+				chunk->planes[i].top = chunk->columns + 2*span*i + 1;
+				chunk->planes[i].bottom = chunk->planes[i].top + span;
+			}
+			chunk->width = vid.width;
+		}
 	}
+
+	check = &curvisplanechunk->planes[chunkplanesused++];
+	planestats.planes++;
+
 	check->next = visplanes[hash];
 	visplanes[hash] = check;
 	return check;
@@ -459,8 +508,10 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 	// New visplane algorithm uses hash table
 	hash = visplane_hash(picnum, lightlevel, height);
 
+	planestats.lookups++;
 	for (check = visplanes[hash]; check; check = check->next)
 	{
+		planestats.probes++;
 #ifdef POLYOBJECTS_PLANES
 		if (check->polyobj && pfloor)
 			continue;
@@ -506,8 +557,8 @@ visplane_t *R_FindPlane(fixed_t height, INT32 picnum, INT32 lightlevel,
 	check->slope = slope;
 #endif
 
-	memset(check->top, 0xff, sizeof (check->top));
-	memset(check->bottom, 0x00, sizeof (check->bottom));
+	memset(check->top, 0xff, vid.width * sizeof (*check->top));
+	memset(check->bottom, 0x00, vid.width * sizeof (*check->bottom));
 
 	return check;
 }
@@ -559,6 +610,7 @@ visplane_t *R_CheckPlane(visplane_t *pl, INT32 start, INT32 stop)
 			visplane_hash(pl->picnum, pl->lightlevel, pl->height);
 		visplane_t *new_pl = new_visplane(hash);
 
+		planestats.splits++;
 		new_pl->height = pl->height;
 		new_pl->picnum = pl->picnum;
 		new_pl->lightlevel = pl->lightlevel;
@@ -580,8 +632,8 @@ visplane_t *R_CheckPlane(visplane_t *pl, INT32 start, INT32 stop)
 		pl = new_pl;
 		pl->minx = start;
 		pl->maxx = stop;
-		memset(pl->top, 0xff, sizeof pl->top);
-		memset(pl->bottom, 0x00, sizeof pl->bottom);
+		memset(pl->top, 0xff, vid.width * sizeof (*pl->top));
+		memset(pl->bottom, 0x00, vid.width * sizeof (*pl->bottom));
 	}
 	return pl;
 }
@@ -663,16 +715,46 @@ void R_MakeSpans(INT32 x, INT32 t1, INT32 b1, INT32 t2, INT32 b2)
 		spanstart[b2--] = x;
 }
 
+void R_ResetPlaneStats(void)
+{
+	memset(&planestats, 0, sizeof (planestats));
+	planestats.allocated = numvisplanechunks*VISPLANECHUNK;
+}
+
+// Hash chain lengths for the r_planestats overlay
+static void R_CountPlaneChains(void)
+{
+	visplane_t *pl;
+	UINT32 buckets = 0, chain;
+	INT32 i;
+
+	for (i = 0; i < MAXVISPLANES; i++)
+	{
+		if (!visplanes[i])
+			continue;
+		buckets++;
+		for (chain = 0, pl = visplanes[i]; pl; pl = pl->next)
+			chain++;
+		if (chain > planestats.maxchain)
+			planestats.maxchain = chain;
+	}
+	if (buckets > planestats.buckets)
+		planestats.buckets = buckets;
+}
+
 void R_DrawPlanes(void)
 {
 	visplane_t *pl;
 	INT32 x;
-	INT32 angle;
 	INT32 i;
+	UINT8 **skycolumns;
 
 	spanfunc = basespanfunc;
 	wallcolfunc = walldrawerfunc;
 
+	if (cv_planestats.value)
+		R_CountPlaneChains();
+
 	for (i = 0; i < MAXVISPLANES; i++, pl++)
 	{
 		for (pl = visplanes[i]; pl; pl = pl->next)
@@ -697,6 +779,7 @@ void R_DrawPlanes(void)
 				dc_texturemid = skytexturemid;
 				dc_texheight = textureheight[skytexture]
 					>>FRACBITS;
+				skycolumns = R_GetSkyColumns(pl->viewangle);
 				for (x = pl->minx; x <= pl->maxx; x++)
 				{
 					dc_yl = pl->top[x];
@@ -704,12 +787,9 @@ void R_DrawPlanes(void)
 
 					if (dc_yl <= dc_yh)
 					{
-						angle = (pl->viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
 						dc_x = x;
-						dc_source =
-							R_GetColumn(skytexture,
-								angle);
-						wallcolfunc();
+						dc_source = skycolumns[x];
+						R_DrawColumnFunc(wallcolfunc);
 					}
 				}
 				continue;
@@ -738,6 +818,7 @@ void R_DrawSinglePlane(visplane_t *pl)
 	INT32 stop, angle;
 	size_t size;
 	ffloor_t *rover;
+	UINT8 *flat;
 
 	if (!(pl->minx <= pl->maxx))
 		return;
@@ -755,7 +836,7 @@ void R_DrawSinglePlane(visplane_t *pl)
 		if (pl->polyobj->translucency >= 10)
 			return; // Don't even draw it
 		else if (pl->polyobj->translucency > 0)
-			ds_transmap = transtables + ((pl->polyobj->translucency-1)<<FF_TRANSSHIFT);
+			ds_transmap = R_GetTranslucencyTable(pl->polyobj->translucency);
 		else // Opaque, but allow transparent flat pixels
 			spanfunc = splatfunc;
 
@@ -797,23 +878,23 @@ void R_DrawSinglePlane(visplane_t *pl)
 			if (pl->ffloor->alpha < 12)
 				return; // Don't even draw it
 			else if (pl->ffloor->alpha < 38)
-				ds_transmap = transtables + ((tr_trans90-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans90);
 			else if (pl->ffloor->alpha < 64)
-				ds_transmap = transtables + ((tr_trans80-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans80);
 			else if (pl->ffloor->alpha < 89)
-				ds_transmap = transtables + ((tr_trans70-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans70);
 			else if (pl->ffloor->alpha < 115)
-				ds_transmap = transtables + ((tr_trans60-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans60);
 			else if (pl->ffloor->alpha < 140)
-				ds_transmap = transtables + ((tr_trans50-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans50);
 			else if (pl->ffloor->alpha < 166)
-				ds_transmap = transtables + ((tr_trans40-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans40);
 			else if (pl->ffloor->alpha < 192)
-				ds_transmap = transtables + ((tr_trans30-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans30);
 			else if (pl->ffloor->alpha < 217)
-				ds_transmap = transtables + ((tr_trans20-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans20);
 			else if (pl->ffloor->alpha < 243)
-				ds_transmap = transtables + ((tr_trans10-1)<<FF_TRANSSHIFT);
+				ds_transmap = R_GetTranslucencyTable(tr_trans10);
 			else // Opaque, but allow transparent flat pixels
 				spanfunc = splatfunc;
 
@@ -880,7 +961,7 @@ void R_DrawSinglePlane(visplane_t *pl)
 
 	currentplane = pl;
 
-	ds_source = (UINT8 *)
+	flat = ds_source = (UINT8 *)
 		W_CacheLumpNum(levelflats[pl->picnum].lumpnum,
 			PU_STATIC); // Stay here until Z_ChangeTag
 
@@ -932,6 +1013,22 @@ void R_DrawSinglePlane(visplane_t *pl)
 			break;
 	}
 
+	// Big flats go through the cache a lot better in tiles
+	if (cv_tiledflats.value && spanfunc == R_DrawSpan_8 && size >= 128*128
+#ifdef ESLOPE
+		&& !pl->slope
+#endif
+		&& size == (size_t)1 << (2*(32 - nflatxshift)))
+	{
+		UINT8 *tiled = R_GetTiledFlat(levelflats[pl->picnum].lumpnum, 32 - nflatxshift);
+
+		if (tiled)
+		{
+			ds_source = tiled;
+			spanfunc = R_DrawTiledSpan_8;
+		}
+	}
+
 	xoffs = pl->xoffs;
 	yoffs = pl->yoffs;
 	planeheight = abs(pl->height - pl->viewz);
@@ -1086,7 +1183,7 @@ using the palette colors.
 	if (spanfunc == R_DrawSpan_8)
 	{
 		INT32 i;
-		ds_transmap = transtables + ((tr_trans50-1)<<FF_TRANSSHIFT);
+		ds_transmap = R_GetTranslucencyTable(tr_trans50);
 		spanfunc = R_DrawTranslucentSpan_8;
 		for (i=0; i<4; i++)
 		{
@@ -1137,7 +1234,7 @@ using the palette colors.
 	}
 #endif
 
-	Z_ChangeTag(ds_source, PU_CACHE);
+	Z_ChangeTag(flat, PU_CACHE);
 }
 
 void R_PlaneBounds(visplane_t *plane)
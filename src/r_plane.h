@@ -37,9 +37,8 @@ typedef struct visplane_s
 	// colormaps per sector
 	extracolormap_t *extra_colormap;
 
-	// leave pads for [minx-1]/[maxx+1]
-	UINT16 padtopstart, top[MAXVIDWIDTH], padtopend;
-	UINT16 padbottomstart, bottom[MAXVIDWIDTH], padbottomend;
+	// vid.width columns each, with pads for [minx-1]/[maxx+1]
+	UINT16 *top, *bottom;
 	INT32 high, low; // R_PlaneBounds should set these.
 
 	fixed_t xoffs, yoffs; // Scrolling flats.
@@ -56,6 +55,21 @@ typedef struct visplane_s
 extern visplane_t *floorplane;
 extern visplane_t *ceilingplane;
 
+// Visplane hash buckets. There is no limit on the planes themselves.
+#define MAXVISPLANES 512
+
+// Counted over a frame, for the r_planestats overlay.
+typedef struct
+{
+	UINT32 planes; // handed out from the pool
+	UINT32 splits; // new planes made by R_CheckPlane
+	UINT32 lookups, probes; // R_FindPlane calls, and planes compared in them
+	UINT32 buckets, maxchain; // hash buckets in use and longest chain, worst view
+	size_t allocated; // size of the pool
+} planestats_t;
+
+extern planestats_t planestats;
+
 // Visplane related.
 extern INT16 *lastopening, *openings;
 extern size_t maxopenings;
@@ -69,12 +83,13 @@ extern fixed_t cachedystep[MAXVIDHEIGHT];
 extern fixed_t basexscale, baseyscale;
 
 extern fixed_t *yslope;
-extern lighttable_t **planezlight;
+extern RENDERLOCAL lighttable_t **planezlight;
 
 void R_InitPlanes(void);
 void R_PortalStoreClipValues(INT32 start, INT32 end, INT16 *ceil, INT16 *floor, fixed_t *scale);
 void R_PortalRestoreClipValues(INT32 start, INT32 end, INT16 *ceil, INT16 *floor, fixed_t *scale);
 void R_ClearPlanes(void);
+void R_ResetPlaneStats(void);
 
 void R_MapPlane(INT32 y, INT32 x1, INT32 x2);
 void R_MakeSpans(INT32 x, INT32 t1, INT32 b1, INT32 t2, INT32 b2);
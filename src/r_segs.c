@@ -24,6 +24,7 @@
 #include "p_local.h" // Camera...
 #include "p_slopes.h"
 #include "console.h" // con_clipviewtop
+#include "m_bench.h"
 
 // OPTIMIZE: closed two sided lines as single sided
 
@@ -105,7 +106,7 @@ static void R_DrawSplatColumn(column_t *column)
 			dc_texturemid = basetexturemid - (topdelta<<FRACBITS);
 
 			// Drawn by R_DrawColumn.
-			colfunc();
+			R_DrawColumnFunc(colfunc);
 		}
 		column = (column_t *)((UINT8 *)column + column->length + 4);
 	}
@@ -183,7 +184,7 @@ static void R_DrawWallSplats(void)
 					colfunc = basecolfunc;
 				else
 				{
-					dc_transmap = transtables + ((tr_trans50 - 1)<<FF_TRANSSHIFT);
+					dc_transmap = R_GetTranslucencyTable(tr_trans50);
 					colfunc = fuzzcolfunc;
 				}
 
@@ -274,7 +275,7 @@ static void R_Render2sidedMultiPatchColumn(column_t *column)
 		else if (colfunc == fuzzcolfunc)
 			twosmultipatchtransfunc();
 		else
-			colfunc();
+			R_DrawColumnFunc(colfunc);
 	}
 }
 
@@ -318,7 +319,7 @@ void R_RenderMaskedSegRange(drawseg_t *ds, INT32 x1, INT32 x2)
 		case 906:
 		case 907:
 		case 908:
-			dc_transmap = transtables + ((ldef->special-900)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(ldef->special-899);
 			colfunc = fuzzcolfunc;
 			break;
 		case 909:
@@ -336,7 +337,7 @@ void R_RenderMaskedSegRange(drawseg_t *ds, INT32 x1, INT32 x2)
 		if (curline->polyseg->translucency >= NUMTRANSMAPS)
 			return;
 
-		dc_transmap = transtables + ((curline->polyseg->translucency-1)<<FF_TRANSSHIFT);
+		dc_transmap = R_GetTranslucencyTable(curline->polyseg->translucency);
 		colfunc = fuzzcolfunc;
 	}
 
@@ -782,23 +783,23 @@ void R_RenderThickSideRange(drawseg_t *ds, INT32 x1, INT32 x2, ffloor_t *pfloor)
 		if (pfloor->alpha < 12)
 			return; // Don't even draw it
 		else if (pfloor->alpha < 38)
-			dc_transmap = transtables + ((tr_trans90-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans90);
 		else if (pfloor->alpha < 64)
-			dc_transmap = transtables + ((tr_trans80-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans80);
 		else if (pfloor->alpha < 89)
-			dc_transmap = transtables + ((tr_trans70-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans70);
 		else if (pfloor->alpha < 115)
-			dc_transmap = transtables + ((tr_trans60-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans60);
 		else if (pfloor->alpha < 140)
-			dc_transmap = transtables + ((tr_trans50-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans50);
 		else if (pfloor->alpha < 166)
-			dc_transmap = transtables + ((tr_trans40-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans40);
 		else if (pfloor->alpha < 192)
-			dc_transmap = transtables + ((tr_trans30-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans30);
 		else if (pfloor->alpha < 217)
-			dc_transmap = transtables + ((tr_trans20-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans20);
 		else if (pfloor->alpha < 243)
-			dc_transmap = transtables + ((tr_trans10-1)<<FF_TRANSSHIFT);
+			dc_transmap = R_GetTranslucencyTable(tr_trans10);
 		else
 			fuzzy = false; // Opaque
 
@@ -1295,6 +1296,115 @@ UINT32 nombre = 100000;
 //profile stuff ---------------------------------------------------------
 
 
+// Wall columns waiting to be drawn four at a time. A column can have a
+// top and a bottom texture, so those are gathered apart.
+#define WALLTIERS 2
+static wallcolumn_t quadcols[WALLTIERS][4];
+static INT32 quadx[WALLTIERS]; // leftmost column of the four being gathered
+static UINT8 quadfilled[WALLTIERS]; // one bit per column gathered
+
+//
+// R_FlushWallColumns
+//
+// Draws whatever has been gathered for tier, four at a time if all of
+// them are there, otherwise one by one with wallcolfunc.
+//
+static void R_FlushWallColumns(INT32 tier)
+{
+	lighttable_t *colormap;
+	INT32 x, yl, yh, texheight;
+	fixed_t iscale, texturemid;
+	UINT8 *source;
+	INT32 i;
+
+	if (!quadfilled[tier])
+		return;
+
+	if (quadfilled[tier] == 15)
+	{
+		R_DrawWallColumns4_8(quadx[tier], quadcols[tier]);
+		quadfilled[tier] = 0;
+		return;
+	}
+
+	// The seg loop only sets some of these once per column
+	colormap = dc_colormap;
+	x = dc_x;
+	yl = dc_yl;
+	yh = dc_yh;
+	iscale = dc_iscale;
+	texturemid = dc_texturemid;
+	source = dc_source;
+	texheight = dc_texheight;
+
+	for (i = 0; i < 4; i++)
+	{
+		const wallcolumn_t *col = &quadcols[tier][i];
+
+		if (!(quadfilled[tier] & (1<<i)))
+			continue;
+		dc_colormap = col->colormap;
+		dc_x = quadx[tier] + i;
+		dc_yl = col->yl;
+		dc_yh = col->yh;
+		dc_iscale = col->iscale;
+		dc_texturemid = col->texturemid;
+		dc_source = col->source;
+		dc_texheight = col->texheight;
+		wallcolfunc();
+	}
+	quadfilled[tier] = 0;
+
+	dc_colormap = colormap;
+	dc_x = x;
+	dc_yl = yl;
+	dc_yh = yh;
+	dc_iscale = iscale;
+	dc_texturemid = texturemid;
+	dc_source = source;
+	dc_texheight = texheight;
+}
+
+//
+// R_DrawWallColumn
+//
+// Draws the column in the dc_ globals with colfunc, or gathers it to be
+// drawn with its neighbours when it's a plain wall.
+//
+static void R_DrawWallColumn(INT32 tier)
+{
+	wallcolumn_t *col;
+
+	if (!cv_quadcolumns.value || colfunc != wallcolfunc
+#ifdef RENDERTHREADS
+		|| r_queuedraws
+#endif
+		|| (dc_texheight & (dc_texheight - 1)) || dc_yl > dc_yh)
+	{
+		R_DrawColumnFunc(colfunc);
+		return;
+	}
+
+	if ((dc_x & ~3) != quadx[tier])
+	{
+		R_FlushWallColumns(tier);
+		quadx[tier] = dc_x & ~3;
+	}
+
+	col = &quadcols[tier][dc_x & 3];
+	col->source = dc_source;
+	col->colormap = dc_colormap;
+	col->iscale = dc_iscale;
+	col->texturemid = dc_texturemid;
+	col->yl = dc_yl;
+	col->yh = dc_yh;
+	col->texheight = dc_texheight;
+	quadfilled[tier] |= 1<<(dc_x & 3);
+
+	if (quadfilled[tier] == 15)
+		R_FlushWallColumns(tier);
+}
+
 static void R_RenderSegLoop (void)
 {
 	angle_t angle;
@@ -1515,7 +1625,7 @@ static void R_RenderSegLoop (void)
 #ifdef TIMING
 				ProfZeroTimer();
 #endif
-				colfunc();
+				R_DrawWallColumn(0);
 #ifdef TIMING
 				RDMSR(0x10,&mycount);
 				mytotal += mycount;      //64bit add
@@ -1563,7 +1673,7 @@ static void R_RenderSegLoop (void)
 						dc_texturemid = rw_toptexturemid;
 						dc_source = R_GetColumn(toptexture,texturecolumn);
 						dc_texheight = textureheight[toptexture]>>FRACBITS;
-						colfunc();
+						R_DrawWallColumn(0);
 						ceilingclip[rw_x] = (INT16)mid;
 					}
 					else // entirely off top of screen
@@ -1597,7 +1707,7 @@ static void R_RenderSegLoop (void)
 						dc_source = R_GetColumn(bottomtexture,
 							texturecolumn);
 						dc_texheight = textureheight[bottomtexture]>>FRACBITS;
-						colfunc();
+						R_DrawWallColumn(1);
 						floorclip[rw_x] = (INT16)mid;
 					}
 					else  // entirely off bottom of screen
@@ -1648,6 +1758,9 @@ static void R_RenderSegLoop (void)
 		topfrac += topstep;
 		bottomfrac += bottomstep;
 	}
+
+	R_FlushWallColumns(0);
+	R_FlushWallColumns(1);
 }
 
 // Uses precalculated seg->length
@@ -1672,7 +1785,7 @@ static INT64 R_CalcSegDist(seg_t* seg, INT64 x2, INT64 y2)
 // A wall segment will be drawn
 //  between start and stop pixels (inclusive).
 //
-void R_StoreWallRange(INT32 start, INT32 stop)
+static void R_DoStoreWallRange(INT32 start, INT32 stop)
 {
 	fixed_t       hyp;
 	fixed_t       sineval;
@@ -3156,3 +3269,15 @@ void R_StoreWallRange(INT32 start, INT32 stop)
 	}
 	ds_p++;
 }
+
+void R_StoreWallRange(INT32 start, INT32 stop)
+{
+	if (benchrendering)
+	{
+		const benchstage_t stage = M_BenchStage(BR_SEGS);
+		R_DoStoreWallRange(start, stop);
+		M_BenchStage(stage);
+	}
+	else
+		R_DoStoreWallRange(start, stop);
+}
@@ -50,6 +50,14 @@ fixed_t skyscale;
 INT32 levelskynum;
 INT32 globallevelskynum;
 
+/**	\brief the sky columns R_GetSkyColumns last worked out, and what for
+*/
+static UINT8 *skycolumns[MAXVIDWIDTH];
+static angle_t skycolumnsangle;
+static INT32 skycolumnstexture = -1;
+static UINT8 *skycolumnsdata; // the cached texture they point into
+static INT32 skycolumnswidth;
+
 /**	\brief	The R_SetupSkyDraw function
 
 	Called at loadlevel after skytexture is set, or when sky texture changes.
@@ -81,4 +89,34 @@ void R_SetSkyScale(void)
 {
 	fixed_t difference = vid.fdupx-(vid.dupx<<FRACBITS);
 	skyscale = FixedDiv(FRACUNIT, vid.fdupx+difference);
+
+	skycolumnstexture = -1; // xtoviewangle has changed
+}
+
+/**	\brief	The R_GetSkyColumns function
+
+	Every sky plane in a view needs the same sky column in each screen
+	column, so they're only looked up again when the view turns.
+
+	\param	angle	the view angle of the sky plane
+
+	\return	the column of skytexture for each column of the view
+*/
+UINT8 **R_GetSkyColumns(angle_t angle)
+{
+	UINT8 *data = R_CheckTextureCache(skytexture);
+	INT32 x;
+
+	if (angle == skycolumnsangle && skytexture == skycolumnstexture
+		&& data == skycolumnsdata && viewwidth == skycolumnswidth)
+		return skycolumns;
+
+	for (x = 0; x < viewwidth; x++)
+		skycolumns[x] = R_GetColumn(skytexture, (angle + xtoviewangle[x])>>ANGLETOSKYSHIFT);
+
+	skycolumnsangle = angle;
+	skycolumnstexture = skytexture;
+	skycolumnsdata = data;
+	skycolumnswidth = viewwidth;
+	return skycolumns;
 }
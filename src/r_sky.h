@@ -15,6 +15,7 @@
 #define __R_SKY__
 
 #include "m_fixed.h"
+#include "tables.h"
 
 #ifdef __GNUG__
 #pragma interface
@@ -38,4 +39,7 @@ void R_SetupSkyDraw(void);
 
 void R_SetSkyScale(void);
 
+// the sky texture column to draw in each column of the view, looking at angle
+UINT8 **R_GetSkyColumns(angle_t angle);
+
 #endif
@@ -33,10 +33,14 @@ typedef struct
 	fixed_t offset;
 	fixed_t topoffset;
 	fixed_t height;
+	lumpnum_t lumppat; // patch the above are read from, LUMPERROR once they have been
 } sprcache_t;
 
 extern sprcache_t *spritecachedinfo;
 
+// spritecachedinfo[lumpid], with the patch header read in if it hasn't been yet
+sprcache_t *R_GetSpriteCache(size_t lumpid);
+
 extern lighttable_t *colormaps;
 
 // Boom colormaps.
@@ -82,7 +86,7 @@ extern side_t *sides;
 //
 // POV data.
 //
-extern fixed_t viewx, viewy, viewz;
+extern RENDERLOCAL fixed_t viewx, viewy, viewz;
 extern angle_t viewangle, aimingangle;
 extern boolean viewsky, skyVisible;
 extern boolean skyVisible1, skyVisible2; // saved values of skyVisible for P1 and P2, for splitscreen
@@ -25,6 +25,7 @@
 #include "p_tick.h"
 #include "p_local.h"
 #include "p_slopes.h"
+#include "m_trace.h"
 #include "dehacked.h" // get_number (for thok)
 #include "d_netfil.h" // blargh. for nameonly().
 #include "m_cheat.h" // objectplace
@@ -147,28 +148,47 @@ static void R_InstallSpriteLump(UINT16 wad,            // graphics patch
 		sprtemp[frame].flip &= ~(1<<rotation);
 }
 
-// Install a single sprite, given its identifying name (4 chars)
-//
-// (originally part of R_AddSpriteDefs)
 //
-// Pass: name of sprite : 4 chars
-//       spritedef_t
-//       wadnum         : wad number, indexes wadfiles[], where patches
-//                        for frames are found
-//       startlump      : first lump to search for sprite frames
-//       endlump        : AFTER the last lump to search
+// R_GetSpriteCache
 //
-// Returns true if the sprite was succesfully added
+// The patch headers aren't read when a wad is added, only once something
+// using the frame is first projected, so sprites nobody sees cost nothing.
 //
-static boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16 wadnum, UINT16 startlump, UINT16 endlump)
+sprcache_t *R_GetSpriteCache(size_t lumpid)
 {
-	UINT16 l;
-	UINT8 frame;
-	UINT8 rotation;
-	lumpinfo_t *lumpinfo;
+	sprcache_t *info = &spritecachedinfo[lumpid];
 	patch_t patch;
-	UINT8 numadded = 0;
 
+	if (info->lumppat == LUMPERROR)
+		return info;
+
+	W_ReadLumpHeaderPwad(WADFILENUM(info->lumppat), LUMPNUM(info->lumppat), &patch, sizeof (patch_t), 0);
+	info->width = SHORT(patch.width)<<FRACBITS;
+	info->offset = SHORT(patch.leftoffset)<<FRACBITS;
+	info->topoffset = SHORT(patch.topoffset)<<FRACBITS;
+	info->height = SHORT(patch.height)<<FRACBITS;
+
+	//BP: we cannot use special tric in hardware mode because feet in ground caused by z-buffer
+	if (rendermode != render_none) // not for psprite
+		info->topoffset += 4<<FRACBITS;
+	// Being selective with this causes bad things. :( Like the special stage tokens breaking apart.
+	/*if (rendermode != render_none // not for psprite
+	 && SHORT(patch.topoffset)>0 && SHORT(patch.topoffset)<SHORT(patch.height))
+		// perfect is patch.height but sometime it is too high
+		info->topoffset = min(SHORT(patch.topoffset)+4,SHORT(patch.height))<<FRACBITS;*/
+
+	info->lumppat = LUMPERROR;
+	return info;
+}
+
+//
+// R_BeginSpriteDef
+//
+// Starts sprtemp off with the frames spritedef already has.
+//
+static void R_BeginSpriteDef(const char *sprname, spritedef_t *spritedef)
+{
+	spritename = sprname;
 	memset(sprtemp,0xFF, sizeof (sprtemp));
 	maxframe = (size_t)-1;
 
@@ -182,66 +202,63 @@ static boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef,
 		maxframe = spritedef->numframes - 1;
 	}
 
-	// scan the lumps,
-	//  filling in the frames for whatever is found
-	lumpinfo = wadfiles[wadnum]->lumpinfo;
-	if (endlump > wadfiles[wadnum]->numlumps)
-		endlump = wadfiles[wadnum]->numlumps;
+}
 
-	for (l = startlump; l < endlump; l++)
-	{
-		if (memcmp(lumpinfo[l].name,sprname,4)==0)
-		{
-			frame = R_Char2Frame(lumpinfo[l].name[4]);
-			rotation = (UINT8)(lumpinfo[l].name[5] - '0');
+//
+// R_AddSpriteLump
+//
+// Puts lump l of wadnum into sprtemp, if it's a sprite frame at all.
+// Returns true if it was.
+//
+static boolean R_AddSpriteLump(UINT16 wadnum, UINT16 l)
+{
+	lumpinfo_t *lumpinfo = &wadfiles[wadnum]->lumpinfo[l];
+	UINT8 frame = R_Char2Frame(lumpinfo->name[4]);
+	UINT8 rotation = (UINT8)(lumpinfo->name[5] - '0');
 
-			if (frame >= 64 || rotation > 8) // Give an actual NAME error -_-...
-			{
-				CONS_Alert(CONS_WARNING, M_GetText("Bad sprite name: %s\n"), W_CheckNameForNumPwad(wadnum,l));
-				continue;
-			}
+	if (frame >= 64 || rotation > 8) // Give an actual NAME error -_-...
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Bad sprite name: %s\n"), W_CheckNameForNumPwad(wadnum,l));
+		return false;
+	}
 
-			// skip NULL sprites from very old dmadds pwads
-			if (W_LumpLengthPwad(wadnum,l)<=8)
-				continue;
+	// skip NULL sprites from very old dmadds pwads
+	if (W_LumpLengthPwad(wadnum,l)<=8)
+		return false;
 
-			// store sprite info in lookup tables
-			//FIXME : numspritelumps do not duplicate sprite replacements
-			W_ReadLumpHeaderPwad(wadnum, l, &patch, sizeof (patch_t), 0);
-			spritecachedinfo[numspritelumps].width = SHORT(patch.width)<<FRACBITS;
-			spritecachedinfo[numspritelumps].offset = SHORT(patch.leftoffset)<<FRACBITS;
-			spritecachedinfo[numspritelumps].topoffset = SHORT(patch.topoffset)<<FRACBITS;
-			spritecachedinfo[numspritelumps].height = SHORT(patch.height)<<FRACBITS;
-
-			//BP: we cannot use special tric in hardware mode because feet in ground caused by z-buffer
-			if (rendermode != render_none) // not for psprite
-				spritecachedinfo[numspritelumps].topoffset += 4<<FRACBITS;
-			// Being selective with this causes bad things. :( Like the special stage tokens breaking apart.
-			/*if (rendermode != render_none // not for psprite
-			 && SHORT(patch.topoffset)>0 && SHORT(patch.topoffset)<SHORT(patch.height))
-				// perfect is patch.height but sometime it is too high
-				spritecachedinfo[numspritelumps].topoffset = min(SHORT(patch.topoffset)+4,SHORT(patch.height))<<FRACBITS;*/
+	// store sprite info in lookup tables
+	//FIXME : numspritelumps do not duplicate sprite replacements
+	// the header is read by R_GetSpriteCache, once it's needed
+	spritecachedinfo[numspritelumps].lumppat = (wadnum<<16) + l;
 
-			//----------------------------------------------------
+	R_InstallSpriteLump(wadnum, l, numspritelumps, frame, rotation, 0);
 
-			R_InstallSpriteLump(wadnum, l, numspritelumps, frame, rotation, 0);
+	if (lumpinfo->name[6])
+	{
+		frame = R_Char2Frame(lumpinfo->name[6]);
+		rotation = (UINT8)(lumpinfo->name[7] - '0');
+		R_InstallSpriteLump(wadnum, l, numspritelumps, frame, rotation, 1);
+	}
 
-			if (lumpinfo[l].name[6])
-			{
-				frame = R_Char2Frame(lumpinfo[l].name[6]);
-				rotation = (UINT8)(lumpinfo[l].name[7] - '0');
-				R_InstallSpriteLump(wadnum, l, numspritelumps, frame, rotation, 1);
-			}
+	if (++numspritelumps >= max_spritelumps)
+	{
+		max_spritelumps *= 2;
+		Z_Realloc(spritecachedinfo, max_spritelumps*sizeof(*spritecachedinfo), PU_STATIC, &spritecachedinfo);
+	}
 
-			if (++numspritelumps >= max_spritelumps)
-			{
-				max_spritelumps *= 2;
-				Z_Realloc(spritecachedinfo, max_spritelumps*sizeof(*spritecachedinfo), PU_STATIC, &spritecachedinfo);
-			}
+	return true;
+}
 
-			++numadded;
-		}
-	}
+//
+// R_EndSpriteDef
+//
+// Checks the frames in sprtemp and copies them to spritedef.
+// Returns true if any of them came from the lumps just added.
+//
+static boolean R_EndSpriteDef(const char *sprname, spritedef_t *spritedef, boolean added)
+{
+	UINT8 frame;
+	UINT8 rotation;
 
 	//
 	// if no frames found for this sprite
@@ -262,7 +279,7 @@ static boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef,
 		// sprite already has frames, and is not replaced by this wad
 		return false;
 	}
-	else if (!numadded)
+	else if (!added)
 	{
 		// Nothing related to this spritedef has been changed
 		// so there is no point going back through these checks again.
@@ -318,13 +335,58 @@ static boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef,
 	return true;
 }
 
+// Install a single sprite, given its identifying name (4 chars)
+//
+// (originally part of R_AddSpriteDefs)
+//
+// Pass: name of sprite : 4 chars
+//       spritedef_t
+//       wadnum         : wad number, indexes wadfiles[], where patches
+//                        for frames are found
+//       startlump      : first lump to search for sprite frames
+//       endlump        : AFTER the last lump to search
+//
+// Returns true if the sprite was succesfully added
+//
+static boolean R_AddSingleSpriteDef(const char *sprname, spritedef_t *spritedef, UINT16 wadnum, UINT16 startlump, UINT16 endlump)
+{
+	lumpinfo_t *lumpinfo = wadfiles[wadnum]->lumpinfo;
+	boolean added = false;
+	UINT16 l;
+
+	R_BeginSpriteDef(sprname, spritedef);
+
+	// scan the lumps,
+	//  filling in the frames for whatever is found
+	if (endlump > wadfiles[wadnum]->numlumps)
+		endlump = wadfiles[wadnum]->numlumps;
+
+	for (l = startlump; l < endlump; l++)
+		if (memcmp(lumpinfo[l].name,sprname,4)==0 && R_AddSpriteLump(wadnum, l))
+			added = true;
+
+	return R_EndSpriteDef(sprname, spritedef, added);
+}
+
+// Sprite lumps of the wad being added, chained by the first 4 characters
+#define SPRITEBUCKETS 1024
+#define SPRITECHAINEND UINT16_MAX
+
+static inline UINT32 R_SpriteBucket(const char *name)
+{
+	UINT32 h = ((UINT8)name[0]) | ((UINT8)name[1]<<8) | ((UINT8)name[2]<<16) | ((UINT32)(UINT8)name[3]<<24);
+	return (h * 2654435761u) >> 22; // 32 - log2(SPRITEBUCKETS)
+}
+
 //
 // Search for sprites replacements in a wad whose names are in namelist
 //
 void R_AddSpriteDefs(UINT16 wadnum)
 {
 	size_t i, addsprites = 0;
-	UINT16 start, end;
+	UINT16 start, end, l;
+	UINT16 *buckets, *chain;
+	lumpinfo_t *lumpinfo;
 	char wadname[MAX_WADPATH];
 
 	switch (wadfiles[wadnum]->type)
@@ -355,16 +417,53 @@ void R_AddSpriteDefs(UINT16 wadnum)
 		return;
 	}
 
+	lumpinfo = wadfiles[wadnum]->lumpinfo;
+	if (end > wadfiles[wadnum]->numlumps)
+		end = wadfiles[wadnum]->numlumps;
+
 	//
-	// scan through lumps, for each sprite, find all the sprite frames
+	// chain the lumps by name once, going backwards so every chain
+	// lists its lumps in wad order, and later ones still win
+	//
+	buckets = Z_Malloc(SPRITEBUCKETS * sizeof (*buckets), PU_STATIC, NULL);
+	chain = Z_Malloc((end - start + 1) * sizeof (*chain), PU_STATIC, NULL);
+	memset(buckets, 0xFF, SPRITEBUCKETS * sizeof (*buckets));
+	for (l = end; l-- > start;)
+	{
+		const UINT32 b = R_SpriteBucket(lumpinfo[l].name);
+		chain[l - start] = buckets[b];
+		buckets[b] = l;
+	}
+
+	//
+	// for each sprite, find all the sprite frames in its chain
 	//
 	for (i = 0; i < numsprites; i++)
 	{
+		boolean begun = false, added = false;
+
 		spritename = sprnames[i];
 		if (spritename[4] && wadnum >= (UINT16)spritename[4])
 			continue;
 
-		if (R_AddSingleSpriteDef(spritename, &sprites[i], wadnum, start, end))
+		for (l = buckets[R_SpriteBucket(spritename)]; l != SPRITECHAINEND; l = chain[l - start])
+		{
+			if (memcmp(lumpinfo[l].name, spritename, 4))
+				continue;
+			if (!begun)
+			{
+				R_BeginSpriteDef(spritename, &sprites[i]);
+				begun = true;
+			}
+			if (R_AddSpriteLump(wadnum, l))
+				added = true;
+		}
+
+		// nothing in this wad replaces it
+		if (!added)
+			continue;
+
+		if (R_EndSpriteDef(spritename, &sprites[i], added))
 		{
 #ifdef HWRENDER
 			if (rendermode == render_opengl)
@@ -378,6 +477,9 @@ void R_AddSpriteDefs(UINT16 wadnum)
 		}
 	}
 
+	Z_Free(chain);
+	Z_Free(buckets);
+
 	nameonly(strcpy(wadname, wadfiles[wadnum]->filename));
 	CONS_Printf(M_GetText("%s added %d frames in %s sprites\n"), wadname, end-start, sizeu1(addsprites));
 }
@@ -535,9 +637,11 @@ void R_InitSprites(void)
 	//
 
 	// it can be is do before loading config for skin cvar possible value
+	TRACE_BEGIN("render", "Skins");
 	R_InitSkins();
 	for (i = 0; i < numwadfiles; i++)
 		R_AddSkins((UINT16)i);
+	TRACE_END();
 
 	//
 	// check if all sprites have frames
@@ -644,7 +748,7 @@ void R_DrawMaskedColumn(column_t *column)
 			// FIXTHIS: Figure out what "something more proper" is and do it.
 			// quick fix... something more proper should be done!!!
 			if (ylookup[dc_yl])
-				colfunc();
+				R_DrawColumnFunc(colfunc);
 			else if (colfunc == R_DrawColumn_8
 #ifdef USEASM
 			|| colfunc == R_DrawColumn_8_ASM || colfunc == R_DrawColumn_8_MMX
@@ -708,6 +812,11 @@ static void R_DrawFlippedMaskedColumn(column_t *column, INT32 texheight)
 
 		if (dc_yl <= dc_yh && dc_yl < vid.height && dc_yh > 0)
 		{
+#ifdef RENDERTHREADS
+			if (r_queuedraws) // has to last until the queue runs
+				dc_source = R_DrawQueueAlloc(column->length);
+			else
+#endif
 			dc_source = ZZ_Alloc(column->length);
 			for (s = (UINT8 *)column+2+column->length, d = dc_source; d < dc_source+column->length; --s)
 				*d++ = *s;
@@ -715,7 +824,7 @@ static void R_DrawFlippedMaskedColumn(column_t *column, INT32 texheight)
 
 			// Still drawn by R_DrawColumn.
 			if (ylookup[dc_yl])
-				colfunc();
+				R_DrawColumnFunc(colfunc);
 			else if (colfunc == R_DrawColumn_8
 #ifdef USEASM
 			|| colfunc == R_DrawColumn_8_ASM || colfunc == R_DrawColumn_8_MMX
@@ -729,6 +838,9 @@ static void R_DrawFlippedMaskedColumn(column_t *column, INT32 texheight)
 					first = 0;
 				}
 			}
+#ifdef RENDERTHREADS
+			if (!r_queuedraws)
+#endif
 			Z_Free(dc_source);
 		}
 		column = (column_t *)((UINT8 *)column + column->length + 4);
@@ -1060,6 +1172,7 @@ static void R_ProjectSprite(mobj_t *thing)
 	spritedef_t *sprdef;
 	spriteframe_t *sprframe;
 	size_t lump;
+	const sprcache_t *info;
 
 	size_t rot;
 	UINT8 flip;
@@ -1160,22 +1273,23 @@ static void R_ProjectSprite(mobj_t *thing)
 	}
 
 	I_Assert(lump < max_spritelumps);
+	info = R_GetSpriteCache(lump);
 
 	if (thing->skin && ((skin_t *)thing->skin)->flags & SF_HIRES)
 		this_scale = FixedMul(this_scale, ((skin_t *)thing->skin)->highresscale);
 
 	// calculate edges of the shape
 	if (flip)
-		tx -= FixedMul(spritecachedinfo[lump].width-spritecachedinfo[lump].offset, this_scale);
+		tx -= FixedMul(info->width-info->offset, this_scale);
 	else
-		tx -= FixedMul(spritecachedinfo[lump].offset, this_scale);
+		tx -= FixedMul(info->offset, this_scale);
 	x1 = (centerxfrac + FixedMul (tx,xscale)) >>FRACBITS;
 
 	// off the right side?
 	if (x1 > viewwidth)
 		return;
 
-	tx += FixedMul(spritecachedinfo[lump].width, this_scale);
+	tx += FixedMul(info->width, this_scale);
 	x2 = ((centerxfrac + FixedMul (tx,xscale)) >>FRACBITS) - 1;
 
 	// off the left side
@@ -1198,13 +1312,13 @@ static void R_ProjectSprite(mobj_t *thing)
 		// When vertical flipped, draw sprites from the top down, at least as far as offsets are concerned.
 		// sprite height - sprite topoffset is the proper inverse of the vertical offset, of course.
 		// remember gz and gzt should be seperated by sprite height, not thing height - thing height can be shorter than the sprite itself sometimes!
-		gz = thing->z + thing->height - FixedMul(spritecachedinfo[lump].topoffset, this_scale);
-		gzt = gz + FixedMul(spritecachedinfo[lump].height, this_scale);
+		gz = thing->z + thing->height - FixedMul(info->topoffset, this_scale);
+		gzt = gz + FixedMul(info->height, this_scale);
 	}
 	else
 	{
-		gzt = thing->z + FixedMul(spritecachedinfo[lump].topoffset, this_scale);
-		gz = gzt - FixedMul(spritecachedinfo[lump].height, this_scale);
+		gzt = thing->z + FixedMul(info->topoffset, this_scale);
+		gz = gzt - FixedMul(info->height, this_scale);
 	}
 
 	if (thing->subsector->sector->cullheight)
@@ -1301,7 +1415,7 @@ static void R_ProjectSprite(mobj_t *thing)
 
 	if (flip)
 	{
-		vis->startfrac = spritecachedinfo[lump].width-1;
+		vis->startfrac = info->width-1;
 		vis->xiscale = -iscale;
 	}
 	else
@@ -1326,9 +1440,9 @@ static void R_ProjectSprite(mobj_t *thing)
 	if (!cv_translucency.value)
 		; // no translucency
 	else if (thing->flags2 & MF2_SHADOW) // actually only the player should use this (temporary invisibility)
-		vis->transmap = transtables + ((tr_trans80-1)<<FF_TRANSSHIFT); // because now the translucency is set through FF_TRANSMASK
+		vis->transmap = R_GetTranslucencyTable(tr_trans80); // because now the translucency is set through FF_TRANSMASK
 	else if (thing->frame & FF_TRANSMASK)
-		vis->transmap = transtables + (thing->frame & FF_TRANSMASK) - 0x10000;
+		vis->transmap = R_GetTranslucencyTable((thing->frame & FF_TRANSMASK)>>FF_TRANSSHIFT);
 
 	if (((thing->frame & FF_FULLBRIGHT) || (thing->flags2 & MF2_SHADOW))
 		&& (!vis->extra_colormap || !(vis->extra_colormap->fog & 1)))
@@ -1363,7 +1477,7 @@ static void R_ProjectSprite(mobj_t *thing)
 	++objectsdrawn;
 }
 
-static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
+static void R_ProjectPrecipitationSprite(const precipdrop_t *thing)
 {
 	fixed_t tr_x, tr_y;
 	fixed_t gxt, gyt;
@@ -1375,6 +1489,7 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 	spritedef_t *sprdef;
 	spriteframe_t *sprframe;
 	size_t lump;
+	const sprcache_t *info;
 
 	vissprite_t *vis;
 
@@ -1383,6 +1498,10 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 	//SoM: 3/17/2000
 	fixed_t gz ,gzt;
 
+	// only in sectors the BSP went through
+	if (thing->subsector->sector->validcount != validcount)
+		return;
+
 	// transform the origin point
 	tr_x = thing->x - viewx;
 	tr_y = thing->y - viewy;
@@ -1432,16 +1551,17 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 
 	// use single rotation for all views
 	lump = sprframe->lumpid[0];     //Fab: see note above
+	info = R_GetSpriteCache(lump);
 
 	// calculate edges of the shape
-	tx -= spritecachedinfo[lump].offset;
+	tx -= info->offset;
 	x1 = (centerxfrac + FixedMul (tx,xscale)) >>FRACBITS;
 
 	// off the right side?
 	if (x1 > viewwidth)
 		return;
 
-	tx += spritecachedinfo[lump].width;
+	tx += info->width;
 	x2 = ((centerxfrac + FixedMul (tx,xscale)) >>FRACBITS) - 1;
 
 	// off the left side
@@ -1458,20 +1578,9 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 			return;
 	}
 
-	// okay, we can't return now except for vertical clipping... this is a hack, but weather isn't networked, so it should be ok
-	if (!(thing->precipflags & PCF_THUNK))
-	{
-		if (thing->precipflags & PCF_RAIN)
-			P_RainThinker(thing);
-		else
-			P_SnowThinker(thing);
-		thing->precipflags |= PCF_THUNK;
-	}
-
-
 	//SoM: 3/17/2000: Disregard sprites that are out of view..
-	gzt = thing->z + spritecachedinfo[lump].topoffset;
-	gz = gzt - spritecachedinfo[lump].height;
+	gzt = thing->z + info->topoffset;
+	gz = gzt - info->height;
 
 	if (thing->subsector->sector->cullheight)
 	{
@@ -1523,7 +1632,7 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 
 	// specific translucency
 	if (thing->frame & FF_TRANSMASK)
-		vis->transmap = (thing->frame & FF_TRANSMASK) - 0x10000 + transtables;
+		vis->transmap = R_GetTranslucencyTable((thing->frame & FF_TRANSMASK)>>FF_TRANSSHIFT);
 	else
 		vis->transmap = NULL;
 
@@ -1542,10 +1651,60 @@ static void R_ProjectPrecipitationSprite(precipmobj_t *thing)
 // R_AddSprites
 // During BSP traversal, this adds sprites by sector.
 //
+//
+// R_ThingBoxCulled
+// Whether R_ProjectSprite would turn down every thing in a sector, going
+// by its thingbox: all behind the view plane, all too far off one side,
+// or all beyond the draw distance. Corners are worked out in 64 bits with
+// a unit to spare, so nothing R_ProjectSprite would take is culled.
+//
+static boolean R_ThingBoxCulled(const fixed_t *box, fixed_t limit_dist)
+{
+	INT64 tz, tx, dx, dy;
+	boolean behind = true, left = true, right = true, near = true;
+	INT32 i;
+
+	for (i = 0; i < 4; i++)
+	{
+		dx = (INT64)box[(i & 1) ? BOXRIGHT : BOXLEFT] - viewx;
+		dy = (INT64)box[(i & 2) ? BOXTOP : BOXBOTTOM] - viewy;
+
+		// R_ProjectSprite would wrap around; don't guess what it'd do
+		if (dx != (fixed_t)dx || dy != (fixed_t)dy)
+			return false;
+
+		tz = (dx*viewcos + dy*viewsin) >> FRACBITS;
+		tx = (dx*viewsin - dy*viewcos) >> FRACBITS;
+
+		if (tz >= -FRACUNIT)
+			behind = false;
+		if (tz >= (1<<29) - FRACUNIT) // past where tz<<2 wraps
+			near = false;
+		if (tx <= 4*tz + FRACUNIT)
+			right = false;
+		if (tx >= -4*tz - FRACUNIT)
+			left = false;
+	}
+
+	if (behind || (near && (left || right)))
+		return true;
+
+	if (limit_dist)
+	{
+		dx = viewx < box[BOXLEFT] ? (INT64)box[BOXLEFT] - viewx
+			: viewx > box[BOXRIGHT] ? (INT64)viewx - box[BOXRIGHT] : 0;
+		dy = viewy < box[BOXBOTTOM] ? (INT64)box[BOXBOTTOM] - viewy
+			: viewy > box[BOXTOP] ? (INT64)viewy - box[BOXTOP] : 0;
+		if (dx <= INT32_MAX/2 && dy <= INT32_MAX/2 // nearest any can be
+			&& P_AproxDistance((fixed_t)dx, (fixed_t)dy) > limit_dist)
+			return true;
+	}
+	return false;
+}
+
 void R_AddSprites(sector_t *sec, INT32 lightlevel)
 {
 	mobj_t *thing;
-	precipmobj_t *precipthing; // Tails 08-25-2002
 	INT32 lightnum;
 	fixed_t approx_dist, limit_dist;
 
@@ -1562,6 +1721,13 @@ void R_AddSprites(sector_t *sec, INT32 lightlevel)
 	// Well, now it will be done.
 	sec->validcount = validcount;
 
+	limit_dist = (fixed_t)((maptol & TOL_NIGHTS) ? cv_drawdist_nights.value : cv_drawdist.value) << FRACBITS;
+	if (!sec->thinglist || R_ThingBoxCulled(sec->thingbox, limit_dist))
+		return;
+
+	// Going through the list anyway, so make the box fit again
+	M_ClearBox(sec->thingbox);
+
 	if (!sec->numlights)
 	{
 		if (sec->heightsec == -1) lightlevel = sec->lightlevel;
@@ -1578,10 +1744,11 @@ void R_AddSprites(sector_t *sec, INT32 lightlevel)
 
 	// Handle all things in sector.
 	// If a limit exists, handle things a tiny bit different.
-	if ((limit_dist = (fixed_t)((maptol & TOL_NIGHTS) ? cv_drawdist_nights.value : cv_drawdist.value) << FRACBITS))
+	if (limit_dist)
 	{
 		for (thing = sec->thinglist; thing; thing = thing->snext)
 		{
+			M_AddToBox(sec->thingbox, thing->x, thing->y);
 			if (thing->sprite == SPR_NULL || thing->flags2 & MF2_DONTDRAW)
 				continue;
 
@@ -1597,33 +1764,25 @@ void R_AddSprites(sector_t *sec, INT32 lightlevel)
 	{
 		// Draw everything in sector, no checks
 		for (thing = sec->thinglist; thing; thing = thing->snext)
+		{
+			M_AddToBox(sec->thingbox, thing->x, thing->y);
 			if (!(thing->sprite == SPR_NULL || thing->flags2 & MF2_DONTDRAW))
 				R_ProjectSprite(thing);
+		}
 	}
+}
 
-	// Someone seriously wants infinite draw distance for precipitation?
-	if ((limit_dist = (fixed_t)cv_drawdist_precip.value << FRACBITS))
-	{
-		for (precipthing = sec->preciplist; precipthing; precipthing = precipthing->snext)
-		{
-			if (precipthing->precipflags & PCF_INVISIBLE)
-				continue;
-
-			approx_dist = P_AproxDistance(viewx-precipthing->x, viewy-precipthing->y);
-
-			if (approx_dist > limit_dist)
-				continue;
+//
+// R_AddPrecipitationSprites
+// After BSP traversal, adds the weather in the sectors it went through.
+//
+void R_AddPrecipitationSprites(void)
+{
+	if (rendermode != render_soft)
+		return;
 
-			R_ProjectPrecipitationSprite(precipthing);
-		}
-	}
-	else
-	{
-		// Draw everything in sector, no checks
-		for (precipthing = sec->preciplist; precipthing; precipthing = precipthing->snext)
-			if (!(precipthing->precipflags & PCF_INVISIBLE))
-				R_ProjectPrecipitationSprite(precipthing);
-	}
+	// Someone seriously wants infinite draw distance for precipitation?
+	P_IteratePrecipitation(viewx, viewy, (fixed_t)cv_drawdist_precip.value << FRACBITS, R_ProjectPrecipitationSprite);
 }
 
 //
@@ -1631,68 +1790,74 @@ void R_AddSprites(sector_t *sec, INT32 lightlevel)
 //
 static vissprite_t vsprsortedhead;
 
-void R_SortVisSprites(void)
+// Farthest (smallest scale) first. Sprites of the same scale are ordered by
+// dispoffset, smallest first, and otherwise keep the order they were made in.
+static inline boolean R_VisSpriteBefore(const vissprite_t *a, const vissprite_t *b)
 {
-	UINT32       i;
-	vissprite_t *ds, *dsprev, *dsnext, *dsfirst;
-	vissprite_t *best = NULL;
-	vissprite_t  unsorted;
-	fixed_t      bestscale;
-	INT32        bestdispoffset;
-
-	if (!visspritecount)
-		return;
-
-	unsorted.next = unsorted.prev = &unsorted;
+	return a->scale < b->scale || (a->scale == b->scale && a->dispoffset < b->dispoffset);
+}
 
-	dsfirst = R_GetVisSprite(0);
+// Stable merge sort of count sprites linked through next.
+// The sorted list ends in NULL; prev is left alone.
+static vissprite_t *R_MergeSortVisSprites(vissprite_t *list, UINT32 count)
+{
+	vissprite_t *left, *right, *head = NULL, **tail = &head;
+	UINT32 i, half;
 
-	// The first's prev and last's next will be set to
-	// nonsense, but are fixed in a moment
-	for (i = 0, dsnext = dsfirst, ds = NULL; i < visspritecount; i++)
+	if (count < 2)
 	{
-		dsprev = ds;
-		ds = dsnext;
-		if (i < visspritecount - 1) dsnext = R_GetVisSprite(i + 1);
-
-		ds->next = dsnext;
-		ds->prev = dsprev;
+		list->next = NULL;
+		return list;
 	}
 
-	// Fix first and last. ds still points to the last one after the loop
-	dsfirst->prev = &unsorted;
-	unsorted.next = dsfirst;
-	if (ds)
-		ds->next = &unsorted;
-	unsorted.prev = ds;
+	half = count/2;
+	for (i = 0, right = list; i < half; i++)
+		right = right->next;
 
-	// pull the vissprites out by scale
-	vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
-	for (i = 0; i < visspritecount; i++)
+	left = R_MergeSortVisSprites(list, half);
+	right = R_MergeSortVisSprites(right, count - half);
+
+	while (left && right)
 	{
-		bestscale = bestdispoffset = INT32_MAX;
-		for (ds = unsorted.next; ds != &unsorted; ds = ds->next)
+		if (R_VisSpriteBefore(right, left))
 		{
-			if (ds->scale < bestscale)
-			{
-				bestscale = ds->scale;
-				bestdispoffset = ds->dispoffset;
-				best = ds;
-			}
-			// order visprites of same scale by dispoffset, smallest first
-			else if (ds->scale == bestscale && ds->dispoffset < bestdispoffset)
-			{
-				bestdispoffset = ds->dispoffset;
-				best = ds;
-			}
+			*tail = right;
+			right = right->next;
+		}
+		else
+		{
+			*tail = left;
+			left = left->next;
 		}
-		best->next->prev = best->prev;
-		best->prev->next = best->next;
-		best->next = &vsprsortedhead;
-		best->prev = vsprsortedhead.prev;
-		vsprsortedhead.prev->next = best;
-		vsprsortedhead.prev = best;
+		tail = &(*tail)->next;
 	}
+	*tail = left ? left : right;
+
+	return head;
+}
+
+void R_SortVisSprites(void)
+{
+	UINT32       i;
+	vissprite_t *ds, *dsprev;
+
+	vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+
+	if (!visspritecount)
+		return;
+
+	for (i = 0, ds = R_GetVisSprite(0); i < visspritecount - 1; i++)
+		ds = ds->next = R_GetVisSprite(i + 1);
+	ds->next = NULL;
+
+	// Insertion order breaks ties, so this gives the same order the old
+	// selection sort did, in O(n log n).
+	ds = vsprsortedhead.next = R_MergeSortVisSprites(R_GetVisSprite(0), visspritecount);
+
+	for (dsprev = &vsprsortedhead; ds; dsprev = ds, ds = ds->next)
+		ds->prev = dsprev;
+	dsprev->next = &vsprsortedhead;
+	vsprsortedhead.prev = dsprev;
 }
 
 //
@@ -1703,6 +1868,69 @@ static drawnode_t *R_CreateDrawNode(drawnode_t *link);
 static drawnode_t nodebankhead;
 static drawnode_t nodehead;
 
+// Fills in what the sprite sorting checks first, from what the node is
+static void R_SetDrawNodeKeys(drawnode_t *node)
+{
+	drawseg_t *ds = node->thickseg ? node->thickseg : node->seg;
+
+	if (node->plane)
+	{
+		node->x1 = node->plane->minx;
+		node->x2 = node->plane->maxx;
+	}
+	else if (ds)
+	{
+		node->x1 = ds->x1;
+		node->x2 = ds->x2;
+		node->maxscale = ds->scale1 > ds->scale2 ? ds->scale1 : ds->scale2;
+	}
+	else if (node->sprite)
+	{
+		node->x1 = node->sprite->x1;
+		node->x2 = node->sprite->x2;
+	}
+}
+
+// Whether a plane node's seg is in front of a sprite at any of the
+// columns x1 to x2, which are within the plane. Whole blocks of columns
+// are checked at once, from maxima worked out the first time it's asked.
+static boolean R_PlaneSegInFront(drawnode_t *node, INT32 x1, INT32 x2, fixed_t scale)
+{
+	const fixed_t *frontscale = node->seg->frontscale;
+	const INT32 mask = (1<<DRAWNODEBLOCKBITS) - 1;
+	INT32 i, b;
+
+	if (!node->blocksready)
+	{
+		for (b = node->x1>>DRAWNODEBLOCKBITS; b <= node->x2>>DRAWNODEBLOCKBITS; b++)
+		{
+			INT32 lo = b<<DRAWNODEBLOCKBITS, hi = lo + mask;
+			fixed_t most = INT32_MIN;
+
+			if (lo < node->x1) lo = node->x1;
+			if (hi > node->x2) hi = node->x2;
+			for (i = lo; i <= hi; i++)
+				if (frontscale[i] > most)
+					most = frontscale[i];
+			node->scaleblock[b] = most;
+		}
+		node->blocksready = true;
+	}
+
+	for (i = x1; i <= x2;)
+	{
+		if (!(i & mask) && i + mask <= x2)
+		{
+			if (node->scaleblock[i>>DRAWNODEBLOCKBITS] > scale)
+				return true;
+			i += mask + 1;
+		}
+		else if (frontscale[i++] > scale)
+			return true;
+	}
+	return false;
+}
+
 static void R_CreateDrawNodes(void)
 {
 	drawnode_t *entry;
@@ -1814,6 +2042,9 @@ static void R_CreateDrawNodes(void)
 	if (visspritecount == 0)
 		return;
 
+	for (r2 = nodehead.next; r2 != &nodehead; r2 = r2->next)
+		R_SetDrawNodeKeys(r2);
+
 	R_SortVisSprites();
 	for (rover = vsprsortedhead.prev; rover != &vsprsortedhead; rover = rover->prev)
 	{
@@ -1824,11 +2055,13 @@ static void R_CreateDrawNodes(void)
 
 		for (r2 = nodehead.next; r2 != &nodehead; r2 = r2->next)
 		{
+			// Nothing is sorted against what it doesn't overlap
+			if (r2->x1 > rover->x2 || r2->x2 < rover->x1)
+				continue;
+
 			if (r2->plane)
 			{
 				fixed_t planeobjectz, planecameraz;
-				if (r2->plane->minx > rover->x2 || r2->plane->maxx < rover->x1)
-					continue;
 				if (rover->szt > r2->plane->low || rover->sz < r2->plane->high)
 					continue;
 
@@ -1867,16 +2100,9 @@ static void R_CreateDrawNodes(void)
 				if (x1 < r2->plane->minx) x1 = r2->plane->minx;
 				if (x2 > r2->plane->maxx) x2 = r2->plane->maxx;
 
-				if (r2->seg) // if no seg set, assume the whole thing is in front or something stupid
-				{
-					for (i = x1; i <= x2; i++)
-					{
-						if (r2->seg->frontscale[i] > rover->scale)
-							break;
-					}
-					if (i > x2)
-						continue;
-				}
+				// if no seg set, assume the whole thing is in front or something stupid
+				if (r2->seg && !R_PlaneSegInFront(r2, x1, x2, rover->scale))
+					continue;
 
 				entry = R_CreateDrawNode(NULL);
 				(entry->prev = r2->prev)->next = entry;
@@ -1887,11 +2113,7 @@ static void R_CreateDrawNodes(void)
 			else if (r2->thickseg)
 			{
 				fixed_t topplaneobjectz, topplanecameraz, botplaneobjectz, botplanecameraz;
-				if (rover->x1 > r2->thickseg->x2 || rover->x2 < r2->thickseg->x1)
-					continue;
-
-				scale = r2->thickseg->scale1 > r2->thickseg->scale2 ? r2->thickseg->scale1 : r2->thickseg->scale2;
-				if (scale <= rover->scale)
+				if (r2->maxscale <= rover->scale)
 					continue;
 				scale = r2->thickseg->scale1 + (r2->thickseg->scalestep * (sintersect - r2->thickseg->x1));
 				if (scale <= rover->scale)
@@ -1940,11 +2162,7 @@ static void R_CreateDrawNodes(void)
 						continue;
 				}
 #endif
-				if (rover->x1 > r2->seg->x2 || rover->x2 < r2->seg->x1)
-					continue;
-
-				scale = r2->seg->scale1 > r2->seg->scale2 ? r2->seg->scale1 : r2->seg->scale2;
-				if (scale <= rover->scale)
+				if (r2->maxscale <= rover->scale)
 					continue;
 				scale = r2->seg->scale1 + (r2->seg->scalestep * (sintersect - r2->seg->x1));
 
@@ -1959,8 +2177,6 @@ static void R_CreateDrawNodes(void)
 			}
 			else if (r2->sprite)
 			{
-				if (r2->sprite->x1 > rover->x2 || r2->sprite->x2 < rover->x1)
-					continue;
 				if (r2->sprite->szt > rover->sz || r2->sprite->sz < rover->szt)
 					continue;
 
@@ -1980,6 +2196,7 @@ static void R_CreateDrawNodes(void)
 			entry = R_CreateDrawNode(&nodehead);
 			entry->sprite = rover;
 		}
+		R_SetDrawNodeKeys(entry);
 	}
 }
 
@@ -2009,6 +2226,7 @@ static drawnode_t *R_CreateDrawNode(drawnode_t *link)
 	node->thickseg = NULL;
 	node->ffloor = NULL;
 	node->sprite = NULL;
+	node->blocksready = false;
 	return node;
 }
 
@@ -2408,6 +2626,7 @@ void R_InitSkins(void)
 	skin->spritedef.numframes = sprites[SPR_PLAY].numframes;
 	skin->spritedef.spriteframes = sprites[SPR_PLAY].spriteframes;
 	ST_LoadFaceGraphics(skin->face, skin->superface, 0);
+	R_BuildSkinTranslations(0);
 
 	//MD2 for sonic doesn't want to load in Linux.
 #ifdef HWRENDER
@@ -2808,7 +3027,7 @@ next_token:
 			// So just let the function in the while loop take care of it for us.
 		}
 
-		R_FlushTranslationColormapCache();
+		R_BuildSkinTranslations(numskins);
 
 		CONS_Printf(M_GetText("Added skin '%s'\n"), skin->name);
 #ifdef SKINVALUES
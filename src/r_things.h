@@ -52,6 +52,7 @@ void R_DelSpriteDefs(UINT16 wadnum);
 
 //SoM: 6/5/2000: Light sprites correctly!
 void R_AddSprites(sector_t *sec, INT32 lightlevel);
+void R_AddPrecipitationSprites(void);
 void R_InitSprites(void);
 void R_ClearSprites(void);
 void R_ClipSprites(void);
@@ -165,6 +166,8 @@ typedef struct vissprite_s
 	INT32 dispoffset; // copy of info->dispoffset, affects ordering but not drawing
 } vissprite_t;
 
+#define DRAWNODEBLOCKBITS 4 // columns per scaleblock, as a power of two
+
 // A drawnode is something that points to a 3D floor, 3D side, or masked
 // middle texture. This is used for sorting with sprites.
 typedef struct drawnode_s
@@ -175,6 +178,12 @@ typedef struct drawnode_s
 	ffloor_t *ffloor;
 	vissprite_t *sprite;
 
+	// Worked out once, not for every sprite sorted against it
+	INT32 x1, x2; // columns it covers
+	fixed_t maxscale; // a seg or thickseg's nearest end
+	boolean blocksready;
+	fixed_t scaleblock[(MAXVIDWIDTH>>DRAWNODEBLOCKBITS) + 1]; // a plane's seg's largest frontscale in each block of columns
+
 	struct drawnode_s *next;
 	struct drawnode_s *prev;
 } drawnode_t;
@@ -0,0 +1,454 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_threads.c
+/// \brief Threaded drawing for the software renderer
+///
+///        The drawers read their arguments from the dc_ and ds_ globals,
+///        which are thread-local in builds with RENDERTHREADS. Queuing a
+///        draw copies them; a render thread puts them back before calling
+///        the drawer. Every thread walks the whole queue and only runs
+///        what falls in its own strip of columns, so draws that overlap,
+///        like translucent walls over sprites, stay in order.
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "i_threads.h"
+#include "i_video.h"
+#include "r_local.h"
+#include "r_threads.h"
+
+#ifdef RENDERTHREADS
+
+static CV_PossibleValue_t renderthreads_cons_t[] = {{0, "MIN"}, {MAXRENDERTHREADS, "MAX"}, {0, NULL}};
+consvar_t cv_renderthreads = {"renderthreads", "0", CV_SAVE, renderthreads_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+boolean r_queuedraws = false;
+
+typedef struct
+{
+	lighttable_t *colormap;
+	INT32 x, yl, yh;
+	fixed_t iscale, texturemid;
+	UINT8 hires;
+	UINT8 *source;
+	UINT8 *transmap;
+	UINT8 *translation;
+	r_lightlist_t *lightlist; // copied, the caller reuses its own
+	INT32 numlights;
+	INT32 texheight;
+} colstate_t;
+
+typedef struct
+{
+	INT32 y, x1, x2;
+	lighttable_t *colormap;
+	fixed_t xfrac, yfrac, xstep, ystep;
+	UINT8 *source;
+	UINT8 *transmap;
+	UINT32 flatxshift, flatyshift, flatshiftup, flatmask;
+	lighttable_t **zlight;
+#ifdef ESLOPE
+	pslope_t *slope;
+	floatv3_t su, sv, sz;
+	float zeroheight;
+	fixed_t viewx, viewy, viewz;
+#endif
+} spanstate_t;
+
+typedef struct
+{
+	void (*func)(void);
+	boolean span;
+	union
+	{
+		colstate_t col;
+		spanstate_t span;
+	} u;
+} drawcmd_t;
+
+// Memory for R_DrawQueueAlloc. Blocks are kept, and reused every view.
+#define QUEUEBLOCKSIZE (256*1024)
+
+typedef struct queueblock_s
+{
+	struct queueblock_s *next;
+	size_t size, used;
+} queueblock_t;
+
+// One view's draws, and the view state the drawers read besides dc_ and ds_.
+// There are two, so the split screen views can overlap: the threads draw
+// the first view while the main thread goes through the second one.
+typedef struct
+{
+	drawcmd_t *cmds;
+	size_t numcmds, maxcmds;
+	queueblock_t *blocks, *curblock;
+
+	INT32 numthreads, viewwidth;
+	UINT8 *topleft;
+	UINT8 **ylookup;
+	INT32 ylookuplen, maxylookup;
+	INT32 centerx, centery;
+	fixed_t centeryfrac;
+} drawqueue_t;
+
+static drawqueue_t drawqueues[2];
+static drawqueue_t *fillqueue = &drawqueues[0]; // draws are queued into this one
+static drawqueue_t *runqueue = NULL; // the threads are drawing this one
+
+// Render threads
+static INT32 numrenderthreads = 0; // spawned so far
+static INT32 activethreads = 0; // how many the next queue is shared by
+static INT32 threadsbusy = 0;
+static UINT32 queuegeneration = 0; // bumped every time the queue is handed out
+static boolean renderstop = false;
+static UINT32 spawngeneration[MAXRENDERTHREADS];
+
+static I_mutex render_mutex;
+static I_cond render_workcond;
+static I_cond render_donecond;
+
+void *R_DrawQueueAlloc(size_t size)
+{
+	drawqueue_t *q = fillqueue;
+	queueblock_t *block = q->curblock;
+	void *p;
+
+	size = (size + 15) & ~(size_t)15;
+
+	while (block && block->size - block->used < size)
+	{
+		block = block->next;
+		if (block)
+			block->used = 0;
+	}
+
+	if (!block)
+	{
+		size_t blocksize = max(size, QUEUEBLOCKSIZE);
+		block = malloc(sizeof (queueblock_t) + blocksize);
+		if (!block)
+			I_Error("R_DrawQueueAlloc: out of memory");
+		block->size = blocksize;
+		block->used = 0;
+		// Goes after the current block, so it gets used first next view too
+		if (q->curblock)
+		{
+			block->next = q->curblock->next;
+			q->curblock->next = block;
+		}
+		else
+		{
+			block->next = q->blocks;
+			q->blocks = block;
+		}
+	}
+
+	q->curblock = block;
+	p = (UINT8 *)(block + 1) + block->used;
+	block->used += size;
+	return p;
+}
+
+static drawcmd_t *R_NewDrawCmd(void (*func)(void), boolean span)
+{
+	drawqueue_t *q = fillqueue;
+	drawcmd_t *cmd;
+
+	if (q->numcmds == q->maxcmds)
+	{
+		q->maxcmds = q->maxcmds ? q->maxcmds*2 : 16384;
+		q->cmds = realloc(q->cmds, q->maxcmds * sizeof (*q->cmds));
+		if (!q->cmds)
+			I_Error("R_NewDrawCmd: out of memory");
+	}
+
+	cmd = &q->cmds[q->numcmds++];
+	cmd->func = func;
+	cmd->span = span;
+	return cmd;
+}
+
+void R_QueueColumn(void (*func)(void))
+{
+	colstate_t *col = &R_NewDrawCmd(func, false)->u.col;
+
+	col->colormap = dc_colormap;
+	col->x = dc_x;
+	col->yl = dc_yl;
+	col->yh = dc_yh;
+	col->iscale = dc_iscale;
+	col->texturemid = dc_texturemid;
+	col->hires = dc_hires;
+	col->source = dc_source;
+	col->transmap = dc_transmap;
+	col->translation = dc_translation;
+	col->texheight = dc_texheight;
+	col->numlights = dc_numlights;
+	col->lightlist = NULL;
+	if (dc_numlights && dc_lightlist)
+	{
+		col->lightlist = R_DrawQueueAlloc(dc_numlights * sizeof (r_lightlist_t));
+		M_Memcpy(col->lightlist, dc_lightlist, dc_numlights * sizeof (r_lightlist_t));
+	}
+}
+
+void R_QueueSpan(void (*func)(void))
+{
+	spanstate_t *span = &R_NewDrawCmd(func, true)->u.span;
+
+	span->y = ds_y;
+	span->x1 = ds_x1;
+	span->x2 = ds_x2;
+	span->colormap = ds_colormap;
+	span->xfrac = ds_xfrac;
+	span->yfrac = ds_yfrac;
+	span->xstep = ds_xstep;
+	span->ystep = ds_ystep;
+	span->source = ds_source;
+	span->transmap = ds_transmap;
+	span->flatxshift = nflatxshift;
+	span->flatyshift = nflatyshift;
+	span->flatshiftup = nflatshiftup;
+	span->flatmask = nflatmask;
+	span->zlight = planezlight;
+#ifdef ESLOPE
+	span->slope = ds_slope;
+	span->su = ds_su;
+	span->sv = ds_sv;
+	span->sz = ds_sz;
+	span->zeroheight = zeroheight;
+	span->viewx = viewx;
+	span->viewy = viewy;
+	span->viewz = viewz;
+#endif
+}
+
+// Runs every draw in q that touches columns x1 to x2.
+static void R_RunDrawStrip(const drawqueue_t *q, INT32 x1, INT32 x2)
+{
+	size_t i;
+
+	// This thread's copy of the view the draws were queued for
+	topleft = q->topleft;
+	M_Memcpy(ylookup, q->ylookup, q->ylookuplen * sizeof (*ylookup));
+	centerx = q->centerx;
+	centery = q->centery;
+	centeryfrac = q->centeryfrac;
+
+	for (i = 0; i < q->numcmds; i++)
+	{
+		const drawcmd_t *cmd = &q->cmds[i];
+
+		if (!cmd->span)
+		{
+			const colstate_t *col = &cmd->u.col;
+
+			if (col->x < x1 || col->x > x2)
+				continue;
+
+			dc_colormap = col->colormap;
+			dc_x = col->x;
+			dc_yl = col->yl;
+			dc_yh = col->yh;
+			dc_iscale = col->iscale;
+			dc_texturemid = col->texturemid;
+			dc_hires = col->hires;
+			dc_source = col->source;
+			dc_transmap = col->transmap;
+			dc_translation = col->translation;
+			dc_texheight = col->texheight;
+			dc_lightlist = col->lightlist;
+			dc_numlights = col->numlights;
+		}
+		else
+		{
+			const spanstate_t *span = &cmd->u.span;
+			INT32 skip;
+
+			if (span->x2 < x1 || span->x1 > x2)
+				continue;
+
+			// Start the span at our strip, stepping the texture
+			// coordinates on as if the pixels before it were drawn.
+			skip = span->x1 < x1 ? x1 - span->x1 : 0;
+			ds_y = span->y;
+			ds_x1 = span->x1 + skip;
+			ds_x2 = span->x2 > x2 ? x2 : span->x2;
+			ds_xfrac = (fixed_t)((UINT32)span->xfrac + (UINT32)span->xstep*(UINT32)skip);
+			ds_yfrac = (fixed_t)((UINT32)span->yfrac + (UINT32)span->ystep*(UINT32)skip);
+			ds_xstep = span->xstep;
+			ds_ystep = span->ystep;
+			ds_colormap = span->colormap;
+			ds_source = span->source;
+			ds_transmap = span->transmap;
+			nflatxshift = span->flatxshift;
+			nflatyshift = span->flatyshift;
+			nflatshiftup = span->flatshiftup;
+			nflatmask = span->flatmask;
+			planezlight = span->zlight;
+#ifdef ESLOPE
+			ds_slope = span->slope;
+			ds_su = span->su;
+			ds_sv = span->sv;
+			ds_sz = span->sz;
+			zeroheight = span->zeroheight;
+			viewx = span->viewx;
+			viewy = span->viewy;
+			viewz = span->viewz;
+#endif
+		}
+
+		cmd->func();
+	}
+}
+
+static void R_RenderThread(void *userdata)
+{
+	const INT32 id = (INT32)(size_t)userdata;
+	UINT32 seen = spawngeneration[id];
+	const drawqueue_t *q;
+	INT32 n;
+
+	I_lock_mutex(&render_mutex);
+	for (;;)
+	{
+		while (seen == queuegeneration && !renderstop)
+			I_hold_cond(&render_workcond, render_mutex);
+		if (renderstop)
+			break;
+
+		seen = queuegeneration;
+		q = runqueue;
+		n = q->numthreads;
+		if (id >= n)
+			continue;
+		I_unlock_mutex(render_mutex);
+
+		R_RunDrawStrip(q, id*q->viewwidth/n, (id+1)*q->viewwidth/n - 1);
+
+		I_lock_mutex(&render_mutex);
+		if (--threadsbusy == 0)
+			I_wake_all_cond(&render_donecond);
+	}
+	I_unlock_mutex(render_mutex);
+}
+
+static void R_StopRenderThreads(void)
+{
+	I_lock_mutex(&render_mutex);
+	renderstop = true;
+	I_wake_all_cond(&render_workcond);
+	I_unlock_mutex(render_mutex);
+}
+
+//
+// R_SendFillQueue
+//
+// Hands the queued draws to the render threads, and starts queuing into the
+// other queue. The threads have to be done with that one already.
+//
+static void R_SendFillQueue(void)
+{
+	drawqueue_t *q = fillqueue;
+
+	r_queuedraws = false;
+
+	if (q->numcmds)
+	{
+		q->numthreads = activethreads;
+		q->viewwidth = viewwidth;
+		q->topleft = topleft;
+		q->centerx = centerx;
+		q->centery = centery;
+		q->centeryfrac = centeryfrac;
+		q->ylookuplen = viewheight;
+		if (q->ylookuplen > q->maxylookup)
+		{
+			q->maxylookup = q->ylookuplen;
+			q->ylookup = realloc(q->ylookup, q->maxylookup * sizeof (*q->ylookup));
+			if (!q->ylookup)
+				I_Error("R_SendFillQueue: out of memory");
+		}
+		M_Memcpy(q->ylookup, ylookup, q->ylookuplen * sizeof (*ylookup));
+
+		I_lock_mutex(&render_mutex);
+		runqueue = q;
+		threadsbusy = q->numthreads;
+		queuegeneration++;
+		I_wake_all_cond(&render_workcond);
+		I_unlock_mutex(render_mutex);
+
+		fillqueue = (q == &drawqueues[0]) ? &drawqueues[1] : &drawqueues[0];
+	}
+
+	q = fillqueue;
+	q->numcmds = 0;
+	q->curblock = q->blocks;
+	if (q->curblock)
+		q->curblock->used = 0;
+}
+
+#endif // RENDERTHREADS
+
+void R_WaitDrawQueue(void)
+{
+#ifdef RENDERTHREADS
+	I_lock_mutex(&render_mutex);
+	while (threadsbusy)
+		I_hold_cond(&render_donecond, render_mutex);
+	I_unlock_mutex(render_mutex);
+#endif
+}
+
+void R_StartDrawQueue(void)
+{
+#ifdef RENDERTHREADS
+	INT32 wanted = cv_renderthreads.value;
+
+	r_queuedraws = false;
+	if (wanted < 2 || renderstop || rendermode != render_soft)
+	{
+		// This view will draw as it goes, on top of anything still queued
+		R_WaitDrawQueue();
+		return;
+	}
+
+	if (numrenderthreads == 0)
+		I_AddExitFunc(R_StopRenderThreads);
+	while (numrenderthreads < wanted)
+	{
+		spawngeneration[numrenderthreads] = queuegeneration;
+		I_spawn_thread("render", R_RenderThread, (void *)(size_t)numrenderthreads);
+		numrenderthreads++;
+	}
+
+	activethreads = wanted;
+	r_queuedraws = true;
+#endif
+}
+
+void R_SendDrawQueue(void)
+{
+#ifdef RENDERTHREADS
+	if (!r_queuedraws)
+		return;
+
+	// Only one queue is drawn at a time
+	R_WaitDrawQueue();
+	R_SendFillQueue();
+#endif
+}
+
+void R_FinishDrawQueue(void)
+{
+	R_SendDrawQueue();
+	R_WaitDrawQueue();
+}
@@ -0,0 +1,72 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  r_threads.h
+/// \brief Threaded drawing for the software renderer
+///
+///        While a view is rendered, every column and span drawer call goes
+///        into a queue instead of being run. At the end of the view the
+///        screen is split into vertical strips, and each render thread runs
+///        the queued draws that touch its strip, in order. BSP traversal,
+///        clipping and sprite sorting stay on the main thread.
+///
+///        With split screen, the first view is only sent off, not waited
+///        for, so the threads draw it while the main thread goes through
+///        the second view.
+
+#ifndef __R_THREADS__
+#define __R_THREADS__
+
+#include "command.h"
+
+#ifdef RENDERTHREADS
+
+#define MAXRENDERTHREADS 16
+
+extern consvar_t cv_renderthreads;
+
+// True while drawer calls are being queued.
+extern boolean r_queuedraws;
+
+void R_QueueColumn(void (*func)(void));
+void R_QueueSpan(void (*func)(void));
+
+/**	\brief Memory that stays valid until the queued draws have run.
+	Column data the drawers read from must outlive the caller when queuing.
+*/
+void *R_DrawQueueAlloc(size_t size);
+
+// Use these instead of calling colfunc() or spanfunc() directly.
+#define R_DrawColumnFunc(func) (r_queuedraws ? R_QueueColumn(func) : (func)())
+#define R_DrawSpanFunc(func) (r_queuedraws ? R_QueueSpan(func) : (func)())
+
+#else
+
+#define R_DrawColumnFunc(func) (func)()
+#define R_DrawSpanFunc(func) (func)()
+
+#endif // RENDERTHREADS
+
+/**	\brief Starts queuing draws for a view, if cv_renderthreads asks for it.
+*/
+void R_StartDrawQueue(void);
+
+/**	\brief Hands the queued draws to the render threads without waiting.
+	Nothing may look at the view's pixels until R_WaitDrawQueue.
+*/
+void R_SendDrawQueue(void);
+
+/**	\brief Waits for the render threads to finish every draw they were sent.
+*/
+void R_WaitDrawQueue(void);
+
+/**	\brief Runs every queued draw on the render threads, and waits for them.
+*/
+void R_FinishDrawQueue(void);
+
+#endif // __R_THREADS__
@@ -36,6 +36,7 @@ extern INT32 msg_id;
 #include "d_main.h"
 #include "r_sky.h" // skyflatnum
 #include "p_local.h" // camera info
+#include "p_predict.h"
 #include "m_misc.h" // for tunes command
 
 #if defined(HAVE_BLUA) && defined(HAVE_LUA_MUSICPLUS)
@@ -89,6 +90,13 @@ consvar_t stereoreverse = {"stereoreverse", "Off", CV_SAVE, CV_OnOff, NULL, 0, N
 // if true, all sounds are loaded at game startup
 static consvar_t precachesound = {"precachesound", "Off", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
 
+static CV_PossibleValue_t sfxcachesize_cons_t[] = {{0, "MIN"}, {512, "MAX"}, {0, NULL}};
+consvar_t cv_sfxcachesize = {"sfxcachesize", "32", CV_SAVE, sfxcachesize_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+// how many channels one sound can have at once, 0 for as many as there are
+static CV_PossibleValue_t sfxinstances_cons_t[] = {{0, "MIN"}, {64, "MAX"}, {0, NULL}};
+consvar_t cv_sfxinstances = {"sfxinstances", "6", CV_SAVE, sfxinstances_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
 // actual general (maximum) sound & music volume, saved into the config
 consvar_t cv_soundvolume = {"soundvolume", "18", CV_SAVE, soundvolume_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
 consvar_t cv_digmusicvolume = {"digmusicvolume", "18", CV_SAVE, soundvolume_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
@@ -153,6 +161,13 @@ typedef struct
 	// handle of the sound being played
 	INT32 handle;
 
+	// volume it was last heard at, for picking which to stop
+	INT32 volume;
+
+	// where the origin was when that was worked out
+	fixed_t x, y, z;
+	boolean moved; // or if it has to be worked out again anyway
+
 } channel_t;
 
 // the set of channels available
@@ -168,74 +183,100 @@ static void S_StopChannel(INT32 cnum);
 // S_getChannel
 //
 // If none available, return -1. Otherwise channel #.
+// When every channel is taken, the least important sound is
+// stopped: the lowest priority, and the quietest of those.
 //
-static INT32 S_getChannel(const void *origin, sfxinfo_t *sfxinfo)
+static INT32 S_getChannel(const void *origin, sfxinfo_t *sfxinfo, INT32 volume)
 {
 	// channel number to use
-	INT32 cnum;
+	INT32 cnum, freecnum = -1, weakest = -1, quietestsame = -1, instances = 0;
 
 	channel_t *c;
 
-	// Find an open channel
+	// Find an open channel, counting how many times this sound is playing
 	for (cnum = 0; cnum < numofchannels; cnum++)
 	{
-		if (!channels[cnum].sfxinfo)
-			break;
+		c = &channels[cnum];
+
+		if (!c->sfxinfo)
+		{
+			if (freecnum == -1)
+				freecnum = cnum;
+			continue;
+		}
+
+		if (c->sfxinfo == sfxinfo)
+		{
+			instances++;
+			if (quietestsame == -1 || c->volume < channels[quietestsame].volume)
+				quietestsame = cnum;
+		}
+
+		if (c->sfxinfo->priority <= sfxinfo->priority
+			&& (weakest == -1 || c->sfxinfo->priority < channels[weakest].sfxinfo->priority
+			|| (c->sfxinfo->priority == channels[weakest].sfxinfo->priority && c->volume < channels[weakest].volume)))
+			weakest = cnum;
+
+		// Past an open channel, the sounds playing are only being counted
+		if (freecnum != -1)
+			continue;
 
 		// Now checks if same sound is being played, rather
 		// than just one sound per mobj
-		else if (sfxinfo == channels[cnum].sfxinfo && (sfxinfo->pitch & SF_NOMULTIPLESOUND))
-		{
+		if (sfxinfo == c->sfxinfo && (sfxinfo->pitch & SF_NOMULTIPLESOUND))
 			return -1;
-			break;
-		}
-		else if (sfxinfo == channels[cnum].sfxinfo && sfxinfo->singularity == true)
+		else if (sfxinfo == c->sfxinfo && sfxinfo->singularity == true)
 		{
 			S_StopChannel(cnum);
-			break;
+			goto gotchannel;
 		}
-		else if (origin && channels[cnum].origin == origin && channels[cnum].sfxinfo == sfxinfo)
+		else if (origin && c->origin == origin && c->sfxinfo == sfxinfo)
 		{
 			if (sfxinfo->pitch & SF_NOINTERRUPT)
 				return -1;
-			else
-				S_StopChannel(cnum);
-			break;
+			S_StopChannel(cnum);
+			goto gotchannel;
 		}
-		else if (origin && channels[cnum].origin == origin
-			&& channels[cnum].sfxinfo->name != sfxinfo->name
-			&& channels[cnum].sfxinfo->pitch == SF_TOTALLYSINGLE && sfxinfo->pitch == SF_TOTALLYSINGLE)
+		else if (origin && c->origin == origin
+			&& c->sfxinfo->name != sfxinfo->name
+			&& c->sfxinfo->pitch == SF_TOTALLYSINGLE && sfxinfo->pitch == SF_TOTALLYSINGLE)
 		{
 			S_StopChannel(cnum);
-			break;
+			goto gotchannel;
 		}
 	}
 
-	// None available
-	if (cnum == numofchannels)
+	// Too many of this sound at once already? Replace the quietest, if it's quieter.
+	if (cv_sfxinstances.value && instances >= cv_sfxinstances.value)
 	{
-		// Look for lower priority
-		for (cnum = 0; cnum < numofchannels; cnum++)
-			if (channels[cnum].sfxinfo->priority <= sfxinfo->priority)
-				break;
-
-		if (cnum == numofchannels)
-		{
-			// No lower priority. Sorry, Charlie.
+		if (channels[quietestsame].volume > volume)
 			return -1;
-		}
-		else
-		{
-			// Otherwise, kick out lower priority.
-			S_StopChannel(cnum);
-		}
+		cnum = quietestsame;
+		S_StopChannel(cnum);
+	}
+	else if (freecnum != -1)
+		cnum = freecnum;
+	else if (weakest != -1 && (channels[weakest].sfxinfo->priority < sfxinfo->priority
+		|| channels[weakest].volume <= volume))
+	{
+		// Kick out a less important sound.
+		cnum = weakest;
+		S_StopChannel(cnum);
+	}
+	else
+	{
+		// No lower priority. Sorry, Charlie.
+		return -1;
 	}
 
+gotchannel:
 	c = &channels[cnum];
 
 	// channel is decided to be cnum.
 	c->sfxinfo = sfxinfo;
 	c->origin = origin;
+	c->volume = volume;
+	c->moved = true;
 
 	return cnum;
 }
@@ -250,6 +291,8 @@ void S_RegisterSoundStuff(void)
 
 	CV_RegisterVar(&stereoreverse);
 	CV_RegisterVar(&precachesound);
+	CV_RegisterVar(&cv_sfxcachesize);
+	CV_RegisterVar(&cv_sfxinstances);
 
 #ifdef SNDSERV
 	CV_RegisterVar(&sndserver_cmd);
@@ -348,6 +391,14 @@ lumpnum_t S_GetSfxLumpNum(sfxinfo_t *sfx)
 	return W_GetNumForName("dsthok");
 }
 
+// Loads a sound to play it, telling the lump trace it was wanted
+static void *S_GetSfx(sfxinfo_t *sfx)
+{
+	if (W_LumpMissHook)
+		W_LumpMissHook(sfx->lumpnum != LUMPERROR ? sfx->lumpnum : S_GetSfxLumpNum(sfx), LUMPMISS_SOUND);
+	return I_GetSfx(sfx);
+}
+
 // Stop all sounds, load level info, THEN start sounds.
 void S_StopSounds(void)
 {
@@ -426,7 +477,7 @@ void S_StartSoundAtVolume(const void *origin_p, sfxenum_t sfx_id, INT32 volume)
 	mobj_t *listenmobj = players[displayplayer].mo;
 	mobj_t *listenmobj2 = NULL;
 
-	if (sound_disabled || !sound_started)
+	if (sound_disabled || !sound_started || p_predicting)
 		return;
 
 	// Don't want a sound? Okay then...
@@ -526,7 +577,7 @@ void S_StartSoundAtVolume(const void *origin_p, sfxenum_t sfx_id, INT32 volume)
 			sep = NORM_SEP;
 
 		// try to find a channel
-		cnum = S_getChannel(origin, sfx);
+		cnum = S_getChannel(origin, sfx, volume);
 
 		if (cnum < 0)
 			return; // If there's no free channels, it's not gonna be free for player 1, either.
@@ -538,7 +589,7 @@ void S_StartSoundAtVolume(const void *origin_p, sfxenum_t sfx_id, INT32 volume)
 		// cache data if necessary
 		// NOTE: set sfx->data NULL sfx->lump -1 to force a reload
 		if (!sfx->data)
-			sfx->data = I_GetSfx(sfx);
+			sfx->data = S_GetSfx(sfx);
 
 		// increase the usefulness
 		if (sfx->usefulness++ < 0)
@@ -576,7 +627,7 @@ dontplay:
 		sep = NORM_SEP;
 
 	// try to find a channel
-	cnum = S_getChannel(origin, sfx);
+	cnum = S_getChannel(origin, sfx, volume);
 
 	if (cnum < 0)
 		return;
@@ -588,7 +639,7 @@ dontplay:
 	// cache data if necessary
 	// NOTE: set sfx->data NULL sfx->lump -1 to force a reload
 	if (!sfx->data)
-		sfx->data = I_GetSfx(sfx);
+		sfx->data = S_GetSfx(sfx);
 
 	// increase the usefulness
 	if (sfx->usefulness++ < 0)
@@ -707,9 +758,24 @@ static INT32 actualsfxvolume; // check for change through console
 static INT32 actualdigmusicvolume;
 static INT32 actualmidimusicvolume;
 
+// where the listeners were last update, to tell if they've moved since
+static listener_t lastlistener, lastlistener2;
+
+static void S_SetChannelPosition(channel_t *c, INT32 volume)
+{
+	const mobj_t *soundmobj = c->origin;
+
+	c->volume = volume;
+	c->x = soundmobj->x;
+	c->y = soundmobj->y;
+	c->z = soundmobj->z;
+	c->moved = false;
+}
+
 void S_UpdateSounds(void)
 {
 	INT32 audible, cnum, volume, sep, pitch;
+	boolean listenersmoved;
 	channel_t *c;
 
 	listener_t listener;
@@ -801,6 +867,12 @@ void S_UpdateSounds(void)
 		}
 	}
 
+	// If nobody has moved, what's playing sounds the same as it did
+	listenersmoved = memcmp(&listener, &lastlistener, sizeof (listener_t))
+		|| memcmp(&listener2, &lastlistener2, sizeof (listener_t));
+	lastlistener = listener;
+	lastlistener2 = listener2;
+
 	for (cnum = 0; cnum < numofchannels; cnum++)
 	{
 		c = &channels[cnum];
@@ -809,6 +881,13 @@ void S_UpdateSounds(void)
 		{
 			if (I_SoundIsPlaying(c->handle))
 			{
+				if (c->origin && !listenersmoved && !c->moved)
+				{
+					const mobj_t *soundmobj = c->origin;
+					if (soundmobj->x == c->x && soundmobj->y == c->y && soundmobj->z == c->z)
+						continue;
+				}
+
 				// initialize parameters
 				volume = 255; // 8 bits internal volume precision
 				pitch = NORM_PITCH;
@@ -857,6 +936,9 @@ void S_UpdateSounds(void)
 						else
 							S_StopChannel(cnum);
 					}
+
+					if (c->sfxinfo)
+						S_SetChannelPosition(c, volume);
 				}
 			}
 			else
@@ -886,6 +968,100 @@ void S_SetSfxVolume(INT32 volume)
 #endif
 }
 
+static void S_PrefetchSound(sfxenum_t id)
+{
+	sfxinfo_t *sfx;
+
+	if (id <= sfx_None || id >= NUMSFX)
+		return;
+
+	sfx = &S_sfx[id];
+	if (sfx->name && !sfx->data)
+		I_PrefetchSfx(sfx);
+}
+
+//
+// S_PrefetchLevelSounds
+//
+// Gets the sounds of everything in the level ready before they're first
+// heard, along with the ones every player makes.
+//
+void S_PrefetchLevelSounds(void)
+{
+	static const sfxenum_t playersounds[] = {
+		sfx_jump, sfx_spin, sfx_zoom, sfx_thok, sfx_skid,
+		sfx_itemup, sfx_spring, sfx_pop, sfx_splash
+	};
+	UINT8 seen[(NUMMOBJTYPES + 7)/8];
+	thinker_t *th;
+	size_t i;
+
+	if (dedicated || sound_disabled)
+		return;
+
+	for (i = 0; i < sizeof playersounds / sizeof *playersounds; i++)
+		S_PrefetchSound(playersounds[i]);
+
+	memset(seen, 0, sizeof seen);
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		mobjtype_t type;
+
+		if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+			continue;
+
+		type = ((mobj_t *)th)->type;
+		if (seen[type/8] & (1<<(type%8)))
+			continue;
+		seen[type/8] |= 1<<(type%8);
+
+		S_PrefetchMobjSounds(type);
+	}
+}
+
+//
+// S_PrefetchSoundLump
+//
+// Gets the sound whose lump this is ready, for a warm-up trace.
+//
+void S_PrefetchSoundLump(lumpnum_t lumpnum)
+{
+	const char *name;
+	size_t i;
+
+	if (dedicated || sound_disabled || !(name = W_CheckNameForNum(lumpnum)))
+		return;
+	if (!strnicmp(name, "ds", 2))
+		name += 2;
+
+	for (i = 1; i < NUMSFX; i++)
+		if (S_sfx[i].name && (S_sfx[i].lumpnum == lumpnum || !stricmp(S_sfx[i].name, name)))
+		{
+			S_PrefetchSound((sfxenum_t)i);
+			return;
+		}
+}
+
+//
+// S_PrefetchMobjSounds
+//
+// Gets the sounds a type of object makes ready.
+//
+void S_PrefetchMobjSounds(mobjtype_t type)
+{
+	const mobjinfo_t *info;
+
+	if (dedicated || sound_disabled || type >= NUMMOBJTYPES)
+		return;
+
+	info = &mobjinfo[type];
+	S_PrefetchSound(info->seesound);
+	S_PrefetchSound(info->attacksound);
+	S_PrefetchSound(info->painsound);
+	S_PrefetchSound(info->deathsound);
+	S_PrefetchSound(info->activesound);
+}
+
 void S_ClearSfx(void)
 {
 #ifndef DJGPPDOS
@@ -947,6 +1123,32 @@ fixed_t S_CalculateSoundDistance(fixed_t sx1, fixed_t sy1, fixed_t sz1, fixed_t
 	return approx_dist;
 }
 
+//
+// S_AudibleRadius
+//
+// How far away, in whole units, sfxinfo can be heard from.
+// Anything further than that along any one axis is further away
+// than that in S_CalculateSoundDistance too. 0 if there's no limit.
+//
+static INT32 S_AudibleRadius(const sfxinfo_t *sfxinfo)
+{
+	INT32 shift = 0;
+
+	if (sfxinfo->pitch & SF_X8AWAYSOUND)
+		shift += 3;
+	if (sfxinfo->pitch & SF_X4AWAYSOUND)
+		shift += 2;
+	if (sfxinfo->pitch & SF_X2AWAYSOUND)
+		shift += 1;
+
+	// Past what S_CalculateSoundDistance clips to, it's heard everywhere
+	if ((S_CLIPPING_DIST>>FRACBITS)<<shift >= FRACUNIT/2)
+		return 0;
+
+	// a little slack for the rounding in FixedDiv
+	return ((S_CLIPPING_DIST>>FRACBITS)<<shift) + (1<<shift);
+}
+
 //
 // Changes volume, stereo-separation, and pitch variables
 // from the norm of a sound effect to be played.
@@ -1018,6 +1220,14 @@ INT32 S_AdjustSoundParams(const mobj_t *listener, const mobj_t *source, INT32 *v
 	}
 	else
 	{
+		const INT32 radius = S_AudibleRadius(sfxinfo);
+
+		// Obviously too far away? Don't bother working out how far.
+		if (radius && (abs((listensource.x>>FRACBITS) - (source->x>>FRACBITS)) > radius
+			|| abs((listensource.y>>FRACBITS) - (source->y>>FRACBITS)) > radius
+			|| abs((listensource.z>>FRACBITS) - (source->z>>FRACBITS)) > radius))
+			return 0;
+
 		approx_dist = S_CalculateSoundDistance(listensource.x, listensource.y, listensource.z,
 												source->x, source->y, source->z);
 	}
@@ -1204,11 +1414,12 @@ void S_InitSfxChannels(INT32 sfxVolume)
 	if (!sound_disabled && (M_CheckParm("-precachesound") || precachesound.value))
 	{
 		// Initialize external data (all sounds) at start, keep static.
+		// Where the interface can, they're decoded in the background.
 		CONS_Printf(M_GetText("Loading sounds... "));
 
 		for (i = 1; i < NUMSFX; i++)
 			if (S_sfx[i].name)
-				S_sfx[i].data = I_GetSfx(&S_sfx[i]);
+				I_PrefetchSfx(&S_sfx[i]);
 
 		CONS_Printf(M_GetText(" pre-cached all sound data\n"));
 	}
@@ -1317,6 +1528,8 @@ boolean S_MusicExists(const char *mname, boolean checkMIDI, boolean checkDigi)
 
 boolean S_SpeedMusic(float speed)
 {
+	if (p_predicting)
+		return false;
 	return I_SetSongSpeed(speed);
 }
 
@@ -1407,6 +1620,29 @@ static boolean S_LoadMusic(const char *mname)
 		return false;
 }
 
+void S_PrefetchMusic(const char *mmusic)
+{
+	lumpnum_t mlumpnum;
+	void *mdata;
+
+	if (S_MusicDisabled() || !mmusic[0] || !strnicmp(music_name, mmusic, 6))
+		return;
+
+	if (!S_DigMusicDisabled() && S_DigExists(mmusic))
+		mlumpnum = W_GetNumForName(va("o_%s", mmusic));
+	else if (!S_MIDIMusicDisabled() && S_MIDIExists(mmusic))
+		mlumpnum = W_GetNumForName(va("d_%s", mmusic));
+	else
+		return; // S_LoadMusic complains when it's actually wanted
+
+	// S_LoadMusic gets the same data back out of the cache
+	mdata = W_CacheLumpNum(mlumpnum, PU_MUSIC);
+	I_PrefetchSong(mdata, W_LumpLength(mlumpnum));
+#ifndef HAVE_SDL //SDL uses RWOPS
+	Z_ChangeTag(mdata, PU_CACHE);
+#endif
+}
+
 static void S_UnloadMusic(void)
 {
 	I_UnloadSong();
@@ -1465,7 +1701,7 @@ void S_ChangeMusicEx(const char *mmusic, UINT16 mflags, boolean looping, UINT32
 	S_ClearSfx();
 #endif
 
-	if (S_MusicDisabled())
+	if (S_MusicDisabled() || p_predicting)
 		return;
 
 	strncpy(newmusic, mmusic, 7);
@@ -1489,6 +1725,7 @@ void S_ChangeMusicEx(const char *mmusic, UINT16 mflags, boolean looping, UINT32
 	{
 		CONS_Debug(DBG_DETAILED, "Now fading out song %s\n", music_name);
 		S_QueueMusic(newmusic, mflags, looping, position, fadeinms);
+		S_PrefetchMusic(newmusic); // open it while the old one fades
 		I_FadeSong(0, prefadems, S_ChangeMusicToQueue);
 		return;
 	}
@@ -1532,7 +1769,7 @@ void S_ChangeMusicEx(const char *mmusic, UINT16 mflags, boolean looping, UINT32
 
 void S_StopMusic(void)
 {
-	if (!I_SongPlaying())
+	if (!I_SongPlaying() || p_predicting)
 		return;
 
 	if (I_SongPaused())
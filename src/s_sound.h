@@ -19,6 +19,7 @@
 #include "m_fixed.h"
 #include "command.h"
 #include "tables.h" // angle_t
+#include "info.h" // mobjtype_t
 
 // mask used to indicate sound origin is player item pickup
 #define PICKUP_SOUND 0x8000
@@ -26,6 +27,7 @@
 extern consvar_t stereoreverse;
 extern consvar_t cv_soundvolume, cv_digmusicvolume, cv_midimusicvolume;
 extern consvar_t cv_numChannels;
+extern consvar_t cv_sfxinstances;
 extern consvar_t cv_resetmusic;
 extern consvar_t cv_gamedigimusic;
 extern consvar_t cv_gamemidimusic;
@@ -86,6 +88,21 @@ void S_StopSounds(void);
 void S_ClearSfx(void);
 void S_Start(void);
 
+//
+// Gets the sounds the level is going to need ready, in the background if it can.
+//
+void S_PrefetchLevelSounds(void);
+
+//
+// Gets the sounds a type of object makes ready, in the background if it can.
+//
+void S_PrefetchMobjSounds(mobjtype_t type);
+
+//
+// Gets the sound that plays a lump ready, the same way.
+//
+void S_PrefetchSoundLump(lumpnum_t lumpnum);
+
 //
 // Basically a W_GetNumForName that adds "ds" at the beginning of the string. Returns a lumpnum.
 //
@@ -159,6 +176,9 @@ void S_ChangeMusicEx(const char *mmusic, UINT16 mflags, boolean looping, UINT32
 // Stops the music.
 void S_StopMusic(void);
 
+// Reads in mmusic and has it opened ahead of time, to change to it sooner later
+void S_PrefetchMusic(const char *mmusic);
+
 // Stop and resume music, during game PAUSE.
 void S_PauseAudio(void);
 void S_ResumeAudio(void);
@@ -20,6 +20,7 @@
 #include "r_local.h"
 #include "r_sky.h"
 #include "m_argv.h"
+#include "m_cpu.h"
 #include "m_misc.h"
 #include "v_video.h"
 #include "st_stuff.h"
@@ -216,7 +217,9 @@ void SCR_Startup(void)
 	if (M_CheckParm("-SSE2"))
 		R_SSE2 = true;
 
+	M_DetectCPUFeatures();
 	M_SetupMemcpy();
+	R_SetupSpanKernels();
 
 	if (dedicated)
 	{
@@ -393,17 +396,42 @@ boolean SCR_IsAspectCorrect(INT32 width, INT32 height)
 	 );
 }
 
+// Visplane counts for the last frame, see r_planestats
+void SCR_DisplayPlaneStats(void)
+{
+	const planestats_t *ps = &planestats;
+	const INT32 flags = V_MONOSPACE|V_ALLOWLOWERCASE|V_SNAPTOLEFT|V_SNAPTOTOP;
+	UINT32 avg = ps->lookups ? ps->probes*100/ps->lookups : 0;
+
+	V_DrawThinString(2, 2, flags|V_YELLOWMAP, "Visplanes");
+	V_DrawThinString(2, 10, flags, va("Planes: %u (pool %s)", ps->planes, sizeu1(ps->allocated)));
+	V_DrawThinString(2, 18, flags, va("Splits: %u", ps->splits));
+	V_DrawThinString(2, 26, flags, va("Lookups: %u, %u.%02u compares each", ps->lookups, avg/100, avg%100));
+	V_DrawThinString(2, 34, flags, va("Buckets: %u/%d, longest chain %u", ps->buckets, MAXVISPLANES, ps->maxchain));
+	V_DrawThinString(2, 42, flags, va("Frame arena: %s, peak %s (%s in %u chunks)", sizeu1(framearenastats.used),
+		sizeu2(framearenastats.peak), sizeu3(framearenastats.allocated), framearenastats.chunks));
+}
+
 // XMOD FPS display
 // moved out of os-specific code for consistency
 static boolean fpsgraph[TICRATE];
 static tic_t lasttic;
 
+// Time between the last few frames, for how even they are
+#define FRAMESAMPLES 64
+static UINT32 frametimes[FRAMESAMPLES];
+static UINT32 numframetimes, lastframemicros;
+
 void SCR_DisplayTicRate(void)
 {
 	tic_t i;
 	tic_t ontic = I_GetTime();
 	tic_t totaltics = 0;
 	INT32 ticcntcolor = 0;
+	UINT32 now = I_GetTimeMicros();
+	UINT32 n, mean = 0, deviation = 0;
+	INT64 sum = 0, sumsq = 0;
+	const char *s;
 
 	for (i = lasttic + 1; i < TICRATE+lasttic && i < ontic; ++i)
 		fpsgraph[i % TICRATE] = false;
@@ -423,4 +451,28 @@ void SCR_DisplayTicRate(void)
 		ticcntcolor|V_NOSCALESTART, va("%02d/%02u", totaltics, TICRATE));
 
 	lasttic = ontic;
+
+	// Frame times, in tenths of a millisecond: the average, and how far
+	// they stray from it
+	if (lastframemicros)
+		frametimes[numframetimes++ % FRAMESAMPLES] = now - lastframemicros;
+	lastframemicros = now;
+
+	n = min(numframetimes, FRAMESAMPLES);
+	if (!n)
+		return;
+	for (i = 0; i < n; i++)
+	{
+		sum += frametimes[i];
+		sumsq += (INT64)frametimes[i] * frametimes[i];
+	}
+	mean = (UINT32)(sum / n);
+	deviation = (UINT32)sqrtf((float)(sumsq / n - (INT64)mean * mean));
+
+	s = va("%u.%ums", (mean + 50) / 1000, (mean + 50) / 100 % 10);
+	V_DrawString(vid.width-V_StringWidth(s, 0)*vid.dupx, vid.height-(32*vid.dupy),
+		V_NOSCALESTART, s);
+	s = va("+-%u.%u", (deviation + 50) / 1000, (deviation + 50) / 100 % 10);
+	V_DrawString(vid.width-V_StringWidth(s, 0)*vid.dupx, vid.height-(24*vid.dupy),
+		(deviation > 2000 ? V_REDMAP : 0)|V_NOSCALESTART, s);
 }
@@ -180,5 +180,6 @@ FUNCMATH boolean SCR_IsAspectCorrect(INT32 width, INT32 height);
 
 // move out to main code for consistency
 void SCR_DisplayTicRate(void);
+void SCR_DisplayPlaneStats(void);
 #undef DNWH
 #endif //__SCREEN_H__
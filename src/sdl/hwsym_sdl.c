@@ -82,14 +82,21 @@ void *hwSym(const char *funcName,void *handle)
 	GETFUNC(SetBlend);
 	GETFUNC(ClearBuffer);
 	GETFUNC(SetTexture);
+	GETFUNC(UpdateTexture);
+	GETFUNC(SetColormap);
 	GETFUNC(ReadRect);
 	GETFUNC(GClipRect);
 	GETFUNC(ClearMipMapCache);
 	GETFUNC(SetSpecialState);
 	GETFUNC(GetTextureUsed);
+	GETFUNC(GetTextureStats);
+	GETFUNC(MarkRenderSection);
+	GETFUNC(GetRenderStats);
+	GETFUNC(ReadScreenAsync);
 	GETFUNC(DrawMD2);
 	GETFUNC(DrawMD2i);
 	GETFUNC(SetTransform);
+	GETFUNC(SetBlendedTexture);
 	GETFUNC(GetRenderVersion);
 #ifdef SHUFFLE
 	GETFUNC(PostImgRedraw);
@@ -21,6 +21,7 @@
 #include "../m_argv.h"
 #include "../d_main.h"
 #include "../i_system.h"
+#include "../i_threads.h"
 
 #ifdef __GNUC__
 #include <unistd.h>
@@ -58,6 +59,9 @@ extern int SDL_main(int argc, char *argv[]);
 
 #ifdef LOGMESSAGES
 FILE *logstream = NULL;
+#ifdef HAVE_THREADS
+void I_StartLogThread(void); // sdl/i_system.c
+#endif
 #endif
 
 #ifndef DOXYGEN
@@ -174,6 +178,10 @@ int main(int argc, char **argv)
 #endif
 	//I_OutputMsg("I_StartupSystem() ...\n");
 	I_StartupSystem();
+#ifdef HAVE_THREADS
+	I_start_threads();
+	I_AddExitFunc(I_stop_threads);
+#endif
 	#ifdef _WII
 	// Credits to Andrew Piroli
 		// try a few times to initialize libwiisocket (?)
@@ -222,6 +230,10 @@ int main(int argc, char **argv)
 	// startup SRB2
 	CONS_Printf("Setting up SRB2...\n");
 	D_SRB2Main();
+#if defined (LOGMESSAGES) && defined (HAVE_THREADS)
+	// only now, as D_SRB2Main may have forked, and only the forking thread comes along
+	I_StartLogThread();
+#endif
 	CONS_Printf("Entering main game loop...\n");
 	// never return
 	D_SRB2Loop();
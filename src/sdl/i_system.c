@@ -170,6 +170,7 @@ static char returnWadPath[256];
 #include "../i_video.h"
 #include "../i_sound.h"
 #include "../i_system.h"
+#include "../i_threads.h"
 #include "../screen.h" //vid.WndParent
 #include "../d_net.h"
 #include "../g_game.h"
@@ -187,6 +188,10 @@ static char returnWadPath[256];
 
 #include "../d_main.h"
 
+#if defined (LOGMESSAGES) && defined (HAVE_THREADS)
+#define LOGTHREAD
+#endif
+
 #if !defined(NOMUMBLE) && defined(HAVE_MUMBLE)
 // Mumble context string
 #include "../d_clisrv.h"
@@ -238,6 +243,181 @@ SDL_bool framebuffer = SDL_FALSE;
 
 UINT8 keyboard_started = false;
 
+#ifdef LOGTHREAD
+//
+// The log writer
+//
+// Lines for logstream go into a ring buffer, and a thread writes them out
+// a batch at a time, flushing once per batch, so a slow disk never holds
+// up the game. I_FlushLog waits for everything to be written, for the
+// error and crash paths.
+//
+#define LOGBUFFERSIZE (256*1024)
+#define LOGBATCHMS 100 // how long the writer lets lines pile up
+
+static char logbuffer[LOGBUFFERSIZE];
+static size_t logput = 0, logtaken = 0; // running byte counts, wrapped into logbuffer
+static boolean logthread = false; // the writer is running
+static boolean logstop = false;
+static boolean logurgent = false; // someone is waiting, don't batch
+static I_mutex log_mutex;
+static I_cond log_cond; // there's something to write
+static I_cond log_donecond; // something has been written
+
+static void I_LogWriter(void *userdata)
+{
+	size_t put, taken, at, len;
+	(void)userdata;
+
+	I_lock_mutex(&log_mutex);
+	for (;;)
+	{
+		while (logput == logtaken && !logstop)
+			I_hold_cond(&log_cond, log_mutex);
+		if (logput == logtaken) // stopping, and everything's written
+			break;
+
+		if (!logstop && !logurgent)
+		{
+			I_unlock_mutex(log_mutex);
+			I_thread_sleep(LOGBATCHMS);
+			I_lock_mutex(&log_mutex);
+		}
+
+		put = logput;
+		taken = logtaken;
+		I_unlock_mutex(log_mutex);
+
+		// Nothing up to put gets written over until logtaken moves past it.
+		while (taken != put)
+		{
+			size_t d;
+			at = taken % LOGBUFFERSIZE;
+			len = min(put - taken, LOGBUFFERSIZE - at);
+			d = fwrite(&logbuffer[at], len, 1, logstream);
+			(void)d;
+			taken += len;
+		}
+		fflush(logstream);
+
+		I_lock_mutex(&log_mutex);
+		logtaken = taken;
+		I_wake_all_cond(&log_donecond);
+	}
+	logthread = false;
+	I_wake_all_cond(&log_donecond);
+	I_unlock_mutex(log_mutex);
+}
+
+// Waits up to about two seconds for pred to come true, without trusting
+// the writer to still be alive, since this also runs when something crashed.
+static boolean I_WaitForLog(boolean (*pred)(void))
+{
+	INT32 tries;
+	boolean done = false;
+
+	for (tries = 0; tries < 200 && !done; tries++)
+	{
+		I_lock_mutex(&log_mutex);
+		done = pred();
+		if (!done)
+		{
+			logurgent = true;
+			I_wake_one_cond(&log_cond);
+		}
+		I_unlock_mutex(log_mutex);
+		if (!done)
+			I_thread_sleep(10);
+	}
+	logurgent = false;
+	return done;
+}
+
+static boolean I_LogWritten(void)
+{
+	return !logthread || logtaken == logput;
+}
+
+static boolean I_LogStopped(void)
+{
+	return !logthread;
+}
+
+//
+// I_FlushLog
+//
+// Gets everything written so far into the log file.
+//
+static void I_FlushLog(void)
+{
+	if (!logstream)
+		return;
+	I_WaitForLog(I_LogWritten);
+	fflush(logstream);
+}
+
+static void I_StopLogThread(void)
+{
+	I_lock_mutex(&log_mutex);
+	logstop = true;
+	I_wake_one_cond(&log_cond);
+	I_unlock_mutex(log_mutex);
+	I_WaitForLog(I_LogStopped);
+}
+
+//
+// I_StartLogThread
+//
+// Called by main once startup is over. Until then, and after the
+// system shuts down, lines are written straight to the file.
+//
+void I_StartLogThread(void)
+{
+	if (!logstream || logthread || M_CheckParm("-synclog"))
+		return;
+	logthread = true;
+	I_spawn_thread("log-writer", I_LogWriter, NULL);
+	I_AddExitFunc(I_StopLogThread);
+}
+
+// Puts txt in the ring buffer, or writes it straight out if the writer isn't running.
+static void I_QueueLog(const char *txt, size_t len)
+{
+	size_t room, n, at;
+
+	I_lock_mutex(&log_mutex);
+	while (len)
+	{
+		if (!logthread)
+		{
+			size_t d = fwrite(txt, len, 1, logstream);
+			fflush(logstream);
+			(void)d;
+			break;
+		}
+
+		room = LOGBUFFERSIZE - (logput - logtaken);
+		if (!room) // the disk can't keep up, so wait for it after all
+		{
+			logurgent = true;
+			I_wake_one_cond(&log_cond);
+			I_hold_cond(&log_donecond, log_mutex);
+			logurgent = false;
+			continue;
+		}
+
+		at = logput % LOGBUFFERSIZE;
+		n = min(min(room, len), LOGBUFFERSIZE - at);
+		M_Memcpy(&logbuffer[at], txt, n);
+		logput += n;
+		txt += n;
+		len -= n;
+	}
+	I_wake_one_cond(&log_cond);
+	I_unlock_mutex(log_mutex);
+}
+#endif
+
 FUNCNORETURN static ATTRNORETURN void signal_handler(INT32 num)
 {
 	//static char msg[] = "oh no! back to reality!\r\n";
@@ -275,6 +455,9 @@ FUNCNORETURN static ATTRNORETURN void signal_handler(INT32 num)
 	}
 
 	I_OutputMsg("\nsignal_handler() error: %s\n", sigmsg);
+#ifdef LOGTHREAD
+	I_FlushLog();
+#endif
 
 	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR,
 		"Signal caught",
@@ -703,7 +886,10 @@ void I_OutputMsg(const char *fmt, ...)
 
 	len = strlen(txt);
 
-#ifdef LOGMESSAGES
+#ifdef LOGTHREAD
+	if (logstream)
+		I_QueueLog(txt, len);
+#elif defined (LOGMESSAGES)
 	if (logstream)
 	{
 		size_t d = fwrite(txt, len, 1, logstream);
@@ -2087,6 +2273,27 @@ tic_t I_GetTime (void)
 }
 #endif
 
+//
+// I_GetTimeMicros
+// returns time in microseconds, from the performance counter
+//
+UINT32 I_GetTimeMicros(void)
+{
+	static Uint64 basetime = 0, frequency = 0;
+	Uint64 ticks = SDL_GetPerformanceCounter();
+
+	if (!frequency)
+	{
+		frequency = SDL_GetPerformanceFrequency();
+		basetime = ticks;
+	}
+
+	ticks -= basetime;
+
+	// split up the division so a nanosecond counter doesn't overflow
+	return (UINT32)((ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency);
+}
+
 //
 //I_StartupTimer
 //
@@ -2119,6 +2326,11 @@ void I_Sleep(void)
 		SDL_Delay(cv_sleep.value);
 }
 
+void I_SleepMillis(UINT32 ms)
+{
+	SDL_Delay(ms);
+}
+
 INT32 I_StartupSystem(void)
 {
 	SDL_version SDLcompiled;
@@ -2265,6 +2477,9 @@ void I_Error(const char *error, ...)
 	vsprintf(buffer, error, argptr);
 	va_end(argptr);
 	I_OutputMsg("\nI_Error(): %s\n", buffer);
+#ifdef LOGTHREAD
+	I_FlushLog();
+#endif
 	// ---
 
 	I_ShutdownConsole();
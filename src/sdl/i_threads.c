@@ -0,0 +1,178 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  i_threads.c
+/// \brief Multithreading abstraction, SDL implementation
+
+#if defined (HAVE_SDL) && defined (HAVE_THREADS)
+
+#include "SDL.h"
+
+#include "../doomdef.h"
+#include "../i_system.h"
+#include "../i_threads.h"
+
+typedef struct thread_s
+{
+	SDL_Thread *thread;
+	I_thread_fn fn;
+	void *userdata;
+	struct thread_s *next;
+} thread_t;
+
+static thread_t *threads = NULL; // every thread ever spawned
+static SDL_mutex *threads_mutex = NULL;
+static SDL_atomic_t threads_stopped;
+
+// Guards the lazy creation of mutexes and conditions.
+static SDL_SpinLock anchor_lock = 0;
+
+static int SDLCALL ThreadEntry(void *data)
+{
+	thread_t *th = data;
+	th->fn(th->userdata);
+	return 0;
+}
+
+void I_start_threads(void)
+{
+	threads_mutex = SDL_CreateMutex();
+	if (!threads_mutex)
+		I_Error("I_start_threads: %s", SDL_GetError());
+	SDL_AtomicSet(&threads_stopped, 0);
+}
+
+void I_stop_threads(void)
+{
+	thread_t *th, *next;
+
+	if (!threads_mutex)
+		return;
+
+	SDL_AtomicSet(&threads_stopped, 1);
+
+	// Threads blocked on conditions are expected to be woken by whoever
+	// owns the condition, from an exit function registered before this one.
+	SDL_LockMutex(threads_mutex);
+	for (th = threads; th; th = next)
+	{
+		next = th->next;
+		SDL_WaitThread(th->thread, NULL);
+		free(th);
+	}
+	threads = NULL;
+	SDL_UnlockMutex(threads_mutex);
+
+	SDL_DestroyMutex(threads_mutex);
+	threads_mutex = NULL;
+}
+
+void I_spawn_thread(const char *name, I_thread_fn fn, void *userdata)
+{
+	thread_t *th = malloc(sizeof *th);
+
+	if (!th)
+		I_Error("I_spawn_thread: out of memory");
+
+	th->fn = fn;
+	th->userdata = userdata;
+
+	SDL_LockMutex(threads_mutex);
+	th->thread = SDL_CreateThread(ThreadEntry, name, th);
+	if (!th->thread)
+	{
+		SDL_UnlockMutex(threads_mutex);
+		free(th);
+		I_Error("I_spawn_thread: can't create thread %s: %s", name, SDL_GetError());
+	}
+	th->next = threads;
+	threads = th;
+	SDL_UnlockMutex(threads_mutex);
+}
+
+boolean I_thread_is_stopped(void)
+{
+	return SDL_AtomicGet(&threads_stopped) != 0;
+}
+
+INT32 I_num_cpus(void)
+{
+	INT32 n = SDL_GetCPUCount();
+	return n > 0 ? n : 1;
+}
+
+void I_thread_sleep(UINT32 ms)
+{
+	SDL_Delay(ms);
+}
+
+void I_lock_mutex(I_mutex *anchor)
+{
+	if (!*anchor)
+	{
+		SDL_AtomicLock(&anchor_lock);
+		if (!*anchor)
+		{
+			*anchor = SDL_CreateMutex();
+			if (!*anchor)
+			{
+				SDL_AtomicUnlock(&anchor_lock);
+				I_Error("I_lock_mutex: %s", SDL_GetError());
+			}
+		}
+		SDL_AtomicUnlock(&anchor_lock);
+	}
+
+	if (SDL_LockMutex(*anchor) == -1)
+		I_Error("I_lock_mutex: %s", SDL_GetError());
+}
+
+void I_unlock_mutex(I_mutex mutex)
+{
+	if (SDL_UnlockMutex(mutex) == -1)
+		I_Error("I_unlock_mutex: %s", SDL_GetError());
+}
+
+static SDL_cond *GetCond(I_cond *anchor)
+{
+	if (!*anchor)
+	{
+		SDL_AtomicLock(&anchor_lock);
+		if (!*anchor)
+		{
+			*anchor = SDL_CreateCond();
+			if (!*anchor)
+			{
+				SDL_AtomicUnlock(&anchor_lock);
+				I_Error("I_hold_cond: %s", SDL_GetError());
+			}
+		}
+		SDL_AtomicUnlock(&anchor_lock);
+	}
+	return *anchor;
+}
+
+void I_hold_cond(I_cond *anchor, I_mutex mutex)
+{
+	if (SDL_CondWait(GetCond(anchor), mutex) == -1)
+		I_Error("I_hold_cond: %s", SDL_GetError());
+}
+
+void I_wake_one_cond(I_cond *anchor)
+{
+	if (SDL_CondSignal(GetCond(anchor)) == -1)
+		I_Error("I_wake_one_cond: %s", SDL_GetError());
+}
+
+void I_wake_all_cond(I_cond *anchor)
+{
+	if (SDL_CondBroadcast(GetCond(anchor)) == -1)
+		I_Error("I_wake_all_cond: %s", SDL_GetError());
+}
+
+#endif
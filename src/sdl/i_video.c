@@ -127,6 +127,7 @@ static      SDL_Surface *vidSurface = NULL;
 static      SDL_Surface *bufSurface = NULL;
 static      SDL_Surface *icoSurface = NULL;
 static      SDL_Color    localPalette[256];
+static      Uint32       localPaletteLookup[256]; // localPalette in vidSurface's format
 #if 0
 static      SDL_Rect   **modeList = NULL;
 static       Uint8       BitsPerPixel = 16;
@@ -174,6 +175,7 @@ static INT32 windowedModes[MAXWINMODES][2] =
 };
 
 static void Impl_VideoSetupSDLBuffer(void);
+static void Impl_UpdatePaletteLookup(void);
 static void Impl_VideoSetupBuffer(void);
 static SDL_bool Impl_CreateWindow(SDL_bool fullscreen);
 //static void Impl_SetWindowName(const char *title);
@@ -269,6 +271,7 @@ static void SDLSetMode(INT32 width, INT32 height, SDL_bool fullscreen)
 		}
 		SDL_PixelFormatEnumToMasks(sw_texture_format, &bpp, &rmask, &gmask, &bmask, &amask);
 		vidSurface = SDL_CreateRGBSurface(0, width, height, bpp, rmask, gmask, bmask, amask);
+		Impl_UpdatePaletteLookup();
 	}
 }
 
@@ -1028,6 +1031,57 @@ static inline boolean I_SkipFrame(void)
 	return false;
 }
 
+// Works out what every palette index is in the texture's format
+static void Impl_UpdatePaletteLookup(void)
+{
+	size_t i;
+	if (!vidSurface)
+		return;
+	for (i = 0; i < 256; i++)
+		localPaletteLookup[i] = SDL_MapRGB(vidSurface->format, localPalette[i].r, localPalette[i].g, localPalette[i].b);
+}
+
+// Converts the 8-bit screen straight into the streaming texture,
+// instead of blitting it to vidSurface and copying that into the texture.
+// Palette changes only cost rebuilding localPaletteLookup.
+static SDL_bool Impl_BlitPalettedToTexture(void)
+{
+	const UINT8 *src = screens[0];
+	void *pixels;
+	UINT8 *dst;
+	int pitch;
+	INT32 x, y;
+
+	if (vid.bpp != 1 || !vidSurface)
+		return SDL_FALSE;
+	if (vidSurface->format->BytesPerPixel != 2 && vidSurface->format->BytesPerPixel != 4)
+		return SDL_FALSE;
+	if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0)
+		return SDL_FALSE;
+
+	dst = pixels;
+	for (y = 0; y < vid.height; y++)
+	{
+		if (vidSurface->format->BytesPerPixel == 2)
+		{
+			Uint16 *out = (Uint16 *)dst;
+			for (x = 0; x < vid.width; x++)
+				out[x] = (Uint16)localPaletteLookup[src[x]];
+		}
+		else
+		{
+			Uint32 *out = (Uint32 *)dst;
+			for (x = 0; x < vid.width; x++)
+				out[x] = localPaletteLookup[src[x]];
+		}
+		src += vid.rowbytes;
+		dst += pitch;
+	}
+
+	SDL_UnlockTexture(texture);
+	return SDL_TRUE;
+}
+
 //
 // I_FinishUpdate
 //
@@ -1051,17 +1105,20 @@ void I_FinishUpdate(void)
 		rect.w = vid.width;
 		rect.h = vid.height;
 
-		if (!bufSurface) //Double-Check
+		if (!Impl_BlitPalettedToTexture())
 		{
-			Impl_VideoSetupSDLBuffer();
-		}
-		if (bufSurface)
-		{
-			SDL_BlitSurface(bufSurface, NULL, vidSurface, &rect);
-			// Fury -- there's no way around UpdateTexture, the GL backend uses it anyway
-			SDL_LockSurface(vidSurface);
-			SDL_UpdateTexture(texture, &rect, vidSurface->pixels, vidSurface->pitch);
-			SDL_UnlockSurface(vidSurface);
+			if (!bufSurface) //Double-Check
+			{
+				Impl_VideoSetupSDLBuffer();
+			}
+			if (bufSurface)
+			{
+				SDL_BlitSurface(bufSurface, NULL, vidSurface, &rect);
+				// Fury -- there's no way around UpdateTexture, the GL backend uses it anyway
+				SDL_LockSurface(vidSurface);
+				SDL_UpdateTexture(texture, &rect, vidSurface->pixels, vidSurface->pitch);
+				SDL_UnlockSurface(vidSurface);
+			}
 		}
 		SDL_RenderClear(renderer);
 		SDL_RenderCopy(renderer, texture, NULL, NULL);
@@ -1116,6 +1173,7 @@ void I_SetPalette(RGBA_t *palette)
 	//if (vidSurface) SDL_SetPaletteColors(vidSurface->format->palette, localPalette, 0, 256);
 	// Fury -- SDL2 vidSurface is a 32-bit surface buffer copied to the texture. It's not palletized, like bufSurface.
 	if (bufSurface) SDL_SetPaletteColors(bufSurface->format->palette, localPalette, 0, 256);
+	Impl_UpdatePaletteLookup();
 }
 
 // return number of fullscreen + X11 modes
@@ -1448,7 +1506,7 @@ static void Impl_VideoSetupBuffer(void)
 
 void I_StartupGraphics(void)
 {
-	if (dedicated)
+	if (dedicated || loadtest)
 	{
 		rendermode = render_none;
 		return;
@@ -1512,15 +1570,22 @@ void I_StartupGraphics(void)
 		HWD.pfnSetBlend         = hwSym("SetBlend",NULL);
 		HWD.pfnClearBuffer      = hwSym("ClearBuffer",NULL);
 		HWD.pfnSetTexture       = hwSym("SetTexture",NULL);
+		HWD.pfnUpdateTexture    = hwSym("UpdateTexture",NULL);
+		HWD.pfnSetColormap      = hwSym("SetColormap",NULL);
 		HWD.pfnReadRect         = hwSym("ReadRect",NULL);
 		HWD.pfnGClipRect        = hwSym("GClipRect",NULL);
 		HWD.pfnClearMipMapCache = hwSym("ClearMipMapCache",NULL);
 		HWD.pfnSetSpecialState  = hwSym("SetSpecialState",NULL);
 		HWD.pfnSetPalette       = hwSym("SetPalette",NULL);
 		HWD.pfnGetTextureUsed   = hwSym("GetTextureUsed",NULL);
+		HWD.pfnGetTextureStats  = hwSym("GetTextureStats",NULL);
+		HWD.pfnMarkRenderSection = hwSym("MarkRenderSection",NULL);
+		HWD.pfnGetRenderStats   = hwSym("GetRenderStats",NULL);
+		HWD.pfnReadScreenAsync  = hwSym("ReadScreenAsync",NULL);
 		HWD.pfnDrawMD2          = hwSym("DrawMD2",NULL);
 		HWD.pfnDrawMD2i         = hwSym("DrawMD2i",NULL);
 		HWD.pfnSetTransform     = hwSym("SetTransform",NULL);
+		HWD.pfnSetBlendedTexture= hwSym("SetBlendedTexture",NULL);
 		HWD.pfnGetRenderVersion = hwSym("GetRenderVersion",NULL);
 #ifdef SHUFFLE
 		HWD.pfnPostImgRedraw    = hwSym("PostImgRedraw",NULL);
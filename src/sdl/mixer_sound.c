@@ -19,6 +19,9 @@
 #include "../w_wad.h"
 #include "../z_zone.h"
 #include "../byteptr.h"
+#ifdef HAVE_THREADS
+#include "../i_threads.h"
+#endif
 
 #ifdef _MSC_VER
 #pragma warning(disable : 4214 4244)
@@ -74,6 +77,9 @@
 
 UINT8 sound_started = false;
 
+static void I_ClearSfxCache(void);
+static void I_StopMusicThread(void);
+
 static Mix_Music *music;
 static UINT8 music_volume, sfx_volume, internal_volume;
 static float loop_point;
@@ -164,6 +170,7 @@ void I_ShutdownSound(void)
 		return; // not an error condition
 	sound_started = false;
 
+	I_ClearSfxCache();
 	Mix_CloseAudio();
 #if SDL_MIXER_VERSION_ATLEAST(1,2,11)
 	Mix_Quit();
@@ -185,9 +192,13 @@ void I_UpdateSound(void)
 /// SFX
 /// ------------------------
 
+// Everything made here is 16-bit stereo at 44100hz, the mixer's own
+// format, in memory from malloc rather than the zone, so that it can be
+// made on the decode thread as well as this one.
+
 // this is as fast as I can possibly make it.
 // sorry. more asm needed.
-static Mix_Chunk *ds2chunk(void *stream)
+static Mix_Chunk *ds2chunk(void *stream, size_t length)
 {
 	UINT16 ver,freq;
 	UINT32 samples, i, newsamples;
@@ -198,12 +209,17 @@ static Mix_Chunk *ds2chunk(void *stream)
 	INT16 o;
 	fixed_t step, frac;
 
+	if (length < 8)
+		return NULL;
+
 	// lump header
 	ver = READUINT16(stream); // sound version format?
 	if (ver != 3) // It should be 3 if it's a doomsound...
 		return NULL; // onos! it's not a doomsound!
 	freq = READUINT16(stream);
 	samples = READUINT32(stream);
+	if (samples > length - 8)
+		samples = (UINT32)(length - 8); // don't read past the end of the lump
 
 	// convert from signed 8bit ???hz to signed 16bit 44100hz.
 	switch(freq)
@@ -233,7 +249,9 @@ static Mix_Chunk *ds2chunk(void *stream)
 			return NULL; // would and/or did wrap, can't store.
 		break;
 	}
-	sound = Z_Malloc(newsamples<<2, PU_SOUND, NULL); // samples * frequency shift * bytes per sample * channels
+	sound = malloc(newsamples<<2); // samples * frequency shift * bytes per sample * channels
+	if (!sound)
+		return NULL;
 
 	s = (SINT8 *)stream;
 	d = (INT16 *)sound;
@@ -297,29 +315,49 @@ static Mix_Chunk *ds2chunk(void *stream)
 	return Mix_QuickLoad_RAW(sound, (Uint32)((UINT8*)d-sound));
 }
 
-void *I_GetSfx(sfxinfo_t *sfx)
+#ifdef HAVE_LIBGME
+// Plays the whole of a GME sound into a chunk.
+static Mix_Chunk *gme2chunk(Music_Emu *emu)
+{
+	short *mem;
+	UINT32 len;
+	gme_info_t *info;
+	gme_equalizer_t eq = {GME_TREBLE, GME_BASS, 0,0,0,0,0,0,0,0};
+
+	gme_start_track(emu, 0);
+	gme_set_equalizer(emu, &eq);
+	gme_track_info(emu, &info, 0);
+
+	len = (info->play_length * 441 / 10) << 2;
+	mem = malloc(len);
+	if (mem)
+		gme_play(emu, len >> 1, mem);
+	gme_free_info(info);
+	gme_delete(emu);
+
+	return mem ? Mix_QuickLoad_RAW((Uint8 *)mem, len) : NULL;
+}
+#endif
+
+//
+// I_DecodeSfx
+//
+// Makes a chunk out of a sound lump, which is left as it was.
+// On the decode thread, nothing is printed; a sound that fails
+// there is tried again here, which says why.
+//
+static Mix_Chunk *I_DecodeSfx(void *lump, size_t length, boolean quiet)
 {
-	void *lump;
 	Mix_Chunk *chunk;
 	SDL_RWops *rw;
 #ifdef HAVE_LIBGME
 	Music_Emu *emu;
-	gme_info_t *info;
 #endif
 
-	if (sfx->lumpnum == LUMPERROR)
-		sfx->lumpnum = S_GetSfxLumpNum(sfx);
-	sfx->length = W_LumpLength(sfx->lumpnum);
-
-	lump = W_CacheLumpNum(sfx->lumpnum, PU_SOUND);
-
 	// convert from standard DoomSound format.
-	chunk = ds2chunk(lump);
+	chunk = ds2chunk(lump, length);
 	if (chunk)
-	{
-		Z_Free(lump);
 		return chunk;
-	}
 
 	// Not a doom sound? Try something else.
 #ifdef HAVE_LIBGME
@@ -335,9 +373,11 @@ void *I_GetSfx(sfxinfo_t *sfx)
 
 		memset(&stream, 0x00, sizeof (z_stream)); // Init zlib stream
 		// Begin the inflation process
-		inflatedLen = *(UINT32 *)lump + (sfx->length-4); // Last 4 bytes are the decompressed size, typically
-		inflatedData = (UINT8 *)Z_Malloc(inflatedLen, PU_SOUND, NULL); // Make room for the decompressed data
-		stream.total_in = stream.avail_in = sfx->length;
+		inflatedLen = *(UINT32 *)lump + (length-4); // Last 4 bytes are the decompressed size, typically
+		inflatedData = (UINT8 *)malloc(inflatedLen); // Make room for the decompressed data
+		if (!inflatedData)
+			return NULL;
+		stream.total_in = stream.avail_in = length;
 		stream.total_out = stream.avail_out = inflatedLen;
 		stream.next_in = (UINT8 *)lump;
 		stream.next_out = inflatedData;
@@ -350,27 +390,12 @@ void *I_GetSfx(sfxinfo_t *sfx)
 				// Run GME on new data
 				if (!gme_open_data(inflatedData, inflatedLen, &emu, 44100))
 				{
-					short *mem;
-					UINT32 len;
-					gme_equalizer_t eq = {GME_TREBLE, GME_BASS, 0,0,0,0,0,0,0,0};
-
-					Z_Free(inflatedData); // GME supposedly makes a copy for itself, so we don't need this lying around
-					Z_Free(lump); // We're done with the uninflated lump now, too.
-
-					gme_start_track(emu, 0);
-					gme_set_equalizer(emu, &eq);
-					gme_track_info(emu, &info, 0);
-
-					len = (info->play_length * 441 / 10) << 2;
-					mem = Z_Malloc(len, PU_SOUND, 0);
-					gme_play(emu, len >> 1, mem);
-					gme_free_info(info);
-					gme_delete(emu);
-
-					return Mix_QuickLoad_RAW((Uint8 *)mem, len);
+					free(inflatedData); // GME supposedly makes a copy for itself, so we don't need this lying around
+					(void)inflateEnd(&stream);
+					return gme2chunk(emu);
 				}
 			}
-			else
+			else if (!quiet)
 			{
 				const char *errorType;
 				switch (zErr)
@@ -394,7 +419,7 @@ void *I_GetSfx(sfxinfo_t *sfx)
 			}
 			(void)inflateEnd(&stream);
 		}
-		else // Hold up, zlib's got a problem
+		else if (!quiet) // Hold up, zlib's got a problem
 		{
 			const char *errorType;
 			switch (zErr)
@@ -416,68 +441,372 @@ void *I_GetSfx(sfxinfo_t *sfx)
 			}
 			CONS_Alert(CONS_ERROR,"Encountered %s when running inflateInit: %s\n", errorType, stream.msg);
 		}
-		Z_Free(inflatedData); // GME didn't open jack, but don't let that stop us from freeing this up
+		free(inflatedData); // GME didn't open jack, but don't let that stop us from freeing this up
 #else
+		(void)quiet;
 		return NULL; // No zlib support
 #endif
 	}
 	// Try to read it as a GME sound
-	else if (!gme_open_data(lump, sfx->length, &emu, 44100))
+	else if (!gme_open_data(lump, length, &emu, 44100))
+		return gme2chunk(emu);
+#else
+	(void)quiet;
+#endif
+
+	// Try to load it as a WAVE or OGG using Mixer.
+	rw = SDL_RWFromMem(lump, length);
+	if (rw != NULL)
 	{
-		short *mem;
-		UINT32 len;
-		gme_equalizer_t eq = {GME_TREBLE, GME_BASS, 0,0,0,0,0,0,0,0};
+		chunk = Mix_LoadWAV_RW(rw, 1);
+		return chunk;
+	}
 
-		Z_Free(lump);
+	return NULL; // haven't been able to get anything
+}
 
-		gme_start_track(emu, 0);
-		gme_set_equalizer(emu, &eq);
-		gme_track_info(emu, &info, 0);
+static void I_FreeChunk(Mix_Chunk *chunk)
+{
+	UINT8 *abufdata = NULL;
+	if (chunk->allocated == 0)
+	{
+		// We allocated the data in this chunk, so get the abuf from mixer, then let it free the chunk, THEN we free the data
+		// I believe this should ensure the sound is not playing when we free it
+		abufdata = chunk->abuf;
+	}
+	Mix_FreeChunk(chunk);
+	free(abufdata);
+}
 
-		len = (info->play_length * 441 / 10) << 2;
-		mem = Z_Malloc(len, PU_SOUND, 0);
-		gme_play(emu, len >> 1, mem);
-		gme_free_info(info);
-		gme_delete(emu);
+/// ------------------------
+/// SFX Cache
+/// ------------------------
+
+// Every sound decoded is kept here, keyed by its lump, including the ones
+// handed out to S_sfx. Those are never dropped, but the rest are, least
+// recently used first, once there are more than sfxcachesize megabytes
+// of them. I_PrefetchSfx queues a sound to be decoded on the decode
+// thread; if I_GetSfx asks for it before it's done, I_GetSfx decodes it
+// itself, or waits for the thread to finish.
+//
+// Only this thread adds or removes entries, with the mutex held. The
+// decode thread only changes the state, chunk and lump of an entry it
+// took off the queue, and everything else looks at those with the mutex
+// held, or once the entry is no longer queued or decoding.
+
+typedef enum
+{
+	SC_QUEUED,   // waiting for the decode thread
+	SC_DECODING, // on the decode thread
+	SC_READY,
+	SC_FAILED
+} sfxcachestate_t;
+
+typedef struct sfxcache_s
+{
+	lumpnum_t lumpnum;
+	size_t length; // of the lump, in case it's been replaced
+	sfxcachestate_t state;
+	UINT8 *lump; // the lump, from malloc, until it's decoded
+	Mix_Chunk *chunk;
+	INT32 users; // sfx that have the chunk as their data
+	UINT32 lastused;
+	struct sfxcache_s *next;
+} sfxcache_t;
+
+static sfxcache_t *sfxcache = NULL;
+static UINT32 sfxcacheclock = 0;
+
+#ifdef HAVE_THREADS
+static boolean sfxthreadstarted = false, sfxthreadstop = false;
+static I_mutex sfxcache_mutex;
+static I_cond sfxcache_workcond;
+static I_cond sfxcache_donecond;
+
+#define LockSfxCache() I_lock_mutex(&sfxcache_mutex)
+#define UnlockSfxCache() I_unlock_mutex(sfxcache_mutex)
+
+static void I_SfxDecodeThread(void *userdata)
+{
+	sfxcache_t *entry;
+	Mix_Chunk *chunk;
+
+	(void)userdata;
+
+	I_lock_mutex(&sfxcache_mutex);
+	for (;;)
+	{
+		for (entry = sfxcache; entry; entry = entry->next)
+			if (entry->state == SC_QUEUED)
+				break;
+
+		if (sfxthreadstop)
+			break;
+		if (!entry)
+		{
+			I_hold_cond(&sfxcache_workcond, sfxcache_mutex);
+			continue;
+		}
+
+		entry->state = SC_DECODING;
+		I_unlock_mutex(sfxcache_mutex);
+
+		chunk = I_DecodeSfx(entry->lump, entry->length, true);
+
+		I_lock_mutex(&sfxcache_mutex);
+		entry->chunk = chunk;
+		if (chunk)
+		{
+			free(entry->lump);
+			entry->lump = NULL;
+			entry->state = SC_READY;
+		}
+		else
+			entry->state = SC_FAILED;
+		I_wake_all_cond(&sfxcache_donecond);
+	}
+	I_unlock_mutex(sfxcache_mutex);
+}
+
+// Waits for the decode thread to be done with entry, if it has it.
+static void I_WaitForSfx(sfxcache_t *entry)
+{
+	I_lock_mutex(&sfxcache_mutex);
+	if (entry->state == SC_QUEUED)
+		entry->state = SC_FAILED; // faster to decode it now than to wait
+	while (entry->state == SC_DECODING)
+		I_hold_cond(&sfxcache_donecond, sfxcache_mutex);
+	I_unlock_mutex(sfxcache_mutex);
+}
 
-		return Mix_QuickLoad_RAW((Uint8 *)mem, len);
+static void I_StopSfxThread(void)
+{
+	sfxcache_t *entry;
+
+	if (!sfxthreadstarted)
+		return;
+
+	I_lock_mutex(&sfxcache_mutex);
+	sfxthreadstarted = false;
+	sfxthreadstop = true;
+	I_wake_all_cond(&sfxcache_workcond);
+	for (entry = sfxcache; entry; entry = entry->next)
+	{
+		if (entry->state == SC_QUEUED)
+			entry->state = SC_FAILED;
+		while (entry->state == SC_DECODING)
+			I_hold_cond(&sfxcache_donecond, sfxcache_mutex);
 	}
+	I_unlock_mutex(sfxcache_mutex);
+}
+#else
+#define LockSfxCache()
+#define UnlockSfxCache()
+#define I_WaitForSfx(entry)
+#define I_StopSfxThread()
 #endif
 
-	// Try to load it as a WAVE or OGG using Mixer.
-	rw = SDL_RWFromMem(lump, sfx->length);
-	if (rw != NULL)
+static sfxcache_t *I_FindCachedSfx(lumpnum_t lumpnum, size_t length)
+{
+	sfxcache_t *entry;
+
+	for (entry = sfxcache; entry; entry = entry->next)
+		if (entry->lumpnum == lumpnum && entry->length == length)
+			return entry;
+	return NULL;
+}
+
+static sfxcache_t *I_AddCachedSfx(lumpnum_t lumpnum, size_t length)
+{
+	sfxcache_t *entry = calloc(1, sizeof (*entry));
+	if (!entry)
+		return NULL;
+
+	entry->lump = malloc(length ? length : 1);
+	if (!entry->lump)
 	{
-		chunk = Mix_LoadWAV_RW(rw, 1);
-		return chunk;
+		free(entry);
+		return NULL;
 	}
+	W_ReadLump(lumpnum, entry->lump);
+
+	entry->lumpnum = lumpnum;
+	entry->length = length;
+	entry->state = SC_FAILED; // not decoded yet
+	entry->lastused = ++sfxcacheclock;
+
+	LockSfxCache();
+	entry->next = sfxcache;
+	sfxcache = entry;
+	UnlockSfxCache();
+	return entry;
+}
 
-	return NULL; // haven't been able to get anything
+static void I_FreeCachedSfx(sfxcache_t *entry)
+{
+	sfxcache_t **p;
+
+	LockSfxCache();
+	for (p = &sfxcache; *p; p = &(*p)->next)
+	{
+		if (*p == entry)
+		{
+			*p = entry->next;
+			break;
+		}
+	}
+	UnlockSfxCache();
+
+	if (entry->chunk)
+		I_FreeChunk(entry->chunk);
+	free(entry->lump);
+	free(entry);
 }
 
-void I_FreeSfx(sfxinfo_t *sfx)
+//
+// I_TrimSfxCache
+//
+// Drops the least recently used sounds no sfx has, until what's left fits.
+//
+static void I_TrimSfxCache(void)
 {
-	if (sfx->data)
+	const size_t budget = (size_t)cv_sfxcachesize.value<<20;
+	sfxcache_t *entry, *oldest;
+	size_t total;
+
+	for (;;)
+	{
+		total = 0;
+		oldest = NULL;
+
+		LockSfxCache();
+		for (entry = sfxcache; entry; entry = entry->next)
+		{
+			if (entry->users || entry->state != SC_READY)
+				continue;
+			total += entry->chunk->alen;
+			if (!oldest || entry->lastused < oldest->lastused)
+				oldest = entry;
+		}
+		UnlockSfxCache();
+
+		if (!oldest || total <= budget)
+			break;
+		I_FreeCachedSfx(oldest);
+	}
+}
+
+static void I_ClearSfxCache(void)
+{
+	sfxcache_t *entry, *next;
+
+	I_StopSfxThread();
+
+	// What's been handed out is now the sfx's own, for I_FreeSfx
+	for (entry = sfxcache; entry; entry = next)
 	{
-		Mix_Chunk *chunk = (Mix_Chunk*)sfx->data;
-		UINT8 *abufdata = NULL;
-		if (chunk->allocated == 0)
+		next = entry->next;
+		if (entry->users)
+			entry->chunk = NULL;
+		I_FreeCachedSfx(entry);
+	}
+}
+
+void *I_GetSfx(sfxinfo_t *sfx)
+{
+	sfxcache_t *entry;
+
+	if (sfx->lumpnum == LUMPERROR)
+		sfx->lumpnum = S_GetSfxLumpNum(sfx);
+	sfx->length = W_LumpLength(sfx->lumpnum);
+
+	entry = I_FindCachedSfx(sfx->lumpnum, sfx->length);
+	if (entry)
+		I_WaitForSfx(entry);
+	else
+		entry = I_AddCachedSfx(sfx->lumpnum, sfx->length);
+
+	if (!entry)
+		return NULL;
+
+	// Not decoded yet, or the decode thread couldn't
+	if (entry->state == SC_FAILED && entry->lump)
+	{
+		entry->chunk = I_DecodeSfx(entry->lump, entry->length, false);
+		if (entry->chunk)
 		{
-			// We allocated the data in this chunk, so get the abuf from mixer, then let it free the chunk, THEN we free the data
-			// I believe this should ensure the sound is not playing when we free it
-			abufdata = chunk->abuf;
+			free(entry->lump);
+			entry->lump = NULL;
+			entry->state = SC_READY;
 		}
-		Mix_FreeChunk(sfx->data);
-		if (abufdata)
+	}
+
+	entry->lastused = ++sfxcacheclock;
+	if (!entry->chunk)
+		return NULL;
+
+	entry->users++;
+	I_TrimSfxCache();
+	return entry->chunk;
+}
+
+void I_FreeSfx(sfxinfo_t *sfx)
+{
+	if (sfx->data)
+	{
+		sfxcache_t *entry;
+
+		for (entry = sfxcache; entry; entry = entry->next)
+			if (entry->chunk == sfx->data)
+				break;
+
+		if (entry)
 		{
-			// I'm going to assume we used Z_Malloc to allocate this data.
-			Z_Free(abufdata);
+			// Kept, in case it's wanted again
+			entry->users--;
+			I_TrimSfxCache();
 		}
+		else
+			I_FreeChunk(sfx->data);
 	}
 	sfx->data = NULL;
 	sfx->lumpnum = LUMPERROR;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+#ifdef HAVE_THREADS
+	sfxcache_t *entry;
+
+	if (sfx->data || !sound_started || !cv_sfxcachesize.value)
+		return;
+
+	if (sfx->lumpnum == LUMPERROR)
+		sfx->lumpnum = S_GetSfxLumpNum(sfx);
+	sfx->length = W_LumpLength(sfx->lumpnum);
+
+	if (I_FindCachedSfx(sfx->lumpnum, sfx->length))
+		return;
+	entry = I_AddCachedSfx(sfx->lumpnum, sfx->length);
+	if (!entry)
+		return;
+
+	if (!sfxthreadstarted)
+	{
+		sfxthreadstarted = true;
+		sfxthreadstop = false;
+		I_spawn_thread("sfx-decode", I_SfxDecodeThread, NULL);
+	}
+
+	I_lock_mutex(&sfxcache_mutex);
+	entry->state = SC_QUEUED;
+	I_wake_one_cond(&sfxcache_workcond);
+	I_unlock_mutex(sfxcache_mutex);
+#else
+	(void)sfx; // nothing to decode it on, so it waits to be played
+#endif
+}
+
 INT32 I_StartSound(sfxenum_t id, UINT8 vol, UINT8 sep, UINT8 pitch, UINT8 priority, INT32 channel)
 {
 	UINT8 volume = (((UINT16)vol + 1) * (UINT16)sfx_volume) / 62; // (256 * 31) / 62 == 127
@@ -642,6 +971,7 @@ void I_InitMusic(void)
 
 void I_ShutdownMusic(void)
 {
+	I_StopMusicThread();
 	I_UnloadSong();
 }
 
@@ -894,10 +1224,51 @@ UINT32 I_GetSongPosition(void)
 }
 
 /// ------------------------
-/// Music Playback
+/// Music Prefetch
 /// ------------------------
 
-boolean I_LoadSong(char *data, size_t len)
+// What I_LoadSong makes out of song data, on either thread.
+typedef struct
+{
+	Mix_Music *music;
+#ifdef HAVE_LIBGME
+	Music_Emu *gme;
+	boolean hooked; // VGZs are hooked up as soon as they're loaded
+#endif
+	float loop_point;
+} decodedsong_t;
+
+#if defined (HAVE_LIBGME) && defined (HAVE_ZLIB)
+static const char *I_ZlibErrorType(int zErr)
+{
+	switch (zErr)
+	{
+		case Z_ERRNO:
+			return "Z_ERRNO";
+		case Z_STREAM_ERROR:
+			return "Z_STREAM_ERROR";
+		case Z_DATA_ERROR:
+			return "Z_DATA_ERROR";
+		case Z_MEM_ERROR:
+			return "Z_MEM_ERROR";
+		case Z_BUF_ERROR:
+			return "Z_BUF_ERROR";
+		case Z_VERSION_ERROR:
+			return "Z_VERSION_ERROR";
+		default:
+			return "unknown error";
+	}
+}
+#endif
+
+//
+// I_DecodeSong
+//
+// Opens song data, which has to stay around for as long as the song
+// does. Nothing here touches the zone or what's playing, so it can be
+// done on the music thread, which passes quiet so nothing is printed.
+//
+static boolean I_DecodeSong(char *data, size_t len, decodedsong_t *song, boolean quiet)
 {
 	const char *key1 = "LOOP";
 	const char *key2 = "POINT=";
@@ -909,15 +1280,7 @@ boolean I_LoadSong(char *data, size_t len)
 	char *p = data;
 	SDL_RWops *rw;
 
-	if (music
-#ifdef HAVE_LIBGME
-		|| gme
-#endif
-	)
-		I_UnloadSong();
-
-	// always do this whether or not a music already exists
-	var_cleanup();
+	memset(song, 0, sizeof (*song));
 
 #ifdef HAVE_LIBGME
 	if ((UINT8)data[0] == 0x1F
@@ -932,7 +1295,9 @@ boolean I_LoadSong(char *data, size_t len)
 		memset(&stream, 0x00, sizeof (z_stream)); // Init zlib stream
 		// Begin the inflation process
 		inflatedLen = *(UINT32 *)(data + (len-4)); // Last 4 bytes are the decompressed size, typically
-		inflatedData = (UINT8 *)Z_Calloc(inflatedLen, PU_MUSIC, NULL); // Make room for the decompressed data
+		inflatedData = (UINT8 *)calloc(inflatedLen, 1); // Make room for the decompressed data
+		if (!inflatedData)
+			return false;
 		stream.total_in = stream.avail_in = len;
 		stream.total_out = stream.avail_out = inflatedLen;
 		stream.next_in = (UINT8 *)data;
@@ -944,73 +1309,33 @@ boolean I_LoadSong(char *data, size_t len)
 			zErr = inflate(&stream, Z_FINISH);
 			if (zErr == Z_STREAM_END) {
 				// Run GME on new data
-				if (!gme_open_data(inflatedData, inflatedLen, &gme, 44100))
+				if (!gme_open_data(inflatedData, inflatedLen, &song->gme, 44100))
 				{
 					gme_equalizer_t eq = {GME_TREBLE, GME_BASS, 0,0,0,0,0,0,0,0};
-					gme_start_track(gme, 0);
-					current_track = 0;
-					gme_set_equalizer(gme, &eq);
-					Mix_HookMusic(mix_gme, gme);
-					Z_Free(inflatedData); // GME supposedly makes a copy for itself, so we don't need this lying around
+					gme_set_equalizer(song->gme, &eq);
+					song->hooked = true;
+					free(inflatedData); // GME supposedly makes a copy for itself, so we don't need this lying around
+					(void)inflateEnd(&stream);
 					return true;
 				}
 			}
-			else
-			{
-				const char *errorType;
-				switch (zErr)
-				{
-					case Z_ERRNO:
-						errorType = "Z_ERRNO"; break;
-					case Z_STREAM_ERROR:
-						errorType = "Z_STREAM_ERROR"; break;
-					case Z_DATA_ERROR:
-						errorType = "Z_DATA_ERROR"; break;
-					case Z_MEM_ERROR:
-						errorType = "Z_MEM_ERROR"; break;
-					case Z_BUF_ERROR:
-						errorType = "Z_BUF_ERROR"; break;
-					case Z_VERSION_ERROR:
-						errorType = "Z_VERSION_ERROR"; break;
-					default:
-						errorType = "unknown error";
-				}
-				CONS_Alert(CONS_ERROR,"Encountered %s when running inflate: %s\n", errorType, stream.msg);
-			}
+			else if (!quiet)
+				CONS_Alert(CONS_ERROR,"Encountered %s when running inflate: %s\n", I_ZlibErrorType(zErr), stream.msg);
 			(void)inflateEnd(&stream);
 		}
-		else // Hold up, zlib's got a problem
-		{
-			const char *errorType;
-			switch (zErr)
-			{
-				case Z_ERRNO:
-					errorType = "Z_ERRNO"; break;
-				case Z_STREAM_ERROR:
-					errorType = "Z_STREAM_ERROR"; break;
-				case Z_DATA_ERROR:
-					errorType = "Z_DATA_ERROR"; break;
-				case Z_MEM_ERROR:
-					errorType = "Z_MEM_ERROR"; break;
-				case Z_BUF_ERROR:
-					errorType = "Z_BUF_ERROR"; break;
-				case Z_VERSION_ERROR:
-					errorType = "Z_VERSION_ERROR"; break;
-				default:
-					errorType = "unknown error";
-			}
-			CONS_Alert(CONS_ERROR,"Encountered %s when running inflateInit: %s\n", errorType, stream.msg);
-		}
-		Z_Free(inflatedData); // GME didn't open jack, but don't let that stop us from freeing this up
+		else if (!quiet) // Hold up, zlib's got a problem
+			CONS_Alert(CONS_ERROR,"Encountered %s when running inflateInit: %s\n", I_ZlibErrorType(zErr), stream.msg);
+		free(inflatedData); // GME didn't open jack, but don't let that stop us from freeing this up
 #else
-		CONS_Alert(CONS_ERROR,"Cannot decompress VGZ; no zlib support\n");
+		if (!quiet)
+			CONS_Alert(CONS_ERROR,"Cannot decompress VGZ; no zlib support\n");
 		return true;
 #endif
 	}
-	else if (!gme_open_data(data, len, &gme, 44100))
+	else if (!gme_open_data(data, len, &song->gme, 44100))
 	{
 		gme_equalizer_t eq = {GME_TREBLE, GME_BASS, 0,0,0,0,0,0,0,0};
-		gme_set_equalizer(gme, &eq);
+		gme_set_equalizer(song->gme, &eq);
 		return true;
 	}
 #endif
@@ -1018,27 +1343,25 @@ boolean I_LoadSong(char *data, size_t len)
 	rw = SDL_RWFromMem(data, len);
 	if (rw != NULL)
 	{
-		music = Mix_LoadMUS_RW(rw, 1);
+		song->music = Mix_LoadMUS_RW(rw, 1);
 	}
-	if (!music)
+	if (!song->music)
 	{
-		CONS_Alert(CONS_ERROR, "Mix_LoadMUS_RW: %s\n", Mix_GetError());
+		if (!quiet)
+			CONS_Alert(CONS_ERROR, "Mix_LoadMUS_RW: %s\n", Mix_GetError());
 		return false;
 	}
 
 	// Find the OGG loop point.
-	loop_point = 0.0f;
-	song_length = 0.0f;
-
 	while ((UINT32)(p - data) < len)
 	{
-		if (fpclassify(loop_point) == FP_ZERO && !strncmp(p, key1, key1len))
+		if (fpclassify(song->loop_point) == FP_ZERO && !strncmp(p, key1, key1len))
 		{
 			p += key1len; // skip LOOP
 			if (!strncmp(p, key2, key2len)) // is it LOOPPOINT=?
 			{
 				p += key2len; // skip POINT=
-				loop_point = (float)((44.1L+atoi(p)) / 44100.0L); // LOOPPOINT works by sample count.
+				song->loop_point = (float)((44.1L+atoi(p)) / 44100.0L); // LOOPPOINT works by sample count.
 				// because SDL_Mixer is USELESS and can't even tell us
 				// something simple like the frequency of the streaming music,
 				// we are unfortunately forced to assume that ALL MUSIC is 44100hz.
@@ -1047,12 +1370,12 @@ boolean I_LoadSong(char *data, size_t len)
 			else if (!strncmp(p, key3, key3len)) // is it LOOPMS=?
 			{
 				p += key3len; // skip MS=
-				loop_point = (float)(atoi(p) / 1000.0L); // LOOPMS works by real time, as miliseconds.
+				song->loop_point = (float)(atoi(p) / 1000.0L); // LOOPMS works by real time, as miliseconds.
 				// Everything that uses LOOPMS will work perfectly with SDL_Mixer.
 			}
 		}
 
-		if (fpclassify(loop_point) != FP_ZERO) // Got what we needed
+		if (fpclassify(song->loop_point) != FP_ZERO) // Got what we needed
 			break;
 		else // continue searching
 			p++;
@@ -1060,6 +1383,202 @@ boolean I_LoadSong(char *data, size_t len)
 	return true;
 }
 
+static void I_FreeDecodedSong(decodedsong_t *song)
+{
+#ifdef HAVE_LIBGME
+	if (song->gme)
+		gme_delete(song->gme);
+#endif
+	if (song->music)
+		Mix_FreeMusic(song->music);
+	memset(song, 0, sizeof (*song));
+}
+
+#ifdef HAVE_THREADS
+// One song at a time is opened ahead of time on the music thread, for
+// I_LoadSong to pick up when it's handed the same data.
+typedef enum
+{
+	SP_NONE,
+	SP_QUEUED,
+	SP_DECODING,
+	SP_READY,
+	SP_FAILED
+} songprefetchstate_t;
+
+static struct
+{
+	char *data;
+	size_t len;
+	songprefetchstate_t state;
+	decodedsong_t song;
+} songprefetch;
+
+static boolean musicthreadstarted = false, musicthreadstop = false;
+static I_mutex songprefetch_mutex;
+static I_cond songprefetch_workcond;
+static I_cond songprefetch_donecond;
+
+static void I_MusicDecodeThread(void *userdata)
+{
+	decodedsong_t song;
+	boolean ok;
+
+	(void)userdata;
+
+	I_lock_mutex(&songprefetch_mutex);
+	for (;;)
+	{
+		while (songprefetch.state != SP_QUEUED && !musicthreadstop)
+			I_hold_cond(&songprefetch_workcond, songprefetch_mutex);
+		if (musicthreadstop)
+			break;
+
+		songprefetch.state = SP_DECODING;
+		I_unlock_mutex(songprefetch_mutex);
+
+		ok = I_DecodeSong(songprefetch.data, songprefetch.len, &song, true);
+
+		I_lock_mutex(&songprefetch_mutex);
+		songprefetch.song = song;
+		songprefetch.state = ok ? SP_READY : SP_FAILED;
+		I_wake_all_cond(&songprefetch_donecond);
+	}
+	I_unlock_mutex(songprefetch_mutex);
+}
+
+// Forgets the prefetched song, waiting for the music thread if it has it.
+static void I_DropPrefetchedSong(void)
+{
+	I_lock_mutex(&songprefetch_mutex);
+	while (songprefetch.state == SP_DECODING)
+		I_hold_cond(&songprefetch_donecond, songprefetch_mutex);
+	if (songprefetch.state == SP_READY)
+		I_FreeDecodedSong(&songprefetch.song);
+	songprefetch.state = SP_NONE;
+	songprefetch.data = NULL;
+	I_unlock_mutex(songprefetch_mutex);
+}
+
+//
+// I_TakePrefetchedSong
+//
+// Picks up data's song, if it's the one opened ahead of time. If the
+// music thread hasn't got to it yet, it's quicker to open it here.
+//
+static boolean I_TakePrefetchedSong(char *data, size_t len, decodedsong_t *song)
+{
+	boolean ok = false;
+
+	I_lock_mutex(&songprefetch_mutex);
+	if (songprefetch.state != SP_NONE && songprefetch.data == data && songprefetch.len == len)
+	{
+		while (songprefetch.state == SP_DECODING)
+			I_hold_cond(&songprefetch_donecond, songprefetch_mutex);
+		if (songprefetch.state == SP_READY)
+		{
+			*song = songprefetch.song;
+			ok = true;
+		}
+		songprefetch.state = SP_NONE;
+		songprefetch.data = NULL;
+	}
+	I_unlock_mutex(songprefetch_mutex);
+
+	return ok;
+}
+
+static void I_StopMusicThread(void)
+{
+	if (!musicthreadstarted)
+		return;
+
+	I_DropPrefetchedSong();
+
+	I_lock_mutex(&songprefetch_mutex);
+	musicthreadstarted = false;
+	musicthreadstop = true;
+	I_wake_all_cond(&songprefetch_workcond);
+	I_unlock_mutex(songprefetch_mutex);
+}
+#else
+#define I_TakePrefetchedSong(data, len, song) false
+
+static void I_StopMusicThread(void)
+{
+}
+#endif
+
+void I_PrefetchSong(char *data, size_t len)
+{
+#ifdef HAVE_THREADS
+	if (!sound_started)
+		return;
+
+	if (data && songprefetch.state != SP_NONE && songprefetch.data == data && songprefetch.len == len)
+		return; // already on it
+
+	I_DropPrefetchedSong();
+
+	// SDL_mixer's MIDI players are shared with the song that's playing
+	if (!data || len < 4 || !memcmp(data, "MThd", 4))
+		return;
+
+	if (!musicthreadstarted)
+	{
+		musicthreadstarted = true;
+		musicthreadstop = false;
+		I_spawn_thread("music-decode", I_MusicDecodeThread, NULL);
+	}
+
+	I_lock_mutex(&songprefetch_mutex);
+	songprefetch.data = data;
+	songprefetch.len = len;
+	songprefetch.state = SP_QUEUED;
+	I_wake_one_cond(&songprefetch_workcond);
+	I_unlock_mutex(songprefetch_mutex);
+#else
+	(void)data; // nothing to open it on, so it waits to be played
+	(void)len;
+#endif
+}
+
+/// ------------------------
+/// Music Playback
+/// ------------------------
+
+boolean I_LoadSong(char *data, size_t len)
+{
+	decodedsong_t song;
+
+	if (music
+#ifdef HAVE_LIBGME
+		|| gme
+#endif
+	)
+		I_UnloadSong();
+
+	// always do this whether or not a music already exists
+	var_cleanup();
+
+	if (!I_TakePrefetchedSong(data, len, &song)
+		&& !I_DecodeSong(data, len, &song, false))
+		return false;
+
+	music = song.music;
+	loop_point = song.loop_point;
+#ifdef HAVE_LIBGME
+	gme = song.gme;
+	if (song.hooked)
+	{
+		gme_start_track(gme, 0);
+		current_track = 0;
+		Mix_HookMusic(mix_gme, gme);
+	}
+#endif
+	return true;
+}
+
 void I_UnloadSong(void)
 {
 	I_StopSong();
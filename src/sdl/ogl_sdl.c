@@ -212,13 +212,20 @@ void OglSdlFinishUpdate(boolean waitvbl)
 
 	HWR_MakeScreenFinalTexture();
 	HWR_DrawScreenFinalTexture(sdlw, sdlh);
-	SDL_GL_SwapWindow(window);
+	if (!waitvbl || ReadyToSwap())
+	{
+		SDL_GL_SwapWindow(window);
+		if (waitvbl)
+			SwapMade();
+	}
 
 	GClipRect(0, 0, realwidth, realheight, NZCLIP_PLANE);
 
 	// Sryder:	We need to draw the final screen texture again into the other buffer in the original position so that
 	//			effects that want to take the old screen can do so after this
 	HWR_DrawScreenFinalTexture(realwidth, realheight);
+
+	FinishFrame();
 }
 
 EXPORT void HWRAPI( OglSdlSetPalette) (RGBA_t *palette, RGBA_t *pgamma)
@@ -61,6 +61,7 @@
 #include "../i_sound.h"
 #include "../m_argv.h"
 #include "../m_misc.h"
+#include "../m_cpu.h"
 #include "../w_wad.h"
 #include "../screen.h" //vid.WndParent
 #include "../doomdef.h"
@@ -79,6 +80,21 @@
 #include "gme/gme.h"
 #endif
 
+// Vector mixing kernels, see I_SetupMixKernels
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIXSSE2
+#define MIXSSE2_TARGET
+#include <emmintrin.h>
+#elif defined (__GNUC__) && defined (__i386__) && !defined (__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MIXSSE2
+#define MIXSSE2_TARGET __attribute__((target("sse2")))
+#include <emmintrin.h>
+#endif
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define MIXNEON
+#include <arm_neon.h>
+#endif
+
 // The number of internal mixing channels,
 //  the samples calculated for each mixing step,
 //  the size of the 16bit, 2 hardware channel (stereo)
@@ -592,6 +608,12 @@ void I_FreeSfx(sfxinfo_t * sfx)
 	sfx->lumpnum = LUMPERROR;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx(sfx);
+}
+
 //
 // Starting a sound means adding it
 //  to the current list of active sounds
@@ -652,341 +674,299 @@ boolean I_SoundIsPlaying(INT32 handle)
 	return isplaying;
 }
 
-FUNCINLINE static ATTRINLINE void I_UpdateStream8S(Uint8 *stream, int len)
-{
-	// Mix current sound data.
-	// Data, from raw sound
-	register Sint16 dr; // Right 8bit stream
-	register Uint8 sample; // Center 8bit sfx
-	register Sint16 dl; // Left 8bit stream
-
-	// Pointers in audio stream
-	Sint8 *rightout = (Sint8 *)stream; // currect right
-	Sint8 *leftout = rightout + 1;// currect left
-	const Uint8 step = 2; // Step in stream, left and right, thus two.
+// Mixing is done MIXBLOCK output frames at a time. Each playing channel
+// in turn is resampled into a block of 16-bit stereo frames, which gets
+// added to 32-bit totals, and the totals are clamped to the stream's
+// format at the end.
+#define MIXBLOCK 256
 
-	INT32 chan; // Mixing channel index.
+// 32-bit totals, right then left for stereo
+static INT32 mixbuf[MIXBLOCK*2];
 
-	// Determine end of the stream
-	len /= 2; // not 8bit mono samples, 8bit stereo ones
+// Adds n 16-bit values, shifted right by shift, to n mixbuf totals
+static void (*I_MixAccumulate)(INT32 *mix, const Sint16 *in, size_t n, int shift);
+// Clamps n totals to 16-bit or 8-bit samples
+static void (*I_MixClamp16)(const INT32 *mix, Sint16 *out, size_t n);
+static void (*I_MixClamp8)(const INT32 *mix, Sint8 *out, size_t n);
 
-	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
+static void I_MixAccumulate_C(INT32 *mix, const Sint16 *in, size_t n, int shift)
+{
+	while (n--)
+		*mix++ += *in++ >> shift;
+}
 
-	// Mix sounds into the mixing buffer.
-	// Loop over len
-	while (len--)
+static void I_MixClamp16_C(const INT32 *mix, Sint16 *out, size_t n)
+{
+	for (; n--; mix++)
 	{
-		// Reset left/right value.
-		dl = *leftout;
-		dr = *rightout;
-
-		// Love thy L2 cache - made this a loop.
-		// Now more channels could be set at compile time
-		//  as well. Thus loop those channels.
-		for (chan = 0; chan < NUM_CHANNELS; chan++)
-		{
-			// Check channel, if active.
-			if (channels[chan].end)
-			{
-#if 1
-				// Get the raw data from the channel.
-				sample = channels[chan].data[0];
-#else
-				// linear filtering from PrDoom
-				sample = (((Uint32)channels[chan].data[0] *(0x10000 - channels[chan].stepremainder))
-					+ ((Uint32)channels[chan].data[1]) * (channels[chan].stepremainder))) >> 16;
-#endif
-				// Add left and right part
-				//  for this channel (sound)
-				//  to the current data.
-				// Adjust volume accordingly.
-				dl = (Sint16)(dl+(channels[chan].leftvol_lookup[sample]>>8));
-				dr = (Sint16)(dr+(channels[chan].rightvol_lookup[sample]>>8));
-				// Increment stepage
-				channels[chan].stepremainder += channels[chan].step;
-				// Check whether we are done.
-				if (channels[chan].data + (channels[chan].stepremainder >> 16) >= channels[chan].end)
-					channels[chan].end = NULL;
-				else
-				{
-					// step to next sample
-					channels[chan].data += (channels[chan].stepremainder >> 16);
-					// Limit to LSB???
-					channels[chan].stepremainder &= 0xffff;
-				}
-			}
-		}
-
-		// Clamp to range. Left hardware channel.
-		// Has been char instead of short.
-
-		if (dl > 0x7f)
-			*leftout = 0x7f;
-		else if (dl < -0x80)
-			*leftout = -0x80;
+		if (*mix > 0x7fff)
+			*out++ = 0x7fff;
+		else if (*mix < -0x8000)
+			*out++ = -0x8000;
 		else
-			*leftout = (Sint8)dl;
+			*out++ = (Sint16)*mix;
+	}
+}
 
-		// Same for right hardware channel.
-		if (dr > 0x7f)
-			*rightout = 0x7f;
-		else if (dr < -0x80)
-			*rightout = -0x80;
+static void I_MixClamp8_C(const INT32 *mix, Sint8 *out, size_t n)
+{
+	for (; n--; mix++)
+	{
+		if (*mix > 0x7f)
+			*out++ = 0x7f;
+		else if (*mix < -0x80)
+			*out++ = -0x80;
 		else
-			*rightout = (Sint8)dr;
+			*out++ = (Sint8)*mix;
+	}
+}
 
-		// Increment current pointers in stream
-		leftout += step;
-		rightout += step;
+#ifdef MIXSSE2
+static MIXSSE2_TARGET void I_MixAccumulate_SSE2(INT32 *mix, const Sint16 *in, size_t n, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
 
+	for (; n >= 8; n -= 8, in += 8, mix += 8)
+	{
+		const __m128i v = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)(const void *)in), count);
+		// widen to 32 bits by putting each value in the top half and shifting it back down
+		_mm_storeu_si128((__m128i *)(void *)mix, _mm_add_epi32(_mm_loadu_si128((__m128i *)(void *)mix),
+			_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)));
+		_mm_storeu_si128((__m128i *)(void *)(mix + 4), _mm_add_epi32(_mm_loadu_si128((__m128i *)(void *)(mix + 4)),
+			_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)));
 	}
-	if (Snd_Mutex) SDL_UnlockMutex(Snd_Mutex);
+	I_MixAccumulate_C(mix, in, n, shift);
 }
 
-FUNCINLINE static ATTRINLINE void I_UpdateStream8M(Uint8 *stream, int len)
+static MIXSSE2_TARGET void I_MixClamp16_SSE2(const INT32 *mix, Sint16 *out, size_t n)
 {
-	// Mix current sound data.
-	// Data, from raw sound
-	register Sint16 d; // Mono 8bit stream
-	register Uint8 sample; // Center 8bit sfx
+	for (; n >= 8; n -= 8, mix += 8, out += 8)
+		_mm_storeu_si128((__m128i *)(void *)out, _mm_packs_epi32(
+			_mm_loadu_si128((const __m128i *)(const void *)mix),
+			_mm_loadu_si128((const __m128i *)(const void *)(mix + 4))));
+	I_MixClamp16_C(mix, out, n);
+}
 
-	// Pointers in audio stream
-	Sint8 *monoout = (Sint8 *)stream; // currect mono
-	const Uint8 step = 1; // Step in stream, left and right, thus two.
+static MIXSSE2_TARGET void I_MixClamp8_SSE2(const INT32 *mix, Sint8 *out, size_t n)
+{
+	for (; n >= 16; n -= 16, mix += 16, out += 16)
+		_mm_storeu_si128((__m128i *)(void *)out, _mm_packs_epi16(
+			_mm_packs_epi32(_mm_loadu_si128((const __m128i *)(const void *)mix),
+				_mm_loadu_si128((const __m128i *)(const void *)(mix + 4))),
+			_mm_packs_epi32(_mm_loadu_si128((const __m128i *)(const void *)(mix + 8)),
+				_mm_loadu_si128((const __m128i *)(const void *)(mix + 12)))));
+	I_MixClamp8_C(mix, out, n);
+}
+#endif
 
-	INT32 chan; // Mixing channel index.
+#ifdef MIXNEON
+static void I_MixAccumulate_NEON(INT32 *mix, const Sint16 *in, size_t n, int shift)
+{
+	const int16x8_t count = vdupq_n_s16((int16_t)-shift); // shifts right
 
-	// Determine end of the stream
-	//len /= 1; // not 8bit mono samples, 8bit mono ones?
+	for (; n >= 8; n -= 8, in += 8, mix += 8)
+	{
+		const int16x8_t v = vshlq_s16(vld1q_s16(in), count);
+		vst1q_s32(mix, vaddw_s16(vld1q_s32(mix), vget_low_s16(v)));
+		vst1q_s32(mix + 4, vaddw_s16(vld1q_s32(mix + 4), vget_high_s16(v)));
+	}
+	I_MixAccumulate_C(mix, in, n, shift);
+}
 
-	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
+static void I_MixClamp16_NEON(const INT32 *mix, Sint16 *out, size_t n)
+{
+	for (; n >= 8; n -= 8, mix += 8, out += 8)
+		vst1q_s16(out, vcombine_s16(vqmovn_s32(vld1q_s32(mix)), vqmovn_s32(vld1q_s32(mix + 4))));
+	I_MixClamp16_C(mix, out, n);
+}
 
-	// Mix sounds into the mixing buffer.
-	// Loop over len
-	while (len--)
+static void I_MixClamp8_NEON(const INT32 *mix, Sint8 *out, size_t n)
+{
+	for (; n >= 16; n -= 16, mix += 16, out += 16)
+		vst1q_s8(out, vcombine_s8(
+			vqmovn_s16(vcombine_s16(vqmovn_s32(vld1q_s32(mix)), vqmovn_s32(vld1q_s32(mix + 4)))),
+			vqmovn_s16(vcombine_s16(vqmovn_s32(vld1q_s32(mix + 8)), vqmovn_s32(vld1q_s32(mix + 12))))));
+	I_MixClamp8_C(mix, out, n);
+}
+#endif
+
+// Checks the vector kernels against the C ones on made up totals
+static boolean I_MixKernelsMatch(void (*accumulate)(INT32 *, const Sint16 *, size_t, int),
+	void (*clamp16)(const INT32 *, Sint16 *, size_t), void (*clamp8)(const INT32 *, Sint8 *, size_t))
+{
+	static INT32 want[MIXBLOCK*2], got[MIXBLOCK*2];
+	static Sint16 in[MIXBLOCK*2], want16[MIXBLOCK*2], got16[MIXBLOCK*2];
+	static Sint8 want8[MIXBLOCK*2], got8[MIXBLOCK*2];
+	size_t i, n;
+	int shift;
+
+	for (i = 0; i < MIXBLOCK*2; i++)
 	{
-		// Reset left/right value.
-		d = *monoout;
+		in[i] = (Sint16)(i * 40503);
+		want[i] = got[i] = (INT32)(i * 2654435761u) >> (4 + i % 17);
+	}
 
-		// Love thy L2 cache - made this a loop.
-		// Now more channels could be set at compile time
-		//  as well. Thus loop those channels.
-		for (chan = 0; chan < NUM_CHANNELS; chan++)
+	for (n = MIXBLOCK*2 - 31; n <= MIXBLOCK*2; n++) // tails too
+		for (shift = 0; shift <= 8; shift += 8)
 		{
-			// Check channel, if active.
-			if (channels[chan].end)
-			{
-#if 1
-				// Get the raw data from the channel.
-				sample = channels[chan].data[0];
-#else
-				// linear filtering from PrDoom
-				sample = (((Uint32)channels[chan].data[0] *(0x10000 - channels[chan].stepremainder))
-					+ ((Uint32)channels[chan].data[1]) * (channels[chan].stepremainder))) >> 16;
-#endif
-				// Add left and right part
-				//  for this channel (sound)
-				//  to the current data.
-				// Adjust volume accordingly.
-				d = (Sint16)(d+((channels[chan].leftvol_lookup[sample] + channels[chan].rightvol_lookup[sample])>>9));
-				// Increment stepage
-				channels[chan].stepremainder += channels[chan].step;
-				// Check whether we are done.
-				if (channels[chan].data + (channels[chan].stepremainder >> 16) >= channels[chan].end)
-					channels[chan].end = NULL;
-				else
-				{
-					// step to next sample
-					channels[chan].data += (channels[chan].stepremainder >> 16);
-					// Limit to LSB???
-					channels[chan].stepremainder &= 0xffff;
-				}
-			}
+			I_MixAccumulate_C(want, in, n, shift);
+			accumulate(got, in, n, shift);
+			I_MixClamp16_C(want, want16, n);
+			clamp16(got, got16, n);
+			I_MixClamp8_C(want, want8, n);
+			clamp8(got, got8, n);
+			if (memcmp(want, got, sizeof want) || memcmp(want16, got16, sizeof want16) || memcmp(want8, got8, sizeof want8))
+				return false;
 		}
+	return true;
+}
 
-		// Clamp to range. Left hardware channel.
-		// Has been char instead of short.
+// Picks the mixing kernels for this CPU, like R_SetupSpanKernels
+static void I_SetupMixKernels(void)
+{
+	void (*accumulate)(INT32 *, const Sint16 *, size_t, int) = I_MixAccumulate_C;
+	void (*clamp16)(const INT32 *, Sint16 *, size_t) = I_MixClamp16_C;
+	void (*clamp8)(const INT32 *, Sint8 *, size_t) = I_MixClamp8_C;
+	const char *name = NULL;
+
+#ifdef MIXSSE2
+#if !defined (__x86_64__) && !defined (_M_X64)
+	if (cpufeatures.sse2) // always there on x86_64
+#endif
+	{
+		accumulate = I_MixAccumulate_SSE2;
+		clamp16 = I_MixClamp16_SSE2;
+		clamp8 = I_MixClamp8_SSE2;
+		name = "SSE2";
+	}
+#endif
+#ifdef MIXNEON
+	accumulate = I_MixAccumulate_NEON;
+	clamp16 = I_MixClamp16_NEON;
+	clamp8 = I_MixClamp8_NEON;
+	name = "NEON";
+#endif
 
-		if (d > 0x7f)
-			*monoout = 0x7f;
-		else if (d < -0x80)
-			*monoout = -0x80;
-		else
-			*monoout = (Sint8)d;
+	I_MixAccumulate = I_MixAccumulate_C;
+	I_MixClamp16 = I_MixClamp16_C;
+	I_MixClamp8 = I_MixClamp8_C;
+	M_SetKernelPath("sound mixer", "C");
+	if (!name || M_CheckParm("-nomixsimd"))
+		return;
 
-		// Increment current pointers in stream
-		monoout += step;
+	if (I_MixKernelsMatch(accumulate, clamp16, clamp8))
+	{
+		I_MixAccumulate = accumulate;
+		I_MixClamp16 = clamp16;
+		I_MixClamp8 = clamp8;
+		M_SetKernelPath("sound mixer", name);
+		CONS_Printf(" Using %s sound mixer\n", name);
 	}
-	if (Snd_Mutex) SDL_UnlockMutex(Snd_Mutex);
+	else
+		CONS_Alert(CONS_WARNING, "%s sound mixer doesn't match the C mixer, not using it\n", name);
 }
 
-FUNCINLINE static ATTRINLINE void I_UpdateStream16S(Uint8 *stream, int len)
+// Steps through up to frames samples of a channel, writing the right and
+// left volume lookups of each into lr, and returns how many it wrote.
+static size_t I_ResampleChannel(chan_t *c, Sint16 *lr, size_t frames)
 {
-	// Mix current sound data.
-	// Data, from raw sound
-	register Sint32 dr; // Right 16bit stream
-	register Uint8 sample; // Center 8bit sfx
-	register Sint32 dl; // Left 16bit stream
-
-	// Pointers in audio stream
-	Sint16 *rightout = (Sint16 *)(void *)stream; // currect right
-	Sint16 *leftout = rightout + 1;// currect left
-	const Uint8 step = 2; // Step in stream, left and right, thus two.
-
-	INT32 chan; // Mixing channel index.
-
-	// Determine end of the stream
-	len /= 4; // not 8bit mono samples, 16bit stereo ones
-
-	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
-
-
-	// Mix sounds into the mixing buffer.
-	// Loop over len
-	while (len--)
+	const Uint8 *data = c->data;
+	const Uint32 step = c->step;
+	Uint32 frac = c->stepremainder; // 0.16 bit position between data[0] and data[1]
+	const Sint16 *leftvol = c->leftvol_lookup;
+	const Sint16 *rightvol = c->rightvol_lookup;
+	boolean ended = false;
+	size_t i, n = frames;
+
+	if (step)
 	{
-		// Reset left/right value.
-		dl = *leftout;
-		dr = *rightout;
-
-		// Love thy L2 cache - made this a loop.
-		// Now more channels could be set at compile time
-		//  as well. Thus loop those channels.
-		for (chan = 0; chan < NUM_CHANNELS; chan++)
+		// sample i is read at 16.16 offset frac + i*step, while that is
+		// still before the end
+		const UINT64 avail = ((((UINT64)(c->end - data)) << 16) - frac + step - 1) / step;
+		if (avail <= frames)
 		{
-			// Check channel, if active.
-			if (channels[chan].end)
-			{
-#if 1
-				// Get the raw data from the channel.
-				sample = channels[chan].data[0];
-#else
-				// linear filtering from PrDoom
-				sample = (((Uint32)channels[chan].data[0] *(0x10000 - channels[chan].stepremainder))
-					+ ((Uint32)channels[chan].data[1]) * (channels[chan].stepremainder))) >> 16;
-#endif
-				// Add left and right part
-				//  for this channel (sound)
-				//  to the current data.
-				// Adjust volume accordingly.
-				dl += channels[chan].leftvol_lookup[sample];
-				dr += channels[chan].rightvol_lookup[sample];
-				// Increment stepage
-				channels[chan].stepremainder += channels[chan].step;
-				// Check whether we are done.
-				if (channels[chan].data + (channels[chan].stepremainder >> 16) >= channels[chan].end)
-					channels[chan].end = NULL;
-				else
-				{
-					// step to next sample
-					channels[chan].data += (channels[chan].stepremainder >> 16);
-					// Limit to LSB???
-					channels[chan].stepremainder &= 0xffff;
-				}
-			}
+			n = (size_t)avail;
+			ended = true;
 		}
+	}
 
-		// Clamp to range. Left hardware channel.
-		// Has been char instead of short.
-
-		if (dl > 0x7fff)
-			*leftout = 0x7fff;
-		else if (dl < -0x8000)
-			*leftout = -0x8000;
-		else
-			*leftout = (Sint16)dl;
-
-		// Same for right hardware channel.
-		if (dr > 0x7fff)
-			*rightout = 0x7fff;
-		else if (dr < -0x8000)
-			*rightout = -0x8000;
-		else
-			*rightout = (Sint16)dr;
-
-		// Increment current pointers in stream
-		leftout += step;
-		rightout += step;
+	for (i = 0; i < n; i++)
+	{
+		const Uint8 sample = *data;
+		*lr++ = rightvol[sample];
+		*lr++ = leftvol[sample];
+		frac += step;
+		data += frac >> 16;
+		frac &= 0xffff;
+	}
 
+	if (ended)
+		c->end = NULL;
+	else
+	{
+		c->data = (Uint8 *)data;
+		c->stepremainder = frac;
 	}
-	if (Snd_Mutex) SDL_UnlockMutex(Snd_Mutex);
+	return n;
 }
 
-FUNCINLINE static ATTRINLINE void I_UpdateStream16M(Uint8 *stream, int len)
+// Mixes frames output frames of every playing channel into mixbuf.
+// 8-bit streams take the top byte of each volume lookup.
+static void I_MixChannels(size_t frames, boolean stereo, int shift)
 {
-	// Mix current sound data.
-	// Data, from raw sound
-	register Sint32 d; // Mono 16bit stream
-	register Uint8 sample; // Center 8bit sfx
+	static Sint16 lr[MIXBLOCK*2];
+	INT32 chan;
+	size_t i, n;
 
-	// Pointers in audio stream
-	Sint16 *monoout = (Sint16 *)(void *)stream; // currect mono
-	const Uint8 step = 1; // Step in stream, left and right, thus two.
+	memset(mixbuf, 0, (stereo ? 2 : 1) * frames * sizeof *mixbuf);
 
-	INT32 chan; // Mixing channel index.
+	for (chan = 0; chan < NUM_CHANNELS; chan++)
+	{
+		if (!channels[chan].end)
+			continue;
 
-	// Determine end of the stream
-	len /= 2; // not 8bit mono samples, 16bit mono ones
+		n = I_ResampleChannel(&channels[chan], lr, frames);
+		if (stereo)
+			I_MixAccumulate(mixbuf, lr, n*2, shift);
+		else
+			for (i = 0; i < n; i++)
+				mixbuf[i] += (lr[i*2] + lr[i*2 + 1]) >> (shift + 1);
+	}
+}
 
-	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
+FUNCINLINE static ATTRINLINE void I_UpdateStream8(Uint8 *stream, int len, boolean stereo)
+{
+	Sint8 *out = (Sint8 *)stream;
+	size_t frames = (size_t)len / (stereo ? 2 : 1), n;
 
+	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
 
-	// Mix sounds into the mixing buffer.
-	// Loop over len
-	while (len--)
+	for (; frames; frames -= n)
 	{
-		// Reset left/right value.
-		d = *monoout;
+		n = min(frames, MIXBLOCK);
+		I_MixChannels(n, stereo, 8);
+		I_MixClamp8(mixbuf, out, stereo ? n*2 : n);
+		out += stereo ? n*2 : n;
+	}
 
-		// Love thy L2 cache - made this a loop.
-		// Now more channels could be set at compile time
-		//  as well. Thus loop those channels.
-		for (chan = 0; chan < NUM_CHANNELS; chan++)
-		{
-			// Check channel, if active.
-			if (channels[chan].end)
-			{
-#if 1
-				// Get the raw data from the channel.
-				sample = channels[chan].data[0];
-#else
-				// linear filtering from PrDoom
-				sample = (((Uint32)channels[chan].data[0] *(0x10000 - channels[chan].stepremainder))
-					+ ((Uint32)channels[chan].data[1]) * (channels[chan].stepremainder))) >> 16;
-#endif
-				// Add left and right part
-				//  for this channel (sound)
-				//  to the current data.
-				// Adjust volume accordingly.
-				d += (channels[chan].leftvol_lookup[sample] + channels[chan].rightvol_lookup[sample])>>1;
-				// Increment stepage
-				channels[chan].stepremainder += channels[chan].step;
-				// Check whether we are done.
-				if (channels[chan].data + (channels[chan].stepremainder >> 16) >= channels[chan].end)
-					channels[chan].end = NULL;
-				else
-				{
-					// step to next sample
-					channels[chan].data += (channels[chan].stepremainder >> 16);
-					// Limit to LSB???
-					channels[chan].stepremainder &= 0xffff;
-				}
-			}
-		}
+	if (Snd_Mutex) SDL_UnlockMutex(Snd_Mutex);
+}
 
-		// Clamp to range. Left hardware channel.
-		// Has been char instead of short.
+FUNCINLINE static ATTRINLINE void I_UpdateStream16(Uint8 *stream, int len, boolean stereo)
+{
+	Sint16 *out = (Sint16 *)(void *)stream;
+	size_t frames = (size_t)len / (stereo ? 4 : 2), n;
 
-		if (d > 0x7fff)
-			*monoout = 0x7fff;
-		else if (d < -0x8000)
-			*monoout = -0x8000;
-		else
-			*monoout = (Sint16)d;
+	if (Snd_Mutex) SDL_LockMutex(Snd_Mutex);
 
-		// Increment current pointers in stream
-		monoout += step;
+	for (; frames; frames -= n)
+	{
+		n = min(frames, MIXBLOCK);
+		I_MixChannels(n, stereo, 0);
+		I_MixClamp16(mixbuf, out, stereo ? n*2 : n);
+		out += stereo ? n*2 : n;
 	}
+
 	if (Snd_Mutex) SDL_UnlockMutex(Snd_Mutex);
 }
 
@@ -1041,15 +1021,13 @@ static void SDLCALL I_UpdateStream(void *userdata, Uint8 *stream, int len)
 	if ((audio.channels != 1 && audio.channels != 2) ||
 	    (audio.format != AUDIO_S8 && audio.format != AUDIO_S16SYS))
 		; // no function to encode this type of stream
-	else if (audio.channels == 1 && audio.format == AUDIO_S8)
-		I_UpdateStream8M(stream, len);
-	else if (audio.channels == 2 && audio.format == AUDIO_S8)
-		I_UpdateStream8S(stream, len);
-	else if (audio.channels == 1 && audio.format == AUDIO_S16SYS)
-		I_UpdateStream16M(stream, len);
-	else if (audio.channels == 2 && audio.format == AUDIO_S16SYS)
+	else if (audio.format == AUDIO_S8)
+		I_UpdateStream8(stream, len, audio.channels == 2);
+	else if (audio.channels == 1)
+		I_UpdateStream16(stream, len, false);
+	else
 	{
-		I_UpdateStream16S(stream, len);
+		I_UpdateStream16(stream, len, true);
 
 		// Crashes! But no matter; this build doesn't play music anyway...
 // #ifdef HAVE_LIBGME
@@ -1314,6 +1292,7 @@ void I_StartupSound(void)
 	if (!musicStarted) SDL_PauseAudio(0);
 	//Mix_Pause(0);
 	I_SetChannels();
+	I_SetupMixKernels();
 	sound_started = true;
 	Snd_Mutex = SDL_CreateMutex();
 }
@@ -1436,6 +1415,12 @@ boolean I_LoadSong(char *data, size_t len)
 
 void I_UnloadSong(void) { }
 
+void I_PrefetchSong(char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+}
+
 boolean I_PlaySong(boolean looping)
 {
 	(void)looping;
@@ -440,7 +440,7 @@ boolean I_InitNetwork(void)
 			COM_BufAddText("connect any\n");
 
 			net_bandwidth = 800000;
-			hardware_MAXPACKETLENGTH = MAXPACKETLENGTH;
+			hardware_MAXPACKETLENGTH = LANPACKETLENGTH;
 		}
 	}
 
@@ -416,11 +416,11 @@ boolean I_InitNetwork(void)
 			COM_BufAddText("connect any\n");
 
 			net_bandwidth = 800000;
-			hardware_MAXPACKETLENGTH = MAXPACKETLENGTH;
+			hardware_MAXPACKETLENGTH = LANPACKETLENGTH;
 		}
 	}
 
-	mypacket.maxlen = hardware_MAXPACKETLENGTH;
+	mypacket.maxlen = MAXPACKETLENGTH;
 	I_NetOpenSocket = NET_OpenSocket;
 	I_Ban = NET_Ban;
 	I_ClearBans = NET_ClearBans;
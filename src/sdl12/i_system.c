@@ -2189,6 +2189,15 @@ tic_t I_GetTime (void)
 }
 #endif
 
+//
+// I_GetTimeMicros
+// SDL 1.2 has no performance counter, so this is only millisecond precise
+//
+UINT32 I_GetTimeMicros(void)
+{
+	return SDL_GetTicks() * 1000;
+}
+
 //
 //I_StartupTimer
 //
@@ -2226,6 +2235,15 @@ void I_Sleep(void)
 #endif
 }
 
+void I_SleepMillis(UINT32 ms)
+{
+#if !(defined (_arch_dreamcast) || defined (_XBOX))
+	SDL_Delay(ms);
+#else
+	(void)ms;
+#endif
+}
+
 INT32 I_StartupSystem(void)
 {
 	SDL_version SDLcompiled;
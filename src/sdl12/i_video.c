@@ -1959,15 +1959,22 @@ void I_StartupGraphics(void)
 		HWD.pfnSetBlend         = hwSym("SetBlend",NULL);
 		HWD.pfnClearBuffer      = hwSym("ClearBuffer",NULL);
 		HWD.pfnSetTexture       = hwSym("SetTexture",NULL);
+		HWD.pfnUpdateTexture    = hwSym("UpdateTexture",NULL);
+		HWD.pfnSetColormap      = hwSym("SetColormap",NULL);
 		HWD.pfnReadRect         = hwSym("ReadRect",NULL);
 		HWD.pfnGClipRect        = hwSym("GClipRect",NULL);
 		HWD.pfnClearMipMapCache = hwSym("ClearMipMapCache",NULL);
 		HWD.pfnSetSpecialState  = hwSym("SetSpecialState",NULL);
 		HWD.pfnSetPalette       = hwSym("SetPalette",NULL);
 		HWD.pfnGetTextureUsed   = hwSym("GetTextureUsed",NULL);
+		HWD.pfnGetTextureStats  = hwSym("GetTextureStats",NULL);
+		HWD.pfnMarkRenderSection = hwSym("MarkRenderSection",NULL);
+		HWD.pfnGetRenderStats   = hwSym("GetRenderStats",NULL);
+		HWD.pfnReadScreenAsync  = hwSym("ReadScreenAsync",NULL);
 		HWD.pfnDrawMD2          = hwSym("DrawMD2",NULL);
 		HWD.pfnDrawMD2i         = hwSym("DrawMD2i",NULL);
 		HWD.pfnSetTransform     = hwSym("SetTransform",NULL);
+		HWD.pfnSetBlendedTexture= hwSym("SetBlendedTexture",NULL);
 		HWD.pfnGetRenderVersion = hwSym("GetRenderVersion",NULL);
 #ifdef SHUFFLE
 		HWD.pfnPostImgRedraw    = hwSym("PostImgRedraw",NULL);
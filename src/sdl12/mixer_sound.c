@@ -384,6 +384,12 @@ void I_FreeSfx(sfxinfo_t *sfx)
 	sfx->data = NULL;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx(sfx);
+}
+
 INT32 I_StartSound(sfxenum_t id, UINT8 vol, UINT8 sep, UINT8 pitch, UINT8 priority, INT32 channel)
 {
 	UINT8 volume = (((UINT16)vol + 1) * (UINT16)sfx_volume) / 62; // (256 * 31) / 62 == 127
@@ -609,6 +609,12 @@ void I_FreeSfx(sfxinfo_t * sfx)
 	sfx->lumpnum = LUMPERROR;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx(sfx);
+}
+
 //
 // Starting a sound means adding it
 //  to the current list of active sounds
@@ -342,6 +342,8 @@ void ST_LoadGraphics(void)
 // made separate so that skins code can reload custom face graphics
 void ST_LoadFaceGraphics(char *facestr, char *superstr, INT32 skinnum)
 {
+	if (dedicated) // never drawn, so leave them freed
+		return;
 	faceprefix[skinnum] = W_CachePatchName(facestr, PU_HUDGFX);
 	superprefix[skinnum] = W_CachePatchName(superstr, PU_HUDGFX);
 	facefreed[skinnum] = false;
@@ -1683,7 +1685,6 @@ static void ST_doHuntIconsAndSound(void)
 static void ST_doItemFinderIconsAndSound(void)
 {
 	INT32 emblems[16];
-	thinker_t *th;
 	mobj_t *mo2;
 
 	UINT8 stemblems = 0, stunfound = 0;
@@ -1709,29 +1710,22 @@ static void ST_doItemFinderIconsAndSound(void)
 		return;
 
 	// Scan thinkers to find emblem mobj with these ids
-	for (th = thinkercap.next; th != &thinkercap; th = th->next)
+	for (mo2 = P_FindMobjFromType(MT_EMBLEM, NULL); mo2; mo2 = P_FindMobjFromType(MT_EMBLEM, mo2))
 	{
-		if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+		if (!(mo2->flags & MF_SPECIAL))
 			continue;
-		mo2 = (mobj_t *)th;
 
-		if (mo2->type == MT_EMBLEM)
+		for (i = 0; i < stemblems; ++i)
 		{
-			if (!(mo2->flags & MF_SPECIAL))
-				continue;
-
-			for (i = 0; i < stemblems; ++i)
+			if (mo2->health == emblems[i]+1)
 			{
-				if (mo2->health == emblems[i]+1)
-				{
-					soffset = (i * 20) - ((stemblems-1) * 10);
+				soffset = (i * 20) - ((stemblems-1) * 10);
 
-					newinterval = ST_drawEmeraldHuntIcon(mo2, itemhoming, soffset);
-					if (newinterval && (!interval || newinterval < interval))
-						interval = newinterval;
+				newinterval = ST_drawEmeraldHuntIcon(mo2, itemhoming, soffset);
+				if (newinterval && (!interval || newinterval < interval))
+					interval = newinterval;
 
-					break;
-				}
+				break;
 			}
 		}
 	}
@@ -328,6 +328,68 @@ static inline UINT8 transmappedpdraw(const UINT8 *dest, const UINT8 *source, fix
 }
 
 // Draws a patch scaled to arbitrary size.
+//
+// V_DrawPatchBlocks
+//
+// V_DrawFixedPatch for whole number scales, without flipping: each patch
+// pixel becomes a dup by dup block. desttop is where the patch's top left
+// corner goes, column x of the screen.
+//
+static void V_DrawPatchBlocks(INT32 x, INT32 dup, UINT8 *desttop, const UINT8 *screenstart, const UINT8 *deststop, const patch_t *patch)
+{
+	const INT32 width = SHORT(patch->width);
+	const column_t *column;
+	const UINT8 *source, *blend = NULL;
+	UINT8 *dest, v;
+	INT32 col, x1, x2, topdelta, prevdelta, i, r, u;
+
+	for (col = 0; col < width; col++)
+	{
+		x1 = x + col*dup;
+		x2 = x1 + dup;
+		if (x1 >= vid.width)
+			break;
+		if (x2 <= 0)
+			continue;
+		if (x1 < 0)
+			x1 = 0;
+		if (x2 > vid.width)
+			x2 = vid.width;
+
+		column = (const column_t *)((const UINT8 *)(patch) + LONG(patch->columnofs[col]));
+		prevdelta = -1;
+		while (column->topdelta != 0xff)
+		{
+			topdelta = column->topdelta;
+			if (topdelta <= prevdelta)
+				topdelta += prevdelta;
+			prevdelta = topdelta;
+			source = (const UINT8 *)(column) + 3;
+			dest = desttop + (x1 - x) + topdelta*dup*vid.width;
+
+			for (i = 0; i < column->length && dest < deststop; i++)
+			{
+				v = v_colormap ? v_colormap[source[i]] : source[i];
+				if (v_translevel)
+					blend = v_translevel + (v<<8);
+				for (r = 0; r < dup; r++, dest += vid.width)
+				{
+					if (dest < screenstart || dest >= deststop) // don't draw off the screen (CRASH PREVENTION)
+						continue;
+					if (blend)
+					{
+						for (u = 0; u < x2 - x1; u++)
+							dest[u] = blend[dest[u]];
+					}
+					else
+						memset(dest, v, x2 - x1);
+				}
+			}
+			column = (const column_t *)((const UINT8 *)column + column->length + 4);
+		}
+	}
+}
+
 void V_DrawFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, INT32 scrn, patch_t *patch, const UINT8 *colormap)
 {
 	UINT8 (*patchdrawfunc)(const UINT8*, const UINT8*, fixed_t);
@@ -370,7 +432,7 @@ void V_DrawFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, INT32 scrn, patch_t
 	}
 	if (alphalevel)
 	{
-		v_translevel = transtables + ((alphalevel-1)<<FF_TRANSSHIFT);
+		v_translevel = R_GetTranslucencyTable(alphalevel);
 		patchdrawfunc = translucentpdraw;
 	}
 
@@ -501,6 +563,19 @@ void V_DrawFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, INT32 scrn, patch_t
 	else
 		pwidth = SHORT(patch->width) * dupx;
 
+	// Nothing to do if it's off the screen entirely
+	if (x + pwidth <= 0 || x >= vid.width || y >= vid.height
+		|| y + (FixedMul(SHORT(patch->height)<<FRACBITS, fdup)>>FRACBITS) <= 0)
+		return;
+
+	// At a whole number scale, every patch pixel is a block of the same
+	// colour, so work it out once and fill the block.
+	if (!(fdup & (FRACUNIT-1)) && !(scrn & V_FLIP))
+	{
+		V_DrawPatchBlocks(x, fdup>>FRACBITS, desttop, screens[scrn&V_PARAMMASK], deststop, patch);
+		return;
+	}
+
 	deststart = desttop;
 	destend = desttop + pwidth;
 
@@ -970,15 +1045,19 @@ void V_DrawFillConsoleMap(INT32 x, INT32 y, INT32 w, INT32 h, INT32 c)
 	// Jimita (12-04-2018)
 	w = min(w, vid.width);
 	h = min(h, vid.height);
-	fadetable = ((UINT8 *)transtables + ((alphalevel-1)<<FF_TRANSSHIFT) + (c*256));
-	for (v = 0; v < h; v++, dest += vid.width)
-		for (u = 0; u < w; u++)
-		{
-			if (!alphalevel)
+	fadetable = alphalevel ? R_GetTranslucencyTable(alphalevel) + (c*256) : NULL;
+	if (!alphalevel)
+	{
+		for (v = 0; v < h; v++, dest += vid.width)
+			for (u = 0; u < w; u++)
 				dest[u] = consolebgmap[dest[u]];
-			else
+	}
+	else
+	{
+		for (v = 0; v < h; v++, dest += vid.width)
+			for (u = 0; u < w; u++)
 				dest[u] = fadetable[consolebgmap[dest[u]]];
-		}
+	}
 }
 
 //
@@ -2078,7 +2157,7 @@ void V_DoPostProcessor(INT32 view, postimg_t type, INT32 param)
 		angle_t disStart = (leveltime * 128) & FINEMASK; // in 0 to FINEANGLE
 		INT32 newpix;
 		INT32 sine;
-		//UINT8 *transme = transtables + ((tr_trans50-1)<<FF_TRANSSHIFT);
+		//UINT8 *transme = R_GetTranslucencyTable(tr_trans50);
 
 		for (y = yoffset; y < yoffset+height; y++)
 		{
@@ -2135,7 +2214,7 @@ Unoptimized version
 		INT32 x, y;
 
 		// TODO: Add a postimg_param so that we can pick the translucency level...
-		UINT8 *transme = transtables + ((param-1)<<FF_TRANSSHIFT);
+		UINT8 *transme = R_GetTranslucencyTable(param);
 
 		for (y = yoffset; y < yoffset+height; y++)
 		{
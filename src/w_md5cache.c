@@ -0,0 +1,340 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  w_md5cache.c
+/// \brief Remembering the MD5 of every file hashed, so it's only done once
+///
+///        New digests are added to the end of the cache file as they're
+///        made, so a crash loses nothing. When a file changes, its old line
+///        stays behind; once those are most of the file, it's written again
+///        with only the lines still in use.
+
+#include <sys/stat.h>
+#if defined (__unix__) || defined (UNIXCOMMON) || defined (__APPLE__)
+#include <limits.h> // PATH_MAX
+#endif
+
+#include "doomdef.h"
+#include "d_main.h" // srb2home
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+#include "m_argv.h"
+#include "m_misc.h"
+#include "md5.h"
+#include "w_md5cache.h"
+#include "z_zone.h"
+
+#define MD5CACHEFILE "md5cache.txt"
+
+consvar_t cv_md5cache = {"md5cache", "On", CV_SAVE, CV_OnOff, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct md5entry_s
+{
+	char *path; // full path
+	UINT32 size, mtime;
+	UINT8 md5sum[16];
+	struct md5entry_s *next;
+} md5entry_t;
+
+static md5entry_t *md5entries = NULL;
+static boolean md5cacheloaded = false;
+
+//
+// W_FullPath
+//
+// So the same file reached two ways is only kept once.
+//
+static void W_FullPath(const char *filename, char *path, size_t size)
+{
+#if defined (_WIN32) && !defined (_XBOX) && !defined (_WIN32_WCE)
+	if (_fullpath(path, filename, size))
+		return;
+#elif defined (__unix__) || defined (UNIXCOMMON) || defined (__APPLE__)
+	char full[PATH_MAX];
+
+	if (realpath(filename, full))
+	{
+		strlcpy(path, full, size);
+		return;
+	}
+#endif
+	strlcpy(path, filename, size);
+}
+
+static md5entry_t *W_FindMD5Entry(const char *path)
+{
+	md5entry_t *e;
+
+	for (e = md5entries; e; e = e->next)
+		if (!strcmp(e->path, path))
+			return e;
+	return NULL;
+}
+
+static md5entry_t *W_SetMD5Entry(const char *path, UINT32 size, UINT32 mtime, const UINT8 *md5sum)
+{
+	md5entry_t *e = W_FindMD5Entry(path);
+
+	if (!e)
+	{
+		e = Z_Malloc(sizeof (*e), PU_STATIC, NULL);
+		e->path = Z_StrDup(path);
+		e->next = md5entries;
+		md5entries = e;
+	}
+	e->size = size;
+	e->mtime = mtime;
+	memcpy(e->md5sum, md5sum, 16);
+	return e;
+}
+
+static void W_WriteMD5Entry(FILE *f, const md5entry_t *e)
+{
+	INT32 i;
+
+	for (i = 0; i < 16; i++)
+		fprintf(f, "%02x", e->md5sum[i]);
+	fprintf(f, " %lu %lu %s\n", (unsigned long)e->size, (unsigned long)e->mtime, e->path);
+}
+
+//
+// W_LoadMD5Cache
+//
+// Reads the cache file, and writes it again if most of it is stale.
+//
+static void W_LoadMD5Cache(void)
+{
+	char line[MAX_WADPATH + 64];
+	size_t lines = 0, kept = 0;
+	md5entry_t *e;
+	FILE *f;
+
+	md5cacheloaded = true;
+
+	f = fopen(va(pandf, srb2home, MD5CACHEFILE), "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof line, f))
+	{
+		char hex[33];
+		unsigned long size, mtime;
+		UINT8 md5sum[16];
+		INT32 i, pathstart = 0;
+		size_t len;
+
+		if (sscanf(line, "%32s %lu %lu %n", hex, &size, &mtime, &pathstart) < 3
+			|| !pathstart || strlen(hex) != 32)
+			continue;
+
+		len = strlen(line);
+		while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+			line[--len] = '\0';
+		if ((size_t)pathstart >= len)
+			continue;
+
+		for (i = 0; i < 16; i++)
+		{
+			unsigned int byte;
+			if (sscanf(&hex[i*2], "%2x", &byte) != 1)
+				break;
+			md5sum[i] = (UINT8)byte;
+		}
+		if (i < 16)
+			continue;
+
+		W_SetMD5Entry(&line[pathstart], (UINT32)size, (UINT32)mtime, md5sum);
+		lines++;
+	}
+	fclose(f);
+
+	for (e = md5entries; e; e = e->next)
+		kept++;
+
+	if (lines > 2*kept + 16)
+	{
+		f = fopen(va(pandf, srb2home, MD5CACHEFILE), "w");
+		if (f)
+		{
+			for (e = md5entries; e; e = e->next)
+				W_WriteMD5Entry(f, e);
+			fclose(f);
+		}
+	}
+}
+
+static INT32 W_HashFile(const char *filename, UINT8 *md5sum)
+{
+	FILE *f = fopen(filename, "rb");
+	INT32 err;
+
+	if (!f)
+		return 1;
+	err = md5_stream(f, md5sum);
+	fclose(f);
+	return err ? 1 : 0;
+}
+
+INT32 W_FileMD5(const char *filename, UINT8 *md5sum)
+{
+	char path[MAX_WADPATH];
+	struct stat st;
+	md5entry_t *e;
+	FILE *f;
+
+	// The config hasn't been read yet for the startup files
+	if (M_CheckParm("-nomd5cache") || (cv_md5cache.string && !cv_md5cache.value)
+		|| stat(filename, &st) < 0)
+		return W_HashFile(filename, md5sum);
+
+	if (!md5cacheloaded)
+		W_LoadMD5Cache();
+
+	W_FullPath(filename, path, sizeof path);
+	e = W_FindMD5Entry(path);
+	if (e && e->size == (UINT32)st.st_size && e->mtime == (UINT32)st.st_mtime)
+	{
+		memcpy(md5sum, e->md5sum, 16);
+		return 0;
+	}
+
+	if (W_HashFile(filename, md5sum))
+		return 1;
+
+	e = W_SetMD5Entry(path, (UINT32)st.st_size, (UINT32)st.st_mtime, md5sum);
+	f = fopen(va(pandf, srb2home, MD5CACHEFILE), "a");
+	if (f)
+	{
+		W_WriteMD5Entry(f, e);
+		fclose(f);
+	}
+	return 0;
+}
+
+// A file W_PrepareFileMD5s has to hash, because the cache didn't have it
+typedef struct
+{
+	const char *filename;
+	char path[MAX_WADPATH];
+	UINT32 size, mtime;
+	UINT8 md5sum[16];
+	INT32 err;
+} md5job_t;
+
+#define MAXMD5THREADS 8 // past this the disk is the limit anyway
+
+static md5job_t *md5jobs;
+static size_t nummd5jobs = 0, nextmd5job = 0, md5jobsleft = 0;
+#ifdef HAVE_THREADS
+static I_mutex md5job_mutex;
+static I_cond md5job_cond;
+#endif
+
+//
+// W_MD5Worker
+//
+// Hashes files off the list until it's empty. Touches nothing but the jobs,
+// so it can run on any thread.
+//
+static void W_MD5Worker(void *userdata)
+{
+	(void)userdata;
+#ifdef HAVE_THREADS
+	I_lock_mutex(&md5job_mutex);
+	while (nextmd5job < nummd5jobs)
+	{
+		md5job_t *job = &md5jobs[nextmd5job++];
+
+		I_unlock_mutex(md5job_mutex);
+		job->err = W_HashFile(job->filename, job->md5sum);
+		I_lock_mutex(&md5job_mutex);
+
+		if (--md5jobsleft == 0)
+			I_wake_all_cond(&md5job_cond);
+	}
+	I_unlock_mutex(md5job_mutex);
+#else
+	for (; nextmd5job < nummd5jobs; nextmd5job++, md5jobsleft--)
+		md5jobs[nextmd5job].err = W_HashFile(md5jobs[nextmd5job].filename, md5jobs[nextmd5job].md5sum);
+#endif
+}
+
+void W_PrepareFileMD5s(const char **filenames, size_t count)
+{
+	struct stat st;
+	md5entry_t *e;
+	size_t i, n = 0;
+	FILE *f;
+
+	if (!count || M_CheckParm("-nomd5cache") || (cv_md5cache.string && !cv_md5cache.value))
+		return;
+
+	if (!md5cacheloaded)
+		W_LoadMD5Cache();
+
+	md5jobs = malloc(count * sizeof (*md5jobs));
+	if (!md5jobs)
+		return;
+
+	for (i = 0; i < count; i++)
+	{
+		md5job_t *job = &md5jobs[n];
+
+		if (stat(filenames[i], &st) < 0) // W_OpenWadFile will go looking for it
+			continue;
+		W_FullPath(filenames[i], job->path, sizeof job->path);
+		e = W_FindMD5Entry(job->path);
+		if (e && e->size == (UINT32)st.st_size && e->mtime == (UINT32)st.st_mtime)
+			continue;
+
+		job->filename = filenames[i];
+		job->size = (UINT32)st.st_size;
+		job->mtime = (UINT32)st.st_mtime;
+		n++;
+	}
+
+	if (n)
+	{
+#ifdef HAVE_THREADS
+		INT32 threads = min(min(I_num_cpus(), MAXMD5THREADS), (INT32)n);
+#endif
+
+		nummd5jobs = md5jobsleft = n;
+		nextmd5job = 0;
+#ifdef HAVE_THREADS
+		while (--threads > 0)
+			I_spawn_thread("md5", W_MD5Worker, NULL);
+#endif
+		W_MD5Worker(NULL);
+#ifdef HAVE_THREADS
+		I_lock_mutex(&md5job_mutex);
+		while (md5jobsleft)
+			I_hold_cond(&md5job_cond, md5job_mutex);
+		nummd5jobs = 0;
+		I_unlock_mutex(md5job_mutex);
+#else
+		nummd5jobs = 0;
+#endif
+
+		f = fopen(va(pandf, srb2home, MD5CACHEFILE), "a");
+		for (i = 0; i < n; i++)
+		{
+			if (md5jobs[i].err)
+				continue;
+			e = W_SetMD5Entry(md5jobs[i].path, md5jobs[i].size, md5jobs[i].mtime, md5jobs[i].md5sum);
+			if (f)
+				W_WriteMD5Entry(f, e);
+		}
+		if (f)
+			fclose(f);
+	}
+
+	free(md5jobs);
+	md5jobs = NULL;
+}
@@ -0,0 +1,46 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 1999-2018 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  w_md5cache.h
+/// \brief Remembering the MD5 of every file hashed, so it's only done once
+///
+///        The digests are kept in md5cache.txt in the home folder, under the
+///        file's full path along with its size and modification time. A file
+///        that still has the same size and time is taken to have the same
+///        contents: it comes back from the cache without being read.
+
+#ifndef __W_MD5CACHE__
+#define __W_MD5CACHE__
+
+#include "command.h"
+
+extern consvar_t cv_md5cache;
+
+/**	\brief Makes the MD5 for a file, through the cache if it's on.
+
+	Not thread safe: call it from the main thread.
+
+	\param	filename	the file
+	\param	md5sum	where the 16 bytes of the digest go
+	\return	0 if the digest is in md5sum, 1 if the file couldn't be read
+*/
+INT32 W_FileMD5(const char *filename, UINT8 *md5sum);
+
+/**	\brief Makes the MD5s of a list of files ahead of time, several at once
+	if there are threads, so W_FileMD5 finds them all in the cache.
+
+	Call it from the main thread, with the files that are about to be
+	loaded or checked. Does nothing if the cache is off; files that aren't
+	there are left for whoever searches for them.
+
+	\param	filenames	the files
+	\param	count	how many there are
+*/
+void W_PrepareFileMD5s(const char **filenames, size_t count);
+
+#endif // __W_MD5CACHE__
@@ -14,6 +14,17 @@
 #ifdef __GNUC__
 #include <unistd.h>
 #endif
+#include <time.h>
+
+#if defined (_WIN32) && !defined (_XBOX) && !defined (_WIN32_WCE)
+#define MAPWIN32
+#define RPC_NO_WINDOWS_H
+#include <windows.h>
+#include <io.h>
+#elif defined (UNIXCOMMON) || defined (__APPLE__) || defined (__HAIKU__)
+#define MAPPOSIX
+#include <sys/mman.h>
+#endif
 
 #define ZWAD
 
@@ -43,11 +54,15 @@
 #include "r_defs.h"
 #include "i_system.h"
 #include "md5.h"
+#include "w_md5cache.h"
 #include "lua_script.h"
 #ifdef SCANTHINGS
 #include "p_setup.h" // P_ScanThings
 #endif
 #include "m_misc.h" // M_MapNumber
+#include "m_argv.h" // M_CheckParm
+#include "m_trace.h"
+#include "i_threads.h"
 
 #ifdef HWRENDER
 #include "r_data.h"
@@ -90,24 +105,17 @@ typedef struct
 	size_t len;
 } lumpchecklist_t;
 
-// Must be a power of two
-#define LUMPNUMCACHESIZE 64
-
-typedef struct lumpnum_cache_s
-{
-	char lumpname[8];
-	lumpnum_t lumpnum;
-} lumpnum_cache_t;
-
-static lumpnum_cache_t lumpnumcache[LUMPNUMCACHESIZE];
-static UINT16 lumpnumcacheindex = 0;
-
 //===========================================================================
 //                                                                    GLOBALS
 //===========================================================================
 UINT16 numwadfiles; // number of active wadfiles
 wadfile_t *wadfiles[MAX_WADFILES]; // 0 to numwadfiles-1 are valid
 
+void (*W_LumpMissHook)(lumpnum_t lumpnum, lumpmiss_t how) = NULL;
+
+static void W_FreeLumpHash(lumphash_t *hash);
+static void W_UnmapFile(wadfile_t *wadfile);
+
 // W_Shutdown
 // Closes all of the WAD files before quitting
 // If not done on a Mac then open wad files
@@ -115,13 +123,17 @@ wadfile_t *wadfiles[MAX_WADFILES]; // 0 to numwadfiles-1 are valid
 // being ejected
 void W_Shutdown(void)
 {
+	W_FlushPrefetchedLumps();
 	while (numwadfiles--)
 	{
+		W_UnmapFile(wadfiles[numwadfiles]);
 		fclose(wadfiles[numwadfiles]->handle);
 		Z_Free(wadfiles[numwadfiles]->filename);
 		while (wadfiles[numwadfiles]->numlumps--)
 			Z_Free(wadfiles[numwadfiles]->lumpinfo[wadfiles[numwadfiles]->numlumps].name2);
 		Z_Free(wadfiles[numwadfiles]->lumpinfo);
+		W_FreeLumpHash(&wadfiles[numwadfiles]->namehash);
+		W_FreeLumpHash(&wadfiles[numwadfiles]->fullnamehash);
 		Z_Free(wadfiles[numwadfiles]);
 	}
 }
@@ -293,31 +305,187 @@ static inline INT32 W_MakeFileMD5(const char *filename, void *resblock)
 #ifdef NOMD5
 	(void)filename;
 	memset(resblock, 0x00, 16);
+	return 1;
 #else
-	FILE *fhandle;
+	tic_t t = I_GetTime();
+
+	CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",filename);
+	if (W_FileMD5(filename, resblock))
+		return 1;
+	CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f seconds\n",
+		filename, (float)(I_GetTime() - t)/NEWTICRATE);
+	return 0;
+#endif
+}
+
+/** Hashes a lump name, ignoring case.
+  * \param name The name to hash.
+  * \param len Maximum number of characters to consider.
+  * \return The hash value.
+  */
+UINT32 W_HashLumpName(const char *name, size_t len)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	while (len-- && *name)
+	{
+		hash ^= (UINT8)toupper(*name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/** Builds a hash index over the names of a wad's lumps.
+  * \param hash The index to fill in.
+  * \param lumpinfo The wad's directory.
+  * \param numlumps Number of entries in the directory.
+  * \param fullname Hash the full PK3 path instead of the 8-character name.
+  */
+static void W_BuildLumpHash(lumphash_t *hash, lumpinfo_t *lumpinfo, UINT16 numlumps, boolean fullname)
+{
+	UINT32 numbuckets = 16;
+	UINT16 i;
+
+	while (numbuckets < numlumps)
+		numbuckets <<= 1;
+
+	hash->mask = numbuckets - 1;
+	hash->buckets = Z_Malloc(numbuckets * sizeof (*hash->buckets), PU_STATIC, NULL);
+	hash->next = Z_Malloc((numlumps ? numlumps : 1) * sizeof (*hash->next), PU_STATIC, NULL);
+	memset(hash->buckets, 0xff, numbuckets * sizeof (*hash->buckets)); // LUMPHASHEND
 
-	if ((fhandle = fopen(filename, "rb")) != NULL)
+	// Insert backwards so each chain ends up in ascending lump order.
+	for (i = numlumps; i-- > 0;)
 	{
-		tic_t t = I_GetTime();
-		CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",filename);
-		if (md5_stream(fhandle, resblock) == 1)
+		UINT32 bucket = (fullname ? W_HashLumpName(lumpinfo[i].name2, (size_t)-1)
+			: W_HashLumpName(lumpinfo[i].name, 8)) & hash->mask;
+		hash->next[i] = hash->buckets[bucket];
+		hash->buckets[bucket] = i;
+	}
+}
+
+static void W_FreeLumpHash(lumphash_t *hash)
+{
+	Z_Free(hash->buckets);
+	Z_Free(hash->next);
+	hash->buckets = hash->next = NULL;
+}
+
+/** Time spent building lump indexes, reported by W_InitMultipleFiles.
+  */
+static clock_t lumphashtime = 0;
+
+/** Maps a wad file into memory, read-only and shared with every other
+  * process that has it open. Lump reads then become plain copies out of
+  * the mapping instead of fseek/fread pairs.
+  * Does nothing if the platform can't do it or -nommap was given; reads
+  * keep going through the FILE handle in that case.
+  * \param wadfile The freshly opened wad file.
+  */
+static void W_MapFile(wadfile_t *wadfile)
+{
+	wadfile->mapped = NULL;
+	wadfile->maphandle = NULL;
+
+	if (!wadfile->filesize || M_CheckParm("-nommap"))
+		return;
+
+#if defined (MAPPOSIX)
+	{
+		void *view = mmap(NULL, wadfile->filesize, PROT_READ, MAP_SHARED, fileno(wadfile->handle), 0);
+		if (view != MAP_FAILED)
+			wadfile->mapped = view;
+	}
+#elif defined (MAPWIN32)
+	{
+		HANDLE file = (HANDLE)_get_osfhandle(_fileno(wadfile->handle));
+		HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
 		{
-			fclose(fhandle);
-			return 1;
+			wadfile->mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (wadfile->mapped)
+				wadfile->maphandle = mapping;
+			else
+				CloseHandle(mapping);
 		}
-		CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f seconds\n",
-			filename, (float)(I_GetTime() - t)/NEWTICRATE);
-		fclose(fhandle);
-		return 0;
 	}
 #endif
-	return 1;
+
+	if (!wadfile->mapped)
+		CONS_Debug(DBG_SETUP, "Could not map %s into memory, using buffered reads\n", wadfile->filename);
+}
+
+static void W_UnmapFile(wadfile_t *wadfile)
+{
+	if (!wadfile->mapped)
+		return;
+#if defined (MAPPOSIX)
+	munmap(wadfile->mapped, wadfile->filesize);
+#elif defined (MAPWIN32)
+	UnmapViewOfFile(wadfile->mapped);
+	CloseHandle(wadfile->maphandle);
+#endif
+	wadfile->mapped = NULL;
+	wadfile->maphandle = NULL;
+}
+
+/** Reads raw bytes out of a wad file, from its mapping if it has one.
+  * \param wadfile The wad file to read from.
+  * \param dest Destination buffer.
+  * \param position Offset in the file.
+  * \param size Number of bytes to read.
+  * \return Number of bytes actually read.
+  */
+static size_t W_ReadRaw(wadfile_t *wadfile, void *dest, size_t position, size_t size)
+{
+	if (wadfile->mapped)
+	{
+		if (position >= wadfile->filesize)
+			return 0;
+		if (size > wadfile->filesize - position)
+			size = wadfile->filesize - position;
+		M_Memcpy(dest, wadfile->mapped + position, size);
+		return size;
+	}
+
+	if (fseek(wadfile->handle, (long)position, SEEK_SET) == -1)
+		return 0;
+	return fread(dest, 1, size, wadfile->handle);
+}
+
+/** Gets a lump's on-disk data for decompression.
+  * Points straight into the mapping when there is one, so compressed lumps
+  * don't need a temporary copy of their raw data.
+  * \param wadfile The wad file the lump is in.
+  * \param l The lump.
+  * \return The raw data, or NULL if it couldn't be read in full. Release with
+  *         W_ReleaseRawLump.
+  */
+static const UINT8 *W_GetRawLump(wadfile_t *wadfile, const lumpinfo_t *l)
+{
+	UINT8 *raw;
+
+	if (wadfile->mapped)
+	{
+		if (l->position > wadfile->filesize || l->disksize > wadfile->filesize - l->position)
+			return NULL;
+		return wadfile->mapped + l->position;
+	}
+
+	raw = Z_Malloc(l->disksize, PU_STATIC, NULL);
+	if (W_ReadRaw(wadfile, raw, l->position, l->disksize) < l->disksize)
+	{
+		Z_Free(raw);
+		return NULL;
+	}
+	return raw;
 }
 
-// Invalidates the cache of lump numbers. Call this whenever a wad is added.
-static void W_InvalidateLumpnumCache(void)
+static void W_ReleaseRawLump(wadfile_t *wadfile, const UINT8 *raw)
 {
-	memset(lumpnumcache, 0, sizeof (lumpnumcache));
+	if (!wadfile->mapped)
+		Z_Free((void *)raw);
 }
 
 /** Detect a file type.
@@ -639,6 +807,155 @@ static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp)
 	return lumpinfo;
 }
 
+/** Checks for a pack's identification, leaving the file where it was.
+ */
+static boolean ResIsPack (FILE* handle)
+{
+	char id[sizeof PACKID - 1];
+	boolean ispack = (fread(id, 1, sizeof id, handle) == sizeof id && !memcmp(id, PACKID, sizeof id));
+
+	fseek(handle, 0, SEEK_SET);
+	return ispack;
+}
+
+/** Reads one of a pack's ready-made name indexes, checking that it can't
+  * send a search out of the directory or round in circles.
+  */
+static boolean ResReadPackHash (FILE* handle, lumphash_t* hash, UINT32 numbuckets, UINT16 numlumps)
+{
+	UINT32 i;
+
+	hash->mask = numbuckets - 1;
+	hash->buckets = Z_Malloc(numbuckets * sizeof (*hash->buckets), PU_STATIC, NULL);
+	hash->next = Z_Malloc((numlumps ? numlumps : 1) * sizeof (*hash->next), PU_STATIC, NULL);
+	if (fread(hash->buckets, sizeof (*hash->buckets), numbuckets, handle) < numbuckets
+		|| fread(hash->next, sizeof (*hash->next), numlumps, handle) < numlumps)
+		return false;
+
+	for (i = 0; i < numbuckets; i++)
+	{
+		hash->buckets[i] = SHORT(hash->buckets[i]);
+		if (hash->buckets[i] != LUMPHASHEND && hash->buckets[i] >= numlumps)
+			return false;
+	}
+	for (i = 0; i < numlumps; i++)
+	{
+		hash->next[i] = SHORT(hash->next[i]);
+		if (hash->next[i] != LUMPHASHEND && (hash->next[i] >= numlumps || hash->next[i] <= i))
+			return false;
+	}
+	return true;
+}
+
+/** Create a lumpinfo_t array for a pack made by tools/srb2pak.
+  * The pack also has both name indexes ready, laid out just like
+  * W_BuildLumpHash would make them; they come back in namehash and
+  * fullnamehash, or with NULL buckets if they have to be built after all.
+  */
+static lumpinfo_t* ResGetLumpsPack (FILE* handle, UINT16* nlmp, restype_t* type, lumphash_t* namehash, lumphash_t* fullnamehash)
+{
+	packinfo_t header;
+	packlump_t *fileinfo;
+	char *names;
+	lumpinfo_t *lumpinfo;
+	UINT32 numlumps, numbuckets, namessize, filesize;
+	size_t i;
+
+	fseek(handle, 0, SEEK_END);
+	filesize = (UINT32)ftell(handle);
+	fseek(handle, 0, SEEK_SET);
+
+	if (fread(&header, 1, sizeof header, handle) < sizeof header)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Can't read pack header because %s\n"), strerror(ferror(handle)));
+		return NULL;
+	}
+
+	numlumps = LONG(header.numlumps);
+	numbuckets = LONG(header.numbuckets);
+	namessize = LONG(header.namessize);
+	if (numlumps >= LUMPHASHEND || !namessize
+		|| !numbuckets || numbuckets > 0x20000 || (numbuckets & (numbuckets - 1)))
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Invalid pack header\n"));
+		return NULL;
+	}
+
+	fileinfo = malloc((numlumps ? numlumps : 1) * sizeof (*fileinfo));
+	names = malloc(namessize);
+	if (!fileinfo || !names
+		|| fseek(handle, LONG(header.infotableofs), SEEK_SET) == -1
+		|| fread(fileinfo, sizeof (*fileinfo), numlumps, handle) < numlumps
+		|| fseek(handle, LONG(header.namesofs), SEEK_SET) == -1
+		|| fread(names, 1, namessize, handle) < namessize
+		|| names[namessize - 1] != '\0')
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Corrupt pack directory (%s)\n"), strerror(ferror(handle)));
+		free(fileinfo);
+		free(names);
+		return NULL;
+	}
+
+	lumpinfo = Z_Malloc((numlumps ? numlumps : 1) * sizeof (*lumpinfo), PU_STATIC, NULL);
+	for (i = 0; i < numlumps; i++)
+	{
+		lumpinfo_t *lump_p = &lumpinfo[i];
+		const packlump_t *fl = &fileinfo[i];
+		UINT32 nameofs = LONG(fl->nameofs);
+
+		lump_p->position = LONG(fl->filepos);
+		lump_p->disksize = LONG(fl->disksize);
+		lump_p->size = LONG(fl->size);
+		if (nameofs >= namessize || lump_p->position > filesize
+			|| lump_p->disksize > filesize - lump_p->position)
+			break;
+
+		switch (SHORT(fl->compression))
+		{
+		case PACK_STORED:
+			lump_p->compression = CM_NOCOMPRESSION;
+			break;
+		case PACK_LZF:
+			lump_p->compression = CM_LZF;
+			break;
+		default:
+			CONS_Alert(CONS_WARNING, "%s: Unsupported compression method\n", names + nameofs);
+			lump_p->compression = CM_UNSUPPORTED;
+			break;
+		}
+		if (lump_p->compression == CM_NOCOMPRESSION && lump_p->disksize != lump_p->size)
+			break;
+
+		memset(lump_p->name, '\0', 9);
+		strncpy(lump_p->name, fl->name, 8);
+		lump_p->name2 = Z_StrDup(names + nameofs);
+	}
+	free(fileinfo);
+	free(names);
+
+	if (i < numlumps)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Pack directory is corrupt\n"));
+		while (i--)
+			Z_Free(lumpinfo[i].name2);
+		Z_Free(lumpinfo);
+		return NULL;
+	}
+
+	if (fseek(handle, LONG(header.hashofs), SEEK_SET) == -1
+		|| !ResReadPackHash(handle, namehash, numbuckets, (UINT16)numlumps)
+		|| !ResReadPackHash(handle, fullnamehash, numbuckets, (UINT16)numlumps))
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Pack name index is corrupt, rebuilding it\n"));
+		W_FreeLumpHash(namehash);
+		W_FreeLumpHash(fullnamehash);
+	}
+
+	*type = (LONG(header.flags) & PACK_FOLDERS) ? RET_PK3 : RET_WAD;
+	*nlmp = (UINT16)numlumps;
+	return lumpinfo;
+}
+
 //  Allocate a wadfile, setup the lumpinfo (directory) and
 //  lumpcache, add the wadfile to the current active wadfiles
 //
@@ -650,7 +967,7 @@ static lumpinfo_t* ResGetLumpsZip (FILE* handle, UINT16* nlmp)
 //
 // Can now load dehacked files (.soc)
 //
-UINT16 W_InitFile(const char *filename)
+static UINT16 W_LoadFile(const char *filename)
 {
 	FILE *handle;
 	lumpinfo_t *lumpinfo = NULL;
@@ -661,6 +978,7 @@ UINT16 W_InitFile(const char *filename)
 	size_t packetsize;
 	UINT8 md5sum[16];
 	boolean important;
+	lumphash_t namehash, fullnamehash;
 
 	if (!(refreshdirmenu & REFRESHDIR_ADDFILE))
 		refreshdirmenu = REFRESHDIR_NORMAL|REFRESHDIR_ADDFILE; // clean out cons_alerts that happened earlier
@@ -715,7 +1033,9 @@ UINT16 W_InitFile(const char *filename)
 	// Let's not add a wad file if the MD5 matches
 	// an MD5 of an already added WAD file!
 	//
+	TRACE_BEGIN("wad", "MD5");
 	W_MakeFileMD5(filename, md5sum);
+	TRACE_END();
 
 	for (i = 0; i < numwadfiles; i++)
 	{
@@ -729,6 +1049,9 @@ UINT16 W_InitFile(const char *filename)
 	}
 #endif
 
+	TRACE_BEGIN("wad", "Directory");
+	memset(&namehash, 0, sizeof namehash);
+	memset(&fullnamehash, 0, sizeof fullnamehash);
 	switch(type = ResourceFileDetect(filename))
 	{
 	case RET_SOC:
@@ -743,11 +1066,15 @@ UINT16 W_InitFile(const char *filename)
 		lumpinfo = ResGetLumpsZip(handle, &numlumps);
 		break;
 	case RET_WAD:
-		lumpinfo = ResGetLumpsWad(handle, &numlumps, filename);
+		if (ResIsPack(handle))
+			lumpinfo = ResGetLumpsPack(handle, &numlumps, &type, &namehash, &fullnamehash);
+		else
+			lumpinfo = ResGetLumpsWad(handle, &numlumps, filename);
 		break;
 	default:
 		CONS_Alert(CONS_ERROR, "Unsupported file format\n");
 	}
+	TRACE_END();
 
 	if (lumpinfo == NULL)
 	{
@@ -767,10 +1094,31 @@ UINT16 W_InitFile(const char *filename)
 	fseek(handle, 0, SEEK_END);
 	wadfile->filesize = (unsigned)ftell(handle);
 	wadfile->type = type;
+	W_MapFile(wadfile);
 
 	// already generated, just copy it over
 	M_Memcpy(&wadfile->md5sum, &md5sum, 16);
 
+	//
+	// index the lump names
+	//
+	{
+		clock_t start = clock();
+		TRACE_BEGIN("wad", "Lump hash");
+		if (namehash.buckets) // packs come with theirs
+		{
+			wadfile->namehash = namehash;
+			wadfile->fullnamehash = fullnamehash;
+		}
+		else
+		{
+			W_BuildLumpHash(&wadfile->namehash, lumpinfo, numlumps, false);
+			W_BuildLumpHash(&wadfile->fullnamehash, lumpinfo, numlumps, true);
+		}
+		TRACE_END();
+		lumphashtime += clock() - start;
+	}
+
 	//
 	// set up caching
 	//
@@ -789,6 +1137,7 @@ UINT16 W_InitFile(const char *filename)
 	numwadfiles++; // must come BEFORE W_LoadDehackedLumps, so any addfile called by COM_BufInsertText called by Lua doesn't overwrite what we just loaded
 
 	// TODO: HACK ALERT - Load Lua & SOC stuff right here. I feel like this should be out of this place, but... Let's stick with this for now.
+	TRACE_BEGIN("wad", "Scripts");
 	switch (wadfile->type)
 	{
 	case RET_WAD:
@@ -809,11 +1158,191 @@ UINT16 W_InitFile(const char *filename)
 	default:
 		break;
 	}
+	TRACE_END();
 
-	W_InvalidateLumpnumCache();
 	return wadfile->numlumps;
 }
 
+UINT16 W_InitFile(const char *filename)
+{
+	UINT16 numlumps;
+
+	TRACE_BEGIN("wad", filename);
+	numlumps = W_LoadFile(filename);
+	TRACE_END();
+	return numlumps;
+}
+
+// ==========================================================================
+// PURGED LUMP POOL
+// ==========================================================================
+
+// Cached lumps the zone purges are kept packed with lzf, up to lumppool
+// megabytes, so needing one again costs a decompress instead of a read
+// (and an inflate, in a PK3). The least recently used go first.
+
+static void W_LumpPool_OnChange(void);
+
+static CV_PossibleValue_t lumppool_cons_t[] = {{0, "MIN"}, {1024, "MAX"}, {0, NULL}};
+consvar_t cv_lumppool = {"lumppool", "32", CV_SAVE|CV_CALL, lumppool_cons_t, W_LumpPool_OnChange, 0, NULL, NULL, 0, 0, NULL};
+
+typedef struct pooledlump_s
+{
+	UINT16 wad, lump;
+	size_t size, packedsize;
+	struct pooledlump_s *next; // next in the same hash bucket
+	struct pooledlump_s *older, *newer;
+	UINT8 data[1];
+} pooledlump_t;
+
+#define POOLHASHSIZE 1024 // Must be a power of two
+#define POOLMINSIZE 256 // smaller lumps aren't worth the trouble
+
+static pooledlump_t *poolhash[POOLHASHSIZE];
+static pooledlump_t *oldestpooled = NULL, *newestpooled = NULL;
+static size_t pooledbytes = 0;
+
+#define PoolBucket(wad, lump) (&poolhash[((wad)*31 + (lump)) & (POOLHASHSIZE-1)])
+
+static pooledlump_t *W_FindPooledLump(UINT16 wad, UINT16 lump)
+{
+	pooledlump_t *pl;
+
+	for (pl = *PoolBucket(wad, lump); pl; pl = pl->next)
+		if (pl->wad == wad && pl->lump == lump)
+			return pl;
+	return NULL;
+}
+
+static void W_LinkNewestPooled(pooledlump_t *pl)
+{
+	pl->older = newestpooled;
+	pl->newer = NULL;
+	if (newestpooled)
+		newestpooled->newer = pl;
+	else
+		oldestpooled = pl;
+	newestpooled = pl;
+}
+
+static void W_UnlinkPooled(pooledlump_t *pl)
+{
+	if (pl->older)
+		pl->older->newer = pl->newer;
+	else
+		oldestpooled = pl->newer;
+	if (pl->newer)
+		pl->newer->older = pl->older;
+	else
+		newestpooled = pl->older;
+}
+
+static void W_FreePooledLump(pooledlump_t *pl)
+{
+	pooledlump_t **link = PoolBucket(pl->wad, pl->lump);
+
+	while (*link != pl)
+		link = &(*link)->next;
+	*link = pl->next;
+	W_UnlinkPooled(pl);
+	pooledbytes -= sizeof *pl + pl->packedsize;
+	free(pl);
+}
+
+// Drops the oldest lumps until size more bytes fit.
+static void W_TrimLumpPool(size_t size)
+{
+	const size_t budget = (size_t)cv_lumppool.value << 20;
+
+	while (oldestpooled && pooledbytes + size > budget)
+		W_FreePooledLump(oldestpooled);
+}
+
+static void W_LumpPool_OnChange(void)
+{
+	W_TrimLumpPool(0);
+}
+
+// The purge hook: packs ptr away if it's some wad's cached lump.
+static void W_PoolPurgedLump(void *ptr, void **user, size_t size)
+{
+	const size_t budget = (size_t)cv_lumppool.value << 20;
+	lumpcache_t *lumpcache = NULL;
+	pooledlump_t *pl;
+	size_t packedsize;
+	UINT16 wad, lump;
+
+	if (size < POOLMINSIZE || size/2 > budget || !user || *user != ptr)
+		return;
+
+	for (wad = 0; wad < numwadfiles; wad++)
+	{
+		lumpcache = wadfiles[wad]->lumpcache;
+		if ((lumpcache_t *)user >= lumpcache && (lumpcache_t *)user < lumpcache + wadfiles[wad]->numlumps)
+			break;
+	}
+	if (wad == numwadfiles)
+		return;
+	lump = (UINT16)((lumpcache_t *)user - lumpcache);
+
+	if (W_FindPooledLump(wad, lump) || size != W_LumpLengthPwad(wad, lump))
+		return;
+
+	// Only worth keeping if it packs to 7/8 or less
+	pl = malloc(sizeof *pl + size - size/8);
+	if (!pl)
+		return;
+	packedsize = lzf_compress(ptr, size, pl->data, size - size/8);
+	if (!packedsize)
+	{
+		free(pl);
+		return;
+	}
+	pl = realloc(pl, sizeof *pl + packedsize); // only ever shrinks
+
+	W_TrimLumpPool(sizeof *pl + packedsize);
+	pl->wad = wad;
+	pl->lump = lump;
+	pl->size = size;
+	pl->packedsize = packedsize;
+	pl->next = *PoolBucket(wad, lump);
+	*PoolBucket(wad, lump) = pl;
+	W_LinkNewestPooled(pl);
+	pooledbytes += sizeof *pl + packedsize;
+}
+
+// Fills dest with the lump if the pool has it.
+static boolean W_UnpackPooledLump(UINT16 wad, UINT16 lump, void *dest, size_t size)
+{
+	pooledlump_t *pl = W_FindPooledLump(wad, lump);
+
+	if (!pl)
+		return false;
+	if (pl->size != size || lzf_decompress(pl->data, pl->packedsize, dest, size) != size)
+	{
+		W_FreePooledLump(pl);
+		return false;
+	}
+	W_UnlinkPooled(pl);
+	W_LinkNewestPooled(pl);
+	return true;
+}
+
+#ifdef DELFILE
+// Forgets the lumps of wads num and up.
+static void W_DropPooledLumps(UINT16 num)
+{
+	pooledlump_t *pl, *older;
+
+	for (pl = newestpooled; pl; pl = older)
+	{
+		older = pl->older;
+		if (pl->wad >= num)
+			W_FreePooledLump(pl);
+	}
+}
+#endif
+
 #ifdef DELFILE
 void W_UnloadWadFile(UINT16 num)
 {
@@ -839,6 +1368,11 @@ void W_UnloadWadFile(UINT16 num)
 			Z_ChangeTag(lumpcache[i], PU_PURGELEVEL);
 	}
 	Z_Free(lumpcache);
+	W_FreeLumpHash(&delwad->namehash);
+	W_FreeLumpHash(&delwad->fullnamehash);
+	W_FlushPrefetchedLumps();
+	W_DropPooledLumps(num);
+	W_UnmapFile(delwad);
 	fclose(delwad->handle);
 	Z_Free(delwad->filename);
 	Z_Free(delwad);
@@ -860,9 +1394,20 @@ void W_UnloadWadFile(UINT16 num)
 INT32 W_InitMultipleFiles(char **filenames)
 {
 	INT32 rc = 1;
+	clock_t start = clock();
+	UINT32 totallumps = 0;
+	UINT16 i;
+	size_t count;
 
 	// open all the files, load headers, and count lumps
 	numwadfiles = 0;
+	lumphashtime = 0;
+	Z_SetPurgeHook(W_PoolPurgedLump);
+
+	// hash them all at once first, the slow part of opening each one
+	for (count = 0; filenames[count]; count++)
+		;
+	W_PrepareFileMD5s((const char **)filenames, count);
 
 	// will be realloced as lumps are added
 	for (; *filenames; filenames++)
@@ -874,6 +1419,13 @@ INT32 W_InitMultipleFiles(char **filenames)
 	if (!numwadfiles)
 		I_Error("W_InitMultipleFiles: no files found");
 
+	for (i = 0; i < numwadfiles; i++)
+		totallumps += wadfiles[i]->numlumps;
+	CONS_Printf(M_GetText("Loaded %u lumps from %u files in %ld ms (%ld ms indexing)\n"),
+		totallumps, numwadfiles,
+		(long)((clock() - start) * 1000 / CLOCKS_PER_SEC),
+		(long)(lumphashtime * 1000 / CLOCKS_PER_SEC));
+
 	return rc;
 }
 
@@ -918,6 +1470,7 @@ UINT16 W_CheckNumForNamePwad(const char *name, UINT16 wad, UINT16 startlump)
 {
 	UINT16 i;
 	static char uname[9];
+	lumphash_t *hash;
 
 	memset(uname, 0x00, sizeof uname);
 	strncpy(uname, name, 8);
@@ -928,18 +1481,15 @@ UINT16 W_CheckNumForNamePwad(const char *name, UINT16 wad, UINT16 startlump)
 		return INT16_MAX;
 
 	//
-	// scan forward
+	// walk the hash chain forward
 	// start at 'startlump', useful parameter when there are multiple
 	//                       resources with the same name
 	//
-	if (startlump < wadfiles[wad]->numlumps)
+	hash = &wadfiles[wad]->namehash;
+	for (i = hash->buckets[W_HashLumpName(uname, 8) & hash->mask]; i != LUMPHASHEND; i = hash->next[i])
 	{
-		lumpinfo_t *lump_p = wadfiles[wad]->lumpinfo + startlump;
-		for (i = startlump; i < wadfiles[wad]->numlumps; i++, lump_p++)
-		{
-			if (memcmp(lump_p->name,uname,8) == 0)
-				return i;
-		}
+		if (i >= startlump && memcmp(wadfiles[wad]->lumpinfo[i].name,uname,8) == 0)
+			return i;
 	}
 
 	// not found.
@@ -978,14 +1528,12 @@ UINT16 W_CheckNumForFolderEndPK3(const char *name, UINT16 wad, UINT16 startlump)
 // Returns lump position in PK3's lumpinfo, or INT16_MAX if not found.
 UINT16 W_CheckNumForFullNamePK3(const char *name, UINT16 wad, UINT16 startlump)
 {
-	INT32 i;
-	lumpinfo_t *lump_p = wadfiles[wad]->lumpinfo + startlump;
-	for (i = startlump; i < wadfiles[wad]->numlumps; i++, lump_p++)
+	UINT16 i;
+	lumphash_t *hash = &wadfiles[wad]->fullnamehash;
+	for (i = hash->buckets[W_HashLumpName(name, (size_t)-1) & hash->mask]; i != LUMPHASHEND; i = hash->next[i])
 	{
-		if (!strnicmp(name, lump_p->name2, strlen(name)))
-		{
+		if (i >= startlump && !stricmp(name, wadfiles[wad]->lumpinfo[i].name2))
 			return i;
-		}
 	}
 	// Not found at all?
 	return INT16_MAX;
@@ -1000,17 +1548,6 @@ lumpnum_t W_CheckNumForName(const char *name)
 	INT32 i;
 	lumpnum_t check = INT16_MAX;
 
-	// Check the lumpnumcache first. Loop backwards so that we check
-	// most recent entries first
-	for (i = lumpnumcacheindex + LUMPNUMCACHESIZE; i > lumpnumcacheindex; i--)
-	{
-		if (strncmp(lumpnumcache[i & (LUMPNUMCACHESIZE - 1)].lumpname, name, 8) == 0)
-		{
-			lumpnumcacheindex = i & (LUMPNUMCACHESIZE - 1);
-			return lumpnumcache[lumpnumcacheindex].lumpnum;
-		}
-	}
-
 	// scan wad files backwards so patch lump files take precedence
 	for (i = numwadfiles - 1; i >= 0; i--)
 	{
@@ -1020,43 +1557,35 @@ lumpnum_t W_CheckNumForName(const char *name)
 	}
 
 	if (check == INT16_MAX) return LUMPERROR;
-	else
-	{
-		// Update the cache.
-		lumpnumcacheindex = (lumpnumcacheindex + 1) & (LUMPNUMCACHESIZE - 1);
-		strncpy(lumpnumcache[lumpnumcacheindex].lumpname, name, 8);
-		lumpnumcache[lumpnumcacheindex].lumpnum = (i<<16)+check;
-
-		return lumpnumcache[lumpnumcacheindex].lumpnum;
-	}
+	return (i<<16)+check;
 }
 
 // Look for valid map data through all added files in descendant order.
 // Get a map marker for WADs, and a standalone WAD file lump inside PK3s.
-// TODO: Make it search through cache first, maybe...?
 lumpnum_t W_CheckNumForMap(const char *name)
 {
-	UINT16 lumpNum, end;
-	UINT32 i;
+	UINT16 lumpNum;
+	UINT32 i, bucket = W_HashLumpName(name, 8);
 	for (i = numwadfiles - 1; i < numwadfiles; i--)
 	{
-		if (wadfiles[i]->type == RET_WAD)
+		lumphash_t *hash = &wadfiles[i]->namehash;
+		for (lumpNum = hash->buckets[bucket & hash->mask]; lumpNum != LUMPHASHEND; lumpNum = hash->next[lumpNum])
 		{
-			for (lumpNum = 0; lumpNum < wadfiles[i]->numlumps; lumpNum++)
-				if (!strncmp(name, (wadfiles[i]->lumpinfo + lumpNum)->name, 8))
+			lumpinfo_t *lump_p = wadfiles[i]->lumpinfo + lumpNum;
+			if (wadfiles[i]->type == RET_WAD)
+			{
+				if (!strncmp(name, lump_p->name, 8))
 					return (i<<16) + lumpNum;
-		}
-		else if (wadfiles[i]->type == RET_PK3)
-		{
-			lumpNum = W_CheckNumForFolderStartPK3("maps/", i, 0);
-			if (lumpNum != INT16_MAX)
-				end = W_CheckNumForFolderEndPK3("maps/", i, lumpNum);
-			else
-				continue;
-			// Now look for the specified map.
-			for (++lumpNum; lumpNum < end; lumpNum++)
-				if (!strnicmp(name, (wadfiles[i]->lumpinfo + lumpNum)->name, 8))
+			}
+			else if (wadfiles[i]->type == RET_PK3)
+			{
+				// Only standalone map WADs in the maps/ folder count.
+				if (!strnicmp(name, lump_p->name, 8) && !strnicmp("maps/", lump_p->name2, 5)
+				&& !W_IsLumpFolder((UINT16)i, lumpNum))
 					return (i<<16) + lumpNum;
+			}
+			else
+				break;
 		}
 	}
 	return LUMPERROR;
@@ -1113,12 +1642,14 @@ lumpnum_t W_CheckNumForNameInBlock(const char *name, const char *blockstart, con
 #include "fastcmp.h"
 UINT8 W_LumpExists(const char *name)
 {
-	INT32 i,j;
+	INT32 i;
+	UINT16 j;
+	UINT32 bucket = W_HashLumpName(name, 8);
 	for (i = numwadfiles - 1; i >= 0; i--)
 	{
-		lumpinfo_t *lump_p = wadfiles[i]->lumpinfo;
-		for (j = 0; j < wadfiles[i]->numlumps; ++j, ++lump_p)
-			if (fastcmp(lump_p->name,name))
+		lumphash_t *hash = &wadfiles[i]->namehash;
+		for (j = hash->buckets[bucket & hash->mask]; j != LUMPHASHEND; j = hash->next[j])
+			if (fastcmp(wadfiles[i]->lumpinfo[j].name,name))
 				return true;
 	}
 	return false;
@@ -1202,6 +1733,304 @@ void zerr(int ret)
 }
 #endif
 
+// ==========================================================================
+// LUMP PREFETCHING
+// ==========================================================================
+
+#if defined (HAVE_ZLIB) && defined (HAVE_THREADS)
+#define PREFETCH
+
+// A deflated lump being, or already, inflated by a worker thread.
+typedef enum
+{
+	PF_QUEUED,
+	PF_WORKING,
+	PF_DONE,
+	PF_FAILED,
+	PF_CANCELLED, // nobody wants it anymore, the worker frees it
+} prefetchstate_t;
+
+typedef struct prefetch_s
+{
+	UINT16 wad, lump;
+	prefetchstate_t state;
+	const UINT8 *raw; // deflated data, inside the wad's mapping
+	size_t rawsize, size;
+	UINT8 *data; // inflated data, malloc'd by the worker
+	struct prefetch_s *next; // next in the same hash bucket
+	struct prefetch_s *qnext; // next in the work queue
+} prefetch_t;
+
+#define PREFETCHHASHSIZE 256 // Must be a power of two
+#define PREFETCHMAXBYTES (32<<20) // don't sit on more inflated data than this
+#define PREFETCHMAXWORKERS 4
+
+static prefetch_t *prefetchhash[PREFETCHHASHSIZE];
+static prefetch_t *prefetchqueue = NULL, *prefetchqueuetail = NULL;
+static size_t prefetchbytes = 0;
+static INT32 prefetchworkers = 0, prefetchbusy = 0;
+static boolean prefetchstop = false;
+
+static I_mutex prefetch_mutex;
+static I_cond prefetch_workcond; // workers wait here for jobs
+static I_cond prefetch_donecond; // the main thread waits here for results
+
+#define PrefetchBucket(wad, lump) (&prefetchhash[((wad)*31 + (lump)) & (PREFETCHHASHSIZE-1)])
+
+/** Inflates raw deflate data into a new malloc'd buffer.
+  * Safe to call from any thread, as it doesn't touch the zone.
+  * \return The data, or NULL on error.
+  */
+static UINT8 *W_InflateToMalloc(const UINT8 *raw, size_t rawsize, size_t size)
+{
+	UINT8 *out = malloc(size ? size : 1);
+	z_stream strm;
+	int zErr;
+
+	if (!out)
+		return NULL;
+
+	memset(&strm, 0, sizeof strm);
+	strm.next_in = (Bytef *)raw;
+	strm.avail_in = (uInt)rawsize;
+	strm.next_out = out;
+	strm.avail_out = (uInt)size;
+
+	if (inflateInit2(&strm, -15) != Z_OK)
+	{
+		free(out);
+		return NULL;
+	}
+	zErr = inflate(&strm, Z_FINISH);
+	(void)inflateEnd(&strm);
+
+	if (zErr != Z_STREAM_END)
+	{
+		free(out);
+		return NULL;
+	}
+	return out;
+}
+
+static void W_PrefetchWorker(void *userdata)
+{
+	prefetch_t *job;
+	UINT8 *data;
+	(void)userdata;
+
+	I_lock_mutex(&prefetch_mutex);
+	for (;;)
+	{
+		while (!prefetchqueue && !prefetchstop)
+			I_hold_cond(&prefetch_workcond, prefetch_mutex);
+		if (prefetchstop)
+			break;
+
+		job = prefetchqueue;
+		if (!(prefetchqueue = job->qnext))
+			prefetchqueuetail = NULL;
+
+		if (job->state == PF_CANCELLED)
+		{
+			free(job);
+			continue;
+		}
+
+		job->state = PF_WORKING;
+		prefetchbusy++;
+		I_unlock_mutex(prefetch_mutex);
+
+		data = W_InflateToMalloc(job->raw, job->rawsize, job->size);
+
+		I_lock_mutex(&prefetch_mutex);
+		prefetchbusy--;
+		if (job->state == PF_CANCELLED)
+		{
+			free(data);
+			free(job);
+		}
+		else
+		{
+			job->data = data;
+			job->state = data ? PF_DONE : PF_FAILED;
+		}
+		I_wake_all_cond(&prefetch_donecond);
+	}
+	prefetchworkers--;
+	I_unlock_mutex(prefetch_mutex);
+}
+
+static void W_StopPrefetch(void)
+{
+	I_lock_mutex(&prefetch_mutex);
+	prefetchstop = true;
+	I_wake_all_cond(&prefetch_workcond);
+	I_unlock_mutex(prefetch_mutex);
+}
+
+/** Unlinks a job from its hash bucket. The mutex must be held.
+  */
+static void W_UnhashPrefetch(prefetch_t *job)
+{
+	prefetch_t **link = PrefetchBucket(job->wad, job->lump);
+	while (*link != job)
+		link = &(*link)->next;
+	*link = job->next;
+	prefetchbytes -= job->size;
+}
+
+/** Picks up a lump inflated ahead of time, if there is one.
+  * Waits for it if a worker is busy with it right now. If it's still
+  * queued, the job is cancelled and the caller inflates the lump itself.
+  * \return true if dest was filled in.
+  */
+static boolean W_TakePrefetchedLump(UINT16 wad, UINT16 lump, void *dest, size_t size, size_t offset)
+{
+	prefetch_t *job;
+	boolean ok = false;
+
+	if (!prefetchworkers)
+		return false;
+
+	I_lock_mutex(&prefetch_mutex);
+	for (job = *PrefetchBucket(wad, lump); job; job = job->next)
+		if (job->wad == wad && job->lump == lump)
+			break;
+
+	if (job)
+	{
+		while (job->state == PF_WORKING)
+			I_hold_cond(&prefetch_donecond, prefetch_mutex);
+
+		W_UnhashPrefetch(job);
+		if (job->state == PF_QUEUED)
+			job->state = PF_CANCELLED;
+		else
+		{
+			if (job->state == PF_DONE)
+			{
+				M_Memcpy(dest, job->data + offset, size);
+				ok = true;
+			}
+			free(job->data);
+			free(job);
+		}
+	}
+	I_unlock_mutex(prefetch_mutex);
+
+	return ok;
+}
+#endif // HAVE_ZLIB && HAVE_THREADS
+
+/** Asks the worker threads to inflate a lump ahead of time, so that a later
+  * W_ReadLumpHeaderPwad only has to copy the result.
+  * Only deflated lumps from memory-mapped PK3s that aren't cached already
+  * are worth it; anything else is ignored, as is every call in builds
+  * without threads.
+  * \param lumpnum The lump that is going to be needed soon.
+  * \sa W_FlushPrefetchedLumps
+  */
+void W_PrefetchLump(lumpnum_t lumpnum)
+{
+#ifdef PREFETCH
+	UINT16 wad = WADFILENUM(lumpnum), lump = LUMPNUM(lumpnum);
+	wadfile_t *wadfile;
+	lumpinfo_t *l;
+	prefetch_t *job, **bucket;
+
+	if (lumpnum == LUMPERROR || wad >= numwadfiles || !(wadfile = wadfiles[wad]) || lump >= wadfile->numlumps)
+		return;
+
+	l = wadfile->lumpinfo + lump;
+	if (l->compression != CM_DEFLATE || !wadfile->mapped || wadfile->lumpcache[lump]
+	|| l->position > wadfile->filesize || l->disksize > wadfile->filesize - l->position)
+		return;
+
+	if (!prefetchworkers)
+	{
+		INT32 i, n = I_num_cpus() - 1;
+		if (n > PREFETCHMAXWORKERS)
+			n = PREFETCHMAXWORKERS;
+		else if (n < 1)
+			n = 1;
+		if (M_CheckParm("-noprefetch"))
+			return;
+		prefetchworkers = n;
+		for (i = 0; i < n; i++)
+			I_spawn_thread("lump-prefetch", W_PrefetchWorker, NULL);
+		I_AddExitFunc(W_StopPrefetch);
+	}
+
+	I_lock_mutex(&prefetch_mutex);
+	bucket = PrefetchBucket(wad, lump);
+	for (job = *bucket; job; job = job->next)
+		if (job->wad == wad && job->lump == lump)
+			break;
+
+	if (!job && prefetchbytes + l->size <= PREFETCHMAXBYTES && (job = malloc(sizeof *job)) != NULL)
+	{
+		job->wad = wad;
+		job->lump = lump;
+		job->state = PF_QUEUED;
+		job->raw = wadfile->mapped + l->position;
+		job->rawsize = l->disksize;
+		job->size = l->size;
+		job->data = NULL;
+		job->next = *bucket;
+		*bucket = job;
+		prefetchbytes += job->size;
+
+		job->qnext = NULL;
+		if (prefetchqueuetail)
+			prefetchqueuetail->qnext = job;
+		else
+			prefetchqueue = job;
+		prefetchqueuetail = job;
+		I_wake_one_cond(&prefetch_workcond);
+	}
+	I_unlock_mutex(prefetch_mutex);
+#else
+	(void)lumpnum;
+#endif
+}
+
+/** Drops every prefetched lump that nobody picked up, and waits for the
+  * workers to be idle.
+  */
+void W_FlushPrefetchedLumps(void)
+{
+#ifdef PREFETCH
+	size_t i;
+	prefetch_t *job, *next;
+
+	if (!prefetchworkers)
+		return;
+
+	I_lock_mutex(&prefetch_mutex);
+	for (i = 0; i < PREFETCHHASHSIZE; i++)
+	{
+		for (job = prefetchhash[i]; job; job = next)
+		{
+			next = job->next;
+			if (job->state == PF_QUEUED || job->state == PF_WORKING)
+				job->state = PF_CANCELLED; // the worker will free it
+			else
+			{
+				free(job->data);
+				free(job);
+			}
+		}
+		prefetchhash[i] = NULL;
+	}
+	prefetchbytes = 0;
+
+	// Nothing may still be reading from a mapping once this returns.
+	while (prefetchbusy)
+		I_hold_cond(&prefetch_donecond, prefetch_mutex);
+	I_unlock_mutex(prefetch_mutex);
+#endif
+}
+
 #define NO_PNG_LUMPS
 
 #ifdef NO_PNG_LUMPS
@@ -1234,7 +2063,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 {
 	size_t lumpsize;
 	lumpinfo_t *l;
-	FILE *handle;
+	wadfile_t *wadfile;
 
 	if (!TestValidLump(wad,lump))
 		return 0;
@@ -1249,36 +2078,34 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 		size = lumpsize - offset;
 
 	// Let's get the raw lump data.
-	// We setup the desired file handle to read the lump data.
-	l = wadfiles[wad]->lumpinfo + lump;
-	handle = wadfiles[wad]->handle;
-	fseek(handle, (long)(l->position + offset), SEEK_SET);
+	// It comes out of the file's mapping if it has one, or its handle otherwise.
+	wadfile = wadfiles[wad];
+	l = wadfile->lumpinfo + lump;
 
 	// But let's not copy it yet. We support different compression formats on lumps, so we need to take that into account.
-	switch(wadfiles[wad]->lumpinfo[lump].compression)
+	switch(l->compression)
 	{
 	case CM_NOCOMPRESSION:		// If it's uncompressed, we directly write the data into our destination, and return the bytes read.
 #ifdef NO_PNG_LUMPS
 		{
-			size_t bytesread = fread(dest, 1, size, handle);
-			ErrorIfPNG(dest, bytesread, wadfiles[wad]->filename, l->name2);
+			size_t bytesread = W_ReadRaw(wadfile, dest, l->position + offset, size);
+			ErrorIfPNG(dest, bytesread, wadfile->filename, l->name2);
 			return bytesread;
 		}
 #else
-		return fread(dest, 1, size, handle);
+		return W_ReadRaw(wadfile, dest, l->position + offset, size);
 #endif
 	case CM_LZF:		// Is it LZF compressed? Used by ZWADs.
 		{
 #ifdef ZWAD
-			char *rawData; // The lump's raw data.
+			const UINT8 *rawData; // The lump's raw data.
 			char *decData; // Lump's decompressed real data.
 			size_t retval; // Helper var, lzf_decompress returns 0 when an error occurs.
 
-			rawData = Z_Malloc(l->disksize, PU_STATIC, NULL);
+			if ((rawData = W_GetRawLump(wadfile, l)) == NULL)
+				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
 			decData = Z_Malloc(l->size, PU_STATIC, NULL);
 
-			if (fread(rawData, 1, l->disksize, handle) < l->disksize)
-				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
 			retval = lzf_decompress(rawData, l->disksize, decData, l->size);
 #ifndef AVOID_ERRNO
 			if (retval == 0) // If this was returned, check if errno was set
@@ -1299,7 +2126,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			if (!decData) // Did we get no data at all?
 				return 0;
 			M_Memcpy(dest, decData + offset, size);
-			Z_Free(rawData);
+			W_ReleaseRawLump(wadfile, rawData);
 			Z_Free(decData);
 #ifdef NO_PNG_LUMPS
 			ErrorIfPNG(dest, size, wadfiles[wad]->filename, l->name2);
@@ -1314,7 +2141,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 #ifdef HAVE_ZLIB
 	case CM_DEFLATE: // Is it compressed via DEFLATE? Very common in ZIPs/PK3s, also what most doom-related editors support.
 		{
-			UINT8 *rawData; // The lump's raw data.
+			const UINT8 *rawData; // The lump's raw data.
 			UINT8 *decData; // Lump's decompressed real data.
 
 			int zErr; // Helper var.
@@ -1322,11 +2149,19 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			unsigned long rawSize = l->disksize;
 			unsigned long decSize = l->size;
 
-			rawData = Z_Malloc(rawSize, PU_STATIC, NULL);
-			decData = Z_Malloc(decSize, PU_STATIC, NULL);
+#ifdef PREFETCH
+			if (W_TakePrefetchedLump(wad, lump, dest, size, offset))
+			{
+#ifdef NO_PNG_LUMPS
+				ErrorIfPNG(dest, size, wadfile->filename, l->name2);
+#endif
+				return size;
+			}
+#endif
 
-			if (fread(rawData, 1, rawSize, handle) < rawSize)
+			if ((rawData = W_GetRawLump(wadfile, l)) == NULL)
 				I_Error("wad %d, lump %d: cannot read compressed data", wad, lump);
+			decData = Z_Malloc(decSize, PU_STATIC, NULL);
 
 			strm.zalloc = Z_NULL;
 			strm.zfree = Z_NULL;
@@ -1335,7 +2170,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 			strm.total_in = strm.avail_in = rawSize;
 			strm.total_out = strm.avail_out = decSize;
 
-			strm.next_in = rawData;
+			strm.next_in = (Bytef *)rawData;
 			strm.next_out = decData;
 
 			zErr = inflateInit2(&strm, -15);
@@ -1344,7 +2179,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 				zErr = inflate(&strm, Z_FINISH);
 				if (zErr == Z_STREAM_END)
 				{
-					M_Memcpy(dest, decData, size);
+					M_Memcpy(dest, decData + offset, size);
 				}
 				else
 				{
@@ -1361,7 +2196,7 @@ size_t W_ReadLumpHeaderPwad(UINT16 wad, UINT16 lump, void *dest, size_t size, si
 				zerr(zErr);
 			}
 
-			Z_Free(rawData);
+			W_ReleaseRawLump(wadfile, rawData);
 			Z_Free(decData);
 
 #ifdef NO_PNG_LUMPS
@@ -1411,8 +2246,16 @@ void *W_CacheLumpNumPwad(UINT16 wad, UINT16 lump, INT32 tag)
 	lumpcache = wadfiles[wad]->lumpcache;
 	if (!lumpcache[lump])
 	{
-		void *ptr = Z_Malloc(W_LumpLengthPwad(wad, lump), tag, &lumpcache[lump]);
-		W_ReadLumpHeaderPwad(wad, lump, ptr, 0, 0);  // read the lump in full
+		const size_t size = W_LumpLengthPwad(wad, lump);
+		void *ptr;
+
+		// Only what stays cached; the rest is freed by whoever read it
+		if (W_LumpMissHook && tag >= PU_HWRCACHE)
+			W_LumpMissHook((wad<<16) + lump, LUMPMISS_LUMP);
+
+		ptr = Z_Malloc(size, tag, &lumpcache[lump]);
+		if (!W_UnpackPooledLump(wad, lump, ptr, size))
+			W_ReadLumpHeaderPwad(wad, lump, ptr, 0, 0);  // read the lump in full
 	}
 	else
 		Z_ChangeTag(lumpcache[lump], tag);
@@ -1527,6 +2370,9 @@ static inline void *W_CachePatchNumPwad(UINT16 wad, UINT16 lump, INT32 tag)
 	{
 		patch_t *ptr = NULL;
 
+		if (W_LumpMissHook)
+			W_LumpMissHook((wad<<16) + lump, LUMPMISS_PATCH);
+
 		// Only load the patch if we haven't initialised the grPatch yet
 		if (grPatch->mipmap.width == 0)
 			ptr = W_CacheLumpNumPwad(grPatch->wadnum, grPatch->lumpnum, PU_STATIC);
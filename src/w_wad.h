@@ -18,6 +18,8 @@
 #include "hardware/hw_data.h"
 #endif
 
+#include "command.h"
+
 #ifdef __GNUG__
 #pragma interface
 #endif
@@ -50,6 +52,38 @@ typedef struct
 	UINT32 infotableofs; // the 'directory' of resources
 } wadinfo_t;
 
+// header of a pack made by tools/srb2pak, everything little endian
+#define PACKID "SRB2PAK1"
+#define PACK_FOLDERS 1 // made from a pk3, loads like one
+
+typedef struct
+{
+	char identification[8]; // PACKID
+	UINT32 flags; // PACK_ flags
+	UINT32 numlumps; // how many resources
+	UINT32 infotableofs; // packlump_t[numlumps]
+	UINT32 namesofs, namessize; // full names, each NUL terminated
+	UINT32 hashofs; // both name indexes, see ResGetLumpsPack
+	UINT32 numbuckets; // in each index, a power of 2
+	UINT8 md5sum[16]; // of everything after the header
+	UINT8 reserved[12];
+} packinfo_t;
+
+// Lumps in a pack are either stored or packed with lzf
+#define PACK_STORED 0
+#define PACK_LZF 1
+
+typedef struct
+{
+	UINT32 filepos; // file offset of the resource, page aligned if it's big
+	UINT32 disksize; // size in the file
+	UINT32 size; // real (uncompressed) size
+	UINT32 nameofs; // full name, in the names block
+	UINT16 compression; // PACK_STORED or PACK_LZF
+	UINT16 reserved;
+	char name[8]; // name of the resource
+} packlump_t;
+
 // Available compression methods for lumps.
 typedef enum
 {
@@ -97,17 +131,33 @@ typedef enum restype
 } restype_t;
 
 
+// Hash index over a wad's lump names, built once by W_InitFile.
+// Every bucket is a chain of lump numbers in ascending order, so searches
+// that start from a given lump can stop early.
+typedef struct
+{
+	UINT16 *buckets; // first lump of each chain, LUMPHASHEND if empty
+	UINT16 *next; // next lump in the same chain, indexed by lump number
+	UINT32 mask; // number of buckets - 1
+} lumphash_t;
+
+#define LUMPHASHEND UINT16_MAX
+
 typedef struct wadfile_s
 {
 	char *filename;
 	restype_t type;
 	lumpinfo_t *lumpinfo;
 	lumpcache_t *lumpcache;
+	lumphash_t namehash; // lumpinfo[].name, case insensitive
+	lumphash_t fullnamehash; // lumpinfo[].name2, case insensitive
 #ifdef HWRENDER
 	aatree_t *hwrcache; // patches are cached in renderer's native format
 #endif
 	UINT16 numlumps; // this wad's number of resources
 	FILE *handle;
+	UINT8 *mapped; // read-only view of the whole file, NULL if reads go through handle
+	void *maphandle; // file mapping object backing the view (win32 only)
 	UINT32 filesize; // for network
 	UINT8 md5sum[16];
 	boolean important;
@@ -139,6 +189,7 @@ const char *W_CheckNameForNumPwad(UINT16 wad, UINT16 lump);
 const char *W_CheckNameForNum(lumpnum_t lumpnum);
 
 UINT16 W_CheckNumForNamePwad(const char *name, UINT16 wad, UINT16 startlump); // checks only in one pwad
+UINT32 W_HashLumpName(const char *name, size_t len); // case insensitive, at most len characters
 
 UINT16 W_CheckNumForFullNamePK3(const char *name, UINT16 wad, UINT16 startlump);
 UINT16 W_CheckNumForFolderStartPK3(const char *name, UINT16 wad, UINT16 startlump);
@@ -165,6 +216,21 @@ size_t W_ReadLumpHeader(lumpnum_t lump, void *dest, size_t size, size_t offest);
 void W_ReadLumpPwad(UINT16 wad, UINT16 lump, void *dest);
 void W_ReadLump(lumpnum_t lump, void *dest);
 
+void W_PrefetchLump(lumpnum_t lumpnum); // inflate ahead of time on worker threads, when possible
+
+typedef enum
+{
+	LUMPMISS_LUMP,  // a lump W_CacheLumpNum had to read in
+	LUMPMISS_PATCH, // a patch OpenGL had to convert
+	LUMPMISS_SOUND  // a sound's lump, the first time it was played
+} lumpmiss_t;
+
+// Told about every lump that's read because it wasn't cached yet, if set
+extern void (*W_LumpMissHook)(lumpnum_t lumpnum, lumpmiss_t how);
+void W_FlushPrefetchedLumps(void);
+
+extern consvar_t cv_lumppool; // megabytes of packed purged lumps
+
 void *W_CacheLumpNumPwad(UINT16 wad, UINT16 lump, INT32 tag);
 void *W_CacheLumpNum(lumpnum_t lump, INT32 tag);
 void *W_CacheLumpNumForce(lumpnum_t lumpnum, INT32 tag);
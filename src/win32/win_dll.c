@@ -105,6 +105,8 @@ static loadfunc_t hwdFuncTable[] = {
 	{"SetBlend@4",          &hwdriver.pfnSetBlend},
 	{"ClearBuffer@12",      &hwdriver.pfnClearBuffer},
 	{"SetTexture@4",        &hwdriver.pfnSetTexture},
+	{"UpdateTexture@4",     &hwdriver.pfnUpdateTexture},
+	{"SetColormap@4",       &hwdriver.pfnSetColormap},
 	{"ReadRect@24",         &hwdriver.pfnReadRect},
 	{"GClipRect@20",        &hwdriver.pfnGClipRect},
 	{"ClearMipMapCache@0",  &hwdriver.pfnClearMipMapCache},
@@ -112,7 +114,12 @@ static loadfunc_t hwdFuncTable[] = {
 	{"DrawMD2@16",          &hwdriver.pfnDrawMD2},
 	{"DrawMD2i@36",         &hwdriver.pfnDrawMD2i},
 	{"SetTransform@4",      &hwdriver.pfnSetTransform},
+	{"SetBlendedTexture@12",&hwdriver.pfnSetBlendedTexture},
 	{"GetTextureUsed@0",    &hwdriver.pfnGetTextureUsed},
+	{"GetTextureStats@8",   &hwdriver.pfnGetTextureStats},
+	{"MarkRenderSection@4", &hwdriver.pfnMarkRenderSection},
+	{"GetRenderStats@4",    &hwdriver.pfnGetRenderStats},
+	{"ReadScreenAsync@20",  &hwdriver.pfnReadScreenAsync},
 	{"GetRenderVersion@0",  &hwdriver.pfnGetRenderVersion},
 #ifdef SHUFFLE
 	{"PostImgRedraw@4",     &hwdriver.pfnPostImgRedraw},
@@ -136,6 +143,8 @@ static loadfunc_t hwdFuncTable[] = {
 	{"SetBlend",            &hwdriver.pfnSetBlend},
 	{"ClearBuffer",         &hwdriver.pfnClearBuffer},
 	{"SetTexture",          &hwdriver.pfnSetTexture},
+	{"UpdateTexture",       &hwdriver.pfnUpdateTexture},
+	{"SetColormap",         &hwdriver.pfnSetColormap},
 	{"ReadRect",            &hwdriver.pfnReadRect},
 	{"GClipRect",           &hwdriver.pfnGClipRect},
 	{"ClearMipMapCache",    &hwdriver.pfnClearMipMapCache},
@@ -143,7 +152,12 @@ static loadfunc_t hwdFuncTable[] = {
 	{"DrawMD2",             &hwdriver.pfnDrawMD2},
 	{"DrawMD2i",            &hwdriver.pfnDrawMD2i},
 	{"SetTransform",        &hwdriver.pfnSetTransform},
+	{"SetBlendedTexture",   &hwdriver.pfnSetBlendedTexture},
 	{"GetTextureUsed",      &hwdriver.pfnGetTextureUsed},
+	{"GetTextureStats",     &hwdriver.pfnGetTextureStats},
+	{"MarkRenderSection",   &hwdriver.pfnMarkRenderSection},
+	{"GetRenderStats",      &hwdriver.pfnGetRenderStats},
+	{"ReadScreenAsync",     &hwdriver.pfnReadScreenAsync},
 	{"GetRenderVersion",    &hwdriver.pfnGetRenderVersion},
 #ifdef SHUFFLE
 	{"PostImgRedraw",       &hwdriver.pfnPostImgRedraw},
@@ -352,6 +352,12 @@ void I_FreeSfx(sfxinfo_t *sfx)
 	sfx->data = NULL;
 }
 
+void I_PrefetchSfx(sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx(sfx);
+}
+
 INT32 I_StartSound(sfxenum_t id, UINT8 vol, UINT8 sep, UINT8 pitch, UINT8 priority, INT32 channel)
 {
 	FMOD_SOUND *sound;
@@ -757,6 +763,12 @@ void I_UnloadSong(void)
 	}
 }
 
+void I_PrefetchSong(char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+}
+
 boolean I_PlaySong(boolean looping)
 {
 #ifdef HAVE_LIBGME
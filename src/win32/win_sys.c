@@ -259,12 +259,32 @@ tic_t I_GetTime(void)
 	return newtics;
 }
 
+UINT32 I_GetTimeMicros(void)
+{
+	static LARGE_INTEGER frequency = {{0, 0}};
+	LARGE_INTEGER currtime;
+
+	if (!frequency.QuadPart && !QueryPerformanceFrequency(&frequency))
+		frequency.QuadPart = -1;
+
+	if (frequency.QuadPart > 0 && QueryPerformanceCounter(&currtime))
+		return (UINT32)((currtime.QuadPart / frequency.QuadPart) * 1000000
+			+ (currtime.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+
+	return GetTickCount() * 1000;
+}
+
 void I_Sleep(void)
 {
 	if (cv_sleep.value != -1)
 		Sleep(cv_sleep.value);
 }
 
+void I_SleepMillis(UINT32 ms)
+{
+	Sleep(ms);
+}
+
 // should move to i_video
 void I_WaitVBL(INT32 count)
 {
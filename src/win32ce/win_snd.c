@@ -408,6 +408,12 @@ void I_FreeSfx (sfxinfo_t *sfx)
 	sfx->lumpnum = -1;
 }
 
+void I_PrefetchSfx (sfxinfo_t *sfx)
+{
+	if (!sfx->data)
+		sfx->data = I_GetSfx (sfx);
+}
+
 
 // --------------------------------------------------------------------------
 // Set the global volume for sound effects
@@ -159,6 +159,14 @@ static void Y_CalculateMatchWinners(void);
 static void Y_FollowIntermission(void);
 static void Y_UnloadData(void);
 
+// Dedicated servers go through the intermission without ever drawing it.
+static patch_t *Y_CachePatch(const char *name)
+{
+	if (dedicated)
+		return NULL;
+	return W_CachePatchName(name, PU_STATIC);
+}
+
 // Stuff copy+pasted from st_stuff.c
 static INT32 SCX(INT32 x)
 {
@@ -657,6 +665,14 @@ void Y_Ticker(void)
 
 	intertic++;
 
+	// Get the next map's music and data ready while the tally runs
+	if (intertic == 1 && nextmap >= 0 && nextmap < NUMMAPS && mapheaderinfo[nextmap])
+	{
+		S_PrefetchMusic(mapheaderinfo[nextmap]->musname);
+		P_StartMapPrefetch(nextmap);
+	}
+	P_MapPrefetchTicker();
+
 	// Team scramble code for team match and CTF.
 	// Don't do this if we're going to automatically scramble teams next round.
 	if (G_GametypeHasTeams() && cv_teamscramble.value && !cv_scrambleonchange.value && server)
@@ -1051,24 +1067,23 @@ void Y_StartIntermission(void)
 			}
 
 			for (i = 0; i < 4; ++i)
-				data.coop.bonuspatches[i] = W_CachePatchName(data.coop.bonuses[i].patch, PU_STATIC);
-			data.coop.ptotal = W_CachePatchName("YB_TOTAL", PU_STATIC);
+				data.coop.bonuspatches[i] = Y_CachePatch(data.coop.bonuses[i].patch);
+			data.coop.ptotal = Y_CachePatch("YB_TOTAL");
 
 			// get act number
 			if (mapheaderinfo[prevmap]->actnum)
-				data.coop.ttlnum = W_CachePatchName(va("TTL%.2d", mapheaderinfo[prevmap]->actnum),
-					PU_STATIC);
+				data.coop.ttlnum = Y_CachePatch(va("TTL%.2d", mapheaderinfo[prevmap]->actnum));
 			else
-				data.coop.ttlnum = W_CachePatchName("TTL01", PU_STATIC);
+				data.coop.ttlnum = Y_CachePatch("TTL01");
 
 			// get background patches
-			widebgpatch = W_CachePatchName("INTERSCW", PU_STATIC);
-			bgpatch = W_CachePatchName("INTERSCR", PU_STATIC);
+			widebgpatch = Y_CachePatch("INTERSCW");
+			bgpatch = Y_CachePatch("INTERSCR");
 
 			// grab an interscreen if appropriate
 			if (mapheaderinfo[gamemap-1]->interscreen[0] != '#')
 			{
-				interpic = W_CachePatchName(mapheaderinfo[gamemap-1]->interscreen, PU_STATIC);
+				interpic = Y_CachePatch(mapheaderinfo[gamemap-1]->interscreen);
 				useinterpic = true;
 				usebuffer = false;
 			}
@@ -1153,17 +1168,17 @@ void Y_StartIntermission(void)
 			// give out ring bonuses
 			Y_AwardSpecialStageBonus();
 
-			data.spec.bonuspatch = W_CachePatchName(data.spec.bonus.patch, PU_STATIC);
-			data.spec.pscore = W_CachePatchName("YB_SCORE", PU_STATIC);
-			data.spec.pcontinues = W_CachePatchName("YB_CONTI", PU_STATIC);
+			data.spec.bonuspatch = Y_CachePatch(data.spec.bonus.patch);
+			data.spec.pscore = Y_CachePatch("YB_SCORE");
+			data.spec.pcontinues = Y_CachePatch("YB_CONTI");
 
 			// get background tile
-			bgtile = W_CachePatchName("SPECTILE", PU_STATIC);
+			bgtile = Y_CachePatch("SPECTILE");
 
 			// grab an interscreen if appropriate
 			if (mapheaderinfo[gamemap-1]->interscreen[0] != '#')
 			{
-				interpic = W_CachePatchName(mapheaderinfo[gamemap-1]->interscreen, PU_STATIC);
+				interpic = Y_CachePatch(mapheaderinfo[gamemap-1]->interscreen);
 				useinterpic = true;
 			}
 			else
@@ -1175,14 +1190,14 @@ void Y_StartIntermission(void)
 			// get special stage specific patches
 /*			if (!stagefailed && ALL7EMERALDS(emeralds))
 			{
-				data.spec.cemerald = W_CachePatchName("GOTEMALL", PU_STATIC);
+				data.spec.cemerald = Y_CachePatch("GOTEMALL");
 				data.spec.headx = 70;
 				data.spec.nowsuper = players[consoleplayer].skin
-					? NULL : W_CachePatchName("NOWSUPER", PU_STATIC);
+					? NULL : Y_CachePatch("NOWSUPER");
 			}
 			else
 			{
-				data.spec.cemerald = W_CachePatchName("CEMERALD", PU_STATIC);
+				data.spec.cemerald = Y_CachePatch("CEMERALD");
 				data.spec.headx = 48;
 				data.spec.nowsuper = NULL;
 			} */
@@ -1255,9 +1270,9 @@ void Y_StartIntermission(void)
 
 			// get RESULT header
 			data.match.result =
-				W_CachePatchName("RESULT", PU_STATIC);
+				Y_CachePatch("RESULT");
 
-			bgtile = W_CachePatchName("SRB2BACK", PU_STATIC);
+			bgtile = Y_CachePatch("SRB2BACK");
 			usetile = true;
 			useinterpic = false;
 			break;
@@ -1283,9 +1298,9 @@ void Y_StartIntermission(void)
 			data.match.levelstring[sizeof data.match.levelstring - 1] = '\0';
 
 			// get RESULT header
-			data.match.result = W_CachePatchName("RESULT", PU_STATIC);
+			data.match.result = Y_CachePatch("RESULT");
 
-			bgtile = W_CachePatchName("SRB2BACK", PU_STATIC);
+			bgtile = Y_CachePatch("SRB2BACK");
 			usetile = true;
 			useinterpic = false;
 			break;
@@ -1322,7 +1337,7 @@ void Y_StartIntermission(void)
 				data.match.blueflag = bmatcico;
 			}
 
-			bgtile = W_CachePatchName("SRB2BACK", PU_STATIC);
+			bgtile = Y_CachePatch("SRB2BACK");
 			usetile = true;
 			useinterpic = false;
 			break;
@@ -1348,7 +1363,7 @@ void Y_StartIntermission(void)
 			data.competition.levelstring[sizeof data.competition.levelstring - 1] = '\0';
 
 			// get background tile
-			bgtile = W_CachePatchName("SRB2BACK", PU_STATIC);
+			bgtile = Y_CachePatch("SRB2BACK");
 			usetile = true;
 			useinterpic = false;
 			break;
@@ -1360,45 +1375,73 @@ void Y_StartIntermission(void)
 	}
 }
 
+// The winners are sorted best first, and on a tie the higher player
+// number goes first, the way they always have been.
+static int Y_CompareScores(const void *a, const void *b)
+{
+	const INT32 i = *(const INT32 *)a, j = *(const INT32 *)b;
+
+	if (players[i].score != players[j].score)
+		return (players[i].score > players[j].score) ? -1 : 1;
+	return j - i;
+}
+
+static int Y_CompareTimes(const void *a, const void *b)
+{
+	const INT32 i = *(const INT32 *)a, j = *(const INT32 *)b;
+
+	if (players[i].realtime != players[j].realtime)
+		return (players[i].realtime < players[j].realtime) ? -1 : 1;
+	return j - i;
+}
+
+static const UINT32 *sortpoints; // for Y_ComparePoints
+
+static int Y_ComparePoints(const void *a, const void *b)
+{
+	const INT32 i = *(const INT32 *)a, j = *(const INT32 *)b;
+
+	if (sortpoints[i] != sortpoints[j])
+		return (sortpoints[i] > sortpoints[j]) ? -1 : 1;
+	return j - i;
+}
+
+// Puts the numbers of the players in the game in order, returns how many
+static INT32 Y_SortPlayers(INT32 *order, int (*compare)(const void *, const void *))
+{
+	INT32 i, count = 0;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		if (playeringame[i])
+			order[count++] = i;
+
+	qsort(order, count, sizeof (*order), compare);
+	return count;
+}
+
 //
 // Y_CalculateMatchWinners
 //
 static void Y_CalculateMatchWinners(void)
 {
-	INT32 i, j;
-	boolean completed[MAXPLAYERS];
+	INT32 i, order[MAXPLAYERS];
 
 	// Initialize variables
 	memset(data.match.scores, 0, sizeof (data.match.scores));
 	memset(data.match.color, 0, sizeof (data.match.color));
 	memset(data.match.character, 0, sizeof (data.match.character));
 	memset(data.match.spectator, 0, sizeof (data.match.spectator));
-	memset(completed, 0, sizeof (completed));
-	data.match.numplayers = 0;
-	i = j = 0;
 
-	for (j = 0; j < MAXPLAYERS; j++)
-	{
-		if (!playeringame[j])
-			continue;
-
-		for (i = 0; i < MAXPLAYERS; i++)
-		{
-			if (!playeringame[i])
-				continue;
+	data.match.numplayers = Y_SortPlayers(order, Y_CompareScores);
 
-			if (players[i].score >= data.match.scores[data.match.numplayers] && completed[i] == false)
-			{
-				data.match.scores[data.match.numplayers] = players[i].score;
-				data.match.color[data.match.numplayers] = &players[i].skincolor;
-				data.match.character[data.match.numplayers] = &players[i].skin;
-				data.match.name[data.match.numplayers] = player_names[i];
-				data.match.spectator[data.match.numplayers] = players[i].spectator;
-				data.match.num[data.match.numplayers] = i;
-			}
-		}
-		completed[data.match.num[data.match.numplayers]] = true;
-		data.match.numplayers++;
+	for (i = 0; i < data.match.numplayers; i++)
+	{
+		data.match.scores[i] = players[order[i]].score;
+		data.match.color[i] = &players[order[i]].skincolor;
+		data.match.character[i] = &players[order[i]].skin;
+		data.match.name[i] = player_names[order[i]];
+		data.match.spectator[i] = players[order[i]].spectator;
+		data.match.num[i] = order[i];
 	}
 }
 
@@ -1407,8 +1450,7 @@ static void Y_CalculateMatchWinners(void)
 //
 static void Y_CalculateTimeRaceWinners(void)
 {
-	INT32 i, j;
-	boolean completed[MAXPLAYERS];
+	INT32 i, order[MAXPLAYERS];
 
 	// Initialize variables
 
@@ -1418,31 +1460,16 @@ static void Y_CalculateTimeRaceWinners(void)
 	memset(data.match.color, 0, sizeof (data.match.color));
 	memset(data.match.character, 0, sizeof (data.match.character));
 	memset(data.match.spectator, 0, sizeof (data.match.spectator));
-	memset(completed, 0, sizeof (completed));
-	data.match.numplayers = 0;
-	i = j = 0;
 
-	for (j = 0; j < MAXPLAYERS; j++)
-	{
-		if (!playeringame[j])
-			continue;
+	data.match.numplayers = Y_SortPlayers(order, Y_CompareTimes);
 
-		for (i = 0; i < MAXPLAYERS; i++)
-		{
-			if (!playeringame[i])
-				continue;
-
-			if (players[i].realtime <= data.match.scores[data.match.numplayers] && completed[i] == false)
-			{
-				data.match.scores[data.match.numplayers] = players[i].realtime;
-				data.match.color[data.match.numplayers] = &players[i].skincolor;
-				data.match.character[data.match.numplayers] = &players[i].skin;
-				data.match.name[data.match.numplayers] = player_names[i];
-				data.match.num[data.match.numplayers] = i;
-			}
-		}
-		completed[data.match.num[data.match.numplayers]] = true;
-		data.match.numplayers++;
+	for (i = 0; i < data.match.numplayers; i++)
+	{
+		data.match.scores[i] = players[order[i]].realtime;
+		data.match.color[i] = &players[order[i]].skincolor;
+		data.match.character[i] = &players[order[i]].skin;
+		data.match.name[i] = player_names[order[i]];
+		data.match.num[i] = order[i];
 	}
 }
 
@@ -1451,9 +1478,8 @@ static void Y_CalculateTimeRaceWinners(void)
 //
 static void Y_CalculateCompetitionWinners(void)
 {
-	INT32 i, j;
+	INT32 i, j, order[MAXPLAYERS];
 	boolean bestat[5];
-	boolean completed[MAXPLAYERS];
 	INT32 winner; // shortcut
 
 	UINT32 points[MAXPLAYERS];
@@ -1466,7 +1492,6 @@ static void Y_CalculateCompetitionWinners(void)
 
 	memset(data.competition.points, 0, sizeof (data.competition.points));
 	memset(points, 0, sizeof (points));
-	memset(completed, 0, sizeof (completed));
 
 	// Award points.
 	for (i = 0; i < MAXPLAYERS; i++)
@@ -1528,41 +1553,28 @@ static void Y_CalculateCompetitionWinners(void)
 	}
 
 	// Now we go through and set the data.competition struct properly
-	data.competition.numplayers = 0;
-	for (i = 0; i < MAXPLAYERS; i++)
-	{
-		if (!playeringame[i])
-			continue;
-
-		winner = 0;
+	sortpoints = points;
+	data.competition.numplayers = Y_SortPlayers(order, Y_ComparePoints);
 
-		for (j = 0; j < MAXPLAYERS; j++)
-		{
-			if (!playeringame[j])
-				continue;
+	for (i = 0; i < data.competition.numplayers; i++)
+	{
+		winner = order[i];
 
-			if (points[j] >= data.competition.points[data.competition.numplayers] && completed[j] == false)
-			{
-				data.competition.points[data.competition.numplayers] = points[j];
-				data.competition.num[data.competition.numplayers] = winner = j;
-			}
-		}
 		// We know this person won this spot, now let's set everything appropriately
-		data.competition.times[data.competition.numplayers] = times[winner];
-		data.competition.rings[data.competition.numplayers] = rings[winner];
-		data.competition.maxrings[data.competition.numplayers] = maxrings[winner];
-		data.competition.monitors[data.competition.numplayers] = monitors[winner];
-		data.competition.scores[data.competition.numplayers] = scores[winner];
+		data.competition.points[i] = points[winner];
+		data.competition.num[i] = winner;
+		data.competition.times[i] = times[winner];
+		data.competition.rings[i] = rings[winner];
+		data.competition.maxrings[i] = maxrings[winner];
+		data.competition.monitors[i] = monitors[winner];
+		data.competition.scores[i] = scores[winner];
 
 		strncpy(tempname, player_names[winner], 8);
 		tempname[8] = '\0';
-		strncpy(data.competition.name[data.competition.numplayers], tempname, 9);
-
-		data.competition.color[data.competition.numplayers] = &players[winner].skincolor;
-		data.competition.character[data.competition.numplayers] = &players[winner].skin;
+		strncpy(data.competition.name[i], tempname, 9);
 
-		completed[winner] = true;
-		data.competition.numplayers++;
+		data.competition.color[i] = &players[winner].skincolor;
+		data.competition.character[i] = &players[winner].skin;
 	}
 }
 
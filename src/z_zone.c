@@ -24,6 +24,16 @@
 ///        caught with this direct-malloc version. We also suspected that SRB2's
 ///        allocator was fragmenting badly. Finally, this version is a bit
 ///        simpler (about half the lines of code).
+///
+///        Blocks are kept on a list per tag, so purging a tag, or counting
+///        what it uses, only looks at that tag's blocks. Small blocks that
+///        get freed are kept around by size, and handed back out by the
+///        next Z_Malloc that wants one that big.
+///
+///        With zonebudget set, an allocation that would take the blocks
+///        past it first frees purgable blocks, the ones least recently
+///        allocated or retagged first. Each tag's list is kept newest
+///        first, so the oldest of a tag is always at the end of its list.
 
 #include "doomdef.h"
 #include "doomstat.h"
@@ -31,6 +41,7 @@
 #include "i_video.h" // rendermode
 #include "z_zone.h"
 #include "m_misc.h" // M_Memcpy
+#include "d_main.h" // srb2home, for memprofile diff
 #include "lua_script.h"
 
 #ifdef HWRENDER
@@ -44,12 +55,15 @@ static boolean Z_calloc = false;
 #endif
 
 #define ZONEID 0xa441d13d
+#define POOLID 0xa441b001 // live object carved out of a zpool_t slab
+#define POOLFREEID 0xa441b00f // pool object sitting on its free list
 
 #ifdef ZDEBUG
 //#define ZDEBUG2
 #endif
 
 struct memblock_s;
+struct zsite_s;
 
 typedef struct
 {
@@ -73,6 +87,9 @@ typedef struct memblock_s
 
 	size_t size; // including the header and blocks
 	size_t realsize; // size of real data only
+	size_t capacity; // how much was actually allocated at real
+	struct zsite_s *site; // where it came from, if memprofile is following it
+	UINT32 lastuse; // zoneclock when it was last allocated or retagged
 
 #ifdef ZDEBUG
 	const char *ownerfile;
@@ -131,7 +148,503 @@ static memblock_t *Ptr2Memblock(void *ptr, const char* func)
 
 }
 
-static memblock_t head;
+// One list of blocks per tag. Tags past MAXLISTEDTAG, if anyone uses
+// one, all share the last list.
+#define MAXLISTEDTAG 127
+#define NUMTAGLISTS (MAXLISTEDTAG + 2)
+#define TAGLIST(tag) ((tag) >= 0 && (tag) <= MAXLISTEDTAG ? (tag) : MAXLISTEDTAG + 1)
+
+static memblock_t heads[NUMTAGLISTS];
+static size_t tagusage[NUMTAGLISTS]; // bytes each list's blocks take up
+static size_t zoneusage; // all of them together
+static UINT32 zoneclock;
+
+// Does the list hold any blocks with tags from lowtag to hightag?
+static inline boolean Z_ListInRange(INT32 list, INT32 lowtag, INT32 hightag)
+{
+	if (list > MAXLISTEDTAG)
+		return lowtag < 0 || hightag > MAXLISTEDTAG;
+	return list >= lowtag && list <= hightag;
+}
+
+static void Z_LinkBlock(memblock_t *block)
+{
+	const INT32 list = TAGLIST(block->tag);
+	memblock_t *head = &heads[list];
+
+	block->next = head->next;
+	block->prev = head;
+	head->next = block;
+	block->next->prev = block;
+	block->lastuse = ++zoneclock;
+	tagusage[list] += block->size + sizeof *block;
+	zoneusage += block->size + sizeof *block;
+}
+
+static void Z_UnlinkBlock(memblock_t *block)
+{
+	block->prev->next = block->next;
+	block->next->prev = block->prev;
+	tagusage[TAGLIST(block->tag)] -= block->size + sizeof *block;
+	zoneusage -= block->size + sizeof *block;
+}
+
+// Valgrind has to see every block come and go, so nothing is kept for it.
+#ifndef HAVE_VALGRIND
+#define BLOCKCACHE
+#endif
+
+#ifdef BLOCKCACHE
+// Freed blocks of up to CACHEGRAIN*NUMCACHECLASSES bytes, with their
+// memory still attached, by size rounded up to CACHEGRAIN. That covers
+// sector nodes, net commands, and most of what Lua allocates.
+#define CACHEGRAIN 16
+#define NUMCACHECLASSES 32
+#define CACHEDEPTH 1024 // most blocks kept of any one size
+
+static memblock_t *cachedblocks[NUMCACHECLASSES]; // linked through next
+static size_t numcached[NUMCACHECLASSES];
+static size_t cachedbytes; // all of them, headers and all
+
+// Keeps a freed block for later, if it's one worth keeping.
+static boolean Z_CacheBlock(memblock_t *block)
+{
+	size_t cls;
+
+	if (block->capacity > CACHEGRAIN*NUMCACHECLASSES)
+		return false;
+	cls = block->capacity/CACHEGRAIN - 1;
+	if (numcached[cls] >= CACHEDEPTH)
+		return false;
+	// Kept blocks count towards the budget too
+	if (cv_zonebudget.value && zoneusage + cachedbytes + block->capacity + sizeof *block > (size_t)cv_zonebudget.value << 20)
+		return false;
+
+	block->next = cachedblocks[cls];
+	cachedblocks[cls] = block;
+	numcached[cls]++;
+	cachedbytes += block->capacity + sizeof *block;
+	return true;
+}
+
+// Gives every cached block back to the system.
+static void Z_FlushBlockCache(void)
+{
+	memblock_t *block;
+	size_t cls;
+
+	for (cls = 0; cls < NUMCACHECLASSES; cls++)
+	{
+		while ((block = cachedblocks[cls]) != NULL)
+		{
+			cachedblocks[cls] = block->next;
+			free(block->real);
+			free(block);
+		}
+		numcached[cls] = 0;
+	}
+	cachedbytes = 0;
+}
+
+#endif
+
+//
+// Zone budget
+//
+
+static CV_PossibleValue_t zonebudget_cons_t[] = {{0, "MIN"}, {4095, "MAX"}, {0, NULL}};
+consvar_t cv_zonebudget = {"zonebudget", "0", CV_SAVE, zonebudget_cons_t, NULL, 0, NULL, NULL, 0, 0, NULL};
+
+static UINT32 numevicted;
+static UINT64 evictedbytes;
+
+static void (*purgehook)(void *ptr, void **user, size_t size) = NULL;
+
+void Z_SetPurgeHook(void (*hook)(void *ptr, void **user, size_t size))
+{
+	purgehook = hook;
+}
+
+// Frees a block that's being purged rather than freed by its owner.
+static void Z_Purge(memblock_t *block)
+{
+	void *ptr = (UINT8 *)block->hdr + sizeof *block->hdr;
+
+	if (purgehook && block->tag >= PU_PURGELEVEL)
+		purgehook(ptr, block->user, block->realsize);
+	Z_Free(ptr);
+}
+
+// The purgable block that's gone unused the longest, if there is one
+static memblock_t *Z_OldestPurgable(void)
+{
+	memblock_t *oldest = NULL, *block;
+	INT32 list;
+
+	for (list = PU_PURGELEVEL; list < NUMTAGLISTS; list++)
+	{
+		block = heads[list].prev;
+		if (block == &heads[list] || block->tag < PU_PURGELEVEL)
+			continue;
+		if (!oldest || (INT32)(block->lastuse - oldest->lastuse) < 0)
+			oldest = block;
+	}
+	return oldest;
+}
+
+// Frees purgable blocks until size more bytes fit in the budget, or
+// there's nothing left to free.
+static void Z_MakeRoom(size_t size)
+{
+	const size_t budget = (size_t)cv_zonebudget.value << 20;
+	memblock_t *block;
+
+#ifdef BLOCKCACHE
+	if (zoneusage + cachedbytes + size > budget)
+		Z_FlushBlockCache();
+#endif
+
+	while (zoneusage + size > budget && (block = Z_OldestPurgable()) != NULL)
+	{
+		numevicted++;
+		evictedbytes += block->size + sizeof *block;
+		Z_Purge(block);
+	}
+}
+
+// Pool chunks keep a memhdr_t right in front of the object, like regular
+// blocks do, so Z_Free can tell them apart. For pool chunks the header's
+// block pointer refers to the owning zpool_t instead.
+#define POOLHDRSIZE ((sizeof (memhdr_t) + sizeof (void *) - 1) & ~(sizeof (void *) - 1))
+
+//
+// Heap profiling
+//
+// While memprofile is running, one allocation in every zsampleevery is
+// followed until it's freed, and counted towards the place it came
+// from and its tag. Everything shown is scaled back up by zsampleevery,
+// so with sampling on the numbers are estimates. Blocks allocated
+// before profiling started aren't counted at all.
+//
+
+typedef struct zsite_s
+{
+	const char *file;
+	INT32 line;
+	INT32 tag;
+
+	size_t live, blocks; // sampled blocks still allocated, and their bytes
+	size_t peak; // highest live since profiling started
+	UINT32 allocs; // sampled allocations in all
+	size_t snaplive, snapblocks; // live and blocks at the last snapshot
+
+	struct zsite_s *hashnext;
+} zsite_t;
+
+#define NUMSITEHASHES 1024
+#define DEFAULTSAMPLEEVERY 16
+
+static zsite_t *sitehash[NUMSITEHASHES];
+static size_t numsites;
+
+static boolean zprofiling = false;
+static UINT32 zsampleevery, zsamplecountdown;
+static tic_t zprofilestart, zsnapshottic;
+static boolean zsnapshot;
+
+// Every allocation, sampled or not, since profiling started
+static UINT32 zprofileallocs;
+static UINT64 zprofilebytes;
+static size_t zprofilelive, zprofilepeak; // of the sampled blocks
+
+static zsite_t *Z_ProfileSite(const char *file, INT32 line, INT32 tag)
+{
+	const size_t h = ((UINT32)line * 2654435761u ^ (UINT32)tag) % NUMSITEHASHES;
+	zsite_t *site;
+
+	for (site = sitehash[h]; site; site = site->hashnext)
+		if (site->line == line && site->tag == tag
+			&& (site->file == file || !strcmp(site->file, file)))
+			return site;
+
+	// Not zone memory, or this would never be done
+	site = calloc(1, sizeof *site);
+	if (!site)
+		return NULL;
+	site->file = file;
+	site->line = line;
+	site->tag = tag;
+	site->hashnext = sitehash[h];
+	sitehash[h] = site;
+	numsites++;
+	return site;
+}
+
+static void Z_ProfileAdd(zsite_t *site, size_t size, INT32 blocks)
+{
+	site->live += size;
+	site->blocks += blocks;
+	if (site->live > site->peak)
+		site->peak = site->live;
+	zprofilelive += size;
+	if (zprofilelive > zprofilepeak)
+		zprofilepeak = zprofilelive;
+}
+
+static void Z_ProfileRemove(zsite_t *site, size_t size, INT32 blocks)
+{
+	site->live -= size;
+	site->blocks -= blocks;
+	zprofilelive -= size;
+}
+
+static inline void Z_ProfileAlloc(memblock_t *block, const char *file, INT32 line)
+{
+	block->site = NULL;
+	if (!zprofiling)
+		return;
+
+	zprofileallocs++;
+	zprofilebytes += block->realsize;
+	if (--zsamplecountdown)
+		return;
+	zsamplecountdown = zsampleevery;
+
+	block->site = Z_ProfileSite(file, line, block->tag);
+	if (block->site)
+	{
+		block->site->allocs++;
+		Z_ProfileAdd(block->site, block->realsize, 1);
+	}
+}
+
+// Forgets every site, and every block's pointer to one.
+static void Z_ClearProfile(void)
+{
+	memblock_t *block;
+	zsite_t *site, *next;
+	INT32 list;
+
+	for (list = 0; list < NUMTAGLISTS; list++)
+		for (block = heads[list].next; block != &heads[list]; block = block->next)
+			block->site = NULL;
+
+	for (list = 0; list < NUMSITEHASHES; list++)
+	{
+		for (site = sitehash[list]; site; site = next)
+		{
+			next = site->hashnext;
+			free(site);
+		}
+		sitehash[list] = NULL;
+	}
+
+	numsites = 0;
+	zprofileallocs = 0;
+	zprofilebytes = 0;
+	zprofilelive = zprofilepeak = 0;
+	zsnapshot = false;
+}
+
+// Every site, in an array of numsites to be freed by the caller
+static zsite_t **Z_ProfileSites(void)
+{
+	zsite_t **sites = malloc((numsites ? numsites : 1) * sizeof *sites);
+	zsite_t *site;
+	size_t i, n = 0;
+
+	if (!sites)
+		return NULL;
+	for (i = 0; i < NUMSITEHASHES; i++)
+		for (site = sitehash[i]; site; site = site->hashnext)
+			sites[n++] = site;
+	return sites;
+}
+
+static int Z_CompareLive(const void *a, const void *b)
+{
+	const zsite_t *sa = *(const zsite_t *const *)a, *sb = *(const zsite_t *const *)b;
+
+	if (sa->live != sb->live)
+		return sa->live < sb->live ? 1 : -1;
+	return sa->peak < sb->peak ? 1 : sa->peak > sb->peak ? -1 : 0;
+}
+
+static INT64 Z_SiteGrowth(const zsite_t *site)
+{
+	return (INT64)site->live - (INT64)site->snaplive;
+}
+
+static int Z_CompareGrowth(const void *a, const void *b)
+{
+	const INT64 ga = Z_SiteGrowth(*(const zsite_t *const *)a);
+	const INT64 gb = Z_SiteGrowth(*(const zsite_t *const *)b);
+	const INT64 aa = ga < 0 ? -ga : ga, ab = gb < 0 ? -gb : gb;
+
+	return aa < ab ? 1 : aa > ab ? -1 : 0;
+}
+
+static const char *Z_SiteFile(const zsite_t *site)
+{
+	const char *filename = strrchr(site->file, PATHSEP[0]);
+	return filename ? filename + 1 : site->file;
+}
+
+static void Z_PrintProfile(size_t top)
+{
+	zsite_t **sites = Z_ProfileSites();
+	const tic_t tics = max(gametic - zprofilestart, 1);
+	size_t i;
+
+	if (!sites)
+		return;
+	qsort(sites, numsites, sizeof *sites, Z_CompareLive);
+
+	CONS_Printf("\x82%s", M_GetText("Heap Profile\n"));
+	CONS_Printf(M_GetText("%u tics, %u allocations (%u per tic), %s KB allocated (%s KB per tic)\n"),
+		tics, zprofileallocs, zprofileallocs/tics,
+		sizeu1((size_t)(zprofilebytes>>10)), sizeu2((size_t)(zprofilebytes/tics)>>10));
+	CONS_Printf(M_GetText("Live %s KB, peak %s KB, 1 in %u allocations sampled\n"),
+		sizeu1((zprofilelive*zsampleevery)>>10), sizeu2((zprofilepeak*zsampleevery)>>10), zsampleevery);
+	CONS_Printf(M_GetText("tag    live KB  blocks  peak KB allocs/tic  site\n"));
+	for (i = 0; i < numsites && i < top; i++)
+	{
+		const zsite_t *site = sites[i];
+		if (!site->peak)
+			break;
+		CONS_Printf("%3d %10s %7s %8s %10u  %s:%d\n", site->tag,
+			sizeu1((site->live*zsampleevery)>>10), sizeu2(site->blocks*zsampleevery),
+			sizeu3((site->peak*zsampleevery)>>10), site->allocs*zsampleevery/tics,
+			Z_SiteFile(site), site->line);
+	}
+
+	free(sites);
+}
+
+static void Z_TakeSnapshot(void)
+{
+	zsite_t *site;
+	size_t i;
+
+	for (i = 0; i < NUMSITEHASHES; i++)
+		for (site = sitehash[i]; site; site = site->hashnext)
+		{
+			site->snaplive = site->live;
+			site->snapblocks = site->blocks;
+		}
+	zsnapshot = true;
+	zsnapshottic = gametic;
+}
+
+// Everything that grew or shrank since the snapshot, to the console or to f
+static void Z_WriteDiff(FILE *f, size_t top)
+{
+	zsite_t **sites = Z_ProfileSites();
+	size_t i;
+
+	if (!sites)
+		return;
+	qsort(sites, numsites, sizeof *sites, Z_CompareGrowth);
+
+	if (f)
+		fprintf(f, "tag,growth,blocks,live,site\n");
+	else
+	{
+		CONS_Printf("\x82%s", M_GetText("Heap Growth\n"));
+		CONS_Printf(M_GetText("Over %u tics\n"), gametic - zsnapshottic);
+		CONS_Printf(M_GetText("tag  growth KB  blocks  live KB  site\n"));
+	}
+
+	for (i = 0; i < numsites && (f || i < top); i++)
+	{
+		const zsite_t *site = sites[i];
+		const INT64 growth = Z_SiteGrowth(site) * zsampleevery;
+		const INT64 blocks = ((INT64)site->blocks - (INT64)site->snapblocks) * zsampleevery;
+
+		if (!growth && !blocks)
+			break;
+		if (f)
+			fprintf(f, "%d,%d,%d,%s,%s:%d\n", site->tag, (INT32)growth, (INT32)blocks,
+				sizeu1(site->live*zsampleevery), Z_SiteFile(site), site->line);
+		else
+			CONS_Printf("%3d %10d %7d %8s  %s:%d\n", site->tag, (INT32)(growth/1024), (INT32)blocks,
+				sizeu1((site->live*zsampleevery)>>10), Z_SiteFile(site), site->line);
+	}
+
+	free(sites);
+}
+
+static void Command_Memprofile_f(void)
+{
+	const char *cmd = COM_Argc() > 1 ? COM_Argv(1) : "";
+	const size_t top = COM_Argc() > 2 ? (size_t)atoi(COM_Argv(2)) : 20;
+
+	if (!stricmp(cmd, "start"))
+	{
+		Z_ClearProfile();
+		zsampleevery = COM_Argc() > 2 ? max(atoi(COM_Argv(2)), 1) : DEFAULTSAMPLEEVERY;
+		zsamplecountdown = zsampleevery;
+		zprofilestart = gametic;
+		zprofiling = true;
+		CONS_Printf(M_GetText("Profiling 1 in %u allocations\n"), zsampleevery);
+		return;
+	}
+
+	if (!stricmp(cmd, "stop"))
+	{
+		zprofiling = false;
+		Z_ClearProfile();
+		return;
+	}
+
+	if (!zprofiling)
+	{
+		CONS_Printf(M_GetText(
+			"memprofile start [<sample 1 in n>]: start following allocations\n"
+			"memprofile show [<top>]: where the memory is now\n"
+			"memprofile snapshot: remember where the memory is now\n"
+			"memprofile diff [<top> | <file>]: what changed since the snapshot\n"
+			"memprofile stop: stop, and forget everything\n"));
+		return;
+	}
+
+	if (!stricmp(cmd, "snapshot"))
+	{
+		Z_TakeSnapshot();
+		CONS_Printf(M_GetText("Snapshot taken\n"));
+	}
+	else if (!stricmp(cmd, "diff"))
+	{
+		if (!zsnapshot)
+			CONS_Printf(M_GetText("Take a snapshot first\n"));
+		else if (COM_Argc() > 2 && !isdigit(COM_Argv(2)[0]))
+		{
+			char path[512];
+			FILE *f;
+
+			snprintf(path, sizeof path, "%s"PATHSEP"%s", srb2home, COM_Argv(2));
+			f = fopen(path, "w");
+
+			if (!f)
+			{
+				CONS_Alert(CONS_ERROR, M_GetText("Couldn't open %s for writing\n"), path);
+				return;
+			}
+			Z_WriteDiff(f, 0);
+			fclose(f);
+			CONS_Printf(M_GetText("Wrote %s\n"), path);
+		}
+		else
+			Z_WriteDiff(NULL, top);
+	}
+	else
+		Z_PrintProfile(top);
+}
+
+static zpool_t *poolhead;
+
+static void Z_PoolFree(void *ptr, memhdr_t *hdr);
+static void Z_PurgePool(zpool_t *pool);
 
 static void Command_Memfree_f(void);
 #ifdef ZDEBUG
@@ -141,16 +654,19 @@ static void Command_Memdump_f(void);
 void Z_Init(void)
 {
 	UINT32 total, memfree;
+	INT32 i;
 
-	memset(&head, 0x00, sizeof(head));
+	memset(heads, 0x00, sizeof(heads));
 
-	head.next = head.prev = &head;
+	for (i = 0; i < NUMTAGLISTS; i++)
+		heads[i].next = heads[i].prev = &heads[i];
 
 	memfree = I_GetFreeMem(&total)>>20;
 	CONS_Printf("System memory: %uMB - Free: %uMB\n", total>>20, memfree);
 
 	// Note: This allocates memory. Watch out.
 	COM_AddCommand("memfree", Command_Memfree_f);
+	COM_AddCommand("memprofile", Command_Memprofile_f);
 
 #ifdef ZDEBUG
 	COM_AddCommand("memdump", Command_Memdump_f);
@@ -164,6 +680,8 @@ void Z_Free(void *ptr)
 #endif
 {
 	memblock_t *block;
+	memhdr_t *hdr;
+	UINT32 id;
 
 	if (ptr == NULL)
 		return;
@@ -172,6 +690,20 @@ void Z_Free(void *ptr)
 	CONS_Debug(DBG_MEMORY, "Z_Free %s:%d\n", file, line);
 #endif
 
+	hdr = (memhdr_t *)((UINT8 *)ptr - sizeof *hdr);
+#ifdef VALGRIND_MAKE_MEM_DEFINED
+	VALGRIND_MAKE_MEM_DEFINED(hdr, sizeof *hdr);
+#endif
+	id = hdr->id;
+	if (id == POOLID || id == POOLFREEID)
+	{
+		Z_PoolFree(ptr, hdr);
+		return;
+	}
+#ifdef VALGRIND_MAKE_MEM_NOACCESS
+	VALGRIND_MAKE_MEM_NOACCESS(hdr, sizeof *hdr);
+#endif
+
 #ifdef ZDEBUG
 	block = Ptr2Memblock2(ptr, "Z_Free", file, line);
 #else
@@ -196,10 +728,16 @@ void Z_Free(void *ptr)
 	if (block->user != NULL)
 		*block->user = NULL;
 
+	if (block->site)
+		Z_ProfileRemove(block->site, block->realsize, 1);
+
 	// Free the memory and get rid of the block.
+	Z_UnlinkBlock(block);
+#ifdef BLOCKCACHE
+	if (Z_CacheBlock(block))
+		return;
+#endif
 	free(block->real);
-	block->prev->next = block->next;
-	block->next->prev = block->prev;
 	free(block);
 #ifdef VALGRIND_DESTROY_MEMPOOL
 	VALGRIND_DESTROY_MEMPOOL(block);
@@ -216,6 +754,9 @@ static void *xm(size_t size)
 	{
 		// Oh crumbs: we're out of heap. Try purging the cache and reallocating.
 		Z_FreeTags(PU_PURGELEVEL, INT32_MAX);
+#ifdef BLOCKCACHE
+		Z_FlushBlockCache();
+#endif
 		p = malloc(padedsize);
 
 		if (p == NULL)
@@ -235,30 +776,52 @@ static void *xm(size_t size)
 // You can pass Z_Malloc() a NULL user if the tag is less than
 // PU_PURGELEVEL.
 
-#ifdef ZDEBUG
 void *Z_Malloc2(size_t size, INT32 tag, void *user, INT32 alignbits,
 	const char *file, INT32 line)
-#else
-void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
-#endif
 {
 	size_t extrabytes = (1<<alignbits) - 1;
 	size_t padsize = 0;
-	memblock_t *block;
-	void *ptr;
+	memblock_t *block = NULL;
+	void *ptr = NULL;
 	memhdr_t *hdr;
 	void *given;
 	size_t blocksize = extrabytes + sizeof *hdr + size;
+	size_t capacity;
 
 #ifdef ZDEBUG2
 	CONS_Debug(DBG_MEMORY, "Z_Malloc %s:%d\n", file, line);
 #endif
 
-	block = xm(sizeof *block);
 #ifdef HAVE_VALGRIND
 	padsize += (1<<sizeof(size_t))*2;
 #endif
-	ptr = xm(blocksize + padsize*2);
+	capacity = blocksize + padsize*2;
+
+	if (cv_zonebudget.value)
+		Z_MakeRoom(capacity + sizeof *block);
+
+#ifdef BLOCKCACHE
+	if (capacity <= CACHEGRAIN*NUMCACHECLASSES)
+	{
+		const size_t cls = (capacity - 1)/CACHEGRAIN;
+
+		capacity = (cls + 1)*CACHEGRAIN;
+		block = cachedblocks[cls];
+		if (block)
+		{
+			cachedblocks[cls] = block->next;
+			numcached[cls]--;
+			cachedbytes -= capacity + sizeof *block;
+			ptr = block->real;
+		}
+	}
+#endif
+
+	if (!block)
+	{
+		block = xm(sizeof *block);
+		ptr = xm(capacity);
+	}
 
 	// This horrible calculation makes sure that "given" is aligned
 	// properly.
@@ -276,11 +839,6 @@ void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
 	VALGRIND_MEMPOOL_ALLOC(block, hdr, size + sizeof *hdr);
 #endif
 
-	block->next = head.next;
-	block->prev = &head;
-	head.next = block;
-	block->next->prev = block;
-
 	block->real = ptr;
 	block->hdr = hdr;
 	block->tag = tag;
@@ -291,6 +849,9 @@ void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
 #endif
 	block->size = blocksize;
 	block->realsize = size;
+	block->capacity = capacity;
+	Z_LinkBlock(block);
+	Z_ProfileAlloc(block, file, line);
 
 	hdr->id = ZONEID;
 	hdr->block = block;
@@ -311,27 +872,15 @@ void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
 	return given;
 }
 
-#ifdef ZDEBUG
 void *Z_Calloc2(size_t size, INT32 tag, void *user, INT32 alignbits, const char *file, INT32 line)
-#else
-void *Z_CallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits)
-#endif
 {
 #ifdef VALGRIND_MEMPOOL_ALLOC
 	Z_calloc = true;
 #endif
-#ifdef ZDEBUG
-	return memset(Z_Malloc2    (size, tag, user, alignbits, file, line), 0, size);
-#else
-	return memset(Z_MallocAlign(size, tag, user, alignbits            ), 0, size);
-#endif
+	return memset(Z_Malloc2(size, tag, user, alignbits, file, line), 0, size);
 }
 
-#ifdef ZDEBUG
 void *Z_Realloc2(void *ptr, size_t size, INT32 tag, void *user, INT32 alignbits, const char *file, INT32 line)
-#else
-void *Z_ReallocAlign(void *ptr, size_t size,INT32 tag, void *user,  INT32 alignbits)
-#endif
 {
 	void *rez;
 	memblock_t *block;
@@ -349,11 +898,7 @@ void *Z_ReallocAlign(void *ptr, size_t size,INT32 tag, void *user,  INT32 alignb
 
 	if (!ptr)
 	{
-#ifdef ZDEBUG
-		return Z_Calloc2(size, tag, user, alignbits, file , line);
-#else
-		return Z_CallocAlign(size, tag, user, alignbits);
-#endif
+		return Z_Calloc2(size, tag, user, alignbits, file, line);
 	}
 
 #ifdef ZDEBUG
@@ -365,13 +910,41 @@ void *Z_ReallocAlign(void *ptr, size_t size,INT32 tag, void *user,  INT32 alignb
 	if (block == NULL)
 		return NULL;
 
+#ifdef BLOCKCACHE
+	// If it still fits where it is, without wasting most of the space,
+	// just change its size.
+	if (block->tag == tag && (void *)block->user == user
+		&& !((size_t)ptr & ((1<<alignbits) - 1))
+		&& (UINT8 *)ptr + size <= (UINT8 *)block->real + block->capacity
+		&& size >= block->realsize/2)
+	{
+#ifdef HAVE_BLUA
+		// Same as if it had moved
+		if (tag != PU_LUA)
+			LUA_InvalidateUserdata(ptr);
+#endif
+		if (size > block->realsize)
+			memset((UINT8 *)ptr + block->realsize, 0x00, size - block->realsize);
+		tagusage[TAGLIST(tag)] -= block->realsize;
+		tagusage[TAGLIST(tag)] += size;
+		zoneusage -= block->realsize;
+		zoneusage += size;
+		if (block->site)
+		{
+			Z_ProfileRemove(block->site, block->realsize, 1);
+			Z_ProfileAdd(block->site, size, 1);
+		}
+		block->size = block->size - block->realsize + size;
+		block->realsize = size;
+		return ptr;
+	}
+#endif
+
 #ifdef ZDEBUG
 	// Write every Z_Realloc call to a debug file.
 	DEBFILE(va("Z_Realloc at %s:%d\n", file, line));
-	rez = Z_Malloc2(size, tag, user, alignbits, file, line);
-#else
-	rez = Z_MallocAlign(size, tag, user, alignbits);
 #endif
+	rez = Z_Malloc2(size, tag, user, alignbits, file, line);
 
 	if (size < block->realsize)
 		copysize = size;
@@ -397,17 +970,229 @@ void *Z_ReallocAlign(void *ptr, size_t size,INT32 tag, void *user,  INT32 alignb
 	return rez;
 }
 
+/** Allocates a zeroed object out of a fixed-size pool.
+  * The pool registers itself on first use. When its free list runs dry,
+  * another slab of pool->perslab objects is allocated with pool->tag.
+  * \param pool The pool to allocate from.
+  * \return A zeroed object of pool->objsize bytes. Free it with Z_Free.
+  * \sa Z_PoolFree, Z_PurgePool
+  */
+void *Z_PoolCalloc(zpool_t *pool)
+{
+	UINT8 *obj;
+	memhdr_t *hdr;
+
+	if (!pool->stride)
+	{
+		if (pool->tag >= PU_PURGELEVEL)
+			I_Error("Z_PoolCalloc: pool %s cannot use a purgable tag", pool->name);
+		if (!pool->perslab)
+			pool->perslab = 1;
+		pool->stride = POOLHDRSIZE + ((pool->objsize + sizeof (void *) - 1) & ~(sizeof (void *) - 1));
+		pool->next = poolhead;
+		poolhead = pool;
+	}
+
+	if (pool->freelist)
+		pool->recycled++;
+	else
+	{
+		// Out of chunks, grab a new slab and thread it onto the free list backwards
+		// so objects are handed out in address order.
+		UINT8 *slab = Z_MallocAlign(POOLHDRSIZE + pool->stride*pool->perslab, pool->tag, NULL, 4);
+		size_t i = pool->perslab;
+
+		*(void **)slab = pool->slabs;
+		pool->slabs = slab;
+		pool->numslabs++;
+
+		while (i--)
+		{
+			obj = slab + POOLHDRSIZE + i*pool->stride + POOLHDRSIZE;
+			hdr = (memhdr_t *)(obj - sizeof *hdr);
+			hdr->block = (struct memblock_s *)(void *)pool;
+			hdr->id = POOLFREEID;
+			*(void **)obj = pool->freelist;
+			pool->freelist = obj;
+		}
+	}
+
+	obj = pool->freelist;
+	pool->freelist = *(void **)obj;
+	hdr = (memhdr_t *)(obj - sizeof *hdr);
+	hdr->id = POOLID;
+
+	pool->allocs++;
+	if (++pool->live > pool->peak)
+		pool->peak = pool->live;
+
+	return memset(obj, 0, pool->objsize);
+}
+
+/** Returns a pool object to its free list. Called through Z_Free.
+  * \param ptr The object being freed.
+  * \param hdr Its header.
+  */
+static void Z_PoolFree(void *ptr, memhdr_t *hdr)
+{
+	zpool_t *pool = (zpool_t *)(void *)hdr->block;
+
+	if (hdr->id == POOLFREEID)
+		I_Error("Z_Free: %s object freed twice", pool->name);
+
+#ifdef HAVE_BLUA
+	if (pool->tag != PU_LUA)
+		LUA_InvalidateUserdata(ptr);
+#endif
+
+	hdr->id = POOLFREEID;
+	*(void **)ptr = pool->freelist;
+	pool->freelist = ptr;
+	pool->live--;
+}
+
+/** Forgets every slab of a pool right before Z_FreeTags frees them.
+  * Live objects are treated as if they were Z_Free'd one by one.
+  * \param pool The pool to purge.
+  */
+static void Z_PurgePool(zpool_t *pool)
+{
+#ifdef HAVE_BLUA
+	UINT8 *slab;
+	size_t i;
+
+	if (pool->tag != PU_LUA && pool->live)
+		for (slab = pool->slabs; slab; slab = *(void **)slab)
+			for (i = 0; i < pool->perslab; i++)
+			{
+				UINT8 *obj = slab + POOLHDRSIZE + i*pool->stride + POOLHDRSIZE;
+				if (((memhdr_t *)(obj - sizeof (memhdr_t)))->id == POOLID)
+					LUA_InvalidateUserdata(obj);
+			}
+#endif
+
+	pool->slabs = pool->freelist = NULL;
+	pool->numslabs = pool->live = pool->peak = 0;
+}
+
+// ----------------
+// The level arena
+// ----------------
+
+#define ARENAALIGN 8
+
+static UINT8 *levelarena; // NULL once the level is freed, as its user
+static size_t arenasize, arenaused, arenalast;
+static size_t arenaspilled; // bytes that didn't fit and came from the zone
+static UINT32 arenaallocs, arenaspills;
+
+/** Makes the arena for the level about to be loaded.
+  * Call after the last level is freed.
+  * \param size What the level's geometry is expected to take.
+  */
+void Z_StartLevelArena(size_t size)
+{
+	if (levelarena)
+		Z_Free(levelarena);
+	arenasize = arenaused = arenalast = arenaspilled = 0;
+	arenaallocs = arenaspills = 0;
+
+	size = (size + ARENAALIGN - 1) & ~(size_t)(ARENAALIGN - 1);
+	if (!size)
+		return;
+	Z_Malloc(size, PU_LEVEL, &levelarena);
+	arenasize = size;
+}
+
+/** Allocates zeroed memory for the level, out of the arena if it fits.
+  * \param size Number of bytes.
+  * \param file Where it was asked for, if it has to come from the zone.
+  * \param line The line there.
+  * eturn The memory, which lasts until the level's freed.
+  */
+void *Z_LevelCalloc2(size_t size, const char *file, INT32 line)
+{
+	size_t need = (size + ARENAALIGN - 1) & ~(size_t)(ARENAALIGN - 1);
+	void *ptr;
+
+	if (!levelarena || need > arenasize - arenaused)
+	{
+		arenaspilled += size;
+		arenaspills++;
+		return Z_Calloc2(size, PU_LEVEL, NULL, 0, file, line);
+	}
+
+	ptr = levelarena + arenaused;
+	arenalast = arenaused;
+	arenaused += need;
+	arenaallocs++;
+	return memset(ptr, 0, size);
+}
+
+/** Frees memory from Z_LevelCalloc. Only the last thing taken from the
+  * arena gives its space back; anything else in it stays until the level
+  * goes.
+  * \param ptr The memory, or NULL.
+  */
+void Z_LevelFree(void *ptr)
+{
+	UINT8 *p = ptr;
+
+	if (!ptr)
+		return;
+	if (!levelarena || p < levelarena || p >= levelarena + arenasize)
+	{
+		Z_Free(ptr);
+		return;
+	}
+	if (p == levelarena + arenalast)
+		arenaused = arenalast;
+}
+
+/** Gets how full the level arena is.
+  * \param used Bytes given out of it.
+  * \param size Its size, or 0 if there isn't one.
+  * \param spilled Bytes that came from the zone because it was full.
+  */
+void Z_LevelArenaUsage(size_t *used, size_t *size, size_t *spilled)
+{
+	if (!levelarena)
+		arenasize = arenaused = 0;
+	*used = arenaused;
+	*size = arenasize;
+	*spilled = arenaspilled;
+}
+
+static void Z_CheckList(INT32 list, INT32 i, UINT32 *blocknumon);
+
 void Z_FreeTags(INT32 lowtag, INT32 hightag)
 {
 	memblock_t *block, *next;
+	zpool_t *pool;
+	UINT32 blocknumon = 0;
+	INT32 list;
+
+	for (list = 0; list < NUMTAGLISTS; list++)
+		if (Z_ListInRange(list, lowtag, hightag))
+			Z_CheckList(list, 420, &blocknumon);
 
-	Z_CheckHeap(420);
-	for (block = head.next; block != &head; block = next)
+	// The slabs themselves are freed below along with every other block.
+	for (pool = poolhead; pool; pool = pool->next)
+		if (pool->tag >= lowtag && pool->tag <= hightag)
+			Z_PurgePool(pool);
+
+	for (list = 0; list < NUMTAGLISTS; list++)
 	{
-		next = block->next; // get link before freeing
+		if (!Z_ListInRange(list, lowtag, hightag))
+			continue;
 
-		if (block->tag >= lowtag && block->tag <= hightag)
-			Z_Free((UINT8 *)block->hdr + sizeof *block->hdr);
+		for (block = heads[list].next; block != &heads[list]; block = next)
+		{
+			next = block->next; // get link before freeing
+
+			if (block->tag >= lowtag && block->tag <= hightag)
+				Z_Purge(block);
+		}
 	}
 }
 
@@ -437,26 +1222,27 @@ void Z_CheckMemCleanup(void)
 }
 
 
-/** Checks the heap, as well as the memhdr_ts, for any corruption or
-  * other problems.
-  * \param i Identifies from where in the code Z_CheckHeap was called.
-  * \author Graue <graue@oceanbase.org>
+/** Checks one tag list's blocks, as well as their memhdr_ts, for any
+  * corruption or other problems.
+  * \param list The list to check.
+  * \param i Identifies from where in the code the check was asked for.
+  * \param blocknumon Number of blocks checked so far, for the errors.
+  * \sa Z_CheckHeap
   */
-void Z_CheckHeap(INT32 i)
+static void Z_CheckList(INT32 list, INT32 i, UINT32 *blocknumon)
 {
 	memblock_t *block;
 	memhdr_t *hdr;
-	UINT32 blocknumon = 0;
 	void *given;
 
-	for (block = head.next; block != &head; block = block->next)
+	for (block = heads[list].next; block != &heads[list]; block = block->next)
 	{
-		blocknumon++;
+		(*blocknumon)++;
 		hdr = block->hdr;
 		given = (UINT8 *)hdr + sizeof *hdr;
 #ifdef ZDEBUG2
 		CONS_Debug(DBG_MEMORY, "block %u owned by %s:%d\n",
-			blocknumon, block->ownerfile, block->ownerline);
+			*blocknumon, block->ownerfile, block->ownerline);
 #endif
 #ifdef VALGRIND_MEMPOOL_EXISTS
 		if (!VALGRIND_MEMPOOL_EXISTS(block))
@@ -465,7 +1251,7 @@ void Z_CheckHeap(INT32 i)
 #ifdef ZDEBUG
 				"(owned by %s:%d)"
 #endif
-				" should not exist", i, blocknumon
+				" should not exist", i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -478,7 +1264,7 @@ void Z_CheckHeap(INT32 i)
 #ifdef ZDEBUG
 				"(owned by %s:%d)"
 #endif
-				" doesn't have a proper user", i, blocknumon
+				" doesn't have a proper user", i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -490,7 +1276,7 @@ void Z_CheckHeap(INT32 i)
 #ifdef ZDEBUG
 				"(owned by %s:%d)"
 #endif
-				" lacks proper backlink", i, blocknumon
+				" lacks proper backlink", i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -502,7 +1288,7 @@ void Z_CheckHeap(INT32 i)
 #ifdef ZDEBUG
 				"(owned by %s:%d)"
 #endif
-				" lacks proper forward link", i, blocknumon
+				" lacks proper forward link", i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -518,7 +1304,7 @@ void Z_CheckHeap(INT32 i)
 				"(owned by %s:%d)"
 #endif
 				" doesn't have linkback from allocated memory",
-				i, blocknumon
+				i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -530,7 +1316,7 @@ void Z_CheckHeap(INT32 i)
 #ifdef ZDEBUG
 				"(owned by %s:%d)"
 #endif
-				" have the wrong ID", i, blocknumon
+				" have the wrong ID", i, *blocknumon
 #ifdef ZDEBUG
 				, block->ownerfile, block->ownerline
 #endif
@@ -539,9 +1325,35 @@ void Z_CheckHeap(INT32 i)
 #ifdef VALGRIND_MAKE_MEM_NOACCESS
 	VALGRIND_MAKE_MEM_NOACCESS(hdr, sizeof *hdr);
 #endif
+		if (TAGLIST(block->tag) != list)
+		{
+			I_Error("Z_CheckHeap %d: block %u"
+#ifdef ZDEBUG
+				"(owned by %s:%d)"
+#endif
+				" is on the wrong tag list", i, *blocknumon
+#ifdef ZDEBUG
+				, block->ownerfile, block->ownerline
+#endif
+					);
+		}
 	}
 }
 
+/** Checks the heap, as well as the memhdr_ts, for any corruption or
+  * other problems.
+  * \param i Identifies from where in the code Z_CheckHeap was called.
+  * \author Graue <graue@oceanbase.org>
+  */
+void Z_CheckHeap(INT32 i)
+{
+	UINT32 blocknumon = 0;
+	INT32 list;
+
+	for (list = 0; list < NUMTAGLISTS; list++)
+		Z_CheckList(list, i, &blocknumon);
+}
+
 #ifdef PARANOIA
 void Z_ChangeTag2(void *ptr, INT32 tag, const char *file, INT32 line)
 #else
@@ -584,7 +1396,19 @@ void Z_ChangeTag2(void *ptr, INT32 tag)
 		I_Error("Internal memory management error: "
 			"tried to make block purgable but it has no owner");
 
+	Z_UnlinkBlock(block);
 	block->tag = tag;
+	Z_LinkBlock(block);
+
+	// Counted under the new tag from now on
+	if (block->site && block->site->tag != tag)
+	{
+		zsite_t *site = Z_ProfileSite(block->site->file, block->site->line, tag);
+		Z_ProfileRemove(block->site, block->realsize, 1);
+		block->site = site;
+		if (site)
+			Z_ProfileAdd(site, block->realsize, 1);
+	}
 }
 
 /** Calculates memory usage for a given set of tags.
@@ -598,13 +1422,21 @@ size_t Z_TagsUsage(INT32 lowtag, INT32 hightag)
 {
 	size_t cnt = 0;
 	memblock_t *rover;
+	INT32 list;
 
-	for (rover = head.next; rover != &head; rover = rover->next)
-	{
-		if (rover->tag < lowtag || rover->tag > hightag)
-			continue;
-		cnt += rover->size + sizeof *rover;
-	}
+	for (list = 0; list <= MAXLISTEDTAG; list++)
+		if (list >= lowtag && list <= hightag)
+			cnt += tagusage[list];
+
+	// The odd tags all share a list, so look at each of those
+	list = MAXLISTEDTAG + 1;
+	if (Z_ListInRange(list, lowtag, hightag))
+		for (rover = heads[list].next; rover != &heads[list]; rover = rover->next)
+		{
+			if (rover->tag < lowtag || rover->tag > hightag)
+				continue;
+			cnt += rover->size + sizeof *rover;
+		}
 
 	return cnt;
 }
@@ -617,6 +1449,7 @@ size_t Z_TagUsage(INT32 tagnum)
 void Command_Memfree_f(void)
 {
 	UINT32 freebytes, totalbytes;
+	zpool_t *pool;
 
 	Z_CheckHeap(-1);
 	CONS_Printf("\x82%s", M_GetText("Memory Info\n"));
@@ -629,6 +1462,15 @@ void Command_Memfree_f(void)
 	CONS_Printf(M_GetText("Special thinker   : %7s KB\n"), sizeu1(Z_TagUsage(PU_LEVSPEC)>>10));
 	CONS_Printf(M_GetText("All purgable      : %7s KB\n"),
 		sizeu1(Z_TagsUsage(PU_PURGELEVEL, INT32_MAX)>>10));
+#ifdef BLOCKCACHE
+	CONS_Printf(M_GetText("Freed, kept       : %7s KB\n"), sizeu1(cachedbytes>>10));
+#endif
+	if (levelarena)
+		CONS_Printf(M_GetText("Level arena       : %7s of %s KB, %u allocations, %u (%s KB) didn't fit\n"),
+			sizeu1(arenaused>>10), sizeu2(arenasize>>10), arenaallocs, arenaspills, sizeu3(arenaspilled>>10));
+	if (cv_zonebudget.value)
+		CONS_Printf(M_GetText("Budget            : %7d KB, %u blocks (%s KB) purged to stay in it\n"),
+			cv_zonebudget.value<<10, numevicted, sizeu1((size_t)(evictedbytes>>10)));
 
 #ifdef HWRENDER
 	if (rendermode != render_soft && rendermode != render_none)
@@ -641,6 +1483,18 @@ void Command_Memfree_f(void)
 	}
 #endif
 
+	if (poolhead)
+	{
+		CONS_Printf("\x82%s", M_GetText("Object Pools\n"));
+		for (pool = poolhead; pool; pool = pool->next)
+		{
+			CONS_Printf(M_GetText("%-18s: %7s KB in %s slabs\n"), pool->name,
+				sizeu1((pool->numslabs*(POOLHDRSIZE + pool->stride*pool->perslab))>>10), sizeu2(pool->numslabs));
+			CONS_Printf(M_GetText("  live %s, peak %s, %u of %u allocations recycled\n"),
+				sizeu1(pool->live), sizeu2(pool->peak), pool->recycled, pool->allocs);
+		}
+	}
+
 	CONS_Printf("\x82%s", M_GetText("System Memory Info\n"));
 	freebytes = I_GetFreeMem(&totalbytes);
 	CONS_Printf(M_GetText("    Total physical memory: %7u KB\n"), totalbytes>>10);
@@ -652,7 +1506,7 @@ static void Command_Memdump_f(void)
 {
 	memblock_t *block;
 	INT32 mintag = 0, maxtag = INT32_MAX;
-	INT32 i;
+	INT32 i, list;
 
 	if ((i = COM_CheckParm("-min")))
 		mintag = atoi(COM_Argv(i + 1));
@@ -660,12 +1514,13 @@ static void Command_Memdump_f(void)
 	if ((i = COM_CheckParm("-max")))
 		maxtag = atoi(COM_Argv(i + 1));
 
-	for (block = head.next; block != &head; block = block->next)
-		if (block->tag >= mintag && block->tag <= maxtag)
-		{
-			char *filename = strrchr(block->ownerfile, PATHSEP[0]);
-			CONS_Printf("[%3d] %s (%s) bytes @ %s:%d\n", block->tag, sizeu1(block->size), sizeu2(block->realsize), filename ? filename + 1 : block->ownerfile, block->ownerline);
-		}
+	for (list = 0; list < NUMTAGLISTS; list++)
+		for (block = heads[list].next; block != &heads[list]; block = block->next)
+			if (block->tag >= mintag && block->tag <= maxtag)
+			{
+				char *filename = strrchr(block->ownerfile, PATHSEP[0]);
+				CONS_Printf("[%3d] %s (%s) bytes @ %s:%d\n", block->tag, sizeu1(block->size), sizeu2(block->realsize), filename ? filename + 1 : block->ownerfile, block->ownerline);
+			}
 }
 #endif
 
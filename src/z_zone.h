@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include "doomtype.h"
+#include "command.h"
 
 #ifdef __GNUC__ // __attribute__ ((X))
 #if (__GNUC__ > 4) || (__GNUC__ == 4 && (__GNUC_MINOR__ >= 3 || (__GNUC_MINOR__ == 2 && __GNUC_PATCHLEVEL__ >= 5)))
@@ -58,8 +59,16 @@
                                   // stored in hardware format and downloaded as needed
 #define PU_HWRPATCHINFO_UNLOCKED 103
 
+extern consvar_t cv_zonebudget;
+
 void Z_Init(void);
 void Z_FreeTags(INT32 lowtag, INT32 hightag);
+
+/**	\brief Sets what gets a look at every purgable block the zone purges,
+	by budget or by Z_FreeTags, just before it's freed.
+	\param	hook	called with the block's data, user and size, or NULL
+*/
+void Z_SetPurgeHook(void (*hook)(void *ptr, void **user, size_t size));
 void Z_CheckMemCleanup(void);
 void Z_CheckHeap(INT32 i);
 #ifdef PARANOIA
@@ -77,6 +86,12 @@ void Z_SetUser2(void *ptr, void **newuser);
 #ifdef ZDEBUG
 #define Z_Free(p) Z_Free2(p, __FILE__, __LINE__)
 void Z_Free2(void *ptr, const char *file, INT32 line);
+#else
+void Z_Free(void *ptr);
+#endif
+
+// Where each allocation comes from is passed along even in release
+// builds, for memprofile.
 #define Z_Malloc(s,t,u) Z_Malloc2(s, t, u, 0, __FILE__, __LINE__)
 #define Z_MallocAlign(s,t,u,a) Z_Malloc2(s, t, u, a, __FILE__, __LINE__)
 void *Z_Malloc2(size_t size, INT32 tag, void *user, INT32 alignbits, const char *file, INT32 line) FUNCALLOC(1);
@@ -86,15 +101,50 @@ void *Z_Calloc2(size_t size, INT32 tag, void *user, INT32 alignbits, const char
 #define Z_Realloc(p,s,t,u) Z_Realloc2(p, s, t, u, 0, __FILE__, __LINE__)
 #define Z_ReallocAlign(p,s,t,u,a) Z_Realloc2(p,s, t, u, a, __FILE__, __LINE__)
 void *Z_Realloc2(void *ptr, size_t size, INT32 tag, void *user, INT32 alignbits, const char *file, INT32 line) FUNCALLOC(2);
-#else
-void Z_Free(void *ptr);
-void *Z_MallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits) FUNCALLOC(1);
-#define Z_Malloc(s,t,u) Z_MallocAlign(s, t, u, 0)
-void *Z_CallocAlign(size_t size, INT32 tag, void *user, INT32 alignbits) FUNCALLOC(1);
-#define Z_Calloc(s,t,u) Z_CallocAlign(s, t, u, 0)
-void *Z_ReallocAlign(void *ptr, size_t size, INT32 tag, void *user, INT32 alignbits) FUNCALLOC(2) ;
-#define Z_Realloc(p, s,t,u) Z_ReallocAlign(p, s, t, u, 0)
-#endif
+
+//
+// Fixed-size object pools.
+// Objects are carved out of zone-allocated slabs and recycled through a free
+// list instead of going through malloc/free every time. Pool objects can be
+// released with the regular Z_Free, and all slabs are dropped in bulk when
+// their tag is purged by Z_FreeTags.
+//
+typedef struct zpool_s
+{
+	const char *name;
+	size_t objsize; // size of one object, as requested
+	size_t perslab; // objects per slab
+	INT32 tag; // tag the slabs are allocated with
+
+	// Everything below is managed by z_zone.c
+	size_t stride; // size of one chunk, including its header
+	void *slabs; // most recently allocated slab
+	void *freelist; // recycled chunks
+	size_t numslabs; // slabs currently allocated
+	size_t live; // objects currently in use
+	size_t peak; // highest live count since the pool was last purged
+	UINT32 allocs; // total allocations, for statistics
+	UINT32 recycled; // allocations served from the free list
+	struct zpool_s *next; // next registered pool
+} zpool_t;
+
+#define Z_POOLINIT(name, type, perslab, tag) {name, sizeof (type), perslab, tag, 0, NULL, NULL, 0, 0, 0, 0, 0, NULL}
+
+void *Z_PoolCalloc(zpool_t *pool);
+
+//
+// Level arena.
+// A level's geometry is bump-allocated out of one PU_LEVEL block, sized
+// from the map lumps before they're loaded, so it goes in one go with the
+// rest of the level instead of as thousands of blocks. What doesn't fit
+// comes from the zone as usual. Nothing in it can be Z_Free'd or
+// Z_Realloc'd on its own; use Z_LevelFree for what may be in it.
+//
+void Z_StartLevelArena(size_t size);
+#define Z_LevelCalloc(s) Z_LevelCalloc2(s, __FILE__, __LINE__)
+void *Z_LevelCalloc2(size_t size, const char *file, INT32 line) FUNCALLOC(1);
+void Z_LevelFree(void *ptr);
+void Z_LevelArenaUsage(size_t *used, size_t *size, size_t *spilled);
 
 size_t Z_TagUsage(INT32 tagnum);
 size_t Z_TagsUsage(INT32 lowtag, INT32 hightag);
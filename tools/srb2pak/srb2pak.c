@@ -0,0 +1,493 @@
+/*
+ * srb2pak: turns a wad or pk3 into an SRB2 pack, and checks packs.
+ *
+ * A pack is what the game's ResGetLumpsPack reads (see packinfo_t in
+ * src/w_wad.h): a 64 byte header, the directory, the full names, both
+ * name indexes exactly as W_BuildLumpHash would build them, and then the
+ * lumps. Lumps start on 16 byte boundaries, or on a page if they're big,
+ * so the game can use them straight out of its mapping of the file.
+ *
+ * This file is distributed under the terms of the GNU General Public
+ * License, version 2, like the rest of SRB2.
+ */
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <stdint.h>
+#else
+typedef unsigned int uint32_t;
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+#endif
+#include <zlib.h>
+#include "lzf.h"
+#include "md5.h"
+
+#define PACKID "SRB2PAK1"
+#define PACK_FOLDERS 1
+#define PACK_STORED 0
+#define PACK_LZF 1
+
+#define HEADERSIZE 64
+#define DIRENTRYSIZE 28
+#define PAGESIZE 4096 // lumps this big or bigger start on a page
+#define LUMPALIGN 16
+#define MINCOMPRESS 1024 // don't bother compressing lumps smaller than this
+#define MAXLUMPS 65534 // the game's lump numbers are 16 bit, with 65535 ending chains
+#define HASHEND 0xFFFF
+
+typedef struct
+{
+	char name[9];
+	char *fullname;
+	uint8_t *data; // uncompressed
+	uint32_t size;
+	uint8_t *packed; // what goes in the pack, data itself if stored
+	uint32_t packedsize;
+	uint16_t compression;
+	uint32_t filepos;
+	uint32_t nameofs;
+} lump_t;
+
+static lump_t *lumps = NULL;
+static uint32_t numlumps = 0;
+
+static void fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fputs("srb2pak: ", stderr);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+	exit(1);
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size ? size : 1);
+
+	if (!p)
+		fail("out of memory");
+	return p;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t n)
+{
+	p[0] = (uint8_t)n;
+	p[1] = (uint8_t)(n >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t n)
+{
+	p[0] = (uint8_t)n;
+	p[1] = (uint8_t)(n >> 8);
+	p[2] = (uint8_t)(n >> 16);
+	p[3] = (uint8_t)(n >> 24);
+}
+
+static uint8_t *readfile(const char *filename, uint32_t *size)
+{
+	FILE *fp = fopen(filename, "rb");
+	uint8_t *buf;
+	long len;
+
+	if (!fp)
+		fail("can't open %s", filename);
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (len < 0)
+		fail("can't read %s", filename);
+	buf = xmalloc((size_t)len);
+	if (fread(buf, 1, (size_t)len, fp) != (size_t)len)
+		fail("can't read %s", filename);
+	fclose(fp);
+	*size = (uint32_t)len;
+	return buf;
+}
+
+static lump_t *newlump(void)
+{
+	lump_t *l;
+
+	if (numlumps >= MAXLUMPS)
+		fail("too many lumps, a pack can hold %d", MAXLUMPS);
+	lumps = realloc(lumps, (numlumps + 1) * sizeof (*lumps));
+	if (!lumps)
+		fail("out of memory");
+	l = &lumps[numlumps++];
+	memset(l, 0, sizeof (*l));
+	return l;
+}
+
+/* Same as W_HashLumpName in src/w_wad.c, which has to find what we put here. */
+static uint32_t hashname(const char *name, size_t len)
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	while (len-- && *name)
+	{
+		hash ^= (uint8_t)toupper(*name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+//
+// Reading wads
+//
+static void readwad(const uint8_t *file, uint32_t filesize)
+{
+	uint32_t count, dirofs, i;
+	int compressed = !memcmp(file, "ZWAD", 4);
+
+	if (filesize < 12 || (!compressed && memcmp(file, "IWAD", 4)
+		&& memcmp(file, "PWAD", 4) && memcmp(file, "SDLL", 4)))
+		fail("not a wad");
+
+	count = get32(file + 4);
+	dirofs = get32(file + 8);
+	if (dirofs > filesize || count > (filesize - dirofs) / 16)
+		fail("wad directory is corrupt");
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t *entry = file + dirofs + i*16;
+		uint32_t pos = get32(entry), size = get32(entry + 4);
+		lump_t *l = newlump();
+
+		if (pos > filesize || size > filesize - pos)
+			fail("lump %u is outside the wad", i);
+
+		memcpy(l->name, entry + 8, 8);
+		l->name[8] = '\0';
+		l->fullname = xmalloc(9);
+		strcpy(l->fullname, l->name); // a wad's lumps have no other name
+
+		if (compressed && size >= 4)
+		{
+			uint32_t realsize = get32(file + pos);
+
+			pos += 4;
+			size -= 4;
+			if (realsize)
+			{
+				l->data = xmalloc(realsize);
+				if (lzf_decompress(file + pos, size, l->data, realsize) != realsize)
+					fail("%s: can't unpack lump", l->name);
+				l->size = realsize;
+				continue;
+			}
+		}
+
+		l->data = xmalloc(size);
+		memcpy(l->data, file + pos, size);
+		l->size = size;
+	}
+}
+
+//
+// Reading pk3s
+//
+static void readzip(const uint8_t *file, uint32_t filesize)
+{
+	uint32_t end, count, cdir, i;
+
+	// the end of central directory record is in the last 64K or so
+	if (filesize < 22)
+		fail("not a pk3");
+	for (end = filesize - 22;; end--)
+	{
+		if (!memcmp(file + end, "PK\5\6", 4))
+			break;
+		if (end == 0 || filesize - end > 22 + 65536)
+			fail("missing central directory");
+	}
+
+	count = get16(file + end + 10);
+	cdir = get32(file + end + 16);
+
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t *entry;
+		uint16_t method, namelen;
+		uint32_t compsize, size, local, pos;
+		const char *trimname, *dotpos;
+		lump_t *l = newlump();
+
+		if (cdir > filesize - 46 || memcmp(file + cdir, "PK\1\2", 4))
+			fail("central directory is corrupt");
+		entry = file + cdir;
+		method = get16(entry + 10);
+		compsize = get32(entry + 20);
+		size = get32(entry + 24);
+		namelen = get16(entry + 28);
+		local = get32(entry + 42);
+		if (cdir + 46 + namelen > filesize)
+			fail("central directory is corrupt");
+
+		l->fullname = xmalloc(namelen + 1);
+		memcpy(l->fullname, entry + 46, namelen);
+		l->fullname[namelen] = '\0';
+		cdir += 46 + namelen + get16(entry + 30) + get16(entry + 32);
+
+		// The 8 character name, the way ResGetLumpsZip makes it
+		if ((trimname = strrchr(l->fullname, '/')) != NULL)
+			trimname++;
+		else
+			trimname = l->fullname;
+		if ((dotpos = strrchr(trimname, '.')) == NULL)
+			dotpos = l->fullname + strlen(l->fullname);
+		if (dotpos > trimname)
+			strncpy(l->name, trimname, (dotpos - trimname) < 8 ? (size_t)(dotpos - trimname) : 8);
+
+		if (local > filesize - 30 || memcmp(file + local, "PK\3\4", 4))
+			fail("%s: local header is corrupt", l->fullname);
+		pos = local + 30 + get16(file + local + 26) + get16(file + local + 28);
+		if (pos > filesize || compsize > filesize - pos)
+			fail("%s: is outside the pk3", l->fullname);
+
+		l->data = xmalloc(size);
+		l->size = size;
+		switch (method)
+		{
+		case 0:
+			if (compsize != size)
+				fail("%s: stored with the wrong size", l->fullname);
+			memcpy(l->data, file + pos, size);
+			break;
+		case 8:
+			{
+				z_stream strm;
+
+				memset(&strm, 0, sizeof strm);
+				strm.next_in = (Bytef *)(file + pos);
+				strm.avail_in = compsize;
+				strm.next_out = l->data;
+				strm.avail_out = size;
+				if (inflateInit2(&strm, -15) != Z_OK
+					|| inflate(&strm, Z_FINISH) != Z_STREAM_END
+					|| strm.total_out != size)
+					fail("%s: can't inflate", l->fullname);
+				inflateEnd(&strm);
+			}
+			break;
+		case 14:
+			if (lzf_decompress(file + pos, compsize, l->data, size) != size)
+				fail("%s: can't unpack", l->fullname);
+			break;
+		default:
+			fail("%s: unsupported compression method %u", l->fullname, method);
+		}
+	}
+}
+
+//
+// Writing packs
+//
+
+// Builds one name index the way W_BuildLumpHash does.
+static void buildhash(uint8_t *out, uint32_t numbuckets, int fullname)
+{
+	uint16_t *buckets = xmalloc(numbuckets * sizeof (*buckets));
+	uint16_t *next = xmalloc(numlumps * sizeof (*next));
+	uint32_t i;
+
+	memset(buckets, 0xff, numbuckets * sizeof (*buckets));
+	for (i = numlumps; i-- > 0;) // backwards, so chains go up
+	{
+		uint32_t b = (fullname ? hashname(lumps[i].fullname, (size_t)-1)
+			: hashname(lumps[i].name, 8)) & (numbuckets - 1);
+		next[i] = buckets[b];
+		buckets[b] = (uint16_t)i;
+	}
+
+	for (i = 0; i < numbuckets; i++)
+		put16(out + i*2, buckets[i]);
+	for (i = 0; i < numlumps; i++)
+		put16(out + (numbuckets + i)*2, next[i]);
+	free(buckets);
+	free(next);
+}
+
+static void packlumps(int compress)
+{
+	uint32_t i;
+
+	for (i = 0; i < numlumps; i++)
+	{
+		lump_t *l = &lumps[i];
+
+		l->packed = l->data;
+		l->packedsize = l->size;
+		l->compression = PACK_STORED;
+
+		if (compress && l->size >= MINCOMPRESS)
+		{
+			// only worth it if it saves an eighth
+			uint8_t *buf = xmalloc(l->size);
+			unsigned int len = lzf_compress(l->data, l->size, buf, l->size - l->size/8);
+
+			if (len)
+			{
+				l->packed = buf;
+				l->packedsize = len;
+				l->compression = PACK_LZF;
+			}
+			else
+				free(buf);
+		}
+	}
+}
+
+static void writepack(const char *filename, uint32_t flags)
+{
+	uint32_t numbuckets = 16, namessize = 0, hashsize, pos, i;
+	uint32_t dirofs, namesofs, hashofs;
+	uint8_t *out;
+	FILE *fp;
+
+	while (numbuckets < numlumps)
+		numbuckets <<= 1;
+
+	for (i = 0; i < numlumps; i++)
+	{
+		lumps[i].nameofs = namessize;
+		namessize += (uint32_t)strlen(lumps[i].fullname) + 1;
+	}
+
+	dirofs = HEADERSIZE;
+	namesofs = dirofs + numlumps*DIRENTRYSIZE;
+	hashofs = (namesofs + namessize + 1) & ~1u;
+	hashsize = 2 * (numbuckets + numlumps) * 2;
+
+	// The lumps start on a page of their own
+	pos = (hashofs + hashsize + PAGESIZE - 1) & ~(uint32_t)(PAGESIZE - 1);
+	for (i = 0; i < numlumps; i++)
+	{
+		uint32_t align = lumps[i].packedsize >= PAGESIZE ? PAGESIZE : LUMPALIGN;
+
+		pos = (pos + align - 1) & ~(align - 1);
+		lumps[i].filepos = pos;
+		pos += lumps[i].packedsize;
+		if (pos < lumps[i].filepos)
+			fail("pack would be over 4 GB");
+	}
+
+	out = xmalloc(pos);
+	memset(out, 0, pos);
+
+	memcpy(out, PACKID, 8);
+	put32(out + 8, flags);
+	put32(out + 12, numlumps);
+	put32(out + 16, dirofs);
+	put32(out + 20, namesofs);
+	put32(out + 24, namessize);
+	put32(out + 28, hashofs);
+	put32(out + 32, numbuckets);
+
+	for (i = 0; i < numlumps; i++)
+	{
+		const lump_t *l = &lumps[i];
+		uint8_t *entry = out + dirofs + i*DIRENTRYSIZE;
+
+		put32(entry, l->filepos);
+		put32(entry + 4, l->packedsize);
+		put32(entry + 8, l->size);
+		put32(entry + 12, l->nameofs);
+		put16(entry + 16, l->compression);
+		memcpy(entry + 20, l->name, strlen(l->name));
+		strcpy((char *)out + namesofs + l->nameofs, l->fullname);
+		memcpy(out + l->filepos, l->packed, l->packedsize);
+	}
+
+	buildhash(out + hashofs, numbuckets, 0);
+	buildhash(out + hashofs + (numbuckets + numlumps)*2, numbuckets, 1);
+
+	md5_buffer((const char *)out + HEADERSIZE, pos - HEADERSIZE, out + 36);
+
+	if ((fp = fopen(filename, "wb")) == NULL)
+		fail("can't create %s", filename);
+	if (fwrite(out, 1, pos, fp) != pos || fclose(fp))
+		fail("can't write %s", filename);
+	free(out);
+
+	printf("%s: %u lumps, %u bytes\n", filename, numlumps, pos);
+}
+
+static int verifypack(const char *filename)
+{
+	uint32_t size;
+	uint8_t *file = readfile(filename, &size);
+	uint8_t md5sum[16];
+	int bad;
+
+	if (size < HEADERSIZE || memcmp(file, PACKID, 8))
+		fail("%s is not a pack", filename);
+
+	md5_buffer((const char *)file + HEADERSIZE, size - HEADERSIZE, md5sum);
+	bad = memcmp(md5sum, file + 36, 16);
+	free(file);
+	if (bad)
+	{
+		printf("%s: MD5 mismatch, the pack is damaged\n", filename);
+		return 1;
+	}
+	printf("%s: OK\n", filename);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int compress = 0;
+	uint8_t *file;
+	uint32_t filesize;
+	size_t len;
+
+	if (argc == 3 && !strcmp(argv[1], "v"))
+		return verifypack(argv[2]);
+
+	if (argc == 4 && !strcmp(argv[1], "z"))
+		compress = 1;
+	else if (!(argc == 4 && !strcmp(argv[1], "c")))
+	{
+		fputs("usage: srb2pak c|z input.wad|input.pk3 output.pak\n"
+			"       srb2pak v file.pak\n"
+			"c makes a pack of stored lumps, z packs big lumps with lzf,\n"
+			"v checks a pack's MD5.\n", stderr);
+		return 2;
+	}
+
+	file = readfile(argv[2], &filesize);
+	len = strlen(argv[2]);
+	if (len >= 4 && (!strcmp(argv[2] + len - 4, ".pk3") || !strcmp(argv[2] + len - 4, ".PK3")))
+	{
+		readzip(file, filesize);
+		packlumps(compress);
+		writepack(argv[3], PACK_FOLDERS);
+	}
+	else
+	{
+		readwad(file, filesize);
+		packlumps(compress);
+		writepack(argv[3], 0);
+	}
+	return 0;
+}